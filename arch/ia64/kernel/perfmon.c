@@ -2283,6 +2283,7 @@ pfm_smpl_buffer_alloc(struct task_struct *task, struct file *filp, pfm_context_t
 		DPRINT(("Cannot allocate vma\n"));
 		goto error_kmem;
 	}
+	vma_init_speculative(vma);
 	INIT_LIST_HEAD(&vma->anon_vma_chain);
 
 	/*
@@ -0,0 +1,132 @@
+/*
+ * AES block cipher using the scalar crypto (Zkne/Zknd) instructions
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <crypto/aes.h>
+#include <linux/crypto.h>
+#include <linux/module.h>
+#include <asm/hwcap.h>
+#include <asm/insn-def.h>
+#include <asm/unaligned.h>
+
+/*
+ * Each instruction computes one half of the 128-bit state after a round,
+ * taking the half to produce in rs1 and the other half in rs2.
+ */
+#define AES64_OP(name, func7)						\
+static __always_inline u64 name(u64 rs1, u64 rs2)			\
+{									\
+	u64 rd;								\
+									\
+	__asm__ (INSN_R(OPCODE_OP, "0", func7, "%0", "%1", "%2")	\
+		 : "=r" (rd) : "r" (rs1), "r" (rs2));			\
+	return rd;							\
+}
+
+AES64_OP(aes64es, "0x19")
+AES64_OP(aes64esm, "0x1b")
+AES64_OP(aes64ds, "0x1d")
+AES64_OP(aes64dsm, "0x1f")
+
+/*
+ * crypto_aes_expand_key() leaves the schedules as little-endian words, so
+ * each round key is two native u64s in the order the instructions expect.
+ * The decryption schedule is the one for the equivalent inverse cipher,
+ * with InvMixColumns already applied, which is what aes64dsm wants.
+ */
+static void aes_riscv64_encrypt(struct crypto_tfm *tfm, u8 *out, const u8 *in)
+{
+	struct crypto_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+	const u64 *rk = (const u64 *)ctx->key_enc;
+	int rounds = 6 + ctx->key_length / 4;
+	u64 s0, s1, t0, t1;
+
+	s0 = get_unaligned_le64(in) ^ rk[0];
+	s1 = get_unaligned_le64(in + 8) ^ rk[1];
+
+	while (--rounds) {
+		rk += 2;
+		t0 = aes64esm(s0, s1);
+		t1 = aes64esm(s1, s0);
+		s0 = t0 ^ rk[0];
+		s1 = t1 ^ rk[1];
+	}
+
+	rk += 2;
+	t0 = aes64es(s0, s1);
+	t1 = aes64es(s1, s0);
+	put_unaligned_le64(t0 ^ rk[0], out);
+	put_unaligned_le64(t1 ^ rk[1], out + 8);
+}
+
+static void aes_riscv64_decrypt(struct crypto_tfm *tfm, u8 *out, const u8 *in)
+{
+	struct crypto_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+	const u64 *rk = (const u64 *)ctx->key_dec;
+	int rounds = 6 + ctx->key_length / 4;
+	u64 s0, s1, t0, t1;
+
+	s0 = get_unaligned_le64(in) ^ rk[0];
+	s1 = get_unaligned_le64(in + 8) ^ rk[1];
+
+	while (--rounds) {
+		rk += 2;
+		t0 = aes64dsm(s0, s1);
+		t1 = aes64dsm(s1, s0);
+		s0 = t0 ^ rk[0];
+		s1 = t1 ^ rk[1];
+	}
+
+	rk += 2;
+	t0 = aes64ds(s0, s1);
+	t1 = aes64ds(s1, s0);
+	put_unaligned_le64(t0 ^ rk[0], out);
+	put_unaligned_le64(t1 ^ rk[1], out + 8);
+}
+
+static struct crypto_alg aes_alg = {
+	.cra_name			= "aes",
+	.cra_driver_name		= "aes-riscv64-zkn",
+	.cra_priority			= 300,
+	.cra_flags			= CRYPTO_ALG_TYPE_CIPHER,
+	.cra_blocksize			= AES_BLOCK_SIZE,
+	.cra_ctxsize			= sizeof(struct crypto_aes_ctx),
+	.cra_module			= THIS_MODULE,
+	.cra_cipher.cia_min_keysize	= AES_MIN_KEY_SIZE,
+	.cra_cipher.cia_max_keysize	= AES_MAX_KEY_SIZE,
+	.cra_cipher.cia_setkey		= crypto_aes_set_key,
+	.cra_cipher.cia_encrypt		= aes_riscv64_encrypt,
+	.cra_cipher.cia_decrypt		= aes_riscv64_decrypt
+};
+
+static int __init aes_riscv64_init(void)
+{
+	if (!riscv_isa_extension_available(RISCV_ISA_EXT_ZKNE) ||
+	    !riscv_isa_extension_available(RISCV_ISA_EXT_ZKND))
+		return -ENODEV;
+
+	return crypto_register_alg(&aes_alg);
+}
+
+static void __exit aes_riscv64_fini(void)
+{
+	crypto_unregister_alg(&aes_alg);
+}
+
+module_init(aes_riscv64_init);
+module_exit(aes_riscv64_fini);
+
+MODULE_DESCRIPTION("AES cipher using RISC-V Zkne/Zknd");
+MODULE_LICENSE("GPL v2");
+MODULE_ALIAS_CRYPTO("aes");
@@ -0,0 +1,155 @@
+/*
+ * CRC32 and CRC32C digest algorithms using carry-less multiplication
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/crc32.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <crypto/internal/hash.h>
+#include <asm/hwcap.h>
+#include <asm/unaligned.h>
+
+/*
+ * The work is done by the Zbc versions of crc32_le() and __crc32c_le() in
+ * arch/riscv/lib/crc32.c, which also serve every other user of the
+ * library; this only puts them in front of the crypto API users too.
+ */
+
+static int crc32_riscv_cra_init(struct crypto_tfm *tfm)
+{
+	u32 *key = crypto_tfm_ctx(tfm);
+
+	*key = 0;
+	return 0;
+}
+
+static int crc32c_riscv_cra_init(struct crypto_tfm *tfm)
+{
+	u32 *key = crypto_tfm_ctx(tfm);
+
+	*key = ~0;
+	return 0;
+}
+
+static int crc32_riscv_setkey(struct crypto_shash *hash, const u8 *key,
+			      unsigned int keylen)
+{
+	u32 *mctx = crypto_shash_ctx(hash);
+
+	if (keylen != sizeof(u32)) {
+		crypto_shash_set_flags(hash, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+	*mctx = get_unaligned_le32(key);
+	return 0;
+}
+
+static int crc32_riscv_init(struct shash_desc *desc)
+{
+	u32 *mctx = crypto_shash_ctx(desc->tfm);
+	u32 *crc = shash_desc_ctx(desc);
+
+	*crc = *mctx;
+	return 0;
+}
+
+static int crc32_riscv_update(struct shash_desc *desc, const u8 *data,
+			      unsigned int length)
+{
+	u32 *crc = shash_desc_ctx(desc);
+
+	*crc = crc32_le(*crc, data, length);
+	return 0;
+}
+
+static int crc32c_riscv_update(struct shash_desc *desc, const u8 *data,
+			       unsigned int length)
+{
+	u32 *crc = shash_desc_ctx(desc);
+
+	*crc = __crc32c_le(*crc, data, length);
+	return 0;
+}
+
+static int crc32_riscv_final(struct shash_desc *desc, u8 *out)
+{
+	u32 *crc = shash_desc_ctx(desc);
+
+	put_unaligned_le32(*crc, out);
+	return 0;
+}
+
+static int crc32c_riscv_final(struct shash_desc *desc, u8 *out)
+{
+	u32 *crc = shash_desc_ctx(desc);
+
+	put_unaligned_le32(~*crc, out);
+	return 0;
+}
+
+static struct shash_alg crc32_riscv_algs[] = { {
+	.setkey			= crc32_riscv_setkey,
+	.init			= crc32_riscv_init,
+	.update			= crc32_riscv_update,
+	.final			= crc32_riscv_final,
+	.descsize		= sizeof(u32),
+	.digestsize		= sizeof(u32),
+
+	.base.cra_ctxsize	= sizeof(u32),
+	.base.cra_init		= crc32_riscv_cra_init,
+	.base.cra_name		= "crc32",
+	.base.cra_driver_name	= "crc32-riscv",
+	.base.cra_priority	= 200,
+	.base.cra_blocksize	= 1,
+	.base.cra_module	= THIS_MODULE,
+}, {
+	.setkey			= crc32_riscv_setkey,
+	.init			= crc32_riscv_init,
+	.update			= crc32c_riscv_update,
+	.final			= crc32c_riscv_final,
+	.descsize		= sizeof(u32),
+	.digestsize		= sizeof(u32),
+
+	.base.cra_ctxsize	= sizeof(u32),
+	.base.cra_init		= crc32c_riscv_cra_init,
+	.base.cra_name		= "crc32c",
+	.base.cra_driver_name	= "crc32c-riscv",
+	.base.cra_priority	= 200,
+	.base.cra_blocksize	= 1,
+	.base.cra_module	= THIS_MODULE,
+} };
+
+static int __init crc32_riscv_mod_init(void)
+{
+	if (!riscv_isa_extension_available(RISCV_ISA_EXT_ZBC))
+		return -ENODEV;
+
+	return crypto_register_shashes(crc32_riscv_algs,
+				       ARRAY_SIZE(crc32_riscv_algs));
+}
+
+static void __exit crc32_riscv_mod_exit(void)
+{
+	crypto_unregister_shashes(crc32_riscv_algs,
+				  ARRAY_SIZE(crc32_riscv_algs));
+}
+
+module_init(crc32_riscv_mod_init);
+module_exit(crc32_riscv_mod_exit);
+
+MODULE_DESCRIPTION("CRC32 and CRC32C using RISC-V Zbc");
+MODULE_LICENSE("GPL v2");
+MODULE_ALIAS_CRYPTO("crc32");
+MODULE_ALIAS_CRYPTO("crc32c");
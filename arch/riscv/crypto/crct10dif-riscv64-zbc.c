@@ -0,0 +1,115 @@
+/*
+ * CRC-T10DIF using carry-less multiplication (Zbc)
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/crc-t10dif.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <crypto/internal/hash.h>
+#include <asm/clmul.h>
+#include <asm/hwcap.h>
+#include <asm/unaligned.h>
+
+#define CRCT10DIF_POLY		0x8bb7
+/* floor(x^80 / P), less its x^64 term */
+#define CRCT10DIF_POLY_QT	0xf65a57f81d33a48aUL
+
+/*
+ * The T10 CRC isn't bit-reflected, so each big-endian 64-bit word is
+ * folded in with a Barrett reduction on the top of the product: the high
+ * half of s * floor(x^80 / P) is the quotient, and the remainder is the
+ * low 16 bits of the quotient times P.
+ */
+static u16 crct10dif_zbc(u16 crc, const u8 *p, size_t len)
+{
+	size_t head = -(unsigned long)p & (sizeof(unsigned long) - 1);
+
+	if (head) {
+		head = min(head, len);
+		crc = crc_t10dif_generic(crc, p, head);
+		p += head;
+		len -= head;
+	}
+
+	for (; len >= sizeof(unsigned long); len -= sizeof(unsigned long)) {
+		unsigned long s = ((unsigned long)crc << 48) ^
+				  be64_to_cpup((const __be64 *)p);
+		unsigned long q = clmulh(s, CRCT10DIF_POLY_QT) ^ s;
+
+		crc = clmul(q, CRCT10DIF_POLY);
+		p += sizeof(unsigned long);
+	}
+
+	return len ? crc_t10dif_generic(crc, p, len) : crc;
+}
+
+static int crct10dif_init(struct shash_desc *desc)
+{
+	u16 *crc = shash_desc_ctx(desc);
+
+	*crc = 0;
+	return 0;
+}
+
+static int crct10dif_update(struct shash_desc *desc, const u8 *data,
+			    unsigned int length)
+{
+	u16 *crc = shash_desc_ctx(desc);
+
+	*crc = crct10dif_zbc(*crc, data, length);
+	return 0;
+}
+
+static int crct10dif_final(struct shash_desc *desc, u8 *out)
+{
+	u16 *crc = shash_desc_ctx(desc);
+
+	*(u16 *)out = *crc;
+	return 0;
+}
+
+static struct shash_alg crc_t10dif_alg = {
+	.digestsize		= CRC_T10DIF_DIGEST_SIZE,
+	.init			= crct10dif_init,
+	.update			= crct10dif_update,
+	.final			= crct10dif_final,
+	.descsize		= CRC_T10DIF_DIGEST_SIZE,
+
+	.base.cra_name		= "crct10dif",
+	.base.cra_driver_name	= "crct10dif-riscv",
+	.base.cra_priority	= 200,
+	.base.cra_blocksize	= CRC_T10DIF_BLOCK_SIZE,
+	.base.cra_module	= THIS_MODULE,
+};
+
+static int __init crc_t10dif_mod_init(void)
+{
+	if (!riscv_isa_extension_available(RISCV_ISA_EXT_ZBC))
+		return -ENODEV;
+
+	return crypto_register_shash(&crc_t10dif_alg);
+}
+
+static void __exit crc_t10dif_mod_exit(void)
+{
+	crypto_unregister_shash(&crc_t10dif_alg);
+}
+
+module_init(crc_t10dif_mod_init);
+module_exit(crc_t10dif_mod_exit);
+
+MODULE_DESCRIPTION("CRC-T10DIF using RISC-V Zbc");
+MODULE_LICENSE("GPL v2");
+MODULE_ALIAS_CRYPTO("crct10dif");
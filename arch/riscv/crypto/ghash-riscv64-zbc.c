@@ -0,0 +1,184 @@
+/*
+ * GHASH hash function using carry-less multiplication (Zbc/Zbkc)
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <crypto/ghash.h>
+#include <crypto/internal/hash.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <asm/clmul.h>
+#include <asm/hwcap.h>
+#include <asm/unaligned.h>
+
+struct ghash_riscv64_key {
+	u64 hi;
+	u64 lo;
+};
+
+struct ghash_riscv64_desc_ctx {
+	u64 hi;
+	u64 lo;
+	u8 buf[GHASH_BLOCK_SIZE];
+	u32 count;
+};
+
+/*
+ * X = X * H in GF(2^128).  Both are kept as big-endian 128-bit values, so
+ * GHASH's reflected bit order makes the product come out shifted right by
+ * one: shift it back, then reduce modulo x^128 + x^7 + x^2 + x + 1 in the
+ * reflected domain.
+ */
+static void ghash_riscv64_mul(struct ghash_riscv64_desc_ctx *ctx,
+			      const struct ghash_riscv64_key *key)
+{
+	u64 xh = ctx->hi, xl = ctx->lo;
+	u64 z0, z1, z2, z3, d, h0, h1;
+
+	z0 = clmul(xl, key->lo);
+	z1 = clmulh(xl, key->lo) ^ clmul(xl, key->hi) ^ clmul(xh, key->lo);
+	z2 = clmul(xh, key->hi) ^ clmulh(xl, key->hi) ^ clmulh(xh, key->lo);
+	z3 = clmulh(xh, key->hi);
+
+	z3 = (z3 << 1) | (z2 >> 63);
+	z2 = (z2 << 1) | (z1 >> 63);
+	z1 = (z1 << 1) | (z0 >> 63);
+	z0 <<= 1;
+
+	d = z1 ^ (z0 << 63) ^ (z0 << 62) ^ (z0 << 57);
+	h1 = d ^ (d >> 1) ^ (d >> 2) ^ (d >> 7);
+	h0 = z0 ^ ((z0 >> 1) | (d << 63)) ^ ((z0 >> 2) | (d << 62)) ^
+	     ((z0 >> 7) | (d << 57));
+
+	ctx->hi = z3 ^ h1;
+	ctx->lo = z2 ^ h0;
+}
+
+static void ghash_riscv64_blocks(struct ghash_riscv64_desc_ctx *ctx,
+				 const struct ghash_riscv64_key *key,
+				 const u8 *src, unsigned int blocks)
+{
+	while (blocks--) {
+		ctx->hi ^= get_unaligned_be64(src);
+		ctx->lo ^= get_unaligned_be64(src + 8);
+		ghash_riscv64_mul(ctx, key);
+		src += GHASH_BLOCK_SIZE;
+	}
+}
+
+static int ghash_riscv64_init(struct shash_desc *desc)
+{
+	struct ghash_riscv64_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	*ctx = (struct ghash_riscv64_desc_ctx){};
+	return 0;
+}
+
+static int ghash_riscv64_update(struct shash_desc *desc, const u8 *src,
+				unsigned int len)
+{
+	struct ghash_riscv64_desc_ctx *ctx = shash_desc_ctx(desc);
+	struct ghash_riscv64_key *key = crypto_shash_ctx(desc->tfm);
+	unsigned int partial = ctx->count % GHASH_BLOCK_SIZE;
+
+	ctx->count += len;
+
+	if (partial + len >= GHASH_BLOCK_SIZE) {
+		if (partial) {
+			int p = GHASH_BLOCK_SIZE - partial;
+
+			memcpy(ctx->buf + partial, src, p);
+			ghash_riscv64_blocks(ctx, key, ctx->buf, 1);
+			src += p;
+			len -= p;
+		}
+
+		ghash_riscv64_blocks(ctx, key, src, len / GHASH_BLOCK_SIZE);
+		src += round_down(len, GHASH_BLOCK_SIZE);
+		len %= GHASH_BLOCK_SIZE;
+		partial = 0;
+	}
+	if (len)
+		memcpy(ctx->buf + partial, src, len);
+	return 0;
+}
+
+static int ghash_riscv64_final(struct shash_desc *desc, u8 *dst)
+{
+	struct ghash_riscv64_desc_ctx *ctx = shash_desc_ctx(desc);
+	unsigned int partial = ctx->count % GHASH_BLOCK_SIZE;
+
+	if (partial) {
+		struct ghash_riscv64_key *key = crypto_shash_ctx(desc->tfm);
+
+		memset(ctx->buf + partial, 0, GHASH_BLOCK_SIZE - partial);
+		ghash_riscv64_blocks(ctx, key, ctx->buf, 1);
+	}
+	put_unaligned_be64(ctx->hi, dst);
+	put_unaligned_be64(ctx->lo, dst + 8);
+
+	*ctx = (struct ghash_riscv64_desc_ctx){};
+	return 0;
+}
+
+static int ghash_riscv64_setkey(struct crypto_shash *tfm, const u8 *inkey,
+				unsigned int keylen)
+{
+	struct ghash_riscv64_key *key = crypto_shash_ctx(tfm);
+
+	if (keylen != GHASH_BLOCK_SIZE) {
+		crypto_shash_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+
+	key->hi = get_unaligned_be64(inkey);
+	key->lo = get_unaligned_be64(inkey + 8);
+	return 0;
+}
+
+static struct shash_alg ghash_alg = {
+	.digestsize		= GHASH_DIGEST_SIZE,
+	.init			= ghash_riscv64_init,
+	.update			= ghash_riscv64_update,
+	.final			= ghash_riscv64_final,
+	.setkey			= ghash_riscv64_setkey,
+	.descsize		= sizeof(struct ghash_riscv64_desc_ctx),
+	.base.cra_name		= "ghash",
+	.base.cra_driver_name	= "ghash-riscv64-zbc",
+	.base.cra_priority	= 300,
+	.base.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
+	.base.cra_blocksize	= GHASH_BLOCK_SIZE,
+	.base.cra_ctxsize	= sizeof(struct ghash_riscv64_key),
+	.base.cra_module	= THIS_MODULE,
+};
+
+static int __init ghash_riscv64_mod_init(void)
+{
+	if (!riscv_isa_extension_available(RISCV_ISA_EXT_ZBC) &&
+	    !riscv_isa_extension_available(RISCV_ISA_EXT_ZBKC))
+		return -ENODEV;
+
+	return crypto_register_shash(&ghash_alg);
+}
+
+static void __exit ghash_riscv64_mod_exit(void)
+{
+	crypto_unregister_shash(&ghash_alg);
+}
+
+module_init(ghash_riscv64_mod_init);
+module_exit(ghash_riscv64_mod_exit);
+
+MODULE_DESCRIPTION("GHASH secure hash using RISC-V Zbc/Zbkc");
+MODULE_LICENSE("GPL v2");
+MODULE_ALIAS_CRYPTO("ghash");
@@ -0,0 +1,178 @@
+/*
+ * SHA-224/SHA-256 using the scalar crypto (Zknh) instructions
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <crypto/internal/hash.h>
+#include <crypto/sha.h>
+#include <crypto/sha256_base.h>
+#include <linux/bitops.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <asm/hwcap.h>
+#include <asm/insn-def.h>
+#include <asm/unaligned.h>
+
+/* The four sigma functions are single instructions with Zknh */
+#define SHA256_OP(name, imm12)						\
+static __always_inline u32 name(u32 x)					\
+{									\
+	unsigned long r;						\
+									\
+	__asm__ (INSN_I(OPCODE_OP_IMM, "1", imm12, "%0", "%1")		\
+		 : "=r" (r) : "r" ((unsigned long)x));			\
+	return r;							\
+}
+
+SHA256_OP(sha256sum0, "0x100")
+SHA256_OP(sha256sum1, "0x101")
+SHA256_OP(sha256sig0, "0x102")
+SHA256_OP(sha256sig1, "0x103")
+
+static const u32 sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void sha256_zknh_block(struct sha256_state *sst, u8 const *src,
+			      int blocks)
+{
+	u32 w[16];
+
+	while (blocks--) {
+		u32 a = sst->state[0], b = sst->state[1];
+		u32 c = sst->state[2], d = sst->state[3];
+		u32 e = sst->state[4], f = sst->state[5];
+		u32 g = sst->state[6], h = sst->state[7];
+		u32 t1, t2;
+		int i;
+
+		/* The message schedule is kept in a 16-word ring */
+		for (i = 0; i < 64; i++) {
+			if (i < 16)
+				w[i] = get_unaligned_be32(src + i * 4);
+			else
+				w[i & 15] += sha256sig1(w[(i - 2) & 15]) +
+					     w[(i - 7) & 15] +
+					     sha256sig0(w[(i - 15) & 15]);
+
+			t1 = h + sha256sum1(e) + (g ^ (e & (f ^ g))) +
+			     sha256_k[i] + w[i & 15];
+			t2 = sha256sum0(a) + ((a & b) | (c & (a | b)));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		sst->state[0] += a;
+		sst->state[1] += b;
+		sst->state[2] += c;
+		sst->state[3] += d;
+		sst->state[4] += e;
+		sst->state[5] += f;
+		sst->state[6] += g;
+		sst->state[7] += h;
+		src += SHA256_BLOCK_SIZE;
+	}
+
+	memzero_explicit(w, sizeof(w));
+}
+
+static int sha256_zknh_update(struct shash_desc *desc, const u8 *data,
+			      unsigned int len)
+{
+	return sha256_base_do_update(desc, data, len, sha256_zknh_block);
+}
+
+static int sha256_zknh_finup(struct shash_desc *desc, const u8 *data,
+			     unsigned int len, u8 *out)
+{
+	if (len)
+		sha256_base_do_update(desc, data, len, sha256_zknh_block);
+	sha256_base_do_finalize(desc, sha256_zknh_block);
+
+	return sha256_base_finish(desc, out);
+}
+
+static int sha256_zknh_final(struct shash_desc *desc, u8 *out)
+{
+	return sha256_zknh_finup(desc, NULL, 0, out);
+}
+
+static struct shash_alg algs[] = { {
+	.digestsize		= SHA256_DIGEST_SIZE,
+	.init			= sha256_base_init,
+	.update			= sha256_zknh_update,
+	.final			= sha256_zknh_final,
+	.finup			= sha256_zknh_finup,
+	.descsize		= sizeof(struct sha256_state),
+	.base.cra_name		= "sha256",
+	.base.cra_driver_name	= "sha256-riscv-zknh",
+	.base.cra_priority	= 300,
+	.base.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
+	.base.cra_blocksize	= SHA256_BLOCK_SIZE,
+	.base.cra_module	= THIS_MODULE,
+}, {
+	.digestsize		= SHA224_DIGEST_SIZE,
+	.init			= sha224_base_init,
+	.update			= sha256_zknh_update,
+	.final			= sha256_zknh_final,
+	.finup			= sha256_zknh_finup,
+	.descsize		= sizeof(struct sha256_state),
+	.base.cra_name		= "sha224",
+	.base.cra_driver_name	= "sha224-riscv-zknh",
+	.base.cra_priority	= 300,
+	.base.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
+	.base.cra_blocksize	= SHA224_BLOCK_SIZE,
+	.base.cra_module	= THIS_MODULE,
+} };
+
+static int __init sha256_zknh_mod_init(void)
+{
+	if (!riscv_isa_extension_available(RISCV_ISA_EXT_ZKNH))
+		return -ENODEV;
+
+	return crypto_register_shashes(algs, ARRAY_SIZE(algs));
+}
+
+static void __exit sha256_zknh_mod_fini(void)
+{
+	crypto_unregister_shashes(algs, ARRAY_SIZE(algs));
+}
+
+module_init(sha256_zknh_mod_init);
+module_exit(sha256_zknh_mod_fini);
+
+MODULE_DESCRIPTION("SHA-224/SHA-256 secure hash using RISC-V Zknh");
+MODULE_LICENSE("GPL v2");
+MODULE_ALIAS_CRYPTO("sha224");
+MODULE_ALIAS_CRYPTO("sha256");
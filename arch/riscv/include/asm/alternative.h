@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_ALTERNATIVE_H
+#define _ASM_RISCV_ALTERNATIVE_H
+
+#include <linux/stringify.h>
+#include <asm/asm.h>
+#include <asm/hwcap.h>
+
+#ifdef __ASSEMBLY__
+
+/*
+ * The assembler version of ALTERNATIVE() below.  Sequences of more than
+ * one instruction are separated with ';', and are quoted if they contain
+ * commas, so that they reach here as a single argument.
+ */
+.macro __ALTERNATIVE oldinsn, newinsn, ext
+	.option push
+	.option norelax
+	.option norvc
+886:	\oldinsn
+887:
+	.pushsection .alt_instructions, "a"
+	.balign RISCV_SZPTR
+	RISCV_PTR 886b, 888f
+	RISCV_PTR \ext, 887b - 886b
+	.popsection
+	.pushsection .altinstr_replacement, "ax"
+888:	\newinsn
+889:
+	.popsection
+	.org . - (887b - 886b) + (889b - 888b)
+	.org . - (889b - 888b) + (887b - 886b)
+	.option pop
+.endm
+
+#define ALTERNATIVE(oldinsn, newinsn, ext)				\
+	__ALTERNATIVE oldinsn, newinsn, ext
+
+#else /* !__ASSEMBLY__ */
+
+#include <linux/init.h>
+#include <linux/types.h>
+
+/* One entry in .alt_instructions, as emitted by ALTERNATIVE() */
+struct alt_entry {
+	void *old_ptr;		/* The instructions to patch */
+	void *alt_ptr;		/* What to replace them with */
+	unsigned long ext;	/* The RISCV_ISA_EXT_* the replacement needs */
+	unsigned long len;	/* Of both sequences, in bytes */
+};
+
+void __init apply_boot_alternatives(void);
+void apply_module_alternatives(void *start, size_t len);
+
+/*
+ * ALTERNATIVE(oldinsn, newinsn, ext) emits oldinsn, which is replaced by
+ * newinsn at boot, or when a module is loaded, if the harts have ISA
+ * extension ext.  Both must have the same length, which the .org
+ * directives check at build time, and are assembled without compression
+ * so the lengths don't depend on what the assembler picks.  newinsn is
+ * copied into place, so it must not contain PC-relative references to
+ * anything outside itself; oldinsn may.
+ */
+#define ALTERNATIVE(oldinsn, newinsn, ext)				\
+	".option push\n"						\
+	".option norelax\n"						\
+	".option norvc\n"						\
+	"886:\n"							\
+	oldinsn "\n"							\
+	"887:\n"							\
+	".pushsection .alt_instructions, \"a\"\n"			\
+	".balign " RISCV_SZPTR "\n"					\
+	RISCV_PTR " 886b, 888f\n"					\
+	RISCV_PTR " " __stringify(ext) ", 887b - 886b\n"		\
+	".popsection\n"							\
+	".pushsection .altinstr_replacement, \"ax\"\n"			\
+	"888:\n"							\
+	newinsn "\n"							\
+	"889:\n"							\
+	".popsection\n"							\
+	".org . - (887b - 886b) + (889b - 888b)\n"			\
+	".org . - (889b - 888b) + (887b - 886b)\n"			\
+	".option pop\n"
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* _ASM_RISCV_ALTERNATIVE_H */
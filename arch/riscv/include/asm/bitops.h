@@ -20,24 +20,185 @@
 
 #include <linux/compiler.h>
 #include <linux/irqflags.h>
+#include <asm/alternative.h>
 #include <asm/barrier.h>
 #include <asm/bitsperlong.h>
+#include <asm/insn-def.h>
 
 #ifndef smp_mb__before_clear_bit
 #define smp_mb__before_clear_bit()  smp_mb()
 #define smp_mb__after_clear_bit()   smp_mb()
 #endif /* smp_mb__before_clear_bit */
 
+#define __HAVE_ARCH___FFS
+#define __HAVE_ARCH___FLS
+#define __HAVE_ARCH_FFS
+#define __HAVE_ARCH_FLS
+
 #include <asm-generic/bitops/__ffs.h>
-#include <asm-generic/bitops/ffz.h>
-#include <asm-generic/bitops/fls.h>
 #include <asm-generic/bitops/__fls.h>
+#include <asm-generic/bitops/ffs.h>
+#include <asm-generic/bitops/fls.h>
+
+/*
+ * Each of these starts with a jump to the generic C version, which is
+ * patched to a nop on harts with Zbb so execution falls through to the
+ * single instruction instead.  The instructions are volatile so they
+ * can't be hoisted above the jump.  Constants are left to the compiler.
+ */
+#define ZBB_OR_GOTO(label)						\
+	asm_volatile_goto(ALTERNATIVE("j %l[" #label "]", "nop",	\
+				      RISCV_ISA_EXT_ZBB)		\
+			  : : : : label)
+
+static __always_inline unsigned long variable__ffs(unsigned long word)
+{
+	ZBB_OR_GOTO(legacy);
+	asm volatile (ZBB_CTZ("%0", "%1") : "=r" (word) : "r" (word));
+	return word;
+legacy:
+	return generic___ffs(word);
+}
+
+/**
+ * __ffs - find first set bit in a long word
+ * @word: The word to search
+ *
+ * Undefined if no set bit exists, so code should check against 0 first.
+ */
+#define __ffs(word)							\
+	(__builtin_constant_p(word) ?					\
+	 (unsigned long)__builtin_ctzl(word) : variable__ffs(word))
+
+static __always_inline unsigned long variable__fls(unsigned long word)
+{
+	ZBB_OR_GOTO(legacy);
+	asm volatile (ZBB_CLZ("%0", "%1") : "=r" (word) : "r" (word));
+	return BITS_PER_LONG - 1 - word;
+legacy:
+	return generic___fls(word);
+}
+
+/**
+ * __fls - find last set bit in a long word
+ * @word: the word to search
+ *
+ * Undefined if no set bit exists, so code should check against 0 first.
+ */
+#define __fls(word)							\
+	(__builtin_constant_p(word) ?					\
+	 (unsigned long)(BITS_PER_LONG - 1 - __builtin_clzl(word)) :	\
+	 variable__fls(word))
+
+#if __riscv_xlen == 64
+#define ZBB_CTZ32	ZBB_CTZW
+#define ZBB_CLZ32	ZBB_CLZW
+#define ZBB_CPOP32	ZBB_CPOPW
+#else
+#define ZBB_CTZ32	ZBB_CTZ
+#define ZBB_CLZ32	ZBB_CLZ
+#define ZBB_CPOP32	ZBB_CPOP
+#endif
+
+static __always_inline int variable_ffs(int x)
+{
+	unsigned long r;
+
+	if (!x)
+		return 0;
+
+	ZBB_OR_GOTO(legacy);
+	asm volatile (ZBB_CTZ32("%0", "%1") : "=r" (r) : "r" ((unsigned long)x));
+	return r + 1;
+legacy:
+	return generic_ffs(x);
+}
+
+/**
+ * ffs - find first set bit in a word
+ * @x: the word to search
+ *
+ * This is defined the same way as the libc and compiler builtin ffs
+ * routines: ffs(0) = 0, ffs(1) = 1, ffs(0x80000000) = 32.
+ */
+#define ffs(x) (__builtin_constant_p(x) ? __builtin_ffs(x) : variable_ffs(x))
+
+static __always_inline int variable_fls(unsigned int x)
+{
+	unsigned long r;
+
+	if (!x)
+		return 0;
+
+	ZBB_OR_GOTO(legacy);
+	asm volatile (ZBB_CLZ32("%0", "%1") : "=r" (r) : "r" ((unsigned long)x));
+	return 32 - r;
+legacy:
+	return generic_fls(x);
+}
+
+/**
+ * fls - find last set bit in a word
+ * @x: the word to search
+ *
+ * This is defined the same way as ffs:
+ * fls(0) = 0, fls(1) = 1, fls(0x80000000) = 32.
+ */
+#define fls(x)								\
+	(__builtin_constant_p(x) ?					\
+	 (int)((x) ? 32 - __builtin_clz(x) : 0) : variable_fls(x))
+
+#include <asm-generic/bitops/ffz.h>
 #include <asm-generic/bitops/fls64.h>
 #include <asm-generic/bitops/find.h>
 #include <asm-generic/bitops/sched.h>
-#include <asm-generic/bitops/ffs.h>
 
-#include <asm-generic/bitops/hweight.h>
+static __always_inline unsigned int __arch_hweight32(unsigned int w)
+{
+	unsigned long r;
+
+	ZBB_OR_GOTO(legacy);
+	asm volatile (ZBB_CPOP32("%0", "%1") : "=r" (r) : "r" ((unsigned long)w));
+	return r;
+legacy:
+	return __sw_hweight32(w);
+}
+
+static inline unsigned int __arch_hweight16(unsigned int w)
+{
+	return __arch_hweight32(w & 0xffff);
+}
+
+static inline unsigned int __arch_hweight8(unsigned int w)
+{
+	return __arch_hweight32(w & 0xff);
+}
+
+#if __riscv_xlen == 64
+static __always_inline unsigned long __arch_hweight64(__u64 w)
+{
+	unsigned long r;
+
+	ZBB_OR_GOTO(legacy);
+	asm volatile (ZBB_CPOP("%0", "%1") : "=r" (r) : "r" (w));
+	return r;
+legacy:
+	return __sw_hweight64(w);
+}
+#else
+static inline unsigned long __arch_hweight64(__u64 w)
+{
+	return __arch_hweight32((unsigned int)w) +
+	       __arch_hweight32((unsigned int)(w >> 32));
+}
+#endif
+
+#undef ZBB_CPOP32
+#undef ZBB_CLZ32
+#undef ZBB_CTZ32
+#undef ZBB_OR_GOTO
+
+#include <asm-generic/bitops/const_hweight.h>
 
 #if (BITS_PER_LONG == 64)
 #define __AMO(op)	"amo" #op ".d"
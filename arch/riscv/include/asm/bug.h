@@ -20,8 +20,14 @@
 
 #include <asm/asm.h>
 
+#define __BUG_INSN_32	_AC(0x00100073, UL) /* ebreak */
+#define __BUG_INSN_16	_AC(0x9002, UL) /* c.ebreak */
+
+/* The two low bits are all ones for anything that isn't a 16-bit RVC insn */
+#define GET_INSN_LENGTH(insn)	(((insn) & 0x3) == 0x3 ? 4 : 2)
+
 #ifdef CONFIG_GENERIC_BUG
-#define __BUG_INSN	_AC(0x00100073, UL) /* ebreak */
+#define __BUG_INSN	__BUG_INSN_32
 
 #ifndef __ASSEMBLY__
 typedef u32 bug_insn_t;
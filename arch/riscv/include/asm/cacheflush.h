@@ -15,6 +15,7 @@
 #define _ASM_RISCV_CACHEFLUSH_H
 
 #include <asm-generic/cacheflush.h>
+#include <uapi/asm/cachectl.h>
 
 #undef flush_icache_range
 #undef flush_icache_user_range
@@ -24,16 +25,26 @@ static inline void local_flush_icache_all(void)
 	asm volatile ("fence.i" ::: "memory");
 }
 
+struct mm_struct;
+
 #ifndef CONFIG_SMP
 
-#define flush_icache_range(start, end) local_flush_icache_all()
-#define flush_icache_user_range(vma, pg, addr, len) local_flush_icache_all()
+#define flush_icache_all() local_flush_icache_all()
+#define flush_icache_mm(mm, local) flush_icache_all()
 
 #else /* CONFIG_SMP */
 
-#define flush_icache_range(start, end) sbi_remote_fence_i(0)
-#define flush_icache_user_range(vma, pg, addr, len) sbi_remote_fence_i(0)
+void flush_icache_all(void);
+void flush_icache_mm(struct mm_struct *mm, bool local);
 
 #endif /* CONFIG_SMP */
 
+/*
+ * Kernel text is executed by every hart, so changes to it are fenced
+ * everywhere.  User text only needs it on the harts running its mm.
+ */
+#define flush_icache_range(start, end) flush_icache_all()
+#define flush_icache_user_range(vma, pg, addr, len) \
+	flush_icache_mm((vma)->vm_mm, false)
+
 #endif /* _ASM_RISCV_CACHEFLUSH_H */
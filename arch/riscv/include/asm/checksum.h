@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_CHECKSUM_H
+#define _ASM_RISCV_CHECKSUM_H
+
+#include <linux/in6.h>
+#include <linux/types.h>
+
+/* Sum a word at a time instead of the generic 16 bits */
+unsigned int do_csum(const unsigned char *buff, int len);
+#define do_csum do_csum
+
+static inline __sum16 csum_fold(__wsum csum)
+{
+	u32 sum = (__force u32)csum;
+
+	sum += (sum >> 16) | (sum << 16);
+	return ~(__force __sum16)(sum >> 16);
+}
+#define csum_fold csum_fold
+
+/* IP headers are 32-bit aligned and between 5 and 15 words long */
+static inline __sum16 ip_fast_csum(const void *iph, unsigned int ihl)
+{
+	const u32 *p = iph;
+	u64 sum = 0;
+
+	do {
+		sum += *p++;
+	} while (--ihl);
+
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	return csum_fold((__force __wsum)(u32)sum);
+}
+#define ip_fast_csum ip_fast_csum
+
+#define _HAVE_ARCH_IPV6_CSUM
+__sum16 csum_ipv6_magic(const struct in6_addr *saddr,
+			const struct in6_addr *daddr,
+			__u32 len, __u8 proto, __wsum csum);
+
+#include <asm-generic/checksum.h>
+
+#endif /* _ASM_RISCV_CHECKSUM_H */
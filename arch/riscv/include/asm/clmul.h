@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_CLMUL_H
+#define _ASM_RISCV_CLMUL_H
+
+#include <linux/types.h>
+#include <asm/insn-def.h>
+
+/*
+ * Carry-less multiplication from Zbc (clmul and clmulh are also in Zbkc).
+ * Only use these once riscv_isa_extension_available() has said so.
+ */
+#define __CLMUL_OP(name, func3)						\
+static __always_inline unsigned long name(unsigned long a,		\
+					  unsigned long b)		\
+{									\
+	unsigned long r;						\
+									\
+	__asm__ (INSN_R(OPCODE_OP, func3, "0x05", "%0", "%1", "%2")	\
+		 : "=r" (r) : "r" (a), "r" (b));			\
+	return r;							\
+}
+
+/* The low half of the product */
+__CLMUL_OP(clmul, "1")
+/* The high half */
+__CLMUL_OP(clmulh, "3")
+/* Bits [2 * XLEN - 2 : XLEN - 1], i.e. the bit-reversed clmul */
+__CLMUL_OP(clmulr, "2")
+
+#undef __CLMUL_OP
+
+#endif /* _ASM_RISCV_CLMUL_H */
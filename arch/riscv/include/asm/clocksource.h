@@ -11,9 +11,11 @@
  *   GNU General Public License for more details.
  */
 
-#ifndef IRQCHIP__IRQ_RISCV_INIT_H
-#define IRQCHIP__IRQ_RISCV_INIT_H
+#ifndef _ASM_RISCV_CLOCKSOURCE_H
+#define _ASM_RISCV_CLOCKSOURCE_H
 
-void riscv_intc_irq(unsigned int cause, struct pt_regs *regs);
+struct arch_clocksource_data {
+	bool vdso_direct;	/* Can the vDSO read this with rdtime? */
+};
 
-#endif
+#endif /* _ASM_RISCV_CLOCKSOURCE_H */
@@ -15,8 +15,11 @@
 #define _ASM_RISCV_CMPXCHG_H
 
 #include <linux/bug.h>
+#include <linux/mmdebug.h>
 
 #include <asm/barrier.h>
+#include <asm/hwcap.h>
+#include <asm/insn-def.h>
 
 #define __xchg(new, ptr, size, asm_or)				\
 ({								\
@@ -131,4 +134,63 @@
 	cmpxchg_local((ptr), (o), (n));		\
 })
 
+#ifdef CONFIG_64BIT
+/*
+ * A pair of LR/SC sequences can't be made atomic together, since a hart
+ * holds one reservation at a time, so the double-word compare-and-swap
+ * needs amocas.q from Zacas.  Its data operands are even/odd register
+ * pairs, low word first, which are pinned to t1:t2 and t3:t4 here.
+ */
+#define system_has_cmpxchg_double() \
+	riscv_isa_extension_available(RISCV_ISA_EXT_ZACAS)
+
+#define __CMPXCHG_DOUBLE(name, func7)					\
+static __always_inline int						\
+__cmpxchg_double##name(unsigned long old1, unsigned long old2,		\
+		       unsigned long new1, unsigned long new2,		\
+		       volatile void *ptr)				\
+{									\
+	register unsigned long t1 __asm__("t1") = old1;			\
+	register unsigned long t2 __asm__("t2") = old2;			\
+	register unsigned long t3 __asm__("t3") = new1;			\
+	register unsigned long t4 __asm__("t4") = new2;			\
+									\
+	__asm__ __volatile__ (						\
+		INSN_R("0x2f", "4", func7, "t1", "%4", "t3")		\
+		: "+r" (t1), "+r" (t2)					\
+		: "r" (t3), "r" (t4), "r" (ptr)				\
+		: "memory");						\
+									\
+	return !((t1 ^ old1) | (t2 ^ old2));				\
+}
+
+/* amocas.q is funct5 0b00101, then the aq and rl bits */
+__CMPXCHG_DOUBLE(, "0x17")
+__CMPXCHG_DOUBLE(_local, "0x14")
+
+#undef __CMPXCHG_DOUBLE
+
+#define __cmpxchg_double_check(ptr1, ptr2)				\
+({									\
+	BUILD_BUG_ON(sizeof(*(ptr1)) != 8);				\
+	VM_BUG_ON((unsigned long)((ptr1) + 1) != (unsigned long)(ptr2)); \
+})
+
+#define cmpxchg_double(ptr1, ptr2, o1, o2, n1, n2)			\
+({									\
+	__cmpxchg_double_check(ptr1, ptr2);				\
+	__cmpxchg_double((unsigned long)(o1), (unsigned long)(o2),	\
+			 (unsigned long)(n1), (unsigned long)(n2),	\
+			 (ptr1));					\
+})
+
+#define cmpxchg_double_local(ptr1, ptr2, o1, o2, n1, n2)		\
+({									\
+	__cmpxchg_double_check(ptr1, ptr2);				\
+	__cmpxchg_double_local((unsigned long)(o1), (unsigned long)(o2), \
+			       (unsigned long)(n1), (unsigned long)(n2), \
+			       (ptr1));					\
+})
+#endif /* CONFIG_64BIT */
+
 #endif /* _ASM_RISCV_CMPXCHG_H */
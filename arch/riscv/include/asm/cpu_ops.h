@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_CPU_OPS_H
+#define _ASM_RISCV_CPU_OPS_H
+
+#include <linux/init.h>
+#include <linux/sched.h>
+
+/*
+ * How secondary harts are started and stopped.  cpu_start() is run on
+ * the CPU doing the bring-up, cpu_stop() by the CPU going down.
+ *
+ * @name:		Printed once, to say which method is used.
+ * @cpu_start:		Get the hart behind cpu into the kernel, where it
+ *			waits in head.S for __cpu_up() to hand it a task.
+ * @cpu_stop:		Never return, until the hart is started again.
+ * @cpu_is_stopped:	Non-zero if the hart has got out of the kernel.
+ */
+struct cpu_operations {
+	const char *name;
+	int (*cpu_start)(unsigned int cpu);
+#ifdef CONFIG_HOTPLUG_CPU
+	void (*cpu_stop)(void);
+	int (*cpu_is_stopped)(unsigned int cpu);
+#endif
+};
+
+/*
+ * Per CPU, the stack and task the hart waiting in head.S is to run
+ * smp_callin() with, and the time it started waiting at.
+ */
+extern void *__cpu_up_stack_pointer[NR_CPUS];
+extern void *__cpu_up_task_pointer[NR_CPUS];
+extern unsigned long __cpu_up_ready_time[NR_CPUS];
+
+extern const struct cpu_operations *cpu_ops;
+
+/* Pick the SBI HSM extension if the firmware has it, spinning if not */
+void __init cpu_set_ops(void);
+
+#endif /* _ASM_RISCV_CPU_OPS_H */
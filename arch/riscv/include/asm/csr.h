@@ -15,12 +15,14 @@
 #define _ASM_RISCV_CSR_H
 
 #include <linux/const.h>
+#include <linux/stringify.h>
 
 /* Status register flags */
 #define SR_IE   _AC(0x00000002, UL) /* Interrupt Enable */
 #define SR_PIE  _AC(0x00000020, UL) /* Previous IE */
 #define SR_PS   _AC(0x00000100, UL) /* Previously Supervisor */
 #define SR_SUM  _AC(0x00040000, UL) /* Supervisor may access User Memory */
+#define SR_MXR  _AC(0x00080000, UL) /* Make eXecutable Readable */
 
 #define SR_FS           _AC(0x00006000, UL) /* Floating-point Status */
 #define SR_FS_OFF       _AC(0x00000000, UL)
@@ -28,6 +30,12 @@
 #define SR_FS_CLEAN     _AC(0x00004000, UL)
 #define SR_FS_DIRTY     _AC(0x00006000, UL)
 
+#define SR_VS           _AC(0x00000600, UL) /* Vector Status */
+#define SR_VS_OFF       _AC(0x00000000, UL)
+#define SR_VS_INITIAL   _AC(0x00000200, UL)
+#define SR_VS_CLEAN     _AC(0x00000400, UL)
+#define SR_VS_DIRTY     _AC(0x00000600, UL)
+
 #define SR_XS           _AC(0x00018000, UL) /* Extension Status */
 #define SR_XS_OFF       _AC(0x00000000, UL)
 #define SR_XS_INITIAL   _AC(0x00008000, UL)
@@ -35,42 +43,127 @@
 #define SR_XS_DIRTY     _AC(0x00018000, UL)
 
 #ifndef CONFIG_64BIT
-#define SR_SD   _AC(0x80000000, UL) /* FS/XS dirty */
+#define SR_SD   _AC(0x80000000, UL) /* FS/VS/XS dirty */
 #else
-#define SR_SD   _AC(0x8000000000000000, UL) /* FS/XS dirty */
+#define SR_SD   _AC(0x8000000000000000, UL) /* FS/VS/XS dirty */
 #endif
 
+/* Vector CSRs, by number as older assemblers don't know their names */
+#define CSR_VSTART	0x008
+#define CSR_VCSR	0x00f
+#define CSR_VL		0xc20
+#define CSR_VTYPE	0xc21
+#define CSR_VLENB	0xc22
+
 /* SPTBR flags */
 #if __riscv_xlen == 32
 #define SPTBR_PPN     _AC(0x003FFFFF, UL)
 #define SPTBR_MODE_32 _AC(0x80000000, UL)
 #define SPTBR_MODE    SPTBR_MODE_32
+#define SPTBR_ASID_SHIFT 22
+#define SPTBR_ASID_MASK  _AC(0x1FF, UL)
 #else
 #define SPTBR_PPN     _AC(0x00000FFFFFFFFFFF, UL)
 #define SPTBR_MODE_39 _AC(0x8000000000000000, UL)
+#define SPTBR_MODE_48 _AC(0x9000000000000000, UL)
 #define SPTBR_MODE    SPTBR_MODE_39
+#define SPTBR_MODE_SHIFT 60
+#define SPTBR_ASID_SHIFT 44
+#define SPTBR_ASID_MASK  _AC(0xFFFF, UL)
 #endif
 
 /* Interrupt Enable and Interrupt Pending flags */
 #define SIE_SSIE _AC(0x00000002, UL) /* Software Interrupt Enable */
 #define SIE_STIE _AC(0x00000020, UL) /* Timer Interrupt Enable */
 
+/* Interrupt numbers, as in scause and the sie/sip/hvip bits */
+#define IRQ_S_SOFT		1
+#define IRQ_VS_SOFT		2
+#define IRQ_S_TIMER		5
+#define IRQ_VS_TIMER		6
+#define IRQ_S_EXT		9
+#define IRQ_VS_EXT		10
+
+#define CAUSE_IRQ_FLAG		(_AC(1, UL) << (__riscv_xlen - 1))
+
 #define EXC_INST_MISALIGNED     0
 #define EXC_INST_ACCESS         1
+#define EXC_INST_ILLEGAL        2
 #define EXC_BREAKPOINT          3
 #define EXC_LOAD_ACCESS         5
 #define EXC_STORE_ACCESS        7
 #define EXC_SYSCALL             8
+#define EXC_HYPERVISOR_SYSCALL  9
+#define EXC_SUPERVISOR_SYSCALL  10
 #define EXC_INST_PAGE_FAULT     12
 #define EXC_LOAD_PAGE_FAULT     13
 #define EXC_STORE_PAGE_FAULT    15
+#define EXC_INST_GUEST_PAGE_FAULT	20
+#define EXC_LOAD_GUEST_PAGE_FAULT	21
+#define EXC_VIRTUAL_INST_FAULT		22
+#define EXC_STORE_GUEST_PAGE_FAULT	23
+
+/*
+ * Hypervisor extension CSRs, by number as older assemblers don't know
+ * their names.  From HS-mode the VS CSRs reach the guest's supervisor
+ * state, which the guest itself sees as the plain S CSRs.
+ */
+#define CSR_VSSTATUS	0x200
+#define CSR_VSIE	0x204
+#define CSR_VSTVEC	0x205
+#define CSR_VSSCRATCH	0x240
+#define CSR_VSEPC	0x241
+#define CSR_VSCAUSE	0x242
+#define CSR_VSTVAL	0x243
+#define CSR_VSIP	0x244
+#define CSR_VSATP	0x280
+
+#define CSR_HSTATUS	0x600
+#define CSR_HEDELEG	0x602
+#define CSR_HIDELEG	0x603
+#define CSR_HIE		0x604
+#define CSR_HTIMEDELTA	0x605
+#define CSR_HCOUNTEREN	0x606
+#define CSR_HGEIE	0x607
+#define CSR_HTIMEDELTAH	0x615
+#define CSR_HTVAL	0x643
+#define CSR_HIP		0x644
+#define CSR_HVIP	0x645
+#define CSR_HTINST	0x64a
+#define CSR_HGATP	0x680
+
+#define HSTATUS_VSBE	_AC(0x00000020, UL)
+#define HSTATUS_GVA	_AC(0x00000040, UL)
+#define HSTATUS_SPV	_AC(0x00000080, UL)
+#define HSTATUS_SPVP	_AC(0x00000100, UL)
+#define HSTATUS_HU	_AC(0x00000200, UL)
+#define HSTATUS_VTVM	_AC(0x00100000, UL)
+#define HSTATUS_VTW	_AC(0x00200000, UL)
+#define HSTATUS_VTSR	_AC(0x00400000, UL)
+#define HSTATUS_VSXL_SHIFT	32
+#define HSTATUS_VSXL_64	_AC(2, UL)
+
+/* hgatp: two more bits of guest physical address than satp's modes */
+#if __riscv_xlen == 32
+#define HGATP_PPN	_AC(0x003FFFFF, UL)
+#define HGATP_MODE_SV32X4	_AC(1, UL)
+#define HGATP_MODE_SHIFT	31
+#define HGATP_VMID_SHIFT	22
+#define HGATP_VMID_MASK	_AC(0x1FC00000, UL)
+#else
+#define HGATP_PPN	_AC(0x00000FFFFFFFFFFF, UL)
+#define HGATP_MODE_SV39X4	_AC(8, UL)
+#define HGATP_MODE_SHIFT	60
+#define HGATP_VMID_SHIFT	44
+#define HGATP_VMID_MASK	_AC(0x03FFF00000000000, UL)
+#endif
 
 #ifndef __ASSEMBLY__
 
 #define csr_swap(csr, val)					\
 ({								\
 	unsigned long __v = (unsigned long)(val);		\
-	__asm__ __volatile__ ("csrrw %0, " #csr ", %1"		\
+	__asm__ __volatile__ ("csrrw %0, " __stringify(csr) ", %1" \
 			      : "=r" (__v) : "rK" (__v)		\
 			      : "memory");			\
 	__v;							\
@@ -79,7 +172,7 @@
 #define csr_read(csr)						\
 ({								\
 	register unsigned long __v;				\
-	__asm__ __volatile__ ("csrr %0, " #csr			\
+	__asm__ __volatile__ ("csrr %0, " __stringify(csr)	\
 			      : "=r" (__v) :			\
 			      : "memory");			\
 	__v;							\
@@ -88,7 +181,7 @@
 #define csr_write(csr, val)					\
 ({								\
 	unsigned long __v = (unsigned long)(val);		\
-	__asm__ __volatile__ ("csrw " #csr ", %0"		\
+	__asm__ __volatile__ ("csrw " __stringify(csr) ", %0"	\
 			      : : "rK" (__v)			\
 			      : "memory");			\
 })
@@ -96,7 +189,7 @@
 #define csr_read_set(csr, val)					\
 ({								\
 	unsigned long __v = (unsigned long)(val);		\
-	__asm__ __volatile__ ("csrrs %0, " #csr ", %1"		\
+	__asm__ __volatile__ ("csrrs %0, " __stringify(csr) ", %1" \
 			      : "=r" (__v) : "rK" (__v)		\
 			      : "memory");			\
 	__v;							\
@@ -105,7 +198,7 @@
 #define csr_set(csr, val)					\
 ({								\
 	unsigned long __v = (unsigned long)(val);		\
-	__asm__ __volatile__ ("csrs " #csr ", %0"		\
+	__asm__ __volatile__ ("csrs " __stringify(csr) ", %0"	\
 			      : : "rK" (__v)			\
 			      : "memory");			\
 })
@@ -113,7 +206,7 @@
 #define csr_read_clear(csr, val)				\
 ({								\
 	unsigned long __v = (unsigned long)(val);		\
-	__asm__ __volatile__ ("csrrc %0, " #csr ", %1"		\
+	__asm__ __volatile__ ("csrrc %0, " __stringify(csr) ", %1" \
 			      : "=r" (__v) : "rK" (__v)		\
 			      : "memory");			\
 	__v;							\
@@ -122,7 +215,7 @@
 #define csr_clear(csr, val)					\
 ({								\
 	unsigned long __v = (unsigned long)(val);		\
-	__asm__ __volatile__ ("csrc " #csr ", %0"		\
+	__asm__ __volatile__ ("csrc " __stringify(csr) ", %0"	\
 			      : : "rK" (__v)			\
 			      : "memory");			\
 })
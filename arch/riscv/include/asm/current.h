@@ -26,11 +26,11 @@
 struct task_struct;
 
 /*
- * This only works because "struct thread_info" is at offset 0 from "struct
- * task_struct".  This constraint seems to be necessary on other architectures
- * as well, but __switch_to enforces it.  We can't check TASK_TI here because
- * <asm/asm-offsets.h> includes this, and I can't get the definition of "struct
- * task_struct" here due to some header ordering problems.
+ * tp holds current rather than a pointer into the stack, so the stack can
+ * live anywhere, including vmalloc space.  current_thread_info() also
+ * works off tp: THREAD_INFO_IN_TASK puts "struct thread_info" at offset 0
+ * of "struct task_struct", which __switch_to checks.  We can't check
+ * TASK_TI here because <asm/asm-offsets.h> includes this.
  */
 static __always_inline struct task_struct *get_current(void)
 {
@@ -40,6 +40,8 @@ static __always_inline struct task_struct *get_current(void)
 
 #define current get_current()
 
+register unsigned long current_stack_pointer __asm__("sp");
+
 #endif /* __ASSEMBLY__ */
 
 #endif /* __ASM_CURRENT_H */
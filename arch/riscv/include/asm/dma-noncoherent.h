@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_DMA_NONCOHERENT_H
+#define _ASM_RISCV_DMA_NONCOHERENT_H
+
+#include <linux/device.h>
+#include <linux/dma-direction.h>
+#include <linux/types.h>
+
+/*
+ * Cache maintenance on a physical range, for DMA masters that don't snoop
+ * the caches.  Zicbom provides these; an SoC with a pre-standard cache
+ * controller can register its own instead, before devices are probed.
+ */
+struct riscv_cache_ops {
+	void (*wback)(phys_addr_t paddr, size_t size);
+	void (*inv)(phys_addr_t paddr, size_t size);
+	void (*wback_inv)(phys_addr_t paddr, size_t size);
+};
+
+static inline bool dev_is_noncoherent(struct device *dev)
+{
+	return IS_ENABLED(CONFIG_RISCV_DMA_NONCOHERENT) && dev &&
+	       dev->archdata.dma_noncoherent;
+}
+
+#ifdef CONFIG_RISCV_DMA_NONCOHERENT
+void riscv_noncoherent_register_cache_ops(const struct riscv_cache_ops *ops);
+bool riscv_noncoherent_supported(void);
+
+void riscv_dma_sync_for_device(phys_addr_t paddr, size_t size,
+			       enum dma_data_direction dir);
+void riscv_dma_sync_for_cpu(phys_addr_t paddr, size_t size,
+			    enum dma_data_direction dir);
+void riscv_dma_prep_coherent(phys_addr_t paddr, size_t size);
+#else
+static inline bool riscv_noncoherent_supported(void)
+{
+	return false;
+}
+
+static inline void riscv_dma_sync_for_device(phys_addr_t paddr, size_t size,
+					     enum dma_data_direction dir) { }
+static inline void riscv_dma_sync_for_cpu(phys_addr_t paddr, size_t size,
+					  enum dma_data_direction dir) { }
+static inline void riscv_dma_prep_coherent(phys_addr_t paddr, size_t size) { }
+#endif
+
+#endif /* _ASM_RISCV_DMA_NONCOHERENT_H */
@@ -62,6 +62,10 @@
 #define ELF_HWCAP	(elf_hwcap)
 extern unsigned long elf_hwcap;
 
+/* The multi-letter extensions, in AT_HWCAP2 */
+#define ELF_HWCAP2	(elf_hwcap2)
+extern unsigned long elf_hwcap2;
+
 /*
  * This yields a string that ld.so will use to load implementation
  * specific libraries for optimization.  This is more specific in
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_FPU_H
+#define _ASM_RISCV_FPU_H
+
+#include <linux/preempt.h>
+#include <linux/types.h>
+
+#include <asm/hwcap.h>
+
+/* The kernel only manages the FP state of harts with the D extension */
+static inline bool has_fpu(void)
+{
+	return elf_hwcap & COMPAT_HWCAP_ISA_D;
+}
+
+/*
+ * The kernel may only use the FP registers between these two, which
+ * disable preemption and nest.  Softirqs may use them too, but never
+ * hardirqs.
+ */
+static inline bool may_use_fpu(void)
+{
+	return has_fpu() && !in_irq() && !in_nmi();
+}
+
+void kernel_fpu_begin(void);
+void kernel_fpu_end(void);
+
+#endif /* _ASM_RISCV_FPU_H */
@@ -21,7 +21,29 @@
 
 #include <uapi/asm/hwcap.h>
 
+/*
+ * Multi-letter ISA extensions, which don't fit in elf_hwcap, and the
+ * hypervisor extension, which means nothing to user programs.  These are
+ * plain numbers so that alternatives can name them from assembly.
+ */
+#define RISCV_ISA_EXT_ZBB	0
+#define RISCV_ISA_EXT_ZBC	1
+#define RISCV_ISA_EXT_ZBKB	2
+#define RISCV_ISA_EXT_ZBKC	3
+#define RISCV_ISA_EXT_ZKND	4
+#define RISCV_ISA_EXT_ZKNE	5
+#define RISCV_ISA_EXT_ZKNH	6
+#define RISCV_ISA_EXT_SVPBMT	7
+#define RISCV_ISA_EXT_ZICBOM	8
+#define RISCV_ISA_EXT_H		9
+#define RISCV_ISA_EXT_ZACAS	10
+#define RISCV_ISA_EXT_SVADU	11
+#define RISCV_ISA_EXT_ZICBOZ	12
+#define RISCV_ISA_EXT_MAX	13
+
 #ifndef __ASSEMBLY__
+#include <linux/types.h>
+
 /*
  * This yields a mask that user programs can use to figure out what
  * instruction set this cpu supports.
@@ -33,5 +55,11 @@ enum {
 };
 
 extern unsigned long elf_hwcap;
+extern unsigned long elf_hwcap2;
+
+/* Set at boot if misaligned loads and stores run at full speed */
+extern bool riscv_fast_misaligned_access;
+
+bool riscv_isa_extension_available(unsigned int ext);
 #endif
 #endif
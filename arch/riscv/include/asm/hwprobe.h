@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_HWPROBE_H
+#define _ASM_RISCV_HWPROBE_H
+
+#include <uapi/asm/hwprobe.h>
+
+#define RISCV_HWPROBE_MAX_KEY	3
+
+#ifndef __ASSEMBLY__
+#include <linux/bitmap.h>
+#include <linux/threads.h>
+#include <asm/hwcap.h>
+
+/* The ISA of one hart, as its riscv,isa property gives it */
+struct riscv_isainfo {
+	unsigned long hwcap;
+	DECLARE_BITMAP(isa, RISCV_ISA_EXT_MAX);
+};
+
+/* Indexed by CPU number, filled in by riscv_fill_hwcap() */
+extern struct riscv_isainfo hart_isa[NR_CPUS];
+#endif
+
+#endif /* _ASM_RISCV_HWPROBE_H */
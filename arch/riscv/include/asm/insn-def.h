@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_INSN_DEF_H
+#define _ASM_RISCV_INSN_DEF_H
+
+/*
+ * Emit instructions the assembler doesn't know yet from inline assembly,
+ * while still letting the compiler pick the registers: each register
+ * name it may substitute is defined as a symbol holding its number, e.g.
+ *
+ *	asm(INSN_R(OPCODE_OP, "1", "5", "%0", "%1", "%2")
+ *	    : "=r" (rd) : "r" (rs1), "r" (rs2));
+ *
+ * emits clmul.  The symbols are redefined by every use, which .equ
+ * allows, so each asm statement stands on its own.
+ */
+#define __ASM_GPR_NUMS							\
+"	.irp	num,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31\n" \
+"	.equ	.L__gpr_num_x\\num, \\num\n"				\
+"	.endr\n"							\
+"	.equ	.L__gpr_num_zero, 0\n"					\
+"	.equ	.L__gpr_num_ra, 1\n"					\
+"	.equ	.L__gpr_num_sp, 2\n"					\
+"	.equ	.L__gpr_num_gp, 3\n"					\
+"	.equ	.L__gpr_num_tp, 4\n"					\
+"	.equ	.L__gpr_num_t0, 5\n"					\
+"	.equ	.L__gpr_num_t1, 6\n"					\
+"	.equ	.L__gpr_num_t2, 7\n"					\
+"	.equ	.L__gpr_num_s0, 8\n"					\
+"	.equ	.L__gpr_num_fp, 8\n"					\
+"	.equ	.L__gpr_num_s1, 9\n"					\
+"	.irp	num,0,1,2,3,4,5,6,7\n"					\
+"	.equ	.L__gpr_num_a\\num, \\num + 10\n"			\
+"	.endr\n"							\
+"	.irp	num,2,3,4,5,6,7,8,9,10,11\n"				\
+"	.equ	.L__gpr_num_s\\num, \\num + 16\n"			\
+"	.endr\n"							\
+"	.irp	num,3,4,5,6\n"						\
+"	.equ	.L__gpr_num_t\\num, \\num + 25\n"			\
+"	.endr\n"
+
+#define OPCODE_OP_IMM		"0x13"
+#define OPCODE_OP_IMM_32	"0x1b"
+#define OPCODE_OP		"0x33"
+#define OPCODE_SYSTEM		"0x73"
+
+#define INSN_R(opcode, func3, func7, rd, rs1, rs2)			\
+	__ASM_GPR_NUMS							\
+	"	.4byte	(" opcode ") | ((" func3 ") << 12) | "		\
+	"((" func7 ") << 25) | (.L__gpr_num_" rd " << 7) | "		\
+	"(.L__gpr_num_" rs1 " << 15) | (.L__gpr_num_" rs2 " << 20)\n"
+
+#define INSN_I(opcode, func3, imm12, rd, rs1)				\
+	__ASM_GPR_NUMS							\
+	"	.4byte	(" opcode ") | ((" func3 ") << 12) | "		\
+	"((" imm12 ") << 20) | (.L__gpr_num_" rd " << 7) | "		\
+	"(.L__gpr_num_" rs1 " << 15)\n"
+
+/* Zbb bit-manipulation; the W forms are RV64 only */
+#define ZBB_CLZ(rd, rs1)	INSN_I(OPCODE_OP_IMM, "1", "0x600", rd, rs1)
+#define ZBB_CTZ(rd, rs1)	INSN_I(OPCODE_OP_IMM, "1", "0x601", rd, rs1)
+#define ZBB_CPOP(rd, rs1)	INSN_I(OPCODE_OP_IMM, "1", "0x602", rd, rs1)
+#define ZBB_CLZW(rd, rs1)	INSN_I(OPCODE_OP_IMM_32, "1", "0x600", rd, rs1)
+#define ZBB_CTZW(rd, rs1)	INSN_I(OPCODE_OP_IMM_32, "1", "0x601", rd, rs1)
+#define ZBB_CPOPW(rd, rs1)	INSN_I(OPCODE_OP_IMM_32, "1", "0x602", rd, rs1)
+#if __riscv_xlen == 64
+#define ZBB_REV8(rd, rs1)	INSN_I(OPCODE_OP_IMM, "5", "0x6b8", rd, rs1)
+#else
+#define ZBB_REV8(rd, rs1)	INSN_I(OPCODE_OP_IMM, "5", "0x698", rd, rs1)
+#endif
+
+/*
+ * Hypervisor extension fences, and loads through the guest's translation
+ * (with the privilege in hstatus.SPVP).  hlvx.hu reads execute-only
+ * pages too, for fetching the guest's instructions.
+ */
+#define HFENCE_VVMA(vaddr, asid)					\
+	INSN_R(OPCODE_SYSTEM, "0", "0x11", "zero", vaddr, asid)
+#define HFENCE_GVMA(gaddr, vmid)					\
+	INSN_R(OPCODE_SYSTEM, "0", "0x31", "zero", gaddr, vmid)
+#define HLV_W(rd, rs1)		INSN_R(OPCODE_SYSTEM, "4", "0x34", rd, rs1, "zero")
+#define HLV_D(rd, rs1)		INSN_R(OPCODE_SYSTEM, "4", "0x36", rd, rs1, "zero")
+#define HLVX_HU(rd, rs1)	INSN_R(OPCODE_SYSTEM, "4", "0x32", rd, rs1, "x3")
+
+/*
+ * A few vector instructions, with unmasked operation.  The vector
+ * registers are given as numbers, e.g. from an "i" operand; the scalar
+ * ones as names, as above.  All element widths are 8 bits.
+ */
+#define RVV_VSETVLI_E8M1(rd, rs1)					\
+	__ASM_GPR_NUMS							\
+	"	.4byte	0x0c007057 | (.L__gpr_num_" rd " << 7) | "	\
+	"(.L__gpr_num_" rs1 " << 15)\n"
+
+/* The same with 8-register groups, which v0, v8, v16 and v24 start */
+#define RVV_VSETVLI_E8M8(rd, rs1)					\
+	__ASM_GPR_NUMS							\
+	"	.4byte	0x0c307057 | (.L__gpr_num_" rd " << 7) | "	\
+	"(.L__gpr_num_" rs1 " << 15)\n"
+
+#define RVV_VLE8_V(vd, rs1)						\
+	__ASM_GPR_NUMS							\
+	"	.4byte	0x02000007 | ((" vd ") << 7) | "		\
+	"(.L__gpr_num_" rs1 " << 15)\n"
+
+#define RVV_VSE8_V(vs3, rs1)						\
+	__ASM_GPR_NUMS							\
+	"	.4byte	0x02000027 | ((" vs3 ") << 7) | "		\
+	"(.L__gpr_num_" rs1 " << 15)\n"
+
+#define __RVV_OP_VV(base, vd, vs2, vs1)					\
+	"	.4byte	" base " | ((" vd ") << 7) | ((" vs1 ") << 15) | "	\
+	"((" vs2 ") << 20)\n"
+
+#define __RVV_OP_VI(base, vd, vs2, imm5)				\
+	"	.4byte	" base " | ((" vd ") << 7) | "			\
+	"(((" imm5 ") & 0x1f) << 15) | ((" vs2 ") << 20)\n"
+
+#define __RVV_OP_VX(base, vd, vs2, rs1)					\
+	__ASM_GPR_NUMS							\
+	"	.4byte	" base " | ((" vd ") << 7) | "			\
+	"(.L__gpr_num_" rs1 " << 15) | ((" vs2 ") << 20)\n"
+
+#define RVV_VXOR_VV(vd, vs2, vs1)	__RVV_OP_VV("0x2e000057", vd, vs2, vs1)
+#define RVV_VRGATHER_VV(vd, vs2, vs1)	__RVV_OP_VV("0x32000057", vd, vs2, vs1)
+#define RVV_VMV_V_V(vd, vs1)		__RVV_OP_VV("0x5e000057", vd, "0", vs1)
+#define RVV_VMV_V_I(vd, imm5)		__RVV_OP_VI("0x5e003057", vd, "0", imm5)
+#define RVV_VSLL_VI(vd, vs2, imm5)	__RVV_OP_VI("0x96003057", vd, vs2, imm5)
+#define RVV_VSRL_VI(vd, vs2, imm5)	__RVV_OP_VI("0xa2003057", vd, vs2, imm5)
+#define RVV_VSRA_VI(vd, vs2, imm5)	__RVV_OP_VI("0xa6003057", vd, vs2, imm5)
+#define RVV_VAND_VX(vd, vs2, rs1)	__RVV_OP_VX("0x26004057", vd, vs2, rs1)
+
+#endif /* _ASM_RISCV_INSN_DEF_H */
@@ -22,14 +22,15 @@
 #ifdef CONFIG_MMU
 
 extern void __iomem *ioremap(phys_addr_t offset, unsigned long size);
+extern void __iomem *ioremap_wc(phys_addr_t offset, unsigned long size);
 
 /*
- * The RISC-V ISA doesn't yet specify how to query or modify PMAs, so we can't
- * change the properties of memory regions.  This should be fixed by the
- * upcoming platform spec.
+ * With Svpbmt, ioremap() maps strongly-ordered I/O and ioremap_wc() lets
+ * stores be merged; without it both get whatever the PMAs say.  There is
+ * no write-through type, so those mappings are simply uncached.
  */
 #define ioremap_nocache(addr, size) ioremap((addr), (size))
-#define ioremap_wc(addr, size) ioremap((addr), (size))
+#define ioremap_wc ioremap_wc
 #define ioremap_wt(addr, size) ioremap((addr), (size))
 
 extern void iounmap(void __iomem *addr);
@@ -164,9 +165,12 @@ static inline u64 __raw_readq(const volatile void __iomem *addr)
  * Normal memory access.  The memory barriers here are necessary as RISC-V
  * doesn't define any ordering between the memory space and the I/O space.
  */
+#define __iormb()	__asm__ __volatile__ ("fence i,r" : : : "memory")
+#define __iowmb()	__asm__ __volatile__ ("fence w,o" : : : "memory")
+
 #define __io_br()	do {} while (0)
-#define __io_ar()	__asm__ __volatile__ ("fence i,r" : : : "memory");
-#define __io_bw()	__asm__ __volatile__ ("fence w,o" : : : "memory");
+#define __io_ar()	__iormb()
+#define __io_bw()	__iowmb()
 #define __io_aw()	do {} while (0)
 
 #define readb(c)	({ u8  __v; __io_br(); __v = readb_cpu(c); __io_ar(); __v; })
@@ -213,8 +217,8 @@ static inline u64 __raw_readq(const volatile void __iomem *addr)
 #define outl(v,c)	({ __io_pbw(); writel_cpu((v),(void*)(PCI_IOBASE + (c))); __io_paw(); })
 
 #ifdef CONFIG_64BIT
-#define inq(c)		({ u64 __v; __io_pbr(); __v = readq_cpu((void*)(c)); __io_par(); __v; })
-#define outq(v,c)	({ __io_pbw(); writeq_cpu((v),(void*)(c)); __io_paw(); })
+#define inq(c)		({ u64 __v; __io_pbr(); __v = readq_cpu((void*)(PCI_IOBASE + (c))); __io_par(); __v; })
+#define outq(v,c)	({ __io_pbw(); writeq_cpu((v),(void*)(PCI_IOBASE + (c))); __io_paw(); })
 #endif
 
 /*
@@ -250,7 +254,7 @@ static inline u64 __raw_readq(const volatile void __iomem *addr)
 			const ctype *buf = buffer;				\
 										\
 			do {							\
-				__raw_writeq(*buf++, addr);			\
+				__raw_write ## len(*buf++, addr);		\
 			} while (--count);					\
 		}								\
 		afence;								\
@@ -294,10 +298,25 @@ __io_reads_ins(ins, u64, q, __io_pbr(), __io_par())
 __io_writes_outs(writes, u64, q, __io_bw(), __io_aw())
 #define writesq(addr, buffer, count) __writesq(addr, buffer, count)
 
-__io_writes_outs(outs, u64, q, __io_pbr(), __io_paw())
+__io_writes_outs(outs, u64, q, __io_pbw(), __io_paw())
 #define outsq(addr, buffer, count) __outsq((void __iomem *)addr, buffer, count)
 #endif
 
+/*
+ * Block copies to and from I/O memory: unlike memcpy() these only ever
+ * make naturally aligned accesses, a word at a time where they can, and
+ * like the _relaxed accessors they add no fences of their own.
+ */
+extern void __memcpy_fromio(void *to, const volatile void __iomem *from,
+			    size_t count);
+extern void __memcpy_toio(volatile void __iomem *to, const void *from,
+			  size_t count);
+extern void __memset_io(volatile void __iomem *dst, int c, size_t count);
+
+#define memcpy_fromio(a, c, l)	__memcpy_fromio((a), (c), (l))
+#define memcpy_toio(c, a, l)	__memcpy_toio((c), (a), (l))
+#define memset_io(c, v, l)	__memset_io((c), (v), (l))
+
 #include <asm-generic/io.h>
 
 #endif /* _ASM_RISCV_IO_H */
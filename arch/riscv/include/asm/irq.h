@@ -23,6 +23,15 @@
 
 void riscv_timer_interrupt(void);
 
+struct pt_regs;
+
+/*
+ * The root interrupt controller registers its handler here; entry.S calls
+ * it directly for every interrupt trap.
+ */
+extern void (*handle_arch_irq)(struct pt_regs *);
+void set_handle_irq(void (*handle_irq)(struct pt_regs *));
+
 #include <asm-generic/irq.h>
 
 #endif /* _ASM_RISCV_IRQ_H */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_KEXEC_H
+#define _ASM_RISCV_KEXEC_H
+
+#include <asm/page.h>
+
+/* Maximum physical address we can use pages from */
+#define KEXEC_SOURCE_MEMORY_LIMIT	(-1UL)
+
+/* Maximum address we can reach in physical address mode */
+#define KEXEC_DESTINATION_MEMORY_LIMIT	(-1UL)
+
+/* Maximum address we can use for the control code buffer */
+#define KEXEC_CONTROL_MEMORY_LIMIT	(-1UL)
+
+/* The relocation code, copied out of the way of the new image */
+#define KEXEC_CONTROL_PAGE_SIZE		PAGE_SIZE
+
+#define KEXEC_ARCH			KEXEC_ARCH_RISCV
+
+#ifndef __ASSEMBLY__
+
+#include <linux/string.h>
+#include <asm/ptrace.h>
+
+/*
+ * What a crash dump records for the CPU that panicked, when there is no
+ * trap frame to take it from: enough of the registers to unwind from.
+ */
+static inline void crash_setup_regs(struct pt_regs *newregs,
+				    struct pt_regs *oldregs)
+{
+	if (oldregs) {
+		memcpy(newregs, oldregs, sizeof(struct pt_regs));
+		return;
+	}
+
+	memset(newregs, 0, sizeof(struct pt_regs));
+	__asm__ __volatile__ (
+		"mv	%0, ra\n"
+		"mv	%1, sp\n"
+		"mv	%2, gp\n"
+		"mv	%3, tp\n"
+		"mv	%4, s0\n"
+		"auipc	%5, 0\n"
+		: "=r" (newregs->ra), "=r" (newregs->sp), "=r" (newregs->gp),
+		  "=r" (newregs->tp), "=r" (newregs->s0), "=r" (newregs->sepc));
+}
+
+/* Where in the new image the DTB is, found in machine_kexec_prepare() */
+struct kimage_arch {
+	unsigned long fdt_addr;
+};
+
+/*
+ * relocate_kernel.S, run from a copy in the control page with the MMU
+ * turned off on the way in.  Its arguments are the kimage list head,
+ * the physical entry point, the DTB, our hart ID and va_pa_offset.
+ */
+typedef void (*riscv_kexec_method)(unsigned long head,
+				   unsigned long entry,
+				   unsigned long fdt_addr,
+				   unsigned long hartid,
+				   unsigned long va_pa_offset);
+
+extern const unsigned char riscv_kexec_relocate[];
+extern const unsigned int riscv_kexec_relocate_size;
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* _ASM_RISCV_KEXEC_H */
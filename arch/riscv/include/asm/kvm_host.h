@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_KVM_HOST_H
+#define _ASM_RISCV_KVM_HOST_H
+
+#include <linux/hrtimer.h>
+#include <linux/kvm.h>
+#include <linux/kvm_types.h>
+#include <linux/types.h>
+
+#include <asm/csr.h>
+#include <asm/insn-def.h>
+#include <asm/page.h>
+#include <asm/sbi.h>
+
+#define KVM_MAX_VCPUS			NR_CPUS
+#define KVM_USER_MEM_SLOTS		512
+#define KVM_HALT_POLL_NS_DEFAULT	500000
+
+#define KVM_VCPU_MAX_FEATURES		0
+
+#define KVM_REQ_SLEEP \
+	KVM_ARCH_REQ_FLAGS(0, KVM_REQUEST_WAIT | KVM_REQUEST_NO_WAKEUP)
+#define KVM_REQ_VCPU_RESET		KVM_ARCH_REQ(1)
+#define KVM_REQ_UPDATE_HGATP		KVM_ARCH_REQ(2)
+/* Remote fences: the sender waits until the targets are out of the guest */
+#define KVM_REQ_FENCE_I \
+	KVM_ARCH_REQ_FLAGS(3, KVM_REQUEST_WAIT | KVM_REQUEST_NO_WAKEUP)
+#define KVM_REQ_HFENCE_VVMA_ALL \
+	KVM_ARCH_REQ_FLAGS(4, KVM_REQUEST_WAIT | KVM_REQUEST_NO_WAKEUP)
+#define KVM_REQ_STEAL_UPDATE		KVM_ARCH_REQ(5)
+
+struct kvm_vm_stat {
+	ulong remote_tlb_flush;
+};
+
+struct kvm_vcpu_stat {
+	u64 halt_successful_poll;
+	u64 halt_attempted_poll;
+	u64 halt_poll_invalid;
+	u64 halt_wakeup;
+	u64 ecall_exit_stat;
+	u64 wfi_exit_stat;
+	u64 mmio_exit_user;
+	u64 mmio_exit_kernel;
+	u64 exits;
+};
+
+struct kvm_arch_memory_slot {
+};
+
+/*
+ * The VMID tags the guest's translations in the TLBs.  Like the ASIDs
+ * of host processes, they are handed out in generations: see vmid.c.
+ */
+struct kvm_vmid {
+	unsigned long vmid_version;
+	unsigned long vmid;
+};
+
+/* The guest's time is the host's plus this many timebase ticks */
+struct kvm_guest_timer {
+	u64 time_delta;
+};
+
+struct kvm_arch {
+	struct kvm_vmid vmid;
+
+	/* The stage 2 (guest physical to host physical) root table */
+	pgd_t *pgd;
+	phys_addr_t pgd_phys;
+
+	/* The vcpu each host CPU last ran, as so many share the VMID */
+	int __percpu *last_vcpu_ran;
+
+	struct kvm_guest_timer timer;
+};
+
+/* Enough for a page table page at each level below the root */
+#define KVM_NR_MEM_OBJS		2
+
+/*
+ * Stage 2 faults are taken with the mmu_lock held and must not sleep,
+ * so the tables they need are allocated beforehand.
+ */
+struct kvm_mmu_memory_cache {
+	int nobjs;
+	void *objects[KVM_NR_MEM_OBJS];
+};
+
+/* What vcpu_exit.c needs to know to complete an MMIO load */
+struct kvm_mmio_decode {
+	unsigned long insn;
+	int insn_len;
+	int rd;
+	int len;
+	int shift;
+	int return_handled;
+};
+
+/* An SBI call forwarded to userspace, completed on the next KVM_RUN */
+struct kvm_sbi_context {
+	int return_handled;
+};
+
+/*
+ * The registers the world switch saves and restores: the GPRs in their
+ * architectural order (with zero unused), then the CSRs that are live in
+ * HS-mode but belong to whoever runs.  The guest's sstatus is the HS one
+ * used while it runs, of which only the FS field changes.
+ */
+struct kvm_cpu_context {
+	unsigned long zero;
+	unsigned long ra;
+	unsigned long sp;
+	unsigned long gp;
+	unsigned long tp;
+	unsigned long t0;
+	unsigned long t1;
+	unsigned long t2;
+	unsigned long s0;
+	unsigned long s1;
+	unsigned long a0;
+	unsigned long a1;
+	unsigned long a2;
+	unsigned long a3;
+	unsigned long a4;
+	unsigned long a5;
+	unsigned long a6;
+	unsigned long a7;
+	unsigned long s2;
+	unsigned long s3;
+	unsigned long s4;
+	unsigned long s5;
+	unsigned long s6;
+	unsigned long s7;
+	unsigned long s8;
+	unsigned long s9;
+	unsigned long s10;
+	unsigned long s11;
+	unsigned long t3;
+	unsigned long t4;
+	unsigned long t5;
+	unsigned long t6;
+	unsigned long sepc;
+	unsigned long sstatus;
+	unsigned long hstatus;
+	union __riscv_fp_state fp;
+};
+
+/* The guest's VS CSRs, only switched on vcpu_load()/vcpu_put() */
+struct kvm_vcpu_csr {
+	unsigned long vsstatus;
+	unsigned long vsie;
+	unsigned long vstvec;
+	unsigned long vsscratch;
+	unsigned long vsepc;
+	unsigned long vscause;
+	unsigned long vstval;
+	unsigned long hvip;
+	unsigned long vsatp;
+};
+
+/* The trap that made the guest exit, read before interrupts are enabled */
+struct kvm_cpu_trap {
+	unsigned long sepc;
+	unsigned long scause;
+	unsigned long stval;
+	unsigned long htval;
+	unsigned long htinst;
+};
+
+/* The SBI timer of a vcpu, backed by an hrtimer */
+struct kvm_vcpu_timer {
+	bool init_done;
+	bool next_set;
+	u64 next_cycles;
+	struct hrtimer hrt;
+	/* Converts timebase ticks to nanoseconds */
+	u32 mult;
+	u32 shift;
+};
+
+struct kvm_vcpu_arch {
+	/* Whether the vcpu has entered the guest since it was reset */
+	bool ran_atleast_once;
+
+	/* The host CPU the vcpu last ran on, to catch migrations */
+	int last_exit_cpu;
+
+	/* The single-letter ISA extensions the guest sees */
+	unsigned long isa;
+
+	struct kvm_cpu_context host_context;
+	unsigned long host_sscratch;
+	unsigned long host_stvec;
+
+	struct kvm_cpu_context guest_context;
+	struct kvm_vcpu_csr guest_csr;
+
+	/* What the two above are set back to on reset */
+	struct kvm_cpu_context guest_reset_context;
+	struct kvm_vcpu_csr guest_reset_csr;
+
+	/*
+	 * The VS interrupts raised (by the timer, other vcpus or
+	 * userspace) since the vcpu last entered the guest, and which of
+	 * their bits changed.  They reach hvip on the next entry.
+	 */
+	unsigned long irqs_pending;
+	unsigned long irqs_pending_mask;
+
+	struct kvm_vcpu_timer timer;
+
+	struct kvm_mmu_memory_cache mmu_page_cache;
+
+	struct kvm_mmio_decode mmio_decode;
+	struct kvm_sbi_context sbi_context;
+
+	/*
+	 * The steal-time area the guest registered with SBI_EXT_STA, our
+	 * copy of it, and the run_delay of the vcpu thread last added in.
+	 */
+	struct {
+		bool enabled;
+		struct gfn_to_hva_cache cache;
+		struct sbi_sta_struct shadow;
+		u64 last_steal;
+	} sta;
+
+	/* Stopped through SBI HSM or KVM_SET_MP_STATE */
+	bool power_off;
+};
+
+static inline void kvm_arch_hardware_unsetup(void) {}
+static inline void kvm_arch_sync_events(struct kvm *kvm) {}
+static inline void kvm_arch_vcpu_uninit(struct kvm_vcpu *vcpu) {}
+static inline void kvm_arch_sched_in(struct kvm_vcpu *vcpu, int cpu) {}
+static inline void kvm_arch_vcpu_block_finish(struct kvm_vcpu *vcpu) {}
+static inline void kvm_arch_free_memslot(struct kvm *kvm,
+		struct kvm_memory_slot *free, struct kvm_memory_slot *dont) {}
+static inline void kvm_arch_memslots_updated(struct kvm *kvm,
+					     struct kvm_memslots *slots) {}
+static inline void kvm_arch_vcpu_blocking(struct kvm_vcpu *vcpu) {}
+static inline void kvm_arch_vcpu_unblocking(struct kvm_vcpu *vcpu) {}
+
+#define KVM_ARCH_WANT_MMU_NOTIFIER
+int kvm_unmap_hva(struct kvm *kvm, unsigned long hva);
+int kvm_unmap_hva_range(struct kvm *kvm,
+			unsigned long start, unsigned long end);
+void kvm_set_spte_hva(struct kvm *kvm, unsigned long hva, pte_t pte);
+int kvm_age_hva(struct kvm *kvm, unsigned long start, unsigned long end);
+int kvm_test_age_hva(struct kvm *kvm, unsigned long hva);
+
+/*
+ * Flushes of guest translations, on the local hart only.  The G-stage
+ * ones take the guest physical address shifted right by two; the
+ * VS-stage one applies to the VMID currently in hgatp.
+ */
+static inline void __kvm_riscv_hfence_gvma_vmid_gpa(unsigned long gpa_divby_4,
+						    unsigned long vmid)
+{
+	__asm__ __volatile__ (HFENCE_GVMA("%0", "%1")
+			      : : "r" (gpa_divby_4), "r" (vmid) : "memory");
+}
+
+static inline void __kvm_riscv_hfence_gvma_vmid(unsigned long vmid)
+{
+	__asm__ __volatile__ (HFENCE_GVMA("zero", "%0")
+			      : : "r" (vmid) : "memory");
+}
+
+static inline void __kvm_riscv_hfence_gvma_all(void)
+{
+	__asm__ __volatile__ (HFENCE_GVMA("zero", "zero") : : : "memory");
+}
+
+static inline void __kvm_riscv_hfence_vvma_all(void)
+{
+	__asm__ __volatile__ (HFENCE_VVMA("zero", "zero") : : : "memory");
+}
+
+int kvm_riscv_stage2_map(struct kvm_vcpu *vcpu,
+			 struct kvm_memory_slot *memslot,
+			 gpa_t gpa, unsigned long hva, bool is_write);
+int kvm_riscv_stage2_alloc_pgd(struct kvm *kvm);
+void kvm_riscv_stage2_free_pgd(struct kvm *kvm);
+void kvm_riscv_stage2_update_hgatp(struct kvm_vcpu *vcpu);
+void kvm_riscv_stage2_cache_free(struct kvm_vcpu *vcpu);
+
+void kvm_riscv_stage2_vmid_detect(void);
+unsigned long kvm_riscv_stage2_vmid_bits(void);
+int kvm_riscv_stage2_vmid_init(struct kvm *kvm);
+bool kvm_riscv_stage2_vmid_ver_changed(struct kvm_vmid *vmid);
+void kvm_riscv_stage2_vmid_update(struct kvm_vcpu *vcpu);
+
+void __kvm_riscv_unpriv_trap(void);
+
+unsigned long kvm_riscv_vcpu_unpriv_read(struct kvm_vcpu *vcpu,
+					 bool read_insn,
+					 unsigned long guest_addr,
+					 struct kvm_cpu_trap *trap);
+void kvm_riscv_vcpu_trap_redirect(struct kvm_vcpu *vcpu,
+				  struct kvm_cpu_trap *trap);
+int kvm_riscv_vcpu_mmio_return(struct kvm_vcpu *vcpu, struct kvm_run *run);
+int kvm_riscv_vcpu_exit(struct kvm_vcpu *vcpu, struct kvm_run *run,
+			struct kvm_cpu_trap *trap);
+
+void __kvm_riscv_switch_to(struct kvm_vcpu_arch *vcpu_arch);
+void __kvm_riscv_fp_d_save(struct kvm_cpu_context *context);
+void __kvm_riscv_fp_d_restore(struct kvm_cpu_context *context);
+
+int kvm_riscv_vcpu_set_interrupt(struct kvm_vcpu *vcpu, unsigned int irq);
+int kvm_riscv_vcpu_unset_interrupt(struct kvm_vcpu *vcpu, unsigned int irq);
+void kvm_riscv_vcpu_flush_interrupts(struct kvm_vcpu *vcpu);
+void kvm_riscv_vcpu_sync_interrupts(struct kvm_vcpu *vcpu);
+bool kvm_riscv_vcpu_has_interrupts(struct kvm_vcpu *vcpu, unsigned long mask);
+void kvm_riscv_vcpu_power_off(struct kvm_vcpu *vcpu);
+void kvm_riscv_vcpu_power_on(struct kvm_vcpu *vcpu);
+
+int kvm_riscv_vcpu_sbi_return(struct kvm_vcpu *vcpu, struct kvm_run *run);
+int kvm_riscv_vcpu_sbi_ecall(struct kvm_vcpu *vcpu, struct kvm_run *run);
+void kvm_riscv_vcpu_record_steal_time(struct kvm_vcpu *vcpu);
+void kvm_riscv_vcpu_set_preempted(struct kvm_vcpu *vcpu);
+
+int kvm_riscv_vcpu_timer_init(struct kvm_vcpu *vcpu);
+int kvm_riscv_vcpu_timer_deinit(struct kvm_vcpu *vcpu);
+int kvm_riscv_vcpu_timer_reset(struct kvm_vcpu *vcpu);
+void kvm_riscv_vcpu_timer_restore(struct kvm_vcpu *vcpu);
+int kvm_riscv_vcpu_timer_next_event(struct kvm_vcpu *vcpu, u64 ncycles);
+int kvm_riscv_vcpu_get_reg_timer(struct kvm_vcpu *vcpu,
+				 const struct kvm_one_reg *reg);
+int kvm_riscv_vcpu_set_reg_timer(struct kvm_vcpu *vcpu,
+				 const struct kvm_one_reg *reg);
+
+#endif /* _ASM_RISCV_KVM_HOST_H */
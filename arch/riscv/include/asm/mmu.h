@@ -18,9 +18,24 @@
 #ifndef __ASSEMBLY__
 
 typedef struct {
+	atomic_long_t id;
 	void *vdso;
+#ifdef CONFIG_SMP
+	/* Harts that have to fence.i before they next run this mm */
+	cpumask_t icache_stale_mask;
+#endif
 } mm_context_t;
 
+/*
+ * The hardware ASID lives in the low bits of the context ID, see
+ * arch/riscv/mm/context.c.  This is only used by the TLB flush code, which
+ * cannot race with an ASID change and so doesn't need atomic_long_read.
+ */
+#define ASID(mm)	((mm)->context.id.counter & SPTBR_ASID_MASK)
+
+/* Set once the boot hart has found enough ASIDs to allocate per mm */
+extern bool riscv_use_asid;
+
 #endif /* __ASSEMBLY__ */
 
 #endif /* _ASM_RISCV_MMU_H */
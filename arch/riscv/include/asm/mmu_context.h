@@ -18,6 +18,8 @@
 
 #include <linux/mm.h>
 #include <linux/sched.h>
+#include <linux/sched/task_stack.h>
+#include <asm/cacheflush.h>
 #include <asm/tlbflush.h>
 
 static inline void enter_lazy_tlb(struct mm_struct *mm,
@@ -29,9 +31,14 @@ static inline void enter_lazy_tlb(struct mm_struct *mm,
 static inline int init_new_context(struct task_struct *task,
 	struct mm_struct *mm)
 {
+	atomic_long_set(&mm->context.id, 0);
 	return 0;
 }
 
+/*
+ * ASIDs are reclaimed lazily on generation rollover, so there is nothing
+ * to release here.
+ */
 static inline void destroy_context(struct mm_struct *mm)
 {
 }
@@ -41,18 +48,78 @@ static inline pgd_t *current_pgdir(void)
 	return pfn_to_virt(csr_read(sptbr) & SPTBR_PPN);
 }
 
-static inline void set_pgdir(pgd_t *pgd)
+static inline void set_pgdir(pgd_t *pgd, unsigned long asid)
+{
+	csr_write(sptbr, virt_to_pfn(pgd) | (asid << SPTBR_ASID_SHIFT) |
+		  sptbr_mode);
+}
+
+void check_and_switch_context(struct mm_struct *mm, unsigned int cpu);
+
+/*
+ * Run the fence.i that flush_icache_mm() left to us, after any other
+ * hart's writes to the code it is for are visible here.
+ */
+static inline void flush_icache_deferred(struct mm_struct *mm,
+					 unsigned int cpu)
+{
+#ifdef CONFIG_SMP
+	cpumask_t *mask = &mm->context.icache_stale_mask;
+
+	if (cpumask_test_cpu(cpu, mask)) {
+		cpumask_clear_cpu(cpu, mask);
+		/* Pairs with the barrier in flush_icache_mm() */
+		smp_mb();
+		local_flush_icache_all();
+	}
+#endif
+}
+
+/*
+ * Kernel page tables below the top level are shared, but each mm has its
+ * own copy of the top level, which only picks up new vmalloc entries when
+ * a fault syncs it.  A fault on the stack itself can't be handled (the
+ * trap frame goes on that stack), so make sure both the stack we're on
+ * and the one we're about to switch to are reachable from next.
+ */
+static inline void vmap_stack_sync(struct mm_struct *mm, unsigned long addr)
 {
-	csr_write(sptbr, virt_to_pfn(pgd) | SPTBR_MODE);
+#ifdef CONFIG_VMAP_STACK
+	pgd_t *pgd = pgd_offset(mm, addr);
+
+	/* pgd_none() is false for a folded level, so look at the raw entry */
+	if (unlikely(!pgd_val(*pgd)))
+		set_pgd(pgd, *pgd_offset_k(addr));
+#endif
 }
 
 static inline void switch_mm(struct mm_struct *prev,
 	struct mm_struct *next, struct task_struct *task)
 {
-	if (likely(prev != next)) {
-		set_pgdir(next->pgd);
-		local_flush_tlb_all();
-	}
+	unsigned int cpu;
+
+	if (unlikely(prev == next))
+		return;
+
+	vmap_stack_sync(next, current_stack_pointer);
+	if (task)
+		vmap_stack_sync(next, (unsigned long)task_stack_page(task));
+
+	/*
+	 * mm_cpumask() is what the TLB shootdown code uses to pick target
+	 * harts.  Without ASIDs the local TLB is flushed on every switch, so
+	 * this hart holds no translations for prev once it leaves.  With
+	 * ASIDs, prev's entries survive in the TLB and the bit must stay set
+	 * until the next flush reaches us.
+	 */
+	cpu = smp_processor_id();
+	if (!riscv_use_asid)
+		cpumask_clear_cpu(cpu, mm_cpumask(prev));
+	cpumask_set_cpu(cpu, mm_cpumask(next));
+
+	check_and_switch_context(next, cpu);
+
+	flush_icache_deferred(next, cpu);
 }
 
 static inline void activate_mm(struct mm_struct *prev,
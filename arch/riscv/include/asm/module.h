@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_MODULE_H
+#define _ASM_RISCV_MODULE_H
+
+#include <asm-generic/module.h>
+
+/*
+ * Modules are built -fPIC and are allocated anywhere in the vmalloc area,
+ * so the calls and GOT references in them may not reach their targets
+ * with a 32-bit PC-relative offset.  module_frob_arch_sections() sizes a
+ * GOT, and a PLT with its own GOT, for the worst case.
+ */
+struct mod_section {
+	Elf_Shdr *shdr;
+	int num_entries;
+	int max_entries;
+};
+
+struct mod_arch_specific {
+	struct mod_section got;
+	struct mod_section plt;
+	struct mod_section got_plt;
+};
+
+struct got_entry {
+	unsigned long symbol_addr;	/* The target's absolute address */
+};
+
+/* auipc t3, %pcrel_hi(got_plt); l[wd] t3, %pcrel_lo(got_plt)(t3); jr t3 */
+struct plt_entry {
+	u32 insn_auipc;
+	u32 insn_load;
+	u32 insn_jr;
+};
+
+unsigned long module_emit_got_entry(struct module *mod, unsigned long val);
+unsigned long module_emit_plt_entry(struct module *mod, unsigned long val);
+
+#endif /* _ASM_RISCV_MODULE_H */
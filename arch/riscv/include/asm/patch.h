@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_PATCH_H
+#define _ASM_RISCV_PATCH_H
+
+#include <linux/types.h>
+
+/*
+ * Write len bytes of instructions to kernel or module text at addr, which
+ * may be mapped read-only.  Instruction fetch is not synchronised: the
+ * caller has to fence.i on every hart that may run the new code.
+ */
+int patch_text_nosync(void *addr, const void *insns, size_t len);
+
+#endif /* _ASM_RISCV_PATCH_H */
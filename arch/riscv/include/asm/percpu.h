@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_PERCPU_H
+#define _ASM_RISCV_PERCPU_H
+
+#ifdef CONFIG_SMP
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+#include <asm/cmpxchg.h>
+#include <asm/current.h>
+
+/*
+ * The per-CPU offset of the hart a task is running on is cached in its
+ * thread_info, which tp always points to: finding this CPU's copy of a
+ * variable is a single load rather than a load of thread_info->cpu and an
+ * indexed load from __per_cpu_offset[].  switch_to() passes the value on
+ * to the incoming task, so it is only wrong while a task is migrating,
+ * i.e. with preemption enabled, when it can't be relied on anyway.
+ */
+#define __my_cpu_offset		(current_thread_info()->percpu_offset)
+#define set_my_cpu_offset(off)	(current_thread_info()->percpu_offset = (off))
+
+/*
+ * The read-modify-write ops are single AMOs, so they can't be torn by an
+ * interrupt and don't need to disable them.  Reading the offset and
+ * issuing the AMO are still two instructions: preemption is disabled
+ * around them so we can't update another hart's copy while it is using
+ * the non-atomic __this_cpu_*() ops on it.
+ */
+#define __PERCPU_AMO_OP(op, asm_op, sz, asm_type, c_type)		\
+static inline void __percpu_##op##_##sz(void *ptr, unsigned long val)	\
+{									\
+	__asm__ __volatile__ (						\
+		"amo" #asm_op "." #asm_type " zero, %1, %0"		\
+		: "+A" (*(c_type *)ptr)					\
+		: "r" ((c_type)val));					\
+}
+
+#define __PERCPU_AMO_RETURN_OP(op, asm_op, sz, asm_type, c_type)	\
+static inline unsigned long						\
+__percpu_##op##_return_##sz(void *ptr, unsigned long val)		\
+{									\
+	c_type ret;							\
+									\
+	__asm__ __volatile__ (						\
+		"amo" #asm_op "." #asm_type " %1, %2, %0"		\
+		: "+A" (*(c_type *)ptr), "=r" (ret)			\
+		: "r" ((c_type)val));					\
+	return (c_type)(ret + (c_type)val);				\
+}
+
+#ifdef CONFIG_64BIT
+#define __PERCPU_AMO_OPS(op, asm_op)					\
+	__PERCPU_AMO_OP(op, asm_op, 4, w, u32)				\
+	__PERCPU_AMO_OP(op, asm_op, 8, d, u64)
+#else
+#define __PERCPU_AMO_OPS(op, asm_op)					\
+	__PERCPU_AMO_OP(op, asm_op, 4, w, u32)
+#endif
+
+__PERCPU_AMO_OPS(add, add)
+__PERCPU_AMO_OPS(and, and)
+__PERCPU_AMO_OPS(or, or)
+
+__PERCPU_AMO_RETURN_OP(add, add, 4, w, u32)
+#ifdef CONFIG_64BIT
+__PERCPU_AMO_RETURN_OP(add, add, 8, d, u64)
+#endif
+
+#undef __PERCPU_AMO_OPS
+#undef __PERCPU_AMO_RETURN_OP
+#undef __PERCPU_AMO_OP
+
+/* Like the AMOs above, neither needs to be ordered against other harts */
+#define __percpu_xchg(ptr, val)		__xchg((val), (ptr), sizeof(*(ptr)), )
+#define __percpu_cmpxchg(ptr, o, n)	cmpxchg_local((ptr), (o), (n))
+
+#define _pcp_protect(op, pcp, ...)					\
+({									\
+	preempt_disable_notrace();					\
+	op(raw_cpu_ptr(&(pcp)), __VA_ARGS__);				\
+	preempt_enable_notrace();					\
+})
+
+#define _pcp_protect_return(op, pcp, args...)				\
+({									\
+	typeof(pcp) __retval;						\
+	preempt_disable_notrace();					\
+	__retval = (typeof(pcp))op(raw_cpu_ptr(&(pcp)), ##args);	\
+	preempt_enable_notrace();					\
+	__retval;							\
+})
+
+#define this_cpu_add_4(pcp, val)	\
+	_pcp_protect(__percpu_add_4, pcp, (unsigned long)(val))
+#define this_cpu_and_4(pcp, val)	\
+	_pcp_protect(__percpu_and_4, pcp, (unsigned long)(val))
+#define this_cpu_or_4(pcp, val)		\
+	_pcp_protect(__percpu_or_4, pcp, (unsigned long)(val))
+#define this_cpu_add_return_4(pcp, val)	\
+	_pcp_protect_return(__percpu_add_return_4, pcp, (unsigned long)(val))
+#define this_cpu_xchg_4(pcp, val)	\
+	_pcp_protect_return(__percpu_xchg, pcp, val)
+#define this_cpu_cmpxchg_4(pcp, o, n)	\
+	_pcp_protect_return(__percpu_cmpxchg, pcp, o, n)
+
+#ifdef CONFIG_64BIT
+#define this_cpu_add_8(pcp, val)	\
+	_pcp_protect(__percpu_add_8, pcp, (unsigned long)(val))
+#define this_cpu_and_8(pcp, val)	\
+	_pcp_protect(__percpu_and_8, pcp, (unsigned long)(val))
+#define this_cpu_or_8(pcp, val)		\
+	_pcp_protect(__percpu_or_8, pcp, (unsigned long)(val))
+#define this_cpu_add_return_8(pcp, val)	\
+	_pcp_protect_return(__percpu_add_return_8, pcp, (unsigned long)(val))
+#define this_cpu_xchg_8(pcp, val)	\
+	_pcp_protect_return(__percpu_xchg, pcp, val)
+#define this_cpu_cmpxchg_8(pcp, o, n)	\
+	_pcp_protect_return(__percpu_cmpxchg, pcp, o, n)
+
+/*
+ * The SLUB fast path uses this whether or not system_has_cmpxchg_double()
+ * holds, so harts without Zacas take the generic interrupts-off version.
+ */
+#define this_cpu_cmpxchg_double_8(pcp1, pcp2, o1, o2, n1, n2)		\
+({									\
+	int __ret;							\
+									\
+	if (system_has_cmpxchg_double()) {				\
+		preempt_disable_notrace();				\
+		__ret = cmpxchg_double_local(raw_cpu_ptr(&(pcp1)),	\
+					     raw_cpu_ptr(&(pcp2)),	\
+					     o1, o2, n1, n2);		\
+		preempt_enable_notrace();				\
+	} else {							\
+		__ret = this_cpu_generic_cmpxchg_double(pcp1, pcp2,	\
+							o1, o2, n1, n2); \
+	}								\
+	__ret;								\
+})
+#endif
+
+#endif /* CONFIG_SMP */
+
+#include <asm-generic/percpu.h>
+
+#endif /* _ASM_RISCV_PERCPU_H */
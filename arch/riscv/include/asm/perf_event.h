@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_PERF_EVENT_H
+#define _ASM_RISCV_PERF_EVENT_H
+
+/*
+ * The user-visible counters: cycle, time, instret and hpmcounter3-31.  The
+ * counter number doubles as the raw event code.
+ */
+#define RISCV_MAX_COUNTERS	32
+
+#define RISCV_PMU_CYCLE		0
+#define RISCV_PMU_TIME		1
+#define RISCV_PMU_INSTRET	2
+#define RISCV_PMU_HPMCOUNTER3	3
+
+#endif /* _ASM_RISCV_PERF_EVENT_H */
@@ -16,8 +16,23 @@
 #define _ASM_RISCV_PGALLOC_H
 
 #include <linux/mm.h>
+#include <linux/quicklist.h>
 #include <asm/tlb.h>
 
+/*
+ * Page-table pages are kept on per-CPU quicklists when freed, which the
+ * core mm only does once every entry in them has been cleared, so they
+ * come back zeroed without touching the allocator or clearing a page.
+ * A PGD keeps the kernel half it was built with, copied from init_mm
+ * only when a page is first taken for one: entries in init_mm's half are
+ * only ever added after boot, and a missing one is synced on the fault.
+ * The lists are trimmed back from the idle loop, in check_pgt_cache().
+ */
+#define QUICK_PGD	0	/* PGDs, with the kernel half filled in */
+#define QUICK_PT	1	/* Every other level, all zero */
+
+#define PGALLOC_GFP	(GFP_KERNEL | __GFP_RETRY_MAYFAIL)
+
 static inline void pmd_populate_kernel(struct mm_struct *mm,
 	pmd_t *pmd, pte_t *pte)
 {
@@ -41,84 +56,152 @@ static inline void pud_populate(struct mm_struct *mm, pud_t *pud, pmd_t *pmd)
 
 	set_pud(pud, __pud((pfn << _PAGE_PFN_SHIFT) | _PAGE_TABLE));
 }
+
+static inline void p4d_populate(struct mm_struct *mm, p4d_t *p4d, pud_t *pud)
+{
+	if (pgtable_l4_enabled) {
+		unsigned long pfn = virt_to_pfn(pud);
+
+		set_p4d(p4d, __p4d((pfn << _PAGE_PFN_SHIFT) | _PAGE_TABLE));
+	}
+}
 #endif /* __PAGETABLE_PMD_FOLDED */
 
 #define pmd_pgtable(pmd)	pmd_page(pmd)
 
-static inline pgd_t *pgd_alloc(struct mm_struct *mm)
+static inline void pgd_ctor(void *pgd)
 {
-	pgd_t *pgd;
+	/* Copy kernel mappings */
+	memcpy((pgd_t *)pgd + USER_PTRS_PER_PGD,
+		init_mm.pgd + USER_PTRS_PER_PGD,
+		(PTRS_PER_PGD - USER_PTRS_PER_PGD) * sizeof(pgd_t));
+}
 
-	pgd = (pgd_t *)__get_free_page(GFP_KERNEL);
-	if (likely(pgd != NULL)) {
-		memset(pgd, 0, USER_PTRS_PER_PGD * sizeof(pgd_t));
-		/* Copy kernel mappings */
-		memcpy(pgd + USER_PTRS_PER_PGD,
-			init_mm.pgd + USER_PTRS_PER_PGD,
-			(PTRS_PER_PGD - USER_PTRS_PER_PGD) * sizeof(pgd_t));
-	}
-	return pgd;
+static inline pgd_t *pgd_alloc(struct mm_struct *mm)
+{
+	return quicklist_alloc(QUICK_PGD, GFP_KERNEL, pgd_ctor);
 }
 
 static inline void pgd_free(struct mm_struct *mm, pgd_t *pgd)
 {
-	free_page((unsigned long)pgd);
+	quicklist_free(QUICK_PGD, NULL, pgd);
 }
 
 #ifndef __PAGETABLE_PMD_FOLDED
 
 static inline pmd_t *pmd_alloc_one(struct mm_struct *mm, unsigned long addr)
 {
-	return (pmd_t *)__get_free_page(
-		GFP_KERNEL | __GFP_RETRY_MAYFAIL | __GFP_ZERO);
+	return quicklist_alloc(QUICK_PT, PGALLOC_GFP, NULL);
 }
 
 static inline void pmd_free(struct mm_struct *mm, pmd_t *pmd)
 {
-	free_page((unsigned long)pmd);
+	quicklist_free(QUICK_PT, NULL, pmd);
 }
 
+#ifdef CONFIG_HAVE_RCU_TABLE_FREE
+#define __pmd_free_tlb(tlb, pmd, addr)	\
+	tlb_remove_table((tlb), virt_to_page(pmd))
+#else
 #define __pmd_free_tlb(tlb, pmd, addr)  pmd_free((tlb)->mm, pmd)
+#endif
+
+/*
+ * On Sv39 no PUD is ever allocated, as p4d_none() is false, but the core
+ * mm still hands the folded one, which is part of the PGD, back to us.
+ */
+static inline pud_t *pud_alloc_one(struct mm_struct *mm, unsigned long addr)
+{
+	if (pgtable_l4_enabled)
+		return quicklist_alloc(QUICK_PT, PGALLOC_GFP, NULL);
+	return NULL;
+}
+
+static inline void pud_free(struct mm_struct *mm, pud_t *pud)
+{
+	if (pgtable_l4_enabled)
+		quicklist_free(QUICK_PT, NULL, pud);
+}
+
+#ifdef CONFIG_HAVE_RCU_TABLE_FREE
+#define __pud_free_tlb(tlb, pud, addr)				\
+do {								\
+	if (pgtable_l4_enabled)					\
+		tlb_remove_table((tlb), virt_to_page(pud));	\
+} while (0)
+#else
+#define __pud_free_tlb(tlb, pud, addr)  pud_free((tlb)->mm, pud)
+#endif
 
 #endif /* __PAGETABLE_PMD_FOLDED */
 
 static inline pte_t *pte_alloc_one_kernel(struct mm_struct *mm,
 	unsigned long address)
 {
-	return (pte_t *)__get_free_page(
-		GFP_KERNEL | __GFP_RETRY_MAYFAIL | __GFP_ZERO);
+	return quicklist_alloc(QUICK_PT, PGALLOC_GFP, NULL);
 }
 
 static inline struct page *pte_alloc_one(struct mm_struct *mm,
 	unsigned long address)
 {
 	struct page *pte;
-
-	pte = alloc_page(GFP_KERNEL | __GFP_RETRY_MAYFAIL | __GFP_ZERO);
-	if (likely(pte != NULL))
-		pgtable_page_ctor(pte);
+	void *pg;
+
+	pg = quicklist_alloc(QUICK_PT, PGALLOC_GFP, NULL);
+	if (unlikely(pg == NULL))
+		return NULL;
+	pte = virt_to_page(pg);
+	if (!pgtable_page_ctor(pte)) {
+		quicklist_free(QUICK_PT, NULL, pg);
+		return NULL;
+	}
 	return pte;
 }
 
 static inline void pte_free_kernel(struct mm_struct *mm, pte_t *pte)
 {
-	free_page((unsigned long)pte);
+	quicklist_free(QUICK_PT, NULL, pte);
 }
 
 static inline void pte_free(struct mm_struct *mm, pgtable_t pte)
 {
 	pgtable_page_dtor(pte);
-	__free_page(pte);
+	quicklist_free_page(QUICK_PT, NULL, pte);
 }
 
+#ifdef CONFIG_HAVE_RCU_TABLE_FREE
+/*
+ * Remote sfence.vma goes through the SBI and does not wait for harts
+ * that have interrupts disabled, so that alone does not keep a lockless
+ * walker (the speculative fault path) off a table being freed.  Defer
+ * the free past a sched-RCU grace period instead.
+ */
+#define __pte_free_tlb(tlb, pte, buf)   \
+do {                                    \
+	pgtable_page_dtor(pte);         \
+	tlb_remove_table((tlb), pte);   \
+} while (0)
+
+static inline void __tlb_remove_table(void *table)
+{
+	quicklist_free_page(QUICK_PT, NULL, table);
+}
+#else
 #define __pte_free_tlb(tlb, pte, buf)   \
 do {                                    \
 	pgtable_page_dtor(pte);         \
 	tlb_remove_page((tlb), pte);    \
 } while (0)
+#endif
 
+/*
+ * Down to this CPU's share of 1/16 of its node's free pages, or 25 pages
+ * if that is more, handing back at most 16 on each pass.
+ */
 static inline void check_pgt_cache(void)
 {
+	quicklist_trim(QUICK_PGD, NULL, 25, 16);
+	quicklist_trim(QUICK_PT, NULL, 25, 16);
 }
 
 #endif /* _ASM_RISCV_PGALLOC_H */
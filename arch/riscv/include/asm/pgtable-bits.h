@@ -18,6 +18,11 @@
  * PTE format:
  * | XLEN-1  10 | 9             8 | 7 | 6 | 5 | 4 | 3 | 2 | 1 | 0
  *       PFN      reserved for SW   D   A   G   U   X   W   R   V
+ *
+ * On RV64 the PFN only goes up to bit 53, and with Svpbmt bits 62-61
+ * select a memory type that overrides the PMAs:
+ * | 63 | 62   61 | 60  54 | 53  10 | ...
+ *   N     PBMT    reserved   PFN
  */
 
 #define _PAGE_ACCESSED_OFFSET 6
@@ -35,12 +40,30 @@
 #define _PAGE_SPECIAL   _PAGE_SOFT
 #define _PAGE_TABLE     _PAGE_PRESENT
 
+/* A valid entry with any of R/W/X set is a leaf, at any level */
+#define _PAGE_LEAF      (_PAGE_READ | _PAGE_WRITE | _PAGE_EXEC)
+
 #define _PAGE_PFN_SHIFT 10
 
+#ifdef CONFIG_64BIT
+#define _PAGE_PFN_MASK  (((1UL << 44) - 1) << _PAGE_PFN_SHIFT)
+
+#define _PAGE_PBMT_NC   (1UL << 61) /* Non-cacheable, idempotent: for WC */
+#define _PAGE_PBMT_IO   (2UL << 61) /* Non-cacheable, strongly ordered */
+#define _PAGE_MTMASK    (3UL << 61)
+#else
+#define _PAGE_PFN_MASK  (~0UL << _PAGE_PFN_SHIFT)
+#define _PAGE_MTMASK    0
+#endif
+
+/* The PFN of a leaf or the next table, ignoring any memory type */
+#define __page_val_to_pfn(val)	(((val) & _PAGE_PFN_MASK) >> _PAGE_PFN_SHIFT)
+
 /* Set of bits to preserve across pte_modify() */
 #define _PAGE_CHG_MASK  (~(unsigned long)(_PAGE_PRESENT | _PAGE_READ |	\
 					  _PAGE_WRITE | _PAGE_EXEC |	\
-					  _PAGE_USER | _PAGE_GLOBAL))
+					  _PAGE_USER | _PAGE_GLOBAL |	\
+					  _PAGE_MTMASK))
 
 /* Advertise support for _PAGE_SPECIAL */
 #define __HAVE_ARCH_PTE_SPECIAL
@@ -16,14 +16,20 @@
 
 #include <linux/mmzone.h>
 
+#include <asm/hwcap.h>
 #include <asm/pgtable-bits.h>
 
 #ifndef __ASSEMBLY__
 
 #ifdef CONFIG_MMU
 
-/* Page Upper Directory not used in RISC-V */
+#ifdef CONFIG_64BIT
+/* Sv48 at most: no P4D, and the PUD is folded at run time on Sv39 */
+#include <asm-generic/pgtable-nop4d.h>
+#else
+/* Page Upper Directory not used in Sv32 */
 #include <asm-generic/pgtable-nopud.h>
+#endif
 #include <asm/page.h>
 #include <asm/tlbflush.h>
 #include <linux/mm_types.h>
@@ -34,6 +40,15 @@
 #include <asm/pgtable-32.h>
 #endif /* CONFIG_64BIT */
 
+/*
+ * Megapages: 2MiB leaves in the PMD on Sv39, 4MiB leaves in the PGD on
+ * Sv32.  Sv39 also has 1GiB gigapages in the PGD (PUD_SIZE).
+ */
+#define HPAGE_SHIFT		PMD_SHIFT
+#define HPAGE_SIZE		(_AC(1, UL) << HPAGE_SHIFT)
+#define HPAGE_MASK		(~(HPAGE_SIZE - 1))
+#define HUGETLB_PAGE_ORDER	(HPAGE_SHIFT - PAGE_SHIFT)
+
 /* Number of entries in the page global directory */
 #define PTRS_PER_PGD    (PAGE_SIZE / sizeof(pgd_t))
 /* Number of entries in the page table */
@@ -68,8 +83,12 @@
 
 #define PAGE_KERNEL		__pgprot(_PAGE_KERNEL)
 #define PAGE_KERNEL_EXEC	__pgprot(_PAGE_KERNEL | _PAGE_EXEC)
+#define PAGE_KERNEL_READ	__pgprot(_PAGE_KERNEL & ~_PAGE_WRITE)
+#define PAGE_KERNEL_READ_EXEC	__pgprot((_PAGE_KERNEL & ~_PAGE_WRITE) \
+					 | _PAGE_EXEC)
 
 extern pgd_t swapper_pg_dir[];
+extern unsigned long sptbr_mode;
 
 /* MAP_PRIVATE permissions: xwr (copy-on-write) */
 #define __P000	PAGE_NONE
@@ -141,18 +160,18 @@ static inline pgd_t *pgd_offset(const struct mm_struct *mm, unsigned long addr)
 
 static inline struct page *pmd_page(pmd_t pmd)
 {
-	return pfn_to_page(pmd_val(pmd) >> _PAGE_PFN_SHIFT);
+	return pfn_to_page(__page_val_to_pfn(pmd_val(pmd)));
 }
 
 static inline unsigned long pmd_page_vaddr(pmd_t pmd)
 {
-	return (unsigned long)pfn_to_virt(pmd_val(pmd) >> _PAGE_PFN_SHIFT);
+	return (unsigned long)pfn_to_virt(__page_val_to_pfn(pmd_val(pmd)));
 }
 
 /* Yields the page frame number (PFN) of a page table entry */
 static inline unsigned long pte_pfn(pte_t pte)
 {
-	return (pte_val(pte) >> _PAGE_PFN_SHIFT);
+	return __page_val_to_pfn(pte_val(pte));
 }
 
 #define pte_page(x)     pfn_to_page(pte_pfn(x))
@@ -219,8 +238,7 @@ static inline int pte_write(pte_t pte)
 
 static inline int pte_huge(pte_t pte)
 {
-	return pte_present(pte)
-		&& (pte_val(pte) & (_PAGE_READ | _PAGE_WRITE | _PAGE_EXEC));
+	return pte_present(pte) && (pte_val(pte) & _PAGE_LEAF);
 }
 
 /* static inline int pte_exec(pte_t pte) */
@@ -287,6 +305,33 @@ static inline pte_t pte_modify(pte_t pte, pgprot_t newprot)
 	return __pte((pte_val(pte) & _PAGE_CHG_MASK) | pgprot_val(newprot));
 }
 
+/*
+ * Without Svpbmt the PMAs alone decide whether memory is cached, and the
+ * PBMT bits are reserved: leave them clear and rely on the PMAs marking
+ * device regions as I/O.
+ */
+#ifdef CONFIG_64BIT
+#define _PAGE_NOCACHE	(riscv_isa_extension_available(RISCV_ISA_EXT_SVPBMT) ? \
+			 _PAGE_PBMT_NC : 0)
+#define _PAGE_IO	(riscv_isa_extension_available(RISCV_ISA_EXT_SVPBMT) ? \
+			 _PAGE_PBMT_IO : 0)
+#else
+#define _PAGE_NOCACHE	0
+#define _PAGE_IO	0
+#endif
+
+#define pgprot_noncached pgprot_noncached
+static inline pgprot_t pgprot_noncached(pgprot_t prot)
+{
+	return __pgprot((pgprot_val(prot) & ~_PAGE_MTMASK) | _PAGE_IO);
+}
+
+#define pgprot_writecombine pgprot_writecombine
+static inline pgprot_t pgprot_writecombine(pgprot_t prot)
+{
+	return __pgprot((pgprot_val(prot) & ~_PAGE_MTMASK) | _PAGE_NOCACHE);
+}
+
 #define pgd_ERROR(e) \
 	pr_err("%s:%d: bad pgd " PTE_FMT ".\n", __FILE__, __LINE__, pgd_val(e))
 
@@ -337,6 +382,11 @@ static inline int ptep_test_and_clear_young(struct vm_area_struct *vma,
 					    unsigned long address,
 					    pte_t *ptep)
 {
+	/*
+	 * Harts with Svadu set A (and D) with atomic updates of their own,
+	 * which the AMO can't lose; harts without it trap to handle_ad_fault()
+	 * and set it again the next time the page is touched.
+	 */
 	if (!pte_young(*ptep))
 		return 0;
 	return test_and_clear_bit(_PAGE_ACCESSED_OFFSET, &pte_val(*ptep));
@@ -371,6 +421,144 @@ static inline int ptep_clear_flush_young(struct vm_area_struct *vma,
 	return ptep_test_and_clear_young(vma, address, ptep);
 }
 
+/*
+ * A huge page is just a leaf entry one or two levels up, which has the
+ * same format as a PTE.
+ */
+static inline pte_t pmd_pte(pmd_t pmd)
+{
+	return __pte(pmd_val(pmd));
+}
+
+static inline pmd_t pte_pmd(pte_t pte)
+{
+	return __pmd(pte_val(pte));
+}
+
+#define __HAVE_ARCH_PMD_WRITE
+static inline int pmd_write(pmd_t pmd)
+{
+	return pte_write(pmd_pte(pmd));
+}
+
+static inline int pmd_dirty(pmd_t pmd)
+{
+	return pte_dirty(pmd_pte(pmd));
+}
+
+static inline int pmd_young(pmd_t pmd)
+{
+	return pte_young(pmd_pte(pmd));
+}
+
+static inline pmd_t pmd_wrprotect(pmd_t pmd)
+{
+	return pte_pmd(pte_wrprotect(pmd_pte(pmd)));
+}
+
+static inline pmd_t pmd_mkwrite(pmd_t pmd)
+{
+	return pte_pmd(pte_mkwrite(pmd_pte(pmd)));
+}
+
+static inline pmd_t pmd_mkdirty(pmd_t pmd)
+{
+	return pte_pmd(pte_mkdirty(pmd_pte(pmd)));
+}
+
+static inline pmd_t pmd_mkclean(pmd_t pmd)
+{
+	return pte_pmd(pte_mkclean(pmd_pte(pmd)));
+}
+
+static inline pmd_t pmd_mkyoung(pmd_t pmd)
+{
+	return pte_pmd(pte_mkyoung(pmd_pte(pmd)));
+}
+
+static inline pmd_t pmd_mkold(pmd_t pmd)
+{
+	return pte_pmd(pte_mkold(pmd_pte(pmd)));
+}
+
+static inline pmd_t pmd_modify(pmd_t pmd, pgprot_t newprot)
+{
+	return pte_pmd(pte_modify(pmd_pte(pmd), newprot));
+}
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+static inline int pmd_trans_huge(pmd_t pmd)
+{
+	/* Still true while pmdp_invalidate() has the entry not present */
+	return pmd_val(pmd) && (pmd_val(pmd) & _PAGE_LEAF);
+}
+
+/* The R/W/X bits of the protection already make the entry a leaf */
+static inline pmd_t pmd_mkhuge(pmd_t pmd)
+{
+	return pmd;
+}
+
+static inline pmd_t pmd_mknotpresent(pmd_t pmd)
+{
+	return __pmd(pmd_val(pmd) & ~(_PAGE_PRESENT));
+}
+
+static inline unsigned long pmd_pfn(pmd_t pmd)
+{
+	return __page_val_to_pfn(pmd_val(pmd));
+}
+
+static inline pmd_t mk_pmd(struct page *page, pgprot_t prot)
+{
+	return pfn_pmd(page_to_pfn(page), prot);
+}
+
+static inline void set_pmd_at(struct mm_struct *mm, unsigned long addr,
+			      pmd_t *pmdp, pmd_t pmd)
+{
+	set_pte_at(mm, addr, (pte_t *)pmdp, pmd_pte(pmd));
+}
+
+static inline void update_mmu_cache_pmd(struct vm_area_struct *vma,
+					unsigned long address, pmd_t *pmdp)
+{
+	/* A single SFENCE.VMA covers the whole leaf, see update_mmu_cache */
+	update_mmu_cache(vma, address, (pte_t *)pmdp);
+}
+
+#define __HAVE_ARCH_PMDP_SET_ACCESS_FLAGS
+static inline int pmdp_set_access_flags(struct vm_area_struct *vma,
+					unsigned long address, pmd_t *pmdp,
+					pmd_t entry, int dirty)
+{
+	return ptep_set_access_flags(vma, address, (pte_t *)pmdp,
+				     pmd_pte(entry), dirty);
+}
+
+#define __HAVE_ARCH_PMDP_TEST_AND_CLEAR_YOUNG
+static inline int pmdp_test_and_clear_young(struct vm_area_struct *vma,
+					    unsigned long address,
+					    pmd_t *pmdp)
+{
+	return ptep_test_and_clear_young(vma, address, (pte_t *)pmdp);
+}
+
+#define __HAVE_ARCH_PMDP_HUGE_GET_AND_CLEAR
+static inline pmd_t pmdp_huge_get_and_clear(struct mm_struct *mm,
+					    unsigned long address, pmd_t *pmdp)
+{
+	return pte_pmd(ptep_get_and_clear(mm, address, (pte_t *)pmdp));
+}
+
+#define __HAVE_ARCH_PMDP_SET_WRPROTECT
+static inline void pmdp_set_wrprotect(struct mm_struct *mm,
+				      unsigned long address, pmd_t *pmdp)
+{
+	ptep_set_wrprotect(mm, address, (pte_t *)pmdp);
+}
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE */
+
 /*
  * Encode and decode a swap entry
  *
@@ -396,11 +584,10 @@ static inline int ptep_clear_flush_young(struct vm_area_struct *vma,
 #define __pte_to_swp_entry(pte)	((swp_entry_t) { pte_val(pte) })
 #define __swp_entry_to_pte(x)	((pte_t) { (x).val })
 
-#ifdef CONFIG_FLATMEM
 #define kern_addr_valid(addr)   (1) /* FIXME */
-#endif
 
 extern void paging_init(void);
+extern void bootmem_init(void);
 
 static inline void pgtable_cache_init(void)
 {
@@ -409,12 +596,34 @@ static inline void pgtable_cache_init(void)
 
 #endif /* CONFIG_MMU */
 
+/*
+ * The fixmap takes the top PMD below the linear map, which is as much as
+ * the single page table behind it can cover.  See asm/fixmap.h.
+ */
+#define FIXADDR_TOP      PAGE_OFFSET
+#define FIXADDR_SIZE     PMD_SIZE
+#define FIXADDR_START    (FIXADDR_TOP - FIXADDR_SIZE)
+
 #define VMALLOC_SIZE     (KERN_VIRT_SIZE >> 1)
-#define VMALLOC_END      (PAGE_OFFSET - 1)
+#define VMALLOC_END      (FIXADDR_START - 1)
 #define VMALLOC_START    (PAGE_OFFSET - VMALLOC_SIZE)
 
+#ifdef CONFIG_SPARSEMEM_VMEMMAP
+/*
+ * The struct pages for everything the linear map can reach, in the
+ * otherwise unused space just below the vmalloc area, starting with
+ * that of pfn_base.
+ */
+#define STRUCT_PAGE_MAX_SHIFT	6
+#define VMEMMAP_SIZE	(KERN_VIRT_SIZE >> (PAGE_SHIFT - STRUCT_PAGE_MAX_SHIFT))
+#define VMEMMAP_END	(VMALLOC_START - 1)
+#define VMEMMAP_START	(VMALLOC_START - VMEMMAP_SIZE)
+#define vmemmap		((struct page *)VMEMMAP_START - pfn_base)
+#endif
+
 /*
- * Task size is 0x40000000000 for RV64 or 0xb800000 for RV32.
+ * Task size is 0x4000000000 for RV64 with Sv39, 0x800000000000 with Sv48,
+ * or 0xb800000 for RV32.
  * Note that PGDIR_SIZE must evenly divide TASK_SIZE.
  */
 #ifdef CONFIG_64BIT
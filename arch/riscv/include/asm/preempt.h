@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_PREEMPT_H
+#define _ASM_RISCV_PREEMPT_H
+
+#ifndef CONFIG_64BIT
+#include <asm-generic/preempt.h>
+#else
+
+#include <linux/thread_info.h>
+
+/*
+ * The preempt count and an inverted need_resched flag are the two halves
+ * of one 64-bit word in thread_info, so preempt_enable() tests both with a
+ * single load off tp.  Each half is written separately: the count only by
+ * its own task, the flag possibly from an interrupt, so neither update can
+ * lose the other without needing an atomic.
+ */
+#define PREEMPT_ENABLED	(1UL << 32)
+
+static __always_inline int preempt_count(void)
+{
+	return READ_ONCE(current_thread_info()->preempt.count);
+}
+
+static __always_inline void preempt_count_set(u64 pc)
+{
+	/* Leave need_resched as it is */
+	WRITE_ONCE(current_thread_info()->preempt.count, pc);
+}
+
+/*
+ * must be macros to avoid header recursion hell
+ */
+#define init_task_preempt_count(p) do { \
+	task_thread_info(p)->preempt_count = FORK_PREEMPT_COUNT; \
+} while (0)
+
+#define init_idle_preempt_count(p, cpu) do { \
+	task_thread_info(p)->preempt_count = PREEMPT_ENABLED; \
+} while (0)
+
+static __always_inline void set_preempt_need_resched(void)
+{
+	current_thread_info()->preempt.need_resched = 0;
+}
+
+static __always_inline void clear_preempt_need_resched(void)
+{
+	current_thread_info()->preempt.need_resched = 1;
+}
+
+static __always_inline bool test_preempt_need_resched(void)
+{
+	return !current_thread_info()->preempt.need_resched;
+}
+
+/*
+ * The various preempt_count add/sub methods
+ */
+
+static __always_inline void __preempt_count_add(int val)
+{
+	u32 pc = READ_ONCE(current_thread_info()->preempt.count);
+
+	pc += val;
+	WRITE_ONCE(current_thread_info()->preempt.count, pc);
+}
+
+static __always_inline void __preempt_count_sub(int val)
+{
+	u32 pc = READ_ONCE(current_thread_info()->preempt.count);
+
+	pc -= val;
+	WRITE_ONCE(current_thread_info()->preempt.count, pc);
+}
+
+static __always_inline bool __preempt_count_dec_and_test(void)
+{
+	struct thread_info *ti = current_thread_info();
+	u64 pc = READ_ONCE(ti->preempt_count);
+
+	/* Only the count half is written back */
+	WRITE_ONCE(ti->preempt.count, --pc);
+
+	/*
+	 * All zeroes means preemptible and in need of a reschedule.
+	 * Otherwise look again, in case an interrupt between the load and
+	 * the store above set need_resched.
+	 */
+	return !pc || !READ_ONCE(ti->preempt_count);
+}
+
+/*
+ * Returns true when we need to resched and can (barring IRQ state).
+ */
+static __always_inline bool should_resched(int preempt_offset)
+{
+	u64 pc = READ_ONCE(current_thread_info()->preempt_count);
+
+	return pc == preempt_offset;
+}
+
+#ifdef CONFIG_PREEMPT
+extern asmlinkage void preempt_schedule(void);
+#define __preempt_schedule() preempt_schedule()
+extern asmlinkage void preempt_schedule_notrace(void);
+#define __preempt_schedule_notrace() preempt_schedule_notrace()
+#endif /* CONFIG_PREEMPT */
+
+#endif /* CONFIG_64BIT */
+#endif /* _ASM_RISCV_PREEMPT_H */
@@ -46,6 +46,10 @@ struct thread_struct {
 	unsigned long sp;	/* Kernel mode stack */
 	unsigned long s[12];	/* s[0]: frame pointer */
 	struct __riscv_d_ext_state fstate;
+	bool fstate_lazy;		/* fstate is restored on first FP use */
+	unsigned char fstate_slices;	/* Consecutive slices that used FP */
+	struct __riscv_v_ext_state vstate;	/* datap allocated on first use */
+	unsigned long bad_cause;
 };
 
 #define INIT_THREAD {					\
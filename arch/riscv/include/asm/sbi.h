@@ -14,7 +14,11 @@
 #ifndef _ASM_RISCV_SBI_H
 #define _ASM_RISCV_SBI_H
 
+#include <linux/init.h>
 #include <linux/types.h>
+#include <asm/timex.h>
+
+struct cpumask;
 
 #define SBI_SET_TIMER 0
 #define SBI_CONSOLE_PUTCHAR 1
@@ -25,23 +29,171 @@
 #define SBI_REMOTE_SFENCE_VMA 6
 #define SBI_REMOTE_SFENCE_VMA_ASID 7
 #define SBI_SHUTDOWN 8
+#define SBI_NR_LEGACY 9
 
-#define SBI_CALL(which, arg0, arg1, arg2) ({			\
+#define SBI_CALL(which, arg0, arg1, arg2, arg3) ({		\
 	register uintptr_t a0 asm ("a0") = (uintptr_t)(arg0);	\
 	register uintptr_t a1 asm ("a1") = (uintptr_t)(arg1);	\
 	register uintptr_t a2 asm ("a2") = (uintptr_t)(arg2);	\
+	register uintptr_t a3 asm ("a3") = (uintptr_t)(arg3);	\
 	register uintptr_t a7 asm ("a7") = (uintptr_t)(which);	\
 	asm volatile ("ecall"					\
 		      : "+r" (a0)				\
-		      : "r" (a1), "r" (a2), "r" (a7)		\
+		      : "r" (a1), "r" (a2), "r" (a3), "r" (a7)	\
 		      : "memory");				\
 	a0;							\
 })
 
+/*
+ * With CONFIG_RISCV_SBI_STATS the calls that stand in for instructions on
+ * hot paths (the timer, IPIs and remote fences) are counted and timed per
+ * CPU, see sbi_stats.c, to show what the trips to M-mode cost.
+ */
+#ifdef CONFIG_RISCV_SBI_STATS
+void sbi_stat_account(unsigned int which, cycles_t start);
+
+#define SBI_STAT(which, call) do {		\
+	cycles_t __start = get_cycles();	\
+	call;					\
+	sbi_stat_account(which, __start);	\
+} while (0)
+#else
+#define SBI_STAT(which, call) call
+#endif
+
 /* Lazy implementations until SBI is finalized */
-#define SBI_CALL_0(which) SBI_CALL(which, 0, 0, 0)
-#define SBI_CALL_1(which, arg0) SBI_CALL(which, arg0, 0, 0)
-#define SBI_CALL_2(which, arg0, arg1) SBI_CALL(which, arg0, arg1, 0)
+#define SBI_CALL_0(which) SBI_CALL(which, 0, 0, 0, 0)
+#define SBI_CALL_1(which, arg0) SBI_CALL(which, arg0, 0, 0, 0)
+#define SBI_CALL_2(which, arg0, arg1) SBI_CALL(which, arg0, arg1, 0, 0)
+#define SBI_CALL_3(which, arg0, arg1, arg2) SBI_CALL(which, arg0, arg1, arg2, 0)
+#define SBI_CALL_4(which, arg0, arg1, arg2, arg3) \
+	SBI_CALL(which, arg0, arg1, arg2, arg3)
+
+/*
+ * Extensions from v0.2 of the SBI take the extension ID in a7 and the
+ * function ID in a6, and return an error code in a0 and a value in a1.
+ * Older firmware fails any call it doesn't know with a non-zero a0.
+ */
+#define SBI_EXT_BASE			0x10
+#define SBI_EXT_BASE_GET_SPEC_VERSION	0
+#define SBI_EXT_BASE_GET_IMP_ID		1
+#define SBI_EXT_BASE_GET_IMP_VERSION	2
+#define SBI_EXT_BASE_PROBE_EXT		3
+#define SBI_EXT_BASE_GET_MVENDORID	4
+#define SBI_EXT_BASE_GET_MARCHID	5
+#define SBI_EXT_BASE_GET_MIMPID		6
+
+#define SBI_EXT_TIME			0x54494D45
+#define SBI_EXT_TIME_SET_TIMER		0
+
+#define SBI_EXT_IPI			0x735049
+#define SBI_EXT_IPI_SEND_IPI		0
+
+#define SBI_EXT_RFENCE				0x52464E43
+#define SBI_EXT_RFENCE_REMOTE_FENCE_I		0
+#define SBI_EXT_RFENCE_REMOTE_SFENCE_VMA	1
+#define SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID	2
+#define SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID	3
+#define SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA	4
+#define SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID	5
+#define SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA	6
+
+#define SBI_EXT_HSM			0x48534D
+#define SBI_EXT_HSM_HART_START		0
+#define SBI_EXT_HSM_HART_STOP		1
+#define SBI_EXT_HSM_HART_STATUS		2
+#define SBI_EXT_HSM_HART_SUSPEND	3
+
+#define SBI_HSM_HART_STATUS_STARTED	0
+#define SBI_HSM_HART_STATUS_STOPPED	1
+
+/* Suspend types: the hart loses its state in the non-retentive ones */
+#define SBI_HSM_SUSPEND_RET_DEFAULT	0x00000000
+#define SBI_HSM_SUSPEND_RET_PLATFORM	0x10000000
+#define SBI_HSM_SUSPEND_NON_RET_BIT	0x80000000
+
+#define SBI_EXT_STA			0x535441
+#define SBI_EXT_STA_STEAL_TIME_SET_SHMEM	0
+
+/*
+ * Collaborative processor performance control, with the registers
+ * numbered as ACPI's _CPC lists them.  They belong to the calling hart.
+ */
+#define SBI_EXT_CPPC			0x43505043
+#define SBI_EXT_CPPC_PROBE		0
+#define SBI_EXT_CPPC_READ		1
+#define SBI_EXT_CPPC_READ_HI		2
+#define SBI_EXT_CPPC_WRITE		3
+
+#define SBI_CPPC_HIGHEST_PERF		0x00
+#define SBI_CPPC_NOMINAL_PERF		0x01
+#define SBI_CPPC_LOWEST_NONLINEAR_PERF	0x02
+#define SBI_CPPC_LOWEST_PERF		0x03
+#define SBI_CPPC_DESIRED_PERF		0x05
+#define SBI_CPPC_LOWEST_FREQ		0x13
+#define SBI_CPPC_NOMINAL_FREQ		0x14
+
+/* Passed as both halves of the address to stop using a shared area */
+#define SBI_SHMEM_DISABLE		-1
+
+/*
+ * The steal-time area a hart registers with SBI_EXT_STA.  The hypervisor
+ * makes sequence odd while it updates the rest, so readers retry until
+ * they see the same even value on both sides of their reads.  steal is
+ * in nanoseconds; preempted is non-zero while the hart is descheduled.
+ */
+struct sbi_sta_struct {
+	__le32 sequence;
+	__le32 flags;
+	__le64 steal;
+	u8 preempted;
+	u8 pad[47];
+};
+
+/* The spec version is major << 24 | minor */
+#define SBI_SPEC_VERSION_MAJOR_SHIFT	24
+#define SBI_SPEC_VERSION_MINOR_MASK	0xffffff
+
+#define SBI_SUCCESS			0
+#define SBI_ERR_FAILURE			-1
+#define SBI_ERR_NOT_SUPPORTED		-2
+#define SBI_ERR_INVALID_PARAM		-3
+#define SBI_ERR_DENIED			-4
+#define SBI_ERR_INVALID_ADDRESS		-5
+#define SBI_ERR_ALREADY_AVAILABLE	-6
+
+struct sbiret {
+	long error;
+	long value;
+};
+
+#define SBI_ECALL5(ext, fid, arg0, arg1, arg2, arg3, arg4) ({	\
+	register uintptr_t a0 asm ("a0") = (uintptr_t)(arg0);	\
+	register uintptr_t a1 asm ("a1") = (uintptr_t)(arg1);	\
+	register uintptr_t a2 asm ("a2") = (uintptr_t)(arg2);	\
+	register uintptr_t a3 asm ("a3") = (uintptr_t)(arg3);	\
+	register uintptr_t a4 asm ("a4") = (uintptr_t)(arg4);	\
+	register uintptr_t a6 asm ("a6") = (uintptr_t)(fid);	\
+	register uintptr_t a7 asm ("a7") = (uintptr_t)(ext);	\
+	asm volatile ("ecall"					\
+		      : "+r" (a0), "+r" (a1)			\
+		      : "r" (a2), "r" (a3), "r" (a4),		\
+			"r" (a6), "r" (a7)			\
+		      : "memory");				\
+	(struct sbiret){ .error = a0, .value = a1 };		\
+})
+
+#define SBI_ECALL(ext, fid, arg0, arg1, arg2) \
+	SBI_ECALL5(ext, fid, arg0, arg1, arg2, 0, 0)
+
+/* The major << 24 | minor from the base extension, or 0 for v0.1 */
+extern unsigned long sbi_spec_version;
+
+/* The -errno for an SBI_ERR_* code */
+int sbi_err_map_linux_errno(int err);
+
+/* Pick the interface the timer, IPI and fence calls below go through */
+void __init sbi_init(void);
 
 static inline void sbi_console_putchar(int ch)
 {
@@ -53,15 +205,6 @@ static inline int sbi_console_getchar(void)
 	return SBI_CALL_0(SBI_CONSOLE_GETCHAR);
 }
 
-static inline void sbi_set_timer(uint64_t stime_value)
-{
-#if __riscv_xlen == 32
-	SBI_CALL_2(SBI_SET_TIMER, stime_value, stime_value >> 32);
-#else
-	SBI_CALL_1(SBI_SET_TIMER, stime_value);
-#endif
-}
-
 static inline void sbi_shutdown(void)
 {
 	SBI_CALL_0(SBI_SHUTDOWN);
@@ -72,29 +215,93 @@ static inline void sbi_clear_ipi(void)
 	SBI_CALL_0(SBI_CLEAR_IPI);
 }
 
-static inline void sbi_send_ipi(const unsigned long *hart_mask)
+/*
+ * Through the v0.2 TIME, IPI and RFENCE extensions where the firmware has
+ * them, see sbi.c.  A NULL mask is every hart; the others return 0 or a
+ * -errno.
+ */
+void sbi_set_timer(uint64_t stime_value);
+int sbi_send_ipi(const struct cpumask *cpu_mask);
+int sbi_remote_fence_i(const struct cpumask *cpu_mask);
+int sbi_remote_sfence_vma(const struct cpumask *cpu_mask,
+			  unsigned long start, unsigned long size);
+int sbi_remote_sfence_vma_asid(const struct cpumask *cpu_mask,
+			       unsigned long start, unsigned long size,
+			       unsigned long asid);
+
+/* Non-zero if the firmware implements the given v0.2 extension */
+static inline long sbi_probe_extension(long ext)
+{
+	struct sbiret ret = SBI_ECALL(SBI_EXT_BASE, SBI_EXT_BASE_PROBE_EXT,
+				      ext, 0, 0);
+
+	return ret.error ? 0 : ret.value;
+}
+
+/* Start a stopped hart at the physical address start, with a1 = opaque */
+static inline long sbi_hsm_hart_start(unsigned long hartid,
+				      unsigned long start,
+				      unsigned long opaque)
 {
-	SBI_CALL_1(SBI_SEND_IPI, hart_mask);
+	return SBI_ECALL(SBI_EXT_HSM, SBI_EXT_HSM_HART_START,
+			 hartid, start, opaque).error;
 }
 
-static inline void sbi_remote_fence_i(const unsigned long *hart_mask)
+/* Stop the calling hart: only returns on failure */
+static inline long sbi_hsm_hart_stop(void)
 {
-	SBI_CALL_1(SBI_REMOTE_FENCE_I, hart_mask);
+	return SBI_ECALL(SBI_EXT_HSM, SBI_EXT_HSM_HART_STOP, 0, 0, 0).error;
 }
 
-static inline void sbi_remote_sfence_vma(const unsigned long *hart_mask,
-					 unsigned long start,
-					 unsigned long size)
+/* One of SBI_HSM_HART_STATUS_*, or a negative error */
+static inline long sbi_hsm_hart_status(unsigned long hartid)
 {
-	SBI_CALL_1(SBI_REMOTE_SFENCE_VMA, hart_mask);
+	struct sbiret ret = SBI_ECALL(SBI_EXT_HSM, SBI_EXT_HSM_HART_STATUS,
+				      hartid, 0, 0);
+
+	return ret.error ? ret.error : ret.value;
+}
+
+/* The width in bits of a CPPC register, 0 if there is no such register */
+static inline long sbi_cppc_probe(unsigned long reg)
+{
+	struct sbiret ret = SBI_ECALL(SBI_EXT_CPPC, SBI_EXT_CPPC_PROBE,
+				      reg, 0, 0);
+
+	return ret.error ? ret.error : ret.value;
+}
+
+/* The low XLEN bits of one of the calling hart's CPPC registers */
+static inline long sbi_cppc_read(unsigned long reg, unsigned long *val)
+{
+	struct sbiret ret = SBI_ECALL(SBI_EXT_CPPC, SBI_EXT_CPPC_READ,
+				      reg, 0, 0);
+
+	*val = ret.value;
+	return ret.error;
 }
 
-static inline void sbi_remote_sfence_vma_asid(const unsigned long *hart_mask,
-					      unsigned long start,
-					      unsigned long size,
-					      unsigned long asid)
+static inline long sbi_cppc_write(unsigned long reg, u64 val)
+{
+#if __riscv_xlen == 32
+	return SBI_ECALL(SBI_EXT_CPPC, SBI_EXT_CPPC_WRITE,
+			 reg, val, val >> 32).error;
+#else
+	return SBI_ECALL(SBI_EXT_CPPC, SBI_EXT_CPPC_WRITE, reg, val, 0).error;
+#endif
+}
+
+/*
+ * Suspend the calling hart until an interrupt is pending.  A retentive
+ * suspend returns here like wfi does; a non-retentive one resumes at the
+ * physical address resume instead, with a1 = opaque.
+ */
+static inline long sbi_hsm_hart_suspend(unsigned long type,
+					unsigned long resume,
+					unsigned long opaque)
 {
-	SBI_CALL_1(SBI_REMOTE_SFENCE_VMA_ASID, hart_mask);
+	return SBI_ECALL(SBI_EXT_HSM, SBI_EXT_HSM_HART_SUSPEND,
+			 type, resume, opaque).error;
 }
 
 #endif
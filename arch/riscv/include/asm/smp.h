@@ -20,16 +20,46 @@
 #endif
 
 #include <linux/cpumask.h>
+#include <linux/errno.h>
 #include <linux/irqreturn.h>
 
+#define INVALID_HARTID ULONG_MAX
+
+/* The hart that won the lottery in head.S, which is CPU 0 */
+extern unsigned long boot_cpu_hartid;
+
 #ifdef CONFIG_SMP
 
-/* SMP initialization hook for setup_arch */
-void __init init_clockevent(void);
+struct seq_file;
+
+/*
+ * Linux CPU numbers are handed out densely, with the boot hart as CPU 0,
+ * whatever the hart IDs in the device tree are.  Everything that talks
+ * to the hardware or the SBI about a hart has to translate.
+ */
+extern unsigned long __cpuid_to_hartid_map[NR_CPUS];
+#define cpuid_to_hartid_map(cpu)	__cpuid_to_hartid_map[cpu]
+
+/* The CPU running hartid, or -ENOENT if it isn't one of ours */
+int riscv_hartid_to_cpuid(unsigned long hartid);
+
+/*
+ * The hart mask the legacy SBI calls take for a mask of CPUs.  The
+ * firmware only ever reads its first word, so harts past BITS_PER_LONG
+ * can't be reached through it: sbi.c uses the v0.2 calls, which can,
+ * where the firmware has them.
+ */
+unsigned long riscv_cpuid_to_hartid_mask(const struct cpumask *in);
 
 /* SMP initialization hook for setup_arch */
 void __init setup_smp(void);
 
+/* Switch IPI delivery to SSWI registers if the platform has them */
+void __init riscv_ipi_init(void);
+
+/* Print per-type IPI counts into /proc/interrupts */
+void show_ipi_stats(struct seq_file *p, int prec);
+
 /* Hook for the generic smp_call_function_many() routine. */
 void arch_send_call_function_ipi_mask(struct cpumask *mask);
 
@@ -47,6 +77,30 @@ void arch_send_call_function_single_ipi(int cpu);
 /* Interprocessor interrupt handler */
 irqreturn_t handle_ipi(void);
 
+/* Entry point of a secondary CPU, from head.S or a restart in cpu_ops.c */
+asmlinkage void smp_callin(void);
+
+#ifdef CONFIG_HOTPLUG_CPU
+int __cpu_disable(void);
+void __cpu_die(unsigned int cpu);
+#endif
+
+#else /* CONFIG_SMP */
+
+#define cpuid_to_hartid_map(cpu)	boot_cpu_hartid
+
+static inline int riscv_hartid_to_cpuid(unsigned long hartid)
+{
+	return hartid == boot_cpu_hartid ? 0 : -ENOENT;
+}
+
+static inline unsigned long riscv_cpuid_to_hartid_mask(const struct cpumask *in)
+{
+	if (!cpumask_test_cpu(0, in) || boot_cpu_hartid >= BITS_PER_LONG)
+		return 0;
+	return 1UL << boot_cpu_hartid;
+}
+
 #endif /* CONFIG_SMP */
 
 #endif /* _ASM_RISCV_SMP_H */
@@ -17,149 +17,111 @@
 
 #include <linux/kernel.h>
 #include <asm/current.h>
+#include <asm/barrier.h>
+#include <asm/cmpxchg.h>
 
 /*
- * Simple spin lock operations.  These provide no fairness guarantees.
+ * Ticket spinlocks.  A hart takes a ticket with a single amoadd.w on the
+ * "next" halfword and then waits for "owner" to reach it, so harts are
+ * served in the order they arrived.  Unlocking only has to bump "owner",
+ * which a halfword store does without disturbing concurrent arrivals.
  */
 
-/* FIXME: Replace this with a ticket lock, like MIPS. */
-
 #define arch_spin_lock_flags(lock, flags) arch_spin_lock(lock)
-#define arch_spin_is_locked(x)	((x)->lock != 0)
 
-static inline void arch_spin_unlock(arch_spinlock_t *lock)
+static inline int arch_spin_value_unlocked(arch_spinlock_t lock)
 {
-	__asm__ __volatile__ (
-		"amoswap.w.rl x0, x0, %0"
-		: "=A" (lock->lock)
-		:: "memory");
+	return lock.tickets.owner == lock.tickets.next;
 }
 
-static inline int arch_spin_trylock(arch_spinlock_t *lock)
+static inline int arch_spin_is_locked(arch_spinlock_t *lock)
 {
-	int tmp = 1, busy;
-
-	__asm__ __volatile__ (
-		"amoswap.w.aq %0, %2, %1"
-		: "=r" (busy), "+A" (lock->lock)
-		: "r" (tmp)
-		: "memory");
-
-	return !busy;
+	return !arch_spin_value_unlocked(READ_ONCE(*lock));
 }
 
-static inline void arch_spin_lock(arch_spinlock_t *lock)
+static inline int arch_spin_is_contended(arch_spinlock_t *lock)
 {
-	while (1) {
-		if (arch_spin_is_locked(lock))
-			continue;
+	struct __raw_tickets tickets = READ_ONCE(lock->tickets);
 
-		if (arch_spin_trylock(lock))
-			break;
-	}
+	return (s16)(tickets.next - tickets.owner) > 1;
 }
+#define arch_spin_is_contended	arch_spin_is_contended
 
-static inline void arch_spin_unlock_wait(arch_spinlock_t *lock)
+static inline void arch_spin_unlock(arch_spinlock_t *lock)
 {
-	smp_rmb();
-	do {
-		cpu_relax();
-	} while (arch_spin_is_locked(lock));
-	smp_acquire__after_ctrl_dep();
+	smp_store_release(&lock->tickets.owner, lock->tickets.owner + 1);
 }
 
-/***********************************************************/
-
-static inline int arch_read_can_lock(arch_rwlock_t *lock)
+static inline int arch_spin_trylock(arch_spinlock_t *lock)
 {
-	return lock->lock >= 0;
-}
+	arch_spinlock_t old = READ_ONCE(*lock);
 
-static inline int arch_write_can_lock(arch_rwlock_t *lock)
-{
-	return lock->lock == 0;
-}
+	if (!arch_spin_value_unlocked(old))
+		return 0;
 
-static inline void arch_read_lock(arch_rwlock_t *lock)
-{
-	int tmp;
-
-	__asm__ __volatile__(
-		"1:	lr.w	%1, %0\n"
-		"	bltz	%1, 1b\n"
-		"	addi	%1, %1, 1\n"
-		"	sc.w.aq	%1, %1, %0\n"
-		"	bnez	%1, 1b\n"
-		: "+A" (lock->lock), "=&r" (tmp)
-		:: "memory");
+	return cmpxchg(&lock->lock, old.lock,
+		       old.lock + (1 << TICKET_SHIFT)) == old.lock;
 }
 
-static inline void arch_write_lock(arch_rwlock_t *lock)
+static inline void arch_spin_lock(arch_spinlock_t *lock)
 {
-	int tmp;
-
-	__asm__ __volatile__(
-		"1:	lr.w	%1, %0\n"
-		"	bnez	%1, 1b\n"
-		"	li	%1, -1\n"
-		"	sc.w.aq	%1, %1, %0\n"
-		"	bnez	%1, 1b\n"
-		: "+A" (lock->lock), "=&r" (tmp)
-		:: "memory");
-}
+	u32 old;
+	u16 ticket;
 
-static inline int arch_read_trylock(arch_rwlock_t *lock)
-{
-	int busy;
-
-	__asm__ __volatile__(
-		"1:	lr.w	%1, %0\n"
-		"	bltz	%1, 1f\n"
-		"	addi	%1, %1, 1\n"
-		"	sc.w.aq	%1, %1, %0\n"
-		"	bnez	%1, 1b\n"
-		"1:\n"
-		: "+A" (lock->lock), "=&r" (busy)
-		:: "memory");
-
-	return !busy;
-}
+	__asm__ __volatile__ (
+		"amoadd.w.aq %0, %2, %1"
+		: "=&r" (old), "+A" (lock->lock)
+		: "r" (1 << TICKET_SHIFT)
+		: "memory");
 
-static inline int arch_write_trylock(arch_rwlock_t *lock)
-{
-	int busy;
-
-	__asm__ __volatile__(
-		"1:	lr.w	%1, %0\n"
-		"	bnez	%1, 1f\n"
-		"	li	%1, -1\n"
-		"	sc.w.aq	%1, %1, %0\n"
-		"	bnez	%1, 1b\n"
-		"1:\n"
-		: "+A" (lock->lock), "=&r" (busy)
-		:: "memory");
-
-	return !busy;
-}
+	ticket = old >> TICKET_SHIFT;
+	if ((u16)old == ticket)
+		return;
 
-static inline void arch_read_unlock(arch_rwlock_t *lock)
-{
-	__asm__ __volatile__(
-		"amoadd.w.rl x0, %1, %0"
-		: "+A" (lock->lock)
-		: "r" (-1)
-		: "memory");
+	while (READ_ONCE(lock->tickets.owner) != ticket)
+		cpu_relax();
+
+	smp_acquire__after_ctrl_dep();
 }
 
-static inline void arch_write_unlock(arch_rwlock_t *lock)
+static inline void arch_spin_unlock_wait(arch_spinlock_t *lock)
 {
-	__asm__ __volatile__ (
-		"amoswap.w.rl x0, x0, %0"
-		: "=A" (lock->lock)
-		:: "memory");
+	u16 owner = READ_ONCE(lock->tickets.owner);
+
+	smp_rmb();
+	for (;;) {
+		struct __raw_tickets tickets = READ_ONCE(lock->tickets);
+
+		if (tickets.owner == tickets.next || tickets.owner != owner)
+			break;
+
+		cpu_relax();
+	}
+	smp_acquire__after_ctrl_dep();
 }
 
+/***********************************************************/
+
+/*
+ * Read-write locks are the generic queued rwlocks: the fast paths are a
+ * single AMO on the count word, and contended readers and writers queue
+ * up on the ticket lock above, so a steady stream of readers can no
+ * longer starve a writer.
+ */
+#include <asm/qrwlock.h>
+
 #define arch_read_lock_flags(lock, flags) arch_read_lock(lock)
 #define arch_write_lock_flags(lock, flags) arch_write_lock(lock)
 
+#ifdef CONFIG_PARAVIRT
+#include <asm/paravirt.h>
+
+/* Lets lock spinners give up on an owner whose hart the host descheduled */
+#define vcpu_is_preempted vcpu_is_preempted
+static inline bool vcpu_is_preempted(long cpu)
+{
+	return pv_vcpu_is_preempted(cpu);
+}
+#endif
+
 #endif /* _ASM_RISCV_SPINLOCK_H */
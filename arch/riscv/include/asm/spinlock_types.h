@@ -18,16 +18,27 @@
 # error "please don't include this file directly"
 #endif
 
-typedef struct {
-	volatile unsigned int lock;
-} arch_spinlock_t;
+#include <linux/types.h>
 
-#define __ARCH_SPIN_LOCK_UNLOCKED	{ 0 }
+#define TICKET_SHIFT	16
 
+/*
+ * Ticket lock: "next" is the ticket handed to the next arriving hart and
+ * "owner" is the ticket currently being served.  The lock is free when the
+ * two are equal.  RISC-V is little-endian, so owner is the low halfword.
+ */
 typedef struct {
-	volatile unsigned int lock;
-} arch_rwlock_t;
+	union {
+		u32 lock;
+		struct __raw_tickets {
+			u16 owner;
+			u16 next;
+		} tickets;
+	};
+} arch_spinlock_t;
+
+#define __ARCH_SPIN_LOCK_UNLOCKED	{ { 0 } }
 
-#define __ARCH_RW_LOCK_UNLOCKED		{ 0 }
+#include <asm-generic/qrwlock_types.h>
 
 #endif
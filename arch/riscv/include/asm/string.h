@@ -23,4 +23,16 @@ extern asmlinkage void *memset(void *, int, size_t);
 #define __HAVE_ARCH_MEMCPY
 extern asmlinkage void *memcpy(void *, const void *, size_t);
 
+#define __HAVE_ARCH_MEMMOVE
+extern asmlinkage void *memmove(void *, const void *, size_t);
+
+/*
+ * Copies in ascending address order, so that a destination less than the
+ * length above the source repeats the bytes in between, as the LZ4 and
+ * zstd match copies expect.  Only worth the call for long copies.
+ */
+#define __HAVE_ARCH_COPY_FORWARD
+#define COPY_FORWARD_MIN	256
+extern void copy_forward(void *, const void *, size_t);
+
 #endif /* _ASM_RISCV_STRING_H */
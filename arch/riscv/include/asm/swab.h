@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_SWAB_H
+#define _ASM_RISCV_SWAB_H
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+#include <asm-generic/swab.h>
+#include <asm/alternative.h>
+#include <asm/insn-def.h>
+
+/*
+ * Byte swaps are a single rev8 with Zbb, patched in at boot the same way
+ * as in <asm/bitops.h>.  Narrower swaps use the top of the reversed
+ * register.  <linux/swab.h> already keeps constants away from these.
+ */
+static __always_inline unsigned long __arch_rev8(unsigned long x)
+{
+	asm_volatile_goto(ALTERNATIVE("j %l[legacy]", "nop", RISCV_ISA_EXT_ZBB)
+			  : : : : legacy);
+	asm volatile (ZBB_REV8("%0", "%1") : "=r" (x) : "r" (x));
+	return x;
+legacy:
+#if __riscv_xlen == 64
+	x = ((x & 0x00000000ffffffffUL) << 32) | (x >> 32);
+	x = ((x & 0x0000ffff0000ffffUL) << 16) | ((x >> 16) & 0x0000ffff0000ffffUL);
+	x = ((x & 0x00ff00ff00ff00ffUL) << 8) | ((x >> 8) & 0x00ff00ff00ff00ffUL);
+#else
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ffUL) << 8) | ((x >> 8) & 0x00ff00ffUL);
+#endif
+	return x;
+}
+
+static __always_inline __u16 __arch_swab16(__u16 x)
+{
+	return __arch_rev8(x) >> (__riscv_xlen - 16);
+}
+#define __arch_swab16 __arch_swab16
+
+static __always_inline __u32 __arch_swab32(__u32 x)
+{
+	return __arch_rev8(x) >> (__riscv_xlen - 32);
+}
+#define __arch_swab32 __arch_swab32
+
+#if __riscv_xlen == 64
+static __always_inline __u64 __arch_swab64(__u64 x)
+{
+	return __arch_rev8(x);
+}
+#define __arch_swab64 __arch_swab64
+#endif
+
+#endif /* _ASM_RISCV_SWAB_H */
@@ -14,55 +14,140 @@
 #ifndef _ASM_RISCV_SWITCH_TO_H
 #define _ASM_RISCV_SWITCH_TO_H
 
+#include <linux/preempt.h>
+
 #include <asm/processor.h>
 #include <asm/ptrace.h>
 #include <asm/csr.h>
+#include <asm/vector.h>
 
 extern void __fstate_save(struct task_struct *save_to);
 extern void __fstate_restore(struct task_struct *restore_from);
+extern void __fstate_save_state(struct __riscv_d_ext_state *state);
+extern void __fstate_restore_state(struct __riscv_d_ext_state *state);
 
 static inline void __fstate_clean(struct pt_regs *regs)
 {
-	regs->sstatus |= (regs->sstatus & ~(SR_FS)) | SR_FS_CLEAN;
+	regs->sstatus = (regs->sstatus & ~SR_FS) | SR_FS_CLEAN;
 }
 
+/*
+ * A task's FP registers are only live in the hardware while its FS isn't
+ * off: otherwise thread.fstate is the authoritative copy.  A context
+ * switch can turn FS off under us (see __switch_to_aux), so preemption is
+ * disabled while the two are synchronised.
+ */
 static inline void fstate_save(struct task_struct *task,
 			       struct pt_regs *regs)
 {
+	preempt_disable();
 	if ((regs->sstatus & SR_FS) == SR_FS_DIRTY) {
 		__fstate_save(task);
 		__fstate_clean(regs);
 	}
+	preempt_enable();
 }
 
 static inline void fstate_restore(struct task_struct *task,
 				  struct pt_regs *regs)
 {
+	preempt_disable();
 	if ((regs->sstatus & SR_FS) != SR_FS_OFF) {
 		__fstate_restore(task);
 		__fstate_clean(regs);
 	}
+	preempt_enable();
+}
+
+/*
+ * The FP state of the next task is not restored on context switch: it is
+ * switched in with FS off and marked fstate_lazy, so that the first FP
+ * instruction it executes takes an illegal instruction trap, which loads
+ * the registers (see do_trap_insn_illegal).  Integer-only tasks never pay
+ * for the restore.  A task that dirtied its FP registers in each of its
+ * last FSTATE_EAGER_SLICES slices is going to need them again, so it is
+ * restored eagerly instead; a slice without FP use makes it lazy again.
+ */
+#define FSTATE_EAGER_SLICES	5
+
+static inline void fstate_switch_out(struct task_struct *prev,
+				     struct pt_regs *regs)
+{
+	if ((regs->sstatus & SR_FS) == SR_FS_DIRTY) {
+		__fstate_save(prev);
+		__fstate_clean(regs);
+		if (prev->thread.fstate_slices < FSTATE_EAGER_SLICES)
+			prev->thread.fstate_slices++;
+	} else {
+		prev->thread.fstate_slices = 0;
+	}
+}
+
+static inline void fstate_switch_in(struct task_struct *next,
+				    struct pt_regs *regs)
+{
+	if ((regs->sstatus & SR_FS) == SR_FS_OFF)
+		return;
+
+	if (next->thread.fstate_slices >= FSTATE_EAGER_SLICES) {
+		__fstate_restore(next);
+		__fstate_clean(regs);
+	} else {
+		next->thread.fstate_lazy = true;
+		regs->sstatus &= ~SR_FS;
+	}
+}
+
+/*
+ * The vector state is much larger and is always restored lazily, by
+ * riscv_v_first_use_handler(): with VS off, thread.vstate is always the
+ * authoritative copy, so no flag is needed.
+ */
+static inline void vstate_switch_out(struct task_struct *prev,
+				     struct pt_regs *regs)
+{
+	if ((regs->sstatus & SR_VS) == SR_VS_DIRTY) {
+		__vstate_save(&prev->thread.vstate, prev->thread.vstate.datap);
+		regs->sstatus = (regs->sstatus & ~SR_VS) | SR_VS_CLEAN;
+	}
+}
+
+static inline void vstate_switch_in(struct task_struct *next,
+				    struct pt_regs *regs)
+{
+	regs->sstatus &= ~SR_VS;
 }
 
 static inline void __switch_to_aux(struct task_struct *prev,
 				   struct task_struct *next)
 {
-	struct pt_regs *regs;
+	struct pt_regs *prev_regs = task_pt_regs(prev);
+	struct pt_regs *next_regs = task_pt_regs(next);
 
-	regs = task_pt_regs(prev);
-	if (unlikely(regs->sstatus & SR_SD))
-		fstate_save(prev, regs);
-	fstate_restore(next, task_pt_regs(next));
+	fstate_switch_out(prev, prev_regs);
+	fstate_switch_in(next, next_regs);
+	vstate_switch_out(prev, prev_regs);
+	vstate_switch_in(next, next_regs);
 }
 
 extern struct task_struct *__switch_to(struct task_struct *,
 				       struct task_struct *);
 
+#ifdef CONFIG_SMP
+/* prev ran on this hart, so its cached per-CPU offset is the right one */
+#define __switch_to_percpu(prev, next)				\
+	((next)->thread_info.percpu_offset =			\
+		(prev)->thread_info.percpu_offset)
+#else
+#define __switch_to_percpu(prev, next)	do { } while (0)
+#endif
+
 #define switch_to(prev, next, last)			\
 do {							\
 	struct task_struct *__prev = (prev);		\
 	struct task_struct *__next = (next);		\
 	__switch_to_aux(__prev, __next);		\
+	__switch_to_percpu(__prev, __next);		\
 	((last) = __switch_to(__prev, __next));		\
 } while (0)
 
@@ -0,0 +1,39 @@
+/*
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_SYNC_CORE_H
+#define _ASM_RISCV_SYNC_CORE_H
+
+#include <linux/mm_types.h>
+
+#include <asm/cacheflush.h>
+
+/*
+ * sret does not serialize instruction fetch, so have the hart fence its
+ * own instruction stream before it goes back to user mode.
+ */
+static inline void sync_core_before_usermode(void)
+{
+	local_flush_icache_all();
+}
+
+/*
+ * Harts that run none of mm's threads when the membarrier IPIs go out
+ * fence on their next switch to mm, through flush_icache_deferred().
+ */
+static inline void prepare_sync_core_cmd(struct mm_struct *mm)
+{
+#ifdef CONFIG_SMP
+	cpumask_setall(&mm->context.icache_stale_mask);
+#endif
+}
+
+#endif /* _ASM_RISCV_SYNC_CORE_H */
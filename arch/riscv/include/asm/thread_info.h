@@ -18,10 +18,26 @@
 
 #include <asm/page.h>
 #include <linux/const.h>
+#include <linux/sizes.h>
 
 /* thread information allocation */
 #define THREAD_SIZE_ORDER	(1)
 #define THREAD_SIZE		(PAGE_SIZE << THREAD_SIZE_ORDER)
+#define THREAD_SHIFT		(PAGE_SHIFT + THREAD_SIZE_ORDER)
+
+/*
+ * With virtually mapped stacks, aligning each one to twice its size means
+ * the THREAD_SHIFT bit of any address inside it is clear, and set just
+ * below it: the trap entry tests that one bit to spot an overflow, and
+ * then moves to a small per-cpu stack to report it.
+ */
+#ifdef CONFIG_VMAP_STACK
+#define THREAD_ALIGN		(2 * THREAD_SIZE)
+#else
+#define THREAD_ALIGN		THREAD_SIZE
+#endif
+
+#define OVERFLOW_STACK_SIZE	SZ_4K
 
 #ifndef __ASSEMBLY__
 
@@ -35,12 +51,23 @@ typedef unsigned long mm_segment_t;
  * - this struct should fit entirely inside of one cache line
  * - if the members of this struct changes, the assembly constants
  *   in asm-offsets.c must be updated accordingly
- * - thread_info is included in task_struct at an offset of 0.  This means that
- *   tp points to both thread_info and task_struct.
+ * - with THREAD_INFO_IN_TASK, thread_info is the first member of task_struct.
+ *   This means that tp points to both thread_info and task_struct.
  */
 struct thread_info {
 	unsigned long		flags;		/* low level flags */
+#ifdef CONFIG_64BIT
+	/* need_resched is folded in, inverted, see <asm/preempt.h> */
+	union {
+		u64		preempt_count;	/* 0=>preemptible, <0=>BUG */
+		struct {
+			u32	count;
+			u32	need_resched;
+		} preempt;
+	};
+#else
 	int                     preempt_count;  /* 0=>preemptible, <0=>BUG */
+#endif
 	mm_segment_t		addr_limit;
 	/*
 	 * These stack pointers are overwritten on every system call or
@@ -50,6 +77,9 @@ struct thread_info {
 	long			kernel_sp;	/* Kernel stack pointer */
 	long			user_sp;	/* User stack pointer */
 	int			cpu;
+#ifdef CONFIG_SMP
+	unsigned long		percpu_offset;	/* __per_cpu_offset[cpu] */
+#endif
 };
 
 /*
@@ -82,13 +112,21 @@ struct thread_info {
 #define TIF_RESTORE_SIGMASK	4	/* restore signal mask in do_signal() */
 #define TIF_MEMDIE		5	/* is terminating due to OOM killer */
 #define TIF_SYSCALL_TRACEPOINT  6       /* syscall tracepoint instrumentation */
+#define TIF_UPROBE		7	/* breakpointed or single-stepping */
 
 #define _TIF_SYSCALL_TRACE	(1 << TIF_SYSCALL_TRACE)
 #define _TIF_NOTIFY_RESUME	(1 << TIF_NOTIFY_RESUME)
 #define _TIF_SIGPENDING		(1 << TIF_SIGPENDING)
 #define _TIF_NEED_RESCHED	(1 << TIF_NEED_RESCHED)
+#define _TIF_SYSCALL_TRACEPOINT	(1 << TIF_SYSCALL_TRACEPOINT)
+#define _TIF_UPROBE		(1 << TIF_UPROBE)
 
 #define _TIF_WORK_MASK \
-	(_TIF_NOTIFY_RESUME | _TIF_SIGPENDING | _TIF_NEED_RESCHED)
+	(_TIF_NOTIFY_RESUME | _TIF_SIGPENDING | _TIF_NEED_RESCHED | \
+	 _TIF_UPROBE)
+
+/* Work on syscall entry and exit, which sends a syscall off the fast path */
+#define _TIF_SYSCALL_WORK \
+	(_TIF_SYSCALL_TRACE | _TIF_SYSCALL_TRACEPOINT)
 
 #endif /* _ASM_RISCV_THREAD_INFO_H */
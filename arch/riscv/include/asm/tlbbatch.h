@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_TLBBATCH_H
+#define _ASM_RISCV_TLBBATCH_H
+
+#include <linux/cpumask.h>
+
+struct mm_struct;
+
+struct arch_tlbflush_unmap_batch {
+	/* Harts that may hold a TLB entry for one of the unmapped pages */
+	struct cpumask cpumask;
+	/* The only mm in this batch, or NULL once several have been added */
+	struct mm_struct *mm;
+	/* Smallest user address range covering every unmapped page */
+	unsigned long start;
+	unsigned long end;
+};
+
+#endif /* _ASM_RISCV_TLBBATCH_H */
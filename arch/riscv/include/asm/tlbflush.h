@@ -17,6 +17,8 @@
 
 #ifdef CONFIG_MMU
 
+#include <linux/mm_types.h>
+
 /* Flush entire local TLB */
 static inline void local_flush_tlb_all(void)
 {
@@ -29,35 +31,74 @@ static inline void local_flush_tlb_page(unsigned long addr)
 	__asm__ __volatile__ ("sfence.vma %0" : : "r" (addr) : "memory");
 }
 
+/* Flush all non-global entries tagged with one ASID from local TLB */
+static inline void local_flush_tlb_asid(unsigned long asid)
+{
+	__asm__ __volatile__ ("sfence.vma x0, %0" : : "r" (asid) : "memory");
+}
+
+static inline void local_flush_tlb_mm(struct mm_struct *mm)
+{
+	if (riscv_use_asid)
+		local_flush_tlb_asid(ASID(mm));
+	else
+		local_flush_tlb_all();
+}
+
+/*
+ * Ranges covering more than this many pages are flushed with a single
+ * full sfence.vma instead of one sfence.vma per page.
+ */
+extern unsigned long tlb_flush_ceiling;
+
+void local_flush_tlb_range(unsigned long start, unsigned long end);
+
 #ifndef CONFIG_SMP
 
 #define flush_tlb_all() local_flush_tlb_all()
+#define flush_tlb_mm(mm) local_flush_tlb_mm(mm)
 #define flush_tlb_page(vma, addr) local_flush_tlb_page(addr)
-#define flush_tlb_range(vma, start, end) local_flush_tlb_all()
+#define flush_tlb_range(vma, start, end) local_flush_tlb_range(start, end)
+#define flush_tlb_kernel_range(start, end) local_flush_tlb_range(start, end)
 
 #else /* CONFIG_SMP */
 
-#include <asm/sbi.h>
-
-#define flush_tlb_all() sbi_remote_sfence_vma(0, 0, -1)
-#define flush_tlb_page(vma, addr) flush_tlb_range(vma, addr, 0)
-#define flush_tlb_range(vma, start, end) \
-	sbi_remote_sfence_vma(0, start, (end) - (start))
+void flush_tlb_all(void);
+void flush_tlb_mm(struct mm_struct *mm);
+void flush_tlb_page(struct vm_area_struct *vma, unsigned long addr);
+void flush_tlb_range(struct vm_area_struct *vma, unsigned long start,
+		     unsigned long end);
+void flush_tlb_kernel_range(unsigned long start, unsigned long end);
 
-#endif /* CONFIG_SMP */
-
-/* Flush the TLB entries of the specified mm context */
-static inline void flush_tlb_mm(struct mm_struct *mm)
+/*
+ * Deferred flushing for page reclaim (see should_defer_flush() in
+ * mm/rmap.c).  The batch accumulates target harts and the address range
+ * of every unmapped page so that arch_tlbbatch_flush() can retire them
+ * all with a single SBI call.  This relies on a write through a clean
+ * TLB entry trapping once the PTE has been cleared, which holds both for
+ * software-managed A/D bits and for hardware that updates them atomically
+ * with the PTE walk.
+ */
+static inline void arch_tlbbatch_add_mm(struct arch_tlbflush_unmap_batch *batch,
+					struct mm_struct *mm,
+					unsigned long uaddr)
 {
-	flush_tlb_all();
+	if (cpumask_empty(&batch->cpumask)) {
+		batch->mm = mm;
+		batch->start = uaddr;
+		batch->end = uaddr + PAGE_SIZE;
+	} else {
+		if (batch->mm != mm)
+			batch->mm = NULL;
+		batch->start = min(batch->start, uaddr);
+		batch->end = max(batch->end, uaddr + PAGE_SIZE);
+	}
+	cpumask_or(&batch->cpumask, &batch->cpumask, mm_cpumask(mm));
 }
 
-/* Flush a range of kernel pages */
-static inline void flush_tlb_kernel_range(unsigned long start,
-	unsigned long end)
-{
-	flush_tlb_all();
-}
+void arch_tlbbatch_flush(struct arch_tlbflush_unmap_batch *batch);
+
+#endif /* CONFIG_SMP */
 
 #endif /* CONFIG_MMU */
 
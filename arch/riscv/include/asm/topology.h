@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_TOPOLOGY_H
+#define _ASM_RISCV_TOPOLOGY_H
+
+#ifdef CONFIG_SMP
+
+#include <linux/arch_topology.h>
+#include <linux/cpumask.h>
+
+struct cpu_topology {
+	int thread_id;
+	int core_id;
+	int cluster_id;
+	cpumask_t thread_sibling;
+	cpumask_t core_sibling;		/* The harts in the same cluster */
+	cpumask_t llc_sibling;		/* The harts sharing the last cache */
+};
+
+extern struct cpu_topology cpu_topology[NR_CPUS];
+
+#define topology_physical_package_id(cpu)	(cpu_topology[cpu].cluster_id)
+#define topology_core_id(cpu)		(cpu_topology[cpu].core_id)
+#define topology_core_cpumask(cpu)	(&cpu_topology[cpu].core_sibling)
+#define topology_sibling_cpumask(cpu)	(&cpu_topology[cpu].thread_sibling)
+
+void init_cpu_topology(void);
+void store_cpu_topology(unsigned int cpuid);
+const struct cpumask *cpu_coregroup_mask(int cpu);
+
+/* The capacity-dmips-mhz of each hart, and its current share of fmax */
+#define arch_scale_cpu_capacity topology_get_cpu_scale
+#define arch_scale_freq_capacity topology_get_freq_scale
+
+#endif /* CONFIG_SMP */
+
+#ifdef CONFIG_NUMA
+
+#include <asm/numa.h>
+
+/* PCI host bridges aren't attributed to nodes yet */
+#define pcibus_to_node(bus)	((void)(bus), NUMA_NO_NODE)
+#define cpumask_of_pcibus(bus)	((void)(bus), cpu_all_mask)
+
+#endif /* CONFIG_NUMA */
+
+#include <asm-generic/topology.h>
+
+#endif /* _ASM_RISCV_TOPOLOGY_H */
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM sbi
+
+#if !defined(_TRACE_SBI_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_SBI_H
+
+#include <linux/tracepoint.h>
+#include <asm/sbi.h>
+
+/* A timer, IPI or fence SBI call by the kernel, and the ticks it took */
+TRACE_EVENT(sbi_call,
+
+	TP_PROTO(unsigned int which, u64 cycles),
+
+	TP_ARGS(which, cycles),
+
+	TP_STRUCT__entry(
+		__field(	unsigned int,	which	)
+		__field(	u64,		cycles	)
+	),
+
+	TP_fast_assign(
+		__entry->which = which;
+		__entry->cycles = cycles;
+	),
+
+	TP_printk("call=%s cycles=%llu",
+		  __print_symbolic(__entry->which,
+				   { SBI_SET_TIMER, "set_timer" },
+				   { SBI_SEND_IPI, "send_ipi" },
+				   { SBI_REMOTE_FENCE_I, "remote_fence_i" },
+				   { SBI_REMOTE_SFENCE_VMA,
+				     "remote_sfence_vma" },
+				   { SBI_REMOTE_SFENCE_VMA_ASID,
+				     "remote_sfence_vma_asid" }),
+		  (unsigned long long)__entry->cycles) );
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#define TRACE_INCLUDE_FILE sbi
+#endif /*  _TRACE_SBI_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
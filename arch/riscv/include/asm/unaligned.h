@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_UNALIGNED_H
+#define _ASM_RISCV_UNALIGNED_H
+
+#include <asm-generic/unaligned.h>
+
+#ifndef __ASSEMBLY__
+
+#include <linux/jump_label.h>
+
+/*
+ * The kernel is built with -mstrict-align, so get_unaligned() and
+ * put_unaligned() go a byte at a time, which is right for harts that
+ * trap misaligned accesses to the firmware.  On harts found at boot to
+ * handle them at full speed, get_unaligned_fast() and
+ * put_unaligned_fast() issue a single load or store instead; they are
+ * meant for the hot paths of the decompressors, not as a general
+ * replacement.
+ */
+DECLARE_STATIC_KEY_FALSE(riscv_fast_misaligned_key);
+
+static __always_inline u16 __riscv_ldu16(const void *p)
+{
+	u16 v;
+
+	asm ("lhu %0, %1" : "=r" (v) : "m" (*(const u16 *)p));
+	return v;
+}
+
+/* lw sign-extends, which is how a u32 is kept in a register on rv64 */
+static __always_inline u32 __riscv_ldu32(const void *p)
+{
+	u32 v;
+
+	asm ("lw %0, %1" : "=r" (v) : "m" (*(const u32 *)p));
+	return v;
+}
+
+static __always_inline void __riscv_stu16(void *p, u16 v)
+{
+	asm ("sh %1, %0" : "=m" (*(u16 *)p) : "r" (v));
+}
+
+static __always_inline void __riscv_stu32(void *p, u32 v)
+{
+	asm ("sw %1, %0" : "=m" (*(u32 *)p) : "r" (v));
+}
+
+#ifdef CONFIG_64BIT
+static __always_inline u64 __riscv_ldu64(const void *p)
+{
+	u64 v;
+
+	asm ("ld %0, %1" : "=r" (v) : "m" (*(const u64 *)p));
+	return v;
+}
+
+static __always_inline void __riscv_stu64(void *p, u64 v)
+{
+	asm ("sd %1, %0" : "=m" (*(u64 *)p) : "r" (v));
+}
+#else
+#define __riscv_ldu64(p)	get_unaligned((const u64 *)(p))
+#define __riscv_stu64(p, v)	put_unaligned(v, (u64 *)(p))
+#endif
+
+#define __riscv_get_misaligned(ptr) ((__force typeof(*(ptr)))(		\
+	__builtin_choose_expr(sizeof(*(ptr)) == 1, *(ptr),		\
+	__builtin_choose_expr(sizeof(*(ptr)) == 2, __riscv_ldu16(ptr),	\
+	__builtin_choose_expr(sizeof(*(ptr)) == 4, __riscv_ldu32(ptr),	\
+	__builtin_choose_expr(sizeof(*(ptr)) == 8, __riscv_ldu64(ptr),	\
+	__bad_unaligned_access_size()))))))
+
+#define __riscv_put_misaligned(val, ptr) do {				\
+	void *__gu_p = (ptr);						\
+	switch (sizeof(*(ptr))) {					\
+	case 1:								\
+		*(u8 *)__gu_p = (__force u8)(val);			\
+		break;							\
+	case 2:								\
+		__riscv_stu16(__gu_p, (__force u16)(val));		\
+		break;							\
+	case 4:								\
+		__riscv_stu32(__gu_p, (__force u32)(val));		\
+		break;							\
+	case 8:								\
+		__riscv_stu64(__gu_p, (__force u64)(val));		\
+		break;							\
+	default:							\
+		__bad_unaligned_access_size();				\
+		break;							\
+	}								\
+} while (0)
+
+#define get_unaligned_fast(ptr)						\
+	(static_branch_likely(&riscv_fast_misaligned_key) ?		\
+	 __riscv_get_misaligned(ptr) : get_unaligned(ptr))
+
+#define put_unaligned_fast(val, ptr) do {				\
+	if (static_branch_likely(&riscv_fast_misaligned_key))		\
+		__riscv_put_misaligned(val, ptr);			\
+	else								\
+		put_unaligned(val, ptr);				\
+} while (0)
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* _ASM_RISCV_UNALIGNED_H */
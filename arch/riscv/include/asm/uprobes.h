@@ -0,0 +1,54 @@
+/*
+ * Based on arch/arm64/include/asm/uprobes.h
+ *
+ * Copyright (C) 2014-2016 Pratyush Anand <panand@redhat.com>
+ * Copyright (C) 2017 SiFive
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _ASM_RISCV_UPROBES_H
+#define _ASM_RISCV_UPROBES_H
+
+#include <asm/bug.h>
+#include <asm/probes.h>
+
+#define MAX_UINSN_BYTES		4
+
+/*
+ * The breakpoint must not be longer than the shortest instruction it may
+ * replace, so with RVC user code it has to be c.ebreak.
+ */
+#ifdef CONFIG_RISCV_ISA_C
+#define UPROBE_SWBP_INSN	__BUG_INSN_16
+#define UPROBE_SWBP_INSN_SIZE	2
+typedef u16 uprobe_opcode_t;
+#else
+#define UPROBE_SWBP_INSN	__BUG_INSN_32
+#define UPROBE_SWBP_INSN_SIZE	4
+typedef u32 uprobe_opcode_t;
+#endif
+
+/* The XOL slot is the probed instruction followed by an ebreak */
+#define UPROBE_XOL_SLOT_BYTES	(MAX_UINSN_BYTES + 4)
+
+struct arch_uprobe_task {
+	unsigned long saved_cause;
+};
+
+struct arch_uprobe {
+	union {
+		u8 insn[MAX_UINSN_BYTES];
+		u8 ixol[UPROBE_XOL_SLOT_BYTES];
+	};
+	struct arch_probe_insn api;
+	unsigned long insn_size;
+	bool simulate;
+};
+
+bool uprobe_breakpoint_handler(struct pt_regs *regs);
+bool uprobe_single_step_handler(struct pt_regs *regs);
+
+#endif /* _ASM_RISCV_UPROBES_H */
@@ -20,10 +20,37 @@
 #define _ASM_RISCV_VDSO_H
 
 #include <linux/types.h>
+#include <asm/hwprobe.h>
 
+/*
+ * The vDSO data page, published by update_vsyscall() and read locklessly
+ * by the vDSO time functions under the tb_seq_count sequence counter.
+ */
 struct vdso_data {
+	__u64 cs_cycle_last;	/* Timebase at last timekeeper update */
+	__u64 cs_mask;		/* Clocksource mask */
+	__u64 raw_time_sec;	/* Raw time */
+	__u64 raw_time_nsec;
+	__u64 xtime_clock_sec;	/* Kernel time */
+	__u64 xtime_clock_nsec;
+	__u64 xtime_coarse_sec;	/* Coarse time */
+	__u64 xtime_coarse_nsec;
+	__u64 wtm_clock_sec;	/* Wall to monotonic time */
+	__u64 wtm_clock_nsec;
+	__u32 tb_seq_count;	/* Timebase sequence counter */
+	__u32 cs_mono_mult;	/* NTP-adjusted clocksource multiplier */
+	__u32 cs_shift;		/* Clocksource shift (mono = raw) */
+	__u32 cs_raw_mult;	/* Raw clocksource multiplier */
+	__u32 tz_minuteswest;	/* Whacky timezone stuff */
+	__u32 tz_dsttime;
+	__u32 use_syscall;	/* Clocksource can't be read from userspace */
+	__u32 hrtimer_res;	/* Resolution of the high-resolution clocks */
+	__u32 hwprobe_ready;	/* hwprobe[] is filled in */
+	__u64 hwprobe[RISCV_HWPROBE_MAX_KEY + 1]; /* For every CPU */
 };
 
+extern struct vdso_data *vdso_data;
+
 /*
  * The VDSO symbols are mapped into Linux so we can just use regular symbol
  * addressing to get their offsets in userspace.  The symbols are mapped at an
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _ASM_RISCV_VECTOR_H
+#define _ASM_RISCV_VECTOR_H
+
+#include <linux/preempt.h>
+#include <linux/types.h>
+
+#include <asm/hwcap.h>
+#include <asm/ptrace.h>
+
+struct task_struct;
+
+/* Size of the vector register file, vlenb * 32 bytes */
+extern unsigned long riscv_v_vsize;
+
+static inline bool has_vector(void)
+{
+	return elf_hwcap & COMPAT_HWCAP_ISA_V;
+}
+
+extern void __vstate_save(struct __riscv_v_ext_state *state, void *datap);
+extern void __vstate_restore(struct __riscv_v_ext_state *state, void *datap);
+
+void riscv_v_setup_vsize(void);
+bool riscv_v_first_use_handler(struct pt_regs *regs);
+int riscv_v_thread_alloc(struct task_struct *tsk);
+void riscv_v_thread_free(struct task_struct *tsk);
+void riscv_v_vstate_save(struct task_struct *tsk, struct pt_regs *regs);
+
+/* The softirq save areas are allocated at boot, see kernel_mode_fpu.c */
+extern bool riscv_v_softirq_ready;
+
+/*
+ * The kernel may only use the vector unit between these two, which
+ * disable preemption and nest.  Softirqs may use it too, but never
+ * hardirqs.
+ */
+static inline bool may_use_vector(void)
+{
+	if (!has_vector() || in_irq() || in_nmi())
+		return false;
+
+	return !in_serving_softirq() || riscv_v_softirq_ready;
+}
+
+void kernel_vector_begin(void);
+void kernel_vector_end(void);
+
+#endif /* _ASM_RISCV_VECTOR_H */
@@ -44,9 +44,22 @@ static inline unsigned long create_zero_mask(unsigned long bits)
 	return bits >> 7;
 }
 
+/*
+ * There is no count-leading-zeros instruction in the base ISA, so
+ * fls64() would be a loop.  Count the bytes of the mask with a multiply
+ * instead, as asm-generic/word-at-a-time.h does.
+ */
 static inline unsigned long find_zero(unsigned long mask)
 {
-	return fls64(mask) >> 3;
+#ifdef CONFIG_64BIT
+	return mask * 0x0001020304050608ul >> 56;
+#else
+	/* (000000 0000ff 00ffff ffffff) -> ( 1 1 2 3 ) */
+	unsigned long a = (0x0ff0001 + mask) >> 23;
+
+	/* Fix the 1 for 00 case */
+	return a & mask;
+#endif
 }
 
 /* The mask we created is directly usable as a bytemask */
@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _UAPI_ASM_RISCV_CACHECTL_H
+#define _UAPI_ASM_RISCV_CACHECTL_H
+
+/*
+ * Flags for riscv_flush_icache(2).  By default the flush is seen by all
+ * threads of the process; with LOCAL only the calling thread needs to
+ * see it.
+ */
+#define SYS_RISCV_FLUSH_ICACHE_LOCAL	1UL
+#define SYS_RISCV_FLUSH_ICACHE_ALL	(SYS_RISCV_FLUSH_ICACHE_LOCAL)
+
+#endif /* _UAPI_ASM_RISCV_CACHECTL_H */
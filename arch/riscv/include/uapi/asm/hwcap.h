@@ -32,5 +32,19 @@
 #define COMPAT_HWCAP_ISA_F	(1 << ('F' - 'A'))
 #define COMPAT_HWCAP_ISA_D	(1 << ('D' - 'A'))
 #define COMPAT_HWCAP_ISA_C	(1 << ('C' - 'A'))
+#define COMPAT_HWCAP_ISA_V	(1 << ('V' - 'A'))
+
+/*
+ * The multi-letter extensions in AT_HWCAP2.  Like the single letters in
+ * AT_HWCAP, a bit is only set when every hart has the extension.
+ */
+#define COMPAT_HWCAP2_ISA_ZBB	(1 << 0)
+#define COMPAT_HWCAP2_ISA_ZBC	(1 << 1)
+#define COMPAT_HWCAP2_ISA_ZBKB	(1 << 2)
+#define COMPAT_HWCAP2_ISA_ZBKC	(1 << 3)
+#define COMPAT_HWCAP2_ISA_ZKND	(1 << 4)
+#define COMPAT_HWCAP2_ISA_ZKNE	(1 << 5)
+#define COMPAT_HWCAP2_ISA_ZKNH	(1 << 6)
+#define COMPAT_HWCAP2_ISA_ZACAS	(1 << 7)
 
 #endif
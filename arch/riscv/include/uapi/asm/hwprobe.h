@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _UAPI_ASM_RISCV_HWPROBE_H
+#define _UAPI_ASM_RISCV_HWPROBE_H
+
+#include <linux/types.h>
+
+/*
+ * The pairs passed to riscv_hwprobe.  The caller fills in the keys and
+ * the kernel the values, for what all of the CPUs asked about have in
+ * common; a key the kernel doesn't know comes back as -1 with a value of
+ * 0.  New keys are only ever added, so old binaries keep working.
+ */
+struct riscv_hwprobe {
+	__s64 key;
+	__u64 value;
+};
+
+/* Set if the IMA base described in the user-level ISA spec is there */
+#define RISCV_HWPROBE_KEY_BASE_BEHAVIOR	0
+#define		RISCV_HWPROBE_BASE_BEHAVIOR_IMA	(1 << 0)
+
+/* Extensions on top of RISCV_HWPROBE_BASE_BEHAVIOR_IMA */
+#define RISCV_HWPROBE_KEY_IMA_EXT_0	1
+#define		RISCV_HWPROBE_IMA_FD		(1 << 0)
+#define		RISCV_HWPROBE_IMA_C		(1 << 1)
+#define		RISCV_HWPROBE_IMA_V		(1 << 2)
+#define		RISCV_HWPROBE_EXT_ZBB		(1 << 3)
+#define		RISCV_HWPROBE_EXT_ZBC		(1 << 4)
+#define		RISCV_HWPROBE_EXT_ZBKB		(1 << 5)
+#define		RISCV_HWPROBE_EXT_ZBKC		(1 << 6)
+#define		RISCV_HWPROBE_EXT_ZKND		(1 << 7)
+#define		RISCV_HWPROBE_EXT_ZKNE		(1 << 8)
+#define		RISCV_HWPROBE_EXT_ZKNH		(1 << 9)
+#define		RISCV_HWPROBE_EXT_ZACAS		(1 << 10)
+
+/* How misaligned loads and stores perform */
+#define RISCV_HWPROBE_KEY_CPUPERF_0	2
+#define		RISCV_HWPROBE_MISALIGNED_UNKNOWN	(0 << 0)
+#define		RISCV_HWPROBE_MISALIGNED_SLOW		(2 << 0)
+#define		RISCV_HWPROBE_MISALIGNED_FAST		(3 << 0)
+#define		RISCV_HWPROBE_MISALIGNED_MASK		(7 << 0)
+
+/* The width of a vector register in bytes, or 0 without V */
+#define RISCV_HWPROBE_KEY_VLENB		3
+
+#endif /* _UAPI_ASM_RISCV_HWPROBE_H */
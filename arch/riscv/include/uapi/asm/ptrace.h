@@ -85,6 +85,29 @@ union __riscv_fp_state {
 	struct __riscv_q_ext_state q;
 };
 
+/*
+ * The vector unit's CSRs, followed in memory by its 32 registers (vlenb
+ * bytes each) at datap.  This is how the state appears in a signal frame.
+ */
+struct __riscv_v_ext_state {
+	unsigned long vstart;
+	unsigned long vl;
+	unsigned long vtype;
+	unsigned long vcsr;
+	unsigned long vlenb;
+	void *datap;
+};
+
+/* The NT_RISCV_VECTOR regset: the registers follow the CSRs directly */
+struct __riscv_v_regset_state {
+	unsigned long vstart;
+	unsigned long vl;
+	unsigned long vtype;
+	unsigned long vcsr;
+	unsigned long vlenb;
+	char vreg[];
+};
+
 #endif /* __ASSEMBLY__ */
 
 #endif /* _UAPI_ASM_RISCV_PTRACE_H */
@@ -16,6 +16,30 @@
 
 #include <asm/ptrace.h>
 
+/* Terminates the list of extension contexts */
+#define END_MAGIC	0x0
+#define END_HDR_SIZE	0x0
+
+/* struct __riscv_v_ext_state, followed by the vector registers */
+#define RISCV_V_MAGIC	0x53465457
+
+struct __riscv_ctx_hdr {
+	__u32 magic;
+	__u32 size;	/* Including this header */
+};
+
+/*
+ * The last two reserved words of the Q state hold the header of the first
+ * extension context.  Each context runs on from its header, past the end
+ * of the sigcontext, and the next header follows it.
+ */
+struct __riscv_extra_ext_header {
+	__u32 __padding[129] __attribute__((aligned(16)));
+	/* Reserved, and so currently zeroed and must be zero on sigreturn */
+	__u32 reserved;
+	struct __riscv_ctx_hdr hdr;
+};
+
 /*
  * Signal context structure
  *
@@ -24,7 +48,10 @@
  */
 struct sigcontext {
 	struct user_regs_struct sc_regs;
-	union __riscv_fp_state sc_fpregs;
+	union {
+		union __riscv_fp_state sc_fpregs;
+		struct __riscv_extra_ext_header sc_extdesc;
+	};
 };
 
 #endif /* _UAPI_ASM_RISCV_SIGCONTEXT_H */
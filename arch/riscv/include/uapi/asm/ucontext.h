@@ -21,6 +21,13 @@
 
 #include <linux/types.h>
 
+/*
+ * uc_flags: set when the task hadn't used the FP registers since exec.
+ * sc_fpregs is then left as it was, and sigreturn puts the FP state back
+ * to its all-zero initial value instead of reading it from there.
+ */
+#define UC_FP_INITIAL	0x1
+
 struct ucontext {
 	unsigned long	  uc_flags;
 	struct ucontext	 *uc_link;
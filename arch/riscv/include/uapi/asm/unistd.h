@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+/*
+ * No include guard: the syscall table includes this again with its own
+ * __SYSCALL, as with asm-generic/unistd.h.
+ */
+#include <asm-generic/unistd.h>
+
+/*
+ * Userspace can run fence.i itself, but that only reaches the hart it
+ * happens to be on, and the kernel may move its threads to any other.
+ * JITs call this after writing code instead, and only the harts running
+ * the process are fenced.  The range is currently unused and flushed as
+ * a whole; the flags are in asm/cachectl.h.
+ */
+#define __NR_riscv_flush_icache (__NR_arch_specific_syscall + 15)
+__SYSCALL(__NR_riscv_flush_icache, sys_riscv_flush_icache)
+
+/*
+ * Which extensions and properties a set of CPUs all have, for libraries
+ * picking an implementation at load time; see asm/hwprobe.h for the
+ * keys.  The vDSO answers the common case, for every CPU, itself.
+ */
+#define __NR_riscv_hwprobe (__NR_arch_specific_syscall + 14)
+__SYSCALL(__NR_riscv_hwprobe, sys_riscv_hwprobe)
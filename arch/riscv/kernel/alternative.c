@@ -0,0 +1,71 @@
+/*
+ * Boot-time instruction patching by ISA extension
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <asm/alternative.h>
+#include <asm/cacheflush.h>
+#include <asm/hwcap.h>
+
+extern struct alt_entry __alt_start[], __alt_end[];
+
+/*
+ * Only the boot hart is known to have been probed, and the others are
+ * assumed to match it: riscv_isa_extension_available() says what the
+ * boot hart has.  The sites to patch are still writable in both cases,
+ * so they are simply overwritten.
+ */
+static unsigned int apply_alternatives(struct alt_entry *begin,
+				       struct alt_entry *end)
+{
+	struct alt_entry *alt;
+	unsigned int patched = 0;
+
+	for (alt = begin; alt < end; alt++) {
+		if (!riscv_isa_extension_available(alt->ext))
+			continue;
+
+		memcpy(alt->old_ptr, alt->alt_ptr, alt->len);
+		patched++;
+	}
+
+	return patched;
+}
+
+/*
+ * Runs from setup_arch(), once the ISA string has been parsed and before
+ * the other harts are started or the kernel text is made read-only, so
+ * only this hart's instruction cache needs flushing.
+ */
+void __init apply_boot_alternatives(void)
+{
+	unsigned int patched = apply_alternatives(__alt_start, __alt_end);
+
+	local_flush_icache_all();
+
+	if (patched)
+		pr_info("alternatives: patched %u sites\n", patched);
+}
+
+/*
+ * Called from module_finalize(), before the module's text is made
+ * read-only.  The module loader flushes the instruction caches once
+ * we're done.
+ */
+void apply_module_alternatives(void *start, size_t len)
+{
+	apply_alternatives(start, start + len);
+}
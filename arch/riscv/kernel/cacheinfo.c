@@ -16,20 +16,67 @@
 #include <linux/of.h>
 #include <linux/of_device.h>
 
+/*
+ * A cache's id is the lowest numbered hart it serves, which is unique
+ * among the caches of one type and level: the L1 caches described on a
+ * hart's own node get that hart's id.
+ */
+static unsigned int cache_node_id(struct device_node *cache)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct device_node *np = of_cpu_device_node_get(cpu);
+
+		while (np && np != cache) {
+			struct device_node *next = of_find_next_cache_node(np);
+
+			of_node_put(np);
+			np = next;
+		}
+
+		of_node_put(np);
+		if (np)
+			return cpu;
+	}
+
+	return 0;
+}
+
+/*
+ * The size, line size, sets and ways, and which harts share the cache,
+ * are all read from node by the generic cacheinfo code.  Allocation and
+ * write policies have no DT binding: assume the usual write-back,
+ * allocate on both reads and writes, which an instruction cache only
+ * does on reads.
+ */
 static void ci_leaf_init(struct cacheinfo *this_leaf,
 			 struct device_node *node,
 			 enum cache_type type, unsigned int level)
 {
-	this_leaf->of_node = node;
+	this_leaf->of_node = of_node_get(node);
 	this_leaf->level = level;
 	this_leaf->type = type;
+	this_leaf->id = cache_node_id(node);
 	/* not a sector cache */
 	this_leaf->physical_line_partition = 1;
-	/* TODO: Add to DTS */
-	this_leaf->attributes =
-		CACHE_WRITE_BACK
-		| CACHE_READ_ALLOCATE
-		| CACHE_WRITE_ALLOCATE;
+	if (type == CACHE_TYPE_INST)
+		this_leaf->attributes = CACHE_ID | CACHE_READ_ALLOCATE;
+	else
+		this_leaf->attributes =
+			CACHE_ID
+			| CACHE_WRITE_BACK
+			| CACHE_READ_ALLOCATE
+			| CACHE_WRITE_ALLOCATE;
+}
+
+/* Like of_find_next_cache_node(), but dropping the reference to np */
+static struct device_node *next_cache_node(struct device_node *np)
+{
+	struct device_node *next = of_find_next_cache_node(np);
+
+	of_node_put(np);
+	return next;
 }
 
 static int __init_cache_level(unsigned int cpu)
@@ -47,7 +94,7 @@ static int __init_cache_level(unsigned int cpu)
 	if (leaves > 0)
 		levels = 1;
 
-	while ((np = of_find_next_cache_node(np))) {
+	while ((np = next_cache_node(np))) {
 		if (!of_device_is_compatible(np, "cache"))
 			break;
 		if (of_property_read_u32(np, "cache-level", &level))
@@ -62,6 +109,7 @@ static int __init_cache_level(unsigned int cpu)
 			++leaves;
 		levels = level;
 	}
+	of_node_put(np);
 
 	this_cpu_ci->num_levels = levels;
 	this_cpu_ci->num_leaves = leaves;
@@ -82,7 +130,7 @@ static int __populate_cache_leaves(unsigned int cpu)
 	if (of_property_read_bool(np, "d-cache-size"))
 		ci_leaf_init(this_leaf++, np, CACHE_TYPE_DATA, level);
 
-	while ((np = of_find_next_cache_node(np))) {
+	while ((np = next_cache_node(np))) {
 		if (!of_device_is_compatible(np, "cache"))
 			break;
 		if (of_property_read_u32(np, "cache-level", &level))
@@ -97,6 +145,7 @@ static int __populate_cache_leaves(unsigned int cpu)
 			ci_leaf_init(this_leaf++, np, CACHE_TYPE_DATA, level);
 		levels = level;
 	}
+	of_node_put(np);
 
 	return 0;
 }
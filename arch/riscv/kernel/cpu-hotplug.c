@@ -0,0 +1,69 @@
+/*
+ * CPU hotplug
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/cpu.h>
+#include <linux/err.h>
+#include <linux/irq.h>
+#include <linux/kernel.h>
+#include <linux/sched/hotplug.h>
+
+#include <asm/cpu_ops.h>
+#include <asm/smp.h>
+
+/* Run on the CPU going down, with interrupts disabled */
+int __cpu_disable(void)
+{
+	unsigned int cpu = smp_processor_id();
+
+	if (!cpu_ops->cpu_stop)
+		return -EOPNOTSUPP;
+
+	/*
+	 * The hart only looked at its mailbox on the way up: empty it before
+	 * reporting our death, so that a restart can't see the old task.
+	 */
+	WRITE_ONCE(__cpu_up_stack_pointer[cpu], NULL);
+	WRITE_ONCE(__cpu_up_task_pointer[cpu], NULL);
+
+	set_cpu_online(cpu, false);
+	irq_migrate_all_off_this_cpu();
+	return 0;
+}
+
+/* Run on the CPU doing the hotplug, once the other has left the idle loop */
+void __cpu_die(unsigned int cpu)
+{
+	if (!cpu_wait_death(cpu, 5)) {
+		pr_err("CPU%u: didn't die\n", cpu);
+		return;
+	}
+	pr_notice("CPU%u: off\n", cpu);
+
+	if (cpu_ops->cpu_is_stopped && !cpu_ops->cpu_is_stopped(cpu))
+		pr_warn("CPU%u: the firmware still has the hart running\n",
+			cpu);
+}
+
+/* Called from the idle loop of the CPU going down: never returns */
+void arch_cpu_idle_dead(void)
+{
+	idle_task_exit();
+	local_irq_disable();
+
+	(void)cpu_report_death();
+
+	cpu_ops->cpu_stop();
+	BUG();
+}
@@ -0,0 +1,132 @@
+/*
+ * Starting and stopping secondary harts
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/errno.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/smp.h>
+
+#include <asm/cpu_ops.h>
+#include <asm/processor.h>
+#include <asm/sbi.h>
+
+const struct cpu_operations *cpu_ops __ro_after_init;
+
+void *__cpu_up_stack_pointer[NR_CPUS];
+void *__cpu_up_task_pointer[NR_CPUS];
+unsigned long __cpu_up_ready_time[NR_CPUS];
+
+/*
+ * Without the HSM extension every hart enters the kernel at boot, and
+ * all but one of them spin in head.S until their entry here says which
+ * CPU they are, plus one.  It is indexed by hart ID, so harts with an ID
+ * past NR_CPUS are parked.
+ */
+unsigned long __cpu_spinwait_cpuid[NR_CPUS];
+
+static int spinwait_cpu_start(unsigned int cpu)
+{
+	unsigned long hartid = cpuid_to_hartid_map(cpu);
+
+	if (hartid >= NR_CPUS)
+		return -EINVAL;
+
+	WRITE_ONCE(__cpu_spinwait_cpuid[hartid], cpu + 1);
+	return 0;
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+/*
+ * There's no handing the hart back to the firmware: wait as head.S does,
+ * but from here, and restart the way it would.
+ */
+static void spinwait_cpu_stop(void)
+{
+	unsigned int cpu = smp_processor_id();
+	void *sp, *tp;
+
+	do {
+		cpu_relax();
+		sp = READ_ONCE(__cpu_up_stack_pointer[cpu]);
+		tp = READ_ONCE(__cpu_up_task_pointer[cpu]);
+	} while (!sp || !tp);
+	smp_rmb();
+
+	__asm__ __volatile__ (
+		"mv sp, %0\n"
+		"mv tp, %1\n"
+		"tail smp_callin"
+		: : "r" (sp), "r" (tp));
+	unreachable();
+}
+#endif /* CONFIG_HOTPLUG_CPU */
+
+static const struct cpu_operations cpu_ops_spinwait = {
+	.name		= "spinwait",
+	.cpu_start	= spinwait_cpu_start,
+#ifdef CONFIG_HOTPLUG_CPU
+	.cpu_stop	= spinwait_cpu_stop,
+#endif
+};
+
+/* In head.S: takes the CPU number in a1 */
+asmlinkage void secondary_start_sbi(void);
+
+static int sbi_cpu_start(unsigned int cpu)
+{
+	unsigned long hartid = cpuid_to_hartid_map(cpu);
+
+	if (sbi_hsm_hart_start(hartid, __pa_symbol(secondary_start_sbi), cpu))
+		return -EIO;
+	return 0;
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+static void sbi_cpu_stop(void)
+{
+	long ret = sbi_hsm_hart_stop();
+
+	pr_crit("CPU%d: unable to stop the hart: %ld\n",
+		smp_processor_id(), ret);
+	while (1)
+		wait_for_interrupt();
+}
+
+static int sbi_cpu_is_stopped(unsigned int cpu)
+{
+	unsigned long hartid = cpuid_to_hartid_map(cpu);
+
+	return sbi_hsm_hart_status(hartid) == SBI_HSM_HART_STATUS_STOPPED;
+}
+#endif /* CONFIG_HOTPLUG_CPU */
+
+static const struct cpu_operations cpu_ops_sbi = {
+	.name		= "sbi",
+	.cpu_start	= sbi_cpu_start,
+#ifdef CONFIG_HOTPLUG_CPU
+	.cpu_stop	= sbi_cpu_stop,
+	.cpu_is_stopped	= sbi_cpu_is_stopped,
+#endif
+};
+
+void __init cpu_set_ops(void)
+{
+	if (sbi_probe_extension(SBI_EXT_HSM) > 0)
+		cpu_ops = &cpu_ops_sbi;
+	else
+		cpu_ops = &cpu_ops_spinwait;
+
+	pr_info("SMP: starting harts through %s\n", cpu_ops->name);
+}
@@ -17,45 +17,233 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/bitmap.h>
+#include <linux/export.h>
+#include <linux/init.h>
+#include <linux/jump_label.h>
 #include <linux/of.h>
+#include <linux/string.h>
+#include <asm/asm.h>
 #include <asm/processor.h>
 #include <asm/hwcap.h>
+#include <asm/hwprobe.h>
+#include <asm/smp.h>
+#include <asm/timex.h>
+#include <asm/vector.h>
 
 unsigned long elf_hwcap __read_mostly;
+EXPORT_SYMBOL_GPL(elf_hwcap);
+unsigned long elf_hwcap2 __read_mostly;
+bool riscv_fast_misaligned_access __read_mostly;
+DEFINE_STATIC_KEY_FALSE(riscv_fast_misaligned_key);
+EXPORT_SYMBOL_GPL(riscv_fast_misaligned_key);
 
-void riscv_fill_hwcap(void)
+/* What every hart has, which is all a thread can rely on as it migrates */
+static DECLARE_BITMAP(riscv_isa_ext, RISCV_ISA_EXT_MAX) __read_mostly;
+
+struct riscv_isainfo hart_isa[NR_CPUS] __read_mostly;
+
+static const char * const riscv_isa_ext_names[RISCV_ISA_EXT_MAX] = {
+	[RISCV_ISA_EXT_ZBB]	= "zbb",
+	[RISCV_ISA_EXT_ZBC]	= "zbc",
+	[RISCV_ISA_EXT_ZBKB]	= "zbkb",
+	[RISCV_ISA_EXT_ZBKC]	= "zbkc",
+	[RISCV_ISA_EXT_ZKND]	= "zknd",
+	[RISCV_ISA_EXT_ZKNE]	= "zkne",
+	[RISCV_ISA_EXT_ZKNH]	= "zknh",
+	[RISCV_ISA_EXT_SVPBMT]	= "svpbmt",
+	[RISCV_ISA_EXT_ZICBOM]	= "zicbom",
+	[RISCV_ISA_EXT_H]	= "h",
+	[RISCV_ISA_EXT_ZACAS]	= "zacas",
+	[RISCV_ISA_EXT_SVADU]	= "svadu",
+	[RISCV_ISA_EXT_ZICBOZ]	= "zicboz",
+};
+
+/* The extensions in AT_HWCAP2: the others aren't for user programs */
+static const unsigned long isa_ext2hwcap2[RISCV_ISA_EXT_MAX] = {
+	[RISCV_ISA_EXT_ZBB]	= COMPAT_HWCAP2_ISA_ZBB,
+	[RISCV_ISA_EXT_ZBC]	= COMPAT_HWCAP2_ISA_ZBC,
+	[RISCV_ISA_EXT_ZBKB]	= COMPAT_HWCAP2_ISA_ZBKB,
+	[RISCV_ISA_EXT_ZBKC]	= COMPAT_HWCAP2_ISA_ZBKC,
+	[RISCV_ISA_EXT_ZKND]	= COMPAT_HWCAP2_ISA_ZKND,
+	[RISCV_ISA_EXT_ZKNE]	= COMPAT_HWCAP2_ISA_ZKNE,
+	[RISCV_ISA_EXT_ZKNH]	= COMPAT_HWCAP2_ISA_ZKNH,
+	[RISCV_ISA_EXT_ZACAS]	= COMPAT_HWCAP2_ISA_ZACAS,
+};
+
+bool riscv_isa_extension_available(unsigned int ext)
+{
+	return ext < RISCV_ISA_EXT_MAX && test_bit(ext, riscv_isa_ext);
+}
+EXPORT_SYMBOL_GPL(riscv_isa_extension_available);
+
+static void riscv_parse_isa_ext(const char *ext, size_t len,
+				unsigned long *isa_ext)
 {
-	struct device_node *node;
-	const char *isa;
 	size_t i;
-	static unsigned long isa2hwcap[256] = {0};
 
-	isa2hwcap['i'] = isa2hwcap['I'] = COMPAT_HWCAP_ISA_I;
-	isa2hwcap['m'] = isa2hwcap['M'] = COMPAT_HWCAP_ISA_M;
-	isa2hwcap['a'] = isa2hwcap['A'] = COMPAT_HWCAP_ISA_A;
-	isa2hwcap['f'] = isa2hwcap['F'] = COMPAT_HWCAP_ISA_F;
-	isa2hwcap['d'] = isa2hwcap['D'] = COMPAT_HWCAP_ISA_D;
-	isa2hwcap['c'] = isa2hwcap['C'] = COMPAT_HWCAP_ISA_C;
+	/* Zk and Zkn name the whole NIST scalar crypto suite */
+	if ((len == 2 && !strncasecmp(ext, "zk", 2)) ||
+	    (len == 3 && !strncasecmp(ext, "zkn", 3))) {
+		__set_bit(RISCV_ISA_EXT_ZBKB, isa_ext);
+		__set_bit(RISCV_ISA_EXT_ZBKC, isa_ext);
+		__set_bit(RISCV_ISA_EXT_ZKND, isa_ext);
+		__set_bit(RISCV_ISA_EXT_ZKNE, isa_ext);
+		__set_bit(RISCV_ISA_EXT_ZKNH, isa_ext);
+		return;
+	}
 
-	elf_hwcap = 0;
+	for (i = 0; i < RISCV_ISA_EXT_MAX; i++) {
+		if (strlen(riscv_isa_ext_names[i]) == len &&
+		    !strncasecmp(ext, riscv_isa_ext_names[i], len))
+			__set_bit(i, isa_ext);
+	}
+}
+
+static void riscv_parse_isa(const char *isa, struct riscv_isainfo *info)
+{
+	static unsigned long isa2hwcap[256] = {
+		['i'] = COMPAT_HWCAP_ISA_I, ['I'] = COMPAT_HWCAP_ISA_I,
+		['m'] = COMPAT_HWCAP_ISA_M, ['M'] = COMPAT_HWCAP_ISA_M,
+		['a'] = COMPAT_HWCAP_ISA_A, ['A'] = COMPAT_HWCAP_ISA_A,
+		['f'] = COMPAT_HWCAP_ISA_F, ['F'] = COMPAT_HWCAP_ISA_F,
+		['d'] = COMPAT_HWCAP_ISA_D, ['D'] = COMPAT_HWCAP_ISA_D,
+		['c'] = COMPAT_HWCAP_ISA_C, ['C'] = COMPAT_HWCAP_ISA_C,
+		['v'] = COMPAT_HWCAP_ISA_V, ['V'] = COMPAT_HWCAP_ISA_V,
+	};
+
+	info->hwcap = 0;
+	bitmap_zero(info->isa, RISCV_ISA_EXT_MAX);
 
 	/*
-	 * We don't support running Linux on hertergenous ISA systems.  For
-	 * now, we just check the ISA of the first processor.
+	 * Skip the "rv32"/"rv64" prefix, whose 'v' isn't the vector
+	 * extension, and stop at the multi-letter extensions, which start
+	 * with 's', 'x' or 'z' and are separated by underscores.
 	 */
-	node = of_find_node_by_type(NULL, "cpu");
-	if (!node) {
-		pr_warning("Unable to find \"cpu\" devicetree entry");
-		return;
+	if (strlen(isa) >= 4 && !strncasecmp(isa, "rv", 2))
+		isa += 4;
+	for (; *isa && !strchr("_sSxXzZ", *isa); isa++) {
+		info->hwcap |= isa2hwcap[(unsigned char)*isa];
+		if (*isa == 'h' || *isa == 'H')
+			__set_bit(RISCV_ISA_EXT_H, info->isa);
+	}
+
+	while (*isa) {
+		const char *end = strchrnul(isa, '_');
+
+		riscv_parse_isa_ext(isa, end - isa, info->isa);
+		isa = *end ? end + 1 : end;
+	}
+}
+
+/*
+ * Each hart's ISA is kept in hart_isa[] for riscv_hwprobe, which can be
+ * asked about any set of them.  elf_hwcap, elf_hwcap2 and the extensions
+ * the kernel patches itself for are what all of them have in common.
+ */
+void riscv_fill_hwcap(void)
+{
+	struct device_node *node = NULL;
+	bool found = false;
+	unsigned int i;
+
+	elf_hwcap = ~0UL;
+	bitmap_fill(riscv_isa_ext, RISCV_ISA_EXT_MAX);
+
+	while ((node = of_find_node_by_type(node, "cpu"))) {
+		struct riscv_isainfo *info;
+		const char *isa;
+		int hart, cpu;
+
+		/* This checks for a riscv,isa property too */
+		hart = riscv_of_processor_hart(node);
+		if (hart < 0)
+			continue;
+		cpu = riscv_hartid_to_cpuid(hart);
+		if (cpu < 0)
+			continue;
+
+		of_property_read_string(node, "riscv,isa", &isa);
+		info = &hart_isa[cpu];
+		riscv_parse_isa(isa, info);
+
+		elf_hwcap &= info->hwcap;
+		bitmap_and(riscv_isa_ext, riscv_isa_ext, info->isa,
+			   RISCV_ISA_EXT_MAX);
+		found = true;
 	}
 
-	if (of_property_read_string(node, "riscv,isa", &isa)) {
-		pr_warning("Unable to find \"riscv,isa\" devicetree entry");
+	if (!found) {
+		pr_warning("Unable to find a usable \"cpu\" devicetree entry");
+		elf_hwcap = 0;
+		bitmap_zero(riscv_isa_ext, RISCV_ISA_EXT_MAX);
 		return;
 	}
 
-	for (i = 0; i < strlen(isa); ++i)
-		elf_hwcap |= isa2hwcap[(unsigned char)(isa[i])];
+	elf_hwcap2 = 0;
+	for_each_set_bit(i, riscv_isa_ext, RISCV_ISA_EXT_MAX)
+		elf_hwcap2 |= isa_ext2hwcap2[i];
+
+	pr_info("elf_hwcap is 0x%lx, elf_hwcap2 is 0x%lx",
+		elf_hwcap, elf_hwcap2);
+
+	riscv_v_setup_vsize();
+}
+
+#define MISALIGNED_PROBE_WORDS	512
+#define MISALIGNED_PROBE_PASSES	16
+
+static unsigned long misaligned_probe_buf[MISALIGNED_PROBE_WORDS] __initdata;
+
+/*
+ * Misaligned loads and stores may be handled by the hardware, or trap to
+ * the SBI firmware and be emulated there at a cost of hundreds of cycles
+ * each.  Time misaligned loads against the shift-and-merge sequence the
+ * string routines use otherwise, and only let them go direct if that is
+ * actually faster.  Either path is correct, so the string routines may
+ * run before this; all harts are assumed to behave the same, and
+ * riscv_hwprobe reports the result for each of them.
+ */
+static int __init riscv_probe_misaligned_access(void)
+{
+	const char *p = (const char *)misaligned_probe_buf + 1;
+	unsigned long sum = 0, v, prev, next;
+	cycles_t start, direct, merged;
+	size_t i, pass;
+
+	start = get_cycles();
+	for (pass = 0; pass < MISALIGNED_PROBE_PASSES; pass++) {
+		for (i = 0; i < MISALIGNED_PROBE_WORDS - 1; i++) {
+			__asm__ __volatile__ (
+				REG_L " %0, 0(%1)"
+				: "=r" (v)
+				: "r" (p + i * sizeof(long)));
+			sum += v;
+		}
+	}
+	direct = get_cycles() - start;
+
+	start = get_cycles();
+	for (pass = 0; pass < MISALIGNED_PROBE_PASSES; pass++) {
+		prev = READ_ONCE(misaligned_probe_buf[0]);
+		for (i = 0; i < MISALIGNED_PROBE_WORDS - 1; i++) {
+			next = READ_ONCE(misaligned_probe_buf[i + 1]);
+			sum += (prev >> 8) | (next << (BITS_PER_LONG - 8));
+			prev = next;
+		}
+	}
+	merged = get_cycles() - start;
+
+	/* Keep the loads from being optimised away */
+	OPTIMIZER_HIDE_VAR(sum);
+
+	riscv_fast_misaligned_access = direct < merged;
+	if (riscv_fast_misaligned_access)
+		static_branch_enable(&riscv_fast_misaligned_key);
+	pr_info("misaligned accesses are %s (%lu vs %lu ticks)\n",
+		riscv_fast_misaligned_access ? "fast" : "slow",
+		(unsigned long)direct, (unsigned long)merged);
 
-	pr_info("elf_hwcap is 0x%lx", elf_hwcap);
+	return 0;
 }
+early_initcall(riscv_probe_misaligned_access);
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/ftrace.h>
+#include <linux/uaccess.h>
+
+#include <asm/cacheflush.h>
+#include <asm/patch.h>
+
+#ifdef CONFIG_DYNAMIC_FTRACE
+#define RISCV_INSN_NOP		0x00000013	/* addi x0, x0, 0 */
+#define RISCV_INSN_AUIPC_RA	0x00000097	/* auipc ra, 0 */
+#define RISCV_INSN_JALR_RA	0x000080e7	/* jalr ra, 0(ra) */
+
+/*
+ * Build "auipc ra, hi20; jalr ra, lo12(ra)" calling target from pc, the
+ * same split the module loader uses for R_RISCV_CALL.
+ */
+static int ftrace_gen_call(unsigned long pc, unsigned long target,
+			   u32 call[2])
+{
+	s64 offset = (s64)target - (s64)pc;
+	u32 hi20, lo12;
+
+	if (offset != (s32)offset) {
+		pr_err("ftrace: %pS is out of range of %pS\n",
+		       (void *)target, (void *)pc);
+		return -EINVAL;
+	}
+
+	hi20 = (offset + 0x800) & 0xfffff000;
+	lo12 = (offset - hi20) & 0xfff;
+	call[0] = RISCV_INSN_AUIPC_RA | hi20;
+	call[1] = RISCV_INSN_JALR_RA | (lo12 << 20);
+	return 0;
+}
+
+/*
+ * Replace the call site at pc, which must currently hold old, with new.
+ * The core runs this under stop_machine(), so nothing executes the site
+ * while it is half written.
+ */
+static int ftrace_modify_code(unsigned long pc, const u32 old[2],
+			      const u32 new[2])
+{
+	u32 replaced[2];
+
+	if (probe_kernel_read(replaced, (void *)pc, MCOUNT_INSN_SIZE))
+		return -EFAULT;
+
+	if (memcmp(replaced, old, MCOUNT_INSN_SIZE)) {
+		pr_err("ftrace: unexpected code at %pS: %08x %08x\n",
+		       (void *)pc, replaced[0], replaced[1]);
+		return -EINVAL;
+	}
+
+	if (patch_text_nosync((void *)pc, new, MCOUNT_INSN_SIZE))
+		return -EPERM;
+
+	flush_icache_range(pc, pc + MCOUNT_INSN_SIZE);
+	return 0;
+}
+
+static const u32 ftrace_nops[2] = { RISCV_INSN_NOP, RISCV_INSN_NOP };
+
+static int ftrace_retarget_call(unsigned long pc, unsigned long old_addr,
+				unsigned long new_addr)
+{
+	u32 old[2], new[2];
+	int ret;
+
+	ret = ftrace_gen_call(pc, old_addr, old);
+	if (!ret)
+		ret = ftrace_gen_call(pc, new_addr, new);
+	if (!ret)
+		ret = ftrace_modify_code(pc, old, new);
+
+	return ret;
+}
+
+int ftrace_make_call(struct dyn_ftrace *rec, unsigned long addr)
+{
+	u32 call[2];
+	int ret;
+
+	ret = ftrace_gen_call(rec->ip, addr, call);
+	if (ret)
+		return ret;
+
+	return ftrace_modify_code(rec->ip, ftrace_nops, call);
+}
+
+int ftrace_make_nop(struct module *mod, struct dyn_ftrace *rec,
+		    unsigned long addr)
+{
+	u32 call[2];
+	int ret;
+
+	ret = ftrace_gen_call(rec->ip, addr, call);
+	if (ret)
+		return ret;
+
+	return ftrace_modify_code(rec->ip, call, ftrace_nops);
+}
+
+#ifdef CONFIG_DYNAMIC_FTRACE_WITH_REGS
+int ftrace_modify_call(struct dyn_ftrace *rec, unsigned long old_addr,
+		       unsigned long addr)
+{
+	return ftrace_retarget_call(rec->ip, old_addr, addr);
+}
+#endif
+
+/*
+ * ftrace_call and ftrace_regs_call start out calling ftrace_stub; the
+ * current target is whatever the core last installed.
+ */
+static unsigned long ftrace_call_target = (unsigned long)ftrace_stub;
+
+int ftrace_update_ftrace_func(ftrace_func_t func)
+{
+	unsigned long new = (unsigned long)func;
+	int ret;
+
+	ret = ftrace_retarget_call((unsigned long)&ftrace_call,
+				   ftrace_call_target, new);
+#ifdef CONFIG_DYNAMIC_FTRACE_WITH_REGS
+	if (!ret)
+		ret = ftrace_retarget_call((unsigned long)&ftrace_regs_call,
+					   ftrace_call_target, new);
+#endif
+	if (!ret)
+		ftrace_call_target = new;
+
+	return ret;
+}
+
+int __init ftrace_dyn_arch_init(void)
+{
+	return 0;
+}
+#endif /* CONFIG_DYNAMIC_FTRACE */
+
+#ifdef CONFIG_FUNCTION_GRAPH_TRACER
+/*
+ * Called from _mcount or ftrace_caller to divert the traced function's
+ * return through return_to_handler.  parent points at the return address
+ * saved in its frame, frame_pointer is the caller's s0 for the return-time
+ * sanity check.
+ */
+void prepare_ftrace_return(unsigned long *parent, unsigned long self_addr,
+			   unsigned long frame_pointer)
+{
+	unsigned long return_hooker = (unsigned long)&return_to_handler;
+	struct ftrace_graph_ent trace;
+	unsigned long old;
+	int err;
+
+	if (unlikely(atomic_read(&current->tracing_graph_pause)))
+		return;
+
+	old = *parent;
+
+	trace.func = self_addr;
+	trace.depth = current->curr_ret_stack + 1;
+
+	/* Only trace if the calling function expects to */
+	if (!ftrace_graph_entry(&trace))
+		return;
+
+	err = ftrace_push_return_trace(old, self_addr, &trace.depth,
+				       frame_pointer, NULL);
+	if (err == -EBUSY)
+		return;
+
+	*parent = return_hooker;
+}
+
+#ifdef CONFIG_DYNAMIC_FTRACE
+extern void ftrace_graph_call(void);
+#ifdef CONFIG_DYNAMIC_FTRACE_WITH_REGS
+extern void ftrace_graph_regs_call(void);
+#endif
+
+static int ftrace_modify_graph_caller(bool enable)
+{
+	unsigned long stub = (unsigned long)ftrace_stub;
+	unsigned long graph = (unsigned long)prepare_ftrace_return;
+	unsigned long old = enable ? stub : graph;
+	unsigned long new = enable ? graph : stub;
+	int ret;
+
+	ret = ftrace_retarget_call((unsigned long)&ftrace_graph_call, old, new);
+#ifdef CONFIG_DYNAMIC_FTRACE_WITH_REGS
+	if (!ret)
+		ret = ftrace_retarget_call((unsigned long)&ftrace_graph_regs_call,
+					   old, new);
+#endif
+
+	return ret;
+}
+
+int ftrace_enable_ftrace_graph_caller(void)
+{
+	return ftrace_modify_graph_caller(true);
+}
+
+int ftrace_disable_ftrace_graph_caller(void)
+{
+	return ftrace_modify_graph_caller(false);
+}
+#endif /* CONFIG_DYNAMIC_FTRACE */
+#endif /* CONFIG_FUNCTION_GRAPH_TRACER */
@@ -15,25 +15,30 @@
 #include <linux/interrupt.h>
 #include <linux/irqchip.h>
 #include <linux/irqdomain.h>
+#include <linux/seq_file.h>
+#include <asm/smp.h>
 
-#ifdef CONFIG_RISCV_INTC
-#include <linux/irqchip/irq-riscv-intc.h>
-#endif
+void (*handle_arch_irq)(struct pt_regs *) __ro_after_init;
 
-void __init init_IRQ(void)
+void __init set_handle_irq(void (*handle_irq)(struct pt_regs *))
 {
-	irqchip_init();
+	if (handle_arch_irq)
+		return;
+
+	handle_arch_irq = handle_irq;
 }
 
-asmlinkage void __irq_entry do_IRQ(unsigned int cause, struct pt_regs *regs)
+int arch_show_interrupts(struct seq_file *p, int prec)
 {
-#ifdef CONFIG_RISCV_INTC
-	/*
-	 * FIXME: We don't want a direct call to riscv_intc_irq here.  The plan
-	 * is to put an IRQ domain here and let the interrupt controller
-	 * register with that, but I poked around the arm64 code a bit and
-	 * there might be a better way to do it (ie, something fully generic).
-	 */
-	riscv_intc_irq(cause, regs);
+#ifdef CONFIG_SMP
+	show_ipi_stats(p, prec);
 #endif
+	return 0;
+}
+
+void __init init_IRQ(void)
+{
+	irqchip_init();
+	if (!handle_arch_irq)
+		panic("No interrupt controller found.");
 }
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/bug.h>
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+
+#include <asm/cacheflush.h>
+#include <asm/patch.h>
+
+#ifdef HAVE_JUMP_LABEL
+
+#define RISCV_INSN_NOP	0x00000013U	/* addi zero, zero, 0 */
+#define RISCV_INSN_JAL	0x0000006fU	/* jal zero, 0 */
+
+/* Encode "jal zero, offset" for a +/-1MiB offset */
+static u32 riscv_insn_gen_jal(unsigned long pc, unsigned long target)
+{
+	long offset = (long)target - (long)pc;
+
+	BUG_ON(offset < -(1L << 20) || offset >= (1L << 20));
+
+	return RISCV_INSN_JAL |
+		(((offset >> 20) & 0x1) << 31) |
+		(((offset >> 1) & 0x3ff) << 21) |
+		(((offset >> 11) & 0x1) << 20) |
+		(((offset >> 12) & 0xff) << 12);
+}
+
+void arch_jump_label_transform(struct jump_entry *entry,
+			       enum jump_label_type type)
+{
+	u32 *addr = (u32 *)entry->code;
+	u32 insn;
+
+	if (type == JUMP_LABEL_JMP)
+		insn = riscv_insn_gen_jal(entry->code, entry->target);
+	else
+		insn = RISCV_INSN_NOP;
+
+	/*
+	 * The site is word aligned (see asm/jump_label.h), so other harts
+	 * see either the old or the new instruction, never a mix.  They pick
+	 * the new one up once their instruction fetch has been resynced.
+	 */
+	patch_text_nosync(addr, &insn, sizeof(insn));
+	local_flush_icache_all();
+	flush_icache_range((unsigned long)addr,
+			   (unsigned long)addr + JUMP_LABEL_NOP_SIZE);
+}
+
+void arch_jump_label_transform_static(struct jump_entry *entry,
+				      enum jump_label_type type)
+{
+	/*
+	 * arch_static_branch() already emits the nop, so there is nothing to
+	 * patch over it here.  The core calls arch_jump_label_transform()
+	 * from a module notifier if a branch is needed.
+	 */
+}
+
+#endif	/* HAVE_JUMP_LABEL */
@@ -0,0 +1,199 @@
+/*
+ * Use of the FP and vector registers by the kernel itself
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/bug.h>
+#include <linux/cache.h>
+#include <linux/export.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/preempt.h>
+#include <linux/sched/task_stack.h>
+#include <linux/slab.h>
+
+#include <asm/csr.h>
+#include <asm/fpu.h>
+#include <asm/switch_to.h>
+#include <asm/vector.h>
+
+/*
+ * A section in process context saves the task's user state, if it is
+ * live, and leaves the unit off in its pt_regs, as a context switch
+ * does: the user's registers come back on their next use.  Sections
+ * only nest within the same context, so a count per context does.
+ *
+ * A softirq can't tell whose values are in the registers: the task's,
+ * an open section's it interrupted, or a guest's.  It keeps them in a
+ * per-CPU area for the duration of its own section instead, always for
+ * the FP registers, which are cheap to move, and for the much larger
+ * vector ones unless neither the task nor a section owns them.  For that
+ * to hold, whoever is about to load a task's vector registers marks them
+ * live first, and a section is counted open before it saves the user's.
+ */
+struct kernel_unit_state {
+	unsigned int depth[2];		/* Open in process context, softirq */
+	unsigned long live;		/* SR_FS or SR_VS as the softirq found it */
+	bool saved;			/* The softirq put the registers aside */
+};
+
+struct kernel_fpu_state {
+	struct kernel_unit_state fpu;
+	struct kernel_unit_state vector;
+	struct __riscv_d_ext_state fstate;
+	struct __riscv_v_ext_state vstate;
+};
+
+static DEFINE_PER_CPU(struct kernel_fpu_state, kernel_fpu_state);
+
+bool riscv_v_softirq_ready __ro_after_init;
+EXPORT_SYMBOL_GPL(riscv_v_softirq_ready);
+
+static inline int kernel_fpu_context(void)
+{
+	return in_serving_softirq() ? 1 : 0;
+}
+
+void kernel_fpu_begin(void)
+{
+	struct kernel_fpu_state *state;
+	struct kernel_unit_state *unit;
+	int ctx = kernel_fpu_context();
+
+	BUG_ON(!may_use_fpu());
+
+	preempt_disable();
+	state = this_cpu_ptr(&kernel_fpu_state);
+	unit = &state->fpu;
+	if (unit->depth[ctx]++)
+		return;
+	barrier();
+
+	if (ctx) {
+		unit->live = csr_read(sstatus) & SR_FS;
+		__fstate_save_state(&state->fstate);
+	} else {
+		struct pt_regs *regs = task_pt_regs(current);
+
+		if ((regs->sstatus & SR_FS) != SR_FS_OFF) {
+			if ((regs->sstatus & SR_FS) == SR_FS_DIRTY)
+				__fstate_save(current);
+			current->thread.fstate_lazy = true;
+			regs->sstatus &= ~SR_FS;
+		}
+	}
+
+	csr_set(sstatus, SR_FS);
+}
+EXPORT_SYMBOL_GPL(kernel_fpu_begin);
+
+void kernel_fpu_end(void)
+{
+	struct kernel_fpu_state *state = this_cpu_ptr(&kernel_fpu_state);
+	struct kernel_unit_state *unit = &state->fpu;
+	int ctx = kernel_fpu_context();
+
+	if (WARN_ON(!unit->depth[ctx]))
+		return;
+
+	if (!--unit->depth[ctx]) {
+		csr_clear(sstatus, SR_FS);
+		if (ctx) {
+			__fstate_restore_state(&state->fstate);
+			csr_set(sstatus, unit->live);
+		}
+	}
+	preempt_enable();
+}
+EXPORT_SYMBOL_GPL(kernel_fpu_end);
+
+void kernel_vector_begin(void)
+{
+	struct kernel_fpu_state *state;
+	struct kernel_unit_state *unit;
+	struct pt_regs *regs = task_pt_regs(current);
+	int ctx = kernel_fpu_context();
+
+	BUG_ON(!may_use_vector());
+
+	preempt_disable();
+	state = this_cpu_ptr(&kernel_fpu_state);
+	unit = &state->vector;
+	if (unit->depth[ctx]++)
+		return;
+	barrier();
+
+	if (ctx) {
+		unit->live = csr_read(sstatus) & SR_VS;
+		unit->saved = unit->depth[0] ||
+			      (regs->sstatus & SR_VS) != SR_VS_OFF;
+		if (unit->saved)
+			__vstate_save(&state->vstate, state->vstate.datap);
+	} else {
+		/* The user's registers are reloaded on their next use */
+		if ((regs->sstatus & SR_VS) == SR_VS_DIRTY)
+			__vstate_save(&current->thread.vstate,
+				      current->thread.vstate.datap);
+		regs->sstatus &= ~SR_VS;
+	}
+
+	csr_set(sstatus, SR_VS);
+}
+EXPORT_SYMBOL_GPL(kernel_vector_begin);
+
+void kernel_vector_end(void)
+{
+	struct kernel_fpu_state *state = this_cpu_ptr(&kernel_fpu_state);
+	struct kernel_unit_state *unit = &state->vector;
+	int ctx = kernel_fpu_context();
+
+	if (WARN_ON(!unit->depth[ctx]))
+		return;
+
+	if (!--unit->depth[ctx]) {
+		csr_clear(sstatus, SR_VS);
+		if (ctx) {
+			if (unit->saved)
+				__vstate_restore(&state->vstate,
+						 state->vstate.datap);
+			csr_set(sstatus, unit->live);
+		}
+	}
+	preempt_enable();
+}
+EXPORT_SYMBOL_GPL(kernel_vector_end);
+
+/* Until this has run, softirqs use the scalar fallbacks */
+static int __init kernel_vector_softirq_init(void)
+{
+	unsigned int cpu;
+
+	if (!has_vector())
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		struct kernel_fpu_state *state = per_cpu_ptr(&kernel_fpu_state,
+							     cpu);
+
+		state->vstate.datap = kmalloc(riscv_v_vsize, GFP_KERNEL);
+		if (!state->vstate.datap) {
+			pr_warn("no memory to use the vector unit in softirqs\n");
+			return -ENOMEM;
+		}
+	}
+
+	riscv_v_softirq_ready = true;
+	return 0;
+}
+early_initcall(kernel_vector_softirq_init);
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/cpu.h>
+#include <linux/interrupt.h>
+#include <linux/kexec.h>
+#include <linux/libfdt.h>
+#include <linux/smp.h>
+#include <linux/uaccess.h>
+
+#include <asm/cacheflush.h>
+#include <asm/cpu_ops.h>
+#include <asm/smp.h>
+
+/*
+ * The other harts have to be out of the kernel before it is overwritten.
+ * With SBI HSM they are handed back to the firmware by taking them down,
+ * and the new kernel starts them again like it would on boot; spinning
+ * harts have nowhere to go, so there is no kexec with them online.  A
+ * crash kernel is loaded out of the way and leaves them spinning.
+ */
+static bool kexec_can_park_harts(void)
+{
+	if (num_online_cpus() == 1)
+		return true;
+#ifdef CONFIG_HOTPLUG_CPU
+	return cpu_ops->cpu_stop != NULL;
+#else
+	return false;
+#endif
+}
+
+int machine_kexec_prepare(struct kimage *image)
+{
+	struct kimage_arch *internal = &image->arch;
+	struct fdt_header fdt;
+	unsigned long i;
+
+	if (image->type != KEXEC_TYPE_CRASH && !kexec_can_park_harts()) {
+		pr_err("kexec: the other harts can't be stopped\n");
+		return -EBUSY;
+	}
+
+	/* The new kernel is passed the first segment that holds a DTB */
+	internal->fdt_addr = 0;
+	for (i = 0; i < image->nr_segments; i++) {
+		if (image->segment[i].memsz <= sizeof(fdt))
+			continue;
+
+		if (copy_from_user(&fdt, image->segment[i].buf, sizeof(fdt)))
+			continue;
+
+		if (fdt_check_header(&fdt))
+			continue;
+
+		internal->fdt_addr = image->segment[i].mem;
+		break;
+	}
+
+	if (!internal->fdt_addr) {
+		pr_err("kexec: no DTB among the segments\n");
+		return -EINVAL;
+	}
+
+	memcpy(page_address(image->control_code_page), riscv_kexec_relocate,
+	       riscv_kexec_relocate_size);
+	return 0;
+}
+
+void machine_kexec_cleanup(struct kimage *image)
+{
+}
+
+/* Called by kernel_kexec(), on the reboot CPU, to park the other harts */
+void machine_shutdown(void)
+{
+#ifdef CONFIG_HOTPLUG_CPU
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		if (cpu != smp_processor_id())
+			cpu_down(cpu);
+	}
+#endif
+}
+
+/*
+ * Only this CPU's registers are saved: the others are stopped where they
+ * are, and the dump shows them in the IPI handler.
+ */
+void machine_crash_shutdown(struct pt_regs *regs)
+{
+	local_irq_disable();
+	crash_save_cpu(regs, smp_processor_id());
+	smp_send_stop();
+	pr_info("Starting crashdump kernel...\n");
+}
+
+void machine_kexec(struct kimage *image)
+{
+	void *control_code = page_address(image->control_code_page);
+	riscv_kexec_method relocate = control_code;
+	unsigned long hartid = cpuid_to_hartid_map(smp_processor_id());
+
+	pr_notice("Bye...\n");
+
+	local_irq_disable();
+	/* The copy of the relocation code is about to be run */
+	local_flush_icache_all();
+
+	relocate(image->head, image->start, image->arch.fdt_addr, hartid,
+		 va_pa_offset);
+
+	unreachable();
+}
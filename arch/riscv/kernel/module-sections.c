@@ -0,0 +1,158 @@
+/*
+ * PLT and GOT sections for modules loaded out of range of their targets
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/elf.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleloader.h>
+#include <linux/string.h>
+#include <asm/cache.h>
+
+/* t3 is free for PLT stubs to use, as in the psABI */
+#define PLT_INSN_AUIPC_T3	0x00000e17	/* auipc t3, 0 */
+#ifdef CONFIG_64BIT
+#define PLT_INSN_LOAD_T3	0x000e3e03	/* ld t3, 0(t3) */
+#else
+#define PLT_INSN_LOAD_T3	0x000e2e03	/* lw t3, 0(t3) */
+#endif
+#define PLT_INSN_JR_T3		0x000e0067	/* jalr x0, 0(t3) */
+
+/*
+ * Both tables are searched linearly so a symbol gets a single entry: a
+ * module only has a few hundred of them, and this only runs at load time.
+ */
+unsigned long module_emit_got_entry(struct module *mod, unsigned long val)
+{
+	struct mod_section *got = &mod->arch.got;
+	struct got_entry *entries = (struct got_entry *)got->shdr->sh_addr;
+	int i;
+
+	for (i = 0; i < got->num_entries; i++)
+		if (entries[i].symbol_addr == val)
+			return (unsigned long)&entries[i];
+
+	if (WARN_ON(i >= got->max_entries))
+		return 0;
+
+	entries[i].symbol_addr = val;
+	got->num_entries++;
+	return (unsigned long)&entries[i];
+}
+
+unsigned long module_emit_plt_entry(struct module *mod, unsigned long val)
+{
+	struct mod_section *plt = &mod->arch.plt;
+	struct plt_entry *entries = (struct plt_entry *)plt->shdr->sh_addr;
+	struct got_entry *got_plt =
+		(struct got_entry *)mod->arch.got_plt.shdr->sh_addr;
+	s64 offset;
+	u32 hi20, lo12;
+	int i;
+
+	for (i = 0; i < plt->num_entries; i++)
+		if (got_plt[i].symbol_addr == val)
+			return (unsigned long)&entries[i];
+
+	if (WARN_ON(i >= plt->max_entries))
+		return 0;
+
+	/* Both sections are in the module, so they are within reach */
+	offset = (void *)&got_plt[i] - (void *)&entries[i];
+	hi20 = (offset + 0x800) & 0xfffff000;
+	lo12 = (offset - hi20) & 0xfff;
+
+	got_plt[i].symbol_addr = val;
+	entries[i].insn_auipc = PLT_INSN_AUIPC_T3 | hi20;
+	entries[i].insn_load = PLT_INSN_LOAD_T3 | (lo12 << 20);
+	entries[i].insn_jr = PLT_INSN_JR_T3;
+	plt->num_entries++;
+	mod->arch.got_plt.num_entries++;
+	return (unsigned long)&entries[i];
+}
+
+static void count_max_entries(const Elf_Rela *relas, int num,
+			      unsigned int *plts, unsigned int *gots)
+{
+	int i;
+
+	for (i = 0; i < num; i++) {
+		switch (ELF_RISCV_R_TYPE(relas[i].r_info)) {
+		case R_RISCV_CALL:
+		case R_RISCV_CALL_PLT:
+			(*plts)++;
+			break;
+		case R_RISCV_GOT_HI20:
+			(*gots)++;
+			break;
+		}
+	}
+}
+
+static void init_mod_section(struct mod_section *sec, unsigned long flags,
+			     unsigned int entries, size_t size)
+{
+	sec->shdr->sh_type = SHT_NOBITS;
+	sec->shdr->sh_flags = flags;
+	sec->shdr->sh_addralign = L1_CACHE_BYTES;
+	sec->shdr->sh_size = (entries + 1) * size;
+	sec->num_entries = 0;
+	sec->max_entries = entries;
+}
+
+int module_frob_arch_sections(Elf_Ehdr *ehdr, Elf_Shdr *sechdrs,
+			      char *secstrings, struct module *mod)
+{
+	unsigned int num_plts = 0, num_gots = 0;
+	int i;
+
+	for (i = 0; i < ehdr->e_shnum; i++) {
+		const char *name = secstrings + sechdrs[i].sh_name;
+
+		if (!strcmp(name, ".plt"))
+			mod->arch.plt.shdr = sechdrs + i;
+		else if (!strcmp(name, ".got"))
+			mod->arch.got.shdr = sechdrs + i;
+		else if (!strcmp(name, ".got.plt"))
+			mod->arch.got_plt.shdr = sechdrs + i;
+	}
+
+	if (!mod->arch.plt.shdr || !mod->arch.got.shdr ||
+	    !mod->arch.got_plt.shdr) {
+		pr_err("%s: module PLT/GOT section(s) missing\n", mod->name);
+		return -ENOEXEC;
+	}
+
+	/* Only code refers to the GOT or makes calls */
+	for (i = 0; i < ehdr->e_shnum; i++) {
+		const Elf_Rela *relas = (void *)ehdr + sechdrs[i].sh_offset;
+
+		if (sechdrs[i].sh_type != SHT_RELA)
+			continue;
+		if (!(sechdrs[sechdrs[i].sh_info].sh_flags & SHF_EXECINSTR))
+			continue;
+
+		count_max_entries(relas, sechdrs[i].sh_size / sizeof(*relas),
+				  &num_plts, &num_gots);
+	}
+
+	init_mod_section(&mod->arch.plt, SHF_EXECINSTR | SHF_ALLOC, num_plts,
+			 sizeof(struct plt_entry));
+	init_mod_section(&mod->arch.got, SHF_ALLOC, num_gots,
+			 sizeof(struct got_entry));
+	init_mod_section(&mod->arch.got_plt, SHF_ALLOC, num_plts,
+			 sizeof(struct got_entry));
+
+	return 0;
+}
@@ -15,7 +15,21 @@
 #include <linux/elf.h>
 #include <linux/err.h>
 #include <linux/errno.h>
+#include <linux/ftrace.h>
 #include <linux/moduleloader.h>
+#include <linux/string.h>
+#include <asm/alternative.h>
+
+#define RISCV_INSN_NOP		0x00000013	/* addi x0, x0, 0 */
+#define RISCV_INSN_JAL		0x0000006f	/* jal x0, 0 */
+
+static int apply_r_riscv_32_rela(struct module *me, u32 *location, Elf_Addr v)
+{
+	if (v != (u32)v)
+		return -EINVAL;
+	*location = v;
+	return 0;
+}
 
 static int apply_r_riscv_64_rela(struct module *me, u32 *location, Elf_Addr v)
 {
@@ -92,6 +106,17 @@ static int apply_r_riscv_pcrel_lo12_s_rela(struct module *me, u32 *location,
 	return 0;
 }
 
+static int apply_r_riscv_got_hi20_rela(struct module *me, u32 *location,
+				       Elf_Addr v)
+{
+	unsigned long got = module_emit_got_entry(me, v);
+
+	if (!got)
+		return -ENOEXEC;
+
+	return apply_r_riscv_pcrel_hi20_rela(me, location, got);
+}
+
 static int apply_r_riscv_call_plt_rela(struct module *me, u32 *location,
 				       Elf_Addr v)
 {
@@ -99,11 +124,18 @@ static int apply_r_riscv_call_plt_rela(struct module *me, u32 *location,
 	s32 fill_v = offset;
 	u32 hi20, lo12;
 
+	/* Go through a PLT entry, in the module, if the target is too far */
 	if (offset != fill_v) {
-		pr_err(
-		  "%s: target %016llx can not be addressed by the 32-bit offset from PC = %p\n",
-		  me->name, v, location);
-		return -EINVAL;
+		unsigned long plt = module_emit_plt_entry(me, v);
+
+		if (!plt) {
+			pr_err(
+			  "%s: target %016llx can not be addressed by the 32-bit offset from PC = %p\n",
+			  me->name, (unsigned long long)v, location);
+			return -EINVAL;
+		}
+
+		offset = (void *)plt - (void *)location;
 	}
 
 	hi20 = (offset + 0x800) & 0xfffff000;
@@ -119,15 +151,41 @@ static int apply_r_riscv_relax_rela(struct module *me, u32 *location,
 	return 0;
 }
 
+/*
+ * A call marked with R_RISCV_RELAX whose target is within reach of a jal
+ * becomes "nop; jal rd, target", rd being the jalr's: the call is then a
+ * single jump, returning to the same place.  The _mcount call sites are
+ * left alone, as ftrace expects to find the auipc/jalr pair there.
+ */
+static void relax_call(u32 *location, Elf_Addr v)
+{
+	s64 offset = (void *)v - (void *)(location + 1);
+	u32 rd = (*(location + 1) >> 7) & 0x1f;
+
+#ifdef CONFIG_DYNAMIC_FTRACE
+	if (v == MCOUNT_ADDR)
+		return;
+#endif
+	if (offset < -(1 << 20) || offset >= (1 << 20))
+		return;
+
+	*location = RISCV_INSN_NOP;
+	*(location + 1) = RISCV_INSN_JAL | (rd << 7);
+	apply_r_riscv_jal_rela(NULL, location + 1, v);
+}
+
 static int (*reloc_handlers_rela[]) (struct module *me, u32 *location,
 				Elf_Addr v) = {
+	[R_RISCV_32]			= apply_r_riscv_32_rela,
 	[R_RISCV_64]			= apply_r_riscv_64_rela,
 	[R_RISCV_BRANCH]		= apply_r_riscv_branch_rela,
 	[R_RISCV_JAL]			= apply_r_riscv_jal_rela,
+	[R_RISCV_CALL]			= apply_r_riscv_call_plt_rela,
 	[R_RISCV_PCREL_HI20]		= apply_r_riscv_pcrel_hi20_rela,
 	[R_RISCV_PCREL_LO12_I]		= apply_r_riscv_pcrel_lo12_i_rela,
 	[R_RISCV_PCREL_LO12_S]		= apply_r_riscv_pcrel_lo12_s_rela,
 	[R_RISCV_CALL_PLT]		= apply_r_riscv_call_plt_rela,
+	[R_RISCV_GOT_HI20]		= apply_r_riscv_got_hi20_rela,
 	[R_RISCV_RELAX]			= apply_r_riscv_relax_rela,
 };
 
@@ -192,6 +250,12 @@ int apply_relocate_add(Elf_Shdr *sechdrs, const char *strtab,
 					u64 hi20_sym_val =
 						hi20_sym->st_value
 						+ rel[j].r_addend;
+					/* A GOT reference is to the entry */
+					if (ELF_RISCV_R_TYPE(rel[j].r_info) ==
+					    R_RISCV_GOT_HI20)
+						hi20_sym_val =
+						  module_emit_got_entry(me,
+								hi20_sym_val);
 					/* Calculate lo12 */
 					s64 offset = hi20_sym_val - hi20_loc;
 					s32 hi20 = (offset + 0x800) & 0xfffff000;
@@ -211,6 +275,28 @@ int apply_relocate_add(Elf_Shdr *sechdrs, const char *strtab,
 		res = handler(me, location, v);
 		if (res)
 			return res;
+
+		/* The call's R_RISCV_RELAX, if any, comes right after it */
+		if ((type == R_RISCV_CALL || type == R_RISCV_CALL_PLT) &&
+		    i + 1 < sechdrs[relsec].sh_size / sizeof(*rel) &&
+		    rel[i + 1].r_offset == rel[i].r_offset &&
+		    ELF_RISCV_R_TYPE(rel[i + 1].r_info) == R_RISCV_RELAX)
+			relax_call(location, v);
+	}
+
+	return 0;
+}
+
+int module_finalize(const Elf_Ehdr *hdr, const Elf_Shdr *sechdrs,
+		    struct module *me)
+{
+	const char *secstrs = (void *)hdr + sechdrs[hdr->e_shstrndx].sh_offset;
+	const Elf_Shdr *s;
+
+	for (s = sechdrs; s < sechdrs + hdr->e_shnum; s++) {
+		if (!strcmp(secstrs + s->sh_name, ".alt_instructions"))
+			apply_module_alternatives((void *)s->sh_addr,
+						  s->sh_size);
 	}
 
 	return 0;
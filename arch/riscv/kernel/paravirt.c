@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) "riscv-pv: " fmt
+
+#include <linux/cpuhotplug.h>
+#include <linux/export.h>
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/printk.h>
+#include <linux/types.h>
+#include <asm/barrier.h>
+#include <asm/paravirt.h>
+#include <asm/sbi.h>
+
+struct static_key paravirt_steal_enabled;
+struct static_key paravirt_steal_rq_enabled;
+
+static u64 native_steal_clock(int cpu)
+{
+	return 0;
+}
+
+static bool native_vcpu_is_preempted(long cpu)
+{
+	return false;
+}
+
+struct pv_time_ops pv_time_ops = {
+	.steal_clock = native_steal_clock,
+};
+EXPORT_SYMBOL_GPL(pv_time_ops);
+
+struct pv_lock_ops pv_lock_ops = {
+	.vcpu_is_preempted = native_vcpu_is_preempted,
+};
+EXPORT_SYMBOL_GPL(pv_lock_ops);
+
+static bool steal_acc = true;
+static int __init parse_no_stealacc(char *arg)
+{
+	steal_acc = false;
+	return 0;
+}
+early_param("no-steal-acc", parse_no_stealacc);
+
+/* The spec wants the area 64-byte aligned, and that keeps it in a line */
+static DEFINE_PER_CPU(struct sbi_sta_struct, steal_time) __aligned(64);
+
+static long sbi_sta_steal_time_set_shmem(unsigned long lo, unsigned long hi)
+{
+	return SBI_ECALL(SBI_EXT_STA, SBI_EXT_STA_STEAL_TIME_SET_SHMEM,
+			 lo, hi, 0).error;
+}
+
+static int pv_time_cpu_online(unsigned int cpu)
+{
+	phys_addr_t pa = per_cpu_ptr_to_phys(per_cpu_ptr(&steal_time, cpu));
+	unsigned long lo = (unsigned long)pa;
+	unsigned long hi = IS_ENABLED(CONFIG_32BIT) ? upper_32_bits((u64)pa) : 0;
+	long ret;
+
+	ret = sbi_sta_steal_time_set_shmem(lo, hi);
+	if (ret) {
+		pr_warn("failed to register the steal-time area of CPU%u: %ld\n",
+			cpu, ret);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int pv_time_cpu_down_prepare(unsigned int cpu)
+{
+	sbi_sta_steal_time_set_shmem(SBI_SHMEM_DISABLE, SBI_SHMEM_DISABLE);
+	return 0;
+}
+
+static u64 pv_time_steal_clock(int cpu)
+{
+	struct sbi_sta_struct *st = per_cpu_ptr(&steal_time, cpu);
+	u32 sequence;
+	u64 steal;
+
+	/* A write in progress makes the sequence odd, or changes it */
+	do {
+		sequence = le32_to_cpu(READ_ONCE(st->sequence));
+		virt_rmb();
+		steal = le64_to_cpu(READ_ONCE(st->steal));
+		virt_rmb();
+	} while ((sequence & 1) ||
+		 sequence != le32_to_cpu(READ_ONCE(st->sequence)));
+
+	return steal;
+}
+
+static bool pv_vcpu_is_preempted_sbi(long cpu)
+{
+	return !!READ_ONCE(per_cpu_ptr(&steal_time, cpu)->preempted);
+}
+
+int __init pv_time_init(void)
+{
+	int ret;
+
+	if (!sbi_probe_extension(SBI_EXT_STA))
+		return 0;
+
+	/*
+	 * The online callback runs on the CPU coming up, which is the one
+	 * the area has to be registered from.
+	 */
+	ret = cpuhp_setup_state(CPUHP_AP_ONLINE_DYN, "riscv/pv_time:online",
+				pv_time_cpu_online, pv_time_cpu_down_prepare);
+	if (ret < 0)
+		return ret;
+
+	pv_time_ops.steal_clock = pv_time_steal_clock;
+	pv_lock_ops.vcpu_is_preempted = pv_vcpu_is_preempted_sbi;
+
+	static_key_slow_inc(&paravirt_steal_enabled);
+	if (steal_acc)
+		static_key_slow_inc(&paravirt_steal_rq_enabled);
+
+	pr_info("using SBI steal-time accounting\n");
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/kprobes.h>
+#include <linux/mm.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+
+#include <asm/patch.h>
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+/*
+ * A naturally aligned instruction goes out as a single store, so that
+ * other harts fetch either the old or the new one and never a mix.
+ */
+static int __kprobes patch_insn_write(void *addr, const void *insns,
+				      size_t len)
+{
+	if (len == 4 && IS_ALIGNED((unsigned long)addr, 4)) {
+		WRITE_ONCE(*(u32 *)addr, *(const u32 *)insns);
+		return 0;
+	}
+
+	if (len == 2 && IS_ALIGNED((unsigned long)addr, 2)) {
+		WRITE_ONCE(*(u16 *)addr, *(const u16 *)insns);
+		return 0;
+	}
+
+	return probe_kernel_write(addr, insns, len);
+}
+
+#ifdef CONFIG_STRICT_KERNEL_RWX
+static DEFINE_RAW_SPINLOCK(patch_lock);
+
+/* Find the leaf entry, at whatever level, that maps addr */
+static pte_t * __kprobes patch_leaf_entry(unsigned long addr)
+{
+	pgd_t *pgdp = pgd_offset_k(addr);
+	pud_t *pudp;
+	pmd_t *pmdp;
+
+	pudp = pud_offset(p4d_offset(pgdp, addr), addr);
+#ifndef __PAGETABLE_PMD_FOLDED
+	if (!pud_present(*pudp))
+		return NULL;
+	if (pud_val(*pudp) & _PAGE_LEAF)
+		return (pte_t *)pudp;
+#endif
+
+	pmdp = pmd_offset(pudp, addr);
+	if (!pmd_present(*pmdp))
+		return NULL;
+	if (pmd_val(*pmdp) & _PAGE_LEAF)
+		return (pte_t *)pmdp;
+
+	return pte_offset_kernel(pmdp, addr);
+}
+
+/*
+ * Text is read-only once mark_rodata_ro() has run, so make the leaf that
+ * maps it writable for as long as the write takes.  Only this hart
+ * flushes the writable translation in; everyone flushes it back out.
+ */
+static int __kprobes patch_page(void *addr, const void *insns, size_t len)
+{
+	unsigned long uaddr = (unsigned long)addr;
+	unsigned long flags;
+	pte_t *ptep, old;
+	int ret;
+
+	raw_spin_lock_irqsave(&patch_lock, flags);
+
+	ptep = patch_leaf_entry(uaddr);
+	if (!ptep || (pte_val(*ptep) & _PAGE_WRITE)) {
+		ret = patch_insn_write(addr, insns, len);
+		goto out;
+	}
+
+	old = *ptep;
+	set_pte(ptep, pte_mkwrite(old));
+	local_flush_tlb_page(uaddr);
+
+	ret = patch_insn_write(addr, insns, len);
+
+	set_pte(ptep, old);
+	flush_tlb_kernel_range(uaddr & PAGE_MASK,
+			       (uaddr & PAGE_MASK) + PAGE_SIZE);
+out:
+	raw_spin_unlock_irqrestore(&patch_lock, flags);
+	return ret;
+}
+#else
+static int __kprobes patch_page(void *addr, const void *insns, size_t len)
+{
+	return patch_insn_write(addr, insns, len);
+}
+#endif /* CONFIG_STRICT_KERNEL_RWX */
+
+int __kprobes patch_text_nosync(void *addr, const void *insns, size_t len)
+{
+	int ret = 0;
+
+	/* A 32-bit instruction at a 16-bit boundary can straddle two pages */
+	while (len && !ret) {
+		size_t n = min_t(size_t, len,
+				 PAGE_SIZE - offset_in_page(addr));
+
+		ret = patch_page(addr, insns, n);
+		addr += n;
+		insns += n;
+		len -= n;
+	}
+
+	return ret;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/perf_event.h>
+#include <linux/uaccess.h>
+
+#include <asm/stacktrace.h>
+
+/*
+ * Read one user frame record below fp and store its return address.  The
+ * innermost frame may not have spilled ra yet, so the caller passes the
+ * live register value for it instead.
+ */
+static unsigned long user_backtrace(struct perf_callchain_entry_ctx *entry,
+				    unsigned long fp, unsigned long reg_ra)
+{
+	struct stackframe buftail;
+	struct stackframe __user *frame;
+	unsigned long ra;
+
+	frame = (struct stackframe __user *)fp - 1;
+	if (!access_ok(VERIFY_READ, frame, sizeof(buftail)))
+		return 0;
+	if (__copy_from_user_inatomic(&buftail, frame, sizeof(buftail)))
+		return 0;
+
+	ra = reg_ra ? : buftail.ra;
+	if (!ra)
+		return 0;
+
+	perf_callchain_store(entry, ra);
+
+	/* Frames only move up the stack: anything else is a broken chain */
+	return buftail.fp > fp ? buftail.fp : 0;
+}
+
+/*
+ * This only works when user space was built with frame pointers, which is
+ * the same constraint the kernel walker has without CONFIG_FRAME_POINTER.
+ */
+void perf_callchain_user(struct perf_callchain_entry_ctx *entry,
+			 struct pt_regs *regs)
+{
+	unsigned long fp;
+
+	/* The guest's stack isn't ours to read */
+	if (perf_guest_cbs && perf_guest_cbs->is_in_guest())
+		return;
+
+	perf_callchain_store(entry, regs->sepc);
+
+	/*
+	 * Samples can be taken where sleeping isn't allowed and a BPF
+	 * stackmap can ask from any context: never fault pages in.
+	 */
+	pagefault_disable();
+	fp = user_backtrace(entry, regs->s0, regs->ra);
+	while (fp && !(fp & 0x7) && entry->nr < entry->max_stack)
+		fp = user_backtrace(entry, fp, 0);
+	pagefault_enable();
+}
+
+static bool fill_callchain(unsigned long pc, void *entry)
+{
+	return perf_callchain_store(entry, pc) != 0;
+}
+
+void perf_callchain_kernel(struct perf_callchain_entry_ctx *entry,
+			   struct pt_regs *regs)
+{
+	if (perf_guest_cbs && perf_guest_cbs->is_in_guest())
+		return;
+
+	walk_stackframe(NULL, regs, fill_callchain, entry);
+}
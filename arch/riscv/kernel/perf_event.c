@@ -0,0 +1,269 @@
+/*
+ * RISC-V hardware performance counters
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+/*
+ * The privileged spec v1.10 gives supervisor mode read-only access to the
+ * cycle, instret and hpmcounter3-31 CSRs, provided the SBI firmware has
+ * opened them up through mcounteren.  The event each hpmcounter counts is
+ * programmed by firmware as well, and there is no overflow interrupt that
+ * S-mode could take, so this PMU can only count: every counter runs freely
+ * and an event is simply the difference between two reads.
+ *
+ * Because the counters can't be stopped or written, any number of events
+ * may share a counter and nothing ever has to be scheduled out.
+ *
+ * The counters firmware has set up are described by a "riscv,pmu" node:
+ *
+ *	pmu {
+ *		compatible = "riscv,pmu";
+ *		riscv,hpmcounters = <4>;	// hpmcounter3-6 are readable
+ *		riscv,counter-width = <40>;	// hpmcounter width, default 64
+ *		// <perf_hw_id counter>: cache-misses on 3, branch-misses on 4
+ *		riscv,hw-events = <3 3>, <5 4>;
+ *	};
+ *
+ * Without the node only cycles and instructions are available.  Raw events
+ * select a counter by number, e.g. "perf stat -e r4".
+ */
+
+#define pr_fmt(fmt) "riscv-pmu: " fmt
+
+#include <linux/init.h>
+#include <linux/of.h>
+#include <linux/perf_event.h>
+
+#include <asm/csr.h>
+#include <asm/perf_event.h>
+
+#ifdef CONFIG_64BIT
+#define read_counter_csr(csr)	csr_read(csr)
+#else
+#define read_counter_csr(csr)						\
+({									\
+	u32 __hi, __lo;							\
+									\
+	do {								\
+		__hi = csr_read(csr##h);				\
+		__lo = csr_read(csr);					\
+	} while (__hi != csr_read(csr##h));				\
+									\
+	((u64)__hi << 32) | __lo;					\
+})
+#endif
+
+#define CASE_HPMCOUNTER(n)	case n: return read_counter_csr(hpmcounter##n)
+
+static u64 riscv_pmu_read_counter(int idx)
+{
+	switch (idx) {
+	case RISCV_PMU_CYCLE:	return read_counter_csr(cycle);
+	case RISCV_PMU_TIME:	return read_counter_csr(time);
+	case RISCV_PMU_INSTRET:	return read_counter_csr(instret);
+	CASE_HPMCOUNTER(3);	CASE_HPMCOUNTER(4);	CASE_HPMCOUNTER(5);
+	CASE_HPMCOUNTER(6);	CASE_HPMCOUNTER(7);	CASE_HPMCOUNTER(8);
+	CASE_HPMCOUNTER(9);	CASE_HPMCOUNTER(10);	CASE_HPMCOUNTER(11);
+	CASE_HPMCOUNTER(12);	CASE_HPMCOUNTER(13);	CASE_HPMCOUNTER(14);
+	CASE_HPMCOUNTER(15);	CASE_HPMCOUNTER(16);	CASE_HPMCOUNTER(17);
+	CASE_HPMCOUNTER(18);	CASE_HPMCOUNTER(19);	CASE_HPMCOUNTER(20);
+	CASE_HPMCOUNTER(21);	CASE_HPMCOUNTER(22);	CASE_HPMCOUNTER(23);
+	CASE_HPMCOUNTER(24);	CASE_HPMCOUNTER(25);	CASE_HPMCOUNTER(26);
+	CASE_HPMCOUNTER(27);	CASE_HPMCOUNTER(28);	CASE_HPMCOUNTER(29);
+	CASE_HPMCOUNTER(30);	CASE_HPMCOUNTER(31);
+	default:
+		WARN_ON_ONCE(1);
+		return 0;
+	}
+}
+
+/* Counters userspace may ask for, and the width of the hpmcounters */
+static unsigned long riscv_pmu_counters __read_mostly =
+	BIT(RISCV_PMU_CYCLE) | BIT(RISCV_PMU_INSTRET);
+static u64 riscv_pmu_hpm_mask __read_mostly = ~0ULL;
+
+static int riscv_hw_event_map[PERF_COUNT_HW_MAX] __read_mostly = {
+	[0 ... PERF_COUNT_HW_MAX - 1]	= -1,
+	[PERF_COUNT_HW_CPU_CYCLES]	= RISCV_PMU_CYCLE,
+	[PERF_COUNT_HW_INSTRUCTIONS]	= RISCV_PMU_INSTRET,
+};
+
+static u64 riscv_pmu_counter_mask(int idx)
+{
+	return idx < RISCV_PMU_HPMCOUNTER3 ? ~0ULL : riscv_pmu_hpm_mask;
+}
+
+static void riscv_pmu_event_update(struct perf_event *event)
+{
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev, now;
+
+	do {
+		prev = local64_read(&hwc->prev_count);
+		now = riscv_pmu_read_counter(hwc->idx);
+	} while (local64_cmpxchg(&hwc->prev_count, prev, now) != prev);
+
+	local64_add((now - prev) & riscv_pmu_counter_mask(hwc->idx),
+		    &event->count);
+}
+
+static void riscv_pmu_start(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	hwc->state = 0;
+	local64_set(&hwc->prev_count, riscv_pmu_read_counter(hwc->idx));
+}
+
+static void riscv_pmu_stop(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	riscv_pmu_event_update(event);
+	hwc->state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int riscv_pmu_add(struct perf_event *event, int flags)
+{
+	event->hw.state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	if (flags & PERF_EF_START)
+		riscv_pmu_start(event, PERF_EF_RELOAD);
+
+	perf_event_update_userpage(event);
+	return 0;
+}
+
+static void riscv_pmu_del(struct perf_event *event, int flags)
+{
+	riscv_pmu_stop(event, PERF_EF_UPDATE);
+	perf_event_update_userpage(event);
+}
+
+static void riscv_pmu_read(struct perf_event *event)
+{
+	riscv_pmu_event_update(event);
+}
+
+static int riscv_pmu_event_init(struct perf_event *event)
+{
+	struct perf_event_attr *attr = &event->attr;
+	int idx;
+
+	switch (attr->type) {
+	case PERF_TYPE_HARDWARE:
+		if (attr->config >= PERF_COUNT_HW_MAX)
+			return -ENOENT;
+		idx = riscv_hw_event_map[attr->config];
+		break;
+	case PERF_TYPE_RAW:
+		idx = attr->config < RISCV_MAX_COUNTERS ? attr->config : -1;
+		break;
+	default:
+		return -ENOENT;
+	}
+
+	if (idx < 0 || !(riscv_pmu_counters & BIT(idx)))
+		return -EOPNOTSUPP;
+
+	/* The counters run in every privilege mode and can't be filtered */
+	if (attr->exclude_user || attr->exclude_kernel ||
+	    attr->exclude_hv || attr->exclude_idle)
+		return -EOPNOTSUPP;
+
+	if (has_branch_stack(event))
+		return -EOPNOTSUPP;
+
+	event->hw.idx = idx;
+	event->hw.config = idx;
+	return 0;
+}
+
+PMU_FORMAT_ATTR(event, "config:0-4");
+
+static struct attribute *riscv_pmu_format_attrs[] = {
+	&format_attr_event.attr,
+	NULL,
+};
+
+static struct attribute_group riscv_pmu_format_group = {
+	.name	= "format",
+	.attrs	= riscv_pmu_format_attrs,
+};
+
+static const struct attribute_group *riscv_pmu_attr_groups[] = {
+	&riscv_pmu_format_group,
+	NULL,
+};
+
+static struct pmu riscv_pmu = {
+	.task_ctx_nr	= perf_hw_context,
+	.capabilities	= PERF_PMU_CAP_NO_INTERRUPT,
+	.attr_groups	= riscv_pmu_attr_groups,
+	.event_init	= riscv_pmu_event_init,
+	.add		= riscv_pmu_add,
+	.del		= riscv_pmu_del,
+	.start		= riscv_pmu_start,
+	.stop		= riscv_pmu_stop,
+	.read		= riscv_pmu_read,
+};
+
+static void __init riscv_pmu_of_init(struct device_node *np)
+{
+	u32 nr_hpm = 0, width = 64, event, idx;
+	int i, n;
+
+	of_property_read_u32(np, "riscv,hpmcounters", &nr_hpm);
+	nr_hpm = min_t(u32, nr_hpm, RISCV_MAX_COUNTERS - RISCV_PMU_HPMCOUNTER3);
+	if (nr_hpm)
+		riscv_pmu_counters |= GENMASK(RISCV_PMU_HPMCOUNTER3 + nr_hpm - 1,
+					      RISCV_PMU_HPMCOUNTER3);
+
+	of_property_read_u32(np, "riscv,counter-width", &width);
+	if (width > 0 && width < 64)
+		riscv_pmu_hpm_mask = GENMASK_ULL(width - 1, 0);
+
+	n = of_property_count_u32_elems(np, "riscv,hw-events");
+	for (i = 0; i + 1 < n; i += 2) {
+		of_property_read_u32_index(np, "riscv,hw-events", i, &event);
+		of_property_read_u32_index(np, "riscv,hw-events", i + 1, &idx);
+
+		if (event >= PERF_COUNT_HW_MAX || idx >= RISCV_MAX_COUNTERS ||
+		    !(riscv_pmu_counters & BIT(idx))) {
+			pr_warn("%pOF: ignoring event %u on counter %u\n",
+				np, event, idx);
+			continue;
+		}
+		riscv_hw_event_map[event] = idx;
+	}
+}
+
+static int __init riscv_pmu_init(void)
+{
+	struct device_node *np;
+
+	np = of_find_compatible_node(NULL, NULL, "riscv,pmu");
+	if (np) {
+		riscv_pmu_of_init(np);
+		of_node_put(np);
+	}
+
+	pr_info("%d counters available, counting only\n",
+		bitmap_weight(&riscv_pmu_counters, RISCV_MAX_COUNTERS));
+
+	return perf_pmu_register(&riscv_pmu, "cpu", PERF_TYPE_RAW);
+}
+arch_initcall(riscv_pmu_init);
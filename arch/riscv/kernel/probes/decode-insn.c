@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/kprobes.h>
+
+#include <asm/bug.h>
+
+#include "decode-insn.h"
+#include "simulate-insn.h"
+
+/* Base ISA major opcodes */
+#define RVI_OPCODE_MASK		0x7f
+#define RVI_OPCODE_AUIPC	0x17
+#define RVI_OPCODE_AMO		0x2f
+#define RVI_OPCODE_BRANCH	0x63
+#define RVI_OPCODE_JALR		0x67
+#define RVI_OPCODE_JAL		0x6f
+#define RVI_OPCODE_SYSTEM	0x73
+
+#define RVI_FUNCT3(insn)	(((insn) >> 12) & 0x7)
+#define RVI_AMO_FUNCT5(insn)	((insn) >> 27)
+#define RVI_AMO_LR		0x02
+#define RVI_AMO_SC		0x03
+
+/* RVC: quadrant in bits 1:0, funct3 in 15:13 */
+#define RVC_MASK		0xe003
+#define RVC_JAL			0x2001	/* RV32 only, c.addiw on RV64 */
+#define RVC_J			0xa001
+#define RVC_BEQZ		0xc001
+#define RVC_BNEZ		0xe001
+#define RVC_JR_JALR_MASK	0xf07f
+#define RVC_JR			0x8002
+#define RVC_JALR		0x9002
+#define RVC_RS1(insn)		(((insn) >> 7) & 0x1f)
+
+static enum probe_insn __kprobes
+riscv_decode_rvc(u16 insn, struct arch_probe_insn *api)
+{
+	if (insn == __BUG_INSN_16)
+		return INSN_REJECTED;
+
+	switch (insn & RVC_MASK) {
+	case RVC_J:
+		api->handler = simulate_c_j;
+		return INSN_GOOD_NO_SLOT;
+#ifndef CONFIG_64BIT
+	case RVC_JAL:
+		api->handler = simulate_c_jal;
+		return INSN_GOOD_NO_SLOT;
+#endif
+	case RVC_BEQZ:
+		api->handler = simulate_c_beqz;
+		return INSN_GOOD_NO_SLOT;
+	case RVC_BNEZ:
+		api->handler = simulate_c_bnez;
+		return INSN_GOOD_NO_SLOT;
+	}
+
+	/* rs1 == 0 encodes c.ebreak and c.mv/c.add, not a jump */
+	if (RVC_RS1(insn)) {
+		switch (insn & RVC_JR_JALR_MASK) {
+		case RVC_JR:
+			api->handler = simulate_c_jr;
+			return INSN_GOOD_NO_SLOT;
+		case RVC_JALR:
+			api->handler = simulate_c_jalr;
+			return INSN_GOOD_NO_SLOT;
+		}
+	}
+
+	return INSN_GOOD;
+}
+
+/*
+ * PC-relative instructions would compute the wrong thing in the XOL slot,
+ * so they are simulated instead.  Anything that changes privileged state
+ * or relies on a reservation surviving until the next instruction can't
+ * be stepped at all.
+ */
+enum probe_insn __kprobes
+riscv_probe_decode_insn(probe_opcode_t insn, struct arch_probe_insn *api)
+{
+	api->handler = NULL;
+
+	if (GET_INSN_LENGTH(insn) == 2)
+		return riscv_decode_rvc(insn, api);
+
+	switch (insn & RVI_OPCODE_MASK) {
+	case RVI_OPCODE_SYSTEM:
+		/* ecall, ebreak, sret, wfi, sfence.vma and the CSR ops */
+		return INSN_REJECTED;
+	case RVI_OPCODE_AMO:
+		if (RVI_AMO_FUNCT5(insn) == RVI_AMO_LR ||
+		    RVI_AMO_FUNCT5(insn) == RVI_AMO_SC)
+			return INSN_REJECTED;
+		return INSN_GOOD;
+	case RVI_OPCODE_JAL:
+		api->handler = simulate_jal;
+		return INSN_GOOD_NO_SLOT;
+	case RVI_OPCODE_JALR:
+		api->handler = simulate_jalr;
+		return INSN_GOOD_NO_SLOT;
+	case RVI_OPCODE_AUIPC:
+		api->handler = simulate_auipc;
+		return INSN_GOOD_NO_SLOT;
+	case RVI_OPCODE_BRANCH:
+		/* funct3 2 and 3 are reserved */
+		if (RVI_FUNCT3(insn) == 2 || RVI_FUNCT3(insn) == 3)
+			return INSN_REJECTED;
+		api->handler = simulate_branch;
+		return INSN_GOOD_NO_SLOT;
+	}
+
+	return INSN_GOOD;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/bitops.h>
+#include <linux/kernel.h>
+#include <linux/kprobes.h>
+
+#include "simulate-insn.h"
+
+/*
+ * struct pt_regs starts with sepc followed by x1-x31 in order, so a GPR
+ * number indexes it directly once x0 is special-cased.
+ */
+static inline unsigned long rv_reg_get(struct pt_regs *regs, u32 n)
+{
+	return n ? ((unsigned long *)regs)[n] : 0;
+}
+
+static inline void rv_reg_set(struct pt_regs *regs, u32 n, unsigned long val)
+{
+	if (n)
+		((unsigned long *)regs)[n] = val;
+}
+
+#define RV_RD(insn)		(((insn) >> 7) & 0x1f)
+#define RV_RS1(insn)		(((insn) >> 15) & 0x1f)
+#define RV_RS2(insn)		(((insn) >> 20) & 0x1f)
+#define RVC_RS1_PRIME(insn)	(8 + (((insn) >> 7) & 0x7))
+
+bool __kprobes simulate_jal(u32 opcode, unsigned long addr,
+			    struct pt_regs *regs)
+{
+	/* imm[20|10:1|11|19:12] in bits 31:12 */
+	unsigned long imm = ((opcode >> 21) & 0x3ff) << 1 |
+			    ((opcode >> 20) & 0x1) << 11 |
+			    ((opcode >> 12) & 0xff) << 12;
+
+	imm = sign_extend64(imm | ((opcode >> 31) << 20), 20);
+
+	rv_reg_set(regs, RV_RD(opcode), addr + 4);
+	regs->sepc = addr + imm;
+	return true;
+}
+
+bool __kprobes simulate_jalr(u32 opcode, unsigned long addr,
+			     struct pt_regs *regs)
+{
+	unsigned long target;
+
+	/* rd may equal rs1, so read it first */
+	target = rv_reg_get(regs, RV_RS1(opcode)) + ((s32)opcode >> 20);
+
+	rv_reg_set(regs, RV_RD(opcode), addr + 4);
+	regs->sepc = target & ~1UL;
+	return true;
+}
+
+bool __kprobes simulate_auipc(u32 opcode, unsigned long addr,
+			      struct pt_regs *regs)
+{
+	rv_reg_set(regs, RV_RD(opcode), addr + (s32)(opcode & 0xfffff000));
+	regs->sepc = addr + 4;
+	return true;
+}
+
+bool __kprobes simulate_branch(u32 opcode, unsigned long addr,
+			       struct pt_regs *regs)
+{
+	unsigned long rs1 = rv_reg_get(regs, RV_RS1(opcode));
+	unsigned long rs2 = rv_reg_get(regs, RV_RS2(opcode));
+	/* imm[12|10:5] in bits 31:25, imm[4:1|11] in bits 11:7 */
+	unsigned long imm = ((opcode >> 20) & 0x7e0) |
+			    ((opcode >> 7) & 0x1e) |
+			    ((opcode << 4) & 0x800) |
+			    ((opcode >> 31) << 12);
+	bool taken;
+
+	switch ((opcode >> 12) & 0x7) {
+	case 0:
+		taken = rs1 == rs2;
+		break;
+	case 1:
+		taken = rs1 != rs2;
+		break;
+	case 4:
+		taken = (long)rs1 < (long)rs2;
+		break;
+	case 5:
+		taken = (long)rs1 >= (long)rs2;
+		break;
+	case 6:
+		taken = rs1 < rs2;
+		break;
+	case 7:
+		taken = rs1 >= rs2;
+		break;
+	default:
+		return false;
+	}
+
+	regs->sepc = taken ? addr + sign_extend64(imm, 12) : addr + 4;
+	return true;
+}
+
+/* imm[11|4|9:8|10|6|7|3:1|5] in bits 12:2 */
+static unsigned long rvc_j_imm(u32 insn)
+{
+	unsigned long imm = ((insn >> 1) & 0x800) |
+			    ((insn >> 7) & 0x10) |
+			    ((insn >> 1) & 0x300) |
+			    ((insn << 2) & 0x400) |
+			    ((insn >> 1) & 0x40) |
+			    ((insn << 1) & 0x80) |
+			    ((insn >> 2) & 0xe) |
+			    ((insn << 3) & 0x20);
+
+	return sign_extend64(imm, 11);
+}
+
+/* imm[8|4:3] in bits 12:10, imm[7:6|2:1|5] in bits 6:2 */
+static unsigned long rvc_b_imm(u32 insn)
+{
+	unsigned long imm = ((insn >> 4) & 0x100) |
+			    ((insn >> 7) & 0x18) |
+			    ((insn << 1) & 0xc0) |
+			    ((insn >> 2) & 0x6) |
+			    ((insn << 3) & 0x20);
+
+	return sign_extend64(imm, 8);
+}
+
+bool __kprobes simulate_c_j(u32 opcode, unsigned long addr,
+			    struct pt_regs *regs)
+{
+	regs->sepc = addr + rvc_j_imm(opcode);
+	return true;
+}
+
+bool __kprobes simulate_c_jal(u32 opcode, unsigned long addr,
+			      struct pt_regs *regs)
+{
+	regs->ra = addr + 2;
+	regs->sepc = addr + rvc_j_imm(opcode);
+	return true;
+}
+
+bool __kprobes simulate_c_jr(u32 opcode, unsigned long addr,
+			     struct pt_regs *regs)
+{
+	regs->sepc = rv_reg_get(regs, (opcode >> 7) & 0x1f) & ~1UL;
+	return true;
+}
+
+bool __kprobes simulate_c_jalr(u32 opcode, unsigned long addr,
+			       struct pt_regs *regs)
+{
+	unsigned long target = rv_reg_get(regs, (opcode >> 7) & 0x1f);
+
+	regs->ra = addr + 2;
+	regs->sepc = target & ~1UL;
+	return true;
+}
+
+bool __kprobes simulate_c_beqz(u32 opcode, unsigned long addr,
+			       struct pt_regs *regs)
+{
+	if (!rv_reg_get(regs, RVC_RS1_PRIME(opcode)))
+		regs->sepc = addr + rvc_b_imm(opcode);
+	else
+		regs->sepc = addr + 2;
+	return true;
+}
+
+bool __kprobes simulate_c_bnez(u32 opcode, unsigned long addr,
+			       struct pt_regs *regs)
+{
+	if (rv_reg_get(regs, RVC_RS1_PRIME(opcode)))
+		regs->sepc = addr + rvc_b_imm(opcode);
+	else
+		regs->sepc = addr + 2;
+	return true;
+}
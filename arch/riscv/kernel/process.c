@@ -32,6 +32,7 @@
 #include <asm/csr.h>
 #include <asm/string.h>
 #include <asm/switch_to.h>
+#include <asm/vector.h>
 
 extern asmlinkage void ret_from_fork(void);
 extern asmlinkage void ret_from_kernel_thread(void);
@@ -90,15 +91,27 @@ void flush_thread(void)
 	 *	fflags: accrued exceptions cleared
 	 */
 	memset(&current->thread.fstate, 0, sizeof(current->thread.fstate));
+	current->thread.fstate_lazy = false;
+	current->thread.fstate_slices = 0;
+	/* The new image starts with the vector unit off */
+	riscv_v_thread_free(current);
 }
 
 int arch_dup_task_struct(struct task_struct *dst, struct task_struct *src)
 {
 	fstate_save(src, task_pt_regs(src));
 	*dst = *src;
+
+	/* Vector state is caller-saved: the child starts without, see below */
+	dst->thread.vstate.datap = NULL;
 	return 0;
 }
 
+void arch_release_task_struct(struct task_struct *tsk)
+{
+	riscv_v_thread_free(tsk);
+}
+
 int copy_thread(unsigned long clone_flags, unsigned long usp,
 	unsigned long arg, struct task_struct *p)
 {
@@ -117,6 +130,7 @@ int copy_thread(unsigned long clone_flags, unsigned long usp,
 		p->thread.s[1] = arg;
 	} else {
 		*childregs = *(current_pt_regs());
+		childregs->sstatus &= ~SR_VS;
 		if (usp) /* User fork */
 			childregs->sp = usp;
 		if (clone_flags & CLONE_SETTLS)
@@ -18,6 +18,7 @@
 #include <asm/ptrace.h>
 #include <asm/syscall.h>
 #include <asm/thread_info.h>
+#include <asm/vector.h>
 #include <linux/ptrace.h>
 #include <linux/elf.h>
 #include <linux/regset.h>
@@ -28,6 +29,7 @@
 
 enum riscv_regset {
 	REGSET_X,
+	REGSET_V,
 };
 
 static int riscv_gpr_get(struct task_struct *target,
@@ -54,8 +56,75 @@ static int riscv_gpr_set(struct task_struct *target,
 	return ret;
 }
 
+/*
+ * A stopped tracee's vector registers were saved when it was switched
+ * out, and are reloaded from vstate by its next vector instruction.
+ */
+static int riscv_vr_get(struct task_struct *target,
+			const struct user_regset *regset,
+			unsigned int pos, unsigned int count,
+			void *kbuf, void __user *ubuf)
+{
+	struct __riscv_v_ext_state *vstate = &target->thread.vstate;
+	struct __riscv_v_regset_state ptrace_vstate;
+	const size_t start = offsetof(struct __riscv_v_regset_state, vreg);
+	int ret;
+
+	if (!vstate->datap)
+		return -ENODATA;
+
+	ptrace_vstate.vstart = vstate->vstart;
+	ptrace_vstate.vl = vstate->vl;
+	ptrace_vstate.vtype = vstate->vtype;
+	ptrace_vstate.vcsr = vstate->vcsr;
+	ptrace_vstate.vlenb = vstate->vlenb;
+
+	ret = user_regset_copyout(&pos, &count, &kbuf, &ubuf,
+				  &ptrace_vstate, 0, start);
+	if (!ret)
+		ret = user_regset_copyout(&pos, &count, &kbuf, &ubuf,
+					  vstate->datap, start,
+					  start + riscv_v_vsize);
+	return ret;
+}
+
+static int riscv_vr_set(struct task_struct *target,
+			const struct user_regset *regset,
+			unsigned int pos, unsigned int count,
+			const void *kbuf, const void __user *ubuf)
+{
+	struct __riscv_v_ext_state *vstate = &target->thread.vstate;
+	struct __riscv_v_regset_state ptrace_vstate;
+	const size_t start = offsetof(struct __riscv_v_regset_state, vreg);
+	int ret;
+
+	if (!vstate->datap)
+		return -ENODATA;
+
+	ptrace_vstate.vstart = vstate->vstart;
+	ptrace_vstate.vl = vstate->vl;
+	ptrace_vstate.vtype = vstate->vtype;
+	ptrace_vstate.vcsr = vstate->vcsr;
+	ptrace_vstate.vlenb = vstate->vlenb;
+
+	ret = user_regset_copyin(&pos, &count, &kbuf, &ubuf,
+				 &ptrace_vstate, 0, start);
+	if (ret)
+		return ret;
+	if (ptrace_vstate.vlenb != vstate->vlenb)
+		return -EINVAL;
+
+	vstate->vstart = ptrace_vstate.vstart;
+	vstate->vl = ptrace_vstate.vl;
+	vstate->vtype = ptrace_vstate.vtype;
+	vstate->vcsr = ptrace_vstate.vcsr;
+
+	return user_regset_copyin(&pos, &count, &kbuf, &ubuf,
+				  vstate->datap, start, start + riscv_v_vsize);
+}
 
-static const struct user_regset riscv_user_regset[] = {
+/* REGSET_V is sized once the vector length is known */
+static struct user_regset riscv_user_regset[] __ro_after_init = {
 	[REGSET_X] = {
 		.core_note_type = NT_PRSTATUS,
 		.n = ELF_NGREG,
@@ -64,8 +133,25 @@ static const struct user_regset riscv_user_regset[] = {
 		.get = &riscv_gpr_get,
 		.set = &riscv_gpr_set,
 	},
+	[REGSET_V] = {
+		.core_note_type = NT_RISCV_VECTOR,
+		.size = sizeof(__u32),
+		.align = sizeof(__u32),
+		.get = &riscv_vr_get,
+		.set = &riscv_vr_set,
+	},
 };
 
+static int __init riscv_v_regset_init(void)
+{
+	if (has_vector())
+		riscv_user_regset[REGSET_V].n =
+			(sizeof(struct __riscv_v_regset_state) +
+			 riscv_v_vsize) / sizeof(__u32);
+	return 0;
+}
+arch_initcall(riscv_v_regset_init);
+
 static const struct user_regset_view riscv_user_native_view = {
 	.name = "riscv",
 	.e_machine = EM_RISCV,
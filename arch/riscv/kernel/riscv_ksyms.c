@@ -7,9 +7,13 @@
  */
 
 #include <linux/export.h>
+#include <linux/string.h>
 #include <linux/uaccess.h>
 
 /*
  * Assembly functions that may be used (directly or indirectly) by modules
  */
 EXPORT_SYMBOL(__copy_user);
+EXPORT_SYMBOL(memset);
+EXPORT_SYMBOL(memcpy);
+EXPORT_SYMBOL(memmove);
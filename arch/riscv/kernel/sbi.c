@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/errno.h>
+#include <linux/export.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+
+#include <asm/sbi.h>
+#include <asm/smp.h>
+
+/*
+ * The timer, IPI and remote fence calls go through whichever interface
+ * the firmware has, picked once in sbi_init().  The legacy calls take a
+ * pointer to a single word of hart IDs, so only harts below BITS_PER_LONG
+ * can be named; the v0.2 extensions take the mask by value together with
+ * the hart ID its bit 0 stands for, and a CPU mask is sent as one call
+ * per BITS_PER_LONG-wide window of hart IDs it covers.
+ */
+
+unsigned long sbi_spec_version __ro_after_init;
+EXPORT_SYMBOL(sbi_spec_version);
+
+int sbi_err_map_linux_errno(int err)
+{
+	switch (err) {
+	case SBI_SUCCESS:
+		return 0;
+	case SBI_ERR_DENIED:
+		return -EPERM;
+	case SBI_ERR_INVALID_PARAM:
+		return -EINVAL;
+	case SBI_ERR_INVALID_ADDRESS:
+		return -EFAULT;
+	case SBI_ERR_NOT_SUPPORTED:
+		return -EOPNOTSUPP;
+	case SBI_ERR_ALREADY_AVAILABLE:
+		return -EALREADY;
+	case SBI_ERR_FAILURE:
+	default:
+		return -EIO;
+	}
+}
+EXPORT_SYMBOL(sbi_err_map_linux_errno);
+
+static void __sbi_set_timer_v01(uint64_t stime_value)
+{
+#if __riscv_xlen == 32
+	SBI_CALL_2(SBI_SET_TIMER, stime_value, stime_value >> 32);
+#else
+	SBI_CALL_1(SBI_SET_TIMER, stime_value);
+#endif
+}
+
+/* A NULL CPU mask is all harts, which the legacy calls spell as NULL too */
+static const unsigned long *sbi_v01_hart_mask(const struct cpumask *cpu_mask,
+					      unsigned long *hmask)
+{
+	if (!cpu_mask)
+		return NULL;
+	*hmask = riscv_cpuid_to_hartid_mask(cpu_mask);
+	return hmask;
+}
+
+static int __sbi_send_ipi_v01(const struct cpumask *cpu_mask)
+{
+	unsigned long hmask;
+
+	SBI_CALL_1(SBI_SEND_IPI, sbi_v01_hart_mask(cpu_mask, &hmask));
+	return 0;
+}
+
+static int __sbi_rfence_v01(int fid, const struct cpumask *cpu_mask,
+			    unsigned long start, unsigned long size,
+			    unsigned long asid)
+{
+	unsigned long hmask;
+	const unsigned long *hp = sbi_v01_hart_mask(cpu_mask, &hmask);
+
+	switch (fid) {
+	case SBI_EXT_RFENCE_REMOTE_FENCE_I:
+		SBI_CALL_1(SBI_REMOTE_FENCE_I, hp);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA:
+		SBI_CALL_3(SBI_REMOTE_SFENCE_VMA, hp, start, size);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID:
+		SBI_CALL_4(SBI_REMOTE_SFENCE_VMA_ASID, hp, start, size, asid);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static void __sbi_set_timer_v02(uint64_t stime_value)
+{
+#if __riscv_xlen == 32
+	SBI_ECALL(SBI_EXT_TIME, SBI_EXT_TIME_SET_TIMER,
+		  stime_value, stime_value >> 32, 0);
+#else
+	SBI_ECALL(SBI_EXT_TIME, SBI_EXT_TIME_SET_TIMER, stime_value, 0, 0);
+#endif
+}
+
+static int __sbi_v02_call(unsigned long ext, int fid, unsigned long hmask,
+			  unsigned long hbase, unsigned long start,
+			  unsigned long size, unsigned long asid)
+{
+	struct sbiret ret;
+
+	if (ext == SBI_EXT_IPI)
+		ret = SBI_ECALL(SBI_EXT_IPI, SBI_EXT_IPI_SEND_IPI,
+				hmask, hbase, 0);
+	else
+		ret = SBI_ECALL5(SBI_EXT_RFENCE, fid, hmask, hbase,
+				 start, size, asid);
+
+	if (ret.error) {
+		pr_warn_ratelimited(
+			"SBI call %lx:%d to harts %lx at %ld failed: %ld\n",
+			ext, fid, hmask, (long)hbase, ret.error);
+		return sbi_err_map_linux_errno(ret.error);
+	}
+	return 0;
+}
+
+/*
+ * One call per window of hart IDs: CPU numbers are handed out in hart ID
+ * order on most platforms, so a mask of neighbouring CPUs is one ecall
+ * per BITS_PER_LONG harts whatever the hart IDs are.  A hart base of -1
+ * stands for all harts.
+ */
+static int __sbi_v02_cpumask_call(unsigned long ext, int fid,
+				  const struct cpumask *cpu_mask,
+				  unsigned long start, unsigned long size,
+				  unsigned long asid)
+{
+	unsigned long hmask = 0, hbase = 0;
+	int cpu, err;
+
+	if (!cpu_mask)
+		return __sbi_v02_call(ext, fid, 0, -1UL, start, size, asid);
+
+	for_each_cpu(cpu, cpu_mask) {
+		unsigned long hartid = cpuid_to_hartid_map(cpu);
+
+		if (hmask &&
+		    (hartid < hbase || hartid >= hbase + BITS_PER_LONG)) {
+			err = __sbi_v02_call(ext, fid, hmask, hbase,
+					     start, size, asid);
+			if (err)
+				return err;
+			hmask = 0;
+		}
+		if (!hmask)
+			hbase = hartid;
+		hmask |= 1UL << (hartid - hbase);
+	}
+
+	if (!hmask)
+		return 0;
+	return __sbi_v02_call(ext, fid, hmask, hbase, start, size, asid);
+}
+
+static int __sbi_send_ipi_v02(const struct cpumask *cpu_mask)
+{
+	return __sbi_v02_cpumask_call(SBI_EXT_IPI, SBI_EXT_IPI_SEND_IPI,
+				      cpu_mask, 0, 0, 0);
+}
+
+static int __sbi_rfence_v02(int fid, const struct cpumask *cpu_mask,
+			    unsigned long start, unsigned long size,
+			    unsigned long asid)
+{
+	return __sbi_v02_cpumask_call(SBI_EXT_RFENCE, fid, cpu_mask,
+				      start, size, asid);
+}
+
+static void (*__sbi_set_timer)(uint64_t stime_value) __ro_after_init =
+	__sbi_set_timer_v01;
+static int (*__sbi_send_ipi)(const struct cpumask *cpu_mask) __ro_after_init =
+	__sbi_send_ipi_v01;
+static int (*__sbi_rfence)(int fid, const struct cpumask *cpu_mask,
+			   unsigned long start, unsigned long size,
+			   unsigned long asid) __ro_after_init =
+	__sbi_rfence_v01;
+
+void sbi_set_timer(uint64_t stime_value)
+{
+	SBI_STAT(SBI_SET_TIMER, __sbi_set_timer(stime_value));
+}
+EXPORT_SYMBOL(sbi_set_timer);
+
+int sbi_send_ipi(const struct cpumask *cpu_mask)
+{
+	int ret;
+
+	SBI_STAT(SBI_SEND_IPI, ret = __sbi_send_ipi(cpu_mask));
+	return ret;
+}
+EXPORT_SYMBOL(sbi_send_ipi);
+
+int sbi_remote_fence_i(const struct cpumask *cpu_mask)
+{
+	int ret;
+
+	SBI_STAT(SBI_REMOTE_FENCE_I,
+		 ret = __sbi_rfence(SBI_EXT_RFENCE_REMOTE_FENCE_I,
+				    cpu_mask, 0, 0, 0));
+	return ret;
+}
+EXPORT_SYMBOL(sbi_remote_fence_i);
+
+int sbi_remote_sfence_vma(const struct cpumask *cpu_mask,
+			  unsigned long start, unsigned long size)
+{
+	int ret;
+
+	SBI_STAT(SBI_REMOTE_SFENCE_VMA,
+		 ret = __sbi_rfence(SBI_EXT_RFENCE_REMOTE_SFENCE_VMA,
+				    cpu_mask, start, size, 0));
+	return ret;
+}
+EXPORT_SYMBOL(sbi_remote_sfence_vma);
+
+int sbi_remote_sfence_vma_asid(const struct cpumask *cpu_mask,
+			       unsigned long start, unsigned long size,
+			       unsigned long asid)
+{
+	int ret;
+
+	SBI_STAT(SBI_REMOTE_SFENCE_VMA_ASID,
+		 ret = __sbi_rfence(SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID,
+				    cpu_mask, start, size, asid));
+	return ret;
+}
+EXPORT_SYMBOL(sbi_remote_sfence_vma_asid);
+
+/*
+ * Early in setup_arch, before the first timer is programmed or another
+ * hart is started.  Firmware older than v0.2 fails the base extension
+ * call like any other one it doesn't know, and keeps the legacy calls.
+ */
+void __init sbi_init(void)
+{
+	struct sbiret ret;
+
+	ret = SBI_ECALL(SBI_EXT_BASE, SBI_EXT_BASE_GET_SPEC_VERSION, 0, 0, 0);
+	if (ret.error) {
+		pr_info("SBI v0.1 firmware, using the legacy calls\n");
+		return;
+	}
+
+	sbi_spec_version = ret.value;
+	pr_info("SBI specification v%lu.%lu detected\n",
+		sbi_spec_version >> SBI_SPEC_VERSION_MAJOR_SHIFT,
+		sbi_spec_version & SBI_SPEC_VERSION_MINOR_MASK);
+
+	if (sbi_probe_extension(SBI_EXT_TIME) > 0) {
+		__sbi_set_timer = __sbi_set_timer_v02;
+		pr_info("SBI TIME extension detected\n");
+	}
+	if (sbi_probe_extension(SBI_EXT_IPI) > 0) {
+		__sbi_send_ipi = __sbi_send_ipi_v02;
+		pr_info("SBI IPI extension detected\n");
+	}
+	if (sbi_probe_extension(SBI_EXT_RFENCE) > 0) {
+		__sbi_rfence = __sbi_rfence_v02;
+		pr_info("SBI RFENCE extension detected\n");
+	}
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/export.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+
+#include <asm/sbi.h>
+
+#define CREATE_TRACE_POINTS
+#include <asm/trace/sbi.h>
+
+struct sbi_stat {
+	u64 count;
+	u64 cycles;
+};
+
+static DEFINE_PER_CPU(struct sbi_stat, sbi_stats[SBI_NR_LEGACY]);
+
+static const char * const sbi_stat_names[SBI_NR_LEGACY] = {
+	[SBI_SET_TIMER]			= "set_timer",
+	[SBI_SEND_IPI]			= "send_ipi",
+	[SBI_REMOTE_FENCE_I]		= "remote_fence_i",
+	[SBI_REMOTE_SFENCE_VMA]		= "remote_sfence_vma",
+	[SBI_REMOTE_SFENCE_VMA_ASID]	= "remote_sfence_vma_asid",
+};
+
+/*
+ * Called with the time the call was started at, in the same timer ticks
+ * as get_cycles(), from whatever context made it, interrupts included.
+ */
+void notrace sbi_stat_account(unsigned int which, cycles_t start)
+{
+	cycles_t cycles = get_cycles() - start;
+
+	this_cpu_inc(sbi_stats[which].count);
+	this_cpu_add(sbi_stats[which].cycles, cycles);
+	trace_sbi_call(which, cycles);
+}
+EXPORT_SYMBOL(sbi_stat_account);
+
+static int sbi_stats_show(struct seq_file *m, void *v)
+{
+	unsigned int which;
+	int cpu;
+
+	seq_puts(m, "cpu\tcall\tcount\tcycles\n");
+	for_each_possible_cpu(cpu) {
+		for (which = 0; which < SBI_NR_LEGACY; which++) {
+			struct sbi_stat *s = &per_cpu(sbi_stats[which], cpu);
+
+			if (!sbi_stat_names[which])
+				continue;
+			seq_printf(m, "%d\t%s\t%llu\t%llu\n", cpu,
+				   sbi_stat_names[which],
+				   READ_ONCE(s->count), READ_ONCE(s->cycles));
+		}
+	}
+	return 0;
+}
+
+static int sbi_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sbi_stats_show, NULL);
+}
+
+/* Any write starts the counts over, to measure one workload at a time */
+static ssize_t sbi_stats_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&sbi_stats, cpu), 0, sizeof(sbi_stats));
+	return count;
+}
+
+static const struct file_operations sbi_stats_fops = {
+	.open		= sbi_stats_open,
+	.read		= seq_read,
+	.write		= sbi_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init sbi_stats_init(void)
+{
+	debugfs_create_file("sbi_stats", S_IRUSR | S_IWUSR, NULL, NULL,
+			    &sbi_stats_fops);
+	return 0;
+}
+late_initcall(sbi_stats_init);
@@ -20,16 +20,23 @@
  */
 
 #include <linux/init.h>
+#include <linux/export.h>
+#include <linux/bootmem.h>
+#include <linux/cpu.h>
 #include <linux/mm.h>
 #include <linux/memblock.h>
 #include <linux/sched.h>
 #include <linux/initrd.h>
+#include <linux/ioport.h>
+#include <linux/kexec.h>
 #include <linux/console.h>
 #include <linux/screen_info.h>
 #include <linux/of_fdt.h>
 #include <linux/of_platform.h>
 #include <linux/sched/task.h>
 
+#include <asm/alternative.h>
+#include <asm/cpu_ops.h>
 #include <asm/setup.h>
 #include <asm/sections.h>
 #include <asm/pgtable.h>
@@ -62,6 +69,7 @@ unsigned long pfn_base;
 
 /* The lucky hart to first increment this variable will boot the other cores */
 atomic_t hart_lottery;
+unsigned long boot_cpu_hartid;
 
 #ifdef CONFIG_BLK_DEV_INITRD
 static void __init setup_initrd(void)
@@ -101,11 +109,53 @@ static void __init setup_initrd(void)
 pgd_t swapper_pg_dir[PTRS_PER_PGD] __page_aligned_bss;
 pgd_t trampoline_pg_dir[PTRS_PER_PGD] __initdata __aligned(PAGE_SIZE);
 
+unsigned long sptbr_mode __ro_after_init = SPTBR_MODE;
+
 #ifndef __PAGETABLE_PMD_FOLDED
-#define NUM_SWAPPER_PMDS ((uintptr_t)-PAGE_OFFSET >> PGDIR_SHIFT)
-pmd_t swapper_pmd[PTRS_PER_PMD*((-PAGE_OFFSET)/PGDIR_SIZE)] __page_aligned_bss;
-pmd_t trampoline_pmd[PTRS_PER_PGD] __initdata __aligned(PAGE_SIZE);
+bool pgtable_l4_enabled __ro_after_init;
+EXPORT_SYMBOL(pgtable_l4_enabled);
+
+pud_t swapper_pud[PTRS_PER_PUD] __page_aligned_bss;
+pud_t trampoline_pud[PTRS_PER_PUD] __initdata __aligned(PAGE_SIZE);
+pmd_t swapper_pmd[PTRS_PER_PMD*((-PAGE_OFFSET)/PUD_SIZE)] __page_aligned_bss;
+pmd_t trampoline_pmd[PTRS_PER_PMD] __initdata __aligned(PAGE_SIZE);
+pmd_t fixmap_pmd[PTRS_PER_PMD] __page_aligned_bss;
+
+/*
+ * sptbr ignores a write with a mode the hart doesn't implement, so try
+ * Sv48 with the two gigapages we run from mapped to themselves, and see
+ * whether it stuck.  The kernel's own addresses are the top of Sv39,
+ * which lie in the last Sv48 PGD entry, so either way they stay put.
+ */
+static void __init setup_sptbr_mode(uintptr_t pa)
+{
+	pgprot_t prot = __pgprot(pgprot_val(PAGE_KERNEL) | _PAGE_EXEC);
+	unsigned long mode;
+	uintptr_t i;
+
+	trampoline_pg_dir[(pa >> PGDIR_SHIFT_L4) % PTRS_PER_PGD] =
+		pfn_pgd(PFN_DOWN((uintptr_t)trampoline_pud),
+			__pgprot(_PAGE_TABLE));
+	for (i = 0; i < 2 && pud_index(pa) + i < PTRS_PER_PUD; i++)
+		trampoline_pud[pud_index(pa) + i] =
+			pfn_pud(PFN_DOWN((pa & PUD_MASK) + i * PUD_SIZE), prot);
+
+	csr_write(sptbr, PFN_DOWN((uintptr_t)trampoline_pg_dir) |
+		  SPTBR_MODE_48);
+	mode = csr_read(sptbr) >> SPTBR_MODE_SHIFT;
+	csr_write(sptbr, 0);
+	local_flush_tlb_all();
+
+	memset(trampoline_pg_dir, 0, sizeof(trampoline_pg_dir));
+	memset(trampoline_pud, 0, sizeof(trampoline_pud));
+
+	if (mode == (SPTBR_MODE_48 >> SPTBR_MODE_SHIFT)) {
+		pgtable_l4_enabled = true;
+		sptbr_mode = SPTBR_MODE_48;
+	}
+}
 #endif
+pte_t fixmap_pte[PTRS_PER_PTE] __page_aligned_bss;
 
 asmlinkage void __init setup_vm(void)
 {
@@ -113,28 +163,54 @@ asmlinkage void __init setup_vm(void)
 	uintptr_t i;
 	uintptr_t pa = (uintptr_t) &_start;
 	pgprot_t prot = __pgprot(pgprot_val(PAGE_KERNEL) | _PAGE_EXEC);
+#ifndef __PAGETABLE_PMD_FOLDED
+	/*
+	 * The PUDs are the PGDs themselves on Sv39.  On Sv48 one PGD entry
+	 * points at each, and the one of swapper_pg_dir is copied into
+	 * every mm, so later kernel PUD entries show up in all of them.
+	 */
+	pud_t *tramp_pud = (pud_t *)trampoline_pg_dir;
+	pud_t *kern_pud = (pud_t *)swapper_pg_dir;
+#endif
 
 	va_pa_offset = PAGE_OFFSET - pa;
 	pfn_base = PFN_DOWN(pa);
 
 	/* Sanity check alignment and size */
-	BUG_ON((PAGE_OFFSET % PGDIR_SIZE) != 0);
+	BUG_ON((PAGE_OFFSET % PUD_SIZE) != 0);
 	BUG_ON((pa % (PAGE_SIZE * PTRS_PER_PTE)) != 0);
 
 #ifndef __PAGETABLE_PMD_FOLDED
-	trampoline_pg_dir[(PAGE_OFFSET >> PGDIR_SHIFT) % PTRS_PER_PGD] =
-		pfn_pgd(PFN_DOWN((uintptr_t)trampoline_pmd),
+	setup_sptbr_mode(pa);
+	if (pgtable_l4_enabled) {
+		trampoline_pg_dir[pgd_index(PAGE_OFFSET)] =
+			pfn_pgd(PFN_DOWN((uintptr_t)trampoline_pud),
+				__pgprot(_PAGE_TABLE));
+		swapper_pg_dir[pgd_index(PAGE_OFFSET)] =
+			pfn_pgd(PFN_DOWN((uintptr_t)swapper_pud),
+				__pgprot(_PAGE_TABLE));
+		tramp_pud = trampoline_pud;
+		kern_pud = swapper_pud;
+	}
+
+	tramp_pud[pud_index(PAGE_OFFSET)] =
+		pfn_pud(PFN_DOWN((uintptr_t)trampoline_pmd),
 			__pgprot(_PAGE_TABLE));
 	trampoline_pmd[0] = pfn_pmd(PFN_DOWN(pa), prot);
 
-	for (i = 0; i < (-PAGE_OFFSET)/PGDIR_SIZE; ++i) {
-		size_t o = (PAGE_OFFSET >> PGDIR_SHIFT) % PTRS_PER_PGD + i;
-		swapper_pg_dir[o] =
-			pfn_pgd(PFN_DOWN((uintptr_t)swapper_pmd) + i,
+	for (i = 0; i < (-PAGE_OFFSET)/PUD_SIZE; ++i)
+		kern_pud[pud_index(PAGE_OFFSET) + i] =
+			pfn_pud(PFN_DOWN((uintptr_t)swapper_pmd) + i,
 				__pgprot(_PAGE_TABLE));
-	}
 	for (i = 0; i < ARRAY_SIZE(swapper_pmd); i++)
 		swapper_pmd[i] = pfn_pmd(PFN_DOWN(pa + i * PMD_SIZE), prot);
+
+	kern_pud[pud_index(FIXADDR_START)] =
+		pfn_pud(PFN_DOWN((uintptr_t)fixmap_pmd),
+			__pgprot(_PAGE_TABLE));
+	fixmap_pmd[pmd_index(FIXADDR_START)] =
+		pfn_pmd(PFN_DOWN((uintptr_t)fixmap_pte),
+			__pgprot(_PAGE_TABLE));
 #else
 	trampoline_pg_dir[(PAGE_OFFSET >> PGDIR_SHIFT) % PTRS_PER_PGD] =
 		pfn_pgd(PFN_DOWN(pa), prot);
@@ -144,11 +220,16 @@ asmlinkage void __init setup_vm(void)
 		swapper_pg_dir[o] =
 			pfn_pgd(PFN_DOWN(pa + i * PGDIR_SIZE), prot);
 	}
+
+	swapper_pg_dir[pgd_index(FIXADDR_START)] =
+		pfn_pgd(PFN_DOWN((uintptr_t)fixmap_pte),
+			__pgprot(_PAGE_TABLE));
 #endif
 }
 
 void __init sbi_save(unsigned int hartid, void *dtb)
 {
+	boot_cpu_hartid = hartid;
 	early_init_dt_scan(__va(dtb));
 }
 
@@ -171,6 +252,73 @@ static int __init mem_end_override(char *p)
 }
 early_param("mem_end", mem_end_override);
 
+#ifdef CONFIG_KEXEC_CORE
+/*
+ * crashkernel=size[@offset]: memory kept back for a kdump kernel to be
+ * loaded into and run from, which this one then never touches.
+ */
+static void __init reserve_crashkernel(void)
+{
+	unsigned long long crash_base, crash_size;
+	int ret;
+
+	ret = parse_crashkernel(boot_command_line, memblock_phys_mem_size(),
+				&crash_size, &crash_base);
+	if (ret || !crash_size)
+		return;
+
+	crash_size = PAGE_ALIGN(crash_size);
+	if (crash_base == 0) {
+		/* The kernel is mapped from a PMD boundary, so keep to one */
+		crash_base = memblock_find_in_range(0, memblock_end_of_DRAM(),
+						    crash_size, PMD_SIZE);
+		if (crash_base == 0) {
+			pr_warn("cannot allocate crashkernel (size:0x%llx)\n",
+				crash_size);
+			return;
+		}
+	} else if (!memblock_is_region_memory(crash_base, crash_size) ||
+		   memblock_is_region_reserved(crash_base, crash_size)) {
+		pr_warn("crashkernel at 0x%llx isn't free memory\n",
+			crash_base);
+		return;
+	}
+	memblock_reserve(crash_base, crash_size);
+
+	pr_info("crashkernel reserved: 0x%016llx - 0x%016llx (%lld MB)\n",
+		crash_base, crash_base + crash_size, crash_size >> 20);
+
+	crashk_res.start = crash_base;
+	crashk_res.end = crash_base + crash_size - 1;
+}
+#else
+static inline void reserve_crashkernel(void) { }
+#endif
+
+/*
+ * kexec-tools finds the memory it may load into, and the crash kernel's,
+ * in /proc/iomem.
+ */
+static void __init request_memory_resources(void)
+{
+	struct memblock_region *reg;
+	struct resource *res;
+
+	for_each_memblock(memory, reg) {
+		res = memblock_virt_alloc(sizeof(*res), 0);
+		res->name = "System RAM";
+		res->start = reg->base;
+		res->end = reg->base + reg->size - 1;
+		res->flags = IORESOURCE_SYSTEM_RAM | IORESOURCE_BUSY;
+		request_resource(&iomem_resource, res);
+	}
+
+#ifdef CONFIG_KEXEC_CORE
+	if (crashk_res.end > crashk_res.start)
+		insert_resource(&iomem_resource, &crashk_res);
+#endif
+}
+
 static void __init setup_bootmem(void)
 {
 	struct memblock_region *reg;
@@ -192,8 +340,19 @@ static void __init setup_bootmem(void)
 	}
 	BUG_ON(mem_size == 0);
 
+	/*
+	 * The linear map starts with the kernel's region.  Take in whatever
+	 * follows it, such as the memory of other NUMA nodes, as far as the
+	 * linear map reaches, and drop the rest so that nothing allocates
+	 * from memory we can't address.
+	 */
+	mem_size = min(memblock_end_of_DRAM() - PFN_PHYS(pfn_base),
+		       (phys_addr_t)-PAGE_OFFSET);
+	memblock_remove(PFN_PHYS(pfn_base) + mem_size, ULLONG_MAX);
+
 	set_max_mapnr(PFN_DOWN(mem_size));
 	max_low_pfn = pfn_base + PFN_DOWN(mem_size);
+	max_pfn = max_low_pfn;
 
 #ifdef CONFIG_BLK_DEV_INITRD
 	setup_initrd();
@@ -201,6 +360,7 @@ static void __init setup_bootmem(void)
 
 	early_init_fdt_reserve_self();
 	early_init_fdt_scan_reserved_mem();
+	reserve_crashkernel();
 	memblock_allow_resize();
 	memblock_dump_all();
 
@@ -217,13 +377,6 @@ static void __init setup_bootmem(void)
 
 void __init setup_arch(char **cmdline_p)
 {
-#if defined(CONFIG_HVC_RISCV_SBI)
-	if (likely(early_console == NULL)) {
-		early_console = &riscv_sbi_early_console_dev;
-		register_console(early_console);
-	}
-#endif
-
 #ifdef CONFIG_CMDLINE_BOOL
 #ifdef CONFIG_CMDLINE_OVERRIDE
 	strlcpy(boot_command_line, builtin_cmdline, COMMAND_LINE_SIZE);
@@ -239,6 +392,15 @@ void __init setup_arch(char **cmdline_p)
 	*cmdline_p = boot_command_line;
 
 	parse_early_param();
+	sbi_init();
+
+#if defined(CONFIG_HVC_RISCV_SBI)
+	/* An "earlycon" UART beats a trap into the firmware per character */
+	if (likely(early_console == NULL) && !console_drivers) {
+		early_console = &riscv_sbi_early_console_dev;
+		register_console(early_console);
+	}
+#endif
 
 	init_mm.start_code = (unsigned long) _stext;
 	init_mm.end_code   = (unsigned long) _etext;
@@ -248,6 +410,8 @@ void __init setup_arch(char **cmdline_p)
 	setup_bootmem();
 	paging_init();
 	unflatten_device_tree();
+	bootmem_init();
+	request_memory_resources();
 
 #ifdef CONFIG_SMP
 	setup_smp();
@@ -258,6 +422,7 @@ void __init setup_arch(char **cmdline_p)
 #endif
 
 	riscv_fill_hwcap();
+	apply_boot_alternatives();
 }
 
 static int __init riscv_device_init(void)
@@ -265,3 +430,23 @@ static int __init riscv_device_init(void)
 	return of_platform_populate(NULL, of_default_bus_match_table, NULL, NULL);
 }
 subsys_initcall_sync(riscv_device_init);
+
+static DEFINE_PER_CPU(struct cpu, cpu_devices);
+
+/* Instead of GENERIC_CPU_DEVICES, to say which CPUs can be taken down */
+static int __init topology_init(void)
+{
+	int i;
+
+	for_each_possible_cpu(i) {
+		struct cpu *cpu = &per_cpu(cpu_devices, i);
+
+#ifdef CONFIG_HOTPLUG_CPU
+		cpu->hotpluggable = cpu_ops->cpu_stop != NULL;
+#endif
+		register_cpu(cpu, i);
+	}
+
+	return 0;
+}
+subsys_initcall(topology_init);
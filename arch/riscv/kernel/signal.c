@@ -23,12 +23,14 @@
 #include <linux/uaccess.h>
 #include <linux/syscalls.h>
 #include <linux/tracehook.h>
+#include <linux/uprobes.h>
 #include <linux/linkage.h>
 
 #include <asm/ucontext.h>
 #include <asm/vdso.h>
 #include <asm/switch_to.h>
 #include <asm/csr.h>
+#include <asm/vector.h>
 
 #define DEBUG_SIG 0
 
@@ -47,6 +49,26 @@ static long restore_d_state(struct pt_regs *regs,
 	return err;
 }
 
+/* What sigreturn does with UC_FP_INITIAL: as for exec, see flush_thread() */
+static void reset_d_state(struct pt_regs *regs)
+{
+	preempt_disable();
+	memset(&current->thread.fstate, 0, sizeof(current->thread.fstate));
+	current->thread.fstate_lazy = true;
+	regs->sstatus = (regs->sstatus & ~SR_FS) | SR_FS_OFF;
+	preempt_enable();
+}
+
+/*
+ * FS is only initial from exec until the first FP instruction: until then
+ * there is nothing to save.  It can turn off under us, with the zeroed
+ * fstate to be loaded lazily, which says the same, so look once.
+ */
+static bool sigframe_has_fp(struct pt_regs *regs)
+{
+	return (regs->sstatus & SR_FS) != SR_FS_INITIAL;
+}
+
 static long save_d_state(struct pt_regs *regs,
 	struct __riscv_d_ext_state __user *state)
 {
@@ -54,29 +76,118 @@ static long save_d_state(struct pt_regs *regs,
 	return __copy_to_user(state, &current->thread.fstate, sizeof(*state));
 }
 
-static long restore_sigcontext(struct pt_regs *regs,
-	struct sigcontext __user *sc)
+/* The vector context in a signal frame, including its header */
+static size_t riscv_v_sc_size(void)
+{
+	return sizeof(struct __riscv_ctx_hdr) +
+	       sizeof(struct __riscv_v_ext_state) + riscv_v_vsize;
+}
+
+static bool sigframe_has_v(void)
+{
+	return has_vector() && current->thread.vstate.datap;
+}
+
+static long save_v_state(struct pt_regs *regs,
+	struct __riscv_ctx_hdr __user *hdr)
 {
+	struct __riscv_v_ext_state *vstate = &current->thread.vstate;
+	struct __riscv_v_ext_state __user *state = (void __user *)(hdr + 1);
+	void __user *datap = state + 1;
 	long err;
-	size_t i;
-	/* sc_regs is structured the same as the start of pt_regs */
-	err = __copy_from_user(regs, &sc->sc_regs, sizeof(sc->sc_regs));
+
+	riscv_v_vstate_save(current, regs);
+	err = __put_user(RISCV_V_MAGIC, &hdr->magic);
+	err |= __put_user(riscv_v_sc_size(), &hdr->size);
+	err |= __copy_to_user(state, vstate,
+			      offsetof(struct __riscv_v_ext_state, datap));
+	err |= __put_user((__force void *)datap, &state->datap);
+	err |= __copy_to_user(datap, vstate->datap, riscv_v_vsize);
+	return err;
+}
+
+/* The registers always follow the CSRs, wherever datap says they are */
+static long restore_v_state(struct pt_regs *regs,
+	struct __riscv_ctx_hdr __user *hdr)
+{
+	struct __riscv_v_ext_state *vstate = &current->thread.vstate;
+	struct __riscv_v_ext_state __user *state = (void __user *)(hdr + 1);
+	long err;
+
+	err = riscv_v_thread_alloc(current);
 	if (unlikely(err))
 		return err;
-	/* Restore the floating-point state. */
-	err = restore_d_state(regs, &sc->sc_fpregs.d);
+
+	/*
+	 * All of it is overwritten, so the live registers can simply be
+	 * dropped: the next vector instruction reloads them from vstate.
+	 */
+	regs->sstatus &= ~SR_VS;
+	if (copy_from_user(vstate, state,
+			   offsetof(struct __riscv_v_ext_state, vlenb)) ||
+	    copy_from_user(vstate->datap, state + 1, riscv_v_vsize))
+		return -EFAULT;
+	return 0;
+}
+
+/* The extension contexts run on past the end of the sigcontext */
+static long restore_ext_state(struct pt_regs *regs,
+	struct sigcontext __user *sc)
+{
+	struct __riscv_ctx_hdr __user *hdr = &sc->sc_extdesc.hdr;
+	bool seen_v = false;
+	u32 reserved, magic, size;
+	long err;
+
+	err = __get_user(reserved, &sc->sc_extdesc.reserved);
 	if (unlikely(err))
 		return err;
-	/* We support no other extension state at this time. */
-	for (i = 0; i < ARRAY_SIZE(sc->sc_fpregs.q.reserved); i++) {
-		u32 value;
-		err = __get_user(value, &sc->sc_fpregs.q.reserved[i]);
+	if (reserved != 0)
+		return -EINVAL;
+
+	for (;;) {
+		err = get_user(magic, &hdr->magic);
+		err |= get_user(size, &hdr->size);
 		if (unlikely(err))
+			return err;
+
+		switch (magic) {
+		case END_MAGIC:
+			return size == END_HDR_SIZE ? 0 : -EINVAL;
+		case RISCV_V_MAGIC:
+			if (!has_vector() || seen_v || size != riscv_v_sc_size())
+				return -EINVAL;
+			err = restore_v_state(regs, hdr);
+			if (unlikely(err))
+				return err;
+			seen_v = true;
 			break;
-		if (value != 0)
+		default:
 			return -EINVAL;
+		}
+
+		hdr = (void __user *)hdr + size;
 	}
-	return err;
+}
+
+static long restore_sigcontext(struct pt_regs *regs,
+	struct sigcontext __user *sc, unsigned long uc_flags)
+{
+	long err;
+	/* sc_regs is structured the same as the start of pt_regs */
+	err = __copy_from_user(regs, &sc->sc_regs, sizeof(sc->sc_regs));
+	if (unlikely(err))
+		return err;
+	/* Restore the floating-point state, unless there was none. */
+	if (uc_flags & UC_FP_INITIAL) {
+		reset_d_state(regs);
+	} else {
+		err = restore_d_state(regs, &sc->sc_fpregs.d);
+		if (unlikely(err))
+			return err;
+	}
+	/* Restore the vector state, if there is any. */
+	return restore_ext_state(regs, sc);
 }
 
 SYSCALL_DEFINE0(rt_sigreturn)
@@ -84,6 +195,7 @@ SYSCALL_DEFINE0(rt_sigreturn)
 	struct pt_regs *regs = current_pt_regs();
 	struct rt_sigframe __user *frame;
 	struct task_struct *task;
+	unsigned long uc_flags;
 	sigset_t set;
 
 	/* Always make any pending restarted system calls return -EINTR */
@@ -94,12 +206,13 @@ SYSCALL_DEFINE0(rt_sigreturn)
 	if (!access_ok(VERIFY_READ, frame, sizeof(*frame)))
 		goto badframe;
 
-	if (__copy_from_user(&set, &frame->uc.uc_sigmask, sizeof(set)))
+	if (__copy_from_user(&set, &frame->uc.uc_sigmask, sizeof(set)) ||
+	    __get_user(uc_flags, &frame->uc.uc_flags))
 		goto badframe;
 
 	set_current_blocked(&set);
 
-	if (restore_sigcontext(regs, &frame->uc.uc_mcontext))
+	if (restore_sigcontext(regs, &frame->uc.uc_mcontext, uc_flags))
 		goto badframe;
 
 	if (restore_altstack(&frame->uc.uc_stack))
@@ -120,18 +233,24 @@ SYSCALL_DEFINE0(rt_sigreturn)
 }
 
 static long setup_sigcontext(struct rt_sigframe __user *frame,
-	struct pt_regs *regs)
+	struct pt_regs *regs, bool has_fp)
 {
 	struct sigcontext __user *sc = &frame->uc.uc_mcontext;
+	struct __riscv_ctx_hdr __user *hdr = &sc->sc_extdesc.hdr;
 	long err;
-	size_t i;
 	/* sc_regs is structured the same as the start of pt_regs */
 	err = __copy_to_user(&sc->sc_regs, regs, sizeof(sc->sc_regs));
-	/* Save the floating-point state. */
-	err |= save_d_state(regs, &sc->sc_fpregs.d);
-	/* We support no other extension state at this time. */
-	for (i = 0; i < ARRAY_SIZE(sc->sc_fpregs.q.reserved); i++)
-		err |= __put_user(0, &sc->sc_fpregs.q.reserved[i]);
+	/* Save the floating-point state, if there is any. */
+	if (has_fp)
+		err |= save_d_state(regs, &sc->sc_fpregs.d);
+	/* Save the vector state, then terminate the extension contexts. */
+	err |= __put_user(0, &sc->sc_extdesc.reserved);
+	if (sigframe_has_v()) {
+		err |= save_v_state(regs, hdr);
+		hdr = (void __user *)hdr + riscv_v_sc_size();
+	}
+	err |= __put_user(END_MAGIC, &hdr->magic);
+	err |= __put_user(END_HDR_SIZE, &hdr->size);
 	return err;
 }
 
@@ -163,19 +282,25 @@ static int setup_rt_frame(struct ksignal *ksig, sigset_t *set,
 	struct pt_regs *regs)
 {
 	struct rt_sigframe __user *frame;
+	size_t framesize = sizeof(*frame);
+	bool has_fp = sigframe_has_fp(regs);
 	long err = 0;
 
-	frame = get_sigframe(ksig, regs, sizeof(*frame));
-	if (!access_ok(VERIFY_WRITE, frame, sizeof(*frame)))
+	/* The vector context and its END header follow the frame */
+	if (sigframe_has_v())
+		framesize += riscv_v_sc_size() + sizeof(struct __riscv_ctx_hdr);
+
+	frame = get_sigframe(ksig, regs, framesize);
+	if (!access_ok(VERIFY_WRITE, frame, framesize))
 		return -EFAULT;
 
 	err |= copy_siginfo_to_user(&frame->info, &ksig->info);
 
 	/* Create the ucontext. */
-	err |= __put_user(0, &frame->uc.uc_flags);
+	err |= __put_user(has_fp ? 0 : UC_FP_INITIAL, &frame->uc.uc_flags);
 	err |= __put_user(NULL, &frame->uc.uc_link);
 	err |= __save_altstack(&frame->uc.uc_stack, regs->sp);
-	err |= setup_sigcontext(frame, regs);
+	err |= setup_sigcontext(frame, regs, has_fp);
 	err |= __copy_to_user(&frame->uc.uc_sigmask, set, sizeof(*set));
 	if (err)
 		return -EFAULT;
@@ -281,6 +406,9 @@ static void do_signal(struct pt_regs *regs)
 asmlinkage void do_notify_resume(struct pt_regs *regs,
 	unsigned long thread_info_flags)
 {
+	if (thread_info_flags & _TIF_UPROBE)
+		uprobe_notify_resume(regs);
+
 	/* Handle pending signal delivery */
 	if (thread_info_flags & _TIF_SIGPENDING)
 		do_signal(regs);
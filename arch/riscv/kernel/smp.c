@@ -19,28 +19,114 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/clockchips.h>
+#include <linux/cpu.h>
+#include <linux/delay.h>
 #include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/irq_work.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/of_address.h>
+#include <linux/seq_file.h>
 #include <linux/smp.h>
 #include <linux/sched.h>
 
 #include <asm/sbi.h>
+#include <asm/smp.h>
 #include <asm/tlbflush.h>
 #include <asm/cacheflush.h>
 
-/* A collection of single bit ipi messages.  */
-static struct {
-	unsigned long bits ____cacheline_aligned;
-} ipi_data[NR_CPUS] __cacheline_aligned;
+unsigned long __cpuid_to_hartid_map[NR_CPUS] = {
+	[0 ... NR_CPUS-1] = INVALID_HARTID
+};
+EXPORT_SYMBOL_GPL(__cpuid_to_hartid_map);
+
+int riscv_hartid_to_cpuid(unsigned long hartid)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (cpuid_to_hartid_map(cpu) == hartid)
+			return cpu;
+
+	return -ENOENT;
+}
+EXPORT_SYMBOL_GPL(riscv_hartid_to_cpuid);
+
+unsigned long riscv_cpuid_to_hartid_mask(const struct cpumask *in)
+{
+	unsigned long hmask = 0;
+	int cpu;
+
+	for_each_cpu(cpu, in) {
+		unsigned long hartid = cpuid_to_hartid_map(cpu);
+
+		if (!WARN_ON_ONCE(hartid >= BITS_PER_LONG))
+			hmask |= 1UL << hartid;
+	}
+
+	return hmask;
+}
+
+/* Lets of_get_cpu_node() find a CPU from the hart ID in its "reg" */
+bool arch_match_cpu_phys_id(int cpu, u64 phys_id)
+{
+	return phys_id == cpuid_to_hartid_map(cpu);
+}
 
 enum ipi_message_type {
 	IPI_RESCHEDULE,
 	IPI_CALL_FUNC,
+	IPI_CALL_FUNC_SINGLE,
+	IPI_CPU_STOP,
+	IPI_IRQ_WORK,
+	IPI_TIMER,
 	IPI_MAX
 };
 
+static const char * const ipi_names[IPI_MAX] = {
+	[IPI_RESCHEDULE]	= "Rescheduling interrupts",
+	[IPI_CALL_FUNC]		= "Function call interrupts",
+	[IPI_CALL_FUNC_SINGLE]	= "Single function call interrupts",
+	[IPI_CPU_STOP]		= "CPU stop interrupts",
+	[IPI_IRQ_WORK]		= "IRQ work interrupts",
+	[IPI_TIMER]		= "Timer broadcast interrupts",
+};
+
+/*
+ * A collection of single bit ipi messages, plus a count of how many of
+ * each type this hart has handled.  The counters are only ever written by
+ * the owning hart, so they live on their own cache line.
+ */
+static struct {
+	unsigned long bits ____cacheline_aligned;
+	unsigned long stats[IPI_MAX] ____cacheline_aligned;
+} ipi_data[NR_CPUS] __cacheline_aligned;
+
+/*
+ * Supervisor software interrupt registers, one 32-bit word per hart.
+ * Writing 1 raises SSIP on that hart directly, so when the platform
+ * provides them we don't need to trap into the SBI to send an IPI.  The
+ * receiving hart clears SSIP itself in handle_ipi().
+ */
+static u32 __iomem *sswi_base;
+static u32 sswi_nr_harts;
+
+static void ipi_stop(void)
+{
+	set_cpu_online(smp_processor_id(), false);
+	local_irq_disable();
+
+	while (1)
+		wait_for_interrupt();
+}
+
 irqreturn_t handle_ipi(void)
 {
-	unsigned long *pending_ipis = &ipi_data[smp_processor_id()].bits;
+	unsigned int cpu = smp_processor_id();
+	unsigned long *pending_ipis = &ipi_data[cpu].bits;
+	unsigned long *stats = ipi_data[cpu].stats;
 
 	/* Clear pending IPI */
 	csr_clear(sip, SIE_SSIE);
@@ -55,11 +141,37 @@ irqreturn_t handle_ipi(void)
 		if (ops == 0)
 			return IRQ_HANDLED;
 
-		if (ops & (1 << IPI_RESCHEDULE))
+		if (ops & (1 << IPI_RESCHEDULE)) {
+			stats[IPI_RESCHEDULE]++;
 			scheduler_ipi();
+		}
 
-		if (ops & (1 << IPI_CALL_FUNC))
+		if (ops & (1 << IPI_CALL_FUNC)) {
+			stats[IPI_CALL_FUNC]++;
 			generic_smp_call_function_interrupt();
+		}
+
+		if (ops & (1 << IPI_CALL_FUNC_SINGLE)) {
+			stats[IPI_CALL_FUNC_SINGLE]++;
+			generic_smp_call_function_single_interrupt();
+		}
+
+		if (ops & (1 << IPI_CPU_STOP)) {
+			stats[IPI_CPU_STOP]++;
+			ipi_stop();
+		}
+
+		if (ops & (1 << IPI_IRQ_WORK)) {
+			stats[IPI_IRQ_WORK]++;
+			irq_work_run();
+		}
+
+#ifdef CONFIG_GENERIC_CLOCKEVENTS_BROADCAST
+		if (ops & (1 << IPI_TIMER)) {
+			stats[IPI_TIMER]++;
+			tick_receive_broadcast();
+		}
+#endif
 
 		BUG_ON((ops >> IPI_MAX) != 0);
 
@@ -80,7 +192,57 @@ send_ipi_message(const struct cpumask *to_whom, enum ipi_message_type operation)
 		set_bit(operation, &ipi_data[i].bits);
 
 	mb();
-	sbi_send_ipi(cpumask_bits(to_whom));
+	if (sswi_base) {
+		for_each_cpu(i, to_whom) {
+			unsigned long hartid = cpuid_to_hartid_map(i);
+
+			if (WARN_ON_ONCE(hartid >= sswi_nr_harts))
+				continue;
+			writel_relaxed(1, sswi_base + hartid);
+		}
+		return;
+	}
+
+	sbi_send_ipi(to_whom);
+}
+
+void __init riscv_ipi_init(void)
+{
+	struct device_node *np;
+	struct resource res;
+
+	np = of_find_compatible_node(NULL, NULL, "riscv,aclint-sswi");
+	if (!np)
+		return;
+
+	if (of_address_to_resource(np, 0, &res))
+		goto out;
+
+	sswi_base = ioremap(res.start, resource_size(&res));
+	if (!sswi_base) {
+		pr_warn("%pOF: unable to map SSWI registers, using SBI IPIs\n",
+			np);
+		goto out;
+	}
+	sswi_nr_harts = resource_size(&res) / sizeof(u32);
+
+	pr_info("%pOF: delivering IPIs directly to %u harts\n", np,
+		sswi_nr_harts);
+out:
+	of_node_put(np);
+}
+
+void show_ipi_stats(struct seq_file *p, int prec)
+{
+	unsigned int cpu, i;
+
+	for (i = 0; i < IPI_MAX; i++) {
+		seq_printf(p, "%*s%u:%s", prec - 1, "IPI", i,
+			   prec >= 4 ? " " : "");
+		for_each_online_cpu(cpu)
+			seq_printf(p, "%10lu ", ipi_data[cpu].stats[i]);
+		seq_printf(p, " %s\n", ipi_names[i]);
+	}
 }
 
 void arch_send_call_function_ipi_mask(struct cpumask *mask)
@@ -90,18 +252,46 @@ void arch_send_call_function_ipi_mask(struct cpumask *mask)
 
 void arch_send_call_function_single_ipi(int cpu)
 {
-	send_ipi_message(cpumask_of(cpu), IPI_CALL_FUNC);
+	send_ipi_message(cpumask_of(cpu), IPI_CALL_FUNC_SINGLE);
 }
 
-static void ipi_stop(void *unused)
+#ifdef CONFIG_IRQ_WORK
+void arch_irq_work_raise(void)
 {
-	while (1)
-		wait_for_interrupt();
+	send_ipi_message(cpumask_of(smp_processor_id()), IPI_IRQ_WORK);
+}
+#endif
+
+#ifdef CONFIG_GENERIC_CLOCKEVENTS_BROADCAST
+void tick_broadcast(const struct cpumask *mask)
+{
+	send_ipi_message(mask, IPI_TIMER);
 }
+#endif
 
 void smp_send_stop(void)
 {
-	on_each_cpu(ipi_stop, NULL, 1);
+	unsigned long timeout;
+
+	if (num_online_cpus() > 1) {
+		cpumask_t mask;
+
+		cpumask_copy(&mask, cpu_online_mask);
+		cpumask_clear_cpu(smp_processor_id(), &mask);
+
+		if (system_state <= SYSTEM_RUNNING)
+			pr_crit("SMP: stopping secondary CPUs\n");
+		send_ipi_message(&mask, IPI_CPU_STOP);
+	}
+
+	/* Wait up to one second for other CPUs to stop */
+	timeout = USEC_PER_SEC;
+	while (num_online_cpus() > 1 && timeout--)
+		udelay(1);
+
+	if (num_online_cpus() > 1)
+		pr_warn("SMP: failed to stop secondary CPUs %*pbl\n",
+			cpumask_pr_args(cpu_online_mask));
 }
 
 void smp_send_reschedule(int cpu)
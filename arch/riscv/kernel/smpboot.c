@@ -28,74 +28,204 @@
 #include <linux/delay.h>
 #include <linux/err.h>
 #include <linux/irq.h>
+#include <linux/math64.h>
 #include <linux/of.h>
 #include <linux/sched/task_stack.h>
+#include <asm/cpu_ops.h>
+#include <asm/delay.h>
 #include <asm/irq.h>
 #include <asm/mmu_context.h>
+#include <asm/numa.h>
 #include <asm/tlbflush.h>
 #include <asm/sections.h>
 #include <asm/sbi.h>
-
-void *__cpu_up_stack_pointer[NR_CPUS];
-void *__cpu_up_task_pointer[NR_CPUS];
+#include <asm/timex.h>
+#include <asm/topology.h>
 
 void __init smp_prepare_boot_cpu(void)
 {
+	/* The per-CPU areas have just been set up */
+	set_my_cpu_offset(per_cpu_offset(smp_processor_id()));
+}
+
+/*
+ * The secondaries already let into the kernel by release_secondaries(),
+ * and for the bring-up trace, when each was released and how long its
+ * __cpu_up() took.
+ */
+static struct cpumask cpus_released;
+static unsigned long release_time[NR_CPUS];
+static unsigned long online_cycles[NR_CPUS];
+
+/*
+ * Starting a hart, through the firmware in particular, is slow next to
+ * what it does once it is in: get every secondary to the point where it
+ * only waits for its task in head.S now, all at once, so that __cpu_up()
+ * is left with just the part the core serializes.
+ */
+static void __init release_secondaries(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		int ret;
+
+		if (cpu == smp_processor_id())
+			continue;
+
+		release_time[cpu] = get_cycles();
+		ret = cpu_ops->cpu_start(cpu);
+		if (ret) {
+			pr_err("CPU%u: failed to start hart %lu: %d\n", cpu,
+			       cpuid_to_hartid_map(cpu), ret);
+			continue;
+		}
+		cpumask_set_cpu(cpu, &cpus_released);
+	}
 }
 
 void __init smp_prepare_cpus(unsigned int max_cpus)
 {
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		numa_store_cpu_info(cpu);
+
+	/* All from the DT: no need to wait for each hart to come up */
+	init_cpu_topology();
+	for_each_possible_cpu(cpu)
+		store_cpu_topology(cpu);
+
+	riscv_ipi_init();
+
+	release_secondaries();
 }
 
+/*
+ * The boot hart is CPU 0 and the others are numbered in the order the
+ * device tree lists them, so that the per-CPU areas stay dense however
+ * sparse the hart IDs are.
+ */
 void __init setup_smp(void)
 {
 	struct device_node *dn = NULL;
-	int hart, im_okay_therefore_i_am = 0;
+	int hart, cpuid = 1;
+	bool found_boot_cpu = false;
+
+	cpu_set_ops();
+
+	cpuid_to_hartid_map(0) = boot_cpu_hartid;
 
 	while ((dn = of_find_node_by_type(dn, "cpu"))) {
 		hart = riscv_of_processor_hart(dn);
-		if (hart >= 0) {
-			set_cpu_possible(hart, true);
-			set_cpu_present(hart, true);
-			if (hart == smp_processor_id()) {
-				BUG_ON(im_okay_therefore_i_am);
-				im_okay_therefore_i_am = 1;
-			}
+		if (hart < 0)
+			continue;
+
+		if (hart == boot_cpu_hartid) {
+			BUG_ON(found_boot_cpu);
+			found_boot_cpu = true;
+			early_map_cpu_to_node(0, of_node_to_nid(dn));
+			continue;
 		}
+
+		if (cpuid >= NR_CPUS) {
+			pr_warn("Ignoring hart %d: only %d CPUs are supported\n",
+				hart, NR_CPUS);
+			continue;
+		}
+
+		cpuid_to_hartid_map(cpuid) = hart;
+		early_map_cpu_to_node(cpuid, of_node_to_nid(dn));
+		cpuid++;
 	}
 
-	BUG_ON(!im_okay_therefore_i_am);
+	BUG_ON(!found_boot_cpu);
+
+	for (cpuid = 0; cpuid < NR_CPUS; cpuid++) {
+		if (cpuid_to_hartid_map(cpuid) == INVALID_HARTID)
+			continue;
+		set_cpu_possible(cpuid, true);
+		set_cpu_present(cpuid, true);
+	}
 }
 
 int __cpu_up(unsigned int cpu, struct task_struct *tidle)
 {
+	unsigned long start;
+	int ret;
+
 	tidle->thread_info.cpu = cpu;
+	tidle->thread_info.percpu_offset = per_cpu_offset(cpu);
 
-	/*
-	 * On RISC-V systems, all harts boot on their own accord.  Our _start
-	 * selects the first hart to boot the kernel and causes the remainder
-	 * of the harts to spin in a loop waiting for their stack pointer to be
-	 * setup by that main hart.  Writing __cpu_up_stack_pointer signals to
-	 * the spinning harts that they can continue the boot process.
-	 */
+	/* Released at boot, or after being taken down by CPU hotplug */
+	if (!cpumask_test_and_clear_cpu(cpu, &cpus_released)) {
+		ret = cpu_ops->cpu_start(cpu);
+		if (ret) {
+			pr_err("CPU%u: failed to start hart %lu: %d\n", cpu,
+			       cpuid_to_hartid_map(cpu), ret);
+			return ret;
+		}
+	}
+
+	start = get_cycles();
+
+	/* Filling the mailbox signals the waiting hart it can continue */
 	smp_mb();
-	__cpu_up_stack_pointer[cpu] = task_stack_page(tidle) + THREAD_SIZE;
-	__cpu_up_task_pointer[cpu] = tidle;
+	WRITE_ONCE(__cpu_up_stack_pointer[cpu],
+		   task_stack_page(tidle) + THREAD_SIZE);
+	WRITE_ONCE(__cpu_up_task_pointer[cpu], tidle);
 
 	while (!cpu_online(cpu))
 		cpu_relax();
 
+	if (system_state < SYSTEM_RUNNING)
+		online_cycles[cpu] = get_cycles() - start;
+
 	return 0;
 }
 
+static unsigned long __init cycles_to_us(unsigned long cycles)
+{
+	return div_u64((u64)cycles * USEC_PER_SEC, riscv_timebase);
+}
+
+/*
+ * The bring-up trace: how long each hart took to get into the kernel
+ * once released, which overlaps across harts, and then to come online
+ * once handed its task, which doesn't.  Boot with dyndbg to see each
+ * hart's.
+ */
 void __init smp_cpus_done(unsigned int max_cpus)
 {
+	unsigned long ready_max = 0, online_sum = 0;
+	unsigned int cpu, n = 0;
+
+	for_each_online_cpu(cpu) {
+		unsigned long ready;
+
+		if (cpu == smp_processor_id())
+			continue;
+
+		ready = READ_ONCE(__cpu_up_ready_time[cpu]) - release_time[cpu];
+		pr_debug("CPU%u: hart %lu ready after %lu us, online in %lu us\n",
+			 cpu, cpuid_to_hartid_map(cpu), cycles_to_us(ready),
+			 cycles_to_us(online_cycles[cpu]));
+
+		ready_max = max(ready_max, ready);
+		online_sum += online_cycles[cpu];
+		n++;
+	}
+
+	if (n)
+		pr_info("SMP: %u harts ready within %lu us, then %lu us each to come online\n",
+			n, cycles_to_us(ready_max),
+			cycles_to_us(online_sum / n));
 }
 
 /*
  * C entry point for a secondary processor.
  */
-asmlinkage void __init smp_callin(void)
+asmlinkage void smp_callin(void)
 {
 	struct mm_struct *mm = &init_mm;
 
@@ -104,7 +234,6 @@ asmlinkage void __init smp_callin(void)
 	current->active_mm = mm;
 
 	trap_init();
-	init_clockevent();
 	notify_cpu_starting(smp_processor_id());
 	set_cpu_online(smp_processor_id(), 1);
 	local_flush_tlb_all();
@@ -19,17 +19,26 @@
 #include <linux/sched/task_stack.h>
 #include <linux/stacktrace.h>
 
+#include <asm/stacktrace.h>
+
 #ifdef CONFIG_FRAME_POINTER
 
-struct stackframe {
-	unsigned long fp;
-	unsigned long ra;
-};
+/*
+ * Every frame record has to be inside the stack, above the last one and
+ * aligned.  Frames only ever move up the stack, so the walk terminates,
+ * and the bounds are worked out once rather than per frame.
+ */
+static inline bool fp_is_valid(unsigned long fp, unsigned long low,
+			       unsigned long high)
+{
+	return fp >= low + sizeof(struct stackframe) && fp <= high &&
+	       !(fp & 0x7);
+}
 
-static void notrace walk_stackframe(struct task_struct *task,
+void notrace walk_stackframe(struct task_struct *task,
 	struct pt_regs *regs, bool (*fn)(unsigned long, void *), void *arg)
 {
-	unsigned long fp, sp, pc;
+	unsigned long fp, sp, pc, high;
 
 	if (regs) {
 		fp = GET_FP(regs);
@@ -46,30 +55,37 @@ static void notrace walk_stackframe(struct task_struct *task,
 		sp = task->thread.sp;
 		pc = task->thread.ra;
 	}
+	high = ALIGN(sp, THREAD_SIZE);
 
 	for (;;) {
-		unsigned long low, high;
 		struct stackframe *frame;
 
 		if (unlikely(!__kernel_text_address(pc) || fn(pc, arg)))
 			break;
 
-		/* Validate frame pointer */
-		low = sp + sizeof(struct stackframe);
-		high = ALIGN(sp, THREAD_SIZE);
-		if (unlikely(fp < low || fp > high || fp & 0x7))
+		if (unlikely(!fp_is_valid(fp, sp, high)))
 			break;
 		/* Unwind stack frame */
 		frame = (struct stackframe *)fp - 1;
 		sp = fp;
-		fp = frame->fp;
-		pc = frame->ra - 0x4;
+		if (regs && regs->sepc == pc &&
+		    fp_is_valid(frame->ra, sp, high)) {
+			/*
+			 * A leaf function only saves fp, in the slot ra
+			 * would have: the caller is still in the ra register.
+			 */
+			fp = frame->ra;
+			pc = regs->ra - 0x4;
+		} else {
+			fp = frame->fp;
+			pc = frame->ra - 0x4;
+		}
 	}
 }
 
 #else /* !CONFIG_FRAME_POINTER */
 
-static void notrace walk_stackframe(struct task_struct *task,
+void notrace walk_stackframe(struct task_struct *task,
 	struct pt_regs *regs, bool (*fn)(unsigned long, void *), void *arg)
 {
 	unsigned long sp, pc;
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/init.h>
+#include <linux/syscalls.h>
+#include <linux/uaccess.h>
+#include <asm/hwprobe.h>
+#include <asm/syscalls.h>
+#include <asm/vdso.h>
+#include <asm/vector.h>
+
+static const struct {
+	unsigned int ext;
+	u64 bit;
+} hwprobe_exts[] = {
+	{ RISCV_ISA_EXT_ZBB,	RISCV_HWPROBE_EXT_ZBB },
+	{ RISCV_ISA_EXT_ZBC,	RISCV_HWPROBE_EXT_ZBC },
+	{ RISCV_ISA_EXT_ZBKB,	RISCV_HWPROBE_EXT_ZBKB },
+	{ RISCV_ISA_EXT_ZBKC,	RISCV_HWPROBE_EXT_ZBKC },
+	{ RISCV_ISA_EXT_ZKND,	RISCV_HWPROBE_EXT_ZKND },
+	{ RISCV_ISA_EXT_ZKNE,	RISCV_HWPROBE_EXT_ZKNE },
+	{ RISCV_ISA_EXT_ZKNH,	RISCV_HWPROBE_EXT_ZKNH },
+	{ RISCV_ISA_EXT_ZACAS,	RISCV_HWPROBE_EXT_ZACAS },
+};
+
+/* The extensions all of cpus have, from each hart's riscv,isa */
+static u64 hwprobe_isa_ext0(const struct cpumask *cpus)
+{
+	u64 missing = 0, pair = 0;
+	unsigned int i;
+	int cpu;
+
+	/* Threads only get V state when every hart has V */
+	if (has_vector())
+		pair |= RISCV_HWPROBE_IMA_V;
+	pair |= RISCV_HWPROBE_IMA_FD | RISCV_HWPROBE_IMA_C;
+	for (i = 0; i < ARRAY_SIZE(hwprobe_exts); i++)
+		pair |= hwprobe_exts[i].bit;
+
+	for_each_cpu(cpu, cpus) {
+		const struct riscv_isainfo *info = &hart_isa[cpu];
+
+		if ((info->hwcap & (COMPAT_HWCAP_ISA_F | COMPAT_HWCAP_ISA_D)) !=
+		    (COMPAT_HWCAP_ISA_F | COMPAT_HWCAP_ISA_D))
+			missing |= RISCV_HWPROBE_IMA_FD;
+		if (!(info->hwcap & COMPAT_HWCAP_ISA_C))
+			missing |= RISCV_HWPROBE_IMA_C;
+		if (!(info->hwcap & COMPAT_HWCAP_ISA_V))
+			missing |= RISCV_HWPROBE_IMA_V;
+		for (i = 0; i < ARRAY_SIZE(hwprobe_exts); i++)
+			if (!test_bit(hwprobe_exts[i].ext, info->isa))
+				missing |= hwprobe_exts[i].bit;
+	}
+
+	return pair & ~missing;
+}
+
+static void hwprobe_one_pair(struct riscv_hwprobe *pair,
+			     const struct cpumask *cpus)
+{
+	switch (pair->key) {
+	case RISCV_HWPROBE_KEY_BASE_BEHAVIOR:
+		pair->value = RISCV_HWPROBE_BASE_BEHAVIOR_IMA;
+		break;
+
+	case RISCV_HWPROBE_KEY_IMA_EXT_0:
+		pair->value = hwprobe_isa_ext0(cpus);
+		break;
+
+	/* The probe in cpufeature.c is made once, for every hart */
+	case RISCV_HWPROBE_KEY_CPUPERF_0:
+		pair->value = riscv_fast_misaligned_access ?
+			      RISCV_HWPROBE_MISALIGNED_FAST :
+			      RISCV_HWPROBE_MISALIGNED_SLOW;
+		break;
+
+	case RISCV_HWPROBE_KEY_VLENB:
+		pair->value = has_vector() ? riscv_v_vsize / 32 : 0;
+		break;
+
+	default:
+		pair->key = -1;
+		pair->value = 0;
+		break;
+	}
+}
+
+/*
+ * No CPUs given means every online one.  Otherwise cpus_user is a
+ * cpu_set_t of cpu_count bytes, of which the online CPUs are looked at;
+ * asking about none of those is an error.  No flags are defined yet.
+ */
+SYSCALL_DEFINE5(riscv_hwprobe, struct riscv_hwprobe __user *, pairs,
+	size_t, pair_count, size_t, cpu_count,
+	unsigned long __user *, cpus_user, unsigned int, flags)
+{
+	cpumask_t cpus;
+	size_t i;
+
+	if (flags)
+		return -EINVAL;
+
+	if (!cpu_count) {
+		cpumask_copy(&cpus, cpu_online_mask);
+	} else {
+		cpumask_clear(&cpus);
+		if (cpu_count > cpumask_size())
+			cpu_count = cpumask_size();
+		if (copy_from_user(&cpus, cpus_user, cpu_count))
+			return -EFAULT;
+		cpumask_and(&cpus, &cpus, cpu_online_mask);
+		if (cpumask_empty(&cpus))
+			return -EINVAL;
+	}
+
+	for (i = 0; i < pair_count; i++, pairs++) {
+		struct riscv_hwprobe pair;
+
+		if (get_user(pair.key, &pairs->key))
+			return -EFAULT;
+		hwprobe_one_pair(&pair, &cpus);
+		if (put_user(pair.key, &pairs->key) ||
+		    put_user(pair.value, &pairs->value))
+			return -EFAULT;
+	}
+
+	return 0;
+}
+
+/*
+ * Every key for every CPU, for the vDSO to answer from without a trap.
+ * The misaligned access probe is an early_initcall and the harts are all
+ * up by now; one coming online afterwards is one of the same set.
+ */
+static int __init hwprobe_vdso_init(void)
+{
+	struct riscv_hwprobe pair;
+	int key;
+
+	for (key = 0; key <= RISCV_HWPROBE_MAX_KEY; key++) {
+		pair.key = key;
+		hwprobe_one_pair(&pair, cpu_online_mask);
+		vdso_data->hwprobe[key] = pair.value;
+	}
+
+	smp_wmb();
+	WRITE_ONCE(vdso_data->hwprobe_ready, 1);
+	return 0;
+}
+arch_initcall_sync(hwprobe_vdso_init);
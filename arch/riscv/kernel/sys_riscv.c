@@ -14,7 +14,9 @@
  */
 
 #include <linux/syscalls.h>
+#include <asm/cacheflush.h>
 #include <asm/cmpxchg.h>
+#include <asm/syscalls.h>
 #include <asm/unistd.h>
 
 static long riscv_sys_mmap(unsigned long addr, unsigned long len,
@@ -47,3 +49,20 @@ SYSCALL_DEFINE6(mmap2, unsigned long, addr, unsigned long, len,
 	return riscv_sys_mmap(addr, len, prot, flags, fd, offset, 12);
 }
 #endif /* !CONFIG_64BIT */
+
+/*
+ * Make the code the caller wrote visible to its instruction fetches, on
+ * any hart its threads (or with SYS_RISCV_FLUSH_ICACHE_LOCAL, only the
+ * calling thread) may run.  start and end are for a future ranged
+ * flush; the whole instruction cache is flushed for now.
+ */
+SYSCALL_DEFINE3(riscv_flush_icache, uintptr_t, start, uintptr_t, end,
+	uintptr_t, flags)
+{
+	if (unlikely(flags & ~SYS_RISCV_FLUSH_ICACHE_ALL))
+		return -EINVAL;
+
+	flush_icache_mm(current->mm, flags & SYS_RISCV_FLUSH_ICACHE_LOCAL);
+
+	return 0;
+}
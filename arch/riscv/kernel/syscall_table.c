@@ -14,7 +14,7 @@
 
 #include <linux/linkage.h>
 #include <linux/syscalls.h>
-#include <asm-generic/syscalls.h>
+#include <asm/syscalls.h>
 
 #undef __SYSCALL
 #define __SYSCALL(nr, call)	[nr] = (call),
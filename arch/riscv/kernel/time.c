@@ -20,11 +20,13 @@
 #include <linux/timer_riscv.h>
 #endif
 
+#include <asm/paravirt.h>
 #include <asm/sbi.h>
 
 unsigned long riscv_timebase;
 
 DECLARE_PER_CPU(struct clock_event_device, riscv_clock_event);
+DECLARE_PER_CPU(struct clock_event_device, riscv_clock_event_direct);
 
 void riscv_timer_interrupt(void)
 {
@@ -33,13 +35,18 @@ void riscv_timer_interrupt(void)
 	 * FIXME: This needs to be cleaned up along with the rest of the IRQ
 	 * handling cleanup.  See irq.c for more details.
 	 */
-	struct clock_event_device *evdev = this_cpu_ptr(&riscv_clock_event);
+	struct clock_event_device *evdev =
+		this_cpu_ptr(&riscv_clock_event_direct);
+
+	/* The direct clockevent, when present, displaces the SBI one */
+	if (clockevent_state_detached(evdev))
+		evdev = this_cpu_ptr(&riscv_clock_event);
 
 	evdev->event_handler(evdev);
 #endif
 }
 
-void __init init_clockevent(void)
+static void __init init_clockevent(void)
 {
 	timer_probe();
 	csr_set(sie, SIE_STIE);
@@ -58,4 +65,6 @@ void __init time_init(void)
 	lpj_fine = riscv_timebase / HZ;
 
 	init_clockevent();
+
+	pv_time_init();
 }
@@ -0,0 +1,355 @@
+/*
+ * CPU topology from the device tree
+ * Based on arch/arm64/kernel/topology.c
+ *
+ * Copyright (C) 2011,2013,2014 Linaro Limited.
+ * Copyright (C) 2017 SiFive
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/arch_topology.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/export.h>
+#include <linux/init.h>
+#include <linux/of.h>
+#include <linux/sched/topology.h>
+#include <linux/topology.h>
+
+#include <asm/topology.h>
+
+struct cpu_topology cpu_topology[NR_CPUS];
+EXPORT_SYMBOL_GPL(cpu_topology);
+
+/* The outermost cache node each hart's caches lead to, if any */
+static struct device_node *llc_node[NR_CPUS];
+
+static int __init get_cpu_for_node(struct device_node *node)
+{
+	struct device_node *cpu_node;
+	int cpu;
+
+	cpu_node = of_parse_phandle(node, "cpu", 0);
+	if (!cpu_node)
+		return -1;
+
+	for_each_possible_cpu(cpu) {
+		if (of_get_cpu_node(cpu, NULL) == cpu_node) {
+			of_node_put(cpu_node);
+			return cpu;
+		}
+	}
+
+	pr_crit("Unable to find CPU node for %pOF\n", cpu_node);
+
+	of_node_put(cpu_node);
+	return -1;
+}
+
+static int __init parse_core(struct device_node *core, int cluster_id,
+			     int core_id)
+{
+	char name[10];
+	bool leaf = true;
+	int i = 0;
+	int cpu;
+	struct device_node *t;
+
+	do {
+		snprintf(name, sizeof(name), "thread%d", i);
+		t = of_get_child_by_name(core, name);
+		if (t) {
+			leaf = false;
+			cpu = get_cpu_for_node(t);
+			if (cpu >= 0) {
+				cpu_topology[cpu].cluster_id = cluster_id;
+				cpu_topology[cpu].core_id = core_id;
+				cpu_topology[cpu].thread_id = i;
+			} else {
+				pr_err("%pOF: Can't get CPU for thread\n", t);
+				of_node_put(t);
+				return -EINVAL;
+			}
+			of_node_put(t);
+		}
+		i++;
+	} while (t);
+
+	cpu = get_cpu_for_node(core);
+	if (cpu >= 0) {
+		if (!leaf) {
+			pr_err("%pOF: Core has both threads and CPU\n", core);
+			return -EINVAL;
+		}
+
+		cpu_topology[cpu].cluster_id = cluster_id;
+		cpu_topology[cpu].core_id = core_id;
+	} else if (leaf) {
+		pr_err("%pOF: Can't get CPU for leaf core\n", core);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Nested clusters are flattened: the scheduler only gets to see the
+ * innermost ones, through core_sibling.
+ */
+static int __init parse_cluster(struct device_node *cluster, int depth)
+{
+	char name[10];
+	bool leaf = true;
+	bool has_cores = false;
+	struct device_node *c;
+	static int cluster_id __initdata;
+	int core_id = 0;
+	int i, ret;
+
+	i = 0;
+	do {
+		snprintf(name, sizeof(name), "cluster%d", i);
+		c = of_get_child_by_name(cluster, name);
+		if (c) {
+			leaf = false;
+			ret = parse_cluster(c, depth + 1);
+			of_node_put(c);
+			if (ret != 0)
+				return ret;
+		}
+		i++;
+	} while (c);
+
+	i = 0;
+	do {
+		snprintf(name, sizeof(name), "core%d", i);
+		c = of_get_child_by_name(cluster, name);
+		if (c) {
+			has_cores = true;
+
+			if (depth == 0) {
+				pr_err("%pOF: cpu-map children should be clusters\n",
+				       c);
+				of_node_put(c);
+				return -EINVAL;
+			}
+
+			if (leaf) {
+				ret = parse_core(c, cluster_id, core_id++);
+			} else {
+				pr_err("%pOF: Non-leaf cluster with core %s\n",
+				       cluster, name);
+				ret = -EINVAL;
+			}
+
+			of_node_put(c);
+			if (ret != 0)
+				return ret;
+		}
+		i++;
+	} while (c);
+
+	if (leaf && !has_cores)
+		pr_warn("%pOF: empty cluster\n", cluster);
+
+	if (leaf)
+		cluster_id++;
+
+	return 0;
+}
+
+static int __init parse_dt_topology(void)
+{
+	struct device_node *cn, *map;
+	int ret = 0;
+	int cpu;
+
+	cn = of_find_node_by_path("/cpus");
+	if (!cn) {
+		pr_err("No CPU information found in DT\n");
+		return 0;
+	}
+
+	/* cpu-map is a root cluster with restricted subnodes */
+	map = of_get_child_by_name(cn, "cpu-map");
+	if (!map)
+		goto out;
+
+	ret = parse_cluster(map, 0);
+	if (ret != 0)
+		goto out_map;
+
+	/* setup_smp() only marks the harts described in the DT possible */
+	for_each_possible_cpu(cpu)
+		if (cpu_topology[cpu].cluster_id == -1)
+			ret = -EINVAL;
+
+out_map:
+	of_node_put(map);
+out:
+	of_node_put(cn);
+	return ret;
+}
+
+/*
+ * Follow next-level-cache from the hart's node, as the cacheinfo code
+ * does, and keep the last cache node found.  cacheinfo itself is only
+ * populated once the sched domains have been built.
+ */
+static void __init parse_dt_llc(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct device_node *np = of_get_cpu_node(cpu, NULL);
+		struct device_node *next;
+
+		while (np && (next = of_find_next_cache_node(np))) {
+			of_node_put(np);
+			np = next;
+		}
+
+		llc_node[cpu] = np;
+	}
+}
+
+/*
+ * The MC sched domain spans the harts sharing the last level cache,
+ * provided that is inside the cluster and covers the SMT siblings;
+ * otherwise it is the cluster.  Neither may cross a NUMA node, which is
+ * the level above.
+ */
+const struct cpumask *cpu_coregroup_mask(int cpu)
+{
+	struct cpu_topology *cpu_topo = &cpu_topology[cpu];
+#ifdef CONFIG_NUMA
+	const struct cpumask *node_mask = cpumask_of_node(cpu_to_node(cpu));
+#else
+	const struct cpumask *node_mask = cpu_possible_mask;
+#endif
+
+	if (cpumask_subset(&cpu_topo->llc_sibling, &cpu_topo->core_sibling) &&
+	    cpumask_subset(&cpu_topo->thread_sibling, &cpu_topo->llc_sibling) &&
+	    cpumask_subset(&cpu_topo->llc_sibling, node_mask))
+		return &cpu_topo->llc_sibling;
+
+	if (cpumask_subset(&cpu_topo->core_sibling, node_mask))
+		return &cpu_topo->core_sibling;
+
+	return node_mask;
+}
+
+static void update_siblings_masks(unsigned int cpuid)
+{
+	struct cpu_topology *cpu_topo, *cpuid_topo = &cpu_topology[cpuid];
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		cpu_topo = &cpu_topology[cpu];
+
+		if (llc_node[cpuid] && llc_node[cpu] == llc_node[cpuid]) {
+			cpumask_set_cpu(cpuid, &cpu_topo->llc_sibling);
+			cpumask_set_cpu(cpu, &cpuid_topo->llc_sibling);
+		}
+
+		if (cpuid_topo->cluster_id != cpu_topo->cluster_id)
+			continue;
+
+		cpumask_set_cpu(cpuid, &cpu_topo->core_sibling);
+		if (cpu != cpuid)
+			cpumask_set_cpu(cpu, &cpuid_topo->core_sibling);
+
+		if (cpuid_topo->core_id != cpu_topo->core_id)
+			continue;
+
+		cpumask_set_cpu(cpuid, &cpu_topo->thread_sibling);
+		if (cpu != cpuid)
+			cpumask_set_cpu(cpu, &cpuid_topo->thread_sibling);
+	}
+}
+
+/*
+ * Called on each hart as it comes up.  There is no RISC-V equivalent of
+ * MPIDR to fall back on without a cpu-map: every hart is then its own
+ * core, all in one cluster.
+ */
+void store_cpu_topology(unsigned int cpuid)
+{
+	struct cpu_topology *cpuid_topo = &cpu_topology[cpuid];
+
+	if (cpuid_topo->cluster_id == -1) {
+		cpuid_topo->thread_id = -1;
+		cpuid_topo->core_id = cpuid;
+		cpuid_topo->cluster_id = 0;
+	}
+
+	pr_debug("CPU%u: cluster %d core %d thread %d\n", cpuid,
+		 cpuid_topo->cluster_id, cpuid_topo->core_id,
+		 cpuid_topo->thread_id);
+
+	update_siblings_masks(cpuid);
+}
+
+/*
+ * The relative capacities come from capacity-dmips-mhz in each hart's
+ * node; unless they are given for all of them, every hart keeps the
+ * default.  The cpufreq policy notifier in drivers/base/arch_topology.c
+ * then weighs them by each hart's highest frequency.
+ */
+static void __init parse_dt_capacity(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct device_node *np = of_get_cpu_node(cpu, NULL);
+		bool found;
+
+		/* A missing node counts as a missing property */
+		found = topology_parse_cpu_capacity(np, cpu);
+		of_node_put(np);
+		if (!found)
+			return;
+	}
+
+	topology_normalize_cpu_scale();
+}
+
+static void __init reset_cpu_topology(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct cpu_topology *cpu_topo = &cpu_topology[cpu];
+
+		cpu_topo->thread_id = -1;
+		cpu_topo->core_id = 0;
+		cpu_topo->cluster_id = -1;
+
+		cpumask_clear(&cpu_topo->core_sibling);
+		cpumask_set_cpu(cpu, &cpu_topo->core_sibling);
+		cpumask_clear(&cpu_topo->thread_sibling);
+		cpumask_set_cpu(cpu, &cpu_topo->thread_sibling);
+		cpumask_clear(&cpu_topo->llc_sibling);
+		cpumask_set_cpu(cpu, &cpu_topo->llc_sibling);
+	}
+}
+
+void __init init_cpu_topology(void)
+{
+	reset_cpu_topology();
+
+	/* Don't use partial information if the cpu-map is broken */
+	if (of_have_populated_dt() && parse_dt_topology())
+		reset_cpu_topology();
+
+	parse_dt_llc();
+	parse_dt_capacity();
+}
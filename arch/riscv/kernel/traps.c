@@ -22,10 +22,15 @@
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/irq.h>
+#include <linux/kprobes.h>
+#include <linux/uprobes.h>
+#include <linux/percpu.h>
 
 #include <asm/processor.h>
 #include <asm/ptrace.h>
 #include <asm/csr.h>
+#include <asm/switch_to.h>
+#include <asm/vector.h>
 
 int show_unhandled_signals = 1;
 
@@ -78,6 +83,9 @@ static inline void do_trap_siginfo(int signo, int code,
 void do_trap(struct pt_regs *regs, int signo, int code,
 	unsigned long addr, struct task_struct *tsk)
 {
+	/* Lets uprobes notice that a single-stepped instruction trapped */
+	tsk->thread.bad_cause = regs->scause;
+
 	if (show_unhandled_signals && unhandled_signal(tsk, signo)
 	    && printk_ratelimit()) {
 		pr_info("%s[%d]: unhandled signal %d code 0x%x at 0x" REG_FMT,
@@ -113,14 +121,8 @@ DO_ERROR_INFO(do_trap_insn_misaligned,
 	SIGBUS, BUS_ADRALN, "instruction address misaligned");
 DO_ERROR_INFO(do_trap_insn_fault,
 	SIGSEGV, SEGV_ACCERR, "instruction access fault");
-DO_ERROR_INFO(do_trap_insn_illegal,
-	SIGILL, ILL_ILLOPC, "illegal instruction");
-DO_ERROR_INFO(do_trap_load_misaligned,
-	SIGBUS, BUS_ADRALN, "load address misaligned");
 DO_ERROR_INFO(do_trap_load_fault,
 	SIGSEGV, SEGV_ACCERR, "load access fault");
-DO_ERROR_INFO(do_trap_store_misaligned,
-	SIGBUS, BUS_ADRALN, "store (or AMO) address misaligned");
 DO_ERROR_INFO(do_trap_store_fault,
 	SIGSEGV, SEGV_ACCERR, "store (or AMO) access fault");
 DO_ERROR_INFO(do_trap_ecall_u,
@@ -130,8 +132,62 @@ DO_ERROR_INFO(do_trap_ecall_s,
 DO_ERROR_INFO(do_trap_ecall_m,
 	SIGILL, ILL_ILLTRP, "environment call from M-mode");
 
+/* The first FP instruction after a lazy switch-in, see __switch_to_aux */
+static bool fstate_lazy_restore(struct pt_regs *regs)
+{
+	struct task_struct *tsk = current;
+	bool restored = false;
+
+	preempt_disable();
+	if (tsk->thread.fstate_lazy &&
+	    (regs->sstatus & SR_FS) == SR_FS_OFF) {
+		tsk->thread.fstate_lazy = false;
+		__fstate_restore(tsk);
+		__fstate_clean(regs);
+		restored = true;
+	}
+	preempt_enable();
+
+	return restored;
+}
+
+asmlinkage void do_trap_insn_illegal(struct pt_regs *regs)
+{
+	/* Retry the instruction with the vector or FP registers loaded */
+	if (user_mode(regs) &&
+	    (riscv_v_first_use_handler(regs) || fstate_lazy_restore(regs)))
+		return;
+
+	do_trap_error(regs, SIGILL, ILL_ILLOPC, regs->sepc,
+		      "Oops - illegal instruction");
+}
+
+#ifdef CONFIG_GENERIC_BUG
+/* BUG() is a plain ebreak, which the assembler may have compressed */
+static unsigned long get_break_insn_length(unsigned long pc)
+{
+	u16 insn;
+
+	if (probe_kernel_address((u16 __user *)pc, insn))
+		return 0;
+	return GET_INSN_LENGTH(insn);
+}
+#endif /* CONFIG_GENERIC_BUG */
+
 asmlinkage void do_trap_break(struct pt_regs *regs)
 {
+#ifdef CONFIG_KPROBES
+	if (kprobe_single_step_handler(regs))
+		return;
+	if (kprobe_breakpoint_handler(regs))
+		return;
+#endif
+#ifdef CONFIG_UPROBES
+	if (uprobe_single_step_handler(regs))
+		return;
+	if (uprobe_breakpoint_handler(regs))
+		return;
+#endif
 #ifdef CONFIG_GENERIC_BUG
 	if (!user_mode(regs)) {
 		enum bug_trap_type type;
@@ -141,7 +197,7 @@ asmlinkage void do_trap_break(struct pt_regs *regs)
 		case BUG_TRAP_TYPE_NONE:
 			break;
 		case BUG_TRAP_TYPE_WARN:
-			regs->sepc += sizeof(bug_insn_t);
+			regs->sepc += get_break_insn_length(regs->sepc);
 			return;
 		case BUG_TRAP_TYPE_BUG:
 			die(regs, "Kernel BUG");
@@ -160,13 +216,47 @@ int is_valid_bugaddr(unsigned long pc)
 
 	if (pc < PAGE_OFFSET)
 		return 0;
+	if (get_break_insn_length(pc) == 2) {
+		u16 insn16;
+
+		if (probe_kernel_address((u16 __user *)pc, insn16))
+			return 0;
+		return (insn16 == __BUG_INSN_16);
+	}
 	if (probe_kernel_address((bug_insn_t __user *)pc, insn))
 		return 0;
-	return (insn == __BUG_INSN);
+	return (insn == __BUG_INSN_32);
 }
 #endif /* CONFIG_GENERIC_BUG */
 
-void __init trap_init(void)
+#ifdef CONFIG_VMAP_STACK
+DEFINE_PER_CPU(unsigned long [OVERFLOW_STACK_SIZE / sizeof(long)],
+	       overflow_stack) __aligned(16);
+
+/* Entered from handle_exception on the overflow stack; there's no return */
+asmlinkage void handle_bad_stack(struct pt_regs *regs)
+{
+	unsigned long tsk_stk = (unsigned long)current->stack;
+	unsigned long ovf_stk = (unsigned long)this_cpu_ptr(overflow_stack);
+
+	console_verbose();
+
+	pr_emerg("Insufficient stack space to handle exception!\n");
+	pr_emerg("Task stack:     [0x%016lx..0x%016lx]\n",
+		 tsk_stk, tsk_stk + THREAD_SIZE);
+	pr_emerg("Overflow stack: [0x%016lx..0x%016lx]\n",
+		 ovf_stk, ovf_stk + OVERFLOW_STACK_SIZE);
+
+	show_regs(regs);
+	panic("Kernel stack overflow");
+
+	for (;;)
+		wait_for_interrupt();
+}
+#endif
+
+/* Also run by each secondary CPU, whenever it comes online */
+void trap_init(void)
 {
 	/*
 	 * Set sup0 scratch register to 0, indicating to exception vector
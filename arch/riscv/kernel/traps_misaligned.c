@@ -0,0 +1,374 @@
+/*
+ * Emulation of misaligned loads and stores
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/atomic.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/perf_event.h>
+#include <linux/preempt.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include <asm/bug.h>
+#include <asm/csr.h>
+#include <asm/ptrace.h>
+#include <asm/switch_to.h>
+
+/* Major opcodes, bits [6:0] */
+#define OPC_LOAD	0x03
+#define OPC_LOAD_FP	0x07
+#define OPC_STORE	0x23
+#define OPC_STORE_FP	0x27
+
+struct misaligned_access {
+	unsigned int len;	/* Of the instruction */
+	unsigned int width;	/* Of the access, in bytes */
+	unsigned int reg;	/* Destination or source register */
+	bool store;
+	bool fp;
+	bool sign_extend;
+};
+
+static atomic_long_t misaligned_user;
+static atomic_long_t misaligned_kernel;
+static atomic_long_t misaligned_unhandled;
+
+static int decode_insn32(u32 insn, struct misaligned_access *a)
+{
+	unsigned int funct3 = (insn >> 12) & 0x7;
+
+	a->len = 4;
+	a->sign_extend = false;
+
+	switch (insn & 0x7f) {
+	case OPC_LOAD:
+		/* lh, lw, ld, lhu, lwu; byte accesses never trap */
+		a->store = false;
+		a->fp = false;
+		a->reg = (insn >> 7) & 0x1f;
+		a->width = 1 << (funct3 & 0x3);
+		a->sign_extend = !(funct3 & 0x4);
+		if (funct3 == 0x7 || a->width == 1)
+			return -EINVAL;
+		break;
+	case OPC_STORE:
+		/* sh, sw, sd */
+		a->store = true;
+		a->fp = false;
+		a->reg = (insn >> 20) & 0x1f;
+		a->width = 1 << funct3;
+		if (funct3 == 0 || funct3 > 3)
+			return -EINVAL;
+		break;
+	case OPC_LOAD_FP:
+	case OPC_STORE_FP:
+		/* flw, fld, fsw, fsd */
+		a->store = (insn & 0x7f) == OPC_STORE_FP;
+		a->fp = true;
+		a->reg = a->store ? (insn >> 20) & 0x1f : (insn >> 7) & 0x1f;
+		if (funct3 != 2 && funct3 != 3)
+			return -EINVAL;
+		a->width = 1 << funct3;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+#ifndef CONFIG_64BIT
+	if (!a->fp && a->width == 8)
+		return -EINVAL;
+#endif
+	return 0;
+}
+
+static int decode_insn16(u16 insn, struct misaligned_access *a)
+{
+	unsigned int funct3 = insn >> 13;
+	unsigned int reg;
+
+	a->len = 2;
+	a->sign_extend = true;
+
+	switch (insn & 0x3) {
+	case 0x0:
+		/* c.fld, c.lw, c.ld/c.flw, c.fsd, c.sw, c.sd/c.fsw */
+		reg = 8 + ((insn >> 2) & 0x7);
+		break;
+	case 0x2:
+		/* The same again, relative to sp */
+		if (funct3 & 0x4)
+			reg = (insn >> 2) & 0x1f;
+		else
+			reg = (insn >> 7) & 0x1f;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	a->reg = reg;
+	a->store = funct3 & 0x4;
+
+	switch (funct3 & 0x3) {
+	case 0x1:
+		a->fp = true;
+		a->width = 8;
+		break;
+	case 0x2:
+		a->fp = false;
+		a->width = 4;
+		break;
+	case 0x3:
+#ifdef CONFIG_64BIT
+		a->fp = false;
+		a->width = 8;
+#else
+		a->fp = true;
+		a->width = 4;
+#endif
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	/* c.lwsp and c.ldsp with rd = x0 are reserved */
+	if ((insn & 0x3) == 0x2 && !a->store && !a->fp && reg == 0)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int fetch_insn(struct pt_regs *regs, u32 *insn)
+{
+	unsigned long pc = regs->sepc;
+	u16 lo, hi;
+
+	/* Instructions are only 16-bit aligned with the C extension */
+	if (user_mode(regs)) {
+		if (get_user(lo, (u16 __user *)pc))
+			return -EFAULT;
+		if (GET_INSN_LENGTH(lo) == 4 &&
+		    get_user(hi, (u16 __user *)(pc + 2)))
+			return -EFAULT;
+	} else {
+		if (probe_kernel_address((u16 *)pc, lo))
+			return -EFAULT;
+		if (GET_INSN_LENGTH(lo) == 4 &&
+		    probe_kernel_address((u16 *)(pc + 2), hi))
+			return -EFAULT;
+	}
+
+	*insn = lo;
+	if (GET_INSN_LENGTH(lo) == 4)
+		*insn |= (u32)hi << 16;
+	return 0;
+}
+
+/*
+ * From the kernel the address may still be a user one, if the access
+ * came from a uaccess routine: the probe helpers handle both.
+ */
+static int misaligned_read(struct pt_regs *regs, void *dst,
+			   unsigned long addr, size_t size)
+{
+	if (user_mode(regs))
+		return copy_from_user(dst, (void __user *)addr, size) ?
+			-EFAULT : 0;
+	return probe_kernel_read(dst, (void *)addr, size);
+}
+
+static int misaligned_write(struct pt_regs *regs, unsigned long addr,
+			    const void *src, size_t size)
+{
+	if (user_mode(regs))
+		return copy_to_user((void __user *)addr, src, size) ?
+			-EFAULT : 0;
+	return probe_kernel_write((void *)addr, src, size);
+}
+
+/* pt_regs starts with sepc, so x1-x31 sit at their own index */
+static inline unsigned long *gpr(struct pt_regs *regs, unsigned int reg)
+{
+	return (unsigned long *)regs + reg;
+}
+
+/*
+ * Unless a context switch has since left them to be restored lazily, the
+ * user's FP registers are live in the hardware: spill them to the thread
+ * struct, and reload them after a change.  This is slow, but FP accesses
+ * that need emulating are rare.
+ */
+static u64 get_fpr(struct pt_regs *regs, unsigned int reg)
+{
+	u64 val;
+
+	preempt_disable();
+	if ((regs->sstatus & SR_FS) != SR_FS_OFF)
+		__fstate_save(current);
+	val = current->thread.fstate.f[reg];
+	preempt_enable();
+
+	return val;
+}
+
+static void set_fpr(struct pt_regs *regs, unsigned int reg, u64 val)
+{
+	bool live;
+
+	preempt_disable();
+	live = (regs->sstatus & SR_FS) != SR_FS_OFF;
+	if (live)
+		__fstate_save(current);
+	current->thread.fstate.f[reg] = val;
+	if (live) {
+		__fstate_restore(current);
+		regs->sstatus = (regs->sstatus & ~SR_FS) | SR_FS_DIRTY;
+	}
+	preempt_enable();
+}
+
+static int emulate_misaligned(struct pt_regs *regs, bool store)
+{
+	unsigned long addr = regs->sbadaddr;
+	struct misaligned_access a;
+	u64 val = 0;
+	u32 insn;
+	int err;
+
+	if (fetch_insn(regs, &insn))
+		return -EFAULT;
+
+	if (GET_INSN_LENGTH(insn) == 4)
+		err = decode_insn32(insn, &a);
+	else
+		err = decode_insn16(insn, &a);
+	if (err || a.store != store)
+		return -EINVAL;
+
+	/* The kernel itself never touches the FP registers */
+	if (a.fp && !user_mode(regs))
+		return -EINVAL;
+
+	perf_sw_event(PERF_COUNT_SW_ALIGNMENT_FAULTS, 1, regs, addr);
+
+	if (store) {
+		if (a.fp)
+			val = get_fpr(regs, a.reg);
+		else if (a.reg)
+			val = *gpr(regs, a.reg);
+
+		/* Little endian: the low bytes go first */
+		if (misaligned_write(regs, addr, &val, a.width))
+			return -EFAULT;
+	} else {
+		if (misaligned_read(regs, &val, addr, a.width))
+			return -EFAULT;
+
+		if (a.fp) {
+			/* Single precision values are NaN-boxed */
+			if (a.width == 4)
+				val |= 0xffffffff00000000ULL;
+			set_fpr(regs, a.reg, val);
+		} else if (a.reg) {
+			unsigned int shift = 64 - a.width * 8;
+
+			if (a.sign_extend)
+				val = (u64)((s64)(val << shift) >> shift);
+			*gpr(regs, a.reg) = val;
+		}
+	}
+
+	regs->sepc += a.len;
+	return 0;
+}
+
+static void handle_misaligned(struct pt_regs *regs, bool store,
+			      const char *str)
+{
+	int err = emulate_misaligned(regs, store);
+
+	if (!err) {
+		atomic_long_inc(user_mode(regs) ? &misaligned_user :
+						  &misaligned_kernel);
+		return;
+	}
+
+	atomic_long_inc(&misaligned_unhandled);
+
+	if (user_mode(regs)) {
+		if (err == -EFAULT)
+			do_trap(regs, SIGSEGV, SEGV_MAPERR, regs->sbadaddr,
+				current);
+		else
+			do_trap(regs, SIGBUS, BUS_ADRALN, regs->sbadaddr,
+				current);
+		return;
+	}
+
+	/* A uaccess routine faulting on the user address gets its fixup */
+	if (!fixup_exception(regs))
+		die(regs, str);
+}
+
+asmlinkage void do_trap_load_misaligned(struct pt_regs *regs)
+{
+	handle_misaligned(regs, false, "Oops - load address misaligned");
+}
+
+asmlinkage void do_trap_store_misaligned(struct pt_regs *regs)
+{
+	handle_misaligned(regs, true,
+			  "Oops - store (or AMO) address misaligned");
+}
+
+#ifdef CONFIG_PROC_FS
+static int alignment_proc_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "User:\t\t%lu\n", atomic_long_read(&misaligned_user));
+	seq_printf(m, "System:\t\t%lu\n",
+		   atomic_long_read(&misaligned_kernel));
+	seq_printf(m, "Unhandled:\t%lu\n",
+		   atomic_long_read(&misaligned_unhandled));
+	return 0;
+}
+
+static int alignment_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, alignment_proc_show, NULL);
+}
+
+static const struct file_operations alignment_proc_fops = {
+	.open		= alignment_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init alignment_init(void)
+{
+	struct proc_dir_entry *dir;
+
+	dir = proc_mkdir("cpu", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!proc_create("alignment", 0444, dir, &alignment_proc_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+fs_initcall(alignment_init);
+#endif /* CONFIG_PROC_FS */
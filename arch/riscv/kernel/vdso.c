@@ -21,6 +21,8 @@
 #include <linux/slab.h>
 #include <linux/binfmts.h>
 #include <linux/err.h>
+#include <linux/hrtimer.h>
+#include <linux/timekeeper_internal.h>
 
 #include <asm/vdso.h>
 
@@ -50,14 +52,18 @@ static int __init vdso_init(void)
 		return -ENOMEM;
 	}
 
+	/*
+	 * The data page sits immediately below the vDSO text so that the
+	 * vDSO can find it relative to its own ELF header.
+	 */
+	vdso_pagelist[0] = virt_to_page(vdso_data);
 	for (i = 0; i < vdso_pages; i++) {
 		struct page *pg;
 
 		pg = virt_to_page(vdso_start + (i << PAGE_SHIFT));
 		ClearPageReserved(pg);
-		vdso_pagelist[i] = pg;
+		vdso_pagelist[i + 1] = pg;
 	}
-	vdso_pagelist[i] = virt_to_page(vdso_data);
 
 	return 0;
 }
@@ -84,7 +90,7 @@ int arch_setup_additional_pages(struct linux_binprm *bprm,
 	 * install_special_mapping or the perf counter mmap tracking code
 	 * will fail to recognise it as a vDSO (since arch_vma_name fails).
 	 */
-	mm->context.vdso = (void *)vdso_base;
+	mm->context.vdso = (void *)vdso_base + PAGE_SIZE;
 
 	ret = install_special_mapping(mm, vdso_base, vdso_len,
 		(VM_READ | VM_EXEC | VM_MAYREAD | VM_MAYWRITE | VM_MAYEXEC),
@@ -100,11 +106,54 @@ int arch_setup_additional_pages(struct linux_binprm *bprm,
 
 const char *arch_vma_name(struct vm_area_struct *vma)
 {
-	if (vma->vm_mm && (vma->vm_start == (long)vma->vm_mm->context.vdso))
+	if (vma->vm_mm &&
+	    (vma->vm_start == (long)vma->vm_mm->context.vdso - PAGE_SIZE))
 		return "[vdso]";
 	return NULL;
 }
 
+/*
+ * Update the vDSO data page to keep in sync with kernel timekeeping.
+ */
+void update_vsyscall(struct timekeeper *tk)
+{
+	u32 use_syscall = !tk->tkr_mono.clock->archdata.vdso_direct;
+
+	++vdso_data->tb_seq_count;
+	smp_wmb();
+
+	vdso_data->use_syscall		= use_syscall;
+	vdso_data->xtime_coarse_sec	= tk->xtime_sec;
+	vdso_data->xtime_coarse_nsec	= tk->tkr_mono.xtime_nsec >>
+						tk->tkr_mono.shift;
+	vdso_data->wtm_clock_sec	= tk->wall_to_monotonic.tv_sec;
+	vdso_data->wtm_clock_nsec	= tk->wall_to_monotonic.tv_nsec;
+	vdso_data->hrtimer_res		= hrtimer_resolution;
+
+	if (!use_syscall) {
+		/* tkr_mono.cycle_last == tkr_raw.cycle_last */
+		vdso_data->cs_cycle_last	= tk->tkr_mono.cycle_last;
+		vdso_data->cs_mask		= tk->tkr_mono.mask;
+		vdso_data->raw_time_sec		= tk->raw_sec;
+		vdso_data->raw_time_nsec	= tk->tkr_raw.xtime_nsec;
+		vdso_data->xtime_clock_sec	= tk->xtime_sec;
+		vdso_data->xtime_clock_nsec	= tk->tkr_mono.xtime_nsec;
+		vdso_data->cs_mono_mult		= tk->tkr_mono.mult;
+		vdso_data->cs_raw_mult		= tk->tkr_raw.mult;
+		/* tkr_mono.shift == tkr_raw.shift */
+		vdso_data->cs_shift		= tk->tkr_mono.shift;
+	}
+
+	smp_wmb();
+	++vdso_data->tb_seq_count;
+}
+
+void update_vsyscall_tz(void)
+{
+	vdso_data->tz_minuteswest	= sys_tz.tz_minuteswest;
+	vdso_data->tz_dsttime		= sys_tz.tz_dsttime;
+}
+
 /*
  * Function stubs to prevent linker errors when AT_SYSINFO_EHDR is defined
  */
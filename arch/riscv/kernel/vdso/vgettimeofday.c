@@ -0,0 +1,298 @@
+/*
+ * Userspace implementations of gettimeofday() and friends
+ * Based on arch/arm/vdso/vgettimeofday.c
+ *
+ * Copyright 2015 Mentor Graphics Corporation.
+ * Copyright (C) 2017 SiFive
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2 of the
+ * License.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include <linux/compiler.h>
+#include <linux/hrtimer.h>
+#include <linux/time.h>
+#include <asm/barrier.h>
+#include <asm/page.h>
+#include <asm/timex.h>
+#include <asm/unistd.h>
+#include <asm/vdso.h>
+
+/*
+ * The data page is mapped immediately below the vDSO image, see
+ * arch_setup_additional_pages().  __ehdr_start is provided by the linker
+ * and resolves PC-relatively to the start of our own ELF header.
+ */
+extern const char __ehdr_start[] __attribute__((visibility("hidden")));
+
+static notrace const struct vdso_data *get_datapage(void)
+{
+	return (const struct vdso_data *)(__ehdr_start - PAGE_SIZE);
+}
+
+static notrace u32 vdso_read_begin(const struct vdso_data *vdata)
+{
+	u32 seq;
+
+	do {
+		seq = READ_ONCE(vdata->tb_seq_count);
+	} while (seq & 1);
+
+	smp_rmb(); /* Pairs with the second smp_wmb in update_vsyscall */
+	return seq;
+}
+
+static notrace int vdso_read_retry(const struct vdso_data *vdata, u32 start)
+{
+	smp_rmb(); /* Pairs with the first smp_wmb in update_vsyscall */
+	return READ_ONCE(vdata->tb_seq_count) != start;
+}
+
+static notrace long syscall_fallback_2(long nr, long _a0, long _a1)
+{
+	register long a0 asm("a0") = _a0;
+	register long a1 asm("a1") = _a1;
+	register long a7 asm("a7") = nr;
+
+	asm volatile(
+	"	ecall\n"
+	: "+r" (a0)
+	: "r" (a1), "r" (a7)
+	: "memory");
+
+	return a0;
+}
+
+static notrace long syscall_fallback_3(long nr, long _a0, long _a1, long _a2)
+{
+	register long a0 asm("a0") = _a0;
+	register long a1 asm("a1") = _a1;
+	register long a2 asm("a2") = _a2;
+	register long a7 asm("a7") = nr;
+
+	asm volatile(
+	"	ecall\n"
+	: "+r" (a0)
+	: "r" (a1), "r" (a2), "r" (a7)
+	: "memory");
+
+	return a0;
+}
+
+/* Nanoseconds since the last update, scaled up by cs_shift */
+static notrace u64 get_clock_shifted_nsec(u64 cycle_last, u64 mult, u64 mask)
+{
+	u64 cycle_delta = (get_cycles64() - cycle_last) & mask;
+
+	return cycle_delta * mult;
+}
+
+static notrace void timespec_set(struct timespec *ts, u64 sec, u64 nsec)
+{
+	while (nsec >= NSEC_PER_SEC) {
+		nsec -= NSEC_PER_SEC;
+		sec++;
+	}
+
+	ts->tv_sec = sec;
+	ts->tv_nsec = nsec;
+}
+
+static notrace int do_realtime_coarse(const struct vdso_data *vdata,
+				      struct timespec *ts)
+{
+	u64 sec, nsec;
+	u32 seq;
+
+	do {
+		seq = vdso_read_begin(vdata);
+		sec = vdata->xtime_coarse_sec;
+		nsec = vdata->xtime_coarse_nsec;
+	} while (vdso_read_retry(vdata, seq));
+
+	timespec_set(ts, sec, nsec);
+	return 0;
+}
+
+static notrace int do_monotonic_coarse(const struct vdso_data *vdata,
+				       struct timespec *ts)
+{
+	u64 sec, nsec;
+	u32 seq;
+
+	do {
+		seq = vdso_read_begin(vdata);
+		sec = vdata->xtime_coarse_sec + vdata->wtm_clock_sec;
+		nsec = vdata->xtime_coarse_nsec + vdata->wtm_clock_nsec;
+	} while (vdso_read_retry(vdata, seq));
+
+	timespec_set(ts, sec, nsec);
+	return 0;
+}
+
+static notrace int do_realtime(const struct vdso_data *vdata,
+			       struct timespec *ts)
+{
+	u64 sec, nsec;
+	u32 seq;
+
+	do {
+		seq = vdso_read_begin(vdata);
+		if (vdata->use_syscall)
+			return -1;
+
+		sec = vdata->xtime_clock_sec;
+		nsec = vdata->xtime_clock_nsec;
+		nsec += get_clock_shifted_nsec(vdata->cs_cycle_last,
+					       vdata->cs_mono_mult,
+					       vdata->cs_mask);
+		nsec >>= vdata->cs_shift;
+	} while (vdso_read_retry(vdata, seq));
+
+	timespec_set(ts, sec, nsec);
+	return 0;
+}
+
+static notrace int do_monotonic(const struct vdso_data *vdata,
+				struct timespec *ts)
+{
+	u64 sec, nsec;
+	u32 seq;
+
+	do {
+		seq = vdso_read_begin(vdata);
+		if (vdata->use_syscall)
+			return -1;
+
+		sec = vdata->xtime_clock_sec + vdata->wtm_clock_sec;
+		nsec = vdata->xtime_clock_nsec;
+		nsec += get_clock_shifted_nsec(vdata->cs_cycle_last,
+					       vdata->cs_mono_mult,
+					       vdata->cs_mask);
+		nsec >>= vdata->cs_shift;
+		nsec += vdata->wtm_clock_nsec;
+	} while (vdso_read_retry(vdata, seq));
+
+	timespec_set(ts, sec, nsec);
+	return 0;
+}
+
+static notrace int do_monotonic_raw(const struct vdso_data *vdata,
+				    struct timespec *ts)
+{
+	u64 sec, nsec;
+	u32 seq;
+
+	do {
+		seq = vdso_read_begin(vdata);
+		if (vdata->use_syscall)
+			return -1;
+
+		sec = vdata->raw_time_sec;
+		nsec = vdata->raw_time_nsec;
+		nsec += get_clock_shifted_nsec(vdata->cs_cycle_last,
+					       vdata->cs_raw_mult,
+					       vdata->cs_mask);
+		nsec >>= vdata->cs_shift;
+	} while (vdso_read_retry(vdata, seq));
+
+	timespec_set(ts, sec, nsec);
+	return 0;
+}
+
+notrace int __vdso_clock_gettime(clockid_t clkid, struct timespec *ts)
+{
+	const struct vdso_data *vdata = get_datapage();
+	int ret = -1;
+
+	switch (clkid) {
+	case CLOCK_REALTIME:
+		ret = do_realtime(vdata, ts);
+		break;
+	case CLOCK_MONOTONIC:
+		ret = do_monotonic(vdata, ts);
+		break;
+	case CLOCK_MONOTONIC_RAW:
+		ret = do_monotonic_raw(vdata, ts);
+		break;
+	case CLOCK_REALTIME_COARSE:
+		ret = do_realtime_coarse(vdata, ts);
+		break;
+	case CLOCK_MONOTONIC_COARSE:
+		ret = do_monotonic_coarse(vdata, ts);
+		break;
+	default:
+		break;
+	}
+
+	if (ret)
+		ret = syscall_fallback_2(__NR_clock_gettime, clkid, (long)ts);
+
+	return ret;
+}
+
+notrace int __vdso_gettimeofday(struct timeval *tv, struct timezone *tz)
+{
+	const struct vdso_data *vdata = get_datapage();
+	struct timespec ts;
+
+	if (tv) {
+		if (do_realtime(vdata, &ts))
+			return syscall_fallback_2(__NR_gettimeofday,
+						  (long)tv, (long)tz);
+		tv->tv_sec = ts.tv_sec;
+		tv->tv_usec = ts.tv_nsec / 1000;
+	}
+
+	if (tz) {
+		tz->tz_minuteswest = vdata->tz_minuteswest;
+		tz->tz_dsttime = vdata->tz_dsttime;
+	}
+
+	return 0;
+}
+
+notrace int __vdso_clock_getres(clockid_t clkid, struct timespec *res)
+{
+	const struct vdso_data *vdata = get_datapage();
+	long nsec;
+
+	switch (clkid) {
+	case CLOCK_REALTIME:
+	case CLOCK_MONOTONIC:
+	case CLOCK_MONOTONIC_RAW:
+		nsec = READ_ONCE(vdata->hrtimer_res);
+		break;
+	case CLOCK_REALTIME_COARSE:
+	case CLOCK_MONOTONIC_COARSE:
+		nsec = LOW_RES_NSEC;
+		break;
+	default:
+		return syscall_fallback_2(__NR_clock_getres, clkid, (long)res);
+	}
+
+	if (res) {
+		res->tv_sec = 0;
+		res->tv_nsec = nsec;
+	}
+
+	return 0;
+}
+
+/*
+ * There is no user-readable hart ID on RISC-V, so the vDSO entry point only
+ * exists to give libc a stable symbol; it still has to ask the kernel.
+ */
+notrace int __vdso_getcpu(unsigned int *cpu, unsigned int *node,
+			  void *unused)
+{
+	return syscall_fallback_3(__NR_getcpu, (long)cpu, (long)node,
+				  (long)unused);
+}
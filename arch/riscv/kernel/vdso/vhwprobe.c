@@ -0,0 +1,79 @@
+/*
+ * Userspace implementation of riscv_hwprobe
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2 of the
+ * License.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include <linux/compiler.h>
+#include <asm/barrier.h>
+#include <asm/hwprobe.h>
+#include <asm/page.h>
+#include <asm/unistd.h>
+#include <asm/vdso.h>
+
+/* As in vgettimeofday.c, the data page is the one below our ELF header */
+extern const char __ehdr_start[] __attribute__((visibility("hidden")));
+
+static notrace const struct vdso_data *get_datapage(void)
+{
+	return (const struct vdso_data *)(__ehdr_start - PAGE_SIZE);
+}
+
+static notrace long syscall_fallback_5(long nr, long _a0, long _a1, long _a2,
+				       long _a3, long _a4)
+{
+	register long a0 asm("a0") = _a0;
+	register long a1 asm("a1") = _a1;
+	register long a2 asm("a2") = _a2;
+	register long a3 asm("a3") = _a3;
+	register long a4 asm("a4") = _a4;
+	register long a7 asm("a7") = nr;
+
+	asm volatile(
+	"	ecall\n"
+	: "+r" (a0)
+	: "r" (a1), "r" (a2), "r" (a3), "r" (a4), "r" (a7)
+	: "memory");
+
+	return a0;
+}
+
+/*
+ * Libraries probe once for every CPU as they load, which the data page
+ * answers on its own; a set of CPUs, or flags, take the syscall.
+ */
+notrace int __vdso_riscv_hwprobe(struct riscv_hwprobe *pairs,
+				 size_t pair_count, size_t cpu_count,
+				 unsigned long *cpus, unsigned int flags)
+{
+	const struct vdso_data *vd = get_datapage();
+	size_t i;
+
+	if (flags || cpu_count || !READ_ONCE(vd->hwprobe_ready))
+		return syscall_fallback_5(__NR_riscv_hwprobe, (long)pairs,
+					  pair_count, cpu_count, (long)cpus,
+					  flags);
+
+	smp_rmb(); /* Pairs with the smp_wmb in hwprobe_vdso_init */
+	for (i = 0; i < pair_count; i++) {
+		if (pairs[i].key >= 0 &&
+		    pairs[i].key <= RISCV_HWPROBE_MAX_KEY) {
+			pairs[i].value = vd->hwprobe[pairs[i].key];
+		} else {
+			pairs[i].key = -1;
+			pairs[i].value = 0;
+		}
+	}
+
+	return 0;
+}
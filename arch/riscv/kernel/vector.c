@@ -0,0 +1,144 @@
+/*
+ * Vector extension context management
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/export.h>
+#include <linux/irqflags.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/sched/task_stack.h>
+#include <linux/slab.h>
+#include <linux/stringify.h>
+#include <linux/uaccess.h>
+
+#include <asm/bug.h>
+#include <asm/csr.h>
+#include <asm/vector.h>
+
+unsigned long riscv_v_vsize __read_mostly;
+EXPORT_SYMBOL_GPL(riscv_v_vsize);
+
+void riscv_v_setup_vsize(void)
+{
+	unsigned long vlenb;
+
+	if (!has_vector())
+		return;
+
+	csr_set(sstatus, SR_VS);
+	__asm__ __volatile__ ("csrr %0, " __stringify(CSR_VLENB)
+			      : "=r" (vlenb));
+	csr_clear(sstatus, SR_VS);
+
+	riscv_v_vsize = vlenb * 32;
+	pr_info("vector registers are %lu bits wide\n", vlenb * 8);
+}
+
+int riscv_v_thread_alloc(struct task_struct *tsk)
+{
+	struct __riscv_v_ext_state *vstate = &tsk->thread.vstate;
+
+	if (vstate->datap)
+		return 0;
+
+	vstate->datap = kzalloc(riscv_v_vsize, GFP_KERNEL);
+	if (!vstate->datap)
+		return -ENOMEM;
+
+	/* As after reset: no valid vector configuration */
+	vstate->vstart = 0;
+	vstate->vl = 0;
+	vstate->vtype = 1UL << (BITS_PER_LONG - 1);	/* vill */
+	vstate->vcsr = 0;
+	vstate->vlenb = riscv_v_vsize / 32;
+	return 0;
+}
+
+void riscv_v_thread_free(struct task_struct *tsk)
+{
+	kfree(tsk->thread.vstate.datap);
+	tsk->thread.vstate.datap = NULL;
+}
+
+/* Make thread.vstate current, leaving the registers live */
+void riscv_v_vstate_save(struct task_struct *tsk, struct pt_regs *regs)
+{
+	preempt_disable();
+	if ((regs->sstatus & SR_VS) == SR_VS_DIRTY) {
+		__vstate_save(&tsk->thread.vstate, tsk->thread.vstate.datap);
+		regs->sstatus = (regs->sstatus & ~SR_VS) | SR_VS_CLEAN;
+	}
+	preempt_enable();
+}
+
+static bool insn_is_vector(u32 insn)
+{
+	unsigned int csr = insn >> 20;
+
+	switch (insn & 0x7f) {
+	case 0x57:	/* OP-V */
+		return true;
+	case 0x07:	/* LOAD-FP and STORE-FP with a vector width */
+	case 0x27:
+		switch ((insn >> 12) & 0x7) {
+		case 0: case 5: case 6: case 7:
+			return true;
+		}
+		return false;
+	case 0x73:	/* SYSTEM: accesses to the vector CSRs */
+		if (!((insn >> 12) & 0x3))
+			return false;
+		return (csr >= CSR_VSTART && csr <= CSR_VCSR) ||
+		       (csr >= CSR_VL && csr <= CSR_VLENB);
+	}
+	return false;
+}
+
+/*
+ * An illegal instruction trap from user mode with VS off: either the
+ * first vector instruction since a switch-in, or the first one the task
+ * has ever executed, in which case its state is allocated now.
+ */
+bool riscv_v_first_use_handler(struct pt_regs *regs)
+{
+	struct task_struct *tsk = current;
+	u16 lo, hi;
+
+	if (!has_vector() || (regs->sstatus & SR_VS) != SR_VS_OFF)
+		return false;
+
+	/* We came from user mode, and may fault or sleep below */
+	local_irq_enable();
+
+	/* All vector instructions are 32 bits wide */
+	if (get_user(lo, (u16 __user *)regs->sepc) ||
+	    GET_INSN_LENGTH(lo) != 4 ||
+	    get_user(hi, (u16 __user *)(regs->sepc + 2)) ||
+	    !insn_is_vector(lo | (u32)hi << 16))
+		return false;
+
+	if (riscv_v_thread_alloc(tsk))
+		return false;
+
+	/*
+	 * Marked live first, so that a softirq using the unit meanwhile
+	 * keeps what has been loaded (see kernel_mode_fpu.c)
+	 */
+	preempt_disable();
+	regs->sstatus = (regs->sstatus & ~SR_VS) | SR_VS_CLEAN;
+	__vstate_restore(&tsk->thread.vstate, tsk->thread.vstate.datap);
+	preempt_enable();
+
+	return true;
+}
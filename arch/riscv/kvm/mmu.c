@@ -0,0 +1,539 @@
+/*
+ * Stage 2 (guest physical to host physical) translation
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/bitops.h>
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/module.h>
+#include <linux/kvm_host.h>
+
+#include <asm/csr.h>
+#include <asm/page.h>
+#include <asm/pgtable.h>
+
+/*
+ * Sv39x4 is Sv39 with two more bits of address at the root, which takes
+ * 2048 entries (16KB, aligned to its size) instead of 512.  That gives
+ * guests 41 bits of physical address space.
+ */
+#define stage2_pgd_levels	3
+#define stage2_index_bits	9
+#define stage2_pgd_xbits	2
+#define stage2_pgd_size		(PAGE_SIZE << stage2_pgd_xbits)
+#define stage2_gpa_bits		(PAGE_SHIFT + \
+				 stage2_index_bits * stage2_pgd_levels + \
+				 stage2_pgd_xbits)
+#define stage2_gpa_size		((gpa_t)(1ULL << stage2_gpa_bits))
+
+/* G-stage accesses all count as user ones, so every leaf needs U */
+#define STAGE2_PAGE_RO		(_PAGE_PRESENT | _PAGE_READ | _PAGE_EXEC | \
+				 _PAGE_USER | _PAGE_ACCESSED)
+#define STAGE2_PAGE_RW		(STAGE2_PAGE_RO | _PAGE_WRITE | _PAGE_DIRTY)
+
+static inline unsigned long stage2_pte_index(gpa_t addr, u32 level)
+{
+	unsigned long mask;
+	unsigned long shift = PAGE_SHIFT + (stage2_index_bits * level);
+
+	if (level == (stage2_pgd_levels - 1))
+		mask = (PTRS_PER_PTE << stage2_pgd_xbits) - 1;
+	else
+		mask = PTRS_PER_PTE - 1;
+
+	return (addr >> shift) & mask;
+}
+
+/* The span of guest physical addresses an entry at the level covers */
+static inline unsigned long stage2_level_size(u32 level)
+{
+	return 1UL << (PAGE_SHIFT + stage2_index_bits * level);
+}
+
+static inline pte_t *stage2_pte_next(pte_t pte)
+{
+	return (pte_t *)pfn_to_virt(__page_val_to_pfn(pte_val(pte)));
+}
+
+static inline bool stage2_pte_leaf(pte_t pte)
+{
+	return pte_val(pte) & _PAGE_LEAF;
+}
+
+static int stage2_cache_topup(struct kvm_mmu_memory_cache *pcache,
+			      int min, int max)
+{
+	void *page;
+
+	BUG_ON(max > KVM_NR_MEM_OBJS);
+	if (pcache->nobjs >= min)
+		return 0;
+	while (pcache->nobjs < max) {
+		page = (void *)__get_free_page(GFP_KERNEL | __GFP_ZERO);
+		if (!page)
+			return -ENOMEM;
+		pcache->objects[pcache->nobjs++] = page;
+	}
+
+	return 0;
+}
+
+static void stage2_cache_flush(struct kvm_mmu_memory_cache *pcache)
+{
+	while (pcache && pcache->nobjs)
+		free_page((unsigned long)pcache->objects[--pcache->nobjs]);
+}
+
+static void *stage2_cache_alloc(struct kvm_mmu_memory_cache *pcache)
+{
+	BUG_ON(!pcache || !pcache->nobjs);
+	return pcache->objects[--pcache->nobjs];
+}
+
+void kvm_riscv_stage2_cache_free(struct kvm_vcpu *vcpu)
+{
+	stage2_cache_flush(&vcpu->arch.mmu_page_cache);
+}
+
+/*
+ * Walk down to the entry for addr, either a leaf or an empty entry at the
+ * level the walk stopped.  Returns false if there is no leaf.
+ */
+static bool stage2_get_leaf_entry(struct kvm *kvm, gpa_t addr,
+				  pte_t **ptepp, u32 *ptep_level)
+{
+	pte_t *ptep;
+	u32 current_level = stage2_pgd_levels - 1;
+
+	ptep = (pte_t *)kvm->arch.pgd;
+	ptep = &ptep[stage2_pte_index(addr, current_level)];
+	while (ptep && pte_val(*ptep)) {
+		if (stage2_pte_leaf(*ptep)) {
+			*ptep_level = current_level;
+			*ptepp = ptep;
+			return true;
+		}
+
+		if (current_level) {
+			current_level--;
+			ptep = stage2_pte_next(*ptep);
+			ptep = &ptep[stage2_pte_index(addr, current_level)];
+		} else {
+			ptep = NULL;
+		}
+	}
+
+	*ptep_level = current_level;
+	*ptepp = ptep;
+	return false;
+}
+
+/* Install a 4K leaf, allocating the tables down to it from the cache */
+static int stage2_set_pte(struct kvm *kvm,
+			  struct kvm_mmu_memory_cache *pcache,
+			  gpa_t addr, const pte_t *new_pte)
+{
+	u32 current_level = stage2_pgd_levels - 1;
+	pte_t *next_ptep = (pte_t *)kvm->arch.pgd;
+	pte_t *ptep = &next_ptep[stage2_pte_index(addr, current_level)];
+	bool flush;
+
+	while (current_level) {
+		if (stage2_pte_leaf(*ptep))
+			return -EEXIST;
+
+		if (!pte_val(*ptep)) {
+			if (!pcache)
+				return -ENOMEM;
+			next_ptep = stage2_cache_alloc(pcache);
+			set_pte(ptep, pfn_pte(PFN_DOWN(__pa(next_ptep)),
+					      __pgprot(_PAGE_TABLE)));
+		} else {
+			next_ptep = stage2_pte_next(*ptep);
+		}
+
+		current_level--;
+		ptep = &next_ptep[stage2_pte_index(addr, current_level)];
+	}
+
+	flush = pte_val(*ptep) != 0;
+	set_pte(ptep, *new_pte);
+
+	/*
+	 * A leaf that replaces another may be cached anywhere the VM ran.
+	 * A new one can't be, but the local hart may have walked the
+	 * tables before we got here, so make sure it sees the update.
+	 */
+	if (flush)
+		kvm_flush_remote_tlbs(kvm);
+	else
+		__kvm_riscv_hfence_gvma_vmid_gpa(addr >> 2,
+						 READ_ONCE(kvm->arch.vmid.vmid));
+
+	return 0;
+}
+
+/*
+ * Clear the leaves in [start, start + size).  The tables stay in place
+ * until the VM goes away: they are few, and would just come back on the
+ * next fault.
+ */
+static void stage2_unmap_range(struct kvm *kvm, gpa_t start, gpa_t size)
+{
+	gpa_t addr = start, end = start + size;
+	unsigned long level_size;
+	bool flush = false;
+	pte_t *ptep;
+	u32 level;
+
+	while (addr < end) {
+		if (stage2_get_leaf_entry(kvm, addr, &ptep, &level)) {
+			set_pte(ptep, __pte(0));
+			flush = true;
+		}
+
+		level_size = stage2_level_size(level);
+		addr = (addr & ~((gpa_t)level_size - 1)) + level_size;
+
+		if (!(addr & (stage2_level_size(stage2_pgd_levels - 1) - 1)))
+			cond_resched_lock(&kvm->mmu_lock);
+	}
+
+	if (flush)
+		kvm_flush_remote_tlbs(kvm);
+}
+
+int kvm_riscv_stage2_map(struct kvm_vcpu *vcpu,
+			 struct kvm_memory_slot *memslot,
+			 gpa_t gpa, unsigned long hva, bool is_write)
+{
+	int ret;
+	kvm_pfn_t hfn;
+	bool writeable;
+	pte_t new_pte;
+	unsigned long mmu_seq;
+	gfn_t gfn = gpa >> PAGE_SHIFT;
+	struct kvm *kvm = vcpu->kvm;
+	struct kvm_mmu_memory_cache *pcache = &vcpu->arch.mmu_page_cache;
+
+	/* We need a table for each level below the root */
+	ret = stage2_cache_topup(pcache, stage2_pgd_levels - 1,
+				 KVM_NR_MEM_OBJS);
+	if (ret) {
+		kvm_err("Failed to topup stage2 cache\n");
+		return ret;
+	}
+
+	mmu_seq = kvm->mmu_notifier_seq;
+	/*
+	 * Read mmu_notifier_seq before getting the page, as on arm: if the
+	 * page is unmapped after that, the notifier bumps the count and we
+	 * retry rather than install a stale translation.  This smp_rmb()
+	 * pairs with the smp_wmb() in kvm_mmu_notifier_invalidate_*().
+	 */
+	smp_rmb();
+
+	hfn = gfn_to_pfn_prot(kvm, gfn, is_write, &writeable);
+	if (is_error_noslot_pfn(hfn))
+		return -EFAULT;
+
+	/* A write to a read-only slot is MMIO, and never gets here */
+	if (is_write && !writeable) {
+		ret = -EPERM;
+		goto out_release;
+	}
+
+	spin_lock(&kvm->mmu_lock);
+
+	if (mmu_notifier_retry(kvm, mmu_seq))
+		goto out_unlock;
+
+	if (writeable) {
+		new_pte = pfn_pte(hfn, __pgprot(STAGE2_PAGE_RW));
+		kvm_set_pfn_dirty(hfn);
+		mark_page_dirty(kvm, gfn);
+	} else {
+		new_pte = pfn_pte(hfn, __pgprot(STAGE2_PAGE_RO));
+	}
+
+	ret = stage2_set_pte(kvm, pcache, gpa, &new_pte);
+	if (ret)
+		kvm_err("Failed to map in stage2\n");
+
+out_unlock:
+	spin_unlock(&kvm->mmu_lock);
+	kvm_set_pfn_accessed(hfn);
+out_release:
+	kvm_release_pfn_clean(hfn);
+	return ret;
+}
+
+int kvm_riscv_stage2_alloc_pgd(struct kvm *kvm)
+{
+	struct page *pgd_page;
+
+	if (kvm->arch.pgd != NULL) {
+		kvm_err("kvm_arch already initialized?\n");
+		return -EINVAL;
+	}
+
+	pgd_page = alloc_pages(GFP_KERNEL | __GFP_ZERO,
+			       get_order(stage2_pgd_size));
+	if (!pgd_page)
+		return -ENOMEM;
+	kvm->arch.pgd = page_to_virt(pgd_page);
+	kvm->arch.pgd_phys = page_to_phys(pgd_page);
+
+	return 0;
+}
+
+static void stage2_free_table(pte_t *table, u32 level, unsigned long nr)
+{
+	unsigned long i;
+
+	for (i = 0; level && i < nr; i++) {
+		if (pte_val(table[i]) && !stage2_pte_leaf(table[i]))
+			stage2_free_table(stage2_pte_next(table[i]),
+					  level - 1, PTRS_PER_PTE);
+	}
+
+	free_page((unsigned long)table);
+}
+
+void kvm_riscv_stage2_free_pgd(struct kvm *kvm)
+{
+	pte_t *pgd;
+	unsigned long i;
+	u32 level = stage2_pgd_levels - 1;
+
+	spin_lock(&kvm->mmu_lock);
+	pgd = (pte_t *)kvm->arch.pgd;
+	if (pgd) {
+		stage2_unmap_range(kvm, 0UL, stage2_gpa_size);
+		kvm->arch.pgd = NULL;
+		kvm->arch.pgd_phys = 0;
+	}
+	spin_unlock(&kvm->mmu_lock);
+
+	if (!pgd)
+		return;
+
+	for (i = 0; i < (PTRS_PER_PTE << stage2_pgd_xbits); i++) {
+		if (pte_val(pgd[i]) && !stage2_pte_leaf(pgd[i]))
+			stage2_free_table(stage2_pte_next(pgd[i]),
+					  level - 1, PTRS_PER_PTE);
+	}
+	free_pages((unsigned long)pgd, get_order(stage2_pgd_size));
+}
+
+void kvm_riscv_stage2_update_hgatp(struct kvm_vcpu *vcpu)
+{
+	unsigned long hgatp = HGATP_MODE_SV39X4 << HGATP_MODE_SHIFT;
+	struct kvm_arch *k = &vcpu->kvm->arch;
+
+	hgatp |= (READ_ONCE(k->vmid.vmid) << HGATP_VMID_SHIFT) &
+		 HGATP_VMID_MASK;
+	hgatp |= (k->pgd_phys >> PAGE_SHIFT) & HGATP_PPN;
+
+	csr_write(CSR_HGATP, hgatp);
+
+	/* Without VMIDs every VM is VMID 0, and the switch needs a flush */
+	if (!kvm_riscv_stage2_vmid_bits()) {
+		__kvm_riscv_hfence_gvma_all();
+		__kvm_riscv_hfence_vvma_all();
+	}
+}
+
+int kvm_arch_create_memslot(struct kvm *kvm, struct kvm_memory_slot *slot,
+			    unsigned long npages)
+{
+	return 0;
+}
+
+int kvm_arch_prepare_memory_region(struct kvm *kvm,
+				   struct kvm_memory_slot *memslot,
+				   const struct kvm_userspace_memory_region *mem,
+				   enum kvm_mr_change change)
+{
+	if (change == KVM_MR_DELETE || change == KVM_MR_FLAGS_ONLY)
+		goto check_flags;
+
+	/* The slot has to fit in what the guest can address */
+	if ((memslot->base_gfn + memslot->npages) >
+	    (stage2_gpa_size >> PAGE_SHIFT))
+		return -EFAULT;
+
+check_flags:
+	if (mem->flags & KVM_MEM_LOG_DIRTY_PAGES)
+		return -EOPNOTSUPP;
+
+	return 0;
+}
+
+void kvm_arch_commit_memory_region(struct kvm *kvm,
+				   const struct kvm_userspace_memory_region *mem,
+				   const struct kvm_memory_slot *old,
+				   const struct kvm_memory_slot *new,
+				   enum kvm_mr_change change)
+{
+}
+
+void kvm_arch_flush_shadow_all(struct kvm *kvm)
+{
+	kvm_riscv_stage2_free_pgd(kvm);
+}
+
+void kvm_arch_flush_shadow_memslot(struct kvm *kvm,
+				   struct kvm_memory_slot *slot)
+{
+	gpa_t gpa = slot->base_gfn << PAGE_SHIFT;
+	phys_addr_t size = slot->npages << PAGE_SHIFT;
+
+	spin_lock(&kvm->mmu_lock);
+	stage2_unmap_range(kvm, gpa, size);
+	spin_unlock(&kvm->mmu_lock);
+}
+
+/*
+ * The MMU notifier hooks, which like arm's go through the memslots to
+ * find the guest physical ranges backed by [start, end) of the host's.
+ */
+static int handle_hva_to_gpa(struct kvm *kvm,
+			     unsigned long start, unsigned long end,
+			     int (*handler)(struct kvm *kvm, gpa_t gpa,
+					    u64 size, void *data),
+			     void *data)
+{
+	struct kvm_memslots *slots;
+	struct kvm_memory_slot *memslot;
+	int ret = 0;
+
+	slots = kvm_memslots(kvm);
+
+	/* we only care about the pages that the guest sees */
+	kvm_for_each_memslot(memslot, slots) {
+		unsigned long hva_start, hva_end;
+		gfn_t gpa;
+
+		hva_start = max(start, memslot->userspace_addr);
+		hva_end = min(end, memslot->userspace_addr +
+					(memslot->npages << PAGE_SHIFT));
+		if (hva_start >= hva_end)
+			continue;
+
+		gpa = hva_to_gfn_memslot(hva_start, memslot) << PAGE_SHIFT;
+		ret |= handler(kvm, gpa, (u64)(hva_end - hva_start), data);
+	}
+
+	return ret;
+}
+
+static int kvm_unmap_hva_handler(struct kvm *kvm, gpa_t gpa, u64 size,
+				 void *data)
+{
+	stage2_unmap_range(kvm, gpa, size);
+	return 0;
+}
+
+int kvm_unmap_hva(struct kvm *kvm, unsigned long hva)
+{
+	unsigned long end = hva + PAGE_SIZE;
+
+	if (!kvm->arch.pgd)
+		return 0;
+
+	handle_hva_to_gpa(kvm, hva, end, &kvm_unmap_hva_handler, NULL);
+	return 0;
+}
+
+int kvm_unmap_hva_range(struct kvm *kvm,
+			unsigned long start, unsigned long end)
+{
+	if (!kvm->arch.pgd)
+		return 0;
+
+	handle_hva_to_gpa(kvm, start, end, &kvm_unmap_hva_handler, NULL);
+	return 0;
+}
+
+/*
+ * The host page behind the guest's is being replaced (say by KSM): drop
+ * our translation and let the next fault map the new page with whatever
+ * rights it has.
+ */
+static int kvm_set_spte_handler(struct kvm *kvm, gpa_t gpa, u64 size,
+				void *data)
+{
+	WARN_ON(size != PAGE_SIZE);
+	stage2_unmap_range(kvm, gpa, size);
+	return 0;
+}
+
+void kvm_set_spte_hva(struct kvm *kvm, unsigned long hva, pte_t pte)
+{
+	unsigned long end = hva + PAGE_SIZE;
+
+	if (!kvm->arch.pgd)
+		return;
+
+	handle_hva_to_gpa(kvm, hva, end, &kvm_set_spte_handler, &pte);
+}
+
+/*
+ * Leaves are always installed with A set, so clearing it makes the next
+ * access fault in again on harts that don't update it themselves.
+ */
+static int kvm_age_hva_handler(struct kvm *kvm, gpa_t gpa, u64 size,
+			       void *data)
+{
+	pte_t *ptep;
+	u32 level;
+
+	WARN_ON(size != PAGE_SIZE);
+	if (!stage2_get_leaf_entry(kvm, gpa, &ptep, &level))
+		return 0;
+
+	return test_and_clear_bit(_PAGE_ACCESSED_OFFSET,
+				  (unsigned long *)&pte_val(*ptep));
+}
+
+static int kvm_test_age_hva_handler(struct kvm *kvm, gpa_t gpa, u64 size,
+				    void *data)
+{
+	pte_t *ptep;
+	u32 level;
+
+	WARN_ON(size != PAGE_SIZE);
+	if (!stage2_get_leaf_entry(kvm, gpa, &ptep, &level))
+		return 0;
+
+	return pte_young(*ptep);
+}
+
+int kvm_age_hva(struct kvm *kvm, unsigned long start, unsigned long end)
+{
+	if (!kvm->arch.pgd)
+		return 0;
+
+	return handle_hva_to_gpa(kvm, start, end, kvm_age_hva_handler, NULL);
+}
+
+int kvm_test_age_hva(struct kvm *kvm, unsigned long hva)
+{
+	if (!kvm->arch.pgd)
+		return 0;
+
+	return handle_hva_to_gpa(kvm, hva, hva + PAGE_SIZE,
+				 kvm_test_age_hva_handler, NULL);
+}
@@ -0,0 +1,921 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/bitops.h>
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/uaccess.h>
+#include <linux/sched/signal.h>
+#include <linux/fs.h>
+#include <linux/kvm_host.h>
+
+#include <asm/cacheflush.h>
+#include <asm/csr.h>
+#include <asm/hwcap.h>
+#include <asm/switch_to.h>
+
+#define VCPU_STAT(x) { #x, offsetof(struct kvm_vcpu, stat.x), KVM_STAT_VCPU }
+#define VM_STAT(x) { #x, offsetof(struct kvm, stat.x), KVM_STAT_VM }
+
+struct kvm_stats_debugfs_item debugfs_entries[] = {
+	VCPU_STAT(halt_successful_poll),
+	VCPU_STAT(halt_attempted_poll),
+	VCPU_STAT(halt_poll_invalid),
+	VCPU_STAT(halt_wakeup),
+	VCPU_STAT(ecall_exit_stat),
+	VCPU_STAT(wfi_exit_stat),
+	VCPU_STAT(mmio_exit_user),
+	VCPU_STAT(mmio_exit_kernel),
+	VCPU_STAT(exits),
+	VM_STAT(remote_tlb_flush),
+	{ NULL }
+};
+
+/*
+ * The guest sees its VS interrupts in the S positions of sie and sip,
+ * one bit below where they sit in hvip.
+ */
+#define VSIP_TO_HVIP_SHIFT	(IRQ_VS_SOFT - IRQ_S_SOFT)
+#define VSIP_VALID_MASK		((1UL << IRQ_S_SOFT) | \
+				 (1UL << IRQ_S_TIMER) | \
+				 (1UL << IRQ_S_EXT))
+
+/* The extensions a guest may have: we only switch the D-sized FP state */
+#define KVM_RISCV_ISA_ALLOWED	(COMPAT_HWCAP_ISA_I | COMPAT_HWCAP_ISA_M | \
+				 COMPAT_HWCAP_ISA_A | COMPAT_HWCAP_ISA_F | \
+				 COMPAT_HWCAP_ISA_D | COMPAT_HWCAP_ISA_C)
+
+static unsigned long kvm_riscv_vcpu_allowed_isa(void)
+{
+	unsigned long isa = elf_hwcap & KVM_RISCV_ISA_ALLOWED;
+
+	if (!(isa & COMPAT_HWCAP_ISA_D))
+		isa &= ~COMPAT_HWCAP_ISA_F;
+
+	return isa;
+}
+
+/* The FP registers start out zeroed, if the guest has them at all */
+static void kvm_riscv_vcpu_fp_reset(struct kvm_vcpu *vcpu)
+{
+	struct kvm_cpu_context *cntx = &vcpu->arch.guest_context;
+
+	cntx->sstatus &= ~SR_FS;
+	if (vcpu->arch.isa & (COMPAT_HWCAP_ISA_F | COMPAT_HWCAP_ISA_D))
+		cntx->sstatus |= SR_FS_INITIAL;
+}
+
+static void kvm_riscv_reset_vcpu(struct kvm_vcpu *vcpu)
+{
+	struct kvm_vcpu_csr *csr = &vcpu->arch.guest_csr;
+	struct kvm_vcpu_csr *reset_csr = &vcpu->arch.guest_reset_csr;
+	struct kvm_cpu_context *cntx = &vcpu->arch.guest_context;
+	struct kvm_cpu_context *reset_cntx = &vcpu->arch.guest_reset_context;
+
+	memcpy(csr, reset_csr, sizeof(*csr));
+	memcpy(cntx, reset_cntx, sizeof(*cntx));
+
+	kvm_riscv_vcpu_fp_reset(vcpu);
+
+	kvm_riscv_vcpu_timer_reset(vcpu);
+
+	WRITE_ONCE(vcpu->arch.irqs_pending, 0);
+	WRITE_ONCE(vcpu->arch.irqs_pending_mask, 0);
+
+	/* A reset guest registers its steal-time area again */
+	vcpu->arch.sta.enabled = false;
+}
+
+struct kvm_vcpu *kvm_arch_vcpu_create(struct kvm *kvm, unsigned int id)
+{
+	int err;
+	struct kvm_vcpu *vcpu;
+
+	vcpu = kmem_cache_zalloc(kvm_vcpu_cache, GFP_KERNEL);
+	if (!vcpu) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	err = kvm_vcpu_init(vcpu, kvm, id);
+	if (err)
+		goto free_vcpu;
+
+	return vcpu;
+
+free_vcpu:
+	kmem_cache_free(kvm_vcpu_cache, vcpu);
+out:
+	return ERR_PTR(err);
+}
+
+int kvm_arch_vcpu_setup(struct kvm_vcpu *vcpu)
+{
+	return 0;
+}
+
+/* Only the boot vcpu runs from the start: the others wait for SBI HSM */
+void kvm_arch_vcpu_postcreate(struct kvm_vcpu *vcpu)
+{
+	if (vcpu->vcpu_id)
+		kvm_riscv_vcpu_power_off(vcpu);
+}
+
+void kvm_arch_vcpu_free(struct kvm_vcpu *vcpu)
+{
+	kvm_riscv_vcpu_timer_deinit(vcpu);
+	kvm_riscv_stage2_cache_free(vcpu);
+	kvm_vcpu_uninit(vcpu);
+	kmem_cache_free(kvm_vcpu_cache, vcpu);
+}
+
+void kvm_arch_vcpu_destroy(struct kvm_vcpu *vcpu)
+{
+	kvm_arch_vcpu_free(vcpu);
+}
+
+int kvm_arch_vcpu_init(struct kvm_vcpu *vcpu)
+{
+	struct kvm_cpu_context *cntx = &vcpu->arch.guest_reset_context;
+
+	vcpu->arch.ran_atleast_once = false;
+	vcpu->arch.last_exit_cpu = -1;
+	vcpu->arch.isa = kvm_riscv_vcpu_allowed_isa();
+
+	/*
+	 * The guest starts in VS-mode with interrupts enabled by the sret,
+	 * and traps its wfi so an idle vcpu gives the host CPU back.
+	 */
+	cntx->sstatus = SR_PS | SR_PIE;
+	cntx->hstatus = HSTATUS_SPV | HSTATUS_SPVP | HSTATUS_VTW |
+			(HSTATUS_VSXL_64 << HSTATUS_VSXL_SHIFT);
+
+	kvm_riscv_vcpu_timer_init(vcpu);
+
+	kvm_riscv_reset_vcpu(vcpu);
+
+	return 0;
+}
+
+int kvm_arch_vcpu_runnable(struct kvm_vcpu *vcpu)
+{
+	return kvm_riscv_vcpu_has_interrupts(vcpu, -1UL) &&
+	       !vcpu->arch.power_off;
+}
+
+int kvm_arch_vcpu_should_kick(struct kvm_vcpu *vcpu)
+{
+	return kvm_vcpu_exiting_guest_mode(vcpu) == IN_GUEST_MODE;
+}
+
+bool kvm_arch_vcpu_in_kernel(struct kvm_vcpu *vcpu)
+{
+	return (vcpu->arch.guest_context.sstatus & SR_PS) ? true : false;
+}
+
+int kvm_arch_vcpu_fault(struct kvm_vcpu *vcpu, struct vm_fault *vmf)
+{
+	return VM_FAULT_SIGBUS;
+}
+
+bool kvm_arch_has_vcpu_debugfs(void)
+{
+	return false;
+}
+
+int kvm_arch_create_vcpu_debugfs(struct kvm_vcpu *vcpu)
+{
+	return 0;
+}
+
+int kvm_cpu_has_pending_timer(struct kvm_vcpu *vcpu)
+{
+	return kvm_riscv_vcpu_has_interrupts(vcpu, 1UL << IRQ_VS_TIMER);
+}
+
+/*
+ * The guest's CSRs and FP registers live in the hardware while the vcpu
+ * is loaded, which it is for every ioctl but KVM_INTERRUPT.  Accessing
+ * them puts the vcpu and loads it back around the access.
+ */
+static void kvm_riscv_vcpu_sync_begin(struct kvm_vcpu *vcpu)
+{
+	preempt_disable();
+	kvm_arch_vcpu_put(vcpu);
+}
+
+static void kvm_riscv_vcpu_sync_end(struct kvm_vcpu *vcpu)
+{
+	kvm_arch_vcpu_load(vcpu, smp_processor_id());
+	preempt_enable();
+}
+
+#define KVM_REG_RISCV_NUM(id)	((id) & ~(KVM_REG_ARCH_MASK | \
+					  KVM_REG_SIZE_MASK | \
+					  KVM_REG_RISCV_TYPE_MASK))
+
+static int kvm_riscv_vcpu_get_reg_config(struct kvm_vcpu *vcpu,
+					 const struct kvm_one_reg *reg)
+{
+	unsigned long __user *uaddr =
+			(unsigned long __user *)(unsigned long)reg->addr;
+	unsigned long reg_num = KVM_REG_RISCV_NUM(reg->id);
+	unsigned long reg_val;
+
+	if (KVM_REG_SIZE(reg->id) != sizeof(unsigned long))
+		return -EINVAL;
+
+	switch (reg_num) {
+	case KVM_REG_RISCV_CONFIG_REG(isa):
+		reg_val = vcpu->arch.isa;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (copy_to_user(uaddr, &reg_val, KVM_REG_SIZE(reg->id)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int kvm_riscv_vcpu_set_reg_config(struct kvm_vcpu *vcpu,
+					 const struct kvm_one_reg *reg)
+{
+	unsigned long __user *uaddr =
+			(unsigned long __user *)(unsigned long)reg->addr;
+	unsigned long reg_num = KVM_REG_RISCV_NUM(reg->id);
+	unsigned long reg_val;
+
+	if (KVM_REG_SIZE(reg->id) != sizeof(unsigned long))
+		return -EINVAL;
+
+	if (copy_from_user(&reg_val, uaddr, KVM_REG_SIZE(reg->id)))
+		return -EFAULT;
+
+	switch (reg_num) {
+	case KVM_REG_RISCV_CONFIG_REG(isa):
+		/* The guest can't lose extensions it may already be using */
+		if (vcpu->arch.ran_atleast_once)
+			return -EBUSY;
+		kvm_riscv_vcpu_sync_begin(vcpu);
+		vcpu->arch.isa = reg_val & kvm_riscv_vcpu_allowed_isa();
+		if (!(vcpu->arch.isa & COMPAT_HWCAP_ISA_D))
+			vcpu->arch.isa &= ~COMPAT_HWCAP_ISA_F;
+		kvm_riscv_vcpu_fp_reset(vcpu);
+		kvm_riscv_vcpu_sync_end(vcpu);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int kvm_riscv_vcpu_get_reg_core(struct kvm_vcpu *vcpu,
+				       const struct kvm_one_reg *reg)
+{
+	struct kvm_cpu_context *cntx = &vcpu->arch.guest_context;
+	unsigned long __user *uaddr =
+			(unsigned long __user *)(unsigned long)reg->addr;
+	unsigned long reg_num = KVM_REG_RISCV_NUM(reg->id);
+	unsigned long reg_val;
+
+	if (KVM_REG_SIZE(reg->id) != sizeof(unsigned long))
+		return -EINVAL;
+	if (reg_num >= sizeof(struct kvm_riscv_core) / sizeof(unsigned long))
+		return -EINVAL;
+
+	if (reg_num == KVM_REG_RISCV_CORE_REG(regs.pc))
+		reg_val = cntx->sepc;
+	else if (reg_num == KVM_REG_RISCV_CORE_REG(mode))
+		reg_val = (cntx->sstatus & SR_PS) ?
+				KVM_RISCV_MODE_S : KVM_RISCV_MODE_U;
+	else
+		reg_val = ((unsigned long *)cntx)[reg_num];
+
+	if (copy_to_user(uaddr, &reg_val, KVM_REG_SIZE(reg->id)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int kvm_riscv_vcpu_set_reg_core(struct kvm_vcpu *vcpu,
+				       const struct kvm_one_reg *reg)
+{
+	struct kvm_cpu_context *cntx = &vcpu->arch.guest_context;
+	unsigned long __user *uaddr =
+			(unsigned long __user *)(unsigned long)reg->addr;
+	unsigned long reg_num = KVM_REG_RISCV_NUM(reg->id);
+	unsigned long reg_val;
+
+	if (KVM_REG_SIZE(reg->id) != sizeof(unsigned long))
+		return -EINVAL;
+	if (reg_num >= sizeof(struct kvm_riscv_core) / sizeof(unsigned long))
+		return -EINVAL;
+
+	if (copy_from_user(&reg_val, uaddr, KVM_REG_SIZE(reg->id)))
+		return -EFAULT;
+
+	if (reg_num == KVM_REG_RISCV_CORE_REG(regs.pc))
+		cntx->sepc = reg_val;
+	else if (reg_num == KVM_REG_RISCV_CORE_REG(mode)) {
+		if (reg_val == KVM_RISCV_MODE_S)
+			cntx->sstatus |= SR_PS;
+		else
+			cntx->sstatus &= ~SR_PS;
+	} else
+		((unsigned long *)cntx)[reg_num] = reg_val;
+
+	return 0;
+}
+
+/* struct kvm_riscv_csr and struct kvm_vcpu_csr have the same layout */
+static int kvm_riscv_vcpu_get_reg_csr(struct kvm_vcpu *vcpu,
+				      const struct kvm_one_reg *reg)
+{
+	struct kvm_vcpu_csr *csr = &vcpu->arch.guest_csr;
+	unsigned long __user *uaddr =
+			(unsigned long __user *)(unsigned long)reg->addr;
+	unsigned long reg_num = KVM_REG_RISCV_NUM(reg->id);
+	unsigned long reg_val;
+
+	if (KVM_REG_SIZE(reg->id) != sizeof(unsigned long))
+		return -EINVAL;
+	if (reg_num >= sizeof(struct kvm_riscv_csr) / sizeof(unsigned long))
+		return -EINVAL;
+
+	kvm_riscv_vcpu_sync_begin(vcpu);
+	if (reg_num == KVM_REG_RISCV_CSR_REG(sip)) {
+		kvm_riscv_vcpu_flush_interrupts(vcpu);
+		reg_val = (csr->hvip >> VSIP_TO_HVIP_SHIFT) & VSIP_VALID_MASK;
+	} else {
+		reg_val = ((unsigned long *)csr)[reg_num];
+	}
+	kvm_riscv_vcpu_sync_end(vcpu);
+
+	if (copy_to_user(uaddr, &reg_val, KVM_REG_SIZE(reg->id)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int kvm_riscv_vcpu_set_reg_csr(struct kvm_vcpu *vcpu,
+				      const struct kvm_one_reg *reg)
+{
+	struct kvm_vcpu_csr *csr = &vcpu->arch.guest_csr;
+	unsigned long __user *uaddr =
+			(unsigned long __user *)(unsigned long)reg->addr;
+	unsigned long reg_num = KVM_REG_RISCV_NUM(reg->id);
+	unsigned long reg_val;
+
+	if (KVM_REG_SIZE(reg->id) != sizeof(unsigned long))
+		return -EINVAL;
+	if (reg_num >= sizeof(struct kvm_riscv_csr) / sizeof(unsigned long))
+		return -EINVAL;
+
+	if (copy_from_user(&reg_val, uaddr, KVM_REG_SIZE(reg->id)))
+		return -EFAULT;
+
+	kvm_riscv_vcpu_sync_begin(vcpu);
+	if (reg_num == KVM_REG_RISCV_CSR_REG(sip)) {
+		reg_val = (reg_val & VSIP_VALID_MASK) << VSIP_TO_HVIP_SHIFT;
+		WRITE_ONCE(vcpu->arch.irqs_pending_mask, 0);
+		WRITE_ONCE(vcpu->arch.irqs_pending, reg_val);
+		csr->hvip = reg_val;
+	} else {
+		((unsigned long *)csr)[reg_num] = reg_val;
+	}
+	kvm_riscv_vcpu_sync_end(vcpu);
+
+	return 0;
+}
+
+static int kvm_riscv_vcpu_reg_fp_d(struct kvm_vcpu *vcpu,
+				   const struct kvm_one_reg *reg, bool set)
+{
+	struct __riscv_d_ext_state *d = &vcpu->arch.guest_context.fp.d;
+	unsigned long reg_num = KVM_REG_RISCV_NUM(reg->id);
+	void __user *uaddr = (void __user *)(unsigned long)reg->addr;
+	void *reg_val;
+	int ret = 0;
+
+	if (!(vcpu->arch.isa & COMPAT_HWCAP_ISA_D))
+		return -EINVAL;
+
+	if (reg_num == KVM_REG_RISCV_FP_D_REG(fcsr)) {
+		if (KVM_REG_SIZE(reg->id) != sizeof(u32))
+			return -EINVAL;
+		reg_val = &d->fcsr;
+	} else if (reg_num < ARRAY_SIZE(d->f)) {
+		if (KVM_REG_SIZE(reg->id) != sizeof(u64))
+			return -EINVAL;
+		reg_val = &d->f[reg_num];
+	} else {
+		return -EINVAL;
+	}
+
+	kvm_riscv_vcpu_sync_begin(vcpu);
+	if (set) {
+		if (copy_from_user(reg_val, uaddr, KVM_REG_SIZE(reg->id)))
+			ret = -EFAULT;
+	} else {
+		if (copy_to_user(uaddr, reg_val, KVM_REG_SIZE(reg->id)))
+			ret = -EFAULT;
+	}
+	kvm_riscv_vcpu_sync_end(vcpu);
+
+	return ret;
+}
+
+static int kvm_riscv_vcpu_set_reg(struct kvm_vcpu *vcpu,
+				  const struct kvm_one_reg *reg)
+{
+	switch (reg->id & KVM_REG_RISCV_TYPE_MASK) {
+	case KVM_REG_RISCV_CONFIG:
+		return kvm_riscv_vcpu_set_reg_config(vcpu, reg);
+	case KVM_REG_RISCV_CORE:
+		return kvm_riscv_vcpu_set_reg_core(vcpu, reg);
+	case KVM_REG_RISCV_CSR:
+		return kvm_riscv_vcpu_set_reg_csr(vcpu, reg);
+	case KVM_REG_RISCV_TIMER:
+		return kvm_riscv_vcpu_set_reg_timer(vcpu, reg);
+	case KVM_REG_RISCV_FP_D:
+		return kvm_riscv_vcpu_reg_fp_d(vcpu, reg, true);
+	}
+
+	return -EINVAL;
+}
+
+static int kvm_riscv_vcpu_get_reg(struct kvm_vcpu *vcpu,
+				  const struct kvm_one_reg *reg)
+{
+	switch (reg->id & KVM_REG_RISCV_TYPE_MASK) {
+	case KVM_REG_RISCV_CONFIG:
+		return kvm_riscv_vcpu_get_reg_config(vcpu, reg);
+	case KVM_REG_RISCV_CORE:
+		return kvm_riscv_vcpu_get_reg_core(vcpu, reg);
+	case KVM_REG_RISCV_CSR:
+		return kvm_riscv_vcpu_get_reg_csr(vcpu, reg);
+	case KVM_REG_RISCV_TIMER:
+		return kvm_riscv_vcpu_get_reg_timer(vcpu, reg);
+	case KVM_REG_RISCV_FP_D:
+		return kvm_riscv_vcpu_reg_fp_d(vcpu, reg, false);
+	}
+
+	return -EINVAL;
+}
+
+long kvm_arch_vcpu_ioctl(struct file *filp,
+			 unsigned int ioctl, unsigned long arg)
+{
+	struct kvm_vcpu *vcpu = filp->private_data;
+	void __user *argp = (void __user *)arg;
+	long r = -EINVAL;
+
+	switch (ioctl) {
+	case KVM_INTERRUPT: {
+		struct kvm_interrupt irq;
+
+		/* Called without the vcpu loaded: see kvm_vcpu_ioctl() */
+		if (copy_from_user(&irq, argp, sizeof(irq)))
+			return -EFAULT;
+
+		if (irq.irq == KVM_INTERRUPT_SET)
+			return kvm_riscv_vcpu_set_interrupt(vcpu, IRQ_VS_EXT);
+		else if (irq.irq == KVM_INTERRUPT_UNSET)
+			return kvm_riscv_vcpu_unset_interrupt(vcpu, IRQ_VS_EXT);
+		return -EINVAL;
+	}
+	case KVM_SET_ONE_REG:
+	case KVM_GET_ONE_REG: {
+		struct kvm_one_reg reg;
+
+		r = -EFAULT;
+		if (copy_from_user(&reg, argp, sizeof(reg)))
+			break;
+
+		if (ioctl == KVM_SET_ONE_REG)
+			r = kvm_riscv_vcpu_set_reg(vcpu, &reg);
+		else
+			r = kvm_riscv_vcpu_get_reg(vcpu, &reg);
+		break;
+	}
+	default:
+		break;
+	}
+
+	return r;
+}
+
+int kvm_arch_vcpu_ioctl_get_sregs(struct kvm_vcpu *vcpu,
+				  struct kvm_sregs *sregs)
+{
+	return -EINVAL;
+}
+
+int kvm_arch_vcpu_ioctl_set_sregs(struct kvm_vcpu *vcpu,
+				  struct kvm_sregs *sregs)
+{
+	return -EINVAL;
+}
+
+int kvm_arch_vcpu_ioctl_get_fpu(struct kvm_vcpu *vcpu, struct kvm_fpu *fpu)
+{
+	return -EINVAL;
+}
+
+int kvm_arch_vcpu_ioctl_set_fpu(struct kvm_vcpu *vcpu, struct kvm_fpu *fpu)
+{
+	return -EINVAL;
+}
+
+int kvm_arch_vcpu_ioctl_translate(struct kvm_vcpu *vcpu,
+				  struct kvm_translation *tr)
+{
+	return -EINVAL;
+}
+
+int kvm_arch_vcpu_ioctl_get_regs(struct kvm_vcpu *vcpu, struct kvm_regs *regs)
+{
+	return -EINVAL;
+}
+
+int kvm_arch_vcpu_ioctl_set_regs(struct kvm_vcpu *vcpu, struct kvm_regs *regs)
+{
+	return -EINVAL;
+}
+
+int kvm_arch_vcpu_ioctl_set_guest_debug(struct kvm_vcpu *vcpu,
+					struct kvm_guest_debug *dbg)
+{
+	return -EINVAL;
+}
+
+/*
+ * Interrupts are raised from anywhere, and only reach hvip when the vcpu
+ * next enters the guest: irqs_pending_mask says which bits of hvip the
+ * bits of irqs_pending replace.
+ */
+int kvm_riscv_vcpu_set_interrupt(struct kvm_vcpu *vcpu, unsigned int irq)
+{
+	if (irq != IRQ_VS_SOFT && irq != IRQ_VS_TIMER && irq != IRQ_VS_EXT)
+		return -EINVAL;
+
+	set_bit(irq, &vcpu->arch.irqs_pending);
+	smp_mb__before_atomic();
+	set_bit(irq, &vcpu->arch.irqs_pending_mask);
+
+	kvm_vcpu_kick(vcpu);
+
+	return 0;
+}
+
+int kvm_riscv_vcpu_unset_interrupt(struct kvm_vcpu *vcpu, unsigned int irq)
+{
+	if (irq != IRQ_VS_SOFT && irq != IRQ_VS_TIMER && irq != IRQ_VS_EXT)
+		return -EINVAL;
+
+	clear_bit(irq, &vcpu->arch.irqs_pending);
+	smp_mb__before_atomic();
+	set_bit(irq, &vcpu->arch.irqs_pending_mask);
+
+	return 0;
+}
+
+void kvm_riscv_vcpu_flush_interrupts(struct kvm_vcpu *vcpu)
+{
+	struct kvm_vcpu_csr *csr = &vcpu->arch.guest_csr;
+	unsigned long mask, val;
+
+	if (READ_ONCE(vcpu->arch.irqs_pending_mask)) {
+		mask = xchg_acquire(&vcpu->arch.irqs_pending_mask, 0);
+		val = READ_ONCE(vcpu->arch.irqs_pending) & mask;
+
+		csr->hvip &= ~mask;
+		csr->hvip |= val;
+	}
+}
+
+/* Pick up what the guest changed: its sie, and the VSSIP it may clear */
+void kvm_riscv_vcpu_sync_interrupts(struct kvm_vcpu *vcpu)
+{
+	struct kvm_vcpu_arch *v = &vcpu->arch;
+	struct kvm_vcpu_csr *csr = &vcpu->arch.guest_csr;
+	unsigned long hvip;
+
+	csr->vsie = csr_read(CSR_VSIE);
+
+	hvip = csr_read(CSR_HVIP);
+	if ((csr->hvip ^ hvip) & (1UL << IRQ_VS_SOFT)) {
+		if (!test_and_set_bit(IRQ_VS_SOFT, &v->irqs_pending_mask)) {
+			if (hvip & (1UL << IRQ_VS_SOFT))
+				set_bit(IRQ_VS_SOFT, &v->irqs_pending);
+			else
+				clear_bit(IRQ_VS_SOFT, &v->irqs_pending);
+		}
+	}
+}
+
+bool kvm_riscv_vcpu_has_interrupts(struct kvm_vcpu *vcpu, unsigned long mask)
+{
+	unsigned long ie;
+
+	ie = ((vcpu->arch.guest_csr.vsie & VSIP_VALID_MASK)
+		<< VSIP_TO_HVIP_SHIFT) & mask;
+
+	return (READ_ONCE(vcpu->arch.irqs_pending) & ie) ? true : false;
+}
+
+void kvm_riscv_vcpu_power_off(struct kvm_vcpu *vcpu)
+{
+	vcpu->arch.power_off = true;
+	kvm_make_request(KVM_REQ_SLEEP, vcpu);
+	kvm_vcpu_kick(vcpu);
+}
+
+void kvm_riscv_vcpu_power_on(struct kvm_vcpu *vcpu)
+{
+	vcpu->arch.power_off = false;
+	kvm_vcpu_wake_up(vcpu);
+}
+
+int kvm_arch_vcpu_ioctl_get_mpstate(struct kvm_vcpu *vcpu,
+				    struct kvm_mp_state *mp_state)
+{
+	if (vcpu->arch.power_off)
+		mp_state->mp_state = KVM_MP_STATE_STOPPED;
+	else
+		mp_state->mp_state = KVM_MP_STATE_RUNNABLE;
+
+	return 0;
+}
+
+int kvm_arch_vcpu_ioctl_set_mpstate(struct kvm_vcpu *vcpu,
+				    struct kvm_mp_state *mp_state)
+{
+	switch (mp_state->mp_state) {
+	case KVM_MP_STATE_RUNNABLE:
+		vcpu->arch.power_off = false;
+		break;
+	case KVM_MP_STATE_STOPPED:
+		kvm_riscv_vcpu_power_off(vcpu);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+void kvm_arch_vcpu_load(struct kvm_vcpu *vcpu, int cpu)
+{
+	struct kvm_vcpu_csr *csr = &vcpu->arch.guest_csr;
+	struct kvm_cpu_context *cntx = &vcpu->arch.guest_context;
+	int *last_ran;
+
+	csr_write(CSR_VSSTATUS, csr->vsstatus);
+	csr_write(CSR_VSIE, csr->vsie);
+	csr_write(CSR_VSTVEC, csr->vstvec);
+	csr_write(CSR_VSSCRATCH, csr->vsscratch);
+	csr_write(CSR_VSEPC, csr->vsepc);
+	csr_write(CSR_VSCAUSE, csr->vscause);
+	csr_write(CSR_VSTVAL, csr->vstval);
+	csr_write(CSR_HVIP, csr->hvip);
+	csr_write(CSR_VSATP, csr->vsatp);
+
+	kvm_riscv_stage2_update_hgatp(vcpu);
+
+	kvm_riscv_vcpu_timer_restore(vcpu);
+
+	/* Save the host's FP registers, which the guest's replace */
+	fstate_save(current, task_pt_regs(current));
+	if ((cntx->sstatus & SR_FS) != SR_FS_OFF) {
+		__kvm_riscv_fp_d_restore(cntx);
+		cntx->sstatus = (cntx->sstatus & ~SR_FS) | SR_FS_CLEAN;
+	}
+
+	/*
+	 * The VS-stage TLB entries and the instruction cache are per hart,
+	 * and only tagged by the VMID the vcpus of a VM share.  Flush them
+	 * if another vcpu ran here since, or this one ran elsewhere.
+	 */
+	last_ran = per_cpu_ptr(vcpu->kvm->arch.last_vcpu_ran, cpu);
+	if (*last_ran != vcpu->vcpu_id || vcpu->arch.last_exit_cpu != cpu) {
+		__kvm_riscv_hfence_vvma_all();
+		local_flush_icache_all();
+		*last_ran = vcpu->vcpu_id;
+	}
+
+	kvm_make_request(KVM_REQ_STEAL_UPDATE, vcpu);
+
+	vcpu->cpu = cpu;
+}
+
+void kvm_arch_vcpu_put(struct kvm_vcpu *vcpu)
+{
+	struct kvm_vcpu_csr *csr = &vcpu->arch.guest_csr;
+	struct kvm_cpu_context *cntx = &vcpu->arch.guest_context;
+
+	vcpu->cpu = -1;
+
+	if (vcpu->preempted)
+		kvm_riscv_vcpu_set_preempted(vcpu);
+
+	if ((cntx->sstatus & SR_FS) == SR_FS_DIRTY) {
+		__kvm_riscv_fp_d_save(cntx);
+		cntx->sstatus = (cntx->sstatus & ~SR_FS) | SR_FS_CLEAN;
+	}
+	fstate_restore(current, task_pt_regs(current));
+
+	csr->vsstatus = csr_read(CSR_VSSTATUS);
+	csr->vsie = csr_read(CSR_VSIE);
+	csr->vstvec = csr_read(CSR_VSTVEC);
+	csr->vsscratch = csr_read(CSR_VSSCRATCH);
+	csr->vsepc = csr_read(CSR_VSEPC);
+	csr->vscause = csr_read(CSR_VSCAUSE);
+	csr->vstval = csr_read(CSR_VSTVAL);
+	csr->hvip = csr_read(CSR_HVIP);
+	csr->vsatp = csr_read(CSR_VSATP);
+
+	vcpu->arch.last_exit_cpu = smp_processor_id();
+}
+
+/* Called with the srcu read lock held, which a sleeping vcpu must drop */
+static void kvm_riscv_check_vcpu_requests(struct kvm_vcpu *vcpu)
+{
+	struct swait_queue_head *wq = kvm_arch_vcpu_wq(vcpu);
+
+	if (!kvm_request_pending(vcpu))
+		return;
+
+	if (kvm_check_request(KVM_REQ_SLEEP, vcpu)) {
+		srcu_read_unlock(&vcpu->kvm->srcu, vcpu->srcu_idx);
+		swait_event_interruptible(*wq, !vcpu->arch.power_off);
+		vcpu->srcu_idx = srcu_read_lock(&vcpu->kvm->srcu);
+
+		if (vcpu->arch.power_off) {
+			/* Awaken to handle a signal, sleep again later */
+			kvm_make_request(KVM_REQ_SLEEP, vcpu);
+		}
+	}
+
+	if (kvm_check_request(KVM_REQ_VCPU_RESET, vcpu)) {
+		preempt_disable();
+		kvm_arch_vcpu_put(vcpu);
+		kvm_riscv_reset_vcpu(vcpu);
+		kvm_arch_vcpu_load(vcpu, smp_processor_id());
+		preempt_enable();
+	}
+
+	if (kvm_check_request(KVM_REQ_UPDATE_HGATP, vcpu))
+		kvm_riscv_stage2_update_hgatp(vcpu);
+
+	if (kvm_check_request(KVM_REQ_TLB_FLUSH, vcpu))
+		__kvm_riscv_hfence_gvma_vmid(
+				READ_ONCE(vcpu->kvm->arch.vmid.vmid));
+
+	if (kvm_check_request(KVM_REQ_FENCE_I, vcpu))
+		local_flush_icache_all();
+
+	if (kvm_check_request(KVM_REQ_HFENCE_VVMA_ALL, vcpu))
+		__kvm_riscv_hfence_vvma_all();
+
+	if (kvm_check_request(KVM_REQ_STEAL_UPDATE, vcpu))
+		kvm_riscv_vcpu_record_steal_time(vcpu);
+}
+
+int kvm_arch_vcpu_ioctl_run(struct kvm_vcpu *vcpu, struct kvm_run *run)
+{
+	int ret;
+	sigset_t sigsaved;
+	struct kvm_cpu_trap trap;
+
+	vcpu->arch.ran_atleast_once = true;
+
+	vcpu->srcu_idx = srcu_read_lock(&vcpu->kvm->srcu);
+
+	/* Complete what userspace emulated for us */
+	if (run->exit_reason == KVM_EXIT_MMIO) {
+		ret = kvm_riscv_vcpu_mmio_return(vcpu, vcpu->run);
+		if (ret) {
+			srcu_read_unlock(&vcpu->kvm->srcu, vcpu->srcu_idx);
+			return ret;
+		}
+	}
+
+	if (run->exit_reason == KVM_EXIT_RISCV_SBI) {
+		ret = kvm_riscv_vcpu_sbi_return(vcpu, vcpu->run);
+		if (ret) {
+			srcu_read_unlock(&vcpu->kvm->srcu, vcpu->srcu_idx);
+			return ret;
+		}
+	}
+
+	if (run->immediate_exit) {
+		srcu_read_unlock(&vcpu->kvm->srcu, vcpu->srcu_idx);
+		return -EINTR;
+	}
+
+	if (vcpu->sigset_active)
+		sigprocmask(SIG_SETMASK, &vcpu->sigset, &sigsaved);
+
+	ret = 1;
+	run->exit_reason = KVM_EXIT_UNKNOWN;
+	while (ret > 0) {
+		/* Check conditions before entering the guest */
+		cond_resched();
+
+		kvm_riscv_stage2_vmid_update(vcpu);
+
+		kvm_riscv_check_vcpu_requests(vcpu);
+
+		preempt_disable();
+
+		local_irq_disable();
+
+		if (signal_pending(current)) {
+			ret = -EINTR;
+			run->exit_reason = KVM_EXIT_INTR;
+		}
+
+		/*
+		 * Ensure we set mode to IN_GUEST_MODE after we disable
+		 * interrupts and before the final VCPU requests check.
+		 * See the comment in kvm_vcpu_exiting_guest_mode() and
+		 * Documentation/virtual/kvm/vcpu-requests.rst
+		 */
+		vcpu->mode = IN_GUEST_MODE;
+
+		srcu_read_unlock(&vcpu->kvm->srcu, vcpu->srcu_idx);
+		smp_mb__after_srcu_read_unlock();
+
+		kvm_riscv_vcpu_flush_interrupts(vcpu);
+		csr_write(CSR_HVIP, vcpu->arch.guest_csr.hvip);
+
+		if (ret <= 0 ||
+		    kvm_riscv_stage2_vmid_ver_changed(&vcpu->kvm->arch.vmid) ||
+		    kvm_request_pending(vcpu)) {
+			vcpu->mode = OUTSIDE_GUEST_MODE;
+			local_irq_enable();
+			preempt_enable();
+			vcpu->srcu_idx = srcu_read_lock(&vcpu->kvm->srcu);
+			continue;
+		}
+
+		guest_enter_irqoff();
+
+		__kvm_riscv_switch_to(&vcpu->arch);
+
+		vcpu->mode = OUTSIDE_GUEST_MODE;
+		vcpu->stat.exits++;
+
+		/*
+		 * Record why we exited before enabling interrupts, as an
+		 * interrupt handler overwrites these CSRs.
+		 */
+		trap.sepc = vcpu->arch.guest_context.sepc;
+		trap.scause = csr_read(scause);
+		trap.stval = csr_read(sbadaddr);
+		trap.htval = csr_read(CSR_HTVAL);
+		trap.htinst = csr_read(CSR_HTINST);
+
+		kvm_riscv_vcpu_sync_interrupts(vcpu);
+
+		/*
+		 * We may have exited for a host interrupt, which is still
+		 * pending and gets taken as soon as interrupts are enabled.
+		 * Enabling them before guest_exit() accounts the tick to
+		 * the guest; enabling preemption after keeps the ticks
+		 * from then on out of the guest's time.
+		 */
+		local_irq_enable();
+
+		guest_exit();
+
+		preempt_enable();
+
+		vcpu->srcu_idx = srcu_read_lock(&vcpu->kvm->srcu);
+
+		ret = kvm_riscv_vcpu_exit(vcpu, run, &trap);
+	}
+
+	if (vcpu->sigset_active)
+		sigprocmask(SIG_SETMASK, &sigsaved, NULL);
+
+	srcu_read_unlock(&vcpu->kvm->srcu, vcpu->srcu_idx);
+
+	return ret;
+}
@@ -0,0 +1,532 @@
+/*
+ * Handling of the traps that take a vcpu out of the guest
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/bitops.h>
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/kvm_host.h>
+
+#include <asm/csr.h>
+#include <asm/insn-def.h>
+
+#define INSN_LEN(insn)		(((insn) & 0x3) == 0x3 ? 4 : 2)
+#define INSN_16BIT_MASK		0x3
+
+#define INSN_MATCH_WFI		0x10500073
+#define INSN_MASK_WFI		0xffffffff
+
+#define INSN_MASK_LOAD		0x707f
+#define INSN_MATCH_LB		0x3
+#define INSN_MATCH_LH		0x1003
+#define INSN_MATCH_LW		0x2003
+#define INSN_MATCH_LD		0x3003
+#define INSN_MATCH_LBU		0x4003
+#define INSN_MATCH_LHU		0x5003
+#define INSN_MATCH_LWU		0x6003
+
+#define INSN_MASK_STORE		0x707f
+#define INSN_MATCH_SB		0x23
+#define INSN_MATCH_SH		0x1023
+#define INSN_MATCH_SW		0x2023
+#define INSN_MATCH_SD		0x3023
+
+#define INSN_MASK_C		0xe003
+#define INSN_MATCH_C_LW		0x4000
+#define INSN_MATCH_C_LD		0x6000
+#define INSN_MATCH_C_SW		0xc000
+#define INSN_MATCH_C_SD		0xe000
+#define INSN_MATCH_C_LWSP	0x4002
+#define INSN_MATCH_C_LDSP	0x6002
+#define INSN_MATCH_C_SWSP	0xc002
+#define INSN_MATCH_C_SDSP	0xe002
+
+/* Register fields: rd and rs2 of the base forms, and the compressed ones */
+#define INSN_RD(insn)		(((insn) >> 7) & 0x1f)
+#define INSN_RS2(insn)		(((insn) >> 20) & 0x1f)
+#define INSN_C_RS2(insn)	(((insn) >> 2) & 0x1f)
+#define INSN_C_RDS(insn)	(8 + (((insn) >> 2) & 0x7))
+
+#define GUEST_REG(cntx, n)	(((unsigned long *)(cntx))[n])
+
+/*
+ * Read guest memory (or, with read_insn, the instruction at guest_addr)
+ * through the guest's own translation, with hlv/hlvx.  A fault lands in
+ * __kvm_riscv_unpriv_trap, which records it in trap for the caller to
+ * redirect to the guest; trap->scause must be zero to begin with.
+ */
+unsigned long kvm_riscv_vcpu_unpriv_read(struct kvm_vcpu *vcpu,
+					 bool read_insn,
+					 unsigned long guest_addr,
+					 struct kvm_cpu_trap *trap)
+{
+	register unsigned long taddr asm("a0") = (unsigned long)trap;
+	register unsigned long ttmp asm("a1");
+	register unsigned long val asm("t0");
+	register unsigned long tmp asm("t1");
+	register unsigned long addr asm("t2") = guest_addr;
+	unsigned long flags;
+	unsigned long old_stvec, old_hstatus;
+
+	local_irq_save(flags);
+
+	old_hstatus = csr_swap(CSR_HSTATUS, vcpu->arch.guest_context.hstatus);
+	old_stvec = csr_swap(stvec, (unsigned long)&__kvm_riscv_unpriv_trap);
+
+	if (read_insn) {
+		/* A 32-bit instruction is read in halves, as it may cross pages */
+		asm volatile ("\n"
+			".option push\n"
+			".option norvc\n"
+			HLVX_HU("%[val]", "%[addr]") "\n"
+			"andi %[tmp], %[val], 3\n"
+			"addi %[tmp], %[tmp], -3\n"
+			"bne %[tmp], zero, 2f\n"
+			"addi %[addr], %[addr], 2\n"
+			HLVX_HU("%[tmp]", "%[addr]") "\n"
+			"sll %[tmp], %[tmp], 16\n"
+			"add %[val], %[val], %[tmp]\n"
+			"2:\n"
+			".option pop"
+		: [val] "=&r" (val), [tmp] "=&r" (tmp), [ttmp] "=&r" (ttmp),
+		  [addr] "+&r" (addr)
+		: [taddr] "r" (taddr)
+		: "memory");
+
+		if (trap->scause == EXC_LOAD_PAGE_FAULT)
+			trap->scause = EXC_INST_PAGE_FAULT;
+	} else {
+		asm volatile ("\n"
+			".option push\n"
+			".option norvc\n"
+#ifdef CONFIG_64BIT
+			HLV_D("%[val]", "%[addr]") "\n"
+#else
+			HLV_W("%[val]", "%[addr]") "\n"
+#endif
+			".option pop"
+		: [val] "=&r" (val), [ttmp] "=&r" (ttmp)
+		: [taddr] "r" (taddr), [addr] "r" (addr)
+		: "memory");
+	}
+
+	csr_write(stvec, old_stvec);
+	csr_write(CSR_HSTATUS, old_hstatus);
+
+	local_irq_restore(flags);
+
+	return val;
+}
+
+/* Make the guest take trap, as if the hardware had delegated it */
+void kvm_riscv_vcpu_trap_redirect(struct kvm_vcpu *vcpu,
+				  struct kvm_cpu_trap *trap)
+{
+	unsigned long vsstatus = csr_read(CSR_VSSTATUS);
+
+	vsstatus &= ~SR_PS;
+	if (vcpu->arch.guest_context.sstatus & SR_PS)
+		vsstatus |= SR_PS;
+
+	vsstatus &= ~SR_PIE;
+	if (vsstatus & SR_IE)
+		vsstatus |= SR_PIE;
+
+	vsstatus &= ~SR_IE;
+
+	csr_write(CSR_VSSTATUS, vsstatus);
+	csr_write(CSR_VSCAUSE, trap->scause);
+	csr_write(CSR_VSTVAL, trap->stval);
+	csr_write(CSR_VSEPC, trap->sepc);
+
+	/* Exceptions go to the base of stvec, even when it is vectored */
+	vcpu->arch.guest_context.sepc = csr_read(CSR_VSTVEC) & ~0x3UL;
+	vcpu->arch.guest_context.sstatus |= SR_PS;
+}
+
+/*
+ * Find out which instruction faulted.  htinst has it, transformed so
+ * its address field is zero, unless the hardware leaves that to us.
+ */
+static int kvm_riscv_vcpu_fetch_insn(struct kvm_vcpu *vcpu,
+				     unsigned long htinst,
+				     unsigned long *insn, int *insn_len)
+{
+	struct kvm_cpu_context *ct = &vcpu->arch.guest_context;
+	struct kvm_cpu_trap utrap = { 0 };
+
+	if (htinst & 0x1) {
+		/* Bit 1 is clear for a compressed one: set it back */
+		*insn = htinst | INSN_16BIT_MASK;
+		*insn_len = (htinst & BIT(1)) ? 4 : 2;
+		return 0;
+	}
+
+	*insn = kvm_riscv_vcpu_unpriv_read(vcpu, true, ct->sepc, &utrap);
+	if (utrap.scause) {
+		utrap.sepc = ct->sepc;
+		kvm_riscv_vcpu_trap_redirect(vcpu, &utrap);
+		return 1;
+	}
+	*insn_len = INSN_LEN(*insn);
+
+	return 0;
+}
+
+static int emulate_load(struct kvm_vcpu *vcpu, struct kvm_run *run,
+			unsigned long fault_addr, unsigned long htinst)
+{
+	struct kvm_mmio_decode *d = &vcpu->arch.mmio_decode;
+	int shift = 0, len = 0, insn_len, rd, ret;
+	unsigned long insn;
+	u8 data_buf[8];
+
+	ret = kvm_riscv_vcpu_fetch_insn(vcpu, htinst, &insn, &insn_len);
+	if (ret)
+		return ret;
+
+	rd = INSN_RD(insn);
+	if (insn_len == 4) {
+		switch (insn & INSN_MASK_LOAD) {
+		case INSN_MATCH_LB:
+			len = 1;
+			shift = 8 * (sizeof(unsigned long) - len);
+			break;
+		case INSN_MATCH_LBU:
+			len = 1;
+			break;
+		case INSN_MATCH_LH:
+			len = 2;
+			shift = 8 * (sizeof(unsigned long) - len);
+			break;
+		case INSN_MATCH_LHU:
+			len = 2;
+			break;
+		case INSN_MATCH_LW:
+			len = 4;
+			shift = 8 * (sizeof(unsigned long) - len);
+			break;
+#ifdef CONFIG_64BIT
+		case INSN_MATCH_LWU:
+			len = 4;
+			break;
+		case INSN_MATCH_LD:
+			len = 8;
+			break;
+#endif
+		default:
+			return -EOPNOTSUPP;
+		}
+	} else {
+		switch (insn & INSN_MASK_C) {
+		case INSN_MATCH_C_LW:
+			rd = INSN_C_RDS(insn);
+			len = 4;
+			shift = 8 * (sizeof(unsigned long) - len);
+			break;
+		case INSN_MATCH_C_LWSP:
+			len = 4;
+			shift = 8 * (sizeof(unsigned long) - len);
+			break;
+#ifdef CONFIG_64BIT
+		case INSN_MATCH_C_LD:
+			rd = INSN_C_RDS(insn);
+			len = 8;
+			break;
+		case INSN_MATCH_C_LDSP:
+			len = 8;
+			break;
+#endif
+		default:
+			return -EOPNOTSUPP;
+		}
+	}
+
+	/* Misaligned MMIO is the guest's bug, not something to emulate */
+	if (fault_addr & (len - 1))
+		return -EIO;
+
+	d->insn = insn;
+	d->insn_len = insn_len;
+	d->rd = rd;
+	d->len = len;
+	d->shift = shift;
+	d->return_handled = 0;
+
+	run->mmio.is_write = false;
+	run->mmio.phys_addr = fault_addr;
+	run->mmio.len = len;
+
+	if (!kvm_io_bus_read(vcpu, KVM_MMIO_BUS, fault_addr, len, data_buf)) {
+		memcpy(run->mmio.data, data_buf, len);
+		vcpu->stat.mmio_exit_kernel++;
+		kvm_riscv_vcpu_mmio_return(vcpu, run);
+		return 1;
+	}
+
+	vcpu->stat.mmio_exit_user++;
+	run->exit_reason = KVM_EXIT_MMIO;
+
+	return 0;
+}
+
+static int emulate_store(struct kvm_vcpu *vcpu, struct kvm_run *run,
+			 unsigned long fault_addr, unsigned long htinst)
+{
+	struct kvm_mmio_decode *d = &vcpu->arch.mmio_decode;
+	struct kvm_cpu_context *ct = &vcpu->arch.guest_context;
+	int len = 0, insn_len, rs2, ret;
+	unsigned long insn, data;
+
+	ret = kvm_riscv_vcpu_fetch_insn(vcpu, htinst, &insn, &insn_len);
+	if (ret)
+		return ret;
+
+	rs2 = INSN_RS2(insn);
+	if (insn_len == 4) {
+		switch (insn & INSN_MASK_STORE) {
+		case INSN_MATCH_SB:
+			len = 1;
+			break;
+		case INSN_MATCH_SH:
+			len = 2;
+			break;
+		case INSN_MATCH_SW:
+			len = 4;
+			break;
+#ifdef CONFIG_64BIT
+		case INSN_MATCH_SD:
+			len = 8;
+			break;
+#endif
+		default:
+			return -EOPNOTSUPP;
+		}
+	} else {
+		switch (insn & INSN_MASK_C) {
+		case INSN_MATCH_C_SW:
+			rs2 = INSN_C_RDS(insn);
+			len = 4;
+			break;
+		case INSN_MATCH_C_SWSP:
+			rs2 = INSN_C_RS2(insn);
+			len = 4;
+			break;
+#ifdef CONFIG_64BIT
+		case INSN_MATCH_C_SD:
+			rs2 = INSN_C_RDS(insn);
+			len = 8;
+			break;
+		case INSN_MATCH_C_SDSP:
+			rs2 = INSN_C_RS2(insn);
+			len = 8;
+			break;
+#endif
+		default:
+			return -EOPNOTSUPP;
+		}
+	}
+
+	if (fault_addr & (len - 1))
+		return -EIO;
+
+	d->insn = insn;
+	d->insn_len = insn_len;
+	d->rd = 0;
+	d->len = len;
+	d->shift = 0;
+	d->return_handled = 0;
+
+	/* x0 isn't saved with the other registers, but always reads zero */
+	data = rs2 ? GUEST_REG(ct, rs2) : 0;
+
+	run->mmio.is_write = true;
+	run->mmio.phys_addr = fault_addr;
+	run->mmio.len = len;
+	memcpy(run->mmio.data, &data, len);
+
+	if (!kvm_io_bus_write(vcpu, KVM_MMIO_BUS, fault_addr, len,
+			      run->mmio.data)) {
+		vcpu->stat.mmio_exit_kernel++;
+		kvm_riscv_vcpu_mmio_return(vcpu, run);
+		return 1;
+	}
+
+	vcpu->stat.mmio_exit_user++;
+	run->exit_reason = KVM_EXIT_MMIO;
+
+	return 0;
+}
+
+/*
+ * Finish an MMIO access, emulated here or by userspace: write a load's
+ * value back, extended as the instruction wants, and skip past it.
+ */
+int kvm_riscv_vcpu_mmio_return(struct kvm_vcpu *vcpu, struct kvm_run *run)
+{
+	struct kvm_mmio_decode *d = &vcpu->arch.mmio_decode;
+	struct kvm_cpu_context *ct = &vcpu->arch.guest_context;
+	unsigned long data = 0;
+
+	if (d->return_handled)
+		return 0;
+	d->return_handled = 1;
+
+	if (!run->mmio.is_write) {
+		memcpy(&data, run->mmio.data, d->len);
+		if (d->shift)
+			data = (unsigned long)((long)(data << d->shift) >>
+					       d->shift);
+		if (d->rd)
+			GUEST_REG(ct, d->rd) = data;
+	}
+
+	ct->sepc += d->insn_len;
+
+	return 0;
+}
+
+static int stage2_page_fault(struct kvm_vcpu *vcpu, struct kvm_run *run,
+			     struct kvm_cpu_trap *trap)
+{
+	struct kvm_memory_slot *memslot;
+	unsigned long hva, fault_addr;
+	bool writeable;
+	gfn_t gfn;
+	int ret;
+
+	fault_addr = (trap->htval << 2) | (trap->stval & 0x3);
+	gfn = fault_addr >> PAGE_SHIFT;
+	memslot = gfn_to_memslot(vcpu->kvm, gfn);
+	hva = gfn_to_hva_memslot_prot(memslot, gfn, &writeable);
+
+	/* Outside the memory slots, or a write to a read-only one, is MMIO */
+	if (kvm_is_error_hva(hva) ||
+	    (trap->scause == EXC_STORE_GUEST_PAGE_FAULT && !writeable)) {
+		switch (trap->scause) {
+		case EXC_LOAD_GUEST_PAGE_FAULT:
+			return emulate_load(vcpu, run, fault_addr,
+					    trap->htinst);
+		case EXC_STORE_GUEST_PAGE_FAULT:
+			return emulate_store(vcpu, run, fault_addr,
+					     trap->htinst);
+		default:
+			return -EOPNOTSUPP;
+		}
+	}
+
+	ret = kvm_riscv_stage2_map(vcpu, memslot, fault_addr, hva,
+			trap->scause == EXC_STORE_GUEST_PAGE_FAULT);
+	if (ret < 0)
+		return ret;
+
+	return 1;
+}
+
+static int truly_illegal_insn(struct kvm_vcpu *vcpu, unsigned long insn)
+{
+	struct kvm_cpu_trap utrap = { 0 };
+
+	utrap.sepc = vcpu->arch.guest_context.sepc;
+	utrap.scause = EXC_INST_ILLEGAL;
+	utrap.stval = insn;
+	kvm_riscv_vcpu_trap_redirect(vcpu, &utrap);
+
+	return 1;
+}
+
+/* An idle vcpu blocks until it has an interrupt to take */
+static int wfi_insn(struct kvm_vcpu *vcpu, unsigned long insn)
+{
+	vcpu->stat.wfi_exit_stat++;
+	if (!kvm_arch_vcpu_runnable(vcpu)) {
+		srcu_read_unlock(&vcpu->kvm->srcu, vcpu->srcu_idx);
+		kvm_vcpu_block(vcpu);
+		vcpu->srcu_idx = srcu_read_lock(&vcpu->kvm->srcu);
+		kvm_clear_request(KVM_REQ_UNHALT, vcpu);
+	}
+	vcpu->arch.guest_context.sepc += INSN_LEN(insn);
+
+	return 1;
+}
+
+/*
+ * A virtual instruction exception is an instruction VS-mode could run
+ * if it weren't virtualized: the only one we trap on purpose is wfi.
+ * stval has the instruction, if the hardware bothers to set it.
+ */
+static int virtual_inst_fault(struct kvm_vcpu *vcpu, struct kvm_cpu_trap *trap)
+{
+	unsigned long insn = trap->stval;
+	int insn_len, ret;
+
+	if (!insn) {
+		ret = kvm_riscv_vcpu_fetch_insn(vcpu, 0, &insn, &insn_len);
+		if (ret)
+			return ret;
+	}
+
+	if ((insn & INSN_MASK_WFI) == INSN_MATCH_WFI)
+		return wfi_insn(vcpu, insn);
+
+	return truly_illegal_insn(vcpu, insn);
+}
+
+/*
+ * Return > 0 to go back into the guest, 0 to exit to userspace with
+ * run filled in, or an error.
+ */
+int kvm_riscv_vcpu_exit(struct kvm_vcpu *vcpu, struct kvm_run *run,
+			struct kvm_cpu_trap *trap)
+{
+	bool from_guest = vcpu->arch.guest_context.hstatus & HSTATUS_SPV;
+	int ret;
+
+	/* Host interrupts were taken when we enabled them again */
+	if (trap->scause & CAUSE_IRQ_FLAG)
+		return 1;
+
+	ret = -EFAULT;
+	run->exit_reason = KVM_EXIT_UNKNOWN;
+	switch (trap->scause) {
+	case EXC_VIRTUAL_INST_FAULT:
+		if (from_guest)
+			ret = virtual_inst_fault(vcpu, trap);
+		break;
+	case EXC_INST_GUEST_PAGE_FAULT:
+	case EXC_LOAD_GUEST_PAGE_FAULT:
+	case EXC_STORE_GUEST_PAGE_FAULT:
+		if (from_guest)
+			ret = stage2_page_fault(vcpu, run, trap);
+		break;
+	case EXC_SUPERVISOR_SYSCALL:
+		if (from_guest)
+			ret = kvm_riscv_vcpu_sbi_ecall(vcpu, run);
+		break;
+	default:
+		break;
+	}
+
+	if (ret < 0) {
+		kvm_err("VCPU exit error %d\n", ret);
+		kvm_err("SEPC=0x%lx SSTATUS=0x%lx HSTATUS=0x%lx\n",
+			vcpu->arch.guest_context.sepc,
+			vcpu->arch.guest_context.sstatus,
+			vcpu->arch.guest_context.hstatus);
+		kvm_err("SCAUSE=0x%lx STVAL=0x%lx HTVAL=0x%lx HTINST=0x%lx\n",
+			trap->scause, trap->stval, trap->htval, trap->htinst);
+	}
+
+	return ret;
+}
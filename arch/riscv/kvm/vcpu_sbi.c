@@ -0,0 +1,505 @@
+/*
+ * The SBI as a vcpu sees it
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/bitops.h>
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/sched.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+#include <linux/kvm_host.h>
+
+#include <asm/csr.h>
+#include <asm/sbi.h>
+
+/* The implementation ID the SBI spec assigns to KVM */
+#define KVM_SBI_IMPID			3
+
+/* We implement v0.2 of the spec, plus the legacy calls */
+#define KVM_SBI_VERSION_MAJOR		0
+#define KVM_SBI_VERSION_MINOR		2
+
+/*
+ * Calls the kernel doesn't handle go to userspace, which completes
+ * them on the next KVM_RUN with kvm_riscv_vcpu_sbi_return().
+ */
+static void kvm_sbi_forward(struct kvm_vcpu *vcpu, struct kvm_run *run)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+
+	vcpu->arch.sbi_context.return_handled = 0;
+	run->exit_reason = KVM_EXIT_RISCV_SBI;
+	run->riscv_sbi.extension_id = cp->a7;
+	run->riscv_sbi.function_id = cp->a6;
+	run->riscv_sbi.args[0] = cp->a0;
+	run->riscv_sbi.args[1] = cp->a1;
+	run->riscv_sbi.args[2] = cp->a2;
+	run->riscv_sbi.args[3] = cp->a3;
+	run->riscv_sbi.args[4] = cp->a4;
+	run->riscv_sbi.args[5] = cp->a5;
+	run->riscv_sbi.ret[0] = cp->a0;
+	run->riscv_sbi.ret[1] = cp->a1;
+}
+
+int kvm_riscv_vcpu_sbi_return(struct kvm_vcpu *vcpu, struct kvm_run *run)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+
+	if (vcpu->arch.sbi_context.return_handled)
+		return 0;
+	vcpu->arch.sbi_context.return_handled = 1;
+
+	cp->a0 = run->riscv_sbi.ret[0];
+	cp->a1 = run->riscv_sbi.ret[1];
+	cp->sepc += 4;
+
+	return 0;
+}
+
+static void kvm_sbi_system_shutdown(struct kvm_vcpu *vcpu,
+				    struct kvm_run *run, u32 type)
+{
+	int i;
+	struct kvm_vcpu *tmp;
+
+	kvm_for_each_vcpu(i, tmp, vcpu->kvm)
+		tmp->arch.power_off = true;
+	kvm_make_all_cpus_request(vcpu->kvm, KVM_REQ_SLEEP);
+
+	memset(&run->system_event, 0, sizeof(run->system_event));
+	run->system_event.type = type;
+	run->exit_reason = KVM_EXIT_SYSTEM_EVENT;
+}
+
+static void kvm_sbi_set_timer(struct kvm_vcpu *vcpu)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+
+#if __riscv_xlen == 32
+	kvm_riscv_vcpu_timer_next_event(vcpu, ((u64)cp->a1 << 32) | cp->a0);
+#else
+	kvm_riscv_vcpu_timer_next_event(vcpu, cp->a0);
+#endif
+}
+
+/*
+ * Remote fences are made on every vcpu, whatever the hart mask says: a
+ * few more flushes are cheaper than reading the mask from the guest.
+ */
+static void kvm_sbi_remote_fence_i(struct kvm_vcpu *vcpu)
+{
+	kvm_make_all_cpus_request(vcpu->kvm, KVM_REQ_FENCE_I);
+}
+
+static void kvm_sbi_remote_sfence_vma(struct kvm_vcpu *vcpu)
+{
+	kvm_make_all_cpus_request(vcpu->kvm, KVM_REQ_HFENCE_VVMA_ALL);
+}
+
+/*
+ * The legacy IPI takes the guest address of a hart mask, a bitmap of any
+ * length, or none for every hart.  Hart IDs are vcpu IDs.
+ */
+static void kvm_sbi_send_ipi_legacy(struct kvm_vcpu *vcpu,
+				    struct kvm_cpu_trap *utrap)
+{
+	unsigned long hmask_addr = vcpu->arch.guest_context.a0;
+	unsigned long hmask = 0, word = -1UL, w;
+	struct kvm_vcpu *tmp;
+	int i;
+
+	kvm_for_each_vcpu(i, tmp, vcpu->kvm) {
+		if (hmask_addr) {
+			w = tmp->vcpu_id / BITS_PER_LONG;
+			if (w != word) {
+				hmask = kvm_riscv_vcpu_unpriv_read(vcpu, false,
+						hmask_addr + w * sizeof(hmask),
+						utrap);
+				if (utrap->scause)
+					return;
+				word = w;
+			}
+			if (!(hmask & BIT(tmp->vcpu_id % BITS_PER_LONG)))
+				continue;
+		}
+		kvm_riscv_vcpu_set_interrupt(tmp, IRQ_VS_SOFT);
+	}
+}
+
+/* The v0.2 IPI takes the mask itself, and the hart bit 0 stands for */
+static long kvm_sbi_send_ipi(struct kvm_vcpu *vcpu)
+{
+	unsigned long hmask = vcpu->arch.guest_context.a0;
+	unsigned long hbase = vcpu->arch.guest_context.a1;
+	struct kvm_vcpu *tmp;
+	int i;
+
+	kvm_for_each_vcpu(i, tmp, vcpu->kvm) {
+		if (hbase != -1UL) {
+			if (tmp->vcpu_id < hbase ||
+			    tmp->vcpu_id - hbase >= BITS_PER_LONG)
+				continue;
+			if (!(hmask & BIT(tmp->vcpu_id - hbase)))
+				continue;
+		}
+		kvm_riscv_vcpu_set_interrupt(tmp, IRQ_VS_SOFT);
+	}
+
+	return SBI_SUCCESS;
+}
+
+/*
+ * Returns > 0 with the result in out->error, or 0 to exit to userspace.
+ * Only a0 comes back from the legacy calls.
+ */
+static int kvm_sbi_legacy(struct kvm_vcpu *vcpu, struct kvm_run *run,
+			  struct sbiret *out, struct kvm_cpu_trap *utrap)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+
+	switch (cp->a7) {
+	case SBI_SET_TIMER:
+		kvm_sbi_set_timer(vcpu);
+		break;
+	case SBI_CLEAR_IPI:
+		kvm_riscv_vcpu_unset_interrupt(vcpu, IRQ_VS_SOFT);
+		break;
+	case SBI_SEND_IPI:
+		kvm_sbi_send_ipi_legacy(vcpu, utrap);
+		break;
+	case SBI_REMOTE_FENCE_I:
+		kvm_sbi_remote_fence_i(vcpu);
+		break;
+	case SBI_REMOTE_SFENCE_VMA:
+	case SBI_REMOTE_SFENCE_VMA_ASID:
+		kvm_sbi_remote_sfence_vma(vcpu);
+		break;
+	case SBI_SHUTDOWN:
+		kvm_sbi_system_shutdown(vcpu, run, KVM_SYSTEM_EVENT_SHUTDOWN);
+		return 0;
+	case SBI_CONSOLE_PUTCHAR:
+	case SBI_CONSOLE_GETCHAR:
+	default:
+		/* The console, and whatever else, is up to userspace */
+		kvm_sbi_forward(vcpu, run);
+		return 0;
+	}
+
+	out->error = 0;
+
+	return 1;
+}
+
+static bool kvm_sbi_ext_available(unsigned long ext)
+{
+	switch (ext) {
+	case SBI_SET_TIMER ... SBI_SHUTDOWN:
+	case SBI_EXT_BASE:
+	case SBI_EXT_TIME:
+	case SBI_EXT_IPI:
+	case SBI_EXT_RFENCE:
+	case SBI_EXT_HSM:
+	case SBI_EXT_STA:
+		return true;
+	}
+
+	return false;
+}
+
+static void kvm_sbi_ext_base(struct kvm_vcpu *vcpu, struct sbiret *out)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+
+	switch (cp->a6) {
+	case SBI_EXT_BASE_GET_SPEC_VERSION:
+		out->value = (KVM_SBI_VERSION_MAJOR <<
+			      SBI_SPEC_VERSION_MAJOR_SHIFT) |
+			     KVM_SBI_VERSION_MINOR;
+		break;
+	case SBI_EXT_BASE_GET_IMP_ID:
+		out->value = KVM_SBI_IMPID;
+		break;
+	case SBI_EXT_BASE_GET_IMP_VERSION:
+		out->value = LINUX_VERSION_CODE;
+		break;
+	case SBI_EXT_BASE_PROBE_EXT:
+		out->value = kvm_sbi_ext_available(cp->a0);
+		break;
+	case SBI_EXT_BASE_GET_MVENDORID:
+	case SBI_EXT_BASE_GET_MARCHID:
+	case SBI_EXT_BASE_GET_MIMPID:
+		/* Nothing the guest can rely on, so nothing at all */
+		out->value = 0;
+		break;
+	default:
+		out->error = SBI_ERR_NOT_SUPPORTED;
+		break;
+	}
+}
+
+static void kvm_sbi_ext_rfence(struct kvm_vcpu *vcpu, struct sbiret *out)
+{
+	switch (vcpu->arch.guest_context.a6) {
+	case SBI_EXT_RFENCE_REMOTE_FENCE_I:
+		kvm_sbi_remote_fence_i(vcpu);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA:
+	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID:
+		kvm_sbi_remote_sfence_vma(vcpu);
+		break;
+	default:
+		/* The hfences are for hypervisors, which guests aren't */
+		out->error = SBI_ERR_NOT_SUPPORTED;
+		break;
+	}
+}
+
+static long kvm_sbi_hsm_hart_start(struct kvm_vcpu *vcpu)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+	struct kvm_cpu_context *reset_cntx;
+	struct kvm_vcpu *target;
+
+	target = kvm_get_vcpu_by_id(vcpu->kvm, cp->a0);
+	if (!target)
+		return SBI_ERR_INVALID_PARAM;
+	if (!target->arch.power_off)
+		return SBI_ERR_ALREADY_AVAILABLE;
+
+	/* The hart starts in S-mode with the MMU off, as from the firmware */
+	reset_cntx = &target->arch.guest_reset_context;
+	reset_cntx->sepc = cp->a1;
+	reset_cntx->a0 = cp->a0;
+	reset_cntx->a1 = cp->a2;
+	kvm_make_request(KVM_REQ_VCPU_RESET, target);
+
+	kvm_riscv_vcpu_power_on(target);
+
+	return SBI_SUCCESS;
+}
+
+static void kvm_sbi_ext_hsm(struct kvm_vcpu *vcpu, struct sbiret *out)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+	struct kvm_vcpu *target;
+
+	switch (cp->a6) {
+	case SBI_EXT_HSM_HART_START:
+		out->error = kvm_sbi_hsm_hart_start(vcpu);
+		break;
+	case SBI_EXT_HSM_HART_STOP:
+		kvm_riscv_vcpu_power_off(vcpu);
+		break;
+	case SBI_EXT_HSM_HART_STATUS:
+		target = kvm_get_vcpu_by_id(vcpu->kvm, cp->a0);
+		if (!target)
+			out->error = SBI_ERR_INVALID_PARAM;
+		else if (target->arch.power_off)
+			out->value = SBI_HSM_HART_STATUS_STOPPED;
+		else
+			out->value = SBI_HSM_HART_STATUS_STARTED;
+		break;
+	case SBI_EXT_HSM_HART_SUSPEND:
+		/* A retentive suspend is a wfi; we keep no state to lose */
+		if (cp->a0 & SBI_HSM_SUSPEND_NON_RET_BIT) {
+			out->error = SBI_ERR_NOT_SUPPORTED;
+			break;
+		}
+		if (!kvm_arch_vcpu_runnable(vcpu)) {
+			srcu_read_unlock(&vcpu->kvm->srcu, vcpu->srcu_idx);
+			kvm_vcpu_block(vcpu);
+			vcpu->srcu_idx = srcu_read_lock(&vcpu->kvm->srcu);
+			kvm_clear_request(KVM_REQ_UNHALT, vcpu);
+		}
+		break;
+	default:
+		out->error = SBI_ERR_NOT_SUPPORTED;
+		break;
+	}
+}
+
+static long kvm_sbi_sta_set_shmem(struct kvm_vcpu *vcpu)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+	struct sbi_sta_struct *st = &vcpu->arch.sta.shadow;
+	gpa_t gpa;
+
+	if (cp->a2)
+		return SBI_ERR_INVALID_PARAM;
+
+	if (cp->a0 == SBI_SHMEM_DISABLE && cp->a1 == SBI_SHMEM_DISABLE) {
+		vcpu->arch.sta.enabled = false;
+		return SBI_SUCCESS;
+	}
+
+	/* a1 holds the upper half of the address for RV32 guests only */
+	if (cp->a1)
+		return SBI_ERR_INVALID_ADDRESS;
+	gpa = cp->a0;
+	if (gpa & (sizeof(*st) - 1))
+		return SBI_ERR_INVALID_PARAM;
+
+	if (kvm_gfn_to_hva_cache_init(vcpu->kvm, &vcpu->arch.sta.cache,
+				      gpa, sizeof(*st)))
+		return SBI_ERR_INVALID_ADDRESS;
+
+	/* The guest starts counting from zero, at an even sequence */
+	memset(st, 0, sizeof(*st));
+	if (kvm_write_guest_cached(vcpu->kvm, &vcpu->arch.sta.cache,
+				   st, sizeof(*st)))
+		return SBI_ERR_INVALID_ADDRESS;
+
+	vcpu->arch.sta.last_steal = current->sched_info.run_delay;
+	vcpu->arch.sta.enabled = true;
+
+	return SBI_SUCCESS;
+}
+
+/*
+ * Add the time the vcpu thread waited on a runqueue since the last call
+ * to the guest's steal time, and tell it that it is running again.
+ */
+void kvm_riscv_vcpu_record_steal_time(struct kvm_vcpu *vcpu)
+{
+	struct gfn_to_hva_cache *ghc = &vcpu->arch.sta.cache;
+	struct sbi_sta_struct *st = &vcpu->arch.sta.shadow;
+	u64 run_delay = current->sched_info.run_delay;
+	u32 sequence;
+
+	if (!vcpu->arch.sta.enabled)
+		return;
+
+	if (kvm_read_guest_cached(vcpu->kvm, ghc, st, sizeof(*st)))
+		return;
+
+	/* Don't trust the guest's copy of the sequence to be even */
+	sequence = le32_to_cpu(st->sequence);
+	sequence += (sequence & 1) ? 1 : 2;
+
+	st->sequence = cpu_to_le32(sequence - 1);
+	kvm_write_guest_cached(vcpu->kvm, ghc, st, sizeof(*st));
+
+	smp_wmb();
+
+	st->steal = cpu_to_le64(le64_to_cpu(st->steal) +
+				run_delay - vcpu->arch.sta.last_steal);
+	st->preempted = 0;
+	vcpu->arch.sta.last_steal = run_delay;
+	kvm_write_guest_cached(vcpu->kvm, ghc, st, sizeof(*st));
+
+	smp_wmb();
+
+	st->sequence = cpu_to_le32(sequence);
+	kvm_write_guest_cached(vcpu->kvm, ghc, st, sizeof(*st));
+}
+
+/* Called from vcpu_put when the vcpu thread is preempted */
+void kvm_riscv_vcpu_set_preempted(struct kvm_vcpu *vcpu)
+{
+	struct sbi_sta_struct *st = &vcpu->arch.sta.shadow;
+	int idx;
+
+	if (!vcpu->arch.sta.enabled)
+		return;
+
+	/*
+	 * We may be in atomic context, where the write must not fault in
+	 * the page, and outside of the run loop's srcu read side.
+	 */
+	st->preempted = 1;
+	pagefault_disable();
+	idx = srcu_read_lock(&vcpu->kvm->srcu);
+	kvm_write_guest_offset_cached(vcpu->kvm, &vcpu->arch.sta.cache,
+				      &st->preempted,
+				      offsetof(struct sbi_sta_struct, preempted),
+				      sizeof(st->preempted));
+	srcu_read_unlock(&vcpu->kvm->srcu, idx);
+	pagefault_enable();
+}
+
+/* The v0.2 extensions, returning an error in a0 and a value in a1 */
+static int kvm_sbi_ext(struct kvm_vcpu *vcpu, struct kvm_run *run,
+		       struct sbiret *out)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+
+	switch (cp->a7) {
+	case SBI_EXT_BASE:
+		kvm_sbi_ext_base(vcpu, out);
+		break;
+	case SBI_EXT_TIME:
+		if (cp->a6 == SBI_EXT_TIME_SET_TIMER)
+			kvm_sbi_set_timer(vcpu);
+		else
+			out->error = SBI_ERR_NOT_SUPPORTED;
+		break;
+	case SBI_EXT_IPI:
+		if (cp->a6 == SBI_EXT_IPI_SEND_IPI)
+			out->error = kvm_sbi_send_ipi(vcpu);
+		else
+			out->error = SBI_ERR_NOT_SUPPORTED;
+		break;
+	case SBI_EXT_RFENCE:
+		kvm_sbi_ext_rfence(vcpu, out);
+		break;
+	case SBI_EXT_HSM:
+		kvm_sbi_ext_hsm(vcpu, out);
+		break;
+	case SBI_EXT_STA:
+		if (cp->a6 == SBI_EXT_STA_STEAL_TIME_SET_SHMEM)
+			out->error = kvm_sbi_sta_set_shmem(vcpu);
+		else
+			out->error = SBI_ERR_NOT_SUPPORTED;
+		break;
+	default:
+		out->error = SBI_ERR_NOT_SUPPORTED;
+		break;
+	}
+
+	return 1;
+}
+
+int kvm_riscv_vcpu_sbi_ecall(struct kvm_vcpu *vcpu, struct kvm_run *run)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+	struct kvm_cpu_trap utrap = { 0 };
+	struct sbiret out = { .error = SBI_SUCCESS, .value = 0 };
+	bool legacy = cp->a7 <= SBI_SHUTDOWN;
+	int ret;
+
+	vcpu->stat.ecall_exit_stat++;
+
+	if (legacy)
+		ret = kvm_sbi_legacy(vcpu, run, &out, &utrap);
+	else
+		ret = kvm_sbi_ext(vcpu, run, &out);
+
+	/* A bad hart mask faults in the guest, at the ecall */
+	if (utrap.scause) {
+		utrap.sepc = cp->sepc;
+		kvm_riscv_vcpu_trap_redirect(vcpu, &utrap);
+		return 1;
+	}
+
+	if (ret <= 0)
+		return ret;
+
+	cp->a0 = out.error;
+	if (!legacy)
+		cp->a1 = out.value;
+	cp->sepc += 4;
+
+	return 1;
+}
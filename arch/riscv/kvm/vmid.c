@@ -0,0 +1,140 @@
+/*
+ * VMID allocator
+ * Based on the VMID generations of virt/kvm/arm/arm.c
+ *
+ * Copyright (C) 2012 - Virtual Open Systems and Columbia University
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/bitops.h>
+#include <linux/cpumask.h>
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/module.h>
+#include <linux/smp.h>
+#include <linux/kvm_host.h>
+
+#include <asm/csr.h>
+
+/*
+ * A VM's VMID is only valid in the generation it was allocated in.  When
+ * the VMIDs run out the generation moves on and every hart flushes all
+ * of its guest translations, so each VM then picks a new VMID the next
+ * time one of its vcpus enters the guest.
+ */
+static unsigned long vmid_version = 1;
+static unsigned long vmid_next = 1;
+static unsigned long vmid_bits;
+static DEFINE_SPINLOCK(vmid_lock);
+
+/* Probe the number of VMID bits implemented by writing all ones to hgatp */
+void kvm_riscv_stage2_vmid_detect(void)
+{
+	unsigned long old;
+
+	old = csr_read(CSR_HGATP);
+	csr_write(CSR_HGATP, old | HGATP_VMID_MASK);
+	vmid_bits = csr_read(CSR_HGATP);
+	vmid_bits = (vmid_bits & HGATP_VMID_MASK) >> HGATP_VMID_SHIFT;
+	vmid_bits = fls_long(vmid_bits);
+	csr_write(CSR_HGATP, old);
+
+	/* We polluted the local TLB, so flush all guest translations */
+	__kvm_riscv_hfence_gvma_all();
+
+	/*
+	 * After a rollover each hart needs a VMID for the VM it is running:
+	 * with fewer VMIDs than that, tag nothing and flush on every
+	 * switch between VMs instead.
+	 */
+	if ((1UL << vmid_bits) < num_possible_cpus() + 1)
+		vmid_bits = 0;
+}
+
+unsigned long kvm_riscv_stage2_vmid_bits(void)
+{
+	return vmid_bits;
+}
+
+int kvm_riscv_stage2_vmid_init(struct kvm *kvm)
+{
+	/* Mark the initial VMID and VMID version invalid */
+	kvm->arch.vmid.vmid_version = 0;
+	kvm->arch.vmid.vmid = 0;
+
+	return 0;
+}
+
+bool kvm_riscv_stage2_vmid_ver_changed(struct kvm_vmid *vmid)
+{
+	if (!vmid_bits)
+		return false;
+
+	return unlikely(READ_ONCE(vmid->vmid_version) !=
+			READ_ONCE(vmid_version));
+}
+
+static void __local_hfence_gvma_all(void *info)
+{
+	__kvm_riscv_hfence_gvma_all();
+}
+
+/*
+ * Called from the run loop with interrupts enabled, as a rollover has to
+ * wait for the other harts to flush.
+ */
+void kvm_riscv_stage2_vmid_update(struct kvm_vcpu *vcpu)
+{
+	int i;
+	struct kvm_vcpu *v;
+	struct kvm_vmid *vmid = &vcpu->kvm->arch.vmid;
+
+	if (!kvm_riscv_stage2_vmid_ver_changed(vmid))
+		return;
+
+	spin_lock(&vmid_lock);
+
+	/*
+	 * We need to re-check the vmid_version here to ensure that if
+	 * another vcpu already allocated a valid vmid for this vm.
+	 */
+	if (!kvm_riscv_stage2_vmid_ver_changed(vmid)) {
+		spin_unlock(&vmid_lock);
+		return;
+	}
+
+	/* First user of a new VMID version? */
+	if (unlikely(vmid_next == 0)) {
+		WRITE_ONCE(vmid_version, READ_ONCE(vmid_version) + 1);
+		vmid_next = 1;
+
+		/*
+		 * Every VMID handed out so far is now stale.  The vcpus that
+		 * aren't running pick up new ones on their next entry; the
+		 * running ones are forced out of the guest by the IPI, and
+		 * find their VMID outdated before they can go back in.
+		 */
+		on_each_cpu(__local_hfence_gvma_all, NULL, 1);
+	}
+
+	vmid->vmid = vmid_next;
+	vmid_next++;
+	vmid_next &= (1UL << vmid_bits) - 1;
+
+	WRITE_ONCE(vmid->vmid_version, READ_ONCE(vmid_version));
+
+	spin_unlock(&vmid_lock);
+
+	/* Request stage2 page table update for all vcpus */
+	kvm_for_each_vcpu(i, v, vcpu->kvm)
+		kvm_make_request(KVM_REQ_UPDATE_HGATP, v);
+}
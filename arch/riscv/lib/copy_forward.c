@@ -0,0 +1,101 @@
+/*
+ * Long forward copies for the LZ4 and zstd decompressors
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/export.h>
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <asm/insn-def.h>
+#include <asm/vector.h>
+
+static DEFINE_STATIC_KEY_FALSE(copy_forward_rvv);
+
+/*
+ * As in page.c, one asm statement per loop, the caller owning the unit.
+ * No strip is longer than @step, so none reads what it is about to write.
+ */
+static void copy_forward_rvv_loop(u8 *dst, const u8 *src, size_t len,
+				  size_t step)
+{
+	unsigned long vl;
+
+	do {
+		asm volatile (
+			RVV_VSETVLI_E8M8("%0", "%1")
+			RVV_VLE8_V("0", "%3")
+			RVV_VSE8_V("0", "%2")
+			: "=&r" (vl)
+			: "r" (min(len, step)), "r" (dst), "r" (src)
+			: "memory");
+		len -= vl;
+		dst += vl;
+		src += vl;
+	} while (len);
+}
+
+/**
+ * copy_forward - copy memory in ascending address order
+ * @dst: where to copy to
+ * @src: where to copy from
+ * @len: number of bytes to copy
+ *
+ * Behaves as a byte-at-a-time loop would: when @dst is less than @len
+ * bytes above @src, the bytes in between are repeated over the rest of
+ * the destination.  The match copies of LZ4 and zstd depend on this, and
+ * make sure the distance is at least 8 before they get here; shorter
+ * distances are correct but slow.
+ */
+void copy_forward(void *dst, const void *src, size_t len)
+{
+	size_t step = len;
+
+	if (!len)
+		return;
+	if (dst > src && dst - src < len)
+		step = dst - src;
+
+	if (static_branch_unlikely(&copy_forward_rvv) && may_use_vector()) {
+		kernel_vector_begin();
+		copy_forward_rvv_loop(dst, src, len, step);
+		kernel_vector_end();
+		return;
+	}
+
+	/* Nothing to repeat: memmove() copes with @dst below @src too */
+	if (step == len) {
+		memmove(dst, src, len);
+		return;
+	}
+
+	/* Each chunk ends where the next one's source begins */
+	while (len > step) {
+		memcpy(dst, src, step);
+		dst += step;
+		src += step;
+		len -= step;
+	}
+	memcpy(dst, src, len);
+}
+EXPORT_SYMBOL(copy_forward);
+
+static int __init copy_forward_init(void)
+{
+	if (has_vector())
+		static_branch_enable(&copy_forward_rvv);
+
+	return 0;
+}
+early_initcall(copy_forward_init);
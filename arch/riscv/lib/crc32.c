@@ -0,0 +1,89 @@
+/*
+ * CRC32 and CRC32C using carry-less multiplication (Zbc)
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/crc32.h>
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+#include <asm/byteorder.h>
+#include <asm/clmul.h>
+#include <asm/hwcap.h>
+
+/*
+ * Each aligned 64-bit word is folded into the CRC with a Barrett
+ * reduction: multiply by floor(x^96 / P) to find the quotient, then by P
+ * to find the remainder.  Everything is bit-reflected, as the CRCs are.
+ * The quotient constants leave out their x^64 term, which is added back
+ * by the xor with s.
+ */
+#define CRC32_POLY_LE		0xedb88320
+#define CRC32C_POLY_LE		0x82f63b78
+#define CRC32_POLY_QT_LE	0x5a72d812fb808b20UL
+#define CRC32C_POLY_QT_LE	0xa434f61c6f5389f8UL
+
+static DEFINE_STATIC_KEY_FALSE(crc32_zbc);
+
+typedef u32 __pure (*crc32_fn)(u32 crc, unsigned char const *p, size_t len);
+
+static inline u32 crc32_le_zbc(u32 crc, unsigned char const *p, size_t len,
+			       u32 poly, unsigned long poly_qt,
+			       crc32_fn fallback)
+{
+	size_t head = -(unsigned long)p & (sizeof(unsigned long) - 1);
+
+	/* Stay on aligned words: misaligned loads may have to be emulated */
+	if (head) {
+		head = min(head, len);
+		crc = fallback(crc, p, head);
+		p += head;
+		len -= head;
+	}
+
+	for (; len >= sizeof(unsigned long); len -= sizeof(unsigned long)) {
+		unsigned long s = crc ^ le64_to_cpup((const __le64 *)p);
+
+		s ^= clmul(s, poly_qt) << 1;
+		crc = clmulr(s, (unsigned long)poly << 32) >> 32;
+		p += sizeof(unsigned long);
+	}
+
+	return len ? fallback(crc, p, len) : crc;
+}
+
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	if (!static_branch_likely(&crc32_zbc))
+		return crc32_le_base(crc, p, len);
+
+	return crc32_le_zbc(crc, p, len, CRC32_POLY_LE, CRC32_POLY_QT_LE,
+			    crc32_le_base);
+}
+
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	if (!static_branch_likely(&crc32_zbc))
+		return __crc32c_le_base(crc, p, len);
+
+	return crc32_le_zbc(crc, p, len, CRC32C_POLY_LE, CRC32C_POLY_QT_LE,
+			    __crc32c_le_base);
+}
+
+static int __init crc32_zbc_init(void)
+{
+	if (riscv_isa_extension_available(RISCV_ISA_EXT_ZBC))
+		static_branch_enable(&crc32_zbc);
+	return 0;
+}
+core_initcall(crc32_zbc_init);
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/compiler.h>
+#include <linux/export.h>
+#include <linux/kernel.h>
+#include <net/checksum.h>
+
+#include <asm/byteorder.h>
+
+/* Fold an end-around-carry sum of longs down to 16 bits */
+static inline unsigned int csum_fold_long(unsigned long sum)
+{
+#ifdef CONFIG_64BIT
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+#endif
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return sum;
+}
+
+/*
+ * Sum the buffer as longs with end-around carry, accumulating the
+ * carries separately so the adds don't form one long dependency chain.
+ *
+ * The buffer is read in aligned words and the bytes outside it masked
+ * off the first and last one.  An aligned word never straddles a page,
+ * so this can't fault where a byte-wise loop wouldn't.  Starting on an
+ * odd address pairs every byte with the wrong neighbour, which a byte
+ * swap of the folded result undoes.
+ */
+unsigned int do_csum(const unsigned char *buff, int len)
+{
+	unsigned long offset, shift, data, sum, carry = 0;
+	const unsigned long *ptr;
+	unsigned int result;
+
+	if (unlikely(len <= 0))
+		return 0;
+
+	offset = (unsigned long)buff & (sizeof(long) - 1);
+	ptr = (const unsigned long *)(buff - offset);
+	len += offset;
+
+	/* Little endian: the bytes before buff are the low ones */
+	shift = offset * BITS_PER_BYTE;
+	data = (*ptr++ >> shift) << shift;
+
+	if (len <= sizeof(long)) {
+		shift = (sizeof(long) - len) * BITS_PER_BYTE;
+		sum = (data << shift) >> shift;
+		goto fold;
+	}
+
+	sum = data;
+	len -= sizeof(long);
+
+	while (len > 4 * sizeof(long)) {
+		unsigned long d0 = ptr[0], d1 = ptr[1];
+		unsigned long d2 = ptr[2], d3 = ptr[3];
+
+		sum += d0;
+		carry += sum < d0;
+		sum += d1;
+		carry += sum < d1;
+		sum += d2;
+		carry += sum < d2;
+		sum += d3;
+		carry += sum < d3;
+
+		ptr += 4;
+		len -= 4 * sizeof(long);
+	}
+
+	while (len > sizeof(long)) {
+		data = *ptr++;
+		sum += data;
+		carry += sum < data;
+		len -= sizeof(long);
+	}
+
+	/* Keep only the first len bytes of the last word */
+	shift = (sizeof(long) - len) * BITS_PER_BYTE;
+	data = (*ptr << shift) >> shift;
+	sum += data;
+	carry += sum < data;
+
+	sum += carry;
+	sum += sum < carry;
+
+fold:
+	result = csum_fold_long(sum);
+	if (offset & 1)
+		result = ((result >> 8) & 0xff) | ((result & 0xff) << 8);
+
+	return result;
+}
+
+__sum16 csum_ipv6_magic(const struct in6_addr *saddr,
+			const struct in6_addr *daddr,
+			__u32 len, __u8 proto, __wsum csum)
+{
+	u64 sum = (__force u32)csum;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		sum += (__force u32)saddr->s6_addr32[i];
+		sum += (__force u32)daddr->s6_addr32[i];
+	}
+	sum += (__force u32)htonl(len);
+	sum += (__force u32)htonl(proto);
+
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	return csum_fold((__force __wsum)(u32)sum);
+}
+EXPORT_SYMBOL(csum_ipv6_magic);
@@ -0,0 +1,133 @@
+/*
+ * Clearing and copying whole pages
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/export.h>
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/of.h>
+#include <asm/hwcap.h>
+#include <asm/insn-def.h>
+#include <asm/page.h>
+#include <asm/vector.h>
+
+void __clear_page(void *page);
+void __clear_page_cbo(void *page, unsigned long block_size);
+void __copy_page(void *to, const void *from);
+
+/*
+ * cbo.zero claims each block in the cache without reading it, so it beats
+ * any stores.  Failing that, a vector loop moves far more per instruction
+ * than the unrolled scalar one, where the vector unit may be used at all:
+ * until the variants are picked, and in hardirqs, that is what runs.
+ */
+static DEFINE_STATIC_KEY_FALSE(clear_page_cbo);
+static DEFINE_STATIC_KEY_FALSE(page_rvv);
+static unsigned long cboz_block_size __ro_after_init;
+
+/* As in xor-rvv.c, one asm statement per loop, the caller owning the unit */
+static void clear_page_rvv(void *page)
+{
+	unsigned long bytes = PAGE_SIZE;
+	unsigned long vl;
+
+	do {
+		asm volatile (
+			RVV_VSETVLI_E8M8("%0", "%1")
+			RVV_VMV_V_I("0", "0")
+			RVV_VSE8_V("0", "%2")
+			: "=&r" (vl)
+			: "r" (bytes), "r" (page)
+			: "memory");
+		bytes -= vl;
+		page += vl;
+	} while (bytes);
+}
+
+static void copy_page_rvv(void *to, const void *from)
+{
+	unsigned long bytes = PAGE_SIZE;
+	unsigned long vl;
+
+	do {
+		asm volatile (
+			RVV_VSETVLI_E8M8("%0", "%1")
+			RVV_VLE8_V("0", "%3")
+			RVV_VSE8_V("0", "%2")
+			: "=&r" (vl)
+			: "r" (bytes), "r" (to), "r" (from)
+			: "memory");
+		bytes -= vl;
+		to += vl;
+		from += vl;
+	} while (bytes);
+}
+
+void clear_page(void *page)
+{
+	if (static_branch_likely(&clear_page_cbo)) {
+		__clear_page_cbo(page, cboz_block_size);
+	} else if (static_branch_unlikely(&page_rvv) && may_use_vector()) {
+		kernel_vector_begin();
+		clear_page_rvv(page);
+		kernel_vector_end();
+	} else {
+		__clear_page(page);
+	}
+}
+EXPORT_SYMBOL(clear_page);
+
+void copy_page(void *to, const void *from)
+{
+	if (static_branch_unlikely(&page_rvv) && may_use_vector()) {
+		kernel_vector_begin();
+		copy_page_rvv(to, from);
+		kernel_vector_end();
+	} else {
+		__copy_page(to, from);
+	}
+}
+EXPORT_SYMBOL(copy_page);
+
+/* The harts all share one block size, which the DT gives per CPU */
+static int __init riscv_page_ops_init(void)
+{
+	struct device_node *node;
+	u32 val;
+
+	if (has_vector())
+		static_branch_enable(&page_rvv);
+
+	if (!riscv_isa_extension_available(RISCV_ISA_EXT_ZICBOZ))
+		return 0;
+
+	node = of_find_node_by_type(NULL, "cpu");
+	if (!node)
+		return 0;
+
+	if (of_property_read_u32(node, "riscv,cboz-block-size", &val) ||
+	    !is_power_of_2(val) || val > PAGE_SIZE) {
+		pr_warn("Zicboz without a valid riscv,cboz-block-size, "
+			"not using cbo.zero\n");
+	} else {
+		cboz_block_size = val;
+		static_branch_enable(&clear_page_cbo);
+	}
+
+	of_node_put(node);
+	return 0;
+}
+early_initcall(riscv_page_ops_init);
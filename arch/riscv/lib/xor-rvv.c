@@ -0,0 +1,133 @@
+/*
+ * RAID-5 XOR using the vector extension
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/export.h>
+#include <linux/module.h>
+#include <asm/insn-def.h>
+
+MODULE_LICENSE("GPL");
+
+/*
+ * Each loop is a single asm statement, as the compiler doesn't know about
+ * the vector registers and must not get a chance to use them in between.
+ * vl is recomputed from the remaining length so the tail needs no
+ * special case.  The caller owns the vector unit.
+ */
+
+void xor_rvv_2(unsigned long bytes, unsigned long *p1, unsigned long *p2)
+{
+	unsigned long vl;
+
+	do {
+		asm volatile (
+			RVV_VSETVLI_E8M1("%0", "%1")
+			RVV_VLE8_V("0", "%2")
+			RVV_VLE8_V("1", "%3")
+			RVV_VXOR_VV("0", "0", "1")
+			RVV_VSE8_V("0", "%2")
+			: "=&r" (vl)
+			: "r" (bytes), "r" (p1), "r" (p2)
+			: "memory");
+		bytes -= vl;
+		p1 = (void *)p1 + vl;
+		p2 = (void *)p2 + vl;
+	} while (bytes);
+}
+EXPORT_SYMBOL(xor_rvv_2);
+
+void xor_rvv_3(unsigned long bytes, unsigned long *p1, unsigned long *p2,
+	       unsigned long *p3)
+{
+	unsigned long vl;
+
+	do {
+		asm volatile (
+			RVV_VSETVLI_E8M1("%0", "%1")
+			RVV_VLE8_V("0", "%2")
+			RVV_VLE8_V("1", "%3")
+			RVV_VLE8_V("2", "%4")
+			RVV_VXOR_VV("0", "0", "1")
+			RVV_VXOR_VV("0", "0", "2")
+			RVV_VSE8_V("0", "%2")
+			: "=&r" (vl)
+			: "r" (bytes), "r" (p1), "r" (p2), "r" (p3)
+			: "memory");
+		bytes -= vl;
+		p1 = (void *)p1 + vl;
+		p2 = (void *)p2 + vl;
+		p3 = (void *)p3 + vl;
+	} while (bytes);
+}
+EXPORT_SYMBOL(xor_rvv_3);
+
+void xor_rvv_4(unsigned long bytes, unsigned long *p1, unsigned long *p2,
+	       unsigned long *p3, unsigned long *p4)
+{
+	unsigned long vl;
+
+	do {
+		asm volatile (
+			RVV_VSETVLI_E8M1("%0", "%1")
+			RVV_VLE8_V("0", "%2")
+			RVV_VLE8_V("1", "%3")
+			RVV_VLE8_V("2", "%4")
+			RVV_VLE8_V("3", "%5")
+			RVV_VXOR_VV("0", "0", "1")
+			RVV_VXOR_VV("2", "2", "3")
+			RVV_VXOR_VV("0", "0", "2")
+			RVV_VSE8_V("0", "%2")
+			: "=&r" (vl)
+			: "r" (bytes), "r" (p1), "r" (p2), "r" (p3), "r" (p4)
+			: "memory");
+		bytes -= vl;
+		p1 = (void *)p1 + vl;
+		p2 = (void *)p2 + vl;
+		p3 = (void *)p3 + vl;
+		p4 = (void *)p4 + vl;
+	} while (bytes);
+}
+EXPORT_SYMBOL(xor_rvv_4);
+
+void xor_rvv_5(unsigned long bytes, unsigned long *p1, unsigned long *p2,
+	       unsigned long *p3, unsigned long *p4, unsigned long *p5)
+{
+	unsigned long vl;
+
+	do {
+		asm volatile (
+			RVV_VSETVLI_E8M1("%0", "%1")
+			RVV_VLE8_V("0", "%2")
+			RVV_VLE8_V("1", "%3")
+			RVV_VLE8_V("2", "%4")
+			RVV_VLE8_V("3", "%5")
+			RVV_VLE8_V("4", "%6")
+			RVV_VXOR_VV("0", "0", "1")
+			RVV_VXOR_VV("2", "2", "3")
+			RVV_VXOR_VV("0", "0", "4")
+			RVV_VXOR_VV("0", "0", "2")
+			RVV_VSE8_V("0", "%2")
+			: "=&r" (vl)
+			: "r" (bytes), "r" (p1), "r" (p2), "r" (p3), "r" (p4),
+			  "r" (p5)
+			: "memory");
+		bytes -= vl;
+		p1 = (void *)p1 + vl;
+		p2 = (void *)p2 + vl;
+		p3 = (void *)p3 + vl;
+		p4 = (void *)p4 + vl;
+		p5 = (void *)p5 + vl;
+	} while (bytes);
+}
+EXPORT_SYMBOL(xor_rvv_5);
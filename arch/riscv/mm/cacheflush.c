@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/mm.h>
+#include <linux/sched.h>
+
+#include <asm/cacheflush.h>
+#include <asm/sbi.h>
+#include <asm/smp.h>
+
+void flush_icache_all(void)
+{
+	sbi_remote_fence_i(NULL);
+}
+
+/*
+ * There is no instruction cache shootdown in RISC-V, so the harts to
+ * flush have to be asked by the firmware.  Only those running mm right
+ * now are: every other hart is marked in icache_stale_mask and fences
+ * itself when it next switches to mm, so a process with one thread on
+ * a many-hart machine doesn't stop the whole system.  With local set
+ * the caller only cares about its own thread, and the harts running
+ * mm's other threads are left to catch up on their next switch too.
+ */
+void flush_icache_mm(struct mm_struct *mm, bool local)
+{
+	cpumask_t others, *mask;
+	unsigned int cpu;
+
+	preempt_disable();
+
+	mask = &mm->context.icache_stale_mask;
+	cpumask_setall(mask);
+
+	cpu = smp_processor_id();
+	cpumask_clear_cpu(cpu, mask);
+	local_flush_icache_all();
+
+	/* Only our own thread's view is "local", not a ptraced mm's */
+	local &= (mm == current->active_mm);
+
+	cpumask_andnot(&others, mm_cpumask(mm), cpumask_of(cpu));
+	if (!local && !cpumask_empty(&others)) {
+		sbi_remote_fence_i(&others);
+	} else {
+		/*
+		 * The stores above have to be visible before another hart
+		 * switches to mm and tests its bit.  The SBI call orders
+		 * them when there is one; pairs with flush_icache_deferred().
+		 */
+		smp_mb();
+	}
+
+	preempt_enable();
+}
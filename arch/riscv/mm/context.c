@@ -0,0 +1,236 @@
+/*
+ * ASID allocator
+ * Based on arch/arm64/mm/context.c
+ *
+ * Copyright (C) 2002-2003 Deep Blue Solutions Ltd, all rights reserved.
+ * Copyright (C) 2012 ARM Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/bitops.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include <asm/csr.h>
+#include <asm/mmu_context.h>
+#include <asm/tlbflush.h>
+
+/*
+ * The context ID of an mm is split in two: the low asid_bits hold the
+ * hardware ASID and the remaining upper bits hold the generation it was
+ * allocated in.  A generation bump (rollover) invalidates every ASID at
+ * once; each hart then flushes its local TLB the next time it switches.
+ */
+static unsigned long asid_bits;
+static unsigned long num_asids;
+static unsigned long asid_mask;
+
+bool riscv_use_asid __read_mostly;
+
+static DEFINE_RAW_SPINLOCK(cpu_asid_lock);
+
+static atomic_long_t asid_generation;
+static unsigned long *asid_map;
+
+static DEFINE_PER_CPU(atomic_long_t, active_asids);
+static DEFINE_PER_CPU(unsigned long, reserved_asids);
+static cpumask_t tlb_flush_pending;
+
+#define ASID_FIRST_VERSION	num_asids
+
+static void flush_context(void)
+{
+	int i;
+	unsigned long asid;
+
+	/* Update the list of reserved ASIDs and the ASID bitmap. */
+	bitmap_clear(asid_map, 0, num_asids);
+
+	/*
+	 * Ensure the generation bump is observed before we xchg the
+	 * active_asids.
+	 */
+	smp_wmb();
+
+	for_each_possible_cpu(i) {
+		asid = atomic_long_xchg_relaxed(&per_cpu(active_asids, i), 0);
+		/*
+		 * If this CPU has already been through a rollover, but
+		 * hasn't run another task in the meantime, we must preserve
+		 * its reserved ASID, as this is the only trace we have of
+		 * the process it is still running.
+		 */
+		if (asid == 0)
+			asid = per_cpu(reserved_asids, i);
+		__set_bit(asid & asid_mask, asid_map);
+		per_cpu(reserved_asids, i) = asid;
+	}
+
+	/* Queue a TLB invalidation on every hart. */
+	cpumask_setall(&tlb_flush_pending);
+}
+
+static bool check_update_reserved_asid(unsigned long asid,
+				       unsigned long newasid)
+{
+	int cpu;
+	bool hit = false;
+
+	/*
+	 * Iterate over the set of reserved ASIDs looking for a match.  We
+	 * can't exit the loop early, since every copy of the old ASID must
+	 * be updated to reflect the mm, or we could miss the reserved ASID
+	 * in a future generation.
+	 */
+	for_each_possible_cpu(cpu) {
+		if (per_cpu(reserved_asids, cpu) == asid) {
+			hit = true;
+			per_cpu(reserved_asids, cpu) = newasid;
+		}
+	}
+
+	return hit;
+}
+
+static unsigned long new_context(struct mm_struct *mm)
+{
+	static unsigned long cur_idx = 1;
+	unsigned long asid = atomic_long_read(&mm->context.id);
+	unsigned long generation = atomic_long_read(&asid_generation);
+
+	if (asid != 0) {
+		unsigned long newasid = generation | (asid & asid_mask);
+
+		/*
+		 * If our current ASID was active during a rollover, we can
+		 * continue to use it and this was just a false alarm.
+		 */
+		if (check_update_reserved_asid(asid, newasid))
+			return newasid;
+
+		/*
+		 * We had a valid ASID in a previous life, so try to re-use
+		 * it if possible.
+		 */
+		if (!__test_and_set_bit(asid & asid_mask, asid_map))
+			return newasid;
+	}
+
+	/*
+	 * Allocate a free ASID.  If we can't find one, take a note of the
+	 * currently active ASIDs and mark the TLBs as requiring flushes.
+	 * ASID #0 is never handed out: it is what init_mm and any hart
+	 * running without an allocated context use.
+	 */
+	asid = find_next_zero_bit(asid_map, num_asids, cur_idx);
+	if (asid != num_asids)
+		goto set_asid;
+
+	/* We're out of ASIDs, so increment the global generation count */
+	generation = atomic_long_add_return_relaxed(ASID_FIRST_VERSION,
+						    &asid_generation);
+	flush_context();
+
+	/* We have more ASIDs than CPUs, so this will always succeed */
+	asid = find_next_zero_bit(asid_map, num_asids, 1);
+
+set_asid:
+	__set_bit(asid, asid_map);
+	cur_idx = asid;
+	return asid | generation;
+}
+
+void check_and_switch_context(struct mm_struct *mm, unsigned int cpu)
+{
+	unsigned long flags;
+	unsigned long asid;
+
+	if (!riscv_use_asid) {
+		set_pgdir(mm->pgd, 0);
+		local_flush_tlb_all();
+		return;
+	}
+
+	asid = atomic_long_read(&mm->context.id);
+
+	/*
+	 * The memory ordering here is subtle.  We rely on the control
+	 * dependency between the generation read and the update of
+	 * active_asids to ensure that we are synchronised with a parallel
+	 * rollover (i.e. this pairs with the smp_wmb() in flush_context).
+	 */
+	if (!((asid ^ atomic_long_read(&asid_generation)) >> asid_bits) &&
+	    atomic_long_xchg_relaxed(&per_cpu(active_asids, cpu), asid))
+		goto switch_mm_fastpath;
+
+	raw_spin_lock_irqsave(&cpu_asid_lock, flags);
+	/* Check that our ASID belongs to the current generation. */
+	asid = atomic_long_read(&mm->context.id);
+	if ((asid ^ atomic_long_read(&asid_generation)) >> asid_bits) {
+		asid = new_context(mm);
+		atomic_long_set(&mm->context.id, asid);
+	}
+
+	if (cpumask_test_and_clear_cpu(cpu, &tlb_flush_pending))
+		local_flush_tlb_all();
+
+	atomic_long_set(&per_cpu(active_asids, cpu), asid);
+	raw_spin_unlock_irqrestore(&cpu_asid_lock, flags);
+
+switch_mm_fastpath:
+	set_pgdir(mm->pgd, asid & asid_mask);
+}
+
+/* Probe the number of ASID bits implemented by writing all ones to sptbr */
+static unsigned long __init get_cpu_asid_bits(void)
+{
+	unsigned long old, bits;
+
+	old = csr_read(sptbr);
+	csr_write(sptbr, old | (SPTBR_ASID_MASK << SPTBR_ASID_SHIFT));
+	bits = (csr_read(sptbr) >> SPTBR_ASID_SHIFT) & SPTBR_ASID_MASK;
+	csr_write(sptbr, old);
+	local_flush_tlb_all();
+
+	return fls_long(bits);
+}
+
+static int __init asids_init(void)
+{
+	asid_bits = get_cpu_asid_bits();
+	num_asids = 1UL << asid_bits;
+	asid_mask = num_asids - 1;
+
+	/*
+	 * Allocation after rollover would fail if we didn't have at least
+	 * one more ASID than CPUs (ASID #0 is reserved).  Rather than risk
+	 * that, fall back to flushing the local TLB on every switch.
+	 */
+	if (num_asids <= num_possible_cpus() + 1) {
+		pr_info("ASID allocator disabled (%lu ASIDs)\n", num_asids);
+		return 0;
+	}
+
+	atomic_long_set(&asid_generation, ASID_FIRST_VERSION);
+	asid_map = kzalloc(BITS_TO_LONGS(num_asids) * sizeof(*asid_map),
+			   GFP_KERNEL);
+	if (!asid_map)
+		panic("Failed to allocate bitmap for %lu ASIDs\n", num_asids);
+
+	riscv_use_asid = true;
+	pr_info("ASID allocator initialised with %lu entries\n", num_asids);
+	return 0;
+}
+early_initcall(asids_init);
@@ -0,0 +1,318 @@
+/*
+ * DMA mapping ops for devices behind an IOMMU
+ * Based on arch/arm64/mm/dma-mapping.c
+ *
+ * Copyright (C) 2012 ARM Ltd.
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/dma-iommu.h>
+#include <linux/dma-mapping.h>
+#include <linux/gfp.h>
+#include <linux/iommu.h>
+#include <linux/mm.h>
+#include <linux/scatterlist.h>
+#include <linux/vmalloc.h>
+
+#include <asm/dma-noncoherent.h>
+
+static pgprot_t dma_iommu_pgprot(struct device *dev, pgprot_t prot,
+				 unsigned long attrs)
+{
+	if (dev_is_noncoherent(dev) || (attrs & DMA_ATTR_WRITE_COMBINE))
+		return pgprot_writecombine(prot);
+	return prot;
+}
+
+static void flush_page(struct device *dev, const void *virt, phys_addr_t phys)
+{
+	riscv_dma_prep_coherent(phys, PAGE_SIZE);
+}
+
+/*
+ * Non-atomic allocations are built from scattered pages, which the IOMMU
+ * makes contiguous for the device and vmap() for us.  In atomic context
+ * nothing can be remapped, so only a coherent master can be given a
+ * physically contiguous buffer straight from the linear map.
+ */
+static void *dma_iommu_alloc(struct device *dev, size_t size,
+			     dma_addr_t *handle, gfp_t gfp,
+			     unsigned long attrs)
+{
+	bool coherent = !dev_is_noncoherent(dev);
+	int ioprot = dma_info_to_prot(DMA_BIDIRECTIONAL, coherent, attrs);
+	size_t iosize = size;
+	struct page **pages;
+	void *addr;
+
+	size = PAGE_ALIGN(size);
+	gfp |= __GFP_ZERO;
+
+	if (!gfpflags_allow_blocking(gfp)) {
+		struct page *page;
+
+		if (!coherent)
+			return NULL;
+
+		page = alloc_pages(gfp, get_order(size));
+		if (!page)
+			return NULL;
+
+		*handle = iommu_dma_map_page(dev, page, 0, iosize, ioprot);
+		if (iommu_dma_mapping_error(dev, *handle)) {
+			__free_pages(page, get_order(size));
+			return NULL;
+		}
+		return page_address(page);
+	}
+
+	pages = iommu_dma_alloc(dev, iosize, gfp, attrs, ioprot, handle,
+				flush_page);
+	if (!pages)
+		return NULL;
+
+	addr = dma_common_pages_remap(pages, size, VM_USERMAP,
+				      dma_iommu_pgprot(dev, PAGE_KERNEL, attrs),
+				      __builtin_return_address(0));
+	if (!addr)
+		iommu_dma_free(dev, pages, iosize, handle);
+	return addr;
+}
+
+static void dma_iommu_free(struct device *dev, size_t size, void *cpu_addr,
+			   dma_addr_t handle, unsigned long attrs)
+{
+	size_t iosize = size;
+
+	size = PAGE_ALIGN(size);
+	if (is_vmalloc_addr(cpu_addr)) {
+		struct vm_struct *area = find_vm_area(cpu_addr);
+
+		if (WARN_ON(!area || !area->pages))
+			return;
+		iommu_dma_free(dev, area->pages, iosize, &handle);
+		dma_common_free_remap(cpu_addr, size, VM_USERMAP);
+	} else {
+		iommu_dma_unmap_page(dev, handle, iosize, 0, 0);
+		__free_pages(virt_to_page(cpu_addr), get_order(size));
+	}
+}
+
+static int dma_iommu_mmap(struct device *dev, struct vm_area_struct *vma,
+			  void *cpu_addr, dma_addr_t dma_addr, size_t size,
+			  unsigned long attrs)
+{
+	struct vm_struct *area;
+	int ret;
+
+	vma->vm_page_prot = dma_iommu_pgprot(dev, vma->vm_page_prot, attrs);
+
+	if (dma_mmap_from_dev_coherent(dev, vma, cpu_addr, size, &ret))
+		return ret;
+
+	if (!is_vmalloc_addr(cpu_addr))
+		return dma_common_mmap(dev, vma, cpu_addr, dma_addr, size);
+
+	area = find_vm_area(cpu_addr);
+	if (WARN_ON(!area || !area->pages))
+		return -ENXIO;
+
+	return iommu_dma_mmap(area->pages, size, vma);
+}
+
+static int dma_iommu_get_sgtable(struct device *dev, struct sg_table *sgt,
+				 void *cpu_addr, dma_addr_t dma_addr,
+				 size_t size, unsigned long attrs)
+{
+	unsigned int count = PAGE_ALIGN(size) >> PAGE_SHIFT;
+	struct vm_struct *area;
+
+	if (!is_vmalloc_addr(cpu_addr))
+		return dma_common_get_sgtable(dev, sgt, cpu_addr, dma_addr,
+					      size);
+
+	area = find_vm_area(cpu_addr);
+	if (WARN_ON(!area || !area->pages))
+		return -ENXIO;
+
+	return sg_alloc_table_from_pages(sgt, area->pages, count, 0, size,
+					 GFP_KERNEL);
+}
+
+static void dma_iommu_sync_single_for_cpu(struct device *dev,
+					  dma_addr_t dev_addr, size_t size,
+					  enum dma_data_direction dir)
+{
+	phys_addr_t phys;
+
+	if (!dev_is_noncoherent(dev))
+		return;
+
+	phys = iommu_iova_to_phys(iommu_get_domain_for_dev(dev), dev_addr);
+	riscv_dma_sync_for_cpu(phys, size, dir);
+}
+
+static void dma_iommu_sync_single_for_device(struct device *dev,
+					     dma_addr_t dev_addr, size_t size,
+					     enum dma_data_direction dir)
+{
+	phys_addr_t phys;
+
+	if (!dev_is_noncoherent(dev))
+		return;
+
+	phys = iommu_iova_to_phys(iommu_get_domain_for_dev(dev), dev_addr);
+	riscv_dma_sync_for_device(phys, size, dir);
+}
+
+static void dma_iommu_sync_sg_for_cpu(struct device *dev,
+				      struct scatterlist *sgl, int nelems,
+				      enum dma_data_direction dir)
+{
+	struct scatterlist *sg;
+	int i;
+
+	if (!dev_is_noncoherent(dev))
+		return;
+
+	for_each_sg(sgl, sg, nelems, i)
+		riscv_dma_sync_for_cpu(sg_phys(sg), sg->length, dir);
+}
+
+static void dma_iommu_sync_sg_for_device(struct device *dev,
+					 struct scatterlist *sgl, int nelems,
+					 enum dma_data_direction dir)
+{
+	struct scatterlist *sg;
+	int i;
+
+	if (!dev_is_noncoherent(dev))
+		return;
+
+	for_each_sg(sgl, sg, nelems, i)
+		riscv_dma_sync_for_device(sg_phys(sg), sg->length, dir);
+}
+
+static dma_addr_t dma_iommu_map_page(struct device *dev, struct page *page,
+				     unsigned long offset, size_t size,
+				     enum dma_data_direction dir,
+				     unsigned long attrs)
+{
+	bool coherent = !dev_is_noncoherent(dev);
+	int prot = dma_info_to_prot(dir, coherent, attrs);
+	dma_addr_t dev_addr = iommu_dma_map_page(dev, page, offset, size, prot);
+
+	if (!coherent && !iommu_dma_mapping_error(dev, dev_addr) &&
+	    (attrs & DMA_ATTR_SKIP_CPU_SYNC) == 0)
+		riscv_dma_sync_for_device(page_to_phys(page) + offset, size,
+					  dir);
+
+	return dev_addr;
+}
+
+static void dma_iommu_unmap_page(struct device *dev, dma_addr_t dev_addr,
+				 size_t size, enum dma_data_direction dir,
+				 unsigned long attrs)
+{
+	if ((attrs & DMA_ATTR_SKIP_CPU_SYNC) == 0)
+		dma_iommu_sync_single_for_cpu(dev, dev_addr, size, dir);
+
+	iommu_dma_unmap_page(dev, dev_addr, size, dir, attrs);
+}
+
+/*
+ * dma-iommu.c allocates one IOVA range for the whole list, so however
+ * scattered the pages are, the device sees a single contiguous buffer
+ * wherever the segment boundaries allow it.
+ */
+static int dma_iommu_map_sg(struct device *dev, struct scatterlist *sgl,
+			    int nelems, enum dma_data_direction dir,
+			    unsigned long attrs)
+{
+	bool coherent = !dev_is_noncoherent(dev);
+
+	if ((attrs & DMA_ATTR_SKIP_CPU_SYNC) == 0)
+		dma_iommu_sync_sg_for_device(dev, sgl, nelems, dir);
+
+	return iommu_dma_map_sg(dev, sgl, nelems,
+				dma_info_to_prot(dir, coherent, attrs));
+}
+
+static void dma_iommu_unmap_sg(struct device *dev, struct scatterlist *sgl,
+			       int nelems, enum dma_data_direction dir,
+			       unsigned long attrs)
+{
+	if ((attrs & DMA_ATTR_SKIP_CPU_SYNC) == 0)
+		dma_iommu_sync_sg_for_cpu(dev, sgl, nelems, dir);
+
+	iommu_dma_unmap_sg(dev, sgl, nelems, dir, attrs);
+}
+
+static const struct dma_map_ops riscv_iommu_dma_ops = {
+	.alloc			= dma_iommu_alloc,
+	.free			= dma_iommu_free,
+	.mmap			= dma_iommu_mmap,
+	.get_sgtable		= dma_iommu_get_sgtable,
+	.map_page		= dma_iommu_map_page,
+	.unmap_page		= dma_iommu_unmap_page,
+	.map_sg			= dma_iommu_map_sg,
+	.unmap_sg		= dma_iommu_unmap_sg,
+	.sync_single_for_cpu	= dma_iommu_sync_single_for_cpu,
+	.sync_single_for_device	= dma_iommu_sync_single_for_device,
+	.sync_sg_for_cpu	= dma_iommu_sync_sg_for_cpu,
+	.sync_sg_for_device	= dma_iommu_sync_sg_for_device,
+	.map_resource		= iommu_dma_map_resource,
+	.unmap_resource		= iommu_dma_unmap_resource,
+	.mapping_error		= iommu_dma_mapping_error,
+};
+
+static int __init riscv_iommu_dma_init(void)
+{
+	return iommu_dma_init();
+}
+arch_initcall(riscv_iommu_dma_init);
+
+/*
+ * By the time of_dma_configure() gets here the IOMMU driver has added the
+ * device, so its group and default domain already exist.  Only DMA
+ * domains need our ops: an identity domain keeps the direct ones.
+ */
+void riscv_iommu_setup_dma_ops(struct device *dev, u64 dma_base, u64 size,
+			       const struct iommu_ops *iommu)
+{
+	struct iommu_domain *domain;
+
+	if (!iommu)
+		return;
+
+	domain = iommu_get_domain_for_dev(dev);
+	if (!domain)
+		goto out_err;
+
+	if (domain->type == IOMMU_DOMAIN_DMA) {
+		if (iommu_dma_init_domain(domain, dma_base, size, dev))
+			goto out_err;
+
+		dev->dma_ops = &riscv_iommu_dma_ops;
+	}
+
+	return;
+
+out_err:
+	pr_warn("Failed to set up IOMMU for device %s; retaining platform DMA ops\n",
+		dev_name(dev));
+}
+
+void arch_teardown_dma_ops(struct device *dev)
+{
+	dev->dma_ops = NULL;
+}
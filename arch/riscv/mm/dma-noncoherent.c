@@ -0,0 +1,141 @@
+/*
+ * Cache maintenance for DMA masters that don't snoop the caches
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/of.h>
+
+#include <asm/dma-noncoherent.h>
+#include <asm/hwcap.h>
+
+/* The cbo.* instructions, for assemblers that don't know Zicbom */
+#define CBO_INSN(op, addr)						\
+	__asm__ __volatile__ (".insn i 0x0f, 0x2, x0, %0, " #op		\
+			      : : "r" (addr) : "memory")
+#define CBO_INVAL(addr)	CBO_INSN(0, addr)
+#define CBO_CLEAN(addr)	CBO_INSN(1, addr)
+#define CBO_FLUSH(addr)	CBO_INSN(2, addr)
+
+static unsigned int cbom_block_size __ro_after_init;
+static const struct riscv_cache_ops *cache_ops __ro_after_init;
+
+/*
+ * Zicbom works on virtual addresses: all memory that can be handed to a
+ * device is in the linear map, so go through that.
+ */
+#define ZICBOM_OP(name, insn)						\
+static void zicbom_##name(phys_addr_t paddr, size_t size)		\
+{									\
+	unsigned long addr = (unsigned long)phys_to_virt(paddr);	\
+	unsigned long end = addr + size;				\
+									\
+	for (addr &= ~(cbom_block_size - 1UL); addr < end;		\
+	     addr += cbom_block_size)					\
+		insn(addr);						\
+}
+
+ZICBOM_OP(wback, CBO_CLEAN)
+ZICBOM_OP(inv, CBO_INVAL)
+ZICBOM_OP(wback_inv, CBO_FLUSH)
+
+static const struct riscv_cache_ops zicbom_cache_ops = {
+	.wback		= zicbom_wback,
+	.inv		= zicbom_inv,
+	.wback_inv	= zicbom_wback_inv,
+};
+
+void riscv_noncoherent_register_cache_ops(const struct riscv_cache_ops *ops)
+{
+	cache_ops = ops;
+}
+
+bool riscv_noncoherent_supported(void)
+{
+	return cache_ops != NULL;
+}
+
+/*
+ * Clean the lines the device will read, and the ones it will write to
+ * as well: a dirty line evicted while the DMA is in flight would
+ * otherwise land on top of the data.
+ */
+void riscv_dma_sync_for_device(phys_addr_t paddr, size_t size,
+			       enum dma_data_direction dir)
+{
+	switch (dir) {
+	case DMA_TO_DEVICE:
+	case DMA_FROM_DEVICE:
+		cache_ops->wback(paddr, size);
+		break;
+	case DMA_BIDIRECTIONAL:
+		cache_ops->wback_inv(paddr, size);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Drop whatever was speculatively fetched while the device was writing */
+void riscv_dma_sync_for_cpu(phys_addr_t paddr, size_t size,
+			    enum dma_data_direction dir)
+{
+	switch (dir) {
+	case DMA_FROM_DEVICE:
+	case DMA_BIDIRECTIONAL:
+		cache_ops->inv(paddr, size);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Before a buffer is mapped uncached, push out its cacheable alias */
+void riscv_dma_prep_coherent(phys_addr_t paddr, size_t size)
+{
+	cache_ops->wback_inv(paddr, size);
+}
+
+/*
+ * The harts all share one block size, which the DT gives per CPU.  A
+ * vendor driver registering its own ops would normally do it from an
+ * earlier initcall, and wins.
+ */
+static int __init riscv_dma_noncoherent_init(void)
+{
+	struct device_node *node;
+	u32 val;
+
+	if (cache_ops || !riscv_isa_extension_available(RISCV_ISA_EXT_ZICBOM))
+		return 0;
+
+	node = of_find_node_by_type(NULL, "cpu");
+	if (!node)
+		return 0;
+
+	if (of_property_read_u32(node, "riscv,cbom-block-size", &val) ||
+	    !is_power_of_2(val)) {
+		pr_warn("Zicbom without a valid riscv,cbom-block-size, "
+			"treating all DMA as coherent\n");
+	} else {
+		cbom_block_size = val;
+		cache_ops = &zicbom_cache_ops;
+	}
+
+	of_node_put(node);
+	return 0;
+}
+core_initcall(riscv_dma_noncoherent_init);
@@ -17,16 +17,170 @@
  * to the Free Software Foundation, Inc.,
  */
 
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
 #include <linux/gfp.h>
 #include <linux/mm.h>
 #include <linux/dma-mapping.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/swiotlb.h>
+#include <linux/vmalloc.h>
+
+#include <asm/dma-noncoherent.h>
+#include <asm/hwcap.h>
+
+#ifdef CONFIG_SWIOTLB
+/*
+ * Streaming mappings of memory the device can't reach are bounced through
+ * the swiotlb pool.  That pool is allocated as low as memory goes, and is
+ * sized with the generic "swiotlb=<slabs>" parameter.
+ */
+static atomic_long_t dma_bounced_maps;
+static atomic_long_t dma_bounced_bytes;
+static atomic_long_t dma_failed_maps;
+
+static void dma_riscv_count(struct device *dev, phys_addr_t phys,
+			    dma_addr_t dev_addr, size_t size)
+{
+	if (swiotlb_dma_mapping_error(dev, dev_addr)) {
+		atomic_long_inc(&dma_failed_maps);
+	} else if (dma_to_phys(dev, dev_addr) != phys) {
+		atomic_long_inc(&dma_bounced_maps);
+		atomic_long_add(size, &dma_bounced_bytes);
+	}
+}
+
+static dma_addr_t __dma_map_page(struct device *dev, struct page *page,
+				 unsigned long offset, size_t size,
+				 enum dma_data_direction dir,
+				 unsigned long attrs)
+{
+	dma_addr_t dev_addr;
+
+	dev_addr = swiotlb_map_page(dev, page, offset, size, dir, attrs);
+	dma_riscv_count(dev, page_to_phys(page) + offset, dev_addr, size);
+	return dev_addr;
+}
+
+static int __dma_map_sg(struct device *dev, struct scatterlist *sgl,
+			int nents, enum dma_data_direction dir,
+			unsigned long attrs)
+{
+	struct scatterlist *sg;
+	int i, ret;
+
+	ret = swiotlb_map_sg_attrs(dev, sgl, nents, dir, attrs);
+	if (!ret) {
+		atomic_long_inc(&dma_failed_maps);
+		return ret;
+	}
+
+	for_each_sg(sgl, sg, ret, i)
+		dma_riscv_count(dev, sg_phys(sg), sg->dma_address, sg->length);
+	return ret;
+}
+
+#define __dma_alloc(dev, size, handle, gfp, attrs)			\
+	swiotlb_alloc_coherent(dev, size, handle, gfp)
+#define __dma_free(dev, size, vaddr, handle, attrs)			\
+	swiotlb_free_coherent(dev, size, vaddr, handle)
+#define __dma_unmap_page		swiotlb_unmap_page
+#define __dma_unmap_sg			swiotlb_unmap_sg_attrs
+#define __dma_sync_single_for_cpu	swiotlb_sync_single_for_cpu
+#define __dma_sync_single_for_device	swiotlb_sync_single_for_device
+#define __dma_sync_sg_for_cpu		swiotlb_sync_sg_for_cpu
+#define __dma_sync_sg_for_device	swiotlb_sync_sg_for_device
+#define __dma_mapping_error		swiotlb_dma_mapping_error
+
+static int swiotlb_stats_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "pool_bytes:\t%lu\n", swiotlb_nr_tbl() << IO_TLB_SHIFT);
+	seq_printf(m, "bounced_maps:\t%ld\n",
+		   atomic_long_read(&dma_bounced_maps));
+	seq_printf(m, "bounced_bytes:\t%ld\n",
+		   atomic_long_read(&dma_bounced_bytes));
+	seq_printf(m, "failed_maps:\t%ld\n",
+		   atomic_long_read(&dma_failed_maps));
+	return 0;
+}
+
+static int swiotlb_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, swiotlb_stats_show, NULL);
+}
+
+static const struct file_operations swiotlb_stats_fops = {
+	.open		= swiotlb_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init swiotlb_stats_init(void)
+{
+	debugfs_create_file("swiotlb_stats", S_IRUSR, NULL, NULL,
+			    &swiotlb_stats_fops);
+	return 0;
+}
+late_initcall(swiotlb_stats_init);
+#else /* !CONFIG_SWIOTLB */
+// Without a bounce pool every page is handed to the device as it is
+static dma_addr_t __dma_map_page(struct device *dev, struct page *page,
+				 unsigned long offset, size_t size,
+				 enum dma_data_direction dir,
+				 unsigned long attrs)
+{
+	return phys_to_dma(dev, page_to_phys(page) + offset);
+}
+
+static int __dma_map_sg(struct device *dev, struct scatterlist *sgl,
+			int nents, enum dma_data_direction dir,
+			unsigned long attrs)
+{
+	struct scatterlist *sg;
+	int i;
+
+	for_each_sg(sgl, sg, nents, i) {
+		sg->dma_address = phys_to_dma(dev, sg_phys(sg));
+		sg_dma_len(sg) = sg->length;
+	}
+	return nents;
+}
+
+#define __dma_alloc		dma_noop_ops.alloc
+#define __dma_free		dma_noop_ops.free
+#define __dma_unmap_page(dev, addr, size, dir, attrs)		do { } while (0)
+#define __dma_unmap_sg(dev, sgl, nents, dir, attrs)		do { } while (0)
+#define __dma_sync_single_for_cpu(dev, addr, size, dir)		do { } while (0)
+#define __dma_sync_single_for_device(dev, addr, size, dir)	do { } while (0)
+#define __dma_sync_sg_for_cpu(dev, sgl, nents, dir)		do { } while (0)
+#define __dma_sync_sg_for_device(dev, sgl, nents, dir)		do { } while (0)
+#define __dma_mapping_error(dev, addr)				0
+#endif /* CONFIG_SWIOTLB */
+
+/*
+ * Masters that don't snoop the caches get explicit cache maintenance around
+ * each transfer, on the buffer the device actually sees: after swiotlb has
+ * filled a bounce buffer, and before it copies one back.  The flag is only
+ * ever set when the platform has a way to do that maintenance.
+ *
+ * Devices behind an IOMMU are switched over to the ops in dma-iommu.c.
+ */
+void arch_setup_dma_ops(struct device *dev, u64 dma_base, u64 size,
+			const struct iommu_ops *iommu, bool coherent)
+{
+	dev->archdata.dma_noncoherent = !coherent &&
+					riscv_noncoherent_supported();
+	riscv_iommu_setup_dma_ops(dev, dma_base, size, iommu);
+}
 
 static void *dma_riscv_alloc(struct device *dev, size_t size,
                             dma_addr_t *dma_handle, gfp_t gfp,
                             unsigned long attrs)
 {
 	dma_addr_t end_of_normal = (max_low_pfn << PAGE_SHIFT) - 1;
+	void *cpu_addr, *remapped;
 
 	// If the device cannot address ZONE_NORMAL, allocate from ZONE_DMA
 	gfp &= ~(__GFP_DMA | __GFP_DMA32 | __GFP_HIGHMEM);
@@ -37,14 +191,82 @@ static void *dma_riscv_alloc(struct device *dev, size_t size,
 		gfp |= GFP_DMA;
 	}
 
-	return dma_noop_ops.alloc(dev, size, dma_handle, gfp, attrs);
+	// A non-coherent master needs an uncached alias, which takes Svpbmt
+	// and a vmap() that may sleep
+	if (dev_is_noncoherent(dev)) {
+		if (!riscv_isa_extension_available(RISCV_ISA_EXT_SVPBMT)) {
+			dev_warn_once(dev, "no uncached mappings for coherent DMA\n");
+			return NULL;
+		}
+		if (!gfpflags_allow_blocking(gfp))
+			return NULL;
+	}
+
+	// With swiotlb, falls back to the bounce pool if ZONE_DMA is still
+	// out of reach
+	cpu_addr = __dma_alloc(dev, size, dma_handle, gfp, attrs);
+	if (!cpu_addr || !dev_is_noncoherent(dev))
+		return cpu_addr;
+
+	riscv_dma_prep_coherent(dma_to_phys(dev, *dma_handle), size);
+	remapped = dma_common_contiguous_remap(virt_to_page(cpu_addr),
+					       PAGE_ALIGN(size), VM_USERMAP,
+					       pgprot_writecombine(PAGE_KERNEL),
+					       __builtin_return_address(0));
+	if (!remapped)
+		__dma_free(dev, size, cpu_addr, *dma_handle, attrs);
+	return remapped;
 }
 
 static void dma_riscv_free(struct device *dev, size_t size,
                           void *cpu_addr, dma_addr_t dma_addr,
                           unsigned long attrs)
 {
-	return dma_noop_ops.free(dev, size, cpu_addr, dma_addr, attrs);
+	if (dev_is_noncoherent(dev)) {
+		dma_common_free_remap(cpu_addr, PAGE_ALIGN(size), VM_USERMAP);
+		cpu_addr = phys_to_virt(dma_to_phys(dev, dma_addr));
+	}
+
+	__dma_free(dev, size, cpu_addr, dma_addr, attrs);
+}
+
+// The generic helpers find the pages through cpu_addr, which is a vmalloc
+// address for non-coherent masters
+static int dma_riscv_mmap(struct device *dev, struct vm_area_struct *vma,
+			  void *cpu_addr, dma_addr_t dma_addr, size_t size,
+			  unsigned long attrs)
+{
+	unsigned long nr_pages = PAGE_ALIGN(size) >> PAGE_SHIFT;
+	unsigned long pfn = PHYS_PFN(dma_to_phys(dev, dma_addr));
+	unsigned long off = vma->vm_pgoff;
+
+	if (!dev_is_noncoherent(dev))
+		return dma_common_mmap(dev, vma, cpu_addr, dma_addr, size);
+
+	if (off >= nr_pages || vma_pages(vma) > nr_pages - off)
+		return -ENXIO;
+
+	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	return remap_pfn_range(vma, vma->vm_start, pfn + off,
+			       vma->vm_end - vma->vm_start,
+			       vma->vm_page_prot);
+}
+
+static int dma_riscv_get_sgtable(struct device *dev, struct sg_table *sgt,
+				 void *cpu_addr, dma_addr_t dma_addr,
+				 size_t size, unsigned long attrs)
+{
+	struct page *page = pfn_to_page(PHYS_PFN(dma_to_phys(dev, dma_addr)));
+	int ret;
+
+	if (!dev_is_noncoherent(dev))
+		return dma_common_get_sgtable(dev, sgt, cpu_addr, dma_addr,
+					      size);
+
+	ret = sg_alloc_table(sgt, 1, GFP_KERNEL);
+	if (!ret)
+		sg_set_page(sgt->sgl, page, PAGE_ALIGN(size), 0);
+	return ret;
 }
 
 static dma_addr_t dma_riscv_map_page(struct device *dev, struct page *page,
@@ -52,18 +274,111 @@ static dma_addr_t dma_riscv_map_page(struct device *dev, struct page *page,
                                       enum dma_data_direction dir,
                                       unsigned long attrs)
 {
-	return dma_noop_ops.map_page(dev, page, offset, size, dir, attrs);
+	dma_addr_t dev_addr = __dma_map_page(dev, page, offset, size, dir,
+					     attrs);
+
+	if (dev_is_noncoherent(dev) && !(attrs & DMA_ATTR_SKIP_CPU_SYNC) &&
+	    !__dma_mapping_error(dev, dev_addr))
+		riscv_dma_sync_for_device(dma_to_phys(dev, dev_addr), size, dir);
+	return dev_addr;
+}
+
+static void dma_riscv_unmap_page(struct device *dev, dma_addr_t dev_addr,
+				 size_t size, enum dma_data_direction dir,
+				 unsigned long attrs)
+{
+	if (dev_is_noncoherent(dev) && !(attrs & DMA_ATTR_SKIP_CPU_SYNC))
+		riscv_dma_sync_for_cpu(dma_to_phys(dev, dev_addr), size, dir);
+	__dma_unmap_page(dev, dev_addr, size, dir, attrs);
 }
 
 static int dma_riscv_map_sg(struct device *dev, struct scatterlist *sgl, int nents,
                              enum dma_data_direction dir,
                              unsigned long attrs)
 {
-	return dma_noop_ops.map_sg(dev, sgl, nents, dir, attrs);
+	struct scatterlist *sg;
+	int i, ret;
+
+	ret = __dma_map_sg(dev, sgl, nents, dir, attrs);
+	if (dev_is_noncoherent(dev) && !(attrs & DMA_ATTR_SKIP_CPU_SYNC))
+		for_each_sg(sgl, sg, ret, i)
+			riscv_dma_sync_for_device(dma_to_phys(dev, sg->dma_address),
+						  sg_dma_len(sg), dir);
+	return ret;
+}
+
+static void dma_riscv_unmap_sg(struct device *dev, struct scatterlist *sgl,
+			       int nents, enum dma_data_direction dir,
+			       unsigned long attrs)
+{
+	struct scatterlist *sg;
+	int i;
+
+	if (dev_is_noncoherent(dev) && !(attrs & DMA_ATTR_SKIP_CPU_SYNC))
+		for_each_sg(sgl, sg, nents, i)
+			riscv_dma_sync_for_cpu(dma_to_phys(dev, sg->dma_address),
+					       sg_dma_len(sg), dir);
+	__dma_unmap_sg(dev, sgl, nents, dir, attrs);
+}
+
+static void dma_riscv_sync_single_for_cpu(struct device *dev,
+					  dma_addr_t dev_addr, size_t size,
+					  enum dma_data_direction dir)
+{
+	if (dev_is_noncoherent(dev))
+		riscv_dma_sync_for_cpu(dma_to_phys(dev, dev_addr), size, dir);
+	__dma_sync_single_for_cpu(dev, dev_addr, size, dir);
+}
+
+static void dma_riscv_sync_single_for_device(struct device *dev,
+					     dma_addr_t dev_addr, size_t size,
+					     enum dma_data_direction dir)
+{
+	__dma_sync_single_for_device(dev, dev_addr, size, dir);
+	if (dev_is_noncoherent(dev))
+		riscv_dma_sync_for_device(dma_to_phys(dev, dev_addr), size, dir);
+}
+
+static void dma_riscv_sync_sg_for_cpu(struct device *dev,
+				      struct scatterlist *sgl, int nents,
+				      enum dma_data_direction dir)
+{
+	struct scatterlist *sg;
+	int i;
+
+	if (dev_is_noncoherent(dev))
+		for_each_sg(sgl, sg, nents, i)
+			riscv_dma_sync_for_cpu(dma_to_phys(dev, sg->dma_address),
+					       sg_dma_len(sg), dir);
+	__dma_sync_sg_for_cpu(dev, sgl, nents, dir);
+}
+
+static void dma_riscv_sync_sg_for_device(struct device *dev,
+					 struct scatterlist *sgl, int nents,
+					 enum dma_data_direction dir)
+{
+	struct scatterlist *sg;
+	int i;
+
+	__dma_sync_sg_for_device(dev, sgl, nents, dir);
+	if (dev_is_noncoherent(dev))
+		for_each_sg(sgl, sg, nents, i)
+			riscv_dma_sync_for_device(dma_to_phys(dev, sg->dma_address),
+						  sg_dma_len(sg), dir);
+}
+
+static int dma_riscv_mapping_error(struct device *dev, dma_addr_t dma_addr)
+{
+	return __dma_mapping_error(dev, dma_addr);
 }
 
 static int dma_riscv_supported(struct device *dev, u64 mask)
 {
+#ifdef CONFIG_SWIOTLB
+	// Anything that reaches the bounce pool can be served through it
+	if (swiotlb_nr_tbl())
+		return swiotlb_dma_supported(dev, mask);
+#endif
 	// Our smallest allocation pool (ZONE_DMA) uses 32 physical address bits
 	// (it is common on RISC-V for physical memory to start at the 2GiB mark)
 	return mask >= DMA_BIT_MASK(32);
@@ -72,8 +387,17 @@ static int dma_riscv_supported(struct device *dev, u64 mask)
 const struct dma_map_ops dma_riscv_ops = {
 	.alloc			= dma_riscv_alloc,
 	.free			= dma_riscv_free,
+	.mmap			= dma_riscv_mmap,
+	.get_sgtable		= dma_riscv_get_sgtable,
 	.map_page		= dma_riscv_map_page,
+	.unmap_page		= dma_riscv_unmap_page,
 	.map_sg			= dma_riscv_map_sg,
+	.unmap_sg		= dma_riscv_unmap_sg,
+	.sync_single_for_cpu	= dma_riscv_sync_single_for_cpu,
+	.sync_single_for_device	= dma_riscv_sync_single_for_device,
+	.sync_sg_for_cpu	= dma_riscv_sync_sg_for_cpu,
+	.sync_sg_for_device	= dma_riscv_sync_sg_for_device,
+	.mapping_error		= dma_riscv_mapping_error,
 	.dma_supported		= dma_riscv_supported,
 };
 
@@ -23,14 +23,138 @@
 #include <linux/mm.h>
 #include <linux/kernel.h>
 #include <linux/interrupt.h>
+#include <linux/kprobes.h>
 #include <linux/perf_event.h>
 #include <linux/signal.h>
 #include <linux/uaccess.h>
 
+#include <asm/hwcap.h>
 #include <asm/pgalloc.h>
 #include <asm/ptrace.h>
 #include <asm/uaccess.h>
 
+#define CREATE_TRACE_POINTS
+#include <asm/trace/exceptions.h>
+
+#ifdef CONFIG_KPROBES
+static inline int notify_page_fault(struct pt_regs *regs, unsigned int cause)
+{
+	int ret = 0;
+
+	/* kprobe_running() needs smp_processor_id() */
+	if (!user_mode(regs)) {
+		preempt_disable();
+		if (kprobe_running() && kprobe_fault_handler(regs, cause))
+			ret = 1;
+		preempt_enable();
+	}
+
+	return ret;
+}
+#else
+static inline int notify_page_fault(struct pt_regs *regs, unsigned int cause)
+{
+	return 0;
+}
+#endif
+
+/*
+ * The vmemmap and hotplugged memory can need a new top-level entry in the
+ * kernel page tables after a task's own copy of them was made, see
+ * pgd_alloc(): pick it up from init_mm.  Only an empty entry is ever
+ * filled in, so a fault below a present one still goes to no_context.
+ */
+static bool sync_kernel_top_level(unsigned long addr)
+{
+	unsigned int index = pgd_index(addr);
+	pgd_t *pgd = (pgd_t *)pfn_to_virt(csr_read(sptbr) & SPTBR_PPN) + index;
+	pgd_t *pgd_k = init_mm.pgd + index;
+	pud_t *pud = pud_offset(p4d_offset(pgd, addr), addr);
+	pud_t *pud_k = pud_offset(p4d_offset(pgd_k, addr), addr);
+
+#ifdef __PAGETABLE_PMD_FOLDED
+	pmd_t *pmd = pmd_offset(pud, addr);
+	pmd_t *pmd_k = pmd_offset(pud_k, addr);
+
+	if (pmd_present(*pmd) || !pmd_present(*pmd_k))
+		return false;
+	set_pmd(pmd, *pmd_k);
+#else
+	if (pud_present(*pud) || !pud_present(*pud_k))
+		return false;
+	set_pud(pud, *pud_k);
+#endif
+	local_flush_tlb_page(addr);
+	return true;
+}
+
+/*
+ * Harts without Svadu leave the accessed and dirty bits to software: they
+ * trap on an access to a PTE without A, or a store to one without D,
+ * even though it allows the access.  Setting the bit is all the core mm
+ * would do for that, so do it here, before find_vma() and the rest of
+ * handle_mm_fault().  mmap_sem keeps the page tables from going away and
+ * the PTE lock orders us against changes to the entry.
+ */
+static bool handle_ad_fault(struct mm_struct *mm, unsigned long addr,
+			    unsigned long cause, bool user)
+{
+	unsigned long need, set;
+	pgd_t *pgd;
+	p4d_t *p4d;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *ptep, pte;
+	spinlock_t *ptl;
+	bool done = false;
+
+	switch (cause) {
+	case EXC_INST_PAGE_FAULT:
+		need = _PAGE_EXEC;
+		set = _PAGE_ACCESSED;
+		break;
+	case EXC_LOAD_PAGE_FAULT:
+		need = _PAGE_READ;
+		set = _PAGE_ACCESSED;
+		break;
+	case EXC_STORE_PAGE_FAULT:
+		need = _PAGE_WRITE;
+		set = _PAGE_ACCESSED | _PAGE_DIRTY;
+		break;
+	default:
+		return false;
+	}
+	need |= _PAGE_PRESENT | (user ? _PAGE_USER : 0);
+
+	/* Kernel mappings are made with both bits already set */
+	if (addr >= TASK_SIZE)
+		return false;
+
+	pgd = pgd_offset(mm, addr);
+	p4d = p4d_offset(pgd, addr);
+	if (p4d_none(*p4d))
+		return false;
+	pud = pud_offset(p4d, addr);
+	/* Huge mappings take the long way */
+	if (pud_none(*pud) || (pud_val(*pud) & _PAGE_LEAF))
+		return false;
+	pmd = pmd_offset(pud, addr);
+	if (pmd_none(*pmd) || (pmd_val(*pmd) & _PAGE_LEAF))
+		return false;
+
+	ptep = pte_offset_map_lock(mm, pmd, addr, &ptl);
+	pte = *ptep;
+	if ((pte_val(pte) & need) == need && (pte_val(pte) & set) != set) {
+		/* Only the bits change, so nothing else needs to know */
+		set_pte(ptep, __pte(pte_val(pte) | set));
+		local_flush_tlb_page(addr);
+		done = true;
+	}
+	pte_unmap_unlock(ptep, ptl);
+
+	return done;
+}
+
 /*
  * This routine handles page faults.  It determines the address and the
  * problem, and then passes it off to one of the appropriate routines.
@@ -47,6 +171,14 @@ asmlinkage void do_page_fault(struct pt_regs *regs)
 	cause = regs->scause;
 	addr = regs->sbadaddr;
 
+	if (notify_page_fault(regs, cause))
+		return;
+
+	if (user_mode(regs))
+		trace_page_fault_user(addr, regs, cause);
+	else
+		trace_page_fault_kernel(addr, regs, cause);
+
 	tsk = current;
 	mm = tsk->mm;
 
@@ -61,6 +193,9 @@ asmlinkage void do_page_fault(struct pt_regs *regs)
 	 */
 	if (unlikely((addr >= VMALLOC_START) && (addr <= VMALLOC_END)))
 		goto vmalloc_fault;
+	if (unlikely(addr >= TASK_SIZE && !user_mode(regs) &&
+		     sync_kernel_top_level(addr)))
+		return;
 
 	/* Enable interrupts if they were enabled in the parent context. */
 	if (likely(regs->sstatus & SR_PIE))
@@ -78,8 +213,39 @@ asmlinkage void do_page_fault(struct pt_regs *regs)
 
 	perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS, 1, regs, addr);
 
+	/*
+	 * Try to handle the fault without mmap_sem first.  Anything that
+	 * path cannot complete, errors included, is reported back as
+	 * VM_FAULT_RETRY and handled below as if it never happened.
+	 */
+	fault = handle_speculative_fault(mm, addr, flags |
+			(cause == EXC_STORE_PAGE_FAULT ? FAULT_FLAG_WRITE : 0) |
+			(cause == EXC_INST_PAGE_FAULT ?
+			 FAULT_FLAG_INSTRUCTION : 0));
+	if (!(fault & VM_FAULT_RETRY)) {
+		if (fault & VM_FAULT_MAJOR) {
+			tsk->maj_flt++;
+			perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MAJ,
+				      1, regs, addr);
+		} else {
+			tsk->min_flt++;
+			perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MIN,
+				      1, regs, addr);
+		}
+		return;
+	}
+
 retry:
 	down_read(&mm->mmap_sem);
+	if ((flags & FAULT_FLAG_ALLOW_RETRY) &&
+	    !riscv_isa_extension_available(RISCV_ISA_EXT_SVADU) &&
+	    handle_ad_fault(mm, addr, cause, user_mode(regs))) {
+		up_read(&mm->mmap_sem);
+		tsk->min_flt++;
+		perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MIN, 1, regs, addr);
+		return;
+	}
+
 	vma = find_vma(mm, addr);
 	if (unlikely(!vma))
 		goto bad_area;
@@ -241,7 +407,7 @@ asmlinkage void do_page_fault(struct pt_regs *regs)
 		 * of a task switch.
 		 */
 		index = pgd_index(addr);
-		pgd = (pgd_t *)pfn_to_virt(csr_read(sptbr)) + index;
+		pgd = (pgd_t *)pfn_to_virt(csr_read(sptbr) & SPTBR_PPN) + index;
 		pgd_k = init_mm.pgd + index;
 
 		if (!pgd_present(*pgd_k))
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/hugetlb.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+
+/*
+ * The page table walkers come from the generic code
+ * (ARCH_WANT_GENERAL_HUGETLB); all that's needed here is telling leaves
+ * apart from pointers to the next level.
+ */
+int pmd_huge(pmd_t pmd)
+{
+	return pte_huge(pmd_pte(pmd));
+}
+
+int pud_huge(pud_t pud)
+{
+	return pte_huge(__pte(pud_val(pud)));
+}
+
+static __init int setup_hugepagesz(char *opt)
+{
+	unsigned long ps = memparse(opt, &opt);
+
+	switch (ps) {
+	case PMD_SIZE:
+		hugetlb_add_hstate(PMD_SHIFT - PAGE_SHIFT);
+		return 1;
+#ifdef CONFIG_64BIT
+	case PUD_SIZE:
+		hugetlb_add_hstate(PUD_SHIFT - PAGE_SHIFT);
+		return 1;
+#endif
+	}
+
+	hugetlb_bad_size();
+	pr_err("hugepagesz: Unsupported page size %lu M\n", ps >> 20);
+	return 0;
+}
+__setup("hugepagesz=", setup_hugepagesz);
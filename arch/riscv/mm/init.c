@@ -16,12 +16,17 @@
 #include <linux/bootmem.h>
 #include <linux/initrd.h>
 #include <linux/memblock.h>
+#include <linux/memory_hotplug.h>
 #include <linux/swap.h>
+#include <linux/swiotlb.h>
 
+#include <asm/fixmap.h>
 #include <asm/tlbflush.h>
 #include <asm/sections.h>
 #include <asm/pgtable.h>
 #include <asm/io.h>
+#include <asm/numa.h>
+#include <asm/pgalloc.h>
 
 // Memory below the 4GiB threshold is special/precious.
 // We use this memory for devices which cannot DMA to all of ZONE_NORMAL.
@@ -47,22 +52,377 @@ void setup_zero_page(void)
 	memset((void *)empty_zero_page, 0, PAGE_SIZE);
 }
 
+/* The permission and type bits of a leaf, for re-creating it one level down */
+#define LEAF_PROT(val)	__pgprot((val) & ~_PAGE_PFN_MASK)
+
+static inline bool pmd_is_leaf(pmd_t pmd)
+{
+	return pmd_present(pmd) && (pmd_val(pmd) & _PAGE_LEAF);
+}
+
+#ifndef __PAGETABLE_PMD_FOLDED
+static inline bool pud_is_leaf(pud_t pud)
+{
+	return pud_present(pud) && (pud_val(pud) & _PAGE_LEAF);
+}
+#endif
+
+static void alloc_init_pte(pmd_t *pmdp, unsigned long addr,
+			   unsigned long end, phys_addr_t phys, pgprot_t prot,
+			   phys_addr_t (*pgtable_alloc)(void))
+{
+	pte_t *ptep;
+
+	if (pmd_none(*pmdp) || pmd_is_leaf(*pmdp)) {
+		phys_addr_t pte_phys;
+		unsigned long i;
+
+		BUG_ON(!pgtable_alloc);
+		pte_phys = pgtable_alloc();
+		ptep = __va(pte_phys);
+
+		/*
+		 * Breaking up a leaf: keep the rest of it mapped exactly
+		 * as it was, so that code running from it never notices.
+		 */
+		if (pmd_present(*pmdp)) {
+			unsigned long pfn = __page_val_to_pfn(pmd_val(*pmdp));
+			pgprot_t old = LEAF_PROT(pmd_val(*pmdp));
+
+			for (i = 0; i < PTRS_PER_PTE; i++)
+				ptep[i] = pfn_pte(pfn + i, old);
+		}
+
+		set_pmd(pmdp, pfn_pmd(PFN_DOWN(pte_phys),
+				      __pgprot(_PAGE_TABLE)));
+	}
+
+	ptep = pte_offset_kernel(pmdp, addr);
+	do {
+		set_pte(ptep, pfn_pte(PFN_DOWN(phys), prot));
+		phys += PAGE_SIZE;
+	} while (ptep++, addr += PAGE_SIZE, addr != end);
+}
+
+static void alloc_init_pmd(pud_t *pudp, unsigned long addr,
+			   unsigned long end, phys_addr_t phys, pgprot_t prot,
+			   phys_addr_t (*pgtable_alloc)(void))
+{
+	unsigned long next;
+	pmd_t *pmdp;
+
+#ifndef __PAGETABLE_PMD_FOLDED
+	/* A gigapage needs both addresses aligned to the whole entry */
+	if (((addr | end | phys) & ~PUD_MASK) == 0) {
+		set_pud(pudp, __pud((PFN_DOWN(phys) << _PAGE_PFN_SHIFT) |
+				    pgprot_val(prot)));
+		return;
+	}
+
+	if (pud_none(*pudp) || pud_is_leaf(*pudp)) {
+		phys_addr_t pmd_phys;
+		unsigned long i;
+
+		BUG_ON(!pgtable_alloc);
+		pmd_phys = pgtable_alloc();
+		pmdp = __va(pmd_phys);
+
+		if (pud_present(*pudp)) {
+			unsigned long pfn = __page_val_to_pfn(pud_val(*pudp));
+			pgprot_t old = LEAF_PROT(pud_val(*pudp));
+
+			for (i = 0; i < PTRS_PER_PMD; i++)
+				pmdp[i] = pfn_pmd(pfn + i * PTRS_PER_PTE, old);
+		}
+
+		set_pud(pudp, __pud((PFN_DOWN(pmd_phys) << _PAGE_PFN_SHIFT) |
+				    _PAGE_TABLE));
+	}
+#endif
+
+	pmdp = pmd_offset(pudp, addr);
+	do {
+		next = pmd_addr_end(addr, end);
+
+		if (((addr | next | phys) & ~PMD_MASK) == 0)
+			set_pmd(pmdp, pfn_pmd(PFN_DOWN(phys), prot));
+		else
+			alloc_init_pte(pmdp, addr, next, phys, prot,
+				       pgtable_alloc);
+
+		phys += next - addr;
+	} while (pmdp++, addr = next, addr != end);
+}
+
+/* A PGD entry spans many PUD entries on Sv48, and just the one otherwise */
+static void alloc_init_pud(p4d_t *p4dp, unsigned long addr,
+			   unsigned long end, phys_addr_t phys, pgprot_t prot,
+			   phys_addr_t (*pgtable_alloc)(void))
+{
+	unsigned long next;
+	pud_t *pudp;
+
+	pudp = pud_offset(p4dp, addr);
+	do {
+		next = pud_addr_end(addr, end);
+		alloc_init_pmd(pudp, addr, next, phys, prot, pgtable_alloc);
+		phys += next - addr;
+	} while (pudp++, addr = next, addr != end);
+}
+
+/*
+ * Map [virt, virt + size) to phys in the kernel page tables, using the
+ * largest leaf entries that the alignment of both addresses allows.
+ * Leaves already covering part of the range are split with their
+ * existing permissions preserved.  A NULL pgtable_alloc means the range
+ * must already be mapped at the right granularity.
+ */
+static void create_pgd_mapping(phys_addr_t phys, unsigned long virt,
+			       phys_addr_t size, pgprot_t prot,
+			       phys_addr_t (*pgtable_alloc)(void))
+{
+	unsigned long addr, next, end;
+	pgd_t *pgdp;
+
+	addr = virt & PAGE_MASK;
+	end = PAGE_ALIGN(virt + size);
+	phys &= PAGE_MASK;
+
+	pgdp = pgd_offset_k(addr);
+	do {
+		next = pgd_addr_end(addr, end);
+		alloc_init_pud(p4d_offset(pgdp, addr), addr, next, phys, prot,
+			       pgtable_alloc);
+		phys += next - addr;
+	} while (pgdp++, addr = next, addr != end);
+}
+
+static phys_addr_t __init early_pgtable_alloc(void)
+{
+	/* memblock_alloc_base() panics rather than failing */
+	phys_addr_t phys = memblock_alloc_base(PAGE_SIZE, PAGE_SIZE,
+					       PFN_PHYS(max_low_pfn));
+
+	clear_page(__va(phys));
+	return phys;
+}
+
+static void __init map_range(phys_addr_t start, phys_addr_t end,
+			     pgprot_t prot)
+{
+	if (start < end)
+		create_pgd_mapping(start, (unsigned long)__va(start),
+				   end - start, prot, early_pgtable_alloc);
+}
+
+static void __init map_kernel_segment(void *start, void *end, pgprot_t prot)
+{
+	map_range(__pa(start), __pa(end), prot);
+}
+
+/*
+ * setup_vm() maps everything with RWX megapages so that head.S has
+ * something to run on.  Rebuild the linear map from memblock so that it
+ * uses gigapages wherever possible and, with STRICT_KERNEL_RWX, so that
+ * only the kernel text is executable.  Each kernel segment gets leaves of
+ * its own, so mark_rodata_ro() can later change its permissions without
+ * having to allocate page tables.
+ */
+static void __init map_lowmem(void)
+{
+	phys_addr_t lowmem_start = PFN_PHYS(pfn_base);
+	phys_addr_t lowmem_end = PFN_PHYS(max_low_pfn);
+	phys_addr_t kernel_start = __pa(__init_begin);
+	phys_addr_t kernel_end = __pa(__end_rodata);
+	struct memblock_region *reg;
+
+	for_each_memblock(memory, reg) {
+		phys_addr_t start = max(reg->base, lowmem_start);
+		phys_addr_t end = min(reg->base + reg->size, lowmem_end);
+
+		if (!IS_ENABLED(CONFIG_STRICT_KERNEL_RWX)) {
+			map_range(start, end, PAGE_KERNEL_EXEC);
+			continue;
+		}
+
+		map_range(start, min(end, kernel_start), PAGE_KERNEL);
+		map_range(max(start, kernel_end), end, PAGE_KERNEL);
+	}
+
+	if (IS_ENABLED(CONFIG_STRICT_KERNEL_RWX)) {
+		/* Rodata stays writable until mark_rodata_ro() */
+		map_kernel_segment(__init_begin, __init_end, PAGE_KERNEL_EXEC);
+		map_kernel_segment(_stext, _etext, PAGE_KERNEL_EXEC);
+		map_kernel_segment(_etext, __end_rodata, PAGE_KERNEL);
+	}
+}
+
+#ifdef CONFIG_STRICT_KERNEL_RWX
+static void update_mapping_prot(void *start, void *end, pgprot_t prot)
+{
+	create_pgd_mapping(__pa(start), (unsigned long)start,
+			   (unsigned long)end - (unsigned long)start, prot, NULL);
+	flush_tlb_kernel_range((unsigned long)start, (unsigned long)end);
+}
+
+void mark_rodata_ro(void)
+{
+	update_mapping_prot(_stext, _etext, PAGE_KERNEL_READ_EXEC);
+	update_mapping_prot(_etext, __end_rodata, PAGE_KERNEL_READ);
+}
+#endif
+
+extern pte_t fixmap_pte[PTRS_PER_PTE];
+
+void __set_fixmap(enum fixed_addresses idx, phys_addr_t phys, pgprot_t prot)
+{
+	unsigned long addr = __fix_to_virt(idx);
+	pte_t *ptep;
+
+	BUG_ON(idx <= FIX_HOLE || idx >= __end_of_fixed_addresses);
+
+	ptep = &fixmap_pte[pte_index(addr)];
+	if (pgprot_val(prot))
+		set_pte(ptep, pfn_pte(PFN_DOWN(phys), prot));
+	else
+		pte_clear(&init_mm, addr, ptep);
+	local_flush_tlb_page(addr);
+}
+
+/*
+ * Each mm copies the kernel's top-level entries when its pgd is made, and
+ * would only pick up ones added later by taking a vmalloc fault.  Fill
+ * them all in for vmalloc space now, so the tables below are shared and
+ * vmalloc, ioremap and module mappings show up everywhere at once.  That
+ * is one page of PMDs per PUD_SIZE, 64 of them with the default layout;
+ * on Sv48 the PUD page they hang off is shared already, and the 32-bit
+ * layout would need pages of PTEs instead, and keeps faulting them in.
+ */
+static void __init preallocate_vmalloc_pgds(void)
+{
+#ifndef __PAGETABLE_PMD_FOLDED
+	unsigned long addr;
+
+	for (addr = VMALLOC_START; addr < VMALLOC_END; addr += PUD_SIZE) {
+		pud_t *pud = pud_offset(p4d_offset(pgd_offset_k(addr), addr),
+					addr);
+
+		if (pud_none(*pud))
+			set_pud(pud, __pud((PFN_DOWN(early_pgtable_alloc()) <<
+					    _PAGE_PFN_SHIFT) | _PAGE_TABLE));
+	}
+#endif
+}
+
 void __init paging_init(void)
 {
-	init_mm.pgd = (pgd_t *)pfn_to_virt(csr_read(sptbr));
+	init_mm.pgd = (pgd_t *)pfn_to_virt(csr_read(sptbr) & SPTBR_PPN);
 
 	setup_zero_page();
+	map_lowmem();
+	preallocate_vmalloc_pgds();
 	local_flush_tlb_all();
+}
+
+#ifdef CONFIG_SPARSEMEM
+static void __init riscv_memory_present(void)
+{
+	struct memblock_region *reg;
+
+	for_each_memblock(memory, reg)
+		memory_present(memblock_get_region_node(reg),
+			       memblock_region_memory_base_pfn(reg),
+			       memblock_region_memory_end_pfn(reg));
+}
+#else
+static inline void riscv_memory_present(void) { }
+#endif
+
+/*
+ * The NUMA layout comes from the DT, so this runs once it has been
+ * unflattened: the zones are then laid out node by node.
+ */
+void __init bootmem_init(void)
+{
+	riscv_numa_init();
+	riscv_memory_present();
+	sparse_init();
 	zone_sizes_init();
 }
 
+#ifdef CONFIG_SPARSEMEM_VMEMMAP
+/*
+ * Back the vmemmap with megapages where we can get them, falling back
+ * to pages when memory is short.
+ */
+int __meminit vmemmap_populate(unsigned long start, unsigned long end,
+			       int node)
+{
+	unsigned long addr, next;
+	pgd_t *pgdp;
+	p4d_t *p4dp;
+	pud_t *pudp;
+	pmd_t *pmdp;
+
+	for (addr = start; addr < end; addr = next) {
+		next = pmd_addr_end(addr, end);
+
+		pgdp = vmemmap_pgd_populate(addr, node);
+		if (!pgdp)
+			return -ENOMEM;
+		p4dp = vmemmap_p4d_populate(pgdp, addr, node);
+		if (!p4dp)
+			return -ENOMEM;
+		pudp = vmemmap_pud_populate(p4dp, addr, node);
+		if (!pudp)
+			return -ENOMEM;
+
+		pmdp = pmd_offset(pudp, addr);
+		if (pmd_none(*pmdp)) {
+			void *p = vmemmap_alloc_block_buf(PMD_SIZE, node);
+
+			if (p) {
+				set_pmd(pmdp, pfn_pmd(PFN_DOWN(__pa(p)),
+						      PAGE_KERNEL));
+				continue;
+			}
+		} else if (pmd_is_leaf(*pmdp)) {
+			vmemmap_verify((pte_t *)pmdp, node, addr, next);
+			continue;
+		}
+
+		if (vmemmap_populate_basepages(addr, next, node))
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+void vmemmap_free(unsigned long start, unsigned long end)
+{
+}
+#endif /* CONFIG_SPARSEMEM_VMEMMAP */
+
 void __init mem_init(void)
 {
 #ifdef CONFIG_FLATMEM
 	BUG_ON(!mem_map);
 #endif /* CONFIG_FLATMEM */
+#ifdef CONFIG_SPARSEMEM_VMEMMAP
+	BUILD_BUG_ON(sizeof(struct page) > (1 << STRUCT_PAGE_MAX_SHIFT));
+#endif
 
 	high_memory = (void *)(__va(PFN_PHYS(max_low_pfn)));
+
+#ifdef CONFIG_SWIOTLB
+	/* Only set aside a bounce pool if some memory is out of 32-bit reach */
+	if (swiotlb_force == SWIOTLB_FORCE ||
+	    max_pfn > PFN_DOWN(MAX_DMA_PHYSICAL))
+		swiotlb_init(1);
+	else
+		swiotlb_force = SWIOTLB_NO_FORCE;
+#endif
+
 	free_all_bootmem();
 
 	mem_init_print_info(NULL);
@@ -70,6 +430,9 @@ void __init mem_init(void)
 
 void free_initmem(void)
 {
+#ifdef CONFIG_STRICT_KERNEL_RWX
+	update_mapping_prot(__init_begin, __init_end, PAGE_KERNEL);
+#endif
 	free_initmem_default(0);
 }
 
@@ -78,3 +441,105 @@ void free_initrd_mem(unsigned long start, unsigned long end)
 {
 }
 #endif /* CONFIG_BLK_DEV_INITRD */
+
+#ifdef CONFIG_MEMORY_HOTPLUG
+/*
+ * Take [start, end) out of the linear map.  Hotplugged memory is mapped
+ * with leaves that never cross a section, so whole ones are cleared;
+ * the page tables are kept for when memory is added back.
+ */
+static void unmap_range(phys_addr_t start, phys_addr_t end)
+{
+	unsigned long addr = (unsigned long)__va(start);
+	unsigned long va_end = (unsigned long)__va(end);
+	unsigned long next;
+
+	for (; addr < va_end; addr = next) {
+		pgd_t *pgdp = pgd_offset_k(addr);
+		pud_t *pudp = pud_offset(p4d_offset(pgdp, addr), addr);
+		pmd_t *pmdp;
+		pte_t *ptep;
+
+		next = pmd_addr_end(addr, va_end);
+#ifndef __PAGETABLE_PMD_FOLDED
+		if (pud_none(*pudp)) {
+			next = pud_addr_end(addr, va_end);
+			continue;
+		}
+#endif
+		pmdp = pmd_offset(pudp, addr);
+		if (pmd_none(*pmdp))
+			continue;
+		if (pmd_is_leaf(*pmdp)) {
+			pmd_clear(pmdp);
+			continue;
+		}
+
+		ptep = pte_offset_kernel(pmdp, addr);
+		for (; addr < next; addr += PAGE_SIZE, ptep++)
+			pte_clear(&init_mm, addr, ptep);
+	}
+
+	flush_tlb_kernel_range((unsigned long)__va(start), va_end);
+}
+
+/* The buddy allocator is up by now: it can't fail at this size */
+static phys_addr_t hotplug_pgtable_alloc(void)
+{
+	return __pa(__get_free_page(GFP_KERNEL | __GFP_ZERO | __GFP_NOFAIL));
+}
+
+int arch_add_memory(int nid, u64 start, u64 size, bool want_memblock)
+{
+	unsigned long start_pfn = PFN_DOWN(start);
+	unsigned long nr_pages = size >> PAGE_SHIFT;
+	u64 addr;
+	int ret;
+
+	/* The memory has to be reachable through the linear map */
+	if (start_pfn < pfn_base ||
+	    start + size - PFN_PHYS(pfn_base) > KERN_VIRT_SIZE)
+		return -ERANGE;
+
+	/*
+	 * Map it one section at a time: that never makes gigapages, so
+	 * that any section can later be removed on its own.
+	 */
+	for (addr = start; addr < start + size; addr += PA_SECTION_SIZE)
+		create_pgd_mapping(addr, (unsigned long)__va(addr),
+				   min_t(u64, PA_SECTION_SIZE,
+					 start + size - addr),
+				   PAGE_KERNEL, hotplug_pgtable_alloc);
+
+	ret = __add_pages(nid, start_pfn, nr_pages, want_memblock);
+	if (ret) {
+		unmap_range(start, start + size);
+		return ret;
+	}
+
+	if (start_pfn + nr_pages > max_pfn) {
+		max_pfn = max_low_pfn = start_pfn + nr_pages;
+		high_memory = __va(PFN_PHYS(max_low_pfn));
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_MEMORY_HOTREMOVE
+int arch_remove_memory(u64 start, u64 size)
+{
+	unsigned long start_pfn = PFN_DOWN(start);
+	unsigned long nr_pages = size >> PAGE_SHIFT;
+	struct zone *zone = page_zone(pfn_to_page(start_pfn));
+	int ret;
+
+	ret = __remove_pages(zone, start_pfn, nr_pages);
+	if (ret)
+		return ret;
+
+	/* Nothing may reach the memory once it has been returned */
+	unmap_range(start, start + size);
+	return 0;
+}
+#endif /* CONFIG_MEMORY_HOTREMOVE */
+#endif /* CONFIG_MEMORY_HOTPLUG */
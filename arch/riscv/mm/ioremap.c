@@ -73,11 +73,30 @@ static void __iomem *__ioremap_caller(phys_addr_t addr, size_t size,
  */
 void __iomem *ioremap(phys_addr_t offset, unsigned long size)
 {
-	return __ioremap_caller(offset, size, PAGE_KERNEL,
+	return __ioremap_caller(offset, size, pgprot_noncached(PAGE_KERNEL),
 		__builtin_return_address(0));
 }
 EXPORT_SYMBOL(ioremap);
 
+/*
+ * ioremap_wc  -   map bus memory into CPU space, write-combined
+ * @offset:    bus address of the memory
+ * @size:      size of the resource to map
+ *
+ * Like ioremap, but stores may be buffered and merged before they reach
+ * the device, and loads may be speculated: for framebuffers and the like,
+ * not for registers with side effects.  Needs an explicit wmb() before
+ * telling the device the data is there.
+ *
+ * Must be freed with iounmap.
+ */
+void __iomem *ioremap_wc(phys_addr_t offset, unsigned long size)
+{
+	return __ioremap_caller(offset, size, pgprot_writecombine(PAGE_KERNEL),
+		__builtin_return_address(0));
+}
+EXPORT_SYMBOL(ioremap_wc);
+
 
 /**
  * iounmap - Free a IO remapping
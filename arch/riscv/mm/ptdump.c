@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/seq_file.h>
+
+#include <asm/fixmap.h>
+#include <asm/pgtable.h>
+
+/*
+ * Dump the kernel half of swapper_pg_dir to debugfs as kernel_page_tables,
+ * one line per run of entries at the same level with the same bits, as
+ * x86 and arm64 do.  The level is where the leaf sits in the walk, so
+ * folded levels show up under the name of the one they are folded into.
+ */
+
+struct addr_marker {
+	unsigned long start_address;
+	const char *name;
+};
+
+static struct addr_marker address_markers[] = {
+#ifdef CONFIG_SPARSEMEM_VMEMMAP
+	{ VMEMMAP_START,	"vmemmap" },
+#endif
+	{ VMALLOC_START,	"vmalloc() area" },
+	{ FIXADDR_START,	"Fixmap" },
+	{ PAGE_OFFSET,		"Linear mapping" },
+	{ -1,			NULL },
+};
+
+enum pg_level {
+	PG_LEVEL_NONE,
+	PG_LEVEL_PGD,
+	PG_LEVEL_PUD,
+	PG_LEVEL_PMD,
+	PG_LEVEL_PTE,
+};
+
+static const char * const level_names[] = {
+	[PG_LEVEL_NONE]	= "",
+	[PG_LEVEL_PGD]	= "PGD",
+	[PG_LEVEL_PUD]	= "PUD",
+	[PG_LEVEL_PMD]	= "PMD",
+	[PG_LEVEL_PTE]	= "PTE",
+};
+
+struct prot_bits {
+	unsigned long mask;
+	const char *set;
+	const char *clear;
+};
+
+static const struct prot_bits pte_bits[] = {
+	{ _PAGE_SOFT,		"RSW",	"   " },
+	{ _PAGE_DIRTY,		"D",	"." },
+	{ _PAGE_ACCESSED,	"A",	"." },
+	{ _PAGE_GLOBAL,		"G",	"." },
+	{ _PAGE_USER,		"U",	"." },
+	{ _PAGE_EXEC,		"X",	"." },
+	{ _PAGE_WRITE,		"W",	"." },
+	{ _PAGE_READ,		"R",	"." },
+	{ _PAGE_PRESENT,	"V",	"." },
+#ifdef CONFIG_64BIT
+	{ _PAGE_MTMASK,		NULL,	NULL },
+#endif
+};
+
+#define PTE_PROT_MASK	(_PAGE_SOFT | _PAGE_DIRTY | _PAGE_ACCESSED |	\
+			 _PAGE_GLOBAL | _PAGE_USER | _PAGE_LEAF |	\
+			 _PAGE_PRESENT | _PAGE_MTMASK)
+
+struct pg_state {
+	struct seq_file *seq;
+	const struct addr_marker *marker;
+	unsigned long start_address;
+	enum pg_level level;
+	unsigned long prot;
+};
+
+static void dump_prot(struct pg_state *st)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(pte_bits); i++) {
+		unsigned long val = st->prot & pte_bits[i].mask;
+
+#ifdef CONFIG_64BIT
+		if (!pte_bits[i].set) {
+			/* The memory type field */
+			if (val == _PAGE_PBMT_NC)
+				seq_puts(st->seq, " NC");
+			else if (val == _PAGE_PBMT_IO)
+				seq_puts(st->seq, " IO");
+			else
+				seq_puts(st->seq, "   ");
+			continue;
+		}
+#endif
+		seq_printf(st->seq, " %s",
+			   val ? pte_bits[i].set : pte_bits[i].clear);
+	}
+}
+
+static void dump_size(struct pg_state *st, unsigned long size)
+{
+	static const char units[] = "KMGTPE";
+	const char *unit = units;
+
+	size >>= 10;
+	while (!(size & 1023) && size && unit[1]) {
+		size >>= 10;
+		unit++;
+	}
+	seq_printf(st->seq, "%9lu%c", size, *unit);
+}
+
+/* Close off the current run at addr when the new entry doesn't extend it */
+static void note_page(struct pg_state *st, unsigned long addr,
+		      enum pg_level level, unsigned long val)
+{
+	unsigned long prot = val & PTE_PROT_MASK;
+
+	if (!(val & _PAGE_PRESENT))
+		prot = 0;
+
+	if (st->level == PG_LEVEL_NONE) {
+		st->level = level;
+		st->prot = prot;
+		st->start_address = addr;
+		seq_printf(st->seq, "---[ %s ]---\n", st->marker->name);
+		return;
+	}
+
+	if (prot == st->prot && level == st->level &&
+	    addr < st->marker[1].start_address)
+		return;
+
+	if (st->prot) {
+		seq_printf(st->seq, "0x%0*lx-0x%0*lx ",
+			   (int)(2 * sizeof(long)), st->start_address,
+			   (int)(2 * sizeof(long)), addr);
+		dump_size(st, addr - st->start_address);
+		seq_printf(st->seq, " %s", level_names[st->level]);
+		dump_prot(st);
+		seq_puts(st->seq, "\n");
+	}
+
+	while (addr >= st->marker[1].start_address && st->marker[1].name) {
+		st->marker++;
+		seq_printf(st->seq, "---[ %s ]---\n", st->marker->name);
+	}
+
+	st->start_address = addr;
+	st->prot = prot;
+	st->level = level;
+}
+
+static void walk_pte(struct pg_state *st, pmd_t *pmdp, unsigned long addr,
+		     unsigned long end)
+{
+	pte_t *ptep = pte_offset_kernel(pmdp, addr);
+
+	do {
+		note_page(st, addr, PG_LEVEL_PTE, pte_val(*ptep));
+	} while (ptep++, addr += PAGE_SIZE, addr != end);
+}
+
+static void walk_pmd(struct pg_state *st, pud_t *pudp, unsigned long addr,
+		     unsigned long end)
+{
+	pmd_t *pmdp = pmd_offset(pudp, addr);
+	unsigned long next;
+
+	do {
+		pmd_t pmd = *pmdp;
+
+		next = pmd_addr_end(addr, end);
+		if (!pmd_present(pmd) || (pmd_val(pmd) & _PAGE_LEAF))
+			note_page(st, addr, PG_LEVEL_PMD, pmd_val(pmd));
+		else
+			walk_pte(st, pmdp, addr, next);
+	} while (pmdp++, addr = next, addr != end);
+}
+
+static void walk_pud(struct pg_state *st, p4d_t *p4dp, unsigned long addr,
+		     unsigned long end)
+{
+	pud_t *pudp = pud_offset(p4dp, addr);
+	unsigned long next;
+
+	do {
+		pud_t pud = *pudp;
+
+		next = pud_addr_end(addr, end);
+#ifndef __PAGETABLE_PMD_FOLDED
+		if (!pud_present(pud) || (pud_val(pud) & _PAGE_LEAF)) {
+			note_page(st, addr, PG_LEVEL_PUD, pud_val(pud));
+			continue;
+		}
+#endif
+		walk_pmd(st, pudp, addr, next);
+	} while (pudp++, addr = next, addr != end);
+}
+
+static void walk_pgd(struct pg_state *st)
+{
+	unsigned long addr = address_markers[0].start_address;
+	unsigned long next;
+	pgd_t *pgdp = pgd_offset_k(addr);
+
+	do {
+		p4d_t *p4dp = p4d_offset(pgdp, addr);
+
+		next = pgd_addr_end(addr, 0UL);
+		if (!p4d_present(*p4dp))
+			note_page(st, addr, PG_LEVEL_PGD, 0);
+		else
+			walk_pud(st, p4dp, addr, next);
+	} while (pgdp++, addr = next, addr != 0);
+
+	/* Flush out the last run */
+	note_page(st, 0, PG_LEVEL_NONE, 0);
+}
+
+static int ptdump_show(struct seq_file *m, void *v)
+{
+	struct pg_state st = {
+		.seq = m,
+		.marker = address_markers,
+	};
+
+	walk_pgd(&st);
+	return 0;
+}
+
+static int ptdump_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ptdump_show, NULL);
+}
+
+static const struct file_operations ptdump_fops = {
+	.open		= ptdump_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init ptdump_init(void)
+{
+	debugfs_create_file("kernel_page_tables", S_IRUSR, NULL, NULL,
+			    &ptdump_fops);
+	return 0;
+}
+device_initcall(ptdump_init);
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+
+#include <asm/sbi.h>
+#include <asm/smp.h>
+#include <asm/tlbflush.h>
+
+/*
+ * Each sfence.vma costs roughly as much as refilling a handful of TLB
+ * entries, so past a certain size one full flush is cheaper than walking
+ * the range.  Tunable through debugfs.
+ */
+unsigned long tlb_flush_ceiling __read_mostly = 64;
+
+static inline bool tlb_flush_whole(unsigned long start, unsigned long end)
+{
+	return (end - start) > (tlb_flush_ceiling << PAGE_SHIFT);
+}
+
+void local_flush_tlb_range(unsigned long start, unsigned long end)
+{
+	if (tlb_flush_whole(start, end)) {
+		local_flush_tlb_all();
+		return;
+	}
+
+	for (start &= PAGE_MASK; start < end; start += PAGE_SIZE)
+		local_flush_tlb_page(start);
+}
+
+#ifdef CONFIG_SMP
+
+/*
+ * Flush [start, end) on every hart in cmask.  If mm is given the flush is
+ * restricted to its ASID, otherwise the range is flushed in all address
+ * spaces.
+ */
+static void __flush_tlb_range(const struct cpumask *cmask,
+			      struct mm_struct *mm,
+			      unsigned long start, unsigned long end)
+{
+	bool use_asid = mm && riscv_use_asid;
+	unsigned long size;
+	unsigned int cpu;
+
+	if (tlb_flush_whole(start, end)) {
+		start = 0;
+		size = -1UL;
+	} else {
+		start &= PAGE_MASK;
+		size = PAGE_ALIGN(end) - start;
+	}
+
+	cpu = get_cpu();
+
+	/*
+	 * If no other hart can hold translations for this mm, skip the trap
+	 * into firmware entirely and just fence locally.
+	 */
+	if (cpumask_any_but(cmask, cpu) >= nr_cpu_ids) {
+		if (size == -1UL) {
+			if (use_asid)
+				local_flush_tlb_asid(ASID(mm));
+			else
+				local_flush_tlb_all();
+		} else {
+			local_flush_tlb_range(start, start + size);
+		}
+	} else if (use_asid) {
+		sbi_remote_sfence_vma_asid(cmask, start, size, ASID(mm));
+	} else {
+		sbi_remote_sfence_vma(cmask, start, size);
+	}
+
+	put_cpu();
+}
+
+static inline void remote_flush_tlb_range(struct mm_struct *mm,
+					  unsigned long start,
+					  unsigned long end)
+{
+	__flush_tlb_range(mm ? mm_cpumask(mm) : cpu_online_mask, mm,
+			  start, end);
+}
+
+void flush_tlb_all(void)
+{
+	sbi_remote_sfence_vma(NULL, 0, -1UL);
+}
+
+void flush_tlb_mm(struct mm_struct *mm)
+{
+	remote_flush_tlb_range(mm, 0, -1UL);
+}
+
+void flush_tlb_page(struct vm_area_struct *vma, unsigned long addr)
+{
+	remote_flush_tlb_range(vma->vm_mm, addr, addr + PAGE_SIZE);
+}
+
+void flush_tlb_range(struct vm_area_struct *vma, unsigned long start,
+		     unsigned long end)
+{
+	remote_flush_tlb_range(vma->vm_mm, start, end);
+}
+
+void flush_tlb_kernel_range(unsigned long start, unsigned long end)
+{
+	remote_flush_tlb_range(NULL, start, end);
+}
+
+void arch_tlbbatch_flush(struct arch_tlbflush_unmap_batch *batch)
+{
+	__flush_tlb_range(&batch->cpumask, batch->mm, batch->start, batch->end);
+	cpumask_clear(&batch->cpumask);
+}
+
+#endif /* CONFIG_SMP */
+
+static int __init tlb_flush_ceiling_init(void)
+{
+	debugfs_create_ulong("tlb_flush_ceiling", S_IRUSR | S_IWUSR, NULL,
+			     &tlb_flush_ceiling);
+	return 0;
+}
+late_initcall(tlb_flush_ceiling_init);
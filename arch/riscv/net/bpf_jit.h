@@ -0,0 +1,179 @@
+/*
+ * BPF JIT compiler for RV64: instruction encoders
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#ifndef _RISCV_NET_BPF_JIT_H
+#define _RISCV_NET_BPF_JIT_H
+
+#include <linux/types.h>
+
+enum {
+	RV_REG_ZERO =	0,	/* The constant value 0 */
+	RV_REG_RA =	1,	/* Return address */
+	RV_REG_SP =	2,	/* Stack pointer */
+	RV_REG_GP =	3,	/* Global pointer */
+	RV_REG_TP =	4,	/* Thread pointer */
+	RV_REG_T0 =	5,	/* Temporaries */
+	RV_REG_T1 =	6,
+	RV_REG_T2 =	7,
+	RV_REG_FP =	8,	/* Saved register/frame pointer */
+	RV_REG_S1 =	9,	/* Saved register */
+	RV_REG_A0 =	10,	/* Function argument/return values */
+	RV_REG_A1 =	11,	/* Function arguments */
+	RV_REG_A2 =	12,
+	RV_REG_A3 =	13,
+	RV_REG_A4 =	14,
+	RV_REG_A5 =	15,
+	RV_REG_A6 =	16,
+	RV_REG_A7 =	17,
+	RV_REG_S2 =	18,	/* Saved registers */
+	RV_REG_S3 =	19,
+	RV_REG_S4 =	20,
+	RV_REG_S5 =	21,
+	RV_REG_S6 =	22,
+	RV_REG_S7 =	23,
+	RV_REG_S8 =	24,
+	RV_REG_S9 =	25,
+	RV_REG_S10 =	26,
+	RV_REG_S11 =	27,
+	RV_REG_T3 =	28,	/* Temporaries */
+	RV_REG_T4 =	29,
+	RV_REG_T5 =	30,
+	RV_REG_T6 =	31,
+};
+
+/* Branch conditions, encoded as the B-type funct3 */
+enum {
+	RV_COND_EQ =	0,
+	RV_COND_NE =	1,
+	RV_COND_LT =	4,
+	RV_COND_GE =	5,
+	RV_COND_LTU =	6,
+	RV_COND_GEU =	7,
+};
+
+/* Flipping the low bit of the condition gives its inverse */
+#define RV_COND_INVERT(cond)	((cond) ^ 1)
+
+#define RV_INSN_EBREAK		0x00100073U
+
+static inline u32 rv_r_insn(u8 funct7, u8 rs2, u8 rs1, u8 funct3, u8 rd,
+			    u8 opcode)
+{
+	return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) |
+		(rd << 7) | opcode;
+}
+
+static inline u32 rv_i_insn(u16 imm11_0, u8 rs1, u8 funct3, u8 rd, u8 opcode)
+{
+	return ((imm11_0 & 0xfff) << 20) | (rs1 << 15) | (funct3 << 12) |
+		(rd << 7) | opcode;
+}
+
+static inline u32 rv_s_insn(u16 imm11_0, u8 rs2, u8 rs1, u8 funct3, u8 opcode)
+{
+	u8 imm11_5 = (imm11_0 >> 5) & 0x7f, imm4_0 = imm11_0 & 0x1f;
+
+	return (imm11_5 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) |
+		(imm4_0 << 7) | opcode;
+}
+
+/* imm is the byte offset, which must be even */
+static inline u32 rv_b_insn(u16 imm12_1, u8 rs2, u8 rs1, u8 funct3, u8 opcode)
+{
+	u8 imm12 = ((imm12_1 & 0x800) >> 5) | ((imm12_1 & 0x3f0) >> 4);
+	u8 imm4_1 = ((imm12_1 & 0xf) << 1) | ((imm12_1 & 0x400) >> 10);
+
+	return (imm12 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) |
+		(imm4_1 << 7) | opcode;
+}
+
+static inline u32 rv_u_insn(u32 imm31_12, u8 rd, u8 opcode)
+{
+	return ((imm31_12 & 0xfffff) << 12) | (rd << 7) | opcode;
+}
+
+/* imm is the byte offset, which must be even */
+static inline u32 rv_j_insn(u32 imm20_1, u8 rd, u8 opcode)
+{
+	u32 imm;
+
+	imm = (imm20_1 & 0x80000) | ((imm20_1 & 0x3ff) << 9) |
+		((imm20_1 & 0x400) >> 2) | ((imm20_1 & 0x7f800) >> 11);
+
+	return (imm << 12) | (rd << 7) | opcode;
+}
+
+/* RV32I/RV64I, the branch and jump offsets are in bytes */
+#define rv_lui(rd, imm)		rv_u_insn(imm, rd, 0x37)
+#define rv_jal(rd, off)		rv_j_insn((off) >> 1, rd, 0x6f)
+#define rv_jalr(rd, rs1, off)	rv_i_insn(off, rs1, 0, rd, 0x67)
+#define rv_branch(cond, rs1, rs2, off)	\
+	rv_b_insn((off) >> 1, rs2, rs1, cond, 0x63)
+#define rv_beq(rs1, rs2, off)	rv_branch(RV_COND_EQ, rs1, rs2, off)
+#define rv_bne(rs1, rs2, off)	rv_branch(RV_COND_NE, rs1, rs2, off)
+#define rv_bltu(rs1, rs2, off)	rv_branch(RV_COND_LTU, rs1, rs2, off)
+#define rv_bgeu(rs1, rs2, off)	rv_branch(RV_COND_GEU, rs1, rs2, off)
+
+#define rv_lb(rd, off, rs1)	rv_i_insn(off, rs1, 0, rd, 0x03)
+#define rv_lbu(rd, off, rs1)	rv_i_insn(off, rs1, 4, rd, 0x03)
+#define rv_lhu(rd, off, rs1)	rv_i_insn(off, rs1, 5, rd, 0x03)
+#define rv_lwu(rd, off, rs1)	rv_i_insn(off, rs1, 6, rd, 0x03)
+#define rv_ld(rd, off, rs1)	rv_i_insn(off, rs1, 3, rd, 0x03)
+#define rv_sb(rs1, off, rs2)	rv_s_insn(off, rs2, rs1, 0, 0x23)
+#define rv_sh(rs1, off, rs2)	rv_s_insn(off, rs2, rs1, 1, 0x23)
+#define rv_sw(rs1, off, rs2)	rv_s_insn(off, rs2, rs1, 2, 0x23)
+#define rv_sd(rs1, off, rs2)	rv_s_insn(off, rs2, rs1, 3, 0x23)
+
+#define rv_addi(rd, rs1, imm)	rv_i_insn(imm, rs1, 0, rd, 0x13)
+#define rv_xori(rd, rs1, imm)	rv_i_insn(imm, rs1, 4, rd, 0x13)
+#define rv_ori(rd, rs1, imm)	rv_i_insn(imm, rs1, 6, rd, 0x13)
+#define rv_andi(rd, rs1, imm)	rv_i_insn(imm, rs1, 7, rd, 0x13)
+#define rv_slli(rd, rs1, sh)	rv_i_insn(sh, rs1, 1, rd, 0x13)
+#define rv_srli(rd, rs1, sh)	rv_i_insn(sh, rs1, 5, rd, 0x13)
+#define rv_srai(rd, rs1, sh)	rv_i_insn(0x400 | (sh), rs1, 5, rd, 0x13)
+
+#define rv_add(rd, rs1, rs2)	rv_r_insn(0x00, rs2, rs1, 0, rd, 0x33)
+#define rv_sub(rd, rs1, rs2)	rv_r_insn(0x20, rs2, rs1, 0, rd, 0x33)
+#define rv_sll(rd, rs1, rs2)	rv_r_insn(0x00, rs2, rs1, 1, rd, 0x33)
+#define rv_xor(rd, rs1, rs2)	rv_r_insn(0x00, rs2, rs1, 4, rd, 0x33)
+#define rv_srl(rd, rs1, rs2)	rv_r_insn(0x00, rs2, rs1, 5, rd, 0x33)
+#define rv_sra(rd, rs1, rs2)	rv_r_insn(0x20, rs2, rs1, 5, rd, 0x33)
+#define rv_or(rd, rs1, rs2)	rv_r_insn(0x00, rs2, rs1, 6, rd, 0x33)
+#define rv_and(rd, rs1, rs2)	rv_r_insn(0x00, rs2, rs1, 7, rd, 0x33)
+
+/* RV64I only, 32-bit operations with a sign-extended result */
+#define rv_addiw(rd, rs1, imm)	rv_i_insn(imm, rs1, 0, rd, 0x1b)
+#define rv_slliw(rd, rs1, sh)	rv_i_insn(sh, rs1, 1, rd, 0x1b)
+#define rv_srliw(rd, rs1, sh)	rv_i_insn(sh, rs1, 5, rd, 0x1b)
+#define rv_sraiw(rd, rs1, sh)	rv_i_insn(0x400 | (sh), rs1, 5, rd, 0x1b)
+#define rv_addw(rd, rs1, rs2)	rv_r_insn(0x00, rs2, rs1, 0, rd, 0x3b)
+#define rv_subw(rd, rs1, rs2)	rv_r_insn(0x20, rs2, rs1, 0, rd, 0x3b)
+#define rv_sllw(rd, rs1, rs2)	rv_r_insn(0x00, rs2, rs1, 1, rd, 0x3b)
+#define rv_srlw(rd, rs1, rs2)	rv_r_insn(0x00, rs2, rs1, 5, rd, 0x3b)
+#define rv_sraw(rd, rs1, rs2)	rv_r_insn(0x20, rs2, rs1, 5, rd, 0x3b)
+
+/* RV64M */
+#define rv_mul(rd, rs1, rs2)	rv_r_insn(0x01, rs2, rs1, 0, rd, 0x33)
+#define rv_divu(rd, rs1, rs2)	rv_r_insn(0x01, rs2, rs1, 5, rd, 0x33)
+#define rv_remu(rd, rs1, rs2)	rv_r_insn(0x01, rs2, rs1, 7, rd, 0x33)
+#define rv_mulw(rd, rs1, rs2)	rv_r_insn(0x01, rs2, rs1, 0, rd, 0x3b)
+#define rv_divuw(rd, rs1, rs2)	rv_r_insn(0x01, rs2, rs1, 5, rd, 0x3b)
+#define rv_remuw(rd, rs1, rs2)	rv_r_insn(0x01, rs2, rs1, 7, rd, 0x3b)
+
+/* RV64A, without acquire or release ordering */
+#define rv_amoadd_w(rd, rs2, rs1)	rv_r_insn(0x00, rs2, rs1, 2, rd, 0x2f)
+#define rv_amoadd_d(rd, rs2, rs1)	rv_r_insn(0x00, rs2, rs1, 3, rd, 0x2f)
+
+#endif /* _RISCV_NET_BPF_JIT_H */
@@ -0,0 +1,1051 @@
+/*
+ * BPF JIT compiler for RV64
+ * Based on arch/arm64/net/bpf_jit_comp.c
+ *
+ * Copyright (C) 2014-2016 Zi Shen Lim <zlim.lnx@gmail.com>
+ * Copyright (C) 2017 SiFive
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) "bpf_jit: " fmt
+
+#include <linux/bitops.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/printk.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+
+#include <asm/cacheflush.h>
+
+#include "bpf_jit.h"
+
+int bpf_jit_enable __read_mostly;
+
+#define TMP_REG_1 (MAX_BPF_JIT_REG + 0)
+#define TMP_REG_2 (MAX_BPF_JIT_REG + 1)
+#define TCALL_CNT (MAX_BPF_JIT_REG + 2)
+
+/* Map BPF registers to RISC-V registers */
+static const int bpf2rv[] = {
+	/* return value from in-kernel function, and exit value from eBPF */
+	[BPF_REG_0] = RV_REG_A5,
+	/* arguments from eBPF program to in-kernel function */
+	[BPF_REG_1] = RV_REG_A0,
+	[BPF_REG_2] = RV_REG_A1,
+	[BPF_REG_3] = RV_REG_A2,
+	[BPF_REG_4] = RV_REG_A3,
+	[BPF_REG_5] = RV_REG_A4,
+	/* callee saved registers that in-kernel function will preserve */
+	[BPF_REG_6] = RV_REG_S1,
+	[BPF_REG_7] = RV_REG_S2,
+	[BPF_REG_8] = RV_REG_S3,
+	[BPF_REG_9] = RV_REG_S4,
+	/* read-only frame pointer to access stack */
+	[BPF_REG_FP] = RV_REG_S5,
+	/* temporary registers for internal BPF JIT */
+	[TMP_REG_1] = RV_REG_T1,
+	[TMP_REG_2] = RV_REG_T2,
+	/* tail_call_cnt */
+	[TCALL_CNT] = RV_REG_S6,
+	/* temporary register for blinding constants */
+	[BPF_REG_AX] = RV_REG_T0,
+};
+
+/*
+ * tail_call_cnt is handed from one program to the next in a6, which the
+ * epilogue leaves alone.
+ */
+#define TCALL_CNT_ARG	RV_REG_A6
+
+struct jit_ctx {
+	const struct bpf_prog *prog;
+	int idx;
+	/*
+	 * offset[i] is the index of the first RISC-V instruction of BPF
+	 * instruction i, offset[prog->len] that of the epilogue.  Entries
+	 * not reached yet in the current pass hold the previous pass's
+	 * value, or 0 on the first pass.
+	 */
+	int *offset;
+	u32 *image;
+	u32 stack_size;
+};
+
+static inline void emit(const u32 insn, struct jit_ctx *ctx)
+{
+	if (ctx->image != NULL)
+		ctx->image[ctx->idx] = insn;
+
+	ctx->idx++;
+}
+
+static inline bool is_12b_int(s64 val)
+{
+	return -(1 << 11) <= val && val < (1 << 11);
+}
+
+static inline bool is_13b_int(s64 val)
+{
+	return -(1 << 12) <= val && val < (1 << 12);
+}
+
+static inline bool is_21b_int(s64 val)
+{
+	return -(1L << 20) <= val && val < (1L << 20);
+}
+
+static inline bool is_32b_int(s64 val)
+{
+	return -(1L << 31) <= val && val < (1L << 31);
+}
+
+/* Load a 64-bit constant in as few instructions as it takes */
+static void emit_imm(const u8 rd, s64 val, struct jit_ctx *ctx)
+{
+	/* The low 12 bits are added sign-extended, so round the rest up */
+	s64 upper = (val + (1 << 11)) >> 12;
+	s64 lower = val & 0xfff;
+	int shift;
+
+	if (is_32b_int(val)) {
+		if (!upper) {
+			emit(rv_addi(rd, RV_REG_ZERO, lower), ctx);
+			return;
+		}
+		emit(rv_lui(rd, upper), ctx);
+		if (lower)
+			emit(rv_addiw(rd, rd, lower), ctx);
+		return;
+	}
+
+	shift = __ffs(upper);
+	upper >>= shift;
+	shift += 12;
+
+	emit_imm(rd, upper, ctx);
+	emit(rv_slli(rd, rd, shift), ctx);
+	if (lower)
+		emit(rv_addi(rd, rd, lower), ctx);
+}
+
+/* 32-bit BPF operations zero the upper half of their destination */
+static inline void emit_zext_32(const u8 rd, struct jit_ctx *ctx)
+{
+	emit(rv_slli(rd, rd, 32), ctx);
+	emit(rv_srli(rd, rd, 32), ctx);
+}
+
+static inline void emit_mv(const u8 rd, const u8 rs, struct jit_ctx *ctx)
+{
+	emit(rv_addi(rd, rs, 0), ctx);
+}
+
+/* Reverse the low 'bytes' bytes of rd; the rest of rd ends up zero */
+static void emit_rev(const u8 rd, int bytes, const u8 tmp, const u8 tmp2,
+		     struct jit_ctx *ctx)
+{
+	int i;
+
+	emit(rv_addi(tmp2, RV_REG_ZERO, 0), ctx);
+	for (i = 0; i < bytes; i++) {
+		emit(rv_andi(tmp, rd, 0xff), ctx);
+		emit(rv_or(tmp2, tmp2, tmp), ctx);
+		if (i == bytes - 1)
+			break;
+		emit(rv_slli(tmp2, tmp2, 8), ctx);
+		emit(rv_srli(rd, rd, 8), ctx);
+	}
+	emit_mv(rd, tmp2, ctx);
+}
+
+/* Index of the first instruction of the jump target of BPF insn 'i' */
+static inline int bpf2rv_target(int i, s16 off, const struct jit_ctx *ctx)
+{
+	return ctx->offset[i + off + 1];
+}
+
+#define check_imm(bits, imm) do {				\
+	if (!is_##bits##b_int(imm)) {				\
+		pr_info("imm=%lld(0x%llx) out of range\n",	\
+			(s64)(imm), (s64)(imm));		\
+		return -EINVAL;					\
+	}							\
+} while (0)
+
+/*
+ * Conditional branch to instruction index 'to'.  A B-type branch only
+ * reaches +/-4KiB, so anything farther (or not placed yet) becomes an
+ * inverted branch over a jal.  The code only ever shrinks from one pass
+ * to the next, so a distance that fits once keeps fitting.
+ */
+static int emit_branch(u8 cond, u8 rs1, u8 rs2, int to, struct jit_ctx *ctx)
+{
+	s64 rvoff = (s64)(to - ctx->idx) * 4;
+
+	if (to && is_13b_int(rvoff)) {
+		emit(rv_branch(cond, rs1, rs2, rvoff), ctx);
+		return 0;
+	}
+
+	/* Skip the jal when the condition is false */
+	emit(rv_branch(RV_COND_INVERT(cond), rs1, rs2, 8), ctx);
+	rvoff = (s64)(to - ctx->idx) * 4;
+	check_imm(21, rvoff);
+	emit(rv_jal(RV_REG_ZERO, rvoff), ctx);
+	return 0;
+}
+
+static int emit_jump(int to, struct jit_ctx *ctx)
+{
+	s64 rvoff = (s64)(to - ctx->idx) * 4;
+
+	check_imm(21, rvoff);
+	emit(rv_jal(RV_REG_ZERO, rvoff), ctx);
+	return 0;
+}
+
+static inline int epilogue_offset(const struct jit_ctx *ctx)
+{
+	return ctx->offset[ctx->prog->len];
+}
+
+static void jit_fill_hole(void *area, unsigned int size)
+{
+	u32 *ptr;
+	/* We are guaranteed to have aligned memory. */
+	for (ptr = area; size >= sizeof(u32); size -= sizeof(u32))
+		*ptr++ = RV_INSN_EBREAK;
+}
+
+/* Stack must be multiples of 16B */
+#define STACK_ALIGN(sz) (((sz) + 15) & ~15)
+
+/* ra, s0 and s1-s6 */
+#define SAVED_REGS_SIZE	(8 * 8)
+
+static void build_prologue(struct jit_ctx *ctx)
+{
+	const u8 r6 = bpf2rv[BPF_REG_6];
+	const u8 r7 = bpf2rv[BPF_REG_7];
+	const u8 r8 = bpf2rv[BPF_REG_8];
+	const u8 r9 = bpf2rv[BPF_REG_9];
+	const u8 fp = bpf2rv[BPF_REG_FP];
+	const u8 tcc = bpf2rv[TCALL_CNT];
+	const int stack = ctx->stack_size;
+
+	/*
+	 * BPF prog stack layout
+	 *
+	 *                        high
+	 * original sp, s0 =>  0:+-----+ BPF prologue
+	 *                      |RA/FP|
+	 *                      | ... | callee saved registers
+	 * BPF fp register => -64:+-----+ <= (BPF_FP)
+	 *                      |     |
+	 *                      | ... | BPF prog stack
+	 *                      |     |
+	 *                      +-----+ <= (BPF_FP - prog->aux->stack_depth)
+	 *                      | ... |
+	 *                      |RSVD | JIT scratchpad
+	 * current sp =>        +-----+ <= (original sp - ctx->stack_size)
+	 *                      |     |
+	 *                      | ... | Function call stack
+	 *                      |     |
+	 *                      +-----+
+	 *                        low
+	 *
+	 * ra and s0 sit where a compiled function keeps them, so the stack
+	 * can still be unwound through JITed code.
+	 */
+
+	/* Initialize tail_call_cnt; a tail call enters right after this */
+	emit(rv_addi(TCALL_CNT_ARG, RV_REG_ZERO, 0), ctx);
+
+	emit(rv_addi(RV_REG_SP, RV_REG_SP, -stack), ctx);
+	emit(rv_sd(RV_REG_SP, stack - 8, RV_REG_RA), ctx);
+	emit(rv_sd(RV_REG_SP, stack - 16, RV_REG_FP), ctx);
+	emit(rv_sd(RV_REG_SP, stack - 24, r6), ctx);
+	emit(rv_sd(RV_REG_SP, stack - 32, r7), ctx);
+	emit(rv_sd(RV_REG_SP, stack - 40, r8), ctx);
+	emit(rv_sd(RV_REG_SP, stack - 48, r9), ctx);
+	emit(rv_sd(RV_REG_SP, stack - 56, fp), ctx);
+	emit(rv_sd(RV_REG_SP, stack - 64, tcc), ctx);
+	emit(rv_addi(RV_REG_FP, RV_REG_SP, stack), ctx);
+
+	/* Set up BPF prog stack base register */
+	emit(rv_addi(fp, RV_REG_FP, -SAVED_REGS_SIZE), ctx);
+
+	emit_mv(tcc, TCALL_CNT_ARG, ctx);
+}
+
+/* Tear down the frame, then return or (for a tail call) jump to rs + 4 */
+static void __build_epilogue(bool is_tail_call, const u8 rs,
+			     struct jit_ctx *ctx)
+{
+	const u8 r0 = bpf2rv[BPF_REG_0];
+	const u8 r6 = bpf2rv[BPF_REG_6];
+	const u8 r7 = bpf2rv[BPF_REG_7];
+	const u8 r8 = bpf2rv[BPF_REG_8];
+	const u8 r9 = bpf2rv[BPF_REG_9];
+	const u8 fp = bpf2rv[BPF_REG_FP];
+	const u8 tcc = bpf2rv[TCALL_CNT];
+	const int stack = ctx->stack_size;
+
+	if (is_tail_call)
+		emit_mv(TCALL_CNT_ARG, tcc, ctx);
+	else
+		/* Set return value */
+		emit_mv(RV_REG_A0, r0, ctx);
+
+	emit(rv_ld(RV_REG_RA, stack - 8, RV_REG_SP), ctx);
+	emit(rv_ld(RV_REG_FP, stack - 16, RV_REG_SP), ctx);
+	emit(rv_ld(r6, stack - 24, RV_REG_SP), ctx);
+	emit(rv_ld(r7, stack - 32, RV_REG_SP), ctx);
+	emit(rv_ld(r8, stack - 40, RV_REG_SP), ctx);
+	emit(rv_ld(r9, stack - 48, RV_REG_SP), ctx);
+	emit(rv_ld(fp, stack - 56, RV_REG_SP), ctx);
+	emit(rv_ld(tcc, stack - 64, RV_REG_SP), ctx);
+	emit(rv_addi(RV_REG_SP, RV_REG_SP, stack), ctx);
+
+	emit(rv_jalr(RV_REG_ZERO, rs, is_tail_call ? 4 : 0), ctx);
+}
+
+static void build_epilogue(struct jit_ctx *ctx)
+{
+	__build_epilogue(false, RV_REG_RA, ctx);
+}
+
+static int out_offset = -1; /* initialized on the first pass of build_body() */
+static int emit_bpf_tail_call(struct jit_ctx *ctx)
+{
+	/* bpf_tail_call(void *prog_ctx, struct bpf_array *array, u64 index) */
+	const u8 r2 = bpf2rv[BPF_REG_2];
+	const u8 r3 = bpf2rv[BPF_REG_3];
+
+	const u8 tmp = bpf2rv[TMP_REG_1];
+	const u8 idx = bpf2rv[TMP_REG_2];
+	const u8 tcc = bpf2rv[TCALL_CNT];
+	const int idx0 = ctx->idx;
+#define cur_offset (ctx->idx - idx0)
+#define jmp_offset ((out_offset - (cur_offset)) * 4)
+	size_t off;
+
+	/* if (index >= array->map.max_entries)
+	 *     goto out;
+	 */
+	off = offsetof(struct bpf_array, map.max_entries);
+	if (!is_12b_int(off))
+		return -1;
+	emit(rv_lwu(tmp, off, r2), ctx);
+	emit(rv_slli(idx, r3, 32), ctx);
+	emit(rv_srli(idx, idx, 32), ctx);
+	emit(rv_bgeu(idx, tmp, jmp_offset), ctx);
+
+	/* if (tail_call_cnt > MAX_TAIL_CALL_CNT)
+	 *     goto out;
+	 * tail_call_cnt++;
+	 */
+	emit(rv_addi(tmp, RV_REG_ZERO, MAX_TAIL_CALL_CNT), ctx);
+	emit(rv_bltu(tmp, tcc, jmp_offset), ctx);
+	emit(rv_addi(tcc, tcc, 1), ctx);
+
+	/* prog = array->ptrs[index];
+	 * if (prog == NULL)
+	 *     goto out;
+	 */
+	off = offsetof(struct bpf_array, ptrs);
+	if (!is_12b_int(off))
+		return -1;
+	emit(rv_slli(tmp, idx, 3), ctx);
+	emit(rv_add(tmp, tmp, r2), ctx);
+	emit(rv_ld(tmp, off, tmp), ctx);
+	emit(rv_beq(tmp, RV_REG_ZERO, jmp_offset), ctx);
+
+	/* goto *(prog->bpf_func + 4); */
+	off = offsetof(struct bpf_prog, bpf_func);
+	if (!is_12b_int(off))
+		return -1;
+	emit(rv_ld(tmp, off, tmp), ctx);
+	__build_epilogue(true, tmp, ctx);
+
+	/* out: */
+	if (out_offset == -1)
+		out_offset = cur_offset;
+	if (cur_offset != out_offset) {
+		pr_err_once("tail_call out_offset = %d, expected %d!\n",
+			    cur_offset, out_offset);
+		return -1;
+	}
+	return 0;
+#undef cur_offset
+#undef jmp_offset
+}
+
+/* dst = *(size *)(src + off), zero-extended */
+static void emit_load(u8 size, const u8 dst, const u8 src, s16 off,
+		      const u8 tmp, struct jit_ctx *ctx)
+{
+	u8 base = src;
+
+	if (!is_12b_int(off)) {
+		emit_imm(tmp, off, ctx);
+		emit(rv_add(tmp, tmp, src), ctx);
+		base = tmp;
+		off = 0;
+	}
+
+	switch (size) {
+	case BPF_B:
+		emit(rv_lbu(dst, off, base), ctx);
+		break;
+	case BPF_H:
+		emit(rv_lhu(dst, off, base), ctx);
+		break;
+	case BPF_W:
+		emit(rv_lwu(dst, off, base), ctx);
+		break;
+	case BPF_DW:
+		emit(rv_ld(dst, off, base), ctx);
+		break;
+	}
+}
+
+/* *(size *)(dst + off) = src */
+static void emit_store(u8 size, const u8 dst, s16 off, const u8 src,
+		       const u8 tmp, struct jit_ctx *ctx)
+{
+	u8 base = dst;
+
+	if (!is_12b_int(off)) {
+		emit_imm(tmp, off, ctx);
+		emit(rv_add(tmp, tmp, dst), ctx);
+		base = tmp;
+		off = 0;
+	}
+
+	switch (size) {
+	case BPF_B:
+		emit(rv_sb(base, off, src), ctx);
+		break;
+	case BPF_H:
+		emit(rv_sh(base, off, src), ctx);
+		break;
+	case BPF_W:
+		emit(rv_sw(base, off, src), ctx);
+		break;
+	case BPF_DW:
+		emit(rv_sd(base, off, src), ctx);
+		break;
+	}
+}
+
+/* JITs an eBPF instruction.
+ * Returns:
+ * 0  - successfully JITed an 8-byte eBPF instruction.
+ * >0 - successfully JITed a 16-byte eBPF instruction.
+ * <0 - failed to JIT.
+ */
+static int build_insn(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const u8 code = insn->code;
+	u8 dst = bpf2rv[insn->dst_reg];
+	const u8 src = bpf2rv[insn->src_reg];
+	const u8 tmp = bpf2rv[TMP_REG_1];
+	const u8 tmp2 = bpf2rv[TMP_REG_2];
+	const s16 off = insn->off;
+	const s32 imm = insn->imm;
+	const int i = insn - ctx->prog->insnsi;
+	const bool is64 = BPF_CLASS(code) == BPF_ALU64;
+	u8 rs, cond;
+	int ret;
+
+	switch (code) {
+	/* dst = src */
+	case BPF_ALU | BPF_MOV | BPF_X:
+	case BPF_ALU64 | BPF_MOV | BPF_X:
+		if (is64) {
+			emit_mv(dst, src, ctx);
+		} else {
+			emit(rv_slli(dst, src, 32), ctx);
+			emit(rv_srli(dst, dst, 32), ctx);
+		}
+		break;
+	/* dst = dst OP src */
+	case BPF_ALU | BPF_ADD | BPF_X:
+	case BPF_ALU64 | BPF_ADD | BPF_X:
+		emit(is64 ? rv_add(dst, dst, src) : rv_addw(dst, dst, src), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_SUB | BPF_X:
+	case BPF_ALU64 | BPF_SUB | BPF_X:
+		emit(is64 ? rv_sub(dst, dst, src) : rv_subw(dst, dst, src), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_AND | BPF_X:
+	case BPF_ALU64 | BPF_AND | BPF_X:
+		emit(rv_and(dst, dst, src), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_OR | BPF_X:
+	case BPF_ALU64 | BPF_OR | BPF_X:
+		emit(rv_or(dst, dst, src), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_XOR | BPF_X:
+	case BPF_ALU64 | BPF_XOR | BPF_X:
+		emit(rv_xor(dst, dst, src), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_MUL | BPF_X:
+	case BPF_ALU64 | BPF_MUL | BPF_X:
+		emit(is64 ? rv_mul(dst, dst, src) : rv_mulw(dst, dst, src), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_DIV | BPF_X:
+	case BPF_ALU64 | BPF_DIV | BPF_X:
+	case BPF_ALU | BPF_MOD | BPF_X:
+	case BPF_ALU64 | BPF_MOD | BPF_X:
+	{
+		const u8 r0 = bpf2rv[BPF_REG_0];
+
+		/* Only the low half of the divisor counts for 32-bit ops */
+		rs = src;
+		if (!is64) {
+			emit(rv_slli(tmp, src, 32), ctx);
+			emit(rv_srli(tmp, tmp, 32), ctx);
+			rs = tmp;
+		}
+
+		/* if (src == 0) return 0 */
+		emit(rv_bne(rs, RV_REG_ZERO, 12), ctx); /* skip to else path */
+		emit(rv_addi(r0, RV_REG_ZERO, 0), ctx);
+		ret = emit_jump(epilogue_offset(ctx), ctx);
+		if (ret)
+			return ret;
+		/* else */
+		switch (BPF_OP(code)) {
+		case BPF_DIV:
+			emit(is64 ? rv_divu(dst, dst, rs) :
+			     rv_divuw(dst, dst, rs), ctx);
+			break;
+		case BPF_MOD:
+			emit(is64 ? rv_remu(dst, dst, rs) :
+			     rv_remuw(dst, dst, rs), ctx);
+			break;
+		}
+		goto alu_zext;
+	}
+	case BPF_ALU | BPF_LSH | BPF_X:
+	case BPF_ALU64 | BPF_LSH | BPF_X:
+		emit(is64 ? rv_sll(dst, dst, src) : rv_sllw(dst, dst, src), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_RSH | BPF_X:
+	case BPF_ALU64 | BPF_RSH | BPF_X:
+		emit(is64 ? rv_srl(dst, dst, src) : rv_srlw(dst, dst, src), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_ARSH | BPF_X:
+	case BPF_ALU64 | BPF_ARSH | BPF_X:
+		emit(is64 ? rv_sra(dst, dst, src) : rv_sraw(dst, dst, src), ctx);
+		goto alu_zext;
+	/* dst = -dst */
+	case BPF_ALU | BPF_NEG:
+	case BPF_ALU64 | BPF_NEG:
+		emit(is64 ? rv_sub(dst, RV_REG_ZERO, dst) :
+		     rv_subw(dst, RV_REG_ZERO, dst), ctx);
+		goto alu_zext;
+	/* dst = BSWAP##imm(dst) */
+	case BPF_ALU | BPF_END | BPF_FROM_LE:
+	case BPF_ALU | BPF_END | BPF_FROM_BE:
+		/* RISC-V is little endian: only FROM_BE swaps */
+		if (BPF_SRC(code) == BPF_FROM_BE) {
+			emit_rev(dst, imm / 8, tmp, tmp2, ctx);
+			break;
+		}
+		switch (imm) {
+		case 16:
+			/* zero-extend 16 bits into 64 bits */
+			emit(rv_slli(dst, dst, 48), ctx);
+			emit(rv_srli(dst, dst, 48), ctx);
+			break;
+		case 32:
+			/* zero-extend 32 bits into 64 bits */
+			emit_zext_32(dst, ctx);
+			break;
+		case 64:
+			/* nop */
+			break;
+		}
+		break;
+	/* dst = imm */
+	case BPF_ALU | BPF_MOV | BPF_K:
+	case BPF_ALU64 | BPF_MOV | BPF_K:
+		emit_imm(dst, imm, ctx);
+		if (imm < 0)
+			goto alu_zext;
+		break;
+	/* dst = dst OP imm */
+	case BPF_ALU | BPF_ADD | BPF_K:
+	case BPF_ALU64 | BPF_ADD | BPF_K:
+		if (is_12b_int(imm)) {
+			emit(is64 ? rv_addi(dst, dst, imm) :
+			     rv_addiw(dst, dst, imm), ctx);
+		} else {
+			emit_imm(tmp, imm, ctx);
+			emit(is64 ? rv_add(dst, dst, tmp) :
+			     rv_addw(dst, dst, tmp), ctx);
+		}
+		goto alu_zext;
+	case BPF_ALU | BPF_SUB | BPF_K:
+	case BPF_ALU64 | BPF_SUB | BPF_K:
+		if (is_12b_int(-(s64)imm)) {
+			emit(is64 ? rv_addi(dst, dst, -imm) :
+			     rv_addiw(dst, dst, -imm), ctx);
+		} else {
+			emit_imm(tmp, imm, ctx);
+			emit(is64 ? rv_sub(dst, dst, tmp) :
+			     rv_subw(dst, dst, tmp), ctx);
+		}
+		goto alu_zext;
+	case BPF_ALU | BPF_AND | BPF_K:
+	case BPF_ALU64 | BPF_AND | BPF_K:
+		if (is_12b_int(imm)) {
+			emit(rv_andi(dst, dst, imm), ctx);
+		} else {
+			emit_imm(tmp, imm, ctx);
+			emit(rv_and(dst, dst, tmp), ctx);
+		}
+		goto alu_zext;
+	case BPF_ALU | BPF_OR | BPF_K:
+	case BPF_ALU64 | BPF_OR | BPF_K:
+		if (is_12b_int(imm)) {
+			emit(rv_ori(dst, dst, imm), ctx);
+		} else {
+			emit_imm(tmp, imm, ctx);
+			emit(rv_or(dst, dst, tmp), ctx);
+		}
+		goto alu_zext;
+	case BPF_ALU | BPF_XOR | BPF_K:
+	case BPF_ALU64 | BPF_XOR | BPF_K:
+		if (is_12b_int(imm)) {
+			emit(rv_xori(dst, dst, imm), ctx);
+		} else {
+			emit_imm(tmp, imm, ctx);
+			emit(rv_xor(dst, dst, tmp), ctx);
+		}
+		goto alu_zext;
+	case BPF_ALU | BPF_MUL | BPF_K:
+	case BPF_ALU64 | BPF_MUL | BPF_K:
+		emit_imm(tmp, imm, ctx);
+		emit(is64 ? rv_mul(dst, dst, tmp) : rv_mulw(dst, dst, tmp), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_DIV | BPF_K:
+	case BPF_ALU64 | BPF_DIV | BPF_K:
+		emit_imm(tmp, imm, ctx);
+		emit(is64 ? rv_divu(dst, dst, tmp) : rv_divuw(dst, dst, tmp), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_MOD | BPF_K:
+	case BPF_ALU64 | BPF_MOD | BPF_K:
+		emit_imm(tmp, imm, ctx);
+		emit(is64 ? rv_remu(dst, dst, tmp) : rv_remuw(dst, dst, tmp), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_LSH | BPF_K:
+	case BPF_ALU64 | BPF_LSH | BPF_K:
+		emit(is64 ? rv_slli(dst, dst, imm) : rv_slliw(dst, dst, imm), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_RSH | BPF_K:
+	case BPF_ALU64 | BPF_RSH | BPF_K:
+		emit(is64 ? rv_srli(dst, dst, imm) : rv_srliw(dst, dst, imm), ctx);
+		goto alu_zext;
+	case BPF_ALU | BPF_ARSH | BPF_K:
+	case BPF_ALU64 | BPF_ARSH | BPF_K:
+		emit(is64 ? rv_srai(dst, dst, imm) : rv_sraiw(dst, dst, imm), ctx);
+alu_zext:
+		if (!is64)
+			emit_zext_32(dst, ctx);
+		break;
+
+	/* JUMP off */
+	case BPF_JMP | BPF_JA:
+		return emit_jump(bpf2rv_target(i, off, ctx), ctx);
+	/* IF (dst COND src) JUMP off */
+	case BPF_JMP | BPF_JEQ | BPF_X:
+	case BPF_JMP | BPF_JGT | BPF_X:
+	case BPF_JMP | BPF_JLT | BPF_X:
+	case BPF_JMP | BPF_JGE | BPF_X:
+	case BPF_JMP | BPF_JLE | BPF_X:
+	case BPF_JMP | BPF_JNE | BPF_X:
+	case BPF_JMP | BPF_JSGT | BPF_X:
+	case BPF_JMP | BPF_JSLT | BPF_X:
+	case BPF_JMP | BPF_JSGE | BPF_X:
+	case BPF_JMP | BPF_JSLE | BPF_X:
+		rs = src;
+emit_cond_jmp:
+		/* RISC-V only has "less than" and "greater or equal" forms */
+		switch (BPF_OP(code)) {
+		case BPF_JEQ:
+			cond = RV_COND_EQ;
+			break;
+		case BPF_JSET:
+		case BPF_JNE:
+			cond = RV_COND_NE;
+			break;
+		case BPF_JGT:
+			cond = RV_COND_LTU;
+			swap(dst, rs);
+			break;
+		case BPF_JLT:
+			cond = RV_COND_LTU;
+			break;
+		case BPF_JGE:
+			cond = RV_COND_GEU;
+			break;
+		case BPF_JLE:
+			cond = RV_COND_GEU;
+			swap(dst, rs);
+			break;
+		case BPF_JSGT:
+			cond = RV_COND_LT;
+			swap(dst, rs);
+			break;
+		case BPF_JSLT:
+			cond = RV_COND_LT;
+			break;
+		case BPF_JSGE:
+			cond = RV_COND_GE;
+			break;
+		case BPF_JSLE:
+			cond = RV_COND_GE;
+			swap(dst, rs);
+			break;
+		default:
+			return -EFAULT;
+		}
+		return emit_branch(cond, dst, rs, bpf2rv_target(i, off, ctx),
+				   ctx);
+	case BPF_JMP | BPF_JSET | BPF_X:
+		emit(rv_and(tmp, dst, src), ctx);
+		dst = tmp;
+		rs = RV_REG_ZERO;
+		goto emit_cond_jmp;
+	/* IF (dst COND imm) JUMP off */
+	case BPF_JMP | BPF_JEQ | BPF_K:
+	case BPF_JMP | BPF_JGT | BPF_K:
+	case BPF_JMP | BPF_JLT | BPF_K:
+	case BPF_JMP | BPF_JGE | BPF_K:
+	case BPF_JMP | BPF_JLE | BPF_K:
+	case BPF_JMP | BPF_JNE | BPF_K:
+	case BPF_JMP | BPF_JSGT | BPF_K:
+	case BPF_JMP | BPF_JSLT | BPF_K:
+	case BPF_JMP | BPF_JSGE | BPF_K:
+	case BPF_JMP | BPF_JSLE | BPF_K:
+		rs = RV_REG_ZERO;
+		if (imm) {
+			emit_imm(tmp, imm, ctx);
+			rs = tmp;
+		}
+		goto emit_cond_jmp;
+	case BPF_JMP | BPF_JSET | BPF_K:
+		if (is_12b_int(imm)) {
+			emit(rv_andi(tmp, dst, imm), ctx);
+		} else {
+			emit_imm(tmp, imm, ctx);
+			emit(rv_and(tmp, dst, tmp), ctx);
+		}
+		dst = tmp;
+		rs = RV_REG_ZERO;
+		goto emit_cond_jmp;
+	/* function call */
+	case BPF_JMP | BPF_CALL:
+	{
+		const u8 r0 = bpf2rv[BPF_REG_0];
+		const u64 func = (u64)__bpf_call_base + imm;
+
+		emit_imm(tmp, func, ctx);
+		emit(rv_jalr(RV_REG_RA, tmp, 0), ctx);
+		emit_mv(r0, RV_REG_A0, ctx);
+		break;
+	}
+	/* tail call */
+	case BPF_JMP | BPF_TAIL_CALL:
+		if (emit_bpf_tail_call(ctx))
+			return -EFAULT;
+		break;
+	/* function return */
+	case BPF_JMP | BPF_EXIT:
+		/* Optimization: when last instruction is EXIT,
+		   simply fallthrough to epilogue. */
+		if (i == ctx->prog->len - 1)
+			break;
+		return emit_jump(epilogue_offset(ctx), ctx);
+
+	/* dst = imm64 */
+	case BPF_LD | BPF_IMM | BPF_DW:
+	{
+		const struct bpf_insn insn1 = insn[1];
+		u64 imm64;
+
+		imm64 = (u64)insn1.imm << 32 | (u32)imm;
+		emit_imm(dst, imm64, ctx);
+
+		return 1;
+	}
+
+	/* LDX: dst = *(size *)(src + off) */
+	case BPF_LDX | BPF_MEM | BPF_W:
+	case BPF_LDX | BPF_MEM | BPF_H:
+	case BPF_LDX | BPF_MEM | BPF_B:
+	case BPF_LDX | BPF_MEM | BPF_DW:
+		emit_load(BPF_SIZE(code), dst, src, off, tmp, ctx);
+		break;
+
+	/* ST: *(size *)(dst + off) = imm */
+	case BPF_ST | BPF_MEM | BPF_W:
+	case BPF_ST | BPF_MEM | BPF_H:
+	case BPF_ST | BPF_MEM | BPF_B:
+	case BPF_ST | BPF_MEM | BPF_DW:
+		/* Load imm to a register then store it */
+		emit_imm(tmp2, imm, ctx);
+		emit_store(BPF_SIZE(code), dst, off, tmp2, tmp, ctx);
+		break;
+
+	/* STX: *(size *)(dst + off) = src */
+	case BPF_STX | BPF_MEM | BPF_W:
+	case BPF_STX | BPF_MEM | BPF_H:
+	case BPF_STX | BPF_MEM | BPF_B:
+	case BPF_STX | BPF_MEM | BPF_DW:
+		emit_store(BPF_SIZE(code), dst, off, src, tmp, ctx);
+		break;
+	/* STX XADD: lock *(u32 *)(dst + off) += src */
+	case BPF_STX | BPF_XADD | BPF_W:
+	/* STX XADD: lock *(u64 *)(dst + off) += src */
+	case BPF_STX | BPF_XADD | BPF_DW:
+		if (is_12b_int(off)) {
+			emit(rv_addi(tmp, dst, off), ctx);
+		} else {
+			emit_imm(tmp, off, ctx);
+			emit(rv_add(tmp, tmp, dst), ctx);
+		}
+		emit(BPF_SIZE(code) == BPF_W ?
+		     rv_amoadd_w(RV_REG_ZERO, src, tmp) :
+		     rv_amoadd_d(RV_REG_ZERO, src, tmp), ctx);
+		break;
+
+	/* R0 = ntohx(*(size *)(((struct sk_buff *)R6)->data + imm)) */
+	case BPF_LD | BPF_ABS | BPF_W:
+	case BPF_LD | BPF_ABS | BPF_H:
+	case BPF_LD | BPF_ABS | BPF_B:
+	/* R0 = ntohx(*(size *)(((struct sk_buff *)R6)->data + src + imm)) */
+	case BPF_LD | BPF_IND | BPF_W:
+	case BPF_LD | BPF_IND | BPF_H:
+	case BPF_LD | BPF_IND | BPF_B:
+	{
+		const u8 r0 = bpf2rv[BPF_REG_0]; /* r0 = return value */
+		const u8 r6 = bpf2rv[BPF_REG_6]; /* r6 = pointer to sk_buff */
+		const u8 r1 = bpf2rv[BPF_REG_1]; /* r1: struct sk_buff *skb */
+		const u8 r2 = bpf2rv[BPF_REG_2]; /* r2: int k */
+		const u8 r3 = bpf2rv[BPF_REG_3]; /* r3: unsigned int size */
+		const u8 r4 = bpf2rv[BPF_REG_4]; /* r4: void *buffer */
+		int size;
+
+		switch (BPF_SIZE(code)) {
+		case BPF_W:
+			size = 4;
+			break;
+		case BPF_H:
+			size = 2;
+			break;
+		case BPF_B:
+			size = 1;
+			break;
+		default:
+			return -EINVAL;
+		}
+
+		/* src may be one of the argument registers: use it first */
+		if (BPF_MODE(code) == BPF_IND) {
+			emit_imm(tmp, imm, ctx);
+			emit(rv_addw(r2, tmp, src), ctx);
+		} else {
+			emit_imm(r2, imm, ctx);
+		}
+		emit_mv(r1, r6, ctx);
+		emit_imm(r3, size, ctx);
+		/* The scratchpad sits at the bottom of the frame */
+		emit_mv(r4, RV_REG_SP, ctx);
+		emit_imm(tmp, (unsigned long)bpf_load_pointer, ctx);
+		emit(rv_jalr(RV_REG_RA, tmp, 0), ctx);
+		emit_mv(r0, RV_REG_A0, ctx);
+
+		ret = emit_branch(RV_COND_EQ, r0, RV_REG_ZERO,
+				  epilogue_offset(ctx), ctx);
+		if (ret)
+			return ret;
+
+		emit_load(BPF_SIZE(code), r0, r0, 0, tmp, ctx);
+		if (size > 1)
+			emit_rev(r0, size, tmp, tmp2, ctx);
+		break;
+	}
+	default:
+		pr_err_once("unknown opcode %02x\n", code);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int build_body(struct jit_ctx *ctx)
+{
+	const struct bpf_prog *prog = ctx->prog;
+	int i;
+
+	for (i = 0; i < prog->len; i++) {
+		const struct bpf_insn *insn = &prog->insnsi[i];
+		int ret;
+
+		if (ctx->image == NULL)
+			ctx->offset[i] = ctx->idx;
+		ret = build_insn(insn, ctx);
+		if (ret > 0) {
+			i++;
+			if (ctx->image == NULL)
+				ctx->offset[i] = ctx->idx;
+			continue;
+		}
+		if (ret)
+			return ret;
+	}
+	if (ctx->image == NULL)
+		ctx->offset[i] = ctx->idx;
+
+	return 0;
+}
+
+static int validate_code(struct jit_ctx *ctx)
+{
+	int i;
+
+	for (i = 0; i < ctx->idx; i++) {
+		if (ctx->image[i] == RV_INSN_EBREAK)
+			return -1;
+	}
+
+	return 0;
+}
+
+static inline void bpf_flush_icache(void *start, void *end)
+{
+	flush_icache_range((unsigned long)start, (unsigned long)end);
+}
+
+/* Passes allowed for the branch sizes to settle */
+#define NR_JIT_ITERATIONS	16
+
+struct bpf_prog *bpf_int_jit_compile(struct bpf_prog *prog)
+{
+	struct bpf_prog *tmp, *orig_prog = prog;
+	struct bpf_binary_header *header;
+	bool tmp_blinded = false;
+	struct jit_ctx ctx;
+	int image_size, prev_idx = 0;
+	u8 *image_ptr;
+	int pass;
+
+	if (!bpf_jit_enable)
+		return orig_prog;
+
+	tmp = bpf_jit_blind_constants(prog);
+	/* If blinding was requested and we failed during blinding,
+	 * we must fall back to the interpreter.
+	 */
+	if (IS_ERR(tmp))
+		return orig_prog;
+	if (tmp != prog) {
+		tmp_blinded = true;
+		prog = tmp;
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.prog = prog;
+
+	ctx.offset = kcalloc(prog->len + 1, sizeof(int), GFP_KERNEL);
+	if (ctx.offset == NULL) {
+		prog = orig_prog;
+		goto out;
+	}
+
+	/* Saved registers, BPF stack and 8 bytes for the skb buffer */
+	ctx.stack_size = STACK_ALIGN(SAVED_REGS_SIZE +
+				     round_up(prog->aux->stack_depth, 8) + 8);
+
+	/*
+	 * 1. Fake passes to compute ctx->idx and fill in ctx->offset,
+	 *    until the branch sizes stop shrinking.
+	 */
+	for (pass = 0; pass < NR_JIT_ITERATIONS; pass++) {
+		ctx.idx = 0;
+		build_prologue(&ctx);
+		if (build_body(&ctx)) {
+			prog = orig_prog;
+			goto out_off;
+		}
+		build_epilogue(&ctx);
+
+		if (ctx.idx == prev_idx)
+			break;
+		prev_idx = ctx.idx;
+	}
+
+	/* Now we know the actual image size. */
+	image_size = sizeof(u32) * ctx.idx;
+	header = bpf_jit_binary_alloc(image_size, &image_ptr,
+				      sizeof(u32), jit_fill_hole);
+	if (header == NULL) {
+		prog = orig_prog;
+		goto out_off;
+	}
+
+	/* 2. Now, the actual pass. */
+
+	ctx.image = (u32 *)image_ptr;
+	ctx.idx = 0;
+
+	build_prologue(&ctx);
+
+	if (build_body(&ctx)) {
+		bpf_jit_binary_free(header);
+		prog = orig_prog;
+		goto out_off;
+	}
+
+	build_epilogue(&ctx);
+
+	/* 3. Extra pass to validate JITed code. */
+	if (ctx.idx != prev_idx || validate_code(&ctx)) {
+		bpf_jit_binary_free(header);
+		prog = orig_prog;
+		goto out_off;
+	}
+
+	/* And we're done. */
+	if (bpf_jit_enable > 1)
+		bpf_jit_dump(prog->len, image_size, 2, ctx.image);
+
+	bpf_flush_icache(header, ctx.image + ctx.idx);
+
+	bpf_jit_binary_lock_ro(header);
+	prog->bpf_func = (void *)ctx.image;
+	prog->jited = 1;
+	prog->jited_len = image_size;
+
+out_off:
+	kfree(ctx.offset);
+out:
+	if (tmp_blinded)
+		bpf_jit_prog_release_other(prog, prog == orig_prog ?
+					   tmp : orig_prog);
+	return prog;
+}
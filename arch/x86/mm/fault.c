@@ -1364,6 +1364,17 @@ __do_page_fault(struct pt_regs *regs, unsigned long error_code,
 	if (error_code & PF_INSTR)
 		flags |= FAULT_FLAG_INSTRUCTION;
 
+	/*
+	 * Try to handle the fault without mmap_sem first.  Anything that
+	 * path cannot complete, errors included, is reported back as
+	 * VM_FAULT_RETRY and handled below as if it never happened.
+	 */
+	fault = handle_speculative_fault(mm, address, flags);
+	if (!(fault & VM_FAULT_RETRY)) {
+		major |= fault & VM_FAULT_MAJOR;
+		goto done;
+	}
+
 	/*
 	 * When running in the kernel we expect faults to occur only to
 	 * addresses in user space.  All other faults represent errors in
@@ -1474,6 +1485,7 @@ __do_page_fault(struct pt_regs *regs, unsigned long error_code,
 		return;
 	}
 
+done:
 	/*
 	 * Major/minor page fault accounting. If any of the events
 	 * returned VM_FAULT_MAJOR, we account it as a major fault.
@@ -1829,6 +1829,9 @@ void bio_endio(struct bio *bio)
 	if (!bio_integrity_endio(bio))
 		return;
 
+	/* before chaining on, a completed child bio is done all the same */
+	blkcg_iolatency_done_bio(bio);
+
 	/*
 	 * Need to have a real endio function for chained bios, otherwise
 	 * various corner cases will break (like stacking block devices that
@@ -326,6 +326,7 @@ static bool blk_kick_flush(struct request_queue *q, struct blk_flush_queue *fq)
 		struct blk_mq_hw_ctx *hctx;
 
 		flush_rq->mq_ctx = first_rq->mq_ctx;
+		flush_rq->mq_hctx = first_rq->mq_hctx;
 		flush_rq->tag = first_rq->tag;
 		fq->orig_rq = first_rq;
 
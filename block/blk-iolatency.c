@@ -0,0 +1,567 @@
+/*
+ * Block rq depth based latency protection for cgroups
+ *
+ * A cgroup is given a completion latency target for a device by writing
+ * "MAJ:MIN target=<usec>" to its io.latency file.  Completion latencies
+ * of the bios it issues are sampled over a window that is sixteen times
+ * the target, clamped to [100ms, 1s].  A window in which more than a
+ * tenth of the samples took longer than the target, i.e. one whose p90
+ * latency is above it, counts as a miss.
+ *
+ * A miss is signalled to the siblings of the group through the scale
+ * cookie of their common parent.  Each decrement of the cookie halves
+ * the queue depth of every sibling that does not have a target at least
+ * as strict as the one being protected, down to a depth of one.  Every
+ * window that meets the target increments the cookie again, doubling
+ * the depth of the siblings until they are unthrottled once the cookie
+ * is back to its default.  If the protected group goes idle the cookie
+ * walks back on its own, one step per second.
+ *
+ * Limits apply at each level of the hierarchy on the way up from the
+ * group a bio was issued from, the root group is never limited.  Only
+ * blk-mq queues are throttled.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/blk-cgroup.h>
+#include "blk.h"
+#include "blk-wbt.h"
+
+#define DEFAULT_SCALE_COOKIE	1000000U
+#define MAX_SCALE_STEPS		16
+#define MIN_WINDOW_SAMPLES	5
+#define MIN_WINDOW_NSEC		(100ULL * NSEC_PER_MSEC)
+#define MAX_WINDOW_NSEC		NSEC_PER_SEC
+#define IDLE_STEP_NSEC		NSEC_PER_SEC
+
+static struct blkcg_policy blkcg_policy_iolatency;
+
+struct blk_iolatency {
+	struct request_queue *q;
+	/* number of groups on @q with a latency target */
+	atomic_t enabled;
+};
+
+struct latency_stat {
+	u64 total;
+	u64 missed;
+};
+
+struct iolatency_grp {
+	struct blkg_policy_data pd;
+	struct blk_iolatency *blkiolat;
+
+	/* depth limit of the group, UINT_MAX when not scaled */
+	unsigned int max_depth;
+	struct rq_wait rq_wait;
+	/* last scale cookie of the parent acted upon */
+	atomic_t seen_cookie;
+
+	/* latency target, 0 if there is none */
+	u64 min_lat_nsec;
+	u64 cur_win_nsec;
+	atomic64_t window_start;
+	struct latency_stat __percpu *stats;
+	u64 win_total;
+	u64 win_missed;
+
+	/* state for scaling the children, see iolatency_scale_down() */
+	spinlock_t child_lock;
+	atomic_t scale_cookie;
+	u64 scale_lat;
+	u64 scale_time;
+};
+
+static inline struct iolatency_grp *pd_to_lat(struct blkg_policy_data *pd)
+{
+	return pd ? container_of(pd, struct iolatency_grp, pd) : NULL;
+}
+
+static inline struct iolatency_grp *blkg_to_lat(struct blkcg_gq *blkg)
+{
+	return pd_to_lat(blkg_to_pd(blkg, &blkcg_policy_iolatency));
+}
+
+static inline struct blkcg_gq *lat_to_blkg(struct iolatency_grp *iolat)
+{
+	return pd_to_blkg(&iolat->pd);
+}
+
+static bool iolat_inc_below(atomic_t *v, unsigned int below)
+{
+	unsigned int cur = atomic_read(v);
+
+	for (;;) {
+		unsigned int old;
+
+		if (cur >= below)
+			return false;
+		old = atomic_cmpxchg(v, cur, cur + 1);
+		if (old == cur)
+			break;
+		cur = old;
+	}
+	return true;
+}
+
+static void iolatency_set_depth(struct iolatency_grp *iolat,
+				unsigned int depth)
+{
+	unsigned int old = READ_ONCE(iolat->max_depth);
+
+	WRITE_ONCE(iolat->max_depth, depth);
+	if (depth > old)
+		wake_up_all(&iolat->rq_wait.wait);
+}
+
+/*
+ * One step of the parent's cookie back towards the default.  Called with
+ * @parent->child_lock held.
+ */
+static void __iolatency_step_up(struct iolatency_grp *parent, u64 now)
+{
+	if (atomic_read(&parent->scale_cookie) == DEFAULT_SCALE_COOKIE)
+		return;
+	if (atomic_inc_return(&parent->scale_cookie) == DEFAULT_SCALE_COOKIE)
+		parent->scale_lat = 0;
+	parent->scale_time = now;
+}
+
+static void iolatency_scale_down(struct iolatency_grp *parent, u64 lat,
+				 u64 now)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&parent->child_lock, flags);
+	/* a miss of a looser target than the protected one is ignored */
+	if (!parent->scale_lat || lat <= parent->scale_lat) {
+		parent->scale_lat = lat;
+		if (atomic_read(&parent->scale_cookie) >
+		    DEFAULT_SCALE_COOKIE - MAX_SCALE_STEPS)
+			atomic_dec(&parent->scale_cookie);
+		parent->scale_time = now;
+	}
+	spin_unlock_irqrestore(&parent->child_lock, flags);
+}
+
+static void iolatency_scale_up(struct iolatency_grp *parent, u64 lat,
+			       u64 now)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&parent->child_lock, flags);
+	if (parent->scale_lat == lat)
+		__iolatency_step_up(parent, now);
+	spin_unlock_irqrestore(&parent->child_lock, flags);
+}
+
+static void iolatency_clear_scale(struct iolatency_grp *parent, u64 lat)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&parent->child_lock, flags);
+	if (parent->scale_lat == lat) {
+		atomic_set(&parent->scale_cookie, DEFAULT_SCALE_COOKIE);
+		parent->scale_lat = 0;
+	}
+	spin_unlock_irqrestore(&parent->child_lock, flags);
+}
+
+/*
+ * Apply the changes of the parent's scale cookie since the last time
+ * @iolat looked at it to the depth of @iolat.
+ */
+static void iolatency_check_scale(struct iolatency_grp *iolat,
+				  struct iolatency_grp *parent, u64 now)
+{
+	struct request_queue *q = lat_to_blkg(iolat)->q;
+	unsigned int depth;
+	int old, cur;
+
+	cur = atomic_read(&parent->scale_cookie);
+	if (cur != DEFAULT_SCALE_COOKIE &&
+	    now - READ_ONCE(parent->scale_time) > IDLE_STEP_NSEC) {
+		unsigned long flags;
+
+		spin_lock_irqsave(&parent->child_lock, flags);
+		if (now - parent->scale_time > IDLE_STEP_NSEC)
+			__iolatency_step_up(parent, now);
+		spin_unlock_irqrestore(&parent->child_lock, flags);
+		cur = atomic_read(&parent->scale_cookie);
+	}
+
+	old = atomic_read(&iolat->seen_cookie);
+	if (cur == old || atomic_cmpxchg(&iolat->seen_cookie, old, cur) != old)
+		return;
+
+	if (cur == DEFAULT_SCALE_COOKIE ||
+	    (iolat->min_lat_nsec &&
+	     iolat->min_lat_nsec <= READ_ONCE(parent->scale_lat))) {
+		iolatency_set_depth(iolat, UINT_MAX);
+		return;
+	}
+
+	depth = READ_ONCE(iolat->max_depth);
+	if (cur < old) {
+		if (depth == UINT_MAX)
+			depth = q->nr_requests;
+		depth = max(depth >> 1, 1U);
+	} else if (depth != UINT_MAX) {
+		depth <<= 1;
+		if (depth >= q->nr_requests)
+			depth = UINT_MAX;
+	}
+	iolatency_set_depth(iolat, depth);
+}
+
+static void __iolatency_throttle(struct iolatency_grp *iolat)
+{
+	struct rq_wait *rqw = &iolat->rq_wait;
+	DEFINE_WAIT(wait);
+
+	if (iolat_inc_below(&rqw->inflight, READ_ONCE(iolat->max_depth)))
+		return;
+
+	do {
+		prepare_to_wait_exclusive(&rqw->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+		if (iolat_inc_below(&rqw->inflight,
+				    READ_ONCE(iolat->max_depth)))
+			break;
+		io_schedule();
+	} while (1);
+
+	finish_wait(&rqw->wait, &wait);
+}
+
+/**
+ * blkcg_iolatency_throttle - wait for room at each level of the hierarchy
+ * @q: the request_queue @bio is being submitted to
+ * @bio: the bio
+ *
+ * Called from the make_request function of blk-mq before a request is
+ * allocated for @bio.  May sleep.
+ */
+void blkcg_iolatency_throttle(struct request_queue *q, struct bio *bio)
+{
+	struct blkcg_gq *blkg, *leaf;
+	u64 now;
+
+	if (!q->blkiolat || !atomic_read(&q->blkiolat->enabled))
+		return;
+	/* metadata may be waited upon by everybody, don't hold it back */
+	if (bio->bi_opf & REQ_META)
+		return;
+
+	rcu_read_lock();
+	leaf = blkg_lookup(bio_blkcg(bio), q);
+	if (!leaf || !leaf->parent || !blkg_tryget(leaf)) {
+		rcu_read_unlock();
+		return;
+	}
+	rcu_read_unlock();
+
+	now = ktime_get_ns();
+	for (blkg = leaf; blkg->parent; blkg = blkg->parent) {
+		struct iolatency_grp *iolat = blkg_to_lat(blkg);
+
+		iolatency_check_scale(iolat, blkg_to_lat(blkg->parent), now);
+		__iolatency_throttle(iolat);
+	}
+
+	bio->bi_iolat_blkg = leaf;
+	bio->bi_iolat_start = ktime_get_ns();
+}
+
+static void iolatency_check_window(struct iolatency_grp *iolat, u64 now)
+{
+	struct blkcg_gq *blkg = lat_to_blkg(iolat);
+	u64 start = atomic64_read(&iolat->window_start);
+	u64 total = 0, missed = 0, samples;
+	int cpu;
+
+	if (now - start < iolat->cur_win_nsec ||
+	    atomic64_cmpxchg(&iolat->window_start, start, now) != start)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct latency_stat *s = per_cpu_ptr(iolat->stats, cpu);
+
+		total += READ_ONCE(s->total);
+		missed += READ_ONCE(s->missed);
+	}
+
+	samples = total - iolat->win_total;
+	if (samples < MIN_WINDOW_SAMPLES)
+		return;
+
+	if ((missed - iolat->win_missed) * 10 > samples)
+		iolatency_scale_down(blkg_to_lat(blkg->parent),
+				     iolat->min_lat_nsec, now);
+	else
+		iolatency_scale_up(blkg_to_lat(blkg->parent),
+				   iolat->min_lat_nsec, now);
+
+	iolat->win_total = total;
+	iolat->win_missed = missed;
+}
+
+/**
+ * blkcg_iolatency_done_bio - account the completion of a throttled bio
+ * @bio: the bio
+ *
+ * Called from bio_endio(), possibly in interrupt context.
+ */
+void blkcg_iolatency_done_bio(struct bio *bio)
+{
+	struct blkcg_gq *blkg, *leaf = bio->bi_iolat_blkg;
+	u64 now, lat;
+
+	if (!leaf)
+		return;
+	bio->bi_iolat_blkg = NULL;
+
+	now = ktime_get_ns();
+	lat = now > bio->bi_iolat_start ? now - bio->bi_iolat_start : 0;
+
+	for (blkg = leaf; blkg->parent; blkg = blkg->parent) {
+		struct iolatency_grp *iolat = blkg_to_lat(blkg);
+		struct rq_wait *rqw = &iolat->rq_wait;
+		u64 target = READ_ONCE(iolat->min_lat_nsec);
+
+		atomic_dec(&rqw->inflight);
+		if (waitqueue_active(&rqw->wait))
+			wake_up(&rqw->wait);
+
+		if (!target)
+			continue;
+
+		this_cpu_inc(iolat->stats->total);
+		if (lat > target)
+			this_cpu_inc(iolat->stats->missed);
+		iolatency_check_window(iolat, now);
+	}
+
+	blkg_put(leaf);
+}
+
+static u64 iolatency_prfill_target(struct seq_file *sf,
+				   struct blkg_policy_data *pd, int off)
+{
+	struct iolatency_grp *iolat = pd_to_lat(pd);
+	const char *dname = blkg_dev_name(pd->blkg);
+
+	if (!dname || !iolat->min_lat_nsec)
+		return 0;
+	seq_printf(sf, "%s target=%llu\n", dname,
+		   div_u64(iolat->min_lat_nsec, NSEC_PER_USEC));
+	return 0;
+}
+
+static int iolatency_print_target(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)),
+			  iolatency_prfill_target, &blkcg_policy_iolatency,
+			  seq_cft(sf)->private, false);
+	return 0;
+}
+
+static void iolatency_set_target(struct iolatency_grp *iolat, u64 lat_nsec)
+{
+	struct blkcg_gq *blkg = lat_to_blkg(iolat);
+	u64 old = iolat->min_lat_nsec;
+
+	if (old == lat_nsec)
+		return;
+
+	if (old) {
+		iolatency_clear_scale(blkg_to_lat(blkg->parent), old);
+		if (!lat_nsec)
+			atomic_dec(&iolat->blkiolat->enabled);
+	} else {
+		atomic_inc(&iolat->blkiolat->enabled);
+	}
+
+	iolat->cur_win_nsec = clamp_t(u64, lat_nsec * 16, MIN_WINDOW_NSEC,
+				      MAX_WINDOW_NSEC);
+	WRITE_ONCE(iolat->min_lat_nsec, lat_nsec);
+}
+
+static ssize_t iolatency_set_limit(struct kernfs_open_file *of, char *buf,
+				   size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct blkg_conf_ctx ctx;
+	u64 lat_nsec;
+	int ret;
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_iolatency, buf, &ctx);
+	if (ret)
+		return ret;
+
+	lat_nsec = blkg_to_lat(ctx.blkg)->min_lat_nsec;
+	while (true) {
+		char tok[27];	/* target=18446744073709551616 */
+		char *p;
+		u64 val;
+		int len;
+
+		if (sscanf(ctx.body, "%26s%n", tok, &len) != 1)
+			break;
+		if (tok[0] == '\0')
+			break;
+		ctx.body += len;
+
+		ret = -EINVAL;
+		p = tok;
+		strsep(&p, "=");
+		if (!p || strcmp(tok, "target"))
+			goto out_finish;
+
+		if (!strcmp(p, "max")) {
+			lat_nsec = 0;
+		} else {
+			if (sscanf(p, "%llu", &val) != 1)
+				goto out_finish;
+			ret = -ERANGE;
+			if (!val || val > U64_MAX / NSEC_PER_USEC)
+				goto out_finish;
+			lat_nsec = val * NSEC_PER_USEC;
+		}
+	}
+
+	iolatency_set_target(blkg_to_lat(ctx.blkg), lat_nsec);
+	ret = 0;
+out_finish:
+	blkg_conf_finish(&ctx);
+	return ret ?: nbytes;
+}
+
+static size_t iolatency_pd_stat(struct blkg_policy_data *pd, char *buf,
+				size_t size)
+{
+	struct iolatency_grp *iolat = pd_to_lat(pd);
+	unsigned int depth = READ_ONCE(iolat->max_depth);
+	u64 total = 0, missed = 0;
+	int cpu;
+
+	if (!iolat->min_lat_nsec && depth == UINT_MAX)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		struct latency_stat *s = per_cpu_ptr(iolat->stats, cpu);
+
+		total += READ_ONCE(s->total);
+		missed += READ_ONCE(s->missed);
+	}
+
+	if (depth == UINT_MAX)
+		return scnprintf(buf, size,
+				 " depth=max lat_total=%llu lat_missed=%llu",
+				 total, missed);
+	return scnprintf(buf, size, " depth=%u lat_total=%llu lat_missed=%llu",
+			 depth, total, missed);
+}
+
+static struct blkg_policy_data *iolatency_pd_alloc(gfp_t gfp, int node)
+{
+	struct iolatency_grp *iolat;
+
+	iolat = kzalloc_node(sizeof(*iolat), gfp, node);
+	if (!iolat)
+		return NULL;
+	iolat->stats = alloc_percpu_gfp(struct latency_stat, gfp);
+	if (!iolat->stats) {
+		kfree(iolat);
+		return NULL;
+	}
+	return &iolat->pd;
+}
+
+static void iolatency_pd_init(struct blkg_policy_data *pd)
+{
+	struct iolatency_grp *iolat = pd_to_lat(pd);
+	struct blkcg_gq *blkg = lat_to_blkg(iolat);
+
+	iolat->blkiolat = blkg->q->blkiolat;
+	iolat->max_depth = UINT_MAX;
+	init_waitqueue_head(&iolat->rq_wait.wait);
+	atomic_set(&iolat->rq_wait.inflight, 0);
+	atomic_set(&iolat->seen_cookie, DEFAULT_SCALE_COOKIE);
+	atomic64_set(&iolat->window_start, ktime_get_ns());
+	spin_lock_init(&iolat->child_lock);
+	atomic_set(&iolat->scale_cookie, DEFAULT_SCALE_COOKIE);
+}
+
+static void iolatency_pd_offline(struct blkg_policy_data *pd)
+{
+	struct iolatency_grp *iolat = pd_to_lat(pd);
+
+	iolatency_set_target(iolat, 0);
+	iolatency_set_depth(iolat, UINT_MAX);
+}
+
+static void iolatency_pd_free(struct blkg_policy_data *pd)
+{
+	struct iolatency_grp *iolat = pd_to_lat(pd);
+
+	free_percpu(iolat->stats);
+	kfree(iolat);
+}
+
+static struct cftype iolatency_files[] = {
+	{
+		.name = "latency",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = iolatency_print_target,
+		.write = iolatency_set_limit,
+	},
+	{ }	/* terminate */
+};
+
+static struct blkcg_policy blkcg_policy_iolatency = {
+	.dfl_cftypes		= iolatency_files,
+
+	.pd_alloc_fn		= iolatency_pd_alloc,
+	.pd_init_fn		= iolatency_pd_init,
+	.pd_offline_fn		= iolatency_pd_offline,
+	.pd_free_fn		= iolatency_pd_free,
+	.pd_stat_fn		= iolatency_pd_stat,
+};
+
+int blk_iolatency_init(struct request_queue *q)
+{
+	struct blk_iolatency *blkiolat;
+	int ret;
+
+	blkiolat = kzalloc_node(sizeof(*blkiolat), GFP_KERNEL, q->node);
+	if (!blkiolat)
+		return -ENOMEM;
+
+	blkiolat->q = q;
+	q->blkiolat = blkiolat;
+
+	ret = blkcg_activate_policy(q, &blkcg_policy_iolatency);
+	if (ret) {
+		q->blkiolat = NULL;
+		kfree(blkiolat);
+	}
+	return ret;
+}
+
+void blk_iolatency_exit(struct request_queue *q)
+{
+	blkcg_deactivate_policy(q, &blkcg_policy_iolatency);
+	kfree(q->blkiolat);
+	q->blkiolat = NULL;
+}
+
+static int __init iolatency_init(void)
+{
+	return blkcg_policy_register(&blkcg_policy_iolatency);
+}
+
+module_init(iolatency_init);
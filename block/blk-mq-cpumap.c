@@ -38,7 +38,7 @@ static int get_first_sibling(unsigned int cpu)
 int blk_mq_map_queues(struct blk_mq_tag_set *set)
 {
 	unsigned int *map = set->mq_map;
-	unsigned int nr_queues = set->nr_hw_queues;
+	unsigned int nr_queues = blk_mq_nr_default_queues(set);
 	unsigned int cpu, first_sibling;
 
 	for_each_possible_cpu(cpu) {
@@ -63,6 +63,23 @@ int blk_mq_map_queues(struct blk_mq_tag_set *set)
 }
 EXPORT_SYMBOL_GPL(blk_mq_map_queues);
 
+/*
+ * Spread the CPUs over the poll queues, which come after the queues
+ * blk_mq_map_queues() or the driver's ->map_queues() handed out.
+ */
+void blk_mq_map_poll_queues(struct blk_mq_tag_set *set)
+{
+	unsigned int first = blk_mq_nr_default_queues(set);
+	unsigned int cpu;
+
+	if (!set->nr_poll_queues)
+		return;
+
+	for_each_possible_cpu(cpu)
+		set->mq_poll_map[cpu] = first +
+			cpu_to_queue_index(set->nr_poll_queues, cpu);
+}
+
 /*
  * We have no quick way of doing reverse lookups. This is only used at
  * queue init time, so runtime isn't important.
@@ -23,6 +23,7 @@
 #include "blk-mq.h"
 #include "blk-mq-debugfs.h"
 #include "blk-mq-tag.h"
+#include "blk-stat.h"
 
 static int blk_flags_show(struct seq_file *m, const unsigned long flags,
 			  const char *const *flag_name, int flag_name_count)
@@ -409,7 +410,7 @@ static void hctx_show_busy_rq(struct request *rq, void *data, bool reserved)
 {
 	const struct show_busy_params *params = data;
 
-	if (blk_mq_map_queue(rq->q, rq->mq_ctx->cpu) == params->hctx &&
+	if (rq->mq_hctx == params->hctx &&
 	    test_bit(REQ_ATOM_STARTED, &rq->atomic_flags))
 		__blk_mq_debugfs_rq_show(params->m,
 					 list_entry_rq(&rq->queuelist));
@@ -566,6 +567,37 @@ static ssize_t hctx_dispatched_write(void *data, const char __user *buf,
 	return count;
 }
 
+#ifdef CONFIG_BLK_MQ_LAT_HIST
+static int hctx_latency_hist_show(void *data, struct seq_file *m)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+	struct blk_mq_lat_hist hist;
+	int i;
+
+	blk_mq_lat_hist_read(hctx, &hist);
+
+	seq_printf(m, "%8u\t%lu\t%lu\n", 0U, hist.buckets[0][0],
+		   hist.buckets[1][0]);
+
+	for (i = 1; i < BLK_MQ_LAT_HIST_BUCKETS - 1; i++)
+		seq_printf(m, "%8u\t%lu\t%lu\n", 1U << (i - 1),
+			   hist.buckets[0][i], hist.buckets[1][i]);
+
+	seq_printf(m, "%8u+\t%lu\t%lu\n", 1U << (i - 1),
+		   hist.buckets[0][i], hist.buckets[1][i]);
+	return 0;
+}
+
+static ssize_t hctx_latency_hist_write(void *data, const char __user *buf,
+				       size_t count, loff_t *ppos)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+
+	blk_mq_lat_hist_reset(hctx);
+	return count;
+}
+#endif
+
 static int hctx_queued_show(void *data, struct seq_file *m)
 {
 	struct blk_mq_hw_ctx *hctx = data;
@@ -770,6 +802,9 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_hctx_attrs[] = {
 	{"sched_tags_bitmap", 0400, hctx_sched_tags_bitmap_show},
 	{"io_poll", 0600, hctx_io_poll_show, hctx_io_poll_write},
 	{"dispatched", 0600, hctx_dispatched_show, hctx_dispatched_write},
+#ifdef CONFIG_BLK_MQ_LAT_HIST
+	{"latency_hist", 0600, hctx_latency_hist_show, hctx_latency_hist_write},
+#endif
 	{"queued", 0600, hctx_queued_show, hctx_queued_write},
 	{"run", 0600, hctx_run_show, hctx_run_write},
 	{"active", 0400, hctx_active_show},
@@ -360,14 +360,16 @@ void blk_mq_sched_insert_request(struct request *rq, bool at_head,
 	struct request_queue *q = rq->q;
 	struct elevator_queue *e = q->elevator;
 	struct blk_mq_ctx *ctx = rq->mq_ctx;
-	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(q, ctx->cpu);
+	struct blk_mq_hw_ctx *hctx = rq->mq_hctx;
 
 	if (rq->tag == -1 && op_is_flush(rq->cmd_flags)) {
 		blk_mq_sched_insert_flush(hctx, rq, can_block);
 		return;
 	}
 
-	if (e && blk_mq_sched_bypass_insert(hctx, rq))
+	/* a poll queue has no software queues to be dispatched from */
+	if ((e || blk_mq_hctx_is_poll(hctx)) &&
+	    blk_mq_sched_bypass_insert(hctx, rq))
 		goto run;
 
 	if (e && e->type->ops.mq.insert_requests) {
@@ -410,6 +412,17 @@ void blk_mq_sched_insert_requests(struct request_queue *q,
 		}
 	}
 
+	/*
+	 * Without a scheduler the requests already own a driver tag, so a
+	 * driver that can take a batch gets the list straight away, unless
+	 * we are flushing from schedule() and must not issue inline.
+	 */
+	if (!e && !run_queue_async && q->mq_ops->queue_rqs) {
+		blk_mq_try_issue_list_directly(hctx, list);
+		if (list_empty(list))
+			return;
+	}
+
 	if (e && e->type->ops.mq.insert_requests)
 		e->type->ops.mq.insert_requests(hctx, list, false);
 	else
@@ -12,6 +12,7 @@
 #include <linux/blk-mq.h>
 #include "blk-mq.h"
 #include "blk-mq-tag.h"
+#include "blk-stat.h"
 
 static void blk_mq_sysfs_release(struct kobject *kobj)
 {
@@ -21,6 +22,7 @@ static void blk_mq_hw_sysfs_release(struct kobject *kobj)
 {
 	struct blk_mq_hw_ctx *hctx = container_of(kobj, struct blk_mq_hw_ctx,
 						  kobj);
+	blk_mq_free_lat_hist(hctx);
 	free_cpumask_var(hctx->cpumask);
 	kfree(hctx->ctxs);
 	kfree(hctx);
@@ -161,6 +163,34 @@ static ssize_t blk_mq_hw_sysfs_cpus_show(struct blk_mq_hw_ctx *hctx, char *page)
 	return ret;
 }
 
+#ifdef CONFIG_BLK_MQ_LAT_HIST
+static ssize_t blk_mq_hw_sysfs_lat_hist_show(struct blk_mq_hw_ctx *hctx,
+					     char *page)
+{
+	static const char * const dir_name[] = { "read", "write" };
+	struct blk_mq_lat_hist hist;
+	ssize_t ret = 0;
+	int dir, i;
+
+	blk_mq_lat_hist_read(hctx, &hist);
+	for (dir = 0; dir < 2; dir++) {
+		ret += sprintf(page + ret, "%s", dir_name[dir]);
+		for (i = 0; i < BLK_MQ_LAT_HIST_BUCKETS; i++)
+			ret += sprintf(page + ret, " %lu",
+				       hist.buckets[dir][i]);
+		ret += sprintf(page + ret, "\n");
+	}
+	return ret;
+}
+
+static ssize_t blk_mq_hw_sysfs_lat_hist_store(struct blk_mq_hw_ctx *hctx,
+					      const char *page, size_t count)
+{
+	blk_mq_lat_hist_reset(hctx);
+	return count;
+}
+#endif
+
 static struct attribute *default_ctx_attrs[] = {
 	NULL,
 };
@@ -177,11 +207,21 @@ static struct blk_mq_hw_ctx_sysfs_entry blk_mq_hw_sysfs_cpus = {
 	.attr = {.name = "cpu_list", .mode = S_IRUGO },
 	.show = blk_mq_hw_sysfs_cpus_show,
 };
+#ifdef CONFIG_BLK_MQ_LAT_HIST
+static struct blk_mq_hw_ctx_sysfs_entry blk_mq_hw_sysfs_lat_hist = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_mq_hw_sysfs_lat_hist_show,
+	.store = blk_mq_hw_sysfs_lat_hist_store,
+};
+#endif
 
 static struct attribute *default_hw_ctx_attrs[] = {
 	&blk_mq_hw_sysfs_nr_tags.attr,
 	&blk_mq_hw_sysfs_nr_reserved_tags.attr,
 	&blk_mq_hw_sysfs_cpus.attr,
+#ifdef CONFIG_BLK_MQ_LAT_HIST
+	&blk_mq_hw_sysfs_lat_hist.attr,
+#endif
 	NULL,
 };
 
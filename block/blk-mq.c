@@ -277,6 +277,7 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 	struct request *rq = tags->static_rqs[tag];
 
 	rq->rq_flags = 0;
+	rq->mq_hctx = data->hctx;
 
 	if (data->flags & BLK_MQ_REQ_INTERNAL) {
 		rq->tag = -1;
@@ -340,10 +341,11 @@ static struct request *blk_mq_get_request(struct request_queue *q,
 
 	blk_queue_enter_live(q);
 	data->q = q;
+	data->cmd_flags = op;
 	if (likely(!data->ctx))
 		data->ctx = local_ctx = blk_mq_get_ctx(q);
 	if (likely(!data->hctx))
-		data->hctx = blk_mq_map_queue(q, data->ctx->cpu);
+		data->hctx = blk_mq_map_queue_op(q, op, data->ctx->cpu);
 	if (op & REQ_NOWAIT)
 		data->flags |= BLK_MQ_REQ_NOWAIT;
 
@@ -460,7 +462,7 @@ void blk_mq_free_request(struct request *rq)
 	struct request_queue *q = rq->q;
 	struct elevator_queue *e = q->elevator;
 	struct blk_mq_ctx *ctx = rq->mq_ctx;
-	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(q, ctx->cpu);
+	struct blk_mq_hw_ctx *hctx = rq->mq_hctx;
 	const int sched_tag = rq->internal_tag;
 
 	if (rq->rq_flags & RQF_ELVPRIV) {
@@ -893,7 +895,7 @@ bool blk_mq_get_driver_tag(struct request *rq, struct blk_mq_hw_ctx **hctx,
 {
 	struct blk_mq_alloc_data data = {
 		.q = rq->q,
-		.hctx = blk_mq_map_queue(rq->q, rq->mq_ctx->cpu),
+		.hctx = rq->mq_hctx,
 		.flags = wait ? 0 : BLK_MQ_REQ_NOWAIT,
 	};
 
@@ -948,7 +950,7 @@ static void blk_mq_put_driver_tag(struct request *rq)
 	if (rq->tag == -1 || rq->internal_tag == -1)
 		return;
 
-	hctx = blk_mq_map_queue(rq->q, rq->mq_ctx->cpu);
+	hctx = rq->mq_hctx;
 	__blk_mq_put_driver_tag(hctx, rq);
 }
 
@@ -1088,6 +1090,13 @@ bool blk_mq_dispatch_rq_list(struct request_queue *q, struct list_head *list)
 
 	hctx->dispatched[queued_to_index(queued)]++;
 
+	/*
+	 * If we stopped short, or the request flagged last failed, the
+	 * driver was never told that the batch it was handed is complete.
+	 */
+	if ((!list_empty(list) || errors) && queued && q->mq_ops->commit_rqs)
+		q->mq_ops->commit_rqs(hctx);
+
 	/*
 	 * Any items that need requeuing? Stuff them into hctx->dispatch,
 	 * that is where we will continue on next queue run.
@@ -1407,8 +1416,7 @@ void __blk_mq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
  */
 void blk_mq_request_bypass_insert(struct request *rq)
 {
-	struct blk_mq_ctx *ctx = rq->mq_ctx;
-	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(rq->q, ctx->cpu);
+	struct blk_mq_hw_ctx *hctx = rq->mq_hctx;
 
 	spin_lock(&hctx->lock);
 	list_add_tail(&rq->queuelist, &hctx->dispatch);
@@ -1595,6 +1603,44 @@ static void blk_mq_try_issue_directly(struct blk_mq_hw_ctx *hctx,
 	}
 }
 
+static void __blk_mq_try_issue_list_directly(struct blk_mq_hw_ctx *hctx,
+					     struct list_head *list)
+{
+	struct request_queue *q = hctx->queue;
+
+	/*
+	 * RCU or SRCU read lock is needed before checking quiesced flag.
+	 * Requests already waiting on ->dispatch must not be overtaken.
+	 */
+	if (blk_mq_hctx_stopped(hctx) || blk_queue_quiesced(q) ||
+	    !list_empty_careful(&hctx->dispatch))
+		return;
+
+	q->mq_ops->queue_rqs(hctx, list);
+}
+
+/*
+ * Hand the requests of a plug to ->queue_rqs() in one go. Whatever the
+ * driver did not take is left on @list for the caller to insert.
+ */
+void blk_mq_try_issue_list_directly(struct blk_mq_hw_ctx *hctx,
+				    struct list_head *list)
+{
+	if (!(hctx->flags & BLK_MQ_F_BLOCKING)) {
+		rcu_read_lock();
+		__blk_mq_try_issue_list_directly(hctx, list);
+		rcu_read_unlock();
+	} else {
+		unsigned int srcu_idx;
+
+		might_sleep();
+
+		srcu_idx = srcu_read_lock(hctx->queue_rq_srcu);
+		__blk_mq_try_issue_list_directly(hctx, list);
+		srcu_read_unlock(hctx->queue_rq_srcu, srcu_idx);
+	}
+}
+
 static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 {
 	const int is_sync = op_is_sync(bio->bi_opf);
@@ -1621,6 +1667,8 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	if (blk_mq_sched_bio_merge(q, bio))
 		return BLK_QC_T_NONE;
 
+	blkcg_iolatency_throttle(q, bio);
+
 	wb_acct = wbt_wait(q->rq_wb, bio, NULL);
 
 	trace_block_getrq(q, bio, bio->bi_opf);
@@ -1648,6 +1696,14 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 			blk_insert_flush(rq);
 			blk_mq_run_hw_queue(data.hctx, true);
 		}
+	} else if (blk_mq_hctx_is_poll(data.hctx)) {
+		/*
+		 * Nothing takes an interrupt for a poll queue, the submitter
+		 * is going to spin on it right away.  Don't plug.
+		 */
+		blk_mq_put_ctx(data.ctx);
+		blk_mq_bio_to_request(rq, bio);
+		blk_mq_try_issue_directly(data.hctx, rq, &cookie);
 	} else if (plug && q->nr_hw_queues == 1) {
 		struct request *last = NULL;
 
@@ -2129,6 +2185,20 @@ static void blk_mq_map_swqueue(struct request_queue *q)
 		cpumask_set_cpu(i, hctx->cpumask);
 		ctx->index_hw = hctx->nr_ctx;
 		hctx->ctxs[hctx->nr_ctx++] = ctx;
+
+		if (!set->nr_poll_queues)
+			continue;
+
+		/*
+		 * A poll queue gets no software queue, requests are issued
+		 * to it directly.  It only needs tags and the cpumask.  If
+		 * the tags can't be had, poll from the default queue.
+		 */
+		hctx_idx = q->mq_poll_map[i];
+		if (!set->tags[hctx_idx] &&
+		    !__blk_mq_alloc_rq_map(set, hctx_idx))
+			q->mq_poll_map[i] = q->mq_map[i];
+		cpumask_set_cpu(i, q->queue_hw_ctx[q->mq_poll_map[i]]->cpumask);
 	}
 
 	mutex_unlock(&q->sysfs_lock);
@@ -2136,9 +2206,11 @@ static void blk_mq_map_swqueue(struct request_queue *q)
 	queue_for_each_hw_ctx(q, hctx, i) {
 		/*
 		 * If no software queues are mapped to this hardware queue,
-		 * disable it and free the request entries.
+		 * disable it and free the request entries.  Poll queues
+		 * never have any, they're used as long as a CPU maps to them.
 		 */
-		if (!hctx->nr_ctx) {
+		if (!hctx->nr_ctx && (!blk_mq_hctx_is_poll(hctx) ||
+				      cpumask_empty(hctx->cpumask))) {
 			/* Never unmap queue 0.  We need it as a
 			 * fallback in case of a new remap fails
 			 * allocation
@@ -2261,6 +2333,7 @@ void blk_mq_release(struct request_queue *q)
 	}
 
 	q->mq_map = NULL;
+	q->mq_poll_map = NULL;
 
 	kfree(q->queue_hw_ctx);
 
@@ -2329,11 +2402,19 @@ static void blk_mq_realloc_hw_ctxs(struct blk_mq_tag_set *set,
 			break;
 		}
 
+		if (blk_mq_alloc_lat_hist(hctxs[i])) {
+			free_cpumask_var(hctxs[i]->cpumask);
+			kfree(hctxs[i]);
+			hctxs[i] = NULL;
+			break;
+		}
+
 		atomic_set(&hctxs[i]->nr_active, 0);
 		hctxs[i]->numa_node = node;
 		hctxs[i]->queue_num = i;
 
 		if (blk_mq_init_hctx(q, set, hctxs[i], i)) {
+			blk_mq_free_lat_hist(hctxs[i]);
 			free_cpumask_var(hctxs[i]->cpumask);
 			kfree(hctxs[i]);
 			hctxs[i] = NULL;
@@ -2373,6 +2454,10 @@ struct request_queue *blk_mq_init_allocated_queue(struct blk_mq_tag_set *set,
 	if (!q->queue_ctx)
 		goto err_exit;
 
+	/* The latency histograms need every request's issue time */
+	if (IS_ENABLED(CONFIG_BLK_MQ_LAT_HIST))
+		blk_stat_enable_accounting(q);
+
 	/* init q->mq_kobj and sw queues' kobjects */
 	blk_mq_sysfs_init(q);
 
@@ -2382,6 +2467,7 @@ struct request_queue *blk_mq_init_allocated_queue(struct blk_mq_tag_set *set,
 		goto err_percpu;
 
 	q->mq_map = set->mq_map;
+	q->mq_poll_map = set->mq_poll_map;
 
 	blk_mq_realloc_hw_ctxs(set, q);
 	if (!q->nr_hw_queues)
@@ -2524,10 +2610,24 @@ static int blk_mq_alloc_rq_maps(struct blk_mq_tag_set *set)
 
 static int blk_mq_update_queue_map(struct blk_mq_tag_set *set)
 {
+	int ret;
+
+	/*
+	 * At least one queue has to take interrupts, everything that isn't
+	 * REQ_HIPRI goes there.
+	 */
+	if (set->nr_poll_queues >= set->nr_hw_queues)
+		set->nr_poll_queues = set->nr_hw_queues - 1;
+
 	if (set->ops->map_queues)
-		return set->ops->map_queues(set);
+		ret = set->ops->map_queues(set);
 	else
-		return blk_mq_map_queues(set);
+		ret = blk_mq_map_queues(set);
+	if (ret)
+		return ret;
+
+	blk_mq_map_poll_queues(set);
+	return 0;
 }
 
 /*
@@ -2583,6 +2683,10 @@ int blk_mq_alloc_tag_set(struct blk_mq_tag_set *set)
 			GFP_KERNEL, set->numa_node);
 	if (!set->mq_map)
 		goto out_free_tags;
+	set->mq_poll_map = kzalloc_node(sizeof(*set->mq_poll_map) * nr_cpu_ids,
+			GFP_KERNEL, set->numa_node);
+	if (!set->mq_poll_map)
+		goto out_free_mq_map;
 
 	ret = blk_mq_update_queue_map(set);
 	if (ret)
@@ -2598,6 +2702,8 @@ int blk_mq_alloc_tag_set(struct blk_mq_tag_set *set)
 	return 0;
 
 out_free_mq_map:
+	kfree(set->mq_poll_map);
+	set->mq_poll_map = NULL;
 	kfree(set->mq_map);
 	set->mq_map = NULL;
 out_free_tags:
@@ -2614,6 +2720,8 @@ void blk_mq_free_tag_set(struct blk_mq_tag_set *set)
 	for (i = 0; i < nr_cpu_ids; i++)
 		blk_mq_free_map_and_requests(set, i);
 
+	kfree(set->mq_poll_map);
+	set->mq_poll_map = NULL;
 	kfree(set->mq_map);
 	set->mq_map = NULL;
 
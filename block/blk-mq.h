@@ -57,11 +57,14 @@ void __blk_mq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 void blk_mq_request_bypass_insert(struct request *rq);
 void blk_mq_insert_requests(struct blk_mq_hw_ctx *hctx, struct blk_mq_ctx *ctx,
 				struct list_head *list);
+void blk_mq_try_issue_list_directly(struct blk_mq_hw_ctx *hctx,
+				    struct list_head *list);
 
 /*
  * CPU -> queue mappings
  */
 extern int blk_mq_hw_queue_to_node(unsigned int *map, unsigned int);
+void blk_mq_map_poll_queues(struct blk_mq_tag_set *set);
 
 static inline struct blk_mq_hw_ctx *blk_mq_map_queue(struct request_queue *q,
 		int cpu)
@@ -69,6 +72,21 @@ static inline struct blk_mq_hw_ctx *blk_mq_map_queue(struct request_queue *q,
 	return q->queue_hw_ctx[q->mq_map[cpu]];
 }
 
+/*
+ * The hardware queue a new request for @op, allocated from @cpu, goes to:
+ * the poll queue of @cpu for REQ_HIPRI, unless there are none or an IO
+ * scheduler is attached.  Flushes have their own machinery and stay on
+ * the default map.
+ */
+static inline struct blk_mq_hw_ctx *blk_mq_map_queue_op(struct request_queue *q,
+		unsigned int op, int cpu)
+{
+	if ((op & REQ_HIPRI) && q->tag_set->nr_poll_queues &&
+	    !q->elevator && !op_is_flush(op))
+		return q->queue_hw_ctx[q->mq_poll_map[cpu]];
+	return blk_mq_map_queue(q, cpu);
+}
+
 /*
  * sysfs helpers
  */
@@ -110,6 +128,7 @@ struct blk_mq_alloc_data {
 	struct request_queue *q;
 	unsigned int flags;
 	unsigned int shallow_depth;
+	unsigned int cmd_flags;
 
 	/* input & output parameter */
 	struct blk_mq_ctx *ctx;
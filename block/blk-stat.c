@@ -78,6 +78,69 @@ static void __blk_stat_add(struct blk_rq_stat *stat, u64 value)
 	stat->nr_batch++;
 }
 
+#ifdef CONFIG_BLK_MQ_LAT_HIST
+static unsigned int blk_mq_lat_hist_bucket(u64 nsecs)
+{
+	u64 usecs = div_u64(nsecs, NSEC_PER_USEC);
+
+	if (!usecs)
+		return 0;
+	return min_t(unsigned int, ilog2(usecs) + 1,
+		     BLK_MQ_LAT_HIST_BUCKETS - 1);
+}
+
+static void blk_mq_lat_hist_add(struct request *rq, u64 value)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	if (!rq->q->mq_ops || !rq->mq_ctx)
+		return;
+
+	hctx = blk_mq_map_queue(rq->q, rq->mq_ctx->cpu);
+	this_cpu_inc(hctx->lat_hist->buckets[op_is_write(req_op(rq))]
+					    [blk_mq_lat_hist_bucket(value)]);
+}
+
+int blk_mq_alloc_lat_hist(struct blk_mq_hw_ctx *hctx)
+{
+	hctx->lat_hist = alloc_percpu(struct blk_mq_lat_hist);
+	return hctx->lat_hist ? 0 : -ENOMEM;
+}
+
+void blk_mq_free_lat_hist(struct blk_mq_hw_ctx *hctx)
+{
+	free_percpu(hctx->lat_hist);
+}
+
+void blk_mq_lat_hist_read(struct blk_mq_hw_ctx *hctx,
+			  struct blk_mq_lat_hist *hist)
+{
+	int cpu, dir, i;
+
+	memset(hist, 0, sizeof(*hist));
+	for_each_possible_cpu(cpu) {
+		struct blk_mq_lat_hist *cpu_hist;
+
+		cpu_hist = per_cpu_ptr(hctx->lat_hist, cpu);
+		for (dir = 0; dir < 2; dir++)
+			for (i = 0; i < BLK_MQ_LAT_HIST_BUCKETS; i++)
+				hist->buckets[dir][i] +=
+					READ_ONCE(cpu_hist->buckets[dir][i]);
+	}
+}
+
+void blk_mq_lat_hist_reset(struct blk_mq_hw_ctx *hctx)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(hctx->lat_hist, cpu), 0,
+		       sizeof(struct blk_mq_lat_hist));
+}
+#else
+static inline void blk_mq_lat_hist_add(struct request *rq, u64 value) { }
+#endif
+
 void blk_stat_add(struct request *rq)
 {
 	struct request_queue *q = rq->q;
@@ -93,6 +156,7 @@ void blk_stat_add(struct request *rq)
 	value = now - blk_stat_time(&rq->issue_stat);
 
 	blk_throtl_stat_add(rq, value);
+	blk_mq_lat_hist_add(rq, value);
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(cb, &q->stats->callbacks, list) {
@@ -76,6 +76,33 @@ struct blk_stat_callback {
 	struct rcu_head rcu;
 };
 
+/*
+ * Completion latency histogram of a blk-mq hardware queue.  Bucket 0
+ * counts requests that completed within 1us, bucket n those that took
+ * [2^(n-1), 2^n) us, and the last one everything slower.
+ */
+#define BLK_MQ_LAT_HIST_BUCKETS	24
+
+struct blk_mq_hw_ctx;
+
+struct blk_mq_lat_hist {
+	unsigned long buckets[2][BLK_MQ_LAT_HIST_BUCKETS];	/* [write] */
+};
+
+#ifdef CONFIG_BLK_MQ_LAT_HIST
+int blk_mq_alloc_lat_hist(struct blk_mq_hw_ctx *hctx);
+void blk_mq_free_lat_hist(struct blk_mq_hw_ctx *hctx);
+void blk_mq_lat_hist_read(struct blk_mq_hw_ctx *hctx,
+			  struct blk_mq_lat_hist *hist);
+void blk_mq_lat_hist_reset(struct blk_mq_hw_ctx *hctx);
+#else
+static inline int blk_mq_alloc_lat_hist(struct blk_mq_hw_ctx *hctx)
+{
+	return 0;
+}
+static inline void blk_mq_free_lat_hist(struct blk_mq_hw_ctx *hctx) { }
+#endif
+
 struct blk_queue_stats *blk_alloc_queue_stats(void);
 void blk_free_queue_stats(struct blk_queue_stats *);
 
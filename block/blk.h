@@ -348,6 +348,23 @@ static inline void blk_throtl_bio_endio(struct bio *bio) { }
 static inline void blk_throtl_stat_add(struct request *rq, u64 time) { }
 #endif
 
+/*
+ * Internal latency target interface
+ */
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+extern int blk_iolatency_init(struct request_queue *q);
+extern void blk_iolatency_exit(struct request_queue *q);
+extern void blkcg_iolatency_throttle(struct request_queue *q,
+				     struct bio *bio);
+extern void blkcg_iolatency_done_bio(struct bio *bio);
+#else
+static inline int blk_iolatency_init(struct request_queue *q) { return 0; }
+static inline void blk_iolatency_exit(struct request_queue *q) { }
+static inline void blkcg_iolatency_throttle(struct request_queue *q,
+					    struct bio *bio) { }
+static inline void blkcg_iolatency_done_bio(struct bio *bio) { }
+#endif
+
 #ifdef CONFIG_BOUNCE
 extern int init_emergency_isa_pool(void);
 extern void blk_queue_bounce(struct request_queue *q, struct bio **bio);
@@ -13,13 +13,121 @@
  */
 
 #include <linux/err.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/seq_file.h>
 #include <crypto/engine.h>
 #include <crypto/internal/hash.h>
 #include <uapi/linux/sched/types.h>
 #include "internal.h"
 
-#define CRYPTO_ENGINE_MAX_QLEN 10
+static struct dentry *crypto_engine_debugfs_root;
+
+static void crypto_finalize_request(struct crypto_engine *engine,
+				    struct crypto_async_request *req, int err)
+{
+	switch (crypto_tfm_alg_type(req->tfm)) {
+	case CRYPTO_ALG_TYPE_AHASH:
+		crypto_finalize_hash_request(engine, ahash_request_cast(req),
+					     err);
+		break;
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		crypto_finalize_cipher_request(engine,
+					       ablkcipher_request_cast(req),
+					       err);
+		break;
+	}
+}
+
+/**
+ * crypto_pump_batch - hand a batch of requests to the driver
+ * @engine: the hardware engine, in batching mode
+ * @flags: the saved interrupt state of @engine->queue_lock
+ *
+ * Called with the queue lock held on a running engine with queued
+ * requests, and releases it.
+ */
+static void crypto_pump_batch(struct crypto_engine *engine,
+			      unsigned long flags)
+	__releases(&engine->queue_lock)
+{
+	struct crypto_async_request *reqs[CRYPTO_ENGINE_MAX_QLEN], *backlog;
+	unsigned int nr = 0, max, qlen, i;
+	bool was_busy = engine->busy;
+	int ret;
+
+	max = engine->max_batch;
+	if (!max || max > CRYPTO_ENGINE_MAX_QLEN)
+		max = CRYPTO_ENGINE_MAX_QLEN;
+
+	qlen = crypto_queue_len(&engine->queue);
+	engine->stats.pumps++;
+	engine->stats.qlen_sum += qlen;
+	engine->stats.qlen_max = max(engine->stats.qlen_max, qlen);
+
+	while (nr < max) {
+		backlog = crypto_get_backlog(&engine->queue);
+		reqs[nr] = crypto_dequeue_request(&engine->queue);
+		if (!reqs[nr])
+			break;
+		if (backlog)
+			backlog->complete(backlog, -EINPROGRESS);
+		nr++;
+	}
+
+	engine->busy = true;
+	engine->inflight += nr;
+	engine->stats.batches++;
+	engine->stats.batch_reqs += nr;
+	engine->stats.batch_max = max(engine->stats.batch_max, nr);
+	spin_unlock_irqrestore(&engine->queue_lock, flags);
+
+	if (!was_busy && engine->prepare_crypt_hardware) {
+		ret = engine->prepare_crypt_hardware(engine);
+		if (ret) {
+			dev_err(engine->dev, "failed to prepare crypt hardware\n");
+			goto batch_err;
+		}
+	}
+
+	ret = engine->do_batch(engine, reqs, nr);
+	if (ret == -ENOSPC)
+		ret = 0;
+	if (ret < 0) {
+		dev_err(engine->dev, "failed to do batch of %u requests: %d\n",
+			nr, ret);
+		goto batch_err;
+	}
+	if (ret >= nr)
+		goto out;
+
+	/* Retry the requests the driver had no room for, in order */
+	spin_lock_irqsave(&engine->queue_lock, flags);
+	for (i = nr; i-- > ret; )
+		crypto_enqueue_request_head(&engine->queue, reqs[i]);
+	engine->inflight -= nr - ret;
+	engine->stats.retries += nr - ret;
+	/* nothing left to complete and pump again, so do it now */
+	if (!engine->inflight)
+		kthread_queue_work(engine->kworker, &engine->pump_requests);
+	spin_unlock_irqrestore(&engine->queue_lock, flags);
+	return;
+
+batch_err:
+	spin_lock_irqsave(&engine->queue_lock, flags);
+	engine->stats.errors++;
+	spin_unlock_irqrestore(&engine->queue_lock, flags);
+	for (i = 0; i < nr; i++)
+		crypto_finalize_request(engine, reqs[i], ret);
+	return;
+
+out:
+	/* Keep the accelerator fed while requests are still queued */
+	spin_lock_irqsave(&engine->queue_lock, flags);
+	if (crypto_queue_len(&engine->queue))
+		kthread_queue_work(engine->kworker, &engine->pump_requests);
+	spin_unlock_irqrestore(&engine->queue_lock, flags);
+}
 
 /**
  * crypto_pump_requests - dequeue one request from engine queue to process
@@ -57,6 +165,10 @@ static void crypto_pump_requests(struct crypto_engine *engine,
 		if (!engine->busy)
 			goto out;
 
+		/* A batch is still on the hardware */
+		if (engine->inflight)
+			goto out;
+
 		/* Only do teardown in the thread */
 		if (!in_kthread) {
 			kthread_queue_work(engine->kworker,
@@ -77,6 +189,11 @@ static void crypto_pump_requests(struct crypto_engine *engine,
 		goto out;
 	}
 
+	if (engine->do_batch) {
+		crypto_pump_batch(engine, flags);
+		return;
+	}
+
 	/* Get the fist request from the engine queue to handle */
 	backlog = crypto_get_backlog(&engine->queue);
 	async_req = crypto_dequeue_request(&engine->queue);
@@ -268,7 +385,9 @@ void crypto_finalize_cipher_request(struct crypto_engine *engine,
 	int ret;
 
 	spin_lock_irqsave(&engine->queue_lock, flags);
-	if (engine->cur_req == &req->base)
+	if (engine->do_batch)
+		engine->inflight--;
+	else if (engine->cur_req == &req->base)
 		finalize_cur_req = true;
 	spin_unlock_irqrestore(&engine->queue_lock, flags);
 
@@ -305,7 +424,9 @@ void crypto_finalize_hash_request(struct crypto_engine *engine,
 	int ret;
 
 	spin_lock_irqsave(&engine->queue_lock, flags);
-	if (engine->cur_req == &req->base)
+	if (engine->do_batch)
+		engine->inflight--;
+	else if (engine->cur_req == &req->base)
 		finalize_cur_req = true;
 	spin_unlock_irqrestore(&engine->queue_lock, flags);
 
@@ -392,6 +513,44 @@ int crypto_engine_stop(struct crypto_engine *engine)
 }
 EXPORT_SYMBOL_GPL(crypto_engine_stop);
 
+static int crypto_engine_stats_show(struct seq_file *m, void *v)
+{
+	struct crypto_engine *engine = m->private;
+	unsigned long flags;
+	typeof(engine->stats) stats;
+	unsigned int qlen, inflight;
+
+	spin_lock_irqsave(&engine->queue_lock, flags);
+	stats = engine->stats;
+	qlen = crypto_queue_len(&engine->queue);
+	inflight = engine->inflight;
+	spin_unlock_irqrestore(&engine->queue_lock, flags);
+
+	seq_printf(m, "qlen: %u\n", qlen);
+	seq_printf(m, "qlen_max: %u\n", stats.qlen_max);
+	seq_printf(m, "qlen_avg: %lu\n",
+		   stats.pumps ? stats.qlen_sum / stats.pumps : 0);
+	seq_printf(m, "inflight: %u\n", inflight);
+	seq_printf(m, "batches: %lu\n", stats.batches);
+	seq_printf(m, "batch_reqs: %lu\n", stats.batch_reqs);
+	seq_printf(m, "batch_max: %u\n", stats.batch_max);
+	seq_printf(m, "retries: %lu\n", stats.retries);
+	seq_printf(m, "errors: %lu\n", stats.errors);
+	return 0;
+}
+
+static int crypto_engine_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, crypto_engine_stats_show, inode->i_private);
+}
+
+static const struct file_operations crypto_engine_stats_fops = {
+	.open		= crypto_engine_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /**
  * crypto_engine_alloc_init - allocate crypto hardware engine structure and
  * initialize it.
@@ -438,6 +597,14 @@ struct crypto_engine *crypto_engine_alloc_init(struct device *dev, bool rt)
 		sched_setscheduler(engine->kworker->task, SCHED_FIFO, &param);
 	}
 
+	if (!IS_ERR_OR_NULL(crypto_engine_debugfs_root)) {
+		struct dentry *root = crypto_engine_debugfs_root;
+
+		engine->debugfs = debugfs_create_dir(engine->name, root);
+		debugfs_create_file("stats", 0400, engine->debugfs, engine,
+				    &crypto_engine_stats_fops);
+	}
+
 	return engine;
 }
 EXPORT_SYMBOL_GPL(crypto_engine_alloc_init);
@@ -456,11 +623,26 @@ int crypto_engine_exit(struct crypto_engine *engine)
 	if (ret)
 		return ret;
 
+	debugfs_remove_recursive(engine->debugfs);
 	kthread_destroy_worker(engine->kworker);
 
 	return 0;
 }
 EXPORT_SYMBOL_GPL(crypto_engine_exit);
 
+static int __init crypto_engine_init(void)
+{
+	crypto_engine_debugfs_root = debugfs_create_dir("crypto_engine", NULL);
+	return 0;
+}
+
+static void __exit crypto_engine_cleanup(void)
+{
+	debugfs_remove_recursive(crypto_engine_debugfs_root);
+}
+
+subsys_initcall(crypto_engine_init);
+module_exit(crypto_engine_cleanup);
+
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Crypto hardware engine framework");
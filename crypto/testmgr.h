@@ -34638,4 +34638,70 @@ static const struct comp_testvec lz4hc_decomp_tv_template[] = {
 	},
 };
 
+static const struct comp_testvec zstd_comp_tv_template[] = {
+	{
+		.inlen	= 68,
+		.outlen	= 39,
+		.input	= "The algorithm is zstd. The algorithm is zstd. "
+			 "The algorithm is zstd.",
+		.output	= "\x28\xb5\x2f\xfd\x00\x50\xf5\x00\x00\xb8\x54\x68\x65"
+			  "\x20\x61\x6c\x67\x6f\x72\x69\x74\x68\x6d\x20\x69\x73"
+			  "\x20\x7a\x73\x74\x64\x2e\x20\x01\x00\x55\x73\x36\x01",
+	}, {
+		.inlen	= 232,
+		.outlen	= 165,
+		.input	= "zstd, short for Zstandard, is a fast lossless "
+			 "compression algorithm, targeting real-time "
+			 "compression scenarios at zlib-level and better "
+			 "compression ratios. It's backed by a very fast "
+			 "entropy stage, provided by Huff0 and FSE library.",
+		.output	= "\x28\xb5\x2f\xfd\x00\x50\xe5\x04\x00\xd2\x0b\x22\x1c"
+			  "\x70\x09\xd3\x00\x40\x84\x52\x32\xc9\xa5\x18\xf2\xdd"
+			  "\x72\x53\xc6\xf3\x3b\xa4\x55\x87\xf0\x6f\x5e\xea\xff"
+			  "\x4d\x08\x85\x45\x4b\xcf\xa1\x05\x0c\x06\x02\x0c\x23"
+			  "\x81\x00\x9d\x92\x9a\xd8\xd8\x51\x7b\x2f\x49\xea\x26"
+			  "\x5b\xd4\x14\x97\x97\x63\x64\x08\x45\x1d\x1f\x60\x0b"
+			  "\x5c\x78\xde\x96\xaa\xed\xda\x31\x4a\x65\x34\xc5\x90"
+			  "\x38\x87\x07\x6f\xf9\x79\x5a\xc9\x8a\x1b\x72\x4b\x60"
+			  "\x99\xfa\x48\xb7\x76\x68\xad\x0d\x62\xd8\xd3\x3c\xb0"
+			  "\x9c\xf2\x7e\xd3\x04\xc9\xc2\xbf\xe1\x9f\xe8\x7d\x19"
+			  "\x2e\xff\x6c\x90\x16\x4a\xb5\x3f\xb0\xa6\xe1\xd5\x34"
+			  "\xdc\x06\xed\x0f\x01\x05\x00\x5e\x10\xba\xd2\xc1\xaa"
+			  "\x98\xc1\x49\xaa\xe3\x31\x77\x28\x33",
+	},
+};
+
+static const struct comp_testvec zstd_decomp_tv_template[] = {
+	{
+		.inlen	= 39,
+		.outlen	= 68,
+		.input	= "\x28\xb5\x2f\xfd\x00\x50\xf5\x00\x00\xb8\x54\x68\x65"
+			  "\x20\x61\x6c\x67\x6f\x72\x69\x74\x68\x6d\x20\x69\x73"
+			  "\x20\x7a\x73\x74\x64\x2e\x20\x01\x00\x55\x73\x36\x01",
+		.output	= "The algorithm is zstd. The algorithm is zstd. "
+			 "The algorithm is zstd.",
+	}, {
+		.inlen	= 165,
+		.outlen	= 232,
+		.input	= "\x28\xb5\x2f\xfd\x00\x50\xe5\x04\x00\xd2\x0b\x22\x1c"
+			  "\x70\x09\xd3\x00\x40\x84\x52\x32\xc9\xa5\x18\xf2\xdd"
+			  "\x72\x53\xc6\xf3\x3b\xa4\x55\x87\xf0\x6f\x5e\xea\xff"
+			  "\x4d\x08\x85\x45\x4b\xcf\xa1\x05\x0c\x06\x02\x0c\x23"
+			  "\x81\x00\x9d\x92\x9a\xd8\xd8\x51\x7b\x2f\x49\xea\x26"
+			  "\x5b\xd4\x14\x97\x97\x63\x64\x08\x45\x1d\x1f\x60\x0b"
+			  "\x5c\x78\xde\x96\xaa\xed\xda\x31\x4a\x65\x34\xc5\x90"
+			  "\x38\x87\x07\x6f\xf9\x79\x5a\xc9\x8a\x1b\x72\x4b\x60"
+			  "\x99\xfa\x48\xb7\x76\x68\xad\x0d\x62\xd8\xd3\x3c\xb0"
+			  "\x9c\xf2\x7e\xd3\x04\xc9\xc2\xbf\xe1\x9f\xe8\x7d\x19"
+			  "\x2e\xff\x6c\x90\x16\x4a\xb5\x3f\xb0\xa6\xe1\xd5\x34"
+			  "\xdc\x06\xed\x0f\x01\x05\x00\x5e\x10\xba\xd2\xc1\xaa"
+			  "\x98\xc1\x49\xaa\xe3\x31\x77\x28\x33",
+		.output	= "zstd, short for Zstandard, is a fast lossless "
+			 "compression algorithm, targeting real-time "
+			 "compression scenarios at zlib-level and better "
+			 "compression ratios. It's backed by a very fast "
+			 "entropy stage, provided by Huff0 and FSE library.",
+	},
+};
+
 #endif	/* _CRYPTO_TESTMGR_H */
@@ -35,6 +35,27 @@ void topology_set_cpu_scale(unsigned int cpu, unsigned long capacity)
 	per_cpu(cpu_scale, cpu) = capacity;
 }
 
+DEFINE_PER_CPU(unsigned long, freq_scale) = SCHED_CAPACITY_SCALE;
+
+/*
+ * Called by the cpufreq drivers once a frequency change has taken effect,
+ * so the scheduler can scale the load it tracks on @cpus accordingly.
+ */
+void arch_set_freq_scale(const struct cpumask *cpus, unsigned long cur_freq,
+			 unsigned long max_freq)
+{
+	unsigned long scale;
+	int cpu;
+
+	if (!max_freq)
+		return;
+
+	scale = (cur_freq << SCHED_CAPACITY_SHIFT) / max_freq;
+
+	for_each_cpu(cpu, cpus)
+		per_cpu(freq_scale, cpu) = scale;
+}
+
 static ssize_t cpu_capacity_show(struct device *dev,
 				 struct device_attribute *attr,
 				 char *buf)
@@ -18,6 +18,7 @@
 
 #define PART_BITS 4
 #define VQ_NAME_LEN 16
+#define MAX_DISCARD_SEGMENTS 256u
 
 static int major;
 static DEFINE_IDA(vd_index_ida);
@@ -61,6 +62,8 @@ struct virtblk_req {
 #endif
 	struct virtio_blk_outhdr out_hdr;
 	u8 status;
+	/* Chains the requests reaped together, to complete them unlocked */
+	struct virtblk_req *next_done;
 	struct scatterlist sg[];
 };
 
@@ -172,10 +175,52 @@ static int virtblk_add_req(struct virtqueue *vq, struct virtblk_req *vbr,
 	return virtqueue_add_sgs(vq, sgs, num_out, num_in, vbr, GFP_ATOMIC);
 }
 
+/*
+ * Discard and write zeroes take a table of ranges, one per bio of the
+ * request, as their payload in place of data.
+ */
+static int virtblk_setup_discard_write_zeroes(struct request *req, bool unmap)
+{
+	unsigned short segments = blk_rq_nr_discard_segments(req);
+	unsigned short n = 0;
+	struct virtio_blk_discard_write_zeroes *range;
+	struct bio *bio;
+	u32 flags = 0;
+
+	if (unmap)
+		flags |= VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP;
+
+	range = kmalloc_array(segments, sizeof(*range), GFP_ATOMIC);
+	if (!range)
+		return -ENOMEM;
+
+	__rq_for_each_bio(bio, req) {
+		u64 sector = bio->bi_iter.bi_sector;
+		u32 num_sectors = bio->bi_iter.bi_size >> 9;
+
+		range[n].flags = cpu_to_le32(flags);
+		range[n].num_sectors = cpu_to_le32(num_sectors);
+		range[n].sector = cpu_to_le64(sector);
+		n++;
+	}
+
+	req->special_vec.bv_page = virt_to_page(range);
+	req->special_vec.bv_offset = offset_in_page(range);
+	req->special_vec.bv_len = sizeof(*range) * segments;
+	req->rq_flags |= RQF_SPECIAL_PAYLOAD;
+
+	return 0;
+}
+
 static inline void virtblk_request_done(struct request *req)
 {
 	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
 
+	if (req->rq_flags & RQF_SPECIAL_PAYLOAD) {
+		kfree(page_address(req->special_vec.bv_page) +
+		      req->special_vec.bv_offset);
+	}
+
 	switch (req_op(req)) {
 	case REQ_OP_SCSI_IN:
 	case REQ_OP_SCSI_OUT:
@@ -186,48 +231,91 @@ static inline void virtblk_request_done(struct request *req)
 	blk_mq_end_request(req, virtblk_result(vbr));
 }
 
+/*
+ * Take everything the device is done with off the queue, under its lock,
+ * chained up for virtblk_complete() to finish once the lock is dropped:
+ * submitters on other CPUs aren't held up by a whole batch of completions.
+ */
+static struct virtblk_req *virtblk_reap(struct virtio_blk_vq *vq,
+					struct virtblk_req *done)
+{
+	struct virtblk_req *vbr;
+	unsigned int len;
+
+	while ((vbr = virtqueue_get_buf(vq->vq, &len)) != NULL) {
+		vbr->next_done = done;
+		done = vbr;
+	}
+
+	return done;
+}
+
+/* Returns whether the request with @tag was among them */
+static bool virtblk_complete(struct virtio_blk *vblk, struct virtblk_req *done,
+			     unsigned int tag)
+{
+	bool found = false;
+
+	if (!done)
+		return false;
+
+	while (done) {
+		struct request *req = blk_mq_rq_from_pdu(done);
+
+		done = done->next_done;
+		if (req->tag == tag)
+			found = true;
+		blk_mq_complete_request(req);
+	}
+
+	/* In case queue is stopped waiting for more buffers. */
+	blk_mq_start_stopped_hw_queues(vblk->disk->queue, true);
+	return found;
+}
+
 static void virtblk_done(struct virtqueue *vq)
 {
 	struct virtio_blk *vblk = vq->vdev->priv;
-	bool req_done = false;
 	int qid = vq->index;
-	struct virtblk_req *vbr;
+	struct virtblk_req *done = NULL;
 	unsigned long flags;
-	unsigned int len;
 
 	spin_lock_irqsave(&vblk->vqs[qid].lock, flags);
 	do {
 		virtqueue_disable_cb(vq);
-		while ((vbr = virtqueue_get_buf(vblk->vqs[qid].vq, &len)) != NULL) {
-			struct request *req = blk_mq_rq_from_pdu(vbr);
-
-			blk_mq_complete_request(req);
-			req_done = true;
-		}
+		done = virtblk_reap(&vblk->vqs[qid], done);
 		if (unlikely(virtqueue_is_broken(vq)))
 			break;
 	} while (!virtqueue_enable_cb(vq));
-
-	/* In case queue is stopped waiting for more buffers. */
-	if (req_done)
-		blk_mq_start_stopped_hw_queues(vblk->disk->queue, true);
 	spin_unlock_irqrestore(&vblk->vqs[qid].lock, flags);
+
+	virtblk_complete(vblk, done, -1U);
 }
 
-static blk_status_t virtio_queue_rq(struct blk_mq_hw_ctx *hctx,
-			   const struct blk_mq_queue_data *bd)
+/*
+ * blk_poll() spins here for a REQ_HIPRI request to complete, reaping the
+ * queue without waiting for its interrupt.
+ */
+static int virtblk_poll(struct blk_mq_hw_ctx *hctx, unsigned int tag)
 {
 	struct virtio_blk *vblk = hctx->queue->queuedata;
-	struct request *req = bd->rq;
-	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
+	struct virtio_blk_vq *vq = &vblk->vqs[hctx->queue_num];
+	struct virtblk_req *done;
 	unsigned long flags;
-	unsigned int num;
-	int qid = hctx->queue_num;
-	int err;
-	bool notify = false;
-	u32 type;
 
-	BUG_ON(req->nr_phys_segments + 2 > vblk->sg_elems);
+	spin_lock_irqsave(&vq->lock, flags);
+	done = virtblk_reap(vq, NULL);
+	spin_unlock_irqrestore(&vq->lock, flags);
+
+	return virtblk_complete(vblk, done, tag);
+}
+
+static blk_status_t virtblk_setup_cmd(struct virtio_blk *vblk,
+				      struct request *req)
+{
+	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
+	bool unmap = false;
+	u32 type;
 
 	switch (req_op(req)) {
 	case REQ_OP_READ:
@@ -237,6 +325,13 @@ static blk_status_t virtio_queue_rq(struct blk_mq_hw_ctx *hctx,
 	case REQ_OP_FLUSH:
 		type = VIRTIO_BLK_T_FLUSH;
 		break;
+	case REQ_OP_DISCARD:
+		type = VIRTIO_BLK_T_DISCARD;
+		break;
+	case REQ_OP_WRITE_ZEROES:
+		type = VIRTIO_BLK_T_WRITE_ZEROES;
+		unmap = !(req->cmd_flags & REQ_NOUNMAP);
+		break;
 	case REQ_OP_SCSI_IN:
 	case REQ_OP_SCSI_OUT:
 		type = VIRTIO_BLK_T_SCSI_CMD;
@@ -254,25 +349,78 @@ static blk_status_t virtio_queue_rq(struct blk_mq_hw_ctx *hctx,
 		0 : cpu_to_virtio64(vblk->vdev, blk_rq_pos(req));
 	vbr->out_hdr.ioprio = cpu_to_virtio32(vblk->vdev, req_get_ioprio(req));
 
-	blk_mq_start_request(req);
+	if (type == VIRTIO_BLK_T_DISCARD || type == VIRTIO_BLK_T_WRITE_ZEROES) {
+		if (virtblk_setup_discard_write_zeroes(req, unmap))
+			return BLK_STS_RESOURCE;
+	}
+
+	BUG_ON(blk_rq_nr_phys_segments(req) + 2 > vblk->sg_elems);
+	return BLK_STS_OK;
+}
+
+static unsigned int virtblk_map_data(struct virtio_blk *vblk,
+				     struct request *req)
+{
+	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
+	unsigned int num;
 
-	num = blk_rq_map_sg(hctx->queue, req, vbr->sg);
+	num = blk_rq_map_sg(req->q, req, vbr->sg);
 	if (num) {
 		if (rq_data_dir(req) == WRITE)
 			vbr->out_hdr.type |= cpu_to_virtio32(vblk->vdev, VIRTIO_BLK_T_OUT);
 		else
 			vbr->out_hdr.type |= cpu_to_virtio32(vblk->vdev, VIRTIO_BLK_T_IN);
 	}
+	return num;
+}
+
+static int virtblk_add(struct virtqueue *vq, struct request *req,
+		       unsigned int num)
+{
+	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
 
-	spin_lock_irqsave(&vblk->vqs[qid].lock, flags);
 	if (blk_rq_is_scsi(req))
-		err = virtblk_add_req_scsi(vblk->vqs[qid].vq, vbr, vbr->sg, num);
-	else
-		err = virtblk_add_req(vblk->vqs[qid].vq, vbr, vbr->sg, num);
+		return virtblk_add_req_scsi(vq, vbr, vbr->sg, num);
+	return virtblk_add_req(vq, vbr, vbr->sg, num);
+}
+
+/* The ranges are set up again if it comes back */
+static void virtblk_cleanup_cmd(struct request *req)
+{
+	if (req->rq_flags & RQF_SPECIAL_PAYLOAD) {
+		kfree(page_address(req->special_vec.bv_page) +
+		      req->special_vec.bv_offset);
+		req->rq_flags &= ~RQF_SPECIAL_PAYLOAD;
+	}
+}
+
+static blk_status_t virtio_queue_rq(struct blk_mq_hw_ctx *hctx,
+			   const struct blk_mq_queue_data *bd)
+{
+	struct virtio_blk *vblk = hctx->queue->queuedata;
+	struct request *req = bd->rq;
+	unsigned long flags;
+	unsigned int num;
+	int qid = hctx->queue_num;
+	blk_status_t status;
+	int err;
+	bool notify = false;
+
+	status = virtblk_setup_cmd(vblk, req);
+	if (status)
+		return status;
+
+	blk_mq_start_request(req);
+
+	num = virtblk_map_data(vblk, req);
+
+	spin_lock_irqsave(&vblk->vqs[qid].lock, flags);
+	err = virtblk_add(vblk->vqs[qid].vq, req, num);
 	if (err) {
 		virtqueue_kick(vblk->vqs[qid].vq);
 		blk_mq_stop_hw_queue(hctx);
 		spin_unlock_irqrestore(&vblk->vqs[qid].lock, flags);
+		virtblk_cleanup_cmd(req);
 		/* Out of mem doesn't actually happen, since we fall back
 		 * to direct descriptors */
 		if (err == -ENOMEM || err == -ENOSPC)
@@ -280,7 +428,7 @@ static blk_status_t virtio_queue_rq(struct blk_mq_hw_ctx *hctx,
 		return BLK_STS_IOERR;
 	}
 
-	if (bd->last && virtqueue_kick_prepare(vblk->vqs[qid].vq))
+	if (virtqueue_kick_prepare_batch(vblk->vqs[qid].vq, !bd->last))
 		notify = true;
 	spin_unlock_irqrestore(&vblk->vqs[qid].lock, flags);
 
@@ -289,6 +437,44 @@ static blk_status_t virtio_queue_rq(struct blk_mq_hw_ctx *hctx,
 	return BLK_STS_OK;
 }
 
+/*
+ * Batched submission of the requests of a plug: they are all added to the
+ * virtqueue under one hold of its lock, and the host is notified at most
+ * once.  A request is only started once it is on the ring, so the one that
+ * does not fit and those after it are left on @list untouched, for
+ * ->queue_rq to deal with.  Completions take the same lock, none can be
+ * seen before the request is started.
+ */
+static void virtio_queue_rqs(struct blk_mq_hw_ctx *hctx,
+			     struct list_head *list)
+{
+	struct virtio_blk *vblk = hctx->queue->queuedata;
+	struct virtio_blk_vq *vq = &vblk->vqs[hctx->queue_num];
+	struct request *req, *next;
+	unsigned long flags;
+	bool queued = false;
+	bool notify = false;
+
+	spin_lock_irqsave(&vq->lock, flags);
+	list_for_each_entry_safe(req, next, list, queuelist) {
+		if (virtblk_setup_cmd(vblk, req) != BLK_STS_OK)
+			break;
+		if (virtblk_add(vq->vq, req, virtblk_map_data(vblk, req))) {
+			virtblk_cleanup_cmd(req);
+			break;
+		}
+		list_del_init(&req->queuelist);
+		blk_mq_start_request(req);
+		queued = true;
+	}
+	if (queued && virtqueue_kick_prepare_batch(vq->vq, false))
+		notify = true;
+	spin_unlock_irqrestore(&vq->lock, flags);
+
+	if (notify)
+		virtqueue_notify(vq->vq);
+}
+
 /* return id (s/n) string for *disk to *id_str
  */
 static int virtblk_get_id(struct gendisk *disk, char *id_str)
@@ -595,9 +781,11 @@ static int virtblk_map_queues(struct blk_mq_tag_set *set)
 
 static const struct blk_mq_ops virtio_mq_ops = {
 	.queue_rq	= virtio_queue_rq,
+	.queue_rqs	= virtio_queue_rqs,
 	.complete	= virtblk_request_done,
 	.init_request	= virtblk_init_request,
 	.map_queues	= virtblk_map_queues,
+	.poll		= virtblk_poll,
 };
 
 static unsigned int virtblk_queue_depth;
@@ -768,6 +956,32 @@ static int virtblk_probe(struct virtio_device *vdev)
 	if (!err && opt_io_size)
 		blk_queue_io_opt(q, blk_size * opt_io_size);
 
+	if (virtio_has_feature(vdev, VIRTIO_BLK_F_DISCARD)) {
+		q->limits.discard_granularity = blk_size;
+
+		virtio_cread(vdev, struct virtio_blk_config,
+			     discard_sector_alignment, &v);
+		q->limits.discard_alignment = v << 9;
+
+		virtio_cread(vdev, struct virtio_blk_config,
+			     max_discard_sectors, &v);
+		blk_queue_max_discard_sectors(q, v ? v : UINT_MAX);
+
+		/* The table of ranges takes a single sg entry however long */
+		virtio_cread(vdev, struct virtio_blk_config, max_discard_seg,
+			     &v);
+		blk_queue_max_discard_segments(q,
+				min_not_zero(v, MAX_DISCARD_SEGMENTS));
+
+		queue_flag_set_unlocked(QUEUE_FLAG_DISCARD, q);
+	}
+
+	if (virtio_has_feature(vdev, VIRTIO_BLK_F_WRITE_ZEROES)) {
+		virtio_cread(vdev, struct virtio_blk_config,
+			     max_write_zeroes_sectors, &v);
+		blk_queue_max_write_zeroes_sectors(q, v ? v : UINT_MAX);
+	}
+
 	virtio_device_ready(vdev);
 
 	device_add_disk(&vdev->dev, vblk->disk);
@@ -875,14 +1089,14 @@ static unsigned int features_legacy[] = {
 	VIRTIO_BLK_F_SCSI,
 #endif
 	VIRTIO_BLK_F_FLUSH, VIRTIO_BLK_F_TOPOLOGY, VIRTIO_BLK_F_CONFIG_WCE,
-	VIRTIO_BLK_F_MQ,
+	VIRTIO_BLK_F_MQ, VIRTIO_BLK_F_DISCARD, VIRTIO_BLK_F_WRITE_ZEROES,
 }
 ;
 static unsigned int features[] = {
 	VIRTIO_BLK_F_SEG_MAX, VIRTIO_BLK_F_SIZE_MAX, VIRTIO_BLK_F_GEOMETRY,
 	VIRTIO_BLK_F_RO, VIRTIO_BLK_F_BLK_SIZE,
 	VIRTIO_BLK_F_FLUSH, VIRTIO_BLK_F_TOPOLOGY, VIRTIO_BLK_F_CONFIG_WCE,
-	VIRTIO_BLK_F_MQ,
+	VIRTIO_BLK_F_MQ, VIRTIO_BLK_F_DISCARD, VIRTIO_BLK_F_WRITE_ZEROES,
 };
 
 static struct virtio_driver virtio_blk = {
@@ -570,6 +570,8 @@ static int write_to_bdev(struct zram *zram, struct bio_vec *bvec,
 
 	submit_bio(bio);
 	*pentry = entry;
+	atomic64_inc(&zram->stats.bd_count);
+	atomic64_inc(&zram->stats.bd_writes);
 
 	return 0;
 }
@@ -582,6 +584,24 @@ static void zram_wb_clear(struct zram *zram, u32 index)
 	entry = zram_get_element(zram, index);
 	zram_set_element(zram, index, 0);
 	put_entry_bdev(zram, entry);
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.bd_count),
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes));
+	up_read(&zram->init_lock);
+
+	return ret;
 }
 
 #else
@@ -666,6 +686,48 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_compressor, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+/* An empty string turns recompression off again. */
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->recomp_compressor)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[--sz] = 0x00;
+
+	if (sz && !zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	strcpy(zram->recomp_compressor, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
 static ssize_t compact_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -722,14 +784,16 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
 			zram->limit_pages << PAGE_SHIFT,
 			max_used << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.same_pages),
-			pool_stats.pages_compacted);
+			pool_stats.pages_compacted,
+			(u64)atomic64_read(&zram->stats.recomp_pages),
+			(u64)atomic64_read(&zram->stats.huge_pages));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -806,6 +870,17 @@ static void zram_free_page(struct zram *zram, size_t index)
 {
 	unsigned long handle;
 
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	if (zram_test_flag(zram, index, ZRAM_RECOMP)) {
+		zram_clear_flag(zram, index, ZRAM_RECOMP);
+		atomic64_dec(&zram->stats.recomp_pages);
+	}
+	if (zram_test_flag(zram, index, ZRAM_HUGE)) {
+		zram_clear_flag(zram, index, ZRAM_HUGE);
+		atomic64_dec(&zram->stats.huge_pages);
+	}
+
 	if (zram_wb_enabled(zram) && zram_test_flag(zram, index, ZRAM_WB)) {
 		zram_wb_clear(zram, index);
 		atomic64_dec(&zram->stats.pages_stored);
@@ -838,13 +913,48 @@ static void zram_free_page(struct zram *zram, size_t index)
 	zram_set_obj_size(zram, index, 0);
 }
 
+/*
+ * Uncompress the zsmalloc object of the page at @index into @page.  The
+ * caller holds the slot lock and has checked that there is an object.
+ */
+static int zram_read_from_zspool(struct zram *zram, struct page *page,
+				 u32 index)
+{
+	unsigned long handle = zram_get_handle(zram, index);
+	unsigned int size = zram_get_obj_size(zram, index);
+	void *src, *dst;
+	int ret;
+
+	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
+	if (size == PAGE_SIZE) {
+		dst = kmap_atomic(page);
+		memcpy(dst, src, PAGE_SIZE);
+		kunmap_atomic(dst);
+		ret = 0;
+	} else {
+		struct zcomp *comp = zram_test_flag(zram, index, ZRAM_RECOMP) ?
+					zram->recomp : zram->comp;
+		struct zcomp_strm *zstrm = zcomp_stream_get(comp);
+
+		dst = kmap_atomic(page);
+		ret = zcomp_decompress(zstrm, src, size, dst);
+		kunmap_atomic(dst);
+		zcomp_stream_put(comp);
+	}
+	zs_unmap_object(zram->mem_pool, handle);
+
+	/* Should NEVER happen. Return bio error if it does. */
+	if (unlikely(ret))
+		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
+
+	return ret;
+}
+
 static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 				struct bio *bio, bool partial_io)
 {
 	int ret;
 	unsigned long handle;
-	unsigned int size;
-	void *src, *dst;
 
 	if (zram_wb_enabled(zram)) {
 		zram_slot_lock(zram, index);
@@ -856,6 +966,7 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 			bvec.bv_page = page;
 			bvec.bv_len = PAGE_SIZE;
 			bvec.bv_offset = 0;
+			atomic64_inc(&zram->stats.bd_reads);
 			return read_from_bdev(zram, &bvec,
 					zram_get_element(zram, index),
 					bio, partial_io);
@@ -864,6 +975,7 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 	}
 
 	zram_slot_lock(zram, index);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
 	handle = zram_get_handle(zram, index);
 	if (!handle || zram_test_flag(zram, index, ZRAM_SAME)) {
 		unsigned long value;
@@ -877,29 +989,9 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		return 0;
 	}
 
-	size = zram_get_obj_size(zram, index);
-
-	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
-	if (size == PAGE_SIZE) {
-		dst = kmap_atomic(page);
-		memcpy(dst, src, PAGE_SIZE);
-		kunmap_atomic(dst);
-		ret = 0;
-	} else {
-		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
-
-		dst = kmap_atomic(page);
-		ret = zcomp_decompress(zstrm, src, size, dst);
-		kunmap_atomic(dst);
-		zcomp_stream_put(zram->comp);
-	}
-	zs_unmap_object(zram->mem_pool, handle);
+	ret = zram_read_from_zspool(zram, page, index);
 	zram_slot_unlock(zram, index);
 
-	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret))
-		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
-
 	return ret;
 }
 
@@ -1053,6 +1145,10 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	}  else {
 		zram_set_handle(zram, index, handle);
 		zram_set_obj_size(zram, index, comp_len);
+		if (comp_len == PAGE_SIZE) {
+			zram_set_flag(zram, index, ZRAM_HUGE);
+			atomic64_inc(&zram->stats.huge_pages);
+		}
 	}
 	zram_slot_unlock(zram, index);
 
@@ -1102,6 +1198,328 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	return ret;
 }
 
+/*
+ * Mark every page stored in zram memory idle.  Reading or rewriting a
+ * page clears the mark, so what's still idle at the next recompress has
+ * not been touched in between.
+ */
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages;
+	u32 index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (!zram_test_flag(zram, index, ZRAM_SAME) &&
+		    !zram_test_flag(zram, index, ZRAM_WB) &&
+		    zram_get_handle(zram, index))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+	}
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+/*
+ * Recompress the page at @index with zram->recomp, using @page as the
+ * scratch buffer for its uncompressed data.  The new object replaces the
+ * old one only when it is smaller.  Called with the slot locked, so
+ * nothing in here may sleep.
+ */
+static int zram_recompress(struct zram *zram, u32 index, struct page *page)
+{
+	unsigned long handle = zram_get_handle(zram, index);
+	unsigned int size = zram_get_obj_size(zram, index);
+	unsigned long new_handle;
+	unsigned int comp_len;
+	struct zcomp_strm *zstrm;
+	void *src, *dst;
+	int ret = 0;
+
+	ret = zram_read_from_zspool(zram, page, index);
+	if (unlikely(ret))
+		return ret;
+
+	zstrm = zcomp_stream_get(zram->recomp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress(zstrm, src, &comp_len);
+	kunmap_atomic(src);
+
+	if (ret || comp_len >= size || comp_len > max_zpage_size) {
+		zcomp_stream_put(zram->recomp);
+		/* Not worth it, leave it be until it is rewritten. */
+		zram_clear_flag(zram, index, ZRAM_IDLE);
+		return 0;
+	}
+
+	new_handle = zs_malloc(zram->mem_pool, comp_len,
+			__GFP_KSWAPD_RECLAIM |
+			__GFP_NOWARN |
+			__GFP_HIGHMEM |
+			__GFP_MOVABLE);
+	if (!new_handle) {
+		zcomp_stream_put(zram->recomp);
+		return -ENOMEM;
+	}
+
+	dst = zs_map_object(zram->mem_pool, new_handle, ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, comp_len);
+	zs_unmap_object(zram->mem_pool, new_handle);
+	zcomp_stream_put(zram->recomp);
+
+	zs_free(zram->mem_pool, handle);
+	atomic64_sub(size - comp_len, &zram->stats.compr_data_size);
+
+	zram_set_handle(zram, index, new_handle);
+	zram_set_obj_size(zram, index, comp_len);
+	zram_set_flag(zram, index, ZRAM_RECOMP);
+	atomic64_inc(&zram->stats.recomp_pages);
+	if (zram_test_flag(zram, index, ZRAM_HUGE)) {
+		zram_clear_flag(zram, index, ZRAM_HUGE);
+		atomic64_dec(&zram->stats.huge_pages);
+	}
+
+	return 0;
+}
+
+/*
+ * Recompress the pages still marked idle with recomp_algorithm.  Meant
+ * to be driven from userspace when the system is quiet: it only ever
+ * holds one slot lock at a time, so swap traffic on hot pages carries
+ * on meanwhile.
+ */
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages;
+	struct page *page;
+	ssize_t ret = 0;
+	u32 index;
+
+	if (!sysfs_streq(buf, "idle"))
+		return -EINVAL;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->recomp) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (zram_test_flag(zram, index, ZRAM_IDLE) &&
+		    !zram_test_flag(zram, index, ZRAM_RECOMP))
+			ret = zram_recompress(zram, index, page);
+		zram_slot_unlock(zram, index);
+		if (ret)
+			break;
+
+		cond_resched();
+	}
+out:
+	up_read(&zram->init_lock);
+	__free_page(page);
+
+	return ret ? ret : len;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Pages written back per bio */
+#define ZRAM_WB_BATCH	32
+
+static bool zram_wb_candidate(struct zram *zram, u32 index, bool huge_only)
+{
+	if (zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+	    !zram_get_handle(zram, index))
+		return false;
+
+	if (huge_only)
+		return zram_test_flag(zram, index, ZRAM_HUGE);
+	return zram_test_flag(zram, index, ZRAM_IDLE);
+}
+
+/*
+ * Write @nr pages, uncompressed into @pages, to the backing device
+ * blocks starting at @entry, and then drop their zsmalloc objects.  A
+ * page that was freed or rewritten while the IO was in flight lost its
+ * ZRAM_UNDER_WB mark; its block is given back instead.
+ */
+static int zram_wb_submit(struct zram *zram, struct page **pages,
+			  u32 *indices, unsigned long entry, unsigned int nr)
+{
+	struct bio *bio;
+	unsigned int i;
+	int ret;
+
+	bio = bio_alloc(GFP_KERNEL, nr);
+	bio_set_dev(bio, zram->bdev);
+	bio->bi_iter.bi_sector = entry * (PAGE_SIZE >> 9);
+	bio->bi_opf = REQ_OP_WRITE | REQ_SYNC;
+	for (i = 0; i < nr; i++)
+		bio_add_page(bio, pages[i], PAGE_SIZE, 0);
+
+	ret = submit_bio_wait(bio);
+	bio_put(bio);
+
+	for (i = 0; i < nr; i++) {
+		u32 index = indices[i];
+
+		zram_slot_lock(zram, index);
+		if (ret || !zram_test_flag(zram, index, ZRAM_UNDER_WB)) {
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_slot_unlock(zram, index);
+			put_entry_bdev(zram, entry + i);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_set_element(zram, index, entry + i);
+		zram_slot_unlock(zram, index);
+
+		atomic64_inc(&zram->stats.pages_stored);
+		atomic64_inc(&zram->stats.bd_count);
+		atomic64_inc(&zram->stats.bd_writes);
+	}
+
+	return ret;
+}
+
+/*
+ * Move pages from memory to the backing device: "huge" writes out the
+ * pages that are stored uncompressed, "idle" the pages still marked idle
+ * since the last write to the idle attribute.  Pages are collected into
+ * bios of up to ZRAM_WB_BATCH consecutive blocks.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct page *pages[ZRAM_WB_BATCH] = { NULL };
+	u32 indices[ZRAM_WB_BATCH];
+	unsigned long nr_pages, entry = 0, start = 0;
+	unsigned int i, nr = 0;
+	bool huge_only;
+	ssize_t ret = 0;
+	u32 index;
+
+	if (sysfs_streq(buf, "huge"))
+		huge_only = true;
+	else if (sysfs_streq(buf, "idle"))
+		huge_only = false;
+	else
+		return -EINVAL;
+
+	/*
+	 * One writeback at a time: ZRAM_UNDER_WB only tells whether a page
+	 * changed while its own IO was in flight.
+	 */
+	if (!mutex_trylock(&zram->wb_lock))
+		return -EBUSY;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram_wb_enabled(zram)) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		bool candidate = false;
+
+		if (!entry) {
+			entry = get_entry_bdev(zram);
+			if (!entry) {
+				ret = -ENOSPC;
+				break;
+			}
+		}
+
+		/* A bio covers consecutive blocks only */
+		if (nr && entry != start + nr) {
+			ret = zram_wb_submit(zram, pages, indices, start, nr);
+			nr = 0;
+			if (ret)
+				break;
+		}
+
+		zram_slot_lock(zram, index);
+		if (zram_wb_candidate(zram, index, huge_only)) {
+			ret = zram_read_from_zspool(zram, pages[nr], index);
+			if (!ret) {
+				zram_set_flag(zram, index, ZRAM_UNDER_WB);
+				candidate = true;
+			}
+		}
+		zram_slot_unlock(zram, index);
+		if (ret)
+			break;
+
+		if (candidate) {
+			if (!nr)
+				start = entry;
+			indices[nr++] = index;
+			entry = 0;
+		}
+
+		if (nr == ZRAM_WB_BATCH) {
+			ret = zram_wb_submit(zram, pages, indices, start, nr);
+			nr = 0;
+			if (ret)
+				break;
+		}
+
+		cond_resched();
+	}
+
+	if (nr) {
+		int err = zram_wb_submit(zram, pages, indices, start, nr);
+
+		if (!ret)
+			ret = err;
+	}
+	if (entry)
+		put_entry_bdev(zram, entry);
+out_free:
+	for (i = 0; i < ZRAM_WB_BATCH && pages[i]; i++)
+		__free_page(pages[i]);
+out_unlock:
+	up_read(&zram->init_lock);
+	mutex_unlock(&zram->wb_lock);
+
+	return ret ? ret : len;
+}
+#endif
+
 /*
  * zram_bio_discard - handler on discard request
  * @index: physical block index in PAGE_SIZE units
@@ -1310,7 +1728,7 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 
 static void zram_reset_device(struct zram *zram)
 {
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp;
 	u64 disksize;
 
 	down_write(&zram->init_lock);
@@ -1323,6 +1741,8 @@ static void zram_reset_device(struct zram *zram)
 	}
 
 	comp = zram->comp;
+	recomp = zram->recomp;
+	zram->recomp = NULL;
 	disksize = zram->disksize;
 	zram->disksize = 0;
 
@@ -1334,6 +1754,8 @@ static void zram_reset_device(struct zram *zram)
 	zram_meta_free(zram, disksize);
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zcomp_destroy(comp);
+	if (recomp)
+		zcomp_destroy(recomp);
 	reset_bdev(zram);
 }
 
@@ -1341,7 +1763,7 @@ static ssize_t disksize_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	u64 disksize;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp = NULL;
 	struct zram *zram = dev_to_zram(dev);
 	int err;
 
@@ -1370,7 +1792,18 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	if (zram->recomp_compressor[0]) {
+		recomp = zcomp_create(zram->recomp_compressor);
+		if (IS_ERR(recomp)) {
+			pr_err("Cannot initialise %s recompressing backend\n",
+					zram->recomp_compressor);
+			err = PTR_ERR(recomp);
+			goto out_free_comp;
+		}
+	}
+
 	zram->comp = comp;
+	zram->recomp = recomp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 	zram_revalidate_disk(zram);
@@ -1378,6 +1811,8 @@ static ssize_t disksize_store(struct device *dev,
 
 	return len;
 
+out_free_comp:
+	zcomp_destroy(comp);
 out_free_meta:
 	zram_meta_free(zram, disksize);
 out_unlock:
@@ -1460,8 +1895,13 @@ static DEVICE_ATTR_WO(mem_limit);
 static DEVICE_ATTR_WO(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_WO(idle);
+static DEVICE_ATTR_WO(recompress);
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_WO(writeback);
+static DEVICE_ATTR_RO(bd_stat);
 #endif
 
 static struct attribute *zram_disk_attrs[] = {
@@ -1473,8 +1913,13 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_recompress.attr,
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_stat.attr,
 #endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
@@ -1506,6 +1951,9 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	mutex_init(&zram->wb_lock);
+#endif
 
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
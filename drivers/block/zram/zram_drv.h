@@ -16,6 +16,7 @@
 #define _ZRAM_DRV_H_
 
 #include <linux/rwsem.h>
+#include <linux/mutex.h>
 #include <linux/zsmalloc.h>
 #include <linux/crypto.h>
 
@@ -64,6 +65,10 @@ enum zram_pageflags {
 	ZRAM_SAME = ZRAM_FLAG_SHIFT,
 	ZRAM_ACCESS,	/* page is now accessed */
 	ZRAM_WB,	/* page is stored on backing_device */
+	ZRAM_IDLE,	/* not accessed since it was last marked idle */
+	ZRAM_RECOMP,	/* compressed with the recompression algorithm */
+	ZRAM_HUGE,	/* stored uncompressed, it didn't compress well */
+	ZRAM_UNDER_WB,	/* being written back; freeing the page clears it */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -91,12 +96,21 @@ struct zram_stats {
 	atomic64_t pages_stored;	/* no. of pages currently stored */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
+	atomic64_t recomp_pages;	/* no. of pages recompressed */
+	atomic64_t huge_pages;		/* no. of pages stored uncompressed */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;		/* no. of pages on the backing device */
+	atomic64_t bd_reads;		/* no. of reads from backing device */
+	atomic64_t bd_writes;		/* no. of writes to backing device */
+#endif
 };
 
 struct zram {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
 	struct zcomp *comp;
+	/* optional, stronger algorithm idle pages get recompressed with */
+	struct zcomp *recomp;
 	struct gendisk *disk;
 	/* Prevent concurrent execution of device init */
 	struct rw_semaphore init_lock;
@@ -112,6 +126,7 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[CRYPTO_MAX_ALG_NAME];
+	char recomp_compressor[CRYPTO_MAX_ALG_NAME];
 	/*
 	 * zram is claimed so open request will be failed
 	 */
@@ -123,6 +138,7 @@ struct zram {
 	unsigned long *bitmap;
 	unsigned long nr_pages;
 	spinlock_t bitmap_lock;
+	struct mutex wb_lock;	/* serialises writeback_store() */
 #endif
 };
 #endif
@@ -14,20 +14,33 @@
 
 #include <linux/clocksource.h>
 #include <linux/clockchips.h>
+#include <linux/cpu.h>
 #include <linux/delay.h>
+#include <linux/io.h>
+#include <linux/of_address.h>
+#include <linux/sched_clock.h>
 #include <linux/timer_riscv.h>
 #include <asm/sbi.h>
+#include <asm/smp.h>
 
 #define MINDELTA 100
 #define MAXDELTA 0x7fffffff
 
+/* Supervisor timer compare CSRs, see the "Sstc" proposal */
+#define CSR_STIMECMP	0x14d
+#define CSR_STIMECMPH	0x15d
+
 /*
  * See <linux/timer_riscv.h> for the rationale behind pre-allocating per-cpu
  * timers on RISC-V systems.
  */
 DECLARE_PER_CPU(struct clock_event_device, riscv_clock_event);
+DECLARE_PER_CPU(struct clock_event_device, riscv_clock_event_direct);
 DECLARE_PER_CPU(struct clocksource, riscv_clocksource);
 
+/* This hart's memory-mapped supervisor timer compare register, if any */
+static DEFINE_PER_CPU(void __iomem *, riscv_timecmp);
+
 static int next_event(unsigned long delta, struct clock_event_device *ce)
 {
 	/*
@@ -40,15 +53,72 @@ static int next_event(unsigned long delta, struct clock_event_device *ce)
 	return 0;
 }
 
+static int sbi_timer_shutdown(struct clock_event_device *ce)
+{
+	/*
+	 * Push the firmware's deadline out of reach so it doesn't raise a
+	 * stray interrupt after a direct clockevent has taken over.
+	 */
+	sbi_set_timer(ULLONG_MAX);
+	return 0;
+}
+
 DEFINE_PER_CPU(struct clock_event_device, riscv_clock_event) = {
 	.name           = "riscv_timer_clockevent",
 	.features       = CLOCK_EVT_FEAT_ONESHOT,
 	.rating         = 100,
 	.set_state_oneshot  = NULL,
-	.set_state_shutdown = NULL,
+	.set_state_shutdown = sbi_timer_shutdown,
 	.set_next_event = next_event,
 };
 
+/*
+ * Some implementations let S-mode program its timer compare value without
+ * trapping into the SBI, either through a memory-mapped alias of the
+ * per-hart compare register that raises the supervisor timer interrupt
+ * directly, or through the stimecmp CSR.  Either way, writing a value in
+ * the future also clears the pending interrupt.
+ */
+static int next_event_mmio(unsigned long delta, struct clock_event_device *ce)
+{
+	void __iomem *timecmp = __this_cpu_read(riscv_timecmp);
+	u64 val = get_cycles64() + delta;
+
+#ifdef CONFIG_64BIT
+	writeq_relaxed(val, timecmp);
+#else
+	/* Keep the compare value in the future while it's half-written */
+	writel_relaxed(0xffffffff, timecmp);
+	writel_relaxed(val >> 32, timecmp + 4);
+	writel_relaxed(val, timecmp);
+#endif
+	return 0;
+}
+
+static int next_event_csr(unsigned long delta, struct clock_event_device *ce)
+{
+	u64 val = get_cycles64() + delta;
+
+#ifdef CONFIG_64BIT
+	__asm__ __volatile__ ("csrw %0, %1"
+			      : : "i" (CSR_STIMECMP), "r" (val));
+#else
+	__asm__ __volatile__ ("csrw %0, %1"
+			      : : "i" (CSR_STIMECMP), "r" (-1UL));
+	__asm__ __volatile__ ("csrw %0, %1"
+			      : : "i" (CSR_STIMECMPH), "r" ((u32)(val >> 32)));
+	__asm__ __volatile__ ("csrw %0, %1"
+			      : : "i" (CSR_STIMECMP), "r" ((u32)val));
+#endif
+	return 0;
+}
+
+DEFINE_PER_CPU(struct clock_event_device, riscv_clock_event_direct) = {
+	.name           = "riscv_timer_direct_clockevent",
+	.features       = CLOCK_EVT_FEAT_ONESHOT,
+	.rating         = 150,
+};
+
 DEFINE_PER_CPU(bool, riscv_clock_event_enabled) = false;
 
 static unsigned long long rdtime(struct clocksource *cs)
@@ -68,8 +138,14 @@ DEFINE_PER_CPU(struct clocksource, riscv_clocksource) = {
 	.mask = CLOCKSOURCE_MASK(BITS_PER_LONG),
 	.flags = CLOCK_SOURCE_IS_CONTINUOUS,
 	.read = rdtime,
+	.archdata.vdso_direct = true,
 };
 
+static u64 notrace riscv_sched_clock(void)
+{
+	return get_cycles64();
+}
+
 void timer_riscv_init(int cpu_id,
 		      unsigned long riscv_timebase,
 		      int (*next)(unsigned long, struct clock_event_device*))
@@ -94,20 +170,71 @@ static int hart_of_timer(struct device_node *dev)
 	return hart;
 }
 
-static int timer_riscv_init_dt(struct device_node *n)
+/*
+ * Set up a second, higher-rated clockevent when the device tree says this
+ * hart's compare register can be written from S-mode: "riscv,stimecmp" for
+ * the CSR, or a "reg" entry pointing at a memory-mapped alias.
+ */
+static void timer_riscv_init_direct(struct device_node *n, int cpu_id)
 {
-	int cpu_id = hart_of_timer(n);
-	struct clock_event_device *ce = per_cpu_ptr(&riscv_clock_event, cpu_id);
-	struct clocksource *cs = per_cpu_ptr(&riscv_clocksource, cpu_id);
+	struct clock_event_device *ce =
+		per_cpu_ptr(&riscv_clock_event_direct, cpu_id);
+	void __iomem *timecmp;
+
+	if (of_property_read_bool(n, "riscv,stimecmp")) {
+		ce->set_next_event = next_event_csr;
+	} else {
+		timecmp = of_iomap(n, 0);
+		if (!timecmp)
+			return;
+		per_cpu(riscv_timecmp, cpu_id) = timecmp;
+		ce->set_next_event = next_event_mmio;
+	}
+}
+
+/*
+ * Run on each CPU as it comes online, whether at boot or after a hotplug:
+ * the clockevents core forgets a CPU's devices when it goes down.
+ */
+static int riscv_timer_starting_cpu(unsigned int cpu)
+{
+	struct clock_event_device *ce = per_cpu_ptr(&riscv_clock_event, cpu);
 
-	if (cpu_id == smp_processor_id()) {
-		clocksource_register_hz(cs, riscv_timebase);
+	ce->cpumask = cpumask_of(cpu);
+	clockevents_config_and_register(ce, riscv_timebase, MINDELTA, MAXDELTA);
 
-		ce->cpumask = cpumask_of(cpu_id);
-		clockevents_config_and_register(ce, riscv_timebase, MINDELTA, MAXDELTA);
+	ce = per_cpu_ptr(&riscv_clock_event_direct, cpu);
+	if (ce->set_next_event) {
+		ce->cpumask = cpumask_of(cpu);
+		clockevents_config_and_register(ce, riscv_timebase,
+						MINDELTA, MAXDELTA);
 	}
 
 	return 0;
 }
 
+static int timer_riscv_init_dt(struct device_node *n)
+{
+	int hart = hart_of_timer(n);
+	int cpu_id = hart < 0 ? hart : riscv_hartid_to_cpuid(hart);
+	struct clocksource *cs;
+
+	if (cpu_id < 0)
+		return 0;
+
+	timer_riscv_init_direct(n, cpu_id);
+
+	/* All the harts share one timebase: a single clocksource will do */
+	if (cpu_id != smp_processor_id())
+		return 0;
+
+	cs = per_cpu_ptr(&riscv_clocksource, cpu_id);
+	clocksource_register_hz(cs, riscv_timebase);
+	sched_clock_register(riscv_sched_clock, 64, riscv_timebase);
+
+	return cpuhp_setup_state(CPUHP_AP_RISCV_TIMER_STARTING,
+				 "clockevents/riscv/timer:starting",
+				 riscv_timer_starting_cpu, NULL);
+}
+
 TIMER_OF_DECLARE(riscv_timer, "riscv,cpu-timer", timer_riscv_init_dt);
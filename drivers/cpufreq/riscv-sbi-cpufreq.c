@@ -0,0 +1,253 @@
+/*
+ * CPUFreq driver for RISC-V harts whose performance level is set through
+ * the CPPC extension of the SBI
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt)	"riscv-sbi-cpufreq: " fmt
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+
+#include <asm/sbi.h>
+
+/*
+ * The CPPC registers the SBI gives access to are those of the calling
+ * hart, so every policy covers a single CPU and the requests are made on
+ * it: schedutil only fast-switches a policy from one of its own CPUs
+ * when dvfs_possible_from_any_cpu is clear, and everything else is sent
+ * there with an IPI.  Performance levels are abstract, and are taken to
+ * scale linearly with frequency through the nominal level.
+ */
+struct sbi_cpufreq_data {
+	unsigned long highest_perf;
+	unsigned long nominal_perf;
+	unsigned long lowest_nonlinear_perf;
+	unsigned long lowest_perf;
+	unsigned long nominal_khz;
+	unsigned long desired_perf;
+	long err;
+};
+
+static unsigned int sbi_perf_to_khz(struct sbi_cpufreq_data *data,
+				    unsigned long perf)
+{
+	return (u64)perf * data->nominal_khz / data->nominal_perf;
+}
+
+static unsigned long sbi_khz_to_perf(struct sbi_cpufreq_data *data,
+				     unsigned int khz)
+{
+	u64 perf = DIV_ROUND_UP_ULL((u64)khz * data->nominal_perf,
+				    data->nominal_khz);
+
+	return clamp_t(u64, perf, data->lowest_perf, data->highest_perf);
+}
+
+/* Run on the CPU the data is for */
+static void sbi_cpufreq_read_caps(void *arg)
+{
+	struct sbi_cpufreq_data *data = arg;
+	unsigned long mhz;
+
+	data->err = sbi_cppc_read(SBI_CPPC_HIGHEST_PERF, &data->highest_perf);
+	if (!data->err)
+		data->err = sbi_cppc_read(SBI_CPPC_NOMINAL_PERF,
+					  &data->nominal_perf);
+	if (!data->err)
+		data->err = sbi_cppc_read(SBI_CPPC_LOWEST_PERF,
+					  &data->lowest_perf);
+	if (!data->err)
+		data->err = sbi_cppc_read(SBI_CPPC_NOMINAL_FREQ, &mhz);
+	if (data->err)
+		return;
+
+	/* Optional: the lowest level worth running at for its power */
+	if (sbi_cppc_read(SBI_CPPC_LOWEST_NONLINEAR_PERF,
+			  &data->lowest_nonlinear_perf))
+		data->lowest_nonlinear_perf = data->lowest_perf;
+
+	data->nominal_khz = mhz * 1000;
+}
+
+static void sbi_cpufreq_write_desired(void *arg)
+{
+	struct sbi_cpufreq_data *data = arg;
+
+	data->err = sbi_cppc_write(SBI_CPPC_DESIRED_PERF, data->desired_perf);
+}
+
+static int sbi_cpufreq_set_perf(struct cpufreq_policy *policy,
+				unsigned long perf)
+{
+	struct sbi_cpufreq_data *data = policy->driver_data;
+	int ret;
+
+	data->desired_perf = perf;
+	ret = smp_call_function_single(policy->cpu, sbi_cpufreq_write_desired,
+				       data, 1);
+	if (ret)
+		return ret;
+	return data->err ? sbi_err_map_linux_errno(data->err) : 0;
+}
+
+static int sbi_cpufreq_target(struct cpufreq_policy *policy,
+			      unsigned int target_freq,
+			      unsigned int relation)
+{
+	struct sbi_cpufreq_data *data = policy->driver_data;
+	struct cpufreq_freqs freqs;
+	unsigned long perf = sbi_khz_to_perf(data, target_freq);
+	int ret;
+
+	if (perf == data->desired_perf)
+		return 0;
+
+	freqs.old = policy->cur;
+	freqs.new = sbi_perf_to_khz(data, perf);
+
+	cpufreq_freq_transition_begin(policy, &freqs);
+	ret = sbi_cpufreq_set_perf(policy, perf);
+	cpufreq_freq_transition_end(policy, &freqs, ret != 0);
+
+	if (!ret)
+		arch_set_freq_scale(policy->related_cpus, freqs.new,
+				    policy->cpuinfo.max_freq);
+
+	return ret;
+}
+
+/* From the scheduler, on policy->cpu with interrupts off: 0 on failure */
+static unsigned int sbi_cpufreq_fast_switch(struct cpufreq_policy *policy,
+					    unsigned int target_freq)
+{
+	struct sbi_cpufreq_data *data = policy->driver_data;
+	unsigned long perf = sbi_khz_to_perf(data, target_freq);
+	unsigned int freq;
+
+	if (perf != data->desired_perf) {
+		if (sbi_cppc_write(SBI_CPPC_DESIRED_PERF, perf))
+			return 0;
+		data->desired_perf = perf;
+	}
+
+	freq = sbi_perf_to_khz(data, perf);
+	arch_set_freq_scale(policy->related_cpus, freq,
+			    policy->cpuinfo.max_freq);
+
+	return freq;
+}
+
+static int sbi_cpufreq_verify(struct cpufreq_policy *policy)
+{
+	cpufreq_verify_within_cpu_limits(policy);
+	return 0;
+}
+
+static int sbi_cpufreq_cpu_init(struct cpufreq_policy *policy)
+{
+	struct sbi_cpufreq_data *data;
+	int ret;
+
+	data = kzalloc(sizeof(*data), GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+
+	ret = smp_call_function_single(policy->cpu, sbi_cpufreq_read_caps,
+				       data, 1);
+	if (!ret && data->err)
+		ret = sbi_err_map_linux_errno(data->err);
+	if (!ret && (!data->nominal_perf || !data->nominal_khz ||
+		     data->lowest_perf > data->highest_perf))
+		ret = -ENODEV;
+	if (ret) {
+		pr_debug("CPU%u: no usable CPPC registers: %d\n",
+			 policy->cpu, ret);
+		kfree(data);
+		return ret;
+	}
+
+	policy->driver_data = data;
+	policy->cpuinfo.min_freq = sbi_perf_to_khz(data, data->lowest_perf);
+	policy->cpuinfo.max_freq = sbi_perf_to_khz(data, data->highest_perf);
+	policy->min = sbi_perf_to_khz(data, data->lowest_nonlinear_perf);
+	policy->max = policy->cpuinfo.max_freq;
+
+	/* The firmware doesn't say, a request being just an ecall */
+	policy->cpuinfo.transition_latency = 0;
+	policy->fast_switch_possible = true;
+	policy->dvfs_possible_from_any_cpu = false;
+
+	/* Start flat out, and let the governor bring it down */
+	ret = sbi_cpufreq_set_perf(policy, data->highest_perf);
+	if (ret) {
+		policy->driver_data = NULL;
+		kfree(data);
+		return ret;
+	}
+	policy->cur = policy->cpuinfo.max_freq;
+
+	return 0;
+}
+
+static int sbi_cpufreq_cpu_exit(struct cpufreq_policy *policy)
+{
+	kfree(policy->driver_data);
+	policy->driver_data = NULL;
+	return 0;
+}
+
+static unsigned int sbi_cpufreq_get(unsigned int cpu)
+{
+	struct cpufreq_policy *policy = cpufreq_cpu_get_raw(cpu);
+	struct sbi_cpufreq_data *data;
+
+	if (!policy || !policy->driver_data)
+		return 0;
+	data = policy->driver_data;
+	return sbi_perf_to_khz(data, data->desired_perf);
+}
+
+static struct cpufreq_driver sbi_cpufreq_driver = {
+	.name		= "riscv-sbi",
+	.flags		= CPUFREQ_CONST_LOOPS,
+	.verify		= sbi_cpufreq_verify,
+	.target		= sbi_cpufreq_target,
+	.fast_switch	= sbi_cpufreq_fast_switch,
+	.get		= sbi_cpufreq_get,
+	.init		= sbi_cpufreq_cpu_init,
+	.exit		= sbi_cpufreq_cpu_exit,
+};
+
+static int __init sbi_cpufreq_init(void)
+{
+	if (sbi_probe_extension(SBI_EXT_CPPC) <= 0 ||
+	    sbi_cppc_probe(SBI_CPPC_DESIRED_PERF) <= 0)
+		return -ENODEV;
+
+	return cpufreq_register_driver(&sbi_cpufreq_driver);
+}
+module_init(sbi_cpufreq_init);
+
+static void __exit sbi_cpufreq_exit(void)
+{
+	cpufreq_unregister_driver(&sbi_cpufreq_driver);
+}
+module_exit(sbi_cpufreq_exit);
+
+MODULE_DESCRIPTION("CPUFreq driver for the SBI CPPC extension");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,218 @@
+/*
+ * RISC-V CPU idle driver, using the SBI HSM hart suspend call.
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) "CPUidle riscv: " fmt
+
+#include <linux/cpuidle.h>
+#include <linux/cpumask.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/of_device.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+
+#include <asm/processor.h>
+#include <asm/sbi.h>
+
+#include "dt_idle_states.h"
+
+/* The SBI suspend type of each of the CPU's states, indexed like them */
+static DEFINE_PER_CPU_READ_MOSTLY(u32 [CPUIDLE_STATE_MAX], sbi_suspend_type);
+
+/*
+ * riscv_enter_idle_state - Suspends the hart in the specified state
+ *
+ * dev: cpuidle device
+ * drv: cpuidle driver
+ * idx: state index
+ *
+ * Only retentive states are ever enabled, so like wfi the SBI call
+ * returns here once an interrupt is pending, with all our state intact.
+ */
+static int riscv_enter_idle_state(struct cpuidle_device *dev,
+				  struct cpuidle_driver *drv, int idx)
+{
+	u32 type = per_cpu(sbi_suspend_type, dev->cpu)[idx];
+
+	if (!idx) {
+		wait_for_interrupt();
+		return idx;
+	}
+
+	return sbi_hsm_hart_suspend(type, 0, 0) ? -EBUSY : idx;
+}
+
+static struct cpuidle_driver riscv_idle_driver __initdata = {
+	.name = "riscv_idle",
+	.owner = THIS_MODULE,
+	/*
+	 * wfi needs no help from the firmware and is always there, so it
+	 * is state 0 and the DT only describes the states below it.
+	 */
+	.states[0] = {
+		.enter                  = riscv_enter_idle_state,
+		.exit_latency           = 1,
+		.target_residency       = 1,
+		.power_usage		= UINT_MAX,
+		.name                   = "WFI",
+		.desc                   = "RISC-V WFI",
+	}
+};
+
+static const struct of_device_id riscv_idle_state_match[] __initconst = {
+	{ .compatible = "riscv,idle-state",
+	  .data = riscv_enter_idle_state },
+	{ },
+};
+
+static bool __init sbi_suspend_type_valid(u32 type)
+{
+	u32 ret = type & ~SBI_HSM_SUSPEND_NON_RET_BIT;
+
+	/* Types 0x1 to 0x0fffffff are reserved, with or without the bit */
+	return ret == SBI_HSM_SUSPEND_RET_DEFAULT ||
+	       ret >= SBI_HSM_SUSPEND_RET_PLATFORM;
+}
+
+/*
+ * Read the SBI suspend type of each of the CPU's idle states, walking
+ * its cpu-idle-states the way dt_init_idle_driver() did to number them.
+ *
+ * Resuming from a non-retentive state would mean saving the hart context
+ * and coming back through head.S, which we don't do yet: such states are
+ * kept in the driver, so the numbering still matches the DT, but
+ * disabled.
+ */
+static int __init riscv_cpuidle_init_cpu(int cpu, struct cpuidle_driver *drv)
+{
+	u32 *types = per_cpu(sbi_suspend_type, cpu);
+	struct device_node *cpu_node, *state_node;
+	int i, idx = 1, ret = 0;
+
+	cpu_node = of_cpu_device_node_get(cpu);
+	if (!cpu_node)
+		return -ENODEV;
+
+	for (i = 0; idx < drv->state_count; i++) {
+		state_node = of_parse_phandle(cpu_node, "cpu-idle-states", i);
+		if (!state_node)
+			break;
+
+		if (!of_device_is_available(state_node)) {
+			of_node_put(state_node);
+			continue;
+		}
+
+		ret = of_property_read_u32(state_node, "riscv,sbi-suspend-param",
+					   &types[idx]);
+		if (ret || !sbi_suspend_type_valid(types[idx])) {
+			pr_err("%pOF has no valid riscv,sbi-suspend-param\n",
+			       state_node);
+			of_node_put(state_node);
+			ret = -ENXIO;
+			break;
+		}
+
+		if (types[idx] & SBI_HSM_SUSPEND_NON_RET_BIT) {
+			pr_warn_once("%pOF is non-retentive, disabling it\n",
+				     state_node);
+			drv->states[idx].disabled = true;
+		}
+
+		of_node_put(state_node);
+		idx++;
+	}
+
+	of_node_put(cpu_node);
+	return ret;
+}
+
+/*
+ * riscv_idle_init
+ *
+ * Registers the riscv cpuidle driver with the cpuidle framework, one
+ * driver per CPU since the DT can give each hart its own states.  With
+ * no HSM extension to suspend through, or no DT idle states, there is
+ * nothing beyond the default wfi idle loop to offer.
+ */
+static int __init riscv_idle_init(void)
+{
+	struct cpuidle_driver *drv;
+	struct cpuidle_device *dev;
+	int cpu, ret;
+
+	if (!sbi_probe_extension(SBI_EXT_HSM)) {
+		pr_info("no SBI HSM extension, using wfi only\n");
+		return -ENODEV;
+	}
+
+	for_each_possible_cpu(cpu) {
+		drv = kmemdup(&riscv_idle_driver, sizeof(*drv), GFP_KERNEL);
+		if (!drv) {
+			ret = -ENOMEM;
+			goto out_fail;
+		}
+
+		drv->cpumask = (struct cpumask *)cpumask_of(cpu);
+
+		ret = dt_init_idle_driver(drv, riscv_idle_state_match, 1);
+		if (ret <= 0) {
+			ret = ret ? : -ENODEV;
+			goto init_fail;
+		}
+
+		ret = riscv_cpuidle_init_cpu(cpu, drv);
+		if (ret)
+			goto init_fail;
+
+		ret = cpuidle_register_driver(drv);
+		if (ret) {
+			pr_err("Failed to register cpuidle driver\n");
+			goto init_fail;
+		}
+
+		dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+		if (!dev) {
+			pr_err("Failed to allocate cpuidle device\n");
+			ret = -ENOMEM;
+			goto unregister_drv;
+		}
+		dev->cpu = cpu;
+
+		ret = cpuidle_register_device(dev);
+		if (ret) {
+			pr_err("Failed to register cpuidle device for CPU %d\n",
+			       cpu);
+			kfree(dev);
+			goto unregister_drv;
+		}
+	}
+
+	return 0;
+unregister_drv:
+	cpuidle_unregister_driver(drv);
+init_fail:
+	kfree(drv);
+out_fail:
+	while (--cpu >= 0) {
+		if (!cpu_possible(cpu))
+			continue;
+		dev = per_cpu(cpuidle_devices, cpu);
+		drv = cpuidle_get_cpu_driver(dev);
+		cpuidle_unregister_device(dev);
+		kfree(dev);
+		cpuidle_unregister_driver(drv);
+		kfree(drv);
+	}
+
+	return ret;
+}
+device_initcall(riscv_idle_init);
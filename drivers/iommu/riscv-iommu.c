@@ -0,0 +1,1150 @@
+/*
+ * IOMMU API for RISC-V IOMMU implementations
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Only the base subset of the RISC-V IOMMU specification is driven:
+ * first-stage Sv39 translation of device DMA through the device
+ * directory, invalidated through the command queue.  There is no second
+ * stage, no MSI remapping, no ATS and no process contexts.
+ */
+
+#define pr_fmt(fmt) "riscv-iommu: " fmt
+
+#include <linux/bitops.h>
+#include <linux/delay.h>
+#include <linux/dma-iommu.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/idr.h>
+#include <linux/interrupt.h>
+#include <linux/iommu.h>
+#include <linux/iopoll.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/of_iommu.h>
+#include <linux/pci.h>
+#include <linux/platform_device.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include <asm/pgtable.h>
+
+/* MMIO registers */
+#define RISCV_IOMMU_CAPS		0x00
+#define CAPS_SV39			(1UL << 9)
+#define CAPS_MSI_FLAT			(1UL << 22)
+#define CAPS_IGS_SHIFT			28
+#define CAPS_IGS_MASK			0x3
+#define CAPS_IGS_MSI			0
+#define CAPS_IGS_WSI			1
+#define CAPS_IGS_BOTH			2
+
+#define RISCV_IOMMU_FCTL		0x08
+#define FCTL_BE				(1 << 0)
+#define FCTL_WSI			(1 << 1)
+
+#define RISCV_IOMMU_DDTP		0x10
+#define DDTP_MODE_MASK			0xfUL
+#define DDTP_MODE_OFF			0
+#define DDTP_MODE_BARE			1
+#define DDTP_MODE_1LVL			2
+#define DDTP_MODE_2LVL			3
+#define DDTP_MODE_3LVL			4
+#define DDTP_BUSY			(1UL << 4)
+#define DDTP_PPN_SHIFT			10
+
+#define RISCV_IOMMU_CQB			0x18
+#define RISCV_IOMMU_CQH			0x20
+#define RISCV_IOMMU_CQT			0x24
+#define RISCV_IOMMU_FQB			0x28
+#define RISCV_IOMMU_FQH			0x30
+#define RISCV_IOMMU_FQT			0x34
+#define QB_LOG2SZ_MASK			0x1fUL
+#define QB_PPN_SHIFT			10
+
+#define RISCV_IOMMU_CQCSR		0x48
+#define RISCV_IOMMU_FQCSR		0x4c
+#define QCSR_EN				(1 << 0)
+#define QCSR_IE				(1 << 1)
+#define QCSR_MF				(1 << 8)
+#define CQCSR_CMD_TO			(1 << 9)
+#define CQCSR_CMD_ILL			(1 << 10)
+#define FQCSR_OF			(1 << 9)
+#define QCSR_ON				(1 << 16)
+#define QCSR_BUSY			(1 << 17)
+#define CQCSR_ERR_MASK			(QCSR_MF | CQCSR_CMD_TO | CQCSR_CMD_ILL)
+#define FQCSR_ERR_MASK			(QCSR_MF | FQCSR_OF)
+
+#define RISCV_IOMMU_IPSR		0x54
+#define IPSR_FIP			(1 << 1)
+
+#define RISCV_IOMMU_ICVEC		0x2f8
+#define ICVEC_FIV_SHIFT			4
+
+/* Device directory */
+#define DDTE_VALID			(1UL << 0)
+#define DDTE_PPN_SHIFT			10
+#define DDT_LEAF_BITS_BASE		7
+#define DDT_LEAF_BITS_EXT		6
+#define DDT_NONLEAF_BITS		9
+#define DEVID_MAX_BITS			24
+
+struct riscv_iommu_dc {
+	u64				tc;
+	u64				iohgatp;
+	u64				ta;
+	u64				fsc;
+	/* Only in the extended format, when MSI_FLAT is supported */
+	u64				msiptp;
+	u64				msi_addr_mask;
+	u64				msi_addr_pattern;
+	u64				_reserved;
+};
+
+#define DC_BASE_SIZE			32
+#define DC_EXT_SIZE			64
+#define DC_TC_V				(1UL << 0)
+#define DC_TA_PSCID_SHIFT		12
+#define DC_FSC_MODE_SHIFT		60
+#define DC_FSC_MODE_BARE		0UL
+#define DC_FSC_MODE_SV39		8UL
+
+/* Command queue */
+#define CQ_ENT_DWORDS			2
+#define CQ_OPCODE_IOTINVAL		1
+#define CQ_OPCODE_IOFENCE		2
+#define CQ_OPCODE_IODIR			3
+#define CQ_FUNC_SHIFT			7
+#define CQ_IOTINVAL_FUNC_VMA		0
+#define CQ_IOTINVAL_AV			(1UL << 10)
+#define CQ_IOTINVAL_PSCID_SHIFT		12
+#define CQ_IOTINVAL_PSCV		(1UL << 32)
+#define CQ_IOTINVAL_ADDR_SHIFT		10
+#define CQ_IOFENCE_FUNC_C		0
+#define CQ_IOFENCE_PR			(1UL << 12)
+#define CQ_IOFENCE_PW			(1UL << 13)
+#define CQ_IODIR_FUNC_INVAL_DDT		0
+#define CQ_IODIR_DV			(1UL << 33)
+#define CQ_IODIR_DID_SHIFT		40
+
+/* Fault queue */
+#define FQ_ENT_DWORDS			4
+#define FQ_CAUSE_MASK			0xfffUL
+#define FQ_TTYP_SHIFT			34
+#define FQ_TTYP_MASK			0x3fUL
+#define FQ_DID_SHIFT			40
+
+/* A page per queue is plenty for what we queue up */
+#define RISCV_IOMMU_QUEUE_SIZE		PAGE_SIZE
+#define RISCV_IOMMU_POLL_TIMEOUT_US	100000
+
+/* First-stage page tables */
+#define PT_LEVELS			3
+#define PT_LEVEL_BITS			9
+#define PT_PTRS				(1UL << PT_LEVEL_BITS)
+#define PT_LEVEL_SHIFT(l)		(PAGE_SHIFT + PT_LEVEL_BITS *	\
+					 (PT_LEVELS - 1 - (l)))
+#define PT_LEVEL_SIZE(l)		(1UL << PT_LEVEL_SHIFT(l))
+#define PT_INDEX(iova, l)		(((iova) >> PT_LEVEL_SHIFT(l)) &	\
+					 (PT_PTRS - 1))
+#define PTE_LEAF_MASK			(_PAGE_READ | _PAGE_WRITE | _PAGE_EXEC)
+
+/* Only the low half of Sv39: the rest would need sign-extended IOVAs */
+#define RISCV_IOMMU_IOVA_BITS		38
+
+#define RISCV_IOMMU_PSCID_MAX		(1 << 20)
+
+/*
+ * Past this many pages it is cheaper to drop the whole address space
+ * from the IOTLB than to invalidate it one page at a time.
+ */
+#define RISCV_IOMMU_INVAL_MAX_PAGES	64
+
+struct riscv_iommu_queue {
+	u64				*base;
+	dma_addr_t			base_dma;
+	unsigned int			mask;
+	unsigned int			tail;
+};
+
+struct riscv_iommu_device {
+	struct device			*dev;
+	void __iomem			*reg;
+	u64				caps;
+
+	unsigned int			ddt_mode;
+	unsigned int			dc_size;
+	unsigned int			devid_bits;
+	u64				*ddt_root;
+	struct mutex			ddt_mutex;
+
+	struct riscv_iommu_queue	cq;
+	spinlock_t			cq_lock;
+	struct riscv_iommu_queue	fq;
+
+	struct ida			pscids;
+
+	struct iommu_device		iommu;
+};
+
+struct riscv_iommu_domain {
+	struct iommu_domain		domain;
+	struct riscv_iommu_device	*iommu;
+	struct mutex			init_mutex;
+	unsigned int			pscid;
+
+	u64				*pgd;
+	spinlock_t			pgtbl_lock;
+
+	/* IOVAs unmapped since the last iotlb_sync, under pgtbl_lock */
+	unsigned long			inval_start;
+	unsigned long			inval_end;
+};
+
+struct riscv_iommu_master {
+	struct riscv_iommu_device	*iommu;
+	struct riscv_iommu_domain	*domain;
+};
+
+static struct iommu_ops riscv_iommu_ops;
+static struct platform_driver riscv_iommu_driver;
+
+static struct riscv_iommu_domain *to_riscv_domain(struct iommu_domain *dom)
+{
+	return container_of(dom, struct riscv_iommu_domain, domain);
+}
+
+/* Low-level queue manipulation functions */
+static int riscv_iommu_cmd_issue(struct riscv_iommu_device *iommu,
+				 const u64 *cmd)
+{
+	struct riscv_iommu_queue *q = &iommu->cq;
+	unsigned int next = (q->tail + 1) & q->mask;
+	u32 head;
+	int ret;
+
+	ret = readl_poll_timeout_atomic(iommu->reg + RISCV_IOMMU_CQH, head,
+					head != next, 1,
+					RISCV_IOMMU_POLL_TIMEOUT_US);
+	if (ret) {
+		dev_err_ratelimited(iommu->dev, "command queue stuck full\n");
+		return ret;
+	}
+
+	memcpy(&q->base[q->tail * CQ_ENT_DWORDS], cmd,
+	       CQ_ENT_DWORDS * sizeof(u64));
+	q->tail = next;
+
+	/* writel() orders the command in memory before the doorbell */
+	writel(q->tail, iommu->reg + RISCV_IOMMU_CQT);
+	return 0;
+}
+
+/*
+ * Wait for everything queued so far to take effect.  Called with the
+ * cq_lock held, so that nobody returns from an unmap while the
+ * invalidation somebody else issued on their behalf is in flight.
+ */
+static int riscv_iommu_cmd_sync(struct riscv_iommu_device *iommu)
+{
+	u64 cmd[CQ_ENT_DWORDS] = {
+		CQ_OPCODE_IOFENCE | (CQ_IOFENCE_FUNC_C << CQ_FUNC_SHIFT) |
+		CQ_IOFENCE_PR | CQ_IOFENCE_PW,
+		0,
+	};
+	u32 head, csr;
+	int ret;
+
+	ret = riscv_iommu_cmd_issue(iommu, cmd);
+	if (ret)
+		return ret;
+
+	ret = readl_poll_timeout_atomic(iommu->reg + RISCV_IOMMU_CQH, head,
+					head == iommu->cq.tail, 1,
+					RISCV_IOMMU_POLL_TIMEOUT_US);
+
+	csr = readl(iommu->reg + RISCV_IOMMU_CQCSR);
+	if (csr & CQCSR_ERR_MASK) {
+		dev_err_ratelimited(iommu->dev,
+				    "command queue error, cqcsr 0x%08x\n", csr);
+		/* The error bits are write-1-to-clear, and stop the queue */
+		writel(csr, iommu->reg + RISCV_IOMMU_CQCSR);
+		ret = -EIO;
+	} else if (ret) {
+		dev_err_ratelimited(iommu->dev, "IOFENCE.C timeout\n");
+	}
+
+	return ret;
+}
+
+/* Drop the cached context of one device, or of all of them */
+static int riscv_iommu_inval_ddt(struct riscv_iommu_device *iommu,
+				 u32 devid, bool all)
+{
+	u64 cmd[CQ_ENT_DWORDS] = {
+		CQ_OPCODE_IODIR | (CQ_IODIR_FUNC_INVAL_DDT << CQ_FUNC_SHIFT),
+		0,
+	};
+	unsigned long flags;
+	int ret;
+
+	if (!all)
+		cmd[0] |= CQ_IODIR_DV | ((u64)devid << CQ_IODIR_DID_SHIFT);
+
+	spin_lock_irqsave(&iommu->cq_lock, flags);
+	ret = riscv_iommu_cmd_issue(iommu, cmd);
+	if (!ret)
+		ret = riscv_iommu_cmd_sync(iommu);
+	spin_unlock_irqrestore(&iommu->cq_lock, flags);
+
+	return ret;
+}
+
+static int riscv_iommu_inval_vma(struct riscv_iommu_device *iommu,
+				 unsigned int pscid, unsigned long iova,
+				 bool all)
+{
+	u64 cmd[CQ_ENT_DWORDS] = {
+		CQ_OPCODE_IOTINVAL | (CQ_IOTINVAL_FUNC_VMA << CQ_FUNC_SHIFT) |
+		CQ_IOTINVAL_PSCV | ((u64)pscid << CQ_IOTINVAL_PSCID_SHIFT),
+		0,
+	};
+
+	if (!all) {
+		cmd[0] |= CQ_IOTINVAL_AV;
+		cmd[1] = (iova >> PAGE_SHIFT) << CQ_IOTINVAL_ADDR_SHIFT;
+	}
+
+	return riscv_iommu_cmd_issue(iommu, cmd);
+}
+
+static irqreturn_t riscv_iommu_fq_thread(int irq, void *dev)
+{
+	struct riscv_iommu_device *iommu = dev;
+	struct riscv_iommu_queue *q = &iommu->fq;
+	u32 head, tail, csr;
+	u64 *rec;
+
+	writel(IPSR_FIP, iommu->reg + RISCV_IOMMU_IPSR);
+
+	csr = readl(iommu->reg + RISCV_IOMMU_FQCSR);
+	if (csr & FQCSR_ERR_MASK) {
+		dev_err(iommu->dev, "fault queue error, fqcsr 0x%08x\n", csr);
+		writel(csr, iommu->reg + RISCV_IOMMU_FQCSR);
+	}
+
+	head = readl(iommu->reg + RISCV_IOMMU_FQH) & q->mask;
+	tail = readl(iommu->reg + RISCV_IOMMU_FQT) & q->mask;
+	if (head == tail)
+		return IRQ_NONE;
+
+	/* The tail read orders the records after it on a coherent IOMMU */
+	rmb();
+	for (; head != tail; head = (head + 1) & q->mask) {
+		rec = &q->base[head * FQ_ENT_DWORDS];
+		dev_err_ratelimited(iommu->dev,
+				    "fault: cause %llu ttyp %llu devid 0x%llx iotval 0x%llx\n",
+				    rec[0] & FQ_CAUSE_MASK,
+				    (rec[0] >> FQ_TTYP_SHIFT) & FQ_TTYP_MASK,
+				    rec[0] >> FQ_DID_SHIFT, rec[2]);
+	}
+
+	writel(head, iommu->reg + RISCV_IOMMU_FQH);
+	return IRQ_HANDLED;
+}
+
+/* IO page table management */
+static u64 *riscv_iommu_pte_to_table(u64 pte)
+{
+	return phys_to_virt(__page_val_to_pfn(pte) << PAGE_SHIFT);
+}
+
+static u64 riscv_iommu_table_to_pte(u64 *table)
+{
+	return (virt_to_pfn(table) << _PAGE_PFN_SHIFT) | _PAGE_PRESENT;
+}
+
+static u64 *riscv_iommu_pte_alloc(struct riscv_iommu_domain *dom,
+				  unsigned long iova, int level)
+{
+	u64 *table = dom->pgd;
+	u64 *ptep, *next;
+	int l;
+
+	for (l = 0; l < level; l++) {
+		ptep = &table[PT_INDEX(iova, l)];
+		if (!(*ptep & _PAGE_PRESENT)) {
+			next = (u64 *)get_zeroed_page(GFP_ATOMIC);
+			if (!next)
+				return NULL;
+			*ptep = riscv_iommu_table_to_pte(next);
+		} else if (*ptep & PTE_LEAF_MASK) {
+			/* Already covered by a larger mapping */
+			return NULL;
+		}
+		table = riscv_iommu_pte_to_table(*ptep);
+	}
+
+	return &table[PT_INDEX(iova, level)];
+}
+
+/* Returns the leaf covering the iova and its level, or NULL */
+static u64 *riscv_iommu_pte_lookup(struct riscv_iommu_domain *dom,
+				   unsigned long iova, int *level)
+{
+	u64 *table = dom->pgd;
+	u64 *ptep;
+	int l;
+
+	for (l = 0; l < PT_LEVELS; l++) {
+		ptep = &table[PT_INDEX(iova, l)];
+		if (!(*ptep & _PAGE_PRESENT))
+			return NULL;
+		if (*ptep & PTE_LEAF_MASK) {
+			*level = l;
+			return ptep;
+		}
+		table = riscv_iommu_pte_to_table(*ptep);
+	}
+
+	return NULL;
+}
+
+static void riscv_iommu_free_table(u64 *table, int level)
+{
+	unsigned long i;
+
+	if (level < PT_LEVELS - 1) {
+		for (i = 0; i < PT_PTRS; i++) {
+			if ((table[i] & _PAGE_PRESENT) &&
+			    !(table[i] & PTE_LEAF_MASK))
+				riscv_iommu_free_table(
+					riscv_iommu_pte_to_table(table[i]),
+					level + 1);
+		}
+	}
+
+	free_page((unsigned long)table);
+}
+
+static int riscv_iommu_size_to_level(size_t size)
+{
+	int l;
+
+	for (l = 0; l < PT_LEVELS; l++)
+		if (size == PT_LEVEL_SIZE(l))
+			return l;
+	return -EINVAL;
+}
+
+/* IOMMU API */
+static bool riscv_iommu_capable(enum iommu_cap cap)
+{
+	switch (cap) {
+	case IOMMU_CAP_NOEXEC:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static struct iommu_domain *riscv_iommu_domain_alloc(unsigned type)
+{
+	struct riscv_iommu_domain *dom;
+
+	if (type != IOMMU_DOMAIN_UNMANAGED &&
+	    type != IOMMU_DOMAIN_DMA &&
+	    type != IOMMU_DOMAIN_IDENTITY)
+		return NULL;
+
+	dom = kzalloc(sizeof(*dom), GFP_KERNEL);
+	if (!dom)
+		return NULL;
+
+	if (type != IOMMU_DOMAIN_IDENTITY) {
+		dom->pgd = (u64 *)get_zeroed_page(GFP_KERNEL);
+		if (!dom->pgd)
+			goto out_free;
+	}
+
+	if (type == IOMMU_DOMAIN_DMA &&
+	    iommu_get_dma_cookie(&dom->domain))
+		goto out_free_pgd;
+
+	dom->domain.geometry.aperture_start = 0;
+	dom->domain.geometry.aperture_end =
+		BIT_ULL(RISCV_IOMMU_IOVA_BITS) - 1;
+	dom->domain.geometry.force_aperture = true;
+
+	mutex_init(&dom->init_mutex);
+	spin_lock_init(&dom->pgtbl_lock);
+	dom->inval_start = ULONG_MAX;
+	return &dom->domain;
+
+out_free_pgd:
+	free_page((unsigned long)dom->pgd);
+out_free:
+	kfree(dom);
+	return NULL;
+}
+
+static void riscv_iommu_domain_free(struct iommu_domain *domain)
+{
+	struct riscv_iommu_domain *dom = to_riscv_domain(domain);
+	struct riscv_iommu_device *iommu = dom->iommu;
+	unsigned long flags;
+
+	iommu_put_dma_cookie(domain);
+
+	/* No device is left using it, but its entries may still be cached */
+	if (iommu && dom->pscid) {
+		spin_lock_irqsave(&iommu->cq_lock, flags);
+		if (!riscv_iommu_inval_vma(iommu, dom->pscid, 0, true))
+			riscv_iommu_cmd_sync(iommu);
+		spin_unlock_irqrestore(&iommu->cq_lock, flags);
+		ida_simple_remove(&iommu->pscids, dom->pscid);
+	}
+
+	if (dom->pgd)
+		riscv_iommu_free_table(dom->pgd, 0);
+	kfree(dom);
+}
+
+/*
+ * A domain gets its address space ID from the first IOMMU it is attached
+ * through, and can't span several of them from then on.
+ */
+static int riscv_iommu_domain_finalise(struct riscv_iommu_domain *dom,
+				       struct riscv_iommu_device *iommu)
+{
+	int ret = 0;
+
+	mutex_lock(&dom->init_mutex);
+	if (!dom->iommu) {
+		if (dom->domain.type != IOMMU_DOMAIN_IDENTITY) {
+			ret = ida_simple_get(&iommu->pscids, 1,
+					     RISCV_IOMMU_PSCID_MAX, GFP_KERNEL);
+			if (ret < 0)
+				goto out_unlock;
+			dom->pscid = ret;
+			ret = 0;
+		}
+		dom->iommu = iommu;
+	} else if (dom->iommu != iommu) {
+		ret = -EINVAL;
+	}
+out_unlock:
+	mutex_unlock(&dom->init_mutex);
+	return ret;
+}
+
+static struct riscv_iommu_dc *riscv_iommu_get_dc(struct riscv_iommu_device *iommu,
+						 u32 devid)
+{
+	unsigned int leaf_bits = iommu->dc_size == DC_EXT_SIZE ?
+				 DDT_LEAF_BITS_EXT : DDT_LEAF_BITS_BASE;
+	unsigned int depth = iommu->ddt_mode - DDTP_MODE_1LVL;
+	u64 *table = iommu->ddt_root;
+	u64 *ddtep, *next;
+	unsigned int idx;
+
+	lockdep_assert_held(&iommu->ddt_mutex);
+
+	for (; depth; depth--) {
+		idx = (devid >> (leaf_bits + DDT_NONLEAF_BITS * (depth - 1))) &
+		      ((1U << DDT_NONLEAF_BITS) - 1);
+		ddtep = &table[idx];
+		if (!(*ddtep & DDTE_VALID)) {
+			next = (u64 *)get_zeroed_page(GFP_KERNEL);
+			if (!next)
+				return NULL;
+			*ddtep = (virt_to_pfn(next) << DDTE_PPN_SHIFT) |
+				 DDTE_VALID;
+		}
+		table = phys_to_virt((*ddtep >> DDTE_PPN_SHIFT) << PAGE_SHIFT);
+	}
+
+	idx = devid & ((1U << leaf_bits) - 1);
+	return (void *)table + idx * iommu->dc_size;
+}
+
+/*
+ * Point one device context at the domain.  A valid context can't be
+ * rewritten in place, as the IOMMU might fetch it half-way through: take
+ * it out of service first, then bring it back with its new contents.
+ */
+static void riscv_iommu_write_dc(struct riscv_iommu_device *iommu, u32 devid,
+				 struct riscv_iommu_domain *dom)
+{
+	struct riscv_iommu_dc *dc;
+
+	mutex_lock(&iommu->ddt_mutex);
+	dc = riscv_iommu_get_dc(iommu, devid);
+	if (WARN_ON(!dc))
+		goto out_unlock;
+
+	if (dc->tc & DC_TC_V) {
+		WRITE_ONCE(dc->tc, 0);
+		riscv_iommu_inval_ddt(iommu, devid, false);
+	}
+
+	if (!dom)
+		goto out_unlock;
+
+	dc->iohgatp = 0;
+	if (dom->domain.type == IOMMU_DOMAIN_IDENTITY) {
+		dc->ta = 0;
+		dc->fsc = DC_FSC_MODE_BARE << DC_FSC_MODE_SHIFT;
+	} else {
+		dc->ta = (u64)dom->pscid << DC_TA_PSCID_SHIFT;
+		dc->fsc = (DC_FSC_MODE_SV39 << DC_FSC_MODE_SHIFT) |
+			  virt_to_pfn(dom->pgd);
+	}
+	wmb();
+	WRITE_ONCE(dc->tc, DC_TC_V);
+	riscv_iommu_inval_ddt(iommu, devid, false);
+
+out_unlock:
+	mutex_unlock(&iommu->ddt_mutex);
+}
+
+static int riscv_iommu_attach_dev(struct iommu_domain *domain,
+				  struct device *dev)
+{
+	struct riscv_iommu_domain *dom = to_riscv_domain(domain);
+	struct iommu_fwspec *fwspec = dev->iommu_fwspec;
+	struct riscv_iommu_master *master;
+	int i, ret;
+
+	if (!fwspec)
+		return -ENOENT;
+
+	master = fwspec->iommu_priv;
+	ret = riscv_iommu_domain_finalise(dom, master->iommu);
+	if (ret == -EINVAL)
+		dev_err(dev, "cannot attach to IOMMU %s (domain is on %s)\n",
+			dev_name(master->iommu->dev),
+			dev_name(dom->iommu->dev));
+	if (ret)
+		return ret;
+
+	for (i = 0; i < fwspec->num_ids; i++)
+		riscv_iommu_write_dc(master->iommu, fwspec->ids[i], dom);
+	master->domain = dom;
+
+	return 0;
+}
+
+static int riscv_iommu_map(struct iommu_domain *domain, unsigned long iova,
+			   phys_addr_t paddr, size_t size, int prot)
+{
+	struct riscv_iommu_domain *dom = to_riscv_domain(domain);
+	int level = riscv_iommu_size_to_level(size);
+	unsigned long flags;
+	u64 pte, *ptep;
+	int ret = 0;
+
+	if (domain->type == IOMMU_DOMAIN_IDENTITY)
+		return -EINVAL;
+
+	if (level < 0)
+		return level;
+
+	/* Write-only leaves are reserved, so writing implies reading */
+	if (!(prot & (IOMMU_READ | IOMMU_WRITE)))
+		return 0;
+
+	pte = ((paddr >> PAGE_SHIFT) << _PAGE_PFN_SHIFT) | _PAGE_PRESENT |
+	      _PAGE_READ | _PAGE_USER | _PAGE_ACCESSED;
+	if (prot & IOMMU_WRITE)
+		pte |= _PAGE_WRITE | _PAGE_DIRTY;
+
+	spin_lock_irqsave(&dom->pgtbl_lock, flags);
+	ptep = riscv_iommu_pte_alloc(dom, iova, level);
+	if (!ptep)
+		ret = -ENOMEM;
+	else if (*ptep & _PAGE_PRESENT)
+		ret = -EEXIST;
+	else
+		*ptep = pte;
+	spin_unlock_irqrestore(&dom->pgtbl_lock, flags);
+
+	return ret;
+}
+
+/*
+ * Only clear the leaf: invalidating the IOTLB is left to the
+ * iotlb_range_add()/iotlb_sync() pair that the core wraps unmaps in, so
+ * an unmap of many pages costs a single fence.
+ */
+static size_t riscv_iommu_unmap(struct iommu_domain *domain,
+				unsigned long iova, size_t size)
+{
+	struct riscv_iommu_domain *dom = to_riscv_domain(domain);
+	unsigned long flags;
+	size_t unmapped = 0;
+	u64 *ptep;
+	int level;
+
+	if (domain->type == IOMMU_DOMAIN_IDENTITY)
+		return 0;
+
+	spin_lock_irqsave(&dom->pgtbl_lock, flags);
+	ptep = riscv_iommu_pte_lookup(dom, iova, &level);
+	if (ptep) {
+		*ptep = 0;
+		unmapped = PT_LEVEL_SIZE(level);
+	}
+	spin_unlock_irqrestore(&dom->pgtbl_lock, flags);
+
+	return unmapped;
+}
+
+static void riscv_iommu_iotlb_range_add(struct iommu_domain *domain,
+					unsigned long iova, size_t size)
+{
+	struct riscv_iommu_domain *dom = to_riscv_domain(domain);
+	unsigned long flags;
+
+	spin_lock_irqsave(&dom->pgtbl_lock, flags);
+	dom->inval_start = min(dom->inval_start, iova);
+	dom->inval_end = max(dom->inval_end, iova + size);
+	spin_unlock_irqrestore(&dom->pgtbl_lock, flags);
+}
+
+static void riscv_iommu_iotlb_sync(struct iommu_domain *domain)
+{
+	struct riscv_iommu_domain *dom = to_riscv_domain(domain);
+	struct riscv_iommu_device *iommu = dom->iommu;
+	unsigned long flags, start, end, iova;
+	int ret = 0;
+
+	if (!iommu || !dom->pscid)
+		return;
+
+	spin_lock_irqsave(&iommu->cq_lock, flags);
+
+	spin_lock(&dom->pgtbl_lock);
+	start = dom->inval_start;
+	end = dom->inval_end;
+	dom->inval_start = ULONG_MAX;
+	dom->inval_end = 0;
+	spin_unlock(&dom->pgtbl_lock);
+
+	if (start >= end)
+		goto out_unlock;
+
+	if ((end - start) >> PAGE_SHIFT > RISCV_IOMMU_INVAL_MAX_PAGES) {
+		ret = riscv_iommu_inval_vma(iommu, dom->pscid, 0, true);
+	} else {
+		for (iova = start; iova < end && !ret; iova += PAGE_SIZE)
+			ret = riscv_iommu_inval_vma(iommu, dom->pscid, iova,
+						    false);
+	}
+
+	if (!ret)
+		riscv_iommu_cmd_sync(iommu);
+out_unlock:
+	spin_unlock_irqrestore(&iommu->cq_lock, flags);
+}
+
+static void riscv_iommu_flush_iotlb_all(struct iommu_domain *domain)
+{
+	struct riscv_iommu_domain *dom = to_riscv_domain(domain);
+
+	riscv_iommu_iotlb_range_add(domain, 0,
+				    BIT_ULL(RISCV_IOMMU_IOVA_BITS));
+	if (dom->iommu)
+		riscv_iommu_iotlb_sync(domain);
+}
+
+static phys_addr_t riscv_iommu_iova_to_phys(struct iommu_domain *domain,
+					    dma_addr_t iova)
+{
+	struct riscv_iommu_domain *dom = to_riscv_domain(domain);
+	phys_addr_t phys = 0;
+	unsigned long flags;
+	u64 *ptep;
+	int level;
+
+	if (domain->type == IOMMU_DOMAIN_IDENTITY)
+		return iova;
+
+	spin_lock_irqsave(&dom->pgtbl_lock, flags);
+	ptep = riscv_iommu_pte_lookup(dom, iova, &level);
+	if (ptep)
+		phys = (__page_val_to_pfn(*ptep) << PAGE_SHIFT) |
+		       (iova & (PT_LEVEL_SIZE(level) - 1));
+	spin_unlock_irqrestore(&dom->pgtbl_lock, flags);
+
+	return phys;
+}
+
+static int riscv_iommu_match_node(struct device *dev, void *data)
+{
+	return dev->fwnode == data;
+}
+
+static struct riscv_iommu_device *
+riscv_iommu_get_by_fwnode(struct fwnode_handle *fwnode)
+{
+	struct device *dev = driver_find_device(&riscv_iommu_driver.driver,
+						NULL, fwnode,
+						riscv_iommu_match_node);
+	put_device(dev);
+	return dev ? dev_get_drvdata(dev) : NULL;
+}
+
+static int riscv_iommu_add_device(struct device *dev)
+{
+	struct iommu_fwspec *fwspec = dev->iommu_fwspec;
+	struct riscv_iommu_device *iommu;
+	struct riscv_iommu_master *master;
+	struct iommu_group *group;
+	int i;
+
+	if (!fwspec || fwspec->ops != &riscv_iommu_ops)
+		return -ENODEV;
+
+	if (WARN_ON_ONCE(fwspec->iommu_priv)) {
+		master = fwspec->iommu_priv;
+		iommu = master->iommu;
+	} else {
+		iommu = riscv_iommu_get_by_fwnode(fwspec->iommu_fwnode);
+		if (!iommu)
+			return -ENODEV;
+		master = kzalloc(sizeof(*master), GFP_KERNEL);
+		if (!master)
+			return -ENOMEM;
+
+		master->iommu = iommu;
+		fwspec->iommu_priv = master;
+	}
+
+	for (i = 0; i < fwspec->num_ids; i++)
+		if (fwspec->ids[i] >= 1U << iommu->devid_bits)
+			return -ERANGE;
+
+	group = iommu_group_get_for_dev(dev);
+	if (!IS_ERR(group)) {
+		iommu_group_put(group);
+		iommu_device_link(&iommu->iommu, dev);
+	}
+
+	return PTR_ERR_OR_ZERO(group);
+}
+
+static void riscv_iommu_remove_device(struct device *dev)
+{
+	struct iommu_fwspec *fwspec = dev->iommu_fwspec;
+	struct riscv_iommu_master *master;
+	int i;
+
+	if (!fwspec || fwspec->ops != &riscv_iommu_ops)
+		return;
+
+	master = fwspec->iommu_priv;
+	if (master && master->domain)
+		for (i = 0; i < fwspec->num_ids; i++)
+			riscv_iommu_write_dc(master->iommu, fwspec->ids[i],
+					     NULL);
+	iommu_group_remove_device(dev);
+	if (master)
+		iommu_device_unlink(&master->iommu->iommu, dev);
+	kfree(master);
+	iommu_fwspec_free(dev);
+}
+
+/*
+ * Each device gets a group, hence a default domain, of its own, except
+ * for PCI functions the IOMMU can't tell apart.
+ */
+static struct iommu_group *riscv_iommu_device_group(struct device *dev)
+{
+	if (dev_is_pci(dev))
+		return pci_device_group(dev);
+	return generic_device_group(dev);
+}
+
+static int riscv_iommu_of_xlate(struct device *dev,
+				struct of_phandle_args *args)
+{
+	return iommu_fwspec_add_ids(dev, args->args, 1);
+}
+
+static struct iommu_ops riscv_iommu_ops = {
+	.capable		= riscv_iommu_capable,
+	.domain_alloc		= riscv_iommu_domain_alloc,
+	.domain_free		= riscv_iommu_domain_free,
+	.attach_dev		= riscv_iommu_attach_dev,
+	.map			= riscv_iommu_map,
+	.unmap			= riscv_iommu_unmap,
+	.map_sg			= default_iommu_map_sg,
+	.flush_iotlb_all	= riscv_iommu_flush_iotlb_all,
+	.iotlb_range_add	= riscv_iommu_iotlb_range_add,
+	.iotlb_sync		= riscv_iommu_iotlb_sync,
+	.iova_to_phys		= riscv_iommu_iova_to_phys,
+	.add_device		= riscv_iommu_add_device,
+	.remove_device		= riscv_iommu_remove_device,
+	.device_group		= riscv_iommu_device_group,
+	.of_xlate		= riscv_iommu_of_xlate,
+	.pgsize_bitmap		= SZ_4K | SZ_2M | SZ_1G,
+};
+
+/* Probing and initialisation functions */
+static int riscv_iommu_init_queue(struct riscv_iommu_device *iommu,
+				  struct riscv_iommu_queue *q,
+				  unsigned int base_off, unsigned int csr_off,
+				  unsigned int dwords, u32 csr, u32 err)
+{
+	unsigned int entries = RISCV_IOMMU_QUEUE_SIZE / (dwords * 8);
+	u32 val;
+	int ret;
+
+	q->base = dmam_alloc_coherent(iommu->dev, RISCV_IOMMU_QUEUE_SIZE,
+				      &q->base_dma, GFP_KERNEL | __GFP_ZERO);
+	if (!q->base)
+		return -ENOMEM;
+
+	q->mask = entries - 1;
+	q->tail = 0;
+
+	writeq(((u64)(ilog2(entries) - 1) & QB_LOG2SZ_MASK) |
+	       ((q->base_dma >> PAGE_SHIFT) << QB_PPN_SHIFT),
+	       iommu->reg + base_off);
+	/* Clearing any stale error bits (write-1-to-clear) on the way */
+	writel(csr | QCSR_EN | err, iommu->reg + csr_off);
+
+	ret = readl_poll_timeout(iommu->reg + csr_off, val,
+				 (val & (QCSR_ON | QCSR_BUSY)) == QCSR_ON,
+				 10, RISCV_IOMMU_POLL_TIMEOUT_US);
+	if (ret)
+		dev_err(iommu->dev, "queue at 0x%x failed to come up\n",
+			base_off);
+	return ret;
+}
+
+static int riscv_iommu_set_ddtp(struct riscv_iommu_device *iommu, u64 ddtp)
+{
+	u64 val;
+	int ret;
+
+	writeq(ddtp, iommu->reg + RISCV_IOMMU_DDTP);
+	ret = readq_poll_timeout(iommu->reg + RISCV_IOMMU_DDTP, val,
+				 !(val & DDTP_BUSY), 10,
+				 RISCV_IOMMU_POLL_TIMEOUT_US);
+	if (ret)
+		return ret;
+
+	/* An unsupported mode is simply not taken */
+	return (val & DDTP_MODE_MASK) == (ddtp & DDTP_MODE_MASK) ? 0 : -ENODEV;
+}
+
+/*
+ * Use the deepest directory the IOMMU supports, since that is the one
+ * with room for the most device IDs.
+ */
+static int riscv_iommu_init_ddt(struct riscv_iommu_device *iommu)
+{
+	unsigned int leaf_bits;
+	int mode;
+
+	iommu->ddt_root = (u64 *)devm_get_free_pages(iommu->dev,
+						     GFP_KERNEL | __GFP_ZERO,
+						     0);
+	if (!iommu->ddt_root)
+		return -ENOMEM;
+
+	leaf_bits = iommu->dc_size == DC_EXT_SIZE ? DDT_LEAF_BITS_EXT :
+						    DDT_LEAF_BITS_BASE;
+
+	for (mode = DDTP_MODE_3LVL; mode >= DDTP_MODE_1LVL; mode--) {
+		if (riscv_iommu_set_ddtp(iommu, mode |
+				(virt_to_pfn(iommu->ddt_root) << DDTP_PPN_SHIFT)))
+			continue;
+
+		iommu->ddt_mode = mode;
+		iommu->devid_bits = min(DEVID_MAX_BITS, leaf_bits +
+					DDT_NONLEAF_BITS *
+					(mode - DDTP_MODE_1LVL));
+		return 0;
+	}
+
+	dev_err(iommu->dev, "no usable device directory mode\n");
+	return -ENODEV;
+}
+
+static int riscv_iommu_device_reset(struct riscv_iommu_device *iommu,
+				    int nr_irqs)
+{
+	u32 fctl = readl(iommu->reg + RISCV_IOMMU_FCTL);
+	unsigned int fiv = nr_irqs > 1 ? 1 : 0;
+	unsigned int igs;
+	int ret;
+
+	/* Start from a clean slate, whatever the firmware left behind */
+	riscv_iommu_set_ddtp(iommu, DDTP_MODE_OFF);
+	writel(0, iommu->reg + RISCV_IOMMU_CQCSR);
+	writel(0, iommu->reg + RISCV_IOMMU_FQCSR);
+
+	igs = (iommu->caps >> CAPS_IGS_SHIFT) & CAPS_IGS_MASK;
+	if (igs == CAPS_IGS_WSI || igs == CAPS_IGS_BOTH)
+		fctl |= FCTL_WSI;
+	fctl &= ~FCTL_BE;
+	writel(fctl, iommu->reg + RISCV_IOMMU_FCTL);
+
+	writel(fiv << ICVEC_FIV_SHIFT, iommu->reg + RISCV_IOMMU_ICVEC);
+
+	ret = riscv_iommu_init_queue(iommu, &iommu->cq, RISCV_IOMMU_CQB,
+				     RISCV_IOMMU_CQCSR, CQ_ENT_DWORDS, 0,
+				     CQCSR_ERR_MASK);
+	if (ret)
+		return ret;
+
+	ret = riscv_iommu_init_queue(iommu, &iommu->fq, RISCV_IOMMU_FQB,
+				     RISCV_IOMMU_FQCSR, FQ_ENT_DWORDS,
+				     nr_irqs > 0 ? QCSR_IE : 0,
+				     FQCSR_ERR_MASK);
+	if (ret)
+		return ret;
+
+	ret = riscv_iommu_init_ddt(iommu);
+	if (ret)
+		return ret;
+
+	/* Nothing may survive from before us in the directory cache */
+	return riscv_iommu_inval_ddt(iommu, 0, true);
+}
+
+static int riscv_iommu_device_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct riscv_iommu_device *iommu;
+	struct resource *res;
+	int irq, nr_irqs, ret;
+
+	iommu = devm_kzalloc(dev, sizeof(*iommu), GFP_KERNEL);
+	if (!iommu)
+		return -ENOMEM;
+	iommu->dev = dev;
+	mutex_init(&iommu->ddt_mutex);
+	spin_lock_init(&iommu->cq_lock);
+	ida_init(&iommu->pscids);
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	iommu->reg = devm_ioremap_resource(dev, res);
+	if (IS_ERR(iommu->reg))
+		return PTR_ERR(iommu->reg);
+
+	iommu->caps = readq(iommu->reg + RISCV_IOMMU_CAPS);
+	if (!(iommu->caps & CAPS_SV39)) {
+		dev_err(dev, "no Sv39 support, caps 0x%016llx\n", iommu->caps);
+		return -ENODEV;
+	}
+	iommu->dc_size = iommu->caps & CAPS_MSI_FLAT ? DC_EXT_SIZE :
+						       DC_BASE_SIZE;
+
+	ret = dma_set_mask_and_coherent(dev, DMA_BIT_MASK(56));
+	if (ret)
+		return ret;
+
+	/*
+	 * The interrupts are listed in the order of their vectors.  An
+	 * IOMMU that only signals through MSIs would need an MSI
+	 * controller, which we don't have: its faults just wait in the
+	 * queue.
+	 */
+	nr_irqs = platform_irq_count(pdev);
+	if (nr_irqs < 0)
+		return nr_irqs;
+	if (((iommu->caps >> CAPS_IGS_SHIFT) & CAPS_IGS_MASK) == CAPS_IGS_MSI)
+		nr_irqs = 0;
+
+	ret = riscv_iommu_device_reset(iommu, nr_irqs);
+	if (ret)
+		return ret;
+
+	if (nr_irqs) {
+		irq = platform_get_irq(pdev, nr_irqs > 1 ? 1 : 0);
+		if (irq > 0) {
+			ret = devm_request_threaded_irq(dev, irq, NULL,
+							riscv_iommu_fq_thread,
+							IRQF_ONESHOT,
+							"riscv-iommu-fq", iommu);
+			if (ret)
+				dev_warn(dev, "failed to enable fault irq\n");
+		}
+	}
+
+	platform_set_drvdata(pdev, iommu);
+
+	ret = iommu_device_sysfs_add(&iommu->iommu, dev, NULL,
+				     "riscv-iommu.%pa", &res->start);
+	if (ret)
+		return ret;
+
+	iommu_device_set_ops(&iommu->iommu, &riscv_iommu_ops);
+	iommu_device_set_fwnode(&iommu->iommu, dev->fwnode);
+
+	ret = iommu_device_register(&iommu->iommu);
+	if (ret) {
+		dev_err(dev, "Failed to register iommu\n");
+		return ret;
+	}
+
+	dev_info(dev, "%u-level device directory, %u-bit device IDs\n",
+		 iommu->ddt_mode - DDTP_MODE_1LVL + 1, iommu->devid_bits);
+
+#ifdef CONFIG_PCI
+	if (pci_bus_type.iommu_ops != &riscv_iommu_ops) {
+		pci_request_acs();
+		ret = bus_set_iommu(&pci_bus_type, &riscv_iommu_ops);
+		if (ret)
+			return ret;
+	}
+#endif
+	if (platform_bus_type.iommu_ops != &riscv_iommu_ops) {
+		ret = bus_set_iommu(&platform_bus_type, &riscv_iommu_ops);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+/* Let DMA carry on untranslated into whatever comes next, e.g. kexec */
+static void riscv_iommu_device_shutdown(struct platform_device *pdev)
+{
+	struct riscv_iommu_device *iommu = platform_get_drvdata(pdev);
+
+	riscv_iommu_set_ddtp(iommu, DDTP_MODE_BARE);
+	writel(0, iommu->reg + RISCV_IOMMU_CQCSR);
+	writel(0, iommu->reg + RISCV_IOMMU_FQCSR);
+}
+
+static const struct of_device_id riscv_iommu_of_match[] = {
+	{ .compatible = "riscv,iommu", },
+	{ },
+};
+MODULE_DEVICE_TABLE(of, riscv_iommu_of_match);
+
+static struct platform_driver riscv_iommu_driver = {
+	.driver	= {
+		.name			= "riscv-iommu",
+		.of_match_table		= of_match_ptr(riscv_iommu_of_match),
+		.suppress_bind_attrs	= true,
+	},
+	.probe		= riscv_iommu_device_probe,
+	.shutdown	= riscv_iommu_device_shutdown,
+};
+module_platform_driver(riscv_iommu_driver);
+
+IOMMU_OF_DECLARE(riscv_iommu, "riscv,iommu", NULL);
+
+MODULE_DESCRIPTION("IOMMU API for RISC-V IOMMU implementations");
+MODULE_LICENSE("GPL v2");
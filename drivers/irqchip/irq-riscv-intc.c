@@ -29,7 +29,7 @@
 struct riscv_irq_data {
 	struct irq_chip		chip;
 	struct irq_domain	*domain;
-	int			hart;
+	int			cpu;
 	char			name[20];
 };
 DEFINE_PER_CPU(struct riscv_irq_data, riscv_irq_data);
@@ -52,9 +52,10 @@ static void riscv_software_interrupt(void)
 #endif
 }
 
-void riscv_intc_irq(unsigned int cause, struct pt_regs *regs)
+static void riscv_intc_irq(struct pt_regs *regs)
 {
 	struct pt_regs *old_regs = set_irq_regs(regs);
+	unsigned long cause = regs->scause & ~(1UL << (BITS_PER_LONG - 1));
 	struct irq_domain *domain;
 
 	irq_enter();
@@ -72,8 +73,13 @@ void riscv_intc_irq(unsigned int cause, struct pt_regs *regs)
 		riscv_software_interrupt();
 		break;
 	default:
-		domain = per_cpu(riscv_irq_data, smp_processor_id()).domain;
-		generic_handle_irq(irq_find_mapping(domain, cause));
+		/*
+		 * The local domain is linear and sized to cover every cause,
+		 * so the reverse map can be read without the radix fallback
+		 * irq_find_mapping() would go through.
+		 */
+		domain = this_cpu_read(riscv_irq_data.domain);
+		generic_handle_irq(irq_linear_revmap(domain, cause));
 		break;
 	}
 
@@ -89,7 +95,7 @@ static int riscv_irqdomain_map(struct irq_domain *d, unsigned int irq,
 	irq_set_chip_and_handler(irq, &data->chip, handle_simple_irq);
 	irq_set_chip_data(irq, data);
 	irq_set_noprobe(irq);
-	irq_set_affinity(irq, cpumask_of(data->hart));
+	irq_set_affinity(irq, cpumask_of(data->cpu));
 
 	return 0;
 }
@@ -111,7 +117,7 @@ static void riscv_irq_mask(struct irq_data *d)
 {
 	struct riscv_irq_data *data = irq_data_get_irq_chip_data(d);
 
-	BUG_ON(smp_processor_id() != data->hart);
+	BUG_ON(smp_processor_id() != data->cpu);
 	csr_clear(sie, 1 << (long)d->hwirq);
 }
 
@@ -119,7 +125,7 @@ static void riscv_irq_unmask(struct irq_data *d)
 {
 	struct riscv_irq_data *data = irq_data_get_irq_chip_data(d);
 
-	BUG_ON(smp_processor_id() != data->hart);
+	BUG_ON(smp_processor_id() != data->cpu);
 	csr_set(sie, 1 << (long)d->hwirq);
 }
 
@@ -149,10 +155,10 @@ static void riscv_irq_enable(struct irq_data *d)
 	 * over to the target hart if it's not the current one.  It's invalid
 	 * to write SIE on a hart that's not currently running.
 	 */
-	if (data->hart == smp_processor_id())
+	if (data->cpu == smp_processor_id())
 		riscv_irq_unmask(d);
-	else if (cpu_online(data->hart))
-		riscv_remote_ctrl(data->hart, riscv_irq_enable_helper, d);
+	else if (cpu_online(data->cpu))
+		riscv_remote_ctrl(data->cpu, riscv_irq_enable_helper, d);
 	else
 		WARN_ON_ONCE(1);
 }
@@ -166,17 +172,17 @@ static void riscv_irq_disable(struct irq_data *d)
 	 * over to the target hart if it's not the current one.  It's invalid
 	 * to write SIE on a hart that's not currently running.
 	 */
-	if (data->hart == smp_processor_id())
+	if (data->cpu == smp_processor_id())
 		riscv_irq_mask(d);
-	else if (cpu_online(data->hart))
-		riscv_remote_ctrl(data->hart, riscv_irq_disable_helper, d);
+	else if (cpu_online(data->cpu))
+		riscv_remote_ctrl(data->cpu, riscv_irq_disable_helper, d);
 	else
 		WARN_ON_ONCE(1);
 }
 
 static int riscv_intc_init(struct device_node *node, struct device_node *parent)
 {
-	int hart;
+	int hart, cpu;
 	struct riscv_irq_data *data;
 
 	if (parent)
@@ -186,9 +192,13 @@ static int riscv_intc_init(struct device_node *node, struct device_node *parent)
 	if (hart < 0)
 		return -EIO;
 
-	data = &per_cpu(riscv_irq_data, hart);
-	snprintf(data->name, sizeof(data->name), "riscv,cpu_intc,%d", hart);
-	data->hart = hart;
+	cpu = riscv_hartid_to_cpuid(hart);
+	if (cpu < 0)
+		return -EIO;
+
+	data = &per_cpu(riscv_irq_data, cpu);
+	snprintf(data->name, sizeof(data->name), "riscv,cpu_intc,%d", cpu);
+	data->cpu = cpu;
 	data->chip.name = data->name;
 	data->chip.irq_mask = riscv_irq_mask;
 	data->chip.irq_unmask = riscv_irq_unmask;
@@ -198,6 +208,7 @@ static int riscv_intc_init(struct device_node *node, struct device_node *parent)
 					     &riscv_irqdomain_ops, data);
 	if (!data->domain)
 		goto error_add_linear;
+	set_handle_irq(riscv_intc_irq);
 	pr_info("%s: %d local interrupts mapped\n", data->name, PTR_BITS);
 	return 0;
 
@@ -103,6 +103,16 @@
 #define CONTEXT_THRESHOLD	0
 #define CONTEXT_CLAIM		4
 
+/*
+ * A source with priority 0 never interrupts, and a context only takes
+ * sources whose priority is strictly greater than its threshold.  The spec
+ * leaves the number of priority levels to the implementation, so it comes
+ * from the device tree and defaults to the 7 levels of the SiFive PLIC.
+ */
+#define PRIORITY_DISABLED	0
+#define PRIORITY_DEFAULT	1
+#define PRIORITY_MAX_DEFAULT	7
+
 /*
  * PLIC devices are named like 'riscv,plic0,%llx', this is enough space to
  * store that name.
@@ -112,6 +122,7 @@
 struct plic_handler {
 	bool			present;
 	int			contextid;
+	int			cpu;	/* -1 if not attached to a CPU */
 	struct plic_data	*data;
 };
 
@@ -119,6 +130,8 @@ struct plic_data {
 	struct irq_chip		chip;
 	struct irq_domain	*domain;
 	u32			ndev;
+	u32			max_priority;
+	u32			*priority;	/* per-source, 0 = unset */
 	void __iomem		*reg;
 	int			handlers;
 	struct plic_handler	*handler;
@@ -172,7 +185,8 @@ void plic_complete(struct plic_data *data, int contextid, u32 claim)
 /* Explicit interrupt masking. */
 static void plic_disable(struct plic_data *data, int contextid, int hwirq)
 {
-	void __iomem *reg = plic_enable_vector(data, contextid) + (hwirq / 32);
+	void __iomem *reg = plic_enable_vector(data, contextid) +
+			    (hwirq / 32) * sizeof(u32);
 	u32 mask = ~(1 << (hwirq % 32));
 
 	spin_lock(&data->lock);
@@ -182,7 +196,8 @@ static void plic_disable(struct plic_data *data, int contextid, int hwirq)
 
 static void plic_enable(struct plic_data *data, int contextid, int hwirq)
 {
-	void __iomem *reg = plic_enable_vector(data, contextid) + (hwirq / 32);
+	void __iomem *reg = plic_enable_vector(data, contextid) +
+			    (hwirq / 32) * sizeof(u32);
 	u32 bit = 1 << (hwirq % 32);
 
 	spin_lock(&data->lock);
@@ -191,22 +206,85 @@ static void plic_enable(struct plic_data *data, int contextid, int hwirq)
 }
 
 /*
- * There is no need to mask/unmask PLIC interrupts
- * They are "masked" by reading claim and "unmasked" when writing it back.
+ * The context that is currently claiming on this CPU, so that irq_eoi can
+ * complete the interrupt on the context it was claimed from.  Claims are
+ * made from the chained handler with interrupts disabled, so this can't
+ * change underneath a flow handler.
+ */
+static DEFINE_PER_CPU(struct plic_handler *, plic_claiming);
+
+static u32 plic_source_priority(struct plic_data *data, int hwirq)
+{
+	return data->priority[hwirq] ? : PRIORITY_DEFAULT;
+}
+
+/*
+ * Masking a single source is done through its priority: priority 0 can't
+ * exceed any threshold, so the source stays pending without interrupting
+ * anybody.  This leaves the per-context enable bits, and with them the
+ * affinity, untouched.
  */
-static void plic_irq_mask(struct irq_data *d) { }
-static void plic_irq_unmask(struct irq_data *d) { }
+static void plic_irq_mask(struct irq_data *d)
+{
+	struct plic_data *data = irq_data_get_irq_chip_data(d);
+
+	writel(PRIORITY_DISABLED, plic_priority(data, d->hwirq));
+}
+
+static void plic_irq_unmask(struct irq_data *d)
+{
+	struct plic_data *data = irq_data_get_irq_chip_data(d);
+
+	writel(plic_source_priority(data, d->hwirq),
+	       plic_priority(data, d->hwirq));
+}
+
+/*
+ * Route hwirq to the context of a single hart, turning it off everywhere
+ * else.  Sending a source to more than one hart only makes them race for the
+ * claim, so the effective affinity is always one CPU.  Contexts that aren't
+ * attached to a hart are left enabled, as we can't tell where they go.
+ */
+static void plic_irq_route(struct plic_data *data, int hwirq, int cpu)
+{
+	int i;
+
+	for (i = 0; i < data->handlers; ++i) {
+		struct plic_handler *handler = &data->handler[i];
+
+		if (!handler->present)
+			continue;
+		if (handler->cpu < 0 || handler->cpu == cpu)
+			plic_enable(data, i, hwirq);
+		else
+			plic_disable(data, i, hwirq);
+	}
+}
+
+static unsigned int plic_irq_target(struct irq_data *d)
+{
+	unsigned int cpu;
+
+	cpu = cpumask_any_and(irq_data_get_effective_affinity_mask(d),
+			      cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_any_and(irq_data_get_affinity_mask(d),
+				      cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first(cpu_online_mask);
+
+	return cpu;
+}
 
 static void plic_irq_enable(struct irq_data *d)
 {
 	struct plic_data *data = irq_data_get_irq_chip_data(d);
 	void __iomem *priority = plic_priority(data, d->hwirq);
-	int i;
+	unsigned int cpu = plic_irq_target(d);
 
-	writel(1, priority);
-	for (i = 0; i < data->handlers; ++i)
-		if (data->handler[i].present)
-			plic_enable(data, i, d->hwirq);
+	writel(plic_source_priority(data, d->hwirq), priority);
+	irq_data_update_effective_affinity(d, cpumask_of(cpu));
+	plic_irq_route(data, d->hwirq, cpu);
 }
 
 static void plic_irq_disable(struct irq_data *d)
@@ -215,21 +293,43 @@ static void plic_irq_disable(struct irq_data *d)
 	void __iomem *priority = plic_priority(data, d->hwirq);
 	int i;
 
-	writel(0, priority);
+	writel(PRIORITY_DISABLED, priority);
 	for (i = 0; i < data->handlers; ++i)
 		if (data->handler[i].present)
 			plic_disable(data, i, d->hwirq);
 }
 
+#ifdef CONFIG_SMP
+static int plic_irq_set_affinity(struct irq_data *d,
+				 const struct cpumask *mask_val, bool force)
+{
+	struct plic_data *data = irq_data_get_irq_chip_data(d);
+	unsigned int cpu;
+
+	if (force)
+		cpu = cpumask_first(mask_val);
+	else
+		cpu = cpumask_any_and(mask_val, cpu_online_mask);
+
+	if (cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	irq_data_update_effective_affinity(d, cpumask_of(cpu));
+
+	/* A disabled source picks up its new route when it is enabled */
+	if (!irqd_irq_disabled(d))
+		plic_irq_route(data, d->hwirq, cpu);
+
+	return IRQ_SET_MASK_OK_DONE;
+}
+#endif
+
 static void plic_irq_eoi(struct irq_data *d)
 {
-	/* FIXME: I can't figure out what's going on here: when I set the PLIC
-	 * driver to use hadle_fasteoi_irq I end up with !handler here.  The
-	 * difference is that here we get an irq_data and use
-	 * common.handler_data, while in the working version we get an
-	 * irq_desc and use irq_common_data.handler_data. */
-	struct plic_handler *handler = d->common->handler_data;
-	BUG_ON(!handler);
+	struct plic_handler *handler = __this_cpu_read(plic_claiming);
+
+	if (WARN_ON_ONCE(!handler))
+		return;
 	plic_complete(handler->data, handler->contextid, d->hwirq);
 }
 
@@ -238,17 +338,46 @@ static int plic_irqdomain_map(struct irq_domain *d, unsigned int irq,
 {
 	struct plic_data *data = d->host_data;
 
-	/* FIXME: ... I want to set handle_fasteoi_irq here. */
-	irq_set_chip_and_handler(irq, &data->chip, handle_simple_irq);
+	irq_set_chip_and_handler(irq, &data->chip, handle_fasteoi_irq);
 	irq_set_chip_data(irq, data);
 	irq_set_noprobe(irq);
 
 	return 0;
 }
 
+/*
+ * Interrupt specifiers are either <hwirq> or <hwirq priority>.  The
+ * priority is clamped to what the PLIC implements; sources that don't ask
+ * for one get PRIORITY_DEFAULT.
+ */
+static int plic_irqdomain_xlate(struct irq_domain *d,
+				struct device_node *ctrlr,
+				const u32 *intspec, unsigned int intsize,
+				unsigned long *out_hwirq,
+				unsigned int *out_type)
+{
+	struct plic_data *data = d->host_data;
+	u32 hwirq;
+
+	if (WARN_ON(intsize < 1))
+		return -EINVAL;
+
+	hwirq = intspec[0];
+	if (hwirq == 0 || hwirq > data->ndev)
+		return -EINVAL;
+
+	if (intsize > 1)
+		data->priority[hwirq] = clamp_t(u32, intspec[1], 1,
+						data->max_priority);
+
+	*out_hwirq = hwirq;
+	*out_type = IRQ_TYPE_NONE;
+	return 0;
+}
+
 static const struct irq_domain_ops plic_irqdomain_ops = {
 	.map	= plic_irqdomain_map,
-	.xlate	= irq_domain_xlate_onecell,
+	.xlate	= plic_irqdomain_xlate,
 };
 
 static void plic_chained_handle_irq(struct irq_desc *desc)
@@ -259,17 +388,21 @@ static void plic_chained_handle_irq(struct irq_desc *desc)
 	u32 what;
 
 	chained_irq_enter(chip, desc);
+	__this_cpu_write(plic_claiming, handler);
 
+	/* The fasteoi flow completes each claim through plic_irq_eoi() */
 	while ((what = plic_claim(handler->data, handler->contextid))) {
 		int irq = irq_find_mapping(domain, what);
 
-		if (irq > 0)
+		if (irq > 0) {
 			generic_handle_irq(irq);
-		else
+		} else {
 			handle_bad_irq(desc);
-		plic_complete(handler->data, handler->contextid, what);
+			plic_complete(handler->data, handler->contextid, what);
+		}
 	}
 
+	__this_cpu_write(plic_claiming, NULL);
 	chained_irq_exit(chip, desc);
 }
 
@@ -298,17 +431,31 @@ static int plic_init(struct device_node *node, struct device_node *parent)
 		goto free_reg;
 	}
 
+	data->max_priority = PRIORITY_MAX_DEFAULT;
+	of_property_read_u32(node, "riscv,max-priority", &data->max_priority);
+	if (WARN_ON(!data->max_priority)) {
+		out = -EINVAL;
+		goto free_reg;
+	}
+
+	data->priority = kcalloc(data->ndev + 1, sizeof(*data->priority),
+				 GFP_KERNEL);
+	if (WARN_ON(!data->priority)) {
+		out = -ENOMEM;
+		goto free_reg;
+	}
+
 	data->handlers = of_irq_count(node);
 	if (WARN_ON(!data->handlers)) {
 		out = -EINVAL;
-		goto free_reg;
+		goto free_priority;
 	}
 
 	data->handler =
 		kcalloc(data->handlers, sizeof(*data->handler), GFP_KERNEL);
 	if (WARN_ON(!data->handler)) {
 		out = -ENOMEM;
-		goto free_reg;
+		goto free_priority;
 	}
 
 	data->domain = irq_domain_add_linear(node, data->ndev+1, &plic_irqdomain_ops, data);
@@ -326,6 +473,9 @@ static int plic_init(struct device_node *node, struct device_node *parent)
 	data->chip.irq_enable = plic_irq_enable;
 	data->chip.irq_disable = plic_irq_disable;
 	data->chip.irq_eoi = plic_irq_eoi;
+#ifdef CONFIG_SMP
+	data->chip.irq_set_affinity = plic_irq_set_affinity;
+#endif
 
 	for (i = 0; i < data->handlers; ++i) {
 		struct plic_handler *handler = &data->handler[i];
@@ -333,6 +483,7 @@ static int plic_init(struct device_node *node, struct device_node *parent)
 		int parent_irq, hwirq;
 
 		handler->present = false;
+		handler->cpu = -1;
 
 		if (of_irq_parse_one(node, i, &parent))
 			continue;
@@ -342,9 +493,18 @@ static int plic_init(struct device_node *node, struct device_node *parent)
 
 		/* skip any contexts that lead to inactive harts */
 		if (of_device_is_compatible(parent.np, "riscv,cpu-intc") &&
-		    parent.np->parent &&
-		    riscv_of_processor_hart(parent.np->parent) < 0)
-			continue;
+		    parent.np->parent) {
+			int hart = riscv_of_processor_hart(parent.np->parent);
+			int cpu = hart < 0 ? hart : riscv_hartid_to_cpuid(hart);
+
+			if (cpu < 0) {
+				/* Nobody claims here: mask by threshold */
+				writel(data->max_priority,
+				       plic_hart_threshold(data, i));
+				continue;
+			}
+			handler->cpu = cpu;
+		}
 
 		parent_irq = irq_create_of_mapping(&parent);
 		if (!parent_irq)
@@ -369,6 +529,8 @@ static int plic_init(struct device_node *node, struct device_node *parent)
 
 free_handler:
 	kfree(data->handler);
+free_priority:
+	kfree(data->priority);
 free_reg:
 	iounmap(data->reg);
 free_data:
@@ -25,6 +25,9 @@
 #include <linux/scatterlist.h>
 #include <linux/rbtree.h>
 #include <linux/ctype.h>
+#include <linux/interrupt.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
 #include <asm/page.h>
 #include <asm/unaligned.h>
 #include <crypto/hash.h>
@@ -67,6 +70,7 @@ struct dm_crypt_io {
 	u8 *integrity_metadata;
 	bool integrity_metadata_from_pool;
 	struct work_struct work;
+	struct tasklet_struct tasklet;
 
 	struct convert_context ctx;
 
@@ -74,6 +78,9 @@ struct dm_crypt_io {
 	blk_status_t error;
 	sector_t sector;
 
+	/* Start time of the stage this io is currently in (ns) */
+	u64 stage_start;
+
 	struct rb_node rb_node;
 } CRYPTO_MINALIGN_ATTR;
 
@@ -125,11 +132,35 @@ struct iv_tcw_private {
  * and encrypts / decrypts at the same time.
  */
 enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
-	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD };
+	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD,
+	     DM_CRYPT_NO_READ_WORKQUEUE, DM_CRYPT_NO_WRITE_WORKQUEUE };
 
 enum cipher_flags {
 	CRYPT_MODE_INTEGRITY_AEAD,	/* Use authenticated mode for cihper */
 	CRYPT_IV_LARGE_SECTORS,		/* Calculate IV from sector_size, not 512B sectors */
+	CRYPT_CIPHER_SYNC,		/* Cipher never completes asynchronously */
+};
+
+/*
+ * Stages an io goes through, timed for the STATUSTYPE_INFO output:
+ * a read is submitted to the underlying device and then decrypted,
+ * a write is encrypted and then submitted.
+ */
+enum crypt_stage {
+	CRYPT_STAGE_READ_IO,
+	CRYPT_STAGE_READ_CRYPT,
+	CRYPT_STAGE_WRITE_CRYPT,
+	CRYPT_STAGE_WRITE_IO,
+	CRYPT_NR_STAGES,
+};
+
+static const char * const crypt_stage_names[CRYPT_NR_STAGES] = {
+	"read_io", "read_crypt", "write_crypt", "write_io",
+};
+
+struct crypt_stage_stats {
+	u64 nr[CRYPT_NR_STAGES];
+	u64 ns[CRYPT_NR_STAGES];
 };
 
 /*
@@ -201,6 +232,8 @@ struct crypt_config {
 
 	unsigned int per_bio_data_size;
 
+	struct crypt_stage_stats __percpu *stage_stats;
+
 	unsigned long flags;
 	unsigned int key_size;
 	unsigned int key_parts;      /* independent parts in key buffer */
@@ -1232,7 +1265,7 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 			       int error);
 
 static void crypt_alloc_req_skcipher(struct crypt_config *cc,
-				     struct convert_context *ctx)
+				     struct convert_context *ctx, u32 flags)
 {
 	unsigned key_index = ctx->cc_sector & (cc->tfms_count - 1);
 
@@ -1245,13 +1278,12 @@ static void crypt_alloc_req_skcipher(struct crypt_config *cc,
 	 * Use REQ_MAY_BACKLOG so a cipher driver internally backlogs
 	 * requests if driver request queue is full.
 	 */
-	skcipher_request_set_callback(ctx->r.req,
-	    CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+	skcipher_request_set_callback(ctx->r.req, flags,
 	    kcryptd_async_done, dmreq_of_req(cc, ctx->r.req));
 }
 
 static void crypt_alloc_req_aead(struct crypt_config *cc,
-				 struct convert_context *ctx)
+				 struct convert_context *ctx, u32 flags)
 {
 	if (!ctx->r.req_aead)
 		ctx->r.req_aead = mempool_alloc(cc->req_pool, GFP_NOIO);
@@ -1262,18 +1294,27 @@ static void crypt_alloc_req_aead(struct crypt_config *cc,
 	 * Use REQ_MAY_BACKLOG so a cipher driver internally backlogs
 	 * requests if driver request queue is full.
 	 */
-	aead_request_set_callback(ctx->r.req_aead,
-	    CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+	aead_request_set_callback(ctx->r.req_aead, flags,
 	    kcryptd_async_done, dmreq_of_req(cc, ctx->r.req_aead));
 }
 
+/*
+ * An atomic conversion only ever runs with a synchronous cipher, so the
+ * request preallocated in the per-bio data is never handed off to the
+ * crypto driver and the mempool is not touched here.
+ */
 static void crypt_alloc_req(struct crypt_config *cc,
-			    struct convert_context *ctx)
+			    struct convert_context *ctx, bool atomic)
 {
+	u32 flags = CRYPTO_TFM_REQ_MAY_BACKLOG;
+
+	if (!atomic)
+		flags |= CRYPTO_TFM_REQ_MAY_SLEEP;
+
 	if (crypt_integrity_aead(cc))
-		crypt_alloc_req_aead(cc, ctx);
+		crypt_alloc_req_aead(cc, ctx, flags);
 	else
-		crypt_alloc_req_skcipher(cc, ctx);
+		crypt_alloc_req_skcipher(cc, ctx, flags);
 }
 
 static void crypt_free_req_skcipher(struct crypt_config *cc,
@@ -1303,10 +1344,12 @@ static void crypt_free_req(struct crypt_config *cc, void *req, struct bio *base_
 }
 
 /*
- * Encrypt / decrypt data from one bio to another one (can be the same one)
+ * Encrypt / decrypt data from one bio to another one (can be the same one).
+ * With @atomic set the caller may be in softirq context, so the crypto
+ * request must not sleep and we must not reschedule between sectors.
  */
 static blk_status_t crypt_convert(struct crypt_config *cc,
-			 struct convert_context *ctx)
+			 struct convert_context *ctx, bool atomic)
 {
 	unsigned int tag_offset = 0;
 	unsigned int sector_step = cc->sector_size >> SECTOR_SHIFT;
@@ -1316,7 +1359,7 @@ static blk_status_t crypt_convert(struct crypt_config *cc,
 
 	while (ctx->iter_in.bi_size && ctx->iter_out.bi_size) {
 
-		crypt_alloc_req(cc, ctx);
+		crypt_alloc_req(cc, ctx, atomic);
 		atomic_inc(&ctx->cc_pending);
 
 		if (crypt_integrity_aead(cc))
@@ -1349,7 +1392,8 @@ static blk_status_t crypt_convert(struct crypt_config *cc,
 			atomic_dec(&ctx->cc_pending);
 			ctx->cc_sector += sector_step;
 			tag_offset++;
-			cond_resched();
+			if (!atomic)
+				cond_resched();
 			continue;
 		/*
 		 * There was a data integrity error.
@@ -1463,6 +1507,24 @@ static void crypt_io_init(struct dm_crypt_io *io, struct crypt_config *cc,
 	atomic_set(&io->io_pending, 0);
 }
 
+static void crypt_stage_start(struct dm_crypt_io *io)
+{
+	io->stage_start = ktime_get_ns();
+}
+
+/*
+ * Account the time spent in @stage and start timing the next one.
+ */
+static void crypt_stage_end(struct dm_crypt_io *io, enum crypt_stage stage)
+{
+	struct crypt_config *cc = io->cc;
+	u64 now = ktime_get_ns();
+
+	this_cpu_inc(cc->stage_stats->nr[stage]);
+	this_cpu_add(cc->stage_stats->ns[stage], now - io->stage_start);
+	io->stage_start = now;
+}
+
 static void crypt_inc_pending(struct dm_crypt_io *io)
 {
 	atomic_inc(&io->io_pending);
@@ -1526,6 +1588,9 @@ static void crypt_endio(struct bio *clone)
 	error = clone->bi_status;
 	bio_put(clone);
 
+	crypt_stage_end(io, rw == READ ? CRYPT_STAGE_READ_IO :
+					 CRYPT_STAGE_WRITE_IO);
+
 	if (rw == READ && !error) {
 		kcryptd_queue_crypt(io);
 		return;
@@ -1573,6 +1638,7 @@ static int kcryptd_io_read(struct dm_crypt_io *io, gfp_t gfp)
 		return 1;
 	}
 
+	crypt_stage_start(io);
 	generic_make_request(clone);
 	return 0;
 }
@@ -1681,7 +1747,11 @@ static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io, int async)
 
 	clone->bi_iter.bi_sector = cc->start + io->sector;
 
-	if (likely(!async) && test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags)) {
+	crypt_stage_end(io, CRYPT_STAGE_WRITE_CRYPT);
+
+	if (likely(!async) &&
+	    (test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags) ||
+	     test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))) {
 		generic_make_request(clone);
 		return;
 	}
@@ -1730,7 +1800,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	sector += bio_sectors(clone);
 
 	crypt_inc_pending(io);
-	r = crypt_convert(cc, &io->ctx);
+	r = crypt_convert(cc, &io->ctx, false);
 	if (r)
 		io->error = r;
 	crypt_finished = atomic_dec_and_test(&io->ctx.cc_pending);
@@ -1747,6 +1817,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 
 static void kcryptd_crypt_read_done(struct dm_crypt_io *io)
 {
+	crypt_stage_end(io, CRYPT_STAGE_READ_CRYPT);
 	crypt_dec_pending(io);
 }
 
@@ -1760,7 +1831,7 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 	crypt_convert_init(cc, &io->ctx, io->base_bio, io->base_bio,
 			   io->sector);
 
-	r = crypt_convert(cc, &io->ctx);
+	r = crypt_convert(cc, &io->ctx, in_interrupt());
 	if (r)
 		io->error = r;
 
@@ -1819,10 +1890,46 @@ static void kcryptd_crypt(struct work_struct *work)
 		kcryptd_crypt_write_convert(io);
 }
 
+static void kcryptd_crypt_tasklet(unsigned long data)
+{
+	kcryptd_crypt((struct work_struct *)data);
+}
+
+/*
+ * Reads with a synchronous cipher may be decrypted right in the bio
+ * completion, writes may be encrypted in the context of the submitter.
+ * Hard interrupt context is still too much for the crypto, so that case
+ * is bounced to a tasklet, while an encryption from any interrupt context
+ * goes to the workqueue because it has to allocate the buffer pages.
+ */
+static bool kcryptd_crypt_inline(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->cc;
+
+	if (bio_data_dir(io->base_bio) == READ)
+		return test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags) &&
+		       test_bit(CRYPT_CIPHER_SYNC, &cc->cipher_flags);
+
+	return test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags) &&
+	       !in_interrupt();
+}
+
 static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->cc;
 
+	if (kcryptd_crypt_inline(io)) {
+		if (in_irq()) {
+			tasklet_init(&io->tasklet, kcryptd_crypt_tasklet,
+				     (unsigned long)&io->work);
+			tasklet_schedule(&io->tasklet);
+			return;
+		}
+
+		kcryptd_crypt(&io->work);
+		return;
+	}
+
 	INIT_WORK(&io->work, kcryptd_crypt);
 	queue_work(cc->crypt_queue, &io->work);
 }
@@ -2180,6 +2287,8 @@ static void crypt_dtr(struct dm_target *ti)
 	mempool_destroy(cc->req_pool);
 	mempool_destroy(cc->tag_pool);
 
+	free_percpu(cc->stage_stats);
+
 	if (cc->iv_gen_ops && cc->iv_gen_ops->dtr)
 		cc->iv_gen_ops->dtr(cc);
 
@@ -2531,7 +2640,7 @@ static int crypt_ctr_optional(struct dm_target *ti, unsigned int argc, char **ar
 	struct crypt_config *cc = ti->private;
 	struct dm_arg_set as;
 	static const struct dm_arg _args[] = {
-		{0, 6, "Invalid number of feature args"},
+		{0, 8, "Invalid number of feature args"},
 	};
 	unsigned int opt_params, val;
 	const char *opt_string, *sval;
@@ -2561,6 +2670,12 @@ static int crypt_ctr_optional(struct dm_target *ti, unsigned int argc, char **ar
 
 		else if (!strcasecmp(opt_string, "submit_from_crypt_cpus"))
 			set_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
+
+		else if (!strcasecmp(opt_string, "no_read_workqueue"))
+			set_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+
+		else if (!strcasecmp(opt_string, "no_write_workqueue"))
+			set_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
 		else if (sscanf(opt_string, "integrity:%u:", &val) == 1) {
 			if (val == 0 || val > MAX_TAG_SIZE) {
 				ti->error = "Invalid integrity arguments";
@@ -2601,6 +2716,18 @@ static int crypt_ctr_optional(struct dm_target *ti, unsigned int argc, char **ar
 	return 0;
 }
 
+static bool crypt_cipher_is_sync(struct crypt_config *cc)
+{
+	struct crypto_tfm *tfm;
+
+	if (crypt_integrity_aead(cc))
+		tfm = crypto_aead_tfm(any_tfm_aead(cc));
+	else
+		tfm = crypto_skcipher_tfm(any_tfm(cc));
+
+	return !(tfm->__crt_alg->cra_flags & CRYPTO_ALG_ASYNC);
+}
+
 /*
  * Construct an encryption mapping:
  * <cipher> [<key>|:<key_size>:<user|logon>:<key_description>] <iv_offset> <dev_path> <start>
@@ -2648,6 +2775,11 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	if (ret < 0)
 		goto bad;
 
+	if (crypt_cipher_is_sync(cc))
+		set_bit(CRYPT_CIPHER_SYNC, &cc->cipher_flags);
+	else if (test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags))
+		DMINFO("asynchronous cipher, reads keep using the workqueue");
+
 	if (crypt_integrity_aead(cc)) {
 		cc->dmreq_start = sizeof(struct aead_request);
 		cc->dmreq_start += crypto_aead_reqsize(any_tfm_aead(cc));
@@ -2687,6 +2819,12 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	cc->stage_stats = alloc_percpu(struct crypt_stage_stats);
+	if (!cc->stage_stats) {
+		ti->error = "Cannot allocate crypt stage statistics";
+		goto bad;
+	}
+
 	cc->per_bio_data_size = ti->per_io_data_size =
 		ALIGN(sizeof(struct dm_crypt_io) + cc->dmreq_start + additional_req_size,
 		      ARCH_KMALLOC_MINALIGN);
@@ -2845,12 +2983,41 @@ static int crypt_map(struct dm_target *ti, struct bio *bio)
 	if (bio_data_dir(io->base_bio) == READ) {
 		if (kcryptd_io_read(io, GFP_NOWAIT))
 			kcryptd_queue_read(io);
-	} else
+	} else {
+		crypt_stage_start(io);
 		kcryptd_queue_crypt(io);
+	}
 
 	return DM_MAPIO_SUBMITTED;
 }
 
+/*
+ * Emit "<stage>:<count>:<total ns>" for each stage of the io path.
+ */
+static void crypt_status_stages(struct crypt_config *cc, char *result,
+				unsigned *szp, unsigned maxlen)
+{
+	struct crypt_stage_stats sum = { };
+	unsigned sz = *szp;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct crypt_stage_stats *s = per_cpu_ptr(cc->stage_stats, cpu);
+
+		for (i = 0; i < CRYPT_NR_STAGES; i++) {
+			sum.nr[i] += s->nr[i];
+			sum.ns[i] += s->ns[i];
+		}
+	}
+
+	for (i = 0; i < CRYPT_NR_STAGES; i++)
+		DMEMIT("%s%s:%llu:%llu", i ? " " : "", crypt_stage_names[i],
+		       (unsigned long long)sum.nr[i],
+		       (unsigned long long)sum.ns[i]);
+
+	*szp = sz;
+}
+
 static void crypt_status(struct dm_target *ti, status_type_t type,
 			 unsigned status_flags, char *result, unsigned maxlen)
 {
@@ -2861,6 +3028,7 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 	switch (type) {
 	case STATUSTYPE_INFO:
 		result[0] = '\0';
+		crypt_status_stages(cc, result, &sz, maxlen);
 		break;
 
 	case STATUSTYPE_TABLE:
@@ -2881,6 +3049,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		num_feature_args += !!ti->num_discard_bios;
 		num_feature_args += test_bit(DM_CRYPT_SAME_CPU, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
 		num_feature_args += cc->sector_size != (1 << SECTOR_SHIFT);
 		num_feature_args += test_bit(CRYPT_IV_LARGE_SECTORS, &cc->cipher_flags);
 		if (cc->on_disk_tag_size)
@@ -2893,6 +3063,10 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 				DMEMIT(" same_cpu_crypt");
 			if (test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags))
 				DMEMIT(" submit_from_crypt_cpus");
+			if (test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags))
+				DMEMIT(" no_read_workqueue");
+			if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))
+				DMEMIT(" no_write_workqueue");
 			if (cc->on_disk_tag_size)
 				DMEMIT(" integrity:%u:%s", cc->on_disk_tag_size, cc->cipher_auth);
 			if (cc->sector_size != (1 << SECTOR_SHIFT))
@@ -3007,7 +3181,7 @@ static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 18, 0},
+	.version = {1, 19, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -207,7 +207,7 @@ static void raid5_wakeup_stripe_thread(struct stripe_head *sh)
 	/* at least one worker should run to avoid race */
 	queue_work_on(sh->cpu, raid5_wq, &group->workers[0].work);
 
-	thread_cnt = group->stripes_cnt / MAX_STRIPE_BATCH - 1;
+	thread_cnt = group->stripes_cnt / conf->stripe_batch - 1;
 	/* wakeup more workers */
 	for (i = 1; i < conf->worker_cnt_per_group && thread_cnt > 0; i++) {
 		if (group->workers[i].working == false) {
@@ -644,7 +644,10 @@ raid5_get_active_stripe(struct r5conf *conf, sector_t sector,
 
 	pr_debug("get_stripe, sector %llu\n", (unsigned long long)sector);
 
-	spin_lock_irq(conf->hash_locks + hash);
+	if (!spin_trylock_irq(conf->hash_locks + hash)) {
+		atomic_long_inc(&conf->hash_lock_contended);
+		spin_lock_irq(conf->hash_locks + hash);
+	}
 
 	do {
 		wait_event_lock_irq(conf->wait_for_quiescent,
@@ -6152,6 +6155,17 @@ static int  retry_aligned_read(struct r5conf *conf, struct bio *raid_bio,
 	return handled;
 }
 
+/*
+ * Take conf->device_lock, accounting for the times somebody else held it.
+ */
+static void raid5_lock_device(struct r5conf *conf)
+{
+	if (!spin_trylock_irq(&conf->device_lock)) {
+		spin_lock_irq(&conf->device_lock);
+		conf->device_lock_contended++;
+	}
+}
+
 static int handle_active_stripes(struct r5conf *conf, int group,
 				 struct r5worker *worker,
 				 struct list_head *temp_inactive_list)
@@ -6160,7 +6174,7 @@ static int handle_active_stripes(struct r5conf *conf, int group,
 	int i, batch_size = 0, hash;
 	bool release_inactive = false;
 
-	while (batch_size < MAX_STRIPE_BATCH &&
+	while (batch_size < conf->stripe_batch &&
 			(sh = __get_priority_stripe(conf, group)) != NULL)
 		batch[batch_size++] = sh;
 
@@ -6193,7 +6207,7 @@ static int handle_active_stripes(struct r5conf *conf, int group,
 
 	cond_resched();
 
-	spin_lock_irq(&conf->device_lock);
+	raid5_lock_device(conf);
 	for (i = 0; i < batch_size; i++) {
 		hash = batch[i]->hash_lock_index;
 		__release_stripe(conf, batch[i], &temp_inactive_list[hash]);
@@ -6215,7 +6229,7 @@ static void raid5_do_work(struct work_struct *work)
 
 	blk_start_plug(&plug);
 	handled = 0;
-	spin_lock_irq(&conf->device_lock);
+	raid5_lock_device(conf);
 	while (1) {
 		int batch_size, released;
 
@@ -6265,7 +6279,7 @@ static void raid5d(struct md_thread *thread)
 
 	blk_start_plug(&plug);
 	handled = 0;
-	spin_lock_irq(&conf->device_lock);
+	raid5_lock_device(conf);
 	while (1) {
 		struct bio *bio;
 		int batch_size, released;
@@ -6489,6 +6503,69 @@ raid5_preread_bypass_threshold = __ATTR(preread_bypass_threshold,
 					raid5_show_preread_threshold,
 					raid5_store_preread_threshold);
 
+static ssize_t
+raid5_show_stripe_batch(struct mddev *mddev, char *page)
+{
+	struct r5conf *conf;
+	int ret = 0;
+	spin_lock(&mddev->lock);
+	conf = mddev->private;
+	if (conf)
+		ret = sprintf(page, "%d\n", conf->stripe_batch);
+	spin_unlock(&mddev->lock);
+	return ret;
+}
+
+static ssize_t
+raid5_store_stripe_batch(struct mddev *mddev, const char *page, size_t len)
+{
+	struct r5conf *conf;
+	unsigned long new;
+	int err;
+
+	if (len >= PAGE_SIZE)
+		return -EINVAL;
+	if (kstrtoul(page, 10, &new))
+		return -EINVAL;
+	if (!new || new > MAX_STRIPE_BATCH)
+		return -EINVAL;
+
+	err = mddev_lock(mddev);
+	if (err)
+		return err;
+	conf = mddev->private;
+	if (!conf)
+		err = -ENODEV;
+	else
+		WRITE_ONCE(conf->stripe_batch, new);
+	mddev_unlock(mddev);
+	return err ?: len;
+}
+
+static struct md_sysfs_entry
+raid5_stripe_batch = __ATTR(stripe_batch, S_IRUGO | S_IWUSR,
+			    raid5_show_stripe_batch,
+			    raid5_store_stripe_batch);
+
+static ssize_t
+raid5_show_lock_contention(struct mddev *mddev, char *page)
+{
+	struct r5conf *conf;
+	int ret = 0;
+	spin_lock(&mddev->lock);
+	conf = mddev->private;
+	if (conf)
+		ret = sprintf(page, "device_lock %lu\nhash_lock %lu\n",
+			      READ_ONCE(conf->device_lock_contended),
+			      atomic_long_read(&conf->hash_lock_contended));
+	spin_unlock(&mddev->lock);
+	return ret;
+}
+
+static struct md_sysfs_entry
+raid5_lock_contention = __ATTR(lock_contention, S_IRUGO,
+			       raid5_show_lock_contention, NULL);
+
 static ssize_t
 raid5_show_skip_copy(struct mddev *mddev, char *page)
 {
@@ -6635,6 +6712,8 @@ static struct attribute *raid5_attrs[] =  {
 	&raid5_skip_copy.attr,
 	&raid5_rmw_level.attr,
 	&r5c_journal_mode.attr,
+	&raid5_stripe_batch.attr,
+	&raid5_lock_contention.attr,
 	NULL,
 };
 static struct attribute_group raid5_attrs_group = {
@@ -6932,6 +7011,7 @@ static struct r5conf *setup_conf(struct mddev *mddev)
 	}
 
 	conf->bypass_threshold = BYPASS_THRESHOLD;
+	conf->stripe_batch = DEFAULT_STRIPE_BATCH;
 	conf->recovery_disabled = mddev->recovery_disabled - 1;
 
 	conf->raid_disks = mddev->raid_disks;
@@ -466,7 +466,8 @@ struct disk_info {
 #define BYPASS_THRESHOLD	1
 #define NR_HASH			(PAGE_SIZE / sizeof(struct hlist_head))
 #define HASH_MASK		(NR_HASH - 1)
-#define MAX_STRIPE_BATCH	8
+#define MAX_STRIPE_BATCH	32
+#define DEFAULT_STRIPE_BATCH	8
 
 /* bio's attached to a stripe+device for I/O are linked together in bi_sector
  * order without overlap.  There may be several bio's per stripe+device, and
@@ -602,6 +603,10 @@ struct r5conf {
 	int			bypass_count; /* bypassed prereads */
 	int			bypass_threshold; /* preread nice */
 	int			skip_copy; /* Don't copy data from bio to stripe cache */
+	int			stripe_batch; /* stripes handled per device_lock drop */
+	/* times device_lock / a hash lock had to be waited for */
+	unsigned long		device_lock_contended; /* under device_lock */
+	atomic_long_t		hash_lock_contended;
 	struct list_head	*last_hold; /* detect hold_list promotions */
 
 	atomic_t		reshape_stripes; /* stripes with pending writes for reshape */
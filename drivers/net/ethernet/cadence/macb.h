@@ -82,6 +82,7 @@
 #define GEM_USRIO		0x000c /* User IO */
 #define GEM_DMACFG		0x0010 /* DMA Configuration */
 #define GEM_JML			0x0048 /* Jumbo Max Length */
+#define GEM_IMOD		0x005c /* Interrupt Moderation */
 #define GEM_HRB			0x0080 /* Hash Bottom */
 #define GEM_HRT			0x0084 /* Hash Top */
 #define GEM_SA1B		0x0088 /* Specific1 Bottom */
@@ -291,6 +292,11 @@
 #define GEM_ADDR64_OFFSET	30 /* Address bus width - 64b or 32b */
 #define GEM_ADDR64_SIZE		1
 
+/* Bitfields in IMOD, in units of 800 ns */
+#define GEM_RXMOD_OFFSET	0 /* RX interrupt moderation */
+#define GEM_RXMOD_SIZE		8
+#define GEM_TXMOD_OFFSET	16 /* TX interrupt moderation */
+#define GEM_TXMOD_SIZE		8
 
 /* Bitfields in NSR */
 #define MACB_NSR_LINK_OFFSET	0 /* pcs_link_state */
@@ -540,6 +546,7 @@
 #define MACB_CAPS_USRIO_DISABLED		0x00000010
 #define MACB_CAPS_JUMBO				0x00000020
 #define MACB_CAPS_GEM_HAS_PTP			0x00000040
+#define MACB_CAPS_INT_MODERATION		0x00000080
 #define MACB_CAPS_FIFO_MODE			0x10000000
 #define MACB_CAPS_GIGABIT_MODE_AVAILABLE	0x20000000
 #define MACB_CAPS_SG_DISABLED			0x40000000
@@ -739,6 +746,8 @@ struct gem_tx_ts {
  */
 struct macb_tx_skb {
 	struct sk_buff		*skb;
+	/* XDP frame sent from this buffer, freed with page_frag_free() */
+	void			*xdp_data;
 	dma_addr_t		mapping;
 	size_t			size;
 	bool			mapped_as_page;
@@ -974,6 +983,7 @@ struct macb_queue {
 	struct macb_tx_skb	*tx_skb;
 	dma_addr_t		tx_ring_dma;
 	struct work_struct	tx_error_task;
+	struct napi_struct	napi;
 
 #ifdef CONFIG_MACB_USE_HWSTAMP
 	struct work_struct	tx_ts_task;
@@ -993,9 +1003,10 @@ struct macb {
 	unsigned int		rx_tail;
 	unsigned int		rx_prepared_head;
 	struct macb_dma_desc	*rx_ring;
-	struct sk_buff		**rx_skbuff;
+	void			**rx_buff;
 	void			*rx_buffers;
 	size_t			rx_buffer_size;
+	struct bpf_prog __rcu	*xdp_prog;
 
 	unsigned int		rx_ring_size;
 	unsigned int		tx_ring_size;
@@ -1011,7 +1022,6 @@ struct macb {
 	struct clk		*tx_clk;
 	struct clk		*rx_clk;
 	struct net_device	*dev;
-	struct napi_struct	napi;
 	union {
 		struct macb_stats	macb;
 		struct gem_stats	gem;
@@ -1047,6 +1057,19 @@ struct macb {
 
 	u32			wol;
 
+	/* Interrupt moderation, in usecs */
+	u32			rx_coalesce_usecs;
+	u32			tx_coalesce_usecs;
+	bool			rx_coalesce_adaptive;
+	u32			rx_coalesce_usecs_low;
+	u32			rx_coalesce_usecs_high;
+	u32			pkt_rate_low;
+	u32			pkt_rate_high;
+	/* Adaptive RX moderation: packets since rx_rate_stamp */
+	unsigned long		rx_rate_stamp;
+	unsigned int		rx_rate_pkts;
+	u32			rx_coalesce_cur;
+
 	struct macb_ptp_info	*ptp_info;	/* macb-ptp interface */
 #ifdef MACB_EXT_DESC
 	uint8_t hw_dma_cap;
@@ -22,6 +22,7 @@
 #include <linux/gpio/consumer.h>
 #include <linux/interrupt.h>
 #include <linux/netdevice.h>
+#include <linux/rtnetlink.h>
 #include <linux/etherdevice.h>
 #include <linux/dma-mapping.h>
 #include <linux/platform_data/macb.h>
@@ -35,11 +36,28 @@
 #include <linux/ip.h>
 #include <linux/udp.h>
 #include <linux/tcp.h>
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
+#include <linux/filter.h>
 #include "macb.h"
 
 #define MACB_RX_BUFFER_SIZE	128
 #define RX_BUFFER_MULTIPLE	64  /* bytes */
 
+/* Length of the receive buffers for a given MTU, before rounding up */
+#define MACB_RX_BUFSZ(mtu)	((mtu) + ETH_HLEN + ETH_FCS_LEN + NET_IP_ALIGN)
+
+/* GEM receives into page fragments that leave room in front of the frame
+ * for an XDP program, and behind it for the shared info of build_skb().
+ * Always reserving the XDP headroom costs nothing at the default MTU, and
+ * lets a program be attached without reallocating the ring.
+ */
+#define GEM_RX_HEADROOM		XDP_PACKET_HEADROOM
+
+/* Work left for the end of gem_rx() by the XDP program */
+#define GEM_XDP_TX		BIT(0)
+#define GEM_XDP_REDIR		BIT(1)
+
 #define DEFAULT_RX_RING_SIZE	512 /* must be power of 2 */
 #define MIN_RX_RING_SIZE	64
 #define MAX_RX_RING_SIZE	8192
@@ -55,6 +73,18 @@
 /* level of occupied TX descriptors under which we wake up TX process */
 #define MACB_TX_WAKEUP_THRESH(bp)	(3 * (bp)->tx_ring_size / 4)
 
+/* GEM interrupt moderation counts in steps of 800 ns */
+#define GEM_IMOD_NS		800
+#define GEM_IMOD_MAX_USECS	\
+	(GENMASK(GEM_RXMOD_SIZE - 1, 0) * GEM_IMOD_NS / NSEC_PER_USEC)
+
+/* Adaptive RX moderation samples the packet rate every 100 ms */
+#define MACB_AIM_INTERVAL	(HZ / 10)
+#define MACB_AIM_USECS_LOW	0
+#define MACB_AIM_USECS_HIGH	100
+#define MACB_AIM_RATE_LOW	10000	/* packets per second */
+#define MACB_AIM_RATE_HIGH	100000
+
 #define MACB_RX_INT_FLAGS	(MACB_BIT(RCOMP) | MACB_BIT(RXUBR)	\
 				 | MACB_BIT(ISR_ROVR))
 #define MACB_TX_ERR_FLAGS	(MACB_BIT(ISR_TUND)			\
@@ -664,6 +694,11 @@ static void macb_tx_unmap(struct macb *bp, struct macb_tx_skb *tx_skb)
 		dev_kfree_skb_any(tx_skb->skb);
 		tx_skb->skb = NULL;
 	}
+
+	if (tx_skb->xdp_data) {
+		page_frag_free(tx_skb->xdp_data);
+		tx_skb->xdp_data = NULL;
+	}
 }
 
 static void macb_set_addr(struct macb *bp, struct macb_dma_desc *desc, dma_addr_t addr)
@@ -709,8 +744,8 @@ static void macb_tx_error_task(struct work_struct *work)
 		    (unsigned int)(queue - bp->queues),
 		    queue->tx_tail, queue->tx_head);
 
-	/* Prevent the queue IRQ handlers from running: each of them may call
-	 * macb_tx_interrupt(), which in turn may call netif_wake_subqueue().
+	/* Prevent the queue NAPI handlers from running: each of them may call
+	 * macb_tx_complete(), which in turn may call netif_wake_subqueue().
 	 * As explained below, we have to halt the transmission before updating
 	 * TBQP registers so we call netif_tx_stop_all_queues() to notify the
 	 * network engine about the macb/gem being halted.
@@ -740,8 +775,10 @@ static void macb_tx_error_task(struct work_struct *work)
 		skb = tx_skb->skb;
 
 		if (ctrl & MACB_BIT(TX_USED)) {
-			/* skb is set for the last buffer of the frame */
-			while (!skb) {
+			/* skb is set for the last buffer of the frame, XDP
+			 * frames only ever take one
+			 */
+			while (!skb && !tx_skb->xdp_data) {
 				macb_tx_unmap(bp, tx_skb);
 				tail++;
 				tx_skb = macb_tx_skb(queue, tail);
@@ -752,11 +789,11 @@ static void macb_tx_error_task(struct work_struct *work)
 			 * since it's the only one written back by the hardware
 			 */
 			if (!(ctrl & MACB_BIT(TX_BUF_EXHAUSTED))) {
-				netdev_vdbg(bp->dev, "txerr skb %u (data %p) TX complete\n",
-					    macb_tx_ring_wrap(bp, tail),
-					    skb->data);
+				netdev_vdbg(bp->dev, "txerr frame %u TX complete\n",
+					    macb_tx_ring_wrap(bp, tail));
 				bp->dev->stats.tx_packets++;
-				bp->dev->stats.tx_bytes += skb->len;
+				bp->dev->stats.tx_bytes += skb ? skb->len :
+							   tx_skb->size;
 			}
 		} else {
 			/* "Buffers exhausted mid-frame" errors may only happen
@@ -802,25 +839,27 @@ static void macb_tx_error_task(struct work_struct *work)
 	spin_unlock_irqrestore(&bp->lock, flags);
 }
 
-static void macb_tx_interrupt(struct macb_queue *queue)
+/* Reclaim up to @budget transmitted frames, from the NAPI poll of the queue */
+static int macb_tx_complete(struct macb_queue *queue, int budget)
 {
 	unsigned int tail;
 	unsigned int head;
 	u32 status;
 	struct macb *bp = queue->bp;
 	u16 queue_index = queue - bp->queues;
+	unsigned long flags;
+	int packets = 0;
+
+	spin_lock_irqsave(&bp->lock, flags);
 
 	status = macb_readl(bp, TSR);
 	macb_writel(bp, TSR, status);
 
-	if (bp->caps & MACB_CAPS_ISR_CLEAR_ON_WRITE)
-		queue_writel(queue, ISR, MACB_BIT(TCOMP));
-
-	netdev_vdbg(bp->dev, "macb_tx_interrupt status = 0x%03lx\n",
+	netdev_vdbg(bp->dev, "macb_tx_complete status = 0x%03lx\n",
 		    (unsigned long)status);
 
 	head = queue->tx_head;
-	for (tail = queue->tx_tail; tail != head; tail++) {
+	for (tail = queue->tx_tail; tail != head && packets < budget; tail++) {
 		struct macb_tx_skb	*tx_skb;
 		struct sk_buff		*skb;
 		struct macb_dma_desc	*desc;
@@ -841,8 +880,16 @@ static void macb_tx_interrupt(struct macb_queue *queue)
 
 		/* Process all buffers of the current transmitted frame */
 		for (;; tail++) {
+			void *xdp_data;
+
 			tx_skb = macb_tx_skb(queue, tail);
 			skb = tx_skb->skb;
+			xdp_data = tx_skb->xdp_data;
+
+			if (xdp_data) {
+				bp->dev->stats.tx_packets++;
+				bp->dev->stats.tx_bytes += tx_skb->size;
+			}
 
 			/* First, update TX stats if needed */
 			if (skb) {
@@ -866,9 +913,10 @@ static void macb_tx_interrupt(struct macb_queue *queue)
 			 * WARNING: at this point skb has been freed by
 			 * macb_tx_unmap().
 			 */
-			if (skb)
+			if (skb || xdp_data)
 				break;
 		}
+		packets++;
 	}
 
 	queue->tx_tail = tail;
@@ -876,12 +924,134 @@ static void macb_tx_interrupt(struct macb_queue *queue)
 	    CIRC_CNT(queue->tx_head, queue->tx_tail,
 		     bp->tx_ring_size) <= MACB_TX_WAKEUP_THRESH(bp))
 		netif_wake_subqueue(bp->dev, queue_index);
+
+	spin_unlock_irqrestore(&bp->lock, flags);
+
+	return packets;
+}
+
+/* A frame the hardware is done with, whose TCOMP may have gone unnoticed */
+static bool macb_tx_complete_pending(struct macb_queue *queue)
+{
+	struct macb *bp = queue->bp;
+	bool retval = false;
+	unsigned long flags;
+
+	spin_lock_irqsave(&bp->lock, flags);
+	if (queue->tx_head != queue->tx_tail) {
+		/* Make hw descriptor updates visible to CPU */
+		rmb();
+
+		if (macb_tx_desc(queue, queue->tx_tail)->ctrl &
+		    MACB_BIT(TX_USED))
+			retval = true;
+	}
+	spin_unlock_irqrestore(&bp->lock, flags);
+
+	return retval;
+}
+
+static unsigned int gem_rx_truesize(size_t rx_buffer_size)
+{
+	return SKB_DATA_ALIGN(GEM_RX_HEADROOM + rx_buffer_size) +
+	       SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+}
+
+/* An XDP frame has to fit in one page */
+static bool gem_xdp_mtu_ok(unsigned int mtu)
+{
+	size_t size = roundup(MACB_RX_BUFSZ(mtu), RX_BUFFER_MULTIPLE);
+
+	return gem_rx_truesize(size) <= PAGE_SIZE;
+}
+
+/* XDP_TX and redirected frames go out on the last queue: with more than
+ * one, it is kept from the stack while a program is attached.
+ */
+static struct macb_queue *macb_xdp_queue(struct macb *bp)
+{
+	return &bp->queues[bp->num_queues - 1];
+}
+
+/* Queue an XDP frame for transmit in a single descriptor.  On success the
+ * frame belongs to the ring, and is freed with page_frag_free() once sent.
+ */
+static int macb_xdp_submit(struct macb *bp, struct xdp_buff *xdp)
+{
+	struct macb_queue *queue = macb_xdp_queue(bp);
+	unsigned int len = xdp->data_end - xdp->data;
+	struct macb_tx_skb *tx_skb;
+	struct macb_dma_desc *desc;
+	unsigned int entry;
+	unsigned long flags;
+	dma_addr_t mapping;
+	u32 ctrl;
+
+	if (unlikely(len > bp->max_tx_length))
+		return -EMSGSIZE;
+
+	mapping = dma_map_single(&bp->pdev->dev, xdp->data, len,
+				 DMA_TO_DEVICE);
+	if (dma_mapping_error(&bp->pdev->dev, mapping))
+		return -ENOMEM;
+
+	spin_lock_irqsave(&bp->lock, flags);
+
+	if (CIRC_SPACE(queue->tx_head, queue->tx_tail,
+		       bp->tx_ring_size) < 1) {
+		spin_unlock_irqrestore(&bp->lock, flags);
+		dma_unmap_single(&bp->pdev->dev, mapping, len, DMA_TO_DEVICE);
+		return -ENOSPC;
+	}
+
+	entry = macb_tx_ring_wrap(bp, queue->tx_head);
+	tx_skb = &queue->tx_skb[entry];
+	tx_skb->skb = NULL;
+	tx_skb->xdp_data = xdp->data;
+	tx_skb->mapping = mapping;
+	tx_skb->size = len;
+	tx_skb->mapped_as_page = false;
+
+	/* Set the end of the TX queue before handing the frame over */
+	desc = macb_tx_desc(queue, queue->tx_head + 1);
+	desc->ctrl = MACB_BIT(TX_USED);
+
+	ctrl = len | MACB_BIT(TX_LAST);
+	if (unlikely(entry == (bp->tx_ring_size - 1)))
+		ctrl |= MACB_BIT(TX_WRAP);
+
+	desc = macb_tx_desc(queue, entry);
+	macb_set_addr(bp, desc, mapping);
+	/* desc->addr must be visible to hardware before clearing
+	 * 'TX_USED' bit in desc->ctrl.
+	 */
+	wmb();
+	desc->ctrl = ctrl;
+
+	queue->tx_head++;
+
+	spin_unlock_irqrestore(&bp->lock, flags);
+
+	return 0;
+}
+
+static void macb_xdp_kick(struct macb *bp)
+{
+	unsigned long flags;
+
+	/* Make newly initialized descriptors visible to hardware */
+	wmb();
+
+	spin_lock_irqsave(&bp->lock, flags);
+	macb_writel(bp, NCR, macb_readl(bp, NCR) | MACB_BIT(TSTART));
+	spin_unlock_irqrestore(&bp->lock, flags);
 }
 
 static void gem_rx_refill(struct macb *bp)
 {
+	unsigned int		truesize = gem_rx_truesize(bp->rx_buffer_size);
 	unsigned int		entry;
-	struct sk_buff		*skb;
+	void			*buf;
 	dma_addr_t		paddr;
 	struct macb_dma_desc *desc;
 
@@ -895,33 +1065,33 @@ static void gem_rx_refill(struct macb *bp)
 		bp->rx_prepared_head++;
 		desc = macb_rx_desc(bp, entry);
 
-		if (!bp->rx_skbuff[entry]) {
-			/* allocate sk_buff for this free entry in ring */
-			skb = netdev_alloc_skb(bp->dev, bp->rx_buffer_size);
-			if (unlikely(!skb)) {
+		if (!bp->rx_buff[entry]) {
+			/* allocate a buffer for this free entry in ring */
+			buf = netdev_alloc_frag(truesize);
+			if (unlikely(!buf)) {
 				netdev_err(bp->dev,
-					   "Unable to allocate sk_buff\n");
+					   "Unable to allocate RX buffer\n");
 				break;
 			}
 
-			/* now fill corresponding descriptor entry */
-			paddr = dma_map_single(&bp->pdev->dev, skb->data,
+			/* now fill corresponding descriptor entry; the
+			 * Ethernet header lands NET_IP_ALIGN bytes in (RBOF)
+			 */
+			paddr = dma_map_single(&bp->pdev->dev,
+					       buf + GEM_RX_HEADROOM,
 					       bp->rx_buffer_size,
 					       DMA_FROM_DEVICE);
 			if (dma_mapping_error(&bp->pdev->dev, paddr)) {
-				dev_kfree_skb(skb);
+				page_frag_free(buf);
 				break;
 			}
 
-			bp->rx_skbuff[entry] = skb;
+			bp->rx_buff[entry] = buf;
 
 			if (entry == bp->rx_ring_size - 1)
 				paddr |= MACB_BIT(RX_WRAP);
 			macb_set_addr(bp, desc, paddr);
 			desc->ctrl = 0;
-
-			/* properly align Ethernet header */
-			skb_reserve(skb, NET_IP_ALIGN);
 		} else {
 			desc->addr &= ~MACB_BIT(RX_USED);
 			desc->ctrl = 0;
@@ -956,18 +1126,70 @@ static void discard_partial_frame(struct macb *bp, unsigned int begin,
 	 */
 }
 
+/* Run the XDP program on a received frame.  Returns true if the buffer
+ * was consumed, false if an skb is to be built around @xdp; the frames
+ * passed on are counted with the skbs.
+ */
+static bool gem_rx_xdp(struct macb *bp, struct bpf_prog *xdp_prog,
+		       struct xdp_buff *xdp, unsigned int *xdp_work)
+{
+	unsigned int len = xdp->data_end - xdp->data;
+	u32 act;
+	int err;
+
+	act = bpf_prog_run_xdp(xdp_prog, xdp);
+	if (act == XDP_PASS)
+		return false;
+
+	bp->dev->stats.rx_packets++;
+	bp->dev->stats.rx_bytes += len;
+
+	switch (act) {
+	case XDP_TX:
+		if (unlikely(macb_xdp_submit(bp, xdp)))
+			goto err_xdp;
+		*xdp_work |= GEM_XDP_TX;
+		return true;
+	case XDP_REDIRECT:
+		err = xdp_do_redirect(bp->dev, xdp, xdp_prog);
+		if (unlikely(err))
+			goto err_xdp;
+		*xdp_work |= GEM_XDP_REDIR;
+		return true;
+	default:
+		bpf_warn_invalid_xdp_action(act);
+		/* fall through */
+	case XDP_ABORTED:
+err_xdp:
+		trace_xdp_exception(bp->dev, xdp_prog, act);
+		bp->dev->stats.rx_dropped++;
+		/* fall through */
+	case XDP_DROP:
+		page_frag_free(xdp->data_hard_start);
+		return true;
+	}
+}
+
 static int gem_rx(struct macb *bp, int budget)
 {
+	unsigned int		truesize = gem_rx_truesize(bp->rx_buffer_size);
+	unsigned int		xdp_work = 0;
+	struct bpf_prog		*xdp_prog;
 	unsigned int		len;
 	unsigned int		entry;
 	struct sk_buff		*skb;
 	struct macb_dma_desc	*desc;
 	int			count = 0;
 
+	rcu_read_lock();
+	xdp_prog = rcu_dereference(bp->xdp_prog);
+
 	while (count < budget) {
+		struct xdp_buff xdp;
 		u32 ctrl;
 		dma_addr_t addr;
 		bool rxused;
+		void *buf;
 
 		entry = macb_rx_ring_wrap(bp, bp->rx_tail);
 		desc = macb_rx_desc(bp, entry);
@@ -991,23 +1213,39 @@ static int gem_rx(struct macb *bp, int budget)
 			bp->dev->stats.rx_dropped++;
 			break;
 		}
-		skb = bp->rx_skbuff[entry];
-		if (unlikely(!skb)) {
+		buf = bp->rx_buff[entry];
+		if (unlikely(!buf)) {
 			netdev_err(bp->dev,
 				   "inconsistent Rx descriptor chain\n");
 			bp->dev->stats.rx_dropped++;
 			break;
 		}
 		/* now everything is ready for receiving packet */
-		bp->rx_skbuff[entry] = NULL;
+		bp->rx_buff[entry] = NULL;
 		len = ctrl & bp->rx_frm_len_mask;
 
 		netdev_vdbg(bp->dev, "gem_rx %u (len %u)\n", entry, len);
 
-		skb_put(skb, len);
 		dma_unmap_single(&bp->pdev->dev, addr,
 				 bp->rx_buffer_size, DMA_FROM_DEVICE);
 
+		xdp.data_hard_start = buf;
+		xdp.data = buf + GEM_RX_HEADROOM + NET_IP_ALIGN;
+		xdp.data_end = xdp.data + len;
+
+		if (xdp_prog && gem_rx_xdp(bp, xdp_prog, &xdp, &xdp_work))
+			continue;
+
+		/* The program may have moved the start or the end */
+		skb = build_skb(buf, truesize);
+		if (unlikely(!skb)) {
+			page_frag_free(buf);
+			bp->dev->stats.rx_dropped++;
+			continue;
+		}
+		skb_reserve(skb, xdp.data - xdp.data_hard_start);
+		skb_put(skb, xdp.data_end - xdp.data);
+
 		skb->protocol = eth_type_trans(skb, bp->dev);
 		skb_checksum_none_assert(skb);
 		if (bp->dev->features & NETIF_F_RXCSUM &&
@@ -1029,9 +1267,16 @@ static int gem_rx(struct macb *bp, int budget)
 			       skb->data, 32, true);
 #endif
 
-		netif_receive_skb(skb);
+		napi_gro_receive(&bp->queues[0].napi, skb);
 	}
 
+	rcu_read_unlock();
+
+	if (xdp_work & GEM_XDP_TX)
+		macb_xdp_kick(bp);
+	if (xdp_work & GEM_XDP_REDIR)
+		xdp_do_flush_map();
+
 	gem_rx_refill(bp);
 
 	return count;
@@ -1113,7 +1358,7 @@ static int macb_rx_frame(struct macb *bp, unsigned int first_frag,
 	bp->dev->stats.rx_bytes += skb->len;
 	netdev_vdbg(bp->dev, "received skb of length %u, csum: %08x\n",
 		    skb->len, skb->csum);
-	netif_receive_skb(skb);
+	napi_gro_receive(&bp->queues[0].napi, skb);
 
 	return 0;
 }
@@ -1209,33 +1454,107 @@ static int macb_rx(struct macb *bp, int budget)
 	return received;
 }
 
+static void gem_write_imod(struct macb *bp, u32 rx_usecs)
+{
+	u32 rx = DIV_ROUND_UP(rx_usecs * NSEC_PER_USEC, GEM_IMOD_NS);
+	u32 tx = DIV_ROUND_UP(bp->tx_coalesce_usecs * NSEC_PER_USEC,
+			      GEM_IMOD_NS);
+
+	gem_writel(bp, IMOD, GEM_BF(RXMOD, rx) | GEM_BF(TXMOD, tx));
+}
+
+/* Adaptive RX moderation: once per interval, move the moderation towards
+ * the setting for the packet rate seen since the last one, interpolating
+ * between the low and high settings.
+ */
+static void gem_rx_adapt(struct macb *bp, int received)
+{
+	unsigned long delta = jiffies - bp->rx_rate_stamp;
+	u32 low = bp->rx_coalesce_usecs_low;
+	u32 high = bp->rx_coalesce_usecs_high;
+	u32 rate, usecs;
+
+	bp->rx_rate_pkts += received;
+	if (delta < MACB_AIM_INTERVAL)
+		return;
+
+	rate = div_u64((u64)bp->rx_rate_pkts * HZ, delta);
+	bp->rx_rate_pkts = 0;
+	bp->rx_rate_stamp = jiffies;
+
+	if (rate <= bp->pkt_rate_low)
+		usecs = low;
+	else if (rate >= bp->pkt_rate_high)
+		usecs = high;
+	else
+		usecs = low + div_s64((s64)((int)high - (int)low) *
+				      (rate - bp->pkt_rate_low),
+				      bp->pkt_rate_high - bp->pkt_rate_low);
+
+	/* Damp the changes: go halfway there */
+	usecs = (usecs + bp->rx_coalesce_cur) >> 1;
+	if (usecs == bp->rx_coalesce_cur)
+		return;
+
+	bp->rx_coalesce_cur = usecs;
+	gem_write_imod(bp, usecs);
+}
+
+/* Each queue polls its own TX ring, and queue 0, the only one receiving,
+ * the RX ring as well.
+ */
 static int macb_poll(struct napi_struct *napi, int budget)
 {
-	struct macb *bp = container_of(napi, struct macb, napi);
-	int work_done;
+	struct macb_queue *queue = container_of(napi, struct macb_queue, napi);
+	struct macb *bp = queue->bp;
+	bool rx = queue == bp->queues;
+	int work_done = 0;
+	int tx_done;
+	u32 enable;
 	u32 status;
 
-	status = macb_readl(bp, RSR);
-	macb_writel(bp, RSR, status);
+	tx_done = macb_tx_complete(queue, budget);
+
+	if (rx) {
+		status = macb_readl(bp, RSR);
+		macb_writel(bp, RSR, status);
+
+		netdev_vdbg(bp->dev, "poll: status = %08lx, budget = %d\n",
+			    (unsigned long)status, budget);
 
-	work_done = 0;
+		work_done = bp->macbgem_ops.mog_rx(bp, budget);
+		if (bp->rx_coalesce_adaptive)
+			gem_rx_adapt(bp, work_done);
+	}
 
-	netdev_vdbg(bp->dev, "poll: status = %08lx, budget = %d\n",
-		    (unsigned long)status, budget);
+	if (tx_done >= budget || work_done >= budget)
+		return budget;
 
-	work_done = bp->macbgem_ops.mog_rx(bp, budget);
-	if (work_done < budget) {
-		napi_complete_done(napi, work_done);
+	if (!napi_complete_done(napi, work_done))
+		return work_done;
 
+	enable = MACB_BIT(TCOMP);
+	if (rx) {
 		/* Packets received while interrupts were disabled */
 		status = macb_readl(bp, RSR);
 		if (status) {
 			if (bp->caps & MACB_CAPS_ISR_CLEAR_ON_WRITE)
 				macb_writel(bp, ISR, MACB_BIT(RCOMP));
 			napi_reschedule(napi);
-		} else {
-			macb_writel(bp, IER, MACB_RX_INT_FLAGS);
+			return work_done;
 		}
+		enable |= MACB_RX_INT_FLAGS;
+	}
+	queue_writel(queue, IER, enable);
+
+	/* A frame completed while TCOMP was masked may have left no trace
+	 * in ISR: look at the ring again now that it is enabled.
+	 */
+	if (macb_tx_complete_pending(queue)) {
+		queue_writel(queue, IDR, enable);
+		if (bp->caps & MACB_CAPS_ISR_CLEAR_ON_WRITE)
+			queue_writel(queue, ISR, MACB_BIT(TCOMP));
+		napi_schedule(napi);
 	}
 
 	/* TODO: Handle errors */
@@ -1281,9 +1600,9 @@ static irqreturn_t macb_interrupt(int irq, void *dev_id)
 			if (bp->caps & MACB_CAPS_ISR_CLEAR_ON_WRITE)
 				queue_writel(queue, ISR, MACB_BIT(RCOMP));
 
-			if (napi_schedule_prep(&bp->napi)) {
+			if (napi_schedule_prep(&bp->queues[0].napi)) {
 				netdev_vdbg(bp->dev, "scheduling RX softirq\n");
-				__napi_schedule(&bp->napi);
+				__napi_schedule(&bp->queues[0].napi);
 			}
 		}
 
@@ -1297,8 +1616,17 @@ static irqreturn_t macb_interrupt(int irq, void *dev_id)
 			break;
 		}
 
-		if (status & MACB_BIT(TCOMP))
-			macb_tx_interrupt(queue);
+		if (status & MACB_BIT(TCOMP)) {
+			/* Reclaimed from the NAPI poll of the queue */
+			queue_writel(queue, IDR, MACB_BIT(TCOMP));
+			if (bp->caps & MACB_CAPS_ISR_CLEAR_ON_WRITE)
+				queue_writel(queue, ISR, MACB_BIT(TCOMP));
+
+			if (napi_schedule_prep(&queue->napi)) {
+				netdev_vdbg(bp->dev, "scheduling TX softirq\n");
+				__napi_schedule(&queue->napi);
+			}
+		}
 
 		/* Link change detection isn't possible with RMII, so we'll
 		 * add that if/when we get our hands on a full-blown MII PHY.
@@ -1410,6 +1738,7 @@ static unsigned int macb_tx_map(struct macb *bp,
 
 		/* Save info to properly release resources */
 		tx_skb->skb = NULL;
+		tx_skb->xdp_data = NULL;
 		tx_skb->mapping = mapping;
 		tx_skb->size = size;
 		tx_skb->mapped_as_page = false;
@@ -1440,6 +1769,7 @@ static unsigned int macb_tx_map(struct macb *bp,
 
 			/* Save info to properly release resources */
 			tx_skb->skb = NULL;
+			tx_skb->xdp_data = NULL;
 			tx_skb->mapping = mapping;
 			tx_skb->size = size;
 			tx_skb->mapped_as_page = true;
@@ -1705,18 +2035,18 @@ static void macb_init_rx_buffer_size(struct macb *bp, size_t size)
 
 static void gem_free_rx_buffers(struct macb *bp)
 {
-	struct sk_buff		*skb;
 	struct macb_dma_desc	*desc;
 	dma_addr_t		addr;
+	void			*buf;
 	int i;
 
-	if (!bp->rx_skbuff)
+	if (!bp->rx_buff)
 		return;
 
 	for (i = 0; i < bp->rx_ring_size; i++) {
-		skb = bp->rx_skbuff[i];
+		buf = bp->rx_buff[i];
 
-		if (!skb)
+		if (!buf)
 			continue;
 
 		desc = macb_rx_desc(bp, i);
@@ -1724,12 +2054,11 @@ static void gem_free_rx_buffers(struct macb *bp)
 
 		dma_unmap_single(&bp->pdev->dev, addr, bp->rx_buffer_size,
 				 DMA_FROM_DEVICE);
-		dev_kfree_skb_any(skb);
-		skb = NULL;
+		page_frag_free(buf);
 	}
 
-	kfree(bp->rx_skbuff);
-	bp->rx_skbuff = NULL;
+	kfree(bp->rx_buff);
+	bp->rx_buff = NULL;
 }
 
 static void macb_free_rx_buffers(struct macb *bp)
@@ -1769,14 +2098,14 @@ static int gem_alloc_rx_buffers(struct macb *bp)
 {
 	int size;
 
-	size = bp->rx_ring_size * sizeof(struct sk_buff *);
-	bp->rx_skbuff = kzalloc(size, GFP_KERNEL);
-	if (!bp->rx_skbuff)
+	size = bp->rx_ring_size * sizeof(void *);
+	bp->rx_buff = kzalloc(size, GFP_KERNEL);
+	if (!bp->rx_buff)
 		return -ENOMEM;
 	else
 		netdev_dbg(bp->dev,
-			   "Allocated %d RX struct sk_buff entries at %p\n",
-			   bp->rx_ring_size, bp->rx_skbuff);
+			   "Allocated %d RX buffer entries at %p\n",
+			   bp->rx_ring_size, bp->rx_buff);
 	return 0;
 }
 
@@ -2049,6 +2378,13 @@ static void macb_init_hw(struct macb *bp)
 
 	macb_configure_dma(bp);
 
+	if (bp->caps & MACB_CAPS_INT_MODERATION) {
+		bp->rx_coalesce_cur = bp->rx_coalesce_usecs;
+		bp->rx_rate_pkts = 0;
+		bp->rx_rate_stamp = jiffies;
+		gem_write_imod(bp, bp->rx_coalesce_cur);
+	}
+
 	/* Initialize TX and RX buffers */
 	macb_writel(bp, RBQP, lower_32_bits(bp->rx_ring_dma));
 #ifdef CONFIG_ARCH_DMA_ADDR_T_64BIT
@@ -2195,7 +2531,9 @@ static void macb_set_rx_mode(struct net_device *dev)
 static int macb_open(struct net_device *dev)
 {
 	struct macb *bp = netdev_priv(dev);
-	size_t bufsz = dev->mtu + ETH_HLEN + ETH_FCS_LEN + NET_IP_ALIGN;
+	size_t bufsz = MACB_RX_BUFSZ(dev->mtu);
+	struct macb_queue *queue;
+	unsigned int q;
 	int err;
 
 	netdev_dbg(bp->dev, "open\n");
@@ -2217,7 +2555,8 @@ static int macb_open(struct net_device *dev)
 		return err;
 	}
 
-	napi_enable(&bp->napi);
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue)
+		napi_enable(&queue->napi);
 
 	bp->macbgem_ops.mog_init_rings(bp);
 	macb_init_hw(bp);
@@ -2236,10 +2575,13 @@ static int macb_open(struct net_device *dev)
 static int macb_close(struct net_device *dev)
 {
 	struct macb *bp = netdev_priv(dev);
+	struct macb_queue *queue;
 	unsigned long flags;
+	unsigned int q;
 
 	netif_tx_stop_all_queues(dev);
-	napi_disable(&bp->napi);
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue)
+		napi_disable(&queue->napi);
 
 	if (dev->phydev)
 		phy_stop(dev->phydev);
@@ -2259,14 +2601,94 @@ static int macb_close(struct net_device *dev)
 
 static int macb_change_mtu(struct net_device *dev, int new_mtu)
 {
+	struct macb *bp = netdev_priv(dev);
+
 	if (netif_running(dev))
 		return -EBUSY;
 
+	if (rtnl_dereference(bp->xdp_prog) && !gem_xdp_mtu_ok(new_mtu)) {
+		netdev_warn(dev, "MTU %d too large for XDP\n", new_mtu);
+		return -EINVAL;
+	}
+
 	dev->mtu = new_mtu;
 
 	return 0;
 }
 
+static int gem_xdp_set(struct net_device *dev, struct bpf_prog *prog,
+		       struct netlink_ext_ack *extack)
+{
+	struct macb *bp = netdev_priv(dev);
+	unsigned int txqs = bp->num_queues;
+	struct bpf_prog *old_prog;
+	int err;
+
+	if (!macb_is_gem(bp)) {
+		NL_SET_ERR_MSG(extack, "XDP needs a GEM");
+		return -EOPNOTSUPP;
+	}
+
+	if (prog && !gem_xdp_mtu_ok(dev->mtu)) {
+		NL_SET_ERR_MSG(extack, "MTU too large for XDP");
+		return -EINVAL;
+	}
+
+	/* Keep the stack off the XDP queue while a program may use it */
+	if (prog && txqs > 1)
+		txqs--;
+	err = netif_set_real_num_tx_queues(dev, txqs);
+	if (err)
+		return err;
+
+	/* The receive buffers always have the XDP headroom: swap in place */
+	old_prog = rtnl_dereference(bp->xdp_prog);
+	rcu_assign_pointer(bp->xdp_prog, prog);
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return 0;
+}
+
+static int macb_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+{
+	struct macb *bp = netdev_priv(dev);
+	struct bpf_prog *prog;
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		return gem_xdp_set(dev, xdp->prog, xdp->extack);
+	case XDP_QUERY_PROG:
+		prog = rtnl_dereference(bp->xdp_prog);
+		xdp->prog_id = prog ? prog->aux->id : 0;
+		xdp->prog_attached = !!prog;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Frames redirected here from other devices, sent on the next flush */
+static int macb_xdp_xmit(struct net_device *dev, struct xdp_buff *xdp)
+{
+	struct macb *bp = netdev_priv(dev);
+
+	if (!macb_is_gem(bp))
+		return -EOPNOTSUPP;
+	if (unlikely(!netif_running(dev)))
+		return -ENETDOWN;
+
+	return macb_xdp_submit(bp, xdp);
+}
+
+static void macb_xdp_flush(struct net_device *dev)
+{
+	struct macb *bp = netdev_priv(dev);
+
+	if (netif_running(dev))
+		macb_xdp_kick(bp);
+}
+
 static void gem_update_stats(struct macb *bp)
 {
 	unsigned int i;
@@ -2527,6 +2949,63 @@ static int macb_set_ringparam(struct net_device *netdev,
 	return 0;
 }
 
+static int gem_get_coalesce(struct net_device *netdev,
+			    struct ethtool_coalesce *ec)
+{
+	struct macb *bp = netdev_priv(netdev);
+
+	if (!(bp->caps & MACB_CAPS_INT_MODERATION))
+		return -EOPNOTSUPP;
+
+	ec->rx_coalesce_usecs = bp->rx_coalesce_usecs;
+	ec->tx_coalesce_usecs = bp->tx_coalesce_usecs;
+	ec->use_adaptive_rx_coalesce = bp->rx_coalesce_adaptive;
+	ec->rx_coalesce_usecs_low = bp->rx_coalesce_usecs_low;
+	ec->rx_coalesce_usecs_high = bp->rx_coalesce_usecs_high;
+	ec->pkt_rate_low = bp->pkt_rate_low;
+	ec->pkt_rate_high = bp->pkt_rate_high;
+
+	return 0;
+}
+
+static int gem_set_coalesce(struct net_device *netdev,
+			    struct ethtool_coalesce *ec)
+{
+	struct macb *bp = netdev_priv(netdev);
+
+	if (!(bp->caps & MACB_CAPS_INT_MODERATION))
+		return -EOPNOTSUPP;
+
+	if (ec->rx_coalesce_usecs > GEM_IMOD_MAX_USECS ||
+	    ec->tx_coalesce_usecs > GEM_IMOD_MAX_USECS ||
+	    ec->rx_coalesce_usecs_low > GEM_IMOD_MAX_USECS ||
+	    ec->rx_coalesce_usecs_high > GEM_IMOD_MAX_USECS)
+		return -EINVAL;
+
+	if (ec->use_adaptive_rx_coalesce &&
+	    ec->pkt_rate_low >= ec->pkt_rate_high)
+		return -EINVAL;
+
+	bp->rx_coalesce_adaptive = false;
+	bp->rx_coalesce_usecs = ec->rx_coalesce_usecs;
+	bp->tx_coalesce_usecs = ec->tx_coalesce_usecs;
+	bp->rx_coalesce_usecs_low = ec->rx_coalesce_usecs_low;
+	bp->rx_coalesce_usecs_high = ec->rx_coalesce_usecs_high;
+	bp->pkt_rate_low = ec->pkt_rate_low;
+	bp->pkt_rate_high = ec->pkt_rate_high;
+
+	/* Adaptive moderation starts over from the fixed setting */
+	bp->rx_coalesce_cur = bp->rx_coalesce_usecs;
+	bp->rx_rate_pkts = 0;
+	bp->rx_rate_stamp = jiffies;
+	bp->rx_coalesce_adaptive = ec->use_adaptive_rx_coalesce;
+
+	if (netif_running(netdev))
+		gem_write_imod(bp, bp->rx_coalesce_cur);
+
+	return 0;
+}
+
 #ifdef CONFIG_MACB_USE_HWSTAMP
 static unsigned int gem_get_tsu_rate(struct macb *bp)
 {
@@ -2627,6 +3106,8 @@ static const struct ethtool_ops gem_ethtool_ops = {
 	.set_link_ksettings     = phy_ethtool_set_link_ksettings,
 	.get_ringparam		= macb_get_ringparam,
 	.set_ringparam		= macb_set_ringparam,
+	.get_coalesce		= gem_get_coalesce,
+	.set_coalesce		= gem_set_coalesce,
 };
 
 static int macb_ioctl(struct net_device *dev, struct ifreq *rq, int cmd)
@@ -2702,6 +3183,9 @@ static const struct net_device_ops macb_netdev_ops = {
 #endif
 	.ndo_set_features	= macb_set_features,
 	.ndo_features_check	= macb_features_check,
+	.ndo_xdp		= macb_xdp,
+	.ndo_xdp_xmit		= macb_xdp_xmit,
+	.ndo_xdp_flush		= macb_xdp_flush,
 };
 
 /* Configure peripheral capabilities according to device tree
@@ -2842,6 +3326,24 @@ static int macb_clk_init(struct platform_device *pdev, struct clk **pclk,
 	return err;
 }
 
+/* Not every GEM revision has the moderation register: try to set it */
+static void gem_probe_imod(struct macb *bp)
+{
+	u32 val;
+
+	gem_writel(bp, IMOD, GEM_BF(RXMOD, 1));
+	val = gem_readl(bp, IMOD);
+	gem_writel(bp, IMOD, 0);
+	if (val != GEM_BF(RXMOD, 1))
+		return;
+
+	bp->caps |= MACB_CAPS_INT_MODERATION;
+	bp->rx_coalesce_usecs_low = MACB_AIM_USECS_LOW;
+	bp->rx_coalesce_usecs_high = MACB_AIM_USECS_HIGH;
+	bp->pkt_rate_low = MACB_AIM_RATE_LOW;
+	bp->pkt_rate_high = MACB_AIM_RATE_HIGH;
+}
+
 static int macb_init(struct platform_device *pdev)
 {
 	struct net_device *dev = platform_get_drvdata(pdev);
@@ -2892,6 +3394,14 @@ static int macb_init(struct platform_device *pdev)
 		 * must remove the optional gaps that could exist in the
 		 * hardware queue mask.
 		 */
+		/* Only queue 0 receives: the other NAPI contexts reclaim TX
+		 * and have nothing for a busy polling socket.
+		 */
+		if (q == 0)
+			netif_napi_add(dev, &queue->napi, macb_poll, 64);
+		else
+			netif_tx_napi_add(dev, &queue->napi, macb_poll, 64);
+
 		queue->irq = platform_get_irq(pdev, q);
 		err = devm_request_irq(&pdev->dev, queue->irq, macb_interrupt,
 				       IRQF_SHARED, dev->name, queue);
@@ -2907,7 +3417,6 @@ static int macb_init(struct platform_device *pdev)
 	}
 
 	dev->netdev_ops = &macb_netdev_ops;
-	netif_napi_add(dev, &bp->napi, macb_poll, 64);
 
 	/* setup appropriated routines according to adapter type */
 	if (macb_is_gem(bp)) {
@@ -2917,6 +3426,7 @@ static int macb_init(struct platform_device *pdev)
 		bp->macbgem_ops.mog_init_rings = gem_init_rings;
 		bp->macbgem_ops.mog_rx = gem_rx;
 		dev->ethtool_ops = &gem_ethtool_ops;
+		gem_probe_imod(bp);
 	} else {
 		bp->max_tx_length = MACB_MAX_TX_LEN;
 		bp->macbgem_ops.mog_alloc_rx_buffers = macb_alloc_rx_buffers;
@@ -3573,6 +4083,7 @@ static int macb_probe(struct platform_device *pdev)
 static int macb_remove(struct platform_device *pdev)
 {
 	struct net_device *dev;
+	struct bpf_prog *prog;
 	struct macb *bp;
 
 	dev = platform_get_drvdata(pdev);
@@ -3590,6 +4101,12 @@ static int macb_remove(struct platform_device *pdev)
 			gpiod_set_value(bp->reset_gpio, 0);
 
 		unregister_netdev(dev);
+
+		/* Unregistered: the program can't run any more */
+		prog = rcu_dereference_protected(bp->xdp_prog, 1);
+		if (prog)
+			bpf_prog_put(prog);
+
 		clk_disable_unprepare(bp->tx_clk);
 		clk_disable_unprepare(bp->hclk);
 		clk_disable_unprepare(bp->pclk);
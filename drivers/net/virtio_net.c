@@ -48,6 +48,13 @@ module_param(napi_tx, bool, 0644);
 /* Amount of XDP headroom to prepend to packets for use by xdp_adjust_head */
 #define VIRTIO_XDP_HEADROOM 256
 
+/* Room left after each mergeable buffer for build_skb()'s shared info */
+#define VIRTNET_MRG_TAILROOM SKB_DATA_ALIGN(sizeof(struct skb_shared_info))
+
+/* Frag pages a receive queue keeps around for reuse, and their order */
+#define VIRTNET_POOL_SIZE 32
+#define VIRTNET_FRAG_ORDER get_order(32768)
+
 /* RX packet size EWMA. The average packet size is used to determine the packet
  * buffer size when refilling RX rings. As the entire RX ring may be refilled
  * at once, the weight is chosen so that the EWMA will be insensitive to short-
@@ -106,6 +113,11 @@ struct receive_queue {
 	/* Page frag for packet buffer allocation. */
 	struct page_frag alloc_frag;
 
+	/* Filled frag pages, oldest first, waiting for their buffers back */
+	struct page *pool[VIRTNET_POOL_SIZE];
+	unsigned int pool_head;
+	unsigned int pool_count;
+
 	/* RX: fragments + linear part + virtio header */
 	struct scatterlist sg[MAX_SKB_FRAGS + 2];
 
@@ -260,9 +272,15 @@ static void virtqueue_napi_complete(struct napi_struct *napi,
 	int opaque;
 
 	opaque = virtqueue_enable_cb_prepare(vq);
-	if (napi_complete_done(napi, processed) &&
-	    unlikely(virtqueue_poll(vq, opaque)))
-		virtqueue_napi_schedule(napi, vq);
+	if (napi_complete_done(napi, processed)) {
+		if (unlikely(virtqueue_poll(vq, opaque)))
+			virtqueue_napi_schedule(napi, vq);
+	} else {
+		/* Busy polling: the busy poller will call us again, and
+		 * interrupting it for every packet only adds latency.
+		 */
+		virtqueue_disable_cb(vq);
+	}
 }
 
 static void skb_xmit_done(struct virtqueue *vq)
@@ -297,6 +315,29 @@ static unsigned int mergeable_ctx_to_truesize(void *mrg_ctx)
 	return (unsigned long)mrg_ctx & ((1 << MRG_CTX_HEADER_SHIFT) - 1);
 }
 
+/* Build the head skb around the buffer itself rather than copying it */
+static struct sk_buff *mergeable_buf_to_skb(struct virtnet_info *vi,
+					    struct page *page, void *buf,
+					    unsigned int offset,
+					    unsigned int len,
+					    unsigned int truesize,
+					    unsigned int headroom)
+{
+	char *start = (char *)buf - headroom;
+	char *p = page_address(page) + offset;
+	struct sk_buff *skb;
+
+	skb = build_skb(start, headroom + truesize + VIRTNET_MRG_TAILROOM);
+	if (unlikely(!skb))
+		return NULL;
+
+	/* XDP may have moved the header, but not out of the buffer */
+	skb_reserve(skb, p + vi->hdr_len - start);
+	skb_put(skb, len - vi->hdr_len);
+	memcpy(skb_vnet_hdr(skb), p, vi->hdr_len);
+	return skb;
+}
+
 /* Called from bottom half context */
 static struct sk_buff *page_to_skb(struct virtnet_info *vi,
 				   struct receive_queue *rq,
@@ -665,6 +706,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			 */
 			offset = xdp.data -
 					page_address(xdp_page) - vi->hdr_len;
+			len = xdp.data_end - xdp.data + vi->hdr_len;
 
 			/* We can only create skb based on xdp_page. */
 			if (unlikely(xdp_page != page)) {
@@ -705,7 +747,8 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 		goto err_skb;
 	}
 
-	head_skb = page_to_skb(vi, rq, page, offset, len, truesize);
+	head_skb = mergeable_buf_to_skb(vi, page, buf, offset, len, truesize,
+					headroom);
 	curr_skb = head_skb;
 
 	if (unlikely(!curr_skb))
@@ -838,6 +881,7 @@ static int receive_buf(struct virtnet_info *vi, struct receive_queue *rq,
 	pr_debug("Receiving skb proto 0x%04x len %i type %i\n",
 		 ntohs(skb->protocol), skb->len, skb->pkt_type);
 
+	skb_record_rx_queue(skb, vq2rxq(rq->vq));
 	napi_gro_receive(&rq->napi, skb);
 	return ret;
 
@@ -847,6 +891,93 @@ static int receive_buf(struct virtnet_info *vi, struct receive_queue *rq,
 	return 0;
 }
 
+/*
+ * Filled frag pages are parked in the pool rather than released.  XDP_DROP,
+ * XDP_TX completion and the stack freeing skbs all drop the buffers' page
+ * references, and once only the pool's is left the page can be carved up
+ * again without going back to the page allocator.  Pages are handed out
+ * oldest first: if that one is still busy, the newer ones will be too.
+ */
+static struct page *virtnet_pool_get(struct receive_queue *rq)
+{
+	struct page *page;
+
+	if (!rq->pool_count)
+		return NULL;
+
+	page = rq->pool[rq->pool_head];
+	if (page_ref_count(page) != 1)
+		return NULL;
+
+	rq->pool_head = (rq->pool_head + 1) % VIRTNET_POOL_SIZE;
+	rq->pool_count--;
+	return page;
+}
+
+static void virtnet_pool_put(struct receive_queue *rq, struct page *page)
+{
+	unsigned int tail;
+
+	/* Emergency reserves go back as soon as they are done with */
+	if (page_is_pfmemalloc(page)) {
+		put_page(page);
+		return;
+	}
+
+	/* Full: the oldest goes back to the allocator once it is free */
+	if (rq->pool_count == VIRTNET_POOL_SIZE) {
+		put_page(rq->pool[rq->pool_head]);
+		rq->pool_head = (rq->pool_head + 1) % VIRTNET_POOL_SIZE;
+		rq->pool_count--;
+	}
+
+	tail = (rq->pool_head + rq->pool_count) % VIRTNET_POOL_SIZE;
+	rq->pool[tail] = page;
+	rq->pool_count++;
+}
+
+/* skb_page_frag_refill(), with a page from the pool before a new one */
+static bool virtnet_frag_refill(struct receive_queue *rq, unsigned int sz,
+				gfp_t gfp)
+{
+	struct page_frag *pfrag = &rq->alloc_frag;
+
+	if (pfrag->page) {
+		if (page_ref_count(pfrag->page) == 1) {
+			pfrag->offset = 0;
+			return true;
+		}
+		if (pfrag->offset + sz <= pfrag->size)
+			return true;
+		virtnet_pool_put(rq, pfrag->page);
+	}
+
+	pfrag->offset = 0;
+	pfrag->page = virtnet_pool_get(rq);
+	if (pfrag->page) {
+		pfrag->size = PAGE_SIZE << compound_order(pfrag->page);
+		return true;
+	}
+
+	if (VIRTNET_FRAG_ORDER) {
+		/* Avoid direct reclaim but allow kswapd to wake */
+		pfrag->page = alloc_pages((gfp & ~__GFP_DIRECT_RECLAIM) |
+					  __GFP_COMP | __GFP_NOWARN |
+					  __GFP_NORETRY,
+					  VIRTNET_FRAG_ORDER);
+		if (likely(pfrag->page)) {
+			pfrag->size = PAGE_SIZE << VIRTNET_FRAG_ORDER;
+			return true;
+		}
+	}
+	pfrag->page = alloc_page(gfp);
+	if (likely(pfrag->page)) {
+		pfrag->size = PAGE_SIZE;
+		return true;
+	}
+	return false;
+}
+
 /* Unlike mergeable buffers, all buffers are allocated to the
  * same size, except for the headroom. For this reason we do
  * not need to use  mergeable_len_to_ctx here - it is enough
@@ -864,7 +995,7 @@ static int add_recvbuf_small(struct virtnet_info *vi, struct receive_queue *rq,
 
 	len = SKB_DATA_ALIGN(len) +
 	      SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
-	if (unlikely(!skb_page_frag_refill(len, alloc_frag, gfp)))
+	if (unlikely(!virtnet_frag_refill(rq, len, gfp)))
 		return -ENOMEM;
 
 	buf = (char *)page_address(alloc_frag->page) + alloc_frag->offset;
@@ -934,7 +1065,8 @@ static unsigned int get_mergeable_buf_len(struct receive_queue *rq,
 	unsigned int len;
 
 	len = hdr_len + clamp_t(unsigned int, ewma_pkt_len_read(avg_pkt_len),
-				rq->min_buf_len, PAGE_SIZE - hdr_len);
+				rq->min_buf_len,
+				PAGE_SIZE - hdr_len - VIRTNET_MRG_TAILROOM);
 	return ALIGN(len, L1_CACHE_BYTES);
 }
 
@@ -943,21 +1075,22 @@ static int add_recvbuf_mergeable(struct virtnet_info *vi,
 {
 	struct page_frag *alloc_frag = &rq->alloc_frag;
 	unsigned int headroom = virtnet_get_headroom(vi);
+	unsigned int room = headroom + VIRTNET_MRG_TAILROOM;
 	char *buf;
 	void *ctx;
 	int err;
 	unsigned int len, hole;
 
 	len = get_mergeable_buf_len(rq, &rq->mrg_avg_pkt_len);
-	if (unlikely(!skb_page_frag_refill(len + headroom, alloc_frag, gfp)))
+	if (unlikely(!virtnet_frag_refill(rq, len + room, gfp)))
 		return -ENOMEM;
 
 	buf = (char *)page_address(alloc_frag->page) + alloc_frag->offset;
 	buf += headroom; /* advance address leaving hole at front of pkt */
 	get_page(alloc_frag->page);
-	alloc_frag->offset += len + headroom;
+	alloc_frag->offset += len + room;
 	hole = alloc_frag->size - alloc_frag->offset;
-	if (hole < len + headroom) {
+	if (hole < len + room) {
 		/* To avoid internal fragmentation, if there is very likely not
 		 * enough space for another buffer, add the remaining space to
 		 * the current buffer.
@@ -1317,8 +1450,7 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 		}
 	}
 
-	if (kick || netif_xmit_stopped(txq))
-		virtqueue_kick(sq->vq);
+	virtqueue_kick_batch(sq->vq, !kick && !netif_xmit_stopped(txq));
 
 	return NETDEV_TX_OK;
 }
@@ -2157,9 +2289,17 @@ static void free_receive_bufs(struct virtnet_info *vi)
 static void free_receive_page_frags(struct virtnet_info *vi)
 {
 	int i;
-	for (i = 0; i < vi->max_queue_pairs; i++)
-		if (vi->rq[i].alloc_frag.page)
-			put_page(vi->rq[i].alloc_frag.page);
+	for (i = 0; i < vi->max_queue_pairs; i++) {
+		struct receive_queue *rq = &vi->rq[i];
+
+		if (rq->alloc_frag.page)
+			put_page(rq->alloc_frag.page);
+		while (rq->pool_count) {
+			put_page(rq->pool[rq->pool_head]);
+			rq->pool_head = (rq->pool_head + 1) % VIRTNET_POOL_SIZE;
+			rq->pool_count--;
+		}
+	}
 }
 
 static bool is_xdp_raw_buffer_queue(struct virtnet_info *vi, int q)
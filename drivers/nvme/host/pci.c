@@ -15,6 +15,7 @@
 #include <linux/aer.h>
 #include <linux/bitops.h>
 #include <linux/blkdev.h>
+#include <linux/debugfs.h>
 #include <linux/blk-mq.h>
 #include <linux/blk-mq-pci.h>
 #include <linux/dmi.h>
@@ -27,6 +28,7 @@
 #include <linux/once.h>
 #include <linux/pci.h>
 #include <linux/poison.h>
+#include <linux/seq_file.h>
 #include <linux/t10-pi.h>
 #include <linux/timer.h>
 #include <linux/types.h>
@@ -67,12 +69,30 @@ static int io_queue_depth = 1024;
 module_param_cb(io_queue_depth, &io_queue_depth_ops, &io_queue_depth, 0644);
 MODULE_PARM_DESC(io_queue_depth, "set io queue depth, should >= 2");
 
+static unsigned int poll_queues;
+module_param(poll_queues, uint, 0644);
+MODULE_PARM_DESC(poll_queues,
+	"Number of interrupt-less queues for polled IO, applied on reset");
+
 struct nvme_dev;
 struct nvme_queue;
 
-static void nvme_process_cq(struct nvme_queue *nvmeq);
+static int nvme_process_cq(struct nvme_queue *nvmeq);
 static void nvme_dev_disable(struct nvme_dev *dev, bool shutdown);
 
+static struct dentry *nvme_debugfs_root;
+
+/*
+ * Submission and completion counters of a queue, updated under its q_lock.
+ * They live in the nvme_dev so that they outlast the queues across resets.
+ */
+struct nvme_queue_stats {
+	u64 cmds;		/* commands copied into the SQ */
+	u64 sq_db_writes;	/* MMIO writes of the SQ tail doorbell */
+	u64 irqs;
+	u64 irq_cqes;		/* completions reaped from interrupts */
+};
+
 /*
  * Represents an NVM Express device.  Each nvme_dev is a PCI function.
  */
@@ -86,6 +106,7 @@ struct nvme_dev {
 	struct dma_pool *prp_small_pool;
 	unsigned online_queues;
 	unsigned max_qid;
+	unsigned nr_poll_queues;	/* the last of the I/O queues */
 	int q_depth;
 	u32 db_stride;
 	void __iomem *bar;
@@ -113,6 +134,9 @@ struct nvme_dev {
 	dma_addr_t host_mem_descs_dma;
 	struct nvme_host_mem_buf_desc *host_mem_descs;
 	void **host_mem_desc_bufs;
+
+	struct nvme_queue_stats *qstats;
+	struct dentry *debugfs_dir;
 };
 
 static int io_queue_depth_set(const char *val, const struct kernel_param *kp)
@@ -159,14 +183,17 @@ struct nvme_queue {
 	u16 q_depth;
 	s16 cq_vector;
 	u16 sq_tail;
+	u16 last_sq_tail;	/* sq_tail as of the last doorbell update */
 	u16 cq_head;
 	u16 qid;
 	u8 cq_phase;
 	u8 cqe_seen;
+	u8 polled;		/* created without an interrupt */
 	u32 *dbbuf_sq_db;
 	u32 *dbbuf_cq_db;
 	u32 *dbbuf_sq_ei;
 	u32 *dbbuf_cq_ei;
+	struct nvme_queue_stats *stats;
 };
 
 /*
@@ -178,6 +205,7 @@ struct nvme_queue {
 struct nvme_iod {
 	struct nvme_request req;
 	struct nvme_queue *nvmeq;
+	struct nvme_command cmd;	/* kept for nvme_queue_rqs() */
 	int aborted;
 	int npages;		/* In the PRP list. 0 means small pool in use */
 	int nents;		/* Used in scatterlist */
@@ -400,15 +428,7 @@ static int nvme_pci_map_queues(struct blk_mq_tag_set *set)
 	return blk_mq_pci_map_queues(set, to_pci_dev(dev->dev));
 }
 
-/**
- * __nvme_submit_cmd() - Copy a command into a queue and ring the doorbell
- * @nvmeq: The queue to use
- * @cmd: The command to send
- *
- * Safe to use from interrupt context
- */
-static void __nvme_submit_cmd(struct nvme_queue *nvmeq,
-						struct nvme_command *cmd)
+static void nvme_copy_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
 	u16 tail = nvmeq->sq_tail;
 
@@ -419,10 +439,39 @@ static void __nvme_submit_cmd(struct nvme_queue *nvmeq,
 
 	if (++tail == nvmeq->q_depth)
 		tail = 0;
-	if (nvme_dbbuf_update_and_check_event(tail, nvmeq->dbbuf_sq_db,
-					      nvmeq->dbbuf_sq_ei))
-		writel(tail, nvmeq->q_db);
 	nvmeq->sq_tail = tail;
+	nvmeq->stats->cmds++;
+}
+
+/*
+ * Tell the controller about the commands copied in since the last call.
+ * With a shadow doorbell buffer the MMIO write is skipped unless the
+ * controller asked for it through the event index.
+ */
+static void nvme_write_sq_db(struct nvme_queue *nvmeq)
+{
+	if (nvmeq->sq_tail == nvmeq->last_sq_tail)
+		return;
+	if (nvme_dbbuf_update_and_check_event(nvmeq->sq_tail,
+			nvmeq->dbbuf_sq_db, nvmeq->dbbuf_sq_ei)) {
+		writel(nvmeq->sq_tail, nvmeq->q_db);
+		nvmeq->stats->sq_db_writes++;
+	}
+	nvmeq->last_sq_tail = nvmeq->sq_tail;
+}
+
+/**
+ * __nvme_submit_cmd() - Copy a command into a queue and ring the doorbell
+ * @nvmeq: The queue to use
+ * @cmd: The command to send
+ *
+ * Safe to use from interrupt context
+ */
+static void __nvme_submit_cmd(struct nvme_queue *nvmeq,
+						struct nvme_command *cmd)
+{
+	nvme_copy_cmd(nvmeq, cmd);
+	nvme_write_sq_db(nvmeq);
 }
 
 static __le64 **iod_list(struct request *req)
@@ -714,19 +763,16 @@ static void nvme_unmap_data(struct nvme_dev *dev, struct request *req)
 }
 
 /*
- * NOTE: ns is NULL when called on the admin queue.
+ * Set up the command for @req in its iod and start the request.  Nothing
+ * is left to undo if this fails.
  */
-static blk_status_t nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
-			 const struct blk_mq_queue_data *bd)
+static blk_status_t nvme_prep_rq(struct nvme_dev *dev, struct nvme_ns *ns,
+				 struct request *req)
 {
-	struct nvme_ns *ns = hctx->queue->queuedata;
-	struct nvme_queue *nvmeq = hctx->driver_data;
-	struct nvme_dev *dev = nvmeq->dev;
-	struct request *req = bd->rq;
-	struct nvme_command cmnd;
+	struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
 	blk_status_t ret;
 
-	ret = nvme_setup_cmd(ns, req, &cmnd);
+	ret = nvme_setup_cmd(ns, req, &iod->cmd);
 	if (ret)
 		return ret;
 
@@ -735,28 +781,113 @@ static blk_status_t nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
 		goto out_free_cmd;
 
 	if (blk_rq_nr_phys_segments(req)) {
-		ret = nvme_map_data(dev, req, &cmnd);
+		ret = nvme_map_data(dev, req, &iod->cmd);
 		if (ret)
 			goto out_cleanup_iod;
 	}
 
 	blk_mq_start_request(req);
+	return BLK_STS_OK;
+out_cleanup_iod:
+	nvme_free_iod(dev, req);
+out_free_cmd:
+	nvme_cleanup_cmd(req);
+	return ret;
+}
+
+static void nvme_unprep_rq(struct nvme_dev *dev, struct request *req)
+{
+	nvme_free_iod(dev, req);
+	nvme_cleanup_cmd(req);
+}
+
+/*
+ * NOTE: ns is NULL when called on the admin queue.
+ */
+static blk_status_t nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
+			 const struct blk_mq_queue_data *bd)
+{
+	struct nvme_ns *ns = hctx->queue->queuedata;
+	struct nvme_queue *nvmeq = hctx->driver_data;
+	struct nvme_dev *dev = nvmeq->dev;
+	struct request *req = bd->rq;
+	struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
+	blk_status_t ret;
+
+	ret = nvme_prep_rq(dev, ns, req);
+	if (ret)
+		return ret;
 
 	spin_lock_irq(&nvmeq->q_lock);
 	if (unlikely(nvmeq->cq_vector < 0)) {
-		ret = BLK_STS_IOERR;
 		spin_unlock_irq(&nvmeq->q_lock);
-		goto out_cleanup_iod;
+		nvme_unprep_rq(dev, req);
+		return BLK_STS_IOERR;
 	}
-	__nvme_submit_cmd(nvmeq, &cmnd);
+	/*
+	 * Unless this is the last request of a batch the doorbell waits for
+	 * the next one, or for ->commit_rqs if the batch is cut short.
+	 */
+	nvme_copy_cmd(nvmeq, &iod->cmd);
+	if (bd->last)
+		nvme_write_sq_db(nvmeq);
 	nvme_process_cq(nvmeq);
 	spin_unlock_irq(&nvmeq->q_lock);
 	return BLK_STS_OK;
-out_cleanup_iod:
-	nvme_free_iod(dev, req);
-out_free_cmd:
-	nvme_cleanup_cmd(req);
-	return ret;
+}
+
+static void nvme_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	struct nvme_queue *nvmeq = hctx->driver_data;
+
+	spin_lock_irq(&nvmeq->q_lock);
+	nvme_write_sq_db(nvmeq);
+	spin_unlock_irq(&nvmeq->q_lock);
+}
+
+/*
+ * Batched submission of the requests of a plug: all the commands are
+ * prepared first, then copied into the SQ under a single hold of the
+ * queue lock and announced with a single doorbell write.  A request
+ * that fails to prepare and those after it are left on @list, for the
+ * core to send down ->queue_rq.
+ */
+static void nvme_queue_rqs(struct blk_mq_hw_ctx *hctx, struct list_head *list)
+{
+	struct nvme_ns *ns = hctx->queue->queuedata;
+	struct nvme_queue *nvmeq = hctx->driver_data;
+	struct nvme_dev *dev = nvmeq->dev;
+	struct request *req, *next;
+	LIST_HEAD(submit);
+
+	list_for_each_entry_safe(req, next, list, queuelist) {
+		if (nvme_prep_rq(dev, ns, req) != BLK_STS_OK)
+			break;
+		list_move_tail(&req->queuelist, &submit);
+	}
+
+	if (list_empty(&submit))
+		return;
+
+	spin_lock_irq(&nvmeq->q_lock);
+	if (unlikely(nvmeq->cq_vector < 0)) {
+		spin_unlock_irq(&nvmeq->q_lock);
+		list_for_each_entry_safe(req, next, &submit, queuelist) {
+			list_del_init(&req->queuelist);
+			nvme_unprep_rq(dev, req);
+			blk_mq_end_request(req, BLK_STS_IOERR);
+		}
+		return;
+	}
+	list_for_each_entry_safe(req, next, &submit, queuelist) {
+		struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
+
+		list_del_init(&req->queuelist);
+		nvme_copy_cmd(nvmeq, &iod->cmd);
+	}
+	nvme_write_sq_db(nvmeq);
+	nvme_process_cq(nvmeq);
+	spin_unlock_irq(&nvmeq->q_lock);
 }
 
 static void nvme_pci_complete_rq(struct request *req)
@@ -830,7 +961,7 @@ static inline bool nvme_read_cqe(struct nvme_queue *nvmeq,
 	return false;
 }
 
-static void nvme_process_cq(struct nvme_queue *nvmeq)
+static int nvme_process_cq(struct nvme_queue *nvmeq)
 {
 	struct nvme_completion cqe;
 	int consumed = 0;
@@ -842,6 +973,7 @@ static void nvme_process_cq(struct nvme_queue *nvmeq)
 
 	if (consumed)
 		nvme_ring_cq_doorbell(nvmeq);
+	return consumed;
 }
 
 static irqreturn_t nvme_irq(int irq, void *data)
@@ -849,7 +981,8 @@ static irqreturn_t nvme_irq(int irq, void *data)
 	irqreturn_t result;
 	struct nvme_queue *nvmeq = data;
 	spin_lock(&nvmeq->q_lock);
-	nvme_process_cq(nvmeq);
+	nvmeq->stats->irqs++;
+	nvmeq->stats->irq_cqes += nvme_process_cq(nvmeq);
 	result = nvmeq->cqe_seen ? IRQ_HANDLED : IRQ_NONE;
 	nvmeq->cqe_seen = 0;
 	spin_unlock(&nvmeq->q_lock);
@@ -927,7 +1060,10 @@ static int adapter_alloc_cq(struct nvme_dev *dev, u16 qid,
 						struct nvme_queue *nvmeq)
 {
 	struct nvme_command c;
-	int flags = NVME_QUEUE_PHYS_CONTIG | NVME_CQ_IRQ_ENABLED;
+	int flags = NVME_QUEUE_PHYS_CONTIG;
+
+	if (!nvmeq->polled)
+		flags |= NVME_CQ_IRQ_ENABLED;
 
 	/*
 	 * Note: we (ab)use the fact the the prp fields survive if no data
@@ -1172,7 +1308,8 @@ static int nvme_suspend_queue(struct nvme_queue *nvmeq)
 	if (!nvmeq->qid && nvmeq->dev->ctrl.admin_q)
 		blk_mq_quiesce_queue(nvmeq->dev->ctrl.admin_q);
 
-	pci_free_irq(to_pci_dev(nvmeq->dev->dev), vector, nvmeq);
+	if (!nvmeq->polled)
+		pci_free_irq(to_pci_dev(nvmeq->dev->dev), vector, nvmeq);
 
 	return 0;
 }
@@ -1263,6 +1400,7 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev, int qid,
 	nvmeq->q_depth = depth;
 	nvmeq->qid = qid;
 	nvmeq->cq_vector = -1;
+	nvmeq->stats = &dev->qstats[qid];
 	dev->queues[qid] = nvmeq;
 	dev->ctrl.queue_count++;
 
@@ -1290,12 +1428,22 @@ static int queue_request_irq(struct nvme_queue *nvmeq)
 	}
 }
 
+/*
+ * Poll queues come after the queues that have an interrupt each, and the
+ * interrupt vectors only cover the latter.
+ */
+static bool nvme_qid_polled(struct nvme_dev *dev, unsigned int qid)
+{
+	return qid > dev->max_qid - dev->nr_poll_queues;
+}
+
 static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 {
 	struct nvme_dev *dev = nvmeq->dev;
 
 	spin_lock_irq(&nvmeq->q_lock);
 	nvmeq->sq_tail = 0;
+	nvmeq->last_sq_tail = 0;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
@@ -1310,7 +1458,12 @@ static int nvme_create_queue(struct nvme_queue *nvmeq, int qid)
 	struct nvme_dev *dev = nvmeq->dev;
 	int result;
 
-	nvmeq->cq_vector = qid - 1;
+	/*
+	 * A polled queue has no vector, but cq_vector >= 0 is what marks
+	 * a queue live.
+	 */
+	nvmeq->polled = nvme_qid_polled(dev, qid);
+	nvmeq->cq_vector = nvmeq->polled ? 0 : qid - 1;
 	result = adapter_alloc_cq(dev, qid, nvmeq);
 	if (result < 0)
 		return result;
@@ -1320,6 +1473,9 @@ static int nvme_create_queue(struct nvme_queue *nvmeq, int qid)
 		goto release_cq;
 
 	nvme_init_queue(nvmeq, qid);
+	if (nvmeq->polled)
+		return 0;
+
 	result = queue_request_irq(nvmeq);
 	if (result < 0)
 		goto release_sq;
@@ -1335,6 +1491,7 @@ static int nvme_create_queue(struct nvme_queue *nvmeq, int qid)
 
 static const struct blk_mq_ops nvme_mq_admin_ops = {
 	.queue_rq	= nvme_queue_rq,
+	.commit_rqs	= nvme_commit_rqs,
 	.complete	= nvme_pci_complete_rq,
 	.init_hctx	= nvme_admin_init_hctx,
 	.exit_hctx      = nvme_admin_exit_hctx,
@@ -1344,6 +1501,8 @@ static const struct blk_mq_ops nvme_mq_admin_ops = {
 
 static const struct blk_mq_ops nvme_mq_ops = {
 	.queue_rq	= nvme_queue_rq,
+	.queue_rqs	= nvme_queue_rqs,
+	.commit_rqs	= nvme_commit_rqs,
 	.complete	= nvme_pci_complete_rq,
 	.init_hctx	= nvme_init_hctx,
 	.init_request	= nvme_init_request,
@@ -1487,8 +1646,10 @@ static int nvme_create_io_queues(struct nvme_dev *dev)
 
 	for (i = dev->ctrl.queue_count; i <= dev->max_qid; i++) {
 		/* vector == qid - 1, match nvme_create_queue */
-		if (!nvme_alloc_queue(dev, i, dev->q_depth,
-		     pci_irq_get_node(to_pci_dev(dev->dev), i - 1))) {
+		int node = nvme_qid_polled(dev, i) ? dev_to_node(dev->dev) :
+			pci_irq_get_node(to_pci_dev(dev->dev), i - 1);
+
+		if (!nvme_alloc_queue(dev, i, dev->q_depth, node)) {
 			ret = -ENOMEM;
 			break;
 		}
@@ -1754,9 +1915,17 @@ static int nvme_setup_io_queues(struct nvme_dev *dev)
 	struct nvme_queue *adminq = dev->queues[0];
 	struct pci_dev *pdev = to_pci_dev(dev->dev);
 	int result, nr_io_queues;
+	unsigned int nr_poll;
 	unsigned long size;
 
-	nr_io_queues = num_present_cpus();
+	/*
+	 * Poll queues are asked for on top of one queue per CPU, but
+	 * dev->queues and blk-mq have room for no more than a queue per
+	 * possible CPU.
+	 */
+	nr_poll = min_t(unsigned int, poll_queues, num_possible_cpus());
+	nr_io_queues = min_t(unsigned int, num_present_cpus() + nr_poll,
+			     num_possible_cpus());
 	result = nvme_set_queue_count(&dev->ctrl, &nr_io_queues);
 	if (result < 0)
 		return result;
@@ -1791,17 +1960,24 @@ static int nvme_setup_io_queues(struct nvme_dev *dev)
 	 * setting up the full range we need.
 	 */
 	pci_free_irq_vectors(pdev);
-	nr_io_queues = pci_alloc_irq_vectors(pdev, 1, nr_io_queues,
+
+	/*
+	 * Poll queues need no vector, and at least one queue has to take
+	 * interrupts for everything that isn't polled.
+	 */
+	nr_poll = min_t(unsigned int, nr_poll, nr_io_queues - 1);
+	nr_io_queues = pci_alloc_irq_vectors(pdev, 1, nr_io_queues - nr_poll,
 			PCI_IRQ_ALL_TYPES | PCI_IRQ_AFFINITY);
 	if (nr_io_queues <= 0)
 		return -EIO;
-	dev->max_qid = nr_io_queues;
+	dev->nr_poll_queues = nr_poll;
+	dev->max_qid = nr_io_queues + nr_poll;
 
 	/*
 	 * Should investigate if there's a performance win from allocating
-	 * more queues than interrupt vectors; it might allow the submission
-	 * path to scale better, even if the receive path is limited by the
-	 * number of interrupts.
+	 * more interrupt queues than interrupt vectors; it might allow the
+	 * submission path to scale better, even if the receive path is
+	 * limited by the number of interrupts.
 	 */
 
 	result = queue_request_irq(adminq);
@@ -1899,6 +2075,12 @@ static void nvme_disable_io_queues(struct nvme_dev *dev, int queues)
  */
 static int nvme_dev_add(struct nvme_dev *dev)
 {
+	unsigned int nr_irq_queues = dev->max_qid - dev->nr_poll_queues;
+
+	/* Queues are created in order, the polled ones may be cut short */
+	dev->tagset.nr_poll_queues = dev->online_queues - 1 > nr_irq_queues ?
+			dev->online_queues - 1 - nr_irq_queues : 0;
+
 	if (!dev->ctrl.tagset) {
 		dev->tagset.ops = &nvme_mq_ops;
 		dev->tagset.nr_hw_queues = dev->online_queues - 1;
@@ -2124,6 +2306,7 @@ static void nvme_pci_free_ctrl(struct nvme_ctrl *ctrl)
 	if (dev->ctrl.admin_q)
 		blk_put_queue(dev->ctrl.admin_q);
 	kfree(dev->queues);
+	kfree(dev->qstats);
 	free_opal_dev(dev->ctrl.opal_dev);
 	kfree(dev);
 }
@@ -2302,6 +2485,51 @@ static unsigned long check_dell_samsung_bug(struct pci_dev *pdev)
 	return 0;
 }
 
+static void nvme_print_ratio(struct seq_file *m, u64 n, u64 d)
+{
+	u64 r = d ? div64_u64(n * 100, d) : 0;
+
+	seq_printf(m, " %6llu.%02llu", div_u64(r, 100), r % 100);
+}
+
+static int nvme_queue_stats_show(struct seq_file *m, void *v)
+{
+	struct nvme_dev *dev = m->private;
+	int i;
+
+	seq_puts(m, "qid         cmds   sq_db_writes  cmds/db"
+		    "         irqs     irq_cqes cqes/irq\n");
+	for (i = 0; i <= num_possible_cpus(); i++) {
+		struct nvme_queue_stats *s = &dev->qstats[i];
+		u64 cmds = READ_ONCE(s->cmds);
+		u64 dbs = READ_ONCE(s->sq_db_writes);
+		u64 irqs = READ_ONCE(s->irqs);
+		u64 cqes = READ_ONCE(s->irq_cqes);
+
+		if (!cmds && !irqs)
+			continue;
+		seq_printf(m, "%3d %12llu %14llu", i, cmds, dbs);
+		nvme_print_ratio(m, cmds, dbs);
+		seq_printf(m, " %12llu %12llu", irqs, cqes);
+		nvme_print_ratio(m, cqes, irqs);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static int nvme_queue_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvme_queue_stats_show, inode->i_private);
+}
+
+static const struct file_operations nvme_queue_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= nvme_queue_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 {
 	int node, result = -ENOMEM;
@@ -2319,6 +2547,10 @@ static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 							GFP_KERNEL, node);
 	if (!dev->queues)
 		goto free;
+	dev->qstats = kcalloc_node(num_possible_cpus() + 1,
+				   sizeof(*dev->qstats), GFP_KERNEL, node);
+	if (!dev->qstats)
+		goto free;
 
 	dev->dev = get_device(&pdev->dev);
 	pci_set_drvdata(pdev, dev);
@@ -2346,6 +2578,11 @@ static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	nvme_change_ctrl_state(&dev->ctrl, NVME_CTRL_RESETTING);
 	dev_info(dev->ctrl.device, "pci function %s\n", dev_name(&pdev->dev));
 
+	dev->debugfs_dir = debugfs_create_dir(dev_name(&pdev->dev),
+					      nvme_debugfs_root);
+	debugfs_create_file("queue_stats", 0400, dev->debugfs_dir, dev,
+			    &nvme_queue_stats_fops);
+
 	queue_work(nvme_wq, &dev->ctrl.reset_work);
 	return 0;
 
@@ -2356,6 +2593,7 @@ static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
  put_pci:
 	put_device(dev->dev);
  free:
+	kfree(dev->qstats);
 	kfree(dev->queues);
 	kfree(dev);
 	return result;
@@ -2390,6 +2628,7 @@ static void nvme_remove(struct pci_dev *pdev)
 
 	nvme_change_ctrl_state(&dev->ctrl, NVME_CTRL_DELETING);
 
+	debugfs_remove_recursive(dev->debugfs_dir);
 	cancel_work_sync(&dev->ctrl.reset_work);
 	pci_set_drvdata(pdev, NULL);
 
@@ -2551,12 +2790,19 @@ static struct pci_driver nvme_driver = {
 
 static int __init nvme_init(void)
 {
-	return pci_register_driver(&nvme_driver);
+	int ret;
+
+	nvme_debugfs_root = debugfs_create_dir("nvme-pci", NULL);
+	ret = pci_register_driver(&nvme_driver);
+	if (ret)
+		debugfs_remove(nvme_debugfs_root);
+	return ret;
 }
 
 static void __exit nvme_exit(void)
 {
 	pci_unregister_driver(&nvme_driver);
+	debugfs_remove(nvme_debugfs_root);
 	_nvme_check_size();
 }
 
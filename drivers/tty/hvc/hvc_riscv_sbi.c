@@ -20,6 +20,7 @@
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/moduleparam.h>
+#include <linux/of.h>
 #include <linux/types.h>
 
 #include <asm/sbi.h>
@@ -63,6 +64,13 @@ device_initcall(hvc_sbi_init);
 
 static int __init hvc_sbi_console_init(void)
 {
+	/*
+	 * Leave the console to the UART the device tree points at; hvc0 is
+	 * still there for "console=hvc0".
+	 */
+	if (of_stdout)
+		return 0;
+
 	hvc_instantiate(0, 0, &hvc_sbi_ops);
 	add_preferred_console("hvc", 0, NULL);
 
@@ -0,0 +1,625 @@
+/*
+ * SiFive UART driver
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License
+ *   as published by the Free Software Foundation, version 2.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ * The UART has an 8-entry FIFO in each direction, 8 data bits, no parity
+ * and one or two stop bits, and no modem control lines.  Each FIFO
+ * raises its interrupt around a programmable watermark: the transmit
+ * one is set so that it fires once the FIFO has drained, and the receive
+ * one so that it fires as soon as anything arrives.
+ */
+
+#include <linux/clk.h>
+#include <linux/console.h>
+#include <linux/delay.h>
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/serial.h>
+#include <linux/serial_core.h>
+#include <linux/tty.h>
+#include <linux/tty_flip.h>
+
+#define SIFIVE_SERIAL_PORT_NUM	8
+#define SIFIVE_SERIAL_DEV_NAME	"ttySIF"
+#define SIFIVE_SERIAL_FIFO_SIZE	8
+
+#define SIFIVE_SERIAL_TXDATA	0x00
+#define SIFIVE_SERIAL_RXDATA	0x04
+#define SIFIVE_SERIAL_TXCTRL	0x08
+#define SIFIVE_SERIAL_RXCTRL	0x0c
+#define SIFIVE_SERIAL_IE	0x10
+#define SIFIVE_SERIAL_IP	0x14
+#define SIFIVE_SERIAL_DIV	0x18
+
+#define SIFIVE_SERIAL_TXDATA_FULL	BIT(31)
+#define SIFIVE_SERIAL_TXDATA_DATA_MASK	GENMASK(7, 0)
+
+#define SIFIVE_SERIAL_RXDATA_EMPTY	BIT(31)
+#define SIFIVE_SERIAL_RXDATA_DATA_MASK	GENMASK(7, 0)
+
+#define SIFIVE_SERIAL_TXCTRL_TXEN	BIT(0)
+#define SIFIVE_SERIAL_TXCTRL_NSTOP	BIT(1)
+#define SIFIVE_SERIAL_TXCTRL_TXCNT_SHIFT	16
+#define SIFIVE_SERIAL_TXCTRL_TXCNT_MASK	GENMASK(18, 16)
+
+#define SIFIVE_SERIAL_RXCTRL_RXEN	BIT(0)
+#define SIFIVE_SERIAL_RXCTRL_RXCNT_SHIFT	16
+#define SIFIVE_SERIAL_RXCTRL_RXCNT_MASK	GENMASK(18, 16)
+
+/* The same bits in IE and IP */
+#define SIFIVE_SERIAL_IP_TXWM	BIT(0)
+#define SIFIVE_SERIAL_IP_RXWM	BIT(1)
+
+/* TXWM is pending below txcnt entries, RXWM above rxcnt */
+#define SIFIVE_SERIAL_TXCNT	1
+#define SIFIVE_SERIAL_RXCNT	0
+
+/* The divisor gives a baud rate of uartclk / (div + 1) */
+#define SIFIVE_SERIAL_DIV_MAX	0xffff
+
+static struct uart_driver sifive_serial_driver;
+
+struct sifive_serial_port {
+	struct uart_port port;
+	struct clk *clk;
+	u32 ie;
+};
+
+#define to_sifive_serial_port(p) container_of(p, struct sifive_serial_port, port)
+
+static struct sifive_serial_port *sifive_serial_ports[SIFIVE_SERIAL_PORT_NUM];
+
+static inline void sifive_serial_write(struct uart_port *port, u32 val,
+				       unsigned int off)
+{
+	writel_relaxed(val, port->membase + off);
+}
+
+static inline u32 sifive_serial_read(struct uart_port *port, unsigned int off)
+{
+	return readl_relaxed(port->membase + off);
+}
+
+/* Both called with the port lock held */
+static void sifive_serial_enable_irq(struct uart_port *port, u32 mask)
+{
+	struct sifive_serial_port *ssp = to_sifive_serial_port(port);
+
+	ssp->ie |= mask;
+	sifive_serial_write(port, ssp->ie, SIFIVE_SERIAL_IE);
+}
+
+static void sifive_serial_disable_irq(struct uart_port *port, u32 mask)
+{
+	struct sifive_serial_port *ssp = to_sifive_serial_port(port);
+
+	ssp->ie &= ~mask;
+	sifive_serial_write(port, ssp->ie, SIFIVE_SERIAL_IE);
+}
+
+static void sifive_serial_set_mctrl(struct uart_port *port, unsigned int mctrl)
+{
+}
+
+static unsigned int sifive_serial_get_mctrl(struct uart_port *port)
+{
+	return TIOCM_CAR | TIOCM_CTS | TIOCM_DSR;
+}
+
+static unsigned int sifive_serial_tx_empty(struct uart_port *port)
+{
+	/* With a watermark of one, TXWM means the FIFO has drained */
+	return (sifive_serial_read(port, SIFIVE_SERIAL_IP) &
+		SIFIVE_SERIAL_IP_TXWM) ? TIOCSER_TEMT : 0;
+}
+
+static void sifive_serial_stop_tx(struct uart_port *port)
+{
+	sifive_serial_disable_irq(port, SIFIVE_SERIAL_IP_TXWM);
+}
+
+static void sifive_serial_stop_rx(struct uart_port *port)
+{
+	sifive_serial_disable_irq(port, SIFIVE_SERIAL_IP_RXWM);
+}
+
+static void sifive_serial_send_chars(struct uart_port *port)
+{
+	struct circ_buf *xmit = &port->state->xmit;
+	int count = SIFIVE_SERIAL_FIFO_SIZE;
+
+	if (port->x_char) {
+		sifive_serial_write(port, port->x_char, SIFIVE_SERIAL_TXDATA);
+		port->icount.tx++;
+		port->x_char = 0;
+		count--;
+	}
+
+	if (uart_tx_stopped(port)) {
+		sifive_serial_stop_tx(port);
+		return;
+	}
+
+	/* The interrupt only comes once the FIFO is empty: fill it */
+	while (count-- > 0 && !uart_circ_empty(xmit)) {
+		sifive_serial_write(port, xmit->buf[xmit->tail],
+				    SIFIVE_SERIAL_TXDATA);
+		xmit->tail = (xmit->tail + 1) & (UART_XMIT_SIZE - 1);
+		port->icount.tx++;
+	}
+
+	if (uart_circ_chars_pending(xmit) < WAKEUP_CHARS)
+		uart_write_wakeup(port);
+
+	if (uart_circ_empty(xmit))
+		sifive_serial_stop_tx(port);
+}
+
+static void sifive_serial_start_tx(struct uart_port *port)
+{
+	/* Anything the FIFO has room for goes now, the rest from the irq */
+	if (sifive_serial_tx_empty(port))
+		sifive_serial_send_chars(port);
+
+	if (!uart_circ_empty(&port->state->xmit) && !uart_tx_stopped(port))
+		sifive_serial_enable_irq(port, SIFIVE_SERIAL_IP_TXWM);
+}
+
+static void sifive_serial_receive_chars(struct uart_port *port)
+{
+	u32 val;
+
+	for (;;) {
+		val = sifive_serial_read(port, SIFIVE_SERIAL_RXDATA);
+		if (val & SIFIVE_SERIAL_RXDATA_EMPTY)
+			break;
+
+		port->icount.rx++;
+		val &= SIFIVE_SERIAL_RXDATA_DATA_MASK;
+		if (uart_handle_sysrq_char(port, val))
+			continue;
+
+		tty_insert_flip_char(&port->state->port, val, TTY_NORMAL);
+	}
+
+	spin_unlock(&port->lock);
+	tty_flip_buffer_push(&port->state->port);
+	spin_lock(&port->lock);
+}
+
+static irqreturn_t sifive_serial_irq(int irq, void *dev_id)
+{
+	struct uart_port *port = dev_id;
+	struct sifive_serial_port *ssp = to_sifive_serial_port(port);
+	unsigned long flags;
+	u32 ip;
+
+	spin_lock_irqsave(&port->lock, flags);
+
+	/* The pending bits follow the FIFO levels, so there's no ack */
+	ip = sifive_serial_read(port, SIFIVE_SERIAL_IP) & ssp->ie;
+	if (!ip) {
+		spin_unlock_irqrestore(&port->lock, flags);
+		return IRQ_NONE;
+	}
+
+	if (ip & SIFIVE_SERIAL_IP_RXWM)
+		sifive_serial_receive_chars(port);
+
+	if (ip & SIFIVE_SERIAL_IP_TXWM)
+		sifive_serial_send_chars(port);
+
+	spin_unlock_irqrestore(&port->lock, flags);
+
+	return IRQ_HANDLED;
+}
+
+static void sifive_serial_set_div(struct uart_port *port, unsigned int baud)
+{
+	unsigned int div = DIV_ROUND_UP(port->uartclk, baud) - 1;
+
+	sifive_serial_write(port, min_t(unsigned int, div,
+					SIFIVE_SERIAL_DIV_MAX),
+			    SIFIVE_SERIAL_DIV);
+}
+
+static int sifive_serial_startup(struct uart_port *port)
+{
+	unsigned long flags;
+	int ret;
+
+	ret = request_irq(port->irq, sifive_serial_irq, 0, "sifive-serial",
+			  port);
+	if (ret)
+		return ret;
+
+	spin_lock_irqsave(&port->lock, flags);
+
+	sifive_serial_write(port, SIFIVE_SERIAL_TXCTRL_TXEN |
+			    (SIFIVE_SERIAL_TXCNT <<
+			     SIFIVE_SERIAL_TXCTRL_TXCNT_SHIFT),
+			    SIFIVE_SERIAL_TXCTRL);
+	sifive_serial_write(port, SIFIVE_SERIAL_RXCTRL_RXEN |
+			    (SIFIVE_SERIAL_RXCNT <<
+			     SIFIVE_SERIAL_RXCTRL_RXCNT_SHIFT),
+			    SIFIVE_SERIAL_RXCTRL);
+	sifive_serial_enable_irq(port, SIFIVE_SERIAL_IP_RXWM);
+
+	spin_unlock_irqrestore(&port->lock, flags);
+
+	return 0;
+}
+
+static void sifive_serial_shutdown(struct uart_port *port)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&port->lock, flags);
+	sifive_serial_disable_irq(port, SIFIVE_SERIAL_IP_TXWM |
+				  SIFIVE_SERIAL_IP_RXWM);
+	spin_unlock_irqrestore(&port->lock, flags);
+
+	free_irq(port->irq, port);
+}
+
+static void sifive_serial_set_termios(struct uart_port *port,
+				      struct ktermios *termios,
+				      struct ktermios *old)
+{
+	unsigned long flags;
+	unsigned int baud;
+	u32 txctrl;
+
+	/* Only 8 data bits, no parity and no flow control */
+	termios->c_cflag &= ~(CSIZE | PARENB | CMSPAR | CRTSCTS);
+	termios->c_cflag |= CS8;
+
+	baud = uart_get_baud_rate(port, termios, old,
+				  port->uartclk / (SIFIVE_SERIAL_DIV_MAX + 1),
+				  port->uartclk / 16);
+
+	spin_lock_irqsave(&port->lock, flags);
+
+	txctrl = sifive_serial_read(port, SIFIVE_SERIAL_TXCTRL);
+	if (termios->c_cflag & CSTOPB)
+		txctrl |= SIFIVE_SERIAL_TXCTRL_NSTOP;
+	else
+		txctrl &= ~SIFIVE_SERIAL_TXCTRL_NSTOP;
+	sifive_serial_write(port, txctrl, SIFIVE_SERIAL_TXCTRL);
+
+	sifive_serial_set_div(port, baud);
+
+	/* Don't rewrite B0 */
+	if (tty_termios_baud_rate(termios))
+		tty_termios_encode_baud_rate(termios, baud, baud);
+
+	uart_update_timeout(port, termios->c_cflag, baud);
+
+	spin_unlock_irqrestore(&port->lock, flags);
+}
+
+static void sifive_serial_release_port(struct uart_port *port)
+{
+}
+
+static int sifive_serial_request_port(struct uart_port *port)
+{
+	return 0;
+}
+
+static const char *sifive_serial_type(struct uart_port *port)
+{
+	return (port->type == PORT_SIFIVE_V0) ? "SiFive UART v0" : NULL;
+}
+
+static int sifive_serial_verify_port(struct uart_port *port,
+				     struct serial_struct *ser)
+{
+	if (ser->type != PORT_UNKNOWN && ser->type != PORT_SIFIVE_V0)
+		return -EINVAL;
+
+	if (port->irq != ser->irq)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void sifive_serial_config_port(struct uart_port *port, int flags)
+{
+	if (flags & UART_CONFIG_TYPE)
+		port->type = PORT_SIFIVE_V0;
+}
+
+static const struct uart_ops sifive_serial_ops = {
+	.set_mctrl = sifive_serial_set_mctrl,
+	.get_mctrl = sifive_serial_get_mctrl,
+	.tx_empty = sifive_serial_tx_empty,
+	.start_tx = sifive_serial_start_tx,
+	.stop_rx = sifive_serial_stop_rx,
+	.stop_tx = sifive_serial_stop_tx,
+	.startup = sifive_serial_startup,
+	.shutdown = sifive_serial_shutdown,
+	.set_termios = sifive_serial_set_termios,
+	.type = sifive_serial_type,
+	.config_port = sifive_serial_config_port,
+	.request_port = sifive_serial_request_port,
+	.release_port = sifive_serial_release_port,
+	.verify_port = sifive_serial_verify_port,
+};
+
+#ifdef CONFIG_SERIAL_SIFIVE_CONSOLE
+
+static void sifive_serial_console_putchar(struct uart_port *port, int ch)
+{
+	while (sifive_serial_read(port, SIFIVE_SERIAL_TXDATA) &
+	       SIFIVE_SERIAL_TXDATA_FULL)
+		cpu_relax();
+
+	sifive_serial_write(port, ch, SIFIVE_SERIAL_TXDATA);
+}
+
+static void sifive_serial_console_write(struct console *co, const char *s,
+					unsigned int count)
+{
+	struct sifive_serial_port *ssp = sifive_serial_ports[co->index];
+	struct uart_port *port;
+	unsigned long flags;
+	int locked = 1;
+
+	if (!ssp)
+		return;
+	port = &ssp->port;
+
+	local_irq_save(flags);
+
+	if (port->sysrq)
+		locked = 0;
+	else if (oops_in_progress)
+		locked = spin_trylock(&port->lock);
+	else
+		spin_lock(&port->lock);
+
+	/*
+	 * The FIFO is shared with the tty side: writing around it only
+	 * interleaves output, which the TXWM interrupt copes with.
+	 */
+	uart_console_write(port, s, count, sifive_serial_console_putchar);
+
+	if (locked)
+		spin_unlock(&port->lock);
+
+	local_irq_restore(flags);
+}
+
+static int sifive_serial_console_setup(struct console *co, char *options)
+{
+	struct sifive_serial_port *ssp;
+	int baud = 115200;
+	int bits = 8;
+	int parity = 'n';
+	int flow = 'n';
+
+	if (co->index < 0 || co->index >= SIFIVE_SERIAL_PORT_NUM)
+		return -EINVAL;
+
+	ssp = sifive_serial_ports[co->index];
+	if (!ssp || !ssp->port.membase)
+		return -ENODEV;
+
+	if (options)
+		uart_parse_options(options, &baud, &parity, &bits, &flow);
+
+	return uart_set_options(&ssp->port, co, baud, parity, bits, flow);
+}
+
+static struct console sifive_serial_console = {
+	.name = SIFIVE_SERIAL_DEV_NAME,
+	.write = sifive_serial_console_write,
+	.device = uart_console_device,
+	.setup = sifive_serial_console_setup,
+	.flags = CON_PRINTBUFFER,
+	.index = -1,
+	.data = &sifive_serial_driver,
+};
+
+static int __init sifive_serial_console_init(void)
+{
+	register_console(&sifive_serial_console);
+
+	return 0;
+}
+console_initcall(sifive_serial_console_init);
+
+static void sifive_serial_early_write(struct console *co, const char *s,
+				      unsigned int count)
+{
+	struct earlycon_device *dev = co->data;
+
+	uart_console_write(&dev->port, s, count,
+			   sifive_serial_console_putchar);
+}
+
+static int __init sifive_serial_early_setup(struct earlycon_device *dev,
+					    const char *options)
+{
+	struct uart_port *port = &dev->port;
+
+	if (!port->membase)
+		return -ENODEV;
+
+	/* Keep the firmware's baud rate unless we know the clock */
+	if (port->uartclk && dev->baud)
+		sifive_serial_set_div(port, dev->baud);
+	sifive_serial_write(port, sifive_serial_read(port,
+						     SIFIVE_SERIAL_TXCTRL) |
+			    SIFIVE_SERIAL_TXCTRL_TXEN, SIFIVE_SERIAL_TXCTRL);
+
+	dev->con->write = sifive_serial_early_write;
+
+	return 0;
+}
+OF_EARLYCON_DECLARE(sifive, "sifive,uart0", sifive_serial_early_setup);
+
+#define SIFIVE_SERIAL_CONSOLE (&sifive_serial_console)
+#else
+#define SIFIVE_SERIAL_CONSOLE NULL
+#endif
+
+static struct uart_driver sifive_serial_driver = {
+	.owner = THIS_MODULE,
+	.driver_name = "sifive-serial",
+	.dev_name = SIFIVE_SERIAL_DEV_NAME,
+	.nr = SIFIVE_SERIAL_PORT_NUM,
+	.cons = SIFIVE_SERIAL_CONSOLE,
+};
+
+static const struct of_device_id sifive_serial_of_match[] = {
+	{ .compatible = "sifive,uart0" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, sifive_serial_of_match);
+
+static int sifive_serial_probe(struct platform_device *pdev)
+{
+	struct sifive_serial_port *ssp;
+	struct resource *res;
+	void __iomem *base;
+	int irq, id, ret;
+
+	id = of_alias_get_id(pdev->dev.of_node, "serial");
+	if (id < 0) {
+		/* Without an alias, take the first free line */
+		for (id = 0; id < SIFIVE_SERIAL_PORT_NUM; id++)
+			if (!sifive_serial_ports[id])
+				break;
+	}
+	if (id >= SIFIVE_SERIAL_PORT_NUM) {
+		dev_err(&pdev->dev, "id %d out of range\n", id);
+		return -EINVAL;
+	}
+	if (sifive_serial_ports[id]) {
+		dev_err(&pdev->dev, "port %d already allocated\n", id);
+		return -EBUSY;
+	}
+
+	irq = platform_get_irq(pdev, 0);
+	if (irq < 0) {
+		dev_err(&pdev->dev, "could not get irq\n");
+		return irq;
+	}
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	base = devm_ioremap_resource(&pdev->dev, res);
+	if (IS_ERR(base))
+		return PTR_ERR(base);
+
+	ssp = devm_kzalloc(&pdev->dev, sizeof(*ssp), GFP_KERNEL);
+	if (!ssp)
+		return -ENOMEM;
+
+	ssp->clk = devm_clk_get(&pdev->dev, NULL);
+	if (IS_ERR(ssp->clk)) {
+		dev_err(&pdev->dev, "could not get clk\n");
+		return PTR_ERR(ssp->clk);
+	}
+
+	ret = clk_prepare_enable(ssp->clk);
+	if (ret)
+		return ret;
+
+	ssp->port.uartclk = clk_get_rate(ssp->clk);
+	if (!ssp->port.uartclk) {
+		dev_err(&pdev->dev, "clock rate is zero\n");
+		ret = -EINVAL;
+		goto err_clk;
+	}
+
+	ssp->port.dev = &pdev->dev;
+	ssp->port.line = id;
+	ssp->port.type = PORT_SIFIVE_V0;
+	ssp->port.iotype = UPIO_MEM32;
+	ssp->port.regshift = 2;
+	ssp->port.mapbase = res->start;
+	ssp->port.membase = base;
+	ssp->port.irq = irq;
+	ssp->port.fifosize = SIFIVE_SERIAL_FIFO_SIZE;
+	ssp->port.flags = UPF_BOOT_AUTOCONF;
+	ssp->port.ops = &sifive_serial_ops;
+
+	/* The earlycon, or the firmware, may have left interrupts on */
+	sifive_serial_write(&ssp->port, 0, SIFIVE_SERIAL_IE);
+
+	sifive_serial_ports[id] = ssp;
+	platform_set_drvdata(pdev, ssp);
+
+	ret = uart_add_one_port(&sifive_serial_driver, &ssp->port);
+	if (ret) {
+		sifive_serial_ports[id] = NULL;
+		goto err_clk;
+	}
+
+	return 0;
+
+err_clk:
+	clk_disable_unprepare(ssp->clk);
+	return ret;
+}
+
+static int sifive_serial_remove(struct platform_device *pdev)
+{
+	struct sifive_serial_port *ssp = platform_get_drvdata(pdev);
+
+	uart_remove_one_port(&sifive_serial_driver, &ssp->port);
+	sifive_serial_ports[ssp->port.line] = NULL;
+	clk_disable_unprepare(ssp->clk);
+
+	return 0;
+}
+
+static struct platform_driver sifive_serial_platform_driver = {
+	.probe = sifive_serial_probe,
+	.remove = sifive_serial_remove,
+	.driver = {
+		.name = "sifive-serial",
+		.of_match_table = sifive_serial_of_match,
+	},
+};
+
+static int __init sifive_serial_init(void)
+{
+	int ret;
+
+	ret = uart_register_driver(&sifive_serial_driver);
+	if (ret)
+		return ret;
+
+	ret = platform_driver_register(&sifive_serial_platform_driver);
+	if (ret)
+		uart_unregister_driver(&sifive_serial_driver);
+
+	return ret;
+}
+
+static void __exit sifive_serial_exit(void)
+{
+	platform_driver_unregister(&sifive_serial_platform_driver);
+	uart_unregister_driver(&sifive_serial_driver);
+}
+
+module_init(sifive_serial_init);
+module_exit(sifive_serial_exit);
+
+MODULE_DESCRIPTION("SiFive UART serial driver");
+MODULE_LICENSE("GPL");
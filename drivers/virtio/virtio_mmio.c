@@ -35,6 +35,12 @@
  *			interrupts = <42>;
  *		}
  *
+ *    A device may also have an interrupt for each of its virtqueues, after
+ *    the first one: it then signals configuration changes on the first
+ *    interrupt, as before, and queue N's used buffers on interrupt N + 1,
+ *    which need no acknowledgement.  The queue interrupts are spread over
+ *    the CPUs as MSI-X vectors are on PCI.
+ *
  * 3. Kernel module (or command line) parameter. Can be used more than once -
  *    one device will be created for each one. Syntax:
  *
@@ -94,6 +100,9 @@ struct virtio_mmio_device {
 	/* a list of queues so we can dispatch IRQs */
 	spinlock_t lock;
 	struct list_head virtqueues;
+
+	/* the spread of the per-queue IRQs, config IRQ first, or NULL */
+	struct cpumask *irq_affinity;
 };
 
 struct virtio_mmio_vq_info {
@@ -102,6 +111,10 @@ struct virtio_mmio_vq_info {
 
 	/* the list node for the virtqueues list */
 	struct list_head node;
+
+	/* the queue's own IRQ, or 0 if it shares the device's */
+	unsigned int irq;
+	char irq_name[32];
 };
 
 
@@ -311,6 +324,12 @@ static irqreturn_t vm_interrupt(int irq, void *opaque)
 	return ret;
 }
 
+/* Notify a virtqueue that has an IRQ to itself */
+static irqreturn_t vm_vring_interrupt(int irq, void *opaque)
+{
+	return vring_interrupt(irq, opaque);
+}
+
 
 
 static void vm_del_vq(struct virtqueue *vq)
@@ -320,6 +339,11 @@ static void vm_del_vq(struct virtqueue *vq)
 	unsigned long flags;
 	unsigned int index = vq->index;
 
+	if (info->irq) {
+		irq_set_affinity_hint(info->irq, NULL);
+		free_irq(info->irq, vq);
+	}
+
 	spin_lock_irqsave(&vm_dev->lock, flags);
 	list_del(&info->node);
 	spin_unlock_irqrestore(&vm_dev->lock, flags);
@@ -347,6 +371,9 @@ static void vm_del_vqs(struct virtio_device *vdev)
 		vm_del_vq(vq);
 
 	free_irq(platform_get_irq(vm_dev->pdev, 0), vm_dev);
+
+	kfree(vm_dev->irq_affinity);
+	vm_dev->irq_affinity = NULL;
 }
 
 static struct virtqueue *vm_setup_vq(struct virtio_device *vdev, unsigned index,
@@ -423,6 +450,7 @@ static struct virtqueue *vm_setup_vq(struct virtio_device *vdev, unsigned index,
 
 	vq->priv = info;
 	info->vq = vq;
+	info->irq = 0;
 
 	spin_lock_irqsave(&vm_dev->lock, flags);
 	list_add(&info->node, &vm_dev->virtqueues);
@@ -443,6 +471,30 @@ static struct virtqueue *vm_setup_vq(struct virtio_device *vdev, unsigned index,
 	return ERR_PTR(err);
 }
 
+/* Give the queue the IRQ it has to itself, on its CPUs if spread */
+static int vm_request_vq_irq(struct virtio_mmio_device *vm_dev,
+			     struct virtqueue *vq, unsigned int index)
+{
+	struct virtio_mmio_vq_info *info = vq->priv;
+	int irq = platform_get_irq(vm_dev->pdev, index);
+	int err;
+
+	if (irq < 0)
+		return irq;
+
+	snprintf(info->irq_name, sizeof(info->irq_name), "%s-%s",
+		 dev_name(&vm_dev->vdev.dev), vq->name);
+	err = request_irq(irq, vm_vring_interrupt, 0, info->irq_name, vq);
+	if (err)
+		return err;
+
+	info->irq = irq;
+	if (vm_dev->irq_affinity)
+		irq_set_affinity_hint(irq, &vm_dev->irq_affinity[index]);
+
+	return 0;
+}
+
 static int vm_find_vqs(struct virtio_device *vdev, unsigned nvqs,
 		       struct virtqueue *vqs[],
 		       vq_callback_t *callbacks[],
@@ -452,6 +504,7 @@ static int vm_find_vqs(struct virtio_device *vdev, unsigned nvqs,
 {
 	struct virtio_mmio_device *vm_dev = to_virtio_mmio_device(vdev);
 	unsigned int irq = platform_get_irq(vm_dev->pdev, 0);
+	bool per_vq_irqs = platform_irq_count(vm_dev->pdev) > (int)nvqs;
 	int i, err;
 
 	err = request_irq(irq, vm_interrupt, IRQF_SHARED,
@@ -459,16 +512,57 @@ static int vm_find_vqs(struct virtio_device *vdev, unsigned nvqs,
 	if (err)
 		return err;
 
+	if (per_vq_irqs && desc) {
+		desc->pre_vectors++; /* the config IRQ */
+		vm_dev->irq_affinity = irq_create_affinity_masks(nvqs + 1,
+								 desc);
+	}
+
 	for (i = 0; i < nvqs; ++i) {
 		vqs[i] = vm_setup_vq(vdev, i, callbacks[i], names[i],
 				     ctx ? ctx[i] : false);
 		if (IS_ERR(vqs[i])) {
-			vm_del_vqs(vdev);
-			return PTR_ERR(vqs[i]);
+			err = PTR_ERR(vqs[i]);
+			goto error;
+		}
+
+		if (per_vq_irqs && vqs[i] && callbacks[i]) {
+			err = vm_request_vq_irq(vm_dev, vqs[i], i + 1);
+			if (err)
+				goto error;
 		}
 	}
 
 	return 0;
+
+error:
+	vm_del_vqs(vdev);
+	return err;
+}
+
+static int vm_set_vq_affinity(struct virtqueue *vq, int cpu)
+{
+	struct virtio_mmio_vq_info *info = vq->priv;
+
+	if (!vq->callback)
+		return -EINVAL;
+
+	/* The shared IRQ follows no queue in particular */
+	if (info->irq)
+		irq_set_affinity_hint(info->irq,
+				      cpu == -1 ? NULL : cpumask_of(cpu));
+	return 0;
+}
+
+static const struct cpumask *vm_get_vq_affinity(struct virtio_device *vdev,
+						int index)
+{
+	struct virtio_mmio_device *vm_dev = to_virtio_mmio_device(vdev);
+
+	if (!vm_dev->irq_affinity)
+		return NULL;
+
+	return &vm_dev->irq_affinity[index + 1];
 }
 
 static const char *vm_bus_name(struct virtio_device *vdev)
@@ -490,6 +584,8 @@ static const struct virtio_config_ops virtio_mmio_config_ops = {
 	.get_features	= vm_get_features,
 	.finalize_features = vm_finalize_features,
 	.bus_name	= vm_bus_name,
+	.set_vq_affinity = vm_set_vq_affinity,
+	.get_vq_affinity = vm_get_vq_affinity,
 };
 
 
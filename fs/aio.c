@@ -1605,6 +1605,8 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 		pr_debug("EINVAL: aio_rw_flags\n");
 		goto out_put_req;
 	}
+	/* nobody polls for aio completions, keep them off the poll queues */
+	req->common.ki_flags &= ~IOCB_HIPRI;
 
 	ret = put_user(KIOCB_KEY, &user_iocb->aio_key);
 	if (unlikely(ret)) {
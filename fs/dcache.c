@@ -39,6 +39,7 @@
 #include <linux/ratelimit.h>
 #include <linux/list_lru.h>
 #include <linux/kasan.h>
+#include <linux/sched/mm.h>
 
 #include "internal.h"
 #include "mount.h"
@@ -132,6 +133,14 @@ struct dentry_stat_t dentry_stat = {
 
 static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
+static DEFINE_PER_CPU(long, nr_dentry_negative);
+
+/*
+ * Maximum number of unused negative dentries kept on a superblock's LRU
+ * list, or 0 for no limit.  Going over it makes d_alloc() trim the oldest
+ * unreferenced ones so negative lookups can't flood the hash chains.
+ */
+unsigned long sysctl_negative_dentry_limit __read_mostly;
 
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 
@@ -165,11 +174,21 @@ static long get_nr_dentry_unused(void)
 	return sum < 0 ? 0 : sum;
 }
 
+static long get_nr_dentry_negative(void)
+{
+	int i;
+	long sum = 0;
+	for_each_possible_cpu(i)
+		sum += per_cpu(nr_dentry_negative, i);
+	return sum < 0 ? 0 : sum;
+}
+
 int proc_nr_dentry(struct ctl_table *table, int write, void __user *buffer,
 		   size_t *lenp, loff_t *ppos)
 {
 	dentry_stat.nr_dentry = get_nr_dentry();
 	dentry_stat.nr_unused = get_nr_dentry_unused();
+	dentry_stat.nr_negative = get_nr_dentry_negative();
 	return proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
 }
 #endif
@@ -309,12 +328,30 @@ void release_dentry_name_snapshot(struct name_snapshot *name)
 }
 EXPORT_SYMBOL(release_dentry_name_snapshot);
 
+/*
+ * Negative dentries are accounted while they sit on the superblock LRU,
+ * i.e. with DCACHE_LRU_LIST set and DCACHE_SHRINK_LIST clear.
+ */
+static inline bool d_on_sb_lru(const struct dentry *dentry)
+{
+	return (dentry->d_flags & (DCACHE_LRU_LIST | DCACHE_SHRINK_LIST)) ==
+		DCACHE_LRU_LIST;
+}
+
+static inline void d_negative_account(struct dentry *dentry, long nr)
+{
+	this_cpu_add(nr_dentry_negative, nr);
+	atomic_long_add(nr, &dentry->d_sb->s_nr_negative_dentries);
+}
+
 static inline void __d_set_inode_and_type(struct dentry *dentry,
 					  struct inode *inode,
 					  unsigned type_flags)
 {
 	unsigned flags;
 
+	if (d_is_negative(dentry) && d_on_sb_lru(dentry))
+		d_negative_account(dentry, -1);
 	dentry->d_inode = inode;
 	flags = READ_ONCE(dentry->d_flags);
 	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
@@ -326,6 +363,8 @@ static inline void __d_clear_type_and_inode(struct dentry *dentry)
 {
 	unsigned flags = READ_ONCE(dentry->d_flags);
 
+	if (!d_is_negative(dentry) && d_on_sb_lru(dentry))
+		d_negative_account(dentry, 1);
 	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
 	WRITE_ONCE(dentry->d_flags, flags);
 	dentry->d_inode = NULL;
@@ -384,7 +423,8 @@ static void dentry_unlink_inode(struct dentry * dentry)
  * on the shrink list (ie not on the superblock LRU list).
  *
  * The per-cpu "nr_dentry_unused" counters are updated with
- * the DCACHE_LRU_LIST bit.
+ * the DCACHE_LRU_LIST bit, the "nr_dentry_negative" ones and
+ * sb->s_nr_negative_dentries only while on the superblock LRU.
  *
  * These helper functions make sure we always follow the
  * rules. d_lock must be held by the caller.
@@ -395,6 +435,8 @@ static void d_lru_add(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, 0);
 	dentry->d_flags |= DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_negative_account(dentry, 1);
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -403,6 +445,8 @@ static void d_lru_del(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_negative_account(dentry, -1);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -433,6 +477,8 @@ static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		d_negative_account(dentry, -1);
 	list_lru_isolate(lru, &dentry->d_lru);
 }
 
@@ -441,6 +487,8 @@ static void d_lru_shrink_move(struct list_lru_one *lru, struct dentry *dentry,
 {
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags |= DCACHE_SHRINK_LIST;
+	if (d_is_negative(dentry))
+		d_negative_account(dentry, -1);
 	list_lru_isolate_move(lru, &dentry->d_lru, list);
 }
 
@@ -1174,6 +1222,71 @@ void shrink_dcache_sb(struct super_block *sb)
 }
 EXPORT_SYMBOL(shrink_dcache_sb);
 
+#define NEG_DENTRY_TRIM_BATCH	64
+
+static enum lru_status dentry_lru_isolate_negative(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct list_head *freeable = arg;
+	struct dentry	*dentry = container_of(item, struct dentry, d_lru);
+
+	if (!spin_trylock(&dentry->d_lock))
+		return LRU_SKIP;
+
+	/*
+	 * Positive dentries are left to the shrinker, rotate them out of the
+	 * way so the next trim starts on fresh entries.
+	 */
+	if (!d_is_negative(dentry)) {
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+
+	if (dentry->d_lockref.count) {
+		d_lru_isolate(lru, dentry);
+		spin_unlock(&dentry->d_lock);
+		return LRU_REMOVED;
+	}
+
+	if (dentry->d_flags & DCACHE_REFERENCED) {
+		dentry->d_flags &= ~DCACHE_REFERENCED;
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+
+	d_lru_shrink_move(lru, dentry, freeable);
+	spin_unlock(&dentry->d_lock);
+
+	return LRU_REMOVED;
+}
+
+/*
+ * Called on dentry allocation once @sb holds more unused negative dentries
+ * than sysctl_negative_dentry_limit: kill a batch of the oldest ones, with
+ * the same second-chance treatment the shrinker gives referenced entries.
+ */
+static void d_trim_negative(struct super_block *sb)
+{
+	LIST_HEAD(dispose);
+
+	/* freeing may end up in the filesystem, same rule as the shrinker */
+	if (!(current_gfp_context(GFP_KERNEL) & __GFP_FS))
+		return;
+
+	list_lru_walk(&sb->s_dentry_lru, dentry_lru_isolate_negative,
+		      &dispose, NEG_DENTRY_TRIM_BATCH);
+	shrink_dentry_list(&dispose);
+}
+
+static inline void d_check_negative_limit(struct super_block *sb)
+{
+	unsigned long limit = READ_ONCE(sysctl_negative_dentry_limit);
+
+	if (unlikely(limit) &&
+	    atomic_long_read(&sb->s_nr_negative_dentries) > limit)
+		d_trim_negative(sb);
+}
+
 /**
  * enum d_walk_ret - action to talke during tree walk
  * @D_WALK_CONTINUE:	contrinue walk
@@ -1681,7 +1794,10 @@ struct dentry *__d_alloc(struct super_block *sb, const struct qstr *name)
  */
 struct dentry *d_alloc(struct dentry * parent, const struct qstr *name)
 {
-	struct dentry *dentry = __d_alloc(parent->d_sb, name);
+	struct dentry *dentry;
+
+	d_check_negative_limit(parent->d_sb);
+	dentry = __d_alloc(parent->d_sb, name);
 	if (!dentry)
 		return NULL;
 	dentry->d_flags |= DCACHE_RCUACCESS;
@@ -3604,7 +3720,8 @@ static void __init dcache_init(void)
 	 * of the dcache.
 	 */
 	dentry_cache = KMEM_CACHE(dentry,
-		SLAB_RECLAIM_ACCOUNT|SLAB_PANIC|SLAB_MEM_SPREAD|SLAB_ACCOUNT);
+		SLAB_RECLAIM_ACCOUNT|SLAB_PANIC|SLAB_MEM_SPREAD|SLAB_ACCOUNT|
+		SLAB_SHEAVES);
 
 	/* Hash may have been set up in dcache_init_early */
 	if (!hashdist)
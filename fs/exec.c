@@ -293,6 +293,7 @@ static int __bprm_mm_init(struct linux_binprm *bprm)
 	bprm->vma = vma = kmem_cache_zalloc(vm_area_cachep, GFP_KERNEL);
 	if (!vma)
 		return -ENOMEM;
+	vma_init_speculative(vma);
 
 	if (down_write_killable(&mm->mmap_sem)) {
 		err = -EINTR;
@@ -1083,6 +1083,9 @@ struct ext4_inode_info {
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
 
+	/* Last transaction with changes a fast commit can't replay */
+	tid_t i_fc_ineligible_tid;
+
 #ifdef CONFIG_QUOTA
 	struct dquot *i_dquot[MAXQUOTAS];
 #endif
@@ -1146,6 +1149,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DIOREAD_NOLOCK	0x400000 /* Enable support for dio read nolocking */
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
+#define EXT4_MOUNT_JOURNAL_FAST_COMMIT	0x2000000 /* Fast commits on fsync */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1355,6 +1359,11 @@ struct ext4_super_block {
 /* Number of quota types we support */
 #define EXT4_MAXQUOTAS 3
 
+/* Number of mballoc group scan criteria, see ext4_mb_regular_allocator() */
+#define EXT4_MB_NUM_CRS		4
+/* Buckets of the mballoc scan length histogram */
+#define EXT4_MB_SCAN_HIST_SIZE	16
+
 /*
  * fourth extended-fs super-block data in memory
  */
@@ -1452,10 +1461,13 @@ struct ext4_sb_info {
 	unsigned int s_mb_stats;
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
+	unsigned int s_mb_optimize_scan;
 	unsigned int s_max_dir_size_kb;
-	/* where last allocation was done - for stream allocation */
-	unsigned long s_mb_last_group;
-	unsigned long s_mb_last_start;
+	/* where last allocation was done on each cpu - for stream allocation */
+	struct ext4_mb_stream_goal __percpu *s_mb_stream_goals;
+	/* groups by the order of their largest free extent */
+	struct list_head *s_mb_largest_free_orders;
+	spinlock_t *s_mb_largest_free_orders_locks;
 
 	/* stats for buddy allocator */
 	atomic_t s_bal_reqs;	/* number of reqs with len > 1 */
@@ -1472,6 +1484,12 @@ struct ext4_sb_info {
 	atomic_t s_mb_preallocated;
 	atomic_t s_mb_discarded;
 	atomic_t s_lock_busy;
+	atomic_t s_lock_contended;	/* group lock waits */
+	atomic_t s_bal_cr_hits[EXT4_MB_NUM_CRS];	/* found at criteria */
+	atomic_t s_bal_cr_groups[EXT4_MB_NUM_CRS];	/* groups considered */
+	atomic_t s_bal_cr_optimized[EXT4_MB_NUM_CRS];	/* picked from lists */
+	/* allocations by log2 of the number of groups they scanned */
+	atomic_t s_bal_scan_hist[EXT4_MB_SCAN_HIST_SIZE];
 
 	/* locality groups */
 	struct ext4_locality_group __percpu *s_locality_groups;
@@ -1527,6 +1545,12 @@ struct ext4_sb_info {
 	/* Barrier between changing inodes' journal flags and writepages ops. */
 	struct percpu_rw_semaphore s_journal_flag_rwsem;
 	struct dax_device *s_daxdev;
+
+	/* Fast commits, see fast_commit.c */
+	struct mutex s_fc_lock;
+	tid_t s_fc_tid;			/* owner of the fast commit area */
+	unsigned long s_fc_off;		/* next free block in the area */
+	tid_t s_fc_ineligible_tid;	/* last with fs-wide ineligible ops */
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -1567,6 +1591,7 @@ enum {
 	EXT4_STATE_MAY_INLINE_DATA,	/* may have in-inode data */
 	EXT4_STATE_EXT_PRECACHED,	/* extents have been precached */
 	EXT4_STATE_LUSTRE_EA_INODE,	/* Lustre-style ea_inode */
+	EXT4_STATE_FC_INELIGIBLE,	/* i_fc_ineligible_tid is valid */
 };
 
 #define EXT4_INODE_BIT_FNS(name, field, offset)				\
@@ -2400,6 +2425,15 @@ static inline  unsigned char get_dtype(struct super_block *sb, int filetype)
 extern int ext4_check_all_de(struct inode *dir, struct buffer_head *bh,
 			     void *buf, int buf_size);
 
+/* fast_commit.c */
+extern void ext4_fc_mark_ineligible(handle_t *handle, struct inode *inode);
+extern void ext4_fc_mark_fs_ineligible(handle_t *handle,
+				       struct super_block *sb);
+extern int ext4_fc_commit(struct inode *inode, tid_t commit_tid);
+extern int ext4_fc_replay(journal_t *journal, struct buffer_head *bh,
+			  unsigned long off, tid_t tid);
+extern void ext4_fc_enable(struct super_block *sb);
+
 /* fsync.c */
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 
@@ -2435,6 +2469,7 @@ extern void ext4_end_bitmap_read(struct buffer_head *bh, int uptodate);
 
 /* mballoc.c */
 extern const struct file_operations ext4_seq_mb_groups_fops;
+extern int ext4_seq_mb_stats_show(struct seq_file *seq, void *offset);
 extern long ext4_mb_stats;
 extern long ext4_mb_max_to_scan;
 extern int ext4_mb_init(struct super_block *);
@@ -2889,7 +2924,9 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_free;	/* total free blocks */
 	ext4_grpblk_t	bb_fragments;	/* nr of freespace fragments */
 	ext4_grpblk_t	bb_largest_free_order;/* order of largest frag in BG */
+	ext4_group_t	bb_group;	/* group number */
 	struct          list_head bb_prealloc_list;
+	struct          list_head bb_largest_free_order_node;
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
 #endif
@@ -2953,6 +2990,7 @@ static inline void ext4_lock_group(struct super_block *sb, ext4_group_t group)
 		 */
 		atomic_add_unless(&EXT4_SB(sb)->s_lock_busy, 1,
 				  EXT4_MAX_CONTENTION);
+		atomic_inc(&EXT4_SB(sb)->s_lock_contended);
 		spin_lock(lock);
 	}
 }
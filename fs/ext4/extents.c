@@ -2835,6 +2835,7 @@ int ext4_ext_remove_space(struct inode *inode, ext4_lblk_t start,
 	handle = ext4_journal_start(inode, EXT4_HT_TRUNCATE, depth + 1);
 	if (IS_ERR(handle))
 		return PTR_ERR(handle);
+	ext4_fc_mark_ineligible(handle, inode);
 
 again:
 	trace_ext4_ext_remove_space(inode, start, end, depth);
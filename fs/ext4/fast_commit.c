@@ -0,0 +1,357 @@
+/*
+ * linux/fs/ext4/fast_commit.c
+ *
+ * Fast commits for fsync (the fast_commit mount option).
+ *
+ * A full jbd2 commit writes out every metadata block the running
+ * transaction has touched.  When all an fsync needs is the inode itself,
+ * it is enough to log the inode's raw on-disk image to the fast commit
+ * area at the end of the journal, one block per fsync, tagged with the
+ * ID of the running transaction.  After the full commits have been
+ * replayed, recovery replays the images logged by the transaction that
+ * was running at the time of the crash.
+ *
+ * Replay copies each image into the inode table and marks the blocks of
+ * its extents in use.  That is only enough for regular files whose extent
+ * tree fits in the inode and which, in the running transaction, were not
+ * created, linked, unlinked, renamed or truncated, did not free blocks
+ * and did not change xattrs.  Those inodes, and everything while
+ * filesystem-wide operations such as resize are in the transaction, get
+ * a full commit instead.
+ */
+
+#include <linux/fs.h>
+#include <linux/crc32.h>
+#include <linux/quotaops.h>
+#include <linux/slab.h>
+
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "ext4_extents.h"
+
+#define EXT4_FC_MAGIC		0xEF4FC0DE
+
+/* One block of the fast commit area; the raw inode follows the header. */
+struct ext4_fc_block {
+	__le32	fc_magic;
+	__le32	fc_tid;		/* transaction running when logged */
+	__le32	fc_seq;		/* block offset in the fast commit area */
+	__le32	fc_ino;
+	__le16	fc_inode_size;	/* bytes of raw inode that follow */
+	__le16	fc_reserved;
+	__le32	fc_checksum;	/* crc32 of header and inode */
+};
+
+static __le32 ext4_fc_csum(struct super_block *sb, struct ext4_fc_block *fcb)
+{
+	__le32 saved = fcb->fc_checksum;
+	u32 crc;
+
+	fcb->fc_checksum = 0;
+	crc = crc32_le(~0, EXT4_SB(sb)->s_es->s_uuid,
+		       sizeof(EXT4_SB(sb)->s_es->s_uuid));
+	crc = crc32_le(crc, (u8 *)fcb,
+		       sizeof(*fcb) + le16_to_cpu(fcb->fc_inode_size));
+	fcb->fc_checksum = saved;
+
+	return cpu_to_le32(crc);
+}
+
+/*
+ * Called from within @handle before an operation that a fast commit of
+ * @inode could not replay: its fsyncs take a full commit until the
+ * transaction is committed.
+ */
+void ext4_fc_mark_ineligible(handle_t *handle, struct inode *inode)
+{
+	if (!ext4_handle_valid(handle))
+		return;
+
+	WRITE_ONCE(EXT4_I(inode)->i_fc_ineligible_tid,
+		   handle->h_transaction->t_tid);
+	smp_wmb();
+	ext4_set_inode_state(inode, EXT4_STATE_FC_INELIGIBLE);
+}
+
+/* Same, for operations that make every fast commit in the transaction unsafe */
+void ext4_fc_mark_fs_ineligible(handle_t *handle, struct super_block *sb)
+{
+	if (!ext4_handle_valid(handle))
+		return;
+
+	WRITE_ONCE(EXT4_SB(sb)->s_fc_ineligible_tid,
+		   handle->h_transaction->t_tid);
+}
+
+static bool ext4_fc_eligible(struct inode *inode, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+
+	if (!test_opt(sb, JOURNAL_FAST_COMMIT) ||
+	    test_opt(sb, DATA_FLAGS) != EXT4_MOUNT_ORDERED_DATA ||
+	    sb_any_quota_loaded(sb))
+		return false;
+
+	if (!S_ISREG(inode->i_mode) ||
+	    !ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS) ||
+	    ext4_has_inline_data(inode) || ext4_should_journal_data(inode))
+		return false;
+
+	if (tid_geq(READ_ONCE(EXT4_SB(sb)->s_fc_ineligible_tid), tid))
+		return false;
+
+	if (ext4_test_inode_state(inode, EXT4_STATE_FC_INELIGIBLE)) {
+		smp_rmb();
+		if (tid_geq(READ_ONCE(EXT4_I(inode)->i_fc_ineligible_tid), tid))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Make the current state of @inode durable without waiting for
+ * @commit_tid, the transaction holding its changes, to commit.  Returns
+ * -EAGAIN if the caller has to fall back to a full commit.
+ */
+int ext4_fc_commit(struct inode *inode, tid_t commit_tid)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	journal_t *journal = sbi->s_journal;
+	unsigned int inode_size = EXT4_INODE_SIZE(sb);
+	struct ext4_extent_header *eh;
+	struct ext4_fc_block *fcb;
+	struct ext4_inode *raw;
+	struct ext4_iloc iloc;
+	bool running;
+	int ret;
+
+	if (!journal->j_fc_len || !ext4_fc_eligible(inode, commit_tid))
+		return -EAGAIN;
+
+	/* A transaction on its way to disk already is no use to wait for */
+	read_lock(&journal->j_state_lock);
+	running = journal->j_running_transaction &&
+		  journal->j_running_transaction->t_tid == commit_tid;
+	read_unlock(&journal->j_state_lock);
+	if (!running)
+		return -EAGAIN;
+
+	fcb = kzalloc(sb->s_blocksize, GFP_NOFS);
+	if (!fcb)
+		return -EAGAIN;
+	raw = (struct ext4_inode *)(fcb + 1);
+
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		goto out;
+	spin_lock(&ei->i_raw_lock);
+	memcpy(raw, ext4_raw_inode(&iloc), inode_size);
+	spin_unlock(&ei->i_raw_lock);
+	brelse(iloc.bh);
+
+	ret = -EAGAIN;
+	/* Replay can only account for extents kept in the inode */
+	eh = (struct ext4_extent_header *)raw->i_block;
+	if (eh->eh_magic != EXT4_EXT_MAGIC || eh->eh_depth)
+		goto out;
+	/* Something ineligible may have run while we were copying */
+	if (!ext4_fc_eligible(inode, commit_tid))
+		goto out;
+
+	mutex_lock(&sbi->s_fc_lock);
+	if (sbi->s_fc_tid != commit_tid) {
+		if (tid_gt(sbi->s_fc_tid, commit_tid))
+			goto out_unlock;
+		/*
+		 * Fast commits only stand on top of a committed transaction,
+		 * and the records for the last one die with it.
+		 */
+		ret = jbd2_log_wait_durable(journal, commit_tid - 1);
+		if (ret)
+			goto out_unlock;
+		ret = -EAGAIN;
+		sbi->s_fc_tid = commit_tid;
+		sbi->s_fc_off = 0;
+	}
+	if (sbi->s_fc_off >= journal->j_fc_len)
+		goto out_unlock;
+
+	fcb->fc_magic = cpu_to_le32(EXT4_FC_MAGIC);
+	fcb->fc_tid = cpu_to_le32(commit_tid);
+	fcb->fc_seq = cpu_to_le32(sbi->s_fc_off);
+	fcb->fc_ino = cpu_to_le32(inode->i_ino);
+	fcb->fc_inode_size = cpu_to_le16(inode_size);
+	fcb->fc_checksum = ext4_fc_csum(sb, fcb);
+
+	if (!jbd2_fc_write_block(journal, sbi->s_fc_off, fcb)) {
+		sbi->s_fc_off++;
+		ret = 0;
+	}
+out_unlock:
+	mutex_unlock(&sbi->s_fc_lock);
+out:
+	kfree(fcb);
+	return ret;
+}
+
+/* Mark [block, block + len) in use in the block bitmaps */
+static int ext4_fc_replay_range(struct super_block *sb, ext4_fsblk_t block,
+				unsigned int len)
+{
+	struct ext4_super_block *es = EXT4_SB(sb)->s_es;
+	ext4_fsblk_t end = block + len;
+
+	if (!len || block < le32_to_cpu(es->s_first_data_block) ||
+	    end > ext4_blocks_count(es))
+		return -EFSCORRUPTED;
+
+	while (block < end) {
+		struct buffer_head *gd_bh, *bitmap_bh;
+		struct ext4_group_desc *gdp;
+		ext4_group_t group;
+		ext4_grpblk_t bit, nr, i;
+		unsigned int used = 0;
+
+		ext4_get_group_no_and_offset(sb, block, &group, &bit);
+		nr = min_t(ext4_fsblk_t, end - block,
+			   EXT4_BLOCKS_PER_GROUP(sb) - bit);
+
+		gdp = ext4_get_group_desc(sb, group, &gd_bh);
+		if (!gdp || (gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)))
+			return -EFSCORRUPTED;
+		bitmap_bh = sb_bread(sb, ext4_block_bitmap(sb, gdp));
+		if (!bitmap_bh)
+			return -EIO;
+
+		for (i = 0; i < nr; i++)
+			if (!ext4_test_and_set_bit(bit + i, bitmap_bh->b_data))
+				used++;
+		if (used) {
+			ext4_free_group_clusters_set(sb, gdp,
+				ext4_free_group_clusters(sb, gdp) - used);
+			ext4_block_bitmap_csum_set(sb, group, gdp, bitmap_bh);
+			ext4_group_desc_csum_set(sb, group, gdp);
+			mark_buffer_dirty(bitmap_bh);
+			mark_buffer_dirty(gd_bh);
+		}
+		brelse(bitmap_bh);
+		block += nr;
+	}
+	return 0;
+}
+
+static int ext4_fc_replay_inode(struct super_block *sb, unsigned long ino,
+				struct ext4_inode *raw)
+{
+	unsigned int inode_size = EXT4_INODE_SIZE(sb);
+	struct ext4_extent_header *eh;
+	struct ext4_group_desc *gdp;
+	struct ext4_extent *ex;
+	struct buffer_head *bh;
+	unsigned long index;
+	int i, ret;
+
+	eh = (struct ext4_extent_header *)raw->i_block;
+	if (!(le32_to_cpu(raw->i_flags) & EXT4_EXTENTS_FL) ||
+	    eh->eh_magic != EXT4_EXT_MAGIC || eh->eh_depth ||
+	    le16_to_cpu(eh->eh_entries) > le16_to_cpu(eh->eh_max) ||
+	    le16_to_cpu(eh->eh_max) > (sizeof(raw->i_block) - sizeof(*eh)) /
+				      sizeof(*ex))
+		return -EFSCORRUPTED;
+
+	ex = EXT_FIRST_EXTENT(eh);
+	for (i = 0; i < le16_to_cpu(eh->eh_entries); i++, ex++) {
+		ret = ext4_fc_replay_range(sb, ext4_ext_pblock(ex),
+					   ext4_ext_get_actual_len(ex));
+		if (ret)
+			return ret;
+	}
+
+	index = (ino - 1) % EXT4_INODES_PER_GROUP(sb);
+	gdp = ext4_get_group_desc(sb, (ino - 1) / EXT4_INODES_PER_GROUP(sb),
+				  NULL);
+	if (!gdp)
+		return -EFSCORRUPTED;
+	bh = sb_bread(sb, ext4_inode_table(sb, gdp) +
+			  index / EXT4_SB(sb)->s_inodes_per_block);
+	if (!bh)
+		return -EIO;
+	memcpy(bh->b_data +
+	       (index % EXT4_SB(sb)->s_inodes_per_block) * inode_size,
+	       raw, inode_size);
+	mark_buffer_dirty(bh);
+	brelse(bh);
+
+	return 0;
+}
+
+/* jbd2 ->j_fc_replay_callback, see jbd2_journal_recover() */
+int ext4_fc_replay(journal_t *journal, struct buffer_head *bh,
+		   unsigned long off, tid_t tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_fc_block *fcb = (struct ext4_fc_block *)bh->b_data;
+	unsigned long ino;
+	int ret;
+
+	/* The records of @tid end at the first block not written for it */
+	if (le32_to_cpu(fcb->fc_magic) != EXT4_FC_MAGIC ||
+	    le32_to_cpu(fcb->fc_tid) != tid ||
+	    le32_to_cpu(fcb->fc_seq) != off ||
+	    le16_to_cpu(fcb->fc_inode_size) != EXT4_INODE_SIZE(sb) ||
+	    fcb->fc_checksum != ext4_fc_csum(sb, fcb))
+		return 0;
+
+	ino = le32_to_cpu(fcb->fc_ino);
+	if (ino < EXT4_FIRST_INO(sb) ||
+	    ino > le32_to_cpu(EXT4_SB(sb)->s_es->s_inodes_count))
+		ret = -EFSCORRUPTED;
+	else
+		ret = ext4_fc_replay_inode(sb, ino,
+					   (struct ext4_inode *)(fcb + 1));
+	if (ret) {
+		ext4_msg(sb, KERN_ERR, "failed to replay fast commit of "
+			 "inode %lu: %d", ino, ret);
+		return ret;
+	}
+	return 1;
+}
+
+/*
+ * Set up the fast commit area of the journal, on read-write mounts with
+ * the fast_commit option.  Fast commits are turned off if that fails.
+ */
+void ext4_fc_enable(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	journal_t *journal = sbi->s_journal;
+
+	if (!test_opt(sb, JOURNAL_FAST_COMMIT) || sb_rdonly(sb))
+		return;
+
+	if (ext4_has_feature_bigalloc(sb) ||
+	    EXT4_INODE_SIZE(sb) + sizeof(struct ext4_fc_block) >
+	    sb->s_blocksize ||
+	    test_opt(sb, DATA_FLAGS) != EXT4_MOUNT_ORDERED_DATA) {
+		ext4_msg(sb, KERN_WARNING, "fast_commit needs data=ordered, "
+			 "no bigalloc and inodes smaller than a block");
+		goto disable;
+	}
+
+	if (!jbd2_journal_set_features(journal, 0, 0,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT)) {
+		ext4_msg(sb, KERN_WARNING, "failed to set up the fast commit "
+			 "area of the journal");
+		goto disable;
+	}
+
+	sbi->s_fc_tid = journal->j_commit_sequence;
+	sbi->s_fc_ineligible_tid = journal->j_commit_sequence;
+	sbi->s_fc_off = 0;
+	return;
+
+disable:
+	clear_opt(sb, JOURNAL_FAST_COMMIT);
+}
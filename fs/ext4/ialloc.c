@@ -1038,6 +1038,7 @@ struct inode *__ext4_new_inode(handle_t *handle, struct inode *dir,
 			ext4_block_bitmap_csum_set(sb, group, gdp,
 						   block_bitmap_bh);
 			ext4_group_desc_csum_set(sb, group, gdp);
+			ext4_fc_mark_fs_ineligible(handle, sb);
 		}
 		ext4_unlock_group(sb, group);
 		brelse(block_bitmap_bh);
@@ -1198,6 +1199,8 @@ struct inode *__ext4_new_inode(handle_t *handle, struct inode *dir,
 		ei->i_sync_tid = handle->h_transaction->t_tid;
 		ei->i_datasync_tid = handle->h_transaction->t_tid;
 	}
+	/* The inode bitmap update can't be replayed from a fast commit */
+	ext4_fc_mark_ineligible(handle, inode);
 
 	err = ext4_mark_inode_dirty(handle, inode);
 	if (err) {
@@ -4794,6 +4794,12 @@ struct inode *ext4_iget(struct super_block *sb, unsigned long ino)
 		read_unlock(&journal->j_state_lock);
 		ei->i_sync_tid = tid;
 		ei->i_datasync_tid = tid;
+		/*
+		 * Likewise we cannot know whether the transaction already
+		 * did something to the inode a fast commit can't replay.
+		 */
+		ei->i_fc_ineligible_tid = tid;
+		ext4_set_inode_state(inode, EXT4_STATE_FC_INELIGIBLE);
 	}
 
 	if (EXT4_INODE_SIZE(inode->i_sb) > EXT4_GOOD_OLD_INODE_SIZE) {
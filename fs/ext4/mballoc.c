@@ -697,22 +697,34 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 
 /*
  * Cache the order of the largest free extent we have available in this block
- * group.
+ * group, and keep the group on the list for that order.  Called with the
+ * group locked.
  */
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int old = grp->bb_largest_free_order;
 	int i;
-	int bits;
-
-	grp->bb_largest_free_order = -1; /* uninit */
 
-	bits = sb->s_blocksize_bits + 1;
-	for (i = bits; i >= 0; i--) {
-		if (grp->bb_counters[i] > 0) {
-			grp->bb_largest_free_order = i;
+	for (i = MB_NUM_ORDERS(sb) - 1; i >= 0; i--)
+		if (grp->bb_counters[i] > 0)
 			break;
-		}
+	/* i is -1 when the group is full */
+	if (i == old)
+		return;
+
+	if (old >= 0) {
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[old]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[old]);
+	}
+	grp->bb_largest_free_order = i;
+	if (i >= 0) {
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[i]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[i]);
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[i]);
 	}
 }
 
@@ -1680,10 +1692,12 @@ static void ext4_mb_use_best_found(struct ext4_allocation_context *ac,
 	get_page(ac->ac_buddy_page);
 	/* store last allocated for subsequent stream allocation */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		spin_lock(&sbi->s_md_lock);
-		sbi->s_mb_last_group = ac->ac_f_ex.fe_group;
-		sbi->s_mb_last_start = ac->ac_f_ex.fe_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_mb_stream_goal *goal;
+
+		goal = get_cpu_ptr(sbi->s_mb_stream_goals);
+		goal->group = ac->ac_f_ex.fe_group;
+		goal->start = ac->ac_f_ex.fe_start;
+		put_cpu_ptr(sbi->s_mb_stream_goals);
 	}
 }
 
@@ -2106,6 +2120,57 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Pick a group to scan at criteria 0 or 1 from the lists of groups by
+ * largest free order, instead of trying every group in turn: at cr 0 we
+ * need a group with a free extent of the requested order, at cr 1 one
+ * that ext4_mb_good_group() likes among the groups with free extents of
+ * at least half the request.  The picked group goes to the tail of its
+ * list so that the next picks, ours and those of parallel allocations,
+ * go to other groups.  Returns 0 if there is no candidate.
+ */
+static int ext4_mb_pick_group(struct ext4_allocation_context *ac, int cr,
+			      ext4_group_t ngroups, ext4_group_t *group)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_info *grp;
+	int order, found = 0;
+
+	if (cr == 0)
+		order = ac->ac_2order;
+	else
+		order = fls(ac->ac_g_ex.fe_len) - 1;
+
+	for (; order < MB_NUM_ORDERS(sb) && !found; order++) {
+		struct list_head *head = &sbi->s_mb_largest_free_orders[order];
+		spinlock_t *lock = &sbi->s_mb_largest_free_orders_locks[order];
+		int n = 0;
+
+		if (list_empty(head))
+			continue;
+
+		spin_lock(lock);
+		list_for_each_entry(grp, head, bb_largest_free_order_node) {
+			if (n++ >= MB_OPTIMIZE_SCAN_MAX_GROUPS)
+				break;
+			if (sbi->s_mb_stats)
+				atomic_inc(&sbi->s_bal_cr_groups[cr]);
+			/* ext4_mb_good_group() must not initialize it here */
+			if (grp->bb_group >= ngroups ||
+			    EXT4_MB_GRP_NEED_INIT(grp) ||
+			    ext4_mb_good_group(ac, grp->bb_group, cr) <= 0)
+				continue;
+			list_move_tail(&grp->bb_largest_free_order_node, head);
+			*group = grp->bb_group;
+			found = 1;
+			break;
+		}
+		spin_unlock(lock);
+	}
+	return found;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
@@ -2155,13 +2220,14 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 			ac->ac_2order = i - 1;
 	}
 
-	/* if stream allocation is enabled, use global goal */
+	/* if stream allocation is enabled, use this cpu's goal */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		/* TBD: may be hot point */
-		spin_lock(&sbi->s_md_lock);
-		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
-		ac->ac_g_ex.fe_start = sbi->s_mb_last_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_mb_stream_goal *goal;
+
+		goal = get_cpu_ptr(sbi->s_mb_stream_goals);
+		ac->ac_g_ex.fe_group = goal->group;
+		ac->ac_g_ex.fe_start = goal->start;
+		put_cpu_ptr(sbi->s_mb_stream_goals);
 	}
 
 	/* Let's just scan groups to find more-less suitable blocks */
@@ -2172,6 +2238,9 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 	 */
 repeat:
 	for (; cr < 4 && ac->ac_status == AC_STATUS_CONTINUE; cr++) {
+		int optimized = cr < 2 && sbi->s_mb_optimize_scan;
+		ext4_group_t first_pick = ngroups;
+
 		ac->ac_criteria = cr;
 		/*
 		 * searching for the right group start
@@ -2182,6 +2251,23 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 		for (i = 0; i < ngroups; group++, i++) {
 			int ret = 0;
 			cond_resched();
+			/*
+			 * Past the goal, go through the groups the order
+			 * lists suggest, until they come round again.
+			 */
+			if (optimized && i > 0) {
+				if (!ext4_mb_pick_group(ac, cr, ngroups,
+							&group) ||
+				    group == first_pick)
+					break;
+				if (first_pick == ngroups)
+					first_pick = group;
+				if (sbi->s_mb_stats)
+					atomic_inc(&sbi->
+						   s_bal_cr_optimized[cr]);
+			} else if (sbi->s_mb_stats) {
+				atomic_inc(&sbi->s_bal_cr_groups[cr]);
+			}
 			/*
 			 * Artificially restricted ngroups for non-extent
 			 * files makes group > ngroups possible on first loop.
@@ -2370,6 +2456,58 @@ const struct file_operations ext4_seq_mb_groups_fops = {
 	.release	= seq_release,
 };
 
+int ext4_seq_mb_stats_show(struct seq_file *seq, void *offset)
+{
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int i;
+
+	seq_puts(seq, "mballoc:\n");
+	seq_printf(seq, "\tgroup_lock_contended: %u\n",
+		   atomic_read(&sbi->s_lock_contended));
+	if (!sbi->s_mb_stats) {
+		seq_puts(seq, "\tmb stats collection turned off.\n");
+		seq_puts(seq, "\tTo enable, write \"1\" to sysfs file "
+			 "mb_stats.\n");
+		return 0;
+	}
+	seq_printf(seq, "\treqs: %u\n", atomic_read(&sbi->s_bal_reqs));
+	seq_printf(seq, "\tsuccess: %u\n", atomic_read(&sbi->s_bal_success));
+	seq_printf(seq, "\tblocks: %u\n", atomic_read(&sbi->s_bal_allocated));
+	seq_printf(seq, "\textents_scanned: %u\n",
+		   atomic_read(&sbi->s_bal_ex_scanned));
+	seq_printf(seq, "\tgoal_hits: %u\n", atomic_read(&sbi->s_bal_goals));
+	seq_printf(seq, "\t2^n_hits: %u\n", atomic_read(&sbi->s_bal_2orders));
+	seq_printf(seq, "\tbreaks: %u\n", atomic_read(&sbi->s_bal_breaks));
+	seq_printf(seq, "\tlost: %u\n", atomic_read(&sbi->s_mb_lost_chunks));
+
+	for (i = 0; i < EXT4_MB_NUM_CRS; i++) {
+		seq_printf(seq, "\tcr%d_stats:\n", i);
+		seq_printf(seq, "\t\thits: %u\n",
+			   atomic_read(&sbi->s_bal_cr_hits[i]));
+		seq_printf(seq, "\t\tgroups_considered: %u\n",
+			   atomic_read(&sbi->s_bal_cr_groups[i]));
+		seq_printf(seq, "\t\toptimized_picks: %u\n",
+			   atomic_read(&sbi->s_bal_cr_optimized[i]));
+	}
+
+	/* bucket i counts allocations which scanned [2^i, 2^(i+1)) groups */
+	seq_puts(seq, "\tgroups_scanned_hist:");
+	for (i = 0; i < EXT4_MB_SCAN_HIST_SIZE; i++)
+		seq_printf(seq, " %u", atomic_read(&sbi->s_bal_scan_hist[i]));
+	seq_putc(seq, '\n');
+
+	seq_printf(seq, "\tbuddies_generated: %lu\n",
+		   sbi->s_mb_buddies_generated);
+	seq_printf(seq, "\tbuddies_time_used: %llu\n",
+		   sbi->s_mb_generation_time);
+	seq_printf(seq, "\tpreallocated: %u\n",
+		   atomic_read(&sbi->s_mb_preallocated));
+	seq_printf(seq, "\tdiscarded: %u\n",
+		   atomic_read(&sbi->s_mb_discarded));
+	return 0;
+}
+
 static struct kmem_cache *get_groupinfo_cache(int blocksize_bits)
 {
 	int cache_index = blocksize_bits - EXT4_MIN_BLOCK_LOG_SIZE;
@@ -2465,9 +2603,11 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	}
 
 	INIT_LIST_HEAD(&meta_group_info[i]->bb_prealloc_list);
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	meta_group_info[i]->bb_group = group;
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2617,6 +2757,22 @@ int ext4_mb_init(struct super_block *sb)
 		goto out;
 	}
 
+	sbi->s_mb_largest_free_orders =
+		kmalloc_array(MB_NUM_ORDERS(sb), sizeof(struct list_head),
+			      GFP_KERNEL);
+	sbi->s_mb_largest_free_orders_locks =
+		kmalloc_array(MB_NUM_ORDERS(sb), sizeof(spinlock_t),
+			      GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders ||
+	    !sbi->s_mb_largest_free_orders_locks) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < MB_NUM_ORDERS(sb); i++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		spin_lock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+	}
+
 	ret = ext4_groupinfo_create_slab(sb->s_blocksize);
 	if (ret < 0)
 		goto out;
@@ -2648,6 +2804,7 @@ int ext4_mb_init(struct super_block *sb)
 	sbi->s_mb_stats = MB_DEFAULT_STATS;
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
+	sbi->s_mb_optimize_scan = MB_DEFAULT_OPTIMIZE_SCAN;
 	/*
 	 * The default group preallocation is 512, which for 4k block
 	 * sizes translates to 2 megabytes.  However for bigalloc file
@@ -2689,17 +2846,42 @@ int ext4_mb_init(struct super_block *sb)
 		spin_lock_init(&lg->lg_prealloc_lock);
 	}
 
+	/*
+	 * Start the stream allocations of each cpu in a different part of
+	 * the filesystem so that they don't all fight over the same groups.
+	 */
+	sbi->s_mb_stream_goals = alloc_percpu(struct ext4_mb_stream_goal);
+	if (sbi->s_mb_stream_goals == NULL) {
+		ret = -ENOMEM;
+		goto out_free_locality_groups;
+	}
+	for_each_possible_cpu(i) {
+		struct ext4_mb_stream_goal *goal;
+
+		goal = per_cpu_ptr(sbi->s_mb_stream_goals, i);
+		goal->group = div_u64((u64)ext4_get_groups_count(sb) * i,
+				      nr_cpu_ids);
+		goal->start = 0;
+	}
+
 	/* init file for buddy data */
 	ret = ext4_mb_init_backend(sb);
 	if (ret != 0)
-		goto out_free_locality_groups;
+		goto out_free_stream_goals;
 
 	return 0;
 
+out_free_stream_goals:
+	free_percpu(sbi->s_mb_stream_goals);
+	sbi->s_mb_stream_goals = NULL;
 out_free_locality_groups:
 	free_percpu(sbi->s_locality_groups);
 	sbi->s_locality_groups = NULL;
 out:
+	kfree(sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = NULL;
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = NULL;
 	kfree(sbi->s_mb_offsets);
 	sbi->s_mb_offsets = NULL;
 	kfree(sbi->s_mb_maxs);
@@ -2754,6 +2936,8 @@ int ext4_mb_release(struct super_block *sb)
 	}
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
 	iput(sbi->s_buddy_cache);
 	if (sbi->s_mb_stats) {
 		ext4_msg(sb, KERN_INFO,
@@ -2779,6 +2963,7 @@ int ext4_mb_release(struct super_block *sb)
 				atomic_read(&sbi->s_mb_discarded));
 	}
 
+	free_percpu(sbi->s_mb_stream_goals);
 	free_percpu(sbi->s_locality_groups);
 
 	return 0;
@@ -3028,6 +3213,7 @@ ext4_mb_mark_diskspace_used(struct ext4_allocation_context *ac,
 		ext4_free_group_clusters_set(sb, gdp,
 					     ext4_free_clusters_after_init(sb,
 						ac->ac_b_ex.fe_group, gdp));
+		ext4_fc_mark_fs_ineligible(handle, sb);
 	}
 	len = ext4_free_group_clusters(sb, gdp) - ac->ac_b_ex.fe_len;
 	ext4_free_group_clusters_set(sb, gdp, len);
@@ -3295,6 +3481,15 @@ static void ext4_mb_collect_stats(struct ext4_allocation_context *ac)
 			atomic_inc(&sbi->s_bal_goals);
 		if (ac->ac_found > sbi->s_mb_max_to_scan)
 			atomic_inc(&sbi->s_bal_breaks);
+		if (ac->ac_groups_scanned) {
+			int cr = ac->ac_criteria;
+			int bucket = min_t(int, fls(ac->ac_groups_scanned) - 1,
+					   EXT4_MB_SCAN_HIST_SIZE - 1);
+
+			if (ac->ac_status == AC_STATUS_FOUND)
+				atomic_inc(&sbi->s_bal_cr_hits[cr]);
+			atomic_inc(&sbi->s_bal_scan_hist[bucket]);
+		}
 	}
 
 	if (ac->ac_op == EXT4_MB_HISTORY_ALLOC)
@@ -4748,6 +4943,8 @@ void ext4_free_blocks(handle_t *handle, struct inode *inode,
 	int ret;
 
 	might_sleep();
+	/* Fast commit replay only ever marks blocks in use */
+	ext4_fc_mark_ineligible(handle, inode);
 	if (bh) {
 		if (block)
 			BUG_ON(block != bh->b_blocknr);
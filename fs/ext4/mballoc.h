@@ -76,6 +76,27 @@ do {									\
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * pick groups for the 2^N and the good fit criteria from the lists of
+ * groups by largest free order instead of scanning all of them in turn.
+ * We can tune it via /sys/fs/ext4/<partition>/mb_optimize_scan
+ */
+#define MB_DEFAULT_OPTIMIZE_SCAN	1
+
+/*
+ * How many groups of an order list are looked at for each group picked
+ */
+#define MB_OPTIMIZE_SCAN_MAX_GROUPS	64
+
+/* number of buddy orders, order 0 being the bitmap */
+#define MB_NUM_ORDERS(sb)		((sb)->s_blocksize_bits + 2)
+
+/* where the last stream allocation on a cpu ended */
+struct ext4_mb_stream_goal {
+	ext4_group_t	group;
+	ext4_grpblk_t	start;
+};
+
 
 struct ext4_free_data {
 	/* this links the free block information from sb_info */
@@ -2761,6 +2761,7 @@ int ext4_orphan_add(handle_t *handle, struct inode *inode)
 
 	WARN_ON_ONCE(!(inode->i_state & (I_NEW | I_FREEING)) &&
 		     !inode_is_locked(inode));
+	ext4_fc_mark_ineligible(handle, inode);
 	/*
 	 * Exit early if inode already is on orphan list. This is a big speedup
 	 * since we don't have to contend on the global s_orphan_lock.
@@ -3028,6 +3029,7 @@ static int ext4_unlink(struct inode *dir, struct dentry *dentry)
 
 	if (IS_DIRSYNC(dir))
 		ext4_handle_sync(handle);
+	ext4_fc_mark_ineligible(handle, inode);
 
 	if (inode->i_nlink == 0) {
 		ext4_warning_inode(inode, "Deleting file '%.*s' with no links",
@@ -3243,6 +3245,7 @@ static int ext4_link(struct dentry *old_dentry,
 
 	if (IS_DIRSYNC(dir))
 		ext4_handle_sync(handle);
+	ext4_fc_mark_ineligible(handle, inode);
 
 	inode->i_ctime = current_time(inode);
 	ext4_inc_count(handle, inode);
@@ -3592,6 +3595,9 @@ static int ext4_rename(struct inode *old_dir, struct dentry *old_dentry,
 
 	if (IS_DIRSYNC(old.dir) || IS_DIRSYNC(new.dir))
 		ext4_handle_sync(handle);
+	ext4_fc_mark_ineligible(handle, old.inode);
+	if (new.inode)
+		ext4_fc_mark_ineligible(handle, new.inode);
 
 	if (S_ISDIR(old.inode->i_mode)) {
 		if (new.inode) {
@@ -3786,6 +3792,8 @@ static int ext4_cross_rename(struct inode *old_dir, struct dentry *old_dentry,
 
 	if (IS_DIRSYNC(old.dir) || IS_DIRSYNC(new.dir))
 		ext4_handle_sync(handle);
+	ext4_fc_mark_ineligible(handle, old.inode);
+	ext4_fc_mark_ineligible(handle, new.inode);
 
 	if (S_ISDIR(old.inode->i_mode)) {
 		old.is_dir = true;
@@ -115,7 +115,9 @@ int ext4_mpage_readpages(struct address_space *mapping,
 	int length;
 	unsigned relative_block = 0;
 	struct ext4_map_blocks map;
+	struct readahead_batch rab;
 
+	readahead_batch_init(&rab);
 	map.m_pblk = 0;
 	map.m_lblk = 0;
 	map.m_len = 0;
@@ -127,11 +129,10 @@ int ext4_mpage_readpages(struct address_space *mapping,
 
 		prefetchw(&page->flags);
 		if (pages) {
-			page = list_entry(pages->prev, struct page, lru);
-			list_del(&page->lru);
-			if (add_to_page_cache_lru(page, mapping, page->index,
-				  readahead_gfp_mask(mapping)))
-				goto next_page;
+			page = readahead_next_page(mapping, pages, &rab,
+						   readahead_gfp_mask(mapping));
+			if (!page)
+				break;
 		}
 
 		if (page_has_buffers(page))
@@ -2302,6 +2302,7 @@ ext4_xattr_set_handle(handle_t *handle, struct inode *inode, int name_index,
 	if (strlen(name) > 255)
 		return -ERANGE;
 
+	ext4_fc_mark_ineligible(handle, inode);
 	ext4_write_lock_xattr(inode, &no_expand);
 
 	/* Check journal credits under write lock. */
@@ -2690,6 +2691,8 @@ int ext4_expand_extra_isize_ea(struct inode *inode, int new_extra_isize,
 	if (EXT4_I(inode)->i_extra_isize >= new_extra_isize)
 		return 0;
 
+	/* Entries may move out to an xattr block */
+	ext4_fc_mark_ineligible(handle, inode);
 	header = IHDR(inode, raw_inode);
 
 	/*
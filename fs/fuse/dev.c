@@ -309,11 +309,54 @@ static void queue_request(struct fuse_iqueue *fiq, struct fuse_req *req)
 {
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
+	WRITE_ONCE(req->fiq, fiq);
 	list_add_tail(&req->list, &fiq->pending);
 	wake_up_locked(&fiq->waitq);
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 }
 
+/*
+ * Lock the input queue for a new request.  That is the queue bound to the
+ * current CPU if a device reads from it, so that the request is picked up
+ * by a daemon thread on the same CPU, and fc->iq otherwise.  Interrupts
+ * and forgets always go to fc->iq.
+ */
+static struct fuse_iqueue *fuse_lock_iqueue(struct fuse_conn *fc)
+{
+	struct fuse_iqueue **cpu_iqs = READ_ONCE(fc->cpu_iqs);
+	struct fuse_iqueue *fiq;
+
+	if (cpu_iqs) {
+		fiq = READ_ONCE(cpu_iqs[raw_smp_processor_id()]);
+		if (fiq) {
+			spin_lock(&fiq->waitq.lock);
+			if (fiq->nr_devs)
+				return fiq;
+			spin_unlock(&fiq->waitq.lock);
+		}
+	}
+	fiq = &fc->iq;
+	spin_lock(&fiq->waitq.lock);
+	return fiq;
+}
+
+/*
+ * Lock the input queue a pending request was put on.  The request may be
+ * moved to fc->iq by fuse_iqueue_unbind() until the lock is held.
+ */
+static struct fuse_iqueue *fuse_req_lock_iqueue(struct fuse_req *req)
+{
+	struct fuse_iqueue *fiq;
+
+	for (;;) {
+		fiq = READ_ONCE(req->fiq);
+		spin_lock(&fiq->waitq.lock);
+		if (fiq == req->fiq)
+			return fiq;
+		spin_unlock(&fiq->waitq.lock);
+	}
+}
+
 void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 		       u64 nodeid, u64 nlookup)
 {
@@ -339,12 +382,12 @@ static void flush_bg_queue(struct fuse_conn *fc)
 	while (fc->active_background < fc->max_background &&
 	       !list_empty(&fc->bg_queue)) {
 		struct fuse_req *req;
-		struct fuse_iqueue *fiq = &fc->iq;
+		struct fuse_iqueue *fiq;
 
 		req = list_entry(fc->bg_queue.next, struct fuse_req, list);
 		list_del(&req->list);
 		fc->active_background++;
-		spin_lock(&fiq->waitq.lock);
+		fiq = fuse_lock_iqueue(fc);
 		req->in.h.unique = fuse_get_unique(fiq);
 		queue_request(fiq, req);
 		spin_unlock(&fiq->waitq.lock);
@@ -414,7 +457,7 @@ static void queue_interrupt(struct fuse_iqueue *fiq, struct fuse_req *req)
 
 static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 	int err;
 
 	if (!fc->no_interrupt) {
@@ -428,7 +471,7 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 		/* matches barrier in fuse_dev_do_read() */
 		smp_mb__after_atomic();
 		if (test_bit(FR_SENT, &req->flags))
-			queue_interrupt(fiq, req);
+			queue_interrupt(&fc->iq, req);
 	}
 
 	if (!test_bit(FR_FORCE, &req->flags)) {
@@ -438,7 +481,7 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 		if (!err)
 			return;
 
-		spin_lock(&fiq->waitq.lock);
+		fiq = fuse_req_lock_iqueue(req);
 		/* Request is not yet in userspace, bail out */
 		if (test_bit(FR_PENDING, &req->flags)) {
 			list_del(&req->list);
@@ -459,10 +502,10 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 
 static void __fuse_request_send(struct fuse_conn *fc, struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 
 	BUG_ON(test_bit(FR_BACKGROUND, &req->flags));
-	spin_lock(&fiq->waitq.lock);
+	fiq = fuse_lock_iqueue(fc);
 	if (!fiq->connected) {
 		spin_unlock(&fiq->waitq.lock);
 		req->out.h.error = -ENOTCONN;
@@ -1216,7 +1259,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 {
 	ssize_t err;
 	struct fuse_conn *fc = fud->fc;
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq = fud->fiq;
 	struct fuse_pqueue *fpq = &fud->pq;
 	struct fuse_req *req;
 	struct fuse_in *in;
@@ -1304,7 +1347,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	/* matches barrier in request_wait_answer() */
 	smp_mb__after_atomic();
 	if (test_bit(FR_INTERRUPTED, &req->flags))
-		queue_interrupt(fiq, req);
+		queue_interrupt(&fc->iq, req);
 
 	return reqsize;
 
@@ -2013,7 +2056,7 @@ static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 	if (!fud)
 		return POLLERR;
 
-	fiq = &fud->fc->iq;
+	fiq = fud->fiq;
 	poll_wait(file, &fiq->waitq, wait);
 
 	spin_lock(&fiq->waitq.lock);
@@ -2076,10 +2119,24 @@ static void end_polls(struct fuse_conn *fc)
  * is OK, the request will in that case be removed from the list before we touch
  * it.
  */
-void fuse_abort_conn(struct fuse_conn *fc)
+static void fuse_abort_iqueue(struct fuse_iqueue *fiq, struct list_head *to_end)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_req *req;
+
+	spin_lock(&fiq->waitq.lock);
+	fiq->connected = 0;
+	list_for_each_entry(req, &fiq->pending, list)
+		clear_bit(FR_PENDING, &req->flags);
+	list_splice_tail_init(&fiq->pending, to_end);
+	while (forget_pending(fiq))
+		kfree(dequeue_forget(fiq, 1, NULL));
+	wake_up_all_locked(&fiq->waitq);
+	spin_unlock(&fiq->waitq.lock);
+	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+}
 
+void fuse_abort_conn(struct fuse_conn *fc)
+{
 	spin_lock(&fc->lock);
 	if (fc->connected) {
 		struct fuse_dev *fud;
@@ -2111,16 +2168,16 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		fc->max_background = UINT_MAX;
 		flush_bg_queue(fc);
 
-		spin_lock(&fiq->waitq.lock);
-		fiq->connected = 0;
-		list_splice_init(&fiq->pending, &to_end2);
-		list_for_each_entry(req, &to_end2, list)
-			clear_bit(FR_PENDING, &req->flags);
-		while (forget_pending(fiq))
-			kfree(dequeue_forget(fiq, 1, NULL));
-		wake_up_all_locked(&fiq->waitq);
-		spin_unlock(&fiq->waitq.lock);
-		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+		fuse_abort_iqueue(&fc->iq, &to_end2);
+		if (fc->cpu_iqs) {
+			int cpu;
+
+			for_each_possible_cpu(cpu) {
+				if (fc->cpu_iqs[cpu])
+					fuse_abort_iqueue(fc->cpu_iqs[cpu],
+							  &to_end2);
+			}
+		}
 		end_polls(fc);
 		wake_up_all(&fc->blocked_waitq);
 		spin_unlock(&fc->lock);
@@ -2138,6 +2195,31 @@ void fuse_abort_conn(struct fuse_conn *fc)
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
+/*
+ * Called when a device bound to a per-CPU queue goes away.  When it was
+ * the last one, new requests go to fc->iq again and those that are still
+ * pending are moved there.
+ */
+static void fuse_iqueue_unbind(struct fuse_conn *fc, struct fuse_iqueue *fiq)
+{
+	struct fuse_iqueue *main_fiq = &fc->iq;
+	struct fuse_req *req;
+
+	spin_lock(&fc->lock);
+	spin_lock(&fiq->waitq.lock);
+	if (!--fiq->nr_devs && !list_empty(&fiq->pending)) {
+		spin_lock_nested(&main_fiq->waitq.lock, SINGLE_DEPTH_NESTING);
+		list_for_each_entry(req, &fiq->pending, list)
+			WRITE_ONCE(req->fiq, main_fiq);
+		list_splice_tail_init(&fiq->pending, &main_fiq->pending);
+		wake_up_locked(&main_fiq->waitq);
+		spin_unlock(&main_fiq->waitq.lock);
+		kill_fasync(&main_fiq->fasync, SIGIO, POLL_IN);
+	}
+	spin_unlock(&fiq->waitq.lock);
+	spin_unlock(&fc->lock);
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
 	struct fuse_dev *fud = fuse_get_dev(file);
@@ -2148,6 +2230,8 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 
 		WARN_ON(!list_empty(&fpq->io));
 		end_requests(fc, &fpq->processing);
+		if (fud->fiq != &fc->iq)
+			fuse_iqueue_unbind(fc, fud->fiq);
 		/* Are we the last open device? */
 		if (atomic_dec_and_test(&fc->dev_count)) {
 			WARN_ON(fc->iq.fasync != NULL);
@@ -2167,7 +2251,67 @@ static int fuse_dev_fasync(int fd, struct file *file, int on)
 		return -EPERM;
 
 	/* No locking - fasync_helper does its own locking */
-	return fasync_helper(fd, file, on, &fud->fc->iq.fasync);
+	return fasync_helper(fd, file, on, &fud->fiq->fasync);
+}
+
+/*
+ * Bind a device to the input queue of a CPU.  Requests sent from that CPU
+ * are then read from the devices bound to it rather than from fc->iq.
+ * Interrupts, forgets and requests from CPUs without a bound device are
+ * still read from fc->iq, so the daemon must keep some unbound reader.
+ */
+static int fuse_device_bind_cpu(struct fuse_dev *fud, u32 cpu)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_iqueue **cpu_iqs = NULL;
+	struct fuse_iqueue *fiq;
+	int err;
+
+	if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+
+	if (!fc->cpu_iqs) {
+		cpu_iqs = kcalloc(nr_cpu_ids, sizeof(*cpu_iqs), GFP_KERNEL);
+		if (!cpu_iqs)
+			return -ENOMEM;
+	}
+	fiq = kmalloc(sizeof(*fiq), GFP_KERNEL);
+	if (!fiq) {
+		kfree(cpu_iqs);
+		return -ENOMEM;
+	}
+	fuse_iqueue_init(fiq);
+	/* Keep request ids unique across all queues of the connection */
+	fiq->reqctr = (u64) (cpu + 1) << 48;
+
+	spin_lock(&fc->lock);
+	err = -ENOTCONN;
+	if (!fc->connected)
+		goto out_unlock;
+	err = -EBUSY;
+	if (fud->fiq != &fc->iq)
+		goto out_unlock;
+
+	if (!fc->cpu_iqs) {
+		/* Pairs with READ_ONCE() in fuse_lock_iqueue() */
+		smp_store_release(&fc->cpu_iqs, cpu_iqs);
+		cpu_iqs = NULL;
+	}
+	if (!fc->cpu_iqs[cpu]) {
+		smp_store_release(&fc->cpu_iqs[cpu], fiq);
+		fiq = NULL;
+	}
+	fud->fiq = fc->cpu_iqs[cpu];
+	spin_lock(&fud->fiq->waitq.lock);
+	fud->fiq->nr_devs++;
+	spin_unlock(&fud->fiq->waitq.lock);
+	err = 0;
+out_unlock:
+	spin_unlock(&fc->lock);
+	kfree(fiq);
+	kfree(cpu_iqs);
+
+	return err;
 }
 
 static int fuse_device_clone(struct fuse_conn *fc, struct file *new)
@@ -2219,6 +2363,39 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 				fput(old);
 			}
 		}
+	} else if (cmd == FUSE_DEV_IOC_BACKING_OPEN) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+		struct fuse_backing_map map;
+
+		err = -EINVAL;
+		if (!fud)
+			return err;
+
+		err = -EFAULT;
+		if (!copy_from_user(&map, (void __user *) arg, sizeof(map)))
+			err = fuse_backing_open(fud->fc, &map);
+	} else if (cmd == FUSE_DEV_IOC_BACKING_CLOSE) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+		int backing_id;
+
+		err = -EINVAL;
+		if (!fud)
+			return err;
+
+		err = -EFAULT;
+		if (!get_user(backing_id, (__u32 __user *) arg))
+			err = fuse_backing_close(fud->fc, backing_id);
+	} else if (cmd == FUSE_DEV_IOC_BIND_CPU) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+		u32 cpu;
+
+		err = -EINVAL;
+		if (!fud)
+			return err;
+
+		err = -EFAULT;
+		if (!get_user(cpu, (__u32 __user *) arg))
+			err = fuse_device_bind_cpu(fud, cpu);
 	}
 	return err;
 }
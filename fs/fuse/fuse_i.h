@@ -26,6 +26,7 @@
 #include <linux/xattr.h>
 #include <linux/pid_namespace.h>
 #include <linux/refcount.h>
+#include <linux/idr.h>
 
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
@@ -42,6 +43,8 @@
 /** Number of page pointers embedded in fuse_req */
 #define FUSE_REQ_INLINE_PAGES 1
 
+#define FUSE_SUPER_MAGIC 0x65735546
+
 /** List of active connections */
 extern struct list_head fuse_conn_list;
 
@@ -153,6 +156,9 @@ struct fuse_file {
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
 
+	/** Backing file for FOPEN_PASSTHROUGH, or NULL */
+	struct file *passthrough;
+
 	/** Has flock been performed on this file? */
 	bool flock:1;
 };
@@ -313,6 +319,9 @@ struct fuse_req {
 	/** Unique ID for the interrupt request */
 	u64 intr_unique;
 
+	/** Input queue the request was put on, see fuse_req_lock_iqueue() */
+	struct fuse_iqueue *fiq;
+
 	/* Request flags, updated with test/set/clear_bit() */
 	unsigned long flags;
 
@@ -408,6 +417,9 @@ struct fuse_iqueue {
 
 	/** O_ASYNC requests */
 	struct fasync_struct *fasync;
+
+	/** Number of devices reading a per-CPU queue, zero for fc->iq */
+	unsigned nr_devs;
 };
 
 struct fuse_pqueue {
@@ -434,6 +446,9 @@ struct fuse_dev {
 	/** Processing queue */
 	struct fuse_pqueue pq;
 
+	/** Input queue this device reads from */
+	struct fuse_iqueue *fiq;
+
 	/** list entry on fc->devices */
 	struct list_head entry;
 };
@@ -475,6 +490,13 @@ struct fuse_conn {
 	/** Input queue */
 	struct fuse_iqueue iq;
 
+	/**
+	 * Per-CPU input queues, indexed by CPU and allocated when the
+	 * first device is bound to a CPU.  Entries are never freed before
+	 * the connection is released.
+	 */
+	struct fuse_iqueue **cpu_iqs;
+
 	/** The next unique kernel file handle */
 	u64 khctr;
 
@@ -541,6 +563,9 @@ struct fuse_conn {
 	/** handle fs handles killing suid/sgid/cap on write/chown/trunc */
 	unsigned handle_killpriv:1;
 
+	/** may files be opened with FOPEN_PASSTHROUGH?  Only set in INIT */
+	unsigned passthrough:1;
+
 	/*
 	 * The following bitfields are only for optimization purposes
 	 * and hence races in setting them will not cause malfunction
@@ -639,6 +664,9 @@ struct fuse_conn {
 	/** Device ID from super block */
 	dev_t dev;
 
+	/** Backing files registered by the daemon, protected by lock */
+	struct idr backing_files_map;
+
 	/** Dentries in the control filesystem */
 	struct dentry *ctl_dentry[FUSE_CTL_NUM_DENTRIES];
 
@@ -872,6 +900,11 @@ struct fuse_conn *fuse_conn_get(struct fuse_conn *fc);
  */
 void fuse_conn_init(struct fuse_conn *fc);
 
+/**
+ * Initialize fuse_iqueue
+ */
+void fuse_iqueue_init(struct fuse_iqueue *fiq);
+
 /**
  * Release reference to fuse_conn
  */
@@ -980,4 +1013,16 @@ struct posix_acl;
 struct posix_acl *fuse_get_acl(struct inode *inode, int type);
 int fuse_set_acl(struct inode *inode, struct posix_acl *acl, int type);
 
+/* passthrough.c */
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map);
+int fuse_backing_close(struct fuse_conn *fc, int backing_id);
+void fuse_backing_files_free(struct fuse_conn *fc);
+void fuse_passthrough_open(struct fuse_conn *fc, struct fuse_file *ff,
+			   int backing_id);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb,
+				    struct iov_iter *from);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,227 @@
+/*
+  FUSE: Filesystem in Userspace
+  Copyright (C) 2001-2008  Miklos Szeredi <miklos@szeredi.hu>
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/cred.h>
+#include <linux/file.h>
+#include <linux/pagemap.h>
+#include <linux/uio.h>
+
+/*
+ * The daemon registers an open file with FUSE_DEV_IOC_BACKING_OPEN and
+ * gets back an id.  Replying to OPEN or CREATE with FOPEN_PASSTHROUGH and
+ * that id makes read, write and mmap on the FUSE file go straight to the
+ * backing file, without a round trip through userspace.
+ */
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map)
+{
+	struct file *file;
+	int res;
+
+	res = -EPERM;
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		goto out;
+
+	res = -EINVAL;
+	if (map->flags || map->padding)
+		goto out;
+
+	res = -EBADF;
+	file = fget(map->fd);
+	if (!file)
+		goto out;
+
+	/* Needs the iter methods, and no stacking on another FUSE file */
+	res = -EINVAL;
+	if (file_inode(file)->i_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !file->f_op->read_iter || !file->f_op->write_iter)
+		goto out_fput;
+
+	idr_preload(GFP_KERNEL);
+	spin_lock(&fc->lock);
+	res = idr_alloc_cyclic(&fc->backing_files_map, file, 1, 0, GFP_ATOMIC);
+	spin_unlock(&fc->lock);
+	idr_preload_end();
+	if (res > 0)
+		return res;
+
+out_fput:
+	fput(file);
+out:
+	return res;
+}
+
+int fuse_backing_close(struct fuse_conn *fc, int backing_id)
+{
+	struct file *file;
+
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (backing_id <= 0)
+		return -EINVAL;
+
+	spin_lock(&fc->lock);
+	file = idr_remove(&fc->backing_files_map, backing_id);
+	spin_unlock(&fc->lock);
+	if (!file)
+		return -ENOENT;
+
+	/* Files already opened in passthrough mode hold their own reference */
+	fput(file);
+	return 0;
+}
+
+void fuse_backing_files_free(struct fuse_conn *fc)
+{
+	struct file *file;
+	int id;
+
+	idr_for_each_entry(&fc->backing_files_map, file, id)
+		fput(file);
+	idr_destroy(&fc->backing_files_map);
+}
+
+/*
+ * If the id doesn't name a backing file the open still succeeds, and IO
+ * on it is sent to the daemon as usual.
+ */
+void fuse_passthrough_open(struct fuse_conn *fc, struct fuse_file *ff,
+			   int backing_id)
+{
+	struct file *file = NULL;
+
+	if (fc->passthrough && backing_id > 0) {
+		spin_lock(&fc->lock);
+		file = idr_find(&fc->backing_files_map, backing_id);
+		if (file)
+			get_file(file);
+		spin_unlock(&fc->lock);
+	}
+
+	if (!file) {
+		pr_warn_ratelimited("fuse: no backing file %d for passthrough open\n",
+				    backing_id);
+		ff->open_flags &= ~FOPEN_PASSTHROUGH;
+		return;
+	}
+
+	/* The backing file does its own caching */
+	ff->open_flags &= ~FOPEN_DIRECT_IO;
+	ff->passthrough = file;
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough) {
+		fput(ff->passthrough);
+		ff->passthrough = NULL;
+	}
+}
+
+static rwf_t fuse_iocb_to_rwf(int ki_flags)
+{
+	rwf_t flags = 0;
+
+	if (ki_flags & IOCB_HIPRI)
+		flags |= RWF_HIPRI;
+	if (ki_flags & IOCB_DSYNC)
+		flags |= RWF_DSYNC;
+	if (ki_flags & IOCB_SYNC)
+		flags |= RWF_SYNC;
+	if (ki_flags & IOCB_NOWAIT)
+		flags |= RWF_NOWAIT;
+
+	return flags;
+}
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(to))
+		return 0;
+
+	old_cred = override_creds(backing->f_cred);
+	ret = vfs_iter_read(backing, to, &iocb->ki_pos,
+			    fuse_iocb_to_rwf(iocb->ki_flags));
+	revert_creds(old_cred);
+
+	fuse_invalidate_atime(file_inode(file));
+	return ret;
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough;
+	const struct cred *old_cred;
+	loff_t pos;
+	ssize_t ret;
+
+	if (!iov_iter_count(from))
+		return 0;
+
+	inode_lock(inode);
+	if (iocb->ki_flags & IOCB_APPEND)
+		iocb->ki_pos = i_size_read(file_inode(backing));
+	pos = iocb->ki_pos;
+
+	old_cred = override_creds(backing->f_cred);
+	file_start_write(backing);
+	ret = vfs_iter_write(backing, from, &iocb->ki_pos,
+			     fuse_iocb_to_rwf(iocb->ki_flags));
+	file_end_write(backing);
+	revert_creds(old_cred);
+
+	if (ret > 0) {
+		fuse_write_update_size(inode, iocb->ki_pos);
+		/* Drop pages cached by a non-passthrough open */
+		if (inode->i_mapping->nrpages)
+			invalidate_inode_pages2_range(inode->i_mapping,
+					pos >> PAGE_SHIFT,
+					(iocb->ki_pos - 1) >> PAGE_SHIFT);
+	}
+	fuse_invalidate_attr(inode);
+	inode_unlock(inode);
+
+	return ret;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough;
+	const struct cred *old_cred;
+	int ret;
+
+	if (!backing->f_op->mmap)
+		return -ENODEV;
+
+	vma->vm_file = get_file(backing);
+
+	old_cred = override_creds(backing->f_cred);
+	ret = call_mmap(backing, vma);
+	revert_creds(old_cred);
+
+	if (ret) {
+		/* Drop the reference taken for the new vm_file */
+		fput(backing);
+	} else {
+		/* Drop the reference held by the previous vm_file */
+		fput(file);
+	}
+	return ret;
+}
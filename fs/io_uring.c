@@ -0,0 +1,1581 @@
+/*
+ * Shared application/kernel submission and completion ring pairs, for
+ * supporting fast/efficient IO.
+ *
+ * io_uring_setup() returns a file which the application maps three
+ * regions of: the submission queue ring (SQ), the array of submission
+ * queue entries (sqes) it indexes, and the completion queue ring (CQ).
+ * The application fills in sqes, stores their indices in the SQ and
+ * bumps its tail; io_uring_enter() consumes them, unless a kernel thread
+ * polls the SQ on its behalf (IORING_SETUP_SQPOLL). Every sqe consumed
+ * gets a cqe appended to the CQ, which the application reaps by bumping
+ * the CQ head. Submitting and reaping thus need no system call per IO,
+ * and none at all when the kernel polls the SQ.
+ *
+ * The head of a ring is only written by its consumer and the tail by
+ * its producer. A store of either is a store-release, ordering the
+ * entries before it, and is read with a load-acquire on the other side.
+ * The kernel copies an sqe before it looks at it, so the slot is free
+ * again as soon as it has moved the SQ head past it.
+ *
+ * Requests are first issued with IOCB_NOWAIT. One which would have to
+ * block, say a buffered read missing the page cache or a buffered write,
+ * is issued again from a workqueue, which blocks in its place.
+ *
+ * With IORING_SETUP_IOPOLL, direct IO completions are not signalled:
+ * io_uring_enter(IORING_ENTER_GETEVENTS) polls the device queues for
+ * them through ->iopoll(), and so does the SQ thread if there is one.
+ * Requests then go on the poll list until reaped from there.
+ *
+ * Files and buffers can be registered once with io_uring_register(),
+ * sparing each IO the fget() and get_user_pages() it would otherwise
+ * take. A registered buffer is used with IORING_OP_{READ,WRITE}_FIXED,
+ * a registered file by setting IOSQE_FIXED_FILE and passing its index.
+ */
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/errno.h>
+#include <linux/syscalls.h>
+#include <linux/uio.h>
+
+#include <linux/sched/signal.h>
+#include <linux/sched/mm.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/mmu_context.h>
+#include <linux/poll.h>
+#include <linux/percpu-refcount.h>
+#include <linux/slab.h>
+#include <linux/sizes.h>
+#include <linux/workqueue.h>
+#include <linux/kthread.h>
+#include <linux/bvec.h>
+#include <linux/anon_inodes.h>
+#include <linux/uaccess.h>
+
+#include <uapi/linux/io_uring.h>
+
+#include "internal.h"
+
+#define IORING_MAX_ENTRIES	4096
+#define IORING_MAX_FIXED_FILES	1024
+
+struct io_uring {
+	u32 head ____cacheline_aligned_in_smp;
+	u32 tail ____cacheline_aligned_in_smp;
+};
+
+/* The rings as the application sees them, see struct io_*ring_offsets */
+struct io_sq_ring {
+	struct io_uring		r;
+	u32			ring_mask;
+	u32			ring_entries;
+	u32			dropped;
+	u32			flags;
+	u32			array[];
+};
+
+struct io_cq_ring {
+	struct io_uring		r;
+	u32			ring_mask;
+	u32			ring_entries;
+	u32			overflow;
+	struct io_uring_cqe	cqes[] ____cacheline_aligned_in_smp;
+};
+
+struct io_mapped_ubuf {
+	u64		ubuf;
+	size_t		len;
+	struct bio_vec	*bvec;
+	unsigned int	nr_bvecs;
+};
+
+struct io_ring_ctx {
+	/* held by each request, and by io_uring_enter() */
+	struct percpu_ref	refs;
+	unsigned int		flags;
+	bool			account_mem;
+
+	/*
+	 * Submission side: the SQ is consumed under uring_lock, and only
+	 * by sqo_thread with IORING_SETUP_SQPOLL.
+	 */
+	struct io_sq_ring	*sq_ring;
+	struct io_uring_sqe	*sq_sqes;
+	unsigned int		cached_sq_head;
+	unsigned int		sq_entries;
+	unsigned int		sq_mask;
+	unsigned int		sq_thread_idle;
+
+	struct task_struct	*sqo_thread;	/* IORING_SETUP_SQPOLL */
+	wait_queue_head_t	sqo_wait;
+	struct workqueue_struct	*sqo_wq;	/* requests which block */
+	struct mm_struct	*sqo_mm;
+	const struct cred	*creds;
+
+	/* registered with io_uring_register(), under uring_lock */
+	struct file		**user_files;
+	unsigned int		nr_user_files;
+	struct io_mapped_ubuf	*user_bufs;
+	unsigned int		nr_user_bufs;
+	struct user_struct	*user;
+
+	struct mutex		uring_lock;
+	struct completion	ctx_done;
+
+	/* IORING_SETUP_IOPOLL requests in flight, under uring_lock */
+	struct list_head	poll_list;
+
+	/* Completion side, filled under completion_lock */
+	struct io_cq_ring	*cq_ring ____cacheline_aligned_in_smp;
+	unsigned int		cached_cq_tail;
+	unsigned int		cq_entries;
+	unsigned int		cq_mask;
+	spinlock_t		completion_lock;
+	wait_queue_head_t	cq_wait;
+};
+
+struct io_kiocb {
+	struct kiocb		rw;
+	struct io_ring_ctx	*ctx;
+	unsigned int		flags;
+#define REQ_F_FIXED_FILE	1	/* rw.ki_filp is a registered file */
+	struct list_head	list;		/* on ctx->poll_list */
+	long			result;		/* with IORING_SETUP_IOPOLL */
+	bool			iopoll_completed;
+	struct work_struct	work;
+	struct io_uring_sqe	sqe;	/* copy of the application's */
+};
+
+static struct kmem_cache *req_cachep;
+
+static const struct file_operations io_uring_fops;
+
+static void io_ring_ctx_ref_free(struct percpu_ref *ref)
+{
+	struct io_ring_ctx *ctx = container_of(ref, struct io_ring_ctx, refs);
+
+	complete(&ctx->ctx_done);
+}
+
+static struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
+{
+	struct io_ring_ctx *ctx;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return NULL;
+
+	if (percpu_ref_init(&ctx->refs, io_ring_ctx_ref_free, 0, GFP_KERNEL)) {
+		kfree(ctx);
+		return NULL;
+	}
+
+	ctx->flags = p->flags;
+	init_waitqueue_head(&ctx->sqo_wait);
+	init_waitqueue_head(&ctx->cq_wait);
+	init_completion(&ctx->ctx_done);
+	mutex_init(&ctx->uring_lock);
+	INIT_LIST_HEAD(&ctx->poll_list);
+	spin_lock_init(&ctx->completion_lock);
+	return ctx;
+}
+
+static struct io_uring_cqe *io_get_cqring(struct io_ring_ctx *ctx)
+{
+	struct io_cq_ring *ring = ctx->cq_ring;
+	unsigned int tail = ctx->cached_cq_tail;
+
+	if (tail - READ_ONCE(ring->r.head) == ctx->cq_entries)
+		return NULL;
+
+	ctx->cached_cq_tail++;
+	return &ring->cqes[tail & ctx->cq_mask];
+}
+
+static void io_cqring_add_event(struct io_ring_ctx *ctx, u64 user_data,
+				long res)
+{
+	struct io_cq_ring *ring = ctx->cq_ring;
+	struct io_uring_cqe *cqe;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	cqe = io_get_cqring(ctx);
+	if (cqe) {
+		WRITE_ONCE(cqe->user_data, user_data);
+		WRITE_ONCE(cqe->res, res);
+		WRITE_ONCE(cqe->flags, 0);
+		/* Paired with the application's load-acquire of the tail */
+		smp_store_release(&ring->r.tail, ctx->cached_cq_tail);
+	} else {
+		/* The CQ is full: the application only learns it lost one */
+		WRITE_ONCE(ring->overflow, READ_ONCE(ring->overflow) + 1);
+	}
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+
+	if (wq_has_sleeper(&ctx->cq_wait))
+		wake_up(&ctx->cq_wait);
+}
+
+static unsigned int io_cqring_events(struct io_ring_ctx *ctx)
+{
+	struct io_cq_ring *ring = ctx->cq_ring;
+
+	return READ_ONCE(ring->r.tail) - READ_ONCE(ring->r.head);
+}
+
+static struct io_kiocb *io_get_req(struct io_ring_ctx *ctx)
+{
+	struct io_kiocb *req;
+
+	/* Fails while io_uring_register() waits for the ring to go idle */
+	if (!percpu_ref_tryget_live(&ctx->refs))
+		return NULL;
+
+	req = kmem_cache_alloc(req_cachep, GFP_KERNEL);
+	if (!req) {
+		percpu_ref_put(&ctx->refs);
+		return NULL;
+	}
+
+	req->ctx = ctx;
+	req->flags = 0;
+	req->rw.ki_filp = NULL;
+	return req;
+}
+
+static void io_free_req(struct io_kiocb *req)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+
+	if (req->rw.ki_filp && !(req->flags & REQ_F_FIXED_FILE))
+		fput(req->rw.ki_filp);
+	kmem_cache_free(req_cachep, req);
+	percpu_ref_put(&ctx->refs);
+}
+
+static void kiocb_end_write(struct kiocb *kiocb)
+{
+	if (kiocb->ki_flags & IOCB_WRITE) {
+		struct inode *inode = file_inode(kiocb->ki_filp);
+
+		/*
+		 * Tell lockdep we inherited freeze protection from submission
+		 * thread.
+		 */
+		if (S_ISREG(inode->i_mode))
+			__sb_writers_acquired(inode->i_sb, SB_FREEZE_WRITE);
+		file_end_write(kiocb->ki_filp);
+	}
+}
+
+/* Also the ->ki_complete() of the requests completing asynchronously */
+static void io_complete_rw(struct kiocb *kiocb, long res, long res2)
+{
+	struct io_kiocb *req = container_of(kiocb, struct io_kiocb, rw);
+
+	kiocb_end_write(kiocb);
+	io_cqring_add_event(req->ctx, req->sqe.user_data, res);
+	io_free_req(req);
+}
+
+/*
+ * ->ki_complete() of IORING_SETUP_IOPOLL requests: only record the
+ * result, the poller posts it and frees the request.
+ */
+static void io_complete_rw_iopoll(struct kiocb *kiocb, long res, long res2)
+{
+	struct io_kiocb *req = container_of(kiocb, struct io_kiocb, rw);
+
+	kiocb_end_write(kiocb);
+	req->result = res;
+	/* Paired with the load-acquire in io_do_iopoll() */
+	smp_store_release(&req->iopoll_completed, true);
+}
+
+/* Post and free the requests of the poll list which completed */
+static int io_do_iopoll(struct io_ring_ctx *ctx)
+{
+	struct io_kiocb *req, *tmp;
+	int ret = 0;
+
+	list_for_each_entry_safe(req, tmp, &ctx->poll_list, list) {
+		struct kiocb *kiocb = &req->rw;
+
+		if (!smp_load_acquire(&req->iopoll_completed)) {
+			ret = kiocb->ki_filp->f_op->iopoll(kiocb);
+			if (ret < 0)
+				break;
+			ret = 0;
+			if (!smp_load_acquire(&req->iopoll_completed))
+				continue;
+		}
+
+		list_del(&req->list);
+		io_cqring_add_event(ctx, req->sqe.user_data, req->result);
+		io_free_req(req);
+	}
+
+	return ret;
+}
+
+/*
+ * Poll until there are @min_events in the CQ, or until nothing is left
+ * to poll for.
+ */
+static int io_iopoll_check(struct io_ring_ctx *ctx, unsigned int min_events)
+{
+	bool empty;
+	int ret;
+
+	for (;;) {
+		/* Let the workqueue add requests between rounds */
+		mutex_lock(&ctx->uring_lock);
+		ret = io_do_iopoll(ctx);
+		empty = list_empty(&ctx->poll_list);
+		mutex_unlock(&ctx->uring_lock);
+
+		if (ret < 0 || empty || io_cqring_events(ctx) >= min_events)
+			break;
+		if (signal_pending(current)) {
+			ret = -EINTR;
+			break;
+		}
+		cond_resched();
+	}
+
+	return ret;
+}
+
+/* Reap all IORING_SETUP_IOPOLL requests, once no new ones can come */
+static void io_iopoll_reap_events(struct io_ring_ctx *ctx)
+{
+	if (!(ctx->flags & IORING_SETUP_IOPOLL))
+		return;
+
+	/* Requests retried from the workqueue end up on the poll list */
+	if (ctx->sqo_wq)
+		flush_workqueue(ctx->sqo_wq);
+
+	mutex_lock(&ctx->uring_lock);
+	while (!list_empty(&ctx->poll_list)) {
+		io_do_iopoll(ctx);
+		cond_resched();
+	}
+	mutex_unlock(&ctx->uring_lock);
+}
+
+static inline void io_rw_done(struct kiocb *kiocb, ssize_t ret)
+{
+	switch (ret) {
+	case -EIOCBQUEUED:
+		break;
+	case -ERESTARTSYS:
+	case -ERESTARTNOINTR:
+	case -ERESTARTNOHAND:
+	case -ERESTART_RESTARTBLOCK:
+		/*
+		 * We can't just restart the syscall, since previously
+		 * submitted sqes may already be in progress. Just fail this
+		 * IO with EINTR.
+		 */
+		ret = -EINTR;
+		/* fall through */
+	default:
+		kiocb->ki_complete(kiocb, ret, 0);
+	}
+}
+
+static int io_prep_rw(struct io_kiocb *req, bool force_nonblock)
+{
+	const struct io_uring_sqe *sqe = &req->sqe;
+	struct kiocb *kiocb = &req->rw;
+	struct file *file = kiocb->ki_filp;
+	int ret;
+
+	if (unlikely(sqe->ioprio))
+		return -EINVAL;
+
+	kiocb->ki_pos = sqe->off;
+	kiocb->ki_flags = iocb_flags(file);
+	kiocb->ki_hint = file_write_hint(file);
+
+	ret = kiocb_set_rw_flags(kiocb, sqe->rw_flags);
+	if (unlikely(ret))
+		return ret;
+
+	if (force_nonblock) {
+		/* Files which can't say they'd block go to the workqueue */
+		if (!(file->f_mode & FMODE_NOWAIT))
+			return -EAGAIN;
+		kiocb->ki_flags |= IOCB_NOWAIT;
+	}
+
+	if (req->ctx->flags & IORING_SETUP_IOPOLL) {
+		if (!(kiocb->ki_flags & IOCB_DIRECT) || !file->f_op->iopoll)
+			return -EOPNOTSUPP;
+
+		kiocb->ki_flags |= IOCB_HIPRI;
+		kiocb->ki_complete = io_complete_rw_iopoll;
+		req->iopoll_completed = false;
+	} else {
+		/* only an IOPOLL ring reaps its completions by polling */
+		kiocb->ki_flags &= ~IOCB_HIPRI;
+		kiocb->ki_complete = io_complete_rw;
+	}
+	return 0;
+}
+
+static int io_import_fixed(struct io_ring_ctx *ctx, int rw,
+			   const struct io_uring_sqe *sqe,
+			   struct iov_iter *iter)
+{
+	size_t len = sqe->len;
+	struct io_mapped_ubuf *imu;
+	unsigned int index;
+	u64 buf_addr;
+	size_t offset;
+
+	if (unlikely(!ctx->user_bufs))
+		return -EFAULT;
+
+	index = sqe->buf_index;
+	if (unlikely(index >= ctx->nr_user_bufs))
+		return -EFAULT;
+
+	imu = &ctx->user_bufs[index];
+	buf_addr = sqe->addr;
+
+	/* The range must be within the registered buffer */
+	if (buf_addr + len < buf_addr)
+		return -EFAULT;
+	if (buf_addr < imu->ubuf || buf_addr + len > imu->ubuf + imu->len)
+		return -EFAULT;
+
+	offset = buf_addr - imu->ubuf;
+	iov_iter_bvec(iter, ITER_BVEC | rw, imu->bvec, imu->nr_bvecs,
+		      offset + len);
+	if (offset)
+		iov_iter_advance(iter, offset);
+	return 0;
+}
+
+static int io_import_iovec(struct io_ring_ctx *ctx, int rw,
+			   struct io_kiocb *req, struct iovec **iovec,
+			   struct iov_iter *iter)
+{
+	const struct io_uring_sqe *sqe = &req->sqe;
+
+	if (sqe->opcode == IORING_OP_READ_FIXED ||
+	    sqe->opcode == IORING_OP_WRITE_FIXED) {
+		*iovec = NULL;
+		return io_import_fixed(ctx, rw, sqe, iter);
+	}
+
+	return import_iovec(rw, u64_to_user_ptr(sqe->addr), sqe->len,
+			    UIO_FASTIOV, iovec, iter);
+}
+
+static int io_read(struct io_kiocb *req, bool force_nonblock)
+{
+	struct iovec inline_vecs[UIO_FASTIOV], *iovec = inline_vecs;
+	struct kiocb *kiocb = &req->rw;
+	struct file *file = kiocb->ki_filp;
+	struct iov_iter iter;
+	int ret;
+
+	if (unlikely(!(file->f_mode & FMODE_READ)))
+		return -EBADF;
+	if (unlikely(!file->f_op->read_iter))
+		return -EINVAL;
+
+	ret = io_prep_rw(req, force_nonblock);
+	if (ret)
+		return ret;
+
+	ret = io_import_iovec(req->ctx, READ, req, &iovec, &iter);
+	if (ret)
+		return ret;
+
+	ret = rw_verify_area(READ, file, &kiocb->ki_pos, iov_iter_count(&iter));
+	if (!ret) {
+		ssize_t ret2 = call_read_iter(file, kiocb, &iter);
+
+		if (!force_nonblock || ret2 != -EAGAIN)
+			io_rw_done(kiocb, ret2);
+		else
+			ret = -EAGAIN;
+	}
+	kfree(iovec);
+	return ret;
+}
+
+static int io_write(struct io_kiocb *req, bool force_nonblock)
+{
+	struct iovec inline_vecs[UIO_FASTIOV], *iovec = inline_vecs;
+	struct kiocb *kiocb = &req->rw;
+	struct file *file = kiocb->ki_filp;
+	struct iov_iter iter;
+	int ret;
+
+	if (unlikely(!(file->f_mode & FMODE_WRITE)))
+		return -EBADF;
+	if (unlikely(!file->f_op->write_iter))
+		return -EINVAL;
+
+	ret = io_prep_rw(req, force_nonblock);
+	if (ret)
+		return ret;
+
+	/* Buffered writes don't know how not to block */
+	if (force_nonblock && !(kiocb->ki_flags & IOCB_DIRECT))
+		return -EAGAIN;
+
+	ret = io_import_iovec(req->ctx, WRITE, req, &iovec, &iter);
+	if (ret)
+		return ret;
+
+	ret = rw_verify_area(WRITE, file, &kiocb->ki_pos,
+			     iov_iter_count(&iter));
+	if (!ret) {
+		ssize_t ret2;
+
+		kiocb->ki_flags |= IOCB_WRITE;
+		file_start_write(file);
+		/*
+		 * We release freeze protection in io_complete_rw().  Fool
+		 * lockdep by telling it the lock got released so that it
+		 * doesn't complain about held lock when we return to
+		 * userspace.
+		 */
+		if (S_ISREG(file_inode(file)->i_mode))
+			__sb_writers_release(file_inode(file)->i_sb,
+					     SB_FREEZE_WRITE);
+		ret2 = call_write_iter(file, kiocb, &iter);
+
+		if (!force_nonblock || ret2 != -EAGAIN) {
+			io_rw_done(kiocb, ret2);
+		} else {
+			kiocb_end_write(kiocb);
+			ret = -EAGAIN;
+		}
+	}
+	kfree(iovec);
+	return ret;
+}
+
+static int io_fsync(struct io_kiocb *req, bool force_nonblock)
+{
+	const struct io_uring_sqe *sqe = &req->sqe;
+	loff_t end = LLONG_MAX;
+	int ret;
+
+	if (unlikely(sqe->addr || sqe->ioprio || sqe->buf_index))
+		return -EINVAL;
+	if (unlikely(sqe->fsync_flags & ~IORING_FSYNC_DATASYNC))
+		return -EINVAL;
+	/* Nothing to poll for */
+	if (req->ctx->flags & IORING_SETUP_IOPOLL)
+		return -EINVAL;
+
+	/* fsync always requires a blocking context */
+	if (force_nonblock)
+		return -EAGAIN;
+
+	if (sqe->len)
+		end = sqe->off + sqe->len - 1;
+
+	ret = vfs_fsync_range(req->rw.ki_filp, sqe->off, end,
+			      sqe->fsync_flags & IORING_FSYNC_DATASYNC);
+
+	io_cqring_add_event(req->ctx, sqe->user_data, ret);
+	io_free_req(req);
+	return 0;
+}
+
+/*
+ * Issue @req. On success the request is gone, completed or in flight;
+ * on error the caller still owns it.
+ */
+static int __io_submit_sqe(struct io_kiocb *req, bool force_nonblock)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	int ret;
+
+	switch (req->sqe.opcode) {
+	case IORING_OP_NOP:
+		io_cqring_add_event(ctx, req->sqe.user_data, 0);
+		io_free_req(req);
+		return 0;
+	case IORING_OP_READV:
+	case IORING_OP_READ_FIXED:
+		ret = io_read(req, force_nonblock);
+		break;
+	case IORING_OP_WRITEV:
+	case IORING_OP_WRITE_FIXED:
+		ret = io_write(req, force_nonblock);
+		break;
+	case IORING_OP_FSYNC:
+		return io_fsync(req, force_nonblock);
+	default:
+		return -EINVAL;
+	}
+
+	if (!ret && (ctx->flags & IORING_SETUP_IOPOLL)) {
+		/* The workqueue doesn't hold uring_lock, the submitters do */
+		if (!force_nonblock)
+			mutex_lock(&ctx->uring_lock);
+		list_add_tail(&req->list, &ctx->poll_list);
+		if (!force_nonblock)
+			mutex_unlock(&ctx->uring_lock);
+	}
+	return ret;
+}
+
+/* Issue a request which would have blocked, in its own worker */
+static void io_sq_wq_submit_work(struct work_struct *work)
+{
+	struct io_kiocb *req = container_of(work, struct io_kiocb, work);
+	struct io_ring_ctx *ctx = req->ctx;
+	const struct cred *old_cred;
+	mm_segment_t old_fs;
+	int ret = -EFAULT;
+
+	/* iovecs are read from the application on every issue */
+	if (mmget_not_zero(ctx->sqo_mm)) {
+		old_cred = override_creds(ctx->creds);
+		use_mm(ctx->sqo_mm);
+		old_fs = get_fs();
+		set_fs(USER_DS);
+
+		ret = __io_submit_sqe(req, false);
+
+		set_fs(old_fs);
+		unuse_mm(ctx->sqo_mm);
+		revert_creds(old_cred);
+		mmput(ctx->sqo_mm);
+	}
+
+	if (ret) {
+		io_cqring_add_event(ctx, req->sqe.user_data, ret);
+		io_free_req(req);
+	}
+}
+
+static int io_req_set_file(struct io_ring_ctx *ctx, struct io_kiocb *req)
+{
+	const struct io_uring_sqe *sqe = &req->sqe;
+	int fd = sqe->fd;
+
+	if (sqe->opcode == IORING_OP_NOP)
+		return 0;
+
+	if (sqe->flags & IOSQE_FIXED_FILE) {
+		if (unlikely(!ctx->user_files ||
+			     (unsigned int) fd >= ctx->nr_user_files))
+			return -EBADF;
+		req->rw.ki_filp = ctx->user_files[fd];
+		req->flags |= REQ_F_FIXED_FILE;
+		return 0;
+	}
+
+	/* The thread polling the SQ has no file table to look fds up in */
+	if (ctx->flags & IORING_SETUP_SQPOLL)
+		return -EBADF;
+
+	req->rw.ki_filp = fget(fd);
+	if (unlikely(!req->rw.ki_filp))
+		return -EBADF;
+	return 0;
+}
+
+static void io_submit_sqe(struct io_ring_ctx *ctx, struct io_kiocb *req)
+{
+	int ret = -EINVAL;
+
+	if (unlikely(req->sqe.flags & ~IOSQE_FIXED_FILE))
+		goto err;
+
+	ret = io_req_set_file(ctx, req);
+	if (unlikely(ret))
+		goto err;
+
+	ret = __io_submit_sqe(req, true);
+	if (!ret)
+		return;
+
+	if (ret == -EAGAIN) {
+		INIT_WORK(&req->work, io_sq_wq_submit_work);
+		queue_work(ctx->sqo_wq, &req->work);
+		return;
+	}
+err:
+	io_cqring_add_event(ctx, req->sqe.user_data, ret);
+	io_free_req(req);
+}
+
+static unsigned int io_sqring_entries(struct io_ring_ctx *ctx)
+{
+	/* Paired with the store-release of the tail by the application */
+	return smp_load_acquire(&ctx->sq_ring->r.tail) - ctx->cached_sq_head;
+}
+
+/* Return the next sqe queued by the application, skipping bogus indices */
+static const struct io_uring_sqe *io_get_sqring(struct io_ring_ctx *ctx)
+{
+	struct io_sq_ring *ring = ctx->sq_ring;
+	unsigned int head, idx;
+
+	while (io_sqring_entries(ctx)) {
+		head = ctx->cached_sq_head & ctx->sq_mask;
+		idx = READ_ONCE(ring->array[head]);
+		if (likely(idx < ctx->sq_entries))
+			return &ctx->sq_sqes[idx];
+
+		ctx->cached_sq_head++;
+		WRITE_ONCE(ring->dropped, READ_ONCE(ring->dropped) + 1);
+	}
+	return NULL;
+}
+
+static void io_commit_sqring(struct io_ring_ctx *ctx)
+{
+	struct io_sq_ring *ring = ctx->sq_ring;
+
+	/* The sqes were copied: let the application reuse their slots */
+	if (READ_ONCE(ring->r.head) != ctx->cached_sq_head)
+		smp_store_release(&ring->r.head, ctx->cached_sq_head);
+}
+
+/*
+ * Submit up to @to_submit sqes. Returns how many were, or -EAGAIN when
+ * none could be for lack of a request.
+ */
+static int io_submit_sqes(struct io_ring_ctx *ctx, unsigned int to_submit)
+{
+	int submitted = 0;
+
+	while (submitted < to_submit) {
+		const struct io_uring_sqe *sqe;
+		struct io_kiocb *req;
+
+		sqe = io_get_sqring(ctx);
+		if (!sqe)
+			break;
+
+		req = io_get_req(ctx);
+		if (!req) {
+			if (!submitted)
+				submitted = -EAGAIN;
+			break;
+		}
+
+		memcpy(&req->sqe, sqe, sizeof(req->sqe));
+		ctx->cached_sq_head++;
+
+		io_submit_sqe(ctx, req);
+		submitted++;
+	}
+
+	io_commit_sqring(ctx);
+	return submitted;
+}
+
+static int io_sq_thread(void *data)
+{
+	struct io_ring_ctx *ctx = data;
+	struct io_sq_ring *ring = ctx->sq_ring;
+	const struct cred *old_cred;
+	unsigned long timeout;
+	mm_segment_t old_fs;
+	DEFINE_WAIT(wait);
+
+	old_fs = get_fs();
+	set_fs(USER_DS);
+	old_cred = override_creds(ctx->creds);
+
+	timeout = jiffies + ctx->sq_thread_idle;
+	while (!kthread_should_stop()) {
+		bool mm_ok;
+
+		/* Requests to poll for keep the thread busy too */
+		if (ctx->flags & IORING_SETUP_IOPOLL) {
+			mutex_lock(&ctx->uring_lock);
+			if (!list_empty(&ctx->poll_list)) {
+				io_do_iopoll(ctx);
+				timeout = jiffies + ctx->sq_thread_idle;
+			}
+			mutex_unlock(&ctx->uring_lock);
+		}
+
+		if (!io_sqring_entries(ctx)) {
+			/* Keep polling for a while before going to sleep */
+			if (time_before(jiffies, timeout)) {
+				cond_resched();
+				continue;
+			}
+
+			prepare_to_wait(&ctx->sqo_wait, &wait,
+					TASK_INTERRUPTIBLE);
+
+			/* Tell the application it has to wake us up */
+			WRITE_ONCE(ring->flags,
+				   ring->flags | IORING_SQ_NEED_WAKEUP);
+			/* Order the flag against the check of the tail */
+			smp_mb();
+
+			if (!io_sqring_entries(ctx)) {
+				if (kthread_should_stop()) {
+					finish_wait(&ctx->sqo_wait, &wait);
+					break;
+				}
+				if (signal_pending(current))
+					flush_signals(current);
+				schedule();
+			}
+			finish_wait(&ctx->sqo_wait, &wait);
+
+			WRITE_ONCE(ring->flags,
+				   ring->flags & ~IORING_SQ_NEED_WAKEUP);
+			timeout = jiffies + ctx->sq_thread_idle;
+			continue;
+		}
+
+		/* Without the mm, iovecs fault and fail their request */
+		mm_ok = mmget_not_zero(ctx->sqo_mm);
+		if (mm_ok)
+			use_mm(ctx->sqo_mm);
+
+		mutex_lock(&ctx->uring_lock);
+		io_submit_sqes(ctx, ctx->sq_entries);
+		mutex_unlock(&ctx->uring_lock);
+
+		if (mm_ok) {
+			unuse_mm(ctx->sqo_mm);
+			mmput(ctx->sqo_mm);
+		}
+
+		timeout = jiffies + ctx->sq_thread_idle;
+		cond_resched();
+	}
+
+	revert_creds(old_cred);
+	set_fs(old_fs);
+	return 0;
+}
+
+static void io_sq_thread_stop(struct io_ring_ctx *ctx)
+{
+	if (ctx->sqo_thread) {
+		kthread_stop(ctx->sqo_thread);
+		ctx->sqo_thread = NULL;
+	}
+}
+
+static int io_sq_offload_start(struct io_ring_ctx *ctx,
+			       struct io_uring_params *p)
+{
+	unsigned int max_active;
+
+	mmgrab(current->mm);
+	ctx->sqo_mm = current->mm;
+	ctx->creds = get_current_cred();
+
+	if (ctx->flags & IORING_SETUP_SQPOLL) {
+		if (!capable(CAP_SYS_ADMIN))
+			return -EPERM;
+
+		ctx->sq_thread_idle = msecs_to_jiffies(p->sq_thread_idle);
+		if (!ctx->sq_thread_idle)
+			ctx->sq_thread_idle = HZ;
+
+		if (p->flags & IORING_SETUP_SQ_AFF &&
+		    (p->sq_thread_cpu >= nr_cpu_ids ||
+		     !cpu_online(p->sq_thread_cpu)))
+			return -EINVAL;
+
+		ctx->sqo_thread = kthread_create(io_sq_thread, ctx,
+						 "io_uring-sq");
+		if (IS_ERR(ctx->sqo_thread)) {
+			int ret = PTR_ERR(ctx->sqo_thread);
+
+			ctx->sqo_thread = NULL;
+			return ret;
+		}
+		if (p->flags & IORING_SETUP_SQ_AFF)
+			kthread_bind(ctx->sqo_thread, p->sq_thread_cpu);
+		wake_up_process(ctx->sqo_thread);
+	} else if (p->flags & IORING_SETUP_SQ_AFF) {
+		/* Can't have SQ_AFF without SQPOLL */
+		return -EINVAL;
+	}
+
+	/* Requests only get here to block: don't tie them to a cpu */
+	max_active = min(ctx->sq_entries, 2 * num_online_cpus());
+	ctx->sqo_wq = alloc_workqueue("io_ring-wq", WQ_UNBOUND | WQ_FREEZABLE,
+				      max_active);
+	if (!ctx->sqo_wq)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void *io_mem_alloc(size_t size)
+{
+	gfp_t gfp_flags = GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN | __GFP_COMP |
+				__GFP_NORETRY;
+
+	return (void *) __get_free_pages(gfp_flags, get_order(size));
+}
+
+static void io_mem_free(void *ptr)
+{
+	if (ptr)
+		free_pages((unsigned long) ptr,
+			   compound_order(virt_to_head_page(ptr)));
+}
+
+static int io_allocate_scq_urings(struct io_ring_ctx *ctx,
+				  struct io_uring_params *p)
+{
+	struct io_sq_ring *sq_ring;
+	struct io_cq_ring *cq_ring;
+
+	sq_ring = io_mem_alloc(sizeof(*sq_ring) + p->sq_entries * sizeof(u32));
+	if (!sq_ring)
+		return -ENOMEM;
+
+	ctx->sq_ring = sq_ring;
+	sq_ring->ring_mask = p->sq_entries - 1;
+	sq_ring->ring_entries = p->sq_entries;
+	ctx->sq_mask = sq_ring->ring_mask;
+	ctx->sq_entries = sq_ring->ring_entries;
+
+	ctx->sq_sqes = io_mem_alloc(p->sq_entries *
+				    sizeof(struct io_uring_sqe));
+	if (!ctx->sq_sqes)
+		return -ENOMEM;
+
+	cq_ring = io_mem_alloc(sizeof(*cq_ring) +
+			       p->cq_entries * sizeof(struct io_uring_cqe));
+	if (!cq_ring)
+		return -ENOMEM;
+
+	ctx->cq_ring = cq_ring;
+	cq_ring->ring_mask = p->cq_entries - 1;
+	cq_ring->ring_entries = p->cq_entries;
+	ctx->cq_mask = cq_ring->ring_mask;
+	ctx->cq_entries = cq_ring->ring_entries;
+	return 0;
+}
+
+static int io_account_mem(struct user_struct *user, unsigned long nr_pages)
+{
+	unsigned long page_limit, cur_pages, new_pages;
+
+	page_limit = rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT;
+
+	do {
+		cur_pages = atomic_long_read(&user->locked_vm);
+		new_pages = cur_pages + nr_pages;
+		if (new_pages > page_limit)
+			return -ENOMEM;
+	} while (atomic_long_cmpxchg(&user->locked_vm, cur_pages,
+				     new_pages) != cur_pages);
+
+	return 0;
+}
+
+static void io_unaccount_mem(struct user_struct *user, unsigned long nr_pages)
+{
+	atomic_long_sub(nr_pages, &user->locked_vm);
+}
+
+static int io_sqe_buffer_unregister(struct io_ring_ctx *ctx)
+{
+	unsigned int i, j;
+
+	if (!ctx->user_bufs)
+		return -ENXIO;
+
+	for (i = 0; i < ctx->nr_user_bufs; i++) {
+		struct io_mapped_ubuf *imu = &ctx->user_bufs[i];
+
+		for (j = 0; j < imu->nr_bvecs; j++) {
+			struct page *page = imu->bvec[j].bv_page;
+
+			set_page_dirty_lock(page);
+			put_page(page);
+		}
+
+		if (ctx->account_mem)
+			io_unaccount_mem(ctx->user, imu->nr_bvecs);
+		kvfree(imu->bvec);
+	}
+
+	kfree(ctx->user_bufs);
+	ctx->user_bufs = NULL;
+	ctx->nr_user_bufs = 0;
+	return 0;
+}
+
+static int io_sqe_buffer_register(struct io_ring_ctx *ctx, void __user *arg,
+				  unsigned int nr_args)
+{
+	struct iovec __user *uiov = arg;
+	struct page **pages = NULL;
+	unsigned int i;
+	int ret;
+
+	if (ctx->user_bufs)
+		return -EBUSY;
+	if (!nr_args || nr_args > UIO_MAXIOV)
+		return -EINVAL;
+
+	ctx->user_bufs = kcalloc(nr_args, sizeof(struct io_mapped_ubuf),
+				 GFP_KERNEL);
+	if (!ctx->user_bufs)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_args; i++) {
+		struct io_mapped_ubuf *imu = &ctx->user_bufs[i];
+		unsigned long off, start, end, ubuf;
+		int j, pret, nr_pages;
+		struct iovec iov;
+		size_t size;
+
+		ret = -EFAULT;
+		if (copy_from_user(&iov, &uiov[i], sizeof(iov)))
+			goto err;
+
+		/* An arbitrary limit, but there has to be one */
+		if (!iov.iov_base || !iov.iov_len || iov.iov_len > SZ_1G)
+			goto err;
+
+		ubuf = (unsigned long) iov.iov_base;
+		end = (ubuf + iov.iov_len + PAGE_SIZE - 1) >> PAGE_SHIFT;
+		start = ubuf >> PAGE_SHIFT;
+		nr_pages = end - start;
+
+		if (ctx->account_mem) {
+			ret = io_account_mem(ctx->user, nr_pages);
+			if (ret)
+				goto err;
+		}
+
+		pages = kvmalloc_array(nr_pages, sizeof(struct page *),
+				       GFP_KERNEL);
+		imu->bvec = kvmalloc_array(nr_pages, sizeof(struct bio_vec),
+					   GFP_KERNEL);
+		pret = -ENOMEM;
+		if (pages && imu->bvec) {
+			down_read(&current->mm->mmap_sem);
+			pret = get_user_pages(ubuf, nr_pages, FOLL_WRITE,
+					      pages, NULL);
+			up_read(&current->mm->mmap_sem);
+		}
+
+		if (pret != nr_pages) {
+			/* Short: give back what was pinned */
+			ret = pret < 0 ? pret : -EFAULT;
+			while (pret > 0)
+				put_page(pages[--pret]);
+			kvfree(imu->bvec);
+			imu->bvec = NULL;
+			if (ctx->account_mem)
+				io_unaccount_mem(ctx->user, nr_pages);
+			goto err;
+		}
+
+		off = ubuf & ~PAGE_MASK;
+		size = iov.iov_len;
+		for (j = 0; j < nr_pages; j++) {
+			size_t vec_len;
+
+			vec_len = min_t(size_t, size, PAGE_SIZE - off);
+			imu->bvec[j].bv_page = pages[j];
+			imu->bvec[j].bv_len = vec_len;
+			imu->bvec[j].bv_offset = off;
+			off = 0;
+			size -= vec_len;
+		}
+		/* The original address, for io_import_fixed() to check */
+		imu->ubuf = ubuf;
+		imu->len = iov.iov_len;
+		imu->nr_bvecs = nr_pages;
+		ctx->nr_user_bufs++;
+
+		kvfree(pages);
+		pages = NULL;
+	}
+	return 0;
+
+err:
+	kvfree(pages);
+	io_sqe_buffer_unregister(ctx);
+	return ret;
+}
+
+static int io_sqe_files_unregister(struct io_ring_ctx *ctx)
+{
+	unsigned int i;
+
+	if (!ctx->user_files)
+		return -ENXIO;
+
+	for (i = 0; i < ctx->nr_user_files; i++)
+		fput(ctx->user_files[i]);
+
+	kfree(ctx->user_files);
+	ctx->user_files = NULL;
+	ctx->nr_user_files = 0;
+	return 0;
+}
+
+static int io_sqe_files_register(struct io_ring_ctx *ctx, void __user *arg,
+				 unsigned int nr_args)
+{
+	__s32 __user *fds = (__s32 __user *) arg;
+	unsigned int i;
+	int ret = 0;
+
+	if (ctx->user_files)
+		return -EBUSY;
+	if (!nr_args || nr_args > IORING_MAX_FIXED_FILES)
+		return -EINVAL;
+
+	ctx->user_files = kcalloc(nr_args, sizeof(struct file *), GFP_KERNEL);
+	if (!ctx->user_files)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_args; i++) {
+		struct file *file;
+		int fd;
+
+		ret = -EFAULT;
+		if (copy_from_user(&fd, &fds[i], sizeof(fd)))
+			break;
+
+		ret = -EBADF;
+		file = fget(fd);
+		if (!file)
+			break;
+
+		/*
+		 * A ring holding a reference to itself, or to a ring
+		 * holding one to it, would never be released.
+		 */
+		if (file->f_op == &io_uring_fops) {
+			fput(file);
+			break;
+		}
+
+		ctx->user_files[i] = file;
+		ctx->nr_user_files++;
+		ret = 0;
+	}
+
+	if (ret)
+		io_sqe_files_unregister(ctx);
+	return ret;
+}
+
+static void io_ring_ctx_free(struct io_ring_ctx *ctx)
+{
+	if (ctx->sqo_wq)
+		destroy_workqueue(ctx->sqo_wq);
+	if (ctx->sqo_mm)
+		mmdrop(ctx->sqo_mm);
+	if (ctx->creds)
+		put_cred(ctx->creds);
+
+	io_sqe_buffer_unregister(ctx);
+	io_sqe_files_unregister(ctx);
+
+	io_mem_free(ctx->sq_ring);
+	io_mem_free(ctx->sq_sqes);
+	io_mem_free(ctx->cq_ring);
+
+	percpu_ref_exit(&ctx->refs);
+	free_uid(ctx->user);
+	kfree(ctx);
+}
+
+static void io_ring_ctx_wait_and_kill(struct io_ring_ctx *ctx)
+{
+	mutex_lock(&ctx->uring_lock);
+	percpu_ref_kill(&ctx->refs);
+	mutex_unlock(&ctx->uring_lock);
+
+	/* No more submissions, then wait for the requests in flight */
+	io_sq_thread_stop(ctx);
+	io_iopoll_reap_events(ctx);
+	wait_for_completion(&ctx->ctx_done);
+	io_ring_ctx_free(ctx);
+}
+
+static int io_uring_release(struct inode *inode, struct file *file)
+{
+	struct io_ring_ctx *ctx = file->private_data;
+
+	file->private_data = NULL;
+	io_ring_ctx_wait_and_kill(ctx);
+	return 0;
+}
+
+static unsigned int io_uring_poll(struct file *file, poll_table *wait)
+{
+	struct io_ring_ctx *ctx = file->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(file, &ctx->cq_wait, wait);
+
+	if (READ_ONCE(ctx->sq_ring->r.tail) - ctx->cached_sq_head !=
+	    ctx->sq_entries)
+		mask |= POLLOUT | POLLWRNORM;
+	if (io_cqring_events(ctx))
+		mask |= POLLIN | POLLRDNORM;
+
+	return mask;
+}
+
+static int io_uring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	loff_t offset = (loff_t) vma->vm_pgoff << PAGE_SHIFT;
+	unsigned long sz = vma->vm_end - vma->vm_start;
+	struct io_ring_ctx *ctx = file->private_data;
+	unsigned long pfn;
+	struct page *page;
+	void *ptr;
+
+	switch (offset) {
+	case IORING_OFF_SQ_RING:
+		ptr = ctx->sq_ring;
+		break;
+	case IORING_OFF_SQES:
+		ptr = ctx->sq_sqes;
+		break;
+	case IORING_OFF_CQ_RING:
+		ptr = ctx->cq_ring;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	page = virt_to_head_page(ptr);
+	if (sz > (PAGE_SIZE << compound_order(page)))
+		return -EINVAL;
+
+	/* The mapping holds the file, which holds the pages */
+	pfn = virt_to_phys(ptr) >> PAGE_SHIFT;
+	return remap_pfn_range(vma, vma->vm_start, pfn, sz, vma->vm_page_prot);
+}
+
+static int io_cqring_wait(struct io_ring_ctx *ctx, unsigned int min_events,
+			  const sigset_t __user *sig, size_t sigsz)
+{
+	sigset_t ksigmask, sigsaved;
+	int ret;
+
+	if (io_cqring_events(ctx) >= min_events)
+		return 0;
+
+	/*
+	 * If the caller wants a certain signal mask to be set during the wait,
+	 * we apply it here.
+	 */
+	if (sig) {
+		if (sigsz != sizeof(sigset_t))
+			return -EINVAL;
+		if (copy_from_user(&ksigmask, sig, sizeof(ksigmask)))
+			return -EFAULT;
+		sigsaved = current->blocked;
+		set_current_blocked(&ksigmask);
+	}
+
+	ret = wait_event_interruptible(ctx->cq_wait,
+				       io_cqring_events(ctx) >= min_events);
+	if (ret == -ERESTARTSYS)
+		ret = -EINTR;
+
+	/*
+	 * If we changed the signal mask, we need to restore the original one.
+	 * In case we've got a signal while waiting, we do not restore the
+	 * signal mask yet, and we allow do_signal() to deliver the signal on
+	 * the way back to userspace, before the signal mask is restored.
+	 */
+	if (sig) {
+		if (ret == -EINTR) {
+			memcpy(&current->saved_sigmask, &sigsaved,
+			       sizeof(sigsaved));
+			set_restore_sigmask();
+		} else
+			set_current_blocked(&sigsaved);
+	}
+
+	return ret;
+}
+
+SYSCALL_DEFINE6(io_uring_enter, unsigned int, fd, u32, to_submit,
+		u32, min_complete, u32, flags, const sigset_t __user *, sig,
+		size_t, sigsz)
+{
+	struct io_ring_ctx *ctx;
+	int submitted = 0;
+	struct fd f;
+	long ret;
+
+	if (flags & ~(IORING_ENTER_GETEVENTS | IORING_ENTER_SQ_WAKEUP))
+		return -EINVAL;
+
+	f = fdget(fd);
+	if (!f.file)
+		return -EBADF;
+
+	ret = -EOPNOTSUPP;
+	if (f.file->f_op != &io_uring_fops)
+		goto out_fput;
+
+	ret = -ENXIO;
+	ctx = f.file->private_data;
+	if (!percpu_ref_tryget(&ctx->refs))
+		goto out_fput;
+
+	/*
+	 * When the SQ is polled, the application only has to wake up the
+	 * polling thread in case it went to sleep.
+	 */
+	ret = 0;
+	if (ctx->flags & IORING_SETUP_SQPOLL) {
+		if (flags & IORING_ENTER_SQ_WAKEUP)
+			wake_up(&ctx->sqo_wait);
+		submitted = to_submit;
+	} else if (to_submit) {
+		to_submit = min(to_submit, ctx->sq_entries);
+
+		mutex_lock(&ctx->uring_lock);
+		ret = io_submit_sqes(ctx, to_submit);
+		mutex_unlock(&ctx->uring_lock);
+		if (ret < 0)
+			goto out_ctx;
+		submitted = ret;
+	}
+
+	if (flags & IORING_ENTER_GETEVENTS) {
+		min_complete = min(min_complete, ctx->cq_entries);
+
+		/* Completions of a polled ring only come from polling */
+		if (ctx->flags & IORING_SETUP_IOPOLL)
+			ret = io_iopoll_check(ctx, min_complete);
+		else
+			ret = io_cqring_wait(ctx, min_complete, sig, sigsz);
+	}
+
+out_ctx:
+	percpu_ref_put(&ctx->refs);
+out_fput:
+	fdput(f);
+	return submitted ? submitted : ret;
+}
+
+static const struct file_operations io_uring_fops = {
+	.release	= io_uring_release,
+	.mmap		= io_uring_mmap,
+	.poll		= io_uring_poll,
+};
+
+static int io_uring_get_fd(struct io_ring_ctx *ctx)
+{
+	struct file *file;
+	int fd;
+
+	fd = get_unused_fd_flags(O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		return fd;
+
+	file = anon_inode_getfile("[io_uring]", &io_uring_fops, ctx,
+				  O_RDWR | O_CLOEXEC);
+	if (IS_ERR(file)) {
+		put_unused_fd(fd);
+		return PTR_ERR(file);
+	}
+
+	fd_install(fd, file);
+	return fd;
+}
+
+static int io_uring_create(unsigned int entries, struct io_uring_params *p,
+			   struct io_uring_params __user *params)
+{
+	struct io_ring_ctx *ctx;
+	int ret;
+
+	if (!entries || entries > IORING_MAX_ENTRIES)
+		return -EINVAL;
+
+	/*
+	 * Use twice as many entries for the CQ ring. It's just the
+	 * application's word that it won't keep more than sq_entries in
+	 * flight, so give it some slack before the CQ overflows.
+	 */
+	p->sq_entries = roundup_pow_of_two(entries);
+	p->cq_entries = 2 * p->sq_entries;
+
+	ctx = io_ring_ctx_alloc(p);
+	if (!ctx)
+		return -ENOMEM;
+
+	ctx->user = get_uid(current_user());
+	ctx->account_mem = !capable(CAP_IPC_LOCK);
+
+	ret = io_allocate_scq_urings(ctx, p);
+	if (ret)
+		goto err;
+
+	ret = io_sq_offload_start(ctx, p);
+	if (ret)
+		goto err;
+
+	memset(&p->sq_off, 0, sizeof(p->sq_off));
+	p->sq_off.head = offsetof(struct io_sq_ring, r.head);
+	p->sq_off.tail = offsetof(struct io_sq_ring, r.tail);
+	p->sq_off.ring_mask = offsetof(struct io_sq_ring, ring_mask);
+	p->sq_off.ring_entries = offsetof(struct io_sq_ring, ring_entries);
+	p->sq_off.flags = offsetof(struct io_sq_ring, flags);
+	p->sq_off.dropped = offsetof(struct io_sq_ring, dropped);
+	p->sq_off.array = offsetof(struct io_sq_ring, array);
+
+	memset(&p->cq_off, 0, sizeof(p->cq_off));
+	p->cq_off.head = offsetof(struct io_cq_ring, r.head);
+	p->cq_off.tail = offsetof(struct io_cq_ring, r.tail);
+	p->cq_off.ring_mask = offsetof(struct io_cq_ring, ring_mask);
+	p->cq_off.ring_entries = offsetof(struct io_cq_ring, ring_entries);
+	p->cq_off.overflow = offsetof(struct io_cq_ring, overflow);
+	p->cq_off.cqes = offsetof(struct io_cq_ring, cqes);
+
+	ret = -EFAULT;
+	if (copy_to_user(params, p, sizeof(*p)))
+		goto err;
+
+	/* From here on the file owns the ring */
+	ret = io_uring_get_fd(ctx);
+	if (ret < 0)
+		goto err;
+	return ret;
+
+err:
+	io_ring_ctx_wait_and_kill(ctx);
+	return ret;
+}
+
+/*
+ * Sets up an io_uring with at least @entries entries: fills in @params
+ * with where to find everything in the file after mmap(2), and returns
+ * its descriptor.
+ */
+SYSCALL_DEFINE2(io_uring_setup, u32, entries,
+		struct io_uring_params __user *, params)
+{
+	struct io_uring_params p;
+	int i;
+
+	if (copy_from_user(&p, params, sizeof(p)))
+		return -EFAULT;
+
+	for (i = 0; i < ARRAY_SIZE(p.resv); i++) {
+		if (p.resv[i])
+			return -EINVAL;
+	}
+
+	if (p.flags & ~(IORING_SETUP_SQPOLL | IORING_SETUP_SQ_AFF |
+			IORING_SETUP_IOPOLL))
+		return -EINVAL;
+
+	return io_uring_create(entries, &p, params);
+}
+
+static int __io_uring_register(struct io_ring_ctx *ctx, unsigned int opcode,
+			       void __user *arg, unsigned int nr_args)
+	__releases(ctx->uring_lock)
+	__acquires(ctx->uring_lock)
+{
+	int ret;
+
+	/* Someone else is already waiting for the ring to go idle */
+	if (percpu_ref_is_dying(&ctx->refs))
+		return -ENXIO;
+
+	/*
+	 * The requests in flight may use the files and buffers about to
+	 * change: wait for them, with new ones refused meanwhile.
+	 */
+	percpu_ref_kill(&ctx->refs);
+	mutex_unlock(&ctx->uring_lock);
+	io_iopoll_reap_events(ctx);
+	wait_for_completion(&ctx->ctx_done);
+	mutex_lock(&ctx->uring_lock);
+
+	switch (opcode) {
+	case IORING_REGISTER_BUFFERS:
+		ret = io_sqe_buffer_register(ctx, arg, nr_args);
+		break;
+	case IORING_UNREGISTER_BUFFERS:
+		ret = -EINVAL;
+		if (arg || nr_args)
+			break;
+		ret = io_sqe_buffer_unregister(ctx);
+		break;
+	case IORING_REGISTER_FILES:
+		ret = io_sqe_files_register(ctx, arg, nr_args);
+		break;
+	case IORING_UNREGISTER_FILES:
+		ret = -EINVAL;
+		if (arg || nr_args)
+			break;
+		ret = io_sqe_files_unregister(ctx);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	/* bring the ctx back to life */
+	reinit_completion(&ctx->ctx_done);
+	percpu_ref_reinit(&ctx->refs);
+	return ret;
+}
+
+SYSCALL_DEFINE4(io_uring_register, unsigned int, fd, unsigned int, opcode,
+		void __user *, arg, unsigned int, nr_args)
+{
+	struct io_ring_ctx *ctx;
+	long ret = -EBADF;
+	struct fd f;
+
+	f = fdget(fd);
+	if (!f.file)
+		return -EBADF;
+
+	ret = -EOPNOTSUPP;
+	if (f.file->f_op != &io_uring_fops)
+		goto out_fput;
+
+	ctx = f.file->private_data;
+
+	mutex_lock(&ctx->uring_lock);
+	ret = __io_uring_register(ctx, opcode, arg, nr_args);
+	mutex_unlock(&ctx->uring_lock);
+out_fput:
+	fdput(f);
+	return ret;
+}
+
+static int __init io_uring_init(void)
+{
+	req_cachep = KMEM_CACHE(io_kiocb, SLAB_HWCACHE_ALIGN | SLAB_PANIC);
+	return 0;
+};
+__initcall(io_uring_init);
@@ -685,6 +685,8 @@ EXPORT_SYMBOL_GPL(iomap_seek_data);
 #define IOMAP_DIO_WRITE		(1 << 30)
 #define IOMAP_DIO_DIRTY		(1 << 31)
 
+static struct kmem_cache *iomap_dio_cache __read_mostly;
+
 struct iomap_dio {
 	struct kiocb		*iocb;
 	iomap_dio_end_io_t	*end_io;
@@ -745,8 +747,11 @@ static ssize_t iomap_dio_complete(struct iomap_dio *dio)
 	 * some filesystems convert unwritten extents to real allocations in
 	 * end_io() when necessary, otherwise a racing buffer read would cache
 	 * zeros from unwritten extents.
+	 *
+	 * Inline completions only get here with an empty page cache, see
+	 * iomap_dio_can_complete_inline(), and must not sleep.
 	 */
-	if (!dio->error &&
+	if (!dio->error && !(dio->flags & IOMAP_DIO_INLINE) &&
 	    (dio->flags & IOMAP_DIO_WRITE) && inode->i_mapping->nrpages) {
 		int err;
 		err = invalidate_inode_pages2_range(inode->i_mapping,
@@ -756,7 +761,7 @@ static ssize_t iomap_dio_complete(struct iomap_dio *dio)
 	}
 
 	inode_dio_end(file_inode(iocb->ki_filp));
-	kfree(dio);
+	kmem_cache_free(iomap_dio_cache, dio);
 
 	return ret;
 }
@@ -784,6 +789,27 @@ static inline void iomap_dio_set_error(struct iomap_dio *dio, int ret)
 	cmpxchg(&dio->error, 0, ret);
 }
 
+/*
+ * An aio write that only overwrote mapped blocks inside i_size and needs
+ * no O_DSYNC flush has nothing left to do that can sleep, unless pages
+ * showed up in the page cache meanwhile and must be invalidated.  Such a
+ * write is completed straight from the bio completion, whether that runs
+ * in interrupt context or in the task polling for it, instead of paying
+ * for a trip through s_dio_done_wq.
+ */
+static inline bool iomap_dio_can_complete_inline(struct iomap_dio *dio)
+{
+	struct inode *inode = file_inode(dio->iocb->ki_filp);
+
+	if (!(dio->flags & IOMAP_DIO_INLINE))
+		return false;
+	if (inode->i_mapping->nrpages) {
+		dio->flags &= ~IOMAP_DIO_INLINE;
+		return false;
+	}
+	return true;
+}
+
 static void iomap_dio_bio_end_io(struct bio *bio)
 {
 	struct iomap_dio *dio = bio->bi_private;
@@ -798,7 +824,8 @@ static void iomap_dio_bio_end_io(struct bio *bio)
 
 			WRITE_ONCE(dio->submit.waiter, NULL);
 			wake_up_process(waiter);
-		} else if (dio->flags & IOMAP_DIO_WRITE) {
+		} else if ((dio->flags & IOMAP_DIO_WRITE) &&
+			   !iomap_dio_can_complete_inline(dio)) {
 			struct inode *inode = file_inode(dio->iocb->ki_filp);
 
 			INIT_WORK(&dio->aio.work, iomap_dio_complete_work);
@@ -871,6 +898,7 @@ iomap_dio_actor(struct inode *inode, loff_t pos, loff_t length,
 			return length;
 		}
 		dio->flags |= IOMAP_DIO_UNWRITTEN;
+		dio->flags &= ~IOMAP_DIO_INLINE;
 		need_zeroout = true;
 		break;
 	case IOMAP_MAPPED:
@@ -878,6 +906,8 @@ iomap_dio_actor(struct inode *inode, loff_t pos, loff_t length,
 			dio->flags |= IOMAP_DIO_COW;
 		if (iomap->flags & IOMAP_F_NEW)
 			need_zeroout = true;
+		if (iomap->flags & (IOMAP_F_SHARED | IOMAP_F_NEW))
+			dio->flags &= ~IOMAP_DIO_INLINE;
 		break;
 	default:
 		WARN_ON_ONCE(1);
@@ -969,7 +999,7 @@ iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 	if (!count)
 		return 0;
 
-	dio = kmalloc(sizeof(*dio), GFP_KERNEL);
+	dio = kmem_cache_alloc(iomap_dio_cache, GFP_KERNEL);
 	if (!dio)
 		return -ENOMEM;
 
@@ -982,11 +1012,10 @@ iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 	dio->flags = 0;
 
 	dio->submit.iter = iter;
-	if (is_sync_kiocb(iocb)) {
+	dio->submit.cookie = BLK_QC_T_NONE;
+	dio->submit.last_queue = NULL;
+	if (is_sync_kiocb(iocb))
 		dio->submit.waiter = current;
-		dio->submit.cookie = BLK_QC_T_NONE;
-		dio->submit.last_queue = NULL;
-	}
 
 	if (iov_iter_rw(iter) == READ) {
 		if (pos >= dio->i_size)
@@ -997,6 +1026,11 @@ iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 	} else {
 		dio->flags |= IOMAP_DIO_WRITE;
 		flags |= IOMAP_WRITE;
+
+		/* cleared by the actor if the write turns out not to be one */
+		if (!is_sync_kiocb(iocb) && !(iocb->ki_flags & IOCB_DSYNC) &&
+		    pos + count <= dio->i_size)
+			dio->flags |= IOMAP_DIO_INLINE;
 	}
 
 	if (iocb->ki_flags & IOCB_NOWAIT) {
@@ -1045,6 +1079,15 @@ iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 	if (ret < 0)
 		iomap_dio_set_error(dio, ret);
 
+	/*
+	 * Where iomap_dio_iopoll() looks for the last bio. Our reference
+	 * still keeps dio around, after the put the bios may free it.
+	 */
+	if (!is_sync_kiocb(iocb)) {
+		WRITE_ONCE(iocb->ki_cookie, dio->submit.cookie);
+		WRITE_ONCE(iocb->private, dio->submit.last_queue);
+	}
+
 	if (!atomic_dec_and_test(&dio->ref)) {
 		if (!is_sync_kiocb(iocb))
 			return -EIOCBQUEUED;
@@ -1063,12 +1106,32 @@ iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 		__set_current_state(TASK_RUNNING);
 	}
 
+	/* completing in the submitter, the regular path is fine */
+	dio->flags &= ~IOMAP_DIO_INLINE;
 	ret = iomap_dio_complete(dio);
 
 	return ret;
 
 out_free_dio:
-	kfree(dio);
+	kmem_cache_free(iomap_dio_cache, dio);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(iomap_dio_rw);
+
+/* Poll for the completion of an async IOCB_HIPRI direct IO */
+int iomap_dio_iopoll(struct kiocb *kiocb)
+{
+	struct request_queue *q = READ_ONCE(kiocb->private);
+
+	if (!q)
+		return 0;
+	return blk_mq_poll(q, READ_ONCE(kiocb->ki_cookie));
+}
+EXPORT_SYMBOL_GPL(iomap_dio_iopoll);
+
+static int __init iomap_init(void)
+{
+	iomap_dio_cache = KMEM_CACHE(iomap_dio, SLAB_PANIC);
+	return 0;
+}
+fs_initcall(iomap_init);
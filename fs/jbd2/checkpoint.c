@@ -178,6 +178,63 @@ void __jbd2_log_wait_for_space(journal_t *journal)
 	}
 }
 
+/*
+ * The log is low on space when less than twice what a new transaction
+ * needs is left.  Must be called under j_state_lock.
+ */
+static inline int jbd2_log_space_low(journal_t *journal)
+{
+	return jbd2_log_space_left(journal) <
+		2 * (unsigned long)jbd2_space_needed(journal);
+}
+
+/*
+ * Background checkpointing: checkpoint the oldest transactions until the
+ * log is no longer low on space, so that starting a handle seldom has to
+ * checkpoint in __jbd2_log_wait_for_space().  This runs on an unbound
+ * workqueue, in parallel with commits and with the checkpointing of other
+ * journals.
+ */
+void jbd2_checkpoint_work(struct work_struct *work)
+{
+	journal_t *journal = container_of(work, journal_t, j_checkpoint_work);
+	int low;
+
+	mutex_lock_io(&journal->j_checkpoint_mutex);
+	for (;;) {
+		read_lock(&journal->j_state_lock);
+		spin_lock(&journal->j_list_lock);
+		low = !is_journal_aborted(journal) &&
+		      journal->j_checkpoint_transactions &&
+		      jbd2_log_space_low(journal);
+		spin_unlock(&journal->j_list_lock);
+		read_unlock(&journal->j_state_lock);
+
+		if (!low || jbd2_log_do_checkpoint(journal) < 0)
+			break;
+		cond_resched();
+	}
+	mutex_unlock(&journal->j_checkpoint_mutex);
+}
+
+/*
+ * Called by the commit thread after each commit: start background
+ * checkpointing if the log is low on space.
+ */
+void jbd2_log_start_checkpoint(journal_t *journal)
+{
+	int low;
+
+	if (journal->j_flags & JBD2_UNMOUNT)
+		return;
+
+	read_lock(&journal->j_state_lock);
+	low = jbd2_log_space_low(journal);
+	read_unlock(&journal->j_state_lock);
+	if (low)
+		queue_work(system_unbound_wq, &journal->j_checkpoint_work);
+}
+
 static void
 __flush_batch(journal_t *journal, int *batch_count)
 {
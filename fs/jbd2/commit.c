@@ -874,6 +874,15 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	if (err)
 		jbd2_journal_abort(journal, err);
 
+	/*
+	 * The transaction is on stable storage: whoever only waits for that
+	 * can go now, instead of after the checkpoint list processing below.
+	 */
+	write_lock(&journal->j_state_lock);
+	journal->j_durable_sequence = commit_transaction->t_tid;
+	write_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_wait_done_commit);
+
 	/*
 	 * Now disk caches for filesystem device are flushed so we are safe to
 	 * erase checkpointed transactions from the log by updating journal
@@ -1112,6 +1121,9 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	write_unlock(&journal->j_state_lock);
 	wake_up(&journal->j_wait_done_commit);
 
+	/* Get log space back before anyone has to wait for it */
+	jbd2_log_start_checkpoint(journal);
+
 	/*
 	 * Calculate overall stats
 	 */
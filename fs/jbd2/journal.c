@@ -100,6 +100,7 @@ EXPORT_SYMBOL(jbd2_journal_inode_add_wait);
 EXPORT_SYMBOL(jbd2_journal_init_jbd_inode);
 EXPORT_SYMBOL(jbd2_journal_release_jbd_inode);
 EXPORT_SYMBOL(jbd2_journal_begin_ordered_truncate);
+EXPORT_SYMBOL(jbd2_fc_write_block);
 EXPORT_SYMBOL(jbd2_inode_cache);
 
 static void __journal_abort_soft (journal_t *journal, int errno);
@@ -693,10 +694,19 @@ int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid)
 EXPORT_SYMBOL(jbd2_trans_will_send_data_barrier);
 
 /*
- * Wait for a specified commit to complete.
- * The caller may not hold the journal lock.
+ * Has transaction @tid committed?  With @durable, it is enough for its
+ * commit record to be on stable storage.
  */
-int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
+static inline bool jbd2_commit_done(journal_t *journal, tid_t tid,
+				    bool durable)
+{
+	if (durable && !tid_gt(tid, journal->j_durable_sequence))
+		return true;
+	return !tid_gt(tid, journal->j_commit_sequence);
+}
+
+static int __jbd2_log_wait_commit(journal_t *journal, tid_t tid,
+				  bool durable)
 {
 	int err = 0;
 
@@ -722,13 +732,13 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 		       __func__, journal->j_commit_request, tid);
 	}
 #endif
-	while (tid_gt(tid, journal->j_commit_sequence)) {
+	while (!jbd2_commit_done(journal, tid, durable)) {
 		jbd_debug(1, "JBD2: want %d, j_commit_sequence=%d\n",
 				  tid, journal->j_commit_sequence);
 		read_unlock(&journal->j_state_lock);
 		wake_up(&journal->j_wait_commit);
 		wait_event(journal->j_wait_done_commit,
-				!tid_gt(tid, journal->j_commit_sequence));
+			   jbd2_commit_done(journal, tid, durable));
 		read_lock(&journal->j_state_lock);
 	}
 	read_unlock(&journal->j_state_lock);
@@ -739,13 +749,28 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 }
 
 /*
- * When this function returns the transaction corresponding to tid
- * will be completed.  If the transaction has currently running, start
- * committing that transaction before waiting for it to complete.  If
- * the transaction id is stale, it is by definition already completed,
- * so just return SUCCESS.
+ * Wait for a specified commit to complete.
+ * The caller may not hold the journal lock.
  */
-int jbd2_complete_transaction(journal_t *journal, tid_t tid)
+int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
+{
+	return __jbd2_log_wait_commit(journal, tid, false);
+}
+
+/*
+ * Wait for a specified commit to reach stable storage.  The commit thread
+ * may still be processing the transaction's buffers when this returns, so
+ * this is only good for callers which want durability, like fsync.
+ * The caller may not hold the journal lock.
+ */
+int jbd2_log_wait_durable(journal_t *journal, tid_t tid)
+{
+	return __jbd2_log_wait_commit(journal, tid, true);
+}
+EXPORT_SYMBOL(jbd2_log_wait_durable);
+
+static int __jbd2_complete_transaction(journal_t *journal, tid_t tid,
+				       bool durable)
 {
 	int	need_to_wait = 1;
 
@@ -765,10 +790,32 @@ int jbd2_complete_transaction(journal_t *journal, tid_t tid)
 	if (!need_to_wait)
 		return 0;
 wait_commit:
-	return jbd2_log_wait_commit(journal, tid);
+	return __jbd2_log_wait_commit(journal, tid, durable);
+}
+
+/*
+ * When this function returns the transaction corresponding to tid
+ * will be completed.  If the transaction has currently running, start
+ * committing that transaction before waiting for it to complete.  If
+ * the transaction id is stale, it is by definition already completed,
+ * so just return SUCCESS.
+ */
+int jbd2_complete_transaction(journal_t *journal, tid_t tid)
+{
+	return __jbd2_complete_transaction(journal, tid, false);
 }
 EXPORT_SYMBOL(jbd2_complete_transaction);
 
+/*
+ * Like jbd2_complete_transaction(), but only wait until the transaction
+ * is on stable storage, see jbd2_log_wait_durable().
+ */
+int jbd2_complete_transaction_durable(journal_t *journal, tid_t tid)
+{
+	return __jbd2_complete_transaction(journal, tid, true);
+}
+EXPORT_SYMBOL(jbd2_complete_transaction_durable);
+
 /*
  * Log buffer allocation routines:
  */
@@ -819,6 +866,60 @@ int jbd2_journal_bmap(journal_t *journal, unsigned long blocknr,
 	return err;
 }
 
+/**
+ * int jbd2_fc_write_block() - write one block of the fast commit area
+ * @journal: journal to write to
+ * @off: block offset in the fast commit area
+ * @data: j_blocksize bytes to write
+ *
+ * The block is written synchronously.  On journals with barriers it is
+ * durable on return, along with everything written to the filesystem
+ * before the call.
+ */
+int jbd2_fc_write_block(journal_t *journal, unsigned long off,
+			const void *data)
+{
+	struct buffer_head *bh;
+	unsigned long long blocknr;
+	int write_flags = REQ_SYNC;
+	int err;
+
+	if (WARN_ON_ONCE(off >= journal->j_fc_len))
+		return -EINVAL;
+
+	err = jbd2_journal_bmap(journal, journal->j_fc_first + off, &blocknr);
+	if (err)
+		return err;
+
+	if (journal->j_flags & JBD2_BARRIER) {
+		/* With an external journal, flush the fs device by hand */
+		if (journal->j_fs_dev != journal->j_dev) {
+			err = blkdev_issue_flush(journal->j_fs_dev, GFP_NOFS,
+						 NULL);
+			if (err)
+				return err;
+		}
+		write_flags |= REQ_PREFLUSH | REQ_FUA;
+	}
+
+	bh = __getblk(journal->j_dev, blocknr, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+
+	lock_buffer(bh);
+	memcpy(bh->b_data, data, journal->j_blocksize);
+	set_buffer_uptodate(bh);
+	clear_buffer_dirty(bh);
+	get_bh(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	submit_bh(REQ_OP_WRITE, write_flags, bh);
+	wait_on_buffer(bh);
+	err = buffer_uptodate(bh) ? 0 : -EIO;
+	brelse(bh);
+
+	return err;
+}
+
 /*
  * We play buffer_head aliasing tricks to write data/metadata blocks to
  * the journal without copying their contents, but for journal
@@ -1134,6 +1235,7 @@ static journal_t *journal_init_common(struct block_device *bdev,
 	init_waitqueue_head(&journal->j_wait_reserved);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
+	INIT_WORK(&journal->j_checkpoint_work, jbd2_checkpoint_work);
 	spin_lock_init(&journal->j_revoke_lock);
 	spin_lock_init(&journal->j_list_lock);
 	rwlock_init(&journal->j_state_lock);
@@ -1286,6 +1388,36 @@ static void journal_fail_superblock (journal_t *journal)
  * subsequent use.
  */
 
+/*
+ * With the FAST_COMMIT feature, the last s_num_fc_blks blocks of the journal
+ * are the fast commit area and the log proper ends in front of them.
+ */
+static int journal_setup_fc_area(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long maxlen = be32_to_cpu(sb->s_maxlen);
+	unsigned long nr_fc;
+
+	journal->j_last = maxlen;
+	journal->j_fc_first = maxlen;
+	journal->j_fc_len = 0;
+	if (!jbd2_has_feature_fast_commit(journal))
+		return 0;
+
+	nr_fc = be32_to_cpu(sb->s_num_fc_blks);
+	if (!nr_fc || be32_to_cpu(sb->s_first) + JBD2_MIN_JOURNAL_BLOCKS +
+		      nr_fc > maxlen) {
+		printk(KERN_ERR "JBD2: Invalid fast commit area (%lu of %lu "
+		       "blocks).\n", nr_fc, maxlen);
+		return -EINVAL;
+	}
+
+	journal->j_last = maxlen - nr_fc;
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_len = nr_fc;
+	return 0;
+}
+
 static int journal_reset(journal_t *journal)
 {
 	journal_superblock_t *sb = journal->j_superblock;
@@ -1301,14 +1433,18 @@ static int journal_reset(journal_t *journal)
 	}
 
 	journal->j_first = first;
-	journal->j_last = last;
+	if (journal_setup_fc_area(journal)) {
+		journal_fail_superblock(journal);
+		return -EINVAL;
+	}
 
 	journal->j_head = first;
 	journal->j_tail = first;
-	journal->j_free = last - first;
+	journal->j_free = journal->j_last - first;
 
 	journal->j_tail_sequence = journal->j_transaction_sequence;
 	journal->j_commit_sequence = journal->j_transaction_sequence - 1;
+	journal->j_durable_sequence = journal->j_commit_sequence;
 	journal->j_commit_request = journal->j_commit_sequence;
 
 	journal->j_max_transaction_buffers = journal->j_maxlen / 4;
@@ -1616,10 +1752,12 @@ static int load_superblock(journal_t *journal)
 	journal->j_tail_sequence = be32_to_cpu(sb->s_sequence);
 	journal->j_tail = be32_to_cpu(sb->s_start);
 	journal->j_first = be32_to_cpu(sb->s_first);
-	journal->j_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
-	return 0;
+	err = journal_setup_fc_area(journal);
+	if (err)
+		journal_fail_superblock(journal);
+	return err;
 }
 
 
@@ -1708,6 +1846,9 @@ int jbd2_journal_destroy(journal_t *journal)
 	if (journal->j_running_transaction)
 		jbd2_journal_commit_transaction(journal);
 
+	/* No more commits to queue background checkpoints */
+	cancel_work_sync(&journal->j_checkpoint_work);
+
 	/* Force any old transactions to disk */
 
 	/* Totally anal locking here... */
@@ -1852,6 +1993,7 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 #define COMPAT_FEATURE_ON(f) \
 		((compat & (f)) && !(sb->s_feature_compat & cpu_to_be32(f)))
 	journal_superblock_t *sb;
+	bool fc_on;
 
 	if (jbd2_journal_check_used_features(journal, compat, ro, incompat))
 		return 1;
@@ -1875,6 +2017,25 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 
 	sb = journal->j_superblock;
 
+	/*
+	 * The fast commit area is carved from the end of the log, so that
+	 * can only be done while the log is empty, right after loading.
+	 */
+	fc_on = INCOMPAT_FEATURE_ON(JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+	if (fc_on) {
+		if (journal->j_running_transaction ||
+		    journal->j_committing_transaction ||
+		    journal->j_head != journal->j_first ||
+		    journal->j_tail != journal->j_first) {
+			printk(KERN_ERR "JBD2: Cannot enable fast commits on "
+			       "a journal in use.\n");
+			return 0;
+		}
+		if (!sb->s_num_fc_blks)
+			sb->s_num_fc_blks =
+				cpu_to_be32(JBD2_DEFAULT_FAST_COMMIT_BLOCKS);
+	}
+
 	/* If enabling v3 checksums, update superblock */
 	if (INCOMPAT_FEATURE_ON(JBD2_FEATURE_INCOMPAT_CSUM_V3)) {
 		sb->s_checksum_type = JBD2_CRC32C_CHKSUM;
@@ -1909,6 +2070,25 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 	sb->s_feature_ro_compat |= cpu_to_be32(ro);
 	sb->s_feature_incompat  |= cpu_to_be32(incompat);
 
+	if (fc_on) {
+		write_lock(&journal->j_state_lock);
+		if (journal_setup_fc_area(journal)) {
+			jbd2_clear_feature_fast_commit(journal);
+			journal_setup_fc_area(journal);
+			write_unlock(&journal->j_state_lock);
+			return 0;
+		}
+		journal->j_free = journal->j_last - journal->j_first;
+		write_unlock(&journal->j_state_lock);
+
+		/*
+		 * Recovery must know where the log ends before anything is
+		 * written to the fast commit area.
+		 */
+		if (jbd2_write_superblock(journal, REQ_SYNC | REQ_FUA))
+			return 0;
+	}
+
 	return 1;
 #undef COMPAT_FEATURE_ON
 #undef INCOMPAT_FEATURE_ON
@@ -174,6 +174,37 @@ static int jread(struct buffer_head **bhp, journal_t *journal,
 	return 0;
 }
 
+/*
+ * Hand the fast commit area to the filesystem, block by block, to replay
+ * the records logged during transaction @tid, the one that was running
+ * when the journal went down.
+ */
+static int fc_do_replay(journal_t *journal, tid_t tid)
+{
+	struct buffer_head *bh;
+	unsigned long off;
+	int err = 0;
+
+	if (!journal->j_fc_len || !journal->j_fc_replay_callback)
+		return 0;
+
+	for (off = 0; off < journal->j_fc_len; off++) {
+		err = jread(&bh, journal, journal->j_fc_first + off);
+		if (err)
+			break;
+		err = journal->j_fc_replay_callback(journal, bh, off, tid);
+		brelse(bh);
+		if (err <= 0)
+			break;
+	}
+	if (err > 0)
+		err = 0;
+
+	jbd_debug(1, "JBD2: fast commit replay for transaction %u: %lu "
+		  "blocks, status %d\n", tid, off, err);
+	return err;
+}
+
 static int jbd2_descriptor_block_csum_verify(journal_t *j, void *buf)
 {
 	struct jbd2_journal_block_tail *tail;
@@ -264,7 +295,11 @@ int jbd2_journal_recover(journal_t *journal)
 		jbd_debug(1, "No recovery required, last transaction %d\n",
 			  be32_to_cpu(sb->s_sequence));
 		journal->j_transaction_sequence = be32_to_cpu(sb->s_sequence) + 1;
-		return 0;
+		if (!journal->j_fc_len)
+			return 0;
+		/* Fast commits may have followed a flush of the log */
+		err = fc_do_replay(journal, be32_to_cpu(sb->s_sequence));
+		goto out_sync;
 	}
 
 	err = do_one_pass(journal, &info, PASS_SCAN);
@@ -272,6 +307,8 @@ int jbd2_journal_recover(journal_t *journal)
 		err = do_one_pass(journal, &info, PASS_REVOKE);
 	if (!err)
 		err = do_one_pass(journal, &info, PASS_REPLAY);
+	if (!err)
+		err = fc_do_replay(journal, info.end_transaction);
 
 	jbd_debug(1, "JBD2: recovery, exit status %d, "
 		  "recovered transactions %u to %u\n",
@@ -284,6 +321,7 @@ int jbd2_journal_recover(journal_t *journal)
 	journal->j_transaction_sequence = ++info.end_transaction;
 
 	jbd2_journal_clear_revoke(journal);
+out_sync:
 	err2 = sync_blockdev(journal->j_fs_dev);
 	if (!err)
 		err = err2;
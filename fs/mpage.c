@@ -363,28 +363,23 @@ mpage_readpages(struct address_space *mapping, struct list_head *pages,
 				unsigned nr_pages, get_block_t get_block)
 {
 	struct bio *bio = NULL;
-	unsigned page_idx;
+	unsigned page_idx = 0;
 	sector_t last_block_in_bio = 0;
 	struct buffer_head map_bh;
 	unsigned long first_logical_block = 0;
 	gfp_t gfp = readahead_gfp_mask(mapping);
+	struct readahead_batch rab;
+	struct page *page;
 
 	map_bh.b_state = 0;
 	map_bh.b_size = 0;
-	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
-		struct page *page = lru_to_page(pages);
-
-		prefetchw(&page->flags);
-		list_del(&page->lru);
-		if (!add_to_page_cache_lru(page, mapping,
-					page->index,
-					gfp)) {
-			bio = do_mpage_readpage(bio, page,
-					nr_pages - page_idx,
-					&last_block_in_bio, &map_bh,
-					&first_logical_block,
-					get_block, gfp);
-		}
+	readahead_batch_init(&rab);
+	while ((page = readahead_next_page(mapping, pages, &rab, gfp))) {
+		bio = do_mpage_readpage(bio, page,
+				nr_pages - page_idx++,
+				&last_block_in_bio, &map_bh,
+				&first_logical_block,
+				get_block, gfp);
 		put_page(page);
 	}
 	BUG_ON(!list_empty(pages));
@@ -45,6 +45,15 @@ unsigned int pipe_min_size = PAGE_SIZE;
 unsigned long pipe_user_pages_hard;
 unsigned long pipe_user_pages_soft = PIPE_DEF_BUFFERS * INR_OPEN_CUR;
 
+/*
+ * Number of released pages each pipe keeps around for reuse by later
+ * writes, tunable in /proc/sys/fs/pipe-cached-pages. The default keeps
+ * the historical one-deep cache; streaming users can raise it so that
+ * a full pipe cycles through its own pages instead of the allocator.
+ */
+unsigned int pipe_cached_pages = 1;
+unsigned int pipe_max_cached_pages = PIPE_MAX_CACHED_PAGES;
+
 /*
  * We use a start+len construction, which provides full use of the 
  * allocated memory.
@@ -128,12 +137,13 @@ static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
 	struct page *page = buf->page;
 
 	/*
-	 * If nobody else uses this page, and we don't already have a
-	 * temporary page, let's keep track of it as a one-deep
-	 * allocation cache. (Otherwise just release our reference to it)
+	 * If nobody else uses this page, and the per-pipe cache is not
+	 * full yet, keep it for the next write. (Otherwise just release
+	 * our reference to it)
 	 */
-	if (page_count(page) == 1 && !pipe->tmp_page)
-		pipe->tmp_page = page;
+	if (page_count(page) == 1 &&
+	    pipe->nr_tmp_pages < READ_ONCE(pipe_cached_pages))
+		pipe->tmp_page[pipe->nr_tmp_pages++] = page;
 	else
 		put_page(page);
 }
@@ -252,7 +262,7 @@ pipe_read(struct kiocb *iocb, struct iov_iter *to)
 	size_t total_len = iov_iter_count(to);
 	struct file *filp = iocb->ki_filp;
 	struct pipe_inode_info *pipe = filp->private_data;
-	int do_wakeup;
+	int do_wakeup, wake_writers;
 	ssize_t ret;
 
 	/* Null read succeeds. */
@@ -260,6 +270,7 @@ pipe_read(struct kiocb *iocb, struct iov_iter *to)
 		return 0;
 
 	do_wakeup = 0;
+	wake_writers = 0;
 	ret = 0;
 	__pipe_lock(pipe);
 	for (;;) {
@@ -298,6 +309,14 @@ pipe_read(struct kiocb *iocb, struct iov_iter *to)
 			}
 
 			if (!buf->len) {
+				/*
+				 * Writers only sleep on a full pipe, so
+				 * only the full -> not full transition
+				 * needs to wake them up.
+				 */
+				if (bufs == pipe->buffers ||
+				    READ_ONCE(pipe->poll_usage))
+					wake_writers = 1;
 				pipe_buf_release(pipe, buf);
 				curbuf = (curbuf + 1) & (pipe->buffers - 1);
 				pipe->curbuf = curbuf;
@@ -331,7 +350,8 @@ pipe_read(struct kiocb *iocb, struct iov_iter *to)
 			break;
 		}
 		if (do_wakeup) {
-			wake_up_interruptible_sync_poll(&pipe->wait, POLLOUT | POLLWRNORM);
+			if (wake_writers)
+				wake_up_interruptible_sync_poll(&pipe->wait, POLLOUT | POLLWRNORM);
  			kill_fasync(&pipe->fasync_writers, SIGIO, POLL_OUT);
 		}
 		pipe_wait(pipe);
@@ -340,7 +360,8 @@ pipe_read(struct kiocb *iocb, struct iov_iter *to)
 
 	/* Signal writers asynchronously that there is more room. */
 	if (do_wakeup) {
-		wake_up_interruptible_sync_poll(&pipe->wait, POLLOUT | POLLWRNORM);
+		if (wake_writers)
+			wake_up_interruptible_sync_poll(&pipe->wait, POLLOUT | POLLWRNORM);
 		kill_fasync(&pipe->fasync_writers, SIGIO, POLL_OUT);
 	}
 	if (ret > 0)
@@ -359,7 +380,7 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 	struct file *filp = iocb->ki_filp;
 	struct pipe_inode_info *pipe = filp->private_data;
 	ssize_t ret = 0;
-	int do_wakeup = 0;
+	int do_wakeup = 0, wake_readers = 0;
 	size_t total_len = iov_iter_count(from);
 	ssize_t chars;
 
@@ -413,23 +434,31 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		if (bufs < pipe->buffers) {
 			int newbuf = (pipe->curbuf + bufs) & (pipe->buffers-1);
 			struct pipe_buffer *buf = pipe->bufs + newbuf;
-			struct page *page = pipe->tmp_page;
+			struct page *page;
 			int copied;
 
-			if (!page) {
+			if (!pipe->nr_tmp_pages) {
 				page = alloc_page(GFP_HIGHUSER | __GFP_ACCOUNT);
 				if (unlikely(!page)) {
 					ret = ret ? : -ENOMEM;
 					break;
 				}
-				pipe->tmp_page = page;
+				pipe->tmp_page[pipe->nr_tmp_pages++] = page;
 			}
+			page = pipe->tmp_page[pipe->nr_tmp_pages - 1];
 			/* Always wake up, even if the copy fails. Otherwise
 			 * we lock up (O_NONBLOCK-)readers that sleep due to
 			 * syscall merging.
 			 * FIXME! Is this really true?
+			 *
+			 * Readers only sleep on an empty pipe, so further
+			 * buffers queued behind this one need no wakeup of
+			 * their own; the reader will find them before it
+			 * would block again.
 			 */
 			do_wakeup = 1;
+			if (!bufs || READ_ONCE(pipe->poll_usage))
+				wake_readers = 1;
 			copied = copy_page_from_iter(page, 0, PAGE_SIZE, from);
 			if (unlikely(copied < PAGE_SIZE && iov_iter_count(from))) {
 				if (!ret)
@@ -449,7 +478,7 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 				buf->flags = PIPE_BUF_FLAG_PACKET;
 			}
 			pipe->nrbufs = ++bufs;
-			pipe->tmp_page = NULL;
+			pipe->nr_tmp_pages--;
 
 			if (!iov_iter_count(from))
 				break;
@@ -467,9 +496,11 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 			break;
 		}
 		if (do_wakeup) {
-			wake_up_interruptible_sync_poll(&pipe->wait, POLLIN | POLLRDNORM);
+			if (wake_readers)
+				wake_up_interruptible_sync_poll(&pipe->wait, POLLIN | POLLRDNORM);
 			kill_fasync(&pipe->fasync_readers, SIGIO, POLL_IN);
 			do_wakeup = 0;
+			wake_readers = 0;
 		}
 		pipe->waiting_writers++;
 		pipe_wait(pipe);
@@ -478,7 +509,8 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 out:
 	__pipe_unlock(pipe);
 	if (do_wakeup) {
-		wake_up_interruptible_sync_poll(&pipe->wait, POLLIN | POLLRDNORM);
+		if (wake_readers)
+			wake_up_interruptible_sync_poll(&pipe->wait, POLLIN | POLLRDNORM);
 		kill_fasync(&pipe->fasync_readers, SIGIO, POLL_IN);
 	}
 	if (ret > 0 && sb_start_write_trylock(file_inode(filp)->i_sb)) {
@@ -521,6 +553,14 @@ pipe_poll(struct file *filp, poll_table *wait)
 	struct pipe_inode_info *pipe = filp->private_data;
 	int nrbufs;
 
+	/*
+	 * Pollers may be edge-triggered, so they cannot rely on the
+	 * empty/full transitions alone: from now on every read and
+	 * write on this pipe wakes up the waitqueue.
+	 */
+	if (!READ_ONCE(pipe->poll_usage))
+		WRITE_ONCE(pipe->poll_usage, true);
+
 	poll_wait(filp, &pipe->wait, wait);
 
 	/* Reading only -- no need for acquiring the semaphore.  */
@@ -672,8 +712,8 @@ void free_pipe_info(struct pipe_inode_info *pipe)
 		if (buf->ops)
 			pipe_buf_release(pipe, buf);
 	}
-	if (pipe->tmp_page)
-		__free_page(pipe->tmp_page);
+	for (i = 0; i < pipe->nr_tmp_pages; i++)
+		__free_page(pipe->tmp_page[i]);
 	kfree(pipe->bufs);
 	kfree(pipe);
 }
@@ -1108,6 +1148,12 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 	kfree(pipe->bufs);
 	pipe->bufs = bufs;
 	pipe->buffers = nr_pages;
+
+	/*
+	 * Writers blocked on the old, full size are only woken when a
+	 * full pipe drains, which may now never happen.
+	 */
+	wake_up_interruptible_all(&pipe->wait);
 	return nr_pages * PAGE_SIZE;
 
 out_revert_acct:
@@ -32,6 +32,7 @@
 #include <linux/security.h>
 #include <linux/gfp.h>
 #include <linux/socket.h>
+#include <linux/net.h>
 #include <linux/compat.h>
 #include <linux/sched/signal.h>
 
@@ -834,6 +835,128 @@ ssize_t generic_splice_sendpage(struct pipe_inode_info *pipe, struct file *out,
 
 EXPORT_SYMBOL(generic_splice_sendpage);
 
+#ifdef CONFIG_NET
+/**
+ * splice_to_socket_zerocopy - splice data from a pipe to a socket, MSG_ZEROCOPY
+ * @pipe:	pipe to splice from
+ * @out:	file of the socket
+ * @sock:	socket to send to
+ * @len:	number of bytes to splice
+ * @flags:	splice modifier flags
+ *
+ * Description:
+ *    Hands the pipe buffers to the socket in one sendmsg() with
+ *    MSG_ZEROCOPY, so the protocol may keep references to the pages in
+ *    its skbs instead of copying them.  Like that sendmsg(), the call
+ *    uses up one zerocopy notification id, and a completion is queued on
+ *    the error queue of the socket once the pages have been released.
+ *    Pages gifted to the pipe with vmsplice() may be reused from then on.
+ *
+ *    Only the buffers in the pipe at the time of the call are sent, so
+ *    that each call maps onto one notification; less than @len bytes may
+ *    be spliced.
+ */
+ssize_t splice_to_socket_zerocopy(struct pipe_inode_info *pipe,
+				  struct file *out, struct socket *sock,
+				  size_t len, unsigned int flags)
+{
+	struct splice_desc sd = {
+		.total_len = len,
+		.flags = flags,
+		.u.file = out,
+	};
+	struct msghdr msg = { .msg_flags = MSG_ZEROCOPY };
+	struct bio_vec *array;
+	size_t left;
+	ssize_t ret;
+	int n, idx;
+
+	pipe_lock(pipe);
+
+	splice_from_pipe_begin(&sd);
+	ret = splice_from_pipe_next(pipe, &sd);
+	if (ret <= 0)
+		goto out;
+
+	array = kcalloc(pipe->buffers, sizeof(struct bio_vec), GFP_KERNEL);
+	if (unlikely(!array)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/* build the vector */
+	left = len;
+	for (n = 0, idx = pipe->curbuf; left && n < pipe->nrbufs; n++, idx++) {
+		struct pipe_buffer *buf = pipe->bufs + idx;
+		size_t this_len = buf->len;
+
+		if (this_len > left)
+			this_len = left;
+
+		if (idx == pipe->buffers - 1)
+			idx = -1;
+
+		ret = pipe_buf_confirm(pipe, buf);
+		if (unlikely(ret)) {
+			if (n)
+				break;
+			if (ret == -ENODATA)
+				ret = 0;
+			goto out_free;
+		}
+
+		array[n].bv_page = buf->page;
+		array[n].bv_len = this_len;
+		array[n].bv_offset = buf->offset;
+		left -= this_len;
+	}
+
+	iov_iter_bvec(&msg.msg_iter, ITER_BVEC | WRITE, array, n, len - left);
+	if (flags & SPLICE_F_MORE)
+		msg.msg_flags |= MSG_MORE;
+	if (out->f_flags & O_NONBLOCK)
+		msg.msg_flags |= MSG_DONTWAIT;
+
+	ret = sock_sendmsg(sock, &msg);
+	if (ret <= 0)
+		goto out_free;
+	sd.num_spliced = ret;
+
+	/*
+	 * The socket holds its own page references now; dismiss the fully
+	 * eaten buffers and adjust the partial one.
+	 */
+	while (ret) {
+		struct pipe_buffer *buf = pipe->bufs + pipe->curbuf;
+
+		if (ret >= buf->len) {
+			ret -= buf->len;
+			buf->len = 0;
+			pipe_buf_release(pipe, buf);
+			pipe->curbuf = (pipe->curbuf + 1) & (pipe->buffers - 1);
+			pipe->nrbufs--;
+			if (pipe->files)
+				sd.need_wakeup = true;
+		} else {
+			buf->offset += ret;
+			buf->len -= ret;
+			ret = 0;
+		}
+	}
+out_free:
+	kfree(array);
+out:
+	splice_from_pipe_end(pipe, &sd);
+
+	pipe_unlock(pipe);
+
+	if (sd.num_spliced)
+		ret = sd.num_spliced;
+
+	return ret;
+}
+#endif
+
 /*
  * Attempt to initiate a splice from pipe to file.
  */
@@ -497,7 +497,104 @@ static int squashfs_readpage(struct file *file, struct page *page)
 	return 0;
 }
 
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+/*
+ * Readahead hands us the pages of whole datablocks at once.  Put each
+ * block's pages in the page cache together and decompress the block once,
+ * directly into them, rather than having ->readpage() find all but the
+ * first of them already locked and fall back to the intermediate cache.
+ * Fragments and sparse blocks take the ->readpage() path.
+ */
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned int nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_SHIFT;
+	int mask = (1 << shift) - 1;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	pgoff_t last = (i_size_read(inode) - 1) >> PAGE_SHIFT;
+	gfp_t gfp = readahead_gfp_mask(mapping);
+	struct page **page, *scratch;
+
+	page = kmalloc_array(mask + 1, sizeof(void *), GFP_KERNEL);
+	scratch = alloc_page(GFP_KERNEL);
+
+	while (!list_empty(pages)) {
+		struct page *p = lru_to_page(pages);
+		pgoff_t start = p->index & ~mask;
+		pgoff_t end = min_t(pgoff_t, start | mask, last);
+		int index = p->index >> shift;
+		int i, n = end - start + 1, bsize = 0;
+		u64 block = 0;
+
+		if (page == NULL || scratch == NULL || p->index > last) {
+			list_del(&p->lru);
+			if (!add_to_page_cache_lru(p, mapping, p->index, gfp))
+				squashfs_readpage(file, p);
+			put_page(p);
+			continue;
+		}
+
+		memset(page, 0, n * sizeof(void *));
+		while (!list_empty(pages)) {
+			p = lru_to_page(pages);
+			if (p->index > end)
+				break;
+			list_del(&p->lru);
+			if (add_to_page_cache_lru(p, mapping, p->index, gfp))
+				put_page(p);
+			else
+				page[p->index - start] = p;
+		}
+
+		if (index < file_end || squashfs_i(inode)->fragment_block ==
+						SQUASHFS_INVALID_BLK)
+			bsize = read_blocklist(inode, index, &block);
+
+		if (bsize <= 0) {
+			for (i = 0; i < n; i++) {
+				if (page[i] == NULL)
+					continue;
+				squashfs_readpage(file, page[i]);
+				put_page(page[i]);
+			}
+			continue;
+		}
+
+		/* Fill the rest of the block's pages while we're at it */
+		for (i = 0; i < n; i++) {
+			if (page[i])
+				continue;
+			page[i] = grab_cache_page_nowait(mapping, start + i);
+			if (page[i] && PageUptodate(page[i])) {
+				unlock_page(page[i]);
+				put_page(page[i]);
+				page[i] = NULL;
+			}
+		}
+
+		if (squashfs_readahead_block(inode, block, bsize, page, n,
+				page_address(scratch)))
+			ERROR("Unable to read page, block %llx, size %x\n",
+				block, bsize);
+
+		for (i = 0; i < n; i++)
+			if (page[i])
+				put_page(page[i]);
+	}
+
+	if (scratch)
+		__free_page(scratch);
+	kfree(page);
+	return 0;
+}
+#endif
+
 
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+	.readpages = squashfs_readpages,
+#endif
 };
@@ -137,6 +137,54 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 }
 
 
+/*
+ * Decompress a datablock straight into page[0 .. pages - 1], the locked page
+ * cache pages it covers, for readahead.  Entries may be NULL where the page
+ * is already uptodate or couldn't be had; that part of the block goes to
+ * the PAGE_SIZE @scratch buffer.  The pages are left uptodate, or errored,
+ * and unlocked.  The caller keeps its references.
+ */
+int squashfs_readahead_block(struct inode *inode, u64 block, int bsize,
+	struct page **page, int pages, void *scratch)
+{
+	struct squashfs_page_actor *actor;
+	int i, bytes, res = -ENOMEM;
+	void *pageaddr;
+
+	actor = squashfs_page_actor_init_special(page, pages, 0);
+	if (actor == NULL)
+		goto out;
+	actor->tmp_buffer = scratch;
+
+	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
+	kfree(actor);
+	if (res < 0)
+		goto out;
+
+	/* Last page may have trailing bytes not filled */
+	bytes = res % PAGE_SIZE;
+	if (bytes && page[pages - 1]) {
+		pageaddr = kmap_atomic(page[pages - 1]);
+		memset(pageaddr + bytes, 0, PAGE_SIZE - bytes);
+		kunmap_atomic(pageaddr);
+	}
+
+out:
+	for (i = 0; i < pages; i++) {
+		if (page[i] == NULL)
+			continue;
+		flush_dcache_page(page[i]);
+		if (res < 0)
+			SetPageError(page[i]);
+		else
+			SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+	}
+
+	return res < 0 ? res : 0;
+}
+
+
 static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
 	int pages, struct page **page)
 {
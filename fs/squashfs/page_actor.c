@@ -58,20 +58,37 @@ struct squashfs_page_actor *squashfs_page_actor_init(void **buffer,
 	return actor;
 }
 
-/* Implementation of page_actor for decompressing directly into page cache. */
+/*
+ * Implementation of page_actor for decompressing directly into page cache.
+ * A page the caller couldn't get hold of is NULL in the array, its data
+ * goes to actor->tmp_buffer and is thrown away.
+ */
+static void *direct_map_page(struct squashfs_page_actor *actor)
+{
+	struct page *page = actor->page[actor->next_page++];
+
+	if (page == NULL)
+		return actor->tmp_buffer;
+
+	return actor->pageaddr = kmap_atomic(page);
+}
+
 static void *direct_first_page(struct squashfs_page_actor *actor)
 {
-	actor->next_page = 1;
-	return actor->pageaddr = kmap_atomic(actor->page[0]);
+	actor->next_page = 0;
+	actor->pageaddr = NULL;
+	return direct_map_page(actor);
 }
 
 static void *direct_next_page(struct squashfs_page_actor *actor)
 {
-	if (actor->pageaddr)
+	if (actor->pageaddr) {
 		kunmap_atomic(actor->pageaddr);
+		actor->pageaddr = NULL;
+	}
 
-	return actor->pageaddr = actor->next_page == actor->pages ? NULL :
-		kmap_atomic(actor->page[actor->next_page++]);
+	return actor->next_page == actor->pages ? NULL :
+		direct_map_page(actor);
 }
 
 static void direct_finish_page(struct squashfs_page_actor *actor)
@@ -93,6 +110,7 @@ struct squashfs_page_actor *squashfs_page_actor_init_special(struct page **page,
 	actor->pages = pages;
 	actor->next_page = 0;
 	actor->pageaddr = NULL;
+	actor->tmp_buffer = NULL;
 	actor->squashfs_first_page = direct_first_page;
 	actor->squashfs_next_page = direct_next_page;
 	actor->squashfs_finish_page = direct_finish_page;
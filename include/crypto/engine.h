@@ -20,6 +20,8 @@
 #include <crypto/hash.h>
 
 #define ENGINE_NAME_LEN	30
+#define CRYPTO_ENGINE_MAX_QLEN 10
+
 /*
  * struct crypto_engine - crypto hardware engine
  * @name: the engine name
@@ -43,6 +45,18 @@
  * @prepare_hash_request: do some prepare if need before handle the current request
  * @unprepare_hash_request: undo any work done by prepare_hash_request()
  * @hash_one_request: do hash for current request
+ * @do_batch: if set, the engine runs in batching mode: instead of one
+ * request at a time through the callbacks above, up to @max_batch queued
+ * requests are handed over in a single call, so the driver can chain
+ * them to one doorbell. It returns how many of the leading requests it
+ * took, the rest are put back at the head of the queue and retried once
+ * a request completes; -ENOSPC takes none, any other error fails them
+ * all. Taken requests are completed with crypto_finalize_*_request().
+ * @max_batch: the largest batch passed to @do_batch, at most
+ * CRYPTO_ENGINE_MAX_QLEN (0 means that)
+ * @inflight: number of requests handed over by @do_batch and not finalized
+ * @stats: queue depth and batch size statistics, under @queue_lock
+ * @debugfs: the engine's debugfs directory
  * @kworker: kthread worker struct for request pump
  * @pump_requests: work struct for scheduling work to the request pump
  * @priv_data: the engine private data
@@ -77,6 +91,22 @@ struct crypto_engine {
 				  struct ablkcipher_request *req);
 	int (*hash_one_request)(struct crypto_engine *engine,
 				struct ahash_request *req);
+	int (*do_batch)(struct crypto_engine *engine,
+			struct crypto_async_request **reqs, unsigned int nr);
+
+	unsigned int		max_batch;
+	unsigned int		inflight;
+	struct {
+		unsigned long	pumps;
+		unsigned long	qlen_sum;
+		unsigned int	qlen_max;
+		unsigned long	batches;
+		unsigned long	batch_reqs;
+		unsigned int	batch_max;
+		unsigned long	retries;
+		unsigned long	errors;
+	} stats;
+	struct dentry		*debugfs;
 
 	struct kthread_worker           *kworker;
 	struct kthread_work             pump_requests;
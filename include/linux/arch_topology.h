@@ -4,6 +4,7 @@
 #ifndef _LINUX_ARCH_TOPOLOGY_H_
 #define _LINUX_ARCH_TOPOLOGY_H_
 
+#include <linux/percpu.h>
 #include <linux/types.h>
 
 void topology_normalize_cpu_scale(void);
@@ -16,4 +17,16 @@ unsigned long topology_get_cpu_scale(struct sched_domain *sd, int cpu);
 
 void topology_set_cpu_scale(unsigned int cpu, unsigned long capacity);
 
+struct cpumask;
+void arch_set_freq_scale(const struct cpumask *cpus, unsigned long cur_freq,
+			 unsigned long max_freq);
+
+DECLARE_PER_CPU(unsigned long, freq_scale);
+
+static inline
+unsigned long topology_get_freq_scale(struct sched_domain *sd, int cpu)
+{
+	return per_cpu(freq_scale, cpu);
+}
+
 #endif /* _LINUX_ARCH_TOPOLOGY_H_ */
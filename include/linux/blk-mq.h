@@ -56,6 +56,10 @@ struct blk_mq_hw_ctx {
 	unsigned long		poll_invoked;
 	unsigned long		poll_success;
 
+#ifdef CONFIG_BLK_MQ_LAT_HIST
+	struct blk_mq_lat_hist __percpu *lat_hist;
+#endif
+
 #ifdef CONFIG_BLK_DEBUG_FS
 	struct dentry		*debugfs_dir;
 	struct dentry		*sched_debugfs_dir;
@@ -67,8 +71,10 @@ struct blk_mq_hw_ctx {
 
 struct blk_mq_tag_set {
 	unsigned int		*mq_map;
+	unsigned int		*mq_poll_map;	/* cpu -> poll queue */
 	const struct blk_mq_ops	*ops;
 	unsigned int		nr_hw_queues;
+	unsigned int		nr_poll_queues;	/* last of nr_hw_queues */
 	unsigned int		queue_depth;	/* max hw supported */
 	unsigned int		reserved_tags;
 	unsigned int		cmd_size;	/* per-request extra data */
@@ -90,6 +96,8 @@ struct blk_mq_queue_data {
 
 typedef blk_status_t (queue_rq_fn)(struct blk_mq_hw_ctx *,
 		const struct blk_mq_queue_data *);
+typedef void (queue_rqs_fn)(struct blk_mq_hw_ctx *, struct list_head *);
+typedef void (commit_rqs_fn)(struct blk_mq_hw_ctx *);
 typedef enum blk_eh_timer_return (timeout_fn)(struct request *, bool);
 typedef int (init_hctx_fn)(struct blk_mq_hw_ctx *, void *, unsigned int);
 typedef void (exit_hctx_fn)(struct blk_mq_hw_ctx *, unsigned int);
@@ -111,6 +119,21 @@ struct blk_mq_ops {
 	 */
 	queue_rq_fn		*queue_rq;
 
+	/*
+	 * Queue a list of requests flushed from a plug at once. Requests
+	 * are removed from the list as they are queued; those left on it
+	 * must be untouched and are sent down ->queue_rq instead. Only
+	 * used on queues without an IO scheduler.
+	 */
+	queue_rqs_fn		*queue_rqs;
+
+	/*
+	 * A driver that holds back work, such as a doorbell write, for
+	 * requests queued with bd->last unset gets this called when a batch
+	 * ends without a request flagged last.
+	 */
+	commit_rqs_fn		*commit_rqs;
+
 	/*
 	 * Called on request timeout
 	 */
@@ -263,6 +286,22 @@ int blk_mq_reinit_tagset(struct blk_mq_tag_set *set,
 			 int (reinit_request)(void *, struct request *));
 
 int blk_mq_map_queues(struct blk_mq_tag_set *set);
+
+/*
+ * Poll queues are the last nr_poll_queues of a tag set's hardware queues.
+ * They have no interrupt: only REQ_HIPRI requests are sent there, and they
+ * are issued straight to the driver, never through the software queues.
+ */
+static inline unsigned int blk_mq_nr_default_queues(struct blk_mq_tag_set *set)
+{
+	return set->nr_hw_queues - set->nr_poll_queues;
+}
+
+static inline bool blk_mq_hctx_is_poll(struct blk_mq_hw_ctx *hctx)
+{
+	return hctx->queue_num >=
+		blk_mq_nr_default_queues(hctx->queue->tag_set);
+}
 void blk_mq_update_nr_hw_queues(struct blk_mq_tag_set *set, int nr_hw_queues);
 
 void blk_mq_quiesce_queue_nowait(struct request_queue *q);
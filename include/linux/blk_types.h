@@ -15,6 +15,7 @@ struct page;
 struct block_device;
 struct io_context;
 struct cgroup_subsys_state;
+struct blkcg_gq;
 typedef void (bio_end_io_t) (struct bio *);
 
 /*
@@ -89,6 +90,11 @@ struct bio {
 	void			*bi_cg_private;
 	struct blk_issue_stat	bi_issue_stat;
 #endif
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+	/* blkg the bio is accounted to and its issue time, see blk-iolatency */
+	struct blkcg_gq		*bi_iolat_blkg;
+	u64			bi_iolat_start;
+#endif
 #endif
 	union {
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
@@ -53,7 +53,7 @@ struct blk_stat_callback;
  * Maximum number of blkcg policies allowed to be registered concurrently.
  * Defined here to simplify include dependency.
  */
-#define BLKCG_MAX_POLS		3
+#define BLKCG_MAX_POLS		4
 
 typedef void (rq_end_io_fn)(struct request *, blk_status_t);
 
@@ -140,6 +140,7 @@ struct request {
 
 	struct request_queue *q;
 	struct blk_mq_ctx *mq_ctx;
+	struct blk_mq_hw_ctx *mq_hctx;
 
 	int cpu;
 	unsigned int cmd_flags;		/* op and common flags */
@@ -424,6 +425,7 @@ struct request_queue {
 	const struct blk_mq_ops	*mq_ops;
 
 	unsigned int		*mq_map;
+	unsigned int		*mq_poll_map;
 
 	/* sw queues */
 	struct blk_mq_ctx __percpu	*queue_ctx;
@@ -575,6 +577,10 @@ struct request_queue {
 #ifdef CONFIG_BLK_DEV_THROTTLING
 	/* Throttle data */
 	struct throtl_data *td;
+#endif
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+	/* Latency target data */
+	struct blk_iolatency *blkiolat;
 #endif
 	struct rcu_head		rcu_head;
 	wait_queue_head_t	mq_freeze_wq;
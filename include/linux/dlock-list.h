@@ -0,0 +1,136 @@
+/*
+ * Distributed and locked list
+ *
+ * A dlock list is a set of per-cpu lists, each protected by its own
+ * spinlock.  Insertion goes to the list of the current cpu so that
+ * concurrent adders on different cpus don't contend on a single lock;
+ * deletion goes to whichever list the node was added to.  Walking all
+ * the entries is more expensive and is meant for slow paths only.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __LINUX_DLOCK_LIST_H
+#define __LINUX_DLOCK_LIST_H
+
+#include <linux/list.h>
+#include <linux/spinlock.h>
+
+struct dlock_list_head {
+	struct list_head list;
+	spinlock_t lock;
+} ____cacheline_aligned_in_smp;
+
+struct dlock_list_heads {
+	struct dlock_list_head *heads;
+};
+
+/*
+ * A list node embedded in the objects put on a dlock list.  @head points
+ * back to the per-cpu list the node is on, or is NULL if it is on none.
+ */
+struct dlock_list_node {
+	struct list_head list;
+	struct dlock_list_head *head;
+};
+
+/*
+ * Iteration state.  While the walk is inside a list, the lock of
+ * @entry is held; it is dropped on reaching the end of the walk.
+ */
+struct dlock_list_iter {
+	int index;
+	struct dlock_list_head *head, *entry;
+};
+
+#define DLOCK_LIST_ITER_INIT(dlist)		\
+	{					\
+		.index = -1,			\
+		.head = (dlist)->heads,		\
+	}
+
+#define DEFINE_DLOCK_LIST_ITER(s, dlist)	\
+	struct dlock_list_iter s = DLOCK_LIST_ITER_INIT(dlist)
+
+static inline void init_dlock_list_iter(struct dlock_list_iter *iter,
+					struct dlock_list_heads *dlist)
+{
+	*iter = (struct dlock_list_iter)DLOCK_LIST_ITER_INIT(dlist);
+}
+
+static inline void init_dlock_list_node(struct dlock_list_node *node)
+{
+	INIT_LIST_HEAD(&node->list);
+	node->head = NULL;
+}
+
+/*
+ * Drop and retake the lock of the list the iterator is currently in, so
+ * the caller can block.  The current entry must be pinned by the caller
+ * while the lock is dropped, the walk resumes from it.
+ */
+static inline void dlock_list_unlock(struct dlock_list_iter *iter)
+{
+	spin_unlock(&iter->entry->lock);
+}
+
+static inline void dlock_list_relock(struct dlock_list_iter *iter)
+{
+	spin_lock(&iter->entry->lock);
+}
+
+extern int __alloc_dlock_list_heads(struct dlock_list_heads *dlist,
+				    struct lock_class_key *key);
+extern void free_dlock_list_heads(struct dlock_list_heads *dlist);
+
+#define alloc_dlock_list_heads(dlist)					\
+({									\
+	static struct lock_class_key _key;				\
+	__alloc_dlock_list_heads(dlist, &_key);				\
+})
+
+extern bool dlock_lists_empty(struct dlock_list_heads *dlist);
+extern void dlock_lists_add(struct dlock_list_node *node,
+			    struct dlock_list_heads *dlist);
+extern void dlock_lists_del(struct dlock_list_node *node);
+
+extern struct dlock_list_node *
+__dlock_list_next_list(struct dlock_list_iter *iter);
+
+static inline struct dlock_list_node *
+__dlock_list_next_entry(struct dlock_list_node *curr,
+			struct dlock_list_iter *iter)
+{
+	if (curr) {
+		curr = list_next_entry(curr, list);
+		if (&curr->list != &iter->entry->list)
+			return curr;
+	}
+	return __dlock_list_next_list(iter);
+}
+
+#define __dlist_entry_or_null(node, type, member)			\
+({									\
+	struct dlock_list_node *__n = (node);				\
+	__n ? list_entry(__n, type, member) : NULL;			\
+})
+
+/**
+ * dlist_for_each_entry - iterate over all the entries of a dlock list
+ * @pos:	the type * to use as a loop cursor
+ * @iter:	the dlock list iterator, initialized to the start of the lists
+ * @member:	the name of the dlock_list_node within the struct
+ *
+ * The lock of the list holding @pos is held inside the loop body.  Breaking
+ * out of the loop early requires a dlock_list_unlock(@iter).
+ */
+#define dlist_for_each_entry(pos, iter, member)				\
+	for (pos = __dlist_entry_or_null(__dlock_list_next_entry(NULL, iter), \
+					 typeof(*pos), member);		\
+	     pos;							\
+	     pos = __dlist_entry_or_null(				\
+			__dlock_list_next_entry(&(pos)->member, iter),	\
+			typeof(*pos), member))
+
+#endif /* __LINUX_DLOCK_LIST_H */
@@ -16,6 +16,7 @@
 #include <linux/sched.h>
 #include <linux/capability.h>
 #include <linux/cryptohash.h>
+#include <linux/jump_label.h>
 #include <linux/set_memory.h>
 
 #include <net/sch_generic.h>
@@ -27,6 +28,7 @@ struct sk_buff;
 struct sock;
 struct seccomp_data;
 struct bpf_prog_aux;
+struct xdp_umem;
 
 /* ArgX, context and stack frame pointer register positions. Note,
  * Arg1, Arg2, Arg3, etc are used as argument mappings of function
@@ -481,7 +483,16 @@ struct sk_filter {
 	struct bpf_prog	*prog;
 };
 
-#define BPF_PROG_RUN(filter, ctx)  (*filter->bpf_func)(ctx, filter->insnsi)
+/* kernel.bpf_stats_enabled: count runs and run time of every program */
+DECLARE_STATIC_KEY_FALSE(bpf_stats_enabled_key);
+
+unsigned int __bpf_prog_run_stats(const struct bpf_prog *prog,
+				  const void *ctx);
+
+#define BPF_PROG_RUN(filter, ctx)					\
+	(static_branch_unlikely(&bpf_stats_enabled_key) ?		\
+	 __bpf_prog_run_stats(filter, ctx) :				\
+	 (*(filter)->bpf_func)(ctx, (filter)->insnsi))
 
 #define BPF_SKB_CB_LEN QDISC_CB_PRIV_LEN
 
@@ -723,6 +734,9 @@ int xdp_do_generic_redirect(struct net_device *dev, struct sk_buff *skb,
 int xdp_do_redirect(struct net_device *dev,
 		    struct xdp_buff *xdp,
 		    struct bpf_prog *prog);
+int xdp_do_redirect_umem(struct net_device *dev, struct xdp_buff *xdp,
+			 struct bpf_prog *prog, struct xdp_umem *umem,
+			 u64 handle);
 void xdp_do_flush_map(void);
 
 void bpf_warn_invalid_xdp_action(u32 act);
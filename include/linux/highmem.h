@@ -7,6 +7,7 @@
 #include <linux/mm.h>
 #include <linux/uaccess.h>
 #include <linux/hardirq.h>
+#include <linux/page_prezero.h>
 
 #include <asm/cacheflush.h>
 
@@ -158,9 +159,13 @@ __alloc_zeroed_user_highpage(gfp_t movableflags,
 			struct vm_area_struct *vma,
 			unsigned long vaddr)
 {
-	struct page *page = alloc_page_vma(GFP_HIGHUSER | movableflags,
-			vma, vaddr);
+	struct page *page;
 
+	if (page_prezero_enabled())
+		return alloc_page_vma(GFP_HIGHUSER | movableflags | __GFP_ZERO,
+				      vma, vaddr);
+
+	page = alloc_page_vma(GFP_HIGHUSER | movableflags, vma, vaddr);
 	if (page)
 		clear_user_highpage(page, vaddr);
 
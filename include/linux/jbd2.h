@@ -29,6 +29,7 @@
 #include <linux/mutex.h>
 #include <linux/timer.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 #include <linux/bit_spinlock.h>
 #include <crypto/hash.h>
 #endif
@@ -70,6 +71,7 @@ extern void *jbd2_alloc(size_t size, gfp_t flags);
 extern void jbd2_free(void *ptr, size_t size);
 
 #define JBD2_MIN_JOURNAL_BLOCKS 1024
+#define JBD2_DEFAULT_FAST_COMMIT_BLOCKS 256
 
 #ifdef __KERNEL__
 
@@ -265,7 +267,9 @@ typedef struct journal_superblock_s
 /* 0x0050 */
 	__u8	s_checksum_type;	/* checksum type */
 	__u8	s_padding2[3];
-	__u32	s_padding[42];
+/* 0x0054 */
+	__be32	s_num_fc_blks;		/* Number of fast commit blocks */
+	__u32	s_padding[41];
 	__be32	s_checksum;		/* crc32c(superblock) */
 
 /* 0x0100 */
@@ -291,6 +295,7 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
 #define JBD2_FEATURE_INCOMPAT_CSUM_V2		0x00000008
 #define JBD2_FEATURE_INCOMPAT_CSUM_V3		0x00000010
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT	0x00000020
 
 /* See "journal feature predicate functions" below */
 
@@ -301,7 +306,8 @@ typedef struct journal_superblock_s
 					JBD2_FEATURE_INCOMPAT_64BIT | \
 					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
 					JBD2_FEATURE_INCOMPAT_CSUM_V2 | \
-					JBD2_FEATURE_INCOMPAT_CSUM_V3)
+					JBD2_FEATURE_INCOMPAT_CSUM_V3 | \
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
 
 #ifdef __KERNEL__
 
@@ -749,6 +755,8 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_wait_updates: Wait queue to wait for updates to complete
  * @j_wait_reserved: Wait queue to wait for reserved buffer credits to drop
  * @j_checkpoint_mutex: Mutex for locking against concurrent checkpoints
+ * @j_checkpoint_work: Work item checkpointing in the background when the
+ *  log runs low on space
  * @j_head: Journal head - identifies the first unused block in the journal
  * @j_tail: Journal tail - identifies the oldest still-used block in the
  *  journal.
@@ -770,6 +778,8 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_transaction_sequence: Sequence number of the next transaction to grant
  * @j_commit_sequence: Sequence number of the most recently committed
  *  transaction
+ * @j_durable_sequence: Sequence number of the most recent transaction whose
+ *  commit record is on stable storage, possibly still being committed
  * @j_commit_request: Sequence number of the most recent transaction wanting
  *     commit
  * @j_uuid: Uuid of client object.
@@ -871,6 +881,9 @@ struct journal_s
 	 * j_checkpoint_mutex.  [j_checkpoint_mutex]
 	 */
 	struct buffer_head	*j_chkpt_bhs[JBD2_NR_BATCH];
+
+	/* Work item for background checkpointing */
+	struct work_struct	j_checkpoint_work;
 	
 	/*
 	 * Journal head: identifies the first unused block in the journal.
@@ -897,6 +910,14 @@ struct journal_s
 	unsigned long		j_first;
 	unsigned long		j_last;
 
+	/*
+	 * Fast commit area: j_fc_len blocks starting at j_fc_first, right
+	 * after the log proper (j_fc_first == j_last).  Only set up when
+	 * the journal has the FAST_COMMIT feature.
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_len;
+
 	/*
 	 * Device, blocksize and starting block offset for the location where we
 	 * store the journal.
@@ -944,6 +965,14 @@ struct journal_s
 	 */
 	tid_t			j_commit_sequence;
 
+	/*
+	 * Sequence number of the most recent transaction whose commit
+	 * record is on stable storage.  That is ahead of j_commit_sequence
+	 * while the commit thread finishes the transaction off.
+	 * [j_state_lock]
+	 */
+	tid_t			j_durable_sequence;
+
 	/*
 	 * Sequence number of the most recent transaction wanting commit
 	 * [j_state_lock]
@@ -1013,6 +1042,16 @@ struct journal_s
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
 
+	/*
+	 * Called by recovery for each block of the fast commit area, in
+	 * order, with the ID of the transaction that was running at the
+	 * crash.  Returns 1 to go on with the next block, 0 once the valid
+	 * records are used up, or a negative error.
+	 */
+	int			(*j_fc_replay_callback)(journal_t *,
+							struct buffer_head *,
+							unsigned long, tid_t);
+
 	/*
 	 * Journal statistics
 	 */
@@ -1116,6 +1155,7 @@ JBD2_FEATURE_INCOMPAT_FUNCS(64bit,		64BIT)
 JBD2_FEATURE_INCOMPAT_FUNCS(async_commit,	ASYNC_COMMIT)
 JBD2_FEATURE_INCOMPAT_FUNCS(csum2,		CSUM_V2)
 JBD2_FEATURE_INCOMPAT_FUNCS(csum3,		CSUM_V3)
+JBD2_FEATURE_INCOMPAT_FUNCS(fast_commit,	FAST_COMMIT)
 
 /*
  * Journal flag definitions
@@ -1290,6 +1330,7 @@ extern int	   jbd2_journal_errno      (journal_t *);
 extern void	   jbd2_journal_ack_err    (journal_t *);
 extern int	   jbd2_journal_clear_err  (journal_t *);
 extern int	   jbd2_journal_bmap(journal_t *, unsigned long, unsigned long long *);
+extern int	   jbd2_fc_write_block(journal_t *, unsigned long, const void *);
 extern int	   jbd2_journal_force_commit(journal_t *);
 extern int	   jbd2_journal_force_commit_nested(journal_t *);
 extern int	   jbd2_journal_inode_add_write(handle_t *handle, struct jbd2_inode *inode);
@@ -1367,11 +1408,15 @@ int jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
+int jbd2_log_wait_durable(journal_t *journal, tid_t tid);
 int jbd2_complete_transaction(journal_t *journal, tid_t tid);
+int jbd2_complete_transaction_durable(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
 
 void __jbd2_log_wait_for_space(journal_t *journal);
+void jbd2_log_start_checkpoint(journal_t *journal);
+void jbd2_checkpoint_work(struct work_struct *work);
 extern void __jbd2_journal_drop_transaction(journal_t *, transaction_t *);
 extern int jbd2_cleanup_journal_tail(journal_t *);
 
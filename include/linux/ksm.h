@@ -22,14 +22,33 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags);
 int __ksm_enter(struct mm_struct *mm);
 void __ksm_exit(struct mm_struct *mm);
+int ksm_enable_merge_any(struct mm_struct *mm);
+int ksm_disable_merge_any(struct mm_struct *mm);
+unsigned long __ksm_vma_flags(struct mm_struct *mm, unsigned long vm_flags);
+long ksm_process_profit(struct mm_struct *mm);
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
+	/* The child starts with no pages merged, whatever its parent had */
+	mm->ksm_merging_pages = 0;
+	mm->ksm_rmap_items = 0;
 	if (test_bit(MMF_VM_MERGEABLE, &oldmm->flags))
 		return __ksm_enter(mm);
 	return 0;
 }
 
+/*
+ * Called with mmap_sem held for writing, on the flags of a new vma: under
+ * PR_SET_MEMORY_MERGE, make it mergeable if KSM could be advised on it.
+ */
+static inline unsigned long ksm_vma_flags(struct mm_struct *mm,
+					  unsigned long vm_flags)
+{
+	if (test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		return __ksm_vma_flags(mm, vm_flags);
+	return vm_flags;
+}
+
 static inline void ksm_exit(struct mm_struct *mm)
 {
 	if (test_bit(MMF_VM_MERGEABLE, &mm->flags))
@@ -75,6 +94,12 @@ static inline void ksm_exit(struct mm_struct *mm)
 {
 }
 
+static inline unsigned long ksm_vma_flags(struct mm_struct *mm,
+					  unsigned long vm_flags)
+{
+	return vm_flags;
+}
+
 #ifdef CONFIG_MMU
 static inline int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
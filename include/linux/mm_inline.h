@@ -43,9 +43,139 @@ static __always_inline void update_lru_size(struct lruvec *lruvec,
 #endif
 }
 
+#ifdef CONFIG_LRU_GEN
+static inline int lru_gen_from_seq(unsigned long seq)
+{
+	return seq % MAX_NR_GENS;
+}
+
+/* Returns the generation of a page on a generation list, or -1 */
+static inline int page_lru_gen(struct page *page)
+{
+	unsigned long flags = READ_ONCE(page->flags);
+
+	return (int)((flags >> LRU_GEN_PGSHIFT) & LRU_GEN_MASK) - 1;
+}
+
+static inline void page_set_lru_gen(struct page *page, int gen)
+{
+	unsigned long old_flags, flags;
+
+	do {
+		old_flags = flags = READ_ONCE(page->flags);
+		flags &= ~(LRU_GEN_MASK << LRU_GEN_PGSHIFT);
+		flags |= (gen + 1UL) << LRU_GEN_PGSHIFT;
+	} while (unlikely(cmpxchg(&page->flags, old_flags, flags) !=
+			  old_flags));
+}
+
+static inline bool lru_gen_is_active(struct lruvec *lruvec, int gen)
+{
+	unsigned long max_seq = READ_ONCE(lruvec->lrugen.max_seq);
+
+	return gen == lru_gen_from_seq(max_seq) ||
+	       gen == lru_gen_from_seq(max_seq - 1);
+}
+
+/*
+ * The pages of a generation are also counted on the active or inactive
+ * LRU of their type, so the node, zone and memcg statistics keep working.
+ */
+static __always_inline void lru_gen_update_size(struct lruvec *lruvec,
+				int type, enum zone_type zid, int gen,
+				int nr_pages)
+{
+	enum lru_list lru = type * LRU_FILE;
+
+	if (lru_gen_is_active(lruvec, gen))
+		lru += LRU_ACTIVE;
+
+	lruvec->lrugen.nr_pages[gen][type][zid] += nr_pages;
+	update_lru_size(lruvec, lru, zid, nr_pages);
+}
+
+/*
+ * Active pages go to the youngest generation.  Inactive pages go to the
+ * youngest one that is not active, or to the oldest one if they are wanted
+ * at the tail of the LRU.  PG_active is not kept while a page is on a
+ * generation list, the generation says it all.
+ */
+static __always_inline bool lru_gen_add_page(struct page *page,
+				struct lruvec *lruvec, bool tail)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int type = page_is_file_cache(page);
+	enum zone_type zid = page_zonenum(page);
+	unsigned long seq;
+	int gen;
+
+	if (!lrugen->enabled || PageUnevictable(page))
+		return false;
+
+	if (PageActive(page))
+		seq = lrugen->max_seq;
+	else if (tail)
+		seq = lrugen->min_seq[type];
+	else
+		seq = max(lrugen->max_seq - MIN_NR_GENS, lrugen->min_seq[type]);
+
+	gen = lru_gen_from_seq(seq);
+	ClearPageActive(page);
+	page_set_lru_gen(page, gen);
+	lru_gen_update_size(lruvec, type, zid, gen, hpage_nr_pages(page));
+
+	if (tail)
+		list_add_tail(&page->lru, &lrugen->lists[gen][type][zid]);
+	else
+		list_add(&page->lru, &lrugen->lists[gen][type][zid]);
+
+	return true;
+}
+
+/*
+ * A page taken off an active generation gets PG_active back, so that it is
+ * put on the active list should the generations be switched off meanwhile,
+ * unless it is being reclaimed.
+ */
+static __always_inline bool lru_gen_del_page(struct page *page,
+				struct lruvec *lruvec, bool reclaiming)
+{
+	int type = page_is_file_cache(page);
+	enum zone_type zid = page_zonenum(page);
+	int gen = page_lru_gen(page);
+
+	if (gen < 0)
+		return false;
+
+	list_del(&page->lru);
+	page_set_lru_gen(page, -1);
+	lru_gen_update_size(lruvec, type, zid, gen, -hpage_nr_pages(page));
+
+	if (!reclaiming && lru_gen_is_active(lruvec, gen))
+		SetPageActive(page);
+
+	return true;
+}
+#else
+static __always_inline bool lru_gen_add_page(struct page *page,
+				struct lruvec *lruvec, bool tail)
+{
+	return false;
+}
+
+static __always_inline bool lru_gen_del_page(struct page *page,
+				struct lruvec *lruvec, bool reclaiming)
+{
+	return false;
+}
+#endif /* CONFIG_LRU_GEN */
+
 static __always_inline void add_page_to_lru_list(struct page *page,
 				struct lruvec *lruvec, enum lru_list lru)
 {
+	if (lru_gen_add_page(page, lruvec, false))
+		return;
+
 	update_lru_size(lruvec, lru, page_zonenum(page), hpage_nr_pages(page));
 	list_add(&page->lru, &lruvec->lists[lru]);
 }
@@ -53,6 +183,9 @@ static __always_inline void add_page_to_lru_list(struct page *page,
 static __always_inline void add_page_to_lru_list_tail(struct page *page,
 				struct lruvec *lruvec, enum lru_list lru)
 {
+	if (lru_gen_add_page(page, lruvec, true))
+		return;
+
 	update_lru_size(lruvec, lru, page_zonenum(page), hpage_nr_pages(page));
 	list_add_tail(&page->lru, &lruvec->lists[lru]);
 }
@@ -60,6 +193,9 @@ static __always_inline void add_page_to_lru_list_tail(struct page *page,
 static __always_inline void del_page_from_lru_list(struct page *page,
 				struct lruvec *lruvec, enum lru_list lru)
 {
+	if (lru_gen_del_page(page, lruvec, false))
+		return;
+
 	list_del(&page->lru);
 	update_lru_size(lruvec, lru, page_zonenum(page), -hpage_nr_pages(page));
 }
@@ -13,6 +13,7 @@
 #include <linux/uprobes.h>
 #include <linux/page-flags-layout.h>
 #include <linux/workqueue.h>
+#include <linux/seqlock.h>
 
 #include <asm/mmu.h>
 
@@ -342,8 +343,22 @@ struct vm_area_struct {
 #endif
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
+#endif
+#ifdef CONFIG_NUMA_BALANCING
+	/* Hinting fault migrations since the last NUMA scan pass */
+	unsigned int vm_numa_migrated;
+	/* Consecutive NUMA scan passes without migrations */
+	unsigned int vm_numa_stable;
 #endif
 	struct vm_userfaultfd_ctx vm_userfaultfd_ctx;
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	/*
+	 * Bumped around every change a speculative fault must not race
+	 * with; vm_ref_count keeps the vma alive while one is running.
+	 */
+	seqcount_t vm_sequence;
+	atomic_t vm_ref_count;
+#endif
 } __randomize_layout;
 
 struct core_thread {
@@ -361,6 +376,9 @@ struct kioctx_table;
 struct mm_struct {
 	struct vm_area_struct *mmap;		/* list of VMAs */
 	struct rb_root mm_rb;
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	rwlock_t mm_rb_lock;			/* mm_rb for lockless lookups */
+#endif
 	u32 vmacache_seqnum;                   /* per-thread vmacache */
 #ifdef CONFIG_MMU
 	unsigned long (*get_unmapped_area) (struct file *filp,
@@ -411,6 +429,9 @@ struct mm_struct {
 						 * together off init_mm.mmlist, and are protected
 						 * by mmlist_lock
 						 */
+#ifdef CONFIG_LRU_GEN
+	struct list_head lru_gen_mm_list;	/* see lru_gen_add_mm() */
+#endif
 
 
 	unsigned long hiwater_rss;	/* High-watermark of RSS usage */
@@ -508,6 +529,17 @@ struct mm_struct {
 #endif
 	struct work_struct async_put_work;
 
+#ifdef CONFIG_KSM
+	/*
+	 * Pages of this mm that KSM has merged into the stable tree, and
+	 * the rmap_items it keeps for them: see /proc/<pid>/ksm_stat.
+	 */
+	unsigned long ksm_merging_pages;
+	unsigned long ksm_rmap_items;
+	/* Scanned every (1 << ksm_priority) passes, see PR_SET_KSM_PRIORITY */
+	unsigned int ksm_priority;
+#endif
+
 #if IS_ENABLED(CONFIG_HMM)
 	/* HMM needs to track a few things per mm */
 	struct hmm *hmm;
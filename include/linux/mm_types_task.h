@@ -72,10 +72,10 @@ struct tlbflush_unmap_batch {
 #ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
 	/*
 	 * The arch code makes the following promise: generic code can modify a
-	 * PTE, then call arch_tlbbatch_add_mm() (which internally provides all
-	 * needed barriers), then call arch_tlbbatch_flush(), and the entries
-	 * will be flushed on all CPUs by the time that arch_tlbbatch_flush()
-	 * returns.
+	 * PTE, then call arch_tlbbatch_add_mm() with the mm and user address
+	 * of that PTE (which internally provides all needed barriers), then
+	 * call arch_tlbbatch_flush(), and the entries will be flushed on all
+	 * CPUs by the time that arch_tlbbatch_flush() returns.
 	 */
 	struct arch_tlbflush_unmap_batch arch;
 
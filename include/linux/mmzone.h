@@ -231,6 +231,39 @@ struct zone_reclaim_stat {
 	unsigned long		recent_scanned[2];
 };
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-generational LRU sorts the evictable pages of a lruvec into
+ * generations numbered by a sequence.  Pages found accessed by the page
+ * table walk move to the youngest generation, max_seq, and eviction takes
+ * pages from the oldest one, min_seq, which is kept separately for anon
+ * and file pages since only one of them may be reclaimable.  The two
+ * youngest generations are accounted as active, the rest as inactive.
+ */
+#define MIN_NR_GENS		2
+#define MAX_NR_GENS		4
+
+/* anon pages are of type 0, file pages of type 1, as in zone_reclaim_stat */
+#define ANON_AND_FILE		2
+
+struct lru_gen_struct {
+	/* the youngest generation */
+	unsigned long max_seq;
+	/* the oldest generation of anon and file pages */
+	unsigned long min_seq[ANON_AND_FILE];
+	/* when each generation was created, in jiffies */
+	unsigned long timestamps[MAX_NR_GENS];
+	struct list_head lists[MAX_NR_GENS][ANON_AND_FILE][MAX_NR_ZONES];
+	long nr_pages[MAX_NR_GENS][ANON_AND_FILE][MAX_NR_ZONES];
+	/* for the lru_gen debugfs file */
+	unsigned long nr_aging;
+	unsigned long nr_young;
+	unsigned long nr_evicted;
+	/* pages are added to the lists above rather than lruvec->lists */
+	bool enabled;
+};
+#endif
+
 struct lruvec {
 	struct list_head		lists[NR_LRU_LISTS];
 	struct zone_reclaim_stat	reclaim_stat;
@@ -238,6 +271,9 @@ struct lruvec {
 	atomic_long_t			inactive_age;
 	/* Refaults at the time of last reclaim cycle */
 	unsigned long			refaults;
+#ifdef CONFIG_LRU_GEN
+	struct lru_gen_struct		lrugen;
+#endif
 #ifdef CONFIG_MEMCG
 	struct pglist_data *pgdat;
 #endif
@@ -269,13 +305,27 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * The pcp lists cache order-0 up to PAGE_ALLOC_COSTLY_ORDER pages, plus
+ * PMD-sized pages when THP is enabled.
+ */
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define NR_PCP_THP 1
+#else
+#define NR_PCP_THP 0
+#endif
+#define NR_PCP_ORDERS (PAGE_ALLOC_COSTLY_ORDER + 1 + NR_PCP_THP)
+#define NR_PCP_LISTS (MIGRATE_PCPTYPES * NR_PCP_ORDERS)
+
 struct per_cpu_pages {
-	int count;		/* number of pages in the list */
+	int count;		/* number of base pages in the lists */
 	int high;		/* high watermark, emptying needed */
 	int batch;		/* chunk size for buddy add/remove */
 
-	/* Lists of pages, one per migrate type stored on the pcp-lists */
-	struct list_head lists[MIGRATE_PCPTYPES];
+	/* Lists of pages, one per migrate type and order */
+	struct list_head lists[NR_PCP_LISTS];
+	/* Number of pages of each cached order, for /proc/zoneinfo */
+	int order_count[NR_PCP_ORDERS];
 };
 
 struct per_cpu_pageset {
@@ -797,6 +847,14 @@ extern void init_currently_empty_zone(struct zone *zone, unsigned long start_pfn
 
 extern void lruvec_init(struct lruvec *lruvec);
 
+#ifdef CONFIG_LRU_GEN
+extern void lru_gen_init_lruvec(struct lruvec *lruvec);
+#else
+static inline void lru_gen_init_lruvec(struct lruvec *lruvec)
+{
+}
+#endif
+
 static inline struct pglist_data *lruvec_pgdat(struct lruvec *lruvec)
 {
 #ifdef CONFIG_MEMCG
@@ -104,6 +104,9 @@ enum pageflags {
 #if defined(CONFIG_IDLE_PAGE_TRACKING) && defined(CONFIG_64BIT)
 	PG_young,
 	PG_idle,
+#endif
+#ifdef CONFIG_PAGE_PREZERO
+	PG_zeroed,		/* Free page held zeroed in the prezero pool */
 #endif
 	__NR_PAGEFLAGS,
 
@@ -373,6 +376,14 @@ TESTCLEARFLAG(Young, young, PF_ANY)
 PAGEFLAG(Idle, idle, PF_ANY)
 #endif
 
+#ifdef CONFIG_PAGE_PREZERO
+PAGEFLAG(Zeroed, zeroed, PF_NO_COMPOUND)
+#define __PG_ZEROED		(1UL << PG_zeroed)
+#else
+PAGEFLAG_FALSE(Zeroed)
+#define __PG_ZEROED		0
+#endif
+
 /*
  * On an anonymous page mapped into a user virtual memory area,
  * page->mapping points to its anon_vma, not to a struct address_space;
@@ -725,7 +736,8 @@ static inline void ClearPageSlabPfmemalloc(struct page *page)
 	 1UL << PG_private	| 1UL << PG_private_2	|	\
 	 1UL << PG_writeback	| 1UL << PG_reserved	|	\
 	 1UL << PG_slab		| 1UL << PG_active 	|	\
-	 1UL << PG_unevictable	| __PG_MLOCKED)
+	 1UL << PG_unevictable	| __PG_MLOCKED		|	\
+	 __PG_ZEROED)
 
 /*
  * Flags checked when a page is prepped for return by the page allocator.
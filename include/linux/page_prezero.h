@@ -0,0 +1,25 @@
+#ifndef _LINUX_MM_PAGE_PREZERO_H
+#define _LINUX_MM_PAGE_PREZERO_H
+
+#include <linux/jump_label.h>
+
+#ifdef CONFIG_PAGE_PREZERO
+DECLARE_STATIC_KEY_FALSE(page_prezero_key);
+
+/*
+ * While the pool is enabled, user page faults ask the allocator for
+ * __GFP_ZERO pages instead of clearing the page themselves, so that a
+ * page zeroed ahead of time by kprezerod can be handed out as is.
+ */
+static inline bool page_prezero_enabled(void)
+{
+	return static_branch_unlikely(&page_prezero_key);
+}
+#else /* !CONFIG_PAGE_PREZERO */
+static inline bool page_prezero_enabled(void)
+{
+	return false;
+}
+#endif /* CONFIG_PAGE_PREZERO */
+
+#endif /* _LINUX_MM_PAGE_PREZERO_H */
@@ -616,6 +616,28 @@ extern void delete_from_page_cache(struct page *page);
 extern void __delete_from_page_cache(struct page *page, void *shadow);
 int replace_page_cache_page(struct page *old, struct page *new, gfp_t gfp_mask);
 
+/*
+ * Readahead pages are moved from the ->readpages() list into the page cache
+ * READAHEAD_BATCH at a time, under a single acquisition of the tree_lock.
+ */
+#define READAHEAD_BATCH		16
+
+struct readahead_batch {
+	unsigned int	nr;
+	unsigned int	idx;
+	struct page	*pages[READAHEAD_BATCH];
+};
+
+static inline void readahead_batch_init(struct readahead_batch *rab)
+{
+	rab->nr = 0;
+	rab->idx = 0;
+}
+
+struct page *readahead_next_page(struct address_space *mapping,
+				 struct list_head *pages,
+				 struct readahead_batch *rab, gfp_t gfp_mask);
+
 /*
  * Like add_to_page_cache_locked, but used to add newly allocated pages:
  * the page is new, so we can just run __SetPageLocked() against it.
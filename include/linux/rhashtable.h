@@ -78,6 +78,8 @@ struct rhlist_head {
  * @size: Number of hash buckets
  * @nest: Number of bits of first-level nested table.
  * @rehash: Current bucket being rehashed
+ * @rehash_helped: Buckets rehashed by inserters rather than the worker
+ * @attach_ns: When the table was attached as a future_tbl, for tracing
  * @hash_rnd: Random seed to fold into hash
  * @locks_mask: Mask to apply before accessing locks[]
  * @locks: Array of spinlocks protecting individual buckets
@@ -91,6 +93,8 @@ struct bucket_table {
 	unsigned int		size;
 	unsigned int		nest;
 	unsigned int		rehash;
+	atomic_t		rehash_helped;
+	u64			attach_ns;
 	u32			hash_rnd;
 	unsigned int		locks_mask;
 	spinlock_t		*locks;
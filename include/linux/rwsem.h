@@ -37,6 +37,11 @@ struct rw_semaphore {
 	 * if the owner is running on the cpu.
 	 */
 	struct task_struct *owner;
+	/*
+	 * Set by a waiter that has been starved for too long; spinners then
+	 * leave the lock to the waiters instead of stealing it.
+	 */
+	int handoff;
 #endif
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map	dep_map;
@@ -305,6 +305,7 @@ struct sk_buff;
 #define MAX_SKB_FRAGS (65536/PAGE_SIZE + 1)
 #endif
 extern int sysctl_max_skb_frags;
+extern int sysctl_skb_defer_max;
 
 /* Set skb_shinfo(skb)->gso_size to this in case you want skb_segment to
  * segment using its current segmentation instead.
@@ -569,6 +570,8 @@ enum {
 	SKB_GSO_SCTP = 1 << 14,
 
 	SKB_GSO_ESP = 1 << 15,
+
+	SKB_GSO_UDP_L4 = 1 << 16,
 };
 
 #if BITS_PER_LONG > 32
@@ -645,6 +648,7 @@ typedef unsigned char *sk_buff_data_t;
  *	@transport_header: Transport layer header
  *	@network_header: Network layer header
  *	@mac_header: Link layer header
+ *	@alloc_cpu: CPU which allocated the skb
  *	@tail: Tail pointer
  *	@end: End pointer
  *	@head: Head of buffer
@@ -823,6 +827,7 @@ struct sk_buff {
 	__u16			transport_header;
 	__u16			network_header;
 	__u16			mac_header;
+	__u16			alloc_cpu;
 
 	/* private: */
 	__u32			headers_end[0];
@@ -2654,6 +2659,7 @@ void napi_consume_skb(struct sk_buff *skb, int budget);
 
 void __kfree_skb_flush(void);
 void __kfree_skb_defer(struct sk_buff *skb);
+void skb_attempt_defer_free(struct sk_buff *skb);
 
 /**
  * __dev_alloc_pages - allocate page for network Rx
@@ -35,6 +35,10 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	SHEAF_ALLOC,		/* Allocation from cpu sheaf */
+	SHEAF_FREE,		/* Free to cpu sheaf */
+	SHEAF_REFILL,		/* Refill from node partial slabs */
+	SHEAF_FLUSH,		/* Flush of sheaf objects to their slabs */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
@@ -66,6 +70,14 @@ struct kmem_cache_cpu {
 #define slub_percpu_partial_read_once(c)	NULL
 #endif // CONFIG_SLUB_CPU_PARTIAL
 
+/*
+ * Per cpu array of free objects of a SLAB_SHEAVES cache.
+ */
+struct slub_sheaf {
+	unsigned int size;	/* Number of objects in the sheaf */
+	void *objects[];
+};
+
 /*
  * Word size structure that can be atomically updated or read and that
  * contains both the order and the number of objects that a slab of the
@@ -89,6 +101,8 @@ struct kmem_cache {
 #ifdef CONFIG_SLUB_CPU_PARTIAL
 	int cpu_partial;	/* Number of per cpu partial objects to keep around */
 #endif
+	unsigned int sheaf_capacity;	/* Objects per cpu sheaf, 0 if none */
+	struct slub_sheaf __percpu *sheaves;
 	struct kmem_cache_order_objects oo;
 
 	/* Allocation and freeing of slabs */
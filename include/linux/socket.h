@@ -70,6 +70,14 @@ struct mmsghdr {
 	unsigned int        msg_len;
 };
 
+/* For recvmmsgv: a socket and the recvmmsg() vector to drain it into */
+struct mmsgvec {
+	struct mmsghdr	__user *mv_mmsg;
+	unsigned int	mv_vlen;		/* entries at mv_mmsg */
+	int		mv_fd;
+	int		mv_ret;			/* out: datagrams or -errno */
+};
+
 /*
  *	POSIX 1003.1g - ancillary data object information
  *	Ancillary data consits of a sequence of pairs of
@@ -206,8 +214,9 @@ struct ucred {
 				 * PF_SMC protocol family that
 				 * reuses AF_INET address family
 				 */
+#define AF_XDP		44	/* XDP sockets			*/
 
-#define AF_MAX		44	/* For now.. */
+#define AF_MAX		45	/* For now.. */
 
 /* Protocol families, same as address families. */
 #define PF_UNSPEC	AF_UNSPEC
@@ -256,6 +265,7 @@ struct ucred {
 #define PF_KCM		AF_KCM
 #define PF_QIPCRTR	AF_QIPCRTR
 #define PF_SMC		AF_SMC
+#define PF_XDP		AF_XDP
 #define PF_MAX		AF_MAX
 
 /* Maximum queue length specifiable by listen.  */
@@ -336,6 +346,7 @@ struct ucred {
 #define SOL_NFC		280
 #define SOL_KCM		281
 #define SOL_TLS		282
+#define SOL_XDP		283
 
 /* IPX options */
 #define IPX_TYPE	1
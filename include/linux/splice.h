@@ -19,8 +19,10 @@
 				 /* from/to, of course */
 #define SPLICE_F_MORE	(0x04)	/* expect more data */
 #define SPLICE_F_GIFT	(0x08)	/* pages passed in are a gift */
+#define SPLICE_F_ZEROCOPY (0x10) /* send to a socket as with MSG_ZEROCOPY */
 
-#define SPLICE_F_ALL (SPLICE_F_MOVE|SPLICE_F_NONBLOCK|SPLICE_F_MORE|SPLICE_F_GIFT)
+#define SPLICE_F_ALL (SPLICE_F_MOVE|SPLICE_F_NONBLOCK|SPLICE_F_MORE|\
+		      SPLICE_F_GIFT|SPLICE_F_ZEROCOPY)
 
 /*
  * Passed to the actors
@@ -78,6 +80,11 @@ extern ssize_t add_to_pipe(struct pipe_inode_info *,
 extern ssize_t splice_direct_to_actor(struct file *, struct splice_desc *,
 				      splice_direct_actor *);
 
+struct socket;
+extern ssize_t splice_to_socket_zerocopy(struct pipe_inode_info *,
+					 struct file *, struct socket *,
+					 size_t, unsigned int);
+
 /*
  * for dynamic pipe sizing
  */
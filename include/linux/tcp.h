@@ -285,6 +285,7 @@ struct tcp_sock {
 	u32	fackets_out;	/* FACK'd packets			*/
 
 	struct hrtimer	pacing_timer;
+	u64	tcp_wstamp_ns;	/* departure time of next data packet (EDT) */
 
 	/* from STCP, retrans queue hinting */
 	struct sk_buff* lost_skb_hint;
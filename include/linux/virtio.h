@@ -63,6 +63,10 @@ bool virtqueue_kick_prepare(struct virtqueue *vq);
 
 bool virtqueue_notify(struct virtqueue *vq);
 
+bool virtqueue_kick_batch(struct virtqueue *vq, bool more);
+
+bool virtqueue_kick_prepare_batch(struct virtqueue *vq, bool more);
+
 void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len);
 
 void *virtqueue_get_buf_ctx(struct virtqueue *vq, unsigned int *len,
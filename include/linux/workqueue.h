@@ -119,6 +119,22 @@ struct delayed_work {
 	int cpu;
 };
 
+/*
+ * Affinity scopes of unbound workqueues.  CPUs sharing a scope's pod
+ * share the same pwq, so work items queued from a CPU stay within the
+ * CPUs of its pod.  See the "affinity_scope" sysfs attribute.
+ */
+enum wq_affn_scope {
+	WQ_AFFN_DFL,			/* use system default */
+	WQ_AFFN_CPU,			/* one pod per CPU */
+	WQ_AFFN_SMT,			/* one pod per SMT core */
+	WQ_AFFN_CACHE,			/* one pod per last-level cache */
+	WQ_AFFN_NUMA,			/* one pod per NUMA node */
+	WQ_AFFN_SYSTEM,			/* one pod across the whole system */
+
+	WQ_AFFN_NR_TYPES,
+};
+
 /**
  * struct workqueue_attrs - A struct for workqueue attributes.
  *
@@ -136,13 +152,14 @@ struct workqueue_attrs {
 	cpumask_var_t cpumask;
 
 	/**
-	 * @no_numa: disable NUMA affinity
+	 * @affn_scope: unbound CPU affinity scope
 	 *
-	 * Unlike other fields, ``no_numa`` isn't a property of a worker_pool. It
-	 * only modifies how :c:func:`apply_workqueue_attrs` select pools and thus
-	 * doesn't participate in pool hash calculations or equality comparisons.
+	 * Unlike other fields, ``affn_scope`` isn't a property of a
+	 * worker_pool.  It only modifies how :c:func:`apply_workqueue_attrs`
+	 * selects pools and thus doesn't participate in pool hash
+	 * calculations or equality comparisons.
 	 */
-	bool no_numa;
+	enum wq_affn_scope affn_scope;
 };
 
 static inline struct delayed_work *to_delayed_work(struct work_struct *work)
@@ -646,5 +663,6 @@ int workqueue_offline_cpu(unsigned int cpu);
 
 int __init workqueue_init_early(void);
 int __init workqueue_init(void);
+void __init workqueue_init_topology(void);
 
 #endif
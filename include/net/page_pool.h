@@ -0,0 +1,126 @@
+/*
+ * page_pool: recycling of whole pages for NAPI receive rings
+ *
+ * A pool hands out pages for one receive queue and takes them back when
+ * the driver is done with them, keeping their DMA mapping.  Calls to
+ * page_pool_alloc_pages() and page_pool_recycle_direct() come from the
+ * queue's NAPI context, so they use a small cache nothing else touches;
+ * page_pool_put_page() may be called from anywhere outside hardirq
+ * context and goes through a ptr_ring instead.
+ *
+ * Pages handed up the stack in an skb are no longer the pool's: release
+ * them with page_pool_release_page() first, and the stack's put_page()
+ * frees them like any other page.  Every page must be back, or released,
+ * before page_pool_destroy().
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef _NET_PAGE_POOL_H
+#define _NET_PAGE_POOL_H
+
+#include <linux/dma-direction.h>
+#include <linux/dma-mapping.h>
+#include <linux/mm.h>
+#include <linux/ptr_ring.h>
+
+/* Map pages for DMA once, when they are allocated, and keep the mapping */
+#define PP_FLAG_DMA_MAP		BIT(0)
+#define PP_FLAG_ALL		PP_FLAG_DMA_MAP
+
+/*
+ * The NAPI side cache: a refill from the ring takes half of it at once,
+ * so the ring's consumer lock is taken once per PP_ALLOC_CACHE_REFILL
+ * pages rather than per page.
+ */
+#define PP_ALLOC_CACHE_SIZE	128
+#define PP_ALLOC_CACHE_REFILL	64
+
+struct pp_alloc_cache {
+	u32 count;
+	struct page *cache[PP_ALLOC_CACHE_SIZE];
+};
+
+struct page_pool_params {
+	unsigned int	flags;		/* PP_FLAG_* */
+	unsigned int	order;		/* of the pages allocated */
+	unsigned int	pool_size;	/* entries in the ptr_ring */
+	int		nid;		/* NUMA node to allocate from */
+	struct device	*dev;		/* to map for, with PP_FLAG_DMA_MAP */
+	enum dma_data_direction dma_dir;
+};
+
+struct page_pool {
+	struct page_pool_params p;
+
+	struct pp_alloc_cache alloc ____cacheline_aligned_in_smp;
+
+	/* Pages given back from outside the NAPI context */
+	struct ptr_ring ring;
+};
+
+#ifdef CONFIG_PAGE_POOL
+struct page_pool *page_pool_create(const struct page_pool_params *params);
+void page_pool_destroy(struct page_pool *pool);
+
+struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp);
+void __page_pool_put_page(struct page_pool *pool, struct page *page,
+			  bool allow_direct);
+void page_pool_release_page(struct page_pool *pool, struct page *page);
+#else
+static inline struct page_pool *
+page_pool_create(const struct page_pool_params *params)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+
+static inline void page_pool_destroy(struct page_pool *pool)
+{
+}
+
+static inline struct page *page_pool_alloc_pages(struct page_pool *pool,
+						 gfp_t gfp)
+{
+	return NULL;
+}
+
+static inline void __page_pool_put_page(struct page_pool *pool,
+					struct page *page, bool allow_direct)
+{
+	put_page(page);
+}
+
+static inline void page_pool_release_page(struct page_pool *pool,
+					  struct page *page)
+{
+}
+#endif /* CONFIG_PAGE_POOL */
+
+/* For refilling a receive ring from its NAPI poll */
+static inline struct page *page_pool_dev_alloc_pages(struct page_pool *pool)
+{
+	return page_pool_alloc_pages(pool, GFP_ATOMIC | __GFP_NOWARN);
+}
+
+/* Give a page back from any context but hardirq: XDP_TX completion, say */
+static inline void page_pool_put_page(struct page_pool *pool,
+				      struct page *page)
+{
+	__page_pool_put_page(pool, page, false);
+}
+
+/* Give a page back from the pool's own NAPI poll: XDP_DROP, say */
+static inline void page_pool_recycle_direct(struct page_pool *pool,
+					    struct page *page)
+{
+	__page_pool_put_page(pool, page, true);
+}
+
+/* The mapping made with PP_FLAG_DMA_MAP, kept in page->private */
+static inline dma_addr_t page_pool_get_dma_addr(struct page *page)
+{
+	return (dma_addr_t)page_private(page);
+}
+
+#endif /* _NET_PAGE_POOL_H */
@@ -11,6 +11,7 @@
 #include <linux/list.h>
 #include <linux/refcount.h>
 #include <linux/workqueue.h>
+#include <linux/skb_array.h>
 #include <net/gen_stats.h>
 #include <net/rtnetlink.h>
 
@@ -70,6 +71,7 @@ struct Qdisc {
 				      * qdisc_tree_decrease_qlen() should stop.
 				      */
 #define TCQ_F_INVISIBLE		0x80 /* invisible by default in dump */
+#define TCQ_F_DEFER_ENQ		0x100 /* enqueue while running via q->defer */
 	u32			limit;
 	const struct Qdisc_ops	*ops;
 	struct qdisc_size_table	__rcu *stab;
@@ -99,6 +101,8 @@ struct Qdisc {
 	refcount_t		refcnt;
 
 	spinlock_t		busylock ____cacheline_aligned_in_smp;
+	/* TCQ_F_DEFER_ENQ: skbs left for the running cpu to enqueue */
+	struct skb_array	*defer;
 };
 
 static inline void qdisc_refcount_inc(struct Qdisc *qdisc)
@@ -128,6 +132,16 @@ static inline bool qdisc_run_begin(struct Qdisc *qdisc)
 static inline void qdisc_run_end(struct Qdisc *qdisc)
 {
 	write_seqcount_end(&qdisc->running);
+
+	/* An skb deferred after our last drain is ours to send: paired with
+	 * the barrier in qdisc_defer_skb(). Every consumer of the ring holds
+	 * the qdisc lock, as we do.
+	 */
+	if (qdisc->flags & TCQ_F_DEFER_ENQ) {
+		smp_mb();
+		if (!__skb_array_empty(qdisc->defer))
+			__netif_schedule(qdisc);
+	}
 }
 
 static inline bool qdisc_may_bulk(const struct Qdisc *qdisc)
@@ -429,6 +443,8 @@ struct Qdisc *dev_graft_qdisc(struct netdev_queue *dev_queue,
 			      struct Qdisc *qdisc);
 void qdisc_reset(struct Qdisc *qdisc);
 void qdisc_destroy(struct Qdisc *qdisc);
+int qdisc_defer_init(struct Qdisc *qdisc, int size);
+void qdisc_defer_drain(struct Qdisc *qdisc);
 void qdisc_tree_reduce_backlog(struct Qdisc *qdisc, unsigned int n,
 			       unsigned int len);
 struct Qdisc *qdisc_alloc(struct netdev_queue *dev_queue,
@@ -255,7 +255,7 @@ struct sock_common {
   *	@sk_ll_usec: usecs to busypoll when there is no data
   *	@sk_allocation: allocation mode
   *	@sk_pacing_rate: Pacing rate (if supported by transport/packet scheduler)
-  *	@sk_pacing_status: Pacing status (requested, handled by sch_fq)
+  *	@sk_pacing_status: Pacing status (requested, handled by sch_fq/sch_edt)
   *	@sk_max_pacing_rate: Maximum pacing rate (%SO_MAX_PACING_RATE)
   *	@sk_sndbuf: size of send buffer in bytes
   *	@__sk_flags_offset: empty field used to determine location of bitfield
@@ -486,6 +486,7 @@ enum sk_pacing {
 	SK_PACING_NONE		= 0,
 	SK_PACING_NEEDED	= 1,
 	SK_PACING_FQ		= 2,
+	SK_PACING_EDT		= 3,	/* skb->tstamp is the departure time */
 };
 
 #define __sk_user_data(sk) ((*((void __rcu **)&(sk)->sk_user_data)))
@@ -778,6 +779,7 @@ enum sock_flags {
 	SOCK_FILTER_LOCKED, /* Filter cannot be changed anymore */
 	SOCK_SELECT_ERR_QUEUE, /* Wake select on error queue */
 	SOCK_RCU_FREE, /* wait rcu grace period in sk_destruct() */
+	SOCK_INCOMING_CPU, /* %SO_INCOMING_CPU set by the user */
 };
 
 #define SK_FLAGS_TIMESTAMP ((1UL << SOCK_TIMESTAMP) | (1UL << SOCK_TIMESTAMPING_RX_SOFTWARE))
@@ -1085,6 +1087,7 @@ struct proto {
 #endif
 
 	bool			(*stream_memory_free)(const struct sock *sk);
+	bool			(*stream_memory_read)(const struct sock *sk);
 	/* Memory pressure */
 	void			(*enter_memory_pressure)(struct sock *sk);
 	void			(*leave_memory_pressure)(struct sock *sk);
@@ -2383,6 +2386,7 @@ extern __u32 sysctl_rmem_max;
 
 extern int sysctl_tstamp_allow_data;
 extern int sysctl_optmem_max;
+extern int sysctl_sk_local_timers;
 
 extern __u32 sysctl_wmem_default;
 extern __u32 sysctl_rmem_default;
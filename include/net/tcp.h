@@ -2006,6 +2006,8 @@ static inline int tcp_inq(struct sock *sk)
 }
 
 int tcp_peek_len(struct socket *sock);
+int tcp_mmap(struct file *file, struct socket *sock,
+	     struct vm_area_struct *vma);
 
 static inline void tcp_segs_in(struct tcp_sock *tp, const struct sk_buff *skb)
 {
@@ -0,0 +1,62 @@
+/*
+ * Events for epoll
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM epoll
+
+#if !defined(_TRACE_EPOLL_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_EPOLL_H
+
+#include <linux/tracepoint.h>
+#include <linux/fs.h>
+
+#ifndef __EPOLL_DECLARE_TRACE_ENUMS_ONCE_ONLY
+#define __EPOLL_DECLARE_TRACE_ENUMS_ONCE_ONLY
+
+/* Where ep_poll_callback() queued the item */
+enum ep_queued {
+	EP_QUEUED_NONE,		/* filtered out, or already queued */
+	EP_QUEUED_RDLLIST,	/* added to the ready list */
+	EP_QUEUED_OVFLIST,	/* chained while events are transferred */
+};
+
+#endif /* __EPOLL_DECLARE_TRACE_ENUMS_ONCE_ONLY */
+
+TRACE_DEFINE_ENUM(EP_QUEUED_NONE);
+TRACE_DEFINE_ENUM(EP_QUEUED_RDLLIST);
+TRACE_DEFINE_ENUM(EP_QUEUED_OVFLIST);
+
+#define show_ep_queued(val)					\
+	__print_symbolic(val,					\
+		{ EP_QUEUED_NONE,	"none" },		\
+		{ EP_QUEUED_RDLLIST,	"rdllist" },		\
+		{ EP_QUEUED_OVFLIST,	"ovflist" })
+
+TRACE_EVENT(ep_poll_callback,
+	TP_PROTO(struct file *file, int fd, unsigned long key, int queued),
+
+	TP_ARGS(file, fd, key, queued),
+
+	TP_STRUCT__entry(
+		__field(struct file *, file)
+		__field(int, fd)
+		__field(unsigned long, key)
+		__field(int, queued)
+	),
+
+	TP_fast_assign(
+		__entry->file = file;
+		__entry->fd = fd;
+		__entry->key = key;
+		__entry->queued = queued;
+	),
+
+	TP_printk("ep=%p fd=%d key=0x%lx queued=%s",
+		  __entry->file, __entry->fd, __entry->key,
+		  show_ep_queued(__entry->queued))
+);
+
+#endif /* _TRACE_EPOLL_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,65 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rhashtable
+
+#if !defined(_TRACE_RHASHTABLE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_RHASHTABLE_H
+
+#include <linux/rhashtable.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(rhashtable_rehash_start,
+
+	TP_PROTO(const struct rhashtable *ht, unsigned int old_size,
+		 unsigned int new_size),
+
+	TP_ARGS(ht, old_size, new_size),
+
+	TP_STRUCT__entry(
+		__field(	const void *,		ht)
+		__field(	unsigned int,		old_size)
+		__field(	unsigned int,		new_size)
+		__field(	unsigned int,		nelems)
+	),
+
+	TP_fast_assign(
+		__entry->ht = ht;
+		__entry->old_size = old_size;
+		__entry->new_size = new_size;
+		__entry->nelems = atomic_read(&ht->nelems);
+	),
+
+	TP_printk("ht %p resize %u -> %u buckets with %u elements",
+		  __entry->ht, __entry->old_size, __entry->new_size,
+		  __entry->nelems)
+);
+
+TRACE_EVENT(rhashtable_rehash_end,
+
+	TP_PROTO(const struct rhashtable *ht, unsigned int size,
+		 unsigned int helped, u64 duration_ns),
+
+	TP_ARGS(ht, size, helped, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(	const void *,		ht)
+		__field(	unsigned int,		size)
+		__field(	unsigned int,		helped)
+		__field(	u64,			duration_ns)
+	),
+
+	TP_fast_assign(
+		__entry->ht = ht;
+		__entry->size = size;
+		__entry->helped = helped;
+		__entry->duration_ns = duration_ns;
+	),
+
+	TP_printk("ht %p now %u buckets, %u chains moved by inserters, took %llu ns",
+		  __entry->ht, __entry->size, __entry->helped,
+		  (unsigned long long)__entry->duration_ns)
+);
+
+#endif /* _TRACE_RHASHTABLE_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
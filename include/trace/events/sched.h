@@ -379,6 +379,37 @@ DEFINE_EVENT(sched_stat_template, sched_stat_blocked,
 	     TP_PROTO(struct task_struct *tsk, u64 delay),
 	     TP_ARGS(tsk, delay));
 
+/*
+ * Tracepoint for the runqueue delay of a task, from being queued by a
+ * wakeup or a preemption until it runs on a CPU.  Unlike the sched_stat
+ * tracepoints, this only needs CONFIG_SCHED_INFO.
+ */
+TRACE_EVENT(sched_rq_delay,
+
+	TP_PROTO(struct task_struct *tsk, u64 delay, bool preempted),
+
+	TP_ARGS(tsk, delay, preempted),
+
+	TP_STRUCT__entry(
+		__array( char,	comm,	TASK_COMM_LEN	)
+		__field( pid_t,	pid			)
+		__field( u64,	delay			)
+		__field( bool,	preempted		)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, tsk->comm, TASK_COMM_LEN);
+		__entry->pid		= tsk->pid;
+		__entry->delay		= delay;
+		__entry->preempted	= preempted;
+	),
+
+	TP_printk("comm=%s pid=%d delay=%Lu [ns] preempted=%d",
+			__entry->comm, __entry->pid,
+			(unsigned long long)__entry->delay,
+			__entry->preempted)
+);
+
 /*
  * Tracepoint for accounting runtime (time the task is executing
  * on a CPU).
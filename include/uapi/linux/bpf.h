@@ -92,6 +92,11 @@ enum bpf_cmd {
 	BPF_PROG_GET_FD_BY_ID,
 	BPF_MAP_GET_FD_BY_ID,
 	BPF_OBJ_GET_INFO_BY_FD,
+	BPF_MAP_LOOKUP_BATCH,
+	BPF_MAP_LOOKUP_AND_DELETE_BATCH,
+	BPF_MAP_UPDATE_BATCH,
+	BPF_MAP_DELETE_BATCH,
+	BPF_TRACE_OPEN,
 };
 
 enum bpf_map_type {
@@ -111,6 +116,8 @@ enum bpf_map_type {
 	BPF_MAP_TYPE_HASH_OF_MAPS,
 	BPF_MAP_TYPE_DEVMAP,
 	BPF_MAP_TYPE_SOCKMAP,
+	BPF_MAP_TYPE_XSKMAP,
+	BPF_MAP_TYPE_RINGBUF,
 };
 
 enum bpf_prog_type {
@@ -138,6 +145,8 @@ enum bpf_attach_type {
 	BPF_CGROUP_SOCK_OPS,
 	BPF_SK_SKB_STREAM_PARSER,
 	BPF_SK_SKB_STREAM_VERDICT,
+	BPF_TRACE_FENTRY,
+	BPF_TRACE_FEXIT,
 	__MAX_BPF_ATTACH_TYPE
 };
 
@@ -174,6 +183,11 @@ enum bpf_attach_type {
 #define BPF_F_NO_COMMON_LRU	(1U << 1)
 /* Specify numa node during map creation */
 #define BPF_F_NUMA_NODE		(1U << 2)
+/* Back a BPF_MAP_TYPE_HASH map (which must also be BPF_F_NO_PREALLOC)
+ * with a table that grows and shrinks with the number of elements,
+ * instead of max_entries buckets allocated up front.
+ */
+#define BPF_F_RESIZABLE		(1U << 3)
 
 union bpf_attr {
 	struct { /* anonymous struct used by BPF_MAP_CREATE command */
@@ -200,6 +214,23 @@ union bpf_attr {
 		__u64		flags;
 	};
 
+	struct { /* struct used by BPF_MAP_*_BATCH commands */
+		__aligned_u64	in_batch;	/* start batch,
+						 * NULL to start from beginning
+						 */
+		__aligned_u64	out_batch;	/* output: next start batch */
+		__aligned_u64	keys;
+		__aligned_u64	values;
+		__u32		count;		/* input/output:
+						 * input: # of key/value
+						 * elements
+						 * output: # of filled elements
+						 */
+		__u32		map_fd;
+		__u64		elem_flags;
+		__u64		flags;
+	} batch;
+
 	struct { /* anonymous struct used by BPF_PROG_LOAD command */
 		__u32		prog_type;	/* one of enum bpf_prog_type */
 		__u32		insn_cnt;
@@ -249,6 +280,12 @@ union bpf_attr {
 		__u32		info_len;
 		__aligned_u64	info;
 	} info;
+
+	struct { /* anonymous struct used by BPF_TRACE_OPEN command */
+		__aligned_u64	name;		/* kernel function to hook */
+		__u32		prog_fd;	/* a BPF_PROG_TYPE_KPROBE */
+		__u32		attach_type;	/* BPF_TRACE_FENTRY or FEXIT */
+	} trace;
 } __attribute__((aligned(8)));
 
 /* BPF helper function descriptions:
@@ -574,7 +611,8 @@ union bpf_attr {
  *     sock in map.
  *     @map: pointer to sockmap
  *     @key: key to lookup sock in map
- *     @flags: reserved for future use
+ *     @flags: BPF_F_INGRESS to queue the skb for reading on the sock
+ *             rather than sending it out of the sock
  *     Return: SK_PASS
  *
  * int bpf_sock_map_update(skops, map, key, flags)
@@ -582,6 +620,22 @@ union bpf_attr {
  *	@map: pointer to sockmap to update
  *	@key: key to insert/update sock in map
  *	@flags: same flags as map update elem
+ *
+ * int bpf_ringbuf_output(map, data, size, flags)
+ *     Copy a record into a ring buffer map shared by all CPUs
+ *     @map: pointer to ringbuf map
+ *     @data: data to be copied into the record
+ *     @size: size of data
+ *     @flags: BPF_RB_NO_WAKEUP or BPF_RB_FORCE_WAKEUP, or 0 to wake up
+ *             the consumer only when it has caught up with this record
+ *     Return: 0 on success, -EAGAIN if the ring buffer is full
+ *
+ * u64 bpf_ringbuf_query(map, flags)
+ *     Sample a ring buffer map's state
+ *     @map: pointer to ringbuf map
+ *     @flags: one of BPF_RB_AVAIL_DATA, BPF_RB_RING_SIZE,
+ *             BPF_RB_CONS_POS or BPF_RB_PROD_POS
+ *     Return: requested value, or 0 for unknown flags
  */
 #define __BPF_FUNC_MAPPER(FN)		\
 	FN(unspec),			\
@@ -638,6 +692,8 @@ union bpf_attr {
 	FN(redirect_map),		\
 	FN(sk_redirect_map),		\
 	FN(sock_map_update),		\
+	FN(ringbuf_output),		\
+	FN(ringbuf_query),		\
 
 /* integer value in 'imm' field of BPF_CALL instruction selects which helper
  * function eBPF program intends to call
@@ -665,7 +721,9 @@ enum bpf_func_id {
 #define BPF_F_MARK_MANGLED_0		(1ULL << 5)
 #define BPF_F_MARK_ENFORCE		(1ULL << 6)
 
-/* BPF_FUNC_clone_redirect and BPF_FUNC_redirect flags. */
+/* BPF_FUNC_clone_redirect, BPF_FUNC_redirect and BPF_FUNC_sk_redirect_map
+ * flags.
+ */
 #define BPF_F_INGRESS			(1ULL << 0)
 
 /* BPF_FUNC_skb_set_tunnel_key and BPF_FUNC_skb_get_tunnel_key flags. */
@@ -687,6 +745,24 @@ enum bpf_func_id {
 /* BPF_FUNC_perf_event_output for sk_buff input context. */
 #define BPF_F_CTXLEN_MASK		(0xfffffULL << 32)
 
+/* BPF_FUNC_ringbuf_output flags. */
+#define BPF_RB_NO_WAKEUP		(1ULL << 0)
+#define BPF_RB_FORCE_WAKEUP		(1ULL << 1)
+
+/* BPF_FUNC_ringbuf_query flags. */
+#define BPF_RB_AVAIL_DATA		0
+#define BPF_RB_RING_SIZE		1
+#define BPF_RB_CONS_POS			2
+#define BPF_RB_PROD_POS			3
+
+/* BPF_MAP_TYPE_RINGBUF record header: a u32 length carrying the busy and
+ * discard bits, then a u32 page offset used by the kernel. Records are
+ * 8-byte aligned and start BPF_RINGBUF_HDR_SZ bytes after their header.
+ */
+#define BPF_RINGBUF_BUSY_BIT		(1U << 31)
+#define BPF_RINGBUF_DISCARD_BIT		(1U << 30)
+#define BPF_RINGBUF_HDR_SZ		8
+
 /* Mode for BPF_FUNC_skb_adjust_room helper. */
 enum bpf_adj_room_mode {
 	BPF_ADJ_ROOM_NET,
@@ -801,6 +877,8 @@ struct bpf_prog_info {
 	__u32 xlated_prog_len;
 	__aligned_u64 jited_prog_insns;
 	__aligned_u64 xlated_prog_insns;
+	__u64 run_time_ns;	/* with kernel.bpf_stats_enabled set */
+	__u64 run_cnt;
 } __attribute__((aligned(8)));
 
 struct bpf_map_info {
@@ -810,6 +888,11 @@ struct bpf_map_info {
 	__u32 value_size;
 	__u32 max_entries;
 	__u32 map_flags;
+	__u32 nr_buckets;	/* current number of hash buckets */
+	__u32 max_chain_len;	/* longest bucket chain at query time */
+	__u64 freelist_steals;	/* preallocated elements taken from
+				 * another CPU's free list
+				 */
 } __attribute__((aligned(8)));
 
 /* User bpf_sock_ops struct to access socket values and specify request ops
@@ -831,6 +914,9 @@ struct bpf_sock_ops {
 	__u32 local_ip6[4];	/* Stored in network byte order */
 	__u32 remote_port;	/* Stored in network byte order */
 	__u32 local_port;	/* stored in host byte order */
+	__u32 incoming_cpu;	/* cpu that processed the last packet,
+				 * as getsockopt(SO_INCOMING_CPU)
+				 */
 };
 
 /* List of known BPF sock_ops operators.
@@ -20,6 +20,7 @@
 #define FUTEX_WAKE_BITSET	10
 #define FUTEX_WAIT_REQUEUE_PI	11
 #define FUTEX_CMP_REQUEUE_PI	12
+#define FUTEX_WAIT_MULTIPLE	13
 
 #define FUTEX_PRIVATE_FLAG	128
 #define FUTEX_CLOCK_REALTIME	256
@@ -39,6 +40,27 @@
 					 FUTEX_PRIVATE_FLAG)
 #define FUTEX_CMP_REQUEUE_PI_PRIVATE	(FUTEX_CMP_REQUEUE_PI | \
 					 FUTEX_PRIVATE_FLAG)
+#define FUTEX_WAIT_MULTIPLE_PRIVATE	(FUTEX_WAIT_MULTIPLE | \
+					 FUTEX_PRIVATE_FLAG)
+
+/*
+ * Per-futex entry of the FUTEX_WAIT_MULTIPLE vector: UADDR points to an
+ * array of VAL of these. The call sleeps until any of the futexes is woken
+ * and returns its index in the array.
+ *
+ * NOTE: this structure is part of the syscall ABI, and must not be
+ * changed.
+ */
+struct futex_wait_block {
+	__u64 uaddr;
+	__u32 val;
+	__u32 bitset;
+};
+
+/*
+ * Maximum number of futexes a FUTEX_WAIT_MULTIPLE call can wait on.
+ */
+#define FUTEX_MULTIPLE_MAX_COUNT	128
 
 /*
  * Support for robust futexes: the kernel cleans up held futexes at
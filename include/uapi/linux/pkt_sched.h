@@ -861,6 +861,22 @@ enum {
 };
 #define TCA_PIE_MAX   (__TCA_PIE_MAX - 1)
 
+/* EDT (Earliest Departure Time) */
+enum {
+	TCA_EDT_UNSPEC,
+	TCA_EDT_PLIMIT,		/* limit of total number of packets in queue */
+	TCA_EDT_SLOT_LOG,	/* log2(slot length in ns) */
+	TCA_EDT_SLOTS_LOG,	/* log2(number of slots) */
+	__TCA_EDT_MAX
+};
+#define TCA_EDT_MAX   (__TCA_EDT_MAX - 1)
+
+struct tc_edt_xstats {
+	__u64	horizon_capped;	/* packets sent earlier than asked */
+	__s64	time_next_slot;	/* ns until the next slot is due */
+	__u32	busy_slots;	/* slots holding packets */
+};
+
 struct tc_pie_xstats {
 	__u32 prob;             /* current probability */
 	__u32 delay;            /* current delay in ms */
@@ -197,4 +197,16 @@ struct prctl_mm_map {
 # define PR_CAP_AMBIENT_LOWER		3
 # define PR_CAP_AMBIENT_CLEAR_ALL	4
 
+/* Let KSM merge every compatible anonymous area of the process */
+#define PR_SET_MEMORY_MERGE		48
+#define PR_GET_MEMORY_MERGE		49
+
+/*
+ * Per-process KSM scan priority: 0 (default) is scanned on every pass,
+ * n is scanned on every (1 << n)th pass, up to PR_KSM_PRIORITY_MAX.
+ */
+#define PR_SET_KSM_PRIORITY		50
+#define PR_GET_KSM_PRIORITY		51
+# define PR_KSM_PRIORITY_MAX		3
+
 #endif /* _LINUX_PRCTL_H */
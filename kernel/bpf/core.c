@@ -31,6 +31,7 @@
 #include <linux/rbtree_latch.h>
 #include <linux/kallsyms.h>
 #include <linux/rcupdate.h>
+#include <linux/sched/clock.h>
 
 #include <asm/unaligned.h>
 
@@ -79,6 +80,7 @@ struct bpf_prog *bpf_prog_alloc(unsigned int size, gfp_t gfp_extra_flags)
 	gfp_t gfp_flags = GFP_KERNEL | __GFP_ZERO | gfp_extra_flags;
 	struct bpf_prog_aux *aux;
 	struct bpf_prog *fp;
+	int cpu;
 
 	size = round_up(size, PAGE_SIZE);
 	fp = __vmalloc(size, gfp_flags, PAGE_KERNEL);
@@ -93,6 +95,17 @@ struct bpf_prog *bpf_prog_alloc(unsigned int size, gfp_t gfp_extra_flags)
 		return NULL;
 	}
 
+	aux->stats = alloc_percpu_gfp(struct bpf_prog_stats,
+				      GFP_KERNEL | gfp_extra_flags);
+	if (!aux->stats) {
+		kfree(aux);
+		vfree(fp);
+		return NULL;
+	}
+
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(aux->stats, cpu)->syncp);
+
 	fp->pages = size / PAGE_SIZE;
 	fp->aux = aux;
 	fp->aux->prog = fp;
@@ -145,10 +158,39 @@ struct bpf_prog *bpf_prog_realloc(struct bpf_prog *fp_old, unsigned int size,
 
 void __bpf_prog_free(struct bpf_prog *fp)
 {
-	kfree(fp->aux);
+	if (fp->aux) {
+		free_percpu(fp->aux->stats);
+		kfree(fp->aux);
+	}
 	vfree(fp);
 }
 
+DEFINE_STATIC_KEY_FALSE(bpf_stats_enabled_key);
+EXPORT_SYMBOL_GPL(bpf_stats_enabled_key);
+
+/* BPF_PROG_RUN() with kernel.bpf_stats_enabled set */
+unsigned int __bpf_prog_run_stats(const struct bpf_prog *prog,
+				  const void *ctx)
+{
+	struct bpf_prog_stats *stats;
+	unsigned int ret;
+	u64 start;
+
+	start = sched_clock();
+	ret = (*prog->bpf_func)(ctx, prog->insnsi);
+
+	/* some callers, seccomp for one, run programs preemptible */
+	stats = get_cpu_ptr(prog->aux->stats);
+	u64_stats_update_begin(&stats->syncp);
+	stats->cnt++;
+	stats->nsecs += sched_clock() - start;
+	u64_stats_update_end(&stats->syncp);
+	put_cpu_ptr(prog->aux->stats);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(__bpf_prog_run_stats);
+
 int bpf_prog_calc_tag(struct bpf_prog *fp)
 {
 	const u32 bits_offset = SHA_MESSAGE_BYTES - sizeof(__be64);
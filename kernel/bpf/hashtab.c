@@ -14,6 +14,7 @@
 #include <linux/jhash.h>
 #include <linux/filter.h>
 #include <linux/rculist_nulls.h>
+#include <linux/rhashtable.h>
 #include "percpu_freelist.h"
 #include "bpf_lru_list.h"
 #include "map_in_map.h"
@@ -49,6 +50,7 @@ struct htab_elem {
 			union {
 				struct bpf_htab *htab;
 				struct pcpu_freelist_node fnode;
+				struct htab_elem *batch_flink;
 			};
 		};
 	};
@@ -61,6 +63,7 @@ struct htab_elem {
 };
 
 static bool htab_lru_map_delete_node(void *arg, struct bpf_lru_node *node);
+static struct bpf_map *rhtab_map_alloc(union bpf_attr *attr);
 
 static bool htab_is_lru(const struct bpf_htab *htab)
 {
@@ -242,6 +245,9 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 	int err, i;
 	u64 cost;
 
+	if (attr->map_flags & BPF_F_RESIZABLE)
+		return rhtab_map_alloc(attr);
+
 	BUILD_BUG_ON(offsetof(struct htab_elem, htab) !=
 		     offsetof(struct htab_elem, hash_node.pprev));
 	BUILD_BUG_ON(offsetof(struct htab_elem, fnode.next) !=
@@ -1139,6 +1145,307 @@ static void htab_map_free(struct bpf_map *map)
 	kfree(htab);
 }
 
+static u32 htab_max_chain_len(struct bpf_htab *htab)
+{
+	struct hlist_nulls_head *head;
+	struct hlist_nulls_node *n;
+	struct htab_elem *l;
+	u32 i, len, max_len = 0;
+
+	for (i = 0; i < htab->n_buckets; i++) {
+		head = select_bucket(htab, i);
+		len = 0;
+		rcu_read_lock();
+		hlist_nulls_for_each_entry_rcu(l, n, head, hash_node)
+			len++;
+		rcu_read_unlock();
+		max_len = max(max_len, len);
+		cond_resched();
+	}
+	return max_len;
+}
+
+static void htab_map_fill_info(struct bpf_map *map, struct bpf_map_info *info)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+
+	info->nr_buckets = htab->n_buckets;
+	info->max_chain_len = htab_max_chain_len(htab);
+	/* LRU maps keep their free elements on LRU lists instead */
+	if (htab_is_prealloc(htab) && !htab_is_lru(htab))
+		info->freelist_steals = pcpu_freelist_steals(&htab->freelist);
+}
+
+/* initial number of elements a bucket is expected to hold; the buffers
+ * grow when a longer chain is found
+ */
+#define HTAB_BATCH_BUCKET_SIZE	5
+
+/* The batch cursor is the index of the next bucket to visit. Each bucket
+ * is copied out whole under its lock, so a batch never splits a chain and
+ * the walk keeps going across concurrent updates of other buckets.
+ */
+static int
+__htab_map_lookup_and_delete_batch(struct bpf_map *map,
+				   const union bpf_attr *attr,
+				   union bpf_attr __user *uattr,
+				   bool do_delete, bool is_lru_map,
+				   bool is_percpu)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	void __user *uvalues = u64_to_user_ptr(attr->batch.values);
+	void __user *ubatch = u64_to_user_ptr(attr->batch.in_batch);
+	void __user *ukeys = u64_to_user_ptr(attr->batch.keys);
+	u32 bucket_cnt, total, key_size, value_size, roundup_key_size;
+	u32 batch, max_count, size, bucket_size;
+	struct htab_elem *node_to_free = NULL;
+	void *keys = NULL, *values = NULL;
+	struct hlist_nulls_head *head;
+	struct hlist_nulls_node *n;
+	void *dst_key, *dst_val;
+	unsigned long flags;
+	bool locked = false;
+	struct htab_elem *l;
+	struct bucket *b;
+	int ret = 0;
+
+	if (attr->batch.elem_flags || attr->batch.flags)
+		return -EINVAL;
+
+	max_count = attr->batch.count;
+	if (!max_count)
+		return 0;
+
+	if (put_user(0, &uattr->batch.count))
+		return -EFAULT;
+
+	batch = 0;
+	if (ubatch && copy_from_user(&batch, ubatch, sizeof(batch)))
+		return -EFAULT;
+
+	if (batch >= htab->n_buckets)
+		return -ENOENT;
+
+	key_size = map->key_size;
+	roundup_key_size = round_up(map->key_size, 8);
+	value_size = map->value_size;
+	size = round_up(value_size, 8);
+	if (is_percpu)
+		value_size = size * num_possible_cpus();
+	total = 0;
+	bucket_size = HTAB_BATCH_BUCKET_SIZE;
+
+alloc:
+	/* no copy_{from,to}_user under the bucket lock, so stage a whole
+	 * bucket in kernel memory first
+	 */
+	keys = kvmalloc(key_size * bucket_size, GFP_USER | __GFP_NOWARN);
+	values = kvmalloc(value_size * bucket_size, GFP_USER | __GFP_NOWARN);
+	if (!keys || !values) {
+		ret = -ENOMEM;
+		goto after_loop;
+	}
+
+again:
+	/* same bpf_prog_active rule as the syscall update/delete path */
+	preempt_disable();
+	__this_cpu_inc(bpf_prog_active);
+	rcu_read_lock();
+again_nocopy:
+	dst_key = keys;
+	dst_val = values;
+	b = &htab->buckets[batch];
+	head = &b->head;
+	/* empty buckets are skipped without taking their lock */
+	if (locked)
+		raw_spin_lock_irqsave(&b->lock, flags);
+
+	bucket_cnt = 0;
+	hlist_nulls_for_each_entry_rcu(l, n, head, hash_node)
+		bucket_cnt++;
+
+	if (bucket_cnt && !locked) {
+		locked = true;
+		goto again_nocopy;
+	}
+
+	if (bucket_cnt > max_count - total) {
+		if (total == 0)
+			ret = -ENOSPC;
+		/* bucket_cnt > 0 here, so the lock is held */
+		raw_spin_unlock_irqrestore(&b->lock, flags);
+		rcu_read_unlock();
+		__this_cpu_dec(bpf_prog_active);
+		preempt_enable();
+		goto after_loop;
+	}
+
+	if (bucket_cnt > bucket_size) {
+		bucket_size = bucket_cnt;
+		raw_spin_unlock_irqrestore(&b->lock, flags);
+		rcu_read_unlock();
+		__this_cpu_dec(bpf_prog_active);
+		preempt_enable();
+		kvfree(keys);
+		kvfree(values);
+		locked = false;
+		goto alloc;
+	}
+
+	if (!locked)
+		goto next_batch;
+
+	hlist_nulls_for_each_entry_safe(l, n, head, hash_node) {
+		memcpy(dst_key, l->key, key_size);
+
+		if (is_percpu) {
+			void __percpu *pptr;
+			int off = 0, cpu;
+
+			pptr = htab_elem_get_ptr(l, map->key_size);
+			for_each_possible_cpu(cpu) {
+				bpf_long_memcpy(dst_val + off,
+						per_cpu_ptr(pptr, cpu), size);
+				off += size;
+			}
+		} else {
+			memcpy(dst_val, l->key + roundup_key_size, value_size);
+		}
+
+		if (do_delete) {
+			hlist_nulls_del_rcu(&l->hash_node);
+			/* bpf_lru_push_free() takes the lru lock, which must
+			 * not nest inside the bucket lock; see
+			 * prealloc_lru_pop()
+			 */
+			if (is_lru_map) {
+				l->batch_flink = node_to_free;
+				node_to_free = l;
+			} else {
+				free_htab_elem(htab, l);
+			}
+		}
+		dst_key += key_size;
+		dst_val += value_size;
+	}
+
+	raw_spin_unlock_irqrestore(&b->lock, flags);
+	locked = false;
+
+	while (node_to_free) {
+		l = node_to_free;
+		node_to_free = node_to_free->batch_flink;
+		bpf_lru_push_free(&htab->lru, &l->lru_node);
+	}
+
+next_batch:
+	/* nothing to copy out, move on without dropping rcu */
+	if (!bucket_cnt && (batch + 1 < htab->n_buckets)) {
+		batch++;
+		goto again_nocopy;
+	}
+
+	rcu_read_unlock();
+	__this_cpu_dec(bpf_prog_active);
+	preempt_enable();
+	if (bucket_cnt &&
+	    (copy_to_user(ukeys + total * key_size, keys,
+			  key_size * bucket_cnt) ||
+	     copy_to_user(uvalues + total * value_size, values,
+			  value_size * bucket_cnt))) {
+		ret = -EFAULT;
+		goto after_loop;
+	}
+
+	total += bucket_cnt;
+	batch++;
+	if (batch >= htab->n_buckets) {
+		ret = -ENOENT;
+		goto after_loop;
+	}
+	goto again;
+
+after_loop:
+	if (ret == -EFAULT)
+		goto out;
+
+	/* report the number of copied elements and where to resume */
+	ubatch = u64_to_user_ptr(attr->batch.out_batch);
+	if (copy_to_user(ubatch, &batch, sizeof(batch)) ||
+	    put_user(total, &uattr->batch.count))
+		ret = -EFAULT;
+
+out:
+	kvfree(keys);
+	kvfree(values);
+	return ret;
+}
+
+static int htab_map_lookup_batch(struct bpf_map *map,
+				 const union bpf_attr *attr,
+				 union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_and_delete_batch(map, attr, uattr, false,
+						  false, false);
+}
+
+static int htab_map_lookup_and_delete_batch(struct bpf_map *map,
+					    const union bpf_attr *attr,
+					    union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_and_delete_batch(map, attr, uattr, true,
+						  false, false);
+}
+
+static int htab_lru_map_lookup_batch(struct bpf_map *map,
+				     const union bpf_attr *attr,
+				     union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_and_delete_batch(map, attr, uattr, false,
+						  true, false);
+}
+
+static int htab_lru_map_lookup_and_delete_batch(struct bpf_map *map,
+						const union bpf_attr *attr,
+						union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_and_delete_batch(map, attr, uattr, true,
+						  true, false);
+}
+
+static int htab_percpu_map_lookup_batch(struct bpf_map *map,
+					const union bpf_attr *attr,
+					union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_and_delete_batch(map, attr, uattr, false,
+						  false, true);
+}
+
+static int htab_percpu_map_lookup_and_delete_batch(struct bpf_map *map,
+						   const union bpf_attr *attr,
+						   union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_and_delete_batch(map, attr, uattr, true,
+						  false, true);
+}
+
+static int htab_lru_percpu_map_lookup_batch(struct bpf_map *map,
+					    const union bpf_attr *attr,
+					    union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_and_delete_batch(map, attr, uattr, false,
+						  true, true);
+}
+
+static int
+htab_lru_percpu_map_lookup_and_delete_batch(struct bpf_map *map,
+					    const union bpf_attr *attr,
+					    union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_and_delete_batch(map, attr, uattr, true,
+						  true, true);
+}
+
 const struct bpf_map_ops htab_map_ops = {
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
@@ -1147,6 +1454,11 @@ const struct bpf_map_ops htab_map_ops = {
 	.map_update_elem = htab_map_update_elem,
 	.map_delete_elem = htab_map_delete_elem,
 	.map_gen_lookup = htab_map_gen_lookup,
+	.map_lookup_batch = htab_map_lookup_batch,
+	.map_lookup_and_delete_batch = htab_map_lookup_and_delete_batch,
+	.map_update_batch = generic_map_update_batch,
+	.map_delete_batch = generic_map_delete_batch,
+	.map_fill_info = htab_map_fill_info,
 };
 
 const struct bpf_map_ops htab_lru_map_ops = {
@@ -1157,6 +1469,11 @@ const struct bpf_map_ops htab_lru_map_ops = {
 	.map_update_elem = htab_lru_map_update_elem,
 	.map_delete_elem = htab_lru_map_delete_elem,
 	.map_gen_lookup = htab_lru_map_gen_lookup,
+	.map_lookup_batch = htab_lru_map_lookup_batch,
+	.map_lookup_and_delete_batch = htab_lru_map_lookup_and_delete_batch,
+	.map_update_batch = generic_map_update_batch,
+	.map_delete_batch = generic_map_delete_batch,
+	.map_fill_info = htab_map_fill_info,
 };
 
 /* Called from eBPF program */
@@ -1239,6 +1556,11 @@ const struct bpf_map_ops htab_percpu_map_ops = {
 	.map_lookup_elem = htab_percpu_map_lookup_elem,
 	.map_update_elem = htab_percpu_map_update_elem,
 	.map_delete_elem = htab_map_delete_elem,
+	.map_lookup_batch = htab_percpu_map_lookup_batch,
+	.map_lookup_and_delete_batch = htab_percpu_map_lookup_and_delete_batch,
+	.map_update_batch = generic_map_update_batch,
+	.map_delete_batch = generic_map_delete_batch,
+	.map_fill_info = htab_map_fill_info,
 };
 
 const struct bpf_map_ops htab_lru_percpu_map_ops = {
@@ -1248,6 +1570,312 @@ const struct bpf_map_ops htab_lru_percpu_map_ops = {
 	.map_lookup_elem = htab_lru_percpu_map_lookup_elem,
 	.map_update_elem = htab_lru_percpu_map_update_elem,
 	.map_delete_elem = htab_lru_map_delete_elem,
+	.map_lookup_batch = htab_lru_percpu_map_lookup_batch,
+	.map_lookup_and_delete_batch =
+		htab_lru_percpu_map_lookup_and_delete_batch,
+	.map_update_batch = generic_map_update_batch,
+	.map_delete_batch = generic_map_delete_batch,
+	.map_fill_info = htab_map_fill_info,
+};
+
+/* BPF_F_RESIZABLE hash maps sit on an rhashtable, which starts small and
+ * doubles or halves its bucket array in the background as the load factor
+ * crosses 75% or 30%, while lookups keep running under RCU only. Elements
+ * are always allocated on update; max_entries still caps the element
+ * count, but no longer sizes the table up front.
+ *
+ * rhashtable takes its bucket locks with spin_lock_bh(), so updates and
+ * deletes from hard irq or NMI context (kprobes, perf events) are refused
+ * with -EBUSY; lookups work from any context.
+ */
+struct bpf_rhtab {
+	struct bpf_map map;
+	struct rhashtable ht;
+	struct rhashtable_params params;
+	atomic_t count;	/* number of elements in this hashtable */
+	u32 elem_size;	/* size of each element in bytes */
+};
+
+/* each element is struct rhtab_elem + key + value */
+struct rhtab_elem {
+	struct rhash_head node;
+	struct rcu_head rcu;
+	char key[0] __aligned(8);
+};
+
+static const struct bpf_map_ops rhtab_map_ops;
+
+static void *rhtab_elem_value(struct bpf_rhtab *rhtab, struct rhtab_elem *l)
+{
+	return l->key + round_up(rhtab->map.key_size, 8);
+}
+
+static struct bpf_map *rhtab_map_alloc(union bpf_attr *attr)
+{
+	struct bpf_rhtab *rhtab;
+	int err;
+	u64 cost;
+
+	if (attr->map_type != BPF_MAP_TYPE_HASH ||
+	    attr->map_flags != (BPF_F_NO_PREALLOC | BPF_F_RESIZABLE))
+		return ERR_PTR(-EINVAL);
+
+	/* same limits as htab_map_alloc() */
+	if (attr->max_entries == 0 || attr->key_size == 0 ||
+	    attr->value_size == 0)
+		return ERR_PTR(-EINVAL);
+
+	if (attr->key_size > MAX_BPF_STACK ||
+	    attr->value_size >= KMALLOC_MAX_SIZE - MAX_BPF_STACK -
+				sizeof(struct rhtab_elem))
+		return ERR_PTR(-E2BIG);
+
+	rhtab = kzalloc(sizeof(*rhtab), GFP_USER);
+	if (!rhtab)
+		return ERR_PTR(-ENOMEM);
+
+	/* mandatory map attributes */
+	rhtab->map.ops = &rhtab_map_ops;
+	rhtab->map.map_type = attr->map_type;
+	rhtab->map.key_size = attr->key_size;
+	rhtab->map.value_size = attr->value_size;
+	rhtab->map.max_entries = attr->max_entries;
+	rhtab->map.map_flags = attr->map_flags;
+	rhtab->map.numa_node = NUMA_NO_NODE;
+
+	rhtab->elem_size = sizeof(struct rhtab_elem) +
+			   round_up(attr->key_size, 8) +
+			   round_up(attr->value_size, 8);
+
+	/* charge for a full table, as never growing past it is all that
+	 * max_entries promises
+	 */
+	cost = (u64) roundup_pow_of_two(attr->max_entries) *
+	       sizeof(struct rhash_head) +
+	       (u64) rhtab->elem_size * attr->max_entries;
+
+	err = -ENOMEM;
+	if (cost >= U32_MAX - PAGE_SIZE)
+		goto free_rhtab;
+
+	rhtab->map.pages = round_up(cost, PAGE_SIZE) >> PAGE_SHIFT;
+
+	err = bpf_map_precharge_memlock(rhtab->map.pages);
+	if (err)
+		goto free_rhtab;
+
+	rhtab->params.head_offset = offsetof(struct rhtab_elem, node);
+	rhtab->params.key_offset = offsetof(struct rhtab_elem, key);
+	rhtab->params.key_len = attr->key_size;
+	rhtab->params.max_size = roundup_pow_of_two(attr->max_entries);
+	rhtab->params.automatic_shrinking = true;
+
+	err = rhashtable_init(&rhtab->ht, &rhtab->params);
+	if (err)
+		goto free_rhtab;
+
+	return &rhtab->map;
+
+free_rhtab:
+	kfree(rhtab);
+	return ERR_PTR(err);
+}
+
+static void rhtab_elem_free(void *ptr, void *arg)
+{
+	kfree(ptr);
+}
+
+static void rhtab_map_free(struct bpf_map *map)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+
+	/* at this point bpf_prog->aux->refcnt == 0 and this map->refcnt == 0,
+	 * so the programs (can be more than one that used this map) were
+	 * disconnected from events. Wait for outstanding critical sections in
+	 * these programs to complete
+	 */
+	synchronize_rcu();
+
+	rhashtable_free_and_destroy(&rhtab->ht, rhtab_elem_free, NULL);
+	kfree(rhtab);
+}
+
+/* Called from syscall or from eBPF program */
+static void *rhtab_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l;
+
+	l = rhashtable_lookup_fast(&rhtab->ht, key, rhtab->params);
+	if (l)
+		return rhtab_elem_value(rhtab, l);
+
+	return NULL;
+}
+
+/* Called from syscall or from eBPF program */
+static int rhtab_map_update_elem(struct bpf_map *map, void *key, void *value,
+				 u64 map_flags)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l_new, *l_old;
+	int ret;
+
+	if (unlikely(map_flags > BPF_EXIST))
+		/* unknown flags */
+		return -EINVAL;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	if (in_irq() || in_nmi())
+		return -EBUSY;
+
+	l_new = kmalloc(rhtab->elem_size, GFP_ATOMIC | __GFP_NOWARN);
+	if (!l_new)
+		return -ENOMEM;
+	memcpy(l_new->key, key, map->key_size);
+	memcpy(rhtab_elem_value(rhtab, l_new), value, map->value_size);
+
+again:
+	l_old = rhashtable_lookup_fast(&rhtab->ht, key, rhtab->params);
+	if (l_old && map_flags == BPF_NOEXIST) {
+		ret = -EEXIST;
+		goto err;
+	}
+	if (!l_old && map_flags == BPF_EXIST) {
+		ret = -ENOENT;
+		goto err;
+	}
+
+	if (l_old) {
+		ret = rhashtable_replace_fast(&rhtab->ht, &l_old->node,
+					      &l_new->node, rhtab->params);
+		/* deleted under us, BPF_ANY may still insert it */
+		if (ret == -ENOENT && map_flags == BPF_ANY)
+			goto again;
+		if (ret)
+			goto err;
+		kfree_rcu(l_old, rcu);
+		return 0;
+	}
+
+	if (atomic_inc_return(&rhtab->count) > map->max_entries) {
+		atomic_dec(&rhtab->count);
+		ret = -E2BIG;
+		goto err;
+	}
+
+	ret = rhashtable_lookup_insert_fast(&rhtab->ht, &l_new->node,
+					    rhtab->params);
+	if (ret) {
+		atomic_dec(&rhtab->count);
+		/* inserted under us, BPF_ANY may still replace it */
+		if (ret == -EEXIST && map_flags == BPF_ANY)
+			goto again;
+		goto err;
+	}
+	return 0;
+
+err:
+	kfree(l_new);
+	return ret;
+}
+
+/* Called from syscall or from eBPF program */
+static int rhtab_map_delete_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	if (in_irq() || in_nmi())
+		return -EBUSY;
+
+	l = rhashtable_lookup_fast(&rhtab->ht, key, rhtab->params);
+	if (!l || rhashtable_remove_fast(&rhtab->ht, &l->node, rhtab->params))
+		return -ENOENT;
+
+	atomic_dec(&rhtab->count);
+	kfree_rcu(l, rcu);
+	return 0;
+}
+
+/* Walks the current bucket table only; elements a resize in progress has
+ * already moved to the next table are picked up once it is published.
+ * Called from syscall with rcu_read_lock held.
+ */
+static int rhtab_map_get_next_key(struct bpf_map *map, void *key,
+				  void *next_key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	u32 key_size = map->key_size;
+	struct bucket_table *tbl;
+	struct rhash_head *pos;
+	struct rhtab_elem *l;
+	bool found = false;
+	unsigned int i = 0;
+
+	tbl = rht_dereference_rcu(rhtab->ht.tbl, &rhtab->ht);
+
+	if (key) {
+		i = rht_key_hashfn(&rhtab->ht, tbl, key, rhtab->params);
+		rht_for_each_entry_rcu(l, pos, tbl, i, node) {
+			if (found) {
+				memcpy(next_key, l->key, key_size);
+				return 0;
+			}
+			if (!memcmp(l->key, key, key_size))
+				found = true;
+		}
+		/* key is gone, restart from the first element */
+		i = found ? i + 1 : 0;
+	}
+
+	for (; i < tbl->size; i++) {
+		rht_for_each_entry_rcu(l, pos, tbl, i, node) {
+			memcpy(next_key, l->key, key_size);
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+static void rhtab_map_fill_info(struct bpf_map *map,
+				struct bpf_map_info *info)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct bucket_table *tbl;
+	struct rhash_head *pos;
+	u32 i, len, max_len = 0;
+
+	rcu_read_lock();
+	tbl = rht_dereference_rcu(rhtab->ht.tbl, &rhtab->ht);
+	info->nr_buckets = tbl->size;
+	for (i = 0; i < tbl->size; i++) {
+		len = 0;
+		rht_for_each_rcu(pos, tbl, i)
+			len++;
+		max_len = max(max_len, len);
+	}
+	rcu_read_unlock();
+
+	info->max_chain_len = max_len;
+}
+
+static const struct bpf_map_ops rhtab_map_ops = {
+	.map_alloc = rhtab_map_alloc,
+	.map_free = rhtab_map_free,
+	.map_get_next_key = rhtab_map_get_next_key,
+	.map_lookup_elem = rhtab_map_lookup_elem,
+	.map_update_elem = rhtab_map_update_elem,
+	.map_delete_elem = rhtab_map_delete_elem,
+	.map_lookup_batch = generic_map_lookup_batch,
+	.map_update_batch = generic_map_update_batch,
+	.map_delete_batch = generic_map_delete_batch,
+	.map_fill_info = rhtab_map_fill_info,
 };
 
 static struct bpf_map *fd_htab_map_alloc(union bpf_attr *attr)
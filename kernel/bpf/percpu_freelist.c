@@ -19,6 +19,7 @@ int pcpu_freelist_init(struct pcpu_freelist *s)
 
 		raw_spin_lock_init(&head->lock);
 		head->first = NULL;
+		head->steals = 0;
 	}
 	return 0;
 }
@@ -28,6 +29,16 @@ void pcpu_freelist_destroy(struct pcpu_freelist *s)
 	free_percpu(s->freelist);
 }
 
+u64 pcpu_freelist_steals(struct pcpu_freelist *s)
+{
+	u64 steals = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		steals += READ_ONCE(per_cpu_ptr(s->freelist, cpu)->steals);
+	return steals;
+}
+
 static inline void __pcpu_freelist_push(struct pcpu_freelist_head *head,
 					struct pcpu_freelist_node *node)
 {
@@ -87,6 +98,8 @@ struct pcpu_freelist_node *pcpu_freelist_pop(struct pcpu_freelist *s)
 		node = head->first;
 		if (node) {
 			head->first = node->next;
+			if (cpu != orig_cpu)
+				head->steals++;
 			raw_spin_unlock(&head->lock);
 			return node;
 		}
@@ -12,6 +12,8 @@
 struct pcpu_freelist_head {
 	struct pcpu_freelist_node *first;
 	raw_spinlock_t lock;
+	/* nodes popped from this list by other CPUs */
+	unsigned long steals;
 };
 
 struct pcpu_freelist {
@@ -28,4 +30,5 @@ void pcpu_freelist_populate(struct pcpu_freelist *s, void *buf, u32 elem_size,
 			    u32 nr_elems);
 int pcpu_freelist_init(struct pcpu_freelist *);
 void pcpu_freelist_destroy(struct pcpu_freelist *s);
+u64 pcpu_freelist_steals(struct pcpu_freelist *s);
 #endif
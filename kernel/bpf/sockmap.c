@@ -24,6 +24,11 @@
  * parse or verdict program. If adding a sock object to a map would result
  * in having multiple parsing programs the update will return an EBUSY error.
  *
+ * A verdict program redirecting with BPF_F_INGRESS queues the skb on the
+ * receive side of the target sock instead of sending it out of it. Such
+ * data is read with the sock's normal recvmsg() and poll(), so two local
+ * endpoints can be spliced without a trip through the TCP/IP stack.
+ *
  * For reference this program is similar to devmap used in XDP context
  * reviewing these together may be useful. For an example please review
  * ./samples/bpf/sockmap/.
@@ -38,6 +43,7 @@
 #include <linux/skbuff.h>
 #include <linux/workqueue.h>
 #include <linux/list.h>
+#include <linux/sched/signal.h>
 #include <net/strparser.h>
 #include <net/tcp.h>
 
@@ -66,6 +72,10 @@ struct smap_psock {
 	struct sk_buff_head rxqueue;
 	bool strp_enabled;
 
+	/* skbs redirected to our receive side, protected by the sock lock */
+	struct sk_buff_head ingress;
+	int ingress_off;
+
 	/* datapath error path cache across tx work invocations */
 	int save_rem;
 	int save_off;
@@ -86,6 +96,9 @@ struct smap_psock {
 	void (*save_data_ready)(struct sock *sk);
 	void (*save_write_space)(struct sock *sk);
 	void (*save_state_change)(struct sock *sk);
+
+	/* sk_prot of the sock before it was switched to bpf_tcp_prots */
+	struct proto *sk_proto;
 };
 
 static inline struct smap_psock *smap_psock_sk(const struct sock *sk)
@@ -93,6 +106,176 @@ static inline struct smap_psock *smap_psock_sk(const struct sock *sk)
 	return rcu_dereference_sk_user_data(sk);
 }
 
+/* Copies of the TCP protos with the ingress queue hooked into recvmsg()
+ * and poll(), one for tcp_prot and one for the IPv6 flavour.
+ */
+enum {
+	SOCKMAP_IPV4,
+	SOCKMAP_IPV6,
+	SOCKMAP_NUM_PROTS,
+};
+
+static struct proto bpf_tcp_prots[SOCKMAP_NUM_PROTS];
+static struct proto *bpf_tcp_bases[SOCKMAP_NUM_PROTS];
+static DEFINE_SPINLOCK(bpf_tcp_prots_lock);
+
+static int bpf_tcp_recvmsg(struct sock *sk, struct msghdr *msg, size_t len,
+			   int nonblock, int flags, int *addr_len);
+static bool bpf_tcp_stream_read(const struct sock *sk);
+
+static struct proto *smap_tcp_prot(struct sock *sk)
+{
+	int i = sk->sk_prot == &tcp_prot ? SOCKMAP_IPV4 : SOCKMAP_IPV6;
+
+	if (unlikely(READ_ONCE(bpf_tcp_bases[i]) != sk->sk_prot)) {
+		spin_lock_bh(&bpf_tcp_prots_lock);
+		if (bpf_tcp_bases[i] != sk->sk_prot) {
+			bpf_tcp_prots[i] = *sk->sk_prot;
+			bpf_tcp_prots[i].recvmsg = bpf_tcp_recvmsg;
+			bpf_tcp_prots[i].stream_memory_read =
+				bpf_tcp_stream_read;
+			smp_wmb();
+			WRITE_ONCE(bpf_tcp_bases[i], sk->sk_prot);
+		}
+		spin_unlock_bh(&bpf_tcp_prots_lock);
+	}
+
+	return &bpf_tcp_prots[i];
+}
+
+static struct smap_psock *smap_psock_sk_locked(const struct sock *sk)
+{
+	struct smap_psock *psock;
+
+	/* The psock can not be freed while we hold the sock lock, see
+	 * smap_gc_work().
+	 */
+	rcu_read_lock();
+	psock = smap_psock_sk(sk);
+	rcu_read_unlock();
+	return psock;
+}
+
+static bool bpf_tcp_stream_read(const struct sock *sk)
+{
+	struct smap_psock *psock;
+	bool empty = true;
+
+	rcu_read_lock();
+	psock = smap_psock_sk(sk);
+	if (likely(psock))
+		empty = skb_queue_empty(&psock->ingress);
+	rcu_read_unlock();
+	return !empty;
+}
+
+static bool smap_ingress_ready(struct sock *sk)
+{
+	struct smap_psock *psock = smap_psock_sk_locked(sk);
+
+	return !psock || !skb_queue_empty(&psock->ingress);
+}
+
+/* Called with the sock lock held, which is dropped while sleeping */
+static void smap_wait_data(struct sock *sk, long *timeo)
+{
+	DEFINE_WAIT_FUNC(wait, woken_wake_function);
+
+	add_wait_queue(sk_sleep(sk), &wait);
+	sk_set_bit(SOCKWQ_ASYNC_WAITDATA, sk);
+	sk_wait_event(sk, timeo,
+		      smap_ingress_ready(sk) ||
+		      !skb_queue_empty(&sk->sk_receive_queue) ||
+		      sk->sk_err || (sk->sk_shutdown & RCV_SHUTDOWN),
+		      &wait);
+	sk_clear_bit(SOCKWQ_ASYNC_WAITDATA, sk);
+	remove_wait_queue(sk_sleep(sk), &wait);
+}
+
+static int smap_ingress_recv(struct smap_psock *psock, struct msghdr *msg,
+			     size_t len, int flags)
+{
+	struct sk_buff *skb, *tmp;
+	int off = psock->ingress_off;
+	int copied = 0, n, err;
+
+	skb_queue_walk_safe(&psock->ingress, skb, tmp) {
+		n = min_t(size_t, len - copied, skb->len - off);
+		err = skb_copy_datagram_msg(skb, off, msg, n);
+		if (err)
+			return copied ? : err;
+		copied += n;
+
+		if (flags & MSG_PEEK) {
+			off = 0;
+		} else if (off + n < skb->len) {
+			psock->ingress_off = off + n;
+			break;
+		} else {
+			psock->ingress_off = off = 0;
+			__skb_unlink(skb, &psock->ingress);
+			consume_skb(skb);
+		}
+
+		if (copied == len)
+			break;
+	}
+
+	return copied;
+}
+
+/* Restart a redirect that stalled on our receive buffer being full */
+static void smap_ingress_resume(struct sock *sk)
+{
+	struct smap_psock *psock;
+
+	rcu_read_lock();
+	psock = smap_psock_sk(sk);
+	if (psock && READ_ONCE(psock->save_skb) &&
+	    test_bit(SMAP_TX_RUNNING, &psock->state))
+		schedule_work(&psock->tx_work);
+	rcu_read_unlock();
+}
+
+static int bpf_tcp_recvmsg(struct sock *sk, struct msghdr *msg, size_t len,
+			   int nonblock, int flags, int *addr_len)
+{
+	struct smap_psock *psock;
+	long timeo;
+	int copied;
+
+	if (unlikely(flags & (MSG_ERRQUEUE | MSG_OOB)))
+		return tcp_recvmsg(sk, msg, len, nonblock, flags, addr_len);
+
+	lock_sock(sk);
+	timeo = sock_rcvtimeo(sk, nonblock);
+	for (;;) {
+		psock = smap_psock_sk_locked(sk);
+		if (!psock || !skb_queue_empty(&sk->sk_receive_queue))
+			break;
+
+		if (!skb_queue_empty(&psock->ingress)) {
+			copied = smap_ingress_recv(psock, msg, len, flags);
+			release_sock(sk);
+			smap_ingress_resume(sk);
+			return copied;
+		}
+
+		/* Let tcp_recvmsg() report EOF, errors and EAGAIN/EINTR */
+		if (!timeo || sk->sk_err || (sk->sk_shutdown & RCV_SHUTDOWN) ||
+		    sock_flag(sk, SOCK_DONE) || sk->sk_state == TCP_CLOSE ||
+		    signal_pending(current))
+			break;
+
+		smap_wait_data(sk, &timeo);
+	}
+	release_sock(sk);
+
+	copied = tcp_recvmsg(sk, msg, len, nonblock, flags, addr_len);
+	smap_ingress_resume(sk);
+	return copied;
+}
+
 /* compute the linear packet data range [data, data_end) for skb when
  * sk_skb type programs are in use.
  */
@@ -155,6 +338,29 @@ static void smap_do_verdict(struct smap_psock *psock, struct sk_buff *skb)
 	}
 }
 
+/* Called from the tx work of the target psock, so with its sock locked.
+ * Returns false if the sock has no receive space left; the skb is then
+ * retried once the reader has made room.
+ */
+static bool smap_do_ingress(struct smap_psock *psock, struct sk_buff *skb)
+{
+	struct sock *sk = psock->sock;
+
+	if (atomic_read(&sk->sk_rmem_alloc) > sk->sk_rcvbuf ||
+	    !sk_rmem_schedule(sk, skb, skb->truesize))
+		return false;
+
+	skb_orphan(skb);
+	skb_set_owner_r(skb, sk);
+	__skb_queue_tail(&psock->ingress, skb);
+
+	if (psock->save_data_ready)
+		psock->save_data_ready(sk);
+	else
+		sk->sk_data_ready(sk);
+	return true;
+}
+
 static void smap_report_sk_error(struct smap_psock *psock, int err)
 {
 	struct sock *sk = psock->sock;
@@ -273,6 +479,16 @@ static void smap_tx_work(struct work_struct *w)
 		rem = skb->len;
 		off = 0;
 start:
+		if (TCP_SKB_CB(skb)->bpf.flags & BPF_F_INGRESS) {
+			if (!smap_do_ingress(psock, skb)) {
+				psock->save_skb = skb;
+				psock->save_rem = rem;
+				psock->save_off = off;
+				goto out;
+			}
+			continue;
+		}
+
 		do {
 			if (likely(psock->sock->sk_socket))
 				n = skb_send_sock_locked(psock->sock,
@@ -349,6 +565,7 @@ static void smap_release_sock(struct smap_psock *psock, struct sock *sock)
 
 	smap_stop_sock(psock, sock);
 	clear_bit(SMAP_TX_RUNNING, &psock->state);
+	WRITE_ONCE(sock->sk_prot, psock->sk_proto);
 	rcu_assign_sk_user_data(sock, NULL);
 	call_rcu_sched(&psock->rcu, smap_destroy_psock);
 }
@@ -448,8 +665,16 @@ static void smap_gc_work(struct work_struct *w)
 	if (psock->strp_enabled)
 		strp_done(&psock->strp);
 
+	/* Readers of the ingress queue look the psock up with the sock
+	 * lock held. sk_user_data is already cleared, so once we got the
+	 * lock no one can still be using it.
+	 */
+	lock_sock(psock->sock);
+	release_sock(psock->sock);
+
 	cancel_work_sync(&psock->tx_work);
 	__skb_queue_purge(&psock->rxqueue);
+	__skb_queue_purge(&psock->ingress);
 
 	/* At this point all strparser and xmit work must be complete */
 	if (psock->bpf_parse)
@@ -479,11 +704,15 @@ static struct smap_psock *smap_init_psock(struct sock *sock,
 
 	psock->sock = sock;
 	skb_queue_head_init(&psock->rxqueue);
+	skb_queue_head_init(&psock->ingress);
 	INIT_WORK(&psock->tx_work, smap_tx_work);
 	INIT_WORK(&psock->gc_work, smap_gc_work);
 	INIT_LIST_HEAD(&psock->maps);
 	psock->refcnt = 1;
 
+	psock->sk_proto = sock->sk_prot;
+	WRITE_ONCE(sock->sk_prot, smap_tcp_prot(sock));
+
 	rcu_assign_sk_user_data(sock, psock);
 	sock_hold(sock);
 	return psock;
@@ -0,0 +1,401 @@
+/* BPF programs attached directly to kernel function entry and exit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+/* A trampoline hooks one kernel function and runs the BPF_PROG_TYPE_KPROBE
+ * programs attached to it with the function's pt_regs as context, without
+ * going through a kprobe, a trace_kprobe event or a perf event.
+ *
+ * Entry programs (BPF_TRACE_FENTRY) run from a private ftrace_ops that
+ * saves registers and is filtered on the function's mcount site alone, so
+ * other functions never see the callback. Exit programs (BPF_TRACE_FEXIT)
+ * run from a kretprobe on the function, whose return trampoline already
+ * hands over the registers holding the return value; the ftrace_ops has no
+ * way to hook returns.
+ *
+ * Each trampoline keeps an RCU protected array of programs per hook,
+ * replaced whole under trampoline_mutex. The hooks themselves are only
+ * registered while at least one program needs them. BPF_TRACE_OPEN hands
+ * out one fd per attached program; closing it detaches the program.
+ */
+#include <linux/anon_inodes.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/ftrace.h>
+#include <linux/hash.h>
+#include <linux/kallsyms.h>
+#include <linux/kprobes.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+
+/* programs per hook of a single function */
+#define BPF_TRAMP_MAX_PROGS	16
+
+#define TRAMPOLINE_HASH_BITS	7
+#define TRAMPOLINE_TABLE_SIZE	(1 << TRAMPOLINE_HASH_BITS)
+
+enum bpf_tramp_kind {
+	BPF_TRAMP_FENTRY,
+	BPF_TRAMP_FEXIT,
+	BPF_TRAMP_MAX,
+};
+
+struct bpf_tramp_progs {
+	struct rcu_head rcu;
+	u32 cnt;
+	struct bpf_prog *progs[];
+};
+
+struct bpf_trampoline {
+	struct hlist_node hlist;
+	/* function start, as resolved from kallsyms */
+	unsigned long ip;
+	int refcnt;
+	struct ftrace_ops fops;
+#ifdef CONFIG_KRETPROBES
+	struct kretprobe krp;
+#endif
+	struct bpf_tramp_progs __rcu *progs[BPF_TRAMP_MAX];
+};
+
+/* state behind one fd returned by BPF_TRACE_OPEN */
+struct bpf_tramp_link {
+	struct bpf_trampoline *tr;
+	struct bpf_prog *prog;
+	enum bpf_tramp_kind kind;
+};
+
+/* serializes trampoline lookup, creation and program array updates */
+static DEFINE_MUTEX(trampoline_mutex);
+static struct hlist_head trampoline_table[TRAMPOLINE_TABLE_SIZE];
+
+static void bpf_trampoline_run(struct bpf_trampoline *tr,
+			       enum bpf_tramp_kind kind, struct pt_regs *regs)
+{
+	struct bpf_tramp_progs *progs;
+	u32 i;
+
+	if (in_nmi()) /* not supported yet */
+		return;
+
+	preempt_disable();
+	/* same recursion rule as trace_call_bpf() */
+	if (unlikely(__this_cpu_inc_return(bpf_prog_active) != 1))
+		goto out;
+
+	rcu_read_lock();
+	progs = rcu_dereference(tr->progs[kind]);
+	if (progs) {
+		for (i = 0; i < progs->cnt; i++)
+			BPF_PROG_RUN(progs->progs[i], regs);
+	}
+	rcu_read_unlock();
+out:
+	__this_cpu_dec(bpf_prog_active);
+	preempt_enable();
+}
+
+static void bpf_trampoline_fentry(unsigned long ip, unsigned long parent_ip,
+				  struct ftrace_ops *op, struct pt_regs *regs)
+{
+	struct bpf_trampoline *tr = container_of(op, struct bpf_trampoline,
+						 fops);
+
+	bpf_trampoline_run(tr, BPF_TRAMP_FENTRY, regs);
+}
+
+static int bpf_trampoline_fentry_register(struct bpf_trampoline *tr)
+{
+	unsigned long size, offset, rec_ip;
+	int err;
+
+	if (!kallsyms_lookup_size_offset(tr->ip, &size, &offset))
+		return -ENOENT;
+
+	/* the mcount site need not be the first instruction */
+	rec_ip = ftrace_location_range(tr->ip, tr->ip + size - 1);
+	if (!rec_ip)
+		return -EINVAL;
+
+	memset(&tr->fops, 0, sizeof(tr->fops));
+	tr->fops.func = bpf_trampoline_fentry;
+	tr->fops.flags = FTRACE_OPS_FL_SAVE_REGS;
+	err = ftrace_set_filter_ip(&tr->fops, rec_ip, 0, 0);
+	if (err)
+		return err;
+
+	err = register_ftrace_function(&tr->fops);
+	if (err)
+		ftrace_free_filter(&tr->fops);
+	return err;
+}
+
+static void bpf_trampoline_fentry_unregister(struct bpf_trampoline *tr)
+{
+	unregister_ftrace_function(&tr->fops);
+	ftrace_free_filter(&tr->fops);
+}
+
+#ifdef CONFIG_KRETPROBES
+static int bpf_trampoline_fexit(struct kretprobe_instance *ri,
+				struct pt_regs *regs)
+{
+	struct bpf_trampoline *tr = container_of(ri->rp, struct bpf_trampoline,
+						 krp);
+
+	bpf_trampoline_run(tr, BPF_TRAMP_FEXIT, regs);
+	return 0;
+}
+
+static int bpf_trampoline_fexit_register(struct bpf_trampoline *tr)
+{
+	memset(&tr->krp, 0, sizeof(tr->krp));
+	tr->krp.kp.addr = (kprobe_opcode_t *)tr->ip;
+	tr->krp.handler = bpf_trampoline_fexit;
+
+	return register_kretprobe(&tr->krp);
+}
+
+static void bpf_trampoline_fexit_unregister(struct bpf_trampoline *tr)
+{
+	unregister_kretprobe(&tr->krp);
+}
+#else
+static int bpf_trampoline_fexit_register(struct bpf_trampoline *tr)
+{
+	return -ENOTSUPP;
+}
+
+static void bpf_trampoline_fexit_unregister(struct bpf_trampoline *tr)
+{
+}
+#endif
+
+static struct hlist_head *trampoline_bucket(unsigned long ip)
+{
+	return &trampoline_table[hash_long(ip, TRAMPOLINE_HASH_BITS)];
+}
+
+/* called with trampoline_mutex held */
+static struct bpf_trampoline *bpf_trampoline_get(unsigned long ip)
+{
+	struct hlist_head *head = trampoline_bucket(ip);
+	struct bpf_trampoline *tr;
+
+	hlist_for_each_entry(tr, head, hlist) {
+		if (tr->ip == ip) {
+			tr->refcnt++;
+			return tr;
+		}
+	}
+
+	tr = kzalloc(sizeof(*tr), GFP_KERNEL);
+	if (!tr)
+		return NULL;
+
+	tr->ip = ip;
+	tr->refcnt = 1;
+	hlist_add_head(&tr->hlist, head);
+	return tr;
+}
+
+/* called with trampoline_mutex held */
+static void bpf_trampoline_put(struct bpf_trampoline *tr)
+{
+	if (--tr->refcnt)
+		return;
+
+	hlist_del(&tr->hlist);
+	kfree(tr);
+}
+
+/* Replace the @kind program array with a copy that has @prog added, or
+ * removed when @add is false. Removal cannot fail, so that closing an fd
+ * always detaches its program. Called with trampoline_mutex held.
+ */
+static int bpf_trampoline_update_progs(struct bpf_trampoline *tr,
+				       enum bpf_tramp_kind kind,
+				       struct bpf_prog *prog, bool add)
+{
+	struct bpf_tramp_progs *old, *new = NULL;
+	bool removed = false;
+	u32 i, cnt;
+
+	old = rcu_dereference_protected(tr->progs[kind],
+					lockdep_is_held(&trampoline_mutex));
+	cnt = old ? old->cnt : 0;
+
+	if (add) {
+		if (cnt >= BPF_TRAMP_MAX_PROGS)
+			return -E2BIG;
+		cnt++;
+	} else {
+		cnt--;
+	}
+
+	if (cnt) {
+		new = kmalloc(sizeof(*new) + cnt * sizeof(new->progs[0]),
+			      add ? GFP_KERNEL : GFP_KERNEL | __GFP_NOFAIL);
+		if (!new)
+			return -ENOMEM;
+
+		new->cnt = 0;
+		for (i = 0; old && i < old->cnt; i++) {
+			/* the same program may be attached more than once */
+			if (!add && !removed && old->progs[i] == prog) {
+				removed = true;
+				continue;
+			}
+			new->progs[new->cnt++] = old->progs[i];
+		}
+		if (add)
+			new->progs[new->cnt++] = prog;
+	}
+
+	rcu_assign_pointer(tr->progs[kind], new);
+	if (old)
+		kfree_rcu(old, rcu);
+	return 0;
+}
+
+static int bpf_trampoline_link_prog(struct bpf_trampoline *tr,
+				    enum bpf_tramp_kind kind,
+				    struct bpf_prog *prog)
+{
+	bool first = !rcu_access_pointer(tr->progs[kind]);
+	int err;
+
+	err = bpf_trampoline_update_progs(tr, kind, prog, true);
+	if (err || !first)
+		return err;
+
+	if (kind == BPF_TRAMP_FENTRY)
+		err = bpf_trampoline_fentry_register(tr);
+	else
+		err = bpf_trampoline_fexit_register(tr);
+	if (err)
+		bpf_trampoline_update_progs(tr, kind, prog, false);
+	return err;
+}
+
+static void bpf_trampoline_unlink_prog(struct bpf_trampoline *tr,
+				       enum bpf_tramp_kind kind,
+				       struct bpf_prog *prog)
+{
+	struct bpf_tramp_progs *progs;
+
+	progs = rcu_dereference_protected(tr->progs[kind],
+					  lockdep_is_held(&trampoline_mutex));
+	/* stop the hook before its last program goes away */
+	if (progs->cnt == 1) {
+		if (kind == BPF_TRAMP_FENTRY)
+			bpf_trampoline_fentry_unregister(tr);
+		else
+			bpf_trampoline_fexit_unregister(tr);
+	}
+
+	bpf_trampoline_update_progs(tr, kind, prog, false);
+}
+
+static int bpf_tramp_link_release(struct inode *inode, struct file *filp)
+{
+	struct bpf_tramp_link *link = filp->private_data;
+
+	mutex_lock(&trampoline_mutex);
+	bpf_trampoline_unlink_prog(link->tr, link->kind, link->prog);
+	bpf_trampoline_put(link->tr);
+	mutex_unlock(&trampoline_mutex);
+
+	bpf_prog_put(link->prog);
+	kfree(link);
+	return 0;
+}
+
+static const struct file_operations bpf_tramp_link_fops = {
+	.release	= bpf_tramp_link_release,
+};
+
+int bpf_trampoline_open(const union bpf_attr *attr)
+{
+	char name[KSYM_NAME_LEN];
+	struct bpf_tramp_link *link;
+	struct bpf_trampoline *tr;
+	enum bpf_tramp_kind kind;
+	struct bpf_prog *prog;
+	unsigned long ip;
+	int err, fd;
+
+	switch (attr->trace.attach_type) {
+	case BPF_TRACE_FENTRY:
+		kind = BPF_TRAMP_FENTRY;
+		break;
+	case BPF_TRACE_FEXIT:
+		kind = BPF_TRAMP_FEXIT;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (strncpy_from_user(name, u64_to_user_ptr(attr->trace.name),
+			      sizeof(name) - 1) < 0)
+		return -EFAULT;
+	name[sizeof(name) - 1] = 0;
+
+	ip = kallsyms_lookup_name(name);
+	if (!ip)
+		return -ENOENT;
+
+	prog = bpf_prog_get_type(attr->trace.prog_fd, BPF_PROG_TYPE_KPROBE);
+	if (IS_ERR(prog))
+		return PTR_ERR(prog);
+
+	link = kzalloc(sizeof(*link), GFP_USER);
+	if (!link) {
+		err = -ENOMEM;
+		goto out_put_prog;
+	}
+	link->prog = prog;
+	link->kind = kind;
+
+	mutex_lock(&trampoline_mutex);
+	tr = bpf_trampoline_get(ip);
+	if (!tr) {
+		err = -ENOMEM;
+		goto out_unlock;
+	}
+	err = bpf_trampoline_link_prog(tr, kind, prog);
+	if (err) {
+		bpf_trampoline_put(tr);
+		goto out_unlock;
+	}
+	link->tr = tr;
+	mutex_unlock(&trampoline_mutex);
+
+	fd = anon_inode_getfd("bpf-trampoline", &bpf_tramp_link_fops, link,
+			      O_CLOEXEC);
+	if (fd < 0) {
+		mutex_lock(&trampoline_mutex);
+		bpf_trampoline_unlink_prog(tr, kind, prog);
+		bpf_trampoline_put(tr);
+		mutex_unlock(&trampoline_mutex);
+		err = fd;
+		goto out_free_link;
+	}
+	return fd;
+
+out_unlock:
+	mutex_unlock(&trampoline_mutex);
+out_free_link:
+	kfree(link);
+out_put_prog:
+	bpf_prog_put(prog);
+	return err;
+}
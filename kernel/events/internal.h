@@ -26,6 +26,8 @@ struct ring_buffer {
 	local_t				events;		/* event limit       */
 	local_t				wakeup;		/* wakeup stamp      */
 	local_t				lost;		/* nr records lost   */
+	local_t				lost_nospace;	/* ... ever, no room */
+	local_t				lost_paused;	/* ... ever, paused  */
 
 	long				watermark;	/* wakeup watermark  */
 	long				aux_watermark;
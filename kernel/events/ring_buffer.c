@@ -139,8 +139,11 @@ __perf_output_begin(struct perf_output_handle *handle,
 		goto out;
 
 	if (unlikely(rb->paused)) {
-		if (rb->nr_pages)
+		if (rb->nr_pages) {
 			local_inc(&rb->lost);
+			WRITE_ONCE(rb->user_page->lost_paused,
+				   local_inc_return(&rb->lost_paused));
+		}
 		goto out;
 	}
 
@@ -223,6 +226,14 @@ __perf_output_begin(struct perf_output_handle *handle,
 
 fail:
 	local_inc(&rb->lost);
+	WRITE_ONCE(rb->user_page->lost_nospace,
+		   local_inc_return(&rb->lost_nospace));
+	/*
+	 * The consumer has fallen behind far enough that records are being
+	 * dropped; waiting for the next watermark crossing would only drop
+	 * more, so wake it now.
+	 */
+	perf_output_wakeup(handle);
 	perf_output_put_handle(handle);
 out:
 	rcu_read_unlock();
@@ -681,7 +692,10 @@ void rb_free_aux(struct ring_buffer *rb)
 #ifndef CONFIG_PERF_USE_VMALLOC
 
 /*
- * Back perf_mmap() with regular GFP_KERNEL-0 pages.
+ * Back perf_mmap() with regular GFP_KERNEL pages.  The data area is
+ * allocated in chunks that are as large as the allocator will readily
+ * give us, then split, so big buffers end up physically contiguous
+ * while each page can still be mapped and freed on its own.
  */
 
 static struct page *
@@ -709,6 +723,37 @@ static void *perf_mmap_alloc_page(int cpu)
 	return page_address(page);
 }
 
+/*
+ * Fill @pages with up to @nr_pages pages from a single allocation, trying
+ * the largest order that fits first.  Returns the number of pages filled,
+ * 0 on failure.
+ */
+static int perf_mmap_alloc_chunk(void **pages, int nr_pages, int cpu)
+{
+	int node = (cpu == -1) ? cpu : cpu_to_node(cpu);
+	int order = min(ilog2(nr_pages), MAX_ORDER - 1);
+	struct page *page;
+	int i;
+
+	for (; order > 0; order--) {
+		page = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO |
+					__GFP_NORETRY | __GFP_NOWARN, order);
+		if (page)
+			break;
+	}
+
+	if (!order) {
+		pages[0] = perf_mmap_alloc_page(cpu);
+		return pages[0] ? 1 : 0;
+	}
+
+	split_page(page, order);
+	for (i = 0; i < (1 << order); i++)
+		pages[i] = page_address(page + i);
+
+	return 1 << order;
+}
+
 struct ring_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 {
 	struct ring_buffer *rb;
@@ -726,10 +771,12 @@ struct ring_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 	if (!rb->user_page)
 		goto fail_user_page;
 
-	for (i = 0; i < nr_pages; i++) {
-		rb->data_pages[i] = perf_mmap_alloc_page(cpu);
-		if (!rb->data_pages[i])
+	for (i = 0; i < nr_pages; ) {
+		int nr = perf_mmap_alloc_chunk(&rb->data_pages[i],
+					       nr_pages - i, cpu);
+		if (!nr)
 			goto fail_data_pages;
+		i += nr;
 	}
 
 	rb->nr_pages = nr_pages;
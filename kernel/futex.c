@@ -67,6 +67,7 @@
 #include <linux/freezer.h>
 #include <linux/bootmem.h>
 #include <linux/fault-inject.h>
+#include <linux/vmalloc.h>
 
 #include <asm/futex.h>
 
@@ -269,13 +270,29 @@ struct futex_hash_bucket {
  * The base of the bucket array and its size are always used together
  * (after initialization only in hash_futex()), so ensure that they
  * reside in the same cacheline.
+ *
+ * With futex_numa=1 on the command line of a NUMA machine, the buckets are
+ * split into one table per node, each allocated on its node, and hashsize
+ * is the size of a single table.
  */
 static struct {
 	struct futex_hash_bucket *queues;
 	unsigned long            hashsize;
-} __futex_data __read_mostly __aligned(2*sizeof(long));
+	struct futex_hash_bucket **node_queues;
+	unsigned int             nodes;
+} __futex_data __read_mostly __aligned(4*sizeof(long));
 #define futex_queues   (__futex_data.queues)
 #define futex_hashsize (__futex_data.hashsize)
+#define futex_node_queues (__futex_data.node_queues)
+#define futex_nodes    (__futex_data.nodes)
+
+static bool futex_numa __initdata;
+
+static int __init setup_futex_numa(char *str)
+{
+	return kstrtobool(str, &futex_numa) == 0;
+}
+__setup("futex_numa=", setup_futex_numa);
 
 
 /*
@@ -395,6 +412,18 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
+
+	/*
+	 * The node is picked from the hash bits above the table index, not
+	 * from the page backing the futex: the page can migrate between a
+	 * wait and the matching wake, which would then miss the waiter.
+	 */
+	if (futex_nodes) {
+		unsigned int node;
+
+		node = (hash / futex_hashsize) % futex_nodes;
+		return &futex_node_queues[node][hash & (futex_hashsize - 1)];
+	}
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
@@ -2622,6 +2651,132 @@ static int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 }
 
 
+/*
+ * Unqueue the first @count futex_qs of a FUTEX_WAIT_MULTIPLE call.
+ * Returns the index of one that was woken up already, or -1.
+ */
+static int unqueue_multiple(struct futex_q *q, int count)
+{
+	int ret = -1;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!unqueue_me(&q[i]))
+			ret = i;
+	}
+	return ret;
+}
+
+/**
+ * futex_wait_multiple() - Wait on a vector of futexes, woken by any of them
+ * @uaddr:	user pointer to an array of struct futex_wait_block
+ * @flags:	futex flags (FLAGS_SHARED, etc.)
+ * @count:	number of entries in the array
+ * @abs_time:	absolute timeout, or NULL for none
+ *
+ * All the futexes are queued with the task still running, each one after
+ * checking its value as futex_wait() does. A wakeup of any of them after it
+ * is queued either makes the check before schedule() see it unqueued, or
+ * finds the task already in TASK_INTERRUPTIBLE.
+ *
+ * Return:
+ *  - >=0 - index of the futex that was woken up;
+ *  -  <0 - -EWOULDBLOCK if a futex did not contain its value, or an error
+ */
+static int futex_wait_multiple(u32 __user *uaddr, unsigned int flags,
+			       u32 count, ktime_t *abs_time)
+{
+	struct hrtimer_sleeper timeout, *to = NULL;
+	struct futex_wait_block *wb;
+	struct futex_hash_bucket *hb;
+	struct futex_q *qs;
+	int ret, woken, i;
+
+	if (!count || count > FUTEX_MULTIPLE_MAX_COUNT)
+		return -EINVAL;
+
+	wb = memdup_user(uaddr, count * sizeof(*wb));
+	if (IS_ERR(wb))
+		return PTR_ERR(wb);
+
+	qs = kmalloc_array(count, sizeof(*qs), GFP_KERNEL);
+	if (!qs) {
+		kfree(wb);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!wb[i].bitset) {
+			ret = -EINVAL;
+			goto out_free;
+		}
+		qs[i] = futex_q_init;
+		qs[i].bitset = wb[i].bitset;
+	}
+
+	if (abs_time) {
+		to = &timeout;
+
+		hrtimer_init_on_stack(&to->timer, (flags & FLAGS_CLOCKRT) ?
+				      CLOCK_REALTIME : CLOCK_MONOTONIC,
+				      HRTIMER_MODE_ABS);
+		hrtimer_init_sleeper(to, current);
+		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
+					     current->timer_slack_ns);
+	}
+
+retry:
+	for (i = 0; i < count; i++) {
+		ret = futex_wait_setup(u64_to_user_ptr(wb[i].uaddr), wb[i].val,
+				       flags, &qs[i], &hb);
+		if (ret) {
+			/* One of the futexes queued before may have fired */
+			woken = unqueue_multiple(qs, i);
+			if (woken >= 0)
+				ret = woken;
+			goto out;
+		}
+		queue_me(&qs[i], hb);
+	}
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	if (to)
+		hrtimer_start_expires(&to->timer, HRTIMER_MODE_ABS);
+
+	for (i = 0; i < count; i++) {
+		if (plist_node_empty(&qs[i].list))
+			break;
+	}
+	if (i == count && (!to || to->task))
+		freezable_schedule();
+	__set_current_state(TASK_RUNNING);
+
+	/* unqueue_multiple() drops the key refs */
+	ret = unqueue_multiple(qs, count);
+	if (ret >= 0)
+		goto out;
+	ret = -ETIMEDOUT;
+	if (to && !to->task)
+		goto out;
+
+	if (!signal_pending(current))
+		goto retry;
+
+	/* A restart would start the timeout over: let userspace decide */
+	ret = to ? -EINTR : -ERESTARTSYS;
+
+out:
+	if (to) {
+		hrtimer_cancel(&to->timer);
+		destroy_hrtimer_on_stack(&to->timer);
+	}
+out_free:
+	kfree(qs);
+	kfree(wb);
+	return ret;
+}
+
 static long futex_wait_restart(struct restart_block *restart)
 {
 	u32 __user *uaddr = restart->futex.uaddr;
@@ -3486,6 +3641,8 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 					     uaddr2);
 	case FUTEX_CMP_REQUEUE_PI:
 		return futex_requeue(uaddr, flags, uaddr2, val, val2, &val3, 1);
+	case FUTEX_WAIT_MULTIPLE:
+		return futex_wait_multiple(uaddr, flags, val, timeout);
 	}
 	return -ENOSYS;
 }
@@ -3502,7 +3659,8 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
 		      cmd == FUTEX_WAIT_BITSET ||
-		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
+		      cmd == FUTEX_WAIT_REQUEUE_PI ||
+		      cmd == FUTEX_WAIT_MULTIPLE)) {
 		if (unlikely(should_fail_futex(!(op & FUTEX_PRIVATE_FLAG))))
 			return -EFAULT;
 		if (copy_from_user(&ts, utime, sizeof(ts)) != 0)
@@ -3511,7 +3669,7 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 			return -EINVAL;
 
 		t = timespec_to_ktime(ts);
-		if (cmd == FUTEX_WAIT)
+		if (cmd == FUTEX_WAIT || cmd == FUTEX_WAIT_MULTIPLE)
 			t = ktime_add_safe(ktime_get(), t);
 		tp = &t;
 	}
@@ -3546,10 +3704,62 @@ static void __init futex_detect_cmpxchg(void)
 #endif
 }
 
+static void __init futex_init_buckets(struct futex_hash_bucket *queues)
+{
+	unsigned long i;
+
+	for (i = 0; i < futex_hashsize; i++) {
+		atomic_set(&queues[i].waiters, 0);
+		plist_head_init(&queues[i].chain);
+		spin_lock_init(&queues[i].lock);
+	}
+}
+
+/*
+ * Split the futex hash into one table per node, falling back to the global
+ * one if any allocation fails.
+ */
+static bool __init futex_init_node_queues(void)
+{
+	unsigned long size;
+	int node;
+
+	futex_node_queues = kcalloc(nr_node_ids, sizeof(*futex_node_queues),
+				    GFP_KERNEL);
+	if (!futex_node_queues)
+		return false;
+
+	size = max(16UL, futex_hashsize / nr_node_ids);
+	size = roundup_pow_of_two(size);
+
+	/* Holes in the node map get a table too, hash_futex() can pick them */
+	for (node = 0; node < nr_node_ids; node++) {
+		futex_node_queues[node] =
+			vmalloc_node(size * sizeof(**futex_node_queues),
+				     node_possible(node) ? node : NUMA_NO_NODE);
+		if (!futex_node_queues[node])
+			goto fail;
+	}
+
+	futex_hashsize = size;
+	for (node = 0; node < nr_node_ids; node++)
+		futex_init_buckets(futex_node_queues[node]);
+	futex_nodes = nr_node_ids;
+	pr_info("futex hash: %u nodes, %lu buckets each\n",
+		futex_nodes, futex_hashsize);
+	return true;
+
+fail:
+	for (node = 0; node < nr_node_ids; node++)
+		vfree(futex_node_queues[node]);
+	kfree(futex_node_queues);
+	futex_node_queues = NULL;
+	return false;
+}
+
 static int __init futex_init(void)
 {
 	unsigned int futex_shift;
-	unsigned long i;
 
 #if CONFIG_BASE_SMALL
 	futex_hashsize = 16;
@@ -3557,6 +3767,12 @@ static int __init futex_init(void)
 	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
 #endif
 
+	futex_detect_cmpxchg();
+
+	if (futex_numa && num_node_state(N_POSSIBLE) > 1 &&
+	    futex_init_node_queues())
+		return 0;
+
 	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
 					       futex_hashsize, 0,
 					       futex_hashsize < 256 ? HASH_SMALL : 0,
@@ -3564,13 +3780,7 @@ static int __init futex_init(void)
 					       futex_hashsize, futex_hashsize);
 	futex_hashsize = 1UL << futex_shift;
 
-	futex_detect_cmpxchg();
-
-	for (i = 0; i < futex_hashsize; i++) {
-		atomic_set(&futex_queues[i].waiters, 0);
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	futex_init_buckets(futex_queues);
 
 	return 0;
 }
@@ -19,6 +19,7 @@
 #include <linux/osq_lock.h>
 
 #include "rwsem.h"
+#include "lock_events.h"
 
 /*
  * Guide to the rw_semaphore's count field for common values.
@@ -87,6 +88,7 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	INIT_LIST_HEAD(&sem->wait_list);
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	sem->owner = NULL;
+	sem->handoff = 0;
 	osq_lock_init(&sem->osq);
 #endif
 }
@@ -102,8 +104,17 @@ struct rwsem_waiter {
 	struct list_head list;
 	struct task_struct *task;
 	enum rwsem_waiter_type type;
+	unsigned long timeout;
 };
 
+/*
+ * The minimum time a waiter at the head of the queue has to wait before
+ * it asks for a handoff, i.e. forbids optimistic spinners from stealing
+ * the lock ahead of it. This bounds the writer (or reader) starvation
+ * that lock stealing can otherwise cause.
+ */
+#define RWSEM_WAIT_TIMEOUT	DIV_ROUND_UP(HZ, 250)
+
 enum rwsem_wake_type {
 	RWSEM_WAKE_ANY,		/* Wake whatever's at head of wait list */
 	RWSEM_WAKE_READERS,	/* Wake readers only */
@@ -146,6 +157,7 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 			 * will notice the queued writer.
 			 */
 			wake_q_add(wake_q, waiter->task);
+			lockevent_inc(rwsem_wake_writer);
 		}
 
 		return;
@@ -168,8 +180,17 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 			 * reader grant.
 			 */
 			if (atomic_long_add_return(-adjustment, &sem->count) <
-			    RWSEM_WAITING_BIAS)
+			    RWSEM_WAITING_BIAS) {
+				/*
+				 * Don't let spinning writers beat the head
+				 * reader to the lock forever.
+				 */
+				if (time_after(jiffies, waiter->timeout) &&
+				    rwsem_set_handoff(sem)) {
+					lockevent_inc(rwsem_rlock_handoff);
+				}
 				return;
+			}
 
 			/* Last active locker left. Retry waking readers. */
 			goto try_reader_grant;
@@ -180,6 +201,7 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 		 * readers now have the lock.
 		 */
 		rwsem_set_reader_owned(sem);
+		rwsem_clear_handoff(sem);
 	}
 
 	/*
@@ -196,6 +218,7 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 
 		woken++;
 		tsk = waiter->task;
+		lockevent_inc(rwsem_wake_reader);
 
 		wake_q_add(wake_q, tsk);
 		list_del(&waiter->list);
@@ -218,6 +241,9 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 		atomic_long_add(adjustment, &sem->count);
 }
 
+static bool rwsem_reader_can_spin(struct rw_semaphore *sem);
+static bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool wlock);
+
 /*
  * Wait for the read lock to be granted
  */
@@ -226,13 +252,28 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 {
 	long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
 	struct rwsem_waiter waiter;
+	bool first;
 	DEFINE_WAKE_Q(wake_q);
 
+	/*
+	 * If a running writer holds the lock, it is likely to release it
+	 * soon: drop the bias added by down_read() and spin for the lock
+	 * instead of going to sleep.
+	 */
+	if (rwsem_reader_can_spin(sem)) {
+		atomic_long_add(-RWSEM_ACTIVE_READ_BIAS, &sem->count);
+		adjustment = 0;
+		if (rwsem_optimistic_spin(sem, false))
+			return sem;
+	}
+
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_READ;
+	waiter.timeout = jiffies + RWSEM_WAIT_TIMEOUT;
 
 	raw_spin_lock_irq(&sem->wait_lock);
-	if (list_empty(&sem->wait_list))
+	first = list_empty(&sem->wait_list);
+	if (first)
 		adjustment += RWSEM_WAITING_BIAS;
 	list_add_tail(&waiter.list, &sem->wait_list);
 
@@ -246,8 +287,7 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 	 * wake our own waiter to join the existing active readers !
 	 */
 	if (count == RWSEM_WAITING_BIAS ||
-	    (count > RWSEM_WAITING_BIAS &&
-	     adjustment != -RWSEM_ACTIVE_READ_BIAS))
+	    (count > RWSEM_WAITING_BIAS && first))
 		__rwsem_mark_wake(sem, RWSEM_WAKE_ANY, &wake_q);
 
 	raw_spin_unlock_irq(&sem->wait_lock);
@@ -266,6 +306,7 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 			break;
 		}
 		schedule();
+		lockevent_inc(rwsem_sleep_reader);
 	}
 
 	__set_current_state(TASK_RUNNING);
@@ -317,6 +358,7 @@ static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem)
 	if (atomic_long_cmpxchg_acquire(&sem->count, RWSEM_WAITING_BIAS, count)
 							== RWSEM_WAITING_BIAS) {
 		rwsem_set_owner(sem);
+		rwsem_clear_handoff(sem);
 		return true;
 	}
 
@@ -332,6 +374,13 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 	long old, count = atomic_long_read(&sem->count);
 
 	while (true) {
+		/*
+		 * Only steal the lock from the waiters if none of them has
+		 * asked for a handoff.
+		 */
+		if (count == RWSEM_WAITING_BIAS && READ_ONCE(sem->handoff))
+			return false;
+
 		if (!(count == 0 || count == RWSEM_WAITING_BIAS))
 			return false;
 
@@ -346,6 +395,29 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 	}
 }
 
+/*
+ * Try to acquire read lock before the reader has been put on wait queue.
+ * Readers never jump ahead of queued waiters: the lock is only taken
+ * while there are no waiters and no writer, i.e. while count >= 0.
+ */
+static inline bool rwsem_try_read_lock_unqueued(struct rw_semaphore *sem)
+{
+	long old, count = atomic_long_read(&sem->count);
+
+	while (count >= 0) {
+		old = atomic_long_cmpxchg_acquire(&sem->count, count,
+				      count + RWSEM_ACTIVE_READ_BIAS);
+		if (old == count) {
+			rwsem_set_reader_owned(sem);
+			return true;
+		}
+
+		count = old;
+	}
+
+	return false;
+}
+
 static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 {
 	struct task_struct *owner;
@@ -374,6 +446,19 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 	return ret;
 }
 
+/*
+ * Readers only spin when a writer owns the lock: a reader owned rwsem
+ * that a reader failed to join has waiters queued, and we can't tell
+ * whether its readers are running anyway.
+ */
+static bool rwsem_reader_can_spin(struct rw_semaphore *sem)
+{
+	if (!rwsem_owner_is_writer(READ_ONCE(sem->owner)))
+		return false;
+
+	return rwsem_can_spin_on_owner(sem);
+}
+
 /*
  * Return true only if we can still spin on the owner field of the rwsem.
  */
@@ -415,7 +500,7 @@ static noinline bool rwsem_spin_on_owner(struct rw_semaphore *sem)
 	return !rwsem_owner_is_reader(READ_ONCE(sem->owner));
 }
 
-static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
+static bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool wlock)
 {
 	bool taken = false;
 
@@ -439,7 +524,8 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 		/*
 		 * Try to acquire the lock
 		 */
-		if (rwsem_try_write_lock_unqueued(sem)) {
+		if (wlock ? rwsem_try_write_lock_unqueued(sem) :
+			    rwsem_try_read_lock_unqueued(sem)) {
 			taken = true;
 			break;
 		}
@@ -461,7 +547,24 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 		 */
 		cpu_relax();
 	}
+
+	/*
+	 * Spinning stops once readers own the lock, which a reader may
+	 * still be able to join.
+	 */
+	if (!taken && !wlock)
+		taken = rwsem_try_read_lock_unqueued(sem);
+
 	osq_unlock(&sem->osq);
+
+	if (taken) {
+		if (wlock)
+			lockevent_inc(rwsem_opt_wlock);
+		else
+			lockevent_inc(rwsem_opt_rlock);
+	} else {
+		lockevent_inc(rwsem_opt_fail);
+	}
 done:
 	preempt_enable();
 	return taken;
@@ -476,7 +579,12 @@ static inline bool rwsem_has_spinner(struct rw_semaphore *sem)
 }
 
 #else
-static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
+static bool rwsem_reader_can_spin(struct rw_semaphore *sem)
+{
+	return false;
+}
+
+static bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool wlock)
 {
 	return false;
 }
@@ -495,6 +603,7 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 {
 	long count;
 	bool waiting = true; /* any queued threads before us */
+	bool handoff = false;
 	struct rwsem_waiter waiter;
 	struct rw_semaphore *ret = sem;
 	DEFINE_WAKE_Q(wake_q);
@@ -503,7 +612,7 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	count = atomic_long_sub_return(RWSEM_ACTIVE_WRITE_BIAS, &sem->count);
 
 	/* do optimistic spinning and steal lock if possible */
-	if (rwsem_optimistic_spin(sem))
+	if (rwsem_optimistic_spin(sem, true))
 		return sem;
 
 	/*
@@ -512,6 +621,7 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	 */
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_WRITE;
+	waiter.timeout = jiffies + RWSEM_WAIT_TIMEOUT;
 
 	raw_spin_lock_irq(&sem->wait_lock);
 
@@ -555,6 +665,19 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	while (true) {
 		if (rwsem_try_write_lock(count, sem))
 			break;
+
+		/*
+		 * Once the writer at the head of the queue has waited long
+		 * enough, stop the spinners from stealing the lock from it.
+		 */
+		if (!handoff && time_after(jiffies, waiter.timeout) &&
+		    list_first_entry(&sem->wait_list, struct rwsem_waiter,
+				     list) == &waiter) {
+			handoff = true;
+			if (rwsem_set_handoff(sem)) {
+				lockevent_inc(rwsem_wlock_handoff);
+			}
+		}
 		raw_spin_unlock_irq(&sem->wait_lock);
 
 		/* Block until there are no active lockers. */
@@ -563,6 +686,7 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 				goto out_nolock;
 
 			schedule();
+			lockevent_inc(rwsem_sleep_writer);
 			set_current_state(state);
 		} while ((count = atomic_long_read(&sem->count)) & RWSEM_ACTIVE_MASK);
 
@@ -578,6 +702,8 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	__set_current_state(TASK_RUNNING);
 	raw_spin_lock_irq(&sem->wait_lock);
 	list_del(&waiter.list);
+	if (handoff)
+		rwsem_clear_handoff(sem);
 	if (list_empty(&sem->wait_list))
 		atomic_long_add(-RWSEM_WAITING_BIAS, &sem->count);
 	else
@@ -53,6 +53,24 @@ static inline bool rwsem_owner_is_reader(struct task_struct *owner)
 {
 	return owner == RWSEM_READER_OWNED;
 }
+
+/*
+ * Returns true if the handoff was not requested yet.
+ */
+static inline bool rwsem_set_handoff(struct rw_semaphore *sem)
+{
+	if (sem->handoff)
+		return false;
+
+	WRITE_ONCE(sem->handoff, 1);
+	return true;
+}
+
+static inline void rwsem_clear_handoff(struct rw_semaphore *sem)
+{
+	if (sem->handoff)
+		WRITE_ONCE(sem->handoff, 0);
+}
 #else
 static inline void rwsem_set_owner(struct rw_semaphore *sem)
 {
@@ -65,4 +83,13 @@ static inline void rwsem_clear_owner(struct rw_semaphore *sem)
 static inline void rwsem_set_reader_owned(struct rw_semaphore *sem)
 {
 }
+
+static inline bool rwsem_set_handoff(struct rw_semaphore *sem)
+{
+	return false;
+}
+
+static inline void rwsem_clear_handoff(struct rw_semaphore *sem)
+{
+}
 #endif
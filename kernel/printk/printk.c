@@ -42,6 +42,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
@@ -1204,6 +1205,14 @@ static inline void boot_delay_msec(int level)
 static bool printk_time = IS_ENABLED(CONFIG_PRINTK_TIME);
 module_param_named(time, printk_time, bool, S_IRUGO | S_IWUSR);
 
+/*
+ * Hand console output to the printk kthread instead of printing from the
+ * context that called printk().  Slow consoles then no longer stall the
+ * caller; oopses, panics and shutdown still print synchronously.
+ */
+static bool printk_offload = true;
+module_param_named(offload, printk_offload, bool, S_IRUGO | S_IWUSR);
+
 static size_t print_time(u64 ts, char *buf)
 {
 	unsigned long rem_nsec;
@@ -1680,6 +1689,20 @@ static size_t log_output(int facility, int level, enum log_flags lflags, const c
 	return log_store(facility, level, lflags, 0, dict, dictlen, text, text_len);
 }
 
+static struct task_struct *printk_kthread;
+static void defer_console_output(void);
+
+/*
+ * Console output can be left to the printk kthread unless it is not
+ * running yet, or the system is in a state where the messages must
+ * reach the console before the caller continues.
+ */
+static bool printk_may_offload(void)
+{
+	return printk_offload && READ_ONCE(printk_kthread) &&
+	       !oops_in_progress && system_state == SYSTEM_RUNNING;
+}
+
 asmlinkage int vprintk_emit(int facility, int level,
 			    const char *dict, size_t dictlen,
 			    const char *fmt, va_list args)
@@ -1748,6 +1771,10 @@ asmlinkage int vprintk_emit(int facility, int level,
 
 	/* If called from the scheduler, we can not call up(). */
 	if (!in_sched) {
+		if (printk_may_offload()) {
+			defer_console_output();
+			return printed_len;
+		}
 		/*
 		 * Try to acquire and then immediately release the console
 		 * semaphore.  The release will print out buffers and wake up
@@ -2684,14 +2711,17 @@ late_initcall(printk_late_init);
 #define PRINTK_PENDING_OUTPUT	0x02
 
 static DEFINE_PER_CPU(int, printk_pending);
+static DECLARE_WAIT_QUEUE_HEAD(printk_kthread_wait);
 
 static void wake_up_klogd_work_func(struct irq_work *irq_work)
 {
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
+		if (printk_may_offload())
+			wake_up_interruptible(&printk_kthread_wait);
 		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
+		else if (console_trylock())
 			console_unlock();
 	}
 
@@ -2714,20 +2744,71 @@ void wake_up_klogd(void)
 	preempt_enable();
 }
 
-int vprintk_deferred(const char *fmt, va_list args)
+static void defer_console_output(void)
 {
-	int r;
-
-	r = vprintk_emit(0, LOGLEVEL_SCHED, NULL, 0, fmt, args);
-
 	preempt_disable();
 	__this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
 	irq_work_queue(this_cpu_ptr(&wake_up_klogd_work));
 	preempt_enable();
+}
+
+int vprintk_deferred(const char *fmt, va_list args)
+{
+	int r;
+
+	r = vprintk_emit(0, LOGLEVEL_SCHED, NULL, 0, fmt, args);
+	defer_console_output();
 
 	return r;
 }
 
+static bool console_output_pending(void)
+{
+	unsigned long flags;
+	bool pending;
+
+	logbuf_lock_irqsave(flags);
+	pending = console_seq != log_next_seq;
+	logbuf_unlock_irqrestore(flags);
+
+	return pending;
+}
+
+/*
+ * The printk kthread flushes the log buffer to the consoles.  It takes
+ * console_sem with console_lock(), so console_unlock() may reschedule
+ * between records and slow consoles only delay this thread.
+ */
+static int printk_kthread_func(void *data)
+{
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(printk_kthread_wait,
+					 console_output_pending() ||
+					 kthread_should_stop());
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *tsk;
+
+	tsk = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(tsk)) {
+		pr_err("printk: unable to create printing thread\n");
+		return PTR_ERR(tsk);
+	}
+	WRITE_ONCE(printk_kthread, tsk);
+
+	/* Pick up whatever was logged while printing synchronously. */
+	wake_up_interruptible(&printk_kthread_wait);
+	return 0;
+}
+early_initcall(printk_kthread_init);
+
 int printk_deferred(const char *fmt, ...)
 {
 	va_list args;
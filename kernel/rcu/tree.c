@@ -58,6 +58,8 @@
 #include <linux/trace_events.h>
 #include <linux/suspend.h>
 #include <linux/ftrace.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include "tree.h"
 #include "rcu.h"
@@ -3142,19 +3144,281 @@ void call_rcu_bh(struct rcu_head *head, rcu_callback_t func)
 EXPORT_SYMBOL_GPL(call_rcu_bh);
 
 /*
- * Queue an RCU callback for lazy invocation after a grace period.
- * This will likely be later named something like "call_rcu_lazy()",
- * but this change will require some way of tagging the lazy RCU
- * callbacks in the list of pending callbacks. Until then, this
- * function may only be called from __kfree_rcu().
+ * kfree_rcu() batching.  Rather than queueing one callback per object,
+ * kfree_call_rcu() stores the pointer in a per-CPU page-sized array.
+ * After KFREE_DRAIN_JIFFIES the arrays are detached and handed to one
+ * of KFREE_N_BATCHES in-flight batches, which waits for a single grace
+ * period and then releases the whole lot with kfree_bulk() from a
+ * workqueue.  If no page can be had without sleeping, the object falls
+ * back to being chained through its own rcu_head.
+ */
+#define KFREE_DRAIN_JIFFIES	(HZ / 50)
+#define KFREE_N_BATCHES		2
+
+struct kfree_rcu_bulk_data {
+	unsigned long nr_records;
+	struct kfree_rcu_bulk_data *next;
+	void *records[];
+};
+
+#define KFREE_BULK_MAX_ENTR \
+	((PAGE_SIZE - sizeof(struct kfree_rcu_bulk_data)) / sizeof(void *))
+
+/*
+ * A batch of objects waiting for a grace period: @head_free is the
+ * fallback list and @bhead_free the chain of pointer arrays.
+ */
+struct kfree_rcu_cpu_work {
+	struct rcu_head rcu;
+	struct work_struct work;
+	struct rcu_head *head_free;
+	struct kfree_rcu_bulk_data *bhead_free;
+	struct kfree_rcu_cpu *krcp;
+};
+
+/*
+ * Per-CPU state: @head and @bhead collect objects until the monitor
+ * drains them into a free batch of @krw_arr, @bcached keeps one spare
+ * page so that a steady stream of kfree_rcu() doesn't hit the page
+ * allocator at every drain.
+ */
+struct kfree_rcu_cpu {
+	struct rcu_head *head;
+	struct kfree_rcu_bulk_data *bhead;
+	struct kfree_rcu_bulk_data *bcached;
+	struct kfree_rcu_cpu_work krw_arr[KFREE_N_BATCHES];
+	spinlock_t lock;
+	struct delayed_work monitor_work;
+	bool monitor_todo;
+	bool initialized;
+};
+
+static DEFINE_PER_CPU(struct kfree_rcu_cpu, krc);
+
+/*
+ * Invoked from a workqueue after a grace period has elapsed: free every
+ * object of the batch, returning one of the emptied pages to the cache.
  */
-void kfree_call_rcu(struct rcu_head *head,
-		    rcu_callback_t func)
+static void kfree_rcu_work(struct work_struct *work)
 {
-	__call_rcu(head, func, rcu_state_p, -1, 1);
+	unsigned long flags;
+	struct rcu_head *head, *next;
+	struct kfree_rcu_bulk_data *bhead, *bnext;
+	struct kfree_rcu_cpu *krcp;
+	struct kfree_rcu_cpu_work *krwp;
+
+	krwp = container_of(work, struct kfree_rcu_cpu_work, work);
+	krcp = krwp->krcp;
+	spin_lock_irqsave(&krcp->lock, flags);
+	head = krwp->head_free;
+	krwp->head_free = NULL;
+	bhead = krwp->bhead_free;
+	krwp->bhead_free = NULL;
+	spin_unlock_irqrestore(&krcp->lock, flags);
+
+	/* The batch is now private, so traverse it locklessly. */
+	for (; bhead; bhead = bnext) {
+		bnext = bhead->next;
+
+		rcu_lock_acquire(&rcu_callback_map);
+		kfree_bulk(bhead->nr_records, bhead->records);
+		rcu_lock_release(&rcu_callback_map);
+
+		if (cmpxchg(&krcp->bcached, NULL, bhead))
+			free_page((unsigned long)bhead);
+
+		cond_resched_rcu_qs();
+	}
+
+	for (; head; head = next) {
+		unsigned long offset = (unsigned long)head->func;
+
+		next = head->next;
+		debug_rcu_head_unqueue(head);
+		rcu_lock_acquire(&rcu_callback_map);
+		trace_rcu_invoke_kfree_callback(rcu_state_p->name, head, offset);
+
+		if (!WARN_ON_ONCE(!__is_kfree_rcu_offset(offset)))
+			kfree((void *)head - offset);
+
+		rcu_lock_release(&rcu_callback_map);
+		cond_resched_rcu_qs();
+	}
+}
+
+/* The grace period is over; free from process context. */
+static void kfree_rcu_work_gp(struct rcu_head *rcu)
+{
+	struct kfree_rcu_cpu_work *krwp =
+		container_of(rcu, struct kfree_rcu_cpu_work, rcu);
+
+	queue_work(system_wq, &krwp->work);
+}
+
+/*
+ * Hand the objects collected so far to a batch that is not already
+ * waiting for a grace period.  Returns false if every batch is busy, in
+ * which case the caller retries later.
+ */
+static inline bool queue_kfree_rcu_work(struct kfree_rcu_cpu *krcp)
+{
+	struct kfree_rcu_cpu_work *krwp;
+	int i;
+
+	lockdep_assert_held(&krcp->lock);
+
+	for (i = 0; i < KFREE_N_BATCHES; i++) {
+		krwp = &krcp->krw_arr[i];
+
+		if (krwp->head_free || krwp->bhead_free)
+			continue;
+
+		krwp->head_free = krcp->head;
+		krcp->head = NULL;
+		krwp->bhead_free = krcp->bhead;
+		krcp->bhead = NULL;
+
+		call_rcu(&krwp->rcu, kfree_rcu_work_gp);
+		return true;
+	}
+
+	return false;
+}
+
+static inline void kfree_rcu_drain_unlock(struct kfree_rcu_cpu *krcp,
+					  unsigned long flags)
+{
+	/* Attempt to start a new batch. */
+	krcp->monitor_todo = false;
+	if (queue_kfree_rcu_work(krcp)) {
+		/* Success! Our job is done here. */
+		spin_unlock_irqrestore(&krcp->lock, flags);
+		return;
+	}
+
+	/* Previous batches still in progress, try again later. */
+	krcp->monitor_todo = true;
+	schedule_delayed_work(&krcp->monitor_work, KFREE_DRAIN_JIFFIES);
+	spin_unlock_irqrestore(&krcp->lock, flags);
+}
+
+/*
+ * This function is invoked after KFREE_DRAIN_JIFFIES timeout to drain
+ * the objects queued on this CPU into a batch.
+ */
+static void kfree_rcu_monitor(struct work_struct *work)
+{
+	unsigned long flags;
+	struct kfree_rcu_cpu *krcp = container_of(work, struct kfree_rcu_cpu,
+						  monitor_work.work);
+
+	spin_lock_irqsave(&krcp->lock, flags);
+	if (krcp->monitor_todo)
+		kfree_rcu_drain_unlock(krcp, flags);
+	else
+		spin_unlock_irqrestore(&krcp->lock, flags);
+}
+
+static inline bool
+kfree_call_rcu_add_ptr_to_bulk(struct kfree_rcu_cpu *krcp, void *ptr)
+{
+	struct kfree_rcu_bulk_data *bnode;
+
+	/* SLOB can't kfree_bulk() without knowing the cache. */
+	if (IS_ENABLED(CONFIG_SLOB) || unlikely(!krcp->initialized))
+		return false;
+
+	lockdep_assert_held(&krcp->lock);
+
+	/* Check if a new block is required. */
+	if (!krcp->bhead || krcp->bhead->nr_records == KFREE_BULK_MAX_ENTR) {
+		bnode = xchg(&krcp->bcached, NULL);
+		if (!bnode)
+			bnode = (struct kfree_rcu_bulk_data *)
+				__get_free_page(GFP_NOWAIT | __GFP_NOWARN);
+
+		/* No memory, fall back to the rcu_head list. */
+		if (unlikely(!bnode))
+			return false;
+
+		bnode->nr_records = 0;
+		bnode->next = krcp->bhead;
+		krcp->bhead = bnode;
+	}
+
+	krcp->bhead->records[krcp->bhead->nr_records++] = ptr;
+	return true;
+}
+
+/*
+ * Queue a request for lazy invocation of kfree() after a grace period.
+ *
+ * Each kfree_call_rcu() request is added to a per-CPU batch, which is
+ * drained after KFREE_DRAIN_JIFFIES or once a previous batch has been
+ * released.  This function may only be called from __kfree_rcu().
+ */
+void kfree_call_rcu(struct rcu_head *head, rcu_callback_t func)
+{
+	unsigned long flags;
+	struct kfree_rcu_cpu *krcp;
+	void *ptr = (void *)head - (unsigned long)func;
+
+	local_irq_save(flags);	/* For safely calling this_cpu_ptr(). */
+	krcp = this_cpu_ptr(&krc);
+	if (krcp->initialized)
+		spin_lock(&krcp->lock);
+
+	/*
+	 * Once in a bulk array the rcu_head is not used any more, so only
+	 * the fallback list is tracked by debug-objects.
+	 */
+	if (unlikely(!kfree_call_rcu_add_ptr_to_bulk(krcp, ptr))) {
+		if (debug_rcu_head_queue(head)) {
+			/* Probable double kfree_rcu(), just leak. */
+			WARN_ONCE(1, "%s(): Double-freed call. rcu_head %p\n",
+				  __func__, head);
+			goto unlock_return;
+		}
+		head->func = func;
+		head->next = krcp->head;
+		krcp->head = head;
+	}
+
+	/*
+	 * Set timer to drain after KFREE_DRAIN_JIFFIES.  Objects queued
+	 * before timers are up go out with the first later batch.
+	 */
+	if (rcu_scheduler_active != RCU_SCHEDULER_INACTIVE &&
+	    krcp->initialized && !krcp->monitor_todo) {
+		krcp->monitor_todo = true;
+		schedule_delayed_work(&krcp->monitor_work, KFREE_DRAIN_JIFFIES);
+	}
+
+unlock_return:
+	if (krcp->initialized)
+		spin_unlock(&krcp->lock);
+	local_irq_restore(flags);
 }
 EXPORT_SYMBOL_GPL(kfree_call_rcu);
 
+static void __init kfree_rcu_batch_init(void)
+{
+	int cpu;
+	int i;
+
+	for_each_possible_cpu(cpu) {
+		struct kfree_rcu_cpu *krcp = per_cpu_ptr(&krc, cpu);
+
+		spin_lock_init(&krcp->lock);
+		for (i = 0; i < KFREE_N_BATCHES; i++) {
+			INIT_WORK(&krcp->krw_arr[i].work, kfree_rcu_work);
+			krcp->krw_arr[i].krcp = krcp;
+		}
+		INIT_DELAYED_WORK(&krcp->monitor_work, kfree_rcu_monitor);
+		krcp->initialized = true;
+	}
+}
+
 /*
  * Because a context switch is a grace period for RCU-sched and RCU-bh,
  * any blocking grace-period wait automatically implies a grace period
@@ -4184,6 +4448,7 @@ void __init rcu_init(void)
 
 	rcu_bootup_announce();
 	rcu_init_geometry();
+	kfree_rcu_batch_init();
 	rcu_init_one(&rcu_bh_state);
 	rcu_init_one(&rcu_sched_state);
 	if (dump_tree)
@@ -908,6 +908,12 @@ static void sched_show_numa(struct task_struct *p, struct seq_file *m)
 	task_unlock(p);
 
 	P(numa_pages_migrated);
+	P(numa_migrate_failed);
+	P(numa_hint_faults);
+	P(numa_pte_updates);
+	P(numa_vmas_skipped);
+	P(numa_tlb_flushes);
+	P(numa_scan_sample_shift);
 	P(numa_preferred_nid);
 	P(total_numa_faults);
 	SEQ_printf(m, "current_node=%d, numa_group_id=%d\n",
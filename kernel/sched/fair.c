@@ -33,6 +33,8 @@
 #include <linux/migrate.h>
 #include <linux/task_work.h>
 
+#include <asm/tlbflush.h>
+
 #include <trace/events/sched.h>
 
 #include "sched.h"
@@ -851,7 +853,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		struct task_struct *curtask = task_of(curr);
 
 		trace_sched_stat_runtime(curtask, delta_exec, curr->vruntime);
-		cpuacct_charge(curtask, delta_exec);
+		cgroup_account_cputime(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
 	}
 
@@ -1058,6 +1060,9 @@ unsigned int sysctl_numa_balancing_scan_size = 256;
 /* Scan @scan_size MB every @scan_period after an initial @scan_delay in ms */
 unsigned int sysctl_numa_balancing_scan_delay = 1000;
 
+/* Only mark a sample of each scan window for hinting faults */
+unsigned int sysctl_numa_balancing_sampled;
+
 struct numa_group {
 	atomic_t refcount;
 
@@ -1936,6 +1941,39 @@ static void numa_group_count_active_nodes(struct numa_group *numa_group)
  * the page accesses are shared with other processes.
  * Otherwise, decrease the scan period.
  */
+/*
+ * Sampled scanning marks one in up to 1 << NUMA_SCAN_SAMPLE_SHIFT_MAX
+ * chunks.  The sample gets denser while at least 1/NUMA_SAMPLE_DENSE of
+ * the hinting faults migrate a page and sparser once fewer than
+ * 1/NUMA_SAMPLE_SPARSE do or migrations fail.
+ */
+#define NUMA_SCAN_SAMPLE_SHIFT_MAX	4
+#define NUMA_SAMPLE_DENSE		8
+#define NUMA_SAMPLE_SPARSE		64
+
+static void update_task_scan_sample(struct task_struct *p)
+{
+	unsigned long faults = p->numa_faults_locality[0] +
+			       p->numa_faults_locality[1];
+	unsigned long migrated = p->numa_pages_migrated -
+				 p->numa_sample_migrated;
+	unsigned long failed = p->numa_faults_locality[2];
+
+	p->numa_sample_migrated = p->numa_pages_migrated;
+
+	if (!sysctl_numa_balancing_sampled)
+		return;
+
+	if (faults && !failed && migrated * NUMA_SAMPLE_DENSE >= faults) {
+		if (p->numa_scan_sample_shift)
+			p->numa_scan_sample_shift--;
+	} else if (!faults || failed ||
+		   migrated * NUMA_SAMPLE_SPARSE < faults) {
+		if (p->numa_scan_sample_shift < NUMA_SCAN_SAMPLE_SHIFT_MAX)
+			p->numa_scan_sample_shift++;
+	}
+}
+
 static void update_task_scan_period(struct task_struct *p,
 			unsigned long shared, unsigned long private)
 {
@@ -1946,6 +1984,8 @@ static void update_task_scan_period(struct task_struct *p,
 	unsigned long remote = p->numa_faults_locality[0];
 	unsigned long local = p->numa_faults_locality[1];
 
+	update_task_scan_sample(p);
+
 	/*
 	 * If there were no record hinting faults then either the task is
 	 * completely idle or all activity is areas that are not of interest
@@ -2442,8 +2482,11 @@ void task_numa_fault(int last_cpupid, int mem_node, int pages, int flags)
 
 	if (migrated)
 		p->numa_pages_migrated += pages;
-	if (flags & TNF_MIGRATE_FAIL)
+	if (flags & TNF_MIGRATE_FAIL) {
 		p->numa_faults_locality[2] += pages;
+		p->numa_migrate_failed += pages;
+	}
+	p->numa_hint_faults += pages;
 
 	p->numa_faults[task_faults_idx(NUMA_MEMBUF, mem_node, priv)] += pages;
 	p->numa_faults[task_faults_idx(NUMA_CPUBUF, cpu_node, priv)] += pages;
@@ -2464,6 +2507,56 @@ static void reset_ptenuma_scan(struct task_struct *p)
 	p->mm->numa_scan_offset = 0;
 }
 
+/*
+ * In sampled mode, VMAs whose hinting faults stopped migrating pages for
+ * NUMA_VMA_STABLE_PASSES scan passes are considered to have a stable
+ * placement.  They are skipped on all but one in NUMA_VMA_RESCAN_PASSES
+ * passes so that a change in placement is still noticed.
+ */
+#define NUMA_VMA_STABLE_PASSES	4
+#define NUMA_VMA_RESCAN_PASSES	8
+
+static bool task_numa_skip_vma(struct mm_struct *mm,
+			       struct vm_area_struct *vma, unsigned long start)
+{
+	/* Only decide when a scan pass enters @vma from its start */
+	if (start > vma->vm_start)
+		return false;
+
+	/*
+	 * Racy against hinting faults updating vm_numa_migrated under the
+	 * read side of mmap_sem, which is fine for a heuristic.
+	 */
+	if (vma->vm_numa_migrated)
+		vma->vm_numa_stable = 0;
+	else if (vma->vm_numa_stable < NUMA_VMA_STABLE_PASSES)
+		vma->vm_numa_stable++;
+	vma->vm_numa_migrated = 0;
+
+	return vma->vm_numa_stable >= NUMA_VMA_STABLE_PASSES &&
+	       READ_ONCE(mm->numa_scan_seq) % NUMA_VMA_RESCAN_PASSES;
+}
+
+/* Rotate the sampled chunks with the scan sequence to cover the whole VMA */
+static inline bool task_numa_chunk_sampled(struct mm_struct *mm,
+					   unsigned long addr,
+					   unsigned int shift)
+{
+	unsigned long chunk = addr / HPAGE_SIZE + READ_ONCE(mm->numa_scan_seq);
+
+	return !(chunk & ((1UL << shift) - 1));
+}
+
+static void task_numa_flush_tlb(struct task_struct *p,
+				struct vm_area_struct *vma,
+				unsigned long start, unsigned long end)
+{
+	if (start < end) {
+		flush_tlb_range(vma, start, end);
+		p->numa_tlb_flushes++;
+	}
+}
+
 /*
  * The expensive part of numa migration is done from task_work context.
  * Triggered from task_tick_numa().
@@ -2476,8 +2569,11 @@ void task_numa_work(struct callback_head *work)
 	u64 runtime = p->se.sum_exec_runtime;
 	struct vm_area_struct *vma;
 	unsigned long start, end;
+	unsigned long flush_start, flush_end;
 	unsigned long nr_pte_updates = 0;
 	long pages, virtpages;
+	bool sampled;
+	unsigned int shift;
 
 	SCHED_WARN_ON(p != container_of(work, struct task_struct, numa_work));
 
@@ -2528,6 +2624,9 @@ void task_numa_work(struct callback_head *work)
 		return;
 
 
+	sampled = READ_ONCE(sysctl_numa_balancing_sampled);
+	shift = sampled ? p->numa_scan_sample_shift : 0;
+
 	if (!down_read_trylock(&mm->mmap_sem))
 		return;
 	vma = find_vma(mm, start);
@@ -2536,6 +2635,13 @@ void task_numa_work(struct callback_head *work)
 		start = 0;
 		vma = mm->mmap;
 	}
+
+	/*
+	 * The PTE updates are flushed from the TLB once per VMA rather than
+	 * once per chunk, keep the mm marked as having a flush pending.
+	 */
+	inc_tlb_flush_pending(mm);
+
 	for (; vma; vma = vma->vm_next) {
 		if (!vma_migratable(vma) || !vma_policy_mof(vma) ||
 			is_vm_hugetlb_page(vma) || (vma->vm_flags & VM_MIXEDMAP)) {
@@ -2559,11 +2665,26 @@ void task_numa_work(struct callback_head *work)
 		if (!(vma->vm_flags & (VM_READ | VM_EXEC | VM_WRITE)))
 			continue;
 
+		if (sampled && task_numa_skip_vma(mm, vma, start)) {
+			p->numa_vmas_skipped++;
+			continue;
+		}
+
+		flush_start = ULONG_MAX;
+		flush_end = 0;
 		do {
 			start = max(start, vma->vm_start);
-			end = ALIGN(start + (pages << PAGE_SHIFT), HPAGE_SIZE);
+			if (shift)
+				end = ALIGN(start + 1, HPAGE_SIZE);
+			else
+				end = ALIGN(start + (pages << PAGE_SHIFT),
+					    HPAGE_SIZE);
 			end = min(end, vma->vm_end);
-			nr_pte_updates = change_prot_numa(vma, start, end);
+
+			nr_pte_updates = 0;
+			if (!shift || task_numa_chunk_sampled(mm, start, shift))
+				nr_pte_updates = change_prot_numa_noflush(vma,
+								start, end);
 
 			/*
 			 * Try to scan sysctl_numa_balancing_size worth of
@@ -2571,21 +2692,33 @@ void task_numa_work(struct callback_head *work)
 			 * is not already pte-numa. If the VMA contains
 			 * areas that are unused or already full of prot_numa
 			 * PTEs, scan up to virtpages, to skip through those
-			 * areas faster.
+			 * areas faster.  A sampled chunk stands for the
+			 * 1 << shift chunks it was picked from.
 			 */
-			if (nr_pte_updates)
-				pages -= (end - start) >> PAGE_SHIFT;
+			if (nr_pte_updates) {
+				pages -= ((end - start) >> PAGE_SHIFT) << shift;
+				p->numa_pte_updates += nr_pte_updates;
+				flush_start = min(flush_start, start);
+				flush_end = end;
+			}
 			virtpages -= (end - start) >> PAGE_SHIFT;
 
 			start = end;
-			if (pages <= 0 || virtpages <= 0)
+			if (pages <= 0 || virtpages <= 0) {
+				task_numa_flush_tlb(p, vma, flush_start,
+						    flush_end);
 				goto out;
+			}
 
 			cond_resched();
 		} while (end != vma->vm_end);
+
+		task_numa_flush_tlb(p, vma, flush_start, flush_end);
 	}
 
 out:
+	dec_tlb_flush_pending(mm);
+
 	/*
 	 * It is possible to reach the end of the VMA list but the last few
 	 * VMAs are not guaranteed to the vma_migratable. If they are not, we
@@ -4069,22 +4202,39 @@ static inline u64 sched_cfs_bandwidth_slice(void)
 }
 
 /*
- * Replenish runtime according to assigned quota and update expiration time.
- * We use sched_clock_cpu directly instead of rq->clock to avoid adding
- * additional synchronization around rq->lock.
+ * The slice a cfs_rq pulls from the global pool, capped by the group so
+ * that a small quota spread over many cpus is not soaked up by the first
+ * few of them.
+ */
+static inline u64 cfs_b_slice(struct cfs_bandwidth *cfs_b)
+{
+	return min(sched_cfs_bandwidth_slice(), READ_ONCE(cfs_b->slice));
+}
+
+/*
+ * Replenish runtime according to assigned quota. Runtime left unused in
+ * the previous period is carried over, up to cfs_b->burst on top of the
+ * quota; consuming more than the quota in a period is accounted as a
+ * burst.
  *
  * requires cfs_b->lock
  */
 void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b)
 {
-	u64 now;
+	s64 runtime;
 
 	if (cfs_b->quota == RUNTIME_INF)
 		return;
 
-	now = sched_clock_cpu(smp_processor_id());
-	cfs_b->runtime = cfs_b->quota;
-	cfs_b->runtime_expires = now + ktime_to_ns(cfs_b->period);
+	cfs_b->runtime += cfs_b->quota;
+	runtime = cfs_b->runtime_snap - cfs_b->runtime;
+	if (runtime > 0) {
+		cfs_b->burst_time += runtime;
+		cfs_b->nr_burst++;
+	}
+
+	cfs_b->runtime = min(cfs_b->runtime, cfs_b->quota + cfs_b->burst);
+	cfs_b->runtime_snap = cfs_b->runtime;
 }
 
 static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
@@ -4106,10 +4256,10 @@ static int assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 {
 	struct task_group *tg = cfs_rq->tg;
 	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(tg);
-	u64 amount = 0, min_amount, expires;
+	u64 amount = 0, min_amount;
 
 	/* note: this is a positive sum as runtime_remaining <= 0 */
-	min_amount = sched_cfs_bandwidth_slice() - cfs_rq->runtime_remaining;
+	min_amount = cfs_b_slice(cfs_b) - cfs_rq->runtime_remaining;
 
 	raw_spin_lock(&cfs_b->lock);
 	if (cfs_b->quota == RUNTIME_INF)
@@ -4123,61 +4273,21 @@ static int assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 			cfs_b->idle = 0;
 		}
 	}
-	expires = cfs_b->runtime_expires;
 	raw_spin_unlock(&cfs_b->lock);
 
 	cfs_rq->runtime_remaining += amount;
-	/*
-	 * we may have advanced our local expiration to account for allowed
-	 * spread between our sched_clock and the one on which runtime was
-	 * issued.
-	 */
-	if ((s64)(expires - cfs_rq->runtime_expires) > 0)
-		cfs_rq->runtime_expires = expires;
 
 	return cfs_rq->runtime_remaining > 0;
 }
 
-/*
- * Note: This depends on the synchronization provided by sched_clock and the
- * fact that rq->clock snapshots this value.
- */
-static void expire_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+static void __account_cfs_rq_runtime(struct cfs_rq *cfs_rq, u64 delta_exec)
 {
-	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
-
-	/* if the deadline is ahead of our clock, nothing to do */
-	if (likely((s64)(rq_clock(rq_of(cfs_rq)) - cfs_rq->runtime_expires) < 0))
-		return;
-
-	if (cfs_rq->runtime_remaining < 0)
-		return;
-
 	/*
-	 * If the local deadline has passed we have to consider the
-	 * possibility that our sched_clock is 'fast' and the global deadline
-	 * has not truly expired.
-	 *
-	 * Fortunately we can check determine whether this the case by checking
-	 * whether the global deadline has advanced. It is valid to compare
-	 * cfs_b->runtime_expires without any locks since we only care about
-	 * exact equality, so a partial write will still work.
+	 * Runtime handed to a cfs_rq does not expire at the period boundary:
+	 * it is bounded by the slice, and returning slack below is what
+	 * keeps it from being stranded on cpus that went idle.
 	 */
-
-	if (cfs_rq->runtime_expires != cfs_b->runtime_expires) {
-		/* extend local deadline, drift is bounded above by 2 ticks */
-		cfs_rq->runtime_expires += TICK_NSEC;
-	} else {
-		/* global deadline is ahead, expiration has passed */
-		cfs_rq->runtime_remaining = 0;
-	}
-}
-
-static void __account_cfs_rq_runtime(struct cfs_rq *cfs_rq, u64 delta_exec)
-{
-	/* dock delta_exec before expiring quota (as it could span periods) */
 	cfs_rq->runtime_remaining -= delta_exec;
-	expire_cfs_rq_runtime(cfs_rq);
 
 	if (likely(cfs_rq->runtime_remaining > 0))
 		return;
@@ -4310,6 +4420,16 @@ static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
 	raw_spin_unlock(&cfs_b->lock);
 }
 
+static inline int cfs_throttle_hist_bucket(u64 delta)
+{
+	u64 delta_ms = div_u64(delta, NSEC_PER_MSEC);
+
+	if (!delta_ms)
+		return 0;
+
+	return min(ilog2(delta_ms) + 1, CFS_THROTTLE_HIST_BUCKETS - 1);
+}
+
 void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 {
 	struct rq *rq = rq_of(cfs_rq);
@@ -4317,6 +4437,7 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 	struct sched_entity *se;
 	int enqueue = 1;
 	long task_delta;
+	u64 delta;
 
 	se = cfs_rq->tg->se[cpu_of(rq)];
 
@@ -4324,11 +4445,15 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 
 	update_rq_clock(rq);
 
+	delta = rq_clock(rq) - cfs_rq->throttled_clock;
 	raw_spin_lock(&cfs_b->lock);
-	cfs_b->throttled_time += rq_clock(rq) - cfs_rq->throttled_clock;
+	cfs_b->throttled_time += delta;
+	cfs_b->throttled_hist[cfs_throttle_hist_bucket(delta)]++;
 	list_del_rcu(&cfs_rq->throttled_list);
 	raw_spin_unlock(&cfs_b->lock);
 
+	sched_lat_hist_throttled(rq, cfs_rq->tg, delta);
+
 	/* update hierarchical throttle state */
 	walk_tg_tree_from(cfs_rq->tg, tg_nop, tg_unthrottle_up, (void *)rq);
 
@@ -4357,8 +4482,7 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 		resched_curr(rq);
 }
 
-static u64 distribute_cfs_runtime(struct cfs_bandwidth *cfs_b,
-		u64 remaining, u64 expires)
+static u64 distribute_cfs_runtime(struct cfs_bandwidth *cfs_b, u64 remaining)
 {
 	struct cfs_rq *cfs_rq;
 	u64 runtime;
@@ -4380,7 +4504,6 @@ static u64 distribute_cfs_runtime(struct cfs_bandwidth *cfs_b,
 		remaining -= runtime;
 
 		cfs_rq->runtime_remaining += runtime;
-		cfs_rq->runtime_expires = expires;
 
 		/* we check whether we're throttled above */
 		if (cfs_rq->runtime_remaining > 0)
@@ -4405,7 +4528,7 @@ static u64 distribute_cfs_runtime(struct cfs_bandwidth *cfs_b,
  */
 static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
 {
-	u64 runtime, runtime_expires;
+	u64 runtime;
 	int throttled;
 
 	/* no need to continue the timer with no bandwidth constraint */
@@ -4433,8 +4556,6 @@ static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
 	/* account preceding periods in which throttling occurred */
 	cfs_b->nr_throttled += overrun;
 
-	runtime_expires = cfs_b->runtime_expires;
-
 	/*
 	 * This check is repeated as we are holding onto the new bandwidth while
 	 * we unthrottle. This can potentially race with an unthrottled group
@@ -4446,8 +4567,7 @@ static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
 		runtime = cfs_b->runtime;
 		raw_spin_unlock(&cfs_b->lock);
 		/* we can't nest cfs_b->lock while distributing bandwidth */
-		runtime = distribute_cfs_runtime(cfs_b, runtime,
-						 runtime_expires);
+		runtime = distribute_cfs_runtime(cfs_b, runtime);
 		raw_spin_lock(&cfs_b->lock);
 
 		throttled = !list_empty(&cfs_b->throttled_cfs_rq);
@@ -4508,6 +4628,11 @@ static void start_cfs_slack_bandwidth(struct cfs_bandwidth *cfs_b)
 	if (runtime_refresh_within(cfs_b, min_left))
 		return;
 
+	/* don't push forwards an existing deferred unthrottle */
+	if (cfs_b->slack_started)
+		return;
+	cfs_b->slack_started = 1;
+
 	hrtimer_start(&cfs_b->slack_timer,
 			ns_to_ktime(cfs_bandwidth_slack_period),
 			HRTIMER_MODE_REL);
@@ -4523,12 +4648,11 @@ static void __return_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 		return;
 
 	raw_spin_lock(&cfs_b->lock);
-	if (cfs_b->quota != RUNTIME_INF &&
-	    cfs_rq->runtime_expires == cfs_b->runtime_expires) {
+	if (cfs_b->quota != RUNTIME_INF) {
 		cfs_b->runtime += slack_runtime;
 
 		/* we are under rq->lock, defer unthrottling using a timer */
-		if (cfs_b->runtime > sched_cfs_bandwidth_slice() &&
+		if (cfs_b->runtime > cfs_b_slice(cfs_b) &&
 		    !list_empty(&cfs_b->throttled_cfs_rq))
 			start_cfs_slack_bandwidth(cfs_b);
 	}
@@ -4555,11 +4679,11 @@ static __always_inline void return_cfs_rq_runtime(struct cfs_rq *cfs_rq)
  */
 static void do_sched_cfs_slack_timer(struct cfs_bandwidth *cfs_b)
 {
-	u64 runtime = 0, slice = sched_cfs_bandwidth_slice();
-	u64 expires;
+	u64 runtime = 0, slice = cfs_b_slice(cfs_b);
 
 	/* confirm we're still not at a refresh boundary */
 	raw_spin_lock(&cfs_b->lock);
+	cfs_b->slack_started = 0;
 	if (runtime_refresh_within(cfs_b, min_bandwidth_expiration)) {
 		raw_spin_unlock(&cfs_b->lock);
 		return;
@@ -4568,17 +4692,15 @@ static void do_sched_cfs_slack_timer(struct cfs_bandwidth *cfs_b)
 	if (cfs_b->quota != RUNTIME_INF && cfs_b->runtime > slice)
 		runtime = cfs_b->runtime;
 
-	expires = cfs_b->runtime_expires;
 	raw_spin_unlock(&cfs_b->lock);
 
 	if (!runtime)
 		return;
 
-	runtime = distribute_cfs_runtime(cfs_b, runtime, expires);
+	runtime = distribute_cfs_runtime(cfs_b, runtime);
 
 	raw_spin_lock(&cfs_b->lock);
-	if (expires == cfs_b->runtime_expires)
-		cfs_b->runtime -= min(runtime, cfs_b->runtime);
+	cfs_b->runtime -= min(runtime, cfs_b->runtime);
 	raw_spin_unlock(&cfs_b->lock);
 }
 
@@ -4680,6 +4802,8 @@ void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 	raw_spin_lock_init(&cfs_b->lock);
 	cfs_b->runtime = 0;
 	cfs_b->quota = RUNTIME_INF;
+	cfs_b->burst = 0;
+	cfs_b->slice = RUNTIME_INF;
 	cfs_b->period = ns_to_ktime(default_cfs_period());
 
 	INIT_LIST_HEAD(&cfs_b->throttled_cfs_rq);
@@ -5653,18 +5777,21 @@ static inline bool test_idle_cores(int cpu, bool def)
 
 /*
  * Scans the local SMT mask to see if the entire core is idle, and records this
- * information in sd_llc_shared->has_idle_cores.
+ * information in sd_llc_shared->has_idle_cores and sd_llc_shared's idle core
+ * mask.
  *
  * Since SMT siblings share all cache levels, inspecting this limited remote
  * state should be fairly cheap.
  */
 void __update_idle_core(struct rq *rq)
 {
+	struct sched_domain_shared *sds;
 	int core = cpu_of(rq);
 	int cpu;
 
 	rcu_read_lock();
-	if (test_idle_cores(core, true))
+	sds = rcu_dereference(per_cpu(sd_llc_shared, core));
+	if (!sds)
 		goto unlock;
 
 	for_each_cpu(cpu, cpu_smt_mask(core)) {
@@ -5675,20 +5802,47 @@ void __update_idle_core(struct rq *rq)
 			goto unlock;
 	}
 
-	set_idle_cores(core, 1);
+	/* Only dirty the shared cachelines on an actual change. */
+	cpu = cpumask_first(cpu_smt_mask(core));
+	if (!cpumask_test_cpu(cpu, sds_idle_cores(sds)))
+		cpumask_set_cpu(cpu, sds_idle_cores(sds));
+	if (!READ_ONCE(sds->has_idle_cores))
+		WRITE_ONCE(sds->has_idle_cores, 1);
 unlock:
 	rcu_read_unlock();
 }
 
 /*
- * Scan the entire LLC domain for idle cores; this dynamically switches off if
- * there are no idle cores left in the system; tracked through
- * sd_llc->shared->has_idle_cores and enabled through update_idle_core() above.
+ * The idle task is being switched out: the core, if it was marked idle,
+ * is not anymore.
+ */
+void __update_busy_core(struct rq *rq)
+{
+	struct sched_domain_shared *sds;
+	int core = cpumask_first(cpu_smt_mask(cpu_of(rq)));
+
+	rcu_read_lock();
+	sds = rcu_dereference(per_cpu(sd_llc_shared, core));
+	if (sds && cpumask_test_cpu(core, sds_idle_cores(sds)))
+		cpumask_clear_cpu(core, sds_idle_cores(sds));
+	rcu_read_unlock();
+}
+
+/*
+ * Look for an idle core among the ones recorded in the LLC's idle core mask;
+ * this dynamically switches off if there are no idle cores left in the
+ * system; tracked through sd_llc->shared->has_idle_cores and enabled through
+ * update_idle_core() above.
+ *
+ * The mask is maintained locklessly and may be stale: every candidate is
+ * verified, and stale entries are dropped, so the cost of the search is bound
+ * by the number of idle cores rather than by the size of the LLC.
  */
 static int select_idle_core(struct task_struct *p, struct sched_domain *sd, int target)
 {
 	struct cpumask *cpus = this_cpu_cpumask_var_ptr(select_idle_mask);
-	int core, cpu;
+	struct sched_domain_shared *sds;
+	int core, cpu, nr = 0;
 
 	if (!static_branch_likely(&sched_smt_present))
 		return -1;
@@ -5696,25 +5850,42 @@ static int select_idle_core(struct task_struct *p, struct sched_domain *sd, int
 	if (!test_idle_cores(target, false))
 		return -1;
 
-	cpumask_and(cpus, sched_domain_span(sd), &p->cpus_allowed);
+	sds = rcu_dereference(per_cpu(sd_llc_shared, target));
+	if (!sds)
+		return -1;
+
+	cpumask_and(cpus, sched_domain_span(sd), sds_idle_cores(sds));
 
 	for_each_cpu_wrap(core, cpus, target) {
 		bool idle = true;
 
+		nr++;
 		for_each_cpu(cpu, cpu_smt_mask(core)) {
-			cpumask_clear_cpu(cpu, cpus);
-			if (!idle_cpu(cpu))
+			if (!idle_cpu(cpu)) {
 				idle = false;
+				break;
+			}
 		}
 
-		if (idle)
-			return core;
+		if (!idle) {
+			cpumask_clear_cpu(core, sds_idle_cores(sds));
+			continue;
+		}
+
+		cpu = cpumask_any_and(cpu_smt_mask(core), &p->cpus_allowed);
+		if (cpu < nr_cpu_ids) {
+			schedstat_add(sd->sis_scanned, nr);
+			schedstat_inc(sd->sis_core_hit);
+			return cpu;
+		}
 	}
+	schedstat_add(sd->sis_scanned, nr);
 
 	/*
 	 * Failed to find an idle core; stop looking for one.
 	 */
-	set_idle_cores(target, 0);
+	if (cpumask_empty(sds_idle_cores(sds)))
+		set_idle_cores(target, 0);
 
 	return -1;
 }
@@ -5764,7 +5935,7 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 	u64 avg_cost, avg_idle;
 	u64 time, cost;
 	s64 delta;
-	int cpu, nr = INT_MAX;
+	int cpu, nr = INT_MAX, scanned = 0;
 
 	this_sd = rcu_dereference(*this_cpu_ptr(&sd_llc));
 	if (!this_sd)
@@ -5791,13 +5962,17 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 	time = local_clock();
 
 	for_each_cpu_wrap(cpu, sched_domain_span(sd), target) {
-		if (!--nr)
+		if (!--nr) {
+			schedstat_add(sd->sis_scanned, scanned);
 			return -1;
+		}
+		scanned++;
 		if (!cpumask_test_cpu(cpu, &p->cpus_allowed))
 			continue;
 		if (idle_cpu(cpu))
 			break;
 	}
+	schedstat_add(sd->sis_scanned, scanned);
 
 	time = local_clock() - time;
 	cost = this_sd->avg_scan_cost;
@@ -5828,19 +6003,26 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 	if (!sd)
 		return target;
 
+	schedstat_inc(sd->sis_search);
+
 	i = select_idle_core(p, sd, target);
 	if ((unsigned)i < nr_cpumask_bits)
 		return i;
 
 	i = select_idle_cpu(p, sd, target);
 	if ((unsigned)i < nr_cpumask_bits)
-		return i;
+		goto cpu_hit;
 
 	i = select_idle_smt(p, sd, target);
 	if ((unsigned)i < nr_cpumask_bits)
-		return i;
+		goto cpu_hit;
 
+	schedstat_inc(sd->sis_failed);
 	return target;
+
+cpu_hit:
+	schedstat_inc(sd->sis_cpu_hit);
+	return i;
 }
 
 /*
@@ -5882,6 +6064,20 @@ static inline int task_util(struct task_struct *p)
 	return p->se.avg.util_avg;
 }
 
+#ifdef CONFIG_UCLAMP_TASK
+static inline unsigned long uclamp_task_util(struct task_struct *p)
+{
+	return clamp_t(unsigned long, task_util(p),
+		       uclamp_eff_value(p, UCLAMP_MIN),
+		       uclamp_eff_value(p, UCLAMP_MAX));
+}
+#else
+static inline unsigned long uclamp_task_util(struct task_struct *p)
+{
+	return task_util(p);
+}
+#endif
+
 /*
  * cpu_util_wake: Compute cpu utilization with any contributions from
  * the waking task p removed.
@@ -5921,7 +6117,8 @@ static int wake_cap(struct task_struct *p, int cpu, int prev_cpu)
 	/* Bring task utilization in sync with prev_cpu */
 	sync_entity_load_avg(&p->se);
 
-	return min_cap * 1024 < task_util(p) * capacity_margin;
+	/* A boosted task wants a big CPU, a capped one is fine anywhere */
+	return min_cap * 1024 < uclamp_task_util(p) * capacity_margin;
 }
 
 /*
@@ -9554,6 +9751,10 @@ const struct sched_class fair_sched_class = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	.task_change_group	= task_change_group_fair,
 #endif
+
+#ifdef CONFIG_UCLAMP_TASK
+	.uclamp_enabled		= 1,
+#endif
 };
 
 #ifdef CONFIG_SCHED_DEBUG
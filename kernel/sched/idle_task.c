@@ -47,6 +47,7 @@ dequeue_task_idle(struct rq *rq, struct task_struct *p, int flags)
 
 static void put_prev_task_idle(struct rq *rq, struct task_struct *prev)
 {
+	update_busy_core(rq);
 	rq_last_tick_reset(rq);
 }
 
@@ -26,25 +26,78 @@
  * Bitmask made from a "or" of all commands within enum membarrier_cmd,
  * except MEMBARRIER_CMD_QUERY.
  */
+#ifdef CONFIG_ARCH_HAS_MEMBARRIER_SYNC_CORE
+#define MEMBARRIER_PRIVATE_EXPEDITED_SYNC_CORE_BITMASK			\
+	(MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE			\
+	| MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_SYNC_CORE)
+#else
+#define MEMBARRIER_PRIVATE_EXPEDITED_SYNC_CORE_BITMASK	0
+#endif
+
 #define MEMBARRIER_CMD_BITMASK	\
 	(MEMBARRIER_CMD_SHARED | MEMBARRIER_CMD_PRIVATE_EXPEDITED	\
-	| MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED)
+	| MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED			\
+	| MEMBARRIER_PRIVATE_EXPEDITED_SYNC_CORE_BITMASK)
 
 static void ipi_mb(void *info)
 {
 	smp_mb();	/* IPIs should be serializing but paranoid. */
 }
 
-static int membarrier_private_expedited(void)
+static void ipi_sync_core(void *info)
+{
+	smp_mb();	/* IPIs should be serializing but paranoid. */
+	sync_core_before_usermode();
+}
+
+/*
+ * Only CPUs currently running a thread of the calling process need the
+ * barrier.  Skipping the current CPU is OK even though we can be
+ * migrated at any point. The current CPU, at the point where we read
+ * smp_processor_id(), is ensured to be in program order with respect to
+ * the caller thread.
+ */
+static bool membarrier_runs_mm(int cpu, void *info)
 {
-	int cpu;
-	bool fallback = false;
-	cpumask_var_t tmpmask;
+	struct task_struct *p;
+	bool ret;
+
+	if (cpu == smp_processor_id())
+		return false;
 
-	if (!(atomic_read(&current->mm->membarrier_state)
-			& MEMBARRIER_STATE_PRIVATE_EXPEDITED_READY))
+	rcu_read_lock();
+	p = task_rcu_dereference(&cpu_rq(cpu)->curr);
+	ret = p && p->mm == info;
+	rcu_read_unlock();
+
+	return ret;
+}
+
+static int membarrier_private_expedited(int flags)
+{
+	struct mm_struct *mm = current->mm;
+	smp_call_func_t ipi_func = ipi_mb;
+	int ready = MEMBARRIER_STATE_PRIVATE_EXPEDITED_READY;
+
+	if (flags & MEMBARRIER_FLAG_SYNC_CORE) {
+		if (!IS_ENABLED(CONFIG_ARCH_HAS_MEMBARRIER_SYNC_CORE))
+			return -EINVAL;
+		ready = MEMBARRIER_STATE_PRIVATE_EXPEDITED_SYNC_CORE_READY;
+		ipi_func = ipi_sync_core;
+	}
+
+	if (!(atomic_read(&mm->membarrier_state) & ready))
 		return -EPERM;
 
+	if (flags & MEMBARRIER_FLAG_SYNC_CORE) {
+		/*
+		 * The harts not running mm right now serialize when they
+		 * next switch to it; this one does before returning.
+		 */
+		prepare_sync_core_cmd(mm);
+		sync_core_before_usermode();
+	}
+
 	if (num_online_cpus() == 1)
 		return 0;
 
@@ -56,42 +109,11 @@ static int membarrier_private_expedited(void)
 
 	/*
 	 * Expedited membarrier commands guarantee that they won't
-	 * block, hence the GFP_NOWAIT allocation flag and fallback
-	 * implementation.
+	 * block.  The CPUs are selected while the IPIs are queued, so
+	 * there is no cpumask to allocate.
 	 */
-	if (!zalloc_cpumask_var(&tmpmask, GFP_NOWAIT)) {
-		/* Fallback for OOM. */
-		fallback = true;
-	}
-
 	cpus_read_lock();
-	for_each_online_cpu(cpu) {
-		struct task_struct *p;
-
-		/*
-		 * Skipping the current CPU is OK even through we can be
-		 * migrated at any point. The current CPU, at the point
-		 * where we read raw_smp_processor_id(), is ensured to
-		 * be in program order with respect to the caller
-		 * thread. Therefore, we can skip this CPU from the
-		 * iteration.
-		 */
-		if (cpu == raw_smp_processor_id())
-			continue;
-		rcu_read_lock();
-		p = task_rcu_dereference(&cpu_rq(cpu)->curr);
-		if (p && p->mm == current->mm) {
-			if (!fallback)
-				__cpumask_set_cpu(cpu, tmpmask);
-			else
-				smp_call_function_single(cpu, ipi_mb, NULL, 1);
-		}
-		rcu_read_unlock();
-	}
-	if (!fallback) {
-		smp_call_function_many(tmpmask, ipi_mb, NULL, 1);
-		free_cpumask_var(tmpmask);
-	}
+	on_each_cpu_cond(membarrier_runs_mm, ipi_func, mm, true);
 	cpus_read_unlock();
 
 	/*
@@ -103,21 +125,38 @@ static int membarrier_private_expedited(void)
 	return 0;
 }
 
-static void membarrier_register_private_expedited(void)
+static int membarrier_register_private_expedited(int flags)
 {
 	struct task_struct *p = current;
 	struct mm_struct *mm = p->mm;
+	int state = MEMBARRIER_STATE_PRIVATE_EXPEDITED_READY;
+
+	if (flags & MEMBARRIER_FLAG_SYNC_CORE) {
+		if (!IS_ENABLED(CONFIG_ARCH_HAS_MEMBARRIER_SYNC_CORE))
+			return -EINVAL;
+		state = MEMBARRIER_STATE_PRIVATE_EXPEDITED_SYNC_CORE_READY;
+	}
 
 	/*
 	 * We need to consider threads belonging to different thread
 	 * groups, which use the same mm. (CLONE_VM but not
 	 * CLONE_THREAD).
 	 */
-	if (atomic_read(&mm->membarrier_state)
-			& MEMBARRIER_STATE_PRIVATE_EXPEDITED_READY)
-		return;
-	atomic_or(MEMBARRIER_STATE_PRIVATE_EXPEDITED_READY,
-			&mm->membarrier_state);
+	if (atomic_read(&mm->membarrier_state) & state)
+		return 0;
+	if (flags & MEMBARRIER_FLAG_SYNC_CORE) {
+		atomic_or(MEMBARRIER_STATE_PRIVATE_EXPEDITED_SYNC_CORE,
+			  &mm->membarrier_state);
+		/*
+		 * Ensure all future scheduler executions of the other
+		 * threads observe the state above before the command can
+		 * be used, so none returns to user-space unserialized.
+		 */
+		if (atomic_read(&mm->mm_users) != 1)
+			synchronize_sched();
+	}
+	atomic_or(state, &mm->membarrier_state);
+	return 0;
 }
 
 /**
@@ -168,10 +207,14 @@ SYSCALL_DEFINE2(membarrier, int, cmd, int, flags)
 			synchronize_sched();
 		return 0;
 	case MEMBARRIER_CMD_PRIVATE_EXPEDITED:
-		return membarrier_private_expedited();
+		return membarrier_private_expedited(0);
 	case MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED:
-		membarrier_register_private_expedited();
-		return 0;
+		return membarrier_register_private_expedited(0);
+	case MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE:
+		return membarrier_private_expedited(MEMBARRIER_FLAG_SYNC_CORE);
+	case MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_SYNC_CORE:
+		return membarrier_register_private_expedited(
+				MEMBARRIER_FLAG_SYNC_CORE);
 	default:
 		return -EINVAL;
 	}
@@ -10,11 +10,17 @@
  * bump this up when changing the output format or the meaning of an existing
  * format, so that tools can adapt (or abort)
  */
-#define SCHEDSTAT_VERSION 15
+#define SCHEDSTAT_VERSION 17
+
+static const char * const sched_lat_hist_names[NR_SCHED_LAT_TYPES] = {
+	[SCHED_LAT_WAKEUP]	= "lat_wakeup",
+	[SCHED_LAT_PREEMPT]	= "lat_preempt",
+	[SCHED_LAT_THROTTLE]	= "lat_throttle",
+};
 
 static int show_schedstat(struct seq_file *seq, void *v)
 {
-	int cpu;
+	int cpu, type, i;
 
 	if (v == (void *)1) {
 		seq_printf(seq, "version %d\n", SCHEDSTAT_VERSION);
@@ -39,6 +45,15 @@ static int show_schedstat(struct seq_file *seq, void *v)
 
 		seq_printf(seq, "\n");
 
+		/* latency histograms, see SCHED_LAT_HIST_BUCKETS */
+		for (type = 0; type < NR_SCHED_LAT_TYPES; type++) {
+			seq_printf(seq, "%s", sched_lat_hist_names[type]);
+			for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+				seq_printf(seq, " %llu",
+					   rq->lat_hist.buckets[type][i]);
+			seq_printf(seq, "\n");
+		}
+
 #ifdef CONFIG_SMP
 		/* domain-specific stats */
 		rcu_read_lock();
@@ -60,12 +75,16 @@ static int show_schedstat(struct seq_file *seq, void *v)
 				    sd->lb_nobusyg[itype]);
 			}
 			seq_printf(seq,
-				   " %u %u %u %u %u %u %u %u %u %u %u %u\n",
+				   " %u %u %u %u %u %u %u %u %u %u %u %u",
 			    sd->alb_count, sd->alb_failed, sd->alb_pushed,
 			    sd->sbe_count, sd->sbe_balanced, sd->sbe_pushed,
 			    sd->sbf_count, sd->sbf_balanced, sd->sbf_pushed,
 			    sd->ttwu_wake_remote, sd->ttwu_move_affine,
 			    sd->ttwu_move_balance);
+			seq_printf(seq, " %u %u %u %u %u\n",
+			    sd->sis_search, sd->sis_scanned,
+			    sd->sis_core_hit, sd->sis_cpu_hit,
+			    sd->sis_failed);
 		}
 		rcu_read_unlock();
 #endif
@@ -29,6 +29,65 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 	if (rq)
 		rq->rq_sched_info.run_delay += delta;
 }
+#define sched_lat_hist_enabled()	static_branch_unlikely(&sched_lat_histograms)
+
+static inline int sched_lat_hist_bucket(u64 delta)
+{
+	u64 delta_us = div_u64(delta, NSEC_PER_USEC);
+
+	if (!delta_us)
+		return 0;
+
+	return min(ilog2(delta_us) + 1, SCHED_LAT_HIST_BUCKETS - 1);
+}
+
+/*
+ * Account the runqueue delay of @t into @rq's histogram and into those of
+ * @t's task group and its ancestors.  Expects runqueue lock to be held.
+ */
+static inline void
+sched_lat_hist_arrive(struct rq *rq, struct task_struct *t, u64 delta)
+{
+	enum sched_lat_type type;
+#ifdef CONFIG_CGROUP_SCHED
+	struct task_group *tg;
+#endif
+	int bucket;
+
+	if (!sched_lat_hist_enabled())
+		return;
+
+	type = t->sched_info.preempted ? SCHED_LAT_PREEMPT : SCHED_LAT_WAKEUP;
+	bucket = sched_lat_hist_bucket(delta);
+
+	rq->lat_hist.buckets[type][bucket]++;
+#ifdef CONFIG_CGROUP_SCHED
+	for (tg = t->sched_task_group; tg && tg->lat_hist; tg = tg->parent)
+		per_cpu_ptr(tg->lat_hist, cpu_of(rq))->buckets[type][bucket]++;
+#endif
+}
+
+/*
+ * Account the time a cfs_rq of @tg spent throttled on @rq.  Expects
+ * runqueue lock to be held.
+ */
+static inline void
+sched_lat_hist_throttled(struct rq *rq, struct task_group *tg, u64 delta)
+{
+	int bucket;
+
+	if (!sched_lat_hist_enabled())
+		return;
+
+	bucket = sched_lat_hist_bucket(delta);
+	rq->lat_hist.buckets[SCHED_LAT_THROTTLE][bucket]++;
+#ifdef CONFIG_CGROUP_SCHED
+	if (tg->lat_hist)
+		per_cpu_ptr(tg->lat_hist, cpu_of(rq))->
+			buckets[SCHED_LAT_THROTTLE][bucket]++;
+#endif
+}
+
 #define schedstat_enabled()		static_branch_unlikely(&sched_schedstats)
 #define schedstat_inc(var)		do { if (schedstat_enabled()) { var++; } } while (0)
 #define schedstat_add(var, amt)		do { if (schedstat_enabled()) { var += (amt); } } while (0)
@@ -46,6 +105,12 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 static inline void
 rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 {}
+static inline void
+sched_lat_hist_arrive(struct rq *rq, struct task_struct *t, u64 delta)
+{}
+static inline void
+sched_lat_hist_throttled(struct rq *rq, struct task_group *tg, u64 delta)
+{}
 #define schedstat_enabled()		0
 #define schedstat_inc(var)		do { } while (0)
 #define schedstat_add(var, amt)		do { } while (0)
@@ -54,6 +119,92 @@ rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 #define schedstat_val_or_zero(var)	0
 #endif /* CONFIG_SCHEDSTATS */
 
+#ifdef CONFIG_PSI
+/*
+ * PSI tracks state that persists across sleeps, such as iowaits and
+ * memory stalls. As a result, it has to distinguish between sleeps,
+ * where a task's runnable state changes, and requeues, where a task
+ * and its state are being moved between CPUs and runqueues.
+ */
+static inline void psi_enqueue(struct task_struct *p, bool wakeup)
+{
+	int clear = 0, set = TSK_RUNNING;
+
+	if (static_branch_likely(&psi_disabled))
+		return;
+
+	if (!wakeup || p->sched_psi_wake_requeue) {
+		if (p->flags & PF_MEMSTALL)
+			set |= TSK_MEMSTALL;
+		if (p->sched_psi_wake_requeue)
+			p->sched_psi_wake_requeue = 0;
+	} else {
+		if (p->in_iowait)
+			clear |= TSK_IOWAIT;
+	}
+
+	psi_task_change(p, clear, set);
+}
+
+static inline void psi_dequeue(struct task_struct *p, bool sleep)
+{
+	int clear = TSK_RUNNING, set = 0;
+
+	if (static_branch_likely(&psi_disabled))
+		return;
+
+	if (!sleep) {
+		if (p->flags & PF_MEMSTALL)
+			clear |= TSK_MEMSTALL;
+	} else {
+		if (p->in_iowait)
+			set |= TSK_IOWAIT;
+	}
+
+	psi_task_change(p, clear, set);
+}
+
+static inline void psi_ttwu_dequeue(struct task_struct *p)
+{
+	if (static_branch_likely(&psi_disabled))
+		return;
+	/*
+	 * Is the task being migrated during a wakeup? Make sure to
+	 * deregister its sleep-persistent psi states from the old
+	 * queue, and let psi_enqueue() know it has to requeue.
+	 */
+	if (unlikely(p->in_iowait || (p->flags & PF_MEMSTALL))) {
+		struct rq_flags rf;
+		struct rq *rq;
+		int clear = 0;
+
+		if (p->in_iowait)
+			clear |= TSK_IOWAIT;
+		if (p->flags & PF_MEMSTALL)
+			clear |= TSK_MEMSTALL;
+
+		rq = __task_rq_lock(p, &rf);
+		psi_task_change(p, clear, 0);
+		p->sched_psi_wake_requeue = 1;
+		__task_rq_unlock(rq, &rf);
+	}
+}
+
+static inline void psi_task_tick(struct rq *rq)
+{
+	if (static_branch_likely(&psi_disabled))
+		return;
+
+	if (unlikely(rq->curr->flags & PF_MEMSTALL))
+		psi_memstall_tick(rq->curr, cpu_of(rq));
+}
+#else /* CONFIG_PSI */
+static inline void psi_enqueue(struct task_struct *p, bool wakeup) {}
+static inline void psi_dequeue(struct task_struct *p, bool sleep) {}
+static inline void psi_ttwu_dequeue(struct task_struct *p) {}
+static inline void psi_task_tick(struct rq *rq) {}
+#endif /* CONFIG_PSI */
+
 #ifdef CONFIG_SCHED_INFO
 static inline void sched_info_reset_dequeued(struct task_struct *t)
 {
@@ -96,6 +247,9 @@ static void sched_info_arrive(struct rq *rq, struct task_struct *t)
 	t->sched_info.pcount++;
 
 	rq_sched_info_arrive(rq, delta);
+	sched_lat_hist_arrive(rq, t, delta);
+	trace_sched_rq_delay(t, delta, t->sched_info.preempted);
+	t->sched_info.preempted = 0;
 }
 
 /*
@@ -125,8 +279,10 @@ static inline void sched_info_depart(struct rq *rq, struct task_struct *t)
 
 	rq_sched_info_depart(rq, delta);
 
-	if (t->state == TASK_RUNNING)
+	if (t->state == TASK_RUNNING) {
+		t->sched_info.preempted = 1;
 		sched_info_queued(rq, t);
+	}
 }
 
 /*
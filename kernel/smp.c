@@ -18,6 +18,8 @@
 #include <linux/cpu.h>
 #include <linux/sched.h>
 #include <linux/sched/idle.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/debug.h>
 #include <linux/hypervisor.h>
 
 #include "smpboot.h"
@@ -103,10 +105,43 @@ void __init call_function_init(void)
  * previous function call. For multi-cpu calls its even more interesting
  * as we'll have to ensure no other cpu is observing our csd.
  */
+#ifdef CONFIG_CSD_LOCK_WAIT_DEBUG
+
+#define CSD_LOCK_TIMEOUT	(5ULL * NSEC_PER_SEC)
+
+/*
+ * Same as the plain wait below, but complain every CSD_LOCK_TIMEOUT
+ * about a target CPU that does not run the callback, and say so once
+ * it finally does, so that stuck IPIs show up in the log.
+ */
+static void csd_lock_wait(call_single_data_t *csd)
+{
+	u64 ts0 = local_clock(), ts1, ts2 = ts0;
+	int bug_id = 0;
+
+	while (READ_ONCE(csd->flags) & CSD_FLAG_LOCK) {
+		ts1 = local_clock();
+		if (ts1 - ts2 > CSD_LOCK_TIMEOUT) {
+			pr_alert("csd: Detected non-responsive CSD lock (#%d) on CPU#%d, waiting %llu ns for %pS(%p)\n",
+				 ++bug_id, raw_smp_processor_id(), ts1 - ts0,
+				 READ_ONCE(csd->func), READ_ONCE(csd->info));
+			dump_stack();
+			ts2 = ts1;
+		}
+		cpu_relax();
+	}
+	smp_acquire__after_ctrl_dep();
+
+	if (unlikely(bug_id))
+		pr_alert("csd: CSD lock (#%d) got unstuck on CPU#%d after %llu ns\n",
+			 bug_id, raw_smp_processor_id(), local_clock() - ts0);
+}
+#else
 static __always_inline void csd_lock_wait(call_single_data_t *csd)
 {
 	smp_cond_load_acquire(&csd->flags, !(VAL & CSD_FLAG_LOCK));
 }
+#endif
 
 static __always_inline void csd_lock(call_single_data_t *csd)
 {
@@ -386,22 +421,9 @@ int smp_call_function_any(const struct cpumask *mask,
 }
 EXPORT_SYMBOL_GPL(smp_call_function_any);
 
-/**
- * smp_call_function_many(): Run a function on a set of other CPUs.
- * @mask: The set of cpus to run on (only runs on online subset).
- * @func: The function to run. This must be fast and non-blocking.
- * @info: An arbitrary pointer to pass to the function.
- * @wait: If true, wait (atomically) until function has completed
- *        on other CPUs.
- *
- * If @wait is true, then returns once @func has returned.
- *
- * You must not call this function with disabled interrupts or from a
- * hardware interrupt handler or from a bottom half handler. Preemption
- * must be disabled when calling this function.
- */
-void smp_call_function_many(const struct cpumask *mask,
-			    smp_call_func_t func, void *info, bool wait)
+static void smp_call_function_many_cond(const struct cpumask *mask,
+					smp_call_func_t func, void *info,
+					bool wait, smp_cond_func_t cond_func)
 {
 	struct call_function_data *cfd;
 	int cpu, next_cpu, this_cpu = smp_processor_id();
@@ -431,7 +453,8 @@ void smp_call_function_many(const struct cpumask *mask,
 
 	/* Fastpath: do that cpu by itself. */
 	if (next_cpu >= nr_cpu_ids) {
-		smp_call_function_single(cpu, func, info, wait);
+		if (!cond_func || cond_func(cpu, info))
+			smp_call_function_single(cpu, func, info, wait);
 		return;
 	}
 
@@ -448,6 +471,12 @@ void smp_call_function_many(const struct cpumask *mask,
 	for_each_cpu(cpu, cfd->cpumask) {
 		call_single_data_t *csd = per_cpu_ptr(cfd->csd, cpu);
 
+		/* Filtered out here so that it is not waited for below */
+		if (cond_func && !cond_func(cpu, info)) {
+			__cpumask_clear_cpu(cpu, cfd->cpumask);
+			continue;
+		}
+
 		csd_lock(csd);
 		if (wait)
 			csd->flags |= CSD_FLAG_SYNCHRONOUS;
@@ -457,8 +486,12 @@ void smp_call_function_many(const struct cpumask *mask,
 			__cpumask_set_cpu(cpu, cfd->cpumask_ipi);
 	}
 
-	/* Send a message to all CPUs in the map */
-	arch_send_call_function_ipi_mask(cfd->cpumask_ipi);
+	/*
+	 * Send one message to all CPUs in the map.  CPUs whose queue was
+	 * already non-empty have an IPI in flight and are left out.
+	 */
+	if (!cpumask_empty(cfd->cpumask_ipi))
+		arch_send_call_function_ipi_mask(cfd->cpumask_ipi);
 
 	if (wait) {
 		for_each_cpu(cpu, cfd->cpumask) {
@@ -469,6 +502,26 @@ void smp_call_function_many(const struct cpumask *mask,
 		}
 	}
 }
+
+/**
+ * smp_call_function_many(): Run a function on a set of other CPUs.
+ * @mask: The set of cpus to run on (only runs on online subset).
+ * @func: The function to run. This must be fast and non-blocking.
+ * @info: An arbitrary pointer to pass to the function.
+ * @wait: If true, wait (atomically) until function has completed
+ *        on other CPUs.
+ *
+ * If @wait is true, then returns once @func has returned.
+ *
+ * You must not call this function with disabled interrupts or from a
+ * hardware interrupt handler or from a bottom half handler. Preemption
+ * must be disabled when calling this function.
+ */
+void smp_call_function_many(const struct cpumask *mask,
+			    smp_call_func_t func, void *info, bool wait)
+{
+	smp_call_function_many_cond(mask, func, info, wait, NULL);
+}
 EXPORT_SYMBOL(smp_call_function_many);
 
 /**
@@ -641,10 +694,10 @@ void on_each_cpu_mask(const struct cpumask *mask, smp_call_func_t func,
 EXPORT_SYMBOL(on_each_cpu_mask);
 
 /*
- * on_each_cpu_cond(): Call a function on each processor for which
- * the supplied function cond_func returns true, optionally waiting
- * for all the required CPUs to finish. This may include the local
- * processor.
+ * on_each_cpu_cond_mask(): Call a function on each processor in @mask
+ * for which the supplied function cond_func returns true, optionally
+ * waiting for all the required CPUs to finish. This may include the
+ * local processor.
  * @cond_func:	A callback function that is passed a cpu id and
  *		the the info parameter. The function is called
  *		with preemption disabled. The function should
@@ -655,11 +708,11 @@ EXPORT_SYMBOL(on_each_cpu_mask);
  * @info:	An arbitrary pointer to pass to both functions.
  * @wait:	If true, wait (atomically) until function has
  *		completed on other CPUs.
- * @gfp_flags:	GFP flags to use when allocating the cpumask
- *		used internally by the function.
+ * @mask:	The set of cpus to consider (only the online subset).
  *
- * The function might sleep if the GFP flags indicates a non
- * atomic allocation is allowed.
+ * The condition is evaluated while the per-cpu call function data is
+ * filled in, so no temporary cpumask is needed and all selected CPUs
+ * are sent a single IPI.
  *
  * Preemption is disabled to protect against CPUs going offline but not online.
  * CPUs going online during the call will not be seen or sent an IPI.
@@ -667,37 +720,31 @@ EXPORT_SYMBOL(on_each_cpu_mask);
  * You must not call this function with disabled interrupts or
  * from a hardware interrupt handler or from a bottom half handler.
  */
-void on_each_cpu_cond(bool (*cond_func)(int cpu, void *info),
-			smp_call_func_t func, void *info, bool wait,
-			gfp_t gfp_flags)
+void on_each_cpu_cond_mask(smp_cond_func_t cond_func, smp_call_func_t func,
+			   void *info, bool wait, const struct cpumask *mask)
 {
-	cpumask_var_t cpus;
-	int cpu, ret;
-
-	might_sleep_if(gfpflags_allow_blocking(gfp_flags));
-
-	if (likely(zalloc_cpumask_var(&cpus, (gfp_flags|__GFP_NOWARN)))) {
-		preempt_disable();
-		for_each_online_cpu(cpu)
-			if (cond_func(cpu, info))
-				cpumask_set_cpu(cpu, cpus);
-		on_each_cpu_mask(cpus, func, info, wait);
-		preempt_enable();
-		free_cpumask_var(cpus);
-	} else {
-		/*
-		 * No free cpumask, bother. No matter, we'll
-		 * just have to IPI them one by one.
-		 */
-		preempt_disable();
-		for_each_online_cpu(cpu)
-			if (cond_func(cpu, info)) {
-				ret = smp_call_function_single(cpu, func,
-								info, wait);
-				WARN_ON_ONCE(ret);
-			}
-		preempt_enable();
+	int cpu = get_cpu();
+
+	smp_call_function_many_cond(mask, func, info, wait, cond_func);
+	if (cpumask_test_cpu(cpu, mask) && cond_func(cpu, info)) {
+		unsigned long flags;
+
+		local_irq_save(flags);
+		func(info);
+		local_irq_restore(flags);
 	}
+	put_cpu();
+}
+EXPORT_SYMBOL(on_each_cpu_cond_mask);
+
+/*
+ * on_each_cpu_cond(): Same as on_each_cpu_cond_mask() for all online
+ * processors.
+ */
+void on_each_cpu_cond(smp_cond_func_t cond_func, smp_call_func_t func,
+		      void *info, bool wait)
+{
+	on_each_cpu_cond_mask(cond_func, func, info, wait, cpu_online_mask);
 }
 EXPORT_SYMBOL(on_each_cpu_cond);
 
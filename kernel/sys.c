@@ -47,6 +47,7 @@
 #include <linux/kprobes.h>
 #include <linux/user_namespace.h>
 #include <linux/binfmts.h>
+#include <linux/ksm.h>
 
 #include <linux/sched.h>
 #include <linux/sched/autogroup.h>
@@ -2385,6 +2386,34 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 	case PR_GET_FP_MODE:
 		error = GET_FP_MODE(me);
 		break;
+#ifdef CONFIG_KSM
+	case PR_SET_MEMORY_MERGE:
+		if (arg3 || arg4 || arg5)
+			return -EINVAL;
+		if (down_write_killable(&me->mm->mmap_sem))
+			return -EINTR;
+		if (arg2)
+			error = ksm_enable_merge_any(me->mm);
+		else
+			error = ksm_disable_merge_any(me->mm);
+		up_write(&me->mm->mmap_sem);
+		break;
+	case PR_GET_MEMORY_MERGE:
+		if (arg2 || arg3 || arg4 || arg5)
+			return -EINVAL;
+		error = !!test_bit(MMF_VM_MERGE_ANY, &me->mm->flags);
+		break;
+	case PR_SET_KSM_PRIORITY:
+		if (arg3 || arg4 || arg5 || arg2 > PR_KSM_PRIORITY_MAX)
+			return -EINVAL;
+		WRITE_ONCE(me->mm->ksm_priority, arg2);
+		break;
+	case PR_GET_KSM_PRIORITY:
+		if (arg2 || arg3 || arg4 || arg5)
+			return -EINVAL;
+		error = READ_ONCE(me->mm->ksm_priority);
+		break;
+#endif
 	default:
 		error = -EINVAL;
 		break;
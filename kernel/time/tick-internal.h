@@ -163,3 +163,15 @@ DECLARE_PER_CPU(struct hrtimer_cpu_base, hrtimer_bases);
 
 extern u64 get_next_timer_interrupt(unsigned long basej, u64 basem);
 void timer_clear_idle(void);
+
+/* Timer wheel state reported in /proc/timer_list */
+struct timer_base_stats {
+	unsigned long clk;
+	unsigned long next_expiry;
+	unsigned long nr_remote_locks;
+	unsigned long nr_contended;
+	unsigned long nr_migrated;
+	unsigned long nr_expired;
+};
+
+extern int timer_get_base_stats(int cpu, int idx, struct timer_base_stats *st);
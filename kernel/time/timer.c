@@ -204,12 +204,38 @@ struct timer_base {
 	bool			nohz_active;
 	bool			is_idle;
 	bool			must_forward_clk;
+	/* statistics, updated under lock and reported in /proc/timer_list */
+	unsigned long		nr_remote_locks;
+	unsigned long		nr_contended;
+	unsigned long		nr_migrated;
+	unsigned long		nr_expired;
 	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
 	struct hlist_head	vectors[WHEEL_SIZE];
 } ____cacheline_aligned;
 
 static DEFINE_PER_CPU(struct timer_base, timer_bases[NR_BASES]);
 
+/*
+ * Fill in @st with the state of timer wheel @idx of @cpu. Returns -EINVAL
+ * once @idx is past the last wheel.
+ */
+int timer_get_base_stats(int cpu, int idx, struct timer_base_stats *st)
+{
+	struct timer_base *base;
+
+	if (idx >= NR_BASES)
+		return -EINVAL;
+
+	base = per_cpu_ptr(&timer_bases[idx], cpu);
+	st->clk = READ_ONCE(base->clk);
+	st->next_expiry = READ_ONCE(base->next_expiry);
+	st->nr_remote_locks = READ_ONCE(base->nr_remote_locks);
+	st->nr_contended = READ_ONCE(base->nr_contended);
+	st->nr_migrated = READ_ONCE(base->nr_migrated);
+	st->nr_expired = READ_ONCE(base->nr_expired);
+	return 0;
+}
+
 #if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
 unsigned int sysctl_timer_migration = 1;
 
@@ -919,18 +945,31 @@ static struct timer_base *lock_timer_base(struct timer_list *timer,
 		tf = READ_ONCE(timer->flags);
 
 		if (!(tf & TIMER_MIGRATING)) {
+			bool contended = false;
+
 			base = get_timer_base(tf);
-			raw_spin_lock_irqsave(&base->lock, *flags);
-			if (timer->flags == tf)
+			if (!raw_spin_trylock_irqsave(&base->lock, *flags)) {
+				raw_spin_lock_irqsave(&base->lock, *flags);
+				contended = true;
+			}
+			if (timer->flags == tf) {
+				base->nr_contended += contended;
+				if (base->cpu != smp_processor_id())
+					base->nr_remote_locks++;
 				return base;
+			}
 			raw_spin_unlock_irqrestore(&base->lock, *flags);
 		}
 		cpu_relax();
 	}
 }
 
+#define MOD_TIMER_PENDING_ONLY		0x01
+#define MOD_TIMER_LOCAL			0x02
+
 static inline int
-__mod_timer(struct timer_list *timer, unsigned long expires, bool pending_only)
+__mod_timer(struct timer_list *timer, unsigned long expires,
+	    unsigned int options)
 {
 	struct timer_base *base, *new_base;
 	unsigned int idx = UINT_MAX;
@@ -981,12 +1020,15 @@ __mod_timer(struct timer_list *timer, unsigned long expires, bool pending_only)
 	}
 
 	ret = detach_if_pending(timer, base, false);
-	if (!ret && pending_only)
+	if (!ret && (options & MOD_TIMER_PENDING_ONLY))
 		goto out_unlock;
 
 	debug_activate(timer, expires);
 
-	new_base = get_target_base(base, timer->flags);
+	if (options & MOD_TIMER_LOCAL)
+		new_base = get_timer_this_cpu_base(timer->flags);
+	else
+		new_base = get_target_base(base, timer->flags);
 
 	if (base != new_base) {
 		/*
@@ -1005,6 +1047,7 @@ __mod_timer(struct timer_list *timer, unsigned long expires, bool pending_only)
 			raw_spin_lock(&base->lock);
 			WRITE_ONCE(timer->flags,
 				   (timer->flags & ~TIMER_BASEMASK) | base->cpu);
+			base->nr_migrated++;
 			forward_timer_base(base);
 		}
 	}
@@ -1042,7 +1085,7 @@ __mod_timer(struct timer_list *timer, unsigned long expires, bool pending_only)
  */
 int mod_timer_pending(struct timer_list *timer, unsigned long expires)
 {
-	return __mod_timer(timer, expires, true);
+	return __mod_timer(timer, expires, MOD_TIMER_PENDING_ONLY);
 }
 EXPORT_SYMBOL(mod_timer_pending);
 
@@ -1068,10 +1111,29 @@ EXPORT_SYMBOL(mod_timer_pending);
  */
 int mod_timer(struct timer_list *timer, unsigned long expires)
 {
-	return __mod_timer(timer, expires, false);
+	return __mod_timer(timer, expires, 0);
 }
 EXPORT_SYMBOL(mod_timer);
 
+/**
+ * mod_timer_local - modify a timer's timeout and queue it locally
+ * @timer: the timer to be modified
+ * @expires: new timeout in jiffies
+ *
+ * mod_timer_local() is mod_timer(), except that the timer is always
+ * queued on the calling CPU's timer base instead of a NOHZ migration
+ * target. A timer that keeps being re-armed from the same CPU then only
+ * ever takes that CPU's base lock, which matters for users with huge
+ * numbers of timers such as the networking stack.
+ *
+ * The return value is the same as for mod_timer().
+ */
+int mod_timer_local(struct timer_list *timer, unsigned long expires)
+{
+	return __mod_timer(timer, expires, MOD_TIMER_LOCAL);
+}
+EXPORT_SYMBOL(mod_timer_local);
+
 /**
  * add_timer - start a timer
  * @timer: the timer to be added
@@ -1307,6 +1369,7 @@ static void expire_timers(struct timer_base *base, struct hlist_head *head)
 
 		base->running_timer = timer;
 		detach_timer(timer, true);
+		base->nr_expired++;
 
 		fn = timer->function;
 		data = timer->data;
@@ -1739,7 +1802,7 @@ signed long __sched schedule_timeout(signed long timeout)
 	expire = timeout + jiffies;
 
 	setup_timer_on_stack(&timer, process_timeout, (unsigned long)current);
-	__mod_timer(&timer, expire, false);
+	__mod_timer(&timer, expire, 0);
 	schedule();
 	del_singleshot_timer_sync(&timer);
 
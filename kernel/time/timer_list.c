@@ -162,6 +162,24 @@ static void print_cpu(struct seq_file *m, int cpu, u64 now)
 #undef P
 #undef P_ns
 
+	for (i = 0; ; i++) {
+		struct timer_base_stats st;
+
+		if (timer_get_base_stats(cpu, i, &st))
+			break;
+
+		SEQ_printf(m, " timer wheel %d:\n", i);
+#define P(x) \
+	SEQ_printf(m, "  .%-15s: %Lu\n", #x, (unsigned long long)(st.x))
+		P(clk);
+		P(next_expiry);
+		P(nr_remote_locks);
+		P(nr_contended);
+		P(nr_migrated);
+		P(nr_expired);
+#undef P
+	}
+
 #ifdef CONFIG_TICK_ONESHOT
 # define P(x) \
 	SEQ_printf(m, "  .%-15s: %Lu\n", #x, \
@@ -283,7 +301,7 @@ static void timer_list_show_tickdevices_header(struct seq_file *m)
 
 static inline void timer_list_header(struct seq_file *m, u64 now)
 {
-	SEQ_printf(m, "Timer List Version: v0.8\n");
+	SEQ_printf(m, "Timer List Version: v0.9\n");
 	SEQ_printf(m, "HRTIMER_MAX_CLOCK_BASES: %d\n", HRTIMER_MAX_CLOCK_BASES);
 	SEQ_printf(m, "now at %Ld nsecs\n", (unsigned long long)now);
 	SEQ_printf(m, "\n");
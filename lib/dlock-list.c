@@ -0,0 +1,146 @@
+/*
+ * Distributed and locked list
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/dlock-list.h>
+#include <linux/export.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+
+/**
+ * __alloc_dlock_list_heads - allocate and initialize the per-cpu lists
+ * @dlist: pointer to a dlock_list_heads structure to be initialized
+ * @key  : the lock class key of all the per-cpu list locks
+ *
+ * Return: 0 if successful, -ENOMEM if memory allocation error.
+ */
+int __alloc_dlock_list_heads(struct dlock_list_heads *dlist,
+			     struct lock_class_key *key)
+{
+	int idx;
+
+	dlist->heads = kcalloc(nr_cpu_ids, sizeof(struct dlock_list_head),
+			       GFP_KERNEL);
+	if (!dlist->heads)
+		return -ENOMEM;
+
+	for (idx = 0; idx < nr_cpu_ids; idx++) {
+		struct dlock_list_head *head = &dlist->heads[idx];
+
+		INIT_LIST_HEAD(&head->list);
+		spin_lock_init(&head->lock);
+		lockdep_set_class(&head->lock, key);
+	}
+	return 0;
+}
+EXPORT_SYMBOL(__alloc_dlock_list_heads);
+
+/**
+ * free_dlock_list_heads - free the per-cpu lists
+ * @dlist: pointer to the dlock_list_heads structure
+ *
+ * The lists must be empty.
+ */
+void free_dlock_list_heads(struct dlock_list_heads *dlist)
+{
+	kfree(dlist->heads);
+	dlist->heads = NULL;
+}
+EXPORT_SYMBOL(free_dlock_list_heads);
+
+/**
+ * dlock_lists_empty - check if all the per-cpu lists are empty
+ * @dlist: pointer to the dlock_list_heads structure
+ *
+ * The check is done without taking the list locks, so the answer is only
+ * stable if the caller excludes concurrent adders.
+ */
+bool dlock_lists_empty(struct dlock_list_heads *dlist)
+{
+	int idx;
+
+	for (idx = 0; idx < nr_cpu_ids; idx++)
+		if (!list_empty(&dlist->heads[idx].list))
+			return false;
+	return true;
+}
+EXPORT_SYMBOL(dlock_lists_empty);
+
+/**
+ * dlock_lists_add - add a node to the list of the current cpu
+ * @node : pointer to the node to be added
+ * @dlist: pointer to the dlock_list_heads structure
+ */
+void dlock_lists_add(struct dlock_list_node *node,
+		     struct dlock_list_heads *dlist)
+{
+	struct dlock_list_head *head = &dlist->heads[raw_smp_processor_id()];
+
+	spin_lock(&head->lock);
+	WRITE_ONCE(node->head, head);
+	list_add(&node->list, &head->list);
+	spin_unlock(&head->lock);
+}
+EXPORT_SYMBOL(dlock_lists_add);
+
+/**
+ * dlock_lists_del - delete a node from the list it is on
+ * @node : pointer to the node to be deleted
+ *
+ * Does nothing if the node is on no list.  The caller must make sure the
+ * node is not being added or deleted concurrently.
+ */
+void dlock_lists_del(struct dlock_list_node *node)
+{
+	struct dlock_list_head *head = READ_ONCE(node->head);
+
+	if (!head)
+		return;
+
+	spin_lock(&head->lock);
+	WARN_ON_ONCE(head != node->head);
+	list_del_init(&node->list);
+	WRITE_ONCE(node->head, NULL);
+	spin_unlock(&head->lock);
+}
+EXPORT_SYMBOL(dlock_lists_del);
+
+/**
+ * __dlock_list_next_list - move the iterator to the next non-empty list
+ * @iter: pointer to the dlock list iterator
+ *
+ * Drops the lock of the current list, if any, and takes the lock of the
+ * next non-empty one.
+ *
+ * Return: the first node of that list, or NULL at the end of the walk.
+ */
+struct dlock_list_node *__dlock_list_next_list(struct dlock_list_iter *iter)
+{
+	struct dlock_list_head *head;
+
+	if (iter->entry) {
+		spin_unlock(&iter->entry->lock);
+		iter->entry = NULL;
+	}
+
+	while (++iter->index < nr_cpu_ids) {
+		head = &iter->head[iter->index];
+		if (list_empty(&head->list))
+			continue;
+
+		spin_lock(&head->lock);
+		/* recheck under the lock, it may have emptied meanwhile */
+		if (list_empty(&head->list)) {
+			spin_unlock(&head->lock);
+			continue;
+		}
+		iter->entry = head;
+		return list_first_entry(&head->list, struct dlock_list_node,
+					list);
+	}
+	return NULL;
+}
+EXPORT_SYMBOL(__dlock_list_next_list);
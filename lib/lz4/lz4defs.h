@@ -40,6 +40,16 @@
 
 #define FORCE_INLINE __always_inline
 
+/*
+ * Architectures built for strict alignment that find out at boot whether
+ * misaligned accesses are cheap provide get_unaligned_fast() and
+ * put_unaligned_fast(); everywhere else they are the plain ones.
+ */
+#ifndef get_unaligned_fast
+#define get_unaligned_fast(ptr)		get_unaligned(ptr)
+#define put_unaligned_fast(val, ptr)	put_unaligned(val, ptr)
+#endif
+
 /*-************************************
  *	Basic Types
  **************************************/
@@ -99,51 +109,59 @@ typedef uintptr_t uptrval;
  **************************************/
 static FORCE_INLINE U16 LZ4_read16(const void *ptr)
 {
-	return get_unaligned((const U16 *)ptr);
+	return get_unaligned_fast((const U16 *)ptr);
 }
 
 static FORCE_INLINE U32 LZ4_read32(const void *ptr)
 {
-	return get_unaligned((const U32 *)ptr);
+	return get_unaligned_fast((const U32 *)ptr);
 }
 
 static FORCE_INLINE size_t LZ4_read_ARCH(const void *ptr)
 {
-	return get_unaligned((const size_t *)ptr);
+	return get_unaligned_fast((const size_t *)ptr);
 }
 
 static FORCE_INLINE void LZ4_write16(void *memPtr, U16 value)
 {
-	put_unaligned(value, (U16 *)memPtr);
+	put_unaligned_fast(value, (U16 *)memPtr);
 }
 
 static FORCE_INLINE void LZ4_write32(void *memPtr, U32 value)
 {
-	put_unaligned(value, (U32 *)memPtr);
+	put_unaligned_fast(value, (U32 *)memPtr);
 }
 
 static FORCE_INLINE U16 LZ4_readLE16(const void *memPtr)
 {
+#if LZ4_LITTLE_ENDIAN
+	return LZ4_read16(memPtr);
+#else
 	return get_unaligned_le16(memPtr);
+#endif
 }
 
 static FORCE_INLINE void LZ4_writeLE16(void *memPtr, U16 value)
 {
-	return put_unaligned_le16(value, memPtr);
+#if LZ4_LITTLE_ENDIAN
+	LZ4_write16(memPtr, value);
+#else
+	put_unaligned_le16(value, memPtr);
+#endif
 }
 
 static FORCE_INLINE void LZ4_copy8(void *dst, const void *src)
 {
 #if LZ4_ARCH64
-	U64 a = get_unaligned((const U64 *)src);
+	U64 a = get_unaligned_fast((const U64 *)src);
 
-	put_unaligned(a, (U64 *)dst);
+	put_unaligned_fast(a, (U64 *)dst);
 #else
-	U32 a = get_unaligned((const U32 *)src);
-	U32 b = get_unaligned((const U32 *)src + 1);
+	U32 a = get_unaligned_fast((const U32 *)src);
+	U32 b = get_unaligned_fast((const U32 *)src + 1);
 
-	put_unaligned(a, (U32 *)dst);
-	put_unaligned(b, (U32 *)dst + 1);
+	put_unaligned_fast(a, (U32 *)dst);
+	put_unaligned_fast(b, (U32 *)dst + 1);
 #endif
 }
 
@@ -158,6 +176,14 @@ static FORCE_INLINE void LZ4_wildCopy(void *dstPtr,
 	const BYTE *s = (const BYTE *)srcPtr;
 	BYTE *const e = (BYTE *)dstEnd;
 
+#ifdef __HAVE_ARCH_COPY_FORWARD
+	/* Match copies overlap, but are at least 8 bytes apart by now */
+	if (e - d >= COPY_FORWARD_MIN) {
+		copy_forward(d, s, e - d);
+		return;
+	}
+#endif
+
 	do {
 		LZ4_copy8(d, s);
 		d += 8;
@@ -90,6 +90,12 @@ const struct raid6_calls * const raid6_algos[] = {
 	&raid6_neonx2,
 	&raid6_neonx4,
 	&raid6_neonx8,
+#endif
+#ifdef CONFIG_RISCV
+	&raid6_rvvx1,
+	&raid6_rvvx2,
+	&raid6_rvvx4,
+	&raid6_rvvx8,
 #endif
 	NULL
 };
@@ -115,6 +121,9 @@ const struct raid6_recov_calls *const raid6_recov_algos[] = {
 #endif
 #if defined(CONFIG_KERNEL_MODE_NEON)
 	&raid6_recov_neon,
+#endif
+#ifdef CONFIG_RISCV
+	&raid6_recov_rvv,
 #endif
 	&raid6_recov_intx1,
 	NULL
@@ -0,0 +1,198 @@
+/*
+ * RAID-6 data recovery in dual failure mode using the RISC-V vector
+ * extension
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/raid/pq.h>
+#include "rvv.h"
+
+/*
+ * The GF(2^8) multiplications are two 16-entry table lookups, one per
+ * nibble, done with vrgather.  The tables are loaded with vl = 16, and as
+ * the indices never exceed 15 the rest of the table registers is never
+ * read once vl is raised to cover whole registers.
+ */
+static void __raid6_2data_recov_rvv(size_t bytes, u8 *p, u8 *q, u8 *dp,
+				    u8 *dq, const u8 *pbmul, const u8 *qmul)
+{
+	unsigned long nsize;
+
+	rvv_setvl(16);
+	LOAD(24, qmul);
+	LOAD(25, qmul + 16);
+	LOAD(26, pbmul);
+	LOAD(27, pbmul + 16);
+	nsize = rvv_setvlmax();
+
+	/*
+	 * while ( bytes-- ) {
+	 *	uint8_t px, qx, db;
+	 *
+	 *	px    = *p ^ *dp;
+	 *	qx    = qmul[*q ^ *dq];
+	 *	*dq++ = db = pbmul[px] ^ qx;
+	 *	*dp++ = db ^ px;
+	 *	p++; q++;
+	 * }
+	 */
+	while (bytes) {
+		LOAD(0, p);
+		LOAD(1, dp);
+		XOR(2, 0, 1);		/* px */
+		LOAD(0, q);
+		LOAD(1, dq);
+		XOR(3, 0, 1);
+
+		SHR(4, 3, 4);
+		AND(3, 3, 0x0f);
+		LOOKUP(5, 24, 3);
+		LOOKUP(6, 25, 4);
+		XOR(7, 5, 6);		/* qx */
+
+		SHR(4, 2, 4);
+		AND(3, 2, 0x0f);
+		LOOKUP(5, 26, 3);
+		LOOKUP(6, 27, 4);
+		XOR(5, 5, 6);
+		XOR(8, 5, 7);		/* db */
+
+		STORE(8, dq);
+		XOR(9, 8, 2);
+		STORE(9, dp);
+
+		bytes -= nsize;
+		p += nsize;
+		q += nsize;
+		dp += nsize;
+		dq += nsize;
+	}
+}
+
+static void __raid6_datap_recov_rvv(size_t bytes, u8 *p, u8 *q, u8 *dq,
+				    const u8 *qmul)
+{
+	unsigned long nsize;
+
+	rvv_setvl(16);
+	LOAD(24, qmul);
+	LOAD(25, qmul + 16);
+	nsize = rvv_setvlmax();
+
+	/*
+	 * while (bytes--) {
+	 *	*p++ ^= *dq = qmul[*q ^ *dq];
+	 *	q++; dq++;
+	 * }
+	 */
+	while (bytes) {
+		LOAD(0, q);
+		LOAD(1, dq);
+		XOR(3, 0, 1);
+
+		SHR(4, 3, 4);
+		AND(3, 3, 0x0f);
+		LOOKUP(5, 24, 3);
+		LOOKUP(6, 25, 4);
+		XOR(7, 5, 6);
+
+		LOAD(0, p);
+		XOR(0, 0, 7);
+		STORE(7, dq);
+		STORE(0, p);
+
+		bytes -= nsize;
+		p += nsize;
+		q += nsize;
+		dq += nsize;
+	}
+}
+
+static void raid6_2data_recov_rvv(int disks, size_t bytes, int faila,
+		int failb, void **ptrs)
+{
+	u8 *p, *q, *dp, *dq;
+	const u8 *pbmul;	/* P multiplier table for B data */
+	const u8 *qmul;		/* Q multiplier table (for both) */
+
+	p = (u8 *)ptrs[disks - 2];
+	q = (u8 *)ptrs[disks - 1];
+
+	/*
+	 * Compute syndrome with zero for the missing data pages
+	 * Use the dead data pages as temporary storage for
+	 * delta p and delta q
+	 */
+	dp = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks - 2] = dp;
+	dq = (u8 *)ptrs[failb];
+	ptrs[failb] = (void *)raid6_empty_zero_page;
+	ptrs[disks - 1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]     = dp;
+	ptrs[failb]     = dq;
+	ptrs[disks - 2] = p;
+	ptrs[disks - 1] = q;
+
+	/* Now, pick the proper data tables */
+	pbmul = raid6_vgfmul[raid6_gfexi[failb-faila]];
+	qmul  = raid6_vgfmul[raid6_gfinv[raid6_gfexp[faila] ^
+					 raid6_gfexp[failb]]];
+
+	kernel_vector_begin();
+	__raid6_2data_recov_rvv(bytes, p, q, dp, dq, pbmul, qmul);
+	kernel_vector_end();
+}
+
+static void raid6_datap_recov_rvv(int disks, size_t bytes, int faila,
+		void **ptrs)
+{
+	u8 *p, *q, *dq;
+	const u8 *qmul;		/* Q multiplier table */
+
+	p = (u8 *)ptrs[disks - 2];
+	q = (u8 *)ptrs[disks - 1];
+
+	/*
+	 * Compute syndrome with zero for the missing data page
+	 * Use the dead data page as temporary storage for delta q
+	 */
+	dq = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks - 1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]     = dq;
+	ptrs[disks - 1] = q;
+
+	/* Now, pick the proper data tables */
+	qmul = raid6_vgfmul[raid6_gfinv[raid6_gfexp[faila]]];
+
+	kernel_vector_begin();
+	__raid6_datap_recov_rvv(bytes, p, q, dq, qmul);
+	kernel_vector_end();
+}
+
+static int raid6_has_rvv(void)
+{
+	return has_vector();
+}
+
+const struct raid6_recov_calls raid6_recov_rvv = {
+	.data2		= raid6_2data_recov_rvv,
+	.datap		= raid6_datap_recov_rvv,
+	.valid		= raid6_has_rvv,
+	.name		= "rvv",
+	.priority	= 10,
+};
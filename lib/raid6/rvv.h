@@ -0,0 +1,93 @@
+/*
+ * Vector register helpers shared by the RISC-V RAID6 code
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Vector registers are named by number and don't exist as far as the
+ * compiler is concerned, so the values in them only survive between
+ * these helpers because nothing else in this code touches the vector
+ * unit.  Only call them between kernel_vector_begin() and
+ * kernel_vector_end().
+ */
+
+#ifndef _RAID6_RVV_H
+#define _RAID6_RVV_H
+
+#include <asm/insn-def.h>
+#include <asm/vector.h>
+
+/* Set up 8-bit elements, one register per operand; returns bytes/reg */
+static inline unsigned long rvv_setvl(unsigned long avl)
+{
+	unsigned long vl;
+
+	asm volatile (RVV_VSETVLI_E8M1("%0", "%1") : "=r" (vl) : "r" (avl));
+	return vl;
+}
+
+static inline unsigned long rvv_setvlmax(void)
+{
+	unsigned long vl;
+
+	asm volatile (RVV_VSETVLI_E8M1("%0", "zero") : "=r" (vl));
+	return vl;
+}
+
+static inline void LOAD(int x, const u8 *ptr)
+{
+	asm volatile (RVV_VLE8_V("%0", "%1") : : "i" (x), "r" (ptr) : "memory");
+}
+
+static inline void STORE(int x, u8 *ptr)
+{
+	asm volatile (RVV_VSE8_V("%0", "%1") : : "i" (x), "r" (ptr) : "memory");
+}
+
+static inline void COPY(int x, int y)
+{
+	asm volatile (RVV_VMV_V_V("%0", "%1") : : "i" (x), "i" (y));
+}
+
+static inline void XOR(int x, int y, int z)
+{
+	asm volatile (RVV_VXOR_VV("%0", "%1", "%2")
+		      : : "i" (x), "i" (y), "i" (z));
+}
+
+static inline void AND(int x, int y, unsigned long c)
+{
+	asm volatile (RVV_VAND_VX("%0", "%1", "%2")
+		      : : "i" (x), "i" (y), "r" (c));
+}
+
+/* Each byte of y shifted left (SHL) or right (SHR) into x */
+static inline void SHL(int x, int y, int n)
+{
+	asm volatile (RVV_VSLL_VI("%0", "%1", "%2")
+		      : : "i" (x), "i" (y), "i" (n));
+}
+
+static inline void SHR(int x, int y, int n)
+{
+	asm volatile (RVV_VSRL_VI("%0", "%1", "%2")
+		      : : "i" (x), "i" (y), "i" (n));
+}
+
+/* 0xff for each byte of y with its top bit set, 0x00 otherwise */
+static inline void MASK(int x, int y)
+{
+	asm volatile (RVV_VSRA_VI("%0", "%1", "7") : : "i" (x), "i" (y));
+}
+
+/* x[i] = t[y[i]], for t holding a 16-entry table */
+static inline void LOOKUP(int x, int t, int y)
+{
+	asm volatile (RVV_VRGATHER_VV("%0", "%1", "%2")
+		      : : "i" (x), "i" (t), "i" (y));
+}
+
+#endif /* _RAID6_RVV_H */
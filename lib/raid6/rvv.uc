@@ -0,0 +1,115 @@
+/*
+ * raid6_rvv$#.c
+ *
+ * $#-way unrolled RAID6 gen/xor functions for RISC-V
+ * based on the vector extension
+ *
+ * Copyright (C) 2017 SiFive
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This file is postprocessed using unroll.awk.
+ *
+ * The vector register length is only known at run time, so instead of a
+ * fixed NSIZE each of the $# lanes works on nsize, one register's worth
+ * of bytes.  P accumulates in v0-v7, Q in v8-v15, and v16-v23 hold the
+ * next data block and the multiply-by-2 mask.
+ */
+
+#include <linux/raid/pq.h>
+#include "rvv.h"
+
+static void raid6_rvv$#_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	u8 **dptr, *p, *q;
+	unsigned long d, nsize;
+	int z, z0;
+
+	dptr = (u8 **) ptrs;
+	z0 = disks - 3;		/* Highest data disk */
+	p = dptr[z0 + 1];	/* XOR parity */
+	q = dptr[z0 + 2];	/* RS syndrome */
+
+	kernel_vector_begin();
+	nsize = rvv_setvlmax();
+
+	for (d = 0; d < bytes; d += $# * nsize) {
+		LOAD(0+$$, &dptr[z0][d + $$ * nsize]);
+		COPY(8+$$, 0+$$);
+		for (z = z0 - 1; z >= 0; z--) {
+			MASK(16+$$, 8+$$);
+			AND(16+$$, 16+$$, 0x1d);
+			SHL(8+$$, 8+$$, 1);
+			XOR(8+$$, 8+$$, 16+$$);
+			LOAD(16+$$, &dptr[z][d + $$ * nsize]);
+			XOR(0+$$, 0+$$, 16+$$);
+			XOR(8+$$, 8+$$, 16+$$);
+		}
+		STORE(0+$$, &p[d + $$ * nsize]);
+		STORE(8+$$, &q[d + $$ * nsize]);
+	}
+
+	kernel_vector_end();
+}
+
+static void raid6_rvv$#_xor_syndrome(int disks, int start, int stop,
+				     size_t bytes, void **ptrs)
+{
+	u8 **dptr, *p, *q;
+	unsigned long d, nsize;
+	int z, z0;
+
+	dptr = (u8 **) ptrs;
+	z0 = stop;		/* P/Q right side optimization */
+	p = dptr[disks - 2];	/* XOR parity */
+	q = dptr[disks - 1];	/* RS syndrome */
+
+	kernel_vector_begin();
+	nsize = rvv_setvlmax();
+
+	for (d = 0; d < bytes; d += $# * nsize) {
+		/* P/Q data pages */
+		LOAD(0+$$, &dptr[z0][d + $$ * nsize]);
+		COPY(8+$$, 0+$$);
+		for (z = z0 - 1; z >= start; z--) {
+			MASK(16+$$, 8+$$);
+			AND(16+$$, 16+$$, 0x1d);
+			SHL(8+$$, 8+$$, 1);
+			XOR(8+$$, 8+$$, 16+$$);
+			LOAD(16+$$, &dptr[z][d + $$ * nsize]);
+			XOR(0+$$, 0+$$, 16+$$);
+			XOR(8+$$, 8+$$, 16+$$);
+		}
+		/* P/Q left side optimization */
+		for (z = start - 1; z >= 0; z--) {
+			MASK(16+$$, 8+$$);
+			AND(16+$$, 16+$$, 0x1d);
+			SHL(8+$$, 8+$$, 1);
+			XOR(8+$$, 8+$$, 16+$$);
+		}
+		LOAD(16+$$, &p[d + $$ * nsize]);
+		XOR(16+$$, 16+$$, 0+$$);
+		STORE(16+$$, &p[d + $$ * nsize]);
+		LOAD(16+$$, &q[d + $$ * nsize]);
+		XOR(16+$$, 16+$$, 8+$$);
+		STORE(16+$$, &q[d + $$ * nsize]);
+	}
+
+	kernel_vector_end();
+}
+
+/* A page has to divide evenly between the lanes */
+static int raid6_rvv$#_valid(void)
+{
+	return has_vector() && $# * riscv_v_vsize / 32 <= PAGE_SIZE;
+}
+
+const struct raid6_calls raid6_rvvx$# = {
+	raid6_rvv$#_gen_syndrome,
+	raid6_rvv$#_xor_syndrome,
+	raid6_rvv$#_valid,
+	"rvvx$#",
+	0
+};
@@ -28,10 +28,15 @@
 #include <linux/rhashtable.h>
 #include <linux/err.h>
 #include <linux/export.h>
+#include <linux/ktime.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/rhashtable.h>
 
 #define HASH_DEFAULT_SIZE	64UL
 #define HASH_MIN_SIZE		4U
 #define BUCKET_LOCKS_PER_CPU	32UL
+#define REHASH_HELP_CHAINS	2U
 
 union nested_table {
 	union nested_table __rcu *table;
@@ -255,9 +260,10 @@ static struct bucket_table *rhashtable_last_table(struct rhashtable *ht,
 	return new_tbl;
 }
 
-static int rhashtable_rehash_one(struct rhashtable *ht, unsigned int old_hash)
+static int rhashtable_rehash_one(struct rhashtable *ht,
+				 struct bucket_table *old_tbl,
+				 unsigned int old_hash)
 {
-	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct bucket_table *new_tbl = rhashtable_last_table(ht,
 		rht_dereference_rcu(old_tbl->future_tbl, ht));
 	struct rhash_head __rcu **pprev = rht_bucket_var(old_tbl, old_hash);
@@ -303,28 +309,60 @@ static int rhashtable_rehash_one(struct rhashtable *ht, unsigned int old_hash)
 	return err;
 }
 
+/*
+ * Chains are moved strictly in order, as lookups and inserts rely on the
+ * ones below old_tbl->rehash being done.  Both the worker and helping
+ * inserters pick old_hash from the rehash index, so recheck it under the
+ * bucket lock: whoever loses the race finds the chain moved already.
+ */
 static int rhashtable_rehash_chain(struct rhashtable *ht,
-				    unsigned int old_hash)
+				   struct bucket_table *old_tbl,
+				   unsigned int old_hash)
 {
-	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	spinlock_t *old_bucket_lock;
-	int err;
+	int err = 0;
 
 	old_bucket_lock = rht_bucket_lock(old_tbl, old_hash);
 
 	spin_lock_bh(old_bucket_lock);
-	while (!(err = rhashtable_rehash_one(ht, old_hash)))
+	if (old_tbl->rehash != old_hash)
+		goto out;
+
+	while (!(err = rhashtable_rehash_one(ht, old_tbl, old_hash)))
 		;
 
 	if (err == -ENOENT) {
 		old_tbl->rehash++;
 		err = 0;
 	}
+out:
 	spin_unlock_bh(old_bucket_lock);
 
 	return err;
 }
 
+/*
+ * Inserters that find a resize in progress move a few chains themselves
+ * before retrying, so that under insert churn the old table drains at the
+ * pace of the inserts rather than only as fast as the deferred worker.
+ */
+static void rhashtable_rehash_help(struct rhashtable *ht)
+{
+	struct bucket_table *old_tbl = rht_dereference_rcu(ht->tbl, ht);
+	unsigned int old_hash, i;
+
+	if (!rcu_access_pointer(old_tbl->future_tbl))
+		return;
+
+	for (i = 0; i < REHASH_HELP_CHAINS; i++) {
+		old_hash = READ_ONCE(old_tbl->rehash);
+		if (old_hash >= old_tbl->size ||
+		    rhashtable_rehash_chain(ht, old_tbl, old_hash))
+			break;
+		atomic_inc(&old_tbl->rehash_helped);
+	}
+}
+
 static int rhashtable_rehash_attach(struct rhashtable *ht,
 				    struct bucket_table *old_tbl,
 				    struct bucket_table *new_tbl)
@@ -341,10 +379,13 @@ static int rhashtable_rehash_attach(struct rhashtable *ht,
 	/* Make insertions go into the new, empty table right away. Deletions
 	 * and lookups will be attempted in both tables until we synchronize.
 	 */
+	new_tbl->attach_ns = ktime_get_ns();
 	rcu_assign_pointer(old_tbl->future_tbl, new_tbl);
 
 	spin_unlock_bh(old_tbl->locks);
 
+	trace_rhashtable_rehash_start(ht, old_tbl->size, new_tbl->size);
+
 	return 0;
 }
 
@@ -360,8 +401,8 @@ static int rhashtable_rehash_table(struct rhashtable *ht)
 	if (!new_tbl)
 		return 0;
 
-	for (old_hash = 0; old_hash < old_tbl->size; old_hash++) {
-		err = rhashtable_rehash_chain(ht, old_hash);
+	while ((old_hash = READ_ONCE(old_tbl->rehash)) < old_tbl->size) {
+		err = rhashtable_rehash_chain(ht, old_tbl, old_hash);
 		if (err)
 			return err;
 	}
@@ -369,6 +410,10 @@ static int rhashtable_rehash_table(struct rhashtable *ht)
 	/* Publish the new table pointer. */
 	rcu_assign_pointer(ht->tbl, new_tbl);
 
+	trace_rhashtable_rehash_end(ht, new_tbl->size,
+				    atomic_read(&old_tbl->rehash_helped),
+				    ktime_get_ns() - new_tbl->attach_ns);
+
 	spin_lock(&ht->lock);
 	list_for_each_entry(walker, &old_tbl->walkers, list)
 		walker->tbl = NULL;
@@ -673,6 +718,7 @@ void *rhashtable_insert_slow(struct rhashtable *ht, const void *key,
 
 	do {
 		rcu_read_lock();
+		rhashtable_rehash_help(ht);
 		data = rhashtable_try_insert(ht, key, obj);
 		rcu_read_unlock();
 	} while (PTR_ERR(data) == -EAGAIN);
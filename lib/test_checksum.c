@@ -0,0 +1,191 @@
+/*
+ * Internet checksum correctness check and throughput microbenchmark
+ *
+ * Compares csum_partial(), ip_fast_csum() and csum_ipv6_magic() with a
+ * straightforward 16-bit reference over random data, every start
+ * alignment and a range of lengths, then reports csum_partial()
+ * throughput at typical packet sizes.  Useful when working on
+ * architecture checksum routines.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <net/checksum.h>
+#include <net/ip6_checksum.h>
+
+static unsigned int bytes_per_run = 1 << 22;
+module_param(bytes_per_run, uint, 0);
+MODULE_PARM_DESC(bytes_per_run, "Bytes summed per measurement (default: 4MiB)");
+
+#define MAX_LEN		2048
+#define MAX_OFFSET	8
+
+static const int bench_lens[] = { 20, 40, 64, 256, 576, 1500, MAX_LEN };
+
+/* Ones' complement sum of the little-endian 16-bit words, folded */
+static u32 ref_sum(const u8 *p, int len, u32 sum)
+{
+	u64 s = sum;
+	int i;
+
+	for (i = 0; i + 1 < len; i += 2)
+		s += p[i] | (p[i + 1] << 8);
+	if (len & 1)
+		s += p[len - 1];
+
+	while (s >> 16)
+		s = (s & 0xffff) + (s >> 16);
+	return s;
+}
+
+/* 0x0000 and 0xffff are both zero in ones' complement */
+static bool csum_equal(u32 a, u32 b)
+{
+	return a % 0xffff == b % 0xffff;
+}
+
+static int __init check_csum_partial(u8 *buf)
+{
+	unsigned int off;
+	int len;
+
+	for (off = 0; off < MAX_OFFSET; off++) {
+		for (len = 0; len <= MAX_LEN; len++) {
+			u32 seed = prandom_u32();
+			u32 got = (__force u32)csum_partial(buf + off, len,
+							    (__force __wsum)seed);
+			got = (u16)~(__force u16)csum_fold((__force __wsum)got);
+
+			if (!csum_equal(got, ref_sum(buf + off, len, seed))) {
+				pr_err("csum_partial(buf+%u, %d) = %04x, expected %04x\n",
+				       off, len, got,
+				       ref_sum(buf + off, len, seed));
+				return -EINVAL;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int __init check_ip_fast_csum(u8 *buf)
+{
+	unsigned int off, ihl;
+
+	for (off = 0; off < MAX_OFFSET; off += 4) {
+		for (ihl = 5; ihl <= 15; ihl++) {
+			u32 got = (u16)~(__force u16)ip_fast_csum(buf + off, ihl);
+			u32 want = ref_sum(buf + off, ihl * 4, 0);
+
+			if (!csum_equal(got, want)) {
+				pr_err("ip_fast_csum(buf+%u, %u) = %04x, expected %04x\n",
+				       off, ihl, got, want);
+				return -EINVAL;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int __init check_csum_ipv6_magic(u8 *buf)
+{
+	const struct in6_addr *saddr = (const struct in6_addr *)buf;
+	const struct in6_addr *daddr = saddr + 1;
+	unsigned int i;
+
+	for (i = 0; i < 64; i++) {
+		u32 len = prandom_u32() & 0xffff;
+		u8 proto = prandom_u32();
+		u32 seed = prandom_u32();
+		__be32 pseudo[10];
+		u32 got, want;
+
+		memcpy(pseudo, saddr, sizeof(*saddr));
+		memcpy(pseudo + 4, daddr, sizeof(*daddr));
+		pseudo[8] = htonl(len);
+		pseudo[9] = htonl(proto);
+
+		got = (u16)~(__force u16)csum_ipv6_magic(saddr, daddr, len,
+							 proto,
+							 (__force __wsum)seed);
+		want = ref_sum((const u8 *)pseudo, sizeof(pseudo), seed);
+		if (!csum_equal(got, want)) {
+			pr_err("csum_ipv6_magic(len %u, proto %u) = %04x, expected %04x\n",
+			       len, proto, got, want);
+			return -EINVAL;
+		}
+
+		get_random_bytes(buf, 2 * sizeof(*saddr));
+	}
+
+	return 0;
+}
+
+static u64 __init time_csum_partial(const u8 *buf, int len)
+{
+	unsigned int i, loops = max_t(unsigned int, bytes_per_run / len, 16);
+	__wsum sum = 0;
+	u64 start, ns;
+
+	start = ktime_get_ns();
+	for (i = 0; i < loops; i++)
+		sum = csum_partial(buf, len, sum);
+	ns = ktime_get_ns() - start;
+
+	/* Keep the loop from being optimised away */
+	OPTIMIZER_HIDE_VAR(sum);
+
+	/* MB/s */
+	return ns ? div64_u64((u64)loops * len * 1000, ns) : 0;
+}
+
+static int __init test_checksum_init(void)
+{
+	unsigned int off, i;
+	u8 *buf;
+	int err;
+
+	buf = kmalloc(MAX_LEN + MAX_OFFSET, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	get_random_bytes(buf, MAX_LEN + MAX_OFFSET);
+
+	err = check_csum_partial(buf);
+	if (!err)
+		err = check_ip_fast_csum(buf);
+	if (!err)
+		err = check_csum_ipv6_magic(buf);
+	if (err)
+		goto out;
+
+	pr_info("all checksums correct\n");
+
+	for (off = 0; off < MAX_OFFSET; off += 3) {
+		pr_info("csum_partial buf+%u (MB/s):\n", off);
+		for (i = 0; i < ARRAY_SIZE(bench_lens); i++)
+			pr_info("  %4d: %llu\n", bench_lens[i],
+				time_csum_partial(buf + off, bench_lens[i]));
+	}
+
+out:
+	kfree(buf);
+
+	/* Nothing to keep loaded: fail the load so the test can be rerun */
+	return err ? err : -EAGAIN;
+}
+
+module_init(test_checksum_init);
+MODULE_LICENSE("GPL");
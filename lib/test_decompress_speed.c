@@ -0,0 +1,228 @@
+/*
+ * LZ4 and zstd decompression throughput microbenchmark
+ *
+ * Compresses generated data in page-sized and 128KiB blocks, the sizes
+ * zram and the compressed filesystems work in, checks that each block
+ * decompresses back to the original, then times the decompression and
+ * reports the throughput.  The data mixes literals with matches of all
+ * lengths and distances, down to overlapping ones, so the unaligned
+ * loads and the match copies the decompressors spend their time in are
+ * both exercised.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/lz4.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/zstd.h>
+
+static unsigned int bytes_per_run = 1 << 24;
+module_param(bytes_per_run, uint, 0);
+MODULE_PARM_DESC(bytes_per_run, "Bytes produced per measurement (default: 16MiB)");
+
+static int zstd_level = 3;
+module_param(zstd_level, int, 0);
+MODULE_PARM_DESC(zstd_level, "zstd compression level (default: 3)");
+
+#define MAX_BLOCK	(128 * 1024)
+
+static const size_t block_sizes[] = { PAGE_SIZE, MAX_BLOCK };
+
+enum codec {
+	CODEC_LZ4,
+	CODEC_ZSTD,
+	NR_CODECS,
+};
+
+static const char * const codec_names[NR_CODECS] = {
+	[CODEC_LZ4]	= "lz4",
+	[CODEC_ZSTD]	= "zstd",
+};
+
+static u8 *orig, *comp, *dec;
+static void *lz4_wrkmem, *zstd_cwork, *zstd_dwork;
+static size_t comp_size, zstd_cwork_size;
+static ZSTD_DCtx *dctx;
+
+/*
+ * One run in eight is up to 32 literals, the rest are matches of 4 to 515
+ * bytes from up to 32KiB back, a quarter of them no more than 8 back.
+ * Seeded the same every time, so runs compare.
+ */
+static void fill_input(void)
+{
+	struct rnd_state rnd;
+	size_t pos = 0, len, dist, i;
+	u32 r;
+
+	prandom_seed_state(&rnd, 42);
+	while (pos < MAX_BLOCK) {
+		r = prandom_u32_state(&rnd);
+		if (pos < 8 || !(r & 7)) {
+			len = min_t(size_t, 1 + ((r >> 3) & 31),
+				    MAX_BLOCK - pos);
+			prandom_bytes_state(&rnd, orig + pos, len);
+		} else {
+			len = min_t(size_t, 4 + ((r >> 3) & 511),
+				    MAX_BLOCK - pos);
+			if (!((r >> 12) & 3))
+				dist = 1 + ((r >> 14) & 7);
+			else
+				dist = 1 + ((r >> 14) & 32767);
+			dist = min(dist, pos);
+			for (i = 0; i < len; i++)
+				orig[pos + i] = orig[pos + i - dist];
+		}
+		pos += len;
+	}
+}
+
+static int compress_block(enum codec codec, size_t size, size_t *clen)
+{
+	ZSTD_parameters params;
+	ZSTD_CCtx *cctx;
+	size_t ret;
+	int n;
+
+	if (codec == CODEC_LZ4) {
+		n = LZ4_compress_default((const char *)orig, (char *)comp,
+					 size, comp_size, lz4_wrkmem);
+		if (n <= 0)
+			return -EINVAL;
+		*clen = n;
+		return 0;
+	}
+
+	params = ZSTD_getParams(zstd_level, size, 0);
+	cctx = ZSTD_initCCtx(zstd_cwork, zstd_cwork_size);
+	if (!cctx)
+		return -EINVAL;
+	ret = ZSTD_compressCCtx(cctx, comp, comp_size, orig, size, params);
+	if (ZSTD_isError(ret))
+		return -EINVAL;
+	*clen = ret;
+	return 0;
+}
+
+/* The decompressed length, or 0 on any error */
+static size_t decompress_block(enum codec codec, size_t clen, size_t size)
+{
+	size_t ret;
+	int n;
+
+	if (codec == CODEC_LZ4) {
+		n = LZ4_decompress_safe((const char *)comp, (char *)dec, clen,
+					size);
+		return n > 0 ? n : 0;
+	}
+
+	ret = ZSTD_decompressDCtx(dctx, dec, size, comp, clen);
+	return ZSTD_isError(ret) ? 0 : ret;
+}
+
+static u64 time_block(enum codec codec, size_t clen, size_t size)
+{
+	unsigned int i, loops = max_t(unsigned int, bytes_per_run / size, 16);
+	u64 start, ns;
+
+	/* Warm the caches first */
+	decompress_block(codec, clen, size);
+
+	start = ktime_get_ns();
+	for (i = 0; i < loops; i++)
+		decompress_block(codec, clen, size);
+	ns = ktime_get_ns() - start;
+
+	/* MB/s of decompressed output */
+	return ns ? div64_u64((u64)loops * size * 1000, ns) : 0;
+}
+
+static int test_block(enum codec codec, size_t size)
+{
+	size_t clen, dlen;
+	int err;
+
+	err = compress_block(codec, size, &clen);
+	if (err) {
+		pr_err("%s %zu: compression failed\n", codec_names[codec],
+		       size);
+		return err;
+	}
+
+	memset(dec, 0, MAX_BLOCK);
+	dlen = decompress_block(codec, clen, size);
+	if (dlen != size || memcmp(dec, orig, size)) {
+		pr_err("%s %zu: decompressed %zu bytes, not the original\n",
+		       codec_names[codec], size, dlen);
+		return -EINVAL;
+	}
+
+	pr_info("%s %6zu -> %6zu: %llu MB/s\n", codec_names[codec], size,
+		clen, time_block(codec, clen, size));
+	return 0;
+}
+
+static int __init test_decompress_speed_init(void)
+{
+	ZSTD_parameters params = ZSTD_getParams(zstd_level, MAX_BLOCK, 0);
+	size_t zstd_dwork_size = ZSTD_DCtxWorkspaceBound();
+	unsigned int codec, s;
+	int err = 0;
+
+	comp_size = max_t(size_t, LZ4_compressBound(MAX_BLOCK),
+			  ZSTD_compressBound(MAX_BLOCK));
+	zstd_cwork_size = ZSTD_CCtxWorkspaceBound(params.cParams);
+
+	orig = vmalloc(MAX_BLOCK);
+	comp = vmalloc(comp_size);
+	dec = vmalloc(MAX_BLOCK);
+	lz4_wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	zstd_cwork = vmalloc(zstd_cwork_size);
+	zstd_dwork = vmalloc(zstd_dwork_size);
+	if (!orig || !comp || !dec || !lz4_wrkmem || !zstd_cwork ||
+	    !zstd_dwork) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	dctx = ZSTD_initDCtx(zstd_dwork, zstd_dwork_size);
+	if (!dctx) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	fill_input();
+
+	for (codec = 0; codec < NR_CODECS; codec++) {
+		for (s = 0; s < ARRAY_SIZE(block_sizes); s++) {
+			err = test_block(codec, block_sizes[s]);
+			if (err)
+				goto out;
+		}
+	}
+
+out:
+	vfree(zstd_dwork);
+	vfree(zstd_cwork);
+	vfree(lz4_wrkmem);
+	vfree(dec);
+	vfree(comp);
+	vfree(orig);
+
+	/* Nothing to keep loaded: fail the load so the test can be rerun */
+	return err ? err : -EAGAIN;
+}
+
+module_init(test_decompress_speed_init);
+MODULE_LICENSE("GPL");
@@ -0,0 +1,312 @@
+/*
+ * RISC-V context switch, IPI and SBI latency microbenchmarks
+ *
+ * Times the operations whose cost is specific to the RISC-V port: a
+ * kthread ping-pong on one hart and across two, smp_call_function_single()
+ * round trips, the SBI remote fences behind TLB shootdowns and icache
+ * flushes next to their local equivalents, and a timer reprogram through
+ * sbi_set_timer().  Every figure is in cycles of the cycle CSR, so runs
+ * on the same hardware can be compared before and after a change.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/init.h>
+#include <linux/irqflags.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/smp.h>
+#include <linux/workqueue.h>
+
+#include <asm/cacheflush.h>
+#include <asm/sbi.h>
+#include <asm/timex.h>
+#include <asm/tlbflush.h>
+
+static unsigned int iterations = 10000;
+module_param(iterations, uint, 0);
+MODULE_PARM_DESC(iterations, "Samples taken of each operation (default: 10000)");
+
+static int cpu_a = -1;
+module_param(cpu_a, int, 0);
+MODULE_PARM_DESC(cpu_a, "CPU the measurements are taken on (default: first online)");
+
+static int cpu_b = -1;
+module_param(cpu_b, int, 0);
+MODULE_PARM_DESC(cpu_b, "Remote CPU for the cross-hart tests (default: next online)");
+
+struct latency {
+	u64 min;
+	u64 total;
+	unsigned long samples;
+};
+
+/* get_cycles() reads the time CSR: the cost of a change is in cycles */
+static inline u64 read_cycles(void)
+{
+#ifdef CONFIG_64BIT
+	unsigned long n;
+
+	__asm__ __volatile__ ("rdcycle %0" : "=r" (n));
+	return n;
+#else
+	u32 lo, hi, tmp;
+
+	__asm__ __volatile__ (
+		"1:\n"
+		"rdcycleh %0\n"
+		"rdcycle %1\n"
+		"rdcycleh %2\n"
+		"bne %0, %2, 1b"
+		: "=&r" (hi), "=&r" (lo), "=&r" (tmp));
+	return ((u64)hi << 32) | lo;
+#endif
+}
+
+static void latency_init(struct latency *lat)
+{
+	lat->min = U64_MAX;
+	lat->total = 0;
+	lat->samples = 0;
+}
+
+static void latency_add(struct latency *lat, u64 start)
+{
+	u64 delta = read_cycles() - start;
+
+	lat->min = min(lat->min, delta);
+	lat->total += delta;
+	lat->samples++;
+}
+
+static void latency_report(const char *name, struct latency *lat)
+{
+	if (!lat->samples)
+		return;
+
+	pr_info("%-28s min %8llu avg %8llu cycles\n", name, lat->min,
+		div64_u64(lat->total, lat->samples));
+}
+
+/*
+ * Two kthreads hand a token back and forth: each round trip is two
+ * wakeups and, on a single hart, two context switches.
+ */
+struct pingpong {
+	struct completion ping;
+	struct completion pong;
+	struct completion done;
+	struct latency lat;
+};
+
+static int pingpong_server(void *data)
+{
+	struct pingpong *pp = data;
+	unsigned int i;
+
+	for (i = 0; i < iterations; i++) {
+		wait_for_completion(&pp->ping);
+		complete(&pp->pong);
+	}
+
+	complete(&pp->done);
+	while (!kthread_should_stop())
+		schedule_timeout_interruptible(1);
+	return 0;
+}
+
+static int pingpong_client(void *data)
+{
+	struct pingpong *pp = data;
+	unsigned int i;
+
+	for (i = 0; i < iterations; i++) {
+		u64 t0 = read_cycles();
+
+		complete(&pp->ping);
+		wait_for_completion(&pp->pong);
+		latency_add(&pp->lat, t0);
+	}
+
+	complete(&pp->done);
+	while (!kthread_should_stop())
+		schedule_timeout_interruptible(1);
+	return 0;
+}
+
+static void bench_pingpong(const char *name, int client_cpu, int server_cpu)
+{
+	struct task_struct *client, *server;
+	struct pingpong pp;
+
+	init_completion(&pp.ping);
+	init_completion(&pp.pong);
+	init_completion(&pp.done);
+	latency_init(&pp.lat);
+
+	server = kthread_create_on_cpu(pingpong_server, &pp, server_cpu,
+				       "pingpong_srv/%u");
+	if (IS_ERR(server))
+		return;
+
+	client = kthread_create_on_cpu(pingpong_client, &pp, client_cpu,
+				       "pingpong_cli/%u");
+	if (IS_ERR(client)) {
+		/* Never woken, it is stopped before it runs */
+		kthread_stop(server);
+		return;
+	}
+
+	wake_up_process(server);
+	wake_up_process(client);
+	wait_for_completion(&pp.done);
+	wait_for_completion(&pp.done);
+	kthread_stop(client);
+	kthread_stop(server);
+
+	latency_report(name, &pp.lat);
+}
+
+static void ipi_nop(void *info)
+{
+}
+
+/* The remote side only has to run the handler for the call to return */
+static long bench_ipi(void *data)
+{
+	int target = *(int *)data;
+	struct latency lat;
+	unsigned int i;
+
+	latency_init(&lat);
+	for (i = 0; i < iterations; i++) {
+		u64 t0 = read_cycles();
+
+		if (smp_call_function_single(target, ipi_nop, NULL, 1))
+			break;
+		latency_add(&lat, t0);
+	}
+
+	latency_report("smp_call_function_single", &lat);
+	return 0;
+}
+
+static struct cpumask remote_harts;
+
+/*
+ * What a one-page kernel TLB shootdown or an icache flush costs in the
+ * SBI, set against doing the same only on this hart.
+ */
+static long bench_fences(void *data)
+{
+	unsigned long addr = (unsigned long)&remote_harts;
+	struct latency local, remote;
+	unsigned int i;
+
+	cpumask_copy(&remote_harts, cpu_online_mask);
+	cpumask_clear_cpu(smp_processor_id(), &remote_harts);
+
+	latency_init(&local);
+	latency_init(&remote);
+	for (i = 0; i < iterations; i++) {
+		u64 t0 = read_cycles();
+
+		local_flush_tlb_page(addr);
+		latency_add(&local, t0);
+
+		if (cpumask_empty(&remote_harts))
+			continue;
+		t0 = read_cycles();
+		sbi_remote_sfence_vma(&remote_harts, addr & PAGE_MASK,
+				      PAGE_SIZE);
+		latency_add(&remote, t0);
+	}
+	latency_report("local sfence.vma (page)", &local);
+	latency_report("SBI remote sfence.vma (page)", &remote);
+
+	latency_init(&local);
+	latency_init(&remote);
+	for (i = 0; i < iterations; i++) {
+		u64 t0 = read_cycles();
+
+		local_flush_icache_all();
+		latency_add(&local, t0);
+
+		if (cpumask_empty(&remote_harts))
+			continue;
+		t0 = read_cycles();
+		sbi_remote_fence_i(&remote_harts);
+		latency_add(&remote, t0);
+	}
+	latency_report("local fence.i", &local);
+	latency_report("SBI remote fence.i", &remote);
+
+	return 0;
+}
+
+/*
+ * The deadlines set are 2^32 ticks away, with interrupts off.  Setting one
+ * that has already passed at the end raises an interrupt as soon as they
+ * are back on, which hands the hart back to its clockevent device.
+ */
+static long bench_timer(void *data)
+{
+	struct latency lat;
+	unsigned long flags;
+	unsigned int i;
+
+	latency_init(&lat);
+	local_irq_save(flags);
+	for (i = 0; i < iterations; i++) {
+		u64 t0 = read_cycles();
+
+		sbi_set_timer(get_cycles64() + U32_MAX);
+		latency_add(&lat, t0);
+	}
+	sbi_set_timer(get_cycles64());
+	local_irq_restore(flags);
+
+	latency_report("sbi_set_timer", &lat);
+	return 0;
+}
+
+static int __init test_riscv_latency_init(void)
+{
+	get_online_cpus();
+
+	if (cpu_a < 0 || !cpu_online(cpu_a))
+		cpu_a = cpumask_first(cpu_online_mask);
+	if (cpu_b < 0 || !cpu_online(cpu_b) || cpu_b == cpu_a) {
+		cpu_b = cpumask_next(cpu_a, cpu_online_mask);
+		if (cpu_b >= nr_cpu_ids)
+			cpu_b = cpumask_first(cpu_online_mask);
+	}
+
+	pr_info("%u iterations on CPU%d, remote CPU%d\n", iterations,
+		cpu_a, cpu_b);
+
+	bench_pingpong("kthread ping-pong, one hart", cpu_a, cpu_a);
+	if (cpu_b != cpu_a) {
+		bench_pingpong("kthread ping-pong, two harts", cpu_a, cpu_b);
+		work_on_cpu(cpu_a, bench_ipi, &cpu_b);
+	}
+	work_on_cpu(cpu_a, bench_fences, NULL);
+	work_on_cpu(cpu_a, bench_timer, NULL);
+
+	put_online_cpus();
+
+	/* Nothing to keep loaded: fail the load so the test can be rerun */
+	return -EAGAIN;
+}
+
+module_init(test_riscv_latency_init);
+MODULE_LICENSE("GPL");
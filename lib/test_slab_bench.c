@@ -0,0 +1,258 @@
+/*
+ * Slab allocator microbenchmark
+ *
+ * One kthread per online CPU allocates and frees objects from the same
+ * cache at once, first one object at a time, then in batches that
+ * overflow any per cpu caching, then through the bulk API.  Each
+ * pattern is run against a plain cache and against one created with
+ * SLAB_SHEAVES, and the average cost per object is reported.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/delay.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/sched/clock.h>
+#include <linux/slab.h>
+
+static unsigned int object_size = 256;
+module_param(object_size, uint, 0);
+MODULE_PARM_DESC(object_size, "Size of the benchmarked objects (default: 256)");
+
+static unsigned int batch = 256;
+module_param(batch, uint, 0);
+MODULE_PARM_DESC(batch, "Objects held at once in the batch runs (default: 256)");
+
+static unsigned int loops = 1000;
+module_param(loops, uint, 0);
+MODULE_PARM_DESC(loops, "Batches per thread and run (default: 1000)");
+
+static unsigned int nthreads;
+module_param(nthreads, uint, 0);
+MODULE_PARM_DESC(nthreads, "Number of CPUs allocating at once (default: all online)");
+
+enum bench_pattern {
+	BENCH_SINGLE,		/* alloc and free back to back */
+	BENCH_BATCH,		/* alloc a batch one by one, then free it */
+	BENCH_BULK,		/* the same through the bulk API */
+	NR_BENCH_PATTERNS
+};
+
+static const char * const bench_names[NR_BENCH_PATTERNS] = {
+	"single", "batch", "bulk",
+};
+
+struct bench_thread {
+	struct task_struct *task;
+	void **objects;
+	u64 ns;
+	unsigned long nr;
+	int err;
+};
+
+static struct kmem_cache *bench_cache;
+static enum bench_pattern bench_pattern;
+
+static atomic_t threads_ready;
+static atomic_t threads_done;
+static bool start_running;
+static DECLARE_COMPLETION(all_done);
+
+static int bench_run(struct bench_thread *t)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < loops; i++) {
+		switch (bench_pattern) {
+		case BENCH_SINGLE:
+			for (j = 0; j < batch; j++) {
+				void *object;
+
+				object = kmem_cache_alloc(bench_cache,
+							  GFP_KERNEL);
+				if (!object)
+					return -ENOMEM;
+				kmem_cache_free(bench_cache, object);
+			}
+			break;
+		case BENCH_BATCH:
+			for (j = 0; j < batch; j++) {
+				t->objects[j] = kmem_cache_alloc(bench_cache,
+								 GFP_KERNEL);
+				if (!t->objects[j]) {
+					while (j--)
+						kmem_cache_free(bench_cache,
+								t->objects[j]);
+					return -ENOMEM;
+				}
+			}
+			for (j = 0; j < batch; j++)
+				kmem_cache_free(bench_cache, t->objects[j]);
+			break;
+		case BENCH_BULK:
+			if (!kmem_cache_alloc_bulk(bench_cache, GFP_KERNEL,
+						   batch, t->objects))
+				return -ENOMEM;
+			kmem_cache_free_bulk(bench_cache, batch, t->objects);
+			break;
+		default:
+			return -EINVAL;
+		}
+		t->nr += batch;
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *t = data;
+	u64 t0;
+
+	atomic_inc(&threads_ready);
+	while (!READ_ONCE(start_running))
+		cpu_relax();
+
+	t0 = local_clock();
+	t->err = bench_run(t);
+	t->ns = local_clock() - t0;
+
+	if (atomic_inc_return(&threads_done) == nthreads)
+		complete(&all_done);
+
+	while (!kthread_should_stop())
+		schedule_timeout_interruptible(1);
+
+	return 0;
+}
+
+static int bench_one(struct kmem_cache *cache, enum bench_pattern pattern,
+		     struct bench_thread *threads)
+{
+	unsigned long nr = 0;
+	unsigned int i = 0;
+	u64 ns = 0;
+	int cpu, err = 0;
+
+	bench_cache = cache;
+	bench_pattern = pattern;
+	atomic_set(&threads_ready, 0);
+	atomic_set(&threads_done, 0);
+	WRITE_ONCE(start_running, false);
+	reinit_completion(&all_done);
+
+	for_each_online_cpu(cpu) {
+		struct bench_thread *t = &threads[i];
+		struct task_struct *task;
+
+		if (i == nthreads)
+			break;
+
+		t->ns = 0;
+		t->nr = 0;
+		t->err = 0;
+		task = kthread_create_on_cpu(bench_thread_fn, t, cpu,
+					     "slab_bench/%u");
+		if (IS_ERR(task)) {
+			err = PTR_ERR(task);
+			break;
+		}
+		t->task = task;
+		wake_up_process(task);
+		i++;
+	}
+
+	/* threads that did start still have to run to completion */
+	if (i != nthreads)
+		atomic_add(nthreads - i, &threads_done);
+
+	while (atomic_read(&threads_ready) != i)
+		msleep(1);
+
+	smp_wmb();
+	WRITE_ONCE(start_running, true);
+
+	if (i)
+		wait_for_completion(&all_done);
+
+	while (i--) {
+		struct bench_thread *t = &threads[i];
+
+		kthread_stop(t->task);
+		if (t->err)
+			err = t->err;
+		ns += t->ns;
+		nr += t->nr;
+	}
+
+	if (!err && nr)
+		pr_info("%-16s %-6s: %llu ns/object\n", cache->name,
+			bench_names[pattern], div64_u64(ns, nr));
+
+	return err;
+}
+
+static int __init test_slab_bench_init(void)
+{
+	struct kmem_cache *caches[2];
+	struct bench_thread *threads;
+	enum bench_pattern pattern;
+	unsigned int i;
+	int err = -ENOMEM;
+
+	if (!nthreads || nthreads > num_online_cpus())
+		nthreads = num_online_cpus();
+	if (!batch)
+		batch = 1;
+
+	threads = kcalloc(nthreads, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	for (i = 0; i < nthreads; i++) {
+		threads[i].objects = kcalloc(batch, sizeof(void *),
+					     GFP_KERNEL);
+		if (!threads[i].objects)
+			goto out_free;
+	}
+
+	caches[0] = kmem_cache_create("slab_bench", object_size, 0, 0, NULL);
+	caches[1] = kmem_cache_create("slab_bench_sheaves", object_size, 0,
+				      SLAB_SHEAVES, NULL);
+	if (!caches[0] || !caches[1])
+		goto out_destroy;
+
+	pr_info("%u threads, %u byte objects, %u loops of %u\n",
+		nthreads, object_size, loops, batch);
+
+	err = 0;
+	for (pattern = 0; pattern < NR_BENCH_PATTERNS && !err; pattern++)
+		for (i = 0; i < ARRAY_SIZE(caches) && !err; i++)
+			err = bench_one(caches[i], pattern, threads);
+
+out_destroy:
+	kmem_cache_destroy(caches[1]);
+	kmem_cache_destroy(caches[0]);
+out_free:
+	for (i = 0; i < nthreads; i++)
+		kfree(threads[i].objects);
+	kfree(threads);
+
+	/* Nothing to keep loaded: fail the load so the test can be rerun */
+	return err ? err : -EAGAIN;
+}
+
+module_init(test_slab_bench_init);
+MODULE_LICENSE("GPL");
@@ -0,0 +1,162 @@
+/*
+ * Spinlock contention microbenchmark
+ *
+ * One kthread per online CPU hammers a single spinlock for a fixed amount
+ * of time.  Reports the total acquisition rate, the spread between the
+ * luckiest and unluckiest CPU (a fair lock keeps these close) and the
+ * worst-case time a CPU spent waiting for the lock.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/delay.h>
+#include <linux/init.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/sched/clock.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+static unsigned int duration_ms = 1000;
+module_param(duration_ms, uint, 0);
+MODULE_PARM_DESC(duration_ms, "Length of each run in milliseconds (default: 1000)");
+
+static unsigned int hold_ns = 100;
+module_param(hold_ns, uint, 0);
+MODULE_PARM_DESC(hold_ns, "Time spent inside the critical section (default: 100)");
+
+static unsigned int nthreads;
+module_param(nthreads, uint, 0);
+MODULE_PARM_DESC(nthreads, "Number of contending CPUs (default: all online)");
+
+struct contention_thread {
+	struct task_struct *task;
+	unsigned long acquisitions;
+	u64 wait_ns;
+	u64 max_wait_ns;
+};
+
+static DEFINE_SPINLOCK(contended_lock);
+static unsigned long lock_owner_count;
+
+static atomic_t threads_ready;
+static atomic_t threads_done;
+static bool start_running;
+static unsigned long stop_at;
+static DECLARE_COMPLETION(all_done);
+
+static int contention_thread_fn(void *data)
+{
+	struct contention_thread *t = data;
+
+	atomic_inc(&threads_ready);
+	while (!READ_ONCE(start_running))
+		cpu_relax();
+
+	while (time_before(jiffies, READ_ONCE(stop_at))) {
+		u64 t0, waited;
+
+		t0 = local_clock();
+		spin_lock(&contended_lock);
+		waited = local_clock() - t0;
+
+		lock_owner_count++;
+		if (hold_ns)
+			ndelay(hold_ns);
+		spin_unlock(&contended_lock);
+
+		t->acquisitions++;
+		t->wait_ns += waited;
+		if (waited > t->max_wait_ns)
+			t->max_wait_ns = waited;
+
+		cond_resched();
+	}
+
+	if (atomic_inc_return(&threads_done) == nthreads)
+		complete(&all_done);
+
+	while (!kthread_should_stop())
+		schedule_timeout_interruptible(1);
+
+	return 0;
+}
+
+static int __init test_spinlock_contention_init(void)
+{
+	struct contention_thread *threads;
+	unsigned long total = 0, min = ULONG_MAX, max = 0;
+	u64 wait = 0, max_wait = 0;
+	unsigned int i = 0;
+	int cpu, err = 0;
+
+	if (!nthreads || nthreads > num_online_cpus())
+		nthreads = num_online_cpus();
+
+	threads = kcalloc(nthreads, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	for_each_online_cpu(cpu) {
+		struct task_struct *task;
+
+		if (i == nthreads)
+			break;
+
+		task = kthread_create_on_cpu(contention_thread_fn, &threads[i],
+					     cpu, "lock_contend/%u");
+		if (IS_ERR(task)) {
+			err = PTR_ERR(task);
+			nthreads = i;
+			break;
+		}
+		threads[i++].task = task;
+		wake_up_process(task);
+	}
+
+	while (atomic_read(&threads_ready) != nthreads)
+		msleep(1);
+
+	WRITE_ONCE(stop_at, jiffies + msecs_to_jiffies(duration_ms));
+	smp_wmb();
+	WRITE_ONCE(start_running, true);
+
+	if (nthreads)
+		wait_for_completion(&all_done);
+
+	for (i = 0; i < nthreads; i++) {
+		struct contention_thread *t = &threads[i];
+
+		kthread_stop(t->task);
+		total += t->acquisitions;
+		wait += t->wait_ns;
+		min = min(min, t->acquisitions);
+		max = max(max, t->acquisitions);
+		max_wait = max(max_wait, t->max_wait_ns);
+	}
+
+	if (total) {
+		pr_info("%u threads, %u ms, hold %u ns: %lu acquisitions (%lu in lock)\n",
+			nthreads, duration_ms, hold_ns, total, lock_owner_count);
+		pr_info("per-thread min %lu max %lu, avg wait %llu ns, max wait %llu ns\n",
+			min, max, div64_u64(wait, total), max_wait);
+	}
+
+	kfree(threads);
+
+	/* Nothing to keep loaded: fail the load so the test can be rerun */
+	return err ? err : -EAGAIN;
+}
+
+module_init(test_spinlock_contention_init);
+MODULE_LICENSE("GPL");
@@ -0,0 +1,221 @@
+/*
+ * memcpy/memmove/memset throughput microbenchmark
+ *
+ * Checks each routine against a byte-at-a-time reference, then times it
+ * across a range of sizes and source/destination misalignments and
+ * reports the throughput.  Useful to compare architecture string
+ * routines, which tend to have separate paths for small, co-aligned and
+ * mutually misaligned buffers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+static unsigned int bytes_per_run = 1 << 22;
+module_param(bytes_per_run, uint, 0);
+MODULE_PARM_DESC(bytes_per_run, "Bytes moved per measurement (default: 4MiB)");
+
+#define MAX_SIZE	65536
+#define MAX_OFFSET	8
+
+static const size_t sizes[] = {
+	8, 16, 31, 64, 100, 128, 256, 512, 1500, 4096, MAX_SIZE,
+};
+
+static const struct {
+	unsigned int dst, src;
+} offsets[] = {
+	{ 0, 0 }, { 3, 3 }, { 0, 1 }, { 1, 0 }, { 3, 7 }, { 4, 0 },
+};
+
+enum string_op {
+	OP_MEMCPY,
+	OP_MEMMOVE_UP,		/* dst above and overlapping src */
+	OP_MEMMOVE_DOWN,	/* dst below and overlapping src */
+	OP_MEMSET,
+	NR_OPS,
+};
+
+static const char * const op_names[NR_OPS] = {
+	[OP_MEMCPY]		= "memcpy",
+	[OP_MEMMOVE_UP]		= "memmove up",
+	[OP_MEMMOVE_DOWN]	= "memmove down",
+	[OP_MEMSET]		= "memset",
+};
+
+/* Room for the copy, its overlap and the guard bytes either side */
+#define BUF_SIZE	(2 * MAX_SIZE + 4 * MAX_OFFSET)
+
+static u8 *buf, *ref;
+
+static void setup_op(enum string_op op, size_t size, unsigned int doff,
+		     unsigned int soff, u8 **dst, u8 **src)
+{
+	u8 *base = buf + MAX_OFFSET;
+
+	switch (op) {
+	case OP_MEMCPY:
+	case OP_MEMSET:
+		*dst = base + doff;
+		*src = base + MAX_SIZE + 2 * MAX_OFFSET + soff;
+		break;
+	case OP_MEMMOVE_UP:
+		*src = base + soff;
+		*dst = *src + size / 2 + doff + 1;
+		break;
+	case OP_MEMMOVE_DOWN:
+		*dst = base + doff;
+		*src = *dst + size / 2 + soff + 1;
+		break;
+	default:
+		BUG();
+	}
+}
+
+static void do_op(enum string_op op, u8 *dst, u8 *src, size_t size)
+{
+	switch (op) {
+	case OP_MEMCPY:
+		memcpy(dst, src, size);
+		break;
+	case OP_MEMMOVE_UP:
+	case OP_MEMMOVE_DOWN:
+		memmove(dst, src, size);
+		break;
+	case OP_MEMSET:
+		memset(dst, 0x5a, size);
+		break;
+	default:
+		BUG();
+	}
+}
+
+static void ref_op(enum string_op op, u8 *dst, u8 *src, size_t size)
+{
+	size_t i;
+
+	switch (op) {
+	case OP_MEMCPY:
+	case OP_MEMMOVE_DOWN:
+		for (i = 0; i < size; i++)
+			dst[i] = src[i];
+		break;
+	case OP_MEMMOVE_UP:
+		for (i = size; i-- > 0; )
+			dst[i] = src[i];
+		break;
+	case OP_MEMSET:
+		for (i = 0; i < size; i++)
+			dst[i] = 0x5a;
+		break;
+	default:
+		BUG();
+	}
+}
+
+static int check_op(enum string_op op, size_t size, unsigned int doff,
+		    unsigned int soff)
+{
+	u8 *dst, *src;
+	size_t i;
+
+	get_random_bytes(buf, BUF_SIZE);
+	memcpy(ref, buf, BUF_SIZE);
+
+	setup_op(op, size, doff, soff, &dst, &src);
+	do_op(op, dst, src, size);
+	ref_op(op, ref + (dst - buf), ref + (src - buf), size);
+
+	for (i = 0; i < BUF_SIZE; i++) {
+		if (buf[i] != ref[i]) {
+			pr_err("%s size %zu dst+%u src+%u: byte %zd is %02x, expected %02x\n",
+			       op_names[op], size, doff, soff,
+			       (ssize_t)(buf + i - dst), buf[i], ref[i]);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static u64 time_op(enum string_op op, size_t size, unsigned int doff,
+		   unsigned int soff)
+{
+	unsigned int i, loops = max_t(unsigned int, bytes_per_run / size, 16);
+	u8 *dst, *src;
+	u64 start, ns;
+
+	setup_op(op, size, doff, soff, &dst, &src);
+
+	/* Warm the caches first */
+	do_op(op, dst, src, size);
+
+	start = ktime_get_ns();
+	for (i = 0; i < loops; i++)
+		do_op(op, dst, src, size);
+	ns = ktime_get_ns() - start;
+
+	/* MB/s */
+	return ns ? div64_u64((u64)loops * size * 1000, ns) : 0;
+}
+
+static int __init test_string_speed_init(void)
+{
+	unsigned int op, s, o;
+	int err = 0;
+
+	buf = kmalloc(BUF_SIZE, GFP_KERNEL);
+	ref = kmalloc(BUF_SIZE, GFP_KERNEL);
+	if (!buf || !ref) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (op = 0; op < NR_OPS; op++) {
+		for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+			for (o = 0; o < ARRAY_SIZE(offsets); o++) {
+				err = check_op(op, sizes[s], offsets[o].dst,
+					       offsets[o].src);
+				if (err)
+					goto out;
+			}
+		}
+	}
+
+	for (op = 0; op < NR_OPS; op++) {
+		for (o = 0; o < ARRAY_SIZE(offsets); o++) {
+			/* Only the destination offset matters to memset */
+			if (op == OP_MEMSET && offsets[o].src)
+				continue;
+
+			pr_info("%s dst+%u src+%u (MB/s):\n", op_names[op],
+				offsets[o].dst, offsets[o].src);
+			for (s = 0; s < ARRAY_SIZE(sizes); s++)
+				pr_info("  %6zu: %llu\n", sizes[s],
+					time_op(op, sizes[s], offsets[o].dst,
+						offsets[o].src));
+		}
+	}
+
+out:
+	kfree(ref);
+	kfree(buf);
+
+	/* Nothing to keep loaded: fail the load so the test can be rerun */
+	return err ? err : -EAGAIN;
+}
+
+module_init(test_string_speed_init);
+MODULE_LICENSE("GPL");
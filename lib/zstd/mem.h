@@ -24,6 +24,12 @@
 #include <linux/string.h> /* memcpy */
 #include <linux/types.h>  /* size_t, ptrdiff_t */
 
+/* See lib/lz4/lz4defs.h */
+#ifndef get_unaligned_fast
+#define get_unaligned_fast(ptr) get_unaligned(ptr)
+#define put_unaligned_fast(val, ptr) put_unaligned(val, ptr)
+#endif
+
 /*-****************************************
 *  Compiler specifics
 ******************************************/
@@ -56,25 +62,31 @@ ZSTD_STATIC unsigned ZSTD_64bits(void) { return sizeof(size_t) == 8; }
 
 ZSTD_STATIC unsigned ZSTD_isLittleEndian(void) { return ZSTD_LITTLE_ENDIAN; }
 
-ZSTD_STATIC U16 ZSTD_read16(const void *memPtr) { return get_unaligned((const U16 *)memPtr); }
+ZSTD_STATIC U16 ZSTD_read16(const void *memPtr) { return get_unaligned_fast((const U16 *)memPtr); }
 
-ZSTD_STATIC U32 ZSTD_read32(const void *memPtr) { return get_unaligned((const U32 *)memPtr); }
+ZSTD_STATIC U32 ZSTD_read32(const void *memPtr) { return get_unaligned_fast((const U32 *)memPtr); }
 
-ZSTD_STATIC U64 ZSTD_read64(const void *memPtr) { return get_unaligned((const U64 *)memPtr); }
+ZSTD_STATIC U64 ZSTD_read64(const void *memPtr) { return get_unaligned_fast((const U64 *)memPtr); }
 
-ZSTD_STATIC size_t ZSTD_readST(const void *memPtr) { return get_unaligned((const size_t *)memPtr); }
+ZSTD_STATIC size_t ZSTD_readST(const void *memPtr) { return get_unaligned_fast((const size_t *)memPtr); }
 
-ZSTD_STATIC void ZSTD_write16(void *memPtr, U16 value) { put_unaligned(value, (U16 *)memPtr); }
+ZSTD_STATIC void ZSTD_write16(void *memPtr, U16 value) { put_unaligned_fast(value, (U16 *)memPtr); }
 
-ZSTD_STATIC void ZSTD_write32(void *memPtr, U32 value) { put_unaligned(value, (U32 *)memPtr); }
+ZSTD_STATIC void ZSTD_write32(void *memPtr, U32 value) { put_unaligned_fast(value, (U32 *)memPtr); }
 
-ZSTD_STATIC void ZSTD_write64(void *memPtr, U64 value) { put_unaligned(value, (U64 *)memPtr); }
+ZSTD_STATIC void ZSTD_write64(void *memPtr, U64 value) { put_unaligned_fast(value, (U64 *)memPtr); }
 
 /*=== Little endian r/w ===*/
 
-ZSTD_STATIC U16 ZSTD_readLE16(const void *memPtr) { return get_unaligned_le16(memPtr); }
+ZSTD_STATIC U16 ZSTD_readLE16(const void *memPtr) { return ZSTD_isLittleEndian() ? ZSTD_read16(memPtr) : get_unaligned_le16(memPtr); }
 
-ZSTD_STATIC void ZSTD_writeLE16(void *memPtr, U16 val) { put_unaligned_le16(val, memPtr); }
+ZSTD_STATIC void ZSTD_writeLE16(void *memPtr, U16 val)
+{
+	if (ZSTD_isLittleEndian())
+		ZSTD_write16(memPtr, val);
+	else
+		put_unaligned_le16(val, memPtr);
+}
 
 ZSTD_STATIC U32 ZSTD_readLE24(const void *memPtr) { return ZSTD_readLE16(memPtr) + (((const BYTE *)memPtr)[2] << 16); }
 
@@ -84,13 +96,25 @@ ZSTD_STATIC void ZSTD_writeLE24(void *memPtr, U32 val)
 	((BYTE *)memPtr)[2] = (BYTE)(val >> 16);
 }
 
-ZSTD_STATIC U32 ZSTD_readLE32(const void *memPtr) { return get_unaligned_le32(memPtr); }
+ZSTD_STATIC U32 ZSTD_readLE32(const void *memPtr) { return ZSTD_isLittleEndian() ? ZSTD_read32(memPtr) : get_unaligned_le32(memPtr); }
 
-ZSTD_STATIC void ZSTD_writeLE32(void *memPtr, U32 val32) { put_unaligned_le32(val32, memPtr); }
+ZSTD_STATIC void ZSTD_writeLE32(void *memPtr, U32 val32)
+{
+	if (ZSTD_isLittleEndian())
+		ZSTD_write32(memPtr, val32);
+	else
+		put_unaligned_le32(val32, memPtr);
+}
 
-ZSTD_STATIC U64 ZSTD_readLE64(const void *memPtr) { return get_unaligned_le64(memPtr); }
+ZSTD_STATIC U64 ZSTD_readLE64(const void *memPtr) { return ZSTD_isLittleEndian() ? ZSTD_read64(memPtr) : get_unaligned_le64(memPtr); }
 
-ZSTD_STATIC void ZSTD_writeLE64(void *memPtr, U64 val64) { put_unaligned_le64(val64, memPtr); }
+ZSTD_STATIC void ZSTD_writeLE64(void *memPtr, U64 val64)
+{
+	if (ZSTD_isLittleEndian())
+		ZSTD_write64(memPtr, val64);
+	else
+		put_unaligned_le64(val64, memPtr);
+}
 
 ZSTD_STATIC size_t ZSTD_readLEST(const void *memPtr)
 {
@@ -127,7 +127,7 @@ static const U32 OF_defaultNormLog = OF_DEFAULTNORMLOG;
 *  Shared functions to include for inlining
 *********************************************/
 ZSTD_STATIC void ZSTD_copy8(void *dst, const void *src) {
-	memcpy(dst, src, 8);
+	ZSTD_write64(dst, ZSTD_read64(src));
 }
 /*! ZSTD_wildcopy() :
 *   custom version of memcpy(), can copy up to 7 bytes too many (8 bytes if length==0) */
@@ -144,6 +144,11 @@ ZSTD_STATIC void ZSTD_wildcopy(void *dst, const void *src, ptrdiff_t length)
 	 */
 	if (length <= 8)
 		return ZSTD_copy8(dst, src);
+#ifdef __HAVE_ARCH_COPY_FORWARD
+	/* Match copies overlap, but are at least 8 bytes apart by now */
+	if (length >= COPY_FORWARD_MIN)
+		return copy_forward(dst, src, length);
+#endif
 	do {
 		ZSTD_copy8(op, ip);
 		op += 8;
@@ -21,6 +21,7 @@
 #include <linux/kthread.h>
 #include <linux/freezer.h>
 #include <linux/page_owner.h>
+#include <linux/psi.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -1276,6 +1277,89 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 	return cc->nr_migratepages ? ISOLATE_SUCCESS : ISOLATE_NONE;
 }
 
+/*
+ * Proactive compaction keeps the fragmentation score of each node, the
+ * share of free memory not in blocks of COMPACTION_HPAGE_ORDER or more,
+ * below a target set by vm.compaction_proactiveness.  kcompactd checks
+ * the score every HPAGE_FRAG_CHECK_INTERVAL_MSEC and compacts the node
+ * when it goes past the high mark, until it drops to the low mark.
+ */
+#if defined CONFIG_TRANSPARENT_HUGEPAGE
+#define COMPACTION_HPAGE_ORDER	HPAGE_PMD_ORDER
+#elif defined CONFIG_HUGETLBFS
+#define COMPACTION_HPAGE_ORDER	HUGETLB_PAGE_ORDER
+#else
+#define COMPACTION_HPAGE_ORDER	(PMD_SHIFT - PAGE_SHIFT)
+#endif
+
+#define HPAGE_FRAG_CHECK_INTERVAL_MSEC	500
+
+/* Proactive compaction may use up to a tenth of a CPU */
+#define PROACTIVE_CPU_SHARE	10
+
+int sysctl_compaction_proactiveness = 20;
+
+/*
+ * A zone's fragmentation score is the external fragmentation wrt
+ * COMPACTION_HPAGE_ORDER. It returns a value in the range [0, 100].
+ */
+static unsigned int fragmentation_score_zone(struct zone *zone)
+{
+	return extfrag_for_order(zone, COMPACTION_HPAGE_ORDER);
+}
+
+/*
+ * The node's score is the sum of its zones' scores, each scaled by the
+ * zone's share of the node's memory so that small zones don't dominate.
+ */
+static unsigned int fragmentation_score_node(pg_data_t *pgdat)
+{
+	unsigned int score = 0;
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		u64 zone_score;
+
+		if (!populated_zone(zone))
+			continue;
+
+		zone_score = (u64)zone->present_pages *
+			     fragmentation_score_zone(zone);
+		score += div64_ul(zone_score, pgdat->node_present_pages + 1);
+	}
+
+	return score;
+}
+
+static unsigned int fragmentation_score_wmark(bool low)
+{
+	unsigned int wmark_low;
+
+	/*
+	 * Cap the low watermark to avoid excessive compaction
+	 * activity in case a user sets the proactiveness tunable
+	 * close to 100 (maximum).
+	 */
+	wmark_low = max(100U - READ_ONCE(sysctl_compaction_proactiveness), 5U);
+	return low ? wmark_low : min(wmark_low + 10, 100U);
+}
+
+static bool kswapd_is_running(pg_data_t *pgdat)
+{
+	return pgdat->kswapd && (pgdat->kswapd->state == TASK_RUNNING);
+}
+
+static bool should_proactive_compact_node(pg_data_t *pgdat)
+{
+	if (!READ_ONCE(sysctl_compaction_proactiveness) ||
+	    kswapd_is_running(pgdat))
+		return false;
+
+	return fragmentation_score_node(pgdat) >
+	       fragmentation_score_wmark(false);
+}
+
 /*
  * order == -1 is expected when compacting via
  * /proc/sys/vm/compact_memory
@@ -1314,6 +1398,18 @@ static enum compact_result __compact_finished(struct zone *zone,
 			return COMPACT_PARTIAL_SKIPPED;
 	}
 
+	if (cc->proactive_compaction) {
+		/* Leave the node to kswapd while it is reclaiming */
+		if (kswapd_is_running(zone->zone_pgdat))
+			return COMPACT_PARTIAL_SKIPPED;
+
+		if (fragmentation_score_zone(zone) >
+		    fragmentation_score_wmark(true))
+			return COMPACT_CONTINUE;
+
+		return COMPACT_SUCCESS;
+	}
+
 	if (is_via_compact_memory(cc->order))
 		return COMPACT_CONTINUE;
 
@@ -1888,6 +1984,50 @@ void compaction_unregister_node(struct node *node)
 }
 #endif /* CONFIG_SYSFS && CONFIG_NUMA */
 
+/*
+ * Compact all zones of the node until their fragmentation scores drop to
+ * the low watermark, or kswapd starts reclaiming on the node.
+ */
+static void proactive_compact_node(pg_data_t *pgdat)
+{
+	int zoneid;
+	struct zone *zone;
+	struct compact_control cc = {
+		.order = -1,
+		.mode = MIGRATE_SYNC_LIGHT,
+		.ignore_skip_hint = true,
+		.whole_zone = true,
+		.gfp_mask = GFP_KERNEL,
+		.proactive_compaction = true,
+	};
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		cc.nr_freepages = 0;
+		cc.nr_migratepages = 0;
+		cc.total_migrate_scanned = 0;
+		cc.total_free_scanned = 0;
+		cc.zone = zone;
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		if (kthread_should_stop())
+			return;
+		compact_zone(zone, &cc);
+
+		count_compact_events(KCOMPACTD_MIGRATE_SCANNED,
+				     cc.total_migrate_scanned);
+		count_compact_events(KCOMPACTD_FREE_SCANNED,
+				     cc.total_free_scanned);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+	}
+}
+
 static inline bool kcompactd_work_requested(pg_data_t *pgdat)
 {
 	return pgdat->kcompactd_max_order > 0 || kthread_should_stop();
@@ -2025,6 +2165,9 @@ static int kcompactd(void *p)
 {
 	pg_data_t *pgdat = (pg_data_t*)p;
 	struct task_struct *tsk = current;
+	long default_timeout = msecs_to_jiffies(HPAGE_FRAG_CHECK_INTERVAL_MSEC);
+	long timeout = default_timeout;
+	unsigned int proactive_defer = 0;
 
 	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
 
@@ -2037,11 +2180,47 @@ static int kcompactd(void *p)
 	pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
 
 	while (!kthread_should_stop()) {
+		unsigned int prev_score, score;
+		unsigned long pflags;
+		u64 runtime;
+
 		trace_mm_compaction_kcompactd_sleep(pgdat->node_id);
-		wait_event_freezable(pgdat->kcompactd_wait,
-				kcompactd_work_requested(pgdat));
+		if (wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				kcompactd_work_requested(pgdat), timeout)) {
+			psi_memstall_enter(&pflags);
+			kcompactd_do_work(pgdat);
+			psi_memstall_leave(&pflags);
+			timeout = default_timeout;
+			continue;
+		}
+
+		/* kcompactd wait timeout: check the fragmentation score */
+		timeout = default_timeout;
+		if (!should_proactive_compact_node(pgdat))
+			continue;
+
+		if (proactive_defer) {
+			proactive_defer--;
+			continue;
+		}
+
+		prev_score = fragmentation_score_node(pgdat);
+		runtime = tsk->se.sum_exec_runtime;
+		proactive_compact_node(pgdat);
+		runtime = tsk->se.sum_exec_runtime - runtime;
+		score = fragmentation_score_node(pgdat);
+
+		/*
+		 * Defer proactive compaction if the fragmentation score did
+		 * not go down, i.e. no progress made.
+		 */
+		proactive_defer = score < prev_score ?
+				  0 : 1 << COMPACT_MAX_DEFER_SHIFT;
 
-		kcompactd_do_work(pgdat);
+		/* Sleep long enough to stay within the CPU budget */
+		runtime *= 100 / PROACTIVE_CPU_SHARE - 1;
+		timeout = max_t(long, default_timeout,
+				nsecs_to_jiffies(runtime));
 	}
 
 	return 0;
@@ -797,6 +797,25 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 }
 EXPORT_SYMBOL(add_to_page_cache_locked);
 
+static void page_cache_lru_add(struct page *page, void *shadow, gfp_t gfp_mask)
+{
+	/*
+	 * The page might have been evicted from cache only
+	 * recently, in which case it should be activated like
+	 * any other repeatedly accessed page.
+	 * The exception is pages getting rewritten; evicting other
+	 * data from the working set, only to cache data that will
+	 * get overwritten with something else, is a waste of memory.
+	 */
+	if (!(gfp_mask & __GFP_WRITE) &&
+	    shadow && workingset_refault(shadow)) {
+		SetPageActive(page);
+		workingset_activation(page);
+	} else
+		ClearPageActive(page);
+	lru_cache_add(page);
+}
+
 int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				pgoff_t offset, gfp_t gfp_mask)
 {
@@ -808,27 +827,122 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 					 gfp_mask, &shadow);
 	if (unlikely(ret))
 		__ClearPageLocked(page);
-	else {
-		/*
-		 * The page might have been evicted from cache only
-		 * recently, in which case it should be activated like
-		 * any other repeatedly accessed page.
-		 * The exception is pages getting rewritten; evicting other
-		 * data from the working set, only to cache data that will
-		 * get overwritten with something else, is a waste of memory.
-		 */
-		if (!(gfp_mask & __GFP_WRITE) &&
-		    shadow && workingset_refault(shadow)) {
-			SetPageActive(page);
-			workingset_activation(page);
-		} else
-			ClearPageActive(page);
-		lru_cache_add(page);
-	}
+	else
+		page_cache_lru_add(page, shadow, gfp_mask);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(add_to_page_cache_lru);
 
+/*
+ * Take up to READAHEAD_BATCH new pages off the tail of @pages and insert
+ * them into @mapping at their page->index, like add_to_page_cache_lru()
+ * would, but with a single radix tree preload and tree_lock round trip
+ * for all of them.  Pages that can't be added are released.
+ */
+static void readahead_batch_fill(struct address_space *mapping,
+				 struct list_head *pages,
+				 struct readahead_batch *rab, gfp_t gfp_mask)
+{
+	struct mem_cgroup *memcg[READAHEAD_BATCH];
+	void *shadow[READAHEAD_BATCH];
+	unsigned long failed = 0;
+	struct page *page;
+	unsigned int i, nr = 0;
+	int error;
+
+	BUILD_BUG_ON(READAHEAD_BATCH > BITS_PER_LONG);
+
+	rab->nr = 0;
+	rab->idx = 0;
+	while (nr < READAHEAD_BATCH && !list_empty(pages)) {
+		page = lru_to_page(pages);
+		list_del(&page->lru);
+		VM_BUG_ON_PAGE(PageSwapBacked(page), page);
+		VM_BUG_ON_PAGE(PageHuge(page), page);
+
+		if (mem_cgroup_try_charge(page, current->mm, gfp_mask,
+					  &memcg[nr], false)) {
+			put_page(page);
+			continue;
+		}
+		rab->pages[nr++] = page;
+	}
+	if (!nr)
+		return;
+
+	error = radix_tree_maybe_preload(gfp_mask & ~__GFP_HIGHMEM);
+	if (error) {
+		for (i = 0; i < nr; i++) {
+			page = rab->pages[i];
+			mem_cgroup_cancel_charge(page, memcg[i], false);
+			put_page(page);
+		}
+		return;
+	}
+
+	spin_lock_irq(&mapping->tree_lock);
+	for (i = 0; i < nr; i++) {
+		page = rab->pages[i];
+		shadow[i] = NULL;
+
+		__SetPageLocked(page);
+		get_page(page);
+		page->mapping = mapping;
+		if (unlikely(page_cache_tree_insert(mapping, page,
+						    &shadow[i]))) {
+			/* Leave page->index set: truncation relies upon it */
+			page->mapping = NULL;
+			__ClearPageLocked(page);
+			put_page(page);
+			__set_bit(i, &failed);
+			continue;
+		}
+		__inc_node_page_state(page, NR_FILE_PAGES);
+	}
+	spin_unlock_irq(&mapping->tree_lock);
+	radix_tree_preload_end();
+
+	for (i = 0; i < nr; i++) {
+		page = rab->pages[i];
+		if (test_bit(i, &failed)) {
+			mem_cgroup_cancel_charge(page, memcg[i], false);
+			put_page(page);
+			continue;
+		}
+		mem_cgroup_commit_charge(page, memcg[i], false, false);
+		trace_mm_filemap_add_to_page_cache(page);
+		page_cache_lru_add(page, shadow[i], gfp_mask);
+		rab->pages[rab->nr++] = page;
+	}
+}
+
+/**
+ * readahead_next_page - add the next readahead page to the pagecache
+ * @mapping:	the address_space being read
+ * @pages:	list of new pages passed to ->readpages()
+ * @rab:	batch state, set up with readahead_batch_init()
+ * @gfp_mask:	page allocation mode
+ *
+ * A replacement for the list_del() + add_to_page_cache_lru() loop of
+ * ->readpages() implementations: returns the next page from @pages that
+ * made it into the page cache, locked and on the LRU, or NULL once the
+ * list is used up.  The caller drops its reference with put_page() once
+ * the read is started, exactly as with add_to_page_cache_lru().  Pages
+ * that could not be added are released on the way.
+ */
+struct page *readahead_next_page(struct address_space *mapping,
+				 struct list_head *pages,
+				 struct readahead_batch *rab, gfp_t gfp_mask)
+{
+	while (rab->idx == rab->nr) {
+		if (list_empty(pages))
+			return NULL;
+		readahead_batch_fill(mapping, pages, rab, gfp_mask);
+	}
+	return rab->pages[rab->idx++];
+}
+EXPORT_SYMBOL_GPL(readahead_next_page);
+
 #ifdef CONFIG_NUMA
 struct page *__page_cache_alloc(gfp_t gfp)
 {
@@ -567,7 +567,9 @@ static int __do_huge_pmd_anonymous_page(struct vm_fault *vmf, struct page *page,
 		goto release;
 	}
 
-	clear_huge_page(page, vmf->address, HPAGE_PMD_NR);
+	/* __GFP_ZERO pages were cleared by the allocator or kprezerod */
+	if (!(gfp & __GFP_ZERO))
+		clear_huge_page(page, vmf->address, HPAGE_PMD_NR);
 	/*
 	 * The memory barrier inside __SetPageUptodate makes sure that
 	 * clear_huge_page writes become visible before the set_pmd_at()
@@ -719,9 +721,12 @@ int do_huge_pmd_anonymous_page(struct vm_fault *vmf)
 		return ret;
 	}
 	gfp = alloc_hugepage_direct_gfpmask(vma);
+	if (page_prezero_enabled())
+		gfp |= __GFP_ZERO;
 	page = alloc_hugepage_vma(gfp, vma, haddr, HPAGE_PMD_ORDER);
 	if (unlikely(!page)) {
 		count_vm_event(THP_FAULT_FALLBACK);
+		khugepaged_fault_hint(vma->vm_mm);
 		return VM_FAULT_FALLBACK;
 	}
 	prep_transhuge_page(page);
@@ -1567,6 +1572,7 @@ int do_huge_pmd_numa_page(struct vm_fault *vmf, pmd_t pmd)
 	if (migrated) {
 		flags |= TNF_MIGRATED;
 		page_nid = target_nid;
+		vma_numa_note_migrated(vma);
 	} else
 		flags |= TNF_MIGRATE_FAIL;
 
@@ -2348,6 +2354,7 @@ static void __split_huge_page_tail(struct page *head, int tail,
 			 (1L << PG_active) |
 			 (1L << PG_locked) |
 			 (1L << PG_unevictable) |
+			 (LRU_GEN_MASK << LRU_GEN_PGSHIFT) |
 			 (1L << PG_dirty)));
 
 	/*
@@ -203,6 +203,7 @@ struct compact_control {
 	bool whole_zone;		/* Whole zone should/has been scanned */
 	bool contended;			/* Signal lock or sched contention */
 	bool finishing_block;		/* Finishing current pageblock */
+	bool proactive_compaction;	/* kcompactd proactive compaction */
 };
 
 unsigned long
@@ -283,6 +284,13 @@ static inline bool is_data_mapping(vm_flags_t flags)
 void __vma_link_list(struct mm_struct *mm, struct vm_area_struct *vma,
 		struct vm_area_struct *prev, struct rb_node *rb_parent);
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/* mm/mmap.c */
+extern struct vm_area_struct *get_vma(struct mm_struct *mm,
+				      unsigned long addr);
+extern void put_vma(struct vm_area_struct *vma);
+#endif
+
 #ifdef CONFIG_MMU
 extern long populate_vma_page_range(struct vm_area_struct *vma,
 		unsigned long start, unsigned long end, int *nonblocking);
@@ -496,6 +504,20 @@ unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 #define ALLOC_CPUSET		0x40 /* check for correct cpuset */
 #define ALLOC_CMA		0x80 /* allow allocations from CMA areas */
 
+#ifdef CONFIG_PAGE_PREZERO
+extern struct page *page_prezero_alloc(gfp_t gfp_mask, unsigned int order,
+				       unsigned int alloc_flags,
+				       const struct alloc_context *ac);
+#else
+static inline struct page *page_prezero_alloc(gfp_t gfp_mask,
+					      unsigned int order,
+					      unsigned int alloc_flags,
+					      const struct alloc_context *ac)
+{
+	return NULL;
+}
+#endif
+
 enum ttu_flags;
 struct tlbflush_unmap_batch;
 
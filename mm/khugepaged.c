@@ -54,12 +54,12 @@ enum scan_result {
 
 /* default scan 8*512 pte (or vmas) every 30 second */
 static unsigned int khugepaged_pages_to_scan __read_mostly;
-static unsigned int khugepaged_pages_collapsed;
-static unsigned int khugepaged_full_scans;
+static atomic_long_t khugepaged_pages_collapsed;
+static atomic_long_t khugepaged_pages_scanned;
+static atomic_long_t khugepaged_madvise_collapsed;
 static unsigned int khugepaged_scan_sleep_millisecs __read_mostly = 10000;
 /* during fragmentation poll the hugepage allocator once every minute */
 static unsigned int khugepaged_alloc_sleep_millisecs __read_mostly = 60000;
-static unsigned long khugepaged_sleep_expire;
 static DEFINE_SPINLOCK(khugepaged_mm_lock);
 static DECLARE_WAIT_QUEUE_HEAD(khugepaged_wait);
 /*
@@ -80,11 +80,28 @@ static struct kmem_cache *mm_slot_cache __read_mostly;
  * @hash: hash collision list
  * @mm_node: khugepaged scan list headed in khugepaged_scan.mm_head
  * @mm: the mm that this information is valid for
+ * @nid: node of the khugepaged thread that scans this mm
+ * @hint_scan: full_scans of that thread when the mm was last hinted
  */
 struct mm_slot {
 	struct hlist_node hash;
 	struct list_head mm_node;
 	struct mm_struct *mm;
+	int nid;
+	unsigned int hint_scan;
+};
+
+/**
+ * struct collapse_control - per-caller state of a collapse
+ * @node_load: nodes of the small pages found in the range being scanned
+ * @last_target_node: node the last huge page was allocated on
+ *
+ * Each khugepaged thread has its own, and MADV_COLLAPSE allocates one
+ * for the duration of the call.
+ */
+struct collapse_control {
+	int node_load[MAX_NUMNODES];
+	int last_target_node;
 };
 
 /**
@@ -92,18 +109,54 @@ struct mm_slot {
  * @mm_head: the head of the mm list to scan
  * @mm_slot: the current mm_slot we are scanning
  * @address: the next address inside that to be scanned
+ * @sleep_expire: when the thread is due to scan again
+ * @full_scans: number of passes over the whole of @mm_head
+ * @nid: node this cursor and its thread belong to
+ * @thread: the khugepaged thread using this cursor
+ * @cc: collapse state of that thread
  *
- * There is only the one khugepaged_scan instance of this cursor structure.
+ * There is one cursor, and one khugepaged thread, for each node with
+ * memory.  An mm is scanned by the thread of the node it was registered
+ * from, so that tasks on different nodes are collapsed in parallel.
+ * The lists and cursors are all protected by khugepaged_mm_lock.
  */
 struct khugepaged_scan {
 	struct list_head mm_head;
 	struct mm_slot *mm_slot;
 	unsigned long address;
+	unsigned long sleep_expire;
+	unsigned int full_scans;
+	int nid;
+	struct task_struct *thread;
+	struct collapse_control cc;
 };
 
-static struct khugepaged_scan khugepaged_scan = {
-	.mm_head = LIST_HEAD_INIT(khugepaged_scan.mm_head),
-};
+static struct khugepaged_scan *khugepaged_scans[MAX_NUMNODES];
+
+#define for_each_khugepaged_scan(scan, nid)			\
+	for_each_node(nid)					\
+		if (!((scan) = khugepaged_scans[nid]))		\
+			; /* do nothing */			\
+		else
+
+/* Nodes that had no memory at boot share the first memory node's thread */
+static struct khugepaged_scan *khugepaged_node_scan(int nid)
+{
+	struct khugepaged_scan *scan = khugepaged_scans[nid];
+
+	return scan ? scan : khugepaged_scans[first_memory_node];
+}
+
+/* Make every thread rescan now, after a tunable changed */
+static void khugepaged_wake_all(void)
+{
+	struct khugepaged_scan *scan;
+	int nid;
+
+	for_each_khugepaged_scan(scan, nid)
+		scan->sleep_expire = 0;
+	wake_up_interruptible(&khugepaged_wait);
+}
 
 #ifdef CONFIG_SYSFS
 static ssize_t scan_sleep_millisecs_show(struct kobject *kobj,
@@ -125,8 +178,7 @@ static ssize_t scan_sleep_millisecs_store(struct kobject *kobj,
 		return -EINVAL;
 
 	khugepaged_scan_sleep_millisecs = msecs;
-	khugepaged_sleep_expire = 0;
-	wake_up_interruptible(&khugepaged_wait);
+	khugepaged_wake_all();
 
 	return count;
 }
@@ -153,8 +205,7 @@ static ssize_t alloc_sleep_millisecs_store(struct kobject *kobj,
 		return -EINVAL;
 
 	khugepaged_alloc_sleep_millisecs = msecs;
-	khugepaged_sleep_expire = 0;
-	wake_up_interruptible(&khugepaged_wait);
+	khugepaged_wake_all();
 
 	return count;
 }
@@ -191,20 +242,64 @@ static ssize_t pages_collapsed_show(struct kobject *kobj,
 				    struct kobj_attribute *attr,
 				    char *buf)
 {
-	return sprintf(buf, "%u\n", khugepaged_pages_collapsed);
+	return sprintf(buf, "%ld\n",
+		       atomic_long_read(&khugepaged_pages_collapsed));
 }
 static struct kobj_attribute pages_collapsed_attr =
 	__ATTR_RO(pages_collapsed);
 
+static ssize_t pages_scanned_show(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  char *buf)
+{
+	return sprintf(buf, "%ld\n",
+		       atomic_long_read(&khugepaged_pages_scanned));
+}
+static struct kobj_attribute pages_scanned_attr =
+	__ATTR_RO(pages_scanned);
+
+static ssize_t madvise_collapsed_show(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      char *buf)
+{
+	return sprintf(buf, "%ld\n",
+		       atomic_long_read(&khugepaged_madvise_collapsed));
+}
+static struct kobj_attribute madvise_collapsed_attr =
+	__ATTR_RO(madvise_collapsed);
+
 static ssize_t full_scans_show(struct kobject *kobj,
 			       struct kobj_attribute *attr,
 			       char *buf)
 {
-	return sprintf(buf, "%u\n", khugepaged_full_scans);
+	struct khugepaged_scan *scan;
+	unsigned int full_scans = 0;
+	int nid;
+
+	for_each_khugepaged_scan(scan, nid)
+		full_scans += READ_ONCE(scan->full_scans);
+
+	return sprintf(buf, "%u\n", full_scans);
 }
 static struct kobj_attribute full_scans_attr =
 	__ATTR_RO(full_scans);
 
+static ssize_t threads_show(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    char *buf)
+{
+	struct khugepaged_scan *scan;
+	int nid, threads = 0;
+
+	for_each_khugepaged_scan(scan, nid)
+		if (scan->thread)
+			threads++;
+
+	return sprintf(buf, "%d\n", threads);
+}
+static struct kobj_attribute threads_attr =
+	__ATTR_RO(threads);
+
 static ssize_t khugepaged_defrag_show(struct kobject *kobj,
 				      struct kobj_attribute *attr, char *buf)
 {
@@ -287,7 +382,10 @@ static struct attribute *khugepaged_attr[] = {
 	&khugepaged_max_ptes_none_attr.attr,
 	&pages_to_scan_attr.attr,
 	&pages_collapsed_attr.attr,
+	&pages_scanned_attr.attr,
+	&madvise_collapsed_attr.attr,
 	&full_scans_attr.attr,
+	&threads_attr.attr,
 	&scan_sleep_millisecs_attr.attr,
 	&alloc_sleep_millisecs_attr.attr,
 	&khugepaged_max_ptes_swap_attr.attr,
@@ -341,13 +439,40 @@ int hugepage_madvise(struct vm_area_struct *vma,
 	return 0;
 }
 
+static void __init khugepaged_free_scans(void)
+{
+	int nid;
+
+	for_each_node(nid) {
+		kfree(khugepaged_scans[nid]);
+		khugepaged_scans[nid] = NULL;
+	}
+}
+
 int __init khugepaged_init(void)
 {
+	struct khugepaged_scan *scan;
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY) {
+		scan = kzalloc_node(sizeof(*scan), GFP_KERNEL, nid);
+		if (!scan) {
+			khugepaged_free_scans();
+			return -ENOMEM;
+		}
+		INIT_LIST_HEAD(&scan->mm_head);
+		scan->nid = nid;
+		scan->cc.last_target_node = NUMA_NO_NODE;
+		khugepaged_scans[nid] = scan;
+	}
+
 	mm_slot_cache = kmem_cache_create("khugepaged_mm_slot",
 					  sizeof(struct mm_slot),
 					  __alignof__(struct mm_slot), 0, NULL);
-	if (!mm_slot_cache)
+	if (!mm_slot_cache) {
+		khugepaged_free_scans();
 		return -ENOMEM;
+	}
 
 	khugepaged_pages_to_scan = HPAGE_PMD_NR * 8;
 	khugepaged_max_ptes_none = HPAGE_PMD_NR - 1;
@@ -359,6 +484,8 @@ int __init khugepaged_init(void)
 void __init khugepaged_destroy(void)
 {
 	kmem_cache_destroy(mm_slot_cache);
+	mm_slot_cache = NULL;
+	khugepaged_free_scans();
 }
 
 static inline struct mm_slot *alloc_mm_slot(void)
@@ -398,6 +525,7 @@ static inline int khugepaged_test_exit(struct mm_struct *mm)
 
 int __khugepaged_enter(struct mm_struct *mm)
 {
+	struct khugepaged_scan *scan;
 	struct mm_slot *mm_slot;
 	int wakeup;
 
@@ -415,11 +543,14 @@ int __khugepaged_enter(struct mm_struct *mm)
 	spin_lock(&khugepaged_mm_lock);
 	insert_to_mm_slots_hash(mm, mm_slot);
 	/*
-	 * Insert just behind the scanning cursor, to let the area settle
-	 * down a little.
+	 * Insert just behind the scanning cursor of the local node's
+	 * thread, to let the area settle down a little.
 	 */
-	wakeup = list_empty(&khugepaged_scan.mm_head);
-	list_add_tail(&mm_slot->mm_node, &khugepaged_scan.mm_head);
+	scan = khugepaged_node_scan(numa_node_id());
+	mm_slot->nid = scan->nid;
+	mm_slot->hint_scan = scan->full_scans;
+	wakeup = list_empty(&scan->mm_head);
+	list_add_tail(&mm_slot->mm_node, &scan->mm_head);
 	spin_unlock(&khugepaged_mm_lock);
 
 	mmgrab(mm);
@@ -429,6 +560,35 @@ int __khugepaged_enter(struct mm_struct *mm)
 	return 0;
 }
 
+/*
+ * A huge page fault on @mm fell back to small pages: move the mm right
+ * behind the scanning cursor so that its thread collapses it next.
+ * MMF_KHUGEPAGED_HINT is set by the caller and keeps it to one hint per
+ * full scan.
+ */
+void __khugepaged_hint(struct mm_struct *mm)
+{
+	struct khugepaged_scan *scan;
+	struct mm_slot *mm_slot;
+
+	spin_lock(&khugepaged_mm_lock);
+	mm_slot = get_mm_slot(mm);
+	if (!mm_slot)
+		goto out;
+
+	scan = khugepaged_scans[mm_slot->nid];
+	mm_slot->hint_scan = scan->full_scans;
+	if (scan->mm_slot == mm_slot)
+		goto out;
+
+	if (scan->mm_slot)
+		list_move(&mm_slot->mm_node, &scan->mm_slot->mm_node);
+	else
+		list_move(&mm_slot->mm_node, &scan->mm_head);
+out:
+	spin_unlock(&khugepaged_mm_lock);
+}
+
 int khugepaged_enter_vma_merge(struct vm_area_struct *vma,
 			       unsigned long vm_flags)
 {
@@ -456,7 +616,7 @@ void __khugepaged_exit(struct mm_struct *mm)
 
 	spin_lock(&khugepaged_mm_lock);
 	mm_slot = get_mm_slot(mm);
-	if (mm_slot && khugepaged_scan.mm_slot != mm_slot) {
+	if (mm_slot && khugepaged_scans[mm_slot->nid]->mm_slot != mm_slot) {
 		hash_del(&mm_slot->hash);
 		list_del(&mm_slot->mm_node);
 		free = 1;
@@ -665,9 +825,7 @@ static void khugepaged_alloc_sleep(void)
 	remove_wait_queue(&khugepaged_wait, &wait);
 }
 
-static int khugepaged_node_load[MAX_NUMNODES];
-
-static bool khugepaged_scan_abort(int nid)
+static bool khugepaged_scan_abort(struct collapse_control *cc, int nid)
 {
 	int i;
 
@@ -679,11 +837,11 @@ static bool khugepaged_scan_abort(int nid)
 		return false;
 
 	/* If there is a count for this node already, it must be acceptable */
-	if (khugepaged_node_load[nid])
+	if (cc->node_load[nid])
 		return false;
 
 	for (i = 0; i < MAX_NUMNODES; i++) {
-		if (!khugepaged_node_load[i])
+		if (!cc->node_load[i])
 			continue;
 		if (node_distance(nid, i) > RECLAIM_DISTANCE)
 			return true;
@@ -698,28 +856,27 @@ static inline gfp_t alloc_hugepage_khugepaged_gfpmask(void)
 }
 
 #ifdef CONFIG_NUMA
-static int khugepaged_find_target_node(void)
+static int khugepaged_find_target_node(struct collapse_control *cc)
 {
-	static int last_khugepaged_target_node = NUMA_NO_NODE;
 	int nid, target_node = 0, max_value = 0;
 
 	/* find first node with max normal pages hit */
 	for (nid = 0; nid < MAX_NUMNODES; nid++)
-		if (khugepaged_node_load[nid] > max_value) {
-			max_value = khugepaged_node_load[nid];
+		if (cc->node_load[nid] > max_value) {
+			max_value = cc->node_load[nid];
 			target_node = nid;
 		}
 
 	/* do some balance if several nodes have the same hit record */
-	if (target_node <= last_khugepaged_target_node)
-		for (nid = last_khugepaged_target_node + 1; nid < MAX_NUMNODES;
+	if (target_node <= cc->last_target_node)
+		for (nid = cc->last_target_node + 1; nid < MAX_NUMNODES;
 				nid++)
-			if (max_value == khugepaged_node_load[nid]) {
+			if (max_value == cc->node_load[nid]) {
 				target_node = nid;
 				break;
 			}
 
-	last_khugepaged_target_node = target_node;
+	cc->last_target_node = target_node;
 	return target_node;
 }
 
@@ -757,7 +914,7 @@ khugepaged_alloc_page(struct page **hpage, gfp_t gfp, int node)
 	return *hpage;
 }
 #else
-static int khugepaged_find_target_node(void)
+static int khugepaged_find_target_node(struct collapse_control *cc)
 {
 	return 0;
 }
@@ -924,10 +1081,10 @@ static bool __collapse_huge_page_swapin(struct mm_struct *mm,
 	return true;
 }
 
-static void collapse_huge_page(struct mm_struct *mm,
-				   unsigned long address,
-				   struct page **hpage,
-				   int node, int referenced)
+static int collapse_huge_page(struct mm_struct *mm,
+			      unsigned long address,
+			      struct page **hpage,
+			      int node, int referenced)
 {
 	pmd_t *pmd, _pmd;
 	pte_t *pte;
@@ -1006,6 +1163,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 		goto out;
 
 	anon_vma_lock_write(vma->anon_vma);
+	vm_write_begin(vma);
 
 	pte = pte_offset_map(pmd, address);
 	pte_ptl = pte_lockptr(mm, pmd);
@@ -1039,6 +1197,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 		 */
 		pmd_populate(mm, pmd, pmd_pgtable(_pmd));
 		spin_unlock(pmd_ptl);
+		vm_write_end(vma);
 		anon_vma_unlock_write(vma->anon_vma);
 		result = SCAN_FAIL;
 		goto out;
@@ -1074,29 +1233,37 @@ static void collapse_huge_page(struct mm_struct *mm,
 	set_pmd_at(mm, address, pmd, _pmd);
 	update_mmu_cache_pmd(vma, address, pmd);
 	spin_unlock(pmd_ptl);
+	vm_write_end(vma);
 
 	*hpage = NULL;
 
-	khugepaged_pages_collapsed++;
+	atomic_long_inc(&khugepaged_pages_collapsed);
 	result = SCAN_SUCCEED;
 out_up_write:
 	up_write(&mm->mmap_sem);
 out_nolock:
 	trace_mm_collapse_huge_page(mm, isolated, result);
-	return;
+	return result;
 out:
 	mem_cgroup_cancel_charge(new_page, memcg, true);
 	goto out_up_write;
 }
 
+/*
+ * Returns 1, with mmap_sem released, if a collapse was attempted.  The
+ * outcome is stored in @presult when it is not NULL.
+ */
 static int khugepaged_scan_pmd(struct mm_struct *mm,
 			       struct vm_area_struct *vma,
 			       unsigned long address,
-			       struct page **hpage)
+			       struct page **hpage,
+			       struct collapse_control *cc,
+			       int *presult)
 {
 	pmd_t *pmd;
 	pte_t *pte, *_pte;
 	int ret = 0, none_or_zero = 0, result = 0, referenced = 0;
+	int collapse_result = SCAN_FAIL;
 	struct page *page = NULL;
 	unsigned long _address;
 	spinlock_t *ptl;
@@ -1111,7 +1278,7 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 		goto out;
 	}
 
-	memset(khugepaged_node_load, 0, sizeof(khugepaged_node_load));
+	memset(cc->node_load, 0, sizeof(cc->node_load));
 	pte = pte_offset_map_lock(mm, pmd, address, &ptl);
 	for (_address = address, _pte = pte; _pte < pte+HPAGE_PMD_NR;
 	     _pte++, _address += PAGE_SIZE) {
@@ -1154,16 +1321,16 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 
 		/*
 		 * Record which node the original page is from and save this
-		 * information to khugepaged_node_load[].
+		 * information to cc->node_load[].
 		 * Khupaged will allocate hugepage from the node has the max
 		 * hit record.
 		 */
 		node = page_to_nid(page);
-		if (khugepaged_scan_abort(node)) {
+		if (khugepaged_scan_abort(cc, node)) {
 			result = SCAN_SCAN_ABORT;
 			goto out_unmap;
 		}
-		khugepaged_node_load[node]++;
+		cc->node_load[node]++;
 		if (!PageLRU(page)) {
 			result = SCAN_PAGE_LRU;
 			goto out_unmap;
@@ -1204,13 +1371,108 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 out_unmap:
 	pte_unmap_unlock(pte, ptl);
 	if (ret) {
-		node = khugepaged_find_target_node();
+		node = khugepaged_find_target_node(cc);
 		/* collapse_huge_page will return with the mmap_sem released */
-		collapse_huge_page(mm, address, hpage, node, referenced);
+		collapse_result = collapse_huge_page(mm, address, hpage, node,
+						     referenced);
 	}
 out:
 	trace_mm_khugepaged_scan_pmd(mm, page, writable, referenced,
 				     none_or_zero, result, unmapped);
+	if (presult)
+		*presult = ret ? collapse_result : result;
+	return ret;
+}
+
+/*
+ * MADV_COLLAPSE: collapse the anonymous memory in [start, end) into huge
+ * pages now, in the caller's context, using the same checks as
+ * khugepaged.  Returns with mmap_sem held for read, and *prev set to
+ * NULL if it had to be dropped.
+ */
+int madvise_collapse(struct vm_area_struct *vma,
+		     struct vm_area_struct **prev,
+		     unsigned long start, unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct collapse_control *cc;
+	struct page *hpage = NULL;
+	unsigned long hstart, hend, addr;
+	bool mmap_locked = true, wait = false;
+	long nr_collapsed = 0;
+	int ret = 0;
+
+	*prev = vma;
+	if (vma->vm_file || !hugepage_vma_check(vma))
+		return -EINVAL;
+
+	hstart = (start + ~HPAGE_PMD_MASK) & HPAGE_PMD_MASK;
+	hend = end & HPAGE_PMD_MASK;
+	if (hstart >= hend)
+		return 0;
+
+	cc = kmalloc(sizeof(*cc), GFP_KERNEL);
+	if (!cc)
+		return -ENOMEM;
+	cc->last_target_node = NUMA_NO_NODE;
+
+	/* Small pages still on the pagevecs are not on the LRU yet */
+	lru_add_drain_all();
+
+	for (addr = hstart; addr < hend; addr += HPAGE_PMD_SIZE) {
+		int result = SCAN_FAIL;
+
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			break;
+		}
+
+		if (!mmap_locked) {
+			*prev = NULL;
+			down_read(&mm->mmap_sem);
+			mmap_locked = true;
+			if (hugepage_vma_revalidate(mm, addr, &vma)) {
+				ret = -EINVAL;
+				break;
+			}
+		}
+
+		if (!khugepaged_prealloc_page(&hpage, &wait)) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		if (khugepaged_scan_pmd(mm, vma, addr, &hpage, cc, &result))
+			mmap_locked = false;
+
+		switch (result) {
+		case SCAN_SUCCEED:
+			nr_collapsed++;
+			break;
+		case SCAN_PMD_NULL:
+			/* nothing mapped, or already a huge page */
+			break;
+		case SCAN_ALLOC_HUGE_PAGE_FAIL:
+		case SCAN_CGROUP_CHARGE_FAIL:
+			ret = -ENOMEM;
+			break;
+		default:
+			if (!ret)
+				ret = -EAGAIN;
+			break;
+		}
+	}
+
+	if (!mmap_locked) {
+		*prev = NULL;
+		down_read(&mm->mmap_sem);
+	}
+
+	if (!IS_ERR_OR_NULL(hpage))
+		put_page(hpage);
+	kfree(cc);
+
+	atomic_long_add(nr_collapsed, &khugepaged_madvise_collapsed);
 	return ret;
 }
 
@@ -1561,7 +1823,8 @@ static void collapse_shmem(struct mm_struct *mm,
 
 static void khugepaged_scan_shmem(struct mm_struct *mm,
 		struct address_space *mapping,
-		pgoff_t start, struct page **hpage)
+		pgoff_t start, struct page **hpage,
+		struct collapse_control *cc)
 {
 	struct page *page = NULL;
 	struct radix_tree_iter iter;
@@ -1572,7 +1835,7 @@ static void khugepaged_scan_shmem(struct mm_struct *mm,
 
 	present = 0;
 	swap = 0;
-	memset(khugepaged_node_load, 0, sizeof(khugepaged_node_load));
+	memset(cc->node_load, 0, sizeof(cc->node_load));
 	rcu_read_lock();
 	radix_tree_for_each_slot(slot, &mapping->page_tree, &iter, start) {
 		if (iter.index >= start + HPAGE_PMD_NR)
@@ -1598,11 +1861,11 @@ static void khugepaged_scan_shmem(struct mm_struct *mm,
 		}
 
 		node = page_to_nid(page);
-		if (khugepaged_scan_abort(node)) {
+		if (khugepaged_scan_abort(cc, node)) {
 			result = SCAN_SCAN_ABORT;
 			break;
 		}
-		khugepaged_node_load[node]++;
+		cc->node_load[node]++;
 
 		if (!PageLRU(page)) {
 			result = SCAN_PAGE_LRU;
@@ -1633,7 +1896,7 @@ static void khugepaged_scan_shmem(struct mm_struct *mm,
 		if (present < HPAGE_PMD_NR - khugepaged_max_ptes_none) {
 			result = SCAN_EXCEED_NONE_PTE;
 		} else {
-			node = khugepaged_find_target_node();
+			node = khugepaged_find_target_node(cc);
 			collapse_shmem(mm, mapping, start, hpage, node);
 		}
 	}
@@ -1643,13 +1906,20 @@ static void khugepaged_scan_shmem(struct mm_struct *mm,
 #else
 static void khugepaged_scan_shmem(struct mm_struct *mm,
 		struct address_space *mapping,
-		pgoff_t start, struct page **hpage)
+		pgoff_t start, struct page **hpage,
+		struct collapse_control *cc)
 {
 	BUILD_BUG();
 }
 #endif
 
-static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
+/*
+ * Scan up to @pages of the mm under the cursor.  An mm whose memcg has a
+ * khugepaged priority of N gets N + 1 times the budget, so the returned
+ * progress is scaled down accordingly.
+ */
+static unsigned int khugepaged_scan_mm_slot(struct khugepaged_scan *scan,
+					    unsigned int pages,
 					    struct page **hpage)
 	__releases(&khugepaged_mm_lock)
 	__acquires(&khugepaged_mm_lock)
@@ -1657,27 +1927,34 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 	struct mm_slot *mm_slot;
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
+	unsigned int weight;
 	int progress = 0;
 
 	VM_BUG_ON(!pages);
 	VM_BUG_ON(NR_CPUS != 1 && !spin_is_locked(&khugepaged_mm_lock));
 
-	if (khugepaged_scan.mm_slot)
-		mm_slot = khugepaged_scan.mm_slot;
+	if (scan->mm_slot)
+		mm_slot = scan->mm_slot;
 	else {
-		mm_slot = list_entry(khugepaged_scan.mm_head.next,
+		mm_slot = list_entry(scan->mm_head.next,
 				     struct mm_slot, mm_node);
-		khugepaged_scan.address = 0;
-		khugepaged_scan.mm_slot = mm_slot;
+		scan->address = 0;
+		scan->mm_slot = mm_slot;
 	}
+	mm = mm_slot->mm;
+	/* Allow a new fault hint once a full scan has passed */
+	if (mm_slot->hint_scan != scan->full_scans)
+		clear_bit(MMF_KHUGEPAGED_HINT, &mm->flags);
 	spin_unlock(&khugepaged_mm_lock);
 
-	mm = mm_slot->mm;
+	weight = mem_cgroup_khugepaged_priority(mm) + 1;
+	pages *= weight;
+
 	down_read(&mm->mmap_sem);
 	if (unlikely(khugepaged_test_exit(mm)))
 		vma = NULL;
 	else
-		vma = find_vma(mm, khugepaged_scan.address);
+		vma = find_vma(mm, scan->address);
 
 	progress++;
 	for (; vma; vma = vma->vm_next) {
@@ -1697,40 +1974,40 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 		hend = vma->vm_end & HPAGE_PMD_MASK;
 		if (hstart >= hend)
 			goto skip;
-		if (khugepaged_scan.address > hend)
+		if (scan->address > hend)
 			goto skip;
-		if (khugepaged_scan.address < hstart)
-			khugepaged_scan.address = hstart;
-		VM_BUG_ON(khugepaged_scan.address & ~HPAGE_PMD_MASK);
+		if (scan->address < hstart)
+			scan->address = hstart;
+		VM_BUG_ON(scan->address & ~HPAGE_PMD_MASK);
 
-		while (khugepaged_scan.address < hend) {
+		while (scan->address < hend) {
 			int ret;
 			cond_resched();
 			if (unlikely(khugepaged_test_exit(mm)))
 				goto breakouterloop;
 
-			VM_BUG_ON(khugepaged_scan.address < hstart ||
-				  khugepaged_scan.address + HPAGE_PMD_SIZE >
+			VM_BUG_ON(scan->address < hstart ||
+				  scan->address + HPAGE_PMD_SIZE >
 				  hend);
 			if (shmem_file(vma->vm_file)) {
 				struct file *file;
 				pgoff_t pgoff = linear_page_index(vma,
-						khugepaged_scan.address);
+						scan->address);
 				if (!shmem_huge_enabled(vma))
 					goto skip;
 				file = get_file(vma->vm_file);
 				up_read(&mm->mmap_sem);
 				ret = 1;
 				khugepaged_scan_shmem(mm, file->f_mapping,
-						pgoff, hpage);
+						pgoff, hpage, &scan->cc);
 				fput(file);
 			} else {
 				ret = khugepaged_scan_pmd(mm, vma,
-						khugepaged_scan.address,
-						hpage);
+						scan->address,
+						hpage, &scan->cc, NULL);
 			}
 			/* move to next address */
-			khugepaged_scan.address += HPAGE_PMD_SIZE;
+			scan->address += HPAGE_PMD_SIZE;
 			progress += HPAGE_PMD_NR;
 			if (ret)
 				/* we released mmap_sem so break loop */
@@ -1743,8 +2020,10 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 	up_read(&mm->mmap_sem); /* exit_mmap will destroy ptes after this */
 breakouterloop_mmap_sem:
 
+	atomic_long_add(progress, &khugepaged_pages_scanned);
+
 	spin_lock(&khugepaged_mm_lock);
-	VM_BUG_ON(khugepaged_scan.mm_slot != mm_slot);
+	VM_BUG_ON(scan->mm_slot != mm_slot);
 	/*
 	 * Release the current mm_slot if this mm is about to die, or
 	 * if we scanned all vmas of this mm.
@@ -1755,35 +2034,35 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 		 * khugepaged runs here, khugepaged_exit will find
 		 * mm_slot not pointing to the exiting mm.
 		 */
-		if (mm_slot->mm_node.next != &khugepaged_scan.mm_head) {
-			khugepaged_scan.mm_slot = list_entry(
+		if (mm_slot->mm_node.next != &scan->mm_head) {
+			scan->mm_slot = list_entry(
 				mm_slot->mm_node.next,
 				struct mm_slot, mm_node);
-			khugepaged_scan.address = 0;
+			scan->address = 0;
 		} else {
-			khugepaged_scan.mm_slot = NULL;
-			khugepaged_full_scans++;
+			scan->mm_slot = NULL;
+			scan->full_scans++;
 		}
 
 		collect_mm_slot(mm_slot);
 	}
 
-	return progress;
+	return DIV_ROUND_UP(progress, weight);
 }
 
-static int khugepaged_has_work(void)
+static int khugepaged_has_work(struct khugepaged_scan *scan)
 {
-	return !list_empty(&khugepaged_scan.mm_head) &&
+	return !list_empty(&scan->mm_head) &&
 		khugepaged_enabled();
 }
 
-static int khugepaged_wait_event(void)
+static int khugepaged_wait_event(struct khugepaged_scan *scan)
 {
-	return !list_empty(&khugepaged_scan.mm_head) ||
+	return !list_empty(&scan->mm_head) ||
 		kthread_should_stop();
 }
 
-static void khugepaged_do_scan(void)
+static void khugepaged_do_scan(struct khugepaged_scan *scan)
 {
 	struct page *hpage = NULL;
 	unsigned int progress = 0, pass_through_head = 0;
@@ -1802,11 +2081,12 @@ static void khugepaged_do_scan(void)
 			break;
 
 		spin_lock(&khugepaged_mm_lock);
-		if (!khugepaged_scan.mm_slot)
+		if (!scan->mm_slot)
 			pass_through_head++;
-		if (khugepaged_has_work() &&
+		if (khugepaged_has_work(scan) &&
 		    pass_through_head < 2)
-			progress += khugepaged_scan_mm_slot(pages - progress,
+			progress += khugepaged_scan_mm_slot(scan,
+							    pages - progress,
 							    &hpage);
 		else
 			progress = pages;
@@ -1817,47 +2097,49 @@ static void khugepaged_do_scan(void)
 		put_page(hpage);
 }
 
-static bool khugepaged_should_wakeup(void)
+static bool khugepaged_should_wakeup(struct khugepaged_scan *scan)
 {
 	return kthread_should_stop() ||
-	       time_after_eq(jiffies, khugepaged_sleep_expire);
+	       time_after_eq(jiffies, scan->sleep_expire);
 }
 
-static void khugepaged_wait_work(void)
+static void khugepaged_wait_work(struct khugepaged_scan *scan)
 {
-	if (khugepaged_has_work()) {
+	if (khugepaged_has_work(scan)) {
 		const unsigned long scan_sleep_jiffies =
 			msecs_to_jiffies(khugepaged_scan_sleep_millisecs);
 
 		if (!scan_sleep_jiffies)
 			return;
 
-		khugepaged_sleep_expire = jiffies + scan_sleep_jiffies;
+		scan->sleep_expire = jiffies + scan_sleep_jiffies;
 		wait_event_freezable_timeout(khugepaged_wait,
-					     khugepaged_should_wakeup(),
+					     khugepaged_should_wakeup(scan),
 					     scan_sleep_jiffies);
 		return;
 	}
 
 	if (khugepaged_enabled())
-		wait_event_freezable(khugepaged_wait, khugepaged_wait_event());
+		wait_event_freezable(khugepaged_wait,
+				     khugepaged_wait_event(scan));
 }
 
-static int khugepaged(void *none)
+static int khugepaged(void *data)
 {
+	struct khugepaged_scan *scan = data;
 	struct mm_slot *mm_slot;
 
 	set_freezable();
 	set_user_nice(current, MAX_NICE);
 
 	while (!kthread_should_stop()) {
-		khugepaged_do_scan();
-		khugepaged_wait_work();
+		khugepaged_do_scan(scan);
+		khugepaged_wait_work(scan);
 	}
 
 	spin_lock(&khugepaged_mm_lock);
-	mm_slot = khugepaged_scan.mm_slot;
-	khugepaged_scan.mm_slot = NULL;
+	mm_slot = scan->mm_slot;
+	scan->mm_slot = NULL;
 	if (mm_slot)
 		collect_mm_slot(mm_slot);
 	spin_unlock(&khugepaged_mm_lock);
@@ -1900,31 +2182,53 @@ static void set_recommended_min_free_kbytes(void)
 	setup_per_zone_wmarks();
 }
 
+static int khugepaged_run(struct khugepaged_scan *scan)
+{
+	const struct cpumask *cpumask = cpumask_of_node(scan->nid);
+	struct task_struct *thread;
+
+	if (scan->thread)
+		return 0;
+
+	thread = kthread_create_on_node(khugepaged, scan, scan->nid,
+					"khugepaged%d", scan->nid);
+	if (IS_ERR(thread)) {
+		pr_err("khugepaged: kthread_run(khugepaged) failed\n");
+		return PTR_ERR(thread);
+	}
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(thread, cpumask);
+	scan->thread = thread;
+	wake_up_process(thread);
+
+	return 0;
+}
+
 int start_stop_khugepaged(void)
 {
-	static struct task_struct *khugepaged_thread __read_mostly;
 	static DEFINE_MUTEX(khugepaged_mutex);
-	int err = 0;
+	struct khugepaged_scan *scan;
+	int nid, err = 0;
 
 	mutex_lock(&khugepaged_mutex);
 	if (khugepaged_enabled()) {
-		if (!khugepaged_thread)
-			khugepaged_thread = kthread_run(khugepaged, NULL,
-							"khugepaged");
-		if (IS_ERR(khugepaged_thread)) {
-			pr_err("khugepaged: kthread_run(khugepaged) failed\n");
-			err = PTR_ERR(khugepaged_thread);
-			khugepaged_thread = NULL;
-			goto fail;
+		for_each_khugepaged_scan(scan, nid) {
+			err = khugepaged_run(scan);
+			if (err)
+				goto fail;
 		}
 
-		if (!list_empty(&khugepaged_scan.mm_head))
-			wake_up_interruptible(&khugepaged_wait);
+		wake_up_interruptible(&khugepaged_wait);
 
 		set_recommended_min_free_kbytes();
-	} else if (khugepaged_thread) {
-		kthread_stop(khugepaged_thread);
-		khugepaged_thread = NULL;
+	} else {
+		for_each_khugepaged_scan(scan, nid) {
+			if (!scan->thread)
+				continue;
+			kthread_stop(scan->thread);
+			scan->thread = NULL;
+		}
 	}
 fail:
 	mutex_unlock(&khugepaged_mutex);
@@ -25,7 +25,7 @@
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
 #include <linux/spinlock.h>
-#include <linux/jhash.h>
+#include <linux/xxhash.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
@@ -39,6 +39,7 @@
 #include <linux/freezer.h>
 #include <linux/oom.h>
 #include <linux/numa.h>
+#include <linux/workqueue.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -260,6 +261,13 @@ static unsigned int zero_checksum __read_mostly;
 /* Whether to merge empty (zeroed) pages with actual zero pages */
 static bool ksm_use_zero_pages __read_mostly;
 
+/* Pages are checksummed in batches of up to this, before any is merged */
+#define KSM_SCAN_BATCH		256
+
+/* Checksum workers per node for each batch: 0 to leave it all to ksmd */
+#define KSM_HASH_WORKERS_MAX	8
+static unsigned int ksm_hash_workers;
+
 #ifdef CONFIG_NUMA
 /* Zeroed when merging across nodes is not allowed */
 static unsigned int ksm_merge_across_nodes = 1;
@@ -369,6 +377,7 @@ static inline struct rmap_item *alloc_rmap_item(void)
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
 	ksm_rmap_items--;
+	rmap_item->mm->ksm_rmap_items--;
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -621,6 +630,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		VM_BUG_ON(stable_node->rmap_hlist_len <= 0);
 		stable_node->rmap_hlist_len--;
 		put_anon_vma(rmap_item->anon_vma);
@@ -762,6 +772,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		VM_BUG_ON(stable_node->rmap_hlist_len <= 0);
 		stable_node->rmap_hlist_len--;
 
@@ -775,10 +786,10 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		 * root_unstable_tree was already reset to RB_ROOT.
 		 * But be careful when an mm is exiting: do the rb_erase
 		 * if this rmap_item was inserted by this scan, rather
-		 * than left over from before.
+		 * than left over from before.  An mm given a lower
+		 * PR_SET_KSM_PRIORITY skips passes, so can be older than 1.
 		 */
 		age = (unsigned char)(ksm_scan.seqnr - rmap_item->address);
-		BUG_ON(age > 1);
 		if (!age)
 			rb_erase(&rmap_item->node,
 				 root_unstable_tree + NUMA(rmap_item->nid));
@@ -986,7 +997,11 @@ static u32 calc_checksum(struct page *page)
 {
 	u32 checksum;
 	void *addr = kmap_atomic(page);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+#if BITS_PER_LONG == 64
+	checksum = xxh64(addr, PAGE_SIZE, 0);
+#else
+	checksum = xxh32(addr, PAGE_SIZE, 0);
+#endif
 	kunmap_atomic(addr);
 	return checksum;
 }
@@ -1977,6 +1992,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	rmap_item->mm->ksm_merging_pages++;
 }
 
 /*
@@ -1987,8 +2003,10 @@ static void stable_tree_append(struct rmap_item *rmap_item,
  *
  * @page: the page that we are searching identical page to.
  * @rmap_item: the reverse mapping into the virtual address of this page
+ * @hashed: checksum of the page computed ahead of time, or NULL
  */
-static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
+static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item,
+			       const unsigned int *hashed)
 {
 	struct mm_struct *mm = rmap_item->mm;
 	struct rmap_item *tree_rmap_item;
@@ -2050,7 +2068,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	 * don't want to insert it in the unstable tree, and we don't want
 	 * to waste our time searching for something identical to it there.
 	 */
-	checksum = calc_checksum(page);
+	checksum = hashed ? *hashed : calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
 		return;
@@ -2131,6 +2149,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	if (rmap_item) {
 		/* It has already been zeroed */
 		rmap_item->mm = mm_slot->mm;
+		rmap_item->mm->ksm_rmap_items++;
 		rmap_item->address = addr;
 		rmap_item->rmap_list = *rmap_list;
 		*rmap_list = rmap_item;
@@ -2138,7 +2157,24 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
-static struct rmap_item *scan_get_next_rmap_item(struct page **page)
+/*
+ * An mm at PR_SET_KSM_PRIORITY n is only scanned on one pass in 1 << n;
+ * but one that is exiting must still be visited, to be cleaned up.
+ */
+static bool ksm_skip_mm(struct mm_struct *mm)
+{
+	unsigned int prio = READ_ONCE(mm->ksm_priority);
+
+	return prio && !ksm_test_exit(mm) &&
+	       (ksm_scan.seqnr & ((1UL << prio) - 1));
+}
+
+/*
+ * @pending is the number of pages ksm_do_scan() has batched from the
+ * current mm: they must be merged before we move on to the next mm.
+ */
+static struct rmap_item *scan_get_next_rmap_item(struct page **page,
+						 unsigned int pending)
 {
 	struct mm_struct *mm;
 	struct mm_slot *slot;
@@ -2198,6 +2234,14 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 next_mm:
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
+		if (ksm_skip_mm(slot->mm)) {
+			spin_lock(&ksm_mmlist_lock);
+			slot = list_entry(slot->mm_list.next,
+					  struct mm_slot, mm_list);
+			ksm_scan.mm_slot = slot;
+			spin_unlock(&ksm_mmlist_lock);
+			goto next_slot;
+		}
 	}
 
 	mm = slot->mm;
@@ -2244,6 +2288,15 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 		}
 	}
 
+	/*
+	 * The rmap_items of the pages still batched may be freed below, and
+	 * the mm with them: have ksm_do_scan() merge those pages first.
+	 */
+	if (pending) {
+		up_read(&mm->mmap_sem);
+		return NULL;
+	}
+
 	if (ksm_test_exit(mm)) {
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
@@ -2289,6 +2342,7 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 
 	/* Repeat until we've completed scanning the whole list */
 	slot = ksm_scan.mm_slot;
+next_slot:
 	if (slot != &ksm_mm_head)
 		goto next_mm;
 
@@ -2296,23 +2350,156 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 	return NULL;
 }
 
+/**
+ * struct ksm_scan_entry - a page scanned by ksmd, waiting to be merged
+ * @rmap_item: the reverse mapping of the page in the mm being scanned
+ * @page: the page, with a reference held on it
+ * @checksum: calc_checksum() of the page, if @hashed
+ * @hashed: whether the checksum was computed ahead of the merge
+ */
+struct ksm_scan_entry {
+	struct rmap_item *rmap_item;
+	struct page *page;
+	unsigned int checksum;
+	bool hashed;
+};
+
+/**
+ * struct ksm_hash_work - checksums part of the batch on a node's CPUs
+ * @work: queued on ksm_hash_wq
+ * @nr: number of entries in the batch
+ * @nid: node of the pages checksummed by this work
+ * @index: first of that node's pages checksummed, then every @stride'th
+ * @stride: number of works queued for that node
+ */
+struct ksm_hash_work {
+	struct work_struct work;
+	unsigned int nr;
+	int nid;
+	unsigned int index;
+	unsigned int stride;
+};
+
+/* Only used by ksmd, under ksm_thread_mutex */
+static struct ksm_scan_entry ksm_scan_batch[KSM_SCAN_BATCH];
+static struct ksm_hash_work *ksm_hash_works;
+static struct workqueue_struct *ksm_hash_wq;
+
+static void ksm_hash_workfn(struct work_struct *work)
+{
+	struct ksm_hash_work *hw = container_of(work, struct ksm_hash_work,
+						work);
+	unsigned int i, seen = 0;
+
+	for (i = 0; i < hw->nr; i++) {
+		struct ksm_scan_entry *entry = &ksm_scan_batch[i];
+
+		if (PageKsm(entry->page) || page_to_nid(entry->page) != hw->nid)
+			continue;
+		if (seen++ % hw->stride != hw->index)
+			continue;
+		entry->checksum = calc_checksum(entry->page);
+		entry->hashed = true;
+		cond_resched();
+	}
+}
+
+/*
+ * Checksum the pages of the batch on CPUs local to them, ksm_hash_workers
+ * works per node, while ksmd waits: the trees are only ever touched by
+ * ksmd, this just takes the hashing of the pages off its hands.  KSM pages
+ * are left out, they are found in the stable tree without a checksum.
+ */
+static void ksm_hash_batch(unsigned int nr)
+{
+	unsigned int workers = READ_ONCE(ksm_hash_workers);
+	unsigned int i, w, queued = 0;
+	nodemask_t nodes = NODE_MASK_NONE;
+	int nid, cpu;
+
+	for (i = 0; i < nr; i++)
+		ksm_scan_batch[i].hashed = false;
+
+	if (!workers || !ksm_hash_wq)
+		return;
+
+	for (i = 0; i < nr; i++)
+		node_set(page_to_nid(ksm_scan_batch[i].page), nodes);
+
+	for_each_node_mask(nid, nodes) {
+		cpu = cpumask_any_and(cpumask_of_node(nid), cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			continue;
+		for (w = 0; w < workers; w++) {
+			struct ksm_hash_work *hw = &ksm_hash_works[queued++];
+
+			hw->nr = nr;
+			hw->nid = nid;
+			hw->index = w;
+			hw->stride = workers;
+			/* ksm_hash_wq is unbound: this picks the node only */
+			queue_work_on(cpu, ksm_hash_wq, &hw->work);
+		}
+	}
+
+	for (i = 0; i < queued; i++)
+		flush_work(&ksm_hash_works[i].work);
+
+	/* Whatever is on a node without CPUs online is up to ksmd */
+	for (i = 0; i < nr; i++) {
+		struct ksm_scan_entry *entry = &ksm_scan_batch[i];
+
+		if (!entry->hashed && !PageKsm(entry->page)) {
+			entry->checksum = calc_checksum(entry->page);
+			entry->hashed = true;
+		}
+	}
+}
+
+static void ksm_merge_batch(unsigned int nr)
+{
+	unsigned int i;
+
+	ksm_hash_batch(nr);
+	for (i = 0; i < nr; i++) {
+		struct ksm_scan_entry *entry = &ksm_scan_batch[i];
+
+		cond_resched();
+		cmp_and_merge_page(entry->page, entry->rmap_item,
+				   entry->hashed ? &entry->checksum : NULL);
+		put_page(entry->page);
+	}
+}
+
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages - number of pages we want to scan before we return.
  */
 static void ksm_do_scan(unsigned int scan_npages)
 {
-	struct rmap_item *rmap_item;
-	struct page *uninitialized_var(page);
+	struct ksm_scan_entry *entry;
+	unsigned int nr = 0;
 
-	while (scan_npages-- && likely(!freezing(current))) {
+	while (scan_npages && likely(!freezing(current))) {
 		cond_resched();
-		rmap_item = scan_get_next_rmap_item(&page);
-		if (!rmap_item)
-			return;
-		cmp_and_merge_page(page, rmap_item);
-		put_page(page);
+		entry = &ksm_scan_batch[nr];
+		entry->rmap_item = scan_get_next_rmap_item(&entry->page, nr);
+		if (!entry->rmap_item) {
+			/* End of the scan, or of the mm the batch came from */
+			if (!nr)
+				return;
+			ksm_merge_batch(nr);
+			nr = 0;
+			continue;
+		}
+		scan_npages--;
+		if (++nr == KSM_SCAN_BATCH) {
+			ksm_merge_batch(nr);
+			nr = 0;
+		}
 	}
+	if (nr)
+		ksm_merge_batch(nr);
 }
 
 static int ksmd_should_run(void)
@@ -2345,6 +2532,22 @@ static int ksm_scan_thread(void *nothing)
 	return 0;
 }
 
+/*
+ * Be somewhat over-protective for now!
+ */
+static bool ksm_compatible(unsigned long vm_flags)
+{
+	if (vm_flags & (VM_SHARED  | VM_MAYSHARE   | VM_PFNMAP   |
+			VM_IO      | VM_DONTEXPAND | VM_HUGETLB  | VM_MIXEDMAP))
+		return false;
+
+#ifdef VM_SAO
+	if (vm_flags & VM_SAO)
+		return false;
+#endif
+	return true;
+}
+
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
 {
@@ -2353,19 +2556,9 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 
 	switch (advice) {
 	case MADV_MERGEABLE:
-		/*
-		 * Be somewhat over-protective for now!
-		 */
-		if (*vm_flags & (VM_MERGEABLE | VM_SHARED  | VM_MAYSHARE   |
-				 VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
-				 VM_HUGETLB | VM_MIXEDMAP))
+		if ((*vm_flags & VM_MERGEABLE) || !ksm_compatible(*vm_flags))
 			return 0;		/* just ignore the advice */
 
-#ifdef VM_SAO
-		if (*vm_flags & VM_SAO)
-			return 0;
-#endif
-
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
 			err = __ksm_enter(mm);
 			if (err)
@@ -2392,6 +2585,85 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 	return 0;
 }
 
+unsigned long __ksm_vma_flags(struct mm_struct *mm, unsigned long vm_flags)
+{
+	if (!ksm_compatible(vm_flags))
+		return vm_flags;
+
+	/* After exec, the new mm has yet to be registered with ksmd */
+	if (!test_bit(MMF_VM_MERGEABLE, &mm->flags) && __ksm_enter(mm))
+		return vm_flags;
+
+	return vm_flags | VM_MERGEABLE;
+}
+
+/*
+ * PR_SET_MEMORY_MERGE: advise MADV_MERGEABLE on every vma of the mm that
+ * can take it, now and as they are mapped.  Called with mmap_sem held for
+ * writing.
+ */
+int ksm_enable_merge_any(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	int err;
+
+	if (test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		return 0;
+
+	if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
+		err = __ksm_enter(mm);
+		if (err)
+			return err;
+	}
+
+	set_bit(MMF_VM_MERGE_ANY, &mm->flags);
+	for (vma = mm->mmap; vma; vma = vma->vm_next)
+		if (ksm_compatible(vma->vm_flags))
+			vma->vm_flags |= VM_MERGEABLE;
+
+	return 0;
+}
+
+/*
+ * PR_SET_MEMORY_MERGE to 0: unmerge and MADV_UNMERGEABLE the whole mm,
+ * including any areas advised mergeable before.  Called with mmap_sem
+ * held for writing.
+ */
+int ksm_disable_merge_any(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	int err;
+
+	if (!test_and_clear_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		return 0;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (!(vma->vm_flags & VM_MERGEABLE))
+			continue;
+		if (vma->anon_vma) {
+			err = unmerge_ksm_pages(vma, vma->vm_start,
+						vma->vm_end);
+			if (err) {
+				set_bit(MMF_VM_MERGE_ANY, &mm->flags);
+				return err;
+			}
+		}
+		vma->vm_flags &= ~VM_MERGEABLE;
+	}
+
+	return 0;
+}
+
+/*
+ * What merging has saved the mm, net of the rmap_items kept for it: it goes
+ * negative for an mm scanned to little effect.
+ */
+long ksm_process_profit(struct mm_struct *mm)
+{
+	return (long)READ_ONCE(mm->ksm_merging_pages) * PAGE_SIZE -
+	       (long)READ_ONCE(mm->ksm_rmap_items) * sizeof(struct rmap_item);
+}
+
 int __ksm_enter(struct mm_struct *mm)
 {
 	struct mm_slot *mm_slot;
@@ -2772,6 +3044,31 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t hash_workers_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_hash_workers);
+}
+
+static ssize_t hash_workers_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	int err;
+	unsigned long workers;
+
+	err = kstrtoul(buf, 10, &workers);
+	if (err || workers > KSM_HASH_WORKERS_MAX)
+		return -EINVAL;
+	if (workers && !ksm_hash_wq)
+		return -ENOMEM;
+
+	WRITE_ONCE(ksm_hash_workers, workers);
+
+	return count;
+}
+KSM_ATTR(hash_workers);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -3029,6 +3326,7 @@ KSM_ATTR_RO(full_scans);
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&hash_workers_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
@@ -3052,6 +3350,26 @@ static const struct attribute_group ksm_attr_group = {
 };
 #endif /* CONFIG_SYSFS */
 
+static void __init ksm_hash_init(void)
+{
+	unsigned int i, nr = nr_node_ids * KSM_HASH_WORKERS_MAX;
+
+	ksm_hash_works = kcalloc(nr, sizeof(*ksm_hash_works), GFP_KERNEL);
+	if (!ksm_hash_works)
+		return;
+
+	/* Not freezable: ksmd flushes it before it can freeze itself */
+	ksm_hash_wq = alloc_workqueue("ksm_hash", WQ_UNBOUND, 0);
+	if (!ksm_hash_wq) {
+		kfree(ksm_hash_works);
+		ksm_hash_works = NULL;
+		return;
+	}
+
+	for (i = 0; i < nr; i++)
+		INIT_WORK(&ksm_hash_works[i].work, ksm_hash_workfn);
+}
+
 static int __init ksm_init(void)
 {
 	struct task_struct *ksm_thread;
@@ -3066,6 +3384,9 @@ static int __init ksm_init(void)
 	if (err)
 		goto out;
 
+	/* Without it, ksmd just computes all the checksums itself */
+	ksm_hash_init();
+
 	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
 	if (IS_ERR(ksm_thread)) {
 		pr_err("ksm: creating kthread failed\n");
@@ -3043,10 +3043,94 @@ int do_swap_page(struct vm_fault *vmf)
 	return ret;
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+static bool vma_has_changed(struct vm_fault *vmf)
+{
+	return read_seqcount_retry(&vmf->vma->vm_sequence, vmf->sequence);
+}
+
+/*
+ * Without mmap_sem nothing keeps the page tables from being freed under
+ * us but disabled interrupts, which hold off both the TLB shootdown IPI
+ * and the sched-RCU grace period table freeing waits for.  With them
+ * off, check the vma and the pmd did not change since the fault began,
+ * then only trylock the pte: spinning here could deadlock against a
+ * CPU that holds it while waiting for our TLB flush acknowledgement.
+ * Once the ptl is held, zapping this table has to wait for us.
+ */
+static bool pte_spec_map_lock(struct vm_fault *vmf)
+{
+	bool ret = false;
+	spinlock_t *ptl;
+	pte_t *pte;
+
+	local_irq_disable();
+	if (vma_has_changed(vmf))
+		goto out;
+	if (!pmd_same(READ_ONCE(*vmf->pmd), vmf->orig_pmd))
+		goto out;
+
+	ptl = pte_lockptr(vmf->vma->vm_mm, vmf->pmd);
+	pte = pte_offset_map(vmf->pmd, vmf->address);
+	if (unlikely(!spin_trylock(ptl))) {
+		pte_unmap(pte);
+		goto out;
+	}
+	if (vma_has_changed(vmf)) {
+		pte_unmap_unlock(pte, ptl);
+		goto out;
+	}
+
+	vmf->pte = pte;
+	vmf->ptl = ptl;
+	ret = true;
+out:
+	local_irq_enable();
+	return ret;
+}
+
+/*
+ * The vma's policy is not stable without mmap_sem, so speculative
+ * faults only run on vmas without one and allocate by task policy.
+ */
+static inline struct vm_area_struct *vmf_policy_vma(struct vm_fault *vmf)
+{
+	return (vmf->flags & FAULT_FLAG_SPECULATIVE) ? NULL : vmf->vma;
+}
+#else
+static inline bool pte_spec_map_lock(struct vm_fault *vmf)
+{
+	BUG();
+	return false;
+}
+
+static inline struct vm_area_struct *vmf_policy_vma(struct vm_fault *vmf)
+{
+	return vmf->vma;
+}
+#endif
+
+/*
+ * Map and lock the pte for vmf->address.  This can only fail for a
+ * speculative fault, which must then return VM_FAULT_RETRY.
+ */
+static bool pte_map_lock(struct vm_fault *vmf)
+{
+	if (vmf->flags & FAULT_FLAG_SPECULATIVE)
+		return pte_spec_map_lock(vmf);
+
+	vmf->pte = pte_offset_map_lock(vmf->vma->vm_mm, vmf->pmd,
+				       vmf->address, &vmf->ptl);
+	return true;
+}
+
 /*
  * We enter with non-exclusive mmap_sem (to exclude vma changes,
  * but allow concurrent faults), and pte mapped but not yet locked.
  * We return with mmap_sem still held, but pte unmapped and unlocked.
+ *
+ * A speculative fault enters without mmap_sem, with a pmd that was a
+ * regular page table and a pte that was none when it was sampled.
  */
 static int do_anonymous_page(struct vm_fault *vmf)
 {
@@ -3069,21 +3153,26 @@ static int do_anonymous_page(struct vm_fault *vmf)
 	 * parallel threads are excluded by other means.
 	 *
 	 * Here we only have down_read(mmap_sem).
+	 *
+	 * A speculative fault already checked the pmd, and rechecks it
+	 * in pte_map_lock().
 	 */
-	if (pte_alloc(vma->vm_mm, vmf->pmd, vmf->address))
-		return VM_FAULT_OOM;
+	if (!(vmf->flags & FAULT_FLAG_SPECULATIVE)) {
+		if (pte_alloc(vma->vm_mm, vmf->pmd, vmf->address))
+			return VM_FAULT_OOM;
 
-	/* See the comment in pte_alloc_one_map() */
-	if (unlikely(pmd_trans_unstable(vmf->pmd)))
-		return 0;
+		/* See the comment in pte_alloc_one_map() */
+		if (unlikely(pmd_trans_unstable(vmf->pmd)))
+			return 0;
+	}
 
 	/* Use the zero-page for reads */
 	if (!(vmf->flags & FAULT_FLAG_WRITE) &&
 			!mm_forbids_zeropage(vma->vm_mm)) {
 		entry = pte_mkspecial(pfn_pte(my_zero_pfn(vmf->address),
 						vma->vm_page_prot));
-		vmf->pte = pte_offset_map_lock(vma->vm_mm, vmf->pmd,
-				vmf->address, &vmf->ptl);
+		if (!pte_map_lock(vmf))
+			return VM_FAULT_RETRY;
 		if (!pte_none(*vmf->pte))
 			goto unlock;
 		ret = check_stable_address_space(vma->vm_mm);
@@ -3098,9 +3187,14 @@ static int do_anonymous_page(struct vm_fault *vmf)
 	}
 
 	/* Allocate our own private page. */
-	if (unlikely(anon_vma_prepare(vma)))
+	if (vmf->flags & FAULT_FLAG_SPECULATIVE) {
+		/* Setting up an anon_vma needs mmap_sem */
+		if (!READ_ONCE(vma->anon_vma))
+			return VM_FAULT_RETRY;
+	} else if (unlikely(anon_vma_prepare(vma)))
 		goto oom;
-	page = alloc_zeroed_user_highpage_movable(vma, vmf->address);
+	page = alloc_zeroed_user_highpage_movable(vmf_policy_vma(vmf),
+						  vmf->address);
 	if (!page)
 		goto oom;
 
@@ -3118,8 +3212,11 @@ static int do_anonymous_page(struct vm_fault *vmf)
 	if (vma->vm_flags & VM_WRITE)
 		entry = pte_mkwrite(pte_mkdirty(entry));
 
-	vmf->pte = pte_offset_map_lock(vma->vm_mm, vmf->pmd, vmf->address,
-			&vmf->ptl);
+	if (!pte_map_lock(vmf)) {
+		mem_cgroup_cancel_charge(page, memcg, false);
+		put_page(page);
+		return VM_FAULT_RETRY;
+	}
 	if (!pte_none(*vmf->pte))
 		goto release;
 
@@ -3203,6 +3300,10 @@ static int pte_alloc_one_map(struct vm_fault *vmf)
 {
 	struct vm_area_struct *vma = vmf->vma;
 
+	/* The pmd was a regular page table when the fault began */
+	if (vmf->flags & FAULT_FLAG_SPECULATIVE)
+		return pte_map_lock(vmf) ? 0 : VM_FAULT_RETRY;
+
 	if (!pmd_none(*vmf->pmd))
 		goto map_pte;
 	if (vmf->prealloc_pte) {
@@ -3571,7 +3672,8 @@ static int do_read_fault(struct vm_fault *vmf)
 	 * if page by the offset is not ready to be mapped (cold cache or
 	 * something).
 	 */
-	if (vma->vm_ops->map_pages && fault_around_bytes >> PAGE_SHIFT > 1) {
+	if (vma->vm_ops->map_pages && fault_around_bytes >> PAGE_SHIFT > 1 &&
+	    !(vmf->flags & FAULT_FLAG_SPECULATIVE)) {
 		ret = do_fault_around(vmf);
 		if (ret)
 			return ret;
@@ -3593,10 +3695,14 @@ static int do_cow_fault(struct vm_fault *vmf)
 	struct vm_area_struct *vma = vmf->vma;
 	int ret;
 
-	if (unlikely(anon_vma_prepare(vma)))
+	if (vmf->flags & FAULT_FLAG_SPECULATIVE) {
+		if (!READ_ONCE(vma->anon_vma))
+			return VM_FAULT_RETRY;
+	} else if (unlikely(anon_vma_prepare(vma)))
 		return VM_FAULT_OOM;
 
-	vmf->cow_page = alloc_page_vma(GFP_HIGHUSER_MOVABLE, vma, vmf->address);
+	vmf->cow_page = alloc_page_vma(GFP_HIGHUSER_MOVABLE,
+				       vmf_policy_vma(vmf), vmf->address);
 	if (!vmf->cow_page)
 		return VM_FAULT_OOM;
 
@@ -3787,6 +3893,7 @@ static int do_numa_page(struct vm_fault *vmf)
 	if (migrated) {
 		page_nid = target_nid;
 		flags |= TNF_MIGRATED;
+		vma_numa_note_migrated(vma);
 	} else
 		flags |= TNF_MIGRATE_FAIL;
 
@@ -4086,6 +4193,154 @@ int handle_mm_fault(struct vm_area_struct *vma, unsigned long address,
 }
 EXPORT_SYMBOL_GPL(handle_mm_fault);
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Speculative faults only handle the first touch of a page, in a vma
+ * whose fault path is known not to depend on mmap_sem.
+ */
+static bool vma_can_speculate(struct vm_area_struct *vma, unsigned int flags)
+{
+	unsigned long vm_flags = READ_ONCE(vma->vm_flags);
+
+	if (vm_flags & (VM_HUGETLB | VM_PFNMAP | VM_MIXEDMAP |
+			VM_GROWSDOWN | VM_GROWSUP |
+			VM_UFFD_MISSING | VM_UFFD_WP))
+		return false;
+
+	if (flags & FAULT_FLAG_WRITE) {
+		if (!(vm_flags & VM_WRITE))
+			return false;
+	} else if (flags & FAULT_FLAG_INSTRUCTION) {
+		if (!(vm_flags & VM_EXEC))
+			return false;
+	} else if (!(vm_flags & VM_READ)) {
+		return false;
+	}
+
+	if (vma_policy(vma))
+		return false;
+
+	if (vma_is_anonymous(vma))
+		return true;
+
+	/*
+	 * Only the generic page cache fault is known to be safe, and a
+	 * shared write would need ->page_mkwrite() and dirty accounting.
+	 */
+	if (vma->vm_ops->fault != filemap_fault)
+		return false;
+	if ((flags & FAULT_FLAG_WRITE) && (vm_flags & VM_SHARED))
+		return false;
+	return true;
+}
+
+/*
+ * Try to handle a user fault on current->mm without taking mmap_sem.
+ *
+ * The vma is looked up under mm->mm_rb_lock and pinned by a reference,
+ * then validated against vma->vm_sequence, which every change to the
+ * fields used here bumps (and an unmap leaves odd).  The page tables
+ * are walked with interrupts disabled and only a none pte under a
+ * regular page table is handled; the sequence and the pmd are checked
+ * again once the pte lock is held, before anything is installed.
+ *
+ * Returns VM_FAULT_RETRY if the fault has to be handled the usual way,
+ * under mmap_sem, which includes any error: the regular path redoes
+ * the fault and reports it.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags)
+{
+	struct vm_fault vmf = {
+		.address = address & PAGE_MASK,
+	};
+	struct vm_area_struct *vma;
+	pgd_t *pgd;
+	p4d_t *p4d;
+	pte_t *pte;
+	int ret = VM_FAULT_RETRY;
+
+	/* Nothing to drop on retry, and nowhere to wait for it */
+	flags &= ~(FAULT_FLAG_ALLOW_RETRY | FAULT_FLAG_KILLABLE);
+	flags |= FAULT_FLAG_SPECULATIVE;
+
+	if (mm_has_notifiers(mm))
+		return VM_FAULT_RETRY;
+
+	vma = get_vma(mm, address);
+	if (!vma)
+		return VM_FAULT_RETRY;
+
+	vmf.sequence = raw_read_seqcount(&vma->vm_sequence);
+	if (vmf.sequence & 1)
+		goto out_put;
+	if (!vma_can_speculate(vma, flags))
+		goto out_put;
+	if (address < READ_ONCE(vma->vm_start) ||
+	    READ_ONCE(vma->vm_end) <= address)
+		goto out_put;
+	if (!arch_vma_access_permitted(vma, flags & FAULT_FLAG_WRITE,
+				       flags & FAULT_FLAG_INSTRUCTION,
+				       flags & FAULT_FLAG_REMOTE))
+		goto out_put;
+
+	vmf.vma = vma;
+	vmf.flags = flags;
+	vmf.pgoff = linear_page_index(vma, address);
+	vmf.gfp_mask = __get_fault_gfp_mask(vma);
+
+	__set_current_state(TASK_RUNNING);
+	check_sync_rss_stat(current);
+
+	/* See pte_spec_map_lock() for why interrupts are disabled */
+	local_irq_disable();
+	pgd = pgd_offset(mm, address);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		goto out_walk;
+	p4d = p4d_offset(pgd, address);
+	if (p4d_none(*p4d) || unlikely(p4d_bad(*p4d)))
+		goto out_walk;
+	vmf.pud = pud_offset(p4d, address);
+	if (pud_none(*vmf.pud) || unlikely(pud_bad(*vmf.pud)))
+		goto out_walk;
+	vmf.pmd = pmd_offset(vmf.pud, address);
+	vmf.orig_pmd = READ_ONCE(*vmf.pmd);
+	/* huge, swap and migration pmds all go the regular way */
+	if (pmd_none(vmf.orig_pmd) || !pmd_present(vmf.orig_pmd) ||
+	    pmd_trans_huge(vmf.orig_pmd) || pmd_devmap(vmf.orig_pmd) ||
+	    unlikely(pmd_bad(vmf.orig_pmd)))
+		goto out_walk;
+
+	pte = pte_offset_map(&vmf.orig_pmd, address);
+	vmf.orig_pte = READ_ONCE(*pte);
+	pte_unmap(pte);
+	local_irq_enable();
+
+	if (!pte_none(vmf.orig_pte))
+		goto out_put;
+
+	if (vma_is_anonymous(vma))
+		ret = do_anonymous_page(&vmf);
+	else
+		ret = do_fault(&vmf);
+
+	if (ret & VM_FAULT_ERROR)
+		ret = VM_FAULT_RETRY;
+	if (!(ret & VM_FAULT_RETRY)) {
+		count_vm_event(PGFAULT);
+		count_vm_event(SPECULATIVE_PGFAULT);
+		count_memcg_event_mm(mm, PGFAULT);
+	}
+	goto out_put;
+
+out_walk:
+	local_irq_enable();
+out_put:
+	put_vma(vma);
+	return ret;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_P4D_FOLDED
 /*
  * Allocate p4d page table.
@@ -0,0 +1,514 @@
+/*
+ * Pools of pre-zeroed pages
+ *
+ * Anonymous and THP faults clear every page they allocate, and for a
+ * 2MB page that is hundreds of microseconds spent in the fault path.
+ * When enabled, a SCHED_IDLE kthread per node (kprezerod) allocates
+ * order-0 and PMD-order pages while its CPUs have nothing better to do,
+ * clears them and keeps them on a per-node list, tagged PG_zeroed.
+ * Movable __GFP_ZERO allocations are served from that list before the
+ * buddy freelists are looked at.
+ *
+ * Pooled pages are ordinary allocated pages, so the buddy allocator and
+ * its merging never see them; a shrinker returns them to the freelists
+ * under memory pressure, and the pool is only filled while the node is
+ * above its high watermarks.
+ */
+#include <linux/cpuset.h>
+#include <linux/freezer.h>
+#include <linux/gfp.h>
+#include <linux/highmem.h>
+#include <linux/huge_mm.h>
+#include <linux/init.h>
+#include <linux/kthread.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/page_prezero.h>
+#include <linux/sched.h>
+#include <linux/shrinker.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <uapi/linux/sched/types.h>
+
+#include "internal.h"
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define PREZERO_NR_ORDERS	2
+#else
+#define PREZERO_NR_ORDERS	1
+#endif
+
+/* Pooled pages are movable and must not dip into the node's reserves */
+#define PREZERO_GFP	((GFP_HIGHUSER_MOVABLE | __GFP_THISNODE |	\
+			  __GFP_NOWARN | __GFP_NORETRY |		\
+			  __GFP_NOMEMALLOC) & ~__GFP_RECLAIM)
+
+struct prezero_pool {
+	spinlock_t lock;
+	struct list_head pages[PREZERO_NR_ORDERS];
+	unsigned long nr_pages[PREZERO_NR_ORDERS];
+	int nid;
+	wait_queue_head_t wait;
+	struct task_struct *thread;
+};
+
+DEFINE_STATIC_KEY_FALSE(page_prezero_key);
+
+static struct prezero_pool *prezero_pools[MAX_NUMNODES];
+static DEFINE_MUTEX(prezero_mutex);
+
+/* Per-node pool size, in pages of each order */
+static unsigned long prezero_target[PREZERO_NR_ORDERS] = {
+	256,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	4,
+#endif
+};
+
+static unsigned int prezero_order(int idx)
+{
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (idx)
+		return HPAGE_PMD_ORDER;
+#endif
+	return 0;
+}
+
+static int prezero_index(unsigned int order)
+{
+	if (!order)
+		return 0;
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (order == HPAGE_PMD_ORDER)
+		return 1;
+#endif
+	return -1;
+}
+
+static bool prezero_below_target(struct prezero_pool *pool, int idx)
+{
+	return READ_ONCE(pool->nr_pages[idx]) < READ_ONCE(prezero_target[idx]);
+}
+
+static void prezero_free_page(struct page *page, unsigned int order)
+{
+	ClearPageZeroed(page);
+	__free_pages(page, order);
+}
+
+struct page *page_prezero_alloc(gfp_t gfp_mask, unsigned int order,
+				unsigned int alloc_flags,
+				const struct alloc_context *ac)
+{
+	struct zone *zone = ac->preferred_zoneref->zone;
+	struct prezero_pool *pool;
+	struct page *page;
+	unsigned long flags;
+	bool wake;
+	int idx;
+
+	/* The pool holds movable pages, possibly from CMA or ZONE_MOVABLE */
+	idx = prezero_index(order);
+	if (idx < 0 || ac->migratetype != MIGRATE_MOVABLE || !zone)
+		return NULL;
+
+	pool = prezero_pools[zone_to_nid(zone)];
+	if (!pool || !READ_ONCE(pool->nr_pages[idx]))
+		return NULL;
+
+	if (ac->nodemask && !node_isset(pool->nid, *ac->nodemask))
+		return NULL;
+	if (cpusets_enabled() && (alloc_flags & ALLOC_CPUSET) &&
+	    !__cpuset_zone_allowed(zone, gfp_mask))
+		return NULL;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	page = list_first_entry_or_null(&pool->pages[idx], struct page, lru);
+	if (!page || page_zonenum(page) > ac->high_zoneidx) {
+		spin_unlock_irqrestore(&pool->lock, flags);
+		return NULL;
+	}
+	list_del(&page->lru);
+	pool->nr_pages[idx]--;
+	wake = pool->nr_pages[idx] < READ_ONCE(prezero_target[idx]) / 2;
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	VM_BUG_ON_PAGE(!PageZeroed(page), page);
+	ClearPageZeroed(page);
+	if (order && (gfp_mask & __GFP_COMP))
+		prep_compound_page(page, order);
+
+	if (wake && wq_has_sleeper(&pool->wait))
+		wake_up_interruptible(&pool->wait);
+
+	return page;
+}
+
+/* Zeroing is only worth it while the node has memory to spare */
+static bool prezero_node_has_room(int nid, unsigned int order)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int i;
+
+	for (i = 0; i < MAX_NR_ZONES; i++) {
+		struct zone *zone = pgdat->node_zones + i;
+
+		if (!managed_zone(zone))
+			continue;
+
+		if (zone_watermark_ok(zone, order, high_wmark_pages(zone),
+				      i, 0))
+			return true;
+	}
+
+	return false;
+}
+
+static bool prezero_fill(struct prezero_pool *pool, int idx)
+{
+	unsigned int order = prezero_order(idx);
+	struct page *page;
+	int i;
+
+	if (!prezero_node_has_room(pool->nid, order))
+		return false;
+
+	page = alloc_pages_node(pool->nid, PREZERO_GFP, order);
+	if (!page)
+		return false;
+
+	for (i = 0; i < (1 << order); i++) {
+		clear_highpage(page + i);
+		cond_resched();
+	}
+	SetPageZeroed(page);
+
+	spin_lock_irq(&pool->lock);
+	if (page_prezero_enabled() && prezero_below_target(pool, idx)) {
+		list_add(&page->lru, &pool->pages[idx]);
+		pool->nr_pages[idx]++;
+		page = NULL;
+	}
+	spin_unlock_irq(&pool->lock);
+
+	if (page)
+		prezero_free_page(page, order);
+
+	return true;
+}
+
+/* Pick the order to fill next, huge pages first */
+static int prezero_next_index(struct prezero_pool *pool)
+{
+	int idx;
+
+	if (!page_prezero_enabled())
+		return -1;
+
+	for (idx = PREZERO_NR_ORDERS - 1; idx >= 0; idx--)
+		if (prezero_below_target(pool, idx))
+			return idx;
+
+	return -1;
+}
+
+static int kprezerod(void *data)
+{
+	struct prezero_pool *pool = data;
+	struct sched_param param = { .sched_priority = 0 };
+	int idx;
+
+	/* Only run when the CPU would otherwise be idle */
+	sched_setscheduler_nocheck(current, SCHED_IDLE, &param);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		idx = prezero_next_index(pool);
+		if (idx < 0) {
+			wait_event_freezable(pool->wait,
+					     kthread_should_stop() ||
+					     prezero_next_index(pool) >= 0);
+			continue;
+		}
+
+		if (!prezero_fill(pool, idx))
+			freezable_schedule_timeout_interruptible(HZ);
+	}
+
+	return 0;
+}
+
+/* Give the pool's pages of one order back to the buddy, oldest first */
+static unsigned long prezero_drain_index(struct prezero_pool *pool, int idx,
+					 unsigned long nr)
+{
+	unsigned int order = prezero_order(idx);
+	unsigned long nr_freed = 0;
+	struct page *page, *next;
+	LIST_HEAD(list);
+
+	spin_lock_irq(&pool->lock);
+	while (nr_freed < nr && pool->nr_pages[idx]) {
+		page = list_last_entry(&pool->pages[idx], struct page, lru);
+		list_move(&page->lru, &list);
+		pool->nr_pages[idx]--;
+		nr_freed++;
+	}
+	spin_unlock_irq(&pool->lock);
+
+	list_for_each_entry_safe(page, next, &list, lru) {
+		list_del(&page->lru);
+		prezero_free_page(page, order);
+	}
+
+	return nr_freed << order;
+}
+
+/* Give up to @nr_to_scan base pages back, huge pages first */
+static unsigned long prezero_drain(struct prezero_pool *pool,
+				   unsigned long nr_to_scan)
+{
+	unsigned long nr_freed = 0;
+	int idx;
+
+	for (idx = PREZERO_NR_ORDERS - 1; idx >= 0; idx--) {
+		unsigned long nr;
+
+		if (nr_freed >= nr_to_scan)
+			break;
+
+		/* Round up, without overflowing for ULONG_MAX */
+		nr = ((nr_to_scan - nr_freed - 1) >> prezero_order(idx)) + 1;
+		nr_freed += prezero_drain_index(pool, idx, nr);
+	}
+
+	return nr_freed;
+}
+
+/* Number of base pages held in @pool */
+static unsigned long prezero_pool_pages(struct prezero_pool *pool)
+{
+	unsigned long count = 0;
+	int idx;
+
+	for (idx = 0; idx < PREZERO_NR_ORDERS; idx++)
+		count += READ_ONCE(pool->nr_pages[idx]) << prezero_order(idx);
+
+	return count;
+}
+
+static unsigned long prezero_shrink_count(struct shrinker *shrink,
+					  struct shrink_control *sc)
+{
+	struct prezero_pool *pool = prezero_pools[sc->nid];
+
+	return pool ? prezero_pool_pages(pool) : 0;
+}
+
+static unsigned long prezero_shrink_scan(struct shrinker *shrink,
+					 struct shrink_control *sc)
+{
+	struct prezero_pool *pool = prezero_pools[sc->nid];
+
+	if (!pool)
+		return SHRINK_STOP;
+
+	return prezero_drain(pool, sc->nr_to_scan);
+}
+
+static struct shrinker prezero_shrinker = {
+	.count_objects = prezero_shrink_count,
+	.scan_objects = prezero_shrink_scan,
+	.seeks = DEFAULT_SEEKS,
+	.flags = SHRINKER_NUMA_AWARE,
+};
+
+static void prezero_wake_all(void)
+{
+	int nid;
+
+	for_each_node(nid)
+		if (prezero_pools[nid])
+			wake_up_interruptible(&prezero_pools[nid]->wait);
+}
+
+#ifdef CONFIG_SYSFS
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", page_prezero_enabled());
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	bool enable;
+	int nid;
+
+	if (kstrtobool(buf, &enable))
+		return -EINVAL;
+
+	mutex_lock(&prezero_mutex);
+	if (enable && !page_prezero_enabled()) {
+		static_branch_enable(&page_prezero_key);
+		prezero_wake_all();
+	} else if (!enable && page_prezero_enabled()) {
+		static_branch_disable(&page_prezero_key);
+		for_each_node(nid)
+			if (prezero_pools[nid])
+				prezero_drain(prezero_pools[nid], ULONG_MAX);
+	}
+	mutex_unlock(&prezero_mutex);
+
+	return count;
+}
+static struct kobj_attribute enabled_attr =
+	__ATTR(enabled, 0644, enabled_show, enabled_store);
+
+static ssize_t prezero_target_show(int idx, char *buf)
+{
+	return sprintf(buf, "%lu\n", READ_ONCE(prezero_target[idx]));
+}
+
+static ssize_t prezero_target_store(int idx, const char *buf, size_t count)
+{
+	unsigned long target;
+	int nid;
+
+	if (kstrtoul(buf, 10, &target))
+		return -EINVAL;
+
+	mutex_lock(&prezero_mutex);
+	WRITE_ONCE(prezero_target[idx], target);
+	for_each_node(nid) {
+		struct prezero_pool *pool = prezero_pools[nid];
+		unsigned long nr;
+
+		if (!pool)
+			continue;
+
+		nr = READ_ONCE(pool->nr_pages[idx]);
+		if (nr > target)
+			prezero_drain_index(pool, idx, nr - target);
+	}
+	prezero_wake_all();
+	mutex_unlock(&prezero_mutex);
+
+	return count;
+}
+
+static ssize_t pages_show(struct kobject *kobj,
+			  struct kobj_attribute *attr, char *buf)
+{
+	return prezero_target_show(0, buf);
+}
+
+static ssize_t pages_store(struct kobject *kobj,
+			   struct kobj_attribute *attr,
+			   const char *buf, size_t count)
+{
+	return prezero_target_store(0, buf, count);
+}
+static struct kobj_attribute pages_attr =
+	__ATTR(pages, 0644, pages_show, pages_store);
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+static ssize_t huge_pages_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return prezero_target_show(1, buf);
+}
+
+static ssize_t huge_pages_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	return prezero_target_store(1, buf, count);
+}
+static struct kobj_attribute huge_pages_attr =
+	__ATTR(huge_pages, 0644, huge_pages_show, huge_pages_store);
+#endif
+
+static ssize_t pool_pages_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	unsigned long count = 0;
+	int nid;
+
+	for_each_node(nid)
+		if (prezero_pools[nid])
+			count += prezero_pool_pages(prezero_pools[nid]);
+
+	return sprintf(buf, "%lu\n", count);
+}
+static struct kobj_attribute pool_pages_attr = __ATTR_RO(pool_pages);
+
+static struct attribute *prezero_attrs[] = {
+	&enabled_attr.attr,
+	&pages_attr.attr,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	&huge_pages_attr.attr,
+#endif
+	&pool_pages_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group prezero_attr_group = {
+	.attrs = prezero_attrs,
+	.name = "prezero",
+};
+#endif /* CONFIG_SYSFS */
+
+static int __init prezero_init_node(int nid)
+{
+	struct prezero_pool *pool;
+	int idx;
+
+	pool = kzalloc_node(sizeof(*pool), GFP_KERNEL, nid);
+	if (!pool)
+		return -ENOMEM;
+
+	spin_lock_init(&pool->lock);
+	for (idx = 0; idx < PREZERO_NR_ORDERS; idx++)
+		INIT_LIST_HEAD(&pool->pages[idx]);
+	init_waitqueue_head(&pool->wait);
+	pool->nid = nid;
+
+	pool->thread = kthread_create_on_node(kprezerod, pool, nid,
+					      "kprezerod%d", nid);
+	if (IS_ERR(pool->thread)) {
+		int err = PTR_ERR(pool->thread);
+
+		kfree(pool);
+		return err;
+	}
+
+	if (!cpumask_empty(cpumask_of_node(nid)))
+		set_cpus_allowed_ptr(pool->thread, cpumask_of_node(nid));
+
+	prezero_pools[nid] = pool;
+	wake_up_process(pool->thread);
+
+	return 0;
+}
+
+static int __init page_prezero_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY)
+		if (prezero_init_node(nid))
+			pr_err("prezero: failed to start kprezerod%d\n", nid);
+
+	if (register_shrinker(&prezero_shrinker))
+		pr_err("prezero: register shrinker failed\n");
+
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &prezero_attr_group))
+		pr_err("prezero: register sysfs failed\n");
+#endif
+	return 0;
+}
+late_initcall(page_prezero_init);
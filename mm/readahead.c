@@ -112,7 +112,8 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		struct list_head *pages, unsigned int nr_pages, gfp_t gfp)
 {
 	struct blk_plug plug;
-	unsigned page_idx;
+	struct readahead_batch rab;
+	struct page *page;
 	int ret;
 
 	blk_start_plug(&plug);
@@ -124,11 +125,9 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		goto out;
 	}
 
-	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
-		struct page *page = lru_to_page(pages);
-		list_del(&page->lru);
-		if (!add_to_page_cache_lru(page, mapping, page->index, gfp))
-			mapping->a_ops->readpage(filp, page);
+	readahead_batch_init(&rab);
+	while ((page = readahead_next_page(mapping, pages, &rab, gfp))) {
+		mapping->a_ops->readpage(filp, page);
 		put_page(page);
 	}
 	ret = 0;
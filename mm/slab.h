@@ -144,7 +144,8 @@ static inline unsigned long kmem_cache_flags(unsigned long object_size,
 			  SLAB_NOTRACK | SLAB_ACCOUNT)
 #elif defined(CONFIG_SLUB)
 #define SLAB_CACHE_FLAGS (SLAB_NOLEAKTRACE | SLAB_RECLAIM_ACCOUNT | \
-			  SLAB_TEMPORARY | SLAB_NOTRACK | SLAB_ACCOUNT)
+			  SLAB_TEMPORARY | SLAB_NOTRACK | SLAB_ACCOUNT | \
+			  SLAB_SHEAVES)
 #else
 #define SLAB_CACHE_FLAGS (0)
 #endif
@@ -164,7 +165,8 @@ static inline unsigned long kmem_cache_flags(unsigned long object_size,
 			      SLAB_RECLAIM_ACCOUNT | \
 			      SLAB_TEMPORARY | \
 			      SLAB_NOTRACK | \
-			      SLAB_ACCOUNT)
+			      SLAB_ACCOUNT | \
+			      SLAB_SHEAVES)
 
 int __kmem_cache_shutdown(struct kmem_cache *);
 void __kmem_cache_release(struct kmem_cache *);
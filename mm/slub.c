@@ -1955,6 +1955,224 @@ static void *get_partial(struct kmem_cache *s, gfp_t flags, int node,
 	return get_any_partial(s, flags, c);
 }
 
+/*
+ * Per cpu sheaves of objects.
+ *
+ * A cache created with SLAB_SHEAVES keeps a per cpu array of free objects
+ * in front of its slabs, much like the array caches of SLAB.  Allocations
+ * and frees on the local node are then served with interrupts disabled
+ * and no cmpxchg at all.  An empty sheaf is refilled with half of its
+ * capacity from the node's partial slabs, and a full one flushes half of
+ * its objects back, each under a single list_lock acquisition.
+ */
+static inline bool kmem_cache_has_sheaves(struct kmem_cache *s)
+{
+	return READ_ONCE(s->sheaf_capacity);
+}
+
+/*
+ * Take up to @max objects off the freelist of the partial slab @page.
+ * Returns the number of objects taken.  Called with n->list_lock held,
+ * which keeps everybody but remote frees away from this slab.
+ */
+static unsigned int take_from_partial(struct kmem_cache *s,
+		struct kmem_cache_node *n, struct page *page,
+		void **p, unsigned int max)
+{
+	unsigned long counters;
+	void *freelist, *object;
+	struct page new;
+	unsigned int nr;
+
+	do {
+		freelist = page->freelist;
+		counters = page->counters;
+		new.counters = counters;
+
+		object = freelist;
+		for (nr = 0; object && nr < max; nr++) {
+			p[nr] = object;
+			object = get_freepointer(s, object);
+		}
+		new.inuse += nr;
+	} while (!__cmpxchg_double_slab(s, page,
+			freelist, counters,
+			object, new.counters,
+			"take_from_partial"));
+
+	if (!object)
+		remove_partial(n, page);
+
+	return nr;
+}
+
+/*
+ * Fill @p with up to @max objects from the partial slabs of the local
+ * node, under one list_lock acquisition.  Called with interrupts
+ * disabled.
+ */
+static unsigned int refill_from_partials(struct kmem_cache *s, void **p,
+					 unsigned int max)
+{
+	struct kmem_cache_node *n = get_node(s, numa_mem_id());
+	struct page *page, *page2;
+	unsigned int nr = 0;
+
+	if (!n || !n->nr_partial)
+		return 0;
+
+	spin_lock(&n->list_lock);
+	list_for_each_entry_safe(page, page2, &n->partial, lru) {
+		/* never hand out the reserves through a sheaf */
+		if (unlikely(PageSlabPfmemalloc(page)))
+			continue;
+
+		nr += take_from_partial(s, n, page, p + nr, max - nr);
+		if (nr == max)
+			break;
+	}
+	spin_unlock(&n->list_lock);
+
+	if (nr)
+		stat(s, SHEAF_REFILL);
+	return nr;
+}
+
+/*
+ * Give @nr objects back to their slabs, taking the list_lock of each
+ * node once for a run of objects from that node.  Called with
+ * interrupts disabled.
+ */
+static void flush_to_slabs(struct kmem_cache *s, void **p, unsigned int nr)
+{
+	struct kmem_cache_node *n = NULL;
+	struct page *page, *t;
+	LIST_HEAD(discard);
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		void *object = p[i];
+		unsigned long counters;
+		struct page new;
+		void *prior;
+		int was_frozen;
+
+		page = virt_to_head_page(object);
+		if (n != get_node(s, page_to_nid(page))) {
+			if (n)
+				spin_unlock(&n->list_lock);
+			n = get_node(s, page_to_nid(page));
+			spin_lock(&n->list_lock);
+		}
+
+		do {
+			prior = page->freelist;
+			counters = page->counters;
+			set_freepointer(s, object, prior);
+			new.counters = counters;
+			was_frozen = new.frozen;
+			new.inuse--;
+		} while (!__cmpxchg_double_slab(s, page,
+				prior, counters,
+				object, new.counters,
+				"flush_to_slabs"));
+
+		/* a frozen slab is taken care of by its cpu */
+		if (was_frozen)
+			continue;
+
+		if (!new.inuse && n->nr_partial >= s->min_partial) {
+			if (prior)
+				remove_partial(n, page);
+			list_add(&page->lru, &discard);
+		} else if (!prior) {
+			add_partial(n, page, DEACTIVATE_TO_TAIL);
+			stat(s, FREE_ADD_PARTIAL);
+		}
+	}
+	if (n)
+		spin_unlock(&n->list_lock);
+
+	stat(s, SHEAF_FLUSH);
+
+	list_for_each_entry_safe(page, t, &discard, lru) {
+		stat(s, FREE_SLAB);
+		discard_slab(s, page);
+	}
+}
+
+static void *sheaf_alloc(struct kmem_cache *s)
+{
+	struct slub_sheaf *sheaf;
+	unsigned long flags;
+	void *object = NULL;
+
+	local_irq_save(flags);
+	sheaf = this_cpu_ptr(s->sheaves);
+	if (unlikely(!sheaf->size))
+		sheaf->size = refill_from_partials(s, sheaf->objects,
+						   s->sheaf_capacity / 2);
+	if (likely(sheaf->size)) {
+		object = sheaf->objects[--sheaf->size];
+		stat(s, SHEAF_ALLOC);
+	}
+	local_irq_restore(flags);
+
+	return object;
+}
+
+/*
+ * Returns false if @object has to go back to its slab the usual way:
+ * objects from other nodes or from the reserves don't go into sheaves.
+ */
+static bool sheaf_free(struct kmem_cache *s, struct page *page, void *object)
+{
+	struct slub_sheaf *sheaf;
+	unsigned int capacity;
+	unsigned long flags;
+	bool ret = false;
+
+	if (unlikely(PageSlabPfmemalloc(page)))
+		return false;
+
+	local_irq_save(flags);
+	capacity = READ_ONCE(s->sheaf_capacity);
+	if (unlikely(!capacity || page_to_nid(page) != numa_mem_id()))
+		goto out;
+
+	sheaf = this_cpu_ptr(s->sheaves);
+	if (unlikely(sheaf->size >= capacity)) {
+		unsigned int batch = capacity / 2;
+
+		/* the oldest objects are the coldest ones */
+		flush_to_slabs(s, sheaf->objects, batch);
+		sheaf->size -= batch;
+		memmove(sheaf->objects, sheaf->objects + batch,
+			sheaf->size * sizeof(void *));
+	}
+	sheaf->objects[sheaf->size++] = object;
+	stat(s, SHEAF_FREE);
+	ret = true;
+out:
+	local_irq_restore(flags);
+	return ret;
+}
+
+/* Called with interrupts disabled */
+static void flush_sheaf(struct kmem_cache *s, int cpu)
+{
+	struct slub_sheaf *sheaf;
+
+	if (!s->sheaves)
+		return;
+
+	sheaf = per_cpu_ptr(s->sheaves, cpu);
+	if (sheaf->size) {
+		flush_to_slabs(s, sheaf->objects, sheaf->size);
+		sheaf->size = 0;
+	}
+}
+
 #ifdef CONFIG_PREEMPT
 /*
  * Calculate the next globally unique transaction for disambiguiation
@@ -2322,6 +2540,8 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 
 		unfreeze_partials(s, c);
 	}
+
+	flush_sheaf(s, cpu);
 }
 
 static void flush_cpu_slab(void *d)
@@ -2336,12 +2556,13 @@ static bool has_cpu_slab(int cpu, void *info)
 	struct kmem_cache *s = info;
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	return c->page || slub_percpu_partial(c);
+	return c->page || slub_percpu_partial(c) ||
+		(s->sheaves && per_cpu_ptr(s->sheaves, cpu)->size);
 }
 
 static void flush_all(struct kmem_cache *s)
 {
-	on_each_cpu_cond(has_cpu_slab, flush_cpu_slab, s, 1, GFP_ATOMIC);
+	on_each_cpu_cond(has_cpu_slab, flush_cpu_slab, s, 1);
 }
 
 /*
@@ -2671,6 +2892,12 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 	s = slab_pre_alloc_hook(s, gfpflags);
 	if (!s)
 		return NULL;
+
+	if (kmem_cache_has_sheaves(s) && node == NUMA_NO_NODE) {
+		object = sheaf_alloc(s);
+		if (likely(object))
+			goto out;
+	}
 redo:
 	/*
 	 * Must read kmem_cache cpu data via this cpu ptr. Preemption is
@@ -2738,7 +2965,7 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 		prefetch_freepointer(s, next_object);
 		stat(s, ALLOC_FASTPATH);
 	}
-
+out:
 	if (unlikely(gfpflags & __GFP_ZERO) && object)
 		memset(object, 0, s->object_size);
 
@@ -2948,6 +3175,9 @@ static __always_inline void do_slab_free(struct kmem_cache *s,
 	void *tail_obj = tail ? : head;
 	struct kmem_cache_cpu *c;
 	unsigned long tid;
+
+	if (kmem_cache_has_sheaves(s) && cnt == 1 && sheaf_free(s, page, head))
+		return;
 redo:
 	/*
 	 * Determine the currently cpus per cpu slab.
@@ -3140,7 +3370,20 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 	local_irq_disable();
 	c = this_cpu_ptr(s->cpu_slab);
 
-	for (i = 0; i < size; i++) {
+	i = 0;
+	if (kmem_cache_has_sheaves(s)) {
+		struct slub_sheaf *sheaf = this_cpu_ptr(s->sheaves);
+		unsigned int nr = min_t(size_t, sheaf->size, size);
+
+		/* Empty the sheaf first, then grab the rest in one go */
+		sheaf->size -= nr;
+		memcpy(p, sheaf->objects + sheaf->size, nr * sizeof(void *));
+		i = nr;
+		if (i < size)
+			i += refill_from_partials(s, p + i, size - i);
+	}
+
+	for (; i < size; i++) {
 		void *object = c->freelist;
 
 		if (unlikely(!object)) {
@@ -3334,6 +3577,16 @@ static inline int alloc_kmem_cache_cpus(struct kmem_cache *s)
 
 	init_kmem_cache_cpus(s);
 
+	if (s->sheaf_capacity) {
+		s->sheaves = __alloc_percpu(sizeof(struct slub_sheaf) +
+				s->sheaf_capacity * sizeof(void *),
+				sizeof(void *));
+		if (!s->sheaves) {
+			free_percpu(s->cpu_slab);
+			return 0;
+		}
+	}
+
 	return 1;
 }
 
@@ -3399,6 +3652,7 @@ static void free_kmem_cache_nodes(struct kmem_cache *s)
 void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
+	free_percpu(s->sheaves);
 	free_percpu(s->cpu_slab);
 	free_kmem_cache_nodes(s);
 }
@@ -3470,6 +3724,25 @@ static void set_cpu_partial(struct kmem_cache *s)
 #endif
 }
 
+static void set_sheaf_capacity(struct kmem_cache *s)
+{
+	/*
+	 * Sheaves are sized like the per cpu partial lists, only counted
+	 * in objects.  Half of a sheaf is moved on every refill or flush.
+	 * Debugging wants to see each object go through the slab itself.
+	 */
+	if (!(s->flags & SLAB_SHEAVES) || kmem_cache_debug(s))
+		s->sheaf_capacity = 0;
+	else if (s->size >= PAGE_SIZE)
+		s->sheaf_capacity = 8;
+	else if (s->size >= 1024)
+		s->sheaf_capacity = 24;
+	else if (s->size >= 256)
+		s->sheaf_capacity = 54;
+	else
+		s->sheaf_capacity = 120;
+}
+
 /*
  * calculate_sizes() determines the order and the distribution of data within
  * a slab object.
@@ -3632,6 +3905,7 @@ static int kmem_cache_open(struct kmem_cache *s, unsigned long flags)
 	set_min_partial(s, ilog2(s->size) / 2);
 
 	set_cpu_partial(s);
+	set_sheaf_capacity(s);
 
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -4020,10 +4294,13 @@ void __kmemcg_cache_deactivate(struct kmem_cache *s)
 	 */
 	slub_set_cpu_partial(s, 0);
 	s->min_partial = 0;
+	WRITE_ONCE(s->sheaf_capacity, 0);
 
 	/*
 	 * s->cpu_partial is checked locklessly (see put_cpu_partial), so
 	 * we have to make sure the change is visible before shrinking.
+	 * The same goes for s->sheaf_capacity, read with interrupts
+	 * disabled by the sheaf users.
 	 */
 	slab_deactivate_memcg_cache_rcu_sched(s, kmemcg_cache_deact_after_rcu);
 }
@@ -4979,6 +5256,12 @@ static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(cpu_partial);
 
+static ssize_t sheaf_capacity_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%u\n", s->sheaf_capacity);
+}
+SLAB_ATTR_RO(sheaf_capacity);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -5384,6 +5667,10 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(SHEAF_ALLOC, sheaf_alloc);
+STAT_ATTR(SHEAF_FREE, sheaf_free);
+STAT_ATTR(SHEAF_REFILL, sheaf_refill);
+STAT_ATTR(SHEAF_FLUSH, sheaf_flush);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -5393,6 +5680,7 @@ static struct attribute *slab_attrs[] = {
 	&order_attr.attr,
 	&min_partial_attr.attr,
 	&cpu_partial_attr.attr,
+	&sheaf_capacity_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
@@ -5451,6 +5739,10 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&sheaf_alloc_attr.attr,
+	&sheaf_free_attr.attr,
+	&sheaf_refill_attr.attr,
+	&sheaf_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
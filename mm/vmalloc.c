@@ -22,7 +22,7 @@
 #include <linux/kallsyms.h>
 #include <linux/list.h>
 #include <linux/notifier.h>
-#include <linux/rbtree.h>
+#include <linux/rbtree_augmented.h>
 #include <linux/radix-tree.h>
 #include <linux/rcupdate.h>
 #include <linux/pfn.h>
@@ -332,13 +332,40 @@ LIST_HEAD(vmap_area_list);
 static LLIST_HEAD(vmap_purge_list);
 static struct rb_root vmap_area_root = RB_ROOT;
 
-/* The vmap cache globals are protected by vmap_area_lock */
-static struct rb_node *free_vmap_cache;
-static unsigned long cached_hole_size;
-static unsigned long cached_vstart;
-static unsigned long cached_align;
+/*
+ * Free KVA lives in its own address sorted tree, augmented with the
+ * largest free size found in each subtree, so the lowest fitting hole
+ * is found without walking the busy areas.  It has its own lock:
+ * allocations and frees no longer serialize against lookups of busy
+ * areas under vmap_area_lock.
+ */
+static DEFINE_SPINLOCK(free_vmap_area_lock);
+static LIST_HEAD(free_vmap_area_list);
+static struct rb_root free_vmap_area_root = RB_ROOT;
+
+static inline unsigned long va_size(struct vmap_area *va)
+{
+	return va->va_end - va->va_start;
+}
+
+static inline unsigned long get_subtree_max_size(struct rb_node *node)
+{
+	struct vmap_area *va;
 
-static unsigned long vmap_area_pcpu_hole;
+	va = rb_entry_safe(node, struct vmap_area, rb_node);
+	return va ? va->subtree_max_size : 0;
+}
+
+static inline unsigned long compute_subtree_max_size(struct vmap_area *va)
+{
+	return max3(va_size(va),
+		    get_subtree_max_size(va->rb_node.rb_left),
+		    get_subtree_max_size(va->rb_node.rb_right));
+}
+
+RB_DECLARE_CALLBACKS(static, free_vmap_area_rb_augment_cb,
+		     struct vmap_area, rb_node, unsigned long,
+		     subtree_max_size, compute_subtree_max_size)
 
 static struct vmap_area *__find_vmap_area(unsigned long addr)
 {
@@ -359,9 +386,14 @@ static struct vmap_area *__find_vmap_area(unsigned long addr)
 	return NULL;
 }
 
-static void __insert_vmap_area(struct vmap_area *va)
+/*
+ * Insert @va into @root, which is either the busy or the free tree, and
+ * into the matching address sorted @head.
+ */
+static void link_vmap_area(struct vmap_area *va, struct rb_root *root,
+			   struct list_head *head)
 {
-	struct rb_node **p = &vmap_area_root.rb_node;
+	struct rb_node **p = &root->rb_node;
 	struct rb_node *parent = NULL;
 	struct rb_node *tmp;
 
@@ -379,16 +411,341 @@ static void __insert_vmap_area(struct vmap_area *va)
 	}
 
 	rb_link_node(&va->rb_node, parent, p);
-	rb_insert_color(&va->rb_node, &vmap_area_root);
+	if (root == &free_vmap_area_root) {
+		/*
+		 * Account the new leaf in its parents before the
+		 * rebalancing rotations copy the values around.
+		 */
+		va->subtree_max_size = 0;
+		free_vmap_area_rb_augment_cb.propagate(&va->rb_node, NULL);
+		rb_insert_augmented(&va->rb_node, root,
+				    &free_vmap_area_rb_augment_cb);
+	} else {
+		rb_insert_color(&va->rb_node, root);
+	}
 
 	/* address-sort this list */
 	tmp = rb_prev(&va->rb_node);
 	if (tmp) {
 		struct vmap_area *prev;
 		prev = rb_entry(tmp, struct vmap_area, rb_node);
-		list_add_rcu(&va->list, &prev->list);
+		list_add(&va->list, &prev->list);
 	} else
-		list_add_rcu(&va->list, &vmap_area_list);
+		list_add(&va->list, head);
+}
+
+static void unlink_vmap_area(struct vmap_area *va, struct rb_root *root)
+{
+	BUG_ON(RB_EMPTY_NODE(&va->rb_node));
+
+	if (root == &free_vmap_area_root)
+		rb_erase_augmented(&va->rb_node, root,
+				   &free_vmap_area_rb_augment_cb);
+	else
+		rb_erase(&va->rb_node, root);
+	RB_CLEAR_NODE(&va->rb_node);
+	list_del(&va->list);
+}
+
+/*
+ * Return the lowest address of the free area @va that can hold @size
+ * bytes aligned to @align and not below @vstart, or 0 if there is none.
+ */
+static unsigned long va_fit_addr(struct vmap_area *va, unsigned long size,
+				 unsigned long align, unsigned long vstart)
+{
+	unsigned long addr = ALIGN(max(va->va_start, vstart), align);
+
+	if (addr < vstart || addr + size < addr || addr + size > va->va_end)
+		return 0;
+
+	return addr;
+}
+
+/*
+ * Find the lowest free area that fits the request.  Subtrees whose
+ * largest hole is too small are skipped; for page alignment any hole of
+ * @size will do, larger alignments look for holes that fit regardless
+ * of where they start so that the search does not have to backtrack.
+ */
+static struct vmap_area *find_vmap_lowest_match(unsigned long size,
+		unsigned long align, unsigned long vstart)
+{
+	unsigned long length = align > PAGE_SIZE ? size + align - 1 : size;
+	struct rb_node *node = free_vmap_area_root.rb_node;
+	struct rb_node *parent;
+	struct vmap_area *va;
+
+	while (node) {
+		va = rb_entry(node, struct vmap_area, rb_node);
+
+		/* Everything on the left ends below va->va_start. */
+		if (vstart < va->va_start &&
+		    get_subtree_max_size(node->rb_left) >= length) {
+			node = node->rb_left;
+			continue;
+		}
+
+		/*
+		 * Nothing lower fits: try this area, then the areas above
+		 * it, climbing back to the first parent we went left from.
+		 */
+		for (;;) {
+			if (va_fit_addr(va, size, align, vstart))
+				return va;
+
+			if (get_subtree_max_size(node->rb_right) >= length) {
+				node = node->rb_right;
+				break;
+			}
+
+			while ((parent = rb_parent(node)) &&
+			       parent->rb_right == node)
+				node = parent;
+			if (!parent)
+				return NULL;
+
+			node = parent;
+			va = rb_entry(node, struct vmap_area, rb_node);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Carve [@addr, @addr + @size) out of the free area @va.  Splitting @va
+ * in two consumes *@spare, as nothing can be allocated under the free
+ * lock; without one the carve fails.
+ */
+static bool clip_free_vmap_area(struct vmap_area *va, unsigned long addr,
+				unsigned long size, struct vmap_area **spare)
+{
+	unsigned long end = addr + size;
+	struct vmap_area *lva;
+
+	if (va->va_start == addr && va->va_end == end) {
+		unlink_vmap_area(va, &free_vmap_area_root);
+		kfree_rcu(va, rcu_head);
+		return true;
+	}
+
+	if (va->va_start == addr) {
+		va->va_start = end;
+	} else if (va->va_end == end) {
+		va->va_end = addr;
+	} else {
+		lva = *spare;
+		if (!lva)
+			return false;
+		*spare = NULL;
+
+		lva->va_start = va->va_start;
+		lva->va_end = addr;
+		va->va_start = end;
+		free_vmap_area_rb_augment_cb.propagate(&va->rb_node, NULL);
+		link_vmap_area(lva, &free_vmap_area_root,
+			       &free_vmap_area_list);
+		return true;
+	}
+
+	free_vmap_area_rb_augment_cb.propagate(&va->rb_node, NULL);
+	return true;
+}
+
+/*
+ * Allocate a range of KVA from the free tree.  Returns its start, or 0
+ * if nothing fits.  Called with free_vmap_area_lock held.
+ */
+static unsigned long __alloc_vmap_range(unsigned long size,
+		unsigned long align, unsigned long vstart, unsigned long vend,
+		struct vmap_area **spare)
+{
+	struct vmap_area *va;
+	unsigned long addr;
+
+	lockdep_assert_held(&free_vmap_area_lock);
+
+	va = find_vmap_lowest_match(size, align, vstart);
+	if (!va)
+		return 0;
+
+	addr = va_fit_addr(va, size, align, vstart);
+	if (addr + size > vend)
+		return 0;
+
+	if (!clip_free_vmap_area(va, addr, size, spare))
+		return 0;
+
+	return addr;
+}
+
+/*
+ * Give the range of the busy area @va back to the free tree, merging it
+ * with its free neighbours.  @va itself is freed when it gets merged.
+ * Called with free_vmap_area_lock held.
+ */
+static void merge_or_add_vmap_area(struct vmap_area *va)
+{
+	struct rb_node *n = free_vmap_area_root.rb_node;
+	struct vmap_area *prev = NULL, *next = NULL;
+
+	lockdep_assert_held(&free_vmap_area_lock);
+
+	while (n) {
+		struct vmap_area *tmp;
+
+		tmp = rb_entry(n, struct vmap_area, rb_node);
+		if (va->va_end <= tmp->va_start) {
+			next = tmp;
+			n = n->rb_left;
+		} else if (va->va_start >= tmp->va_end) {
+			prev = tmp;
+			n = n->rb_right;
+		} else
+			BUG();
+	}
+
+	if (prev && prev->va_end != va->va_start)
+		prev = NULL;
+	if (next && next->va_start != va->va_end)
+		next = NULL;
+
+	if (!prev && !next) {
+		link_vmap_area(va, &free_vmap_area_root, &free_vmap_area_list);
+		return;
+	}
+
+	if (prev && next) {
+		/* @va fills the hole between two free areas */
+		unlink_vmap_area(next, &free_vmap_area_root);
+		prev->va_end = next->va_end;
+		kfree_rcu(next, rcu_head);
+	} else if (prev) {
+		prev->va_end = va->va_end;
+	} else {
+		next->va_start = va->va_start;
+		prev = next;
+	}
+	free_vmap_area_rb_augment_cb.propagate(&prev->rb_node, NULL);
+	kfree_rcu(va, rcu_head);
+}
+
+/*
+ * Small areas freed by the lazy purge are not merged back right away:
+ * they are spread over per-cpu pools, sorted by size, so the next
+ * allocation of the same size on that CPU (another kernel stack, say)
+ * reuses one without going near free_vmap_area_lock.  Only 64-bit has
+ * the address space to keep them around.
+ */
+#define VMAP_POOL_PAGES		16
+#define VMAP_POOL_MAX_NR	(BITS_PER_LONG == 64 ? 32 : 0)
+
+struct vmap_pool {
+	spinlock_t lock;
+	unsigned int nr[VMAP_POOL_PAGES];
+	struct list_head free[VMAP_POOL_PAGES];
+};
+
+static DEFINE_PER_CPU(struct vmap_pool, vmap_pool);
+
+/* The CPU whose pool gets the next purged area, under free_vmap_area_lock */
+static int vmap_pool_cpu;
+
+static inline bool vmap_pool_range(unsigned long vstart, unsigned long vend)
+{
+	return vstart == VMALLOC_START && vend == VMALLOC_END;
+}
+
+static struct vmap_area *vmap_pool_get(unsigned long size,
+		unsigned long align, unsigned long vstart, unsigned long vend)
+{
+	unsigned int idx = (size >> PAGE_SHIFT) - 1;
+	struct vmap_area *va, *found = NULL;
+	struct vmap_pool *pool;
+
+	if (idx >= VMAP_POOL_PAGES || !vmap_pool_range(vstart, vend))
+		return NULL;
+
+	pool = get_cpu_ptr(&vmap_pool);
+	if (!pool->nr[idx])
+		goto out;
+
+	spin_lock(&pool->lock);
+	list_for_each_entry(va, &pool->free[idx], list) {
+		if (IS_ALIGNED(va->va_start, align)) {
+			list_del(&va->list);
+			pool->nr[idx]--;
+			found = va;
+			break;
+		}
+	}
+	spin_unlock(&pool->lock);
+out:
+	put_cpu_ptr(&vmap_pool);
+	return found;
+}
+
+/*
+ * Called with free_vmap_area_lock held, returns false if @va has to go
+ * back to the free tree instead.
+ */
+static bool vmap_pool_put(struct vmap_area *va)
+{
+	unsigned int idx = (va_size(va) >> PAGE_SHIFT) - 1;
+	struct vmap_pool *pool;
+	bool ret = false;
+	int cpu;
+
+	if (idx >= VMAP_POOL_PAGES || va->va_start < VMALLOC_START ||
+	    va->va_end > VMALLOC_END)
+		return false;
+
+	cpu = cpumask_next(vmap_pool_cpu, cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first(cpu_online_mask);
+	vmap_pool_cpu = cpu;
+
+	pool = per_cpu_ptr(&vmap_pool, cpu);
+	spin_lock(&pool->lock);
+	if (pool->nr[idx] < VMAP_POOL_MAX_NR) {
+		list_add(&va->list, &pool->free[idx]);
+		pool->nr[idx]++;
+		ret = true;
+	}
+	spin_unlock(&pool->lock);
+
+	return ret;
+}
+
+/*
+ * Return everything the pools hold to the free tree, so that a failing
+ * allocation gets to see all of the free KVA.
+ */
+static void vmap_pool_drain(void)
+{
+	struct vmap_area *va, *n;
+	LIST_HEAD(list);
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct vmap_pool *pool = per_cpu_ptr(&vmap_pool, cpu);
+
+		spin_lock(&pool->lock);
+		for (i = 0; i < VMAP_POOL_PAGES; i++) {
+			list_splice_init(&pool->free[i], &list);
+			pool->nr[i] = 0;
+		}
+		spin_unlock(&pool->lock);
+	}
+
+	if (list_empty(&list))
+		return;
+
+	spin_lock(&free_vmap_area_lock);
+	list_for_each_entry_safe(va, n, &list, list)
+		merge_or_add_vmap_area(va);
+	spin_unlock(&free_vmap_area_lock);
 }
 
 static void purge_vmap_area_lazy(void);
@@ -404,11 +761,9 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 				unsigned long vstart, unsigned long vend,
 				int node, gfp_t gfp_mask)
 {
-	struct vmap_area *va;
-	struct rb_node *n;
+	struct vmap_area *va, *spare = NULL;
 	unsigned long addr;
 	int purged = 0;
-	struct vmap_area *first;
 
 	BUG_ON(!size);
 	BUG_ON(offset_in_page(size));
@@ -416,6 +771,10 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 
 	might_sleep();
 
+	va = vmap_pool_get(size, align, vstart, vend);
+	if (va)
+		goto insert;
+
 	va = kmalloc_node(sizeof(struct vmap_area),
 			gfp_mask & GFP_RECLAIM_MASK, node);
 	if (unlikely(!va))
@@ -428,84 +787,32 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	kmemleak_scan_area(&va->rb_node, SIZE_MAX, gfp_mask & GFP_RECLAIM_MASK);
 
 retry:
-	spin_lock(&vmap_area_lock);
 	/*
-	 * Invalidate cache if we have more permissive parameters.
-	 * cached_hole_size notes the largest hole noticed _below_
-	 * the vmap_area cached in free_vmap_cache: if size fits
-	 * into that hole, we want to scan from vstart to reuse
-	 * the hole instead of allocating above free_vmap_cache.
-	 * Note that __free_vmap_area may update free_vmap_cache
-	 * without updating cached_hole_size or cached_align.
+	 * Splitting a free area in two needs a second vmap_area, which
+	 * can't be allocated under the free lock.
 	 */
-	if (!free_vmap_cache ||
-			size < cached_hole_size ||
-			vstart < cached_vstart ||
-			align < cached_align) {
-nocache:
-		cached_hole_size = 0;
-		free_vmap_cache = NULL;
-	}
-	/* record if we encounter less permissive parameters */
-	cached_vstart = vstart;
-	cached_align = align;
-
-	/* find starting point for our search */
-	if (free_vmap_cache) {
-		first = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
-		addr = ALIGN(first->va_end, align);
-		if (addr < vstart)
-			goto nocache;
-		if (addr + size < addr)
-			goto overflow;
-
-	} else {
-		addr = ALIGN(vstart, align);
-		if (addr + size < addr)
-			goto overflow;
-
-		n = vmap_area_root.rb_node;
-		first = NULL;
-
-		while (n) {
-			struct vmap_area *tmp;
-			tmp = rb_entry(n, struct vmap_area, rb_node);
-			if (tmp->va_end >= addr) {
-				first = tmp;
-				if (tmp->va_start <= addr)
-					break;
-				n = n->rb_left;
-			} else
-				n = n->rb_right;
+	if (!spare) {
+		spare = kmalloc_node(sizeof(struct vmap_area),
+				gfp_mask & GFP_RECLAIM_MASK, node);
+		if (unlikely(!spare)) {
+			kfree(va);
+			return ERR_PTR(-ENOMEM);
 		}
-
-		if (!first)
-			goto found;
-	}
-
-	/* from the starting point, walk areas until a suitable hole is found */
-	while (addr + size > first->va_start && addr + size <= vend) {
-		if (addr + cached_hole_size < first->va_start)
-			cached_hole_size = first->va_start - addr;
-		addr = ALIGN(first->va_end, align);
-		if (addr + size < addr)
-			goto overflow;
-
-		if (list_is_last(&first->list, &vmap_area_list))
-			goto found;
-
-		first = list_next_entry(first, list);
 	}
 
-found:
-	if (addr + size > vend)
+	spin_lock(&free_vmap_area_lock);
+	addr = __alloc_vmap_range(size, align, vstart, vend, &spare);
+	spin_unlock(&free_vmap_area_lock);
+	if (!addr)
 		goto overflow;
 
 	va->va_start = addr;
 	va->va_end = addr + size;
+	kfree(spare);
+insert:
 	va->flags = 0;
-	__insert_vmap_area(va);
-	free_vmap_cache = &va->rb_node;
+	spin_lock(&vmap_area_lock);
+	link_vmap_area(va, &vmap_area_root, &vmap_area_list);
 	spin_unlock(&vmap_area_lock);
 
 	BUG_ON(!IS_ALIGNED(va->va_start, align));
@@ -515,7 +822,6 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	return va;
 
 overflow:
-	spin_unlock(&vmap_area_lock);
 	if (!purged) {
 		purge_vmap_area_lazy();
 		purged = 1;
@@ -534,6 +840,7 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	if (!(gfp_mask & __GFP_NOWARN) && printk_ratelimit())
 		pr_warn("vmap allocation for size %lu failed: use vmalloc=<size> to increase size\n",
 			size);
+	kfree(spare);
 	kfree(va);
 	return ERR_PTR(-EBUSY);
 }
@@ -550,49 +857,18 @@ int unregister_vmap_purge_notifier(struct notifier_block *nb)
 }
 EXPORT_SYMBOL_GPL(unregister_vmap_purge_notifier);
 
-static void __free_vmap_area(struct vmap_area *va)
-{
-	BUG_ON(RB_EMPTY_NODE(&va->rb_node));
-
-	if (free_vmap_cache) {
-		if (va->va_end < cached_vstart) {
-			free_vmap_cache = NULL;
-		} else {
-			struct vmap_area *cache;
-			cache = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
-			if (va->va_start <= cache->va_start) {
-				free_vmap_cache = rb_prev(&va->rb_node);
-				/*
-				 * We don't try to update cached_hole_size or
-				 * cached_align, but it won't go very wrong.
-				 */
-			}
-		}
-	}
-	rb_erase(&va->rb_node, &vmap_area_root);
-	RB_CLEAR_NODE(&va->rb_node);
-	list_del_rcu(&va->list);
-
-	/*
-	 * Track the highest possible candidate for pcpu area
-	 * allocation.  Areas outside of vmalloc area can be returned
-	 * here too, consider only end addresses which fall inside
-	 * vmalloc area proper.
-	 */
-	if (va->va_end > VMALLOC_START && va->va_end <= VMALLOC_END)
-		vmap_area_pcpu_hole = max(vmap_area_pcpu_hole, va->va_end);
-
-	kfree_rcu(va, rcu_head);
-}
-
 /*
  * Free a region of KVA allocated by alloc_vmap_area
  */
 static void free_vmap_area(struct vmap_area *va)
 {
 	spin_lock(&vmap_area_lock);
-	__free_vmap_area(va);
+	unlink_vmap_area(va, &vmap_area_root);
 	spin_unlock(&vmap_area_lock);
+
+	spin_lock(&free_vmap_area_lock);
+	merge_or_add_vmap_area(va);
+	spin_unlock(&free_vmap_area_lock);
 }
 
 /*
@@ -695,15 +971,28 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 
 	flush_tlb_kernel_range(start, end);
 
+	/*
+	 * Take the whole batch off the busy tree first, so that lookups
+	 * only wait for the unlinking and the merging below runs under
+	 * the free lock alone.
+	 */
 	spin_lock(&vmap_area_lock);
+	llist_for_each_entry(va, valist, purge_list) {
+		unlink_vmap_area(va, &vmap_area_root);
+		cond_resched_lock(&vmap_area_lock);
+	}
+	spin_unlock(&vmap_area_lock);
+
+	spin_lock(&free_vmap_area_lock);
 	llist_for_each_entry_safe(va, n_va, valist, purge_list) {
-		int nr = (va->va_end - va->va_start) >> PAGE_SHIFT;
+		int nr = va_size(va) >> PAGE_SHIFT;
 
-		__free_vmap_area(va);
+		if (!vmap_pool_put(va))
+			merge_or_add_vmap_area(va);
 		atomic_sub(nr, &vmap_lazy_nr);
-		cond_resched_lock(&vmap_area_lock);
+		cond_resched_lock(&free_vmap_area_lock);
 	}
-	spin_unlock(&vmap_area_lock);
+	spin_unlock(&free_vmap_area_lock);
 	return true;
 }
 
@@ -727,6 +1016,7 @@ static void purge_vmap_area_lazy(void)
 	mutex_lock(&vmap_purge_lock);
 	purge_fragmented_blocks_allcpus();
 	__purge_vmap_area_lazy(ULONG_MAX, 0);
+	vmap_pool_drain();
 	mutex_unlock(&vmap_purge_lock);
 }
 
@@ -1251,15 +1541,47 @@ void __init vm_area_register_early(struct vm_struct *vm, size_t align)
 	vm_area_add_early(vm);
 }
 
+/*
+ * Everything between the imported vmlist entries is free, from 1 up to
+ * ULONG_MAX: alloc_vmap_area() is also used for ranges outside of
+ * VMALLOC_START..VMALLOC_END, and 0 stays out so that it can mean
+ * "no fit".
+ */
+static void __init vmap_init_free_space(void)
+{
+	unsigned long vmap_start = 1;
+	struct vmap_area *busy, *free;
+
+	list_for_each_entry(busy, &vmap_area_list, list) {
+		if (busy->va_start > vmap_start) {
+			free = kzalloc(sizeof(struct vmap_area), GFP_NOWAIT);
+			free->va_start = vmap_start;
+			free->va_end = busy->va_start;
+			link_vmap_area(free, &free_vmap_area_root,
+				       &free_vmap_area_list);
+		}
+		vmap_start = busy->va_end;
+	}
+
+	if (vmap_start < ULONG_MAX) {
+		free = kzalloc(sizeof(struct vmap_area), GFP_NOWAIT);
+		free->va_start = vmap_start;
+		free->va_end = ULONG_MAX;
+		link_vmap_area(free, &free_vmap_area_root,
+			       &free_vmap_area_list);
+	}
+}
+
 void __init vmalloc_init(void)
 {
 	struct vmap_area *va;
 	struct vm_struct *tmp;
-	int i;
+	int i, j;
 
 	for_each_possible_cpu(i) {
 		struct vmap_block_queue *vbq;
 		struct vfree_deferred *p;
+		struct vmap_pool *pool;
 
 		vbq = &per_cpu(vmap_block_queue, i);
 		spin_lock_init(&vbq->lock);
@@ -1267,6 +1589,10 @@ void __init vmalloc_init(void)
 		p = &per_cpu(vfree_deferred, i);
 		init_llist_head(&p->list);
 		INIT_WORK(&p->wq, free_work);
+		pool = &per_cpu(vmap_pool, i);
+		spin_lock_init(&pool->lock);
+		for (j = 0; j < VMAP_POOL_PAGES; j++)
+			INIT_LIST_HEAD(&pool->free[j]);
 	}
 
 	/* Import existing vmlist entries. */
@@ -1276,10 +1602,10 @@ void __init vmalloc_init(void)
 		va->va_start = (unsigned long)tmp->addr;
 		va->va_end = va->va_start + tmp->size;
 		va->vm = tmp;
-		__insert_vmap_area(va);
+		link_vmap_area(va, &vmap_area_root, &vmap_area_list);
 	}
 
-	vmap_area_pcpu_hole = VMALLOC_END;
+	vmap_init_free_space();
 
 	vmap_initialized = true;
 }
@@ -2375,81 +2701,61 @@ static struct vmap_area *node_to_va(struct rb_node *n)
 }
 
 /**
- * pvm_find_next_prev - find the next and prev vmap_area surrounding @end
- * @end: target address
- * @pnext: out arg for the next vmap_area
- * @pprev: out arg for the previous vmap_area
- *
- * Returns: %true if either or both of next and prev are found,
- *	    %false if no vmap_area exists
+ * pvm_find_va_enclose_addr - find the free vmap_area around @addr
+ * @addr: target address
  *
- * Find vmap_areas end addresses of which enclose @end.  ie. if not
- * NULL, *pnext->va_end > @end and *pprev->va_end <= @end.
+ * Returns: the free vmap_area containing @addr or, failing that, the
+ *	    closest one below it; %NULL if there is none
  */
-static bool pvm_find_next_prev(unsigned long end,
-			       struct vmap_area **pnext,
-			       struct vmap_area **pprev)
+static struct vmap_area *pvm_find_va_enclose_addr(unsigned long addr)
 {
-	struct rb_node *n = vmap_area_root.rb_node;
+	struct rb_node *n = free_vmap_area_root.rb_node;
 	struct vmap_area *va = NULL;
 
 	while (n) {
-		va = rb_entry(n, struct vmap_area, rb_node);
-		if (end < va->va_end)
-			n = n->rb_left;
-		else if (end > va->va_end)
+		struct vmap_area *tmp;
+
+		tmp = rb_entry(n, struct vmap_area, rb_node);
+		if (tmp->va_start <= addr) {
+			va = tmp;
+			if (tmp->va_end >= addr)
+				break;
 			n = n->rb_right;
-		else
-			break;
+		} else
+			n = n->rb_left;
 	}
 
-	if (!va)
-		return false;
-
-	if (va->va_end > end) {
-		*pnext = va;
-		*pprev = node_to_va(rb_prev(&(*pnext)->rb_node));
-	} else {
-		*pprev = va;
-		*pnext = node_to_va(rb_next(&(*pprev)->rb_node));
-	}
-	return true;
+	return va;
 }
 
 /**
- * pvm_determine_end - find the highest aligned address between two vmap_areas
- * @pnext: in/out arg for the next vmap_area
- * @pprev: in/out arg for the previous vmap_area
+ * pvm_determine_end_from_reverse - find the highest aligned end address
+ * @va: in/out arg for the free vmap_area to start from
  * @align: alignment
  *
- * Returns: determined end address
- *
- * Find the highest aligned address between *@pnext and *@pprev below
- * VMALLOC_END.  *@pnext and *@pprev are adjusted so that the aligned
- * down address is between the end addresses of the two vmap_areas.
+ * Returns: determined end address, 0 if there is none
  *
- * Please note that the address returned by this function may fall
- * inside *@pnext vmap_area.  The caller is responsible for checking
- * that.
+ * Walk *@va down the free list until a free area has room for an
+ * aligned end address below VMALLOC_END.  *@va is left pointing at that
+ * area, or %NULL if no free area below it qualifies.
  */
-static unsigned long pvm_determine_end(struct vmap_area **pnext,
-				       struct vmap_area **pprev,
-				       unsigned long align)
+static unsigned long pvm_determine_end_from_reverse(struct vmap_area **va,
+						    unsigned long align)
 {
 	const unsigned long vmalloc_end = VMALLOC_END & ~(align - 1);
 	unsigned long addr;
 
-	if (*pnext)
-		addr = min((*pnext)->va_start & ~(align - 1), vmalloc_end);
-	else
-		addr = vmalloc_end;
-
-	while (*pprev && (*pprev)->va_end > addr) {
-		*pnext = *pprev;
-		*pprev = node_to_va(rb_prev(&(*pnext)->rb_node));
+	if (likely(*va)) {
+		list_for_each_entry_from_reverse((*va), &free_vmap_area_list,
+						 list) {
+			addr = min((*va)->va_end & ~(align - 1), vmalloc_end);
+			if ((*va)->va_start < addr)
+				return addr;
+		}
 	}
 
-	return addr;
+	*va = NULL;
+	return 0;
 }
 
 /**
@@ -2470,11 +2776,12 @@ static unsigned long pvm_determine_end(struct vmap_area **pnext,
  * areas are allocated from top.
  *
  * Despite its complicated look, this allocator is rather simple.  It
- * does everything top-down and scans areas from the end looking for
- * matching slot.  While scanning, if any of the areas overlaps with
- * existing vmap_area, the base address is pulled down to fit the
- * area.  Scanning is repeated till all the areas fit and then all
- * necessary data structures are inserted and the result is returned.
+ * does everything top-down and scans the free areas from the end
+ * looking for matching slot.  While scanning, if any of the areas
+ * does not fit in the free area below it, the base address is pulled
+ * down to fit the area.  Scanning is repeated till all the areas fit,
+ * then they are carved out of the free tree and inserted into the busy
+ * one and the result is returned.
  */
 struct vm_struct **pcpu_get_vm_areas(const unsigned long *offsets,
 				     const size_t *sizes, int nr_vms,
@@ -2482,7 +2789,7 @@ struct vm_struct **pcpu_get_vm_areas(const unsigned long *offsets,
 {
 	const unsigned long vmalloc_start = ALIGN(VMALLOC_START, align);
 	const unsigned long vmalloc_end = VMALLOC_END & ~(align - 1);
-	struct vmap_area **vas, *prev, *next;
+	struct vmap_area **vas, **spares, *va;
 	struct vm_struct **vms;
 	int area, area2, last_area, term_area;
 	unsigned long base, start, end, last_end;
@@ -2518,66 +2825,58 @@ struct vm_struct **pcpu_get_vm_areas(const unsigned long *offsets,
 
 	vms = kcalloc(nr_vms, sizeof(vms[0]), GFP_KERNEL);
 	vas = kcalloc(nr_vms, sizeof(vas[0]), GFP_KERNEL);
-	if (!vas || !vms)
+	spares = kcalloc(nr_vms, sizeof(spares[0]), GFP_KERNEL);
+	if (!vas || !vms || !spares)
 		goto err_free2;
 
+	/* carving an area out of the middle of a free one needs a spare */
 	for (area = 0; area < nr_vms; area++) {
 		vas[area] = kzalloc(sizeof(struct vmap_area), GFP_KERNEL);
 		vms[area] = kzalloc(sizeof(struct vm_struct), GFP_KERNEL);
-		if (!vas[area] || !vms[area])
+		spares[area] = kzalloc(sizeof(struct vmap_area), GFP_KERNEL);
+		if (!vas[area] || !vms[area] || !spares[area])
 			goto err_free;
 	}
 retry:
-	spin_lock(&vmap_area_lock);
+	spin_lock(&free_vmap_area_lock);
 
 	/* start scanning - we scan from the top, begin with the last area */
 	area = term_area = last_area;
 	start = offsets[area];
 	end = start + sizes[area];
 
-	if (!pvm_find_next_prev(vmap_area_pcpu_hole, &next, &prev)) {
-		base = vmalloc_end - last_end;
-		goto found;
-	}
-	base = pvm_determine_end(&next, &prev, align) - end;
+	va = pvm_find_va_enclose_addr(vmalloc_end);
+	base = pvm_determine_end_from_reverse(&va, align) - end;
 
 	while (true) {
-		BUG_ON(next && next->va_end <= base + end);
-		BUG_ON(prev && prev->va_end > base + end);
-
 		/*
 		 * base might have underflowed, add last_end before
 		 * comparing.
 		 */
-		if (base + last_end < vmalloc_start + last_end) {
-			spin_unlock(&vmap_area_lock);
-			if (!purged) {
-				purge_vmap_area_lazy();
-				purged = true;
-				goto retry;
-			}
-			goto err_free;
-		}
+		if (base + last_end < vmalloc_start + last_end)
+			goto overflow;
+
+		/* no free area left to try */
+		if (!va)
+			goto overflow;
 
 		/*
-		 * If next overlaps, move base downwards so that it's
-		 * right below next and then recheck.
+		 * If the area sticks out of the top of the free one, move
+		 * base downwards and then recheck.
 		 */
-		if (next && next->va_start < base + end) {
-			base = pvm_determine_end(&next, &prev, align) - end;
+		if (base + end > va->va_end) {
+			base = pvm_determine_end_from_reverse(&va, align) - end;
 			term_area = area;
 			continue;
 		}
 
 		/*
-		 * If prev overlaps, shift down next and prev and move
-		 * base so that it's right below new next and then
-		 * recheck.
+		 * If it sticks out of the bottom, move on to the free area
+		 * below and move base to its top.
 		 */
-		if (prev && prev->va_end > base + start)  {
-			next = prev;
-			prev = node_to_va(rb_prev(&next->rb_node));
-			base = pvm_determine_end(&next, &prev, align) - end;
+		if (base + start < va->va_start) {
+			va = node_to_va(rb_prev(&va->rb_node));
+			base = pvm_determine_end_from_reverse(&va, align) - end;
 			term_area = area;
 			continue;
 		}
@@ -2591,36 +2890,66 @@ struct vm_struct **pcpu_get_vm_areas(const unsigned long *offsets,
 			break;
 		start = offsets[area];
 		end = start + sizes[area];
-		pvm_find_next_prev(base + end, &next, &prev);
+		va = pvm_find_va_enclose_addr(base + end);
 	}
-found:
-	/* we've found a fitting base, insert all va's */
+
+	/* we've found a fitting base, carve all va's out of the free tree */
 	for (area = 0; area < nr_vms; area++) {
-		struct vmap_area *va = vas[area];
+		start = base + offsets[area];
+		end = start + sizes[area];
 
-		va->va_start = base + offsets[area];
-		va->va_end = va->va_start + sizes[area];
-		__insert_vmap_area(va);
-	}
+		va = pvm_find_va_enclose_addr(start);
+		if (WARN_ON_ONCE(!va || end > va->va_end ||
+				 !clip_free_vmap_area(va, start, sizes[area],
+						      &spares[area])))
+			goto recovery;
 
-	vmap_area_pcpu_hole = base + offsets[last_area];
+		vas[area]->va_start = start;
+		vas[area]->va_end = end;
+	}
+	spin_unlock(&free_vmap_area_lock);
 
+	spin_lock(&vmap_area_lock);
+	for (area = 0; area < nr_vms; area++)
+		link_vmap_area(vas[area], &vmap_area_root, &vmap_area_list);
 	spin_unlock(&vmap_area_lock);
 
 	/* insert all vm's */
-	for (area = 0; area < nr_vms; area++)
+	for (area = 0; area < nr_vms; area++) {
 		setup_vmalloc_vm(vms[area], vas[area], VM_ALLOC,
 				 pcpu_get_vm_areas);
+		kfree(spares[area]);
+	}
 
+	kfree(spares);
 	kfree(vas);
 	return vms;
 
+recovery:
+	/* give back what was carved out already */
+	while (area--) {
+		merge_or_add_vmap_area(vas[area]);
+		vas[area] = NULL;
+	}
+	spin_unlock(&free_vmap_area_lock);
+	goto err_free;
+
+overflow:
+	spin_unlock(&free_vmap_area_lock);
+	if (!purged) {
+		purge_vmap_area_lazy();
+		purged = true;
+		goto retry;
+	}
+
 err_free:
 	for (area = 0; area < nr_vms; area++) {
 		kfree(vas[area]);
 		kfree(vms[area]);
+		kfree(spares[area]);
 	}
 err_free2:
+	kfree(spares);
 	kfree(vas);
 	kfree(vms);
 	return NULL;
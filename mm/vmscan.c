@@ -48,6 +48,9 @@
 #include <linux/prefetch.h>
 #include <linux/printk.h>
 #include <linux/dax.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/psi.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -1706,8 +1709,8 @@ putback_inactive_pages(struct lruvec *lruvec, struct list_head *page_list)
 		}
 		if (put_page_testzero(page)) {
 			__ClearPageLRU(page);
-			__ClearPageActive(page);
 			del_page_from_lru_list(page, lruvec, lru);
+			__ClearPageActive(page);
 
 			if (unlikely(PageCompound(page))) {
 				spin_unlock_irq(&pgdat->lru_lock);
@@ -1938,13 +1941,13 @@ static unsigned move_active_pages_to_lru(struct lruvec *lruvec,
 		SetPageLRU(page);
 
 		nr_pages = hpage_nr_pages(page);
-		update_lru_size(lruvec, lru, page_zonenum(page), nr_pages);
-		list_move(&page->lru, &lruvec->lists[lru]);
+		list_del(&page->lru);
+		add_page_to_lru_list(page, lruvec, lru);
 
 		if (put_page_testzero(page)) {
 			__ClearPageLRU(page);
-			__ClearPageActive(page);
 			del_page_from_lru_list(page, lruvec, lru);
+			__ClearPageActive(page);
 
 			if (unlikely(PageCompound(page))) {
 				spin_unlock_irq(&pgdat->lru_lock);
@@ -2118,7 +2121,7 @@ static bool inactive_list_is_low(struct lruvec *lruvec, bool file,
 	active = lruvec_lru_size(lruvec, active_lru, sc->reclaim_idx);
 
 	if (memcg)
-		refaults = memcg_page_state(memcg, WORKINGSET_ACTIVATE);
+		refaults = memcg_page_state_local(memcg, WORKINGSET_ACTIVATE);
 	else
 		refaults = node_page_state(pgdat, WORKINGSET_ACTIVATE);
 
@@ -2374,6 +2377,767 @@ static void get_scan_count(struct lruvec *lruvec, struct mem_cgroup *memcg,
 	}
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-generational LRU.
+ *
+ * Rather than on the active and inactive lists, the evictable pages of a
+ * lruvec sit on the lists of a few generations (see struct lru_gen_struct).
+ * Aging creates a new generation and then walks the page tables of every
+ * mm, moving the pages found young there into it: the accessed bits of a
+ * whole pte table are harvested under one lock instead of going through
+ * the reverse map of each page like page_referenced() does.  Eviction takes
+ * pages off the oldest generation and feeds them to shrink_page_list(); a
+ * generation is retired once it is empty, and aging is due when no other
+ * than the MIN_NR_GENS active generations are left.
+ *
+ * page->flags holds the generation of a page while the pgdat lru_lock
+ * protects the lists and sequences.  lru_gen_mm_lock protects the list of
+ * mms to walk.
+ */
+static bool lru_gen_enabled __read_mostly = IS_ENABLED(CONFIG_LRU_GEN_ENABLED);
+/* Serialises switching the lruvecs between the two LRUs */
+static DEFINE_MUTEX(lru_gen_mutex);
+
+static LIST_HEAD(lru_gen_mms);
+static DEFINE_SPINLOCK(lru_gen_mm_lock);
+
+void lru_gen_add_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	list_add_tail(&mm->lru_gen_mm_list, &lru_gen_mms);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+void lru_gen_del_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	list_del(&mm->lru_gen_mm_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+/*
+ * Returns the mm after @prev, or the first one, with a reference held and
+ * drops the reference on @prev.  An mm stays on the list while it has
+ * users, and the ones found without any are on their way out.
+ */
+static struct mm_struct *lru_gen_next_mm(struct mm_struct *prev)
+{
+	struct list_head *pos = prev ? &prev->lru_gen_mm_list : &lru_gen_mms;
+	struct mm_struct *mm = NULL;
+
+	spin_lock(&lru_gen_mm_lock);
+	for (pos = pos->next; pos != &lru_gen_mms; pos = pos->next) {
+		mm = list_entry(pos, struct mm_struct, lru_gen_mm_list);
+		if (mmget_not_zero(mm))
+			break;
+		mm = NULL;
+	}
+	spin_unlock(&lru_gen_mm_lock);
+
+	/* Don't tear down an address space from within reclaim */
+	if (prev)
+		mmput_async(prev);
+
+	return mm;
+}
+
+static inline bool lru_gen_lruvec_enabled(struct lruvec *lruvec)
+{
+	return READ_ONCE(lruvec->lrugen.enabled);
+}
+
+static inline int lru_gen_nr_gens(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+
+	return lrugen->max_seq - lrugen->min_seq[type] + 1;
+}
+
+static bool lru_gen_is_empty(struct lruvec *lruvec, int gen, int type)
+{
+	int zid;
+
+	for (zid = 0; zid < MAX_NR_ZONES; zid++)
+		if (!list_empty(&lruvec->lrugen.lists[gen][type][zid]))
+			return false;
+
+	return true;
+}
+
+void lru_gen_init_lruvec(struct lruvec *lruvec)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int gen, type, zid;
+
+	lrugen->max_seq = MIN_NR_GENS;
+	for (gen = 0; gen < MAX_NR_GENS; gen++) {
+		lrugen->timestamps[gen] = jiffies;
+		for (type = 0; type < ANON_AND_FILE; type++)
+			for (zid = 0; zid < MAX_NR_ZONES; zid++)
+				INIT_LIST_HEAD(&lrugen->lists[gen][type][zid]);
+	}
+	lrugen->enabled = READ_ONCE(lru_gen_enabled);
+}
+
+/* Merges the oldest generation of @type into the next one */
+static void lru_gen_fold_oldest(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int old_gen = lru_gen_from_seq(lrugen->min_seq[type]);
+	int new_gen = lru_gen_from_seq(lrugen->min_seq[type] + 1);
+	int zid;
+
+	for (zid = 0; zid < MAX_NR_ZONES; zid++) {
+		struct list_head *head = &lrugen->lists[old_gen][type][zid];
+		long delta = lrugen->nr_pages[old_gen][type][zid];
+		struct page *page;
+
+		list_for_each_entry(page, head, lru)
+			page_set_lru_gen(page, new_gen);
+
+		lru_gen_update_size(lruvec, type, zid, old_gen, -delta);
+		lru_gen_update_size(lruvec, type, zid, new_gen, delta);
+		list_splice_tail_init(head, &lrugen->lists[new_gen][type][zid]);
+	}
+
+	WRITE_ONCE(lrugen->min_seq[type], lrugen->min_seq[type] + 1);
+}
+
+/* Retires the oldest generations that have no pages left */
+static void lru_gen_inc_min_seq(struct lruvec *lruvec)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int type;
+
+	for (type = 0; type < ANON_AND_FILE; type++) {
+		while (lru_gen_nr_gens(lruvec, type) > MIN_NR_GENS) {
+			int gen = lru_gen_from_seq(lrugen->min_seq[type]);
+
+			if (!lru_gen_is_empty(lruvec, gen, type))
+				break;
+
+			WRITE_ONCE(lrugen->min_seq[type],
+				   lrugen->min_seq[type] + 1);
+		}
+	}
+}
+
+/*
+ * Creates a new generation unless somebody else already did since
+ * @max_seq was read.  The generation that stops being one of the two
+ * youngest moves from the active to the inactive counters.
+ */
+static bool lru_gen_inc_max_seq(struct lruvec *lruvec, unsigned long max_seq)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int prev_gen = lru_gen_from_seq(max_seq - 1);
+	int type, zid;
+
+	if (!lrugen->enabled || max_seq != lrugen->max_seq)
+		return false;
+
+	for (type = 0; type < ANON_AND_FILE; type++) {
+		if (lru_gen_nr_gens(lruvec, type) == MAX_NR_GENS)
+			lru_gen_fold_oldest(lruvec, type);
+
+		for (zid = 0; zid < MAX_NR_ZONES; zid++) {
+			long delta = lrugen->nr_pages[prev_gen][type][zid];
+
+			if (!delta)
+				continue;
+
+			update_lru_size(lruvec, type * LRU_FILE + LRU_ACTIVE,
+					zid, -delta);
+			update_lru_size(lruvec, type * LRU_FILE, zid, delta);
+		}
+	}
+
+	lrugen->timestamps[lru_gen_from_seq(max_seq + 1)] = jiffies;
+	WRITE_ONCE(lrugen->max_seq, max_seq + 1);
+	lrugen->nr_aging++;
+
+	return true;
+}
+
+/*
+ * Moves a page found young to the youngest generation of its lruvec.  The
+ * lru_lock is taken on the first young page of a pte table and held until
+ * the whole table has been looked at.
+ */
+static void lru_gen_mark_young(struct page *page, struct pglist_data *pgdat,
+			       bool *locked)
+{
+	struct lru_gen_struct *lrugen;
+	struct lruvec *lruvec;
+	int gen, new_gen, type, zid, nr_pages;
+
+	page = compound_head(page);
+
+	if (!*locked) {
+		spin_lock_irq(&pgdat->lru_lock);
+		*locked = true;
+	}
+
+	if (!PageLRU(page) || PageUnevictable(page))
+		return;
+
+	/* Isolated, or on the active/inactive lists */
+	gen = page_lru_gen(page);
+	if (gen < 0)
+		return;
+
+	lruvec = mem_cgroup_page_lruvec(page, pgdat);
+	lrugen = &lruvec->lrugen;
+	if (!lrugen->enabled)
+		return;
+
+	lrugen->nr_young++;
+	new_gen = lru_gen_from_seq(lrugen->max_seq);
+	if (gen == new_gen)
+		return;
+
+	type = page_is_file_cache(page);
+	zid = page_zonenum(page);
+	nr_pages = hpage_nr_pages(page);
+
+	lru_gen_update_size(lruvec, type, zid, gen, -nr_pages);
+	lru_gen_update_size(lruvec, type, zid, new_gen, nr_pages);
+	page_set_lru_gen(page, new_gen);
+	list_move(&page->lru, &lrugen->lists[new_gen][type][zid]);
+}
+
+static int lru_gen_pte_range(pmd_t *pmd, unsigned long addr,
+			     unsigned long end, struct mm_walk *walk)
+{
+	struct pglist_data *pgdat = walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	pte_t *pte, *orig_pte;
+	struct page *page;
+	bool locked = false;
+	spinlock_t *ptl;
+
+	ptl = pmd_trans_huge_lock(pmd, vma);
+	if (ptl) {
+		if (pmd_present(*pmd)) {
+			page = pmd_page(*pmd);
+			if (page_pgdat(page) == pgdat &&
+			    pmdp_test_and_clear_young(vma, addr, pmd))
+				lru_gen_mark_young(page, pgdat, &locked);
+		}
+		if (locked)
+			spin_unlock_irq(&pgdat->lru_lock);
+		spin_unlock(ptl);
+		return 0;
+	}
+
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		pte_t ptent = *pte;
+
+		if (!pte_present(ptent) || !pte_young(ptent))
+			continue;
+
+		/* Pages of other nodes are left for their own aging */
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page || page_pgdat(page) != pgdat)
+			continue;
+
+		if (ptep_test_and_clear_young(vma, addr, pte))
+			lru_gen_mark_young(page, pgdat, &locked);
+	}
+	if (locked)
+		spin_unlock_irq(&pgdat->lru_lock);
+	pte_unmap_unlock(orig_pte, ptl);
+	cond_resched();
+
+	return 0;
+}
+
+static int lru_gen_test_walk(unsigned long start, unsigned long end,
+			     struct mm_walk *walk)
+{
+	/* Mlocked pages are unevictable, special mappings not on the LRU */
+	if (walk->vma->vm_flags & (VM_LOCKED | VM_SPECIAL))
+		return 1;
+
+	return 0;
+}
+
+static void lru_gen_walk_mm(struct mm_struct *mm, struct pglist_data *pgdat)
+{
+	struct mm_walk walk = {
+		.pmd_entry = lru_gen_pte_range,
+		.test_walk = lru_gen_test_walk,
+		.mm = mm,
+		.private = pgdat,
+	};
+
+	/* Reclaim must not wait on mmap_sem; skip this mm for now */
+	if (!down_read_trylock(&mm->mmap_sem))
+		return;
+
+	walk_page_range(0, mm->highest_vm_end, &walk);
+	up_read(&mm->mmap_sem);
+}
+
+/*
+ * Ages @lruvec: creates a new generation and moves the pages mapped young
+ * by the mms charged to its memcg into it.  Pages of other lruvecs on the
+ * same node are moved to their own youngest generation on the way, their
+ * accessed bit is cleared all the same.
+ */
+static void lru_gen_age(struct lruvec *lruvec, unsigned long max_seq)
+{
+	struct pglist_data *pgdat = lruvec_pgdat(lruvec);
+	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
+	struct mm_struct *mm = NULL;
+	bool aged;
+
+	spin_lock_irq(&pgdat->lru_lock);
+	aged = lru_gen_inc_max_seq(lruvec, max_seq);
+	spin_unlock_irq(&pgdat->lru_lock);
+
+	if (!aged)
+		return;
+
+	while ((mm = lru_gen_next_mm(mm))) {
+		if (memcg && !mm_match_cgroup(mm, memcg))
+			continue;
+
+		lru_gen_walk_mm(mm, pgdat);
+	}
+}
+
+/*
+ * Isolates up to @nr_to_scan pages of @type from the generations that are
+ * old enough to be evicted, oldest first and from the zones eligible for
+ * this reclaim only.
+ */
+static unsigned long lru_gen_isolate(struct lruvec *lruvec,
+				     struct scan_control *sc, int type,
+				     unsigned long nr_to_scan,
+				     struct list_head *dst,
+				     unsigned long *nr_scanned)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	isolate_mode_t mode = sc->may_unmap ? 0 : ISOLATE_UNMAPPED;
+	unsigned long nr_taken = 0, scanned = 0;
+	unsigned long seq;
+
+	for (seq = lrugen->min_seq[type]; seq + MIN_NR_GENS <= lrugen->max_seq;
+	     seq++) {
+		int gen = lru_gen_from_seq(seq);
+		int zid;
+
+		for (zid = sc->reclaim_idx; zid >= 0; zid--) {
+			struct list_head *src = &lrugen->lists[gen][type][zid];
+
+			while (!list_empty(src) && scanned < nr_to_scan) {
+				struct page *page = lru_to_page(src);
+				int nr_pages = hpage_nr_pages(page);
+
+				scanned += nr_pages;
+				if (__isolate_lru_page(page, mode)) {
+					/* Being freed, or not for us */
+					list_move(&page->lru, src);
+					continue;
+				}
+
+				lru_gen_del_page(page, lruvec, true);
+				list_add(&page->lru, dst);
+				nr_taken += nr_pages;
+			}
+
+			if (scanned >= nr_to_scan)
+				goto out;
+		}
+	}
+out:
+	*nr_scanned = scanned;
+	return nr_taken;
+}
+
+/*
+ * The type with the older oldest generation is evicted first.  When both
+ * are as old, swappiness breaks the tie the way it weighs anon against
+ * file in get_scan_count().
+ */
+static int lru_gen_type_to_scan(struct lruvec *lruvec, int swappiness)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+
+	if (!swappiness)
+		return 1;
+
+	if (lrugen->min_seq[0] != lrugen->min_seq[1])
+		return lrugen->min_seq[0] > lrugen->min_seq[1];
+
+	return swappiness <= 200 - swappiness;
+}
+
+/*
+ * Evicts a batch of pages from @lruvec.  If there was nothing old enough
+ * to evict, ages @lruvec instead and returns with *@nr_scanned zero.
+ */
+static noinline_for_stack unsigned long
+lru_gen_evict(struct lruvec *lruvec, struct scan_control *sc, bool can_swap,
+	      int swappiness, unsigned long nr_to_scan,
+	      unsigned long *nr_scanned)
+{
+	LIST_HEAD(page_list);
+	struct pglist_data *pgdat = lruvec_pgdat(lruvec);
+	struct zone_reclaim_stat *reclaim_stat = &lruvec->reclaim_stat;
+	struct reclaim_stat stat = {};
+	unsigned long nr_reclaimed, nr_taken, max_seq;
+	int type;
+
+	lru_add_drain();
+
+	spin_lock_irq(&pgdat->lru_lock);
+
+	lru_gen_inc_min_seq(lruvec);
+	type = can_swap ? lru_gen_type_to_scan(lruvec, swappiness) : 1;
+	nr_taken = lru_gen_isolate(lruvec, sc, type, nr_to_scan, &page_list,
+				   nr_scanned);
+	if (!*nr_scanned && can_swap) {
+		type = !type;
+		nr_taken = lru_gen_isolate(lruvec, sc, type, nr_to_scan,
+					   &page_list, nr_scanned);
+	}
+	max_seq = lruvec->lrugen.max_seq;
+
+	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + type, nr_taken);
+	reclaim_stat->recent_scanned[type] += nr_taken;
+
+	if (current_is_kswapd()) {
+		if (global_reclaim(sc))
+			__count_vm_events(PGSCAN_KSWAPD, *nr_scanned);
+		count_memcg_events(lruvec_memcg(lruvec), PGSCAN_KSWAPD,
+				   *nr_scanned);
+	} else {
+		if (global_reclaim(sc))
+			__count_vm_events(PGSCAN_DIRECT, *nr_scanned);
+		count_memcg_events(lruvec_memcg(lruvec), PGSCAN_DIRECT,
+				   *nr_scanned);
+	}
+	spin_unlock_irq(&pgdat->lru_lock);
+
+	if (!*nr_scanned) {
+		lru_gen_age(lruvec, max_seq);
+		return 0;
+	}
+
+	if (!nr_taken)
+		return 0;
+
+	nr_reclaimed = shrink_page_list(&page_list, pgdat, sc, 0,
+					&stat, false);
+
+	spin_lock_irq(&pgdat->lru_lock);
+
+	if (current_is_kswapd()) {
+		if (global_reclaim(sc))
+			__count_vm_events(PGSTEAL_KSWAPD, nr_reclaimed);
+		count_memcg_events(lruvec_memcg(lruvec), PGSTEAL_KSWAPD,
+				   nr_reclaimed);
+	} else {
+		if (global_reclaim(sc))
+			__count_vm_events(PGSTEAL_DIRECT, nr_reclaimed);
+		count_memcg_events(lruvec_memcg(lruvec), PGSTEAL_DIRECT,
+				   nr_reclaimed);
+	}
+	lruvec->lrugen.nr_evicted += nr_reclaimed;
+
+	/* Activated pages go to the youngest generation, the rest stay old */
+	putback_inactive_pages(lruvec, &page_list);
+
+	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + type, -nr_taken);
+
+	spin_unlock_irq(&pgdat->lru_lock);
+
+	mem_cgroup_uncharge_list(&page_list);
+	free_hot_cold_page_list(&page_list, true);
+
+	/* Let kswapd write and the flushers know, as shrink_inactive_list() */
+	if (stat.nr_writeback && stat.nr_writeback == nr_taken)
+		set_bit(PGDAT_WRITEBACK, &pgdat->flags);
+
+	if (sane_reclaim(sc) && stat.nr_unqueued_dirty == nr_taken) {
+		wakeup_flusher_threads(0, WB_REASON_VMSCAN);
+		set_bit(PGDAT_DIRTY, &pgdat->flags);
+	}
+
+	return nr_reclaimed;
+}
+
+/*
+ * The multi-generational counterpart of the loop in shrink_node_memcg().
+ * The scan target is worked out from the LRU sizes and the priority like
+ * get_scan_count() does, anon only counting when it can be swapped.
+ */
+static void lru_gen_shrink_lruvec(struct lruvec *lruvec,
+				  struct mem_cgroup *memcg,
+				  struct scan_control *sc,
+				  unsigned long *lru_pages)
+{
+	bool can_swap = sc->may_swap && mem_cgroup_get_nr_swap_pages(memcg) > 0;
+	int swappiness = mem_cgroup_swappiness(memcg);
+	unsigned long nr_to_scan = 0, nr_reclaimed = 0;
+	struct blk_plug plug;
+	enum lru_list lru;
+	bool aged = false;
+
+	*lru_pages = 0;
+	for_each_evictable_lru(lru) {
+		unsigned long size;
+
+		size = lruvec_lru_size(lruvec, lru, sc->reclaim_idx);
+		*lru_pages += size;
+		if (can_swap || is_file_lru(lru))
+			nr_to_scan += size >> sc->priority;
+	}
+
+	blk_start_plug(&plug);
+	while (nr_to_scan && nr_reclaimed < sc->nr_to_reclaim) {
+		unsigned long nr_scanned;
+
+		nr_reclaimed += lru_gen_evict(lruvec, sc, can_swap, swappiness,
+					      min(nr_to_scan, SWAP_CLUSTER_MAX),
+					      &nr_scanned);
+		if (!nr_scanned) {
+			/* Still nothing to evict after aging, give up */
+			if (aged)
+				break;
+			aged = true;
+		}
+
+		nr_to_scan -= min(nr_to_scan, nr_scanned);
+		cond_resched();
+	}
+	blk_finish_plug(&plug);
+	sc->nr_reclaimed += nr_reclaimed;
+}
+
+static void lru_gen_relock(struct pglist_data *pgdat)
+{
+	if (need_resched()) {
+		spin_unlock_irq(&pgdat->lru_lock);
+		cond_resched();
+		spin_lock_irq(&pgdat->lru_lock);
+	}
+}
+
+/*
+ * Moves the pages of @lruvec from one LRU to the other, keeping them in
+ * order.  Once the flag is flipped, pages only ever get added to the new
+ * LRU, so dropping the lock in between is safe.
+ */
+static void lru_gen_switch_lruvec(struct lruvec *lruvec, bool enable)
+{
+	struct pglist_data *pgdat = lruvec_pgdat(lruvec);
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	struct page *page;
+	enum lru_list lru;
+	int type, zid;
+
+	spin_lock_irq(&pgdat->lru_lock);
+	if (lrugen->enabled == enable)
+		goto unlock;
+
+	WRITE_ONCE(lrugen->enabled, enable);
+
+	if (enable) {
+		for_each_evictable_lru(lru) {
+			struct list_head *head = &lruvec->lists[lru];
+
+			while (!list_empty(head)) {
+				page = list_first_entry(head, struct page, lru);
+				del_page_from_lru_list(page, lruvec, lru);
+				add_page_to_lru_list_tail(page, lruvec, lru);
+				lru_gen_relock(pgdat);
+			}
+		}
+		goto unlock;
+	}
+
+	for (type = 0; type < ANON_AND_FILE; type++) {
+		unsigned long max_seq = lrugen->max_seq;
+		int i, nr_gens = lru_gen_nr_gens(lruvec, type);
+
+		/* Youngest first, each to the tail of its list */
+		for (i = 0; i < nr_gens; i++) {
+			int gen = lru_gen_from_seq(max_seq - i);
+
+			for (zid = 0; zid < MAX_NR_ZONES; zid++) {
+				struct list_head *head;
+
+				head = &lrugen->lists[gen][type][zid];
+				while (!list_empty(head)) {
+					page = list_first_entry(head,
+							struct page, lru);
+					del_page_from_lru_list(page, lruvec,
+							page_lru(page));
+					add_page_to_lru_list_tail(page, lruvec,
+							page_lru(page));
+					lru_gen_relock(pgdat);
+				}
+			}
+		}
+	}
+unlock:
+	spin_unlock_irq(&pgdat->lru_lock);
+}
+
+static void lru_gen_switch(bool enable)
+{
+	struct mem_cgroup *memcg;
+	int nid;
+
+	memcg = mem_cgroup_iter(NULL, NULL, NULL);
+	do {
+		for_each_node_state(nid, N_MEMORY)
+			lru_gen_switch_lruvec(mem_cgroup_lruvec(NODE_DATA(nid),
+								memcg), enable);
+
+		memcg = mem_cgroup_iter(NULL, memcg, NULL);
+	} while (memcg);
+}
+
+#ifdef CONFIG_SYSFS
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", READ_ONCE(lru_gen_enabled));
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	bool enable;
+
+	if (kstrtobool(buf, &enable))
+		return -EINVAL;
+
+	mutex_lock(&lru_gen_mutex);
+	WRITE_ONCE(lru_gen_enabled, enable);
+	lru_gen_switch(enable);
+	mutex_unlock(&lru_gen_mutex);
+
+	return count;
+}
+static struct kobj_attribute enabled_attr =
+	__ATTR(enabled, 0644, enabled_show, enabled_store);
+
+static struct attribute *lru_gen_attrs[] = {
+	&enabled_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group lru_gen_attr_group = {
+	.attrs = lru_gen_attrs,
+	.name = "lru_gen",
+};
+#endif /* CONFIG_SYSFS */
+
+#ifdef CONFIG_DEBUG_FS
+static void lru_gen_show_lruvec(struct seq_file *m, struct lruvec *lruvec,
+				struct mem_cgroup *memcg, int nid)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	unsigned long max_seq = READ_ONCE(lrugen->max_seq);
+	unsigned long seq;
+
+	seq_printf(m, "memcg %5hu node %d%s\n",
+		   memcg ? mem_cgroup_id(memcg) : 0, nid,
+		   READ_ONCE(lrugen->enabled) ? "" : " (disabled)");
+	seq_printf(m, "  aging %lu young %lu evicted %lu\n",
+		   READ_ONCE(lrugen->nr_aging), READ_ONCE(lrugen->nr_young),
+		   READ_ONCE(lrugen->nr_evicted));
+
+	seq = min(READ_ONCE(lrugen->min_seq[0]), READ_ONCE(lrugen->min_seq[1]));
+	for (; seq <= max_seq; seq++) {
+		int gen = lru_gen_from_seq(seq);
+		long nr[ANON_AND_FILE] = {};
+		int type, zid;
+
+		for (type = 0; type < ANON_AND_FILE; type++)
+			for (zid = 0; zid < MAX_NR_ZONES; zid++)
+				nr[type] += READ_ONCE(
+					lrugen->nr_pages[gen][type][zid]);
+
+		seq_printf(m, "  %10lu %10u ms %10ld anon %10ld file\n", seq,
+			   jiffies_to_msecs(jiffies -
+					    READ_ONCE(lrugen->timestamps[gen])),
+			   nr[0], nr[1]);
+	}
+}
+
+static int lru_gen_debugfs_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg;
+	int nid;
+
+	memcg = mem_cgroup_iter(NULL, NULL, NULL);
+	do {
+		for_each_node_state(nid, N_MEMORY)
+			lru_gen_show_lruvec(m, mem_cgroup_lruvec(NODE_DATA(nid),
+								 memcg),
+					    memcg, nid);
+
+		memcg = mem_cgroup_iter(NULL, memcg, NULL);
+	} while (memcg);
+
+	return 0;
+}
+
+static int lru_gen_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lru_gen_debugfs_show, NULL);
+}
+
+static const struct file_operations lru_gen_debugfs_fops = {
+	.open		= lru_gen_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif /* CONFIG_DEBUG_FS */
+
+static int __init lru_gen_init(void)
+{
+	BUILD_BUG_ON(MAX_NR_GENS + 1 > 1U << LRU_GEN_WIDTH);
+	BUILD_BUG_ON(MIN_NR_GENS >= MAX_NR_GENS);
+
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &lru_gen_attr_group))
+		pr_err("lru_gen: register sysfs failed\n");
+#endif
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("lru_gen", 0444, NULL, NULL,
+			    &lru_gen_debugfs_fops);
+#endif
+	return 0;
+}
+late_initcall(lru_gen_init);
+#else /* !CONFIG_LRU_GEN */
+static inline bool lru_gen_lruvec_enabled(struct lruvec *lruvec)
+{
+	return false;
+}
+
+static inline void lru_gen_shrink_lruvec(struct lruvec *lruvec,
+					 struct mem_cgroup *memcg,
+					 struct scan_control *sc,
+					 unsigned long *lru_pages)
+{
+}
+#endif /* CONFIG_LRU_GEN */
+
 /*
  * This is a basic per-node page freer.  Used by both kswapd and direct reclaim.
  */
@@ -2390,6 +3154,11 @@ static void shrink_node_memcg(struct pglist_data *pgdat, struct mem_cgroup *memc
 	struct blk_plug plug;
 	bool scan_adjusted;
 
+	if (lru_gen_lruvec_enabled(lruvec)) {
+		lru_gen_shrink_lruvec(lruvec, memcg, sc, lru_pages);
+		return;
+	}
+
 	get_scan_count(lruvec, memcg, sc, nr, lru_pages);
 
 	/* Record the original scan target for proportional adjustments later */
@@ -2814,7 +3583,8 @@ static void snapshot_refaults(struct mem_cgroup *root_memcg, pg_data_t *pgdat)
 		struct lruvec *lruvec;
 
 		if (memcg)
-			refaults = memcg_page_state(memcg, WORKINGSET_ACTIVATE);
+			refaults = memcg_page_state_local(memcg,
+						WORKINGSET_ACTIVATE);
 		else
 			refaults = node_page_state(pgdat, WORKINGSET_ACTIVATE);
 
@@ -3117,6 +3887,7 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 	struct zonelist *zonelist;
 	unsigned long nr_reclaimed;
 	int nid;
+	unsigned long pflags;
 	unsigned int noreclaim_flag;
 	struct scan_control sc = {
 		.nr_to_reclaim = max(nr_pages, SWAP_CLUSTER_MAX),
@@ -3144,9 +3915,11 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 					    sc.gfp_mask,
 					    sc.reclaim_idx);
 
+	psi_memstall_enter(&pflags);
 	noreclaim_flag = memalloc_noreclaim_save();
 	nr_reclaimed = do_try_to_free_pages(zonelist, &sc);
 	memalloc_noreclaim_restore(noreclaim_flag);
+	psi_memstall_leave(&pflags);
 
 	trace_mm_vmscan_memcg_reclaim_end(nr_reclaimed);
 
@@ -3166,7 +3939,8 @@ static void age_active_anon(struct pglist_data *pgdat,
 	do {
 		struct lruvec *lruvec = mem_cgroup_lruvec(pgdat, memcg);
 
-		if (inactive_list_is_low(lruvec, false, memcg, sc, true))
+		if (!lru_gen_lruvec_enabled(lruvec) &&
+		    inactive_list_is_low(lruvec, false, memcg, sc, true))
 			shrink_active_list(SWAP_CLUSTER_MAX, lruvec,
 					   sc, LRU_ACTIVE_ANON);
 
@@ -3311,6 +4085,7 @@ static int balance_pgdat(pg_data_t *pgdat, int order, int classzone_idx)
 	int i;
 	unsigned long nr_soft_reclaimed;
 	unsigned long nr_soft_scanned;
+	unsigned long pflags;
 	struct zone *zone;
 	struct scan_control sc = {
 		.gfp_mask = GFP_KERNEL,
@@ -3320,6 +4095,8 @@ static int balance_pgdat(pg_data_t *pgdat, int order, int classzone_idx)
 		.may_unmap = 1,
 		.may_swap = 1,
 	};
+
+	psi_memstall_enter(&pflags);
 	count_vm_event(PAGEOUTRUN);
 
 	do {
@@ -3414,6 +4191,7 @@ static int balance_pgdat(pg_data_t *pgdat, int order, int classzone_idx)
 
 out:
 	snapshot_refaults(NULL, pgdat);
+	psi_memstall_leave(&pflags);
 	/*
 	 * Return the order kswapd stopped reclaiming at as
 	 * prepare_kswapd_sleep() takes it into account. If another caller
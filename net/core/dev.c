@@ -3140,6 +3140,21 @@ static void qdisc_pkt_len_init(struct sk_buff *skb)
 	}
 }
 
+/* The qdisc is running elsewhere: hand it the skb instead of waiting for
+ * its lock. False if the ring is full or the runner is already gone.
+ */
+static bool qdisc_defer_skb(struct sk_buff *skb, struct Qdisc *q)
+{
+	if (skb_array_produce(q->defer, skb))
+		return false;
+
+	/* Paired with the barrier in qdisc_run_end() */
+	smp_mb();
+	if (!qdisc_is_running(q))
+		__netif_schedule(q);
+	return true;
+}
+
 static inline int __dev_xmit_skb(struct sk_buff *skb, struct Qdisc *q,
 				 struct net_device *dev,
 				 struct netdev_queue *txq)
@@ -3157,10 +3172,18 @@ static inline int __dev_xmit_skb(struct sk_buff *skb, struct Qdisc *q,
 	 * often and dequeue packets faster.
 	 */
 	contended = qdisc_is_running(q);
-	if (unlikely(contended))
+	if (unlikely(contended)) {
+		if ((q->flags & TCQ_F_DEFER_ENQ) && qdisc_defer_skb(skb, q))
+			return NET_XMIT_SUCCESS;
 		spin_lock(&q->busylock);
+	}
 
 	spin_lock(root_lock);
+	/* Deferred skbs were sent earlier than this one */
+	if ((q->flags & TCQ_F_DEFER_ENQ) &&
+	    likely(!test_bit(__QDISC_STATE_DEACTIVATED, &q->state)))
+		qdisc_defer_drain(q);
+
 	if (unlikely(test_bit(__QDISC_STATE_DEACTIVATED, &q->state))) {
 		__qdisc_drop(skb, &to_free);
 		rc = NET_XMIT_DROP;
@@ -3648,8 +3671,14 @@ static int get_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 
 		/* First check into global flow table if there is a match */
 		ident = sock_flow_table->ents[hash & sock_flow_table->mask];
-		if ((ident ^ hash) & ~rps_cpu_mask)
+		if ((ident ^ hash) & ~rps_cpu_mask) {
+			/* Another flow took the entry: a bigger
+			 * rps_sock_flow_entries would help.
+			 */
+			if (ident != RPS_NO_CPU)
+				this_cpu_inc(softnet_data.rps_flow_collision);
 			goto try_rps;
+		}
 
 		next_cpu = ident & rps_cpu_mask;
 
@@ -3750,6 +3779,15 @@ static void rps_trigger_softirq(void *data)
 
 #endif /* CONFIG_RPS */
 
+/* Called from hardirq (IPI) context */
+static void trigger_rx_softirq(void *data)
+{
+	struct softnet_data *sd = data;
+
+	__raise_softirq_irqoff(NET_RX_SOFTIRQ);
+	smp_store_release(&sd->defer_ipi_scheduled, 0);
+}
+
 /*
  * Check if this softnet_data structure is another cpu one
  * If yes, queue it to our IPI list and return 1
@@ -3958,11 +3996,12 @@ int do_xdp_generic(struct bpf_prog *xdp_prog, struct sk_buff *skb)
 		if (act != XDP_PASS) {
 			switch (act) {
 			case XDP_REDIRECT:
+				/* On success the skb is sent or consumed */
 				err = xdp_do_generic_redirect(skb->dev, skb,
 							      xdp_prog);
 				if (err)
 					goto out_redir;
-			/* fallthru to submit skb */
+				break;
 			case XDP_TX:
 				generic_xdp_tx(skb, xdp_prog);
 				break;
@@ -5582,6 +5621,28 @@ static int napi_poll(struct napi_struct *n, struct list_head *repoll)
 	return work;
 }
 
+/* Free the skbs other cpus handed back with skb_attempt_defer_free() */
+static void skb_defer_free_flush(struct softnet_data *sd)
+{
+	struct sk_buff *skb, *next;
+
+	/* Paired with WRITE_ONCE() in skb_attempt_defer_free() */
+	if (!READ_ONCE(sd->defer_list))
+		return;
+
+	spin_lock(&sd->defer_lock);
+	skb = sd->defer_list;
+	sd->defer_list = NULL;
+	sd->defer_count = 0;
+	spin_unlock(&sd->defer_lock);
+
+	while (skb != NULL) {
+		next = skb->next;
+		napi_consume_skb(skb, 1);
+		skb = next;
+	}
+}
+
 static __latent_entropy void net_rx_action(struct softirq_action *h)
 {
 	struct softnet_data *sd = this_cpu_ptr(&softnet_data);
@@ -5598,6 +5659,8 @@ static __latent_entropy void net_rx_action(struct softirq_action *h)
 	for (;;) {
 		struct napi_struct *n;
 
+		skb_defer_free_flush(sd);
+
 		if (list_empty(&list)) {
 			if (!sd_has_rps_ipi_waiting(sd) && list_empty(&repoll))
 				goto out;
@@ -8409,6 +8472,19 @@ static int dev_cpu_dead(unsigned int oldcpu)
 		input_queue_head_incr(oldsd);
 	}
 
+	/* Free the skbs other cpus deferred to the offline one */
+	spin_lock_bh(&oldsd->defer_lock);
+	skb = oldsd->defer_list;
+	oldsd->defer_list = NULL;
+	oldsd->defer_count = 0;
+	spin_unlock_bh(&oldsd->defer_lock);
+	while (skb) {
+		struct sk_buff *next = skb->next;
+
+		__kfree_skb(skb);
+		skb = next;
+	}
+
 	return 0;
 }
 
@@ -8715,6 +8791,9 @@ static int __init net_dev_init(void)
 		skb_queue_head_init(&sd->process_queue);
 		INIT_LIST_HEAD(&sd->poll_list);
 		sd->output_queue_tailp = &sd->output_queue;
+		spin_lock_init(&sd->defer_lock);
+		sd->defer_csd.func = trigger_rx_softirq;
+		sd->defer_csd.info = sd;
 #ifdef CONFIG_RPS
 		sd->csd.func = rps_trigger_softirq;
 		sd->csd.info = sd;
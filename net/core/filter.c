@@ -55,6 +55,7 @@
 #include <net/sock_reuseport.h>
 #include <net/busy_poll.h>
 #include <net/tcp.h>
+#include <net/xdp_sock.h>
 #include <linux/bpf_trace.h>
 
 /**
@@ -1845,7 +1846,7 @@ BPF_CALL_4(bpf_sk_redirect_map, struct sk_buff *, skb,
 	struct tcp_skb_cb *tcb = TCP_SKB_CB(skb);
 
 	/* If user passes invalid input drop the packet. */
-	if (unlikely(flags))
+	if (unlikely(flags & ~BPF_F_INGRESS))
 		return SK_DROP;
 
 	tcb->bpf.key = key;
@@ -2495,17 +2496,56 @@ static int __bpf_tx_xdp(struct net_device *dev,
 	return 0;
 }
 
+static int __bpf_tx_xdp_map(struct net_device *dev_rx, void *fwd,
+			    struct bpf_map *map, struct xdp_buff *xdp,
+			    u32 index, struct xdp_umem *umem, u64 handle)
+{
+	switch (map->map_type) {
+	case BPF_MAP_TYPE_DEVMAP:
+		/* A frame in a zero-copy umem can only go to its sockets */
+		if (umem)
+			return -EOPNOTSUPP;
+		return __bpf_tx_xdp(fwd, map, xdp, index);
+	case BPF_MAP_TYPE_XSKMAP:
+		return __xsk_map_redirect(map, dev_rx, xdp, fwd, umem, handle);
+	default:
+		return -EBADRQC;
+	}
+}
+
 void xdp_do_flush_map(void)
 {
 	struct redirect_info *ri = this_cpu_ptr(&redirect_info);
 	struct bpf_map *map = ri->map_to_flush;
 
 	ri->map_to_flush = NULL;
-	if (map)
-		__dev_map_flush(map);
+	if (map) {
+		switch (map->map_type) {
+		case BPF_MAP_TYPE_DEVMAP:
+			__dev_map_flush(map);
+			break;
+		case BPF_MAP_TYPE_XSKMAP:
+			__xsk_map_flush(map);
+			break;
+		default:
+			break;
+		}
+	}
 }
 EXPORT_SYMBOL_GPL(xdp_do_flush_map);
 
+static void *__xdp_map_lookup_elem(struct bpf_map *map, u32 index)
+{
+	switch (map->map_type) {
+	case BPF_MAP_TYPE_DEVMAP:
+		return __dev_map_lookup_elem(map, index);
+	case BPF_MAP_TYPE_XSKMAP:
+		return __xsk_map_lookup_elem(map, index);
+	default:
+		return NULL;
+	}
+}
+
 static inline bool xdp_map_invalid(const struct bpf_prog *xdp_prog,
 				   unsigned long aux)
 {
@@ -2513,13 +2553,15 @@ static inline bool xdp_map_invalid(const struct bpf_prog *xdp_prog,
 }
 
 static int xdp_do_redirect_map(struct net_device *dev, struct xdp_buff *xdp,
-			       struct bpf_prog *xdp_prog)
+			       struct bpf_prog *xdp_prog,
+			       struct xdp_umem *umem, u64 handle)
 {
 	struct redirect_info *ri = this_cpu_ptr(&redirect_info);
 	unsigned long map_owner = ri->map_owner;
 	struct bpf_map *map = ri->map;
 	struct net_device *fwd = NULL;
 	u32 index = ri->ifindex;
+	void *target;
 	int err;
 
 	ri->ifindex = 0;
@@ -2532,15 +2574,18 @@ static int xdp_do_redirect_map(struct net_device *dev, struct xdp_buff *xdp,
 		goto err;
 	}
 
-	fwd = __dev_map_lookup_elem(map, index);
-	if (!fwd) {
+	target = __xdp_map_lookup_elem(map, index);
+	if (!target) {
 		err = -EINVAL;
 		goto err;
 	}
+	/* Only a devmap target is a device to name in the trace */
+	if (map->map_type == BPF_MAP_TYPE_DEVMAP)
+		fwd = target;
 	if (ri->map_to_flush && ri->map_to_flush != map)
 		xdp_do_flush_map();
 
-	err = __bpf_tx_xdp(fwd, map, xdp, index);
+	err = __bpf_tx_xdp_map(dev, target, map, xdp, index, umem, handle);
 	if (unlikely(err))
 		goto err;
 
@@ -2552,8 +2597,20 @@ static int xdp_do_redirect_map(struct net_device *dev, struct xdp_buff *xdp,
 	return err;
 }
 
-int xdp_do_redirect(struct net_device *dev, struct xdp_buff *xdp,
-		    struct bpf_prog *xdp_prog)
+/**
+ * xdp_do_redirect_umem - xdp_do_redirect() for a frame in a zero-copy umem
+ * @dev: the device the frame was received on
+ * @xdp: the frame
+ * @xdp_prog: the program that returned XDP_REDIRECT
+ * @umem: the umem the driver receives into on this queue
+ * @handle: the umem address of @xdp->data_hard_start
+ *
+ * Such a frame can only be redirected to an AF_XDP socket of @umem; the
+ * driver recycles its chunk if this fails.
+ */
+int xdp_do_redirect_umem(struct net_device *dev, struct xdp_buff *xdp,
+			 struct bpf_prog *xdp_prog, struct xdp_umem *umem,
+			 u64 handle)
 {
 	struct redirect_info *ri = this_cpu_ptr(&redirect_info);
 	struct net_device *fwd;
@@ -2561,7 +2618,7 @@ int xdp_do_redirect(struct net_device *dev, struct xdp_buff *xdp,
 	int err;
 
 	if (ri->map)
-		return xdp_do_redirect_map(dev, xdp, xdp_prog);
+		return xdp_do_redirect_map(dev, xdp, xdp_prog, umem, handle);
 
 	fwd = dev_get_by_index_rcu(dev_net(dev), index);
 	ri->ifindex = 0;
@@ -2570,6 +2627,11 @@ int xdp_do_redirect(struct net_device *dev, struct xdp_buff *xdp,
 		goto err;
 	}
 
+	if (unlikely(umem)) {
+		err = -EOPNOTSUPP;
+		goto err;
+	}
+
 	err = __bpf_tx_xdp(fwd, NULL, xdp, 0);
 	if (unlikely(err))
 		goto err;
@@ -2580,8 +2642,34 @@ int xdp_do_redirect(struct net_device *dev, struct xdp_buff *xdp,
 	_trace_xdp_redirect_err(dev, xdp_prog, index, err);
 	return err;
 }
+EXPORT_SYMBOL_GPL(xdp_do_redirect_umem);
+
+int xdp_do_redirect(struct net_device *dev, struct xdp_buff *xdp,
+		    struct bpf_prog *xdp_prog)
+{
+	return xdp_do_redirect_umem(dev, xdp, xdp_prog, NULL, 0);
+}
 EXPORT_SYMBOL_GPL(xdp_do_redirect);
 
+/* The skb starts at the MAC header, as the program saw it */
+static int xdp_do_generic_redirect_xsk(struct xdp_sock *xs,
+				       struct sk_buff *skb)
+{
+	struct xdp_buff xdp;
+	int err;
+
+	xdp.data = skb->data;
+	xdp.data_end = skb->data + skb_headlen(skb);
+	xdp.data_hard_start = skb->data - skb_headroom(skb);
+
+	err = xsk_generic_rcv(xs, skb, &xdp);
+	if (err)
+		return err;
+
+	consume_skb(skb);
+	return 0;
+}
+
 int xdp_do_generic_redirect(struct net_device *dev, struct sk_buff *skb,
 			    struct bpf_prog *xdp_prog)
 {
@@ -2603,7 +2691,17 @@ int xdp_do_generic_redirect(struct net_device *dev, struct sk_buff *skb,
 			map = NULL;
 			goto err;
 		}
-		fwd = __dev_map_lookup_elem(map, index);
+		if (map->map_type == BPF_MAP_TYPE_XSKMAP) {
+			struct xdp_sock *xs = __xsk_map_lookup_elem(map, index);
+
+			err = xs ? xdp_do_generic_redirect_xsk(xs, skb) :
+				   -EINVAL;
+			if (err)
+				goto err;
+			_trace_xdp_redirect_map(dev, xdp_prog, fwd, map, index);
+			return 0;
+		}
+		fwd = __xdp_map_lookup_elem(map, index);
 	} else {
 		fwd = dev_get_by_index_rcu(dev_net(dev), index);
 	}
@@ -2624,6 +2722,7 @@ int xdp_do_generic_redirect(struct net_device *dev, struct sk_buff *skb,
 	}
 
 	skb->dev = fwd;
+	generic_xdp_tx(skb, xdp_prog);
 	map ? _trace_xdp_redirect_map(dev, xdp_prog, fwd, map, index)
 		: _trace_xdp_redirect(dev, xdp_prog, index);
 	return 0;
@@ -3180,6 +3279,10 @@ bpf_base_func_proto(enum bpf_func_id func_id)
 		return &bpf_tail_call_proto;
 	case BPF_FUNC_ktime_get_ns:
 		return &bpf_ktime_get_ns_proto;
+	case BPF_FUNC_ringbuf_output:
+		return &bpf_ringbuf_output_proto;
+	case BPF_FUNC_ringbuf_query:
+		return &bpf_ringbuf_query_proto;
 	case BPF_FUNC_trace_printk:
 		if (capable(CAP_SYS_ADMIN))
 			return bpf_get_trace_printk_proto();
@@ -4240,6 +4343,19 @@ static u32 sock_ops_convert_ctx_access(enum bpf_access_type type,
 		*insn++ = BPF_LDX_MEM(BPF_H, si->dst_reg, si->dst_reg,
 				      offsetof(struct sock_common, skc_num));
 		break;
+
+	case offsetof(struct bpf_sock_ops, incoming_cpu):
+		BUILD_BUG_ON(FIELD_SIZEOF(struct sock_common,
+					  skc_incoming_cpu) != 4);
+
+		*insn++ = BPF_LDX_MEM(BPF_FIELD_SIZEOF(
+						struct bpf_sock_ops_kern, sk),
+				      si->dst_reg, si->src_reg,
+				      offsetof(struct bpf_sock_ops_kern, sk));
+		*insn++ = BPF_LDX_MEM(BPF_W, si->dst_reg, si->dst_reg,
+				      offsetof(struct sock_common,
+					       skc_incoming_cpu));
+		break;
 	}
 	return insn - insn_buf;
 }
@@ -0,0 +1,242 @@
+/*
+ * page_pool: recycling of whole pages for NAPI receive rings
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/dma-mapping.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <net/page_pool.h>
+
+static int page_pool_init(struct page_pool *pool,
+			  const struct page_pool_params *params)
+{
+	unsigned int ring_qsize = 1024; /* Default */
+
+	memcpy(&pool->p, params, sizeof(pool->p));
+
+	if (pool->p.flags & ~PP_FLAG_ALL)
+		return -EINVAL;
+
+	if (pool->p.pool_size)
+		ring_qsize = pool->p.pool_size;
+
+	/* Sanity limit mem that can be pinned down */
+	if (ring_qsize > 32768)
+		return -E2BIG;
+
+	if (pool->p.flags & PP_FLAG_DMA_MAP) {
+		/* The mapping has to fit in page->private */
+		if (sizeof(dma_addr_t) > sizeof(unsigned long))
+			return -EOPNOTSUPP;
+		if (!pool->p.dev)
+			return -EINVAL;
+		if (pool->p.dma_dir != DMA_FROM_DEVICE &&
+		    pool->p.dma_dir != DMA_BIDIRECTIONAL)
+			return -EINVAL;
+	}
+
+	if (ptr_ring_init(&pool->ring, ring_qsize, GFP_KERNEL) < 0)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * page_pool_create - create a pool of pages for one receive queue
+ * @params: what to allocate, and how to map it
+ *
+ * Returns the pool, or an ERR_PTR() on failure.
+ */
+struct page_pool *page_pool_create(const struct page_pool_params *params)
+{
+	struct page_pool *pool;
+	int err;
+
+	pool = kzalloc_node(sizeof(*pool), GFP_KERNEL, params->nid);
+	if (!pool)
+		return ERR_PTR(-ENOMEM);
+
+	err = page_pool_init(pool, params);
+	if (err < 0) {
+		pr_warn("%s() gave up with errno %d\n", __func__, err);
+		kfree(pool);
+		return ERR_PTR(err);
+	}
+	return pool;
+}
+EXPORT_SYMBOL(page_pool_create);
+
+/* Refill the NAPI cache from the ring, taking one page for the caller */
+static struct page *__page_pool_get_cached(struct page_pool *pool)
+{
+	struct ptr_ring *r = &pool->ring;
+	struct page *page;
+
+	if (likely(pool->alloc.count))
+		return pool->alloc.cache[--pool->alloc.count];
+
+	/* The ring is never resized, so an empty one can be seen unlocked */
+	if (__ptr_ring_empty(r))
+		return NULL;
+
+	spin_lock(&r->consumer_lock);
+	page = __ptr_ring_consume(r);
+	if (page)
+		pool->alloc.count = __ptr_ring_consume_batched(r,
+					(void **)pool->alloc.cache,
+					PP_ALLOC_CACHE_REFILL);
+	spin_unlock(&r->consumer_lock);
+	return page;
+}
+
+static struct page *__page_pool_alloc_pages_slow(struct page_pool *pool,
+						 gfp_t gfp)
+{
+	struct page *page;
+	dma_addr_t dma;
+
+	if (pool->p.order)
+		gfp |= __GFP_COMP;
+
+	page = alloc_pages_node(pool->p.nid, gfp, pool->p.order);
+	if (!page)
+		return NULL;
+
+	if (!(pool->p.flags & PP_FLAG_DMA_MAP))
+		return page;
+
+	/* Synced for the device when it is put on a ring, not here */
+	dma = dma_map_page_attrs(pool->p.dev, page, 0,
+				 PAGE_SIZE << pool->p.order,
+				 pool->p.dma_dir, DMA_ATTR_SKIP_CPU_SYNC);
+	if (dma_mapping_error(pool->p.dev, dma)) {
+		put_page(page);
+		return NULL;
+	}
+	set_page_private(page, (unsigned long)dma);
+	return page;
+}
+
+/**
+ * page_pool_alloc_pages - take a page from the pool
+ * @pool: the pool, from its NAPI context
+ * @gfp: for when a new page has to be allocated
+ *
+ * A recycled page comes first; only when there is none does this go to
+ * the page allocator, and map the new page if the pool maps.
+ */
+struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp)
+{
+	struct page *page;
+
+	page = __page_pool_get_cached(pool);
+	if (page)
+		return page;
+
+	return __page_pool_alloc_pages_slow(pool, gfp);
+}
+EXPORT_SYMBOL(page_pool_alloc_pages);
+
+/**
+ * page_pool_release_page - take a page out of the pool's hands
+ * @pool: the pool it came from
+ * @page: the page
+ *
+ * Unmaps the page, so that it can go up the stack and be freed there
+ * with put_page() like any other.
+ */
+void page_pool_release_page(struct page_pool *pool, struct page *page)
+{
+	if (!(pool->p.flags & PP_FLAG_DMA_MAP))
+		return;
+
+	dma_unmap_page_attrs(pool->p.dev, page_pool_get_dma_addr(page),
+			     PAGE_SIZE << pool->p.order, pool->p.dma_dir,
+			     DMA_ATTR_SKIP_CPU_SYNC);
+	set_page_private(page, 0);
+}
+EXPORT_SYMBOL(page_pool_release_page);
+
+static void __page_pool_return_page(struct page_pool *pool, struct page *page)
+{
+	page_pool_release_page(pool, page);
+	put_page(page);
+}
+
+/* Only the pool's own NAPI poll may use the cache, so no locking */
+static bool __page_pool_recycle_direct(struct page_pool *pool,
+				       struct page *page)
+{
+	if (unlikely(pool->alloc.count == PP_ALLOC_CACHE_SIZE))
+		return false;
+
+	pool->alloc.cache[pool->alloc.count++] = page;
+	return true;
+}
+
+static bool __page_pool_recycle_into_ring(struct page_pool *pool,
+					  struct page *page)
+{
+	int ret;
+
+	if (in_serving_softirq())
+		ret = ptr_ring_produce(&pool->ring, page);
+	else
+		ret = ptr_ring_produce_bh(&pool->ring, page);
+
+	return ret == 0;
+}
+
+/**
+ * __page_pool_put_page - give a page back to its pool
+ * @pool: the pool it came from
+ * @page: the page
+ * @allow_direct: the caller is the pool's NAPI poll, and may use the cache
+ *
+ * A page someone else still has a reference to can't be recycled: it is
+ * unmapped and the pool's reference dropped instead.
+ */
+void __page_pool_put_page(struct page_pool *pool, struct page *page,
+			  bool allow_direct)
+{
+	if (likely(page_ref_count(page) == 1 && !page_is_pfmemalloc(page))) {
+		if (allow_direct && in_serving_softirq() &&
+		    __page_pool_recycle_direct(pool, page))
+			return;
+
+		if (__page_pool_recycle_into_ring(pool, page))
+			return;
+	}
+
+	__page_pool_return_page(pool, page);
+}
+EXPORT_SYMBOL(__page_pool_put_page);
+
+static void __page_pool_empty_ring(struct page_pool *pool)
+{
+	struct page *page;
+
+	while ((page = ptr_ring_consume_bh(&pool->ring)))
+		__page_pool_return_page(pool, page);
+}
+
+/**
+ * page_pool_destroy - free the pool and the pages it holds
+ * @pool: the pool, with its NAPI context stopped and every page back
+ */
+void page_pool_destroy(struct page_pool *pool)
+{
+	while (pool->alloc.count)
+		__page_pool_return_page(pool,
+				pool->alloc.cache[--pool->alloc.count]);
+
+	__page_pool_empty_ring(pool);
+	ptr_ring_cleanup(&pool->ring, NULL);
+	kfree(pool);
+}
+EXPORT_SYMBOL(page_pool_destroy);
@@ -3,6 +3,12 @@
  * listening on the same port.  This allows a decision to be made after finding
  * the first socket.  An optional BPF program can also be configured for
  * selecting the socket index from the array of available sockets.
+ *
+ * Without a program, a group in which some sockets have SO_INCOMING_CPU
+ * set hands a packet to the socket bound to the CPU processing it, if
+ * there is one. With one listener per CPU, each served by a thread on
+ * that CPU, a connection's SYN, its ACK and accept() then all stay on
+ * the CPU its flow is steered to, and no accept queue is shared.
  */
 
 #include <net/sock_reuseport.h>
@@ -52,6 +58,8 @@ int reuseport_alloc(struct sock *sk)
 
 	reuse->socks[0] = sk;
 	reuse->num_socks = 1;
+	if (sock_flag(sk, SOCK_INCOMING_CPU))
+		reuse->incoming_cpu = 1;
 	rcu_assign_pointer(sk->sk_reuseport_cb, reuse);
 
 out:
@@ -76,6 +84,7 @@ static struct sock_reuseport *reuseport_grow(struct sock_reuseport *reuse)
 
 	more_reuse->max_socks = more_socks_size;
 	more_reuse->num_socks = reuse->num_socks;
+	more_reuse->incoming_cpu = reuse->incoming_cpu;
 	more_reuse->prog = reuse->prog;
 
 	memcpy(more_reuse->socks, reuse->socks,
@@ -126,6 +135,8 @@ int reuseport_add_sock(struct sock *sk, struct sock *sk2)
 	}
 
 	reuse->socks[reuse->num_socks] = sk;
+	if (sock_flag(sk, SOCK_INCOMING_CPU))
+		WRITE_ONCE(reuse->incoming_cpu, reuse->incoming_cpu + 1);
 	/* paired with smp_rmb() in reuseport_select_sock() */
 	smp_wmb();
 	reuse->num_socks++;
@@ -160,6 +171,9 @@ void reuseport_detach_sock(struct sock *sk)
 		if (reuse->socks[i] == sk) {
 			reuse->socks[i] = reuse->socks[reuse->num_socks - 1];
 			reuse->num_socks--;
+			if (sock_flag(sk, SOCK_INCOMING_CPU))
+				WRITE_ONCE(reuse->incoming_cpu,
+					   reuse->incoming_cpu - 1);
 			if (reuse->num_socks == 0)
 				call_rcu(&reuse->rcu, reuseport_free_rcu);
 			break;
@@ -169,6 +183,50 @@ void reuseport_detach_sock(struct sock *sk)
 }
 EXPORT_SYMBOL(reuseport_detach_sock);
 
+/* SO_INCOMING_CPU: a negative value unbinds the socket from any CPU */
+void reuseport_update_incoming_cpu(struct sock *sk, int val)
+{
+	struct sock_reuseport *reuse;
+	bool was_set;
+
+	spin_lock_bh(&reuseport_lock);
+	WRITE_ONCE(sk->sk_incoming_cpu, val);
+
+	was_set = sock_flag(sk, SOCK_INCOMING_CPU);
+	if (val >= 0)
+		sock_set_flag(sk, SOCK_INCOMING_CPU);
+	else
+		sock_reset_flag(sk, SOCK_INCOMING_CPU);
+
+	reuse = rcu_dereference_protected(sk->sk_reuseport_cb,
+					  lockdep_is_held(&reuseport_lock));
+	if (reuse && was_set != (val >= 0))
+		WRITE_ONCE(reuse->incoming_cpu,
+			   reuse->incoming_cpu + (was_set ? -1 : 1));
+	spin_unlock_bh(&reuseport_lock);
+}
+
+/* Start at the slot of the CPU: finds it first if the sockets were
+ * added in CPU order.
+ */
+static struct sock *select_by_cpu(struct sock_reuseport *reuse, u16 socks)
+{
+	int cpu = raw_smp_processor_id();
+	u16 i, start = cpu % socks;
+
+	i = start;
+	do {
+		struct sock *sk = reuse->socks[i];
+
+		if (READ_ONCE(sk->sk_incoming_cpu) == cpu)
+			return sk;
+		if (++i == socks)
+			i = 0;
+	} while (i != start);
+
+	return NULL;
+}
+
 static struct sock *run_bpf(struct sock_reuseport *reuse, u16 socks,
 			    struct bpf_prog *prog, struct sk_buff *skb,
 			    int hdr_len)
@@ -232,10 +290,15 @@ struct sock *reuseport_select_sock(struct sock *sk,
 		/* paired with smp_wmb() in reuseport_add_sock() */
 		smp_rmb();
 
-		if (prog && skb)
+		if (prog && skb) {
 			sk2 = run_bpf(reuse, socks, prog, skb, hdr_len);
-		else
-			sk2 = reuse->socks[reciprocal_scale(hash, socks)];
+		} else {
+			if (READ_ONCE(reuse->incoming_cpu))
+				sk2 = select_by_cpu(reuse, socks);
+			if (!sk2)
+				sk2 = reuse->socks[reciprocal_scale(hash,
+								    socks)];
+		}
 	}
 
 out:
@@ -973,6 +973,34 @@ static void tcp_internal_pacing(struct sock *sk, const struct sk_buff *skb)
 		      HRTIMER_MODE_ABS_PINNED);
 }
 
+/* An EDT qdisc (sch_edt) asked for departure times: instead of arming
+ * pacing_timer, stamp each data packet with the time it may leave at and
+ * let the qdisc hold it until then. Pure ACKs are not paced.
+ */
+static ktime_t tcp_edt_tstamp(struct sock *sk, const struct sk_buff *skb,
+			      bool data)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	u64 now, tstamp, len_ns;
+	u32 rate;
+
+	if (!data ||
+	    smp_load_acquire(&sk->sk_pacing_status) != SK_PACING_EDT)
+		return 0;
+
+	now = ktime_get_ns();
+	tstamp = max(tp->tcp_wstamp_ns, now);
+	rate = sk->sk_pacing_rate;
+	if (rate && rate != ~0U) {
+		len_ns = (u64)skb->len * NSEC_PER_SEC;
+		do_div(len_ns, rate);
+		tp->tcp_wstamp_ns = tstamp + len_ns;
+	} else {
+		tp->tcp_wstamp_ns = tstamp;
+	}
+	return ns_to_ktime(tstamp);
+}
+
 /* This routine actually transmits TCP packets queued in by
  * tcp_do_sendmsg().  This is used by both the initial
  * transmission and possible later retransmissions.
@@ -1115,8 +1143,10 @@ static int tcp_transmit_skb(struct sock *sk, struct sk_buff *skb, int clone_it,
 	skb_shinfo(skb)->gso_segs = tcp_skb_pcount(skb);
 	skb_shinfo(skb)->gso_size = tcp_skb_mss(skb);
 
-	/* Our usage of tstamp should remain private */
-	skb->tstamp = 0;
+	/* Our usage of tstamp should remain private, unless the qdisc
+	 * wants departure times in it.
+	 */
+	skb->tstamp = tcp_edt_tstamp(sk, skb, skb->len != tcp_header_size);
 
 	/* Cleanup our debris for IP stacks */
 	memset(skb->cb, 0, max(sizeof(struct inet_skb_parm),
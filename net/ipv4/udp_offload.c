@@ -187,19 +187,166 @@ struct sk_buff *skb_udp_tunnel_segment(struct sk_buff *skb,
 }
 EXPORT_SYMBOL(skb_udp_tunnel_segment);
 
-static struct sk_buff *udp4_tunnel_segment(struct sk_buff *skb,
-					   netdev_features_t features)
+/* Split a UDP_SEGMENT datagram into gso_size datagrams. The header of the
+ * GSO skb carries the pseudo header checksum of the whole datagram: each
+ * segment's is adjusted for its own length. Shared by IPv4 and IPv6.
+ */
+struct sk_buff *__udp_gso_segment(struct sk_buff *gso_skb,
+				  netdev_features_t features)
+{
+	struct sock *sk = gso_skb->sk;
+	unsigned int sum_truesize = 0;
+	struct sk_buff *segs, *seg;
+	struct udphdr *uh;
+	unsigned int mss;
+	bool copy_dtor;
+	__sum16 check;
+	__be16 newlen;
+
+	mss = skb_shinfo(gso_skb)->gso_size;
+	if (gso_skb->len <= sizeof(*uh) + mss)
+		return ERR_PTR(-EINVAL);
+
+	skb_pull(gso_skb, sizeof(*uh));
+
+	/* clear destructor to avoid skb_segment assigning it to tail */
+	copy_dtor = gso_skb->destructor == sock_wfree;
+	if (copy_dtor)
+		gso_skb->destructor = NULL;
+
+	segs = skb_segment(gso_skb, features & ~NETIF_F_GSO_PARTIAL);
+	if (unlikely(IS_ERR_OR_NULL(segs))) {
+		if (copy_dtor)
+			gso_skb->destructor = sock_wfree;
+		return segs;
+	}
+
+	seg = segs;
+	uh = udp_hdr(seg);
+
+	/* All but the last segment carry exactly mss bytes */
+	newlen = htons(sizeof(*uh) + mss);
+	check = csum16_add(csum16_sub(uh->check, uh->len), newlen);
+
+	for (;;) {
+		if (copy_dtor) {
+			seg->destructor = sock_wfree;
+			seg->sk = sk;
+			sum_truesize += seg->truesize;
+		}
+
+		if (!seg->next)
+			break;
+
+		uh->len = newlen;
+		uh->check = check;
+
+		if (seg->ip_summed == CHECKSUM_PARTIAL)
+			gso_reset_checksum(seg, ~check);
+		else
+			uh->check = gso_make_checksum(seg, ~check) ? :
+				    CSUM_MANGLED_0;
+
+		seg = seg->next;
+		uh = udp_hdr(seg);
+	}
+
+	newlen = htons(skb_tail_pointer(seg) - skb_transport_header(seg) +
+		       seg->data_len);
+	check = csum16_add(csum16_sub(uh->check, uh->len), newlen);
+
+	uh->len = newlen;
+	uh->check = check;
+
+	if (seg->ip_summed == CHECKSUM_PARTIAL)
+		gso_reset_checksum(seg, ~check);
+	else
+		uh->check = gso_make_checksum(seg, ~check) ? : CSUM_MANGLED_0;
+
+	/* The socket is charged for the segments instead of the GSO skb */
+	if (copy_dtor) {
+		int delta = sum_truesize - gso_skb->truesize;
+
+		if (likely(delta >= 0))
+			refcount_add(delta, &sk->sk_wmem_alloc);
+		else
+			WARN_ON_ONCE(refcount_sub_and_test(-delta,
+							   &sk->sk_wmem_alloc));
+	}
+
+	return segs;
+}
+EXPORT_SYMBOL_GPL(__udp_gso_segment);
+
+static struct sk_buff *udp4_gso_segment(struct sk_buff *skb,
+					netdev_features_t features)
 {
 	struct sk_buff *segs = ERR_PTR(-EINVAL);
 
 	if (skb->encapsulation &&
 	    (skb_shinfo(skb)->gso_type &
 	     (SKB_GSO_UDP_TUNNEL|SKB_GSO_UDP_TUNNEL_CSUM)))
-		segs = skb_udp_tunnel_segment(skb, features, false);
+		return skb_udp_tunnel_segment(skb, features, false);
+
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) {
+		if (!pskb_may_pull(skb, sizeof(struct udphdr)))
+			return segs;
+		segs = __udp_gso_segment(skb, features);
+	}
 
 	return segs;
 }
 
+/* Plain UDP GRO, for UDP_GRO sockets: the datagrams of a flow are chained
+ * on the frag_list of the first one. All have its length but the last,
+ * which may be shorter, as UDP_SEGMENT builds them.
+ */
+static struct sk_buff **udp_gro_receive_segment(struct sk_buff **head,
+						struct sk_buff *skb,
+						struct udphdr *uh)
+{
+	unsigned int off = skb_gro_offset(skb);
+	unsigned int ulen = ntohs(uh->len);
+	struct sk_buff *p, **pp = NULL;
+	struct udphdr *uh2;
+	int flush = 1;
+
+	/* requires non zero csum, for symmetry with GSO */
+	if (!uh->check || ulen <= sizeof(*uh) || ulen != skb_gro_len(skb))
+		goto out;
+
+	skb_gro_pull(skb, sizeof(struct udphdr));
+	skb_gro_postpull_rcsum(skb, uh, sizeof(struct udphdr));
+	flush = 0;
+
+	for (; (p = *head); head = &p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = (struct udphdr *)(p->data + off);
+
+		/* Match ports only, as csum is always non zero */
+		if (*(u32 *)&uh->source != *(u32 *)&uh2->source) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+
+		/* A longer datagram starts a new train. A shorter one ends
+		 * this one, as does reaching the UDP_SEGMENT limit.
+		 */
+		if (ulen > ntohs(uh2->len) || skb_gro_receive_list(p, skb))
+			pp = head;
+		else if (ulen != ntohs(uh2->len) ||
+			 NAPI_GRO_CB(p)->count >= UDP_MAX_SEGMENTS)
+			pp = head;
+		break;
+	}
+
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+	return pp;
+}
+
 struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *skb,
 				 struct udphdr *uh, udp_lookup_t lookup)
 {
@@ -209,18 +356,27 @@ struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *skb,
 	int flush = 1;
 	struct sock *sk;
 
-	if (NAPI_GRO_CB(skb)->encap_mark ||
-	    (skb->ip_summed != CHECKSUM_PARTIAL &&
-	     NAPI_GRO_CB(skb)->csum_cnt == 0 &&
-	     !NAPI_GRO_CB(skb)->csum_valid))
+	if (NAPI_GRO_CB(skb)->encap_mark)
 		goto out;
 
-	/* mark that this skb passed once through the tunnel gro layer */
-	NAPI_GRO_CB(skb)->encap_mark = 1;
-
 	rcu_read_lock();
 	sk = (*lookup)(skb, uh->source, uh->dest);
 
+	/* udp4/6_gro_receive() validated the checksum of the datagram */
+	if (sk && udp_sk(sk)->gro_enabled) {
+		pp = udp_gro_receive_segment(head, skb, uh);
+		rcu_read_unlock();
+		return pp;
+	}
+
+	if (skb->ip_summed != CHECKSUM_PARTIAL &&
+	    NAPI_GRO_CB(skb)->csum_cnt == 0 &&
+	    !NAPI_GRO_CB(skb)->csum_valid)
+		goto out_unlock;
+
+	/* mark that this skb passed once through the tunnel gro layer */
+	NAPI_GRO_CB(skb)->encap_mark = 1;
+
 	if (sk && udp_sk(sk)->gro_receive)
 		goto unflush;
 	goto out_unlock;
@@ -283,6 +439,20 @@ static struct sk_buff **udp4_gro_receive(struct sk_buff **head,
 	return NULL;
 }
 
+/* The GRO skb looks like one a UDP_SEGMENT socket sends: CHECKSUM_PARTIAL
+ * over the pseudo header checksum of the whole datagram.
+ */
+static int udp_gro_complete_segment(struct sk_buff *skb, struct udphdr *uh)
+{
+	skb->csum_start = (unsigned char *)uh - skb->head;
+	skb->csum_offset = offsetof(struct udphdr, check);
+	skb->ip_summed = CHECKSUM_PARTIAL;
+
+	skb_shinfo(skb)->gso_segs = NAPI_GRO_CB(skb)->count;
+	skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_L4;
+	return 0;
+}
+
 int udp_gro_complete(struct sk_buff *skb, int nhoff,
 		     udp_lookup_t lookup)
 {
@@ -293,6 +463,13 @@ int udp_gro_complete(struct sk_buff *skb, int nhoff,
 
 	uh->len = newlen;
 
+	/* Only the tunnel path of udp_gro_receive() sets encap_mark */
+	if (!NAPI_GRO_CB(skb)->encap_mark)
+		return udp_gro_complete_segment(skb, uh);
+
+	skb_shinfo(skb)->gso_type |= uh->check ? SKB_GSO_UDP_TUNNEL_CSUM :
+						 SKB_GSO_UDP_TUNNEL;
+
 	/* Set encapsulation before calling into inner gro_complete() functions
 	 * to make them set up the inner offsets.
 	 */
@@ -317,20 +494,16 @@ static int udp4_gro_complete(struct sk_buff *skb, int nhoff)
 	const struct iphdr *iph = ip_hdr(skb);
 	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
 
-	if (uh->check) {
-		skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_TUNNEL_CSUM;
+	if (uh->check)
 		uh->check = ~udp_v4_check(skb->len - nhoff, iph->saddr,
 					  iph->daddr, 0);
-	} else {
-		skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_TUNNEL;
-	}
 
 	return udp_gro_complete(skb, nhoff, udp4_lib_lookup_skb);
 }
 
 static const struct net_offload udpv4_offload = {
 	.callbacks = {
-		.gso_segment = udp4_tunnel_segment,
+		.gso_segment = udp4_gso_segment,
 		.gro_receive  =	udp4_gro_receive,
 		.gro_complete =	udp4_gro_complete,
 	},
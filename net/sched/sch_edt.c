@@ -0,0 +1,476 @@
+/*
+ * net/sched/sch_edt.c Earliest Departure Time Packet Scheduler
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ *
+ *  Meant for locally generated traffic, like sch_fq, but the transport
+ *  does the pacing math : TCP stamps each data packet (skb->tstamp,
+ *  CLOCK_MONOTONIC) with the time it may leave at, once it sees this
+ *  qdisc has set SK_PACING_EDT in sk->sk_pacing_status, and we only
+ *  hold the packet until then.
+ *
+ *  There is no per flow state. Packets wait in a calendar queue : a ring
+ *  of 2^slots_log slots of 2^slot_log ns each, plus a bitmap of the
+ *  slots that hold packets.
+ *
+ *  enqueue() : release the slots that became due, then append the packet
+ *   to the slot of its departure time, or to the fifo of packets due now.
+ *   O(1), whatever the number of flows.
+ *  dequeue() : serve the fifo of due packets. If it is empty, arm the
+ *   watchdog for the start of the next busy slot. The expiry only changes
+ *   when a slot is released, so the hrtimer is not reprogrammed per
+ *   packet or per flow.
+ *
+ *  Packets are released up to one slot early. Departure times beyond the
+ *  horizon (slots * slot length) are capped to the last slot.
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/init.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/bitmap.h>
+#include <linux/mm.h>
+#include <net/netlink.h>
+#include <net/pkt_sched.h>
+#include <net/sock.h>
+
+struct edt_slot {
+	struct sk_buff	*head;
+	struct sk_buff	*tail;
+};
+
+struct edt_sched_data {
+	struct edt_slot	ready;		/* packets due now */
+	struct edt_slot	*slots;
+	unsigned long	*bitmap;	/* slots holding packets */
+	u64		cursor;		/* first slot not released yet */
+	u32		busy_slots;
+	u32		slot_log;
+	u32		slots_log;
+
+	u64		stat_horizon_capped;
+	struct qdisc_watchdog watchdog;
+};
+
+static void edt_slot_add(struct edt_slot *s, struct sk_buff *skb)
+{
+	skb->next = NULL;
+	if (!s->head)
+		s->head = skb;
+	else
+		s->tail->next = skb;
+	s->tail = skb;
+}
+
+static void edt_slot_splice(struct edt_slot *dst, struct edt_slot *src)
+{
+	if (!dst->head)
+		dst->head = src->head;
+	else
+		dst->tail->next = src->head;
+	dst->tail = src->tail;
+	src->head = NULL;
+}
+
+/* Move the slots that started at or before @now to the ready fifo */
+static void edt_release(struct edt_sched_data *q, u64 now)
+{
+	u64 now_slot = now >> q->slot_log;
+	u32 nslots = 1U << q->slots_log;
+	u32 idx, end, bit;
+	u64 n;
+
+	if (now_slot < q->cursor)
+		return;
+
+	n = min_t(u64, now_slot - q->cursor + 1, nslots);
+	idx = q->cursor & (nslots - 1);
+	while (n && q->busy_slots) {
+		end = min_t(u64, (u64)idx + n, nslots);
+		bit = find_next_bit(q->bitmap, end, idx);
+		if (bit < end) {
+			edt_slot_splice(&q->ready, &q->slots[bit]);
+			__clear_bit(bit, q->bitmap);
+			q->busy_slots--;
+			n -= bit + 1 - idx;
+			idx = (bit + 1) & (nslots - 1);
+		} else {
+			n -= end - idx;
+			idx = 0;
+		}
+	}
+	q->cursor = now_slot + 1;
+}
+
+/* Absolute number of the first busy slot. Caller checks q->busy_slots */
+static u64 edt_next_slot(const struct edt_sched_data *q)
+{
+	u32 nslots = 1U << q->slots_log;
+	u32 idx = q->cursor & (nslots - 1);
+	u32 bit;
+
+	bit = find_next_bit(q->bitmap, nslots, idx);
+	if (bit < nslots)
+		return q->cursor + (bit - idx);
+
+	bit = find_first_bit(q->bitmap, idx);
+	return q->cursor + (nslots - idx) + bit;
+}
+
+/* Queue @skb for departure at @tstamp. Slots up to now were released */
+static void edt_schedule(struct edt_sched_data *q, struct sk_buff *skb,
+			 u64 tstamp)
+{
+	u32 nslots = 1U << q->slots_log;
+	u64 slot = tstamp >> q->slot_log;
+	u32 idx;
+
+	if (slot < q->cursor) {
+		edt_slot_add(&q->ready, skb);
+		return;
+	}
+	if (unlikely(slot >= q->cursor + nslots)) {
+		slot = q->cursor + nslots - 1;
+		q->stat_horizon_capped++;
+	}
+
+	idx = slot & (nslots - 1);
+	if (!q->slots[idx].head) {
+		__set_bit(idx, q->bitmap);
+		q->busy_slots++;
+	}
+	edt_slot_add(&q->slots[idx], skb);
+}
+
+static int edt_enqueue(struct sk_buff *skb, struct Qdisc *sch,
+		       struct sk_buff **to_free)
+{
+	struct edt_sched_data *q = qdisc_priv(sch);
+	struct sock *sk = skb->sk;
+	u64 tstamp = 0;
+
+	if (unlikely(sch->q.qlen >= sch->limit))
+		return qdisc_drop(skb, sch, to_free);
+
+	/* Only trust skb->tstamp from a socket we asked for it :
+	 * forwarded packets carry their receive time there.
+	 */
+	if (sk && sk_fullsock(sk)) {
+		if (unlikely(smp_load_acquire(&sk->sk_pacing_status) !=
+			     SK_PACING_EDT))
+			smp_store_release(&sk->sk_pacing_status,
+					  SK_PACING_EDT);
+		else
+			tstamp = ktime_to_ns(skb->tstamp);
+	}
+
+	edt_release(q, ktime_get_ns());
+	edt_schedule(q, skb, tstamp);
+
+	qdisc_qstats_backlog_inc(sch, skb);
+	sch->q.qlen++;
+
+	return NET_XMIT_SUCCESS;
+}
+
+static struct sk_buff *edt_dequeue(struct Qdisc *sch)
+{
+	struct edt_sched_data *q = qdisc_priv(sch);
+	struct sk_buff *skb;
+
+	edt_release(q, ktime_get_ns());
+
+	skb = q->ready.head;
+	if (!skb) {
+		if (q->busy_slots) {
+			u64 expires = edt_next_slot(q) << q->slot_log;
+
+			qdisc_watchdog_schedule_ns(&q->watchdog, expires);
+		}
+		return NULL;
+	}
+	q->ready.head = skb->next;
+	skb->next = NULL;
+
+	/* The departure time is used up, do not let it pass for an
+	 * arrival time if the packet loops back to us.
+	 */
+	skb->tstamp = 0;
+
+	qdisc_qstats_backlog_dec(sch, skb);
+	sch->q.qlen--;
+	qdisc_bstats_update(sch, skb);
+	return skb;
+}
+
+static void edt_reset(struct Qdisc *sch)
+{
+	struct edt_sched_data *q = qdisc_priv(sch);
+	u32 idx;
+
+	sch->q.qlen = 0;
+	sch->qstats.backlog = 0;
+
+	if (q->ready.head)
+		rtnl_kfree_skbs(q->ready.head, q->ready.tail);
+	q->ready.head = NULL;
+
+	if (!q->slots)
+		return;
+
+	for_each_set_bit(idx, q->bitmap, 1U << q->slots_log) {
+		rtnl_kfree_skbs(q->slots[idx].head, q->slots[idx].tail);
+		q->slots[idx].head = NULL;
+	}
+	bitmap_zero(q->bitmap, 1U << q->slots_log);
+	q->busy_slots = 0;
+}
+
+/* Requeue the packets of the old wheel, in departure order */
+static void edt_rewheel(struct edt_sched_data *q, struct edt_slot *old_slots,
+			unsigned long *old_bitmap, u64 old_cursor, u32 old_log,
+			u32 old_slots_log)
+{
+	u32 nslots = 1U << old_slots_log;
+	struct sk_buff *skb, *next;
+	u32 i, idx;
+
+	for (i = 0; i < nslots; i++) {
+		idx = (old_cursor + i) & (nslots - 1);
+		if (!test_bit(idx, old_bitmap))
+			continue;
+		for (skb = old_slots[idx].head; skb; skb = next) {
+			next = skb->next;
+			edt_schedule(q, skb, ktime_to_ns(skb->tstamp));
+		}
+	}
+}
+
+static int edt_resize(struct Qdisc *sch, u32 slot_log, u32 slots_log)
+{
+	struct edt_sched_data *q = qdisc_priv(sch);
+	u32 old_log, old_slots_log, nslots = 1U << slots_log;
+	unsigned long *bitmap, *old_bitmap;
+	struct edt_slot *slots, *old_slots;
+	int node;
+	u64 old_cursor;
+
+	if (q->slots && slot_log == q->slot_log && slots_log == q->slots_log)
+		return 0;
+
+	/* If XPS was setup, we can allocate memory on right NUMA node */
+	node = netdev_queue_numa_node_read(sch->dev_queue);
+	slots = kvzalloc_node(sizeof(*slots) * nslots,
+			      GFP_KERNEL | __GFP_RETRY_MAYFAIL, node);
+	if (!slots)
+		return -ENOMEM;
+	bitmap = kvzalloc_node(BITS_TO_LONGS(nslots) * sizeof(long),
+			       GFP_KERNEL | __GFP_RETRY_MAYFAIL, node);
+	if (!bitmap) {
+		kvfree(slots);
+		return -ENOMEM;
+	}
+
+	sch_tree_lock(sch);
+
+	old_slots = q->slots;
+	old_bitmap = q->bitmap;
+	old_cursor = q->cursor;
+	old_log = q->slot_log;
+	old_slots_log = q->slots_log;
+
+	q->slots = slots;
+	q->bitmap = bitmap;
+	q->busy_slots = 0;
+	q->slot_log = slot_log;
+	q->slots_log = slots_log;
+	q->cursor = (old_cursor << old_log) >> slot_log;
+
+	if (old_slots)
+		edt_rewheel(q, old_slots, old_bitmap, old_cursor, old_log,
+			    old_slots_log);
+
+	sch_tree_unlock(sch);
+
+	kvfree(old_slots);
+	kvfree(old_bitmap);
+	return 0;
+}
+
+static const struct nla_policy edt_policy[TCA_EDT_MAX + 1] = {
+	[TCA_EDT_PLIMIT]	= { .type = NLA_U32 },
+	[TCA_EDT_SLOT_LOG]	= { .type = NLA_U32 },
+	[TCA_EDT_SLOTS_LOG]	= { .type = NLA_U32 },
+};
+
+static int edt_change(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct edt_sched_data *q = qdisc_priv(sch);
+	struct nlattr *tb[TCA_EDT_MAX + 1];
+	int err, drop_count = 0;
+	unsigned int drop_len = 0;
+	u32 slot_log, slots_log;
+
+	if (!opt)
+		return -EINVAL;
+
+	err = nla_parse_nested(tb, TCA_EDT_MAX, opt, edt_policy, NULL);
+	if (err < 0)
+		return err;
+
+	sch_tree_lock(sch);
+
+	slot_log = q->slot_log;
+	slots_log = q->slots_log;
+
+	if (tb[TCA_EDT_SLOT_LOG]) {
+		u32 nval = nla_get_u32(tb[TCA_EDT_SLOT_LOG]);
+
+		/* from 1 usec to about 1 sec */
+		if (nval >= 10 && nval <= 30)
+			slot_log = nval;
+		else
+			err = -EINVAL;
+	}
+
+	if (tb[TCA_EDT_SLOTS_LOG]) {
+		u32 nval = nla_get_u32(tb[TCA_EDT_SLOTS_LOG]);
+
+		if (nval >= 1 && nval <= ilog2(256*1024))
+			slots_log = nval;
+		else
+			err = -EINVAL;
+	}
+
+	if (tb[TCA_EDT_PLIMIT])
+		sch->limit = nla_get_u32(tb[TCA_EDT_PLIMIT]);
+
+	if (!err) {
+		sch_tree_unlock(sch);
+		err = edt_resize(sch, slot_log, slots_log);
+		sch_tree_lock(sch);
+	}
+	while (sch->q.qlen > sch->limit) {
+		struct sk_buff *skb = edt_dequeue(sch);
+
+		if (!skb)
+			break;
+		drop_len += qdisc_pkt_len(skb);
+		rtnl_kfree_skbs(skb, skb);
+		drop_count++;
+	}
+	qdisc_tree_reduce_backlog(sch, drop_count, drop_len);
+
+	sch_tree_unlock(sch);
+	return err;
+}
+
+static void edt_destroy(struct Qdisc *sch)
+{
+	struct edt_sched_data *q = qdisc_priv(sch);
+
+	edt_reset(sch);
+	kvfree(q->slots);
+	kvfree(q->bitmap);
+	qdisc_watchdog_cancel(&q->watchdog);
+}
+
+static int edt_init(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct edt_sched_data *q = qdisc_priv(sch);
+	int err;
+
+	sch->limit		= 10000;
+	q->ready.head		= NULL;
+	q->slots		= NULL;
+	q->bitmap		= NULL;
+	q->cursor		= 0;
+	q->busy_slots		= 0;
+	q->slot_log		= 16;	/* 65 usec */
+	q->slots_log		= 12;	/* 268 ms horizon */
+	qdisc_watchdog_init(&q->watchdog, sch);
+
+	if (opt)
+		err = edt_change(sch, opt);
+	else
+		err = edt_resize(sch, q->slot_log, q->slots_log);
+
+	return err;
+}
+
+static int edt_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct edt_sched_data *q = qdisc_priv(sch);
+	struct nlattr *opts;
+
+	opts = nla_nest_start(skb, TCA_OPTIONS);
+	if (opts == NULL)
+		goto nla_put_failure;
+
+	if (nla_put_u32(skb, TCA_EDT_PLIMIT, sch->limit) ||
+	    nla_put_u32(skb, TCA_EDT_SLOT_LOG, q->slot_log) ||
+	    nla_put_u32(skb, TCA_EDT_SLOTS_LOG, q->slots_log))
+		goto nla_put_failure;
+
+	return nla_nest_end(skb, opts);
+
+nla_put_failure:
+	return -1;
+}
+
+static int edt_dump_stats(struct Qdisc *sch, struct gnet_dump *d)
+{
+	struct edt_sched_data *q = qdisc_priv(sch);
+	struct tc_edt_xstats st;
+
+	sch_tree_lock(sch);
+
+	st.horizon_capped = q->stat_horizon_capped;
+	st.time_next_slot = 0;
+	if (q->busy_slots)
+		st.time_next_slot = (edt_next_slot(q) << q->slot_log) -
+				    ktime_get_ns();
+	st.busy_slots	  = q->busy_slots;
+
+	sch_tree_unlock(sch);
+
+	return gnet_stats_copy_app(d, &st, sizeof(st));
+}
+
+static struct Qdisc_ops edt_qdisc_ops __read_mostly = {
+	.id		=	"edt",
+	.priv_size	=	sizeof(struct edt_sched_data),
+
+	.enqueue	=	edt_enqueue,
+	.dequeue	=	edt_dequeue,
+	.peek		=	qdisc_peek_dequeued,
+	.init		=	edt_init,
+	.reset		=	edt_reset,
+	.destroy	=	edt_destroy,
+	.change		=	edt_change,
+	.dump		=	edt_dump,
+	.dump_stats	=	edt_dump_stats,
+	.owner		=	THIS_MODULE,
+};
+
+static int __init edt_module_init(void)
+{
+	return register_qdisc(&edt_qdisc_ops);
+}
+
+static void __exit edt_module_exit(void)
+{
+	unregister_qdisc(&edt_qdisc_ops);
+}
+
+module_init(edt_module_init)
+module_exit(edt_module_exit)
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Earliest Departure Time packet scheduler");
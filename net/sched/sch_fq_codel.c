@@ -44,6 +44,9 @@
  * Low memory footprint (64 bytes per flow)
  */
 
+/* Room for the skbs handed over while another cpu runs the qdisc */
+#define FQ_CODEL_DEFER_SIZE	256
+
 struct fq_codel_flow {
 	struct sk_buff	  *head;
 	struct sk_buff	  *tail;
@@ -500,6 +503,11 @@ static int fq_codel_init(struct Qdisc *sch, struct nlattr *opt)
 			codel_vars_init(&flow->cvars);
 		}
 	}
+	if (!sch->defer) {
+		err = qdisc_defer_init(sch, FQ_CODEL_DEFER_SIZE);
+		if (err)
+			return err;
+	}
 	if (sch->limit >= 1)
 		sch->flags |= TCQ_F_CAN_BYPASS;
 	else
@@ -143,6 +143,8 @@ static struct sk_buff *dequeue_skb(struct Qdisc *q, bool *validate,
 		skb = NULL;
 		goto trace;
 	}
+	if (q->flags & TCQ_F_DEFER_ENQ)
+		qdisc_defer_drain(q);
 	if (!(q->flags & TCQ_F_ONETXQUEUE) ||
 	    !netif_xmit_frozen_or_stopped(txq))
 		skb = q->dequeue(q);
@@ -684,11 +686,60 @@ void qdisc_reset(struct Qdisc *qdisc)
 		kfree_skb_list(qdisc->gso_skb);
 		qdisc->gso_skb = NULL;
 	}
+	if (qdisc->flags & TCQ_F_DEFER_ENQ) {
+		struct sk_buff *skb;
+
+		while ((skb = skb_array_consume(qdisc->defer)) != NULL)
+			kfree_skb(skb);
+	}
 	qdisc->q.qlen = 0;
 	qdisc->qstats.backlog = 0;
 }
 EXPORT_SYMBOL(qdisc_reset);
 
+/* Let cpus that find the qdisc running leave their skbs in a ring rather
+ * than queue up for its lock; the running cpu enqueues them before each
+ * dequeue. Called from ->init(), which owns the flag from then on.
+ */
+int qdisc_defer_init(struct Qdisc *qdisc, int size)
+{
+	int node = netdev_queue_numa_node_read(qdisc->dev_queue);
+
+	qdisc->defer = kzalloc_node(sizeof(*qdisc->defer), GFP_KERNEL, node);
+	if (!qdisc->defer)
+		return -ENOMEM;
+
+	if (skb_array_init(qdisc->defer, size, GFP_KERNEL)) {
+		kfree(qdisc->defer);
+		qdisc->defer = NULL;
+		return -ENOMEM;
+	}
+
+	qdisc->flags |= TCQ_F_DEFER_ENQ;
+	return 0;
+}
+EXPORT_SYMBOL(qdisc_defer_init);
+
+/* Under qdisc_lock(qdisc) */
+void qdisc_defer_drain(struct Qdisc *qdisc)
+{
+	struct sk_buff *skbs[16], *to_free = NULL;
+	int budget = qdisc->defer->ring.size;
+	int i, n;
+
+	do {
+		n = skb_array_consume_batched(qdisc->defer, skbs,
+					      ARRAY_SIZE(skbs));
+		for (i = 0; i < n; i++)
+			qdisc->enqueue(skbs[i], qdisc, &to_free);
+		budget -= n;
+	} while (n == ARRAY_SIZE(skbs) && budget > 0);
+
+	if (unlikely(to_free))
+		kfree_skb_list(to_free);
+}
+EXPORT_SYMBOL(qdisc_defer_drain);
+
 static void qdisc_rcu_free(struct rcu_head *head)
 {
 	struct Qdisc *qdisc = container_of(head, struct Qdisc, rcu_head);
@@ -725,6 +776,10 @@ void qdisc_destroy(struct Qdisc *qdisc)
 
 	kfree_skb_list(qdisc->gso_skb);
 	kfree_skb(qdisc->skb_bad_txq);
+	if (qdisc->defer) {
+		skb_array_cleanup(qdisc->defer);
+		kfree(qdisc->defer);
+	}
 	/*
 	 * gen_estimator est_timer() might access qdisc->q.lock,
 	 * wait a RCU grace period before freeing qdisc.
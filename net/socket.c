@@ -89,6 +89,7 @@
 #include <linux/magic.h>
 #include <linux/slab.h>
 #include <linux/xattr.h>
+#include <linux/splice.h>
 
 #include <linux/uaccess.h>
 #include <asm/unistd.h>
@@ -131,6 +132,9 @@ static ssize_t sock_sendpage(struct file *file, struct page *page,
 static ssize_t sock_splice_read(struct file *file, loff_t *ppos,
 				struct pipe_inode_info *pipe, size_t len,
 				unsigned int flags);
+static ssize_t sock_splice_write(struct pipe_inode_info *pipe,
+				 struct file *out, loff_t *ppos,
+				 size_t len, unsigned int flags);
 
 /*
  *	Socket files have a set of 'special' operations as well as the generic file ones. These don't appear
@@ -151,7 +155,7 @@ static const struct file_operations socket_file_ops = {
 	.release =	sock_close,
 	.fasync =	sock_fasync,
 	.sendpage =	sock_sendpage,
-	.splice_write = generic_splice_sendpage,
+	.splice_write = sock_splice_write,
 	.splice_read =	sock_splice_read,
 };
 
@@ -870,6 +874,18 @@ static ssize_t sock_splice_read(struct file *file, loff_t *ppos,
 	return sock->ops->splice_read(sock, ppos, pipe, len, flags);
 }
 
+static ssize_t sock_splice_write(struct pipe_inode_info *pipe,
+				 struct file *out, loff_t *ppos,
+				 size_t len, unsigned int flags)
+{
+	struct socket *sock = out->private_data;
+
+	if (flags & SPLICE_F_ZEROCOPY)
+		return splice_to_socket_zerocopy(pipe, out, sock, len, flags);
+
+	return generic_splice_sendpage(pipe, out, ppos, len, flags);
+}
+
 static ssize_t sock_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
 	struct file *file = iocb->ki_filp;
@@ -2403,6 +2419,48 @@ SYSCALL_DEFINE5(recvmmsg, int, fd, struct mmsghdr __user *, mmsg,
 	return datagrams;
 }
 
+/*
+ *	Drain several sockets in one call, typically those an epoll_wait()
+ *	reported ready. Each entry gets a non-blocking recvmmsg() and its
+ *	result in mv_ret; the return value is the total number of datagrams.
+ */
+
+SYSCALL_DEFINE3(recvmmsgv, struct mmsgvec __user *, vec,
+		unsigned int, vcnt, unsigned int, flags)
+{
+	struct mmsgvec __user *entry = vec;
+	struct mmsgvec mv;
+	int datagrams = 0, err = 0;
+	unsigned int i;
+
+	if (flags & (MSG_CMSG_COMPAT | MSG_WAITFORONE))
+		return -EINVAL;
+
+	if (vcnt > UIO_MAXIOV)
+		vcnt = UIO_MAXIOV;
+
+	flags |= MSG_DONTWAIT;
+
+	for (i = 0; i < vcnt; i++, entry++) {
+		if (copy_from_user(&mv, entry, sizeof(mv))) {
+			err = -EFAULT;
+			break;
+		}
+
+		mv.mv_ret = __sys_recvmmsg(mv.mv_fd, mv.mv_mmsg, mv.mv_vlen,
+					   flags, NULL);
+		if (put_user(mv.mv_ret, &entry->mv_ret)) {
+			err = -EFAULT;
+			break;
+		}
+		if (mv.mv_ret > 0)
+			datagrams += mv.mv_ret;
+		cond_resched();
+	}
+
+	return datagrams ? datagrams : err;
+}
+
 #ifdef __ARCH_WANT_SYS_SOCKETCALL
 /* Argument list sizes for sys_socketcall */
 #define AL(x) ((x) * sizeof(unsigned long))
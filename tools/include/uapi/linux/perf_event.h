@@ -553,12 +553,21 @@ struct perf_event_mmap_page {
 	 */
 	__u64	time_zero;
 	__u32	size;			/* Header size up to __reserved[] fields. */
+	__u32	__reserved_1;
+
+	/*
+	 * Running totals of records that could not be written, by cause.
+	 * Unlike the PERF_RECORD_LOST count these are never reset, and
+	 * they are updated as soon as a record is dropped.
+	 */
+	__u64	lost_nospace;		/* no room left in the data buffer */
+	__u64	lost_paused;		/* buffer paused */
 
 		/*
 		 * Hole for extension of the self monitor capabilities
 		 */
 
-	__u8	__reserved[118*8+4];	/* align to 1k. */
+	__u8	__reserved[116*8];	/* align to 1k. */
 
 	/*
 	 * Control data for the mmap() data buffer.
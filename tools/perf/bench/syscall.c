@@ -0,0 +1,109 @@
+/*
+ *
+ * syscall.c
+ *
+ * syscall: Benchmark for the round trip of trivial system calls
+ *
+ * getppid() does next to nothing in the kernel and read(0, buf, 0) only
+ * looks up a file descriptor, so what these measure is the cost of the
+ * system call entry and exit paths themselves.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include <subcmd/parse-options.h>
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <linux/time64.h>
+
+#define LOOPS_DEFAULT 10000000
+static	int			loops = LOOPS_DEFAULT;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop",	&loops,		"Specify number of loops"),
+	OPT_END()
+};
+
+static const char * const bench_syscall_usage[] = {
+	"perf bench syscall <options>",
+	NULL
+};
+
+static void syscall_getppid(void)
+{
+	/* Through syscall(), in case the C library ever caches the result */
+	syscall(__NR_getppid);
+}
+
+static void syscall_read(void)
+{
+	char c;
+
+	syscall(__NR_read, 0, &c, 0);
+}
+
+static int bench_syscall_common(int argc, const char **argv,
+				const char *name, void (*fn)(void))
+{
+	struct timeval start, stop, diff;
+	unsigned long long result_usec = 0;
+	int i;
+
+	argc = parse_options(argc, argv, options, bench_syscall_usage, 0);
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < loops; i++)
+		fn();
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Executed %d %s() calls\n\n", loops, name);
+
+		result_usec = diff.tv_sec * USEC_PER_SEC;
+		result_usec += diff.tv_usec;
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
+
+		printf(" %14lf usecs/op\n",
+		       (double)result_usec / (double)loops);
+		printf(" %14d ops/sec\n",
+		       (int)((double)loops /
+			     ((double)result_usec / (double)USEC_PER_SEC)));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
+
+int bench_syscall_basic(int argc, const char **argv)
+{
+	return bench_syscall_common(argc, argv, "getppid", syscall_getppid);
+}
+
+int bench_syscall_read(int argc, const char **argv)
+{
+	return bench_syscall_common(argc, argv, "read", syscall_read);
+}